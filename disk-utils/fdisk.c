@@ -59,11 +59,12 @@
 # ifdef HAVE_LINUX_FS_H
 #  include <linux/fs.h>
 # endif
-# ifndef BLKDISCARD
-#   define BLKDISCARD     _IO(0x12,119)
-# endif
+# include "discard.h"
 #endif
 
+/* number of threads to discard sectors */
+#define FDISK_DISCARD_JOBS	4
+
 int pwipemode = WIPEMODE_AUTO;
 int device_is_used;
 int is_interactive;
@@ -791,6 +792,7 @@ static int do_discard(struct fdisk_context *cxt, struct fdisk_partition *pa)
 	char buf[512];
 	unsigned long ss;
 	uint64_t range[2];
+	struct ul_discard dc;
 	int yes = 0;
 
 	ss = fdisk_get_sector_size(cxt);
@@ -810,7 +812,12 @@ static int do_discard(struct fdisk_context *cxt, struct fdisk_partition *pa)
 		return 1;
 
 	errno = 0;
-	if (ioctl(fdisk_get_devfd(cxt), BLKDISCARD, &range)) {
+	if (ul_discard_init(&dc, fdisk_get_devfd(cxt), BLKDISCARD,
+			    range[0], range[0] + range[1]) != 0)
+		return -errno;
+
+	dc.njobs = FDISK_DISCARD_JOBS;
+	if (ul_discard_range(&dc) != 0) {
 		fdisk_warn(cxt, _("BLKDISCARD ioctl failed"));
 		return -errno;
 	}
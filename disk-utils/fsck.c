@@ -59,6 +59,7 @@
 #include "fileutils.h"
 #include "monotonic.h"
 #include "strutils.h"
+#include "sysfs.h"
 
 #define XALLOC_EXIT_CODE	FSCK_EX_ERROR
 #include "xalloc.h"
@@ -99,11 +100,24 @@ struct fsck_fs_data
 {
 	const char	*device;
 	dev_t		disk;
-	unsigned int	stacked:1,
-			done:1,
+	dev_t		*phys;		/* whole disks under the (stacked) device */
+	size_t		nphys;
+	uint64_t	size;		/* device size in bytes */
+	unsigned int	done:1,
 			eval_device:1;
 };
 
+/*
+ * Max number of fsck instances per physical disk, FSCK_DISK_LIMITS
+ */
+struct fsck_disk_limit {
+	char	*name;		/* kernel disk name or NULL for cached disks */
+	dev_t	disk;
+	int	limit;		/* 0 means unlimited */
+};
+
+#define FSCK_MAX_STACK_DEPTH	16
+
 /*
  * Structure to allow exit codes to be stored
  */
@@ -153,6 +167,15 @@ static FILE *report_stats_file;
 static int num_running;
 static int max_running;
 
+static struct fsck_disk_limit *disk_limits;
+static size_t ndisk_limits;
+static int rotational_limit = 1;
+static int nonrot_limit = 1;
+
+/* aggregate progress of check_all() */
+static size_t all_fs, all_fs_done;
+static uint64_t all_bytes, all_bytes_done;
+
 static volatile sig_atomic_t cancel_requested;
 static int kill_sent;
 static char *fstype;
@@ -166,7 +189,7 @@ static char *fsck_path;
 static struct libmnt_table *fstab, *mtab;
 static struct libmnt_cache *mntcache;
 
-static int count_slaves(dev_t disk);
+static void add_phys_disks(struct fsck_fs_data *data, dev_t devno, int depth);
 
 static int string_to_int(const char *s)
 {
@@ -283,17 +306,39 @@ static dev_t fs_get_disk(struct libmnt_fs *fs, int check)
 	if (!stat(device, &st) &&
 	    !blkid_devno_to_wholedisk(st.st_rdev, NULL, 0, &data->disk)) {
 
-		if (data->disk)
-			data->stacked = count_slaves(data->disk) > 0 ? 1 : 0;
+		if (data->disk) {
+			struct path_cxt *pc = ul_new_sysfs_path(st.st_rdev, NULL, NULL);
+
+			if (pc && ul_path_read_u64(pc, &data->size, "size") == 0)
+				data->size <<= 9;
+			ul_unref_path(pc);
+
+			add_phys_disks(data, st.st_rdev, 0);
+		}
 		return data->disk;
 	}
 	return 0;
 }
 
-static int fs_is_stacked(struct libmnt_fs *fs)
+static uint64_t fs_get_size(struct libmnt_fs *fs)
 {
 	struct fsck_fs_data *data = mnt_fs_get_userdata(fs);
-	return data ? data->stacked : 0;
+	return data ? data->size : 0;
+}
+
+/* returns 1 if @fs is on @disk, -1 if the disks of @fs are unknown */
+static int fs_uses_disk(struct libmnt_fs *fs, dev_t disk)
+{
+	struct fsck_fs_data *data = mnt_fs_get_userdata(fs);
+	size_t i;
+
+	if (!data || !data->nphys)
+		return -1;
+	for (i = 0; i < data->nphys; i++) {
+		if (data->phys[i] == disk)
+			return 1;
+	}
+	return 0;
 }
 
 static int fs_is_done(struct libmnt_fs *fs)
@@ -629,6 +674,18 @@ static void print_stats(struct fsck_instance *inst)
 			(int64_t)inst->rusage.ru_stime.tv_usec);
 }
 
+/* print the aggregate progress of all filesystems checked by check_all() */
+static void print_progress(void)
+{
+	char *done = size_to_human_string(SIZE_SUFFIX_1LETTER, all_bytes_done);
+	char *total = size_to_human_string(SIZE_SUFFIX_1LETTER, all_bytes);
+
+	printf(_("Checked %zu of %zu filesystems (%s of %s)\n"),
+	       all_fs_done, all_fs, done, total);
+	free(done);
+	free(total);
+}
+
 /*
  * Execute a particular fsck program, and link it into the list of
  * child processes we are waiting for.
@@ -864,6 +921,13 @@ ret_inst:
 		printf(_("Finished with %s (exit status %d)\n"),
 		       fs_get_device(inst->fs), inst->exit_status);
 	num_running--;
+
+	if (all_fs) {
+		all_fs_done++;
+		all_bytes_done += fs_get_size(inst->fs);
+		if (verbose)
+			print_progress();
+	}
 	return inst;
 }
 
@@ -1184,74 +1248,213 @@ static int ignore(struct libmnt_fs *fs)
 	return 0;
 }
 
-static int count_slaves(dev_t disk)
+/*
+ * Adds the whole disks under @devno to @data->phys. The slaves of the stacked
+ * devices (MD, DM, ...) are followed down to the disks without slaves.
+ */
+static void add_phys_disks(struct fsck_fs_data *data, dev_t devno, int depth)
 {
-	DIR *dir;
-	struct dirent *dp;
-	char dirname[PATH_MAX];
-	int count = 0;
+	struct path_cxt *pc;
+	struct dirent *d;
+	dev_t disk = 0;
+	DIR *dir = NULL;
+	size_t i;
+	int nslaves = 0;
 
-	snprintf(dirname, sizeof(dirname),
-			"/sys/dev/block/%u:%u/slaves/",
-			major(disk), minor(disk));
+	if (depth > FSCK_MAX_STACK_DEPTH)
+		return;
+	if (blkid_devno_to_wholedisk(devno, NULL, 0, &disk) != 0 || !disk)
+		disk = devno;
 
-	if (!(dir = opendir(dirname)))
-		return -1;
+	pc = ul_new_sysfs_path(disk, NULL, NULL);
+	if (pc)
+		dir = ul_path_opendir(pc, "slaves");
+	if (dir) {
+		while ((d = xreaddir(dir))) {
+			dev_t slave;
 
-	while ((dp = readdir(dir)) != NULL) {
-#ifdef _DIRENT_HAVE_D_TYPE
-		if (dp->d_type != DT_UNKNOWN && dp->d_type != DT_LNK)
-			continue;
-#endif
-		if (dp->d_name[0] == '.' &&
-		    ((dp->d_name[1] == 0) ||
-		     ((dp->d_name[1] == '.') && (dp->d_name[2] == 0))))
-			continue;
+			if (ul_path_readf_majmin(pc, &slave, "slaves/%s/dev", d->d_name) != 0)
+				continue;
+			add_phys_disks(data, slave, depth + 1);
+			nslaves++;
+		}
+		closedir(dir);
+	}
+	ul_unref_path(pc);
+
+	if (nslaves)
+		return;
+	for (i = 0; i < data->nphys; i++) {
+		if (data->phys[i] == disk)
+			return;
+	}
+	data->phys = xreallocarray(data->phys, data->nphys + 1, sizeof(dev_t));
+	data->phys[data->nphys++] = disk;
+}
+
+/*
+ * Returns the max number of instances for the physical @disk. The limit is
+ * the FSCK_DISK_LIMITS setting for the disk name, or the default for
+ * rotational and non-rotational disks.
+ */
+static int get_disk_limit(dev_t disk)
+{
+	struct fsck_disk_limit *lim = NULL;
+	struct path_cxt *pc;
+	char name[PATH_MAX];
+	size_t i;
+	int limit;
+
+	for (i = 0; i < ndisk_limits; i++) {
+		if (!disk_limits[i].name && disk_limits[i].disk == disk)
+			return disk_limits[i].limit;
+	}
+
+	limit = is_irrotational_disk(disk) ? nonrot_limit : rotational_limit;
 
-		count++;
+	pc = ul_new_sysfs_path(disk, NULL, NULL);
+	if (pc && sysfs_blkdev_get_name(pc, name, sizeof(name))) {
+		for (i = 0; i < ndisk_limits; i++) {
+			if (disk_limits[i].name
+			    && strcmp(disk_limits[i].name, name) == 0) {
+				limit = disk_limits[i].limit;
+				break;
+			}
+		}
 	}
+	ul_unref_path(pc);
+
+	/* cache the result */
+	disk_limits = xreallocarray(disk_limits, ndisk_limits + 1,
+				    sizeof(struct fsck_disk_limit));
+	lim = &disk_limits[ndisk_limits++];
+	lim->name = NULL;
+	lim->disk = disk;
+	lim->limit = limit;
 
-	closedir(dir);
-	return count;
+	return limit;
 }
 
 /*
- * Returns TRUE if a partition on the same disk is already being
- * checked.
+ * Parses FSCK_DISK_LIMITS="rotational=<num>,nonrot=<num>,<disk>=<num>,...",
+ * the <disk> is the kernel name (e.g. sda or nvme0n1).
+ */
+static void parse_disk_limits(const char *str)
+{
+	char *buf, *tok, *save = NULL;
+
+	if (!str || !*str)
+		return;
+
+	buf = xstrdup(str);
+	for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		char *val = strchr(tok, '=');
+		int32_t limit;
+
+		if (!val || val == tok || ul_strtos32(val + 1, &limit, 10) != 0
+		    || limit < 0) {
+			warnx(_("invalid FSCK_DISK_LIMITS item: %s"), tok);
+			continue;
+		}
+		*val = '\0';
+
+		if (strcmp(tok, "rotational") == 0)
+			rotational_limit = limit;
+		else if (strcmp(tok, "nonrot") == 0)
+			nonrot_limit = limit;
+		else {
+			disk_limits = xreallocarray(disk_limits, ndisk_limits + 1,
+						    sizeof(struct fsck_disk_limit));
+			disk_limits[ndisk_limits].name = xstrdup(tok);
+			disk_limits[ndisk_limits].disk = 0;
+			disk_limits[ndisk_limits].limit = limit;
+			ndisk_limits++;
+		}
+	}
+	free(buf);
+}
+
+/*
+ * Returns TRUE if any physical disk of the filesystem already runs the max
+ * number of instances. A stacked device (RAID, dm-crypt, ...) uses all the
+ * disks under it.
  */
 static int disk_already_active(struct libmnt_fs *fs)
 {
+	struct fsck_fs_data *data;
 	struct fsck_instance *inst;
-	dev_t disk;
+	size_t i;
 
 	if (force_all_parallel)
 		return 0;
 
-	if (instance_list && fs_is_stacked(instance_list->fs))
-		/* any instance for a stacked device is already running */
-		return 1;
-
-	disk = fs_get_disk(fs, 1);
+	fs_get_disk(fs, 1);
+	data = mnt_fs_get_userdata(fs);
 
 	/*
 	 * If we don't know the base device, assume that the device is
 	 * already active if there are any fsck instances running.
-	 *
-	 * Don't check a stacked device with any other disk too.
 	 */
-	if (!disk || fs_is_stacked(fs))
+	if (!data || !data->nphys)
 		return (instance_list != NULL);
 
-	for (inst = instance_list; inst; inst = inst->next) {
-		dev_t idisk = fs_get_disk(inst->fs, 0);
+	for (i = 0; i < data->nphys; i++) {
+		int limit = get_disk_limit(data->phys[i]);
+		int n = 0;
 
-		if (!idisk || disk == idisk)
+		for (inst = instance_list; inst; inst = inst->next) {
+			int rc = fs_uses_disk(inst->fs, data->phys[i]);
+
+			if (rc < 0)
+				return 1;
+			n += rc;
+		}
+		if (limit && n >= limit)
 			return 1;
 	}
 
 	return 0;
 }
 
+/*
+ * Returns the filesystems to check, the largest first to not start the
+ * longest check at the end of the pass. The fstab order is kept for the
+ * filesystems of the same size and for the serialized checks.
+ */
+static struct libmnt_fs **get_fs_order(struct libmnt_iter *itr, size_t *nfs)
+{
+	struct libmnt_fs **fss = NULL, *fs;
+	size_t n = 0;
+
+	mnt_reset_iter(itr, MNT_ITER_FORWARD);
+
+	while (mnt_table_next_fs(fstab, itr, &fs) == 0) {
+		size_t i = n;
+		uint64_t size;
+
+		if (fs_is_done(fs))
+			continue;
+
+		fs_get_disk(fs, 1);
+		size = fs_get_size(fs);
+
+		if (!serialize) {
+			while (i > 0 && fs_get_size(fss[i - 1]) < size)
+				i--;
+		}
+		fss = xreallocarray(fss, n + 1, sizeof(struct libmnt_fs *));
+		memmove(fss + i + 1, fss + i, (n - i) * sizeof(struct libmnt_fs *));
+		fss[i] = fs;
+		n++;
+
+		all_fs++;
+		all_bytes += size;
+	}
+
+	*nfs = n;
+	return fss;
+}
+
 /* Check all file systems, using the /etc/fstab table. */
 static int check_all(void)
 {
@@ -1259,8 +1462,9 @@ static int check_all(void)
 	int passno = 1;
 	int pass_done;
 	int status = FSCK_EX_OK;
+	size_t i, nfs = 0;
 
-	struct libmnt_fs *fs;
+	struct libmnt_fs *fs, **fss;
 	struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_FORWARD);
 
 	if (!itr)
@@ -1316,13 +1520,14 @@ static int check_all(void)
 		}
 	}
 
+	fss = get_fs_order(itr, &nfs);
+
 	while (not_done_yet) {
 		not_done_yet = 0;
 		pass_done = 1;
 
-		mnt_reset_iter(itr, MNT_ITER_FORWARD);
-
-		while(mnt_table_next_fs(fstab, itr, &fs) == 0) {
+		for (i = 0; i < nfs; i++) {
+			fs = fss[i];
 
 			if (cancel_requested)
 				break;
@@ -1339,6 +1544,8 @@ static int check_all(void)
 			}
 			if (ignore_mounted && is_mounted(fs)) {
 				fs_set_done(fs);
+				all_fs--;
+				all_bytes -= fs_get_size(fs);
 				continue;
 			}
 			/*
@@ -1388,6 +1595,7 @@ static int check_all(void)
 	}
 
 	status |= wait_many(FLAG_WAIT_ATLEAST_ONE);
+	free(fss);
 	mnt_free_iter(itr);
 	return status;
 }
@@ -1615,6 +1823,7 @@ static void parse_argv(int argc, char *argv[])
 		force_all_parallel++;
 	if (ul_strtos32(getenv("FSCK_MAX_INST"), &max_running, 10) != 0)
 		max_running = 0;
+	parse_disk_limits(getenv("FSCK_DISK_LIMITS"));
 }
 
 int main(int argc, char *argv[])
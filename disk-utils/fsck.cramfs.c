@@ -45,6 +45,9 @@
 #include <string.h>
 #include <getopt.h>
 #include <fcntl.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 /* We don't use our include/crc32.h, but crc32 from zlib!
  *
@@ -76,6 +79,7 @@ static int cramfs_is_big_endian = 0;	/* source is big endian */
 static int opt_verbose = 0;	/* 1 = verbose (-v), 2+ = very verbose (-vv) */
 static int opt_extract = 0;	/* extract cramfs (-x) */
 static char *extract_dir = "";		/* optional extraction directory (-x) */
+static size_t opt_jobs = 0;		/* number of threads (-j) */
 
 #define PAD_SIZE 512
 
@@ -101,6 +105,9 @@ static size_t rombufmask = CRAMFS_ROMBUFFERMASK;
 static char *read_buffer;
 static unsigned long read_buffer_block = ~0UL;
 
+static char *rom_image;			/* the whole image in memory or NULL */
+static size_t rom_size;
+
 static z_stream stream;
 
 /* Prototypes */
@@ -127,6 +134,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -y                       for compatibility only, ignored\n"), out);
 	fputs(_(" -b, --blocksize <size>   use this blocksize, defaults to page size\n"), out);
 	fputs(_("     --extract[=<dir>]    test uncompression, optionally extract into <dir>\n"), out);
+#ifdef HAVE_PTHREAD
+	fputs(_(" -j, --jobs <num>         uncompress by up to <num> threads\n"), out);
+#endif
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(26));
 
@@ -217,20 +227,15 @@ static void test_super(int *start)
 		warnx(_("old cramfs format"));
 }
 
-static void test_crc(int start)
+/*
+ * Maps the image to rom_image; if mmap() is not supported then the image is
+ * read to anonymous memory.
+ */
+static void map_image(void)
 {
 	void *buf;
-	uint32_t crc;
-
-	if (!(super.flags & CRAMFS_FLAG_FSID_VERSION_2)) {
-		warnx(_("unable to test CRC: old cramfs format"));
-		return;
-	}
-
-	crc = crc32(0L, NULL, 0);
 
-	buf =
-	    mmap(NULL, super.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	buf = mmap(NULL, super.size, PROT_READ, MAP_PRIVATE, fd, 0);
 	if (buf == MAP_FAILED) {
 		buf =
 		    mmap(NULL, super.size, PROT_READ | PROT_WRITE,
@@ -248,10 +253,34 @@ static void test_crc(int start)
 		}
 	}
 	if (buf != MAP_FAILED) {
-		((struct cramfs_super *)((unsigned char *) buf + start))->fsid.crc =
-		    crc32(0L, NULL, 0);
-		crc = crc32(crc, (unsigned char *) buf + start, super.size - start);
-		munmap(buf, super.size);
+		rom_image = buf;
+		rom_size = super.size;
+	}
+}
+
+static void test_crc(int start)
+{
+	void *buf;
+	uint32_t crc;
+
+	if (!(super.flags & CRAMFS_FLAG_FSID_VERSION_2)) {
+		warnx(_("unable to test CRC: old cramfs format"));
+		return;
+	}
+
+	crc = crc32(0L, NULL, 0);
+
+	map_image();
+	if (rom_image) {
+		/* the CRC is calculated with zero in the CRC field */
+		const size_t crcoff = offsetof(struct cramfs_super, fsid.crc);
+		const uint32_t zero = 0;
+		unsigned char *p = (unsigned char *) rom_image + start;
+
+		crc = crc32(crc, p, crcoff);
+		crc = crc32(crc, (const unsigned char *) &zero, sizeof(zero));
+		crc = crc32(crc, p + crcoff + sizeof(zero),
+			    super.size - start - crcoff - sizeof(zero));
 	} else {
 		int retval;
 		size_t length = 0;
@@ -306,6 +335,11 @@ static void print_node(char type, struct cramfs_inode *i, char *name)
 static void *romfs_read(unsigned long offset)
 {
 	unsigned int block = offset >> rombufbits;
+
+	/* use the image in memory, unless the access may go behind the end */
+	if (rom_image && offset + rombufsize <= rom_size)
+		return rom_image + offset;
+
 	if (block != read_buffer_block) {
 		ssize_t x;
 
@@ -382,11 +416,245 @@ static int uncompress_block(void *src, size_t len)
 #define lchown chown
 #endif
 
+static void check_block_size(unsigned long out, unsigned long size)
+{
+	if (size >= blksize) {
+		if (out != blksize)
+			errx(FSCK_EX_UNCORRECTED,
+			     _("non-block (%ld) bytes"), out);
+	} else {
+		if (out != size)
+			errx(FSCK_EX_UNCORRECTED,
+			     _("non-size (%ld vs %ld) bytes"), out,
+			     size);
+	}
+}
+
+#ifdef HAVE_PTHREAD
+/*
+ * The blocks of a file are uncompressed by batches. The threads uncompress
+ * the blocks of the batch to the separate buffers, the main thread checks
+ * and writes them in the order. Every thread has its own z_stream.
+ */
+#define UNCOMPRESS_BLOCKS_PER_JOB	16
+
+struct uncompress_block {
+	unsigned long	curr;		/* the compressed data */
+	unsigned long	next;
+	unsigned long	out;		/* the uncompressed size */
+	int		rc;		/* inflate() return code */
+};
+
+struct uncompress_pool {
+	pthread_mutex_t	lock;
+	pthread_cond_t	work;		/* a new batch or the end */
+	pthread_cond_t	done;		/* all blocks of the batch uncompressed */
+
+	pthread_t	*threads;
+	size_t		nthreads;
+
+	struct uncompress_block *blocks;
+	char		*buf;		/* 2 * blksize per block */
+	size_t		batch;		/* allocated blocks */
+	size_t		nblocks;	/* blocks in the current batch */
+	size_t		next;		/* the next block to uncompress */
+	size_t		ndone;
+
+	unsigned int	quit : 1;
+};
+
+static struct uncompress_pool pool;
+
+static void pool_uncompress_block(z_stream *zs, size_t i)
+{
+	struct uncompress_block *b = &pool.blocks[i];
+
+	/* holes and too large blocks are handled by the main thread */
+	if (b->curr == b->next || b->next - b->curr > blksize * 2)
+		return;
+
+	zs->next_in = (unsigned char *) rom_image + b->curr;
+	zs->avail_in = b->next - b->curr;
+	zs->next_out = (unsigned char *) pool.buf + i * blksize * 2;
+	zs->avail_out = blksize * 2;
+
+	inflateReset(zs);
+	b->rc = inflate(zs, Z_FINISH);
+	b->out = zs->total_out;
+}
+
+/* uncompresses the blocks of the current batch, called with locked pool */
+static void pool_uncompress_blocks(z_stream *zs)
+{
+	while (pool.next < pool.nblocks) {
+		size_t i = pool.next++;
+
+		pthread_mutex_unlock(&pool.lock);
+		pool_uncompress_block(zs, i);
+		pthread_mutex_lock(&pool.lock);
+
+		if (++pool.ndone == pool.nblocks)
+			pthread_cond_signal(&pool.done);
+	}
+}
+
+static void *uncompress_worker(void *data __attribute__((__unused__)))
+{
+	z_stream zs = { .next_in = NULL };
+
+	if (inflateInit(&zs) != Z_OK)
+		return NULL;
+
+	pthread_mutex_lock(&pool.lock);
+	for (;;) {
+		while (!pool.quit && pool.next >= pool.nblocks)
+			pthread_cond_wait(&pool.work, &pool.lock);
+		if (pool.quit)
+			break;
+		pool_uncompress_blocks(&zs);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	inflateEnd(&zs);
+	return NULL;
+}
+
+static void start_uncompress_pool(size_t njobs)
+{
+	size_t i;
+
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.work, NULL);
+	pthread_cond_init(&pool.done, NULL);
+
+	pool.batch = njobs * UNCOMPRESS_BLOCKS_PER_JOB;
+	pool.blocks = xcalloc(pool.batch, sizeof(struct uncompress_block));
+	pool.buf = xmalloc(pool.batch * blksize * 2);
+
+	/* the main thread uncompresses too */
+	pool.threads = xcalloc(njobs - 1, sizeof(pthread_t));
+	for (i = 0; i < njobs - 1; i++) {
+		if (pthread_create(&pool.threads[i], NULL, uncompress_worker, NULL) != 0)
+			break;
+		pool.nthreads++;
+	}
+}
+
+static void stop_uncompress_pool(void)
+{
+	size_t i;
+
+	pthread_mutex_lock(&pool.lock);
+	pool.quit = 1;
+	pthread_cond_broadcast(&pool.work);
+	pthread_mutex_unlock(&pool.lock);
+
+	for (i = 0; i < pool.nthreads; i++)
+		pthread_join(pool.threads[i], NULL);
+
+	free(pool.threads);
+	free(pool.blocks);
+	free(pool.buf);
+	pthread_cond_destroy(&pool.done);
+	pthread_cond_destroy(&pool.work);
+	pthread_mutex_destroy(&pool.lock);
+}
+
+/*
+ * Uncompresses the file by the pool. The blocks that are not completely in
+ * the image (broken block pointers) are left to do_uncompress(), @offset,
+ * @curr and @size are updated according to the processed blocks.
+ */
+static void pool_uncompress(char *path, int outfd, unsigned long *offset,
+			    unsigned long *curr, unsigned long *size)
+{
+	while (*size) {
+		unsigned long o = *offset, c = *curr, left = *size;
+		size_t i, n = 0;
+
+		for (n = 0; left && n < pool.batch; n++) {
+			struct uncompress_block *b = &pool.blocks[n];
+			unsigned long next;
+
+			if (o + 4 > rom_size)
+				break;
+			next = u32_toggle_endianness(cramfs_is_big_endian,
+						     *(uint32_t *) (rom_image + o));
+			if (next < c || next > rom_size)
+				break;
+			b->curr = c;
+			b->next = next;
+			b->out = 0;
+			b->rc = Z_STREAM_END;
+
+			left -= min(left, (unsigned long) blksize);
+			o += 4;
+			c = next;
+		}
+		if (!n)
+			break;
+
+		pthread_mutex_lock(&pool.lock);
+		pool.nblocks = n;
+		pool.next = 0;
+		pool.ndone = 0;
+		pthread_cond_broadcast(&pool.work);
+
+		pool_uncompress_blocks(&stream);
+		while (pool.ndone < pool.nblocks)
+			pthread_cond_wait(&pool.done, &pool.lock);
+		pool.nblocks = 0;
+		pthread_mutex_unlock(&pool.lock);
+
+		for (i = 0; i < n; i++) {
+			struct uncompress_block *b = &pool.blocks[i];
+			char *buf = pool.buf + i * blksize * 2;
+			unsigned long out;
+
+			if (b->next > end_data)
+				end_data = b->next;
+
+			if (b->curr == b->next) {
+				if (opt_verbose > 1)
+					printf(_("  hole at %lu (%zu)\n"), b->curr,
+					       blksize);
+				out = min(*size, (unsigned long) blksize);
+				memset(buf, 0x00, out);
+			} else {
+				if (opt_verbose > 1)
+					printf(_("  uncompressing block at %lu to %lu (%lu)\n"),
+					       b->curr, b->next, b->next - b->curr);
+				if (b->next - b->curr > blksize * 2)
+					errx(FSCK_EX_UNCORRECTED, _("data block too large"));
+				if (b->rc != Z_STREAM_END)
+					errx(FSCK_EX_UNCORRECTED, _("decompression error: %s"),
+					     zError(b->rc));
+				out = b->out;
+			}
+			check_block_size(out, *size);
+
+			*size -= out;
+			if (*extract_dir != '\0' && write(outfd, buf, out) < 0)
+				err(FSCK_EX_ERROR, _("write failed: %s"), path);
+			*offset += 4;
+			*curr = b->next;
+		}
+	}
+}
+#endif /* HAVE_PTHREAD */
+
 static void do_uncompress(char *path, int outfd, unsigned long offset,
 			  unsigned long size)
 {
 	unsigned long curr = offset + 4 * ((size + blksize - 1) / blksize);
 
+#ifdef HAVE_PTHREAD
+	if (pool.nthreads && rom_image) {
+		pool_uncompress(path, outfd, &offset, &curr, &size);
+		if (!size)
+			return;
+	}
+#endif
 	do {
 		unsigned long out = blksize;
 		unsigned long next = u32_toggle_endianness(cramfs_is_big_endian,
@@ -410,22 +678,15 @@ static void do_uncompress(char *path, int outfd, unsigned long offset,
 				       curr, next, next - curr);
 			out = uncompress_block(romfs_read(curr), next - curr);
 		}
-		if (size >= blksize) {
-			if (out != blksize)
-				errx(FSCK_EX_UNCORRECTED,
-				     _("non-block (%ld) bytes"), out);
-		} else {
-			if (out != size)
-				errx(FSCK_EX_UNCORRECTED,
-				     _("non-size (%ld vs %ld) bytes"), out,
-				     size);
-		}
+		check_block_size(out, size);
+
 		size -= out;
 		if (*extract_dir != '\0' && write(outfd, outbuffer, out) < 0)
 			err(FSCK_EX_ERROR, _("write failed: %s"), path);
 		curr = next;
 	} while (size);
 }
+
 static void change_file_status(char *path, struct cramfs_inode *i)
 {
 	const struct timeval epoch[] = { {0,0}, {0,0} };
@@ -655,7 +916,15 @@ static void test_fs(int start)
 	stream.next_in = NULL;
 	stream.avail_in = 0;
 	inflateInit(&stream);
+#ifdef HAVE_PTHREAD
+	if (opt_jobs > 1)
+		start_uncompress_pool(opt_jobs);
+#endif
 	expand_fs(extract_dir, root);
+#ifdef HAVE_PTHREAD
+	if (opt_jobs > 1)
+		stop_uncompress_pool();
+#endif
 	inflateEnd(&stream);
 	if (start_data != ~0UL) {
 		if (start_data < (sizeof(struct cramfs_super) + start))
@@ -684,6 +953,9 @@ int main(int argc, char **argv)
 		{"help",      no_argument,       NULL, 'h'},
 		{"blocksize", required_argument, NULL, 'b'},
 		{"extract",   optional_argument, NULL, 'x'},
+#ifdef HAVE_PTHREAD
+		{"jobs",      required_argument, NULL, 'j'},
+#endif
 		{NULL, 0, NULL, 0},
 	};
 
@@ -696,7 +968,7 @@ int main(int argc, char **argv)
 	strutils_set_exitcode(FSCK_EX_USAGE);
 
 	/* command line options */
-	while ((c = getopt_long(argc, argv, "ayvVhb:", longopts, NULL)) != EOF)
+	while ((c = getopt_long(argc, argv, "ayvVhb:j:", longopts, NULL)) != EOF)
 		switch (c) {
 		case 'a':		/* ignore */
 		case 'y':
@@ -717,6 +989,9 @@ int main(int argc, char **argv)
 		case 'b':
 			blksize = strtou32_or_err(optarg, _("invalid blocksize argument"));
 			break;
+		case 'j':
+			opt_jobs = strtou32_or_err(optarg, _("invalid jobs argument"));
+			break;
 		default:
 			errtryhelp(FSCK_EX_USAGE);
 		}
@@ -748,6 +1023,8 @@ int main(int argc, char **argv)
 		test_fs(start);
 	}
 
+	if (rom_image)
+		munmap(rom_image, rom_size);
 	if (opt_verbose)
 		printf(_("%s: OK\n"), filename);
 
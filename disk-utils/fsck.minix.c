@@ -1141,11 +1141,75 @@ bad_zone(int i) {
 	return (MINIX_BLOCK_SIZE != read(device_fd, buffer, MINIX_BLOCK_SIZE));
 }
 
+/*
+ * Returns the first inode from @i where anything has to be checked. Unused
+ * inodes are skipped by 64-bit words.
+ */
+static unsigned long
+next_inode_to_check(unsigned long i) {
+	unsigned long end = get_ninodes() + 1;
+	uint64_t w;
+
+	if (warn_mode)
+		return i;	/* all unused inodes have to be checked */
+
+	while (i + 64 <= end && i % 64 == 0) {
+		size_t n;
+
+		memcpy(&w, inode_map + i / NBBY, sizeof(w));
+		if (w)
+			break;
+		for (n = 0; n < 64 && inode_count[i + n] == 0; n++)
+			;
+		if (n < 64)
+			break;
+		i += 64;
+	}
+	return i;
+}
+
+/*
+ * Returns the first zone from @i where the bitmap is not in sync with the
+ * counter. The zones are compared by 64-bit words.
+ */
+static unsigned long
+next_zone_to_check(unsigned long i) {
+	const uint64_t ones = 0x0101010101010101ULL;
+	unsigned long end = get_nzones();
+	unsigned long bit;
+	uint64_t w, c;
+
+	for (; i < end; i++) {
+		bit = i - get_first_zone() + 1;
+
+		if (bit % 64 == 0 && i + 64 <= end) {
+			size_t n;
+
+			memcpy(&w, zone_map + bit / NBBY, sizeof(w));
+			if (w == 0 || w == UINT64_MAX) {
+				for (n = 0; n < 64; n += sizeof(c)) {
+					memcpy(&c, zone_count + i + n, sizeof(c));
+					if (c != (w ? ones : 0))
+						break;
+				}
+				if (n == 64) {
+					i += 63;
+					continue;
+				}
+			}
+		}
+		if (zone_in_use(i) != zone_count[i])
+			break;
+	}
+	return i;
+}
+
 static void
 check_counts(void) {
 	unsigned long i;
 
-	for (i = 1; i <= get_ninodes(); i++) {
+	for (i = next_inode_to_check(1); i <= get_ninodes();
+	     i = next_inode_to_check(i + 1)) {
 		if (!inode_in_use(i) && Inode[i].i_mode && warn_mode) {
 			printf(_("Inode %lu mode not cleared."), i);
 			if (ask(_("Clear"), 1)) {
@@ -1176,9 +1240,8 @@ check_counts(void) {
 			}
 		}
 	}
-	for (i = get_first_zone(); i < get_nzones(); i++) {
-		if (zone_in_use(i) == zone_count[i])
-			continue;
+	for (i = next_zone_to_check(get_first_zone()); i < get_nzones();
+	     i = next_zone_to_check(i + 1)) {
 		if (!zone_count[i]) {
 			if (bad_zone(i))
 				continue;
@@ -1201,7 +1264,8 @@ static void
 check_counts2(void) {
 	unsigned long i;
 
-	for (i = 1; i <= get_ninodes(); i++) {
+	for (i = next_inode_to_check(1); i <= get_ninodes();
+	     i = next_inode_to_check(i + 1)) {
 		if (!inode_in_use(i) && Inode2[i].i_mode && warn_mode) {
 			printf(_("Inode %lu mode not cleared."), i);
 			if (ask(_("Clear"), 1)) {
@@ -1232,9 +1296,8 @@ check_counts2(void) {
 			}
 		}
 	}
-	for (i = get_first_zone(); i < get_nzones(); i++) {
-		if (zone_in_use(i) == zone_count[i])
-			continue;
+	for (i = next_zone_to_check(get_first_zone()); i < get_nzones();
+	     i = next_zone_to_check(i + 1)) {
 		if (!zone_count[i]) {
 			if (bad_zone(i))
 				continue;
@@ -1393,17 +1456,18 @@ main(int argc, char **argv) {
 		check();
 	}
 	if (verbose) {
-		unsigned long inode, free;
+		unsigned long free;
 
-		for (inode = 1, free = 0; inode <= get_ninodes(); inode++)
-			if (!inode_in_use(inode))
-				free++;
+		free = get_ninodes() - ul_bitcount_range(inode_map,
+						1, get_ninodes() + 1);
 		printf(_("\n%6ld inodes used (%ld%%)\n"),
 		       (get_ninodes() - free),
 		       100 * (get_ninodes() - free) / get_ninodes());
-		for (inode = get_first_zone(), free = 0; inode < get_nzones(); inode++)
-			if (!zone_in_use(inode))
-				free++;
+		free = 0;
+		if (get_nzones() > (unsigned long) get_first_zone())
+			free = get_nzones() - get_first_zone()
+			       - ul_bitcount_range(zone_map,
+					1, get_nzones() - get_first_zone() + 1);
 		printf(_("%6ld zones used (%ld%%)\n"), (get_nzones() - free),
 		       100 * (get_nzones() - free) / get_nzones());
 		printf(_("\n%6d regular files\n"
@@ -38,6 +38,9 @@
 #include <string.h>
 #include <getopt.h>
 #include <zconf.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 /* We don't use our include/crc32.h, but crc32 from zlib!
  *
@@ -59,6 +62,7 @@
 
 #define XALLOC_EXIT_CODE MKFS_EX_ERROR
 #include "xalloc.h"
+#include "iszero.h"
 
 /* The kernel only supports PAD_SIZE of 0 and 512. */
 #define PAD_SIZE 512
@@ -82,6 +86,7 @@ static unsigned int opt_edition = 0;
 static int opt_errors = 0;
 static int opt_holes = 0;
 static int opt_pad = 0;
+static unsigned int opt_jobs = 0;
 static char *opt_image = NULL;
 static char *opt_name = NULL;
 
@@ -139,6 +144,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputsln(_(  " -e edition     set edition number (part of fsid)"), stdout);
 	fprintf(stdout, _(" -N endian      set cramfs endianness (%s|%s|%s), default %s\n"), "big", "little", "host", "host");
 	fputsln(_(  " -i file        insert a file image into the filesystem"), stdout);
+#ifdef HAVE_PTHREAD
+	fputsln(_(  " -j num         compress blocks by up to num threads"), stdout);
+#endif
 	fputsln(_(  " -n name        set name of cramfs filesystem"), stdout);
 	fprintf(stdout, _(" -p             pad by %d bytes for boot code\n"), PAD_SIZE);
 	fputsln(_(  " -s             sort directory entries (old option, ignored)"), stdout);
@@ -544,20 +552,167 @@ static int is_zero(unsigned char const *begin, unsigned len)
 	if (opt_holes)
 		/* Returns non-zero iff the first LEN bytes from BEGIN are
 		   all NULs. */
-		return (len-- == 0 ||
-			(begin[0] == '\0' &&
-			 (len-- == 0 ||
-			  (begin[1] == '\0' &&
-			   (len-- == 0 ||
-			    (begin[2] == '\0' &&
-			     (len-- == 0 ||
-			      (begin[3] == '\0' &&
-			       memcmp(begin, begin + 4, len) == 0))))))));
+		return ul_buffer_is_zero(begin, len);
 
 	/* Never create holes. */
 	return 0;
 }
 
+#ifdef HAVE_PTHREAD
+/*
+ * The blocks of one file are compressed by the pool threads to the
+ * separate buffers, and the main thread copies them to the image in
+ * the order. Every thread has its own z_stream, the stream is reset
+ * for every block, so the output is the same as from compress().
+ */
+struct compress_pool {
+	pthread_mutex_t	lock;
+	pthread_cond_t	work;		/* a new file or the end */
+	pthread_cond_t	done;		/* all blocks of the file compressed */
+
+	pthread_t	*threads;
+	size_t		nthreads;
+	z_stream	zs;		/* for the main thread */
+
+	const Bytef	*src;		/* the file data */
+	unsigned long	srclen;
+	unsigned long	blocks;
+	unsigned long	next;		/* the next block to compress */
+	unsigned long	ndone;		/* the number of compressed blocks */
+
+	Bytef		*buf;		/* 2 * blksize per block */
+	uLongf		*lens;		/* compressed length per block */
+	unsigned long	bufblocks;	/* allocated blocks */
+
+	unsigned int	quit : 1;
+};
+
+static struct compress_pool pool;
+
+static void compress_block(z_stream *zs, unsigned long i)
+{
+	const Bytef *src = pool.src + i * blksize;
+	uLong input = min((unsigned long) blksize, pool.srclen - i * blksize);
+	int rc;
+
+	if (is_zero(src, input)) {
+		pool.lens[i] = 0;
+		return;
+	}
+
+	zs->next_in = (Bytef *) src;
+	zs->avail_in = input;
+	zs->next_out = pool.buf + i * 2 * blksize;
+	zs->avail_out = 2 * blksize;
+
+	rc = deflate(zs, Z_FINISH);
+	pool.lens[i] = rc == Z_STREAM_END ? zs->total_out : 2 * blksize + 1;
+	deflateReset(zs);
+}
+
+/* compresses the blocks of the current file, called with locked pool */
+static void compress_blocks(z_stream *zs)
+{
+	while (pool.next < pool.blocks) {
+		unsigned long i = pool.next++;
+
+		pthread_mutex_unlock(&pool.lock);
+		compress_block(zs, i);
+		pthread_mutex_lock(&pool.lock);
+
+		if (++pool.ndone == pool.blocks)
+			pthread_cond_signal(&pool.done);
+	}
+}
+
+static void *compress_worker(void *data __attribute__((__unused__)))
+{
+	z_stream zs = { .zalloc = Z_NULL };
+
+	if (deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK)
+		return NULL;
+
+	pthread_mutex_lock(&pool.lock);
+	for (;;) {
+		while (!pool.quit && pool.next >= pool.blocks)
+			pthread_cond_wait(&pool.work, &pool.lock);
+		if (pool.quit)
+			break;
+		compress_blocks(&zs);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	deflateEnd(&zs);
+	return NULL;
+}
+
+static void start_compress_pool(size_t njobs)
+{
+	size_t i;
+
+	if (deflateInit(&pool.zs, Z_DEFAULT_COMPRESSION) != Z_OK)
+		errx(MKFS_EX_ERROR, _("cannot initialize zlib"));
+
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.work, NULL);
+	pthread_cond_init(&pool.done, NULL);
+
+	/* the main thread compresses too */
+	pool.threads = xcalloc(njobs - 1, sizeof(pthread_t));
+	for (i = 0; i < njobs - 1; i++) {
+		if (pthread_create(&pool.threads[i], NULL, compress_worker, NULL) != 0)
+			break;
+		pool.nthreads++;
+	}
+}
+
+static void stop_compress_pool(void)
+{
+	size_t i;
+
+	pthread_mutex_lock(&pool.lock);
+	pool.quit = 1;
+	pthread_cond_broadcast(&pool.work);
+	pthread_mutex_unlock(&pool.lock);
+
+	for (i = 0; i < pool.nthreads; i++)
+		pthread_join(pool.threads[i], NULL);
+
+	deflateEnd(&pool.zs);
+	free(pool.threads);
+	free(pool.buf);
+	free(pool.lens);
+	pthread_cond_destroy(&pool.done);
+	pthread_cond_destroy(&pool.work);
+	pthread_mutex_destroy(&pool.lock);
+}
+
+/* compresses @blocks blocks of @src to pool.buf and pool.lens */
+static void pool_compress(const Bytef *src, unsigned long size, unsigned long blocks)
+{
+	if (blocks > pool.bufblocks) {
+		free(pool.buf);
+		free(pool.lens);
+		pool.buf = xmalloc(blocks * 2 * blksize);
+		pool.lens = xcalloc(blocks, sizeof(uLongf));
+		pool.bufblocks = blocks;
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	pool.src = src;
+	pool.srclen = size;
+	pool.blocks = blocks;
+	pool.next = 0;
+	pool.ndone = 0;
+	pthread_cond_broadcast(&pool.work);
+
+	compress_blocks(&pool.zs);
+	while (pool.ndone < pool.blocks)
+		pthread_cond_wait(&pool.done, &pool.lock);
+	pthread_mutex_unlock(&pool.lock);
+}
+#endif /* HAVE_PTHREAD */
+
 /*
  * One 4-byte pointer per block and then the actual blocked
  * output. The first block does not need an offset pointer,
@@ -590,7 +745,31 @@ do_compress(char *base, unsigned int offset, unsigned char const *name,
 
 	total_blocks += blocks;
 
-	do {
+#ifdef HAVE_PTHREAD
+	if (pool.nthreads && blocks > 1) {
+		unsigned long i;
+
+		pool_compress(p, size, blocks);
+
+		for (i = 0; i < blocks; i++) {
+			uLongf len = pool.lens[i];
+
+			if (len > blksize*2) {
+				printf(_("AIEEE: block \"compressed\" to > "
+					 "2*blocklength (%ld)\n"),
+				       len);
+				exit(MKFS_EX_ERROR);
+			}
+			memcpy(base + curr, pool.buf + i * 2 * blksize, len);
+			curr += len;
+
+			*(uint32_t *) (base + offset) = u32_toggle_endianness(cramfs_is_big_endian, curr);
+			offset += 4;
+		}
+		size = 0;
+	}
+#endif
+	while (size) {
 		uLongf len = 2 * blksize;
 		uLongf input = size;
 		if (input > blksize)
@@ -612,7 +791,7 @@ do_compress(char *base, unsigned int offset, unsigned char const *name,
 
 		*(uint32_t *) (base + offset) = u32_toggle_endianness(cramfs_is_big_endian, curr);
 		offset += 4;
-	} while (size);
+	}
 
 	do_munmap(start, original_size, mode);
 
@@ -735,7 +914,7 @@ int main(int argc, char **argv)
 	strutils_set_exitcode(MKFS_EX_USAGE);
 
 	/* command line options */
-	while ((c = getopt(argc, argv, "hb:Ee:i:n:N:l::psVvz")) != EOF) {
+	while ((c = getopt(argc, argv, "hb:Ee:i:j:n:N:l::psVvz")) != EOF) {
 		switch (c) {
 		case 'h':
 			usage();
@@ -766,6 +945,9 @@ int main(int argc, char **argv)
 			image_length = st.st_size; /* may be padded later */
 			fslen_ub += (image_length + 3); /* 3 is for padding */
 			break;
+		case 'j':
+			opt_jobs = strtou32_or_err(optarg, _("invalid jobs argument"));
+			break;
 		case 'l':
                         lockmode = "1";
 			if (optarg) {
@@ -876,7 +1058,15 @@ int main(int argc, char **argv)
 	if (verbose)
 		printf(_("Directory data: %zd bytes\n"), offset);
 
+#ifdef HAVE_PTHREAD
+	if (opt_jobs > 1)
+		start_compress_pool(opt_jobs);
+#endif
 	offset = write_data(root_entry, rom_image, offset);
+#ifdef HAVE_PTHREAD
+	if (opt_jobs > 1)
+		stop_compress_pool();
+#endif
 
 	/* We always write a multiple of blksize bytes, so that
 	   losetup works. */
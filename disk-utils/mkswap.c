@@ -27,6 +27,9 @@
 #include <errno.h>
 #include <getopt.h>
 #include <assert.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 #ifdef HAVE_LIBSELINUX
 # include <selinux/selinux.h>
 # include <selinux/context.h>
@@ -36,6 +39,9 @@
 # include <linux/fs.h>
 # include <linux/fiemap.h>
 #endif
+#ifndef BLKZEROOUT
+# define BLKZEROOUT	_IO(0x12,127)
+#endif
 
 #include "linux_version.h"
 #include "swapheader.h"
@@ -61,6 +67,9 @@
 
 #define MIN_GOODPAGES	10
 
+/* bytes per read(2) for --check, the pages of a failed chunk are read one by one */
+#define CHECK_CHUNK	(1024 * 1024)
+
 #define SELINUX_SWAPFILE_TYPE	"swapfile_t"
 
 enum ENDIANNESS {
@@ -91,6 +100,7 @@ struct mkswap_control {
 	unsigned long long	filesz;		/* desired swap file size */
 
 	size_t			nbad_extents;
+	size_t			njobs;		/* --jobs for --check */
 
 	enum ENDIANNESS         endianness;
 
@@ -196,6 +206,9 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -c, --check               check bad blocks before creating the swap area\n"), out);
+#ifdef HAVE_PTHREAD
+	fputs(_("     --jobs <num>          check bad blocks by up to <num> threads\n"), out);
+#endif
 	fputs(_(" -f, --force               allow swap size area be larger than device\n"), out);
 	fputs(_(" -q, --quiet               suppress output and warning messages\n"), out);
 	fputs(_(" -p, --pagesize SIZE       specify page size in bytes\n"), out);
@@ -231,33 +244,136 @@ static void page_bad(struct mkswap_control *ctl, unsigned int page)
 	ctl->nbadpages++;
 }
 
+/*
+ * --check
+ *
+ * The area is read by chunks (from more threads), the pages of unreadable
+ * chunks are read one by one to find the bad pages.
+ */
+struct check_pool {
+	struct mkswap_control	*ctl;
+	unsigned long long	next;		/* the next chunk, in pages */
+	unsigned long long	chunk;		/* pages per chunk */
+
+	unsigned int		*bad;		/* bad pages, unsorted */
+	size_t			nbad;
+	size_t			maxbad;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t		lock;
+#endif
+};
+
+static inline void check_lock(struct check_pool *pool __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&pool->lock);
+#endif
+}
+
+static inline void check_unlock(struct check_pool *pool __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&pool->lock);
+#endif
+}
+
+static void check_add_bad(struct check_pool *pool, unsigned int page)
+{
+	check_lock(pool);
+	/* one more than the header limit, page_bad() reports the error */
+	if (pool->nbad <= pool->maxbad) {
+		pool->bad[pool->nbad++] = page;
+		if (pool->nbad > pool->maxbad)
+			pool->next = pool->ctl->npages;		/* stop all */
+	}
+	check_unlock(pool);
+}
+
+static void *check_worker(void *data)
+{
+	struct check_pool *pool = data;
+	struct mkswap_control *ctl = pool->ctl;
+	size_t bufsz = pool->chunk * ctl->pagesize;
+	char *buffer = xmalloc(bufsz);
+
+	do {
+		unsigned long long first, n, i;
+		off_t offset;
+
+		check_lock(pool);
+		first = pool->next;
+		n = first < ctl->npages ? min(pool->chunk, ctl->npages - first) : 0;
+		pool->next += n;
+		check_unlock(pool);
+
+		if (!n)
+			break;
+
+		offset = (off_t) first * ctl->pagesize;
+		if (pread(ctl->fd, buffer, n * ctl->pagesize, offset)
+		    == (ssize_t) (n * ctl->pagesize))
+			continue;
+
+		for (i = 0; i < n; i++) {
+			offset = (off_t) (first + i) * ctl->pagesize;
+			if (pread(ctl->fd, buffer, ctl->pagesize, offset) != ctl->pagesize)
+				check_add_bad(pool, first + i);
+		}
+	} while (1);
+
+	free(buffer);
+	return NULL;
+}
+
+static int cmp_pages(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+
+	return x < y ? -1 : x > y;
+}
+
 static void check_blocks(struct mkswap_control *ctl)
 {
-	unsigned int current_page = 0;
-	int do_seek = 1;
-	char *buffer;
+	struct check_pool pool = { .ctl = ctl };
+	size_t i;
 
 	assert(ctl);
 	assert(ctl->fd > -1);
 
-	buffer = xmalloc(ctl->pagesize);
-	while (current_page < ctl->npages) {
-		ssize_t rc;
-		off_t offset = (off_t) current_page * ctl->pagesize;
+	pool.chunk = max(CHECK_CHUNK / ctl->pagesize, 1);
+	pool.maxbad = (ctl->pagesize - 1024 - 128 * sizeof(int) - 10) / sizeof(int);
+	pool.bad = xcalloc(pool.maxbad + 1, sizeof(unsigned int));
 
-		if (do_seek && lseek(ctl->fd, offset, SEEK_SET) != offset)
-			errx(EXIT_FAILURE, _("seek failed in check_blocks"));
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init(&pool.lock, NULL);
+	if (ctl->njobs > 1) {
+		pthread_t *threads = xcalloc(ctl->njobs, sizeof(pthread_t));
+		size_t nthreads = 0;
 
-		rc = read(ctl->fd, buffer, ctl->pagesize);
-		do_seek = (rc < 0 || rc != ctl->pagesize);
-		if (do_seek)
-			page_bad(ctl, current_page);
-		current_page++;
-	}
+		for (i = 0; i < ctl->njobs; i++) {
+			if (pthread_create(&threads[nthreads], NULL, check_worker, &pool) != 0)
+				break;
+			nthreads++;
+		}
+		if (!nthreads)
+			check_worker(&pool);
+		for (i = 0; i < nthreads; i++)
+			pthread_join(threads[i], NULL);
+		free(threads);
+	} else
+#endif
+		check_worker(&pool);
+#ifdef HAVE_PTHREAD
+	pthread_mutex_destroy(&pool.lock);
+#endif
+
+	qsort(pool.bad, pool.nbad, sizeof(unsigned int), cmp_pages);
+	for (i = 0; i < pool.nbad; i++)
+		page_bad(ctl, pool.bad[i]);
+	free(pool.bad);
 
 	if (!ctl->quiet)
 		printf(P_("%lu bad page\n", "%lu bad pages\n", ctl->nbadpages), ctl->nbadpages);
-	free(buffer);
 }
 
 
@@ -428,6 +544,27 @@ static void open_device(struct mkswap_control *ctl)
 	}
 }
 
+/*
+ * Zeroes the boot bits. The block devices are zeroed by BLKZEROOUT if
+ * supported, the device does it without data transfer.
+ */
+static int zap_bootbits(struct mkswap_control *ctl)
+{
+	char buf[1024] = { '\0' };
+
+	if (S_ISBLK(ctl->devstat.st_mode)) {
+		uint64_t range[2] = { 0, sizeof(buf) };
+
+		if (ioctl(ctl->fd, BLKZEROOUT, &range) == 0)
+			return 0;
+	}
+
+	if (lseek(ctl->fd, 0, SEEK_SET) != 0)
+		errx(EXIT_FAILURE, _("unable to rewind swap-device"));
+
+	return write_all(ctl->fd, buf, sizeof(buf));
+}
+
 static void wipe_device(struct mkswap_control *ctl)
 {
 	char *type = NULL;
@@ -460,12 +597,7 @@ static void wipe_device(struct mkswap_control *ctl)
 		/*
 		 * Wipe bootbits
 		 */
-		char buf[1024] = { '\0' };
-
-		if (lseek(ctl->fd, 0, SEEK_SET) != 0)
-			errx(EXIT_FAILURE, _("unable to rewind swap-device"));
-
-		if (write_all(ctl->fd, buf, sizeof(buf)))
+		if (zap_bootbits(ctl))
 			errx(EXIT_FAILURE, _("unable to erase bootbits sectors"));
 #ifdef HAVE_LIBBLKID
 		/*
@@ -537,7 +669,8 @@ int main(int argc, char **argv)
 #endif
 	enum {
 		OPT_LOCK = CHAR_MAX + 1,
-		OPT_VERBOSE
+		OPT_VERBOSE,
+		OPT_JOBS
 	};
 	static const struct option longopts[] = {
 		{ "check",       no_argument,       NULL, 'c' },
@@ -555,6 +688,9 @@ int main(int argc, char **argv)
 		{ "help",        no_argument,       NULL, 'h' },
 		{ "lock",        optional_argument, NULL, OPT_LOCK },
 		{ "verbose",    no_argument,        NULL, OPT_VERBOSE },
+#ifdef HAVE_PTHREAD
+		{ "jobs",        required_argument, NULL, OPT_JOBS },
+#endif
 		{ NULL,          0, NULL, 0 }
 	};
 
@@ -639,6 +775,12 @@ int main(int argc, char **argv)
 		case OPT_VERBOSE:
 			ctl.verbose = 1;
 			break;
+#ifdef HAVE_PTHREAD
+		case OPT_JOBS:
+			ctl.njobs = str2unum_or_err(optarg, 10,
+					_("invalid jobs argument"), 1024);
+			break;
+#endif
 		case 'h':
 			usage();
 		default:
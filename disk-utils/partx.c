@@ -275,6 +275,37 @@ dflt:
 	return SLICES_MAX;
 }
 
+/*
+ * Reads partitions as known by kernel. The BLKPG ioctls are used only for
+ * partitions which really differ from this state, every unnecessary ioctl
+ * means uevents and udev rules processing.
+ *
+ * Returns 0 on success, <0 if the kernel state is unknown.
+ */
+static int get_kernel_parts(dev_t devno, struct sysfs_blkdev_part **parts,
+			    size_t *nparts)
+{
+	struct path_cxt *pc;
+	int n;
+
+	*parts = NULL;
+	*nparts = 0;
+	if (!devno)
+		return -EINVAL;
+
+	pc = ul_new_sysfs_path(devno, NULL, NULL);
+	if (!pc)
+		return -ENOMEM;
+
+	n = sysfs_blkdev_get_partitions(pc, parts);
+	ul_unref_path(pc);
+	if (n < 0)
+		return n;
+
+	*nparts = n;
+	return 0;
+}
+
 static int recount_range_by_pt(blkid_partlist ls, int *lower, int *upper)
 {
 	int n = 0, i, nparts = blkid_partlist_numof_partitions(ls);
@@ -311,11 +342,15 @@ static void del_parts_warnx(const char *device, int first, int last)
 static int del_parts(int fd, const char *device, dev_t devno,
 		     int lower, int upper)
 {
-	int rc = 0, i, errfirst = 0, errlast = 0;
+	int rc = 0, i, errfirst = 0, errlast = 0, known;
+	struct sysfs_blkdev_part *kparts;
+	size_t nkparts;
 
 	assert(fd >= 0);
 	assert(device);
 
+	known = get_kernel_parts(devno, &kparts, &nkparts) == 0;
+
 	/* recount range by information in /sys */
 	if (!lower)
 		lower = 1;
@@ -331,11 +366,14 @@ static int del_parts(int fd, const char *device, dev_t devno,
 	if (lower > upper) {
 		warnx(_("specified range <%d:%d> "
 			"does not make sense"), lower, upper);
+		free(kparts);
 		return -1;
 	}
 
 	for (i = lower; i <= upper; i++) {
-		if (partx_del_partition(fd, i) == 0) {
+		if (known && !sysfs_blkdev_find_partition(kparts, nkparts, i))
+			errno = ENXIO;
+		else if (partx_del_partition(fd, i) == 0) {
 			if (verbose)
 				printf(_("%s: partition #%d removed\n"), device, i);
 			continue;
@@ -361,6 +399,7 @@ static int del_parts(int fd, const char *device, dev_t devno,
 
 	if (errfirst)
 		del_parts_warnx(device, errfirst, errlast);
+	free(kparts);
 	return rc;
 }
 
@@ -460,14 +499,18 @@ static void upd_parts_warnx(const char *device, int first, int last)
 static int upd_parts(int fd, const char *device, dev_t devno,
 		     blkid_partlist ls, int lower, int upper)
 {
-	int n, nparts, rc = 0, errfirst = 0, errlast = 0, err;
+	int n, nparts, rc = 0, errfirst = 0, errlast = 0, err, known;
 	blkid_partition par;
 	uintmax_t start, size;
+	struct sysfs_blkdev_part *kparts;
+	size_t nkparts;
 
 	assert(fd >= 0);
 	assert(device);
 	assert(ls);
 
+	known = get_kernel_parts(devno, &kparts, &nkparts) == 0;
+
 	/* recount range by information in /sys, if on disk number of
 	 * partitions is greater than in /sys the use on-disk limit */
 	nparts = blkid_partlist_numof_partitions(ls);
@@ -485,10 +528,13 @@ static int upd_parts(int fd, const char *device, dev_t devno,
 	if (lower > upper) {
 		warnx(_("specified range <%d:%d> "
 			"does not make sense"), lower, upper);
+		free(kparts);
 		return -1;
 	}
 
 	for (n = lower; n <= upper; n++) {
+		struct sysfs_blkdev_part *kp;
+
 		par = blkid_partlist_get_partition_by_partno(ls, n);
 		if (!par) {
 			if (verbose)
@@ -505,7 +551,26 @@ static int upd_parts(int fd, const char *device, dev_t devno,
 			 */
 			size = min(size, (uintmax_t) 2);
 
-		err = partx_del_partition(fd, n);
+		kp = known ? sysfs_blkdev_find_partition(kparts, nkparts, n) : NULL;
+		if (kp && kp->start == start && kp->size == size) {
+			if (verbose)
+				printf(_("%s: partition #%d unchanged\n"), device, n);
+			continue;
+		}
+
+		/* only size changed, one ioctl is enough */
+		if (kp && kp->start == start
+		    && partx_resize_partition(fd, n, start, size) == 0) {
+			if (verbose)
+				printf(_("%s: partition #%d resized\n"), device, n);
+			continue;
+		}
+
+		if (known && !kp)
+			err = 0;	/* good, it already doesn't exist */
+		else
+			err = partx_del_partition(fd, n);
+
 		if (err == -1 && errno == ENXIO)
 			err = 0; /* good, it already doesn't exist */
 		if (err == -1 && errno == EBUSY)
@@ -540,6 +605,7 @@ static int upd_parts(int fd, const char *device, dev_t devno,
 
 	if (errfirst)
 		upd_parts_warnx(device, errfirst, errlast);
+	free(kparts);
 	return rc;
 }
 
@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <getopt.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <assert.h>
 #include <fcntl.h>
 #include <libsmartcols.h>
@@ -103,6 +104,7 @@ struct sfdisk {
 	const char	*backup_file;	/* -O <path> */
 	const char	*move_typescript; /* --movedata <typescript> */
 	char		*prompt;
+	size_t		max_jobs;	/* --jobs <num>, 0 means unlimited */
 
 	struct fdisk_context	*cxt;		/* libfdisk context */
 	struct fdisk_partition  *orig_pa;	/* -N <partno> before the change */
@@ -120,6 +122,7 @@ struct sfdisk {
 		     movedata: 1,	/* move data after resize */
 		     movefsync: 1,	/* use fsync() after each write() */
 		     notell : 1,	/* don't tell kernel aout new PT */
+		     devices : 1,	/* all arguments are devices */
 		     noact  : 1;	/* do not write to device */
 };
 
@@ -231,6 +234,8 @@ static void sfdisk_init(struct sfdisk *sf)
 	if (!sf->cxt)
 		err(EXIT_FAILURE, _("failed to allocate libfdisk context"));
 	fdisk_set_ask(sf->cxt, ask_callback, (void *) sf);
+	/* read-only images (--dump, --list, ...) are read by mmap() */
+	fdisk_enable_mmap(sf->cxt, 1);
 
 	if (sf->wipemode != WIPEMODE_ALWAYS)
 		fdisk_enable_bootbits_protection(sf->cxt, 1);
@@ -1064,13 +1069,12 @@ static int command_dump(struct sfdisk *sf, int argc, char **argv)
 	if (!dp)
 		err(EXIT_FAILURE, _("failed to allocate dump struct"));
 
-	rc = fdisk_script_read_context(dp, NULL);
-	if (rc)
-		errx(EXIT_FAILURE, _("%s: failed to dump partition table"), devname);
-
+	/* write the partitions as they are read from the label */
 	if (sf->json)
 		fdisk_script_enable_json(dp, 1);
-	fdisk_script_write_file(dp, stdout);
+	rc = fdisk_script_write_context(dp, NULL, stdout);
+	if (rc)
+		errx(EXIT_FAILURE, _("%s: failed to dump partition table"), devname);
 
 	fdisk_unref_script(dp);
 	fdisk_deassign_device(sf->cxt, 1);		/* no-sync() */
@@ -2031,6 +2035,165 @@ static int command_fdisk(struct sfdisk *sf, int argc, char **argv)
 	return rc;
 }
 
+/*
+ * sfdisk --devices <dev> [<dev> ...]
+ *
+ * Applies the script from stdin to all the devices. Every device is
+ * partitioned (and re-read by kernel) by a separate child process and
+ * the output is printed per device when the child is done.
+ */
+struct sfdisk_job {
+	const char	*devname;
+	pid_t		pid;
+	FILE		*out;		/* child's stdout */
+	int		status;
+};
+
+static void print_job_output(struct sfdisk_job *job)
+{
+	char buf[BUFSIZ];
+	size_t sz;
+
+	if (!job->out)
+		return;
+	rewind(job->out);
+	while ((sz = fread(buf, 1, sizeof(buf), job->out)) > 0)
+		fwrite_all(buf, 1, sz, stdout);
+	fclose(job->out);
+	job->out = NULL;
+	fflush(stdout);
+}
+
+static void __attribute__((__noreturn__))
+run_job(struct sfdisk *sf, struct sfdisk_job *job, const char *script, size_t scriptsz)
+{
+	FILE *in;
+	int rc;
+
+	/* private copy of the script on stdin */
+	in = tmpfile();
+	if (!in || fwrite_all(script, 1, scriptsz, in) != 0 || fflush(in) != 0
+	    || lseek(fileno(in), 0, SEEK_SET) != 0
+	    || dup2(fileno(in), STDIN_FILENO) < 0)
+		err(EXIT_FAILURE, _("%s: failed to setup script input"), job->devname);
+	fclose(in);
+
+	if (dup2(fileno(job->out), STDOUT_FILENO) < 0)
+		err(EXIT_FAILURE, _("%s: failed to setup output"), job->devname);
+	fclose(job->out);
+
+	rc = command_fdisk(sf, 1, (char **) &job->devname);
+	sfdisk_deinit(sf);
+	exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+static struct sfdisk_job *wait_job(struct sfdisk_job *jobs, size_t njobs)
+{
+	pid_t pid;
+	int status;
+	size_t i;
+
+	do {
+		pid = waitpid(-1, &status, 0);
+	} while (pid < 0 && errno == EINTR);
+
+	if (pid < 0)
+		err(EXIT_FAILURE, _("waitpid failed"));
+
+	for (i = 0; i < njobs; i++) {
+		if (jobs[i].pid != pid)
+			continue;
+		jobs[i].pid = 0;
+		jobs[i].status = status;
+		return &jobs[i];
+	}
+	return NULL;
+}
+
+static int command_fdisk_devices(struct sfdisk *sf, int argc, char **argv)
+{
+	struct sfdisk_job *jobs;
+	char *script = NULL;
+	ssize_t scriptsz;
+	size_t i, running = 0, failed = 0;
+
+	if (!argc)
+		errx(EXIT_FAILURE, _("no disk device specified"));
+	if (sf->interactive)
+		errx(EXIT_FAILURE, _("--devices requires a script on standard input"));
+	if (sf->backup_file)
+		errx(EXIT_FAILURE, _("--backup-file cannot be used with --devices"));
+	if (sf->move_typescript)
+		errx(EXIT_FAILURE, _("--move-data=<typescript> cannot be used with --devices"));
+
+	scriptsz = read_all_alloc(STDIN_FILENO, &script);
+	if (scriptsz < 0)
+		err(EXIT_FAILURE, _("cannot read script"));
+
+	jobs = xcalloc(argc, sizeof(*jobs));
+
+	for (i = 0; i < (size_t) argc; i++) {
+		struct sfdisk_job *job = &jobs[i];
+
+		if (sf->max_jobs && running >= sf->max_jobs) {
+			struct sfdisk_job *done = wait_job(jobs, i);
+			if (done) {
+				running--;
+				print_job_output(done);
+			}
+		}
+
+		job->devname = argv[i];
+		job->out = tmpfile();
+		if (!job->out)
+			err(EXIT_FAILURE, _("cannot create temporary file"));
+
+		fflush(stdout);
+		fflush(stderr);
+
+		job->pid = fork();
+		switch (job->pid) {
+		case -1:
+			err(EXIT_FAILURE, _("fork failed"));
+		case 0:
+			run_job(sf, job, script, scriptsz);
+		default:
+			running++;
+			break;
+		}
+	}
+
+	while (running) {
+		struct sfdisk_job *done = wait_job(jobs, argc);
+		if (done) {
+			running--;
+			print_job_output(done);
+		}
+	}
+
+	for (i = 0; i < (size_t) argc; i++) {
+		struct sfdisk_job *job = &jobs[i];
+
+		if (WIFEXITED(job->status) && WEXITSTATUS(job->status) == 0)
+			continue;
+		if (WIFSIGNALED(job->status))
+			warnx(_("%s: partitioning terminated by signal %d"),
+					job->devname, WTERMSIG(job->status));
+		else
+			warnx(_("%s: partitioning failed"), job->devname);
+		failed++;
+	}
+
+	if (!sf->quiet)
+		printf(P_("\n%zu of %zu device partitioned successfully.\n",
+			  "\n%zu of %zu devices partitioned successfully.\n", argc),
+			argc - failed, (size_t) argc);
+
+	free(jobs);
+	free(script);
+	return failed ? -EINVAL : 0;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -2079,6 +2242,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_("     --move-data[=<typescript>] move partition data after relocation (requires -N)\n"), out);
 	fputs(_("     --move-use-fsync      use fsync after each write when move data\n"), out);
 	fputs(_(" -f, --force               disable all consistency checking\n"), out);
+	fputs(_("     --devices             apply script to all the specified devices in parallel\n"), out);
+	fputs(_("     --jobs <num>          maximal number of devices partitioned at once\n"), out);
 
 	fprintf(out,
 	      _("     --color[=<when>]      colorize output (%s, %s or %s)\n"), "auto", "always", "never");
@@ -2145,6 +2310,8 @@ int main(int argc, char *argv[])
 		OPT_NOTELL,
 		OPT_RELOCATE,
 		OPT_LOCK,
+		OPT_DEVICES,
+		OPT_JOBS,
 	};
 
 	static const struct option longopts[] = {
@@ -2157,6 +2324,8 @@ int main(int argc, char *argv[])
 		{ "color",   optional_argument, NULL, OPT_COLOR },
 		{ "lock",    optional_argument, NULL, OPT_LOCK },
 		{ "delete",  no_argument,	NULL, OPT_DELETE },
+		{ "devices", no_argument,	NULL, OPT_DEVICES },
+		{ "jobs",    required_argument,	NULL, OPT_JOBS },
 		{ "dump",    no_argument,	NULL, 'd' },
 		{ "help",    no_argument,       NULL, 'h' },
 		{ "force",   no_argument,       NULL, 'f' },
@@ -2365,6 +2534,12 @@ int main(int argc, char *argv[])
 		case OPT_RELOCATE:
 			sf->act = ACT_RELOCATE;
 			break;
+		case OPT_DEVICES:
+			sf->devices = 1;
+			break;
+		case OPT_JOBS:
+			sf->max_jobs = strtou32_or_err(optarg, _("failed to parse number of jobs"));
+			break;
 		case OPT_LOCK:
 			sf->lockmode = "1";
 			if (optarg) {
@@ -2394,6 +2569,8 @@ int main(int argc, char *argv[])
 
 	if (sf->movedata && !(sf->act == ACT_FDISK && sf->partno >= 0))
 		errx(EXIT_FAILURE, _("--movedata requires -N"));
+	if (sf->devices && sf->act != ACT_FDISK)
+		errx(EXIT_FAILURE, _("--devices cannot be used with a command"));
 
 	switch (sf->act) {
 	case ACT_ACTIVATE:
@@ -2421,7 +2598,10 @@ int main(int argc, char *argv[])
 		break;
 
 	case ACT_FDISK:
-		rc = command_fdisk(sf, argc - optind, argv + optind);
+		if (sf->devices)
+			rc = command_fdisk_devices(sf, argc - optind, argv + optind);
+		else
+			rc = command_fdisk(sf, argc - optind, argv + optind);
 		break;
 
 	case ACT_DUMP:
@@ -8,6 +8,7 @@
 #define BITOPS_H
 
 #include <stdint.h>
+#include <string.h>
 #include <sys/param.h>
 
 #if defined(HAVE_BYTESWAP_H)
@@ -153,5 +154,48 @@
 # define isclr(a,i)	(((a)[(i)/NBBY] & (1<<((i)%NBBY))) == 0)
 #endif
 
+/*
+ * Clears bits from @start to @end (exclusive) in the bitmap @map.
+ */
+static inline void ul_clrbit_range(char *map, size_t start, size_t end)
+{
+	size_t n;
+
+	for (; start < end && start % NBBY; start++)
+		clrbit(map, start);
+	if (start < end && (n = (end - start) / NBBY)) {
+		memset(map + start / NBBY, 0, n);
+		start += n * NBBY;
+	}
+	for (; start < end; start++)
+		clrbit(map, start);
+}
+
+/*
+ * Returns number of set bits from @start to @end (exclusive) in the bitmap @map.
+ */
+static inline size_t ul_bitcount_range(const char *map, size_t start, size_t end)
+{
+	const unsigned char *p;
+	size_t count = 0;
+
+	for (; start < end && start % NBBY; start++)
+		count += isset(map, start) ? 1 : 0;
+
+	p = (const unsigned char *) map + start / NBBY;
+	for (; start + 64 <= end; start += 64, p += sizeof(uint64_t)) {
+		uint64_t w;
+
+		memcpy(&w, p, sizeof(w));
+		count += __builtin_popcountll(w);
+	}
+	for (; start + NBBY <= end; start += NBBY, p++)
+		count += __builtin_popcount(*p);
+
+	for (; start < end; start++)
+		count += isset(map, start) ? 1 : 0;
+	return count;
+}
+
 #endif /* BITOPS_H */
 
@@ -23,7 +23,18 @@ struct ul_buffer {
 
 #define UL_INIT_BUFFER { .begin = NULL }
 
+#define UL_BUFFER_POOLSZ	4
+
+/* released buffers kept for reuse, see ul_buffer_pool_get() */
+struct ul_buffer_pool {
+	struct ul_buffer bufs[UL_BUFFER_POOLSZ];
+	size_t nbufs;
+};
+
 void ul_buffer_reset_data(struct ul_buffer *buf);
+void ul_buffer_pool_get(struct ul_buffer_pool *pool, struct ul_buffer *buf);
+void ul_buffer_pool_put(struct ul_buffer_pool *pool, struct ul_buffer *buf);
+void ul_buffer_pool_free(struct ul_buffer_pool *pool);
 void ul_buffer_free_data(struct ul_buffer *buf);
 int ul_buffer_is_empty(struct ul_buffer *buf);
 void ul_buffer_set_chunksize(struct ul_buffer *buf, size_t sz);
@@ -16,6 +16,13 @@
 #include "strutils.h"
 
 extern char *canonicalize_path(const char *path);
+
+struct canon_cache;
+extern struct canon_cache *new_canon_cache(void);
+extern void free_canon_cache(struct canon_cache *cc);
+extern void canonicalize_cache_reset(struct canon_cache *cc);
+extern char *canonicalize_path_cached(struct canon_cache *cc, const char *path);
+
 extern char *canonicalize_path_restricted(const char *path);
 extern char *canonicalize_dm_name(const char *ptname);
 extern char *__canonicalize_dm_name(const char *prefix, const char *ptname);
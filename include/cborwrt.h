@@ -0,0 +1,51 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ */
+#ifndef UTIL_LINUX_CBORWRT_H
+#define UTIL_LINUX_CBORWRT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* RFC 8949 major types */
+enum {
+	UL_CBOR_UINT = 0,
+	UL_CBOR_NEGINT,
+	UL_CBOR_BYTES,
+	UL_CBOR_TEXT,
+	UL_CBOR_ARRAY,
+	UL_CBOR_MAP,
+	UL_CBOR_TAG,
+	UL_CBOR_SIMPLE
+};
+
+struct ul_cborwrt {
+	FILE *out;
+};
+
+void ul_cborwrt_init(struct ul_cborwrt *fmt, FILE *out);
+void ul_cborwrt_head(struct ul_cborwrt *fmt, int type, uint64_t val);
+
+/* definite length containers, @n is number of items (pairs for maps) */
+#define ul_cborwrt_array_open(_f, _n)	ul_cborwrt_head(_f, UL_CBOR_ARRAY, _n)
+#define ul_cborwrt_map_open(_f, _n)	ul_cborwrt_head(_f, UL_CBOR_MAP, _n)
+
+/* indefinite length containers, terminated by ul_cborwrt_break() */
+void ul_cborwrt_open_indef(struct ul_cborwrt *fmt, int type);
+void ul_cborwrt_break(struct ul_cborwrt *fmt);
+
+#define ul_cborwrt_array_open_indef(_f)	ul_cborwrt_open_indef(_f, UL_CBOR_ARRAY)
+
+void ul_cborwrt_text(struct ul_cborwrt *fmt, const char *data, size_t size);
+void ul_cborwrt_value_s(struct ul_cborwrt *fmt, const char *data);
+void ul_cborwrt_value_s_sized(struct ul_cborwrt *fmt,
+			      const char *data, size_t size);
+void ul_cborwrt_value_u64(struct ul_cborwrt *fmt, uint64_t data);
+void ul_cborwrt_value_i64(struct ul_cborwrt *fmt, int64_t data);
+void ul_cborwrt_value_double(struct ul_cborwrt *fmt, double data);
+void ul_cborwrt_value_boolean(struct ul_cborwrt *fmt, int data);
+void ul_cborwrt_value_null(struct ul_cborwrt *fmt);
+void ul_cborwrt_value_number(struct ul_cborwrt *fmt, const char *data);
+
+#endif /* UTIL_LINUX_CBORWRT_H */
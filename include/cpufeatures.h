@@ -0,0 +1,41 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * Runtime detection of CPU extensions used by lib/ hash functions.
+ */
+#ifndef UTIL_LINUX_CPUFEATURES_H
+#define UTIL_LINUX_CPUFEATURES_H
+
+#if defined(__x86_64__) && defined(__GNUC__) && defined(__has_include)
+# if __has_include(<cpuid.h>) && __has_include(<immintrin.h>)
+#  include <cpuid.h>
+#  include <immintrin.h>
+#  define HAVE_X86_SHA_NI	1
+# endif
+#endif
+
+#ifdef HAVE_X86_SHA_NI
+/*
+ * Returns 1 if SHA (and SSSE3 and SSE4.1 used together with SHA) instructions
+ * are supported. The result is cached in the caller's translation unit.
+ */
+static inline int ul_cpu_has_sha_ni(void)
+{
+	static int has_sha = -1;
+
+	if (has_sha < 0) {
+		unsigned int eax, ebx, ecx, edx;
+
+		has_sha = 0;
+		if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)
+		    && (ecx & bit_SSSE3) && (ecx & bit_SSE4_1)
+		    && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)
+		    && (ebx & bit_SHA))
+			has_sha = 1;
+	}
+	return has_sha;
+}
+#endif /* HAVE_X86_SHA_NI */
+
+#endif /* UTIL_LINUX_CPUFEATURES_H */
@@ -92,6 +92,15 @@ extern int get_max_number_of_cpus(void);
 extern cpu_set_t *cpuset_alloc(int ncpus, size_t *setsize, size_t *nbits);
 extern void cpuset_free(cpu_set_t *set);
 
+extern int cpuset_next_set(const cpu_set_t *set, size_t setsize, int cpu);
+extern int cpuset_next_clear(const cpu_set_t *set, size_t setsize, int cpu);
+extern void cpuset_set_range(cpu_set_t *set, size_t setsize, size_t first, size_t last);
+
+/* iterates over all CPUs in the set */
+#define cpuset_foreach(cpu, set, setsize) \
+	for ((cpu) = cpuset_next_set(set, setsize, 0); (cpu) >= 0; \
+	     (cpu) = cpuset_next_set(set, setsize, (cpu) + 1))
+
 extern char *cpulist_create(char *str, size_t len, cpu_set_t *set, size_t setsize);
 extern int cpulist_parse(const char *str, cpu_set_t *set, size_t setsize, int fail);
 
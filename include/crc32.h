@@ -11,6 +11,7 @@
 extern uint32_t ul_crc32(uint32_t seed, const unsigned char *buf, size_t len);
 extern uint32_t ul_crc32_exclude_offset(uint32_t seed, const unsigned char *buf, size_t len,
 		                              size_t exclude_off, size_t exclude_len);
+extern uint32_t ul_crc32_zeros(uint32_t crc, size_t len);
 
 #endif
 
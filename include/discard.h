@@ -0,0 +1,51 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ */
+#ifndef UTIL_LINUX_DISCARD_H
+#define UTIL_LINUX_DISCARD_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifndef BLKDISCARD
+# define BLKDISCARD	_IO(0x12,119)
+#endif
+
+#ifndef BLKSECDISCARD
+# define BLKSECDISCARD	_IO(0x12,125)
+#endif
+
+#ifndef BLKZEROOUT
+# define BLKZEROOUT	_IO(0x12,127)
+#endif
+
+struct ul_discard {
+	int		fd;
+	unsigned long	request;	/* BLKDISCARD, BLKSECDISCARD or BLKZEROOUT, or
+					   a zone ioctl (BLKRESETZONE, ...) in sectors */
+
+	uint64_t	start;		/* the first byte of the area */
+	uint64_t	end;		/* the end of the area (exclusive) */
+	uint64_t	step;		/* bytes per ioctl, zero for the default */
+	uint64_t	granularity;	/* the default step is multiple of this */
+	uint64_t	max_bytes;	/* the device limit for one request */
+	size_t		njobs;		/* number of threads, 0 or 1 for sequential */
+
+	/* called after every range with the number of done bytes; never
+	 * called from more threads at the same time */
+	void		(*progress)(struct ul_discard *dc, uint64_t done);
+	void		*data;
+
+	/* results */
+	uint64_t	done;		/* number of the discarded bytes */
+	uint64_t	failed;		/* the start of the failed range */
+	uint64_t	usec;		/* duration of the whole operation */
+};
+
+extern int ul_discard_init(struct ul_discard *dc, int fd, unsigned long request,
+			   uint64_t start, uint64_t end);
+extern int ul_discard_range(struct ul_discard *dc);
+extern uint64_t ul_discard_get_throughput(const struct ul_discard *dc);
+
+#endif /* UTIL_LINUX_DISCARD_H */
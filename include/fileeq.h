@@ -9,15 +9,24 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <sys/types.h>
 
 #if defined(__linux__) && defined(HAVE_LINUX_IF_ALG_H)
 # define USE_FILEEQ_CRYPTOAPI 1
 #endif
 
+#if defined(__linux__) && defined(HAVE_LINUX_FIEMAP_H)
+# define USE_FILEEQ_FIEMAP 1
+#endif
+
 /* Number of bytes from the beginning of the file we always
  * compare by memcmp() */
 #define UL_FILEEQ_INTROSIZ	32
 
+/* Default size of the area requested by POSIX_FADV_WILLNEED ahead of
+ * the current read offset; see ul_fileeq_set_readahead() */
+#define UL_FILEEQ_READAHEAD	(2 * 1024 * 1024)
+
 struct ul_fileeq_data {
 	unsigned char intro[UL_FILEEQ_INTROSIZ];
 	unsigned char *blocks;
@@ -25,6 +34,7 @@ struct ul_fileeq_data {
 	size_t maxblocks;
 	int fd;
 	const char *name;
+	off_t ra_end;		/* end of the already requested readahead */
 	bool is_eof;
 };
 
@@ -33,18 +43,27 @@ struct ul_fileeq {
 	int fd_cip;	/* Cipher handler */
 
 	size_t readsiz;
+	size_t readahead;	/* 0 to disable */
 	uint64_t filesiz;
 	uint64_t blocksmax;
 	const struct ul_fileeq_method *method;
 
-	/* UL_FILEEQ_MEMCMP buffers */
+	/* UL_FILEEQ_MEMCMP and XXH3 buffers */
 	unsigned char *buf_a;
 	unsigned char *buf_b;
 	unsigned char *buf_last;
+
+	unsigned int verify :1;	/* confirm digests match by memcmp() */
+	unsigned int extents :1; /* files with the same extents are equal */
 };
 
 extern int ul_fileeq_init(struct ul_fileeq *eq, const char *method);
 extern void ul_fileeq_deinit(struct ul_fileeq *eq);
+extern void ul_fileeq_set_verify(struct ul_fileeq *eq, bool enable);
+extern void ul_fileeq_set_readahead(struct ul_fileeq *eq, size_t bytes);
+extern void ul_fileeq_set_extents(struct ul_fileeq *eq, bool enable);
+extern int ul_fileeq_same_extents(int fa, int fb, bool sync);
+extern int ul_fileeq_prefetch(struct ul_fileeq *eq, const char *name);
 
 
 extern int ul_fileeq_data_associated(struct ul_fileeq_data *data);
@@ -59,4 +78,14 @@ extern size_t ul_fileeq_set_size(struct ul_fileeq *eq, uint64_t filesiz,
 extern int ul_fileeq(struct ul_fileeq *eq,
               struct ul_fileeq_data *a, struct ul_fileeq_data *b);
 
+extern size_t ul_fileeq_get_digsiz(struct ul_fileeq *eq);
+extern ssize_t ul_fileeq_data_get_digests(struct ul_fileeq *eq,
+				struct ul_fileeq_data *data,
+				const unsigned char **digests);
+extern int ul_fileeq_data_set_digests(struct ul_fileeq *eq,
+				struct ul_fileeq_data *data,
+				const unsigned char *intro,
+				const unsigned char *digests, size_t ndigests,
+				bool eof);
+
 #endif /* UTIL_LINUX_FILEEQ */
@@ -63,6 +63,7 @@ static inline int is_same_inode(const int fd, const struct stat *st)
 
 extern int dup_fd_cloexec(int oldfd, int lowfd);
 extern unsigned int get_fd_tabsize(void);
+extern int ul_raise_fd_limit(size_t nfds);
 
 extern int ul_mkdir_p(const char *path, mode_t mode);
 extern char *stripoff_last_component(char *path);
@@ -13,16 +13,25 @@
 struct identry {
 	unsigned long int	id;
 	char			*name;
-	struct identry		*next;
+	int			width;	/* name width */
+	struct identry		*next;	/* all entries */
+	struct identry		*hnext;	/* the same hash bucket */
 };
 
 struct idcache {
-	struct identry	*ent;	/* first entry */
-	int		width;	/* name width */
+	struct identry	*ent;		/* first entry */
+	int		width;		/* width of the added names */
+
+	struct identry	**buckets;
+	size_t		nbuckets;	/* power of 2 */
+	size_t		nents;
+	size_t		nmisses;	/* names resolved by NSS */
+	unsigned int	prefetched : 1;	/* the whole database read */
 };
 
 
 extern struct idcache *new_idcache(void);
+extern struct identry *add_id(struct idcache *ic, const char *name, unsigned long int id);
 extern void add_gid(struct idcache *cache, unsigned long int id);
 extern void add_uid(struct idcache *cache, unsigned long int id);
 
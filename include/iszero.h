@@ -0,0 +1,12 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ */
+#ifndef UTIL_LINUX_ISZERO_H
+#define UTIL_LINUX_ISZERO_H
+
+#include <stddef.h>
+
+extern int ul_buffer_is_zero(const void *buf, size_t bufsz);
+
+#endif /* UTIL_LINUX_ISZERO_H */
@@ -15,10 +15,12 @@ struct ul_jsonwrt {
 	FILE *out;
 	int indent;
 
-	unsigned int after_close :1;
+	unsigned int after_close :1,
+		     compact :1;	/* one line output */
 };
 
 void ul_jsonwrt_init(struct ul_jsonwrt *fmt, FILE *out, int indent);
+void ul_jsonwrt_set_compact(struct ul_jsonwrt *fmt, int enable);
 int ul_jsonwrt_is_ready(struct ul_jsonwrt *fmt);
 void ul_jsonwrt_indent(struct ul_jsonwrt *fmt);
 void ul_jsonwrt_open(struct ul_jsonwrt *fmt, const char *name, int type);
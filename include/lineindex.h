@@ -0,0 +1,27 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ */
+#ifndef UTIL_LINUX_LINEINDEX_H
+#define UTIL_LINUX_LINEINDEX_H
+
+#include <sys/types.h>
+
+/* a checkpoint for every UL_LINEIDX_STEP lines */
+#define UL_LINEIDX_STEP		64
+
+struct ul_lineidx {
+	int		fd;
+	off_t		*offsets;	/* the start of the line N * UL_LINEIDX_STEP */
+	size_t		noffsets;
+	size_t		size;		/* allocated offsets */
+
+	off_t		scanned;	/* the file is scanned up to here ... */
+	size_t		nlines;		/* ... and it contains nlines newlines */
+};
+
+extern void ul_init_lineidx(struct ul_lineidx *li, int fd);
+extern void ul_free_lineidx(struct ul_lineidx *li);
+extern int ul_lineidx_seek(struct ul_lineidx *li, size_t *line, off_t *offset);
+
+#endif /* UTIL_LINUX_LINEINDEX_H */
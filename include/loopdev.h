@@ -122,6 +122,7 @@ struct loopdev_cxt {
 	unsigned int	info_failed:1;	/* LOOP_GET_STATUS ioctl failed */
 	unsigned int    control_ok:1;	/* /dev/loop-control success */
 	unsigned int	is_lost:1;	/* device in /sys, but missing in /dev */
+	unsigned int	autotune:1;	/* set direct I/O and block size by setup */
 
 	struct path_cxt		*sysfs; /* pointer to /sys/dev/block/<maj:min>/ */
 	struct loop_config	config;	/* for GET/SET ioctl */
@@ -159,6 +160,7 @@ extern int loopdev_is_used(const char *device, const char *filename,
 extern char *loopdev_find_by_backing_file(const char *filename,
 				uint64_t offset, uint64_t sizelimit, int flags);
 extern int loopcxt_find_unused(struct loopdev_cxt *lc);
+extern int loopdev_find_unused_many(int *nums, size_t n);
 extern int loopdev_delete(const char *device);
 extern int loopdev_count_by_backing_file(const char *filename, char **loopdev);
 
@@ -196,6 +198,7 @@ int loopcxt_set_offset(struct loopdev_cxt *lc, uint64_t offset);
 int loopcxt_set_sizelimit(struct loopdev_cxt *lc, uint64_t sizelimit);
 int loopcxt_set_blocksize(struct loopdev_cxt *lc, uint64_t blocksize);
 int loopcxt_set_flags(struct loopdev_cxt *lc, uint32_t flags);
+int loopcxt_set_autotune(struct loopdev_cxt *lc, int enable);
 int loopcxt_set_backing_file(struct loopdev_cxt *lc, const char *filename);
 int loopcxt_set_refname(struct loopdev_cxt *lc, const char *refname);
 
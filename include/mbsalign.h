@@ -36,6 +36,12 @@ enum {
 #endif
 };
 
+/* printable ASCII char, one cell on terminal in all locales */
+static inline int is_print_ascii(char c)
+{
+	return (unsigned char) c >= 0x20 && (unsigned char) c < 0x7f;
+}
+
 extern size_t mbs_truncate(char *str, size_t *width);
 
 extern size_t mbsalign (const char *src, char *dest,
@@ -48,6 +54,7 @@ extern size_t mbsalign_with_padding (const char *src, char *dest, size_t dest_si
 
 extern size_t mbs_safe_nwidth(const char *buf, size_t bufsz, size_t *sz);
 extern size_t mbs_safe_width(const char *s);
+extern int mbs_is_safe_ascii(const char *s, size_t *width);
 
 extern size_t mbs_nwidth(const char *buf, size_t bufsz);
 extern size_t mbs_width(const char *s);
@@ -25,6 +25,16 @@ struct path_cxt {
 	void	*dialect;
 	void	(*free_dialect)(struct path_cxt *);
 	int	(*redirect_on_enoent)(struct path_cxt *, const char *, int *);
+
+	char	*attrs_buf;		/* for ul_path_read_attrs() */
+	size_t	attrs_bufsz;
+};
+
+/* ul_path_read_attrs() item */
+struct ul_path_attr {
+	const char	*name;		/* file name */
+	char		*value;		/* content without trailing newline or NULL */
+	size_t		len;		/* length of the value */
 };
 
 struct path_cxt *ul_new_path(const char *dir, ...)
@@ -93,6 +103,9 @@ int ul_path_read_buffer(struct path_cxt *pc, char *buf, size_t bufsz, const char
 int ul_path_readf_buffer(struct path_cxt *pc, char *buf, size_t bufsz, const char *path, ...)
 				__attribute__ ((__format__ (__printf__, 4, 5)));
 
+int ul_path_read_attrs(struct path_cxt *pc, const char *dir,
+		       struct ul_path_attr *attrs, size_t nattrs, uint64_t *present);
+
 int ul_path_scanf(struct path_cxt *pc, const char *path, const char *fmt, ...)
 				__attribute__ ((__format__ (__scanf__, 3, 4)));
 int ul_path_scanff(struct path_cxt *pc, const char *path, va_list ap, const char *fmt, ...)
@@ -61,8 +61,23 @@ extern int procfs_dirent_match_uid(DIR *procfs, struct dirent *d, uid_t uid);
 extern int procfs_dirent_get_name(DIR *procfs, struct dirent *d, char *buf, size_t bufsz);
 extern int procfs_dirent_match_name(DIR *procfs, struct dirent *d, const char *name);
 
+struct procfs_iter;
+
+extern struct procfs_iter *procfs_new_iter(struct path_cxt *pc);
+extern void procfs_free_iter(struct procfs_iter *it);
+extern int procfs_iter_get_fd(struct procfs_iter *it);
+extern void procfs_iter_set_uid(struct procfs_iter *it, uid_t uid);
+extern int procfs_iter_set_name(struct procfs_iter *it, const char *name);
+extern int procfs_iter_set_cgroup(struct procfs_iter *it, const char *path);
+extern int procfs_iter_set_shard(struct procfs_iter *it, unsigned int shard, unsigned int nshards);
+extern int procfs_iter_next(struct procfs_iter *it, pid_t *pid);
+
 extern int fd_is_procfs(int fd);
 extern char *pid_get_cmdname(pid_t pid);
 extern char *pid_get_cmdline(pid_t pid);
 
+extern int cgroup_get_tids(const char *path, pid_t **tids, size_t *ntids);
+extern int cgroup_foreach_tid(const char *path, int (*fn)(pid_t tid, void *data),
+			      void *data);
+
 #endif /* UTIL_LINUX_PROCFS_H */
@@ -28,4 +28,8 @@ void ul_SHA1Update(UL_SHA1_CTX *context, const unsigned char *data, uint32_t len
 void ul_SHA1Final(unsigned char digest[UL_SHA1LENGTH], UL_SHA1_CTX *context);
 void ul_SHA1(char *hash_out, const char *str, unsigned len);
 
+#ifdef TEST_PROGRAM_SHA1
+extern int ul_sha1_generic_only;	/* don't use the CPU extensions */
+#endif
+
 #endif /* UTIL_LINUX_SHA1_H */
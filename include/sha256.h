@@ -11,4 +11,8 @@
 
 extern void ul_SHA256(unsigned char hash_out[UL_SHA256LENGTH], const unsigned char *str, size_t len);
 
+#ifdef TEST_PROGRAM_SHA256
+extern int ul_sha256_generic_only;	/* don't use the CPU extensions */
+#endif
+
 #endif /* UTIL_LINUX_SHA256_H */
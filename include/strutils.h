@@ -29,6 +29,9 @@ extern int ul_strtos32(const char *str, int32_t *num, int base);
 extern int ul_strtou32(const char *str, uint32_t *num, int base);
 extern int ul_strtold(const char *str, long double *num);
 
+extern const char *ul_scan_u64(const char *p, const char *end, uint64_t *num);
+extern const char *ul_scan_x64(const char *p, const char *end, uint64_t *num);
+
 extern int64_t str2num_or_err(const char *str, int base, const char *errmesg, int64_t low, int64_t up);
 extern uint64_t str2unum_or_err(const char *str, int base, const char *errmesg, uint64_t up);
 
@@ -228,6 +231,7 @@ extern int string_to_bitmask(const char *list,
 extern int parse_range(const char *str, int *lower, int *upper, int def);
 
 extern int streq_paths(const char *a, const char *b);
+extern size_t ul_hash_path(const char *p);
 
 /*
  * Match string beginning.
@@ -67,6 +67,13 @@ struct sysfs_blkdev {
 			hctl_error : 1 ;
 };
 
+/* partition as known by kernel, see sysfs_blkdev_get_partitions() */
+struct sysfs_blkdev_part {
+	int		partno;
+	uint64_t	start;		/* 512-byte sectors */
+	uint64_t	size;		/* 512-byte sectors */
+};
+
 void ul_sysfs_init_debug(void);
 
 struct path_cxt *ul_new_sysfs_path(dev_t devno, struct path_cxt *parent, const char *prefix);
@@ -79,6 +86,9 @@ char *sysfs_blkdev_get_name(struct path_cxt *pc, char *buf, size_t bufsiz);
 int sysfs_blkdev_is_partition_dirent(DIR *dir, struct dirent *d, const char *parent_name);
 int sysfs_blkdev_count_partitions(struct path_cxt *pc, const char *devname);
 dev_t sysfs_blkdev_partno_to_devno(struct path_cxt *pc, int partno);
+int sysfs_blkdev_get_partitions(struct path_cxt *pc, struct sysfs_blkdev_part **parts);
+struct sysfs_blkdev_part *sysfs_blkdev_find_partition(struct sysfs_blkdev_part *parts,
+				size_t nparts, int partno);
 char *sysfs_blkdev_get_slave(struct path_cxt *pc);
 char *sysfs_blkdev_get_path(struct path_cxt *pc, char *buf, size_t bufsiz);
 dev_t sysfs_blkdev_get_devno(struct path_cxt *pc);
@@ -106,6 +116,9 @@ char *sysfs_devno_to_devpath(dev_t devno, char *buf, size_t bufsiz);
 char *sysfs_devno_to_devname(dev_t devno, char *buf, size_t bufsiz);
 int sysfs_devno_count_partitions(dev_t devno);
 
+void sysfs_devno_cache_enable(int enable);
+void sysfs_devno_cache_invalidate(void);
+
 int sysfs_blkdev_scsi_get_hctl(struct path_cxt *pc, int *h, int *c, int *t, int *l);
 char *sysfs_blkdev_scsi_host_strdup_attribute(struct path_cxt *pc,
                         const char *type, const char *attr);
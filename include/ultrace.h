@@ -0,0 +1,44 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ */
+#ifndef UTIL_LINUX_ULTRACE_H
+#define UTIL_LINUX_ULTRACE_H
+
+/*
+ * util-linux tracing spans
+ *
+ * The spans are compiled in only with --enable-ultrace (meson -Dultrace=true),
+ * otherwise the macros are no-op. The trace is collected only if the ULTRACE=
+ * environment variable is set to a file name, the events are kept in memory
+ * (per-thread ring buffers) and written on exit in the Chrome trace event
+ * format (JSON array), usable by chrome://tracing or ui.perfetto.dev.
+ *
+ * The file is not truncated, the libraries and programs (and more processes)
+ * append to the same array. Remove the file to start a new trace.
+ *
+ * In the code is possible to use
+ *
+ *	UL_TRACE_BEGIN("blkid_do_safeprobe");
+ *	...
+ *	UL_TRACE_END("blkid_do_safeprobe");
+ *
+ * The name has to be a static string (it is not copied nor escaped), for
+ * example a literal or a probing driver name, and the same name has to be
+ * used for the both macros.
+ */
+#ifdef USE_ULTRACE
+
+extern void ul_trace_event(char phase, const char *name);
+
+# define UL_TRACE_BEGIN(name)	ul_trace_event('B', name)
+# define UL_TRACE_END(name)	ul_trace_event('E', name)
+
+#else /* !USE_ULTRACE */
+
+# define UL_TRACE_BEGIN(name)	do { } while (0)
+# define UL_TRACE_END(name)	do { } while (0)
+
+#endif /* USE_ULTRACE */
+
+#endif /* UTIL_LINUX_ULTRACE_H */
@@ -0,0 +1,23 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ */
+#ifndef UTIL_LINUX_WALKDIR_H
+#define UTIL_LINUX_WALKDIR_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <ftw.h>
+
+/* call back only for regular files and errors (FTW_F, FTW_DNR, FTW_NS),
+ * directories and symlinks are not stat()ed if the filesystem provides
+ * the entry type */
+#define UL_WALKDIR_REGULAR	(1 << 1)
+
+typedef int (*ul_walkdir_cb)(const char *fpath, const struct stat *sb,
+			     int typeflag, struct FTW *ftwbuf);
+
+extern int ul_walkdir(const char *path, ul_walkdir_cb fn,
+		      unsigned int flags, size_t nthreads);
+
+#endif /* UTIL_LINUX_WALKDIR_H */
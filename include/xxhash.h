@@ -79,7 +79,9 @@ XXH32        6.8 GB/s            6.0 GB/s
 */
 
 /* util-linux customizations */
-#define XXH_NO_XXH3
+#ifndef XXH_ENABLE_XXH3
+# define XXH_NO_XXH3
+#endif
 #define XXH_NAMESPACE ul_
 
 #if defined (__cplusplus)
@@ -8,10 +8,14 @@
 #include "mbsalign.h"
 #include "strutils.h"
 
+/* don't keep huge buffers in the pool */
+#define UL_BUFFER_POOL_MAXSZ	(1024 * 1024)
+
 void ul_buffer_reset_data(struct ul_buffer *buf)
 {
-	if (buf->begin)
-		memset(buf->begin, 0, buf->sz);
+	/* the area behind the end is always zeroized, see ul_buffer_alloc_data() */
+	if (buf->begin && buf->end)
+		memset(buf->begin, 0, buf->end - buf->begin);
 	buf->end = buf->begin;
 
 	if (buf->ptrs && buf->nptrs)
@@ -36,6 +40,50 @@ void ul_buffer_free_data(struct ul_buffer *buf)
 	buf->encoded_sz = 0;
 }
 
+/*
+ * The @pool keeps allocations of the released buffers to reuse them for the
+ * next ul_buffer_pool_get(). The @buf has to be empty (UL_INIT_BUFFER or after
+ * ul_buffer_free_data()) for the get, the chunk size is not modified.
+ */
+void ul_buffer_pool_get(struct ul_buffer_pool *pool, struct ul_buffer *buf)
+{
+	assert(pool);
+	assert(buf);
+
+	if (!buf->begin && pool->nbufs) {
+		size_t chunksize = buf->chunksize;
+
+		*buf = pool->bufs[--pool->nbufs];
+		memset(&pool->bufs[pool->nbufs], 0, sizeof(*buf));
+		buf->chunksize = chunksize;
+	}
+}
+
+/* returns the @buf allocation to the @pool (or frees it), the @buf is empty then */
+void ul_buffer_pool_put(struct ul_buffer_pool *pool, struct ul_buffer *buf)
+{
+	assert(pool);
+	assert(buf);
+
+	if (buf->begin && buf->sz <= UL_BUFFER_POOL_MAXSZ
+	    && pool->nbufs < UL_BUFFER_POOLSZ) {
+		ul_buffer_reset_data(buf);
+		pool->bufs[pool->nbufs++] = *buf;
+		memset(buf, 0, sizeof(*buf));
+		return;
+	}
+	ul_buffer_free_data(buf);
+}
+
+/* frees all buffers cached in the @pool */
+void ul_buffer_pool_free(struct ul_buffer_pool *pool)
+{
+	assert(pool);
+
+	while (pool->nbufs)
+		ul_buffer_free_data(&pool->bufs[--pool->nbufs]);
+}
+
 void ul_buffer_set_chunksize(struct ul_buffer *buf, size_t sz)
 {
 	buf->chunksize = sz;
@@ -112,6 +160,9 @@ int ul_buffer_alloc_data(struct ul_buffer *buf, size_t sz)
 	if (buf->end && buf->begin)
 		len = buf->end - buf->begin;
 
+	/* grow geometrically to make appends amortized O(1) */
+	if (buf->sz && sz < buf->sz * 2)
+		sz = buf->sz * 2;
 	if (buf->chunksize)
 		sz = ((sz + buf->chunksize) / buf->chunksize) * buf->chunksize + 1;
 
@@ -241,6 +292,7 @@ enum {
 int main(void)
 {
 	struct ul_buffer buf = UL_INIT_BUFFER;
+	struct ul_buffer_pool pool = { .nbufs = 0 };
 	char *str;
 	size_t sz = 0;
 
@@ -283,7 +335,16 @@ int main(void)
 	str = ul_buffer_get_data(&buf, &sz, NULL);
 	printf("data [%zu] '%s'\n", sz, str);
 
+	ul_buffer_pool_put(&pool, &buf);
+	ul_buffer_pool_get(&pool, &buf);
+	printf("pooled [%zu] empty=%d\n", ul_buffer_get_bufsiz(&buf),
+			ul_buffer_is_empty(&buf));
+	ul_buffer_append_string(&buf, "reused");
+	str = ul_buffer_get_data(&buf, &sz, NULL);
+	printf("data [%zu] '%s'\n", sz, str);
+
 	ul_buffer_free_data(&buf);
+	ul_buffer_pool_free(&pool);
 
         return EXIT_SUCCESS;
 }
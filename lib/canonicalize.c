@@ -21,6 +21,10 @@
 #include "all-io.h"
 #include "strutils.h"
 
+#ifndef MAXSYMLINKS
+# define MAXSYMLINKS	40
+#endif
+
 /*
  * Converts private "dm-N" names to "/dev/mapper/<name>"
  *
@@ -118,14 +122,206 @@ char *absolute_path(const char *path)
 	return res;
 }
 
-char *canonicalize_path(const char *path)
+/*
+ * Cache of the canonicalized directories. The paths used by mount, fsck,
+ * findmnt, etc. have usually many common directories (/dev/mapper,
+ * /dev/disk/by-uuid, ...), so only the last path component has to be resolved.
+ *
+ * The cached directory is revalidated on each use: the directory has to be
+ * the same inode as before and all components of the canonicalized directory
+ * have to be directories (not symlinks). The cache does not detect a symlink
+ * redirected to another path to the same directory (e.g. a bind mount), use
+ * canonicalize_cache_reset() if the tree has been modified this way.
+ */
+struct canon_dir {
+	char	*dir;		/* directory as specified by caller */
+	char	*real;		/* canonicalized directory */
+	dev_t	dev;
+	ino_t	ino;
+};
+
+#define CANON_CACHE_SIZE	16
+
+struct canon_cache {
+	struct canon_dir	dirs[CANON_CACHE_SIZE];
+	size_t			next;	/* the oldest entry */
+};
+
+struct canon_cache *new_canon_cache(void)
+{
+	return calloc(1, sizeof(struct canon_cache));
+}
+
+void canonicalize_cache_reset(struct canon_cache *cc)
+{
+	size_t i;
+
+	if (!cc)
+		return;
+
+	for (i = 0; i < CANON_CACHE_SIZE; i++) {
+		free(cc->dirs[i].dir);
+		free(cc->dirs[i].real);
+	}
+	memset(cc, 0, sizeof(*cc));
+}
+
+void free_canon_cache(struct canon_cache *cc)
+{
+	canonicalize_cache_reset(cc);
+	free(cc);
+}
+
+/* returns 1 if @real is still the canonical path of the @st directory */
+static int is_canonical_dir(const char *real, const struct stat *st)
+{
+	char buf[PATH_MAX];
+	struct stat sb;
+	size_t len = strlen(real), i;
+
+	if (len >= sizeof(buf))
+		return 0;
+	memcpy(buf, real, len + 1);
+
+	for (i = 1; i <= len; i++) {
+		if (buf[i] != '/' && buf[i] != '\0')
+			continue;
+		buf[i] = '\0';
+		if (lstat(buf, &sb) != 0 || !S_ISDIR(sb.st_mode))
+			return 0;
+		buf[i] = real[i];
+	}
+
+	/* @sb is the last component now */
+	return sb.st_dev == st->st_dev && sb.st_ino == st->st_ino;
+}
+
+/* returns the cache entry for @dir, @dir is always deallocated */
+static struct canon_dir *canon_cache_get(struct canon_cache *cc, char *dir)
+{
+	struct canon_dir *cd = NULL;
+	struct stat st;
+	size_t i;
+
+	if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode))
+		goto fail;
+
+	for (i = 0; i < CANON_CACHE_SIZE; i++) {
+		if (cc->dirs[i].dir && strcmp(cc->dirs[i].dir, dir) == 0) {
+			cd = &cc->dirs[i];
+			break;
+		}
+	}
+
+	if (cd && cd->dev == st.st_dev && cd->ino == st.st_ino
+	    && is_canonical_dir(cd->real, &st)) {
+		free(dir);
+		return cd;
+	}
+
+	if (!cd) {
+		/* replace the oldest entry */
+		cd = &cc->dirs[cc->next];
+		cc->next = (cc->next + 1) % CANON_CACHE_SIZE;
+		free(cd->dir);
+		cd->dir = dir;
+	} else
+		free(dir);
+
+	free(cd->real);
+	cd->real = realpath(cd->dir, NULL);
+	if (!cd->real) {
+		free(cd->dir);
+		cd->dir = NULL;
+		return NULL;
+	}
+	cd->dev = st.st_dev;
+	cd->ino = st.st_ino;
+	return cd;
+fail:
+	free(dir);
+	return NULL;
+}
+
+static char *join_path(const char *dir, const char *name)
 {
-	char *canonical, *dmname;
+	size_t dsz = strcmp(dir, "/") == 0 ? 0 : strlen(dir),
+	       nsz = strlen(name);
+	char *res, *p;
+
+	p = res = malloc(dsz + 1 + nsz + 1);
+	if (!res)
+		return NULL;
+	p = mempcpy(p, dir, dsz);
+	*p++ = '/';
+	memcpy(p, name, nsz + 1);
+	return res;
+}
+
+/*
+ * Resolves the last component of the absolute @path within the cached
+ * directory. Returns NULL if the path cannot be resolved this way, the caller
+ * is expected to fall back to realpath(3).
+ */
+static char *canonicalize_cached(struct canon_cache *cc, const char *path, int depth)
+{
+	const char *base;
+	char *dir, *res, *next;
+	char link[PATH_MAX];
+	struct canon_dir *cd;
+	struct stat st;
+	ssize_t sz;
+
+	if (depth > MAXSYMLINKS || *path != '/')
+		return NULL;
+
+	base = strrchr(path, '/') + 1;
+	if (!*base || strcmp(base, ".") == 0 || strcmp(base, "..") == 0)
+		return NULL;
+
+	dir = base - 1 == path ? strdup("/") : strndup(path, base - 1 - path);
+	if (!dir)
+		return NULL;
+	cd = canon_cache_get(cc, dir);
+	if (!cd)
+		return NULL;
+
+	res = join_path(cd->real, base);
+	if (!res || lstat(res, &st) != 0)
+		goto fail;
+	if (!S_ISLNK(st.st_mode))
+		return res;
+
+	sz = readlink(res, link, sizeof(link) - 1);
+	if (sz <= 0)
+		goto fail;
+	link[sz] = '\0';
+
+	/* don't use @cd after this point, the cache may be modified */
+	next = *link == '/' ? strdup(link) : join_path(cd->real, link);
+	free(res);
+	if (!next)
+		return NULL;
+
+	res = canonicalize_cached(cc, next, depth + 1);
+	free(next);
+	return res;
+fail:
+	free(res);
+	return NULL;
+}
+
+static char *__canonicalize_path(struct canon_cache *cc, const char *path)
+{
+	char *canonical = NULL, *dmname;
 
 	if (!path || !*path)
 		return NULL;
 
-	canonical = realpath(path, NULL);
+	if (cc)
+		canonical = canonicalize_cached(cc, path, 0);
+	if (!canonical)
+		canonical = realpath(path, NULL);
 	if (!canonical)
 		return strdup(path);
 
@@ -140,6 +336,20 @@ char *canonicalize_path(const char *path)
 	return canonical;
 }
 
+char *canonicalize_path(const char *path)
+{
+	return __canonicalize_path(NULL, path);
+}
+
+/*
+ * The same as canonicalize_path(), but the directories are resolved by the
+ * cache @cc, see new_canon_cache(). The cache is not thread-safe.
+ */
+char *canonicalize_path_cached(struct canon_cache *cc, const char *path)
+{
+	return __canonicalize_path(cc, path);
+}
+
 char *canonicalize_path_restricted(const char *path)
 {
 	char *canonical = NULL;
@@ -238,10 +448,50 @@ done:
 int main(int argc, char **argv)
 {
 	if (argc < 2) {
-		fprintf(stderr, "usage: %s <device>\n", argv[0]);
+		fprintf(stderr, "usage: %s <device>\n"
+				"       %s --cached [--move <dir> <new>] <path> ...\n", argv[0], argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
+	if (strcmp(argv[1], "--cached") == 0) {
+		struct canon_cache *cc = new_canon_cache();
+		int i, rc = EXIT_SUCCESS;
+
+		if (!cc)
+			err(EXIT_FAILURE, "cannot allocate cache");
+
+		for (i = 2; i < argc; i++) {
+			const char *path = argv[i];
+			char *real, *cached;
+			int n;
+
+			if (strcmp(path, "--move") == 0 && i + 2 < argc) {
+				/* replace the directory with a symlink to the new location */
+				if (rename(argv[i + 1], argv[i + 2]) != 0
+				    || symlink(argv[i + 2], argv[i + 1]) != 0)
+					err(EXIT_FAILURE, "cannot move %s", argv[i + 1]);
+				i += 2;
+				continue;
+			}
+
+			/* twice to use the already cached directories */
+			for (n = 0; n < 2; n++) {
+				real = canonicalize_path(path);
+				cached = canonicalize_path_cached(cc, path);
+				if (n == 0)
+					fprintf(stdout, "%s: %s\n", path, cached);
+				if (strcmp(real, cached) != 0) {
+					fprintf(stderr, "%s: %s != %s\n", path, real, cached);
+					rc = EXIT_FAILURE;
+				}
+				free(real);
+				free(cached);
+			}
+		}
+		free_canon_cache(cc);
+		exit(rc);
+	}
+
 	fprintf(stdout, "orig: %s\n", argv[1]);
 	fprintf(stdout, "real: %s\n", canonicalize_path(argv[1]));
 	exit(EXIT_SUCCESS);
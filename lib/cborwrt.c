@@ -0,0 +1,175 @@
+/*
+ * CBOR (RFC 8949) output formatting functions.
+ *
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include "c.h"
+#include "c_strtod.h"
+#include "strutils.h"
+#include "cborwrt.h"
+
+#define CBOR_AI_1BYTE	24
+#define CBOR_AI_2BYTES	25
+#define CBOR_AI_4BYTES	26
+#define CBOR_AI_8BYTES	27
+#define CBOR_AI_INDEF	31
+
+#define CBOR_FALSE	0xf4
+#define CBOR_TRUE	0xf5
+#define CBOR_NULL	0xf6
+#define CBOR_DOUBLE	0xfb
+#define CBOR_BREAK	0xff
+
+void ul_cborwrt_init(struct ul_cborwrt *fmt, FILE *out)
+{
+	fmt->out = out;
+}
+
+/* writes big-endian @sz bytes of @val */
+static void put_be(struct ul_cborwrt *fmt, uint64_t val, size_t sz)
+{
+	unsigned char buf[8];
+	size_t i;
+
+	for (i = 0; i < sz; i++)
+		buf[i] = (val >> (8 * (sz - i - 1))) & 0xff;
+	fwrite(buf, 1, sz, fmt->out);
+}
+
+/* the initial byte and argument of the data item, always the shortest form */
+void ul_cborwrt_head(struct ul_cborwrt *fmt, int type, uint64_t val)
+{
+	unsigned char mt = (unsigned char) (type << 5);
+
+	if (val < CBOR_AI_1BYTE)
+		fputc(mt | val, fmt->out);
+	else if (val <= UINT8_MAX) {
+		fputc(mt | CBOR_AI_1BYTE, fmt->out);
+		put_be(fmt, val, 1);
+	} else if (val <= UINT16_MAX) {
+		fputc(mt | CBOR_AI_2BYTES, fmt->out);
+		put_be(fmt, val, 2);
+	} else if (val <= UINT32_MAX) {
+		fputc(mt | CBOR_AI_4BYTES, fmt->out);
+		put_be(fmt, val, 4);
+	} else {
+		fputc(mt | CBOR_AI_8BYTES, fmt->out);
+		put_be(fmt, val, 8);
+	}
+}
+
+void ul_cborwrt_open_indef(struct ul_cborwrt *fmt, int type)
+{
+	fputc((type << 5) | CBOR_AI_INDEF, fmt->out);
+}
+
+void ul_cborwrt_break(struct ul_cborwrt *fmt)
+{
+	fputc(CBOR_BREAK, fmt->out);
+}
+
+/* text string, also for empty or NULL @data (e.g. map keys) */
+void ul_cborwrt_text(struct ul_cborwrt *fmt, const char *data, size_t size)
+{
+	ul_cborwrt_head(fmt, UL_CBOR_TEXT, data ? size : 0);
+	if (data && size)
+		fwrite(data, 1, size, fmt->out);
+}
+
+void ul_cborwrt_value_s_sized(struct ul_cborwrt *fmt,
+			      const char *data, size_t size)
+{
+	if (!data || !*data || !size)
+		ul_cborwrt_value_null(fmt);
+	else
+		ul_cborwrt_text(fmt, data, size);
+}
+
+/* empty strings are null, the same as in JSON output */
+void ul_cborwrt_value_s(struct ul_cborwrt *fmt, const char *data)
+{
+	ul_cborwrt_value_s_sized(fmt, data, data ? strlen(data) : 0);
+}
+
+void ul_cborwrt_value_u64(struct ul_cborwrt *fmt, uint64_t data)
+{
+	ul_cborwrt_head(fmt, UL_CBOR_UINT, data);
+}
+
+void ul_cborwrt_value_i64(struct ul_cborwrt *fmt, int64_t data)
+{
+	if (data < 0)
+		/* -1 - n, it never overflows */
+		ul_cborwrt_head(fmt, UL_CBOR_NEGINT, (uint64_t) -(data + 1));
+	else
+		ul_cborwrt_head(fmt, UL_CBOR_UINT, (uint64_t) data);
+}
+
+void ul_cborwrt_value_double(struct ul_cborwrt *fmt, double data)
+{
+	uint64_t x;
+
+	memcpy(&x, &data, sizeof(x));
+	fputc(CBOR_DOUBLE, fmt->out);
+	put_be(fmt, x, 8);
+}
+
+void ul_cborwrt_value_boolean(struct ul_cborwrt *fmt, int data)
+{
+	fputc(data ? CBOR_TRUE : CBOR_FALSE, fmt->out);
+}
+
+void ul_cborwrt_value_null(struct ul_cborwrt *fmt)
+{
+	fputc(CBOR_NULL, fmt->out);
+}
+
+/*
+ * Converts number in string (as used for JSON "raw" values) to CBOR integer
+ * or float. The string is written as text if it's not a number at all, the
+ * content is never lost.
+ */
+void ul_cborwrt_value_number(struct ul_cborwrt *fmt, const char *data)
+{
+	char *end = NULL;
+	double fnum;
+
+	if (!data || !*data) {
+		ul_cborwrt_value_null(fmt);
+		return;
+	}
+
+	errno = 0;
+	if (*data == '-') {
+		int64_t num = strtoimax(data, &end, 10);
+
+		if (!errno && end && !*end && end > data + 1) {
+			ul_cborwrt_value_i64(fmt, num);
+			return;
+		}
+	} else if (isdigit_string(data)) {
+		uint64_t num = strtoumax(data, &end, 10);
+
+		if (!errno && end && !*end) {
+			ul_cborwrt_value_u64(fmt, num);
+			return;
+		}
+	}
+
+	errno = 0;
+	end = NULL;
+	fnum = c_strtod(data, &end);
+	if (!errno && end && end > data && !*end) {
+		ul_cborwrt_value_double(fmt, fnum);
+		return;
+	}
+
+	ul_cborwrt_value_s(fmt, data);
+}
@@ -585,7 +585,6 @@ static int colors_terminal_is_ready(void)
  */
 int colors_init(int mode, const char *name)
 {
-	int ready = -1;
 	struct ul_color_ctl *cc = &ul_colors;
 
 	cc->utilname = name;
@@ -597,8 +596,12 @@ int colors_init(int mode, const char *name)
 	else
 		cc->mode = mode;
 
-	if (cc->mode == UL_COLORMODE_UNDEF
-	    && (ready = colors_terminal_is_ready())) {
+	/*
+	 * Read terminal-colors.d/ before the terminal is initialized, the
+	 * terminfo setup is more expensive than the directory scan and it's
+	 * unnecessary if colors are disabled by the configuration.
+	 */
+	if (cc->mode == UL_COLORMODE_UNDEF) {
 		int rc = colors_read_configuration(cc);
 		if (rc)
 			cc->mode = UL_COLORMODE_DEFAULT;
@@ -617,7 +620,7 @@ int colors_init(int mode, const char *name)
 
 	switch (cc->mode) {
 	case UL_COLORMODE_AUTO:
-		cc->has_colors = ready == -1 ? colors_terminal_is_ready() : ready;
+		cc->has_colors = colors_terminal_is_ready();
 		break;
 	case UL_COLORMODE_ALWAYS:
 		cc->has_colors = 1;
@@ -29,6 +29,14 @@
 #include "cpuset.h"
 #include "c.h"
 
+/* the sets are accessed by words, the bits order is the same as for the
+ * CPU_*() macros in glibc and musl */
+#define CPUSET_WORDBITS		(8 * sizeof(unsigned long))
+
+#define cpuset_words(set)	((unsigned long *) (set)->__bits)
+#define cpuset_cwords(set)	((const unsigned long *) (set)->__bits)
+#define cpuset_nwords(setsize)	((setsize) / sizeof(unsigned long))
+
 static inline int val_to_char(int v)
 {
 	if (v >= 0 && v < 10)
@@ -50,15 +58,6 @@ static inline int char_to_val(int c)
 	return -1;
 }
 
-static const char *nexttoken(const char *q,  int sep)
-{
-	if (q)
-		q = strchr(q, sep);
-	if (q)
-		q++;
-	return q;
-}
-
 /*
  * Number of bits in a CPU bitmask on current system
  */
@@ -147,6 +146,83 @@ int __cpuset_count_s(size_t setsize, const cpu_set_t *set)
 }
 #endif
 
+/*
+ * Returns the first CPU from @set which is equal or greater than @cpu, or -1.
+ */
+int cpuset_next_set(const cpu_set_t *set, size_t setsize, int cpu)
+{
+	const unsigned long *w = cpuset_cwords(set);
+	size_t i, nwords = cpuset_nwords(setsize);
+	unsigned long x;
+
+	if (cpu < 0)
+		cpu = 0;
+	i = cpu / CPUSET_WORDBITS;
+	if (i >= nwords)
+		return -1;
+
+	x = w[i] & (~0UL << (cpu % CPUSET_WORDBITS));
+	while (!x) {
+		if (++i >= nwords)
+			return -1;
+		x = w[i];
+	}
+	return i * CPUSET_WORDBITS + __builtin_ctzl(x);
+}
+
+/*
+ * Returns the first CPU not in @set which is equal or greater than @cpu. If
+ * all the remaining CPUs are set, returns number of bits in the set.
+ */
+int cpuset_next_clear(const cpu_set_t *set, size_t setsize, int cpu)
+{
+	const unsigned long *w = cpuset_cwords(set);
+	size_t i, nwords = cpuset_nwords(setsize);
+	unsigned long x;
+
+	if (cpu < 0)
+		cpu = 0;
+	i = cpu / CPUSET_WORDBITS;
+	if (i >= nwords)
+		return cpuset_nbits(setsize);
+
+	x = ~w[i] & (~0UL << (cpu % CPUSET_WORDBITS));
+	while (!x) {
+		if (++i >= nwords)
+			return cpuset_nbits(setsize);
+		x = ~w[i];
+	}
+	return i * CPUSET_WORDBITS + __builtin_ctzl(x);
+}
+
+/*
+ * Adds CPUs from @first to @last (inclusive) to @set, the CPUs which do not
+ * fit into the set are ignored.
+ */
+void cpuset_set_range(cpu_set_t *set, size_t setsize, size_t first, size_t last)
+{
+	unsigned long *w = cpuset_words(set);
+	size_t i, l, max = cpuset_nbits(setsize);
+
+	if (first > last || first >= max)
+		return;
+	if (last >= max)
+		last = max - 1;
+
+	i = first / CPUSET_WORDBITS;
+	l = last / CPUSET_WORDBITS;
+
+	if (i == l) {
+		w[i] |= (~0UL >> (CPUSET_WORDBITS - 1 - last % CPUSET_WORDBITS))
+			& (~0UL << (first % CPUSET_WORDBITS));
+		return;
+	}
+	w[i++] |= ~0UL << (first % CPUSET_WORDBITS);
+	for (; i < l; i++)
+		w[i] = ~0UL;
+	w[l] |= ~0UL >> (CPUSET_WORDBITS - 1 - last % CPUSET_WORDBITS);
+}
+
 /*
  * Returns human readable representation of the cpuset. The output format is
  * a list of CPUs with ranges (for example, "0,1,3-9").
@@ -154,36 +230,29 @@ int __cpuset_count_s(size_t setsize, const cpu_set_t *set)
 char *cpulist_create(char *str, size_t len,
 			cpu_set_t *set, size_t setsize)
 {
-	size_t i;
 	char *ptr = str;
 	int entry_made = 0;
-	size_t max = cpuset_nbits(setsize);
-
-	for (i = 0; i < max; i++) {
-		if (CPU_ISSET_S(i, setsize, set)) {
-			int rlen;
-			size_t j, run = 0;
-			entry_made = 1;
-			for (j = i + 1; j < max; j++) {
-				if (CPU_ISSET_S(j, setsize, set))
-					run++;
-				else
-					break;
-			}
-			if (!run)
-				rlen = snprintf(ptr, len, "%zu,", i);
-			else if (run == 1) {
-				rlen = snprintf(ptr, len, "%zu,%zu,", i, i + 1);
-				i++;
-			} else {
-				rlen = snprintf(ptr, len, "%zu-%zu,", i, i + run);
-				i += run;
-			}
-			if (rlen < 0 || (size_t) rlen >= len)
-				return NULL;
-			ptr += rlen;
-			len -= rlen;
-		}
+	int i, last;
+
+	/* walk the set by runs of CPUs, not by bits */
+	for (i = cpuset_next_set(set, setsize, 0); i >= 0;
+	     i = cpuset_next_set(set, setsize, last + 1)) {
+		int rlen;
+
+		last = cpuset_next_clear(set, setsize, i) - 1;
+		entry_made = 1;
+
+		if (last == i)
+			rlen = snprintf(ptr, len, "%d,", i);
+		else if (last == i + 1)
+			rlen = snprintf(ptr, len, "%d,%d,", i, last);
+		else
+			rlen = snprintf(ptr, len, "%d-%d,", i, last);
+
+		if (rlen < 0 || (size_t) rlen >= len)
+			return NULL;
+		ptr += rlen;
+		len -= rlen;
 	}
 	ptr -= entry_made;
 	*ptr = '\0';
@@ -197,24 +266,18 @@ char *cpulist_create(char *str, size_t len,
 char *cpumask_create(char *str, size_t len,
 			cpu_set_t *set, size_t setsize)
 {
+	const unsigned long *w = cpuset_cwords(set);
 	char *ptr = str;
 	char *ret = NULL;
 	int cpu;
 
 	for (cpu = cpuset_nbits(setsize) - 4; cpu >= 0; cpu -= 4) {
-		char val = 0;
+		char val;
 
 		if (len == (size_t) (ptr - str))
 			break;
 
-		if (CPU_ISSET_S(cpu, setsize, set))
-			val |= 1;
-		if (CPU_ISSET_S(cpu + 1, setsize, set))
-			val |= 2;
-		if (CPU_ISSET_S(cpu + 2, setsize, set))
-			val |= 4;
-		if (CPU_ISSET_S(cpu + 3, setsize, set))
-			val |= 8;
+		val = (w[cpu / CPUSET_WORDBITS] >> (cpu % CPUSET_WORDBITS)) & 0xf;
 
 		if (!ret && val)
 			ret = ptr;
@@ -229,9 +292,11 @@ char *cpumask_create(char *str, size_t len,
  */
 int cpumask_parse(const char *str, cpu_set_t *set, size_t setsize)
 {
+	unsigned long *w = cpuset_words(set);
+	size_t nwords = cpuset_nwords(setsize);
 	int len = strlen(str);
 	const char *ptr = str + len - 1;
-	int cpu = 0;
+	size_t cpu = 0;
 
 	/* skip 0x, it's all hex anyway */
 	if (len > 1 && !memcmp(str, "0x", 2L))
@@ -249,14 +314,9 @@ int cpumask_parse(const char *str, cpu_set_t *set, size_t setsize)
 		val = char_to_val(*ptr);
 		if (val == (char) -1)
 			return -1;
-		if (val & 1)
-			CPU_SET_S(cpu, setsize, set);
-		if (val & 2)
-			CPU_SET_S(cpu + 1, setsize, set);
-		if (val & 4)
-			CPU_SET_S(cpu + 2, setsize, set);
-		if (val & 8)
-			CPU_SET_S(cpu + 3, setsize, set);
+		/* a nibble never crosses the word boundary */
+		if (val && cpu / CPUSET_WORDBITS < nwords)
+			w[cpu / CPUSET_WORDBITS] |= (unsigned long) val << (cpu % CPUSET_WORDBITS);
 		ptr--;
 		cpu += 4;
 	}
@@ -264,6 +324,15 @@ int cpumask_parse(const char *str, cpu_set_t *set, size_t setsize)
 	return 0;
 }
 
+static const char *nexttoken(const char *q,  int sep)
+{
+	if (q)
+		q = strchr(q, sep);
+	if (q)
+		q++;
+	return q;
+}
+
 static int nextnumber(const char *str, char **end, unsigned int *result)
 {
 	errno = 0;
@@ -325,6 +394,14 @@ int cpulist_parse(const char *str, cpu_set_t *set, size_t setsize, int fail)
 
 		if (!(a <= b))
 			return 1;
+
+		/* contiguous range, set by words */
+		if (s == 1) {
+			cpuset_set_range(set, setsize, a, b);
+			if (fail && b >= max)
+				return 2;
+			continue;
+		}
 		while (a <= b) {
 			if (a >= max) {
 				if (fail)
@@ -0,0 +1,232 @@
+/*
+ * Please, don't add this file to libcommon because it requires -lpthread on
+ * systems with old libc and monotonic.c (-lrt).
+ *
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * The area is split into ranges aligned to the device discard granularity;
+ * each range is one BLKDISCARD, BLKSECDISCARD or BLKZEROOUT ioctl. The kernel
+ * splits every ioctl into requests of the device limit and waits for all of
+ * them, so more ranges are in flight only if the ioctls are called from more
+ * threads.
+ */
+#include <errno.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#include "c.h"
+#include "blkdev.h"
+#include "sysfs.h"
+#include "monotonic.h"
+#include "discard.h"
+
+/* number of ranges per thread, the threads finish at about the same time */
+#define DISCARD_RANGES_PER_JOB	4
+
+struct discard_pool {
+	struct ul_discard	*dc;
+	uint64_t		next;		/* the next range for a worker */
+	int			errsv;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t		lock;
+#endif
+};
+
+static inline void pool_lock(struct discard_pool *pool __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&pool->lock);
+#endif
+}
+
+static inline void pool_unlock(struct discard_pool *pool __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&pool->lock);
+#endif
+}
+
+static uint64_t round_up_to(uint64_t x, uint64_t n)
+{
+	return n ? ((x + n - 1) / n) * n : x;
+}
+
+/*
+ * Sets @dc for the area from @start to @end on @fd. The granularity and the
+ * device limit are read from sysfs, @dc->step, @dc->njobs and @dc->progress
+ * may be set by caller before ul_discard_range().
+ */
+int ul_discard_init(struct ul_discard *dc, int fd, unsigned long request,
+		    uint64_t start, uint64_t end)
+{
+	struct path_cxt *pc;
+	struct stat st;
+	uint64_t gran = 0, max = 0;
+	int ssz = 0;
+
+	memset(dc, 0, sizeof(*dc));
+	dc->fd = fd;
+	dc->request = request;
+	dc->start = start;
+	dc->end = end;
+
+	if (fstat(fd, &st) != 0)
+		return -errno;
+	if (ioctl(fd, BLKSSZGET, &ssz) != 0 || ssz <= 0)
+		ssz = DEFAULT_SECTOR_SIZE;
+
+	pc = ul_new_sysfs_path(st.st_rdev, NULL, NULL);
+	if (pc) {
+		if (request == BLKZEROOUT)
+			ul_path_read_u64(pc, &max, "queue/write_zeroes_max_bytes");
+		else {
+			ul_path_read_u64(pc, &max, "queue/discard_max_bytes");
+			ul_path_read_u64(pc, &gran, "queue/discard_granularity");
+		}
+		ul_unref_path(pc);
+	}
+
+	dc->granularity = max(gran, (uint64_t) ssz);
+	dc->max_bytes = round_up_to(max, dc->granularity);
+	return 0;
+}
+
+/* returns the next range or 0 if there is nothing to do */
+static uint64_t pool_next_range(struct discard_pool *pool, uint64_t *start)
+{
+	struct ul_discard *dc = pool->dc;
+	uint64_t len = 0;
+
+	pool_lock(pool);
+	if (pool->next < dc->end) {
+		*start = pool->next;
+		len = min(dc->step, dc->end - pool->next);
+		pool->next += len;
+	}
+	pool_unlock(pool);
+
+	return len;
+}
+
+static void *discard_worker(void *data)
+{
+	struct discard_pool *pool = data;
+	struct ul_discard *dc = pool->dc;
+	uint64_t range[2];
+
+	while ((range[1] = pool_next_range(pool, &range[0]))) {
+		int rc;
+
+		errno = 0;
+		rc = ioctl(dc->fd, dc->request, &range);
+
+		pool_lock(pool);
+		if (rc != 0) {
+			/* the first error wins, don't start new ranges */
+			if (!pool->errsv) {
+				pool->errsv = errno ? errno : EIO;
+				dc->failed = range[0];
+			}
+			pool->next = dc->end;
+		} else {
+			dc->done += range[1];
+			if (dc->progress)
+				dc->progress(dc, dc->done);
+		}
+		pool_unlock(pool);
+	}
+	return NULL;
+}
+
+#ifdef HAVE_PTHREAD
+/* returns the number of threads, zero if no thread has been created */
+static size_t run_workers(struct discard_pool *pool, size_t njobs)
+{
+	pthread_t *threads;
+	size_t i, nthreads = 0;
+
+	threads = calloc(njobs, sizeof(pthread_t));
+	if (!threads)
+		return 0;
+
+	for (i = 0; i < njobs; i++) {
+		if (pthread_create(&threads[nthreads], NULL, discard_worker, pool) != 0)
+			break;
+		nthreads++;
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	return nthreads;
+}
+#endif
+
+/*
+ * Discards (or zero-fills) the area defined by ul_discard_init(). The ranges
+ * are submitted by up to @dc->njobs threads. The default step is the whole
+ * area for one thread, otherwise a few ranges per thread.
+ *
+ * Returns: 0 on success, negative errno on error; @dc->failed is the start of
+ *          the failed range and @dc->done the number of bytes done.
+ */
+int ul_discard_range(struct ul_discard *dc)
+{
+	struct discard_pool pool = { .dc = dc };
+	struct timeval start, end;
+	uint64_t len = dc->end > dc->start ? dc->end - dc->start : 0;
+	size_t njobs = dc->njobs ? dc->njobs : 1;
+
+	dc->done = 0;
+	dc->failed = 0;
+	pool.next = dc->start;
+
+	/* split the area to a few ranges per thread; every range is multiple
+	 * of the device limit to keep the kernel requests of the maximal size */
+	if (!dc->step && njobs > 1)
+		dc->step = round_up_to(len / (njobs * DISCARD_RANGES_PER_JOB),
+				dc->max_bytes ? dc->max_bytes : dc->granularity);
+	if (!dc->step)
+		dc->step = len;
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init(&pool.lock, NULL);
+#endif
+	gettime_monotonic(&start);
+#ifdef HAVE_PTHREAD
+	if (njobs > 1 && len > dc->step) {
+		uint64_t nranges = (len + dc->step - 1) / dc->step;
+
+		if (!run_workers(&pool, min((uint64_t) njobs, nranges)))
+			discard_worker(&pool);
+	} else
+#endif
+		discard_worker(&pool);
+	gettime_monotonic(&end);
+#ifdef HAVE_PTHREAD
+	pthread_mutex_destroy(&pool.lock);
+#endif
+
+	timersub(&end, &start, &end);
+	dc->usec = (uint64_t) end.tv_sec * 1000000 + end.tv_usec;
+
+	if (pool.errsv) {
+		errno = pool.errsv;
+		return -pool.errsv;
+	}
+	return 0;
+}
+
+/* returns bytes per second */
+uint64_t ul_discard_get_throughput(const struct ul_discard *dc)
+{
+	if (!dc->usec)
+		return 0;
+	return dc->done / dc->usec * 1000000
+	       + dc->done % dc->usec * 1000000 / dc->usec;
+}
@@ -24,6 +24,21 @@
  *  send to the kernel hash functions (sha1, ...), and only hash digest is read
  *  and cached in usersapce. Fast for large set of (large) files.
  *
+ *  * XXH3 (xxh3 and xxh128 methods): data blocks are read to userspace and
+ *  hashed by the non-cryptographic XXH3 hash, only the digest is cached. It's
+ *  usually faster than the crypto API, and does not depend on kernel.
+ *
+ * The XXH3 and crc32 digests are not collision resistant (collisions can be
+ * created on purpose), so a digests match is always confirmed by memcmp().
+ * For the cryptographic hashes it is optional, see ul_fileeq_set_verify().
+ *
+ * The blocks are read synchronously, but the kernel is asked to read the next
+ * window of all the compared files by POSIX_FADV_WILLNEED, see
+ * ul_fileeq_set_readahead() and ul_fileeq_prefetch().
+ *
+ * The files which share all the extents (reflinks) are equal without reading
+ * the content if enabled by ul_fileeq_set_extents().
+ *
  *
  * No copyright is claimed.  This code is in the public domain; do with
  * it what you wish.
@@ -45,11 +60,22 @@
 # include <sys/sendfile.h>
 #endif
 
+#ifdef USE_FILEEQ_FIEMAP
+# include <sys/ioctl.h>
+# include <linux/fs.h>
+# include <linux/fiemap.h>
+#endif
+
 #include "c.h"
 #include "all-io.h"
 #include "fileeq.h"
 #include "debug.h"
 
+/* private copy of XXH3, the common lib/xxhash.c is without XXH3 */
+#define XXH_ENABLE_XXH3
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
 static UL_DEBUG_DEFINE_MASK(ulfileeq);
 UL_DEBUG_DEFINE_MASKNAMES(ulfileeq) = UL_DEBUG_EMPTY_MASKNAMES;
 
@@ -73,6 +99,8 @@ static void ul_fileeq_init_debug(void)
 
 enum {
 	UL_FILEEQ_MEMCMP,
+	UL_FILEEQ_XXH3,
+	UL_FILEEQ_XXH128,
 	UL_FILEEQ_SHA1,
 	UL_FILEEQ_SHA256,
 	UL_FILEEQ_CRC32
@@ -83,20 +111,29 @@ struct ul_fileeq_method {
 	const char *kname;	/* name used by kernel crypto */
 	int id;
 	short digsiz;
+	bool strong;		/* cryptographic hash, memcmp() confirm is optional */
 };
 
 static const struct ul_fileeq_method ul_eq_methods[] = {
 	[UL_FILEEQ_MEMCMP] = {
 		.id = UL_FILEEQ_MEMCMP, .name = "memcmp"
 	},
+	[UL_FILEEQ_XXH3] = {
+		.id = UL_FILEEQ_XXH3, .name = "xxh3",
+		.digsiz = sizeof(XXH64_hash_t)
+	},
+	[UL_FILEEQ_XXH128] = {
+		.id = UL_FILEEQ_XXH128, .name = "xxh128",
+		.digsiz = sizeof(XXH128_hash_t)
+	},
 #ifdef USE_FILEEQ_CRYPTOAPI
 	[UL_FILEEQ_SHA1] = {
 		.id = UL_FILEEQ_SHA1, .name = "sha1",
-		.digsiz = 20, .kname = "sha1"
+		.digsiz = 20, .kname = "sha1", .strong = true
 	},
 	[UL_FILEEQ_SHA256] = {
 		.id = UL_FILEEQ_SHA256, .name = "sha256",
-		.digsiz = 32, .kname = "sha256"
+		.digsiz = 32, .kname = "sha256", .strong = true
 	},
 
 	[UL_FILEEQ_CRC32] = {
@@ -106,6 +143,10 @@ static const struct ul_fileeq_method ul_eq_methods[] = {
 #endif
 };
 
+#ifdef TEST_PROGRAM_FILEEQ
+static bool fileeq_collide;	/* --collide, all the digests are the same */
+#endif
+
 #ifdef USE_FILEEQ_CRYPTOAPI
 static void deinit_crypto_api(struct ul_fileeq *eq)
 {
@@ -163,6 +204,7 @@ int ul_fileeq_init(struct ul_fileeq *eq, const char *method)
 	memset(eq, 0, sizeof(*eq));
 	eq->fd_api = -1;
 	eq->fd_cip = -1;
+	eq->readahead = UL_FILEEQ_READAHEAD;
 
 	for (i = 0; i < ARRAY_SIZE(ul_eq_methods); i++) {
 		const struct ul_fileeq_method *m = &ul_eq_methods[i];
@@ -176,11 +218,110 @@ int ul_fileeq_init(struct ul_fileeq *eq, const char *method)
 	if (!eq->method)
 		return -1;
 #ifdef USE_FILEEQ_CRYPTOAPI
-	if (eq->method->id != UL_FILEEQ_MEMCMP
-	    && init_crypto_api(eq) != 0)
+	if (eq->method->kname && init_crypto_api(eq) != 0)
 		return -1;
 #endif
+	/* the weak digests are always confirmed by memcmp() */
+	if (eq->method->digsiz && !eq->method->strong)
+		eq->verify = 1;
+	return 0;
+}
+
+/*
+ * Compare content of the files by memcmp() if the digests match. The setting
+ * is used only for the cryptographic hashes (sha1, sha256), the other digests
+ * are always confirmed. The already cached data are not affected.
+ */
+void ul_fileeq_set_verify(struct ul_fileeq *eq, bool enable)
+{
+	if (eq->method->strong)
+		eq->verify = enable ? 1 : 0;
+}
+
+/*
+ * The file content is requested by POSIX_FADV_WILLNEED in windows of @bytes
+ * (or readsiz if larger) ahead of the current offset. The kernel reads the
+ * windows of both compared files at the same time, so the device queue is
+ * not limited to one synchronous read. Zero disables the readahead.
+ */
+void ul_fileeq_set_readahead(struct ul_fileeq *eq, size_t bytes)
+{
+	eq->readahead = bytes;
+}
+
+/*
+ * Check the file extents (FS_IOC_FIEMAP) before the content is read. The
+ * files are equal if all the extents are shared by both files.
+ */
+void ul_fileeq_set_extents(struct ul_fileeq *eq, bool enable)
+{
+	eq->extents = enable ? 1 : 0;
+}
+
+/*
+ * Returns 1 if all extents of the files are at the same physical location
+ * and shared, 0 if not or if it cannot be determined (unsupported FIEMAP,
+ * inline or delayed allocated data). The @sync flushes the file data
+ * before the map is read.
+ */
+int ul_fileeq_same_extents(int fa, int fb, bool sync)
+{
+#if defined(USE_FILEEQ_FIEMAP) && defined(FS_IOC_FIEMAP)
+	char abuf[BUFSIZ] = { 0 },
+	     bbuf[BUFSIZ] = { 0 };
+	struct fiemap *amap = (struct fiemap *) abuf,
+		      *bmap = (struct fiemap *) bbuf;
+	const uint32_t unusable = FIEMAP_EXTENT_UNKNOWN
+				| FIEMAP_EXTENT_DELALLOC
+				| FIEMAP_EXTENT_DATA_INLINE
+				| FIEMAP_EXTENT_DATA_TAIL
+				| FIEMAP_EXTENT_NOT_ALIGNED;
+	int last = 0;
+
+	do {
+		size_t i;
+
+		amap->fm_length = bmap->fm_length = ~0ULL;
+		amap->fm_flags = bmap->fm_flags = sync ? FIEMAP_FLAG_SYNC : 0;
+		amap->fm_extent_count = bmap->fm_extent_count =
+			(sizeof(abuf) - sizeof(*amap)) / sizeof(struct fiemap_extent);
+
+		if (ioctl(fa, FS_IOC_FIEMAP, (unsigned long) amap) < 0)
+			return 0;
+		if (ioctl(fb, FS_IOC_FIEMAP, (unsigned long) bmap) < 0)
+			return 0;
+
+		if (amap->fm_mapped_extents == 0 ||
+		    amap->fm_mapped_extents != bmap->fm_mapped_extents)
+			return 0;
+
+		for (i = 0; i < amap->fm_mapped_extents; i++) {
+			struct fiemap_extent *a = &amap->fm_extents[i];
+			struct fiemap_extent *b = &bmap->fm_extents[i];
+
+			if (a->fe_logical != b->fe_logical ||
+			    a->fe_length !=  b->fe_length ||
+			    a->fe_physical != b->fe_physical)
+				return 0;
+			if (!(a->fe_flags & FIEMAP_EXTENT_SHARED) ||
+			    !(b->fe_flags & FIEMAP_EXTENT_SHARED))
+				return 0;
+			if ((a->fe_flags & unusable) || (b->fe_flags & unusable))
+				return 0;
+			if (a->fe_flags & FIEMAP_EXTENT_LAST)
+				last = 1;
+		}
+
+		bmap->fm_start = amap->fm_start =
+			amap->fm_extents[amap->fm_mapped_extents - 1].fe_logical +
+			amap->fm_extents[amap->fm_mapped_extents - 1].fe_length;
+	} while (last == 0);
+
+	return 1;
+#else
+	(void) fa, (void) fb, (void) sync;
 	return 0;
+#endif
 }
 
 void ul_fileeq_deinit(struct ul_fileeq *eq)
@@ -225,6 +366,7 @@ void ul_fileeq_data_deinit(struct ul_fileeq_data *data)
 	data->maxblocks = 0;
 	data->is_eof = 0;
 	data->name = NULL;
+	data->ra_end = 0;
 
 	ul_fileeq_data_close_file(data);
 }
@@ -310,8 +452,62 @@ static unsigned char *get_buffer(struct ul_fileeq *eq)
 				sizeof((_d)->intro) \
 				+ (get_cached_nblocks(_d) * (_e)->readsiz))
 
+static inline size_t get_readahead_size(struct ul_fileeq *eq)
+{
+	return max(eq->readahead, eq->readsiz);
+}
 
-static int get_fd(struct ul_fileeq *eq, struct ul_fileeq_data *data, off_t *off)
+/*
+ * Requests the next window when the read offset @off is in the second half of
+ * the already requested area (ends at @end), so the reads do not wait.
+ */
+static void readahead_file(struct ul_fileeq *eq, int fd, off_t off, off_t *end)
+{
+#if defined(POSIX_FADV_WILLNEED) && defined(HAVE_POSIX_FADVISE)
+	size_t len = get_readahead_size(eq);
+	off_t start = max(off, *end);
+	off_t last = off + len;
+
+	if (!eq->readahead || (uint64_t) start >= eq->filesiz
+	    || off + (off_t) (len / 2) < *end)
+		return;
+	if ((uint64_t) last > eq->filesiz)
+		last = eq->filesiz;
+
+	DBG(DATA, ul_debugobj(end, "readahead off=%ju len=%ju",
+				(uintmax_t) start, (uintmax_t) (last - start)));
+	ignore_result( posix_fadvise(fd, start, last - start, POSIX_FADV_WILLNEED) );
+	*end = last;
+#else
+	(void) eq, (void) fd, (void) off, (void) end;
+#endif
+}
+
+/*
+ * Requests the first window of the file @name. This is useful for the next
+ * file to compare, all the files may be read by the device at the same time.
+ * Call after ul_fileeq_set_size().
+ */
+int ul_fileeq_prefetch(struct ul_fileeq *eq, const char *name)
+{
+	off_t end = 0;
+	int fd;
+
+	if (!eq->readahead)
+		return 0;
+
+	fd = open(name, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	DBG(EQ, ul_debugobj(eq, "prefetch %s", name));
+	readahead_file(eq, fd, 0, &end);
+	close(fd);
+	return 0;
+}
+
+
+static int open_data(struct ul_fileeq *eq, struct ul_fileeq_data *data, off_t *off)
 {
 	off_t o = get_cached_offset(eq, data);
 
@@ -340,6 +536,18 @@ static int get_fd(struct ul_fileeq *eq, struct ul_fileeq_data *data, off_t *off)
 	return data->fd;
 }
 
+static int get_fd(struct ul_fileeq *eq, struct ul_fileeq_data *data, off_t *off)
+{
+	off_t o;
+	int fd = open_data(eq, data, &o);
+
+	if (fd >= 0)
+		readahead_file(eq, fd, o, &data->ra_end);
+	if (off)
+		*off = o;
+	return fd;
+}
+
 static void memcmp_reset(struct ul_fileeq *eq, struct ul_fileeq_data *data)
 {
 	/* only intro[] is cached */
@@ -454,6 +662,180 @@ static ssize_t get_digest(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 }
 #endif
 
+static ssize_t get_xxh_digest(struct ul_fileeq *eq, struct ul_fileeq_data *data,
+				size_t n, unsigned char **block)
+{
+	unsigned char *buf;
+	off_t off = 0;
+	ssize_t rsz;
+	int fd;
+
+	if (n > eq->blocksmax)
+		return 0;
+
+	/* return already cached if available */
+	if (n < get_cached_nblocks(data)) {
+		DBG(DATA, ul_debugobj(data, " digest cached"));
+		assert(data->blocks);
+		*block = data->blocks + (n * eq->method->digsiz);
+		return eq->method->digsiz;
+	}
+
+	if (data->is_eof) {
+		DBG(DATA, ul_debugobj(data, " file EOF"));
+		return 0;
+	}
+
+	fd = get_fd(eq, data, &off);
+	if (fd < 0)
+		return fd;
+
+	DBG(DATA, ul_debugobj(data, " hash block off=%ju", (uintmax_t) off));
+
+	if (!data->blocks) {
+		DBG(DATA, ul_debugobj(data, "  alloc cache %" PRIu64,
+					eq->blocksmax * eq->method->digsiz));
+		data->blocks = malloc(eq->blocksmax * eq->method->digsiz);
+		if (!data->blocks)
+			return -ENOMEM;
+	}
+
+	buf = get_buffer(eq);
+	if (!buf)
+		return -ENOMEM;
+
+	rsz = read_all(fd, (char *) buf, eq->readsiz);
+	if (rsz < 0)
+		return rsz;
+	off += rsz;
+
+	*block = data->blocks + (n * eq->method->digsiz);
+	if (eq->method->id == UL_FILEEQ_XXH3) {
+		XXH64_hash_t h = XXH3_64bits(buf, rsz);
+		memcpy(*block, &h, sizeof(h));
+	} else {
+		XXH128_hash_t h = XXH3_128bits(buf, rsz);
+		memcpy(*block, &h, sizeof(h));
+	}
+#ifdef TEST_PROGRAM_FILEEQ
+	if (fileeq_collide)
+		memset(*block, 0, eq->method->digsiz);
+#endif
+	data->nblocks++;
+
+	if (rsz == 0 || (uint64_t) off >= eq->filesiz) {
+		data->is_eof = 1;
+		ul_fileeq_data_close_file(data);
+	}
+	DBG(DATA, ul_debugobj(data, "  hashed %zu bytes", rsz));
+	return eq->method->digsiz;
+}
+
+/* compare all content by memcmp(), independently on data cache */
+static int verify_content(struct ul_fileeq *eq,
+			  struct ul_fileeq_data *a, struct ul_fileeq_data *b)
+{
+	off_t off = 0, ra_end_a = 0, ra_end_b = 0;
+	int fa, fb, rc = 0;
+
+	DBG(EQ, ul_debugobj(eq, "verify %s %s", a->name, b->name));
+
+	if (!get_buffer(eq))
+		return 0;
+
+	fa = open(a->name, O_RDONLY | O_CLOEXEC);
+	fb = open(b->name, O_RDONLY | O_CLOEXEC);
+	if (fa < 0 || fb < 0)
+		goto done;
+
+	do {
+		ssize_t ca, cb;
+
+		readahead_file(eq, fa, off, &ra_end_a);
+		readahead_file(eq, fb, off, &ra_end_b);
+
+		ca = read_all(fa, (char *) eq->buf_a, eq->readsiz);
+		cb = read_all(fb, (char *) eq->buf_b, eq->readsiz);
+
+		if (ca < 0 || ca != cb)
+			goto done;
+		if (ca == 0)
+			break;
+		if (memcmp(eq->buf_a, eq->buf_b, ca) != 0)
+			goto done;
+		off += ca;
+	} while (1);
+
+	rc = 1;
+done:
+	if (fa >= 0)
+		close(fa);
+	if (fb >= 0)
+		close(fb);
+	DBG(EQ, ul_debugobj(eq, " verify %s", rc ? "success" : "failed"));
+	return rc;
+}
+
+/*
+ * Returns size of one block digest, or 0 if the method does not use digests
+ * (memcmp).
+ */
+size_t ul_fileeq_get_digsiz(struct ul_fileeq *eq)
+{
+	return eq->method->digsiz;
+}
+
+/*
+ * Returns number of the already calculated block digests (the intro is not
+ * counted) or -1 if the file has not been read yet or the method does not use
+ * digests. The digests and data->intro[] may be stored by application and
+ * used later by ul_fileeq_data_set_digests() for the same (unmodified) file
+ * and the same read size.
+ */
+ssize_t ul_fileeq_data_get_digests(struct ul_fileeq *eq,
+				   struct ul_fileeq_data *data,
+				   const unsigned char **digests)
+{
+	if (!eq->method->digsiz || data->nblocks == 0)
+		return -1;
+
+	*digests = data->blocks;
+	return get_cached_nblocks(data);
+}
+
+/*
+ * Initialize the data cache by previously calculated intro[] and digests.
+ * The @eof means that the digests cover the whole file. Note that sizes have
+ * to be already set by ul_fileeq_set_size().
+ */
+int ul_fileeq_data_set_digests(struct ul_fileeq *eq,
+			       struct ul_fileeq_data *data,
+			       const unsigned char *intro,
+			       const unsigned char *digests, size_t ndigests,
+			       bool eof)
+{
+	if (!eq->method->digsiz || ndigests > eq->blocksmax)
+		return -EINVAL;
+
+	if (!data->blocks) {
+		data->blocks = malloc(eq->blocksmax * eq->method->digsiz);
+		if (!data->blocks)
+			return -ENOMEM;
+	}
+
+	DBG(DATA, ul_debugobj(data, "preset %zu digests%s", ndigests,
+				eof ? " [EOF]" : ""));
+
+	memcpy(data->intro, intro, sizeof(data->intro));
+	if (ndigests)
+		memcpy(data->blocks, digests, ndigests * eq->method->digsiz);
+	data->nblocks = ndigests + 1;
+	data->is_eof = eof;
+
+	ul_fileeq_data_close_file(data);
+	return 0;
+}
+
 static ssize_t get_intro(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 				unsigned char **block)
 {
@@ -486,6 +868,9 @@ static ssize_t get_cmp_data(struct ul_fileeq *eq, struct ul_fileeq_data *data,
 	switch (eq->method->id) {
 	case UL_FILEEQ_MEMCMP:
 		return read_block(eq, data, blockno, block);
+	case UL_FILEEQ_XXH3:
+	case UL_FILEEQ_XXH128:
+		return get_xxh_digest(eq, data, blockno, block);
 	default:
 		break;
 	}
@@ -506,6 +891,15 @@ int ul_fileeq(struct ul_fileeq *eq,
 
 	DBG(EQ, ul_debugobj(eq, "--> compare %s %s", a->name, b->name));
 
+	if (eq->extents) {
+		int fa = open_data(eq, a, NULL), fb = open_data(eq, b, NULL);
+
+		if (fa >= 0 && fb >= 0 && ul_fileeq_same_extents(fa, fb, false)) {
+			DBG(EQ, ul_debugobj(eq, "<-- MATCH (shared extents)"));
+			return 1;
+		}
+	}
+
 	if (eq->method->id == UL_FILEEQ_MEMCMP) {
 		memcmp_reset(eq, a);
 		memcmp_reset(eq, b);
@@ -537,6 +931,10 @@ int ul_fileeq(struct ul_fileeq *eq,
 		if (!a->is_eof || !b->is_eof)
 			goto done; /* filesize chnaged? */
 
+		if (eq->verify && eq->method->id != UL_FILEEQ_MEMCMP
+		    && !verify_content(eq, a, b))
+			goto done;
+
 		DBG(EQ, ul_debugobj(eq, "<-- MATCH"));
 		return 1;
 	}
@@ -554,8 +952,13 @@ int main(int argc, char *argv[])
 	struct ul_fileeq eq;
 	struct ul_fileeq_data a, b, c;
 	const char *method = "sha1";
+	size_t readahead = UL_FILEEQ_READAHEAD;
+	bool verify = false;
 	static const struct option longopts[] = {
 		{ "method", required_argument, NULL, 'm' },
+		{ "readahead", required_argument, NULL, 'r' },
+		{ "verify", no_argument, NULL, 'v' },
+		{ "collide", no_argument, NULL, 'C' },
 		{ "help", no_argument, NULL, 'h' },
 		{ NULL, 0, NULL, 0 }
 	};
@@ -563,14 +966,26 @@ int main(int argc, char *argv[])
 	const char *file_a = NULL, *file_b = NULL, *file_c = NULL;
 	struct stat st_a, st_b, st_c;
 
-	while ((ch = getopt_long(argc, argv, "m:", longopts, NULL)) != -1) {
+	while ((ch = getopt_long(argc, argv, "m:r:vC", longopts, NULL)) != -1) {
 		switch (ch) {
 		case 'm':
 			method = optarg;
 			break;
+		case 'r':
+			readahead = strtoul(optarg, NULL, 10);
+			break;
+		case 'v':
+			verify = true;
+			break;
+		case 'C':
+			fileeq_collide = true;
+			break;
 		case 'h':
 			printf("usage: %s [options] <file> <file>\n"
-				" -m, --method <memcmp|sha1|crc32>    compare method\n",
+				" -m, --method <memcmp|xxh3|xxh128|sha1|crc32>    compare method\n"
+				" -r, --readahead <bytes>                         readahead window, 0 to disable\n"
+				" -v, --verify                                    confirm digests match by memcmp\n"
+				" -C, --collide                                   use the same digest for all xxh3 blocks\n",
 				program_invocation_short_name);
 			return EXIT_FAILURE;
 		}
@@ -606,6 +1021,8 @@ int main(int argc, char *argv[])
 	}
 	if (rc < 0)
 		err(EXIT_FAILURE, "failed to initialize files comparior");
+	ul_fileeq_set_readahead(&eq, readahead);
+	ul_fileeq_set_verify(&eq, verify);
 
 	ul_fileeq_data_set_file(&a, file_a);
 	ul_fileeq_data_set_file(&b, file_b);
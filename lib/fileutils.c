@@ -133,6 +133,32 @@ unsigned int get_fd_tabsize(void)
 	return m;
 }
 
+/*
+ * Raises the soft RLIMIT_NOFILE limit (up to the hard limit) to allow
+ * at least @nfds open file descriptors.
+ *
+ * Returns: 0 if the limit is (or has been made) sufficient, -1 otherwise.
+ */
+int ul_raise_fd_limit(size_t nfds)
+{
+#if defined(HAVE_GETRLIMIT) && defined(RLIMIT_NOFILE)
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) != 0)
+		return -1;
+	if (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur >= nfds)
+		return 0;
+
+	rl.rlim_cur = rl.rlim_max == RLIM_INFINITY || rl.rlim_max >= nfds ?
+				(rlim_t) nfds : rl.rlim_max;
+	if (setrlimit(RLIMIT_NOFILE, &rl) != 0)
+		return -1;
+	return rl.rlim_cur >= nfds ? 0 : -1;
+#else
+	return get_fd_tabsize() >= nfds ? 0 : -1;
+#endif
+}
+
 void ul_close_all_fds(unsigned int first, unsigned int last)
 {
 	struct dirent *d;
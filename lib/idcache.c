@@ -3,6 +3,11 @@
  * it what you wish.
  *
  * Written by Karel Zak <kzak@redhat.com>
+ *
+ * The entries are in a hash table. The IDs without a name are cached too
+ * (with the number as the name), so every ID is resolved by NSS only once.
+ * After IDCACHE_PREFETCH_MISSES lookups the whole passwd or group database
+ * is read by one getpwent() or getgrent() pass.
  */
 #include <wchar.h>
 #include <pwd.h>
@@ -12,14 +17,24 @@
 #include "c.h"
 #include "idcache.h"
 
+#define IDCACHE_MINBUCKETS		64
+#define IDCACHE_PREFETCH_MISSES	128
+
+static inline size_t hash_id(unsigned long int id)
+{
+	uint64_t h = (uint64_t) id * 0x9E3779B97F4A7C15ULL;
+
+	return (size_t) (h >> 32);
+}
+
 struct identry *get_id(struct idcache *ic, unsigned long int id)
 {
 	struct identry *ent;
 
-	if (!ic)
+	if (!ic || !ic->nbuckets)
 		return NULL;
 
-	for (ent = ic->ent; ent; ent = ent->next) {
+	for (ent = ic->buckets[hash_id(id) & (ic->nbuckets - 1)]; ent; ent = ent->hnext) {
 		if (ent->id == id)
 			return ent;
 	}
@@ -48,20 +63,47 @@ void free_idcache(struct idcache *ic)
 		ent = next;
 	}
 
+	free(ic->buckets);
 	free(ic);
 }
 
-static void add_id(struct idcache *ic, char *name, unsigned long int id)
+/* doubles the number of buckets, the entries are re-linked */
+static int grow_idcache(struct idcache *ic)
 {
-	struct identry *ent, *x;
+	size_t nbuckets = ic->nbuckets ? ic->nbuckets * 2 : IDCACHE_MINBUCKETS;
+	struct identry **buckets, *ent;
+
+	buckets = calloc(nbuckets, sizeof(struct identry *));
+	if (!buckets)
+		return -1;
+
+	for (ent = ic->ent; ent; ent = ent->next) {
+		size_t i = hash_id(ent->id) & (nbuckets - 1);
+
+		ent->hnext = buckets[i];
+		buckets[i] = ent;
+	}
+
+	free(ic->buckets);
+	ic->buckets = buckets;
+	ic->nbuckets = nbuckets;
+	return 0;
+}
+
+static struct identry *new_id(struct idcache *ic, const char *name, unsigned long int id)
+{
+	struct identry *ent;
+	size_t i;
 	int w = 0;
 
 	if (!ic)
-		return;
+		return NULL;
+	if (ic->nents >= ic->nbuckets && grow_idcache(ic) != 0 && !ic->nbuckets)
+		return NULL;
 
 	ent = calloc(1, sizeof(struct identry));
 	if (!ent)
-		return;
+		return NULL;
 	ent->id = id;
 
 	if (name) {
@@ -82,44 +124,102 @@ static void add_id(struct idcache *ic, char *name, unsigned long int id)
 		ent->name = strdup(name);
 		if (!ent->name) {
 			free(ent);
-			return;
+			return NULL;
 		}
 	} else {
 		if (asprintf(&ent->name, "%lu", id) < 0) {
 			free(ent);
-			return;
+			return NULL;
 		}
 	}
 
-	for (x = ic->ent; x && x->next; x = x->next);
-
-	if (x)
-		x->next = ent;
-	else
-		ic->ent = ent;
-
 	if (w <= 0)
 		w = ent->name ? strlen(ent->name) : 0;
-	ic->width = ic->width < w ? w : ic->width;
+	ent->width = w;
+
+	ent->next = ic->ent;
+	ic->ent = ent;
+
+	i = hash_id(id) & (ic->nbuckets - 1);
+	ent->hnext = ic->buckets[i];
+	ic->buckets[i] = ent;
+	ic->nents++;
+
+	return ent;
+}
+
+/* the name of the entry is used, count it to the cache width */
+static void use_id(struct idcache *ic, struct identry *ent)
+{
+	if (ent)
+		ic->width = ic->width < ent->width ? ent->width : ic->width;
+}
+
+struct identry *add_id(struct idcache *ic, const char *name, unsigned long int id)
+{
+	struct identry *ent = new_id(ic, name, id);
+
+	use_id(ic, ent);
+	return ent;
+}
+
+static void prefetch_uids(struct idcache *ic)
+{
+	struct passwd *pw;
+
+	ic->prefetched = 1;
+
+	setpwent();
+	while ((pw = getpwent())) {
+		if (!get_id(ic, pw->pw_uid))
+			new_id(ic, pw->pw_name, pw->pw_uid);
+	}
+	endpwent();
+}
+
+static void prefetch_gids(struct idcache *ic)
+{
+	struct group *gr;
+
+	ic->prefetched = 1;
+
+	setgrent();
+	while ((gr = getgrent())) {
+		if (!get_id(ic, gr->gr_gid))
+			new_id(ic, gr->gr_name, gr->gr_gid);
+	}
+	endgrent();
 }
 
 void add_uid(struct idcache *cache, unsigned long int id)
 {
 	struct identry *ent = get_id(cache, id);
 
+	if (!ent && cache && !cache->prefetched
+	    && ++cache->nmisses > IDCACHE_PREFETCH_MISSES) {
+		prefetch_uids(cache);
+		ent = get_id(cache, id);
+	}
 	if (!ent) {
+		/* not enumerated, or not in database at all */
 		struct passwd *pw = getpwuid((uid_t) id);
-		add_id(cache, pw ? pw->pw_name : NULL, id);
+		ent = new_id(cache, pw ? pw->pw_name : NULL, id);
 	}
+	use_id(cache, ent);
 }
 
 void add_gid(struct idcache *cache, unsigned long int id)
 {
 	struct identry *ent = get_id(cache, id);
 
+	if (!ent && cache && !cache->prefetched
+	    && ++cache->nmisses > IDCACHE_PREFETCH_MISSES) {
+		prefetch_gids(cache);
+		ent = get_id(cache, id);
+	}
 	if (!ent) {
 		struct group *gr = getgrgid((gid_t) id);
-		add_id(cache, gr ? gr->gr_name : NULL, id);
+		ent = new_id(cache, gr ? gr->gr_name : NULL, id);
 	}
+	use_id(cache, ent);
 }
-
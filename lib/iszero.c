@@ -0,0 +1,269 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * Detection of zero-filled buffers (sparse files, padding of on-disk
+ * structures). The buffer is checked by the widest vector instructions
+ * supported by the CPU; SSE2 and NEON are baseline on x86_64 and aarch64,
+ * AVX2 is detected at runtime.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "c.h"
+#include "iszero.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+# include <immintrin.h>
+# define HAVE_ISZERO_SSE2	1
+# define HAVE_ISZERO_AVX2	1
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+# include <arm_neon.h>
+# define HAVE_ISZERO_NEON	1
+#endif
+
+static int is_zero_bytes(const unsigned char *p, size_t sz)
+{
+	while (sz--) {
+		if (*p++)
+			return 0;
+	}
+	return 1;
+}
+
+static int is_zero_generic(const unsigned char *p, size_t sz)
+{
+	/* bytes up to the word alignment */
+	while (sz && ((uintptr_t) p % sizeof(uintptr_t))) {
+		if (*p++)
+			return 0;
+		sz--;
+	}
+
+	for (; sz >= 4 * sizeof(uintptr_t); sz -= 4 * sizeof(uintptr_t)) {
+		const uintptr_t *w = (const uintptr_t *) p;
+
+		if (w[0] | w[1] | w[2] | w[3])
+			return 0;
+		p += 4 * sizeof(uintptr_t);
+	}
+	return is_zero_bytes(p, sz);
+}
+
+#ifdef HAVE_ISZERO_SSE2
+static int is_zero_sse2(const unsigned char *p, size_t sz)
+{
+	size_t head = (16 - (uintptr_t) p % 16) % 16;
+
+	if (sz < 64 + head)
+		return is_zero_generic(p, sz);
+	if (!is_zero_bytes(p, head))
+		return 0;
+	p += head, sz -= head;
+
+	for (; sz >= 64; sz -= 64, p += 64) {
+		const __m128i *v = (const __m128i *) p;
+		__m128i x = _mm_or_si128(_mm_or_si128(_mm_load_si128(v), _mm_load_si128(v + 1)),
+					 _mm_or_si128(_mm_load_si128(v + 2), _mm_load_si128(v + 3)));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_setzero_si128())) != 0xffff)
+			return 0;
+	}
+	return is_zero_generic(p, sz);
+}
+#endif
+
+#ifdef HAVE_ISZERO_AVX2
+static __attribute__((__target__("avx2")))
+int is_zero_avx2(const unsigned char *p, size_t sz)
+{
+	size_t head = (32 - (uintptr_t) p % 32) % 32;
+
+	if (sz < 128 + head)
+		return is_zero_sse2(p, sz);
+	if (!is_zero_bytes(p, head))
+		return 0;
+	p += head, sz -= head;
+
+	for (; sz >= 128; sz -= 128, p += 128) {
+		const __m256i *v = (const __m256i *) p;
+		__m256i x = _mm256_or_si256(_mm256_or_si256(_mm256_load_si256(v), _mm256_load_si256(v + 1)),
+					    _mm256_or_si256(_mm256_load_si256(v + 2), _mm256_load_si256(v + 3)));
+
+		if (!_mm256_testz_si256(x, x))
+			return 0;
+	}
+	return is_zero_sse2(p, sz);
+}
+#endif
+
+#ifdef HAVE_ISZERO_NEON
+static int is_zero_neon(const unsigned char *p, size_t sz)
+{
+	for (; sz >= 64; sz -= 64, p += 64) {
+		uint8x16_t x = vorrq_u8(vorrq_u8(vld1q_u8(p), vld1q_u8(p + 16)),
+					vorrq_u8(vld1q_u8(p + 32), vld1q_u8(p + 48)));
+
+		if (vmaxvq_u8(x))
+			return 0;
+	}
+	return is_zero_generic(p, sz);
+}
+#endif
+
+/*
+ * Returns: 1 if all @bufsz bytes of @buf are zero (or @bufsz is zero), else 0.
+ */
+int ul_buffer_is_zero(const void *buf, size_t bufsz)
+{
+#if defined(HAVE_ISZERO_NEON)
+	return is_zero_neon(buf, bufsz);
+#elif defined(HAVE_ISZERO_SSE2)
+# ifdef HAVE_ISZERO_AVX2
+	if (__builtin_cpu_supports("avx2"))
+		return is_zero_avx2(buf, bufsz);
+# endif
+	return is_zero_sse2(buf, bufsz);
+#else
+	return is_zero_generic(buf, bufsz);
+#endif
+}
+
+#ifdef TEST_PROGRAM_ISZERO
+# include <getopt.h>
+# include <stdlib.h>
+# include <time.h>
+
+typedef int (*iszero_fn)(const unsigned char *, size_t);
+
+static const struct {
+	const char	*name;
+	iszero_fn	fn;
+} kernels[] = {
+	{ "generic", is_zero_generic },
+#ifdef HAVE_ISZERO_SSE2
+	{ "sse2", is_zero_sse2 },
+#endif
+#ifdef HAVE_ISZERO_AVX2
+	{ "avx2", is_zero_avx2 },
+#endif
+#ifdef HAVE_ISZERO_NEON
+	{ "neon", is_zero_neon },
+#endif
+};
+
+static int kernel_supported(size_t i)
+{
+#ifdef HAVE_ISZERO_AVX2
+	if (kernels[i].fn == is_zero_avx2)
+		return __builtin_cpu_supports("avx2");
+#endif
+	return 1;
+}
+
+/* every size and alignment up to @max with zero or one nonzero byte */
+static int test_kernel(size_t k, size_t max)
+{
+	unsigned char *buf = calloc(1, max + 64 + 1);
+	size_t off, sz, i;
+	int rc = 0;
+
+	if (!buf)
+		err(EXIT_FAILURE, "cannot allocate buffer");
+
+	for (off = 0; off < 64 && !rc; off++) {
+		for (sz = 0; sz <= max && !rc; sz++) {
+			unsigned char *p = buf + off;
+
+			/* the bytes around the buffer must be ignored */
+			if (off)
+				p[-1] = 0xff;
+			p[sz] = 0xff;
+
+			if (!kernels[k].fn(p, sz)) {
+				warnx("%s: off=%zu size=%zu: zero buffer not detected",
+					kernels[k].name, off, sz);
+				rc = 1;
+			}
+			for (i = 0; i < sz && !rc; i++) {
+				p[i] = 1 << (i % 8);
+				if (kernels[k].fn(p, sz)) {
+					warnx("%s: off=%zu size=%zu: byte %zu not detected",
+						kernels[k].name, off, sz, i);
+					rc = 1;
+				}
+				p[i] = 0;
+			}
+			if (off)
+				p[-1] = 0;
+			p[sz] = 0;
+		}
+	}
+	free(buf);
+	return rc;
+}
+
+static void bench_kernel(size_t k, size_t sz, size_t loops)
+{
+	unsigned char *buf = calloc(1, sz);
+	struct timespec a, b;
+	double sec;
+	size_t i;
+	int x = 0;
+
+	if (!buf)
+		err(EXIT_FAILURE, "cannot allocate buffer");
+
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	for (i = 0; i < loops; i++)
+		x += kernels[k].fn(buf, sz);
+	clock_gettime(CLOCK_MONOTONIC, &b);
+
+	sec = (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) / 1e9;
+	printf("%-8s %8.2f GiB/s (%d)\n", kernels[k].name,
+		(double) sz * loops / sec / (1 << 30), x == (int) loops);
+	free(buf);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option longopts[] = {
+		{ "bench",   required_argument, NULL, 'b' },
+		{ "verbose", no_argument,       NULL, 'v' },
+		{ NULL, 0, NULL, 0 },
+	};
+	size_t bench = 0, k;
+	int c, rc = 0, verbose = 0;
+
+	while ((c = getopt_long(argc, argv, "b:v", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'b':
+			bench = strtoul(optarg, NULL, 10);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [--verbose] [--bench <size>]\n",
+					program_invocation_short_name);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (k = 0; k < ARRAY_SIZE(kernels); k++) {
+		if (!kernel_supported(k))
+			continue;
+		if (bench)
+			bench_kernel(k, bench, (1UL << 32) / bench + 1);
+		else if (test_kernel(k, 300) != 0)
+			rc = 1;
+		else if (verbose)
+			printf("%s: ok\n", kernels[k].name);
+	}
+
+	if (!bench && !ul_buffer_is_zero("\0\0\0", 3))
+		rc = 1;
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM_ISZERO */
@@ -7,6 +7,7 @@
  * Written by Karel Zak <kzak@redhat.com>
  */
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 #include <ctype.h>
 #include <cctype.h>
@@ -26,14 +27,75 @@
  *	}
  * }
  */
+
+/*
+ * Word-at-a-time check for bytes which need escaping in JSON strings: control
+ * characters (< 0x20), '"' and '\\'. See "Bit Twiddling Hacks" for the
+ * has-zero-byte and has-less-than tricks.
+ */
+#define JSON_ONES	((uint64_t) 0x0101010101010101ULL)
+#define JSON_HIGHS	((uint64_t) 0x8080808080808080ULL)
+
+static inline int word_has_zero(uint64_t x)
+{
+	return ((x - JSON_ONES) & ~x & JSON_HIGHS) != 0;
+}
+
+static inline int word_needs_escape(uint64_t x)
+{
+	return word_has_zero(x ^ (JSON_ONES * '"'))
+	       || word_has_zero(x ^ (JSON_ONES * '\\'))
+	       || ((x - JSON_ONES * 0x20) & ~x & JSON_HIGHS) != 0;
+}
+
+static inline int char_needs_escape(unsigned char c)
+{
+	return c < 0x20 || c == '"' || c == '\\';
+}
+
+/* returns pointer to the first char which needs escaping in <p, end) */
+static const char *skip_json_safe(const char *p, const char *end)
+{
+	while ((size_t)(end - p) >= sizeof(uint64_t)) {
+		uint64_t x;
+
+		memcpy(&x, p, sizeof(x));
+		if (word_needs_escape(x))
+			break;
+		p += sizeof(x);
+	}
+	while (p < end && !char_needs_escape((unsigned char) *p))
+		p++;
+	return p;
+}
+
 static void fputs_quoted_case_json(const char *data, FILE *out, int dir, size_t size)
 {
-	const char *p;
+	const char *p, *end = NULL;
 
 	fputc('"', out);
+
+	/* fast path: copy runs of chars which do not need any conversion */
+	if (data && dir == 0) {
+		end = data + (size ? strnlen(data, size) : strlen(data));
+		size = end - data;
+	}
+
 	for (p = data; p && *p && (!size || p < data + size); p++) {
 
-		const unsigned int c = (unsigned int) *p;
+		unsigned int c;
+
+		if (end) {
+			const char *safe = skip_json_safe(p, end);
+
+			if (safe > p) {
+				fwrite(p, 1, safe - p, out);
+				p = safe - 1;
+				continue;
+			}
+		}
+
+		c = (unsigned int) *p;
 
 		/* From http://www.json.org
 		 *
@@ -107,6 +169,16 @@ void ul_jsonwrt_init(struct ul_jsonwrt *fmt, FILE *out, int indent)
 	fmt->out = out;
 	fmt->indent = indent;
 	fmt->after_close = 0;
+	fmt->compact = 0;
+}
+
+/*
+ * The compact output is without newlines and indentation; the complete
+ * root object is printed on one line (e.g. for JSON Lines streams).
+ */
+void ul_jsonwrt_set_compact(struct ul_jsonwrt *fmt, int enable)
+{
+	fmt->compact = enable ? 1 : 0;
 }
 
 int ul_jsonwrt_is_ready(struct ul_jsonwrt *fmt)
@@ -118,6 +190,8 @@ void ul_jsonwrt_indent(struct ul_jsonwrt *fmt)
 {
 	int i;
 
+	if (fmt->compact)
+		return;
 	for (i = 0; i < fmt->indent; i++)
 		fputs("   ", fmt->out);
 }
@@ -126,7 +200,7 @@ static void print_name(struct ul_jsonwrt *fmt, const char *name)
 {
 	if (name) {
 		if (fmt->after_close)
-			fputs(",\n", fmt->out);
+			fputs(fmt->compact ? "," : ",\n", fmt->out);
 		ul_jsonwrt_indent(fmt);
 		fputs_quoted_json_lower(name, fmt->out);
 	} else {
@@ -143,11 +217,15 @@ void ul_jsonwrt_open(struct ul_jsonwrt *fmt, const char *name, int type)
 
 	switch (type) {
 	case UL_JSON_OBJECT:
-		fputs(name ? ": {\n" : "{\n", fmt->out);
+		fputs(name ? ": {" : "{", fmt->out);
+		if (!fmt->compact)
+			fputc('\n', fmt->out);
 		fmt->indent++;
 		break;
 	case UL_JSON_ARRAY:
-		fputs(name ? ": [\n" : "[\n", fmt->out);
+		fputs(name ? ": [" : "[", fmt->out);
+		if (!fmt->compact)
+			fputc('\n', fmt->out);
 		fmt->indent++;
 		break;
 	case UL_JSON_VALUE:
@@ -183,7 +261,8 @@ void ul_jsonwrt_close(struct ul_jsonwrt *fmt, int type)
 	switch (type) {
 	case UL_JSON_OBJECT:
 		fmt->indent--;
-		fputc('\n', fmt->out);
+		if (!fmt->compact)
+			fputc('\n', fmt->out);
 		ul_jsonwrt_indent(fmt);
 		fputs("}", fmt->out);
 		if (fmt->indent == 0)
@@ -191,7 +270,8 @@ void ul_jsonwrt_close(struct ul_jsonwrt *fmt, int type)
 		break;
 	case UL_JSON_ARRAY:
 		fmt->indent--;
-		fputc('\n', fmt->out);
+		if (!fmt->compact)
+			fputc('\n', fmt->out);
 		ul_jsonwrt_indent(fmt);
 		fputs("]", fmt->out);
 		break;
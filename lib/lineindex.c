@@ -0,0 +1,170 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * Line index for the pagers. The file is scanned by pread() and memchr()
+ * on demand, only as far as the requested line, and the offset of every
+ * UL_LINEIDX_STEP-th line is kept. A line is found by a lookup of the
+ * nearest checkpoint and a scan of at most UL_LINEIDX_STEP lines. The file
+ * offset of @fd is not modified, so the file may be read by stdio at the same
+ * time.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "c.h"
+#include "xalloc.h"
+#include "lineindex.h"
+
+#define LINEIDX_BUFSIZ	(64 * 1024)
+
+void ul_init_lineidx(struct ul_lineidx *li, int fd)
+{
+	memset(li, 0, sizeof(*li));
+	li->fd = fd;
+}
+
+void ul_free_lineidx(struct ul_lineidx *li)
+{
+	free(li->offsets);
+	ul_init_lineidx(li, -1);
+}
+
+static void add_checkpoint(struct ul_lineidx *li, off_t offset)
+{
+	if (li->noffsets == li->size) {
+		li->size = li->size ? li->size * 2 : 1024;
+		li->offsets = xreallocarray(li->offsets, li->size, sizeof(off_t));
+	}
+	li->offsets[li->noffsets++] = offset;
+}
+
+/*
+ * Scans from @*offset for @*nlines newlines. Returns 0 and @offset behind the
+ * last newline, or 1 at end of the file with @nlines the number of found
+ * newlines and @offset at the end of the file; the file is indexed if @index
+ * is set. Returns negative errno on error.
+ */
+static int scan_lines(struct ul_lineidx *li, off_t *offset, size_t *nlines, int index)
+{
+	char *buf = xmalloc(LINEIDX_BUFSIZ);
+	size_t want = *nlines, n = 0;
+	off_t off = *offset;
+	int rc = 0;
+
+	while (n < want) {
+		ssize_t sz = pread(li->fd, buf, LINEIDX_BUFSIZ, off);
+		char *p = buf, *end;
+
+		if (sz < 0 && errno == EINTR)
+			continue;
+		if (sz < 0) {
+			rc = -errno;
+			break;
+		}
+		if (sz == 0) {
+			rc = 1;
+			break;
+		}
+		end = buf + sz;
+
+		while (n < want && (p = memchr(p, '\n', end - p))) {
+			p++;
+			n++;
+			if (index && ++li->nlines % UL_LINEIDX_STEP == 0)
+				add_checkpoint(li, off + (p - buf));
+		}
+		if (n == want)
+			off += p - buf;
+		else
+			off += sz;
+		if (index)
+			li->scanned = off;
+	}
+
+	free(buf);
+	if (rc >= 0) {
+		*offset = off;
+		*nlines = n;
+	}
+	return rc;
+}
+
+/*
+ * Finds the start of the line @*line (the first line is zero). If the file
+ * has less lines, then @line is set to the number of the newlines in the file
+ * and @offset to the end of the file.
+ *
+ * Returns: 0 on success, negative errno on error (e.g. not seekable file).
+ */
+int ul_lineidx_seek(struct ul_lineidx *li, size_t *line, off_t *offset)
+{
+	size_t n, want = *line;
+	off_t off;
+	int rc;
+
+	if (li->fd < 0)
+		return -EINVAL;
+	if (!li->noffsets)
+		add_checkpoint(li, 0);
+
+	/* index the file up to the checkpoint before the line */
+	if (want / UL_LINEIDX_STEP >= li->noffsets) {
+		off = li->scanned;
+		n = (want / UL_LINEIDX_STEP) * UL_LINEIDX_STEP - li->nlines;
+		rc = scan_lines(li, &off, &n, 1);
+		if (rc < 0)
+			return rc;
+		if (rc == 1) {
+			/* the file is shorter */
+			*line = li->nlines;
+			*offset = off;
+			return 0;
+		}
+	}
+
+	/* scan from the checkpoint */
+	off = li->offsets[want / UL_LINEIDX_STEP];
+	n = want % UL_LINEIDX_STEP;
+	rc = scan_lines(li, &off, &n, 0);
+	if (rc < 0)
+		return rc;
+
+	*line = want - (want % UL_LINEIDX_STEP) + n;
+	*offset = off;
+	return 0;
+}
+
+#ifdef TEST_PROGRAM_LINEINDEX
+#include <fcntl.h>
+#include <stdio.h>
+
+int main(int argc, char *argv[])
+{
+	struct ul_lineidx li;
+	int fd, i;
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <file> <line> [...]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	fd = open(argv[1], O_RDONLY);
+	if (fd < 0)
+		err(EXIT_FAILURE, "cannot open %s", argv[1]);
+
+	ul_init_lineidx(&li, fd);
+	for (i = 2; i < argc; i++) {
+		size_t line = strtoul(argv[i], NULL, 10);
+		off_t off;
+
+		if (ul_lineidx_seek(&li, &line, &off) != 0)
+			err(EXIT_FAILURE, "%s: seek failed", argv[1]);
+		printf("line %zu: offset %jd\n", line, (intmax_t) off);
+	}
+	ul_free_lineidx(&li);
+	close(fd);
+	return EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM_LINEINDEX */
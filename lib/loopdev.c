@@ -120,6 +120,7 @@ int loopcxt_set_device(struct loopdev_cxt *lc, const char *device)
 	lc->devno = 0;
 	lc->mode = O_RDONLY;
 	lc->blocksize = 0;
+	lc->autotune = 0;
 	lc->has_info = 0;
 	lc->info_failed = 0;
 	*lc->device = '\0';
@@ -1214,6 +1215,27 @@ int loopcxt_set_blocksize(struct loopdev_cxt *lc, uint64_t blocksize)
 	return 0;
 }
 
+/*
+ * @lc: context
+ * @enable: TRUE or FALSE
+ *
+ * Enables direct I/O and the logical block size for the backing file by
+ * loopcxt_setup_device(). See loopcxt_autotune().
+ *
+ * The setting is removed by loopcxt_set_device() loopcxt_next()!
+ *
+ * Returns: 0 on success, <0 on error.
+ */
+int loopcxt_set_autotune(struct loopdev_cxt *lc, int enable)
+{
+	if (!lc)
+		return -EINVAL;
+	lc->autotune = enable ? 1 : 0;
+
+	DBG(CXT, ul_debugobj(lc, "set autotune=%s", enable ? "on" : "off"));
+	return 0;
+}
+
 /*
  * @lc: context
  * @flags: kernel LO_FLAGS_{READ_ONLY,USE_AOPS,AUTOCLEAR} flags
@@ -1369,6 +1391,76 @@ static int loopcxt_check_size(struct loopdev_cxt *lc, int file_fd)
 }
 
 
+/*
+ * Returns the direct I/O alignment of the backing file: from statx() on
+ * kernels with STATX_DIOALIGN, otherwise the logical sector size of the
+ * backing block device. Returns 0 if direct I/O is not supported or unknown.
+ */
+static uint32_t get_dio_alignment(const char *filename)
+{
+	struct path_cxt *pc;
+	struct stat st;
+	dev_t disk = 0;
+	uint64_t ssz = 0;
+
+#if defined(HAVE_STATX) && defined(HAVE_STRUCT_STATX) && defined(STATX_DIOALIGN)
+	{
+		struct statx stx;
+
+		if (statx(AT_FDCWD, filename, 0, STATX_DIOALIGN, &stx) == 0
+		    && (stx.stx_mask & STATX_DIOALIGN))
+			return stx.stx_dio_offset_align;
+	}
+#endif
+	if (stat(filename, &st) != 0)
+		return 0;
+	if (sysfs_devno_to_wholedisk(S_ISBLK(st.st_mode) ? st.st_rdev : st.st_dev,
+				     NULL, 0, &disk) != 0 || !disk)
+		return 0;
+
+	pc = ul_new_sysfs_path(disk, NULL, NULL);
+	if (pc) {
+		ul_path_read_u64(pc, &ssz, "queue/logical_block_size");
+		ul_unref_path(pc);
+	}
+	return ssz;
+}
+
+/*
+ * Enables direct I/O for the backing file, so the data are not cached twice
+ * (for the loop device and the file), and sets the logical block size to the
+ * direct I/O alignment of the file. Nothing is changed if direct I/O is not
+ * possible for the file or the offset, or if the block size is already set.
+ */
+static void loopcxt_autotune(struct loopdev_cxt *lc)
+{
+	uint32_t align;
+	long pagesz = getpagesize();
+
+	if (lc->blocksize) {
+		DBG(SETUP, ul_debugobj(lc, "autotune: block size already set"));
+		return;
+	}
+
+	align = get_dio_alignment(lc->filename);
+	if (!align || (long) align > pagesz || (align & (align - 1))) {
+		DBG(SETUP, ul_debugobj(lc, "autotune: unsupported DIO alignment %u", align));
+		return;
+	}
+	align = max(align, 512U);
+
+	if (lc->config.info.lo_offset % align) {
+		DBG(SETUP, ul_debugobj(lc, "autotune: offset not aligned to %u", align));
+		return;
+	}
+
+	lc->config.info.lo_flags |= LO_FLAGS_DIRECT_IO;
+	if (align > 512)
+		lc->blocksize = align;
+
+	DBG(SETUP, ul_debugobj(lc, "autotune: direct-io on, block size %u", align));
+}
+
 /*
  * @lc: context
  *
@@ -1400,6 +1492,9 @@ int loopcxt_setup_device(struct loopdev_cxt *lc)
 
 	DBG(SETUP, ul_debugobj(lc, "device setup requested"));
 
+	if (lc->autotune)
+		loopcxt_autotune(lc);
+
 	/*
 	 * Open backing file and device
 	 */
@@ -1413,6 +1508,15 @@ int loopcxt_setup_device(struct loopdev_cxt *lc)
 		if (mode != O_RDONLY && (errno == EROFS || errno == EACCES))
 			file_fd = open(lc->filename, (mode = O_RDONLY) | flags);
 
+		/* the filesystem does not support O_DIRECT after all */
+		if (file_fd < 0 && errno == EINVAL && lc->autotune) {
+			DBG(SETUP, ul_debugobj(lc, "autotune: O_DIRECT failed, disabled"));
+			lc->config.info.lo_flags &= ~LO_FLAGS_DIRECT_IO;
+			lc->blocksize = 0;
+			flags &= ~O_DIRECT;
+			file_fd = open(lc->filename, mode | flags);
+		}
+
 		if (file_fd < 0) {
 			DBG(SETUP, ul_debugobj(lc, "open backing file failed: %m"));
 			return -errno;
@@ -1722,6 +1826,72 @@ int loopcxt_find_unused(struct loopdev_cxt *lc)
 }
 
 
+/*
+ * Finds up to @n unused loop devices for more setups at once and returns
+ * their numbers in @nums. The missing devices are added by LOOP_CTL_ADD, so
+ * the device nodes exist (and udev is done with them) before the setup.
+ *
+ * Note that the devices are not reserved, another process may use them
+ * before the setup.
+ *
+ * Returns: number of the devices in @nums, <0 on error.
+ */
+int loopdev_find_unused_many(int *nums, size_t n)
+{
+	DIR *dir;
+	size_t count = 0;
+	int ctl, nr, last = -1;
+
+	DBG(CXT, ul_debug("find_unused_many %zu requested", n));
+
+	dir = opendir(_PATH_SYS_BLOCK);
+	if (dir) {
+		struct dirent *d;
+		int fd = dirfd(dir);
+
+		while (count < n && (d = readdir(dir))) {
+			char name[NAME_MAX + 18 + 1];
+			struct stat st;
+
+			if (sscanf(d->d_name, "loop%d", &nr) != 1 || nr < 0)
+				continue;
+			last = max(last, nr);
+
+			/* the loop/ directory exists for used devices only */
+			snprintf(name, sizeof(name), "%s/loop/backing_file", d->d_name);
+			if (fstatat(fd, name, &st, 0) == 0)
+				continue;
+			nums[count++] = nr;
+		}
+		closedir(dir);
+	}
+	if (count)
+		qsort(nums, count, sizeof(int), cmpnum);
+
+	if (count == n)
+		goto done;
+
+	ctl = open(_PATH_DEV_LOOPCTL, O_RDWR|O_CLOEXEC);
+	if (ctl < 0) {
+		if (!count)
+			return -errno;
+		goto done;
+	}
+	for (nr = last + 1; count < n && nr >= 0; nr++) {
+		int rc = ioctl(ctl, LOOP_CTL_ADD, nr);
+
+		if (rc >= 0)
+			nums[count++] = rc;
+		else if (errno != EEXIST)
+			break;
+	}
+	close(ctl);
+done:
+	DBG(CXT, ul_debug("find_unused_many done [found=%zu]", count));
+	return count;
+}
+
+
 
 /*
  * Return: TRUE/FALSE
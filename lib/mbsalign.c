@@ -56,6 +56,13 @@ size_t mbs_nwidth(const char *buf, size_t bufsz)
 			continue;
 		}
 #ifdef HAVE_WIDECHAR
+		/* printable ASCII, no need to decode */
+		if (is_print_ascii(*p) && mbsinit(&st)) {
+			width++;
+			p++;
+			continue;
+		}
+
 		wchar_t wc;
 		size_t len = mbrtowc(&wc, p, MB_CUR_MAX, &st);
 
@@ -111,7 +118,10 @@ size_t mbs_safe_nwidth(const char *buf, size_t bufsz, size_t *sz)
 			p++;
 		}
 #ifdef HAVE_WIDECHAR
-		else {
+		else if (is_print_ascii(*p) && mbsinit(&st)) {
+			width++, bytes++;
+			p++;
+		} else {
 			wchar_t wc;
 			size_t len = mbrtowc(&wc, p, MB_CUR_MAX, &st);
 
@@ -157,6 +167,23 @@ size_t mbs_safe_width(const char *s)
 	return mbs_safe_nwidth(s, strlen(s), NULL);
 }
 
+/*
+ * Returns 1 if @s contains printable ASCII chars only and mbs_safe_encode()
+ * does not modify it; the @width returns number of cells (= bytes).
+ */
+int mbs_is_safe_ascii(const char *s, size_t *width)
+{
+	const char *p;
+
+	for (p = s; p && *p; p++) {
+		if (!is_print_ascii(*p) || (*p == '\\' && *(p + 1) == 'x'))
+			return 0;
+	}
+	if (width)
+		*width = p - s;
+	return 1;
+}
+
 /*
  * Copy @s to @buf and replace control and non-printable chars with
  * \x?? hex sequence. The @width returns number of cells. The @safechars
@@ -195,7 +222,10 @@ char *mbs_safe_encode_to_buffer(const char *s, size_t *width, char *buf, const c
 			p++;
 		}
 #ifdef HAVE_WIDECHAR
-		else {
+		else if (is_print_ascii(*p) && mbsinit(&st)) {
+			*r++ = *p++;
+			(*width)++;
+		} else {
 			wchar_t wc;
 			size_t len = mbrtowc(&wc, p, MB_CUR_MAX, &st);
 
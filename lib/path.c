@@ -99,6 +99,7 @@ void ul_unref_path(struct path_cxt *pc)
 		ul_path_close_dirfd(pc);
 		free(pc->dir_path);
 		free(pc->prefix);
+		free(pc->attrs_buf);
 		free(pc);
 	}
 }
@@ -700,6 +701,96 @@ int ul_path_readf_buffer(struct path_cxt *pc, char *buf, size_t bufsz, const cha
 	return !p ? -errno : ul_path_read_buffer(pc, buf, bufsz, p);
 }
 
+/*
+ * Reads more attributes (small files, usually in sysfs) from directory @dir
+ * (relative to @pc directory, or NULL for @pc directory itself). The
+ * directory is opened only once and all the data are stored in one buffer
+ * owned by @pc, so there is no allocation for each attribute.
+ *
+ * The value is a string without the trailing newline (may be empty), or NULL
+ * if the attribute cannot be read. The values are valid until the next
+ * ul_path_read_attrs() call for @pc.
+ *
+ * The optional @present returns bitmap of the successfully read attributes,
+ * so @nattrs is limited to 64.
+ *
+ * Returns number of successfully read attributes or negative errno.
+ */
+int ul_path_read_attrs(struct path_cxt *pc, const char *dir,
+		       struct ul_path_attr *attrs, size_t nattrs, uint64_t *present)
+{
+	uint64_t mask = 0;
+	size_t i, used = 0;
+	int dirfd = -1, rc = 0;
+
+	if (!pc || !attrs || nattrs > 64)
+		return -EINVAL;
+
+	if (dir) {
+		dirfd = ul_path_open(pc, O_RDONLY|O_DIRECTORY|O_CLOEXEC, dir);
+		if (dirfd < 0)
+			return -errno;
+	}
+
+	DBG(CXT, ul_debugobj(pc, "reading %zu attributes from '%s'", nattrs, dir ? dir : "."));
+
+	for (i = 0; i < nattrs; i++) {
+		struct ul_path_attr *a = &attrs[i];
+		ssize_t sz;
+		int fd;
+
+		a->value = NULL;
+		a->len = 0;
+
+		fd = dirfd >= 0 ? openat(dirfd, a->name, O_RDONLY|O_CLOEXEC) :
+				  ul_path_open(pc, O_RDONLY|O_CLOEXEC, a->name);
+		if (fd < 0)
+			continue;
+
+		if (pc->attrs_bufsz - used < BUFSIZ) {
+			size_t bufsz = max(pc->attrs_bufsz * 2, used + BUFSIZ);
+			char *tmp = realloc(pc->attrs_buf, bufsz);
+
+			if (!tmp) {
+				close(fd);
+				rc = -ENOMEM;
+				break;
+			}
+			pc->attrs_buf = tmp;
+			pc->attrs_bufsz = bufsz;
+		}
+
+		sz = read_all(fd, pc->attrs_buf + used, BUFSIZ - 1);
+		close(fd);
+		if (sz < 0)
+			continue;
+
+		/* Remove trailing newline (usual in sysfs) */
+		if (sz > 0 && pc->attrs_buf[used + sz - 1] == '\n')
+			sz--;
+		pc->attrs_buf[used + sz] = '\0';
+
+		a->len = sz;
+		used += sz + 1;
+		mask |= UINT64_C(1) << i;
+		rc++;
+	}
+
+	/* the buffer may be reallocated, set the values at the end */
+	for (i = 0, used = 0; i < nattrs; i++) {
+		if (!(mask & (UINT64_C(1) << i)))
+			continue;
+		attrs[i].value = pc->attrs_buf + used;
+		used += attrs[i].len + 1;
+	}
+
+	if (dirfd >= 0)
+		close(dirfd);
+	if (present)
+		*present = mask;
+	return rc;
+}
+
 int ul_path_scanf(struct path_cxt *pc, const char *path, const char *fmt, ...)
 {
 	FILE *f;
@@ -1102,6 +1193,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(" read-string <file>         read string  from file\n", stdout);
 	fputs(" read-majmin <file>         read devno from file\n", stdout);
 	fputs(" read-link <file>           read symlink\n", stdout);
+	fputs(" read-attrs <dir> <file>... read files from <dir> at once\n", stdout);
 	fputs(" write-string <file> <str>  write string from file\n", stdout);
 	fputs(" write-u64 <file> <str>     write uint64_t from file\n", stdout);
 
@@ -1254,6 +1346,25 @@ int main(int argc, char *argv[])
 			err(EXIT_FAILURE, "readf symlink failed");
 		printf("readf: %s: %s\n", file, res);
 
+	} else if (strcmp(command, "read-attrs") == 0) {
+		struct ul_path_attr attrs[64];
+		uint64_t present = 0;
+		size_t i, n = 0;
+		const char *subdir;
+
+		if (optind + 1 >= argc)
+			errx(EXIT_FAILURE, "<dir> <file> not defined");
+		subdir = argv[optind++];
+
+		for (; optind < argc && n < ARRAY_SIZE(attrs); optind++)
+			attrs[n++].name = argv[optind];
+
+		if (ul_path_read_attrs(pc, subdir, attrs, n, &present) < 0)
+			err(EXIT_FAILURE, "read attributes failed");
+		for (i = 0; i < n; i++)
+			printf("read:  %s/%s: %s\n", subdir, attrs[i].name,
+				present & (UINT64_C(1) << i) ? attrs[i].value : "<none>");
+
 	} else if (strcmp(command, "write-string") == 0) {
 		char *str;
 
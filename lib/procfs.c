@@ -7,6 +7,8 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
 
 #ifdef HAVE_SYS_VFS_H
 # include <sys/vfs.h>
@@ -192,8 +194,13 @@ int procfs_process_get_stat_nth(struct path_cxt *pc, int n, uintmax_t *re)
 	     tok = strtok_r(NULL, " ", &key)) {
 
 		i++;
-		if (i == n)
-			return ul_strtou64(tok, re, 10);
+		if (i == n) {
+			const char *end = ul_scan_u64(tok, NULL, re);
+
+			if (!end)
+				return -errno;
+			return *end == '\0' || *end == '\n' ? 0 : -EINVAL;
+		}
 
 		/* skip rest of the process name */
 		if (i == 2 && (p = strrchr(key, ')')))
@@ -393,6 +400,297 @@ int procfs_dirent_match_name(DIR *procfs, struct dirent *d, const char *name)
 	return 0;
 }
 
+/*
+ * procfs_iter is a /proc (or /proc/<pid>/task) scanner for the tools that
+ * walk all processes. The directory is read by getdents64() into a large
+ * buffer, and the filters are evaluated from the cheapest; the shard and
+ * the PID need no syscall, the UID costs one fstatat(), the name and the
+ * cgroup cost one small read each.
+ *
+ * Example:
+ *
+ * pid_t pid;
+ * struct procfs_iter *it = procfs_new_iter(NULL);
+ *
+ * procfs_iter_set_uid(it, getuid());
+ * while (procfs_iter_next(it, &pid) == 0)
+ *	printf("process: %d", (int) pid);
+ * procfs_free_iter(it);
+ */
+#define PROCFS_ITER_BUFSIZ	(64 * 1024)
+
+#if defined(SYS_getdents64) && defined(__linux__)
+# define USE_GETDENTS64 1
+
+struct procfs_dirent64 {
+	uint64_t	d_ino;
+	int64_t		d_off;
+	unsigned short	d_reclen;
+	unsigned char	d_type;
+	char		d_name[];
+};
+#endif
+
+struct procfs_iter {
+	int		dirfd;
+#ifdef USE_GETDENTS64
+	char		*buf;
+	long		bufsz;		/* valid data in the buffer */
+	long		bufoff;		/* the next entry */
+#else
+	DIR		*dir;
+#endif
+	uid_t		uid;
+	char		*name;
+	char		*cgroup;
+	size_t		cgrouplen;
+
+	unsigned int	shard;
+	unsigned int	nshards;
+
+	unsigned int	has_uid : 1,
+			done : 1;
+};
+
+/*
+ * Returns a new iterator for all processes in /proc, or for tasks of the
+ * process if @pc is a procfs_process path.
+ */
+struct procfs_iter *procfs_new_iter(struct path_cxt *pc)
+{
+	struct procfs_iter *it = calloc(1, sizeof(*it));
+
+	if (!it)
+		return NULL;
+
+	if (pc)
+		it->dirfd = ul_path_open(pc, O_RDONLY | O_DIRECTORY | O_CLOEXEC, "task");
+	else
+		it->dirfd = open(_PATH_PROC, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (it->dirfd < 0)
+		goto fail;
+#ifdef USE_GETDENTS64
+	it->buf = malloc(PROCFS_ITER_BUFSIZ);
+	if (!it->buf)
+		goto fail;
+#else
+	it->dir = fdopendir(it->dirfd);
+	if (!it->dir)
+		goto fail;
+#endif
+	DBG(CXT, ul_debugobj(it, "new iterator"));
+	return it;
+fail:
+	procfs_free_iter(it);
+	return NULL;
+}
+
+void procfs_free_iter(struct procfs_iter *it)
+{
+	if (!it)
+		return;
+#ifdef USE_GETDENTS64
+	if (it->dirfd >= 0)
+		close(it->dirfd);
+	free(it->buf);
+#else
+	if (it->dir)
+		closedir(it->dir);
+	else if (it->dirfd >= 0)
+		close(it->dirfd);
+#endif
+	free(it->name);
+	free(it->cgroup);
+	free(it);
+}
+
+/* file descriptor of the scanned directory, usable with *at() functions */
+int procfs_iter_get_fd(struct procfs_iter *it)
+{
+	return it ? it->dirfd : -EINVAL;
+}
+
+void procfs_iter_set_uid(struct procfs_iter *it, uid_t uid)
+{
+	it->uid = uid;
+	it->has_uid = 1;
+}
+
+/* matches "comm" of the process, see procfs_dirent_get_name() */
+int procfs_iter_set_name(struct procfs_iter *it, const char *name)
+{
+	free(it->name);
+	it->name = name ? strdup(name) : NULL;
+	return name && !it->name ? -ENOMEM : 0;
+}
+
+/* matches processes within the cgroup v2 @path (e.g. "/system.slice" or
+ * "/sys/fs/cgroup/system.slice"), including its descendants */
+int procfs_iter_set_cgroup(struct procfs_iter *it, const char *path)
+{
+	const size_t plen = sizeof(_PATH_SYS_CGROUP) - 1;
+
+	free(it->cgroup);
+	it->cgroup = NULL;
+	it->cgrouplen = 0;
+
+	if (!path)
+		return 0;
+	if (strncmp(path, _PATH_SYS_CGROUP, plen) == 0
+	    && (path[plen] == '/' || path[plen] == '\0'))
+		path += plen;
+	while (*path == '/')
+		path++;
+	if (asprintf(&it->cgroup, "/%s", path) < 0) {
+		it->cgroup = NULL;
+		return -ENOMEM;
+	}
+
+	it->cgrouplen = strlen(it->cgroup);
+	while (it->cgrouplen > 1 && it->cgroup[it->cgrouplen - 1] == '/')
+		it->cgroup[--it->cgrouplen] = '\0';
+	return 0;
+}
+
+/* returns only PIDs where (PID % @nshards) == @shard; this allows to split
+ * the scan between @nshards threads or processes, each with own iterator */
+int procfs_iter_set_shard(struct procfs_iter *it, unsigned int shard, unsigned int nshards)
+{
+	if (nshards && shard >= nshards)
+		return -EINVAL;
+	it->shard = shard;
+	it->nshards = nshards;
+	return 0;
+}
+
+/* reads /proc/<pid>/<fname> into @buf, see read_procfs_file() */
+static ssize_t iter_read_file(struct procfs_iter *it, const char *pidstr,
+			      const char *fname, char *buf, size_t bufsz)
+{
+	char path[64];
+	ssize_t sz;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", pidstr, fname);
+	fd = openat(it->dirfd, path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	sz = read_procfs_file(fd, buf, bufsz);
+	close(fd);
+	return sz;
+}
+
+static int iter_match_name(struct procfs_iter *it, const char *pidstr)
+{
+	char buf[64];
+	ssize_t sz = iter_read_file(it, pidstr, "comm", buf, sizeof(buf));
+
+	if (sz <= 0)
+		return 0;
+	return strcmp(buf, it->name) == 0;
+}
+
+static int iter_match_cgroup(struct procfs_iter *it, const char *pidstr)
+{
+	char buf[BUFSIZ], *p;
+	ssize_t sz = iter_read_file(it, pidstr, "cgroup", buf, sizeof(buf));
+
+	if (sz <= 0)
+		return 0;
+
+	/* the unified hierarchy is "0::<path>" */
+	for (p = buf; p; p = strchr(p, '\n')) {
+		if (*p == '\n')
+			p++;
+		if (strncmp(p, "0::", 3) != 0)
+			continue;
+		p += 3;
+		if (it->cgrouplen == 1)		/* "/" */
+			return 1;
+		if (strncmp(p, it->cgroup, it->cgrouplen) != 0)
+			return 0;
+		p += it->cgrouplen;
+		return *p == '\n' || *p == '\0' || *p == '/';
+	}
+	return 0;
+}
+
+static int iter_match(struct procfs_iter *it, const char *name,
+		      unsigned char type __attribute__((__unused__)),
+		      pid_t *pid)
+{
+	uint64_t num;
+
+	if (!isdigit((unsigned char) *name))
+		return 0;
+#ifdef DT_UNKNOWN
+	if (type != DT_DIR && type != DT_UNKNOWN)
+		return 0;
+#endif
+	if (ul_strtou64(name, &num, 10) < 0)
+		return 0;
+	if (it->nshards > 1 && num % it->nshards != it->shard)
+		return 0;
+	if (it->has_uid) {
+		struct stat st;
+
+		if (fstatat(it->dirfd, name, &st, 0) != 0 || st.st_uid != it->uid)
+			return 0;
+	}
+	if (it->name && !iter_match_name(it, name))
+		return 0;
+	if (it->cgroup && !iter_match_cgroup(it, name))
+		return 0;
+
+	*pid = (pid_t) num;
+	return 1;
+}
+
+/*
+ * Returns: <0 on error, 0 on success, 1 done
+ */
+int procfs_iter_next(struct procfs_iter *it, pid_t *pid)
+{
+	if (!it || !pid)
+		return -EINVAL;
+	if (it->done)
+		return 1;
+#ifdef USE_GETDENTS64
+	do {
+		while (it->bufoff < it->bufsz) {
+			struct procfs_dirent64 *d =
+				(struct procfs_dirent64 *) (it->buf + it->bufoff);
+
+			it->bufoff += d->d_reclen;
+			if (iter_match(it, d->d_name, d->d_type, pid))
+				return 0;
+		}
+		it->bufoff = 0;
+		it->bufsz = syscall(SYS_getdents64, it->dirfd, it->buf, PROCFS_ITER_BUFSIZ);
+	} while (it->bufsz > 0);
+
+	if (it->bufsz < 0) {
+		it->bufsz = 0;
+		return -errno;
+	}
+#else
+	{
+		struct dirent *d;
+
+		while ((d = xreaddir(it->dir))) {
+# ifdef _DIRENT_HAVE_D_TYPE
+			if (iter_match(it, d->d_name, d->d_type, pid))
+# else
+			if (iter_match(it, d->d_name, DT_UNKNOWN, pid))
+# endif
+				return 0;
+		}
+	}
+#endif
+	it->done = 1;
+	return 1;
+}
+
 #ifdef HAVE_SYS_VFS_H
 /* checks if fd is file in a procfs;
  * returns 1 if true, 0 if false or couldn't determine */
@@ -449,6 +747,96 @@ char *pid_get_cmdline(pid_t pid)
 	return strdup_procfs_file(pid, "cmdline");
 }
 
+/*
+ * Reads TIDs of all threads in the cgroup v2 @path (threads of the
+ * descendant cgroups are not included). The @path is relative to
+ * /sys/fs/cgroup if it does not start with it. The @tids array is
+ * allocated; the caller is responsible to free it.
+ *
+ * Returns: <0 on error, 0 on success.
+ */
+int cgroup_get_tids(const char *path, pid_t **tids, size_t *ntids)
+{
+	const size_t plen = sizeof(_PATH_SYS_CGROUP) - 1;
+	size_t n = 0, nalloc = 0;
+	pid_t *ary = NULL;
+	char *fname;
+	FILE *f;
+	int tid, rc = 0;
+
+	if (!path || !tids || !ntids)
+		return -EINVAL;
+
+	if (strncmp(path, _PATH_SYS_CGROUP, plen) == 0
+	    && (path[plen] == '/' || path[plen] == '\0'))
+		rc = asprintf(&fname, "%s/cgroup.threads", path);
+	else {
+		while (*path == '/')
+			path++;
+		rc = asprintf(&fname, _PATH_SYS_CGROUP "/%s/cgroup.threads", path);
+	}
+	if (rc < 0)
+		return -ENOMEM;
+
+	f = fopen(fname, "r" UL_CLOEXECSTR);
+	free(fname);
+	if (!f)
+		return -errno;
+
+	rc = 0;
+	while (fscanf(f, "%d", &tid) == 1) {
+		if (n == nalloc) {
+			pid_t *tmp;
+
+			nalloc = nalloc ? nalloc * 2 : 64;
+			tmp = reallocarray(ary, nalloc, sizeof(pid_t));
+			if (!tmp) {
+				rc = -ENOMEM;
+				break;
+			}
+			ary = tmp;
+		}
+		ary[n++] = tid;
+	}
+	if (!rc && ferror(f))
+		rc = -errno;
+	fclose(f);
+
+	if (rc) {
+		free(ary);
+		return rc;
+	}
+	*tids = ary;
+	*ntids = n;
+	return 0;
+}
+
+/*
+ * Calls @fn for all threads in the cgroup @path, see cgroup_get_tids(). The
+ * @fn is expected to return 0 on success (or if the thread does not exist
+ * anymore) and <0 on error.
+ *
+ * Returns: <0 if the cgroup cannot be read, or number of failed @fn calls.
+ */
+int cgroup_foreach_tid(const char *path, int (*fn)(pid_t tid, void *data),
+		       void *data)
+{
+	pid_t *tids = NULL;
+	size_t i, ntids = 0;
+	int rc, nerrs = 0;
+
+	rc = cgroup_get_tids(path, &tids, &ntids);
+	if (rc < 0)
+		return rc;
+
+	for (i = 0; i < ntids; i++) {
+		if (fn(tids[i], data) < 0)
+			nerrs++;
+	}
+	free(tids);
+	return nerrs;
+}
+
 #ifdef TEST_PROGRAM_PROCFS
 
 static int test_tasks(int argc, char *argv[], const char *prefix)
@@ -535,6 +923,50 @@ static int test_processes(int argc, char *argv[])
 	return EXIT_SUCCESS;
 }
 
+static int test_iter(int argc, char *argv[])
+{
+	struct procfs_iter *it;
+	struct path_cxt *pc = NULL;
+	pid_t pid;
+	int rc, i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--tasks") == 0 && i + 1 < argc) {
+			pc = ul_new_procfs_path((pid_t) atol(argv[++i]), NULL);
+			if (!pc)
+				err(EXIT_FAILURE, "cannot create path context");
+		}
+	}
+
+	it = procfs_new_iter(pc);
+	if (!it)
+		err(EXIT_FAILURE, "cannot create iterator");
+
+	for (i = 1; i + 1 < argc; i += 2) {
+		if (strcmp(argv[i], "--name") == 0)
+			procfs_iter_set_name(it, argv[i + 1]);
+		else if (strcmp(argv[i], "--uid") == 0)
+			procfs_iter_set_uid(it, (uid_t) atol(argv[i + 1]));
+		else if (strcmp(argv[i], "--cgroup") == 0)
+			procfs_iter_set_cgroup(it, argv[i + 1]);
+		else if (strcmp(argv[i], "--shard") == 0) {
+			unsigned int n = 0, m = 0;
+
+			if (sscanf(argv[i + 1], "%u/%u", &n, &m) != 2 ||
+			    procfs_iter_set_shard(it, n, m) != 0)
+				errx(EXIT_FAILURE, "invalid shard %s", argv[i + 1]);
+		}
+	}
+
+	while ((rc = procfs_iter_next(it, &pid)) == 0)
+		printf(" %d", (int) pid);
+	fputc('\n', stdout);
+
+	procfs_free_iter(it);
+	ul_unref_path(pc);
+	return rc < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 static int test_one_process(int argc, char *argv[], const char *prefix)
 {
 	pid_t pid;
@@ -621,6 +1053,8 @@ int main(int argc, char *argv[])
 				"       %1$s [--prefix <prefix>] --fds <pid>\n"
 				"       %1$s --is-procfs [<dir>]\n"
 				"       %1$s --processes [--name <name>] [--uid <uid>]\n"
+				"       %1$s --iter [--tasks <pid>] [--name <name>] [--uid <uid>]\n"
+				"                   [--cgroup <path>] [--shard <n>/<total>]\n"
 				"       %1$s [--prefix <prefix>] --one <pid>\n"
 				"       %1$s [--prefix <prefix>] --stat-nth <pid> <n>\n",
 				program_invocation_short_name);
@@ -633,6 +1067,8 @@ int main(int argc, char *argv[])
 		return test_fds(argc - 1, argv + 1, prefix);
 	if (strcmp(argv[1], "--processes") == 0)
 		return test_processes(argc - 1, argv + 1);
+	if (strcmp(argv[1], "--iter") == 0)
+		return test_iter(argc - 1, argv + 1);
 	if (strcmp(argv[1], "--is-procfs") == 0)
 		return test_isprocfs(argc - 1, argv + 1);
 	if (strcmp(argv[1], "--one") == 0)
@@ -638,7 +638,7 @@ int ul_pty_proxy_master(struct ul_pty *pty)
 
 	while (!pty->delivered_signal) {
 		size_t i;
-		int errsv, timeout;
+		int errsv, timeout, callback_timeout;
 
 		DBG(IO, ul_debugobj(pty, "--poll() loop--"));
 
@@ -656,14 +656,27 @@ int ul_pty_proxy_master(struct ul_pty *pty)
 		}
 
 		/* set timeout */
+		timeout = pty->poll_timeout;
+		callback_timeout = 0;
+
 		if (timerisset(&pty->next_callback_time)) {
 			struct timeval now = { 0 }, rest = { 0 };
+			int rest_ms;
 
 			gettime_monotonic(&now);
 			timersub(&pty->next_callback_time, &now, &rest);
-			timeout = (rest.tv_sec * 1000) +  (rest.tv_usec / 1000);
-		} else
-			timeout = pty->poll_timeout;
+			rest_ms = (rest.tv_sec * 1000) +  (rest.tv_usec / 1000);
+
+			/* already expired; negative timeout is infinite */
+			if (rest_ms < 0)
+				rest_ms = 0;
+
+			/* don't postpone leaving the loop */
+			if (timeout < 0 || rest_ms <= timeout) {
+				timeout = rest_ms;
+				callback_timeout = 1;
+			}
+		}
 
 		/* use POLLOUT (aka "writing is now possible") if data queued */
 		if (pty->child_buffer_head)
@@ -688,7 +701,7 @@ int ul_pty_proxy_master(struct ul_pty *pty)
 
 		/* timeout */
 		if (ret == 0) {
-			if (timerisset(&pty->next_callback_time)) {
+			if (callback_timeout) {
 				rc = mainloop_callback(pty);
 				if (rc == 0)
 					continue;
@@ -158,9 +158,13 @@ int ul_random_get_bytes(void *buf, size_t nbytes)
 		}
 	}
 	/*
-	 * We do this all the time, but this is the only source of
-	 * randomness if /dev/random/urandom is out to lunch.
+	 * This is the only source of randomness if /dev/random/urandom is out
+	 * to lunch. The pseudo-random numbers add nothing to the kernel bytes,
+	 * and rand() is a locked call per byte, so skip it if all is read.
 	 */
+	if (n == 0)
+		return 0;
+
 	crank_random();
 	for (cp = buf, i = 0; i < nbytes; i++)
 		*cp++ ^= (rand() >> 7) & 0xFF;
@@ -178,7 +182,7 @@ int ul_random_get_bytes(void *buf, size_t nbytes)
 	}
 #endif
 
-	return n != 0;
+	return 1;
 }
 
 
@@ -18,6 +18,14 @@
 #include <stdint.h>
 
 #include "sha1.h"
+#include "cpufeatures.h"
+
+#ifdef TEST_PROGRAM_SHA1
+int ul_sha1_generic_only;
+# define sha1_has_shani()	(!ul_sha1_generic_only && ul_cpu_has_sha_ni())
+#else
+# define sha1_has_shani()	ul_cpu_has_sha_ni()
+#endif
 
 #define rol(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
 
@@ -39,12 +47,77 @@
 #define R3(v,w,x,y,z,i) z+=(((w|x)&y)|(w&x))+blk(i)+0x8F1BBCDC+rol(v,5);w=rol(w,30);
 #define R4(v,w,x,y,z,i) z+=(w^x^y)+blk(i)+0xCA62C1D6+rol(v,5);w=rol(w,30);
 
+#ifdef HAVE_X86_SHA_NI
+/*
+ * Intel SHA extensions; every sha1rnds4 does four rounds, the round function
+ * (the immediate argument) is changed every 20 rounds.
+ */
+static __attribute__((__target__("sha,sse4.1,ssse3")))
+void sha1_transform_shani(uint32_t state[5], const unsigned char buffer[64])
+{
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	__m128i abcd, abcd_save, e0, e0_save, e1, msg[4];
+	int i;
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0x1B);
+	e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+	abcd_save = abcd;
+	e0_save = e0;
+
+	for (i = 0; i < 20; i++) {
+		__m128i w;
+
+		if (i < 4)
+			w = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (buffer + 16 * i)), mask);
+		else {
+			w = _mm_sha1msg1_epu32(msg[i & 3], msg[(i - 3) & 3]);
+			w = _mm_xor_si128(w, msg[(i - 2) & 3]);
+			w = _mm_sha1msg2_epu32(w, msg[(i - 1) & 3]);
+		}
+		msg[i & 3] = w;
+
+		/* E + W for the next four rounds */
+		e1 = i == 0 ? _mm_add_epi32(e0, w) : _mm_sha1nexte_epu32(e0, w);
+		e0 = abcd;
+
+		switch (i / 5) {
+		case 0:
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+			break;
+		case 1:
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+			break;
+		case 2:
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+			break;
+		default:
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+			break;
+		}
+	}
+
+	e0 = _mm_sha1nexte_epu32(e0, e0_save);
+	abcd = _mm_add_epi32(abcd, abcd_save);
+
+	_mm_storeu_si128((__m128i *) state, _mm_shuffle_epi32(abcd, 0x1B));
+	state[4] = _mm_extract_epi32(e0, 3);
+}
+#endif /* HAVE_X86_SHA_NI */
+
 /* Hash a single 512-bit block. This is the core of the algorithm. */
 
 void ul_SHA1Transform(uint32_t state[5], const unsigned char buffer[64])
 {
 	uint32_t a, b, c, d, e;
 
+#ifdef HAVE_X86_SHA_NI
+	if (sha1_has_shani()) {
+		sha1_transform_shani(state, buffer);
+		return;
+	}
+#endif
+
 	typedef union {
 		unsigned char c[64];
 		uint32_t l[16];
@@ -208,6 +281,8 @@ void ul_SHA1Update(UL_SHA1_CTX *context, const unsigned char *data, uint32_t len
 	memcpy(&context->buffer[j], &data[i], len - i);
 }
 
+static const unsigned char sha1_padding[64] = { 0x80 };
+
 /* Add padding and return the message digest. */
 
 void ul_SHA1Final(unsigned char digest[20], UL_SHA1_CTX *context)
@@ -216,7 +291,7 @@ void ul_SHA1Final(unsigned char digest[20], UL_SHA1_CTX *context)
 
 	unsigned char finalcount[8];
 
-	unsigned char c;
+	uint32_t j;
 
 #if 0				/* untested "improvement" by DHR */
 	/* Convert context->count to a sequence of bytes
@@ -238,12 +313,9 @@ void ul_SHA1Final(unsigned char digest[20], UL_SHA1_CTX *context)
 		finalcount[i] = (unsigned char)((context->count[(i >= 4 ? 0 : 1)] >> ((3 - (i & 3)) * 8)) & 255);	/* Endian independent */
 	}
 #endif
-	c = 0200;
-	ul_SHA1Update(context, &c, 1);
-	while ((context->count[0] & 504) != 448) {
-		c = 0000;
-		ul_SHA1Update(context, &c, 1);
-	}
+	/* 0x80 and zeros up to 56 bytes modulo 64, by one update */
+	j = (context->count[0] >> 3) & 63;
+	ul_SHA1Update(context, sha1_padding, j < 56 ? 56 - j : 120 - j);
 	ul_SHA1Update(context, finalcount, 8);	/* Should cause a SHA1Transform() */
 	for (i = 0; i < 20; i++) {
 		digest[i] = (unsigned char)
@@ -17,6 +17,7 @@
 #include <stdint.h>
 
 #include "sha256.h"
+#include "cpufeatures.h"
 
 /* public domain sha256 implementation based on fips180-3 */
 
@@ -45,11 +46,78 @@ static const uint32_t K[64] = {
 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
 };
 
+#ifdef TEST_PROGRAM_SHA256
+int ul_sha256_generic_only;
+# define sha256_has_shani()	(!ul_sha256_generic_only && ul_cpu_has_sha_ni())
+#else
+# define sha256_has_shani()	ul_cpu_has_sha_ni()
+#endif
+
+#ifdef HAVE_X86_SHA_NI
+/*
+ * Intel SHA extensions; the state is kept as ABEF and CDGH vectors, every
+ * sha256rnds2 does two rounds.
+ */
+static __attribute__((__target__("sha,sse4.1,ssse3")))
+void processblock_shani(struct sha256 *s, const uint8_t *buf)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i state0, state1, abef, cdgh, tmp, msg[4];
+	int i;
+
+	tmp = _mm_loadu_si128((const __m128i *) &s->h[0]);
+	state1 = _mm_loadu_si128((const __m128i *) &s->h[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xB1);			/* CDAB */
+	state1 = _mm_shuffle_epi32(state1, 0x1B);		/* EFGH */
+	state0 = _mm_alignr_epi8(tmp, state1, 8);		/* ABEF */
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);		/* CDGH */
+
+	abef = state0;
+	cdgh = state1;
+
+	for (i = 0; i < 16; i++) {
+		__m128i w;
+
+		if (i < 4)
+			w = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (buf + 16 * i)), mask);
+		else {
+			w = _mm_sha256msg1_epu32(msg[i & 3], msg[(i - 3) & 3]);
+			w = _mm_add_epi32(w, _mm_alignr_epi8(msg[(i - 1) & 3], msg[(i - 2) & 3], 4));
+			w = _mm_sha256msg2_epu32(w, msg[(i - 1) & 3]);
+		}
+		msg[i & 3] = w;
+
+		tmp = _mm_add_epi32(w, _mm_loadu_si128((const __m128i *) &K[4 * i]));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, tmp);
+		tmp = _mm_shuffle_epi32(tmp, 0x0E);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, tmp);
+	}
+
+	state0 = _mm_add_epi32(state0, abef);
+	state1 = _mm_add_epi32(state1, cdgh);
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);			/* FEBA */
+	state1 = _mm_shuffle_epi32(state1, 0xB1);		/* DCHG */
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);		/* DCBA */
+	state1 = _mm_alignr_epi8(state1, tmp, 8);		/* HGFE */
+
+	_mm_storeu_si128((__m128i *) &s->h[0], state0);
+	_mm_storeu_si128((__m128i *) &s->h[4], state1);
+}
+#endif /* HAVE_X86_SHA_NI */
+
 static void processblock(struct sha256 *s, const uint8_t *buf)
 {
 	uint32_t W[64], t1, t2, a, b, c, d, e, f, g, h;
 	int i;
 
+#ifdef HAVE_X86_SHA_NI
+	if (sha256_has_shani()) {
+		processblock_shani(s, buf);
+		return;
+	}
+#endif
+
 	for (i = 0; i < 16; i++) {
 		W[i] = (uint32_t)buf[4*i]<<24;
 		W[i] |= (uint32_t)buf[4*i+1]<<16;
@@ -323,6 +323,98 @@ char *strndup(const char *s, size_t n)
 /*
  * convert strings to numbers; returns <0 on error, and 0 on success
  */
+/*
+ * Locale independent in-place number scanners for /proc and /sys files.
+ *
+ * The functions parse digits from @p up to the first non-digit or @end and
+ * return pointer behind the number. Nothing is skipped before the number and
+ * the trailing characters are not checked, the caller does it. The @end may
+ * be NULL for NUL-terminated strings; if it's specified, the decimal
+ * scanner converts eight digits at once while it is safe to read eight bytes.
+ *
+ * Returns NULL and sets errno to EINVAL (no digit) or ERANGE (overflow).
+ */
+static inline int is_eight_digits(uint64_t v)
+{
+	return ((v & 0xF0F0F0F0F0F0F0F0ULL) |
+		(((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4))
+			== 0x3333333333333333ULL;
+}
+
+static inline uint32_t parse_eight_digits(uint64_t v)
+{
+	v = (v & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+	v = (v & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+	return (uint32_t) ((v & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32);
+}
+
+const char *ul_scan_u64(const char *p, const char *end, uint64_t *num)
+{
+	const char *start = p;
+	uint64_t n = 0;
+	int i;
+
+	/* max. 16 digits by SWAR, the rest needs overflow check */
+	for (i = 0; i < 2 && end && end - p >= 8; i++) {
+		uint64_t v;
+
+		memcpy(&v, p, sizeof(v));
+		v = le64_to_cpu(v);
+		if (!is_eight_digits(v))
+			break;
+		n = n * 100000000 + parse_eight_digits(v);
+		p += 8;
+	}
+
+	for (; !end || p < end; p++) {
+		unsigned int d = (unsigned char) *p - '0';
+
+		if (d > 9)
+			break;
+		if (n > (UINT64_MAX - d) / 10) {
+			errno = ERANGE;
+			return NULL;
+		}
+		n = n * 10 + d;
+	}
+
+	if (p == start) {
+		errno = EINVAL;
+		return NULL;
+	}
+	*num = n;
+	return p;
+}
+
+const char *ul_scan_x64(const char *p, const char *end, uint64_t *num)
+{
+	const char *start = p;
+	uint64_t n = 0;
+
+	for (; !end || p < end; p++) {
+		unsigned int c = (unsigned char) *p, d;
+
+		if (c - '0' < 10)
+			d = c - '0';
+		else if ((c | 0x20) - 'a' < 6)
+			d = (c | 0x20) - 'a' + 10;
+		else
+			break;
+		if (n >> 60) {
+			errno = ERANGE;
+			return NULL;
+		}
+		n = (n << 4) | d;
+	}
+
+	if (p == start) {
+		errno = EINVAL;
+		return NULL;
+	}
+	*num = n;
+	return p;
+}
+
 int ul_strtos64(const char *str, int64_t *num, int base)
 {
 	char *end = NULL;
@@ -348,6 +440,16 @@ int ul_strtou64(const char *str, uint64_t *num, int base)
 	if (str == NULL || *str == '\0')
 		return -(errno = EINVAL);
 
+	/* fast path for plain numbers, anything else (white space, sign,
+	 * prefix, garbage) is left to strtoumax() */
+	errno = 0;
+	if (base == 10 || base == 16) {
+		const char *p = base == 10 ? ul_scan_u64(str, NULL, num)
+					   : ul_scan_x64(str, NULL, num);
+		if (p && *p == '\0')
+			return 0;
+	}
+
 	/* we need to ignore negative numbers, note that for invalid negative
 	 * number strtoimax() returns negative number too, so we do not
 	 * need to check errno here */
@@ -936,6 +1038,24 @@ int streq_paths(const char *a, const char *b)
 	return 0;
 }
 
+/*
+ * Returns hash of the path. The hash is calculated from path without
+ * redundant slashes, so paths equal for streq_paths() have the same hash.
+ */
+size_t ul_hash_path(const char *p)
+{
+	uint32_t h = 2166136261U;	/* FNV-1a */
+
+	while (p && *p) {
+		if (*p == '/' && (*(p + 1) == '/' || *(p + 1) == '\0')) {
+			p++;
+			continue;
+		}
+		h = (h ^ (unsigned char) *p++) * 16777619U;
+	}
+	return h;
+}
+
 /* concatenate two strings to a new string, the size of the second string is limited by @b */
 char *strnconcat(const char *s, const char *suffix, size_t b)
 {
@@ -1376,6 +1496,30 @@ static int test_strutils_cstrcasecmp(int argc, char *argv[])
 	return EXIT_SUCCESS;
 }
 
+static int test_strutils_scan(int argc, char *argv[])
+{
+	const char *str, *end;
+	uint64_t num = 0;
+
+	if (argc < 3)
+		return EXIT_FAILURE;
+
+	str = argv[2];
+	errno = 0;
+	if (strcmp(argv[1], "u64") == 0)
+		end = ul_scan_u64(str, str + strlen(str), &num);
+	else if (strcmp(argv[1], "x64") == 0)
+		end = ul_scan_x64(str, str + strlen(str), &num);
+	else
+		return EXIT_FAILURE;
+
+	if (!end)
+		printf("'%s'--> %s\n", str, errno == ERANGE ? "ERANGE" : "EINVAL");
+	else
+		printf("'%s'-->%" PRIu64 " [rest='%s']\n", str, num, end);
+	return EXIT_SUCCESS;
+}
+
 int main(int argc, char *argv[])
 {
 	if (argc == 3 && strcmp(argv[1], "--size") == 0) {
@@ -1417,6 +1561,9 @@ int main(int argc, char *argv[])
 		printf("'%s'-->%hu\n", argv[2], strtou16_or_err(argv[2], "strtou16 failed"));
 		return EXIT_SUCCESS;
 
+	} else if (argc == 4 && strcmp(argv[1], "--scan") == 0) {
+		return test_strutils_scan(argc - 1, argv + 1);
+
 	} else if (argc == 4 && strcmp(argv[1], "--strchr-escaped") == 0) {
 		printf("\"%s\" --> \"%s\"\n", argv[2], ul_strchr_escaped(argv[2], *argv[3]));
 		return EXIT_SUCCESS;
@@ -1437,7 +1584,8 @@ int main(int argc, char *argv[])
 				"       %1$s --stralnumcmp <str> <str>\n"
 				"       %1$s --cstrcasecmp <str> <str>\n"
 				"       %1$s --normalize <str>\n"
-				"       %1$s --strto{s,u}{16,32,64} <str>\n",
+				"       %1$s --strto{s,u}{16,32,64} <str>\n"
+				"       %1$s --scan {u64,x64} <str>\n",
 				argv[0]);
 		exit(EXIT_FAILURE);
 	}
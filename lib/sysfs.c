@@ -300,6 +300,78 @@ dev_t sysfs_blkdev_partno_to_devno(struct path_cxt *pc, int partno)
 }
 
 
+static int cmp_partno(const void *a, const void *b)
+{
+	const struct sysfs_blkdev_part *x = a, *y = b;
+
+	return x->partno < y->partno ? -1 : x->partno > y->partno;
+}
+
+/*
+ * Reads all partitions of the whole disk @pc as they are known by kernel,
+ * the array is sorted by partition numbers and should be deallocated by
+ * free(). It's cheaper than sysfs_blkdev_partno_to_devno() for each
+ * partition, as the directory is read only once.
+ *
+ * Returns number of partitions or <0 on error.
+ */
+int sysfs_blkdev_get_partitions(struct path_cxt *pc, struct sysfs_blkdev_part **parts)
+{
+	DIR *dir;
+	struct dirent *d;
+	struct sysfs_blkdev_part *res = NULL;
+	size_t n = 0, nalloc = 0;
+
+	*parts = NULL;
+
+	dir = ul_path_opendir(pc, NULL);
+	if (!dir)
+		return -errno;
+
+	while ((d = xreaddir(dir))) {
+		struct sysfs_blkdev_part *x;
+
+		if (!sysfs_blkdev_is_partition_dirent(dir, d, NULL))
+			continue;
+		if (n == nalloc) {
+			void *tmp;
+
+			nalloc = nalloc ? nalloc * 2 : 16;
+			tmp = realloc(res, nalloc * sizeof(*res));
+			if (!tmp) {
+				free(res);
+				closedir(dir);
+				return -ENOMEM;
+			}
+			res = tmp;
+		}
+		x = &res[n];
+		if (ul_path_readf_s32(pc, &x->partno, "%s/partition", d->d_name)
+		    || ul_path_readf_u64(pc, &x->start, "%s/start", d->d_name)
+		    || ul_path_readf_u64(pc, &x->size, "%s/size", d->d_name))
+			continue;
+		n++;
+	}
+	closedir(dir);
+
+	if (n)
+		qsort(res, n, sizeof(*res), cmp_partno);
+
+	DBG(CXT, ul_debugobj(pc, "kernel partitions: %zu", n));
+	*parts = res;
+	return n;
+}
+
+struct sysfs_blkdev_part *sysfs_blkdev_find_partition(struct sysfs_blkdev_part *parts,
+				size_t nparts, int partno)
+{
+	struct sysfs_blkdev_part key = { .partno = partno };
+
+	if (!parts || !nparts)
+		return NULL;
+	return bsearch(&key, parts, nparts, sizeof(*parts), cmp_partno);
+}
+
 /*
  * Returns slave name if there is only one slave, otherwise returns NULL.
  * The result should be deallocated by free().
@@ -632,21 +704,141 @@ err:
     return -1;
 }
 
+/*
+ * Optional process-wide cache for sysfs_devno_to_devname(),
+ * sysfs_devno_to_wholedisk() and sysfs_devno_is_dm_private(). The functions
+ * read the real /sys (no prefix) and the results for the same devno are the
+ * same until the devices are changed, so the cache is disabled by default and
+ * the application is expected to call sysfs_devno_cache_invalidate() when it
+ * knows the devices have been changed. The cache is not thread-safe.
+ */
+struct sysfs_devno_entry {
+	dev_t	devno;
+
+	char	*name;		/* sysfs_devno_to_devname() */
+	char	*diskname;	/* sysfs_devno_to_wholedisk() */
+	dev_t	disk;
+	char	*dm_uuid;	/* sysfs_devno_is_dm_private() */
+	int	dm_private;
+
+	unsigned int	has_disk : 1,
+			has_dm : 1;
+};
+
+static struct sysfs_devno_entry *devno_cache;	/* sorted by devno */
+static size_t devno_cache_nents, devno_cache_nalloc;
+static int devno_cache_enabled;
+
+void sysfs_devno_cache_invalidate(void)
+{
+	size_t i;
+
+	for (i = 0; i < devno_cache_nents; i++) {
+		free(devno_cache[i].name);
+		free(devno_cache[i].diskname);
+		free(devno_cache[i].dm_uuid);
+	}
+	free(devno_cache);
+	devno_cache = NULL;
+	devno_cache_nents = devno_cache_nalloc = 0;
+}
+
+void sysfs_devno_cache_enable(int enable)
+{
+	devno_cache_enabled = enable ? 1 : 0;
+	if (!enable)
+		sysfs_devno_cache_invalidate();
+}
+
+/* returns entry for @devno, or NULL if the cache is disabled */
+static struct sysfs_devno_entry *devno_cache_get(dev_t devno, int create)
+{
+	size_t lo = 0, hi = devno_cache_nents;
+	struct sysfs_devno_entry *e;
+
+	if (!devno_cache_enabled)
+		return NULL;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+
+		if (devno_cache[mid].devno == devno)
+			return &devno_cache[mid];
+		if (devno_cache[mid].devno < devno)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (!create)
+		return NULL;
+
+	if (devno_cache_nents == devno_cache_nalloc) {
+		size_t n = devno_cache_nalloc ? devno_cache_nalloc * 2 : 32;
+
+		e = realloc(devno_cache, n * sizeof(*e));
+		if (!e)
+			return NULL;
+		devno_cache = e;
+		devno_cache_nalloc = n;
+	}
+
+	e = &devno_cache[lo];
+	memmove(e + 1, e, (devno_cache_nents - lo) * sizeof(*e));
+	memset(e, 0, sizeof(*e));
+	e->devno = devno;
+	devno_cache_nents++;
+
+	DBG(CXT, ul_debug("devno cache: add %u:%u", major(devno), minor(devno)));
+	return e;
+}
+
 int sysfs_devno_to_wholedisk(dev_t devno, char *diskname,
 		             size_t len, dev_t *diskdevno)
 {
+	struct sysfs_devno_entry *e;
 	struct path_cxt *pc;
+	char buf[PATH_MAX];
+	dev_t disk = 0;
 	int rc = 0;
 
 	if (!devno)
 		return -EINVAL;
+
+	e = devno_cache_get(devno, 0);
+	if (e && e->has_disk) {
+		if (diskname && len)
+			xstrncpy(diskname, e->diskname, len);
+		if (diskdevno)
+			*diskdevno = e->disk;
+		return 0;
+	}
+
 	pc = ul_new_sysfs_path(devno, NULL, NULL);
 	if (!pc)
 		return -ENOMEM;
 
-	rc = sysfs_blkdev_get_wholedisk(pc, diskname, len, diskdevno);
+	if (!devno_cache_enabled) {
+		rc = sysfs_blkdev_get_wholedisk(pc, diskname, len, diskdevno);
+		ul_unref_path(pc);
+		return rc;
+	}
+
+	/* read all for the cache */
+	rc = sysfs_blkdev_get_wholedisk(pc, buf, sizeof(buf), &disk);
 	ul_unref_path(pc);
-	return rc;
+	if (rc)
+		return rc;
+
+	e = devno_cache_get(devno, 1);
+	if (e && !e->has_disk && (e->diskname = strdup(buf))) {
+		e->disk = disk;
+		e->has_disk = 1;
+	}
+	if (diskname && len)
+		xstrncpy(diskname, buf, len);
+	if (diskdevno)
+		*diskdevno = disk;
+	return 0;
 }
 
 /*
@@ -655,10 +847,18 @@ int sysfs_devno_to_wholedisk(dev_t devno, char *diskname,
  */
 int sysfs_devno_is_dm_private(dev_t devno, char **uuid)
 {
+	struct sysfs_devno_entry *e;
 	struct path_cxt *pc = NULL;
 	char *id = NULL;
 	int rc = 0;
 
+	e = devno_cache_get(devno, 0);
+	if (e && e->has_dm) {
+		if (uuid)
+			*uuid = e->dm_uuid ? strdup(e->dm_uuid) : NULL;
+		return e->dm_private;
+	}
+
 	pc = ul_new_sysfs_path(devno, NULL, NULL);
 	if (!pc)
 		goto done;
@@ -680,6 +880,12 @@ int sysfs_devno_is_dm_private(dev_t devno, char **uuid)
 		rc = 1;
 	}
 done:
+	/* the path is NULL on error, don't cache the result */
+	e = pc ? devno_cache_get(devno, 1) : NULL;
+	if (e && (!id || (e->dm_uuid = strdup(id)))) {
+		e->dm_private = rc;
+		e->has_dm = 1;
+	}
 	ul_unref_path(pc);
 	if (uuid)
 		*uuid = id;
@@ -1052,13 +1258,23 @@ char *sysfs_devno_to_devpath(dev_t devno, char *buf, size_t bufsiz)
 
 char *sysfs_devno_to_devname(dev_t devno, char *buf, size_t bufsiz)
 {
-	struct path_cxt *pc = ul_new_sysfs_path(devno, NULL, NULL);
+	struct sysfs_devno_entry *e = devno_cache_get(devno, 0);
+	struct path_cxt *pc;
 	char *res = NULL;
 
+	if (e && e->name) {
+		if (strlen(e->name) >= bufsiz)
+			return NULL;
+		return strcpy(buf, e->name);
+	}
+
+	pc = ul_new_sysfs_path(devno, NULL, NULL);
 	if (pc) {
 		res = sysfs_blkdev_get_name(pc, buf, bufsiz);
 		ul_unref_path(pc);
 	}
+	if (res && (e = devno_cache_get(devno, 1)) && !e->name)
+		e->name = strdup(res);
 	return res;
 }
 
@@ -0,0 +1,170 @@
+/*
+ * Tracing spans, see include/ultrace.h
+ *
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "c.h"
+#include "env.h"
+#include "monotonic.h"
+#include "ultrace.h"
+
+#define ULTRACE_NEVENTS		8192	/* per thread */
+
+#ifdef HAVE_TLS
+# define THREAD_LOCAL static __thread
+#else
+# define THREAD_LOCAL static
+#endif
+
+struct ul_trace_event {
+	const char	*name;
+	uint64_t	ts;		/* nanoseconds */
+	char		phase;		/* 'B'egin or 'E'nd */
+};
+
+struct ul_trace_buffer {
+	struct ul_trace_buffer	*next;
+	pid_t			pid;
+	pid_t			tid;
+
+	/* number of all events; the ring keeps only the last ULTRACE_NEVENTS */
+	size_t			nevents;
+	struct ul_trace_event	events[ULTRACE_NEVENTS];
+};
+
+enum {
+	ULTRACE_UNKNOWN = 0,
+	ULTRACE_INIT,
+	ULTRACE_ENABLED,
+	ULTRACE_DISABLED
+};
+
+static int trace_state;
+static const char *trace_file;
+
+/* all per-thread buffers; the buffers are never freed as the threads may
+ * still run when the trace is written */
+static struct ul_trace_buffer *trace_buffers;
+THREAD_LOCAL struct ul_trace_buffer *trace_buffer;
+
+static void trace_write(void)
+{
+	struct ul_trace_buffer *b;
+	pid_t pid = getpid();
+	struct stat st;
+	FILE *f;
+	int fd;
+
+	fd = open(trace_file, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return;
+
+	/* more libraries and processes may write to the same file */
+	if (flock(fd, LOCK_EX) != 0 || fstat(fd, &st) != 0
+	    || !(f = fdopen(fd, "a"))) {
+		close(fd);
+		return;
+	}
+
+	/* the closing ']' is optional in the trace event format */
+	if (st.st_size == 0)
+		fputs("[\n", f);
+
+	for (b = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE); b; b = b->next) {
+		size_t i = b->nevents > ULTRACE_NEVENTS ?
+				b->nevents - ULTRACE_NEVENTS : 0;
+
+		/* inherited from the parent by fork() */
+		if (b->pid != pid)
+			continue;
+
+		for (; i < b->nevents; i++) {
+			const struct ul_trace_event *ev = &b->events[i % ULTRACE_NEVENTS];
+
+			fprintf(f, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%ju.%03ju,"
+				   "\"pid\":%d,\"tid\":%d},\n",
+				ev->name, ev->phase,
+				(uintmax_t) (ev->ts / 1000), (uintmax_t) (ev->ts % 1000),
+				(int) b->pid, (int) b->tid);
+		}
+	}
+
+	fclose(f);	/* unlocks */
+}
+
+static int trace_init(void)
+{
+	int state = ULTRACE_UNKNOWN;
+
+	if (__atomic_compare_exchange_n(&trace_state, &state, ULTRACE_INIT, 0,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		trace_file = safe_getenv("ULTRACE");
+		if (trace_file && *trace_file && atexit(trace_write) == 0)
+			state = ULTRACE_ENABLED;
+		else
+			state = ULTRACE_DISABLED;
+		__atomic_store_n(&trace_state, state, __ATOMIC_RELEASE);
+	}
+
+	/* initialized by another thread */
+	while (state == ULTRACE_INIT)
+		state = __atomic_load_n(&trace_state, __ATOMIC_ACQUIRE);
+
+	return state;
+}
+
+static struct ul_trace_buffer *get_buffer(void)
+{
+	struct ul_trace_buffer *b;
+
+	if (trace_buffer)
+		return trace_buffer;
+
+	b = calloc(1, sizeof(*b));
+	if (!b)
+		return NULL;
+
+	b->pid = getpid();
+	b->tid = (pid_t) syscall(SYS_gettid);
+	b->next = __atomic_load_n(&trace_buffers, __ATOMIC_RELAXED);
+
+	while (!__atomic_compare_exchange_n(&trace_buffers, &b->next, b, 1,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+	trace_buffer = b;
+	return b;
+}
+
+void ul_trace_event(char phase, const char *name)
+{
+	int state = __atomic_load_n(&trace_state, __ATOMIC_RELAXED);
+	struct ul_trace_buffer *b;
+	struct ul_trace_event *ev;
+	struct timespec ts;
+
+	if (state == ULTRACE_UNKNOWN || state == ULTRACE_INIT)
+		state = trace_init();
+	if (state != ULTRACE_ENABLED)
+		return;
+
+	b = get_buffer();
+	if (!b || clock_gettime(UL_CLOCK_MONOTONIC, &ts) != 0)
+		return;
+
+	ev = &b->events[b->nevents % ULTRACE_NEVENTS];
+	ev->name = name;
+	ev->phase = phase;
+	ev->ts = (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+	b->nevents++;
+}
@@ -0,0 +1,594 @@
+/*
+ * Please, don't add this file to libcommon because it requires -lpthread on
+ * systems with old libc.
+ *
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * ul_walkdir() walks the tree like nftw(FTW_PHYS). The directories are read
+ * and the entries stat()ed by worker threads ahead of the walk, the callback
+ * is called by the caller's thread in the same order as nftw() calls it. The
+ * caller reads (steals) the directory itself if no worker has started it
+ * yet, so the walk never waits for a queued directory.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#include "c.h"
+#include "walkdir.h"
+
+/* getdents64() buffer, glibc readdir() uses 32KiB */
+#define WALKDIR_BUFSIZ		(128 * 1024)
+
+/* max number of read entries not visited yet; the workers wait */
+#define WALKDIR_MAX_PENDING	(64 * 1024)
+
+#if defined(SYS_getdents64) && defined(__linux__)
+# define USE_GETDENTS64 1
+
+struct wd_dirent64 {
+	uint64_t	d_ino;
+	int64_t		d_off;
+	unsigned short	d_reclen;
+	unsigned char	d_type;
+	char		d_name[];
+};
+#endif
+
+enum {
+	WD_QUEUED = 0,
+	WD_READING,
+	WD_DONE
+};
+
+struct wd_entry {
+	struct stat	st;
+	int		type;		/* FTW_* */
+	size_t		name;		/* offset in wd_dir->names */
+	struct wd_dir	*sub;		/* FTW_D only */
+};
+
+struct wd_dir {
+	char		*path;
+	size_t		pathlen;
+	int		level;
+	int		state;		/* WD_* */
+	int		errsv;		/* cannot open the directory */
+
+	struct wd_entry	*ents;
+	size_t		nents;
+	char		*names;
+	size_t		namesz;
+	size_t		namesalloc;
+
+	struct wd_dir	*next;		/* stack of the queued directories */
+	struct wd_dir	*all;		/* list of all directories */
+};
+
+struct wd_walk {
+	unsigned int	flags;
+	struct wd_dir	*stack;		/* directories to read, the next needed is on top */
+	struct wd_dir	*all;
+	size_t		pending;	/* read but not visited entries */
+	int		stop;		/* the walk is over */
+
+	char		*buf;		/* getdents64() buffer for the caller's thread */
+	char		*fpath;		/* path for the callback */
+	size_t		fpathsz;
+
+#ifdef HAVE_PTHREAD
+	int		threaded;
+	pthread_mutex_t	lock;
+	pthread_cond_t	done;		/* a directory has been read */
+	pthread_cond_t	work;		/* a directory has been queued or visited */
+#endif
+};
+
+static inline void wd_lock(struct wd_walk *wd __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD
+	if (wd->threaded)
+		pthread_mutex_lock(&wd->lock);
+#endif
+}
+
+static inline void wd_unlock(struct wd_walk *wd __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD
+	if (wd->threaded)
+		pthread_mutex_unlock(&wd->lock);
+#endif
+}
+
+static struct wd_dir *new_dir(const char *path, size_t pathlen,
+			      const char *name, int level)
+{
+	size_t namelen = name ? strlen(name) : 0;
+	int sep = name && pathlen && path[pathlen - 1] != '/';
+	struct wd_dir *dir;
+
+	dir = calloc(1, sizeof(*dir));
+	if (!dir)
+		return NULL;
+	dir->pathlen = pathlen + sep + namelen;
+	dir->path = malloc(dir->pathlen + 1);
+	if (!dir->path) {
+		free(dir);
+		return NULL;
+	}
+	memcpy(dir->path, path, pathlen);
+	if (sep)
+		dir->path[pathlen] = '/';
+	if (name)
+		memcpy(dir->path + pathlen + sep, name, namelen);
+	dir->path[dir->pathlen] = '\0';
+	dir->level = level;
+	return dir;
+}
+
+static void free_dir_entries(struct wd_dir *dir)
+{
+	free(dir->ents);
+	free(dir->names);
+	dir->ents = NULL;
+	dir->names = NULL;
+	dir->nents = dir->namesz = dir->namesalloc = 0;
+}
+
+static int add_entry(struct wd_walk *wd, struct wd_dir *dir, int dfd,
+		     const char *name, unsigned char dtype)
+{
+	struct wd_entry *ent;
+	size_t namelen;
+
+	if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+		return 0;
+
+	if ((wd->flags & UL_WALKDIR_REGULAR)
+	    && dtype != DT_UNKNOWN && dtype != DT_REG && dtype != DT_DIR)
+		return 0;
+
+	if (dir->nents % 64 == 0) {
+		struct wd_entry *tmp = realloc(dir->ents,
+				(dir->nents + 64) * sizeof(struct wd_entry));
+		if (!tmp)
+			return -ENOMEM;
+		dir->ents = tmp;
+	}
+	ent = &dir->ents[dir->nents];
+	memset(ent, 0, sizeof(*ent));
+
+	if ((wd->flags & UL_WALKDIR_REGULAR) && dtype == DT_DIR)
+		ent->type = FTW_D;
+	else if (fstatat(dfd, name, &ent->st, AT_SYMLINK_NOFOLLOW) != 0)
+		ent->type = FTW_NS;
+	else if (S_ISDIR(ent->st.st_mode))
+		ent->type = FTW_D;
+	else if (S_ISLNK(ent->st.st_mode))
+		ent->type = FTW_SL;
+	else
+		ent->type = FTW_F;
+
+	if ((wd->flags & UL_WALKDIR_REGULAR)
+	    && (ent->type == FTW_SL
+		|| (ent->type == FTW_F && !S_ISREG(ent->st.st_mode))))
+		return 0;
+
+	if (ent->type == FTW_D) {
+		ent->sub = new_dir(dir->path, dir->pathlen, name, dir->level + 1);
+		if (!ent->sub)
+			return -ENOMEM;
+	}
+
+	namelen = strlen(name) + 1;
+	if (dir->namesz + namelen > dir->namesalloc) {
+		size_t sz = max(dir->namesalloc * 2, (size_t) 4096);
+		char *tmp;
+
+		if (sz < dir->namesz + namelen)
+			sz = dir->namesz + namelen;
+		tmp = realloc(dir->names, sz);
+		if (!tmp) {
+			free(ent->sub ? ent->sub->path : NULL);
+			free(ent->sub);
+			return -ENOMEM;
+		}
+		dir->names = tmp;
+		dir->namesalloc = sz;
+	}
+	memcpy(dir->names + dir->namesz, name, namelen);
+	ent->name = dir->namesz;
+	dir->namesz += namelen;
+	dir->nents++;
+	return 0;
+}
+
+/* reads the directory, @buf is WALKDIR_BUFSIZ buffer */
+static void read_dir(struct wd_walk *wd, struct wd_dir *dir, char *buf)
+{
+	int fd;
+
+	fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0) {
+		dir->errsv = errno;
+		return;
+	}
+#ifdef USE_GETDENTS64
+	while (!wd->stop) {
+		long n = syscall(SYS_getdents64, fd, buf, WALKDIR_BUFSIZ);
+		long off;
+
+		if (n <= 0)
+			break;
+		for (off = 0; off < n; ) {
+			struct wd_dirent64 *d = (struct wd_dirent64 *) (buf + off);
+
+			if (add_entry(wd, dir, fd, d->d_name, d->d_type) != 0)
+				goto done;
+			off += d->d_reclen;
+		}
+	}
+done:
+	close(fd);
+#else
+	{
+		DIR *dp = fdopendir(fd);
+		struct dirent *d;
+
+		(void) buf;
+		if (!dp) {
+			dir->errsv = errno;
+			close(fd);
+			return;
+		}
+		while (!wd->stop && (d = readdir(dp))) {
+			if (add_entry(wd, dir, dirfd(dp), d->d_name, d->d_type) != 0)
+				break;
+		}
+		closedir(dp);
+	}
+#endif
+}
+
+/* call with locked @wd */
+static void finish_dir(struct wd_walk *wd, struct wd_dir *dir)
+{
+	size_t i;
+
+	/* the first subdirectory is needed first, so it's pushed last */
+	for (i = dir->nents; i > 0; i--) {
+		struct wd_dir *sub = dir->ents[i - 1].sub;
+
+		if (!sub)
+			continue;
+		sub->next = wd->stack;
+		wd->stack = sub;
+		sub->all = wd->all;
+		wd->all = sub;
+	}
+	wd->pending += dir->nents;
+	dir->state = WD_DONE;
+#ifdef HAVE_PTHREAD
+	if (wd->threaded) {
+		pthread_cond_broadcast(&wd->done);
+		pthread_cond_broadcast(&wd->work);
+	}
+#endif
+}
+
+/* makes sure @dir is read; reads it if no worker has started it */
+static void wait_dir(struct wd_walk *wd, struct wd_dir *dir)
+{
+	wd_lock(wd);
+	if (dir->state == WD_QUEUED) {
+		dir->state = WD_READING;
+		wd_unlock(wd);
+
+		read_dir(wd, dir, wd->buf);
+
+		wd_lock(wd);
+		finish_dir(wd, dir);
+	}
+#ifdef HAVE_PTHREAD
+	while (dir->state != WD_DONE)
+		pthread_cond_wait(&wd->done, &wd->lock);
+#endif
+	wd_unlock(wd);
+}
+
+static void release_dir(struct wd_walk *wd, struct wd_dir *dir)
+{
+	wd_lock(wd);
+	wd->pending -= dir->nents;
+#ifdef HAVE_PTHREAD
+	if (wd->threaded)
+		pthread_cond_broadcast(&wd->work);
+#endif
+	wd_unlock(wd);
+
+	free_dir_entries(dir);
+	free(dir->path);
+	dir->path = NULL;
+}
+
+static const char *set_fpath(struct wd_walk *wd, struct wd_dir *dir,
+			     const char *name, int *base)
+{
+	size_t namelen = strlen(name);
+	int sep = dir->pathlen && dir->path[dir->pathlen - 1] != '/';
+	size_t sz = dir->pathlen + sep + namelen + 1;
+
+	if (sz > wd->fpathsz) {
+		char *tmp = realloc(wd->fpath, sz);
+		if (!tmp)
+			return NULL;
+		wd->fpath = tmp;
+		wd->fpathsz = sz;
+	}
+	memcpy(wd->fpath, dir->path, dir->pathlen);
+	if (sep)
+		wd->fpath[dir->pathlen] = '/';
+	memcpy(wd->fpath + dir->pathlen + sep, name, namelen + 1);
+	*base = dir->pathlen + sep;
+	return wd->fpath;
+}
+
+static int walk_dir(struct wd_walk *wd, struct wd_dir *dir, const struct stat *sb,
+		    int base, ul_walkdir_cb fn)
+{
+	struct FTW ftw = { .base = base, .level = dir->level };
+	size_t i;
+	int rc = 0;
+
+	wait_dir(wd, dir);
+
+	if (dir->errsv) {
+		errno = dir->errsv;
+		return fn(dir->path, sb, FTW_DNR, &ftw);
+	}
+	if (!(wd->flags & UL_WALKDIR_REGULAR)) {
+		rc = fn(dir->path, sb, FTW_D, &ftw);
+		if (rc)
+			goto done;
+	}
+
+	for (i = 0; i < dir->nents; i++) {
+		struct wd_entry *ent = &dir->ents[i];
+		const char *name = dir->names + ent->name;
+
+		if (ent->sub) {
+			base = ent->sub->pathlen - strlen(name);
+			rc = walk_dir(wd, ent->sub, &ent->st, base, fn);
+		} else {
+			const char *fpath = set_fpath(wd, dir, name, &ftw.base);
+
+			if (!fpath) {
+				rc = -1;
+				break;
+			}
+			ftw.level = dir->level + 1;
+			rc = fn(fpath, &ent->st, ent->type, &ftw);
+		}
+		if (rc)
+			break;
+	}
+done:
+	release_dir(wd, dir);
+	return rc;
+}
+
+#ifdef HAVE_PTHREAD
+static void *walk_worker(void *data)
+{
+	struct wd_walk *wd = data;
+	char *buf = malloc(WALKDIR_BUFSIZ);
+
+	if (!buf)
+		return NULL;
+
+	pthread_mutex_lock(&wd->lock);
+	while (!wd->stop) {
+		struct wd_dir *dir = wd->stack;
+
+		if (!dir || wd->pending >= WALKDIR_MAX_PENDING) {
+			pthread_cond_wait(&wd->work, &wd->lock);
+			continue;
+		}
+		wd->stack = dir->next;
+		if (dir->state != WD_QUEUED)
+			continue;		/* stolen by the walk */
+
+		dir->state = WD_READING;
+		pthread_mutex_unlock(&wd->lock);
+
+		read_dir(wd, dir, buf);
+
+		pthread_mutex_lock(&wd->lock);
+		finish_dir(wd, dir);
+	}
+	pthread_mutex_unlock(&wd->lock);
+
+	free(buf);
+	return NULL;
+}
+#endif
+
+/**
+ * ul_walkdir:
+ * @path: the file or directory
+ * @fn: callback, see nftw()
+ * @flags: UL_WALKDIR_* flags
+ * @nthreads: number of threads reading the directories, 0 or 1 for none
+ *
+ * Walks the tree like nftw(@path, @fn, ..., FTW_PHYS). The @fn is called
+ * in the same order as by nftw(), always from the caller's thread. The stat
+ * buffer for FTW_DNR is zeroed if UL_WALKDIR_REGULAR is set.
+ *
+ * Returns: 0 on success, -1 if @path cannot be stat()ed, or the non-zero
+ *          value returned by @fn.
+ */
+int ul_walkdir(const char *path, ul_walkdir_cb fn, unsigned int flags,
+	       size_t nthreads)
+{
+	struct wd_walk wd = { .flags = flags };
+	struct wd_dir *root;
+	struct stat st;
+	size_t len;
+	int rc, base;
+#ifdef HAVE_PTHREAD
+	pthread_t *threads = NULL;
+	size_t i, nthr = 0;
+#endif
+
+	/* like nftw(), the trailing slashes are not used in the paths */
+	len = strlen(path);
+	while (len > 1 && path[len - 1] == '/')
+		len--;
+	for (base = len; base > 0 && path[base - 1] != '/'; base--)
+		;
+	if (base == 0 && len == 1 && *path == '/')
+		base = 1;
+
+	if (lstat(path, &st) != 0)
+		return -1;
+
+	if (!S_ISDIR(st.st_mode)) {
+		struct FTW ftw = { .base = base, .level = 0 };
+
+		if ((flags & UL_WALKDIR_REGULAR) && !S_ISREG(st.st_mode))
+			return 0;
+		return fn(path, &st, S_ISLNK(st.st_mode) ? FTW_SL : FTW_F, &ftw);
+	}
+
+	root = new_dir(path, len, NULL, 0);
+	wd.buf = malloc(WALKDIR_BUFSIZ);
+	if (!root || !wd.buf) {
+		free(root ? root->path : NULL);
+		free(root);
+		free(wd.buf);
+		return -1;
+	}
+	wd.stack = wd.all = root;
+
+#ifdef HAVE_PTHREAD
+	if (nthreads > 1) {
+		pthread_mutex_init(&wd.lock, NULL);
+		pthread_cond_init(&wd.done, NULL);
+		pthread_cond_init(&wd.work, NULL);
+		wd.threaded = 1;
+
+		threads = calloc(nthreads, sizeof(pthread_t));
+		for (i = 0; threads && i < nthreads; i++) {
+			if (pthread_create(&threads[nthr], NULL, walk_worker, &wd) != 0)
+				break;
+			nthr++;
+		}
+	}
+#endif
+	rc = walk_dir(&wd, root, &st, base, fn);
+
+#ifdef HAVE_PTHREAD
+	if (wd.threaded) {
+		wd_lock(&wd);
+		wd.stop = 1;
+		pthread_cond_broadcast(&wd.work);
+		wd_unlock(&wd);
+
+		for (i = 0; i < nthr; i++)
+			pthread_join(threads[i], NULL);
+		free(threads);
+
+		pthread_cond_destroy(&wd.work);
+		pthread_cond_destroy(&wd.done);
+		pthread_mutex_destroy(&wd.lock);
+	}
+#endif
+	while (wd.all) {
+		struct wd_dir *dir = wd.all;
+
+		wd.all = dir->all;
+		free_dir_entries(dir);
+		free(dir->path);
+		free(dir);
+	}
+	free(wd.buf);
+	free(wd.fpath);
+	return rc;
+}
+
+#ifdef TEST_PROGRAM_WALKDIR
+#include <stdio.h>
+#include <getopt.h>
+
+static FILE *out;
+static int regular;
+
+static int print_entry(const char *fpath, const struct stat *sb,
+		       int typeflag, struct FTW *ftwbuf)
+{
+	static const char *types[] = {
+		[FTW_F] = "F", [FTW_D] = "D", [FTW_DNR] = "DNR",
+		[FTW_NS] = "NS", [FTW_SL] = "SL"
+	};
+
+	if (regular && (typeflag == FTW_D || typeflag == FTW_SL
+			|| (typeflag == FTW_F && !S_ISREG(sb->st_mode))))
+		return 0;
+
+	fprintf(out, "%s %d %d %s", types[typeflag], ftwbuf->level, ftwbuf->base, fpath);
+	if (typeflag == FTW_F)
+		fprintf(out, " %ju:%ju", (uintmax_t) sb->st_dev, (uintmax_t) sb->st_ino);
+	fputc('\n', out);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option longopts[] = {
+		{ "nftw",    no_argument,       NULL, 'n' },
+		{ "regular", no_argument,       NULL, 'r' },
+		{ "threads", required_argument, NULL, 't' },
+		{ NULL, 0, NULL, 0 },
+	};
+	size_t nthreads = 0;
+	int c, use_nftw = 0, rc;
+
+	out = stdout;
+	while ((c = getopt_long(argc, argv, "nrt:", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'n':
+			use_nftw = 1;
+			break;
+		case 'r':
+			regular = 1;
+			break;
+		case 't':
+			nthreads = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind + 1 != argc) {
+		fprintf(stderr, "usage: %s [--nftw] [--regular] [--threads <num>] <path>\n",
+				program_invocation_short_name);
+		return EXIT_FAILURE;
+	}
+
+	if (use_nftw)
+		rc = nftw(argv[optind], print_entry, 20, FTW_PHYS);
+	else
+		rc = ul_walkdir(argv[optind], print_entry,
+				regular ? UL_WALKDIR_REGULAR : 0, nthreads);
+
+	return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif /* TEST_PROGRAM_WALKDIR */
@@ -0,0 +1,237 @@
+/*
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * Probing benchmark. The images are mapped to memory and the library reads
+ * them by a read callback, so the results do not depend on page cache or disk
+ * speed, but the library still does all the usual I/O requests and buffer
+ * management. The results are printed as one JSON object per line.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include <blkid.h>
+
+#include "c.h"
+#include "strutils.h"
+
+struct image {
+	const char	*name;
+	const unsigned char *data;
+	uint64_t	size;
+};
+
+struct result {
+	uint64_t	nreads;
+	uint64_t	nbytes;
+	uint64_t	usec;
+	char		type[64];
+};
+
+static ssize_t read_image(void *data, void *buf, size_t count, uint64_t offset)
+{
+	struct image *img = data;
+
+	if (offset >= img->size)
+		return 0;
+	if (count > img->size - offset)
+		count = img->size - offset;
+	memcpy(buf, img->data + offset, count);
+	return count;
+}
+
+static uint64_t cpu_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void print_string(const char *name, const char *str)
+{
+	printf("\"%s\":\"", name);
+	for (; str && *str; str++) {
+		if (*str == '"' || *str == '\\')
+			putchar('\\');
+		if ((unsigned char) *str < 0x20)
+			printf("\\u%04x", *str);
+		else
+			putchar(*str);
+	}
+	putchar('"');
+}
+
+static int probe_image(struct image *img, int full, struct result *res)
+{
+	blkid_probe pr;
+	const char *type = NULL;
+	uint64_t start;
+	int rc;
+
+	pr = blkid_new_probe();
+	if (!pr)
+		return -ENOMEM;
+	rc = blkid_probe_set_reader(pr, read_image, img, img->size);
+	if (rc)
+		goto done;
+
+	blkid_probe_enable_stats(pr, 1);
+	blkid_probe_enable_superblocks(pr, 1);
+	blkid_probe_set_superblocks_flags(pr,
+			BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+			BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE |
+			BLKID_SUBLKS_USAGE | BLKID_SUBLKS_VERSION);
+	blkid_probe_enable_partitions(pr, 1);
+	blkid_probe_set_partitions_flags(pr, BLKID_PARTS_ENTRY_DETAILS);
+
+	start = cpu_usec();
+	rc = full ? blkid_do_fullprobe(pr) : blkid_do_safeprobe(pr);
+	res->usec += cpu_usec() - start;
+
+	if (rc == -2)
+		rc = 0;		/* ambivalent result is still a result */
+	if (rc < 0)
+		goto done;
+
+	if (blkid_probe_lookup_value(pr, "TYPE", &type, NULL) != 0 &&
+	    blkid_probe_lookup_value(pr, "PTTYPE", &type, NULL) != 0)
+		type = "none";
+	xstrncpy(res->type, type, sizeof(res->type));
+
+	blkid_probe_get_stats(pr, &res->nreads, &res->nbytes, NULL, NULL);
+	rc = 0;
+done:
+	blkid_free_probe(pr);
+	return rc;
+}
+
+static void __attribute__((__noreturn__)) usage(int status)
+{
+	fprintf(status ? stderr : stdout, "usage: %s [options] <image> ...\n"
+			"  -f, --full          use blkid_do_fullprobe()\n"
+			"  -n, --iterations N  number of probes for each image (default 100)\n"
+			"  -z, --zeros MiB     add zero-filled image (no signature)\n"
+			"  -h, --help          display this help\n",
+			program_invocation_short_name);
+	exit(status);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option longopts[] = {
+		{ "full",	no_argument,       NULL, 'f' },
+		{ "iterations",	required_argument, NULL, 'n' },
+		{ "zeros",	required_argument, NULL, 'z' },
+		{ "help",	no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	struct image *imgs = NULL;
+	size_t nimgs = 0, i;
+	unsigned long niter = 100;
+	int c, full = 0, rc = EXIT_SUCCESS;
+
+	while ((c = getopt_long(argc, argv, "fn:z:h", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'f':
+			full = 1;
+			break;
+		case 'n':
+			niter = strtoul(optarg, NULL, 10);
+			if (!niter)
+				errx(EXIT_FAILURE, "invalid number of iterations: %s", optarg);
+			break;
+		case 'z':
+		{
+			unsigned long mib = strtoul(optarg, NULL, 10);
+			char *name;
+			void *data;
+
+			if (!mib)
+				errx(EXIT_FAILURE, "invalid size: %s", optarg);
+			data = calloc(mib, 1024 * 1024);
+			imgs = realloc(imgs, (nimgs + 1) * sizeof(*imgs));
+			if (!data || !imgs || asprintf(&name, "zeros-%luM", mib) < 0)
+				err(EXIT_FAILURE, "cannot allocate image");
+			imgs[nimgs].name = name;
+			imgs[nimgs].data = data;
+			imgs[nimgs].size = (uint64_t) mib * 1024 * 1024;
+			nimgs++;
+			break;
+		}
+		case 'h':
+			usage(EXIT_SUCCESS);
+		default:
+			usage(EXIT_FAILURE);
+		}
+	}
+
+	for (i = optind; i < (size_t) argc; i++) {
+		struct stat st;
+		void *data;
+		int fd = open(argv[i], O_RDONLY | O_CLOEXEC);
+
+		if (fd < 0 || fstat(fd, &st) != 0)
+			err(EXIT_FAILURE, "%s: cannot open", argv[i]);
+		if (st.st_size == 0) {
+			warnx("%s: empty file, ignore", argv[i]);
+			close(fd);
+			continue;
+		}
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+			err(EXIT_FAILURE, "%s: cannot map", argv[i]);
+		close(fd);
+
+		imgs = realloc(imgs, (nimgs + 1) * sizeof(*imgs));
+		if (!imgs)
+			err(EXIT_FAILURE, "cannot allocate image");
+		imgs[nimgs].name = argv[i];
+		imgs[nimgs].data = data;
+		imgs[nimgs].size = st.st_size;
+		nimgs++;
+	}
+
+	if (!nimgs)
+		usage(EXIT_FAILURE);
+
+	for (i = 0; i < nimgs; i++) {
+		struct result res = { .usec = 0 };
+		unsigned long n;
+
+		for (n = 0; n < niter; n++) {
+			if (probe_image(&imgs[i], full, &res) != 0)
+				break;
+		}
+		if (n < niter) {
+			warnx("%s: probing failed", imgs[i].name);
+			rc = EXIT_FAILURE;
+			continue;
+		}
+
+		putchar('{');
+		print_string("image", imgs[i].name);
+		putchar(',');
+		print_string("type", res.type);
+		putchar(',');
+		print_string("mode", full ? "fullprobe" : "safeprobe");
+		printf(",\"size\":%"PRIu64",\"iterations\":%lu"
+		       ",\"usec\":%"PRIu64",\"usec_per_probe\":%.2f"
+		       ",\"reads\":%"PRIu64",\"bytes\":%"PRIu64"}\n",
+			imgs[i].size, niter,
+			res.usec, (double) res.usec / niter,
+			res.nreads, res.nbytes);
+	}
+
+	return rc;
+}
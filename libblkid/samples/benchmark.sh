@@ -0,0 +1,33 @@
+#!/bin/bash
+#
+# This file may be redistributed under the terms of the
+# GNU Lesser General Public License.
+#
+# Runs sample-benchmark for all regression tests images (one image for each
+# superblock and partition table type) and for images without signature.
+#
+# usage: benchmark.sh [<sample-benchmark> [<options>]]
+#
+top_srcdir=$(cd "$(dirname "$0")/../.." && pwd)
+bench=${1:-./sample-benchmark}
+[ $# -gt 0 ] && shift
+
+if [ ! -x "$bench" ]; then
+	echo "$bench: not found (make sample-benchmark)" >&2
+	exit 1
+fi
+
+corpus=$(mktemp -d "${TMPDIR:-/tmp}/blkid-benchmark.XXXXXX") || exit 1
+trap 'rm -rf "$corpus"' EXIT
+
+for img in "$top_srcdir"/tests/ts/blkid/images-fs/*.img.xz \
+	   "$top_srcdir"/tests/ts/blkid/images-pt/*.img.xz; do
+	name=$(basename "$img" .img.xz)
+	case "$img" in
+	*/images-pt/*) name="pt-$name" ;;
+	esac
+	xz --decompress --stdout "$img" > "$corpus/$name.img" || exit 1
+done
+
+bench=$(realpath "$bench")
+cd "$corpus" && "$bench" "$@" --zeros 1 --zeros 64 *.img
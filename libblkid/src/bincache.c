@@ -0,0 +1,644 @@
+/*
+ * bincache.c - binary version of the blkid cache file
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The binary cache is written side by side with the text cache file (as
+ * <filename>.bin) and it's used to read the cache without any parsing. The
+ * file is designed to be mmap()-ed read-only; the tags are indexed by a hash
+ * table, so blkid_bincache_lookup() does not need any heap allocation.
+ *
+ * The text file is still the primary (and portable) format. The binary file
+ * is used only if it matches the text file (inode, mtime in nanoseconds and
+ * size), otherwise it's ignored and the text file is parsed.
+ *
+ * blkid_read_cache() keeps the file mapped and does not import the devices.
+ * blkid_find_dev_with_tag() imports only the devices with the requested tag,
+ * all other devices are imported by blkid_bincache_load() when they are
+ * needed (probing, iteration, cache write, ...).
+ *
+ * File format (all in native byte order, offsets are from the file begin):
+ *
+ *	struct bincache_header
+ *	struct bincache_dev	[ndevs]
+ *	struct bincache_tag	[ntags]		(sorted by device)
+ *	uint32_t		[nbuckets]	(index of the first tag in bucket)
+ *	strings					(zero terminated)
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "blkidP.h"
+#include "all-io.h"
+#include "fileutils.h"
+
+#define BINCACHE_MAGIC		"BLKIDBC"
+#define BINCACHE_VERSION	2
+#define BINCACHE_BYTEORDER	0x01020304
+#define BINCACHE_NONE		UINT32_MAX
+
+struct bincache_header {
+	char		magic[8];		/* BINCACHE_MAGIC */
+	uint32_t	version;		/* BINCACHE_VERSION */
+	uint32_t	byteorder;		/* BINCACHE_BYTEORDER */
+
+	int64_t		text_mtime;		/* text cache file stat */
+	int64_t		text_mtime_nsec;
+	uint64_t	text_ino;
+	uint64_t	text_size;
+
+	uint32_t	ndevs;
+	uint32_t	ntags;
+	uint32_t	nbuckets;		/* power of 2 */
+	uint32_t	strings_size;
+
+	uint64_t	devs_off;
+	uint64_t	tags_off;
+	uint64_t	buckets_off;
+	uint64_t	strings_off;
+	uint64_t	file_size;
+};
+
+struct bincache_dev {
+	uint64_t	devno;
+	int64_t		time;
+	int64_t		utime;
+	int32_t		pri;
+	uint32_t	name;			/* string offset */
+	uint32_t	first_tag;
+	uint32_t	ntags;
+};
+
+struct bincache_tag {
+	uint32_t	name;			/* string offset */
+	uint32_t	value;			/* string offset */
+	uint32_t	dev;			/* device index */
+	uint32_t	hash;			/* blkid_tag_hash(name, value) */
+	uint32_t	next;			/* next tag in the same bucket */
+	uint32_t	reserved;
+};
+
+static inline const struct bincache_header *get_header(struct blkid_bincache *bc)
+{
+	return (const struct bincache_header *) bc->map;
+}
+
+static const char *get_string(struct blkid_bincache *bc, uint32_t off)
+{
+	const struct bincache_header *hdr = get_header(bc);
+
+	if (off >= hdr->strings_size)
+		return NULL;
+	return (const char *) bc->map + hdr->strings_off + off;
+}
+
+static inline const struct bincache_dev *get_dev(struct blkid_bincache *bc, uint32_t idx)
+{
+	const struct bincache_header *hdr = get_header(bc);
+
+	if (idx >= hdr->ndevs)
+		return NULL;
+	return (const struct bincache_dev *) (bc->map + hdr->devs_off) + idx;
+}
+
+static inline const struct bincache_tag *get_tag(struct blkid_bincache *bc, uint32_t idx)
+{
+	const struct bincache_header *hdr = get_header(bc);
+
+	if (idx >= hdr->ntags)
+		return NULL;
+	return (const struct bincache_tag *) (bc->map + hdr->tags_off) + idx;
+}
+
+static int check_area(const struct bincache_header *hdr, uint64_t off,
+		      uint64_t nitems, size_t itemsz)
+{
+	return off >= sizeof(*hdr)
+	       && off <= hdr->file_size
+	       && off % sizeof(uint32_t) == 0
+	       && nitems <= (hdr->file_size - off) / itemsz;
+}
+
+static int check_header(const struct bincache_header *hdr, size_t size)
+{
+	if (memcmp(hdr->magic, BINCACHE_MAGIC, sizeof(BINCACHE_MAGIC)) != 0
+	    || hdr->version != BINCACHE_VERSION
+	    || hdr->byteorder != BINCACHE_BYTEORDER
+	    || hdr->file_size != size)
+		return -1;
+	if (hdr->nbuckets == 0 || (hdr->nbuckets & (hdr->nbuckets - 1)))
+		return -1;
+	if (!check_area(hdr, hdr->devs_off, hdr->ndevs, sizeof(struct bincache_dev))
+	    || !check_area(hdr, hdr->tags_off, hdr->ntags, sizeof(struct bincache_tag))
+	    || !check_area(hdr, hdr->buckets_off, hdr->nbuckets, sizeof(uint32_t))
+	    || !check_area(hdr, hdr->strings_off, hdr->strings_size, 1))
+		return -1;
+
+	/* all strings are terminated */
+	if (hdr->strings_size
+	    && *((const char *) hdr + hdr->strings_off + hdr->strings_size - 1) != '\0')
+		return -1;
+	return 0;
+}
+
+static int64_t get_mtime_nsec(const struct stat *st)
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	return st->st_mtim.tv_nsec;
+#else
+	(void) st;
+	return 0;
+#endif
+}
+
+static char *bincache_filename(const char *filename)
+{
+	char *name = NULL;
+
+	if (asprintf(&name, "%s.bin", filename) < 0)
+		return NULL;
+	return name;
+}
+
+/*
+ * Map binary cache for the text cache @filename. The binary file is ignored
+ * if it does not match (inode, mtime and size) the text file.
+ *
+ * Returns: 0 on success, <0 on error.
+ */
+int blkid_bincache_open(struct blkid_bincache *bc, const char *filename)
+{
+	const struct bincache_header *hdr;
+	struct stat st, textst;
+	char *name;
+	void *map;
+	int fd;
+
+	memset(bc, 0, sizeof(*bc));
+
+	if (!filename || stat(filename, &textst) != 0 || !S_ISREG(textst.st_mode))
+		return -BLKID_ERR_PARAM;
+
+	name = bincache_filename(filename);
+	if (!name)
+		return -BLKID_ERR_MEM;
+
+	fd = open(name, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		goto fail;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+	    || (size_t) st.st_size < sizeof(*hdr))
+		goto fail;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		goto fail;
+	close(fd);
+	fd = -1;
+
+	hdr = (const struct bincache_header *) map;
+	if (check_header(hdr, st.st_size) != 0
+	    || hdr->text_mtime != (int64_t) textst.st_mtime
+	    || hdr->text_mtime_nsec != get_mtime_nsec(&textst)
+	    || hdr->text_ino != (uint64_t) textst.st_ino
+	    || hdr->text_size != (uint64_t) textst.st_size) {
+		DBG(CACHE, ul_debug("binary cache %s is obsolete or corrupted", name));
+		munmap(map, st.st_size);
+		goto fail;
+	}
+
+	DBG(CACHE, ul_debug("mapped binary cache %s [devs=%u, tags=%u]",
+				name, hdr->ndevs, hdr->ntags));
+	bc->map = map;
+	bc->size = st.st_size;
+	free(name);
+	return 0;
+fail:
+	if (fd >= 0)
+		close(fd);
+	free(name);
+	return -BLKID_ERR_CACHE;
+}
+
+void blkid_bincache_close(struct blkid_bincache *bc)
+{
+	if (bc->map)
+		munmap(bc->map, bc->size);
+	free(bc->imported);
+	memset(bc, 0, sizeof(*bc));
+}
+
+/*
+ * Returns name of the device with tag @name=@value, the string is owned by
+ * the mapped file.
+ */
+const char *blkid_bincache_lookup(struct blkid_bincache *bc,
+				  const char *name, const char *value)
+{
+	const struct bincache_header *hdr = get_header(bc);
+	const uint32_t *buckets;
+	uint32_t hash, idx, n;
+
+	if (!bc->map)
+		return NULL;
+
+	hash = blkid_tag_hash(name, value);
+	buckets = (const uint32_t *) (bc->map + hdr->buckets_off);
+	idx = buckets[hash & (hdr->nbuckets - 1)];
+
+	/* the loop is limited to be robust against corrupted file */
+	for (n = 0; idx != BINCACHE_NONE && n < hdr->ntags; n++) {
+		const struct bincache_tag *tag = get_tag(bc, idx);
+		const char *tn, *tv;
+
+		if (!tag)
+			break;
+		if (tag->hash == hash
+		    && (tn = get_string(bc, tag->name)) && strcmp(tn, name) == 0
+		    && (tv = get_string(bc, tag->value)) && strcmp(tv, value) == 0) {
+			const struct bincache_dev *dev = get_dev(bc, tag->dev);
+
+			return dev ? get_string(bc, dev->name) : NULL;
+		}
+		idx = tag->next;
+	}
+	return NULL;
+}
+
+/*
+ * Add device @idx from the mapped binary cache to the @cache. If @merge is
+ * true, the device is merged with the device of the same name already in the
+ * cache (the same as for the text file), otherwise a new device is added.
+ */
+static int import_dev(struct blkid_bincache *bc, blkid_cache cache,
+		      uint32_t idx, int merge)
+{
+	const struct bincache_header *hdr = get_header(bc);
+	const struct bincache_dev *bd = get_dev(bc, idx);
+	const char *name;
+	blkid_dev dev;
+	uint32_t t;
+
+	if (!bd || (bc->imported && bc->imported[idx]))
+		return 0;
+	if (bc->imported)
+		bc->imported[idx] = 1;
+
+	name = get_string(bc, bd->name);
+	if (!name || *name != '/')
+		return 0;
+	if (bd->first_tag > hdr->ntags || bd->ntags > hdr->ntags - bd->first_tag)
+		return 0;
+
+	/* the same as for text file, non-existing devices are ignored */
+	if (merge)
+		dev = blkid_get_dev(cache, name, BLKID_DEV_CREATE);
+	else if (access(name, F_OK) == 0 && (dev = blkid_new_dev())) {
+		dev->bid_name = strdup(name);
+		if (!dev->bid_name) {
+			blkid_free_dev(dev);
+			return -BLKID_ERR_MEM;
+		}
+		dev->bid_cache = cache;
+		list_add_tail(&dev->bid_devs, &cache->bic_devs);
+	} else
+		dev = NULL;
+	if (!dev)
+		return 0;
+
+	dev->bid_devno = bd->devno;
+	dev->bid_time = bd->time;
+	dev->bid_utime = bd->utime;
+	dev->bid_pri = bd->pri;
+
+	for (t = bd->first_tag; t < bd->first_tag + bd->ntags; t++) {
+		const struct bincache_tag *tag = get_tag(bc, t);
+		const char *tn = get_string(bc, tag->name);
+		const char *tv = get_string(bc, tag->value);
+
+		if (tn && tv && blkid_set_tag(dev, tn, tv, strlen(tv)) < 0)
+			return -BLKID_ERR_MEM;
+	}
+
+	if (dev->bid_type == NULL) {
+		DBG(READ, ul_debug("device %s has no TYPE", dev->bid_name));
+		blkid_free_dev(dev);
+	}
+	return 0;
+}
+
+/*
+ * Add all devices from the mapped binary cache to the @cache.
+ */
+int blkid_bincache_import(struct blkid_bincache *bc, blkid_cache cache)
+{
+	const struct bincache_header *hdr = get_header(bc);
+	uint32_t i;
+	int rc;
+
+	for (i = 0; i < hdr->ndevs; i++) {
+		rc = import_dev(bc, cache, i, !bc->imported);
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
+
+/*
+ * Add devices with tag @name=@value from the binary cache mapped by
+ * blkid_read_cache() to the @cache. The other devices are not imported.
+ */
+int blkid_bincache_import_tag(blkid_cache cache, const char *name, const char *value)
+{
+	struct blkid_bincache *bc = &cache->bic_bin;
+	const struct bincache_header *hdr = get_header(bc);
+	const uint32_t *buckets;
+	uint32_t hash, idx, n;
+	int flags = cache->bic_flags & BLKID_BIC_FL_CHANGED, rc = 0;
+
+	if (!bc->map)
+		return 0;
+	if (!bc->imported) {
+		bc->imported = calloc(hdr->ndevs ? hdr->ndevs : 1, 1);
+		if (!bc->imported)
+			return -BLKID_ERR_MEM;
+	}
+
+	hash = blkid_tag_hash(name, value);
+	buckets = (const uint32_t *) (bc->map + hdr->buckets_off);
+	idx = buckets[hash & (hdr->nbuckets - 1)];
+
+	/* the loop is limited to be robust against corrupted file */
+	for (n = 0; rc == 0 && idx != BINCACHE_NONE && n < hdr->ntags; n++) {
+		const struct bincache_tag *tag = get_tag(bc, idx);
+		const char *tn, *tv;
+
+		if (!tag)
+			break;
+		if (tag->hash == hash
+		    && (tn = get_string(bc, tag->name)) && strcmp(tn, name) == 0
+		    && (tv = get_string(bc, tag->value)) && strcmp(tv, value) == 0)
+			rc = import_dev(bc, cache, tag->dev, 0);
+		idx = tag->next;
+	}
+
+	/* the devices are the same as on disk */
+	cache->bic_flags = (cache->bic_flags & ~BLKID_BIC_FL_CHANGED) | flags;
+	return rc;
+}
+
+/*
+ * Import the rest of the binary cache mapped by blkid_read_cache() and unmap
+ * it. Has to be called before the code that uses all the cached devices.
+ */
+void blkid_bincache_load(blkid_cache cache)
+{
+	struct blkid_bincache bc = cache->bic_bin;
+	int flags = cache->bic_flags & BLKID_BIC_FL_CHANGED;
+
+	if (!bc.map)
+		return;
+
+	/* the cache is not mapped for blkid_get_dev() during the import */
+	memset(&cache->bic_bin, 0, sizeof(cache->bic_bin));
+
+	DBG(CACHE, ul_debug("importing binary cache"));
+	blkid_bincache_import(&bc, cache);
+	blkid_bincache_close(&bc);
+
+	cache->bic_flags = (cache->bic_flags & ~BLKID_BIC_FL_CHANGED) | flags;
+}
+
+static inline int is_saved_dev(blkid_dev dev)
+{
+	return dev->bid_name[0] == '/' && dev->bid_type
+	       && !(dev->bid_flags & BLKID_BID_FL_REMOVABLE);
+}
+
+static uint32_t add_string(char *strings, uint32_t *off, const char *str)
+{
+	uint32_t res = *off;
+	size_t len = strlen(str) + 1;
+
+	memcpy(strings + res, str, len);
+	*off += len;
+	return res;
+}
+
+/*
+ * Write binary version of the cache for the text cache file @filename. The
+ * text file has to be already written (the binary file contains its stat).
+ */
+int blkid_bincache_write(blkid_cache cache, const char *filename)
+{
+	struct bincache_header *hdr;
+	struct bincache_dev *devs;
+	struct bincache_tag *tags;
+	uint32_t *buckets, ndevs = 0, ntags = 0, nbuckets = 16, stroff = 0, i;
+	uint64_t strsz = 0, size;
+	struct list_head *p, *t;
+	char *buf = NULL, *strings, *name = NULL, *tmp = NULL;
+	struct stat st;
+	int fd = -1, rc = -BLKID_ERR_MEM;
+
+	if (stat(filename, &st) != 0 || !S_ISREG(st.st_mode))
+		return 0;
+
+	blkid_bincache_load(cache);
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+
+		if (!is_saved_dev(dev))
+			continue;
+		ndevs++;
+		strsz += strlen(dev->bid_name) + 1;
+		list_for_each(t, &dev->bid_tags) {
+			blkid_tag tag = list_entry(t, struct blkid_struct_tag, bit_tags);
+
+			ntags++;
+			strsz += strlen(tag->bit_name) + strlen(tag->bit_val) + 2;
+		}
+	}
+	if (strsz >= UINT32_MAX)
+		return -BLKID_ERR_PARAM;
+	while (nbuckets < ntags * 2U)
+		nbuckets <<= 1;
+
+	size = sizeof(*hdr)
+	       + (uint64_t) ndevs * sizeof(*devs)
+	       + (uint64_t) ntags * sizeof(*tags)
+	       + (uint64_t) nbuckets * sizeof(*buckets)
+	       + strsz;
+	buf = calloc(1, size);
+	if (!buf)
+		return -BLKID_ERR_MEM;
+
+	hdr = (struct bincache_header *) buf;
+	memcpy(hdr->magic, BINCACHE_MAGIC, sizeof(BINCACHE_MAGIC));
+	hdr->version = BINCACHE_VERSION;
+	hdr->byteorder = BINCACHE_BYTEORDER;
+	hdr->text_mtime = st.st_mtime;
+	hdr->text_mtime_nsec = get_mtime_nsec(&st);
+	hdr->text_ino = st.st_ino;
+	hdr->text_size = st.st_size;
+	hdr->ndevs = ndevs;
+	hdr->ntags = ntags;
+	hdr->nbuckets = nbuckets;
+	hdr->strings_size = strsz;
+	hdr->devs_off = sizeof(*hdr);
+	hdr->tags_off = hdr->devs_off + (uint64_t) ndevs * sizeof(*devs);
+	hdr->buckets_off = hdr->tags_off + (uint64_t) ntags * sizeof(*tags);
+	hdr->strings_off = hdr->buckets_off + (uint64_t) nbuckets * sizeof(*buckets);
+	hdr->file_size = size;
+
+	devs = (struct bincache_dev *) (buf + hdr->devs_off);
+	tags = (struct bincache_tag *) (buf + hdr->tags_off);
+	buckets = (uint32_t *) (buf + hdr->buckets_off);
+	strings = buf + hdr->strings_off;
+
+	for (i = 0; i < nbuckets; i++)
+		buckets[i] = BINCACHE_NONE;
+
+	ndevs = ntags = 0;
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+		struct bincache_dev *bd;
+
+		if (!is_saved_dev(dev))
+			continue;
+		bd = &devs[ndevs];
+		bd->devno = dev->bid_devno;
+		bd->time = dev->bid_time;
+		bd->utime = dev->bid_utime;
+		bd->pri = dev->bid_pri;
+		bd->name = add_string(strings, &stroff, dev->bid_name);
+		bd->first_tag = ntags;
+
+		list_for_each(t, &dev->bid_tags) {
+			blkid_tag tag = list_entry(t, struct blkid_struct_tag, bit_tags);
+			struct bincache_tag *bt = &tags[ntags];
+			uint32_t bucket;
+
+			bt->name = add_string(strings, &stroff, tag->bit_name);
+			bt->value = add_string(strings, &stroff, tag->bit_val);
+			bt->dev = ndevs;
+			bt->hash = blkid_tag_hash(tag->bit_name, tag->bit_val);
+
+			bucket = bt->hash & (nbuckets - 1);
+			bt->next = buckets[bucket];
+			buckets[bucket] = ntags;
+			ntags++;
+		}
+		bd->ntags = ntags - bd->first_tag;
+		ndevs++;
+	}
+
+	name = bincache_filename(filename);
+	if (!name || asprintf(&tmp, "%s-XXXXXX", name) < 0) {
+		tmp = NULL;
+		goto done;
+	}
+	fd = mkstemp_cloexec(tmp);
+	if (fd < 0) {
+		rc = -BLKID_ERR_IO;
+		goto done;
+	}
+	if (fchmod(fd, 0644) != 0 || write_all(fd, buf, size) != 0 || fsync(fd) != 0) {
+		rc = -BLKID_ERR_IO;
+		goto done;
+	}
+	close(fd);
+	fd = -1;
+
+	if (rename(tmp, name) != 0) {
+		rc = -BLKID_ERR_IO;
+		goto done;
+	}
+	DBG(SAVE, ul_debug("written binary cache %s [devs=%u, tags=%u]",
+				name, ndevs, ntags));
+	rc = 0;
+done:
+	if (fd >= 0)
+		close(fd);
+	if (rc && tmp)
+		unlink(tmp);
+	free(tmp);
+	free(name);
+	free(buf);
+	return rc;
+}
+
+/*
+ * Remove the binary cache, used when the text file has been written but the
+ * binary file cannot be updated.
+ */
+void blkid_bincache_remove(const char *filename)
+{
+	char *name = bincache_filename(filename);
+
+	if (name) {
+		unlink(name);
+		free(name);
+	}
+}
+
+#ifdef TEST_PROGRAM
+int main(int argc, char **argv)
+{
+	struct blkid_bincache bc;
+	blkid_cache cache = NULL;
+	const char *devname;
+	int rc;
+
+	if (argc != 2 && argc != 4) {
+		fprintf(stderr, "Usage: %s <cachefile> [<NAME> <value>]\n"
+			"Write binary version of the cache file and lookup the tag\n",
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+	blkid_init_debug(0);
+
+	if ((rc = blkid_get_cache(&cache, argv[1])) != 0) {
+		fprintf(stderr, "%s: error creating cache (%d)\n", argv[0], rc);
+		return EXIT_FAILURE;
+	}
+	if ((rc = blkid_bincache_write(cache, argv[1])) != 0) {
+		fprintf(stderr, "%s: failed to write binary cache (%d)\n", argv[0], rc);
+		return EXIT_FAILURE;
+	}
+	blkid_put_cache(cache);
+
+	if (blkid_bincache_open(&bc, argv[1]) != 0) {
+		fprintf(stderr, "%s: failed to map binary cache\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	printf("devices: %u, tags: %u\n", get_header(&bc)->ndevs, get_header(&bc)->ntags);
+
+	if (argc == 4) {
+		devname = blkid_bincache_lookup(&bc, argv[2], argv[3]);
+		printf("%s=%s: %s\n", argv[2], argv[3], devname ? devname : "<not found>");
+	}
+	blkid_bincache_close(&bc);
+
+	/* the cache as used by blkid_find_dev_with_tag() */
+	if ((rc = blkid_get_cache(&cache, argv[1])) != 0) {
+		fprintf(stderr, "%s: error creating cache (%d)\n", argv[0], rc);
+		return EXIT_FAILURE;
+	}
+	if (argc == 4)
+		blkid_bincache_import_tag(cache, argv[2], argv[3]);
+	printf("imported: %zu", list_count_entries(&cache->bic_devs));
+	blkid_bincache_load(cache);
+	printf(", loaded: %zu\n", list_count_entries(&cache->bic_devs));
+	blkid_put_cache(cache);
+	return EXIT_SUCCESS;
+}
+#endif
@@ -32,6 +32,7 @@
 #include "blkdev.h"
 
 #include "debug.h"
+#include "ultrace.h"
 #include "blkid.h"
 #include "list.h"
 #include "encode.h"
@@ -62,6 +63,7 @@ struct blkid_struct_dev
 #define BLKID_BID_FL_VERIFIED	0x0001	/* Device data validated from disk */
 #define BLKID_BID_FL_INVALID	0x0004	/* Device is invalid */
 #define BLKID_BID_FL_REMOVABLE	0x0008	/* Device added by blkid_probe_all_removable() */
+#define BLKID_BID_FL_DIRTY	0x0010	/* Device changed (by uevent) */
 
 /*
  * Each tag defines a NAME=value pair for a particular device.  The tags
@@ -74,9 +76,11 @@ struct blkid_struct_tag
 {
 	struct list_head	bit_tags;	/* All tags for this device */
 	struct list_head	bit_names;	/* All tags with given NAME */
+	struct list_head	bit_hash;	/* Cache hash table bucket */
 	char			*bit_name;	/* NAME of tag (shared) */
 	char			*bit_val;	/* value of tag */
 	blkid_dev		bit_dev;	/* pointer to device */
+	uint32_t		bit_hashval;	/* blkid_tag_hash(NAME, value) */
 };
 typedef struct blkid_struct_tag *blkid_tag;
 
@@ -186,9 +190,13 @@ struct blkid_bufinfo {
 	unsigned char		*data;
 	uint64_t		off;
 	uint64_t		len;
+	uint64_t		mapsz;	/* size of the mapping (page aligned) */
 	struct list_head	bufs;	/* list of buffers */
 };
 
+/* max size of the unused buffers kept by the probe for the next reads */
+#define BLKID_FREE_BUFFERS_MAX	(4 * 1024 * 1024)
+
 /*
  * Probing hint
  */
@@ -198,6 +206,38 @@ struct blkid_hint {
 	struct list_head	hints;
 };
 
+/*
+ * Probing cost accounting (see blkid_probe_enable_stats())
+ */
+struct blkid_prober_stats {
+	const char		*chain;		/* chain name */
+	const char		*name;		/* prober name or NULL for whole chain */
+	uint64_t		ncalls;
+	uint64_t		nreads;		/* read() calls */
+	uint64_t		nbytes;		/* bytes read */
+	uint64_t		usec;		/* wall time */
+};
+
+struct blkid_probe_stats {
+	uint64_t		nreads;		/* read() calls */
+	uint64_t		nbytes;		/* bytes read */
+	uint64_t		nhits;		/* buffer found in memory */
+	uint64_t		nmisses;	/* buffer read from device */
+
+	struct blkid_prober_stats *probers;
+	size_t			nprobers;
+
+	unsigned int		enabled : 1;
+};
+
+/* stats snapshot, see blkid_probe_stats_mark() */
+struct blkid_stats_mark {
+	uint64_t		nreads;
+	uint64_t		nbytes;
+	uint64_t		nrequests;	/* hits + misses */
+	uint64_t		usec;
+};
+
 /*
  * Low-level probing control struct
  */
@@ -223,6 +263,14 @@ struct blkid_struct_probe
 
 	struct list_head	buffers;	/* list of buffers */
 	struct list_head	prunable_buffers;	/* list of prunable buffers */
+	struct list_head	free_buffers;	/* unused buffers (arena) */
+	uint64_t		free_bufsz;	/* size of the unused buffers */
+	int			direct_fd;	/* O_DIRECT fd, see blkid_probe_enable_direct_io() */
+
+	/* data source if not fd, see blkid_probe_set_reader() and blkid_probe_set_buffer() */
+	ssize_t			(*read_fn)(void *data, void *buf, size_t count, uint64_t offset);
+	void			*read_data;
+	const unsigned char	*mem;		/* caller's memory */
 	struct list_head	hints;
 
 	struct blkid_chain	chains[BLKID_NCHAINS];	/* array of chains */
@@ -232,6 +280,8 @@ struct blkid_struct_probe
 
 	struct blkid_struct_probe *parent;	/* for clones */
 	struct blkid_struct_probe *disk_probe;	/* whole-disk probing */
+
+	struct blkid_probe_stats stats;		/* I/O and time accounting */
 };
 
 /* private flags library flags */
@@ -242,11 +292,18 @@ struct blkid_struct_probe
 #define BLKID_FL_MODIF_BUFF	(1 << 5)	/* cached buffers has been modified */
 #define BLKID_FL_OPAL_LOCKED	(1 << 6)	/* OPAL device is locked (I/O errors) */
 #define BLKID_FL_OPAL_CHECKED	(1 << 7)	/* OPAL lock checked */
+#define BLKID_FL_DIRECT_IO	(1 << 8)	/* read by O_DIRECT if possible */
 
 /* private per-probing flags */
 #define BLKID_PROBE_FL_IGNORE_PT (1 << 1)	/* ignore partition table */
 
 extern blkid_probe blkid_clone_probe(blkid_probe parent);
+
+extern void blkid_probe_stats_mark(blkid_probe pr, struct blkid_stats_mark *mk)
+			__attribute__((nonnull));
+extern void blkid_probe_stats_add(blkid_probe pr, struct blkid_stats_mark *mk,
+			struct blkid_chain *chn, const char *name)
+			__attribute__((nonnull(1,2,3)));
 extern blkid_probe blkid_probe_get_wholedisk_probe(blkid_probe pr);
 
 /*
@@ -287,6 +344,13 @@ extern void blkid_free_config(struct blkid_config *conf);
  */
 #define BLKID_PROBE_INTERVAL	200
 
+/* binary version of the cache file, see bincache.c */
+struct blkid_bincache {
+	char		*map;		/* mmap()-ed file */
+	size_t		size;
+	unsigned char	*imported;	/* devices already in the cache */
+};
+
 /* This describes an entire blkid cache file and probed devices.
  * We can traverse all of the found devices via bic_list.
  * We can traverse all of the tag types by bic_tags, which hold empty tags
@@ -302,10 +366,37 @@ struct blkid_struct_cache
 	unsigned int		bic_flags;	/* Status flags of the cache */
 	char			*bic_filename;	/* filename of cache */
 	blkid_probe		probe;		/* low-level probing stuff */
+
+	struct list_head	*bic_hash;	/* NAME=value hash table of dev tags */
+	size_t			bic_hashsz;	/* number of buckets (power of 2) */
+	size_t			bic_nhashed;	/* number of tags in the table */
+
+	int			bic_uevent_fd;	/* uevent monitor or -1 */
+
+	struct blkid_prepared	*prepared;	/* devices probed in advance */
+	size_t			nprepared;
+	size_t			prepared_hint;	/* last used prepared[] item */
+
+	struct blkid_bincache	bic_bin;	/* not yet imported binary cache */
+};
+
+/*
+ * Device probed in advance (by worker thread), the result is used by
+ * blkid_verify() rather than probe the device again.
+ */
+struct blkid_prepared
+{
+	dev_t		devno;
+	int		rc;		/* blkid_do_safeprobe() result */
+	blkid_dev	dev;		/* tags, not linked to the cache */
+	time_t		time;
+	suseconds_t	utime;
+	unsigned int	done : 1;	/* probed and not used yet */
 };
 
 #define BLKID_BIC_FL_PROBED	0x0002	/* We probed /proc/partition devices */
 #define BLKID_BIC_FL_CHANGED	0x0004	/* Cache has changed from disk */
+#define BLKID_BIC_FL_NEWDEVS	0x0008	/* Uevent for not cached device */
 
 /* config file */
 #define BLKID_CONFIG_FILE	"/etc/blkid.conf"
@@ -375,10 +466,34 @@ extern int blkid_driver_has_major(const char *drvname, int drvmaj)
 extern void blkid_read_cache(blkid_cache cache)
 			__attribute__((nonnull));
 
+/* verify.c */
+extern int blkid_probe_dev_tags(blkid_probe pr, int fd, blkid_dev dev)
+			__attribute__((nonnull));
+
 /* save.c */
 extern int blkid_flush_cache(blkid_cache cache)
 			__attribute__((nonnull));
 
+/* bincache.c */
+extern int blkid_bincache_open(struct blkid_bincache *bc, const char *filename)
+			__attribute__((nonnull(1)));
+extern void blkid_bincache_close(struct blkid_bincache *bc)
+			__attribute__((nonnull));
+extern const char *blkid_bincache_lookup(struct blkid_bincache *bc,
+			const char *name, const char *value)
+			__attribute__((nonnull));
+extern int blkid_bincache_import(struct blkid_bincache *bc, blkid_cache cache)
+			__attribute__((nonnull));
+extern int blkid_bincache_import_tag(blkid_cache cache,
+			const char *name, const char *value)
+			__attribute__((nonnull));
+extern void blkid_bincache_load(blkid_cache cache)
+			__attribute__((nonnull));
+extern int blkid_bincache_write(blkid_cache cache, const char *filename)
+			__attribute__((nonnull));
+extern void blkid_bincache_remove(const char *filename)
+			__attribute__((nonnull));
+
 /* cache */
 extern char *blkid_safe_getenv(const char *arg)
 			__attribute__((nonnull))
@@ -397,6 +512,10 @@ extern blkid_tag blkid_find_tag_dev(blkid_dev dev, const char *type)
 extern int blkid_set_tag(blkid_dev dev, const char *name,
 			 const char *value, const int vlength)
 			__attribute__((nonnull(1,2)));
+extern uint32_t blkid_tag_hash(const char *name, const char *value)
+			__attribute__((nonnull));
+extern void blkid_free_tag_hash(blkid_cache cache)
+			__attribute__((nonnull));
 
 /*
  * Functions to create and find a specific tag type: dev.c
@@ -438,6 +557,10 @@ extern int blkid_probe_get_idmag(blkid_probe pr, const struct blkid_idinfo *id,
 			__attribute__((nonnull(1)));
 
 extern void blkid_probe_prune_buffers(blkid_probe pr);
+extern void blkid_probe_prefetch(blkid_probe pr, uint64_t off, uint64_t len)
+			__attribute__((nonnull));
+extern void blkid_probe_release_buffer(blkid_probe pr, const unsigned char *data)
+			__attribute__((nonnull(1)));
 
 /* returns superblock according to 'struct blkid_idmag' */
 extern const unsigned char *blkid_probe_get_sb_buffer(blkid_probe pr, const struct blkid_idmag *mag, size_t size);
@@ -103,6 +103,7 @@ int blkid_get_cache(blkid_cache *ret_cache, const char *filename)
 	DBG(CACHE, ul_debugobj(cache, "alloc (from %s)", filename ? filename : "default cache"));
 	INIT_LIST_HEAD(&cache->bic_devs);
 	INIT_LIST_HEAD(&cache->bic_tags);
+	cache->bic_uevent_fd = -1;
 
 	if (filename && !*filename)
 		filename = NULL;
@@ -158,7 +159,10 @@ void blkid_put_cache(blkid_cache cache)
 		blkid_free_tag(tag);
 	}
 
+	blkid_free_tag_hash(cache);
+	blkid_bincache_close(&cache->bic_bin);
 	blkid_free_probe(cache->probe);
+	blkid_cache_enable_uevents(cache, 0);
 
 	free(cache->bic_filename);
 	free(cache);
@@ -178,6 +182,8 @@ void blkid_gc_cache(blkid_cache cache)
 	if (!cache)
 		return;
 
+	blkid_bincache_load(cache);
+
 	list_for_each_safe(p, pnext, &cache->bic_devs) {
 		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
 		if (stat(dev->bid_name, &st) < 0) {
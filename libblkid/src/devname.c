@@ -33,6 +33,10 @@
 #include <errno.h>
 #endif
 #include <time.h>
+#include <sys/time.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include "blkidP.h"
 
@@ -56,6 +60,8 @@ blkid_dev blkid_get_dev(blkid_cache cache, const char *devname, int flags)
 	if (!cache || !devname)
 		return NULL;
 
+	blkid_bincache_load(cache);
+
 	/* search by name */
 	list_for_each(p, &cache->bic_devs) {
 		tmp = list_entry(p, struct blkid_struct_dev, bid_devs);
@@ -403,15 +409,290 @@ ubi_probe_all(blkid_cache cache, int only_if_new)
 	}
 }
 
+/*
+ * Devices are probed in batches. The begin and the end of all devices in the
+ * batch is requested by readahead before the first device from the batch is
+ * probed, so the devices are read in parallel and the probing functions get
+ * the data from page cache. It means that we wait for device latency once
+ * per batch rather than once per device.
+ */
+#define BLKID_PREFETCH_BATCH	32
+#define BLKID_PREFETCH_SIZE	(1024 * 1024)	/* begin and end of the device */
+
+struct probe_batch {
+	struct {
+		char	*ptname;
+		dev_t	devno;
+		uint64_t size;		/* in bytes */
+	} items[BLKID_PREFETCH_BATCH];
+
+	size_t		nitems;
+	int		njobs;		/* number of probing threads */
+};
+
+/*
+ * Returns 1 if the device is going to be read by probe_one().
+ */
+static int need_probe(blkid_cache cache, dev_t devno, int only_if_new)
+{
+	struct list_head *p;
+	time_t now = time(NULL);
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev tmp = list_entry(p, struct blkid_struct_dev, bid_devs);
+
+		if (tmp->bid_devno != devno)
+			continue;
+		if (only_if_new)
+			return 0;
+		if (now >= tmp->bid_time && now - tmp->bid_time < BLKID_PROBE_MIN)
+			return 0;
+	}
+	return 1;
+}
+
+static void prefetch_one(const char *ptname, dev_t devno, uint64_t size)
+{
+#if defined(POSIX_FADV_WILLNEED) && defined(HAVE_POSIX_FADVISE)
+	char path[PATH_MAX];
+	struct stat st;
+	int fd;
+
+	snprintf(path, sizeof(path), "/dev/%s", ptname);
+
+	fd = open(path, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
+	if (fd < 0)
+		return;
+	if (fstat(fd, &st) != 0 || !S_ISBLK(st.st_mode) || st.st_rdev != devno) {
+		close(fd);
+		return;
+	}
+
+	DBG(DEVNAME, ul_debug(" prefetch %s", path));
+
+	/* the first megabyte (most of superblocks, PMBR, primary GPT) */
+	posix_fadvise(fd, 0, min(size, (uint64_t) BLKID_PREFETCH_SIZE),
+			POSIX_FADV_WILLNEED);
+
+	/* the last megabyte (backup GPT, MD 0.90 and 1.0, RAIDs) */
+	if (size > BLKID_PREFETCH_SIZE)
+		posix_fadvise(fd, max(size - BLKID_PREFETCH_SIZE,
+					(uint64_t) BLKID_PREFETCH_SIZE),
+				BLKID_PREFETCH_SIZE, POSIX_FADV_WILLNEED);
+	close(fd);
+#else
+	(void) ptname;
+	(void) devno;
+	(void) size;
+#endif
+}
+
+#ifdef HAVE_PTHREAD
+/*
+ * Parallel probing -- the devices from the batch are probed by a pool of
+ * worker threads, every thread uses its own prober and the results are
+ * stored to cache->prepared[]. The cache itself is not modified by the
+ * threads; the results are merged later by probe_one() -> blkid_verify() in
+ * the original order, so the result is the same as for sequential probing.
+ */
+struct probe_pool {
+	struct probe_batch	*batch;
+	struct blkid_prepared	*prepared;	/* parallel to batch->items[] */
+	size_t			next;		/* next item to probe */
+	pthread_mutex_t		lock;
+};
+
+static void prepare_one(blkid_probe pr, const char *ptname,
+			struct blkid_prepared *prep)
+{
+	char path[PATH_MAX];
+	struct timeval tv;
+	struct stat st;
+	int fd;
+
+	snprintf(path, sizeof(path), "/dev/%s", ptname);
+
+	/* on error blkid_verify() probes the device in usual way */
+	fd = open(path, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
+	if (fd < 0)
+		return;
+	if (fstat(fd, &st) != 0 || !S_ISBLK(st.st_mode) || st.st_rdev != prep->devno)
+		goto done;
+
+	prep->dev = blkid_new_dev();
+	if (!prep->dev)
+		goto done;
+
+	prep->rc = blkid_probe_dev_tags(pr, fd, prep->dev);
+
+	if (!gettimeofday(&tv, NULL)) {
+		prep->time = tv.tv_sec;
+		prep->utime = tv.tv_usec;
+	} else
+		prep->time = time(NULL);
+	prep->done = 1;
+done:
+	close(fd);
+}
+
+static void *probe_worker(void *data)
+{
+	struct probe_pool *pool = (struct probe_pool *) data;
+	blkid_probe pr = blkid_new_probe();
+
+	if (!pr)
+		return NULL;
+
+	do {
+		struct blkid_prepared *prep = NULL;
+		size_t i = 0;
+
+		/* get the next device to probe */
+		pthread_mutex_lock(&pool->lock);
+		while (pool->next < pool->batch->nitems) {
+			i = pool->next++;
+			if (pool->prepared[i].devno) {
+				prep = &pool->prepared[i];
+				break;
+			}
+		}
+		pthread_mutex_unlock(&pool->lock);
+
+		if (!prep)
+			break;
+
+		DBG(DEVNAME, ul_debug(" [%zu] probe %s", i,
+					pool->batch->items[i].ptname));
+		prepare_one(pr, pool->batch->items[i].ptname, prep);
+	} while (1);
+
+	blkid_free_probe(pr);
+	return NULL;
+}
+#endif /* HAVE_PTHREAD */
+
+static void free_prepared(blkid_cache cache)
+{
+	size_t i;
+
+	for (i = 0; i < cache->nprepared; i++)
+		blkid_free_dev(cache->prepared[i].dev);
+	free(cache->prepared);
+	cache->prepared = NULL;
+	cache->nprepared = 0;
+	cache->prepared_hint = 0;
+}
+
+/*
+ * Returns number of the devices probed in advance.
+ */
+static size_t probe_batch_parallel(blkid_cache cache, struct probe_batch *bt,
+				   int only_if_new)
+{
+#ifdef HAVE_PTHREAD
+	pthread_t threads[BLKID_PREFETCH_BATCH];
+	struct probe_pool pool = { .batch = bt };
+	size_t i, nthreads = 0, nneed = 0;
+
+	pool.prepared = calloc(bt->nitems, sizeof(struct blkid_prepared));
+	if (!pool.prepared)
+		return 0;
+
+	for (i = 0; i < bt->nitems; i++) {
+		if (need_probe(cache, bt->items[i].devno, only_if_new)) {
+			pool.prepared[i].devno = bt->items[i].devno;
+			nneed++;
+		}
+	}
+	if (nneed < 2) {
+		free(pool.prepared);
+		return 0;
+	}
+
+	pthread_mutex_init(&pool.lock, NULL);
+
+	for (i = 0; i < min(nneed, (size_t) bt->njobs); i++) {
+		if (pthread_create(&threads[nthreads], NULL, probe_worker, &pool) != 0)
+			break;
+		nthreads++;
+	}
+	DBG(DEVNAME, ul_debug(" probing %zu devices by %zu threads", nneed, nthreads));
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&pool.lock);
+
+	cache->prepared = pool.prepared;
+	cache->nprepared = bt->nitems;
+	cache->prepared_hint = 0;
+	return nthreads ? nneed : 0;
+#else
+	(void) cache;
+	(void) bt;
+	(void) only_if_new;
+	return 0;
+#endif
+}
+
+static void probe_batch_flush(blkid_cache cache, struct probe_batch *bt,
+			      int only_if_new)
+{
+	size_t i;
+
+	if (!bt->nitems)
+		return;
+
+	DBG(DEVNAME, ul_debug(" probe batch of %zu devices", bt->nitems));
+
+	if (bt->njobs <= 1 || !probe_batch_parallel(cache, bt, only_if_new)) {
+		for (i = 0; i < bt->nitems; i++) {
+			if (need_probe(cache, bt->items[i].devno, only_if_new))
+				prefetch_one(bt->items[i].ptname,
+					     bt->items[i].devno, bt->items[i].size);
+		}
+	}
+
+	for (i = 0; i < bt->nitems; i++) {
+		probe_one(cache, bt->items[i].ptname, bt->items[i].devno,
+				0, only_if_new, 0);
+		free(bt->items[i].ptname);
+	}
+	free_prepared(cache);
+	bt->nitems = 0;
+}
+
+static void probe_batch_add(blkid_cache cache, struct probe_batch *bt,
+			    const char *ptname, dev_t devno, uint64_t size,
+			    int only_if_new)
+{
+	char *name = strdup(ptname);
+
+	if (!name) {
+		/* no memory to batch, probe it now */
+		probe_one(cache, ptname, devno, 0, only_if_new, 0);
+		return;
+	}
+
+	bt->items[bt->nitems].ptname = name;
+	bt->items[bt->nitems].devno = devno;
+	bt->items[bt->nitems].size = size;
+
+	if (++bt->nitems == BLKID_PREFETCH_BATCH)
+		probe_batch_flush(cache, bt, only_if_new);
+}
+
 /*
  * This function uses /sys to read all block devices in way compatible with
  * /proc/partitions (like the original libblkid implementation)
  */
 static int
-sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
+sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable,
+		int njobs)
 {
 	DIR *sysfs;
 	struct dirent *dev;
+	struct probe_batch batch = { .nitems = 0, .njobs = njobs };
 
 	sysfs = opendir(_PATH_SYS_BLOCK);
 	if (!sysfs)
@@ -470,14 +751,15 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 		/* read /sys/block/<name>/ do get partitions */
 		while ((part = xreaddir(dir))) {
 			dev_t partno;
+			uint64_t partsz = 0;
 
 			if (!sysfs_blkdev_is_partition_dirent(dir, part, dev->d_name))
 				continue;
 
 			/* ignore extended partitions
 			 * -- recount size to blocks like /proc/partitions */
-			if (ul_path_readf_u64(pc, &size, "%s/size", part->d_name) == 0
-			    && (size >> 1) == 1)
+			if (ul_path_readf_u64(pc, &partsz, "%s/size", part->d_name) == 0
+			    && (partsz >> 1) == 1)
 				continue;
 			partno = __sysfs_devname_to_devno(NULL, part->d_name, dev->d_name);
 			if (!partno)
@@ -486,14 +768,16 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 			DBG(DEVNAME, ul_debug(" Probe partition dev %s, devno 0x%04X",
                                    part->d_name, (unsigned int) partno));
 			nparts++;
-			probe_one(cache, part->d_name, partno, 0, only_if_new, 0);
+			probe_batch_add(cache, &batch, part->d_name, partno,
+					partsz << 9, only_if_new);
 		}
 
 		if (!nparts) {
 			/* add non-partitioned whole disk to cache */
 			DBG(DEVNAME, ul_debug(" Probe whole dev %s, devno 0x%04X",
 				   dev->d_name, (unsigned int) devno));
-			probe_one(cache, dev->d_name, devno, 0, only_if_new, 0);
+			probe_batch_add(cache, &batch, dev->d_name, devno,
+					size << 9, only_if_new);
 		} else {
 			/* remove partitioned whole-disk from cache */
 			struct list_head *p, *pnext;
@@ -516,6 +800,7 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 			ul_unref_path(pc);
 	}
 
+	probe_batch_flush(cache, &batch, only_if_new);
 	closedir(sysfs);
 	return 0;
 }
@@ -523,31 +808,41 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 /*
  * Read the device data for all available block devices in the system.
  */
-static int probe_all(blkid_cache cache, int only_if_new, int update_interval)
+static int probe_all(blkid_cache cache, int only_if_new, int update_interval,
+		     int njobs)
 {
 	int rc;
 
 	if (!cache)
 		return -BLKID_ERR_PARAM;
 
-	if (cache->bic_flags & BLKID_BIC_FL_PROBED &&
+	if (cache->bic_uevent_fd >= 0) {
+		blkid_cache_process_uevents(cache);
+		if (cache->bic_flags & BLKID_BIC_FL_PROBED &&
+		    !(cache->bic_flags & BLKID_BIC_FL_NEWDEVS)) {
+			DBG(PROBE, ul_debug("don't re-probe [no new devices]"));
+			return 0;
+		}
+	} else if (cache->bic_flags & BLKID_BIC_FL_PROBED &&
 	    time(NULL) - cache->bic_time < BLKID_PROBE_INTERVAL) {
 		DBG(PROBE, ul_debug("don't re-probe [delay < %d]", BLKID_PROBE_INTERVAL));
 		return 0;
 	}
 
 	blkid_read_cache(cache);
+	blkid_bincache_load(cache);
 #ifdef VG_DIR
 	lvm_probe_all(cache, only_if_new);
 #endif
 	ubi_probe_all(cache, only_if_new);
 
-	rc = sysfs_probe_all(cache, only_if_new, 0);
+	rc = sysfs_probe_all(cache, only_if_new, 0, njobs);
 
 	/* Don't mark the change as "probed" if /sys not avalable */
 	if (update_interval && rc == 0) {
 		cache->bic_time = time(NULL);
 		cache->bic_flags |= BLKID_BIC_FL_PROBED;
+		cache->bic_flags &= ~BLKID_BIC_FL_NEWDEVS;
 	}
 
 	blkid_flush_cache(cache);
@@ -567,11 +862,38 @@ int blkid_probe_all(blkid_cache cache)
 	int ret;
 
 	DBG(PROBE, ul_debug("Begin blkid_probe_all()"));
-	ret = probe_all(cache, 0, 1);
+	ret = probe_all(cache, 0, 1, 0);
 	DBG(PROBE, ul_debug("End blkid_probe_all() [rc=%d]", ret));
 	return ret;
 }
 
+/**
+ * blkid_probe_all_parallel:
+ * @cache: cache handler
+ * @njobs: maximal number of probing threads
+ *
+ * The same as blkid_probe_all(), but the devices are probed by up to @njobs
+ * threads. This is useful on systems with many (slow) devices, where the
+ * probing time is dominated by I/O latency. The content of the @cache (and
+ * the order of the devices in the cache) is the same as for blkid_probe_all().
+ *
+ * If the library has been compiled without threads support, or @njobs is
+ * less than 2, then the devices are probed sequentially.
+ *
+ * Returns: 0 on success, or number less than zero in case of error.
+ *
+ * Since: 2.41
+ */
+int blkid_probe_all_parallel(blkid_cache cache, int njobs)
+{
+	int ret;
+
+	DBG(PROBE, ul_debug("Begin blkid_probe_all_parallel() [jobs=%d]", njobs));
+	ret = probe_all(cache, 0, 1, min(njobs, BLKID_PREFETCH_BATCH));
+	DBG(PROBE, ul_debug("End blkid_probe_all_parallel() [rc=%d]", ret));
+	return ret;
+}
+
 /**
  * blkid_probe_all_new:
  * @cache: cache handler
@@ -585,7 +907,7 @@ int blkid_probe_all_new(blkid_cache cache)
 	int ret;
 
 	DBG(PROBE, ul_debug("Begin blkid_probe_all_new()"));
-	ret = probe_all(cache, 1, 0);
+	ret = probe_all(cache, 1, 0, 0);
 	DBG(PROBE, ul_debug("End blkid_probe_all_new() [rc=%d]", ret));
 	return ret;
 }
@@ -613,7 +935,7 @@ int blkid_probe_all_removable(blkid_cache cache)
 	int ret;
 
 	DBG(PROBE, ul_debug("Begin blkid_probe_all_removable()"));
-	ret = sysfs_probe_all(cache, 0, 1);
+	ret = sysfs_probe_all(cache, 0, 1, 0);
 	DBG(PROBE, ul_debug("End blkid_probe_all_removable() [rc=%d]", ret));
 	return ret;
 }
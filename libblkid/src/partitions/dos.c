@@ -41,11 +41,38 @@ static inline int is_extended(const struct dos_partition *p)
 		p->sys_ind == MBR_LINUX_EXTENDED_PARTITION);
 }
 
+/*
+ * The EBRs are usually written in the same distance, so ask for the next
+ * few EBRs in advance to avoid waiting for the device for every EBR. It's
+ * only a guess, the chain is still followed by the links in the EBRs.
+ */
+#define DOS_EBR_PREFETCH	8
+
+static void prefetch_ebrs(blkid_probe pr, uint32_t cur, uint32_t next,
+			  uint32_t end, uint32_t *prefetched)
+{
+	uint64_t x, stride;
+	size_t i;
+
+	if (next <= cur)
+		return;
+	stride = next - cur;
+
+	for (i = 1, x = next + stride; i <= DOS_EBR_PREFETCH; i++, x += stride) {
+		if (x >= end)
+			break;
+		if (x <= *prefetched)
+			continue;
+		blkid_probe_prefetch(pr, x << 9, 0x200);
+		*prefetched = x;
+	}
+}
+
 static int parse_dos_extended(blkid_probe pr, blkid_parttable tab,
 		uint32_t ex_start, uint32_t ex_size, int ssf)
 {
 	blkid_partlist ls = blkid_probe_get_partlist(pr);
-	uint32_t cur_start = ex_start, cur_size = ex_size;
+	uint32_t cur_start = ex_start, cur_size = ex_size, prefetched = 0;
 	const unsigned char *data;
 	int ct_nodata = 0;	/* count ext.partitions without data partitions */
 	int i;
@@ -142,6 +169,12 @@ static int parse_dos_extended(blkid_probe pr, blkid_parttable tab,
 		if (i == 4)
 			goto leave;
 
+		/* the EBR is parsed, reuse the buffer for the next EBR */
+		blkid_probe_release_buffer(pr, data);
+
+		prefetch_ebrs(pr, cur_start, ex_start + start,
+				ex_start + ex_size, &prefetched);
+
 		cur_start = ex_start + start;
 		cur_size = size;
 	}
@@ -116,6 +116,33 @@ static inline const unsigned char *get_lba_buffer(blkid_probe pr,
 			blkid_probe_get_sectorsize(pr) * lba, bytes);
 }
 
+/*
+ * Usual size of the entries array (UEFI requires at least 16KiB). The array
+ * usually follows the primary header and precedes the backup header, so read
+ * the header and the array by one read() call, get_gpt_header() will use the
+ * already cached data for the entries.
+ */
+#define GPT_DEFAULT_ENTRIES_SZ	(128 * sizeof(struct gpt_entry))
+
+static const unsigned char *get_header_buffer(blkid_probe pr,
+					uint64_t lba, uint64_t lastlba,
+					uint32_t ssz)
+{
+	const unsigned char *buf = NULL;
+	uint64_t n = GPT_DEFAULT_ENTRIES_SZ / ssz;
+
+	if (lba == GPT_PRIMARY_LBA && lba + n <= lastlba)
+		buf = get_lba_buffer(pr, lba, (n + 1) * ssz);
+
+	else if (lba == lastlba && lba > n) {
+		buf = get_lba_buffer(pr, lba - n, (n + 1) * ssz);
+		if (buf)
+			buf += n * ssz;
+	}
+
+	return buf ? buf : get_lba_buffer(pr, lba, ssz);
+}
+
 static inline int guidcmp(efi_guid_t left, efi_guid_t right)
 {
 	return memcmp(&left, &right, sizeof (efi_guid_t));
@@ -221,7 +248,7 @@ static struct gpt_header *get_gpt_header(
 	DBG(LOWPROBE, ul_debug(" checking for GPT header at %"PRIu64, lba));
 
 	/* whole sector is allocated for GPT header */
-	h = (struct gpt_header *) get_lba_buffer(pr, lba, ssz);
+	h = (struct gpt_header *) get_header_buffer(pr, lba, lastlba, ssz);
 	if (!h)
 		return NULL;
 
@@ -539,9 +539,12 @@ static int idinfo_probe(blkid_probe pr, const struct blkid_idinfo *id,
 			struct blkid_chain *chn)
 {
 	const struct blkid_idmag *mag = NULL;
+	struct blkid_stats_mark mk;
 	uint64_t off;
 	int rc = BLKID_PROBE_NONE;		/* default is nothing */
 
+	blkid_probe_stats_mark(pr, &mk);
+
 	if (pr->size <= 0 || (id->minsz && (unsigned)id->minsz > pr->size))
 		goto nothing;	/* the device is too small */
 	if (pr->flags & BLKID_FL_NOSCAN_DEV)
@@ -573,9 +576,13 @@ static int idinfo_probe(blkid_probe pr, const struct blkid_idinfo *id,
 		DBG(LOWPROBE, ul_debug("%s: <--- (rc = %d)", id->name, rc));
 	}
 
+	if (chn)
+		blkid_probe_stats_add(pr, &mk, chn, id->name);
 	return rc;
 
 nothing:
+	if (chn)
+		blkid_probe_stats_add(pr, &mk, chn, id->name);
 	return BLKID_PROBE_NONE;
 }
 
@@ -121,6 +121,7 @@
 #include "strutils.h"
 #include "list.h"
 #include "fileutils.h"
+#include "monotonic.h"
 
 /*
  * All supported chains
@@ -132,6 +133,8 @@ static const struct blkid_chaindrv *chains_drvs[] = {
 };
 
 static void blkid_probe_reset_values(blkid_probe pr);
+static void free_unused_buffers(blkid_probe pr);
+static void close_direct_fd(blkid_probe pr);
 
 /**
  * blkid_new_probe:
@@ -157,8 +160,10 @@ blkid_probe blkid_new_probe(void)
 	}
 	INIT_LIST_HEAD(&pr->buffers);
 	INIT_LIST_HEAD(&pr->prunable_buffers);
+	INIT_LIST_HEAD(&pr->free_buffers);
 	INIT_LIST_HEAD(&pr->values);
 	INIT_LIST_HEAD(&pr->hints);
+	pr->direct_fd = -1;
 	return pr;
 }
 
@@ -190,6 +195,10 @@ blkid_probe blkid_clone_probe(blkid_probe parent)
 	pr->blkssz = parent->blkssz;
 	pr->flags = parent->flags;
 	pr->zone_size = parent->zone_size;
+	pr->mode = parent->mode;
+	pr->read_fn = parent->read_fn;
+	pr->read_data = parent->read_data;
+	pr->mem = parent->mem;
 	pr->parent = parent;
 
 	pr->flags &= ~BLKID_FL_PRIVATE_FD;
@@ -262,9 +271,12 @@ void blkid_free_probe(blkid_probe pr)
 	if ((pr->flags & BLKID_FL_PRIVATE_FD) && pr->fd >= 0)
 		close(pr->fd);
 	blkid_probe_reset_buffers(pr);
+	free_unused_buffers(pr);
+	close_direct_fd(pr);
 	blkid_probe_reset_values(pr);
 	blkid_probe_reset_hints(pr);
 	blkid_free_probe(pr->disk_probe);
+	free(pr->stats.probers);
 
 	DBG(LOWPROBE, ul_debug("free probe"));
 	free(pr);
@@ -546,58 +558,185 @@ int __blkid_probe_filter_types(blkid_probe pr, int chain, int flag, char *names[
 	return 0;
 }
 
-static void remove_buffer(struct blkid_bufinfo *bf)
+/*
+ * The buffers are not deallocated, but kept in pr->free_buffers to be reused
+ * by the next read_buffer(). It's usual that the same probe is used for many
+ * devices and the probing functions read the same areas.
+ */
+static void remove_buffer(blkid_probe pr, struct blkid_bufinfo *bf)
 {
 	list_del(&bf->bufs);
 
 	DBG(BUFFER, ul_debug(" remove buffer: [off=%"PRIu64", len=%"PRIu64"]",
 				bf->off, bf->len));
-	munmap(bf->data, bf->len);
+
+	if (pr->free_bufsz + bf->mapsz <= BLKID_FREE_BUFFERS_MAX) {
+		pr->free_bufsz += bf->mapsz;
+		list_add(&bf->bufs, &pr->free_buffers);
+		return;
+	}
+	munmap(bf->data, bf->mapsz);
 	free(bf);
 }
 
-static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint64_t len)
+static void free_unused_buffers(blkid_probe pr)
+{
+	while (!list_empty(&pr->free_buffers)) {
+		struct blkid_bufinfo *bf = list_entry(pr->free_buffers.next,
+						struct blkid_bufinfo, bufs);
+		list_del(&bf->bufs);
+		munmap(bf->data, bf->mapsz);
+		free(bf);
+	}
+	pr->free_bufsz = 0;
+}
+
+/*
+ * Returns a writable page aligned buffer, the smallest suitable unused buffer
+ * is preferred.
+ */
+static struct blkid_bufinfo *alloc_buffer(blkid_probe pr, uint64_t len)
 {
-	ssize_t ret;
 	struct blkid_bufinfo *bf = NULL;
+	struct list_head *p;
+	uint64_t pgsz = (uint64_t) getpagesize();
 
-	if (lseek(pr->fd, real_off, SEEK_SET) == (off_t) -1) {
-		errno = 0;
-		return NULL;
+	list_for_each(p, &pr->free_buffers) {
+		struct blkid_bufinfo *x =
+				list_entry(p, struct blkid_bufinfo, bufs);
+
+		if (x->mapsz >= len && (!bf || x->mapsz < bf->mapsz))
+			bf = x;
 	}
 
-	/* someone trying to overflow some buffers? */
-	if (len > ULONG_MAX - sizeof(struct blkid_bufinfo)) {
-		errno = ENOMEM;
-		return NULL;
+	if (bf) {
+		list_del(&bf->bufs);
+		pr->free_bufsz -= bf->mapsz;
+		if (mprotect(bf->data, bf->mapsz, PROT_READ | PROT_WRITE) == 0)
+			goto done;
+
+		DBG(LOWPROBE, ul_debug("	mprotect failed: %m"));
+		munmap(bf->data, bf->mapsz);
+		free(bf);
 	}
 
-	/* allocate info and space for data by one malloc call */
 	bf = calloc(1, sizeof(struct blkid_bufinfo));
-	if (!bf) {
-		errno = ENOMEM;
+	if (!bf)
 		return NULL;
-	}
 
-	bf->data = mmap(NULL, len, PROT_READ | PROT_WRITE,
+	bf->mapsz = (len + pgsz - 1) / pgsz * pgsz;
+	bf->data = mmap(NULL, bf->mapsz, PROT_READ | PROT_WRITE,
 			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 	if (bf->data == MAP_FAILED) {
 		free(bf);
+		return NULL;
+	}
+done:
+	INIT_LIST_HEAD(&bf->bufs);
+	return bf;
+}
+
+static void close_direct_fd(blkid_probe pr)
+{
+	if (pr->direct_fd >= 0)
+		close(pr->direct_fd);
+	pr->direct_fd = -1;
+}
+
+/*
+ * Returns O_DIRECT file descriptor for the probing area or -1. The file
+ * descriptor is shared with clones which use the same device.
+ */
+static int get_direct_fd(blkid_probe pr, uint64_t real_off, uint64_t len)
+{
+#ifdef O_DIRECT
+	uint64_t align = pr->blkssz ? pr->blkssz : DEFAULT_SECTOR_SIZE;
+
+	if (!(pr->flags & BLKID_FL_DIRECT_IO) || (real_off % align) || (len % align))
+		return -1;
+
+	while (pr->parent && pr->parent->fd == pr->fd)
+		pr = pr->parent;
+
+	if (pr->direct_fd == -1) {
+		char path[sizeof("/proc/self/fd/") + sizeof(stringify_value(INT_MAX))];
+
+		snprintf(path, sizeof(path), "/proc/self/fd/%d", pr->fd);
+		pr->direct_fd = open(path, O_RDONLY | O_DIRECT | O_CLOEXEC | O_NONBLOCK);
+		if (pr->direct_fd < 0) {
+			DBG(LOWPROBE, ul_debug("	O_DIRECT unsupported: %m"));
+			pr->direct_fd = -2;	/* don't try it again */
+		}
+	}
+	return pr->direct_fd >= 0 ? pr->direct_fd : -1;
+#else
+	return -1;
+#endif
+}
+
+/* counters are shared with clones */
+static inline struct blkid_probe_stats *get_stats(blkid_probe pr)
+{
+	while (pr->parent)
+		pr = pr->parent;
+	return &pr->stats;
+}
+
+static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint64_t len)
+{
+	ssize_t ret = -1;
+	struct blkid_bufinfo *bf = NULL;
+	struct blkid_probe_stats *stats;
+	int dfd;
+
+	/* someone trying to overflow some buffers? */
+	if (len > ULONG_MAX - sizeof(struct blkid_bufinfo)) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	bf = alloc_buffer(pr, len);
+	if (!bf) {
 		errno = ENOMEM;
 		return NULL;
 	}
 
 	bf->len = len;
 	bf->off = real_off;
-	INIT_LIST_HEAD(&bf->bufs);
 
 	DBG(LOWPROBE, ul_debug("\tread: off=%"PRIu64" len=%"PRIu64"",
 	                       real_off, len));
 
-	ret = read(pr->fd, bf->data, len);
+	dfd = pr->read_fn || pr->mem ? -1 : get_direct_fd(pr, real_off, len);
+	if (pr->mem) {
+		memcpy(bf->data, pr->mem + real_off, len);
+		ret = len;
+	} else if (pr->read_fn) {
+		ret = pr->read_fn(pr->read_data, bf->data, len, real_off);
+	} else if (dfd >= 0) {
+		ret = pread(dfd, bf->data, len, real_off);
+		if (ret < 0 && errno == EINVAL) {
+			DBG(LOWPROBE, ul_debug("\tO_DIRECT read failed, fallback"));
+			dfd = -1;
+		}
+	}
+	if (dfd < 0 && !pr->mem && !pr->read_fn) {
+		if (lseek(pr->fd, real_off, SEEK_SET) == (off_t) -1) {
+			remove_buffer(pr, bf);
+			errno = 0;
+			return NULL;
+		}
+		ret = read(pr->fd, bf->data, len);
+	}
+
+	stats = get_stats(pr);
+	stats->nreads++;
+	if (ret > 0)
+		stats->nbytes += ret;
+
 	if (ret != (ssize_t) len) {
 		DBG(LOWPROBE, ul_debug("\tread failed: %m"));
-		remove_buffer(bf);
+		remove_buffer(pr, bf);
 
 		/* I/O errors on CDROMs are non-fatal to work with hybrid
 		 * audio+data disks */
@@ -607,14 +746,17 @@ static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint
 		return NULL;
 	}
 
-	if (mprotect(bf->data, len, PROT_READ))
+	if (mprotect(bf->data, bf->mapsz, PROT_READ))
 		DBG(LOWPROBE, ul_debug("\tmprotect failed: %m"));
 
 	return bf;
 }
 
 /*
- * Search in buffers we already have in memory
+ * Search in buffers we already have in memory. The last used buffer is moved
+ * to the begin of the list, the probing functions usually read the same area
+ * more than once (and partition tables with many entries use a lot of
+ * buffers).
  */
 static struct blkid_bufinfo *get_cached_buffer(blkid_probe pr, uint64_t off, uint64_t len)
 {
@@ -628,6 +770,10 @@ static struct blkid_bufinfo *get_cached_buffer(blkid_probe pr, uint64_t off, uin
 		if (real_off >= x->off && real_off + len <= x->off + x->len) {
 			DBG(BUFFER, ul_debug("\treuse: off=%"PRIu64" len=%"PRIu64" (for off=%"PRIu64" len=%"PRIu64")",
 						x->off, x->len, real_off, len));
+			if (!list_entry_is_first(&x->bufs, &pr->buffers)) {
+				list_del(&x->bufs);
+				list_add(&x->bufs, &pr->buffers);
+			}
 			return x;
 		}
 	}
@@ -663,7 +809,35 @@ void blkid_probe_prune_buffers(blkid_probe pr)
 		struct blkid_bufinfo *x =
 				list_entry(p, struct blkid_bufinfo, bufs);
 
-		remove_buffer(x);
+		remove_buffer(pr, x);
+	}
+}
+
+/*
+ * The data returned by blkid_probe_get_buffer() are not needed anymore (for
+ * example already parsed partition table sector), so deallocate the buffer
+ * to be reused by the next read. It's a no-op for large buffers which may be
+ * shared with other requests or for modified buffers.
+ */
+void blkid_probe_release_buffer(blkid_probe pr, const unsigned char *data)
+{
+	if (!data || pr->mem || (pr->flags & BLKID_FL_MODIF_BUFF))
+		return;
+
+	/* clones use parent's buffers, see blkid_probe_get_buffer() */
+	for (; pr; pr = pr->parent) {
+		struct list_head *p;
+
+		list_for_each(p, &pr->buffers) {
+			struct blkid_bufinfo *x =
+				list_entry(p, struct blkid_bufinfo, bufs);
+
+			if (data < x->data || data >= x->data + x->len)
+				continue;
+			if (x->len <= pr->io_size)
+				remove_buffer(pr, x);
+			return;
+		}
 	}
 }
 
@@ -685,6 +859,15 @@ static int hide_buffer(blkid_probe pr, uint64_t off, uint64_t len)
 		return -EINVAL;
 	}
 
+	/* the caller's memory is read-only, use a private copy */
+	if (pr->mem && !get_cached_buffer(pr, off, len)
+	    && real_off + len <= pr->off + pr->size) {
+		struct blkid_bufinfo *bf = read_buffer(pr, real_off, len);
+
+		if (bf)
+			list_add_tail(&bf->bufs, &pr->buffers);
+	}
+
 	list_for_each(p, &pr->buffers) {
 		struct blkid_bufinfo *x =
 			list_entry(p, struct blkid_bufinfo, bufs);
@@ -699,9 +882,9 @@ static int hide_buffer(blkid_probe pr, uint64_t off, uint64_t len)
 
 			DBG(BUFFER, ul_debug("\thiding: off=%"PRIu64" len=%"PRIu64,
 						off, len));
-			mprotect(x->data, x->len, PROT_READ | PROT_WRITE);
+			mprotect(x->data, x->mapsz, PROT_READ | PROT_WRITE);
 			memset(data, 0, len);
-			mprotect(x->data, x->len, PROT_READ);
+			mprotect(x->data, x->mapsz, PROT_READ);
 			ct++;
 		}
 	}
@@ -775,13 +958,21 @@ const unsigned char *blkid_probe_get_buffer(blkid_probe pr, uint64_t off, uint64
 
 	/* try buffers we already have in memory or read from device */
 	bf = get_cached_buffer(pr, off, len);
-	if (!bf) {
+	if (bf)
+		get_stats(pr)->nhits++;
+	else if (pr->mem) {
+		/* zero-copy, see blkid_probe_set_buffer() */
+		get_stats(pr)->nhits++;
+		errno = 0;
+		return pr->mem + real_off + bias;
+	} else {
+		get_stats(pr)->nmisses++;
 		bf = read_buffer(pr, real_off, len);
 		if (!bf)
 			return NULL;
 
 		mark_prunable_buffers(pr, bf);
-		list_add_tail(&bf->bufs, &pr->buffers);
+		list_add(&bf->bufs, &pr->buffers);
 	}
 
 	assert(bf->off <= real_off);
@@ -823,7 +1014,7 @@ int blkid_probe_reset_buffers(blkid_probe pr)
 		ct++;
 		len += bf->len;
 
-		remove_buffer(bf);
+		remove_buffer(pr, bf);
 	}
 
 	DBG(LOWPROBE, ul_debug(" buffers summary: %"PRIu64" bytes by %"PRIu64" read() calls",
@@ -834,6 +1025,236 @@ int blkid_probe_reset_buffers(blkid_probe pr)
 	return 0;
 }
 
+/**
+ * blkid_probe_enable_direct_io:
+ * @pr: prober
+ * @enable: TRUE/FALSE
+ *
+ * Read the device by O_DIRECT to bypass the page cache. This is usable when
+ * many devices are scanned and the data should not pollute the page cache.
+ * The library uses a separate file descriptor for O_DIRECT reads; the
+ * requests which are not aligned to the device sector size or unsupported
+ * by the device or filesystem are read by the original file descriptor.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: 2.41
+ */
+int blkid_probe_enable_direct_io(blkid_probe pr, int enable)
+{
+	if (!pr)
+		return -1;
+	if (enable)
+		pr->flags |= BLKID_FL_DIRECT_IO;
+	else {
+		pr->flags &= ~BLKID_FL_DIRECT_IO;
+		close_direct_fd(pr);
+	}
+	return 0;
+}
+
+/**
+ * blkid_probe_enable_stats:
+ * @pr: prober
+ * @enable: TRUE/FALSE
+ *
+ * Enables accounting of the time spent in the probing functions. The I/O
+ * counters (see blkid_probe_get_stats()) are always maintained, the per-prober
+ * statistics (see blkid_probe_get_prober_stats()) are collected only if
+ * enabled. The statistics are reset by blkid_probe_set_device() or
+ * blkid_probe_reset_stats().
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: 2.41
+ */
+int blkid_probe_enable_stats(blkid_probe pr, int enable)
+{
+	if (!pr)
+		return -1;
+	get_stats(pr)->enabled = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * blkid_probe_reset_stats:
+ * @pr: prober
+ *
+ * Zeroize all probing statistics.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: 2.41
+ */
+int blkid_probe_reset_stats(blkid_probe pr)
+{
+	struct blkid_probe_stats *stats;
+
+	if (!pr)
+		return -1;
+
+	stats = get_stats(pr);
+	free(stats->probers);
+	stats->probers = NULL;
+	stats->nprobers = 0;
+	stats->nreads = stats->nbytes = 0;
+	stats->nhits = stats->nmisses = 0;
+	return 0;
+}
+
+/**
+ * blkid_probe_get_stats:
+ * @pr: prober
+ * @nreads: returns number of read() calls
+ * @nbytes: returns number of bytes read from the device
+ * @nhits: returns number of requests satisfied from already read buffers
+ * @nmisses: returns number of requests which has to be read from the device
+ *
+ * The arguments may be NULL.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: 2.41
+ */
+int blkid_probe_get_stats(blkid_probe pr, uint64_t *nreads, uint64_t *nbytes,
+			  uint64_t *nhits, uint64_t *nmisses)
+{
+	const struct blkid_probe_stats *stats;
+
+	if (!pr)
+		return -1;
+
+	/* cloned probes account to the parent */
+	stats = get_stats(pr);
+	if (nreads)
+		*nreads = stats->nreads;
+	if (nbytes)
+		*nbytes = stats->nbytes;
+	if (nhits)
+		*nhits = stats->nhits;
+	if (nmisses)
+		*nmisses = stats->nmisses;
+	return 0;
+}
+
+/**
+ * blkid_probe_get_prober_stats:
+ * @pr: prober
+ * @idx: record number
+ * @chain: returns chain name ("superblocks", "partitions" or "topology")
+ * @name: returns prober name (e.g. "ext4") or NULL for the whole chain
+ * @ncalls: returns number of calls
+ * @nreads: returns number of read() calls
+ * @nbytes: returns number of bytes read from the device
+ * @usec: returns time spent in the prober (microseconds)
+ *
+ * Returns statistics collected when blkid_probe_enable_stats() is enabled.
+ * Only the probers which requested any data from the device are accounted.
+ * The arguments (except @pr) may be NULL.
+ *
+ * Returns: 0 on success, 1 if @idx is out of range, or -1 in case of error.
+ *
+ * Since: 2.41
+ */
+int blkid_probe_get_prober_stats(blkid_probe pr, size_t idx,
+			  const char **chain, const char **name,
+			  uint64_t *ncalls, uint64_t *nreads,
+			  uint64_t *nbytes, uint64_t *usec)
+{
+	const struct blkid_probe_stats *stats;
+	const struct blkid_prober_stats *st;
+
+	if (!pr)
+		return -1;
+
+	stats = get_stats(pr);
+	if (idx >= stats->nprobers)
+		return 1;
+
+	st = &stats->probers[idx];
+	if (chain)
+		*chain = st->chain;
+	if (name)
+		*name = st->name;
+	if (ncalls)
+		*ncalls = st->ncalls;
+	if (nreads)
+		*nreads = st->nreads;
+	if (nbytes)
+		*nbytes = st->nbytes;
+	if (usec)
+		*usec = st->usec;
+	return 0;
+}
+
+static uint64_t stats_now(void)
+{
+	struct timeval tv;
+
+	if (gettime_monotonic(&tv) != 0)
+		return 0;
+	return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/*
+ * Remember the current counters; use blkid_probe_stats_add() to account
+ * the difference to a prober.
+ */
+void blkid_probe_stats_mark(blkid_probe pr, struct blkid_stats_mark *mk)
+{
+	struct blkid_probe_stats *stats = get_stats(pr);
+
+	if (!stats->enabled)
+		return;
+
+	mk->nreads = stats->nreads;
+	mk->nbytes = stats->nbytes;
+	mk->nrequests = stats->nhits + stats->nmisses;
+	mk->usec = stats_now();
+}
+
+void blkid_probe_stats_add(blkid_probe pr, struct blkid_stats_mark *mk,
+			   struct blkid_chain *chn, const char *name)
+{
+	struct blkid_probe_stats *stats = get_stats(pr);
+	struct blkid_prober_stats *st = NULL;
+	uint64_t now;
+	size_t i;
+
+	if (!stats->enabled)
+		return;
+
+	/* ignore probers which do not touch the device */
+	if (name && stats->nhits + stats->nmisses == mk->nrequests)
+		return;
+
+	for (i = 0; i < stats->nprobers; i++) {
+		if (stats->probers[i].chain == chn->driver->name
+		    && stats->probers[i].name == name) {
+			st = &stats->probers[i];
+			break;
+		}
+	}
+	if (!st) {
+		st = reallocarray(stats->probers, stats->nprobers + 1,
+				sizeof(struct blkid_prober_stats));
+		if (!st)
+			return;
+		stats->probers = st;
+		st = &stats->probers[stats->nprobers++];
+		memset(st, 0, sizeof(*st));
+		st->chain = chn->driver->name;
+		st->name = name;
+	}
+
+	now = stats_now();
+
+	st->ncalls++;
+	st->nreads += stats->nreads - mk->nreads;
+	st->nbytes += stats->nbytes - mk->nbytes;
+	st->usec += now > mk->usec ? now - mk->usec : 0;
+}
+
 /**
  * blkid_probe_hide_range:
  * @pr: prober
@@ -1017,9 +1438,11 @@ int blkid_probe_set_device(blkid_probe pr, int fd,
 
 	blkid_reset_probe(pr);
 	blkid_probe_reset_buffers(pr);
+	blkid_probe_reset_stats(pr);
 
 	if ((pr->flags & BLKID_FL_PRIVATE_FD) && pr->fd >= 0)
 		close(pr->fd);
+	close_direct_fd(pr);
 
 	if (pr->disk_probe) {
 		blkid_free_probe(pr->disk_probe);
@@ -1042,6 +1465,9 @@ int blkid_probe_set_device(blkid_probe pr, int fd,
 	pr->wipe_size = 0;
 	pr->wipe_chain = NULL;
 	pr->zone_size = 0;
+	pr->read_fn = NULL;
+	pr->read_data = NULL;
+	pr->mem = NULL;
 
 	if (fd < 0)
 		return 1;
@@ -1215,6 +1641,87 @@ err:
 
 }
 
+/* the probing area without a file descriptor is handled as a regular file */
+static void set_probe_source(blkid_probe pr, uint64_t size)
+{
+	pr->mode = S_IFREG;
+	pr->size = size;
+
+	if (pr->size <= 1440 * 1024)
+		pr->flags |= BLKID_FL_TINY_DEV;
+
+	DBG(LOWPROBE, ul_debug("ready for low-probing, size=%"PRIu64", source=%s",
+				pr->size, pr->mem ? "memory" : "reader"));
+}
+
+/**
+ * blkid_probe_set_reader:
+ * @pr: probe
+ * @read_fn: function to read data
+ * @data: private data for @read_fn
+ * @size: size of the probing area in bytes
+ *
+ * Assigns a user defined data source to the probe. The @read_fn has to read
+ * @count bytes from @offset to @buf and return number of read bytes or -1
+ * (and set errno) in case of error, the same as pread(2). For example, it
+ * allows to probe data from network streams without a file descriptor.
+ *
+ * The probe is not associated with a device, so all things which depend on
+ * a block device (topology ioctls, whole-disk probing, CD-ROMs, etc.) are not
+ * available. The source is reset by blkid_probe_set_device().
+ *
+ * Returns: -1 in case of failure, or 0 on success.
+ *
+ * Since: 2.41
+ */
+int blkid_probe_set_reader(blkid_probe pr,
+		ssize_t (*read_fn)(void *data, void *buf, size_t count, uint64_t offset),
+		void *data, uint64_t size)
+{
+	if (!read_fn || !size) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	blkid_probe_set_device(pr, -1, 0, 0);
+
+	pr->read_fn = read_fn;
+	pr->read_data = data;
+	set_probe_source(pr, size);
+	return 0;
+}
+
+/**
+ * blkid_probe_set_buffer:
+ * @pr: probe
+ * @buf: data to probe
+ * @size: size of the @buf in bytes
+ *
+ * Assigns memory (for example mmap-ed image) to the probe. The probing
+ * functions use @buf directly without copying; the memory is never modified
+ * by the library and it has to be valid until the probe is deallocated or
+ * another source is assigned.
+ *
+ * See also blkid_probe_set_reader() for limitations.
+ *
+ * Returns: -1 in case of failure, or 0 on success.
+ *
+ * Since: 2.41
+ */
+int blkid_probe_set_buffer(blkid_probe pr, const void *buf, uint64_t size)
+{
+	if (!buf || !size) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	blkid_probe_set_device(pr, -1, 0, 0);
+
+	pr->mem = buf;
+	set_probe_source(pr, size);
+	return 0;
+}
+
 int blkid_probe_get_dimension(blkid_probe pr, uint64_t *off, uint64_t *size)
 {
 	*off = pr->off;
@@ -1310,7 +1817,10 @@ int blkid_probe_get_idmag(blkid_probe pr, const struct blkid_idinfo *id,
 		if (!buf && errno)
 			return -errno;
 
-		if (buf && !memcmp(mag->magic, buf, mag->len)) {
+		/* check the first byte to avoid memcmp() call for most
+		 * of the magic strings */
+		if (buf && *buf == (unsigned char) *mag->magic
+		    && !memcmp(mag->magic, buf, mag->len)) {
 			DBG(LOWPROBE, ul_debug("\tmagic sboff=%u, kboff=%ld",
 				mag->sboff, kboff));
 			if (offset)
@@ -1329,12 +1839,170 @@ int blkid_probe_get_idmag(blkid_probe pr, const struct blkid_idinfo *id,
 	return BLKID_PROBE_OK;
 }
 
+/*
+ * Read planner
+ *
+ * Collects locations of the magic strings of all enabled (and not filtered
+ * out) probers, merges neighbouring areas and reads them by a few large
+ * read() calls before probing starts. The probing functions then get the
+ * data from the already cached buffers.
+ *
+ * Only areas shared by more than one magic string are read in advance,
+ * everything else is still read on demand by blkid_probe_get_buffer().
+ */
+#define BLKID_PLAN_SBSZ		4096		/* expected superblock size */
+#define BLKID_PLAN_GAP		(32 * 1024)	/* max. gap between merged areas */
+#define BLKID_PLAN_MAXREAD	(256 * 1024)	/* max. size of one read */
+
+struct blkid_plan_range {
+	uint64_t	start;
+	uint64_t	end;
+};
+
+static int cmp_plan_ranges(const void *a, const void *b)
+{
+	const struct blkid_plan_range *ra = a, *rb = b;
+
+	if (ra->start == rb->start)
+		return ra->end < rb->end ? -1 : ra->end > rb->end;
+	return ra->start < rb->start ? -1 : 1;
+}
+
+static size_t plan_add_idinfo(blkid_probe pr, const struct blkid_idinfo *id,
+			struct blkid_plan_range *ranges, size_t nranges,
+			size_t maxranges)
+{
+	const struct blkid_idmag *mag;
+
+	if (id->minsz && (unsigned) id->minsz > pr->size)
+		return nranges;
+
+	for (mag = &id->magics[0]; mag->magic && nranges < maxranges; mag++) {
+		struct blkid_plan_range *r;
+		uint64_t start, end;
+
+		/* hint and zone based offsets are known during probing only */
+		if (mag->hoff || mag->is_zoned)
+			continue;
+
+		if (mag->kboff >= 0) {
+			start = (uint64_t) mag->kboff << 10;
+			end = start + max((uint64_t) mag->sboff + mag->len,
+					  (uint64_t) BLKID_PLAN_SBSZ);
+		} else {
+			if ((uint64_t) -mag->kboff << 10 > pr->size)
+				continue;
+			start = pr->size - ((uint64_t) -mag->kboff << 10);
+			end = start + mag->sboff + mag->len;
+		}
+
+		start -= start % pr->io_size;
+		if (end % pr->io_size)
+			end += pr->io_size - (end % pr->io_size);
+		if (end > pr->size)
+			end = pr->size;
+		if (start >= end)
+			continue;
+
+		r = &ranges[nranges++];
+		r->start = start;
+		r->end = end;
+	}
+	return nranges;
+}
+
+static void blkid_probe_plan_reads(blkid_probe pr)
+{
+	struct blkid_plan_range *ranges;
+	size_t i, n = 0, nmax = 0;
+	int ch;
+
+	/* clones use parent's buffers, modified buffers have to be kept, and
+	 * the memory source has nothing to batch */
+	if (pr->parent || pr->mem || pr->size == 0 || pr->io_size == 0
+	    || S_ISCHR(pr->mode)
+	    || (pr->flags & (BLKID_FL_MODIF_BUFF | BLKID_FL_NOSCAN_DEV))
+	    || blkid_probe_is_tiny(pr)
+	    || blkid_probe_is_cdrom(pr))
+		return;
+
+	for (ch = 0; ch < BLKID_NCHAINS; ch++) {
+		struct blkid_chain *chn = &pr->chains[ch];
+		const struct blkid_chaindrv *drv = chn->driver;
+
+		if (!chn->enabled || !drv->idinfos)
+			continue;
+		for (i = 0; i < drv->nidinfos; i++) {
+			const struct blkid_idmag *mag = &drv->idinfos[i]->magics[0];
+
+			while (mag->magic) {
+				nmax++;
+				mag++;
+			}
+		}
+	}
+	if (!nmax)
+		return;
+
+	ranges = malloc(nmax * sizeof(struct blkid_plan_range));
+	if (!ranges)
+		return;
+
+	for (ch = 0; ch < BLKID_NCHAINS; ch++) {
+		struct blkid_chain *chn = &pr->chains[ch];
+		const struct blkid_chaindrv *drv = chn->driver;
+
+		if (!chn->enabled || !drv->idinfos)
+			continue;
+		for (i = 0; i < drv->nidinfos; i++) {
+			if (chn->fltr && blkid_bmp_get_item(chn->fltr, i))
+				continue;
+			n = plan_add_idinfo(pr, drv->idinfos[i], ranges, n, nmax);
+		}
+	}
+
+	qsort(ranges, n, sizeof(struct blkid_plan_range), cmp_plan_ranges);
+
+	for (i = 0; i < n; ) {
+		struct blkid_bufinfo *bf;
+		uint64_t start = ranges[i].start, end = ranges[i].end;
+		size_t nmerged = 1;
+
+		for (i++; i < n; i++, nmerged++) {
+			uint64_t e = max(end, ranges[i].end);
+
+			if (ranges[i].start > end + BLKID_PLAN_GAP
+			    || e - start > BLKID_PLAN_MAXREAD)
+				break;
+			end = e;
+		}
+
+		if (nmerged < 2 || get_cached_buffer(pr, start, end - start))
+			continue;
+
+		DBG(BUFFER, ul_debug("\tplan: off=%"PRIu64" len=%"PRIu64" (%zu areas)",
+					start, end - start, nmerged));
+
+		bf = read_buffer(pr, pr->off + start, end - start);
+		if (!bf)
+			continue;	/* ignore errors, read on demand later */
+
+		mark_prunable_buffers(pr, bf);
+		list_add_tail(&bf->bufs, &pr->buffers);
+	}
+
+	blkid_probe_prune_buffers(pr);
+	free(ranges);
+	errno = 0;
+}
+
 static inline void blkid_probe_start(blkid_probe pr)
 {
 	DBG(LOWPROBE, ul_debug("start probe"));
 	pr->cur_chain = NULL;
 	pr->prob_flags = 0;
 	blkid_probe_set_wiper(pr, 0, 0);
+	blkid_probe_plan_reads(pr);
 }
 
 static inline void blkid_probe_end(blkid_probe pr)
@@ -1386,6 +2054,7 @@ static inline void blkid_probe_end(blkid_probe pr)
  */
 int blkid_do_probe(blkid_probe pr)
 {
+	struct blkid_stats_mark mk;
 	int rc = 1;
 
 	if (pr->flags & BLKID_FL_NOSCAN_DEV)
@@ -1429,7 +2098,9 @@ int blkid_do_probe(blkid_probe pr)
 			continue;
 
 		/* rc: -1 = error, 0 = success, 1 = no result */
+		blkid_probe_stats_mark(pr, &mk);
 		rc = chn->driver->probe(pr, chn);
+		blkid_probe_stats_add(pr, &mk, chn, NULL);
 
 	} while (rc == BLKID_PROBE_NONE);
 
@@ -1755,11 +2426,13 @@ int blkid_probe_step_back(blkid_probe pr)
  */
 int blkid_do_safeprobe(blkid_probe pr)
 {
+	struct blkid_stats_mark mk;
 	int i, count = 0, rc = 0;
 
 	if (pr->flags & BLKID_FL_NOSCAN_DEV)
 		return BLKID_PROBE_NONE;
 
+	UL_TRACE_BEGIN("blkid_do_safeprobe");
 	blkid_probe_start(pr);
 
 	for (i = 0; i < BLKID_NCHAINS; i++) {
@@ -1777,7 +2450,11 @@ int blkid_do_safeprobe(blkid_probe pr)
 
 		blkid_probe_chain_reset_position(chn);
 
+		UL_TRACE_BEGIN(chn->driver->name);
+		blkid_probe_stats_mark(pr, &mk);
 		rc = chn->driver->safeprobe(pr, chn);
+		blkid_probe_stats_add(pr, &mk, chn, NULL);
+		UL_TRACE_END(chn->driver->name);
 
 		blkid_probe_chain_reset_position(chn);
 
@@ -1790,6 +2467,7 @@ int blkid_do_safeprobe(blkid_probe pr)
 
 done:
 	blkid_probe_end(pr);
+	UL_TRACE_END("blkid_do_safeprobe");
 	if (rc < 0)
 		return BLKID_PROBE_ERROR;
 
@@ -1810,11 +2488,13 @@ done:
  */
 int blkid_do_fullprobe(blkid_probe pr)
 {
+	struct blkid_stats_mark mk;
 	int i, count = 0, rc = 0;
 
 	if (pr->flags & BLKID_FL_NOSCAN_DEV)
 		return BLKID_PROBE_NONE;
 
+	UL_TRACE_BEGIN("blkid_do_fullprobe");
 	blkid_probe_start(pr);
 
 	for (i = 0; i < BLKID_NCHAINS; i++) {
@@ -1832,7 +2512,11 @@ int blkid_do_fullprobe(blkid_probe pr)
 
 		blkid_probe_chain_reset_position(chn);
 
+		UL_TRACE_BEGIN(chn->driver->name);
+		blkid_probe_stats_mark(pr, &mk);
 		rc = chn->driver->probe(pr, chn);
+		blkid_probe_stats_add(pr, &mk, chn, NULL);
+		UL_TRACE_END(chn->driver->name);
 
 		blkid_probe_chain_reset_position(chn);
 
@@ -1845,6 +2529,7 @@ int blkid_do_fullprobe(blkid_probe pr)
 
 done:
 	blkid_probe_end(pr);
+	UL_TRACE_END("blkid_do_fullprobe");
 	if (rc < 0)
 		return BLKID_PROBE_ERROR;
 
@@ -1857,6 +2542,31 @@ const unsigned char *blkid_probe_get_sector(blkid_probe pr, unsigned int sector)
 	return blkid_probe_get_buffer(pr, ((uint64_t) sector) << 9, 0x200);
 }
 
+/*
+ * Asks kernel to read the area in advance, so the next
+ * blkid_probe_get_buffer() for the area does not wait for the device. It's
+ * only a hint; nothing is done for memory and reader sources and O_DIRECT
+ * reads, as they do not use page cache.
+ */
+void blkid_probe_prefetch(blkid_probe pr, uint64_t off, uint64_t len)
+{
+#if defined(POSIX_FADV_WILLNEED) && defined(HAVE_POSIX_FADVISE)
+	if (pr->fd < 0 || pr->mem || pr->read_fn
+	    || (pr->flags & BLKID_FL_DIRECT_IO)
+	    || off >= pr->size)
+		return;
+
+	len = min(len, pr->size - off);
+
+	DBG(BUFFER, ul_debug("\tprefetch: off=%"PRIu64" len=%"PRIu64, off, len));
+	ignore_result( posix_fadvise(pr->fd, pr->off + off, len, POSIX_FADV_WILLNEED) );
+#else
+	(void) pr;
+	(void) off;
+	(void) len;
+#endif
+}
+
 struct blkid_prval *blkid_probe_assign_value(blkid_probe pr, const char *name)
 {
 	struct blkid_prval *v;
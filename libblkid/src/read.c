@@ -371,6 +371,7 @@ done:
  */
 void blkid_read_cache(blkid_cache cache)
 {
+	struct blkid_bincache bc;
 	FILE *file;
 	char buf[4096];
 	int fd, lineno = 0;
@@ -391,6 +392,24 @@ void blkid_read_cache(blkid_cache cache)
 		goto errout;
 	}
 
+	/* the rest of the previous file is obsolete now */
+	blkid_bincache_close(&cache->bic_bin);
+
+	if (blkid_bincache_open(&bc, cache->bic_filename) == 0) {
+		int rc = 0;
+
+		if (list_empty(&cache->bic_devs)) {
+			/* import later, see blkid_bincache_load() */
+			DBG(CACHE, ul_debug("using binary cache"));
+			cache->bic_bin = bc;
+		} else {
+			rc = blkid_bincache_import(&bc, cache);
+			blkid_bincache_close(&bc);
+		}
+		if (rc == 0)
+			goto done;
+	}
+
 	DBG(CACHE, ul_debug("reading cache file %s",
 				cache->bic_filename));
 
@@ -419,7 +438,10 @@ void blkid_read_cache(blkid_cache cache)
 		}
 	}
 	fclose(file);
-
+	fd = -1;
+done:
+	if (fd >= 0)
+		close(fd);
 	/*
 	 * Initially we do not need to write out the cache file.
 	 */
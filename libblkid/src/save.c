@@ -86,6 +86,9 @@ int blkid_flush_cache(blkid_cache cache)
 	int fd, ret = 0;
 	struct stat st;
 
+	if (cache->bic_flags & BLKID_BIC_FL_CHANGED)
+		blkid_bincache_load(cache);
+
 	if (list_empty(&cache->bic_devs) ||
 	    !(cache->bic_flags & BLKID_BIC_FL_CHANGED)) {
 		DBG(SAVE, ul_debug("skipping cache file write"));
@@ -201,6 +204,9 @@ int blkid_flush_cache(blkid_cache cache)
 		}
 	}
 
+	/* update (or remove obsolete) binary version of the cache */
+	if (ret == 1 && blkid_bincache_write(cache, filename) != 0)
+		blkid_bincache_remove(filename);
 errout:
 	free(tmp);
 	if (filename != cache->bic_filename)
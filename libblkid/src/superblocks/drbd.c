@@ -17,6 +17,7 @@
 #include <stddef.h>
 
 #include "superblocks.h"
+#include "iszero.h"
 
 enum {
 	DRBD_VERSION_08,
@@ -131,11 +132,7 @@ struct meta_data_on_disk_9 {
 static int is_zero_padded(const unsigned char *padding_start,
 			  const unsigned char *padding_end)
 {
-	for (; padding_start < padding_end; padding_start++) {
-		if (*padding_start != 0)
-			return 0;
-	}
-	return 1;
+	return ul_buffer_is_zero(padding_start, padding_end - padding_start);
 }
 
 static int probe_drbd_84(blkid_probe pr, const struct blkid_idmag *mag)
@@ -85,6 +85,7 @@
 
 static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn);
 static int superblocks_safeprobe(blkid_probe pr, struct blkid_chain *chn);
+static void superblocks_free_data(blkid_probe pr, void *data);
 
 static int blkid_probe_set_usage(blkid_probe pr, int usage);
 
@@ -195,8 +196,179 @@ const struct blkid_chaindrv superblocks_drv = {
 	.has_fltr     = TRUE,
 	.probe        = superblocks_probe,
 	.safeprobe    = superblocks_safeprobe,
+	.free_data    = superblocks_free_data
 };
 
+/*
+ * Magic strings index
+ *
+ * All magic strings with a well-known location (no hints, no zones) are
+ * sorted by the location when the library is loaded. At the beginning of the
+ * probing the prober reads every location only once and compares all the
+ * magic strings stored there; the probing functions without a matching magic
+ * string are skipped later in the probing loop.
+ *
+ * The index is used to exclude probing functions only. A match is always
+ * verified by blkid_probe_get_idmag(), so the result is exactly the same as
+ * without the index.
+ */
+struct sb_magic {
+	long		kboff;
+	unsigned int	sboff;
+	unsigned int	len;
+	size_t		idx;		/* idinfos[] index */
+	const char	*magic;
+
+	uint64_t	word;		/* the first (max 8) bytes of the magic */
+	uint64_t	mask;		/* valid bytes in the word */
+};
+
+static struct sb_magic *magics_index;
+static size_t nmagics_index;
+
+/* per-probe status of the idinfos[] items (stored in chn->data) */
+enum {
+	SB_MAGIC_UNKNOWN = 0,	/* not indexed, use blkid_probe_get_idmag() */
+	SB_MAGIC_NONE,		/* indexed, no magic string found */
+	SB_MAGIC_FOUND		/* indexed, a magic string found */
+};
+
+struct sb_magic_status {
+	unsigned char	status[ARRAY_SIZE(idinfos)];
+
+	/* see blkid_probe_prefer_superblocks_type() */
+	unsigned int	ordered : 1;
+	size_t		pos;				/* current order[] item */
+	size_t		order[ARRAY_SIZE(idinfos)];	/* idinfos[] indexes */
+	size_t		rank[ARRAY_SIZE(idinfos)];	/* order[] positions */
+};
+
+static struct sb_magic_status *get_magic_status(struct blkid_chain *chn)
+{
+	if (!chn->data)
+		chn->data = calloc(1, sizeof(struct sb_magic_status));
+	return chn->data;
+}
+
+static int is_indexable_magic(const struct blkid_idmag *mag)
+{
+	unsigned int i;
+
+	if (mag->hoff || mag->is_zoned || !mag->len)
+		return 0;
+
+	/* zeroized by blkid_probe_hide_range() would match */
+	for (i = 0; i < mag->len; i++) {
+		if (mag->magic[i])
+			return 1;
+	}
+	return 0;
+}
+
+static int is_indexable_idinfo(const struct blkid_idinfo *id)
+{
+	const struct blkid_idmag *mag = &id->magics[0];
+
+	if (!mag->magic)
+		return 0;
+	for ( ; mag->magic; mag++) {
+		if (!is_indexable_magic(mag))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * The magic strings are compared by 64-bit words; the first bytes of all magic
+ * strings at the same location are compared with one word read from the
+ * device. Only the rest of the longer magic strings is compared by memcmp().
+ */
+static inline uint64_t magic_to_word(const unsigned char *data, size_t len)
+{
+	uint64_t w = 0;
+	size_t i;
+
+	if (len > sizeof(w))
+		len = sizeof(w);
+	for (i = 0; i < len; i++)
+		w |= (uint64_t) data[i] << (i * 8);
+	return w;
+}
+
+static inline int magic_word_match(const struct sb_magic *m, uint64_t w,
+				   const unsigned char *data)
+{
+	if ((w & m->mask) != m->word)
+		return 0;
+	return m->len <= sizeof(w)
+	       || memcmp(m->magic + sizeof(w), data + sizeof(w),
+			 m->len - sizeof(w)) == 0;
+}
+
+static int cmp_sb_magics(const void *a, const void *b)
+{
+	const struct sb_magic *ma = a, *mb = b;
+
+	if (ma->kboff != mb->kboff)
+		return ma->kboff < mb->kboff ? -1 : 1;
+	if (ma->sboff != mb->sboff)
+		return ma->sboff < mb->sboff ? -1 : 1;
+	return ma->idx < mb->idx ? -1 : ma->idx > mb->idx;
+}
+
+static void __attribute__ ((constructor)) superblocks_init_index(void)
+{
+	size_t i, n = 0;
+
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++) {
+		const struct blkid_idmag *mag;
+
+		if (!is_indexable_idinfo(idinfos[i]))
+			continue;
+		for (mag = &idinfos[i]->magics[0]; mag->magic; mag++)
+			n++;
+	}
+
+	magics_index = calloc(n, sizeof(struct sb_magic));
+	if (!magics_index)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++) {
+		const struct blkid_idmag *mag;
+
+		if (!is_indexable_idinfo(idinfos[i]))
+			continue;
+		for (mag = &idinfos[i]->magics[0]; mag->magic; mag++) {
+			struct sb_magic *m = &magics_index[nmagics_index++];
+
+			m->kboff = mag->kboff;
+			m->sboff = mag->sboff;
+			m->len = mag->len;
+			m->idx = i;
+			m->magic = mag->magic;
+			m->word = magic_to_word((const unsigned char *) mag->magic,
+						mag->len);
+			m->mask = mag->len >= sizeof(m->mask) ? ~0ULL :
+					(1ULL << (mag->len * 8)) - 1;
+		}
+	}
+
+	qsort(magics_index, nmagics_index, sizeof(struct sb_magic), cmp_sb_magics);
+}
+
+static void __attribute__ ((destructor)) superblocks_free_index(void)
+{
+	free(magics_index);
+	magics_index = NULL;
+	nmagics_index = 0;
+}
+
+static void superblocks_free_data(blkid_probe pr __attribute__((__unused__)),
+				  void *data)
+{
+	free(data);
+}
+
 /**
  * blkid_probe_enable_superblocks:
  * @pr: probe
@@ -271,6 +443,65 @@ int blkid_probe_filter_superblocks_type(blkid_probe pr, int flag, char *names[])
 	return __blkid_probe_filter_types(pr, BLKID_CHAIN_SUBLKS, flag, names);
 }
 
+/**
+ * blkid_probe_prefer_superblocks_type:
+ * @pr: prober
+ * @names: NULL terminated array of probing function names (e.g. "xfs") or NULL
+ *
+ * Sets probing functions which are tried before all others by blkid_do_probe()
+ * and blkid_do_fullprobe(). The other functions are tried in the default
+ * order. This is usable if the most common types on the system are known
+ * (for example from the blkid cache), so the common devices are identified
+ * early. Note that the functions return the first detected signature, so for
+ * devices with more signatures the result depends on the order.
+ *
+ * blkid_do_safeprobe() always checks all probing functions to detect
+ * ambivalent results and it ignores the order.
+ *
+ * The default order is restored if @names is NULL or empty.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: 2.41
+ */
+int blkid_probe_prefer_superblocks_type(blkid_probe pr, char *names[])
+{
+	struct blkid_chain *chn = &pr->chains[BLKID_CHAIN_SUBLKS];
+	struct sb_magic_status *st = get_magic_status(chn);
+	size_t i, n = 0;
+	char **p;
+
+	if (!st)
+		return -1;
+
+	st->ordered = 0;
+	if (!names || !*names)
+		goto done;
+
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++)
+		st->rank[i] = SIZE_MAX;
+
+	for (p = names; *p; p++) {
+		for (i = 0; i < ARRAY_SIZE(idinfos); i++) {
+			if (st->rank[i] != SIZE_MAX || strcmp(idinfos[i]->name, *p) != 0)
+				continue;
+			st->rank[i] = n;
+			st->order[n++] = i;
+			break;
+		}
+	}
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++) {
+		if (st->rank[i] == SIZE_MAX) {
+			st->rank[i] = n;
+			st->order[n++] = i;
+		}
+	}
+	st->ordered = 1;
+done:
+	DBG(LOWPROBE, ul_debug("superblocks order %s", st->ordered ? "set" : "reset"));
+	return 0;
+}
+
 /**
  * blkid_probe_filter_superblocks_usage:
  * @pr: prober
@@ -347,11 +578,151 @@ int blkid_superblocks_get_name(size_t idx, const char **name, int *usage)
 }
 
 /*
- * The blkid_do_probe() backend.
+ * Returns 1 if the probing function is not usable for the device.
  */
-static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
+static int is_unusable_idinfo(blkid_probe pr, const struct blkid_idinfo *id)
 {
-	size_t i;
+	if (id->minsz && (unsigned)id->minsz > pr->size)
+		return 1;	/* the device is too small */
+
+	/* don't probe for RAIDs, swap or journal on CD/DVDs */
+	if ((id->usage & (BLKID_USAGE_RAID | BLKID_USAGE_OTHER)) &&
+	    blkid_probe_is_cdrom(pr))
+		return 1;
+
+	/* don't probe for RAIDs on floppies */
+	if ((id->usage & BLKID_USAGE_RAID) && blkid_probe_is_tiny(pr))
+		return 1;
+
+	return 0;
+}
+
+static int is_skipped_magic(blkid_probe pr, struct blkid_chain *chn,
+			    struct sb_magic_status *st, const struct sb_magic *m)
+{
+	return st->status[m->idx] == SB_MAGIC_FOUND
+	       || (chn->fltr && blkid_bmp_get_item(chn->fltr, m->idx))
+	       || is_unusable_idinfo(pr, idinfos[m->idx]);
+}
+
+/*
+ * Compares all indexed magic strings with the device and updates per-probe
+ * status of the probing functions.
+ */
+static void superblocks_scan_index(blkid_probe pr, struct blkid_chain *chn)
+{
+	struct sb_magic_status *st = get_magic_status(chn);
+	size_t i, j;
+
+	if (!st)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(idinfos); i++)
+		st->status[i] = magics_index && is_indexable_idinfo(idinfos[i]) ?
+					SB_MAGIC_NONE : SB_MAGIC_UNKNOWN;
+
+	for (i = 0; i < nmagics_index; i = j) {
+		const unsigned char *buf = NULL;
+		unsigned int len = 0;
+		uint64_t off, w;
+		int err;
+		long kboff = magics_index[i].kboff;
+		unsigned int sboff = magics_index[i].sboff;
+
+		/* all magic strings at the same location */
+		for (j = i; j < nmagics_index
+			    && magics_index[j].kboff == kboff
+			    && magics_index[j].sboff == sboff; j++) {
+			if (!is_skipped_magic(pr, chn, st, &magics_index[j]))
+				len = max(len, magics_index[j].len);
+		}
+		if (!len)
+			continue;
+
+		if (kboff >= 0)
+			off = (kboff << 10) + sboff;
+		else
+			off = pr->size - (-kboff << 10) + sboff;
+
+		errno = 0;
+		buf = blkid_probe_get_buffer(pr, off, len);
+		err = buf ? 0 : errno;
+		w = buf ? magic_to_word(buf, len) : 0;
+
+		for ( ; i < j; i++) {
+			const struct sb_magic *m = &magics_index[i];
+			const unsigned char *data = buf;
+
+			if (is_skipped_magic(pr, chn, st, m))
+				continue;
+			if (!data && !err && m->len < len) {
+				/* the longest magic string is out of the device */
+				errno = 0;
+				data = blkid_probe_get_buffer(pr, off, m->len);
+				if (data)
+					w = magic_to_word(data, m->len);
+				else if (errno)
+					err = errno;
+			}
+			if (err) {
+				/* I/O error, report it in the probing loop */
+				st->status[m->idx] = SB_MAGIC_UNKNOWN;
+				continue;
+			}
+			if (data && magic_word_match(m, w, data))
+				st->status[m->idx] = SB_MAGIC_FOUND;
+		}
+	}
+	errno = 0;
+}
+
+/*
+ * The same as blkid_probe_get_idmag(), but evaluates the index at first.
+ */
+static int superblocks_get_idmag(blkid_probe pr, struct blkid_chain *chn,
+			uint64_t *offset, const struct blkid_idmag **res)
+{
+	struct sb_magic_status *st = chn->data;
+
+	if (st && st->status[chn->idx] == SB_MAGIC_NONE) {
+		if (res)
+			*res = NULL;
+		return BLKID_PROBE_NONE;
+	}
+	return blkid_probe_get_idmag(pr, idinfos[chn->idx], offset, res);
+}
+
+/*
+ * Returns the first order[] position for the probing loop. The chn->idx
+ * is always idinfos[] index, the position is kept in the chain data.
+ */
+static size_t superblocks_start_pos(struct blkid_chain *chn,
+				    struct sb_magic_status *st)
+{
+	size_t idx;
+
+	if (chn->idx < 0)
+		return 0;
+
+	idx = chn->idx;
+	if (st->pos < ARRAY_SIZE(idinfos) && st->order[st->pos] == idx)
+		return st->pos + 1;			/* continue */
+	if (st->pos == ARRAY_SIZE(idinfos) && idx + 1 == ARRAY_SIZE(idinfos))
+		return ARRAY_SIZE(idinfos);		/* already at the end */
+
+	/* blkid_probe_step_back() or so, probe the next item again */
+	idx++;
+	return idx < ARRAY_SIZE(idinfos) ? st->rank[idx] : ARRAY_SIZE(idinfos);
+}
+
+/*
+ * The blkid_do_probe() backend, the @ordered means that the order
+ * by blkid_probe_prefer_superblocks_type() is used.
+ */
+static int __superblocks_probe(blkid_probe pr, struct blkid_chain *chn, int ordered)
+{
+	struct sb_magic_status *st;
+	size_t i, pos;
 	int rc = BLKID_PROBE_NONE;
 
 	if (chn->idx < -1)
@@ -375,13 +746,27 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 	DBG(LOWPROBE, ul_debug("--> starting probing loop [SUBLKS idx=%d]",
 		chn->idx));
 
-	i = chn->idx < 0 ? 0 : chn->idx + 1U;
+	/* a new probing loop, compare all indexed magic strings */
+	if (chn->idx < 0)
+		superblocks_scan_index(pr, chn);
+
+	st = chn->data;
+	if (!st || !st->ordered)
+		ordered = 0;
+
+	pos = ordered ? superblocks_start_pos(chn, st) :
+			chn->idx < 0 ? 0 : chn->idx + 1U;
 
-	for ( ; i < ARRAY_SIZE(idinfos); i++) {
+	for ( ; pos < ARRAY_SIZE(idinfos); pos++) {
 		const struct blkid_idinfo *id;
 		const struct blkid_idmag *mag = NULL;
+		struct blkid_stats_mark mk;
 		uint64_t off = 0;
 
+		i = ordered ? st->order[pos] : pos;
+		if (ordered)
+			st->pos = pos;
+
 		chn->idx = i;
 		id = idinfos[i];
 
@@ -391,31 +776,21 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 			continue;
 		}
 
-		if (id->minsz && (unsigned)id->minsz > pr->size) {
-			rc = BLKID_PROBE_NONE;
-			continue;	/* the device is too small */
-		}
-
-		/* don't probe for RAIDs, swap or journal on CD/DVDs */
-		if ((id->usage & (BLKID_USAGE_RAID | BLKID_USAGE_OTHER)) &&
-		    blkid_probe_is_cdrom(pr)) {
-			rc = BLKID_PROBE_NONE;
-			continue;
-		}
-
-		/* don't probe for RAIDs on floppies */
-		if ((id->usage & BLKID_USAGE_RAID) && blkid_probe_is_tiny(pr)) {
+		if (is_unusable_idinfo(pr, id)) {
 			rc = BLKID_PROBE_NONE;
 			continue;
 		}
 
 		DBG(LOWPROBE, ul_debug("[%zd] %s:", i, id->name));
 
-		rc = blkid_probe_get_idmag(pr, id, &off, &mag);
-		if (rc < 0)
-			break;
-		if (rc != BLKID_PROBE_OK)
+		blkid_probe_stats_mark(pr, &mk);
+		rc = superblocks_get_idmag(pr, chn, &off, &mag);
+		if (rc != BLKID_PROBE_OK) {
+			blkid_probe_stats_add(pr, &mk, chn, id->name);
+			if (rc < 0)
+				break;
 			continue;
+		}
 
 		/* final check by probing function */
 		if (id->probefunc) {
@@ -423,13 +798,15 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 			errno = 0;
 			rc = id->probefunc(pr, mag);
 			blkid_probe_prune_buffers(pr);
+			blkid_probe_stats_add(pr, &mk, chn, id->name);
 			if (rc != BLKID_PROBE_OK) {
 				blkid_probe_chain_reset_values(pr, chn);
 				if (rc < 0)
 					break;
 				continue;
 			}
-		}
+		} else
+			blkid_probe_stats_add(pr, &mk, chn, id->name);
 
 		/* all checks passed */
 		if (chn->flags & BLKID_SUBLKS_TYPE)
@@ -454,11 +831,22 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 		return BLKID_PROBE_OK;
 	}
 
+	if (ordered && pos == ARRAY_SIZE(idinfos)) {
+		/* blkid_do_probe() expects the last item at the end of the chain */
+		st->pos = pos;
+		chn->idx = ARRAY_SIZE(idinfos) - 1;
+	}
+
 	DBG(LOWPROBE, ul_debug("<-- leaving probing loop (failed=%d) [SUBLKS idx=%d]",
 			rc, chn->idx));
 	return rc;
 }
 
+static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
+{
+	return __superblocks_probe(pr, chn, 1);
+}
+
 /*
  * This is the same function as blkid_do_probe(), but returns only one result
  * (cannot be used in while()) and checks for ambivalent results (more
@@ -484,7 +872,8 @@ static int superblocks_safeprobe(blkid_probe pr, struct blkid_chain *chn)
 	if (pr->flags & BLKID_FL_NOSCAN_DEV)
 		return BLKID_PROBE_NONE;
 
-	while ((rc = superblocks_probe(pr, chn)) == 0) {
+	/* the order does not matter, all probing functions are checked */
+	while ((rc = __superblocks_probe(pr, chn, 0)) == 0) {
 
 		if (blkid_probe_is_tiny(pr) && !count)
 			return BLKID_PROBE_OK;	/* floppy or so -- returns the first result. */
@@ -27,10 +27,121 @@ static blkid_tag blkid_new_tag(void)
 	DBG(TAG, ul_debugobj(tag, "alloc"));
 	INIT_LIST_HEAD(&tag->bit_tags);
 	INIT_LIST_HEAD(&tag->bit_names);
+	INIT_LIST_HEAD(&tag->bit_hash);
 
 	return tag;
 }
 
+/*
+ * The device tags are indexed by NAME=value in the cache hash table, so
+ * blkid_find_dev_with_tag() does not need to walk all the devices.
+ */
+#define BLKID_TAG_HASH_MINSZ	64
+
+/* FNV-1a of "NAME\0value" */
+uint32_t blkid_tag_hash(const char *name, const char *value)
+{
+	uint32_t h = 2166136261U;
+	const unsigned char *p;
+
+	for (p = (const unsigned char *) name; *p; p++)
+		h = (h ^ *p) * 16777619U;
+	h *= 16777619U;
+	for (p = (const unsigned char *) value; *p; p++)
+		h = (h ^ *p) * 16777619U;
+	return h;
+}
+
+static inline struct list_head *tag_hash_bucket(blkid_cache cache, uint32_t hash)
+{
+	return &cache->bic_hash[hash & (cache->bic_hashsz - 1)];
+}
+
+static int resize_tag_hash(blkid_cache cache, size_t sz)
+{
+	struct list_head *hash;
+	size_t i;
+
+	hash = malloc(sz * sizeof(struct list_head));
+	if (!hash)
+		return -BLKID_ERR_MEM;
+	for (i = 0; i < sz; i++)
+		INIT_LIST_HEAD(&hash[i]);
+
+	/* move the tags to the new buckets */
+	for (i = 0; i < cache->bic_hashsz; i++) {
+		struct list_head *old = &cache->bic_hash[i];
+
+		while (!list_empty(old)) {
+			blkid_tag tag = list_entry(old->next,
+					struct blkid_struct_tag, bit_hash);
+			list_del(&tag->bit_hash);
+			list_add_tail(&tag->bit_hash,
+				      &hash[tag->bit_hashval & (sz - 1)]);
+		}
+	}
+
+	DBG(TAG, ul_debugobj(cache, "tags hash resized %zu -> %zu",
+				cache->bic_hashsz, sz));
+	free(cache->bic_hash);
+	cache->bic_hash = hash;
+	cache->bic_hashsz = sz;
+	return 0;
+}
+
+/*
+ * Make sure there is a room for one more tag. The table is resized when the
+ * average chain is longer than 2 items; the table is larger than necessary
+ * rather than not available if resize is impossible.
+ */
+static int reserve_tag_hash(blkid_cache cache)
+{
+	if (cache->bic_nhashed + 1 <= cache->bic_hashsz * 2)
+		return 0;
+	if (!cache->bic_hashsz)
+		return resize_tag_hash(cache, BLKID_TAG_HASH_MINSZ);
+
+	resize_tag_hash(cache, cache->bic_hashsz * 4);
+	return 0;
+}
+
+/* requires reserve_tag_hash() */
+static void hash_tag(blkid_cache cache, blkid_tag tag)
+{
+	if (!list_empty(&tag->bit_hash)) {
+		list_del(&tag->bit_hash);
+		cache->bic_nhashed--;
+	}
+
+	tag->bit_hashval = blkid_tag_hash(tag->bit_name, tag->bit_val);
+	list_add_tail(&tag->bit_hash, tag_hash_bucket(cache, tag->bit_hashval));
+	cache->bic_nhashed++;
+}
+
+static void unhash_tag(blkid_tag tag)
+{
+	if (list_empty(&tag->bit_hash))
+		return;
+
+	list_del_init(&tag->bit_hash);
+	if (tag->bit_dev && tag->bit_dev->bid_cache)
+		tag->bit_dev->bid_cache->bic_nhashed--;
+}
+
+void blkid_free_tag_hash(blkid_cache cache)
+{
+	size_t i;
+
+	for (i = 0; i < cache->bic_hashsz; i++) {
+		while (!list_empty(&cache->bic_hash[i]))
+			list_del_init(cache->bic_hash[i].next);
+	}
+	free(cache->bic_hash);
+	cache->bic_hash = NULL;
+	cache->bic_hashsz = 0;
+	cache->bic_nhashed = 0;
+}
+
 void blkid_free_tag(blkid_tag tag)
 {
 	if (!tag)
@@ -38,6 +149,7 @@ void blkid_free_tag(blkid_tag tag)
 
 	DBG(TAG, ul_debugobj(tag, "freeing tag %s (%s)", tag->bit_name, tag->bit_val));
 
+	unhash_tag(tag);
 	list_del(&tag->bit_tags);	/* list of tags for this device */
 	list_del(&tag->bit_names);	/* list of tags with this type */
 
@@ -113,6 +225,8 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 	char		*val = NULL;
 	char		**dev_var = NULL;
 
+	if (value && dev->bid_cache && reserve_tag_hash(dev->bid_cache) != 0)
+		return -BLKID_ERR_MEM;
 	if (value && !(val = strndup(value, vlength)))
 		return -BLKID_ERR_MEM;
 
@@ -141,6 +255,8 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 		DBG(TAG, ul_debugobj(t, "update (%s) '%s' -> '%s'", t->bit_name, t->bit_val, val));
 		free(t->bit_val);
 		t->bit_val = val;
+		if (dev->bid_cache)
+			hash_tag(dev->bid_cache, t);
 	} else {
 		/* Existing tag not present, add to device */
 		if (!(t = blkid_new_tag()))
@@ -168,6 +284,7 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 					      &dev->bid_cache->bic_tags);
 			}
 			list_add_tail(&t->bit_names, &head->bit_names);
+			hash_tag(dev->bid_cache, t);
 		}
 	}
 
@@ -322,7 +439,6 @@ blkid_dev blkid_find_dev_with_tag(blkid_cache cache,
 					 const char *type,
 					 const char *value)
 {
-	blkid_tag	head;
 	blkid_dev	dev;
 	int		pri;
 	struct list_head *p;
@@ -332,20 +448,25 @@ blkid_dev blkid_find_dev_with_tag(blkid_cache cache,
 		return NULL;
 
 	blkid_read_cache(cache);
+	if (blkid_bincache_import_tag(cache, type, value) < 0)
+		return NULL;
 
 	DBG(TAG, ul_debug("looking for tag %s=%s in cache", type, value));
 
 try_again:
 	pri = -1;
 	dev = NULL;
-	head = blkid_find_head_cache(cache, type);
 
-	if (head) {
-		list_for_each(p, &head->bit_names) {
+	if (cache->bic_hashsz) {
+		uint32_t hash = blkid_tag_hash(type, value);
+
+		list_for_each(p, tag_hash_bucket(cache, hash)) {
 			blkid_tag tmp = list_entry(p, struct blkid_struct_tag,
-						   bit_names);
+						   bit_hash);
 
-			if (!strcmp(tmp->bit_val, value) &&
+			if (tmp->bit_hashval == hash &&
+			    !strcmp(tmp->bit_name, type) &&
+			    !strcmp(tmp->bit_val, value) &&
 			    (tmp->bit_dev->bid_pri > pri) &&
 			    !access(tmp->bit_dev->bid_name, F_OK)) {
 				dev = tmp->bit_dev;
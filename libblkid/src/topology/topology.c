@@ -13,6 +13,10 @@
 #include <stddef.h>
 #include <inttypes.h>
 
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
 #include "topology.h"
 
 /**
@@ -53,11 +57,16 @@
  * blkid_probe_get_topology()
  *
  * blkid_topology_get_'VALUENAME'()
+ *
+ * The results may be cached for the whole process, see
+ * blkid_topology_enable_cache().
  */
 static int topology_probe(blkid_probe pr, struct blkid_chain *chn);
 static void topology_free(blkid_probe pr, void *data);
 static int topology_is_complete(blkid_probe pr);
 static int topology_set_logical_sector_size(blkid_probe pr);
+static int topology_set_value(blkid_probe pr, const char *name,
+				size_t structoff, unsigned long data);
 
 /*
  * Binary interface
@@ -102,6 +111,181 @@ const struct blkid_chaindrv topology_drv = {
 	.free_data    = topology_free
 };
 
+/*
+ * Process-wide topology cache, see blkid_topology_enable_cache(). The
+ * items are identified by devno and DISKSEQ (the kernel increments the
+ * sequence number on media change or when the device number is reused).
+ */
+#define TOPOLOGY_CACHE_MAX	256
+
+struct topology_cache_item {
+	dev_t				devno;
+	uint64_t			diskseq;
+	int				idx;	/* chain index of the prober */
+	struct blkid_struct_topology	tp;
+};
+
+static struct topology_cache_item *tpcache;
+static size_t tpcache_nitems;
+static size_t tpcache_next;	/* next item to replace if the cache is full */
+static int tpcache_enabled;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t tpcache_lock = PTHREAD_MUTEX_INITIALIZER;
+# define tpcache_lock()		pthread_mutex_lock(&tpcache_lock)
+# define tpcache_unlock()	pthread_mutex_unlock(&tpcache_lock)
+#else
+# define tpcache_lock()
+# define tpcache_unlock()
+#endif
+
+/**
+ * blkid_topology_enable_cache:
+ * @enable: TRUE/FALSE
+ *
+ * Enables the process-wide cache of the topology results. The topology is
+ * read from kernel (ioctls and sysfs) only once for each device, the next
+ * probes for the same device (device number and DISKSEQ) use the cached
+ * results. This is usable for applications which ask for the topology of the
+ * same devices many times. The cache is supported on kernels with DISKSEQ
+ * (since v5.15) only.
+ *
+ * Note that the kernel is able to change some values (e.g. for device-mapper
+ * after table reload) without a new DISKSEQ. Use blkid_topology_reset_cache()
+ * to invalidate the cache in this case; this is done automatically for the
+ * devices when blkid_cache_process_uevents() receives a uevent.
+ *
+ * Disabling the cache also removes all the cached results.
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ *
+ * Since: 2.41
+ */
+int blkid_topology_enable_cache(int enable)
+{
+	tpcache_lock();
+	tpcache_enabled = enable ? 1 : 0;
+	if (!enable) {
+		free(tpcache);
+		tpcache = NULL;
+		tpcache_nitems = tpcache_next = 0;
+	}
+	tpcache_unlock();
+
+	DBG(LOWPROBE, ul_debug("topology cache %s", enable ? "enabled" : "disabled"));
+	return 0;
+}
+
+/**
+ * blkid_topology_reset_cache:
+ * @devno: device number or zero
+ *
+ * Removes cached topology results for the device or for all devices if
+ * the @devno is zero. See blkid_topology_enable_cache().
+ *
+ * Since: 2.41
+ */
+void blkid_topology_reset_cache(dev_t devno)
+{
+	size_t i;
+
+	tpcache_lock();
+	for (i = 0; i < tpcache_nitems; ) {
+		if (devno && tpcache[i].devno != devno) {
+			i++;
+			continue;
+		}
+		tpcache[i] = tpcache[--tpcache_nitems];
+	}
+	tpcache_next = 0;
+	tpcache_unlock();
+}
+
+static uint64_t topology_get_diskseq(blkid_probe pr)
+{
+	uint64_t diskseq = 0;
+
+	if (ioctl(pr->fd, BLKGETDISKSEQ, &diskseq) != 0)
+		diskseq = 0;
+	return diskseq;
+}
+
+/* returns 0 and copies the result to @res if found */
+static int topology_cache_lookup(dev_t devno, uint64_t diskseq,
+				 struct topology_cache_item *res)
+{
+	size_t i;
+	int rc = 1;
+
+	tpcache_lock();
+	for (i = 0; i < tpcache_nitems; i++) {
+		if (tpcache[i].devno == devno && tpcache[i].diskseq == diskseq) {
+			*res = tpcache[i];
+			rc = 0;
+			break;
+		}
+	}
+	tpcache_unlock();
+	return rc;
+}
+
+static void topology_cache_add(dev_t devno, uint64_t diskseq, int idx,
+			       const struct blkid_struct_topology *tp)
+{
+	struct topology_cache_item *it = NULL;
+	size_t i;
+
+	tpcache_lock();
+	if (!tpcache_enabled)
+		goto done;
+
+	for (i = 0; i < tpcache_nitems; i++) {
+		if (tpcache[i].devno == devno) {
+			it = &tpcache[i];	/* obsolete DISKSEQ */
+			break;
+		}
+	}
+	if (!it && !tpcache) {
+		tpcache = calloc(TOPOLOGY_CACHE_MAX, sizeof(*tpcache));
+		if (!tpcache)
+			goto done;
+	}
+	if (!it && tpcache_nitems < TOPOLOGY_CACHE_MAX)
+		it = &tpcache[tpcache_nitems++];
+	if (!it) {
+		it = &tpcache[tpcache_next];
+		tpcache_next = (tpcache_next + 1) % TOPOLOGY_CACHE_MAX;
+	}
+
+	it->devno = devno;
+	it->diskseq = diskseq;
+	it->idx = idx;
+	it->tp = *tp;
+done:
+	tpcache_unlock();
+}
+
+/* set the values as if they have been returned by the topology prober */
+static int topology_set_cached(blkid_probe pr, struct blkid_chain *chn,
+				const struct topology_cache_item *it)
+{
+	const struct blkid_struct_topology *tp = &it->tp;
+
+	if (blkid_topology_set_alignment_offset(pr, tp->alignment_offset)
+	    || blkid_topology_set_minimum_io_size(pr, tp->minimum_io_size)
+	    || blkid_topology_set_optimal_io_size(pr, tp->optimal_io_size)
+	    || blkid_topology_set_physical_sector_size(pr, tp->physical_sector_size)
+	    || blkid_topology_set_dax(pr, tp->dax)
+	    || blkid_topology_set_diskseq(pr, tp->diskseq)
+	    || topology_set_value(pr, "LOGICAL_SECTOR_SIZE",
+			offsetof(struct blkid_struct_topology, logical_sector_size),
+			tp->logical_sector_size))
+		return -ENOMEM;
+
+	chn->idx = it->idx;
+	return 0;
+}
+
 /**
  * blkid_probe_enable_topology:
  * @pr: probe
@@ -145,6 +329,9 @@ blkid_topology blkid_probe_get_topology(blkid_probe pr)
  */
 static int topology_probe(blkid_probe pr, struct blkid_chain *chn)
 {
+	struct topology_cache_item cached;
+	uint64_t diskseq = 0;
+	dev_t devno = 0;
 	size_t i;
 	int rc;
 
@@ -154,7 +341,8 @@ static int topology_probe(blkid_probe pr, struct blkid_chain *chn)
 	if (!S_ISBLK(pr->mode))
 		return -EINVAL;	/* nothing, works with block devices only */
 
-	if (chn->binary) {
+	/* the cache needs the binary data also for the NAME=value results */
+	if (chn->binary || tpcache_enabled || chn->data) {
 		DBG(LOWPROBE, ul_debug("initialize topology binary data"));
 
 		if (chn->data)
@@ -171,6 +359,17 @@ static int topology_probe(blkid_probe pr, struct blkid_chain *chn)
 
 	blkid_probe_chain_reset_values(pr, chn);
 
+	if (tpcache_enabled && chn->idx < 0) {
+		devno = blkid_probe_get_devno(pr);
+		diskseq = devno ? topology_get_diskseq(pr) : 0;
+
+		if (diskseq && topology_cache_lookup(devno, diskseq, &cached) == 0) {
+			DBG(LOWPROBE, ul_debug("topology: cached result [idx=%d]", cached.idx));
+			rc = topology_set_cached(pr, chn, &cached);
+			return rc ? rc : BLKID_PROBE_OK;
+		}
+	}
+
 	DBG(LOWPROBE, ul_debug("--> starting probing loop [TOPOLOGY idx=%d]",
 		chn->idx));
 
@@ -182,10 +381,14 @@ static int topology_probe(blkid_probe pr, struct blkid_chain *chn)
 		chn->idx = i;
 
 		if (id->probefunc) {
+			struct blkid_stats_mark mk;
+
 			DBG(LOWPROBE, ul_debug("%s: call probefunc()", id->name));
 			errno = 0;
+			blkid_probe_stats_mark(pr, &mk);
 			rc = id->probefunc(pr, NULL);
 			blkid_probe_prune_buffers(pr);
+			blkid_probe_stats_add(pr, &mk, chn, id->name);
 			if (rc != 0)
 				continue;
 		}
@@ -196,6 +399,9 @@ static int topology_probe(blkid_probe pr, struct blkid_chain *chn)
 		/* generic for all probing drivers */
 		topology_set_logical_sector_size(pr);
 
+		if (diskseq)
+			topology_cache_add(devno, diskseq, chn->idx, chn->data);
+
 		DBG(LOWPROBE, ul_debug("<-- leaving probing loop (type=%s) [TOPOLOGY idx=%d]",
 			id->name, chn->idx));
 		return BLKID_PROBE_OK;
@@ -222,10 +428,10 @@ static int topology_set_value(blkid_probe pr, const char *name,
 	if (!data)
 		return 0;	/* ignore zeros */
 
-	if (chn->binary) {
+	if (chn->data)
 		memcpy((char *) chn->data + structoff, &data, sizeof(data));
+	if (chn->binary)
 		return 0;
-	}
 	return blkid_probe_sprintf_value(pr, name, "%lu", data);
 }
 
@@ -239,10 +445,10 @@ static int topology_set_value64(blkid_probe pr, const char *name,
 	if (!data)
 		return 0;	/* ignore zeros */
 
-	if (chn->binary) {
+	if (chn->data)
 		memcpy((char *) chn->data + structoff, &data, sizeof(data));
+	if (chn->binary)
 		return 0;
-	}
 	return blkid_probe_sprintf_value(pr, name, "%"PRIu64, data);
 }
 
@@ -0,0 +1,279 @@
+/*
+ * uevent.c - revalidate cache entries on kernel uevents
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * Long-running processes (daemons) usually keep a cache handler for a long
+ * time. The devices in the cache are re-probed by blkid_verify() when the
+ * BLKID_PROBE_MIN timeout is over, and all the devices are re-probed by
+ * blkid_probe_all() after BLKID_PROBE_INTERVAL.
+ *
+ * If the uevent monitoring is enabled, then the cache listens on kernel
+ * NETLINK_KOBJECT_UEVENT socket and only the devices announced by the kernel
+ * (add, change, remove, ...) are re-probed. The verified devices are trusted
+ * until a uevent for the device is received.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#ifdef HAVE_LINUX_NETLINK_H
+# include <sys/socket.h>
+# include <linux/netlink.h>
+#endif
+
+#include "blkidP.h"
+#include "strutils.h"
+
+#ifdef HAVE_LINUX_NETLINK_H
+/*
+ * Mark the device as dirty, the next blkid_verify() probes the device.
+ */
+static void mark_dirty_devno(blkid_cache cache, dev_t devno)
+{
+	struct list_head *p;
+	int found = 0;
+
+	blkid_bincache_load(cache);
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+
+		if (devno && dev->bid_devno != devno)
+			continue;
+		DBG(CACHE, ul_debugobj(cache, "uevent: %s dirty", dev->bid_name));
+		dev->bid_flags &= ~BLKID_BID_FL_VERIFIED;
+		dev->bid_flags |= BLKID_BID_FL_DIRTY;
+		found = 1;
+	}
+
+	/* the device geometry could be changed too */
+	blkid_topology_reset_cache(devno);
+
+	/* a new device or a device which has not been cached yet */
+	if (!found || !devno)
+		cache->bic_flags |= BLKID_BIC_FL_NEWDEVS;
+}
+
+/*
+ * The kernel message is "<action>@<devpath>\0" followed by "KEY=value\0"
+ * pairs. Returns 1 if the message is about a block device.
+ */
+static int parse_uevent(const char *buf, size_t sz, dev_t *devno)
+{
+	const char *p = buf, *end = buf + sz;
+	uint32_t maj = 0, min = 0;
+	int block = 0, have_maj = 0, have_min = 0;
+
+	if (!memchr(buf, '@', strnlen(buf, sz)))
+		return 0;	/* not kernel message */
+
+	for (p += strnlen(p, end - p) + 1; p < end; p += strnlen(p, end - p) + 1) {
+		if (strcmp(p, "SUBSYSTEM=block") == 0)
+			block = 1;
+		else if (strncmp(p, "MAJOR=", 6) == 0)
+			have_maj = ul_strtou32(p + 6, &maj, 10) == 0;
+		else if (strncmp(p, "MINOR=", 6) == 0)
+			have_min = ul_strtou32(p + 6, &min, 10) == 0;
+	}
+
+	if (!block || !have_maj || !have_min)
+		return 0;
+	*devno = makedev(maj, min);
+	return 1;
+}
+#endif /* HAVE_LINUX_NETLINK_H */
+
+/**
+ * blkid_cache_enable_uevents:
+ * @cache: cache handler
+ * @enable: 1 to enable, 0 to disable
+ *
+ * Enables kernel uevent monitoring for @cache. If enabled, only the devices
+ * announced by the kernel are re-probed and the already verified devices are
+ * not re-read after the usual timeouts. The events are read by
+ * blkid_cache_process_uevents(), which is also called by the library before
+ * the cache is used.
+ *
+ * Returns: 0 on success, or number less than zero in case of error.
+ *
+ * Since: 2.41
+ */
+int blkid_cache_enable_uevents(blkid_cache cache, int enable)
+{
+#ifdef HAVE_LINUX_NETLINK_H
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = 1		/* kernel events */
+	};
+	int fd;
+
+	if (!cache)
+		return -EINVAL;
+
+	if (!enable) {
+		if (cache->bic_uevent_fd >= 0) {
+			DBG(CACHE, ul_debugobj(cache, "uevent: disable"));
+			close(cache->bic_uevent_fd);
+		}
+		cache->bic_uevent_fd = -1;
+		return 0;
+	}
+	if (cache->bic_uevent_fd >= 0)
+		return 0;
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+			NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		return -errno;
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		int rc = -errno;
+
+		close(fd);
+		return rc;
+	}
+
+	DBG(CACHE, ul_debugobj(cache, "uevent: enabled [fd=%d]", fd));
+	cache->bic_uevent_fd = fd;
+
+	/* the devices could be changed before the monitor has been enabled */
+	mark_dirty_devno(cache, 0);
+	return 0;
+#else
+	if (!cache)
+		return -EINVAL;
+	return enable ? -ENOSYS : 0;
+#endif
+}
+
+/**
+ * blkid_cache_get_uevent_fd:
+ * @cache: cache handler
+ *
+ * The file descriptor is usable for poll() in the application event loop;
+ * call blkid_cache_process_uevents() when the descriptor is readable.
+ *
+ * Returns: uevent monitor file descriptor or -1 if monitoring is not enabled.
+ *
+ * Since: 2.41
+ */
+int blkid_cache_get_uevent_fd(blkid_cache cache)
+{
+	return cache ? cache->bic_uevent_fd : -1;
+}
+
+/**
+ * blkid_cache_process_uevents:
+ * @cache: cache handler
+ *
+ * Reads all pending kernel uevents (does not wait) and marks the affected
+ * cached devices to be re-probed.
+ *
+ * Returns: number of block device events, or number less than zero in case
+ * of error.
+ *
+ * Since: 2.41
+ */
+int blkid_cache_process_uevents(blkid_cache cache)
+{
+#ifdef HAVE_LINUX_NETLINK_H
+	char buf[8192];
+	int count = 0;
+
+	if (!cache || cache->bic_uevent_fd < 0)
+		return -EINVAL;
+
+	do {
+		struct sockaddr_nl addr = { .nl_family = AF_NETLINK };
+		struct iovec iov = { .iov_base = buf, .iov_len = sizeof(buf) };
+		struct msghdr msg = {
+			.msg_name = &addr,
+			.msg_namelen = sizeof(addr),
+			.msg_iov = &iov,
+			.msg_iovlen = 1
+		};
+		ssize_t sz;
+		dev_t devno = 0;
+
+		sz = recvmsg(cache->bic_uevent_fd, &msg, 0);
+		if (sz < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (errno == ENOBUFS) {
+				/* lost events, don't trust anything */
+				DBG(CACHE, ul_debugobj(cache, "uevent: overrun"));
+				mark_dirty_devno(cache, 0);
+				count++;
+				continue;
+			}
+			return -errno;
+		}
+
+		/* accept kernel messages only */
+		if (addr.nl_pid != 0 || (msg.msg_flags & MSG_TRUNC))
+			continue;
+		if (!parse_uevent(buf, sz, &devno))
+			continue;
+
+		DBG(CACHE, ul_debugobj(cache, "uevent: %s", buf));
+		mark_dirty_devno(cache, devno);
+		count++;
+	} while (1);
+
+	return count;
+#else
+	(void) cache;
+	return -ENOSYS;
+#endif
+}
+
+#ifdef TEST_PROGRAM
+int main(int argc, char **argv)
+{
+	blkid_cache cache = NULL;
+	int rc;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <cachefile>\n"
+			"Print devices changed by uevents\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	blkid_init_debug(0);
+
+	if (blkid_get_cache(&cache, argv[1]) != 0)
+		return EXIT_FAILURE;
+	if ((rc = blkid_cache_enable_uevents(cache, 1)) != 0) {
+		fprintf(stderr, "%s: failed to enable uevents: %s\n",
+				argv[0], strerror(-rc));
+		return EXIT_FAILURE;
+	}
+
+	rc = 1;
+	do {
+		struct list_head *p, *pnext;
+
+		if (rc > 0) {
+			blkid_probe_all(cache);
+			list_for_each_safe(p, pnext, &cache->bic_devs) {
+				blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+
+				dev = blkid_verify(cache, dev);
+				if (dev)
+					printf("%s: TYPE=%s\n", dev->bid_name,
+						dev->bid_type ? dev->bid_type : "");
+			}
+			fflush(stdout);
+		}
+		sleep(1);
+	} while ((rc = blkid_cache_process_uevents(cache)) >= 0);
+
+	blkid_put_cache(cache);
+	return EXIT_SUCCESS;
+}
+#endif
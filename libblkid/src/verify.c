@@ -49,6 +49,118 @@ static void blkid_probe_to_tags(blkid_probe pr, blkid_dev dev)
 	}
 }
 
+/*
+ * Probe the already opened device @fd and add the result to @dev as tags.
+ * The @dev does not have to be linked to the cache.
+ *
+ * Returns: 0 on success, 1 if nothing found, negative number on error.
+ */
+int blkid_probe_dev_tags(blkid_probe pr, int fd, blkid_dev dev)
+{
+	int rc;
+
+	if (blkid_probe_set_device(pr, fd, 0, 0))
+		return -1;	/* failed to read the device */
+
+	/* enable superblocks probing */
+	blkid_probe_enable_superblocks(pr, TRUE);
+	blkid_probe_set_superblocks_flags(pr,
+		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
+
+	/* enable partitions probing */
+	blkid_probe_enable_partitions(pr, TRUE);
+	blkid_probe_set_partitions_flags(pr, BLKID_PARTS_ENTRY_DETAILS);
+
+	/* probe */
+	rc = blkid_do_safeprobe(pr);
+	if (rc == 0)
+		blkid_probe_to_tags(pr, dev);
+
+	/* reset prober */
+	blkid_probe_reset_superblocks_filter(pr);
+	blkid_probe_set_device(pr, -1, 0, 0);
+
+	return rc;
+}
+
+static void remove_dev_tags(blkid_dev dev)
+{
+	blkid_tag_iterate iter;
+	const char *type, *value;
+
+	iter = blkid_tag_iterate_begin(dev);
+	while (blkid_tag_next(iter, &type, &value) == 0)
+		blkid_set_tag(dev, type, NULL, 0);
+	blkid_tag_iterate_end(iter);
+}
+
+/*
+ * Returns result for @devno from blkid_probe_all_parallel() or NULL. The
+ * devices are verified in the same order as they have been probed, so
+ * start the search from the last used item.
+ */
+static struct blkid_prepared *get_prepared(blkid_cache cache, dev_t devno)
+{
+	size_t i;
+
+	for (i = 0; i < cache->nprepared; i++) {
+		size_t n = (cache->prepared_hint + i) % cache->nprepared;
+		struct blkid_prepared *prep = &cache->prepared[n];
+
+		if (prep->done && prep->devno == devno) {
+			cache->prepared_hint = n;
+			return prep;
+		}
+	}
+	return NULL;
+}
+
+static void set_verified(blkid_cache cache, blkid_dev dev, dev_t devno)
+{
+	dev->bid_devno = devno;
+	dev->bid_flags &= ~BLKID_BID_FL_DIRTY;
+	dev->bid_flags |= BLKID_BID_FL_VERIFIED;
+	cache->bic_flags |= BLKID_BIC_FL_CHANGED;
+
+	DBG(PROBE, ul_debug("%s: devno 0x%04llx, type %s",
+		   dev->bid_name, (long long)devno, dev->bid_type));
+}
+
+/*
+ * Use result probed in advance by a worker thread.
+ */
+static blkid_dev verify_prepared(blkid_cache cache, blkid_dev dev,
+				 struct blkid_prepared *prep)
+{
+	blkid_tag_iterate iter;
+	const char *type, *value;
+
+	DBG(PROBE, ul_debug("%s: using prepared result", dev->bid_name));
+
+	prep->done = 0;
+	remove_dev_tags(dev);
+
+	if (prep->rc) {
+		/* found nothing or error */
+		blkid_free_dev(dev);
+		dev = NULL;
+	} else {
+		iter = blkid_tag_iterate_begin(prep->dev);
+		while (blkid_tag_next(iter, &type, &value) == 0)
+			blkid_set_tag(dev, type, value, strlen(value));
+		blkid_tag_iterate_end(iter);
+
+		dev->bid_time = prep->time;
+		dev->bid_utime = prep->utime;
+		set_verified(cache, dev, prep->devno);
+	}
+
+	blkid_free_dev(prep->dev);
+	prep->dev = NULL;
+	return dev;
+}
+
 /*
  * Verify that the data in dev is consistent with what is on the actual
  * block device (using the devname field only).  Normally this will be
@@ -60,8 +172,6 @@ static void blkid_probe_to_tags(blkid_probe pr, blkid_dev dev)
  */
 blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 {
-	blkid_tag_iterate iter;
-	const char *type, *value;
 	struct stat st;
 	time_t diff, now;
 	int fd;
@@ -69,6 +179,13 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 	if (!dev || !cache)
 		return NULL;
 
+	/* with uevent monitor the device is valid until the kernel says otherwise */
+	if (cache->bic_uevent_fd >= 0) {
+		blkid_cache_process_uevents(cache);
+		if (dev->bid_flags & BLKID_BID_FL_VERIFIED)
+			return dev;
+	}
+
 	now = time(NULL);
 	diff = (uintmax_t)now - dev->bid_time;
 
@@ -87,7 +204,8 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		return NULL;
 	}
 
-	if (now >= dev->bid_time &&
+	if (!(dev->bid_flags & BLKID_BID_FL_DIRTY) &&
+	    now >= dev->bid_time &&
 #ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
 	    (st.st_mtime < dev->bid_time ||
 	        (st.st_mtime == dev->bid_time &&
@@ -118,6 +236,12 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		blkid_free_dev(dev);
 		return NULL;
 	}
+	if (cache->nprepared) {
+		struct blkid_prepared *prep = get_prepared(cache, st.st_rdev);
+
+		if (prep)
+			return verify_prepared(cache, dev, prep);
+	}
 	if (!cache->probe) {
 		cache->probe = blkid_new_probe();
 		if (!cache->probe) {
@@ -134,32 +258,11 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		goto open_err;
 	}
 
-	if (blkid_probe_set_device(cache->probe, fd, 0, 0)) {
-		/* failed to read the device */
-		close(fd);
-		blkid_free_dev(dev);
-		return NULL;
-	}
-
 	/* remove old cache info */
-	iter = blkid_tag_iterate_begin(dev);
-	while (blkid_tag_next(iter, &type, &value) == 0)
-		blkid_set_tag(dev, type, NULL, 0);
-	blkid_tag_iterate_end(iter);
+	remove_dev_tags(dev);
 
-	/* enable superblocks probing */
-	blkid_probe_enable_superblocks(cache->probe, TRUE);
-	blkid_probe_set_superblocks_flags(cache->probe,
-		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
-		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
-
-	/* enable partitions probing */
-	blkid_probe_enable_partitions(cache->probe, TRUE);
-	blkid_probe_set_partitions_flags(cache->probe, BLKID_PARTS_ENTRY_DETAILS);
-
-	/* probe */
-	if (blkid_do_safeprobe(cache->probe)) {
-		/* found nothing or error */
+	if (blkid_probe_dev_tags(cache->probe, fd, dev)) {
+		/* failed to read the device, found nothing or error */
 		blkid_free_dev(dev);
 		dev = NULL;
 	}
@@ -174,21 +277,10 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 #endif
 			dev->bid_time = time(NULL);
 
-		dev->bid_devno = st.st_rdev;
-		dev->bid_flags |= BLKID_BID_FL_VERIFIED;
-		cache->bic_flags |= BLKID_BIC_FL_CHANGED;
-
-		blkid_probe_to_tags(cache->probe, dev);
-
-		DBG(PROBE, ul_debug("%s: devno 0x%04llx, type %s",
-			   dev->bid_name, (long long)st.st_rdev, dev->bid_type));
+		set_verified(cache, dev, st.st_rdev);
 	}
 
-	/* reset prober */
-	blkid_probe_reset_superblocks_filter(cache->probe);
-	blkid_probe_set_device(cache->probe, -1, 0, 0);
 	close(fd);
-
 	return dev;
 }
 
@@ -1,6 +1,7 @@
 #ifdef HAVE_LIBBLKID
 # include <blkid.h>
 #endif
+#include <sys/mman.h>
 
 #include "blkdev.h"
 #ifdef __linux__
@@ -91,6 +92,8 @@ static int init_nested_from_parent(struct fdisk_context *cxt, int isnew)
 	cxt->ask_cb =		parent->ask_cb;
 	cxt->ask_data =		parent->ask_data;
 	cxt->dev_fd =		parent->dev_fd;
+	cxt->dev_map =		parent->dev_map;
+	cxt->dev_mapsz =	parent->dev_mapsz;
 	cxt->first_lba =        parent->first_lba;
 	cxt->firstsector_bufsz = parent->firstsector_bufsz;
 	cxt->firstsector =	parent->firstsector;
@@ -518,6 +521,38 @@ struct fdisk_context *fdisk_get_parent(struct fdisk_context *cxt)
 	return cxt->parent;
 }
 
+/* the mapping is always owned by the primary context */
+static void unmap_device(struct fdisk_context *cxt)
+{
+	if (cxt->dev_map && !cxt->parent) {
+		DBG(CXT, ul_debugobj(cxt, "  unmapping device"));
+		munmap(cxt->dev_map, cxt->dev_mapsz);
+	}
+	cxt->dev_map = NULL;
+	cxt->dev_mapsz = 0;
+}
+
+static void map_device(struct fdisk_context *cxt)
+{
+	void *map;
+
+	if (!cxt->use_mmap || !cxt->readonly
+	    || !S_ISREG(cxt->dev_st.st_mode)
+	    || cxt->dev_st.st_size <= 0
+	    || (uintmax_t) cxt->dev_st.st_size > SIZE_MAX)
+		return;
+
+	map = mmap(NULL, cxt->dev_st.st_size, PROT_READ, MAP_SHARED, cxt->dev_fd, 0);
+	if (map == MAP_FAILED) {
+		DBG(CXT, ul_debugobj(cxt, "mmap failed, using read(): %m"));
+		return;
+	}
+
+	cxt->dev_map = map;
+	cxt->dev_mapsz = cxt->dev_st.st_size;
+	DBG(CXT, ul_debugobj(cxt, "mapped %zu bytes", cxt->dev_mapsz));
+}
+
 static void reset_context(struct fdisk_context *cxt)
 {
 	size_t i;
@@ -536,6 +571,7 @@ static void reset_context(struct fdisk_context *cxt)
 		}
 	} else {
 		/* we close device only in primary context */
+		unmap_device(cxt);
 		if (cxt->dev_fd > -1 && cxt->is_priv)
 			close(cxt->dev_fd);
 		DBG(CXT, ul_debugobj(cxt, "  freeing firstsector"));
@@ -555,6 +591,8 @@ static void reset_context(struct fdisk_context *cxt)
 	memset(&cxt->dev_st, 0, sizeof(cxt->dev_st));
 
 	cxt->dev_fd = -1;
+	cxt->dev_map = NULL;
+	cxt->dev_mapsz = 0;
 	cxt->is_priv = 0;
 	cxt->is_excl = 0;
 	cxt->firstsector = NULL;
@@ -568,6 +606,7 @@ static void reset_context(struct fdisk_context *cxt)
 	cxt->label = NULL;
 
 	fdisk_free_wipe_areas(cxt);
+	fdisk_reset_freespaces(cxt);
 }
 
 /* fdisk_assign_device() body */
@@ -613,6 +652,8 @@ static int fdisk_assign_fd(struct fdisk_context *cxt, int fd,
 	if (!cxt->dev_path)
 		goto fail;
 
+	map_device(cxt);
+
 	fdisk_discover_topology(cxt);
 	fdisk_discover_geometry(cxt);
 
@@ -646,6 +687,7 @@ static int fdisk_assign_fd(struct fdisk_context *cxt, int fd,
 fail:
 	{
 		int rc = errno ? -errno : -EINVAL;
+		unmap_device(cxt);
 		cxt->dev_fd = -1;
 		DBG(CXT, ul_debugobj(cxt, "failed to assign device [rc=%d]", rc));
 		return rc;
@@ -760,6 +802,8 @@ int fdisk_deassign_device(struct fdisk_context *cxt, int nosync)
 
 	DBG(CXT, ul_debugobj(cxt, "de-assigning device %s", cxt->dev_path));
 
+	unmap_device(cxt);
+
 	if (cxt->readonly && cxt->is_priv)
 		close(cxt->dev_fd);
 	else {
@@ -886,6 +930,41 @@ static inline int add_to_partitions_array(
 	(*n)++;
 	return 0;
 }
+
+/* partition size in 512-byte sectors as used by kernel */
+static uint64_t kernel_partition_size(struct fdisk_context *cxt,
+				      struct fdisk_partition *pa,
+				      unsigned int ssf)
+{
+	uint64_t sz = pa->size * ssf;
+
+	if (fdisk_is_label(cxt, DOS) && fdisk_partition_is_container(pa))
+		/* Let's follow the Linux kernel and reduce
+		 * DOS extended partition to 1 or 2 sectors.
+		 */
+		sz = min(sz, (uint64_t) 2);
+	return sz;
+}
+
+/*
+ * Compares the new partition @pa with the partition as known by kernel and
+ * returns FDISK_DIFF_* change necessary to update the kernel.
+ */
+static int kernel_partition_change(struct fdisk_context *cxt,
+				   struct sysfs_blkdev_part *kparts, size_t nkparts,
+				   struct fdisk_partition *pa, unsigned int ssf)
+{
+	struct sysfs_blkdev_part *kp;
+
+	kp = sysfs_blkdev_find_partition(kparts, nkparts, pa->partno + 1);
+	if (!kp)
+		return FDISK_DIFF_ADDED;
+	if (kp->start != pa->start * ssf)
+		return FDISK_DIFF_MOVED;
+	if (kp->size != kernel_partition_size(cxt, pa, ssf))
+		return FDISK_DIFF_RESIZED;
+	return FDISK_DIFF_UNCHANGED;
+}
 #endif
 
 /**
@@ -897,6 +976,10 @@ static inline int add_to_partitions_array(
  * partition table. The BLKPG_* ioctls are used for individual partitions. The
  * advantage is that unmodified partitions maybe mounted.
  *
+ * The changed partitions are compared with the partitions as known by
+ * kernel (from /sys) and the ioctls are called only when necessary, every
+ * ioctl means uevents and udev work.
+ *
  * The function behaves like fdisk_reread_partition_table() on systems where
  * are no available BLKPG_* ioctls.
  *
@@ -909,8 +992,9 @@ int fdisk_reread_changes(struct fdisk_context *cxt, struct fdisk_table *org)
 	struct fdisk_iter itr;
 	struct fdisk_partition *pa;
 	struct fdisk_partition **rem = NULL, **add = NULL, **upd = NULL;
-	int change, rc = 0, err = 0;
-	size_t nparts, i, nadds = 0, nupds = 0, nrems = 0;
+	struct sysfs_blkdev_part *kparts = NULL;
+	int change, rc = 0, err = 0, known = 0;
+	size_t nparts, i, nadds = 0, nupds = 0, nrems = 0, nkparts = 0;
 	unsigned int ssf;
 
 	DBG(CXT, ul_debugobj(cxt, "rereading changes"));
@@ -922,9 +1006,33 @@ int fdisk_reread_changes(struct fdisk_context *cxt, struct fdisk_table *org)
 	/* maximal number of partitions */
 	nparts = max(fdisk_table_get_nents(tb), fdisk_table_get_nents(org));
 
+	/* sector size factor -- used to recount from real to 512-byte sectors */
+	ssf = cxt->sector_size / 512;
+
+	/* the layout used by kernel */
+	if (fdisk_get_devno(cxt)) {
+		struct path_cxt *pc = ul_new_sysfs_path(fdisk_get_devno(cxt), NULL, NULL);
+
+		if (pc) {
+			int n = sysfs_blkdev_get_partitions(pc, &kparts);
+			if (n >= 0) {
+				nkparts = n;
+				known = 1;
+			}
+			ul_unref_path(pc);
+		}
+	}
+
 	while (fdisk_diff_tables(org, tb, &itr, &pa, &change) == 0) {
 		if (change == FDISK_DIFF_UNCHANGED)
 			continue;
+		if (known) {
+			if (change == FDISK_DIFF_REMOVED) {
+				if (!sysfs_blkdev_find_partition(kparts, nkparts, pa->partno + 1))
+					continue;	/* already not used by kernel */
+			} else
+				change = kernel_partition_change(cxt, kparts, nkparts, pa, ssf);
+		}
 		switch (change) {
 		case FDISK_DIFF_REMOVED:
 			rc = add_to_partitions_array(&rem, pa, &nrems, nparts);
@@ -945,8 +1053,8 @@ int fdisk_reread_changes(struct fdisk_context *cxt, struct fdisk_table *org)
 			goto done;
 	}
 
-	/* sector size factor -- used to recount from real to 512-byte sectors */
-	ssf = cxt->sector_size / 512;
+	DBG(CXT, ul_debugobj(cxt, " remove %zu, resize %zu, add %zu partitions",
+				nrems, nupds, nadds));
 
 	for (i = 0; i < nrems; i++) {
 		pa = rem[i];
@@ -960,27 +1068,19 @@ int fdisk_reread_changes(struct fdisk_context *cxt, struct fdisk_table *org)
 		pa = upd[i];
 		DBG(PART, ul_debugobj(pa, "#%zu calling BLKPG_RESIZE_PARTITION", pa->partno));
 		if (partx_resize_partition(cxt->dev_fd, pa->partno + 1,
-					   pa->start * ssf, pa->size * ssf) != 0) {
+					   pa->start * ssf,
+					   kernel_partition_size(cxt, pa, ssf)) != 0) {
 			fdisk_warn(cxt, _("Failed to update system information about partition %zu"), pa->partno + 1);
 			err++;
 		}
 	}
 	for (i = 0; i < nadds; i++) {
-		uint64_t sz;
-
 		pa = add[i];
-		sz = pa->size * ssf;
 
 		DBG(PART, ul_debugobj(pa, "#%zu calling BLKPG_ADD_PARTITION", pa->partno));
 
-		if (fdisk_is_label(cxt, DOS) && fdisk_partition_is_container(pa))
-			/* Let's follow the Linux kernel and reduce
-                         * DOS extended partition to 1 or 2 sectors.
-			 */
-			sz = min(sz, (uint64_t) 2);
-
-		if (partx_add_partition(cxt->dev_fd, pa->partno + 1,
-					pa->start * ssf, sz) != 0) {
+		if (partx_add_partition(cxt->dev_fd, pa->partno + 1, pa->start * ssf,
+					kernel_partition_size(cxt, pa, ssf)) != 0) {
 			fdisk_warn(cxt, _("Failed to add partition %zu to system"), pa->partno + 1);
 			err++;
 		}
@@ -993,6 +1093,7 @@ done:
 	free(rem);
 	free(add);
 	free(upd);
+	free(kparts);
 	fdisk_unref_table(tb);
 	return rc;
 }
@@ -1137,6 +1238,31 @@ int fdisk_enable_listonly(struct fdisk_context *cxt, int enable)
 	return 0;
 }
 
+/**
+ * fdisk_enable_mmap:
+ * @cxt: context
+ * @enable: true/false
+ *
+ * Map regular files assigned in read-only mode to memory and read the
+ * partition table from the mapping rather than by read(). It's cheaper if
+ * many disk images are scanned. The setting has effect on the next
+ * fdisk_assign_device() call.
+ *
+ * Note that the process may be killed by SIGBUS if the file is truncated
+ * by another process while mapped.
+ *
+ * Since: 2.41
+ *
+ * Returns: 0 on success, < 0 on error.
+ */
+int fdisk_enable_mmap(struct fdisk_context *cxt, int enable)
+{
+	if (!cxt)
+		return -EINVAL;
+	cxt->use_mmap = enable ? 1 : 0;
+	return 0;
+}
+
 /**
  * fdisk_is_listonly:
  * @cxt: context
@@ -234,18 +234,8 @@ static int seek_sector(struct fdisk_context *cxt, fdisk_sector_t secno)
 static int read_sector(struct fdisk_context *cxt, fdisk_sector_t secno,
 			unsigned char *buf)
 {
-	int rc = seek_sector(cxt, secno);
-	ssize_t r;
-
-	if (rc < 0)
-		return rc;
-
-	r = read(cxt->dev_fd, buf, cxt->sector_size);
-	if (r == (ssize_t) cxt->sector_size)
-		return 0;
-	if (r < 0)
-		return -errno;
-	return -1;
+	return fdisk_read_device(cxt, buf,
+			(uintmax_t) secno * cxt->sector_size, cxt->sector_size);
 }
 
 /* Allocate a buffer and read a partition table sector */
@@ -520,8 +510,39 @@ static int dos_delete_partition(struct fdisk_context *cxt, size_t partnum)
 	return delete_partition(cxt, partnum);
 }
 
+/*
+ * The EBRs are usually written in the same distance (gap between logical
+ * partition + the partition size), so ask for the next few EBRs in advance
+ * to avoid waiting for the device for every EBR. It's only a guess, the
+ * chain is still followed by the links in the EBRs.
+ */
+#define DOS_EBR_PREFETCH	8
+
+static void prefetch_ebrs(struct fdisk_context *cxt,
+			  fdisk_sector_t cur, fdisk_sector_t next,
+			  fdisk_sector_t *prefetched)
+{
+	fdisk_sector_t stride, x;
+	size_t i;
+
+	if (next <= cur)
+		return;
+	stride = next - cur;
+
+	for (i = 1, x = next + stride; i <= DOS_EBR_PREFETCH; i++, x += stride) {
+		if (x > cxt->total_sectors - 1)
+			break;
+		if (x <= *prefetched)
+			continue;
+		fdisk_prefetch_device(cxt, (uintmax_t) x * cxt->sector_size,
+				      cxt->sector_size);
+		*prefetched = x;
+	}
+}
+
 static void read_extended(struct fdisk_context *cxt, size_t ext)
 {
+	fdisk_sector_t prefetched = 0;
 	size_t i;
 	struct pte *pex, *pe;
 	struct dos_partition *p, *q;
@@ -617,6 +638,11 @@ static void read_extended(struct fdisk_context *cxt, size_t ext)
 		p = pe->ex_entry;
 		cxt->label->nparts_cur = ++cxt->label->nparts_max;
 
+		if (IS_EXTENDED(p->sys_ind))
+			prefetch_ebrs(cxt, pe->offset,
+				l->ext_offset + dos_partition_get_start(p),
+				&prefetched);
+
 		DBG(LABEL, ul_debug("DOS: EBR[offset=%ju]: link: type=%x,  start=%u, size=%u; "
 				                         " data: type=%x, start=%u, size=%u",
 				    (uintmax_t) pe->offset,
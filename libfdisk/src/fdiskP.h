@@ -256,6 +256,9 @@ struct fdisk_label_operations {
 	/* refresh alignment setting */
 	int (*reset_alignment)(struct fdisk_context *cxt);
 
+	/* finish work postponed while fdisk_label->batch is set */
+	int (*end_batch)(struct fdisk_context *cxt);
+
 	/* free in-memory label stuff */
 	void (*free)(struct fdisk_label *lb);
 
@@ -301,7 +304,9 @@ struct fdisk_label {
 	struct fdisk_geometry	geom_max;	/* maximal geometry */
 
 	unsigned int		changed:1,	/* label has been modified */
-				disabled:1;	/* this driver is disabled at all */
+				disabled:1,	/* this driver is disabled at all */
+				batch:1;	/* more changes follow, see end_batch() */
+	unsigned long		generation;	/* incremented on every change */
 
 	const struct fdisk_field *fields;	/* all possible fields */
 	size_t			nfields;
@@ -377,6 +382,26 @@ struct fdisk_ask {
 	} data;
 };
 
+/* free area, see fdisk_get_freespaces() */
+struct fdisk_freespace {
+	fdisk_sector_t	start;
+	fdisk_sector_t	size;
+	size_t		parent_partno;	/* container or undefined */
+	unsigned int	tail : 1;	/* behind the last partition */
+};
+
+/* the free areas are valid for this label and alignment setting */
+struct fdisk_freespaces_key {
+	struct fdisk_label	*label;
+	unsigned long		generation;	/* see label->generation */
+	unsigned long		grain;
+	unsigned long		sector_size;
+	unsigned long		phy_sector_size;
+	unsigned long		alignment_offset;
+	fdisk_sector_t		first_lba;
+	fdisk_sector_t		last_lba;
+};
+
 struct fdisk_context {
 	int dev_fd;         /* device descriptor */
 	char *dev_path;     /* device path */
@@ -388,6 +413,9 @@ struct fdisk_context {
 	unsigned char *firstsector; /* buffer with master boot record */
 	unsigned long firstsector_bufsz;
 
+	unsigned char *dev_map;	/* read-only mapping, see fdisk_enable_mmap() */
+	size_t dev_mapsz;
+
 
 	/* topology */
 	unsigned long io_size;		/* I/O size used by fdisk */
@@ -406,6 +434,7 @@ struct fdisk_context {
 		     dev_model_probed : 1,	/* tried to read from sys */
 		     is_priv : 1,		/* open by libfdisk */
 		     is_excl : 1,		/* open with O_EXCL */
+		     use_mmap : 1,		/* map read-only regular files */
 		     listonly : 1;		/* list partition, nothing else */
 
 	char *collision;			/* name of already existing FS/PT */
@@ -439,6 +468,11 @@ struct fdisk_context {
 
 	struct fdisk_context	*parent;	/* for nested PT */
 	struct fdisk_script	*script;	/* what we want to follow */
+
+	struct fdisk_freespace	*freespaces;	/* cached free areas sorted by start */
+	size_t			nfreespaces;
+	size_t			freespaces_max;	/* allocated items */
+	struct fdisk_freespaces_key freespaces_key;
 };
 
 /* table */
@@ -453,6 +487,7 @@ extern int fdisk_diff_tables(struct fdisk_table *a, struct fdisk_table *b,
 				struct fdisk_iter *itr,
 				struct fdisk_partition **res, int *change);
 extern void fdisk_debug_print_table(struct fdisk_table *tb);
+extern void fdisk_reset_freespaces(struct fdisk_context *cxt);
 
 
 /* context.c */
@@ -476,6 +511,10 @@ extern void fdisk_zeroize_device_properties(struct fdisk_context *cxt);
 extern int fdisk_init_firstsector_buffer(struct fdisk_context *cxt,
 			unsigned int protect_off, unsigned int protect_size);
 extern int fdisk_read_firstsector(struct fdisk_context *cxt);
+extern int fdisk_read_device(struct fdisk_context *cxt, void *buf,
+			     uintmax_t start, size_t size);
+extern void fdisk_prefetch_device(struct fdisk_context *cxt,
+			     uintmax_t start, size_t size);
 
 /* label.c */
 extern int fdisk_probe_labels(struct fdisk_context *cxt);
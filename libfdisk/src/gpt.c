@@ -186,8 +186,21 @@ struct fdisk_gpt_label {
 
 	unsigned char *ents;			/* entries (partitions) */
 
+	/* used areas, sorted and merged; maintained during batch only */
+	struct gpt_extent {
+		uint64_t start;
+		uint64_t end;
+	} *extents;
+	size_t nextents;
+
+	uint32_t *ents_crc;			/* CRC of each entry, or NULL */
+	unsigned char *ents_dirty;		/* bitmap of changed entries */
+
 	unsigned int no_relocate :1,		/* do not fix backup location */
-		     minimize :1;
+		     minimize :1,
+		     has_extents :1,
+		     write_all :1,		/* write all entries, not only changed */
+		     backup_moved :1;		/* backup array is not on the device yet */
 };
 
 static void gpt_deinit(struct fdisk_label *lb);
@@ -512,6 +525,14 @@ static int gpt_mknew_pmbr(struct fdisk_context *cxt)
 }
 
 
+/* the whole entries array has to be written, see gpt_write_partitions() */
+static void gpt_set_write_all(struct fdisk_gpt_label *gpt)
+{
+	free(gpt->ents_dirty);
+	gpt->ents_dirty = NULL;
+	gpt->write_all = 1;
+}
+
 /* Move backup header to the end of the device */
 static int gpt_fix_alternative_lba(struct fdisk_context *cxt, struct fdisk_gpt_label *gpt)
 {
@@ -543,6 +564,10 @@ static int gpt_fix_alternative_lba(struct fdisk_context *cxt, struct fdisk_gpt_l
 
 	b->partition_entry_lba = cpu_to_le64(x);
 
+	/* the entries are unchanged, only the backup array has to be written
+	 * to the new place; see gpt_write_backup() */
+	gpt->backup_moved = 1;
+
 	/* update last usable LBA */
 	rc = gpt_calculate_last_lba(p, nents, &x, cxt);
 	if (rc)
@@ -997,9 +1022,7 @@ static ssize_t read_lba(struct fdisk_context *cxt, uint64_t lba,
 {
 	off_t offset = lba * cxt->sector_size;
 
-	if (lseek(cxt->dev_fd, offset, SEEK_SET) == (off_t) -1)
-		return -1;
-	return (size_t)read(cxt->dev_fd, buffer, bytes) != bytes;
+	return fdisk_read_device(cxt, buffer, offset, bytes) != 0;
 }
 
 
@@ -1008,7 +1031,6 @@ static unsigned char *gpt_read_entries(struct fdisk_context *cxt,
 					 struct gpt_header *header)
 {
 	size_t sz = 0;
-	ssize_t ssz;
 
 	unsigned char *ret = NULL;
 	off_t offset;
@@ -1026,11 +1048,7 @@ static unsigned char *gpt_read_entries(struct fdisk_context *cxt,
 	offset = (off_t) le64_to_cpu(header->partition_entry_lba) *
 		       cxt->sector_size;
 
-	if (offset != lseek(cxt->dev_fd, offset, SEEK_SET))
-		goto fail;
-
-	ssz = read(cxt->dev_fd, ret, sz);
-	if (ssz < 0 || (size_t) ssz != sz)
+	if (fdisk_read_device(cxt, ret, offset, sz) != 0)
 		goto fail;
 
 	return ret;
@@ -1081,6 +1099,76 @@ static void gpt_recompute_crc(struct gpt_header *header, unsigned char *ents)
 	header->crc32 = cpu_to_le32( gpt_header_count_crc32(header) );
 }
 
+/*
+ * The CRC of the entries array is updated incrementally when only one entry
+ * is changed, see gpt_update_entry_crc(). The CRCs of the entries are
+ * cached for this purpose; the cache is dropped when the entries are
+ * changed in another way and it's created again on the next update.
+ */
+static void gpt_free_entries_crc(struct fdisk_gpt_label *gpt)
+{
+	free(gpt->ents_crc);
+	gpt->ents_crc = NULL;
+}
+
+/* recompute CRCs for both headers from all entries */
+static void gpt_recompute_crcs(struct fdisk_gpt_label *gpt)
+{
+	gpt_free_entries_crc(gpt);
+	gpt_recompute_crc(gpt->pheader, gpt->ents);
+	gpt_recompute_crc(gpt->bheader, gpt->ents);
+}
+
+static void gpt_mark_entry_dirty(struct fdisk_gpt_label *gpt, size_t i)
+{
+	if (gpt->write_all)
+		return;
+	if (!gpt->ents_dirty) {
+		gpt->ents_dirty = calloc(1, (gpt_get_nentries(gpt) + NBBY - 1) / NBBY);
+		if (!gpt->ents_dirty) {
+			gpt->write_all = 1;
+			return;
+		}
+	}
+	setbit(gpt->ents_dirty, i);
+}
+
+/* recompute CRCs for both headers after change of the entry @i */
+static void gpt_update_entry_crc(struct fdisk_gpt_label *gpt, size_t i)
+{
+	size_t n = gpt_get_nentries(gpt), arysz = 0;
+	size_t esz = le32_to_cpu(gpt->pheader->sizeof_partition_entry);
+	uint32_t crc, diff;
+
+	assert(i < n);
+
+	gpt_mark_entry_dirty(gpt, i);
+
+	if (!gpt->ents_crc || gpt_sizeof_entries(gpt->pheader, &arysz)) {
+		size_t x;
+
+		gpt_recompute_crcs(gpt);
+
+		gpt->ents_crc = malloc(n * sizeof(uint32_t));
+		if (!gpt->ents_crc)
+			return;
+		for (x = 0; x < n; x++)
+			gpt->ents_crc[x] = ul_crc32(0, gpt_get_entry_ptr(gpt, x), esz);
+		return;
+	}
+
+	crc = ul_crc32(0, gpt_get_entry_ptr(gpt, i), esz);
+	diff = ul_crc32_zeros(crc ^ gpt->ents_crc[i], arysz - (i + 1) * esz);
+	gpt->ents_crc[i] = crc;
+
+	gpt->pheader->partition_entry_array_crc32 ^= cpu_to_le32(diff);
+	gpt->pheader->crc32 = cpu_to_le32(gpt_header_count_crc32(gpt->pheader));
+	if (gpt->bheader) {
+		gpt->bheader->partition_entry_array_crc32 ^= cpu_to_le32(diff);
+		gpt->bheader->crc32 = cpu_to_le32(gpt_header_count_crc32(gpt->bheader));
+	}
+}
+
 /*
  * Compute the 32bit CRC checksum of the partition table header.
  * Returns 1 if it is valid, otherwise 0.
@@ -1450,6 +1538,109 @@ static uint32_t check_overlap_partitions(struct fdisk_gpt_label *gpt)
 	return 0;
 }
 
+/*
+ * The free space functions below scan all entries, and some of them
+ * repeatedly. That's fine for a single partition, but it makes a batch
+ * of added partitions quadratic. For the batch the used areas are kept
+ * sorted and merged (adjacent partitions are one extent), so the
+ * functions only search the extents.
+ */
+static int cmp_extents(const void *a, const void *b)
+{
+	return cmp_numbers(((const struct gpt_extent *) a)->start,
+			   ((const struct gpt_extent *) b)->start);
+}
+
+static void gpt_free_extents(struct fdisk_gpt_label *gpt)
+{
+	free(gpt->extents);
+	gpt->extents = NULL;
+	gpt->nextents = 0;
+	gpt->has_extents = 0;
+}
+
+static int gpt_init_extents(struct fdisk_gpt_label *gpt)
+{
+	size_t i, n = 0;
+
+	gpt_free_extents(gpt);
+
+	gpt->extents = calloc(gpt_get_nentries(gpt), sizeof(struct gpt_extent));
+	if (!gpt->extents)
+		return -ENOMEM;
+
+	for (i = 0; i < gpt_get_nentries(gpt); i++) {
+		struct gpt_entry *e = gpt_get_entry(gpt, i);
+
+		if (!gpt_entry_is_used(e) || gpt_partition_start(e) > gpt_partition_end(e))
+			continue;
+		gpt->extents[n].start = gpt_partition_start(e);
+		gpt->extents[n].end = gpt_partition_end(e);
+		n++;
+	}
+
+	qsort(gpt->extents, n, sizeof(struct gpt_extent), cmp_extents);
+
+	/* merge overlapping and adjacent areas */
+	for (i = 0; i < n; i++) {
+		struct gpt_extent *last = gpt->nextents ?
+				&gpt->extents[gpt->nextents - 1] : NULL;
+
+		if (last && gpt->extents[i].start <= last->end + 1) {
+			if (gpt->extents[i].end > last->end)
+				last->end = gpt->extents[i].end;
+		} else
+			gpt->extents[gpt->nextents++] = gpt->extents[i];
+	}
+
+	gpt->has_extents = 1;
+	DBG(GPT, ul_debug("initialized %zu used extents", gpt->nextents));
+	return 0;
+}
+
+/* returns index of the first extent which ends at or after @lba */
+static size_t gpt_find_extent(struct fdisk_gpt_label *gpt, uint64_t lba)
+{
+	size_t lo = 0, hi = gpt->nextents;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+
+		if (gpt->extents[mid].end < lba)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* add the (free) area <@start,@end> to the used extents */
+static void gpt_add_extent(struct fdisk_gpt_label *gpt, uint64_t start, uint64_t end)
+{
+	size_t i = gpt_find_extent(gpt, start);
+	struct gpt_extent *prev = i ? &gpt->extents[i - 1] : NULL,
+			  *next = i < gpt->nextents ? &gpt->extents[i] : NULL;
+
+	if (prev && prev->end + 1 == start) {
+		prev->end = end;
+		if (next && end + 1 == next->start) {
+			prev->end = next->end;
+			memmove(next, next + 1,
+				(gpt->nextents - i - 1) * sizeof(struct gpt_extent));
+			gpt->nextents--;
+		}
+	} else if (next && end + 1 == next->start) {
+		next->start = start;
+	} else {
+		/* the array is allocated for all entries */
+		memmove(&gpt->extents[i + 1], &gpt->extents[i],
+			(gpt->nextents - i) * sizeof(struct gpt_extent));
+		gpt->extents[i].start = start;
+		gpt->extents[i].end = end;
+		gpt->nextents++;
+	}
+}
+
 /*
  * Find the first available block after the starting point; returns 0 if
  * there are no available blocks left, or error. From gdisk.
@@ -1473,6 +1664,14 @@ static uint64_t find_first_available(struct fdisk_gpt_label *gpt, uint64_t start
 	 */
 	first = start < fu ? fu : start;
 
+	if (gpt->has_extents) {
+		size_t i = gpt_find_extent(gpt, first);
+
+		if (i < gpt->nextents && gpt->extents[i].start <= first)
+			first = gpt->extents[i].end + 1;
+		return first > lu ? 0 : first;
+	}
+
 	/*
 	 * Now search through all partitions; if first is within an
 	 * existing partition, move it to the next sector after that
@@ -1517,6 +1716,15 @@ static uint64_t find_last_free(struct fdisk_gpt_label *gpt, uint64_t start)
 
 	nearest_start = le64_to_cpu(gpt->pheader->last_usable_lba);
 
+	if (gpt->has_extents) {
+		/* @start is free, so the next extent starts after it */
+		i = gpt_find_extent(gpt, start);
+		if (i < gpt->nextents && nearest_start > gpt->extents[i].start
+		    && gpt->extents[i].start > start)
+			nearest_start = gpt->extents[i].start - 1ULL;
+		return nearest_start;
+	}
+
 	for (i = 0; i < gpt_get_nentries(gpt); i++) {
 		struct gpt_entry *e = gpt_get_entry(gpt, i);
 		uint64_t ps = gpt_partition_start(e);
@@ -1540,6 +1748,15 @@ static uint64_t find_last_free_sector(struct fdisk_gpt_label *gpt)
 
 	/* start by assuming the last usable LBA is available */
 	last = le64_to_cpu(gpt->pheader->last_usable_lba);
+
+	if (gpt->has_extents) {
+		size_t i = gpt_find_extent(gpt, last);
+
+		if (i < gpt->nextents && gpt->extents[i].start <= last)
+			last = gpt->extents[i].start - 1ULL;
+		return last;
+	}
+
 	do {
 		size_t i;
 
@@ -1654,12 +1871,27 @@ static int gpt_probe_label(struct fdisk_context *cxt)
 	gpt->pheader = gpt_read_header(cxt, GPT_PRIMARY_PARTITION_TABLE_LBA,
 				       &gpt->ents);
 
-	if (gpt->pheader)
+	if (gpt->pheader) {
+		unsigned char *bents = NULL;
+
 		/* primary OK, try backup from alternative LBA */
 		gpt->bheader = gpt_read_header(cxt,
 					le64_to_cpu(gpt->pheader->alternative_lba),
-					NULL);
-	else
+					&bents);
+
+		/* only changed entries are written later, so both arrays
+		 * have to be the same on the device */
+		if (gpt->bheader) {
+			size_t psz = 0, bsz = 0;
+
+			if (gpt_sizeof_entries(gpt->pheader, &psz) != 0
+			    || gpt_sizeof_entries(gpt->bheader, &bsz) != 0
+			    || psz != bsz
+			    || memcmp(gpt->ents, bents, psz) != 0)
+				gpt_set_write_all(gpt);
+		}
+		free(bents);
+	} else
 		/* primary corrupted -- try last LBA */
 		gpt->bheader = gpt_read_header(cxt, last_lba(cxt), &gpt->ents);
 
@@ -1674,6 +1906,7 @@ static int gpt_probe_label(struct fdisk_context *cxt)
 		if (!gpt->bheader)
 			goto failed;
 		gpt_recompute_crc(gpt->bheader, gpt->ents);
+		gpt_set_write_all(gpt);
 		fdisk_label_set_changed(cxt->label, 1);
 
 	/* primary corrupted, backup OK -- recovery */
@@ -1684,6 +1917,7 @@ static int gpt_probe_label(struct fdisk_context *cxt)
 		if (!gpt->pheader)
 			goto failed;
 		gpt_recompute_crc(gpt->pheader, gpt->ents);
+		gpt_set_write_all(gpt);
 		fdisk_label_set_changed(cxt->label, 1);
 	}
 
@@ -1702,8 +1936,7 @@ static int gpt_probe_label(struct fdisk_context *cxt)
 
 			if (gpt_fix_alternative_lba(cxt, gpt) != 0)
 				fdisk_warnx(cxt, _("Failed to recalculate backup GPT table location"));
-			gpt_recompute_crc(gpt->bheader, gpt->ents);
-			gpt_recompute_crc(gpt->pheader, gpt->ents);
+			gpt_recompute_crcs(gpt);
 			fdisk_label_set_changed(cxt->label, 1);
 		}
 	}
@@ -2013,8 +2246,7 @@ static int gpt_set_partition(struct fdisk_context *cxt, size_t n,
 		}
 		e->lba_end = cpu_to_le64(end);
 	}
-	gpt_recompute_crc(gpt->pheader, gpt->ents);
-	gpt_recompute_crc(gpt->bheader, gpt->ents);
+	gpt_update_entry_crc(gpt, n);
 
 	fdisk_label_set_changed(cxt->label, 1);
 	return rc;
@@ -2050,22 +2282,56 @@ static int gpt_write(struct fdisk_context *cxt, off_t offset, void *buf, size_t
 }
 
 /*
- * Write partitions.
+ * Write partitions. Only sectors with changed entries are written if the
+ * entries on the device are known to be the same as in memory otherwise.
  * Returns 0 on success, or corresponding error otherwise.
  */
 static int gpt_write_partitions(struct fdisk_context *cxt,
-				struct gpt_header *header, unsigned char *ents)
+				struct fdisk_gpt_label *gpt,
+				struct gpt_header *header,
+				int backup)
 {
-	size_t esz = 0;
+	size_t arysz = 0, esz, ss = cxt->sector_size, i, n;
+	off_t base;
 	int rc;
 
-	rc = gpt_sizeof_entries(header, &esz);
+	rc = gpt_sizeof_entries(header, &arysz);
 	if (rc)
 		return rc;
 
-	return gpt_write(cxt,
-			(off_t) le64_to_cpu(header->partition_entry_lba) * cxt->sector_size,
-			ents, esz);
+	base = (off_t) le64_to_cpu(header->partition_entry_lba) * ss;
+
+	if (gpt->write_all || fdisk_has_wipe(cxt) || (backup && gpt->backup_moved))
+		return gpt_write(cxt, base, gpt->ents, arysz);
+	if (!gpt->ents_dirty)
+		return 0;
+
+	esz = le32_to_cpu(header->sizeof_partition_entry);
+	n = gpt_get_nentries(gpt);
+
+	for (i = 0; i < n; i++) {
+		size_t first, last;	/* sectors relative to the array */
+
+		if (!isset(gpt->ents_dirty, i))
+			continue;
+
+		first = i * esz / ss;
+		last = ((i + 1) * esz - 1) / ss;
+
+		/* add the next changed entries within or next to the sectors */
+		while (i + 1 < n && isset(gpt->ents_dirty, i + 1)
+		       && (i + 1) * esz / ss <= last + 1) {
+			i++;
+			last = ((i + 1) * esz - 1) / ss;
+		}
+
+		rc = gpt_write(cxt, base + (off_t) (first * ss),
+				gpt->ents + first * ss,
+				min((last + 1) * ss, arysz) - first * ss);
+		if (rc)
+			return rc;
+	}
+	return 0;
 }
 
 /*
@@ -2082,6 +2348,51 @@ static int gpt_write_header(struct fdisk_context *cxt,
 	return gpt_write(cxt, lba * cxt->sector_size, header, cxt->sector_size);
 }
 
+/*
+ * Write the backup partitions array and the backup header. If the whole array
+ * has to be written (for example the backup has been moved to the end of the
+ * resized device) and the array is just in front of the header, then both
+ * are written by one write() call. The primary header still points to the
+ * old backup until it is written later.
+ *
+ * Returns 0 on success, or corresponding error otherwise.
+ */
+static int gpt_write_backup(struct fdisk_context *cxt,
+			    struct fdisk_gpt_label *gpt, uint64_t lba)
+{
+	struct gpt_header *h = gpt->bheader;
+	size_t arysz = 0, ss = cxt->sector_size, esz;
+	uint64_t esects;
+	unsigned char *buf;
+	int rc;
+
+	if (!(gpt->write_all || gpt->backup_moved || fdisk_has_wipe(cxt))
+	    || gpt_sizeof_entries(h, &arysz) != 0)
+		goto separate;
+
+	esects = (arysz + ss - 1) / ss;
+	if (le64_to_cpu(h->partition_entry_lba) + esects != lba)
+		goto separate;
+
+	esz = esects * ss;
+	buf = calloc(1, esz + ss);
+	if (!buf)
+		goto separate;
+
+	memcpy(buf, gpt->ents, arysz);
+	memcpy(buf + esz, h, ss);
+
+	DBG(GPT, ul_debug("writing backup array and header at once"));
+	rc = gpt_write(cxt, (off_t) (lba - esects) * ss, buf, esz + ss);
+	free(buf);
+	return rc;
+separate:
+	rc = gpt_write_partitions(cxt, gpt, h, 1);
+	if (!rc)
+		rc = gpt_write_header(cxt, h, lba);
+	return rc;
+}
+
 /*
  * Write the protective MBR.
  * Returns 0 on success, or corresponding error otherwise.
@@ -2177,8 +2488,7 @@ static int gpt_write_disklabel(struct fdisk_context *cxt)
 		gpt_minimize_alternative_lba(cxt, gpt);
 
 	/* recompute CRCs for both headers */
-	gpt_recompute_crc(gpt->pheader, gpt->ents);
-	gpt_recompute_crc(gpt->bheader, gpt->ents);
+	gpt_recompute_crcs(gpt);
 
 	/*
 	 * UEFI requires writing in this specific order:
@@ -2190,12 +2500,10 @@ static int gpt_write_disklabel(struct fdisk_context *cxt)
 	 *
 	 * If any write fails, we abort the rest.
 	 */
-	if (gpt_write_partitions(cxt, gpt->bheader, gpt->ents) != 0)
-		goto err1;
-	if (gpt_write_header(cxt, gpt->bheader,
+	if (gpt_write_backup(cxt, gpt,
 			     le64_to_cpu(gpt->pheader->alternative_lba)) != 0)
 		goto err1;
-	if (gpt_write_partitions(cxt, gpt->pheader, gpt->ents) != 0)
+	if (gpt_write_partitions(cxt, gpt, gpt->pheader, 0) != 0)
 		goto err1;
 	if (gpt_write_header(cxt, gpt->pheader, GPT_PRIMARY_PARTITION_TABLE_LBA) != 0)
 		goto err1;
@@ -2205,6 +2513,12 @@ static int gpt_write_disklabel(struct fdisk_context *cxt)
 	else if (gpt_write_pmbr(cxt) != 0)
 		goto err1;
 
+	/* the device is in sync with the in-memory entries now */
+	free(gpt->ents_dirty);
+	gpt->ents_dirty = NULL;
+	gpt->write_all = 0;
+	gpt->backup_moved = 0;
+
 	DBG(GPT, ul_debug("...write success"));
 	return 0;
 err0:
@@ -2360,8 +2674,7 @@ static int gpt_delete_partition(struct fdisk_context *cxt,
 	/* hasta la vista, baby! */
 	gpt_zeroize_entry(gpt, partnum);
 
-	gpt_recompute_crc(gpt->pheader, gpt->ents);
-	gpt_recompute_crc(gpt->bheader, gpt->ents);
+	gpt_update_entry_crc(gpt, partnum);
 	cxt->label->nparts_cur--;
 	fdisk_label_set_changed(cxt->label, 1);
 
@@ -2398,6 +2711,10 @@ static int gpt_add_partition(
 
 	pheader = gpt->pheader;
 
+	/* not fatal, the functions scan the entries without the extents */
+	if (cxt->label->batch && !gpt->has_extents)
+		gpt_init_extents(gpt);
+
 	rc = fdisk_partition_next_partno(pa, cxt, &partnum);
 	if (rc) {
 		DBG(GPT, ul_debug("failed to get next partno"));
@@ -2638,8 +2955,15 @@ static int gpt_add_partition(
 				gpt_partition_end(e),
 				gpt_partition_size(e)));
 
-	gpt_recompute_crc(gpt->pheader, gpt->ents);
-	gpt_recompute_crc(gpt->bheader, gpt->ents);
+	/* the checksums cover all entries, count them once for the batch */
+	if (!cxt->label->batch)
+		gpt_update_entry_crc(gpt, partnum);
+	else {
+		gpt_mark_entry_dirty(gpt, partnum);
+		gpt_free_entries_crc(gpt);
+		if (gpt->has_extents)
+			gpt_add_extent(gpt, user_f, user_l);
+	}
 
 	/* report result */
 	{
@@ -2722,8 +3046,8 @@ static int gpt_create_disklabel(struct fdisk_context *cxt)
 		rc = -ENOMEM;
 		goto done;
 	}
-	gpt_recompute_crc(gpt->pheader, gpt->ents);
-	gpt_recompute_crc(gpt->bheader, gpt->ents);
+	gpt_recompute_crcs(gpt);
+	gpt_set_write_all(gpt);
 
 	cxt->label->nparts_max = gpt_get_nentries(gpt);
 	cxt->label->nparts_cur = 0;
@@ -2909,8 +3233,8 @@ int fdisk_gpt_set_npartitions(struct fdisk_context *cxt, uint32_t nents)
 	gpt_mknew_header_common(cxt, gpt->bheader, le64_to_cpu(gpt->pheader->alternative_lba));
 
 	/* CRCs will have changed */
-	gpt_recompute_crc(gpt->pheader, gpt->ents);
-	gpt_recompute_crc(gpt->bheader, gpt->ents);
+	gpt_recompute_crcs(gpt);
+	gpt_set_write_all(gpt);
 
 	/* update library info */
 	cxt->label->nparts_max = gpt_get_nentries(gpt);
@@ -3028,8 +3352,7 @@ int fdisk_gpt_set_partition_attrs(
 	fdisk_info(cxt, _("The attributes on partition %zu changed to 0x%016" PRIx64 "."),
 			partnum + 1, attrs);
 
-	gpt_recompute_crc(gpt->pheader, gpt->ents);
-	gpt_recompute_crc(gpt->bheader, gpt->ents);
+	gpt_update_entry_crc(gpt, partnum);
 	fdisk_label_set_changed(cxt->label, 1);
 	return 0;
 }
@@ -3112,8 +3435,7 @@ static int gpt_toggle_partition_flag(
 			_("The %s flag on partition %zu is disabled now."),
 			name, i + 1);
 
-	gpt_recompute_crc(gpt->pheader, gpt->ents);
-	gpt_recompute_crc(gpt->bheader, gpt->ents);
+	gpt_update_entry_crc(gpt, i);
 	fdisk_label_set_changed(cxt->label, 1);
 	return 0;
 }
@@ -3159,8 +3481,8 @@ static int gpt_reorder(struct fdisk_context *cxt)
 	qsort(gpt->ents, nparts, sizeof(struct gpt_entry),
 			gpt_entry_cmp_start);
 
-	gpt_recompute_crc(gpt->pheader, gpt->ents);
-	gpt_recompute_crc(gpt->bheader, gpt->ents);
+	gpt_recompute_crcs(gpt);
+	gpt_set_write_all(gpt);
 	fdisk_label_set_changed(cxt->label, 1);
 
 	return 0;
@@ -3212,6 +3534,28 @@ static void gpt_deinit(struct fdisk_label *lb)
 	gpt->ents = NULL;
 	gpt->pheader = NULL;
 	gpt->bheader = NULL;
+
+	gpt_free_extents(gpt);
+	gpt_free_entries_crc(gpt);
+	free(gpt->ents_dirty);
+	gpt->ents_dirty = NULL;
+	gpt->write_all = 0;
+	gpt->backup_moved = 0;
+}
+
+static int gpt_end_batch(struct fdisk_context *cxt)
+{
+	struct fdisk_gpt_label *gpt;
+
+	assert(cxt);
+	assert(cxt->label);
+	assert(fdisk_is_label(cxt, GPT));
+
+	gpt = self_label(cxt);
+
+	gpt_free_extents(gpt);
+	gpt_recompute_crcs(gpt);
+	return 0;
 }
 
 static const struct fdisk_label_operations gpt_operations =
@@ -3235,7 +3579,8 @@ static const struct fdisk_label_operations gpt_operations =
 
 	.deinit		= gpt_deinit,
 
-	.reset_alignment = gpt_reset_alignment
+	.reset_alignment = gpt_reset_alignment,
+	.end_batch	= gpt_end_batch
 };
 
 static const struct fdisk_field gpt_fields[] =
@@ -617,6 +617,7 @@ void fdisk_deinit_label(struct fdisk_label *lb)
 	/* private label information */
 	if (lb->op->deinit)
 		lb->op->deinit(lb);
+	lb->generation++;
 }
 
 /**
@@ -632,6 +633,8 @@ void fdisk_label_set_changed(struct fdisk_label *lb, int changed)
 {
 	assert(lb);
 	lb->changed = changed ? 1 : 0;
+	if (changed)
+		lb->generation++;
 }
 
 /**
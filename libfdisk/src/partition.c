@@ -793,6 +793,7 @@ static int probe_partition_content(struct fdisk_context *cxt, struct fdisk_parti
 #ifdef HAVE_LIBBLKID
 	else {
 		uintmax_t start, size;
+		int xrc;
 
 		blkid_probe pr = blkid_new_probe();
 		if (!pr)
@@ -811,8 +812,13 @@ static int probe_partition_content(struct fdisk_context *cxt, struct fdisk_parti
 		start = fdisk_partition_get_start(pa) * fdisk_get_sector_size(cxt);
 		size = fdisk_partition_get_size(pa) * fdisk_get_sector_size(cxt);
 
-		if (blkid_probe_set_device(pr, cxt->dev_fd, start, size) == 0
-		    && blkid_do_fullprobe(pr) == 0) {
+		if (cxt->dev_map && start <= cxt->dev_mapsz
+		    && size <= cxt->dev_mapsz - start)
+			xrc = blkid_probe_set_buffer(pr, cxt->dev_map + start, size);
+		else
+			xrc = blkid_probe_set_device(pr, cxt->dev_fd, start, size);
+
+		if (xrc == 0 && blkid_do_fullprobe(pr) == 0) {
 
 			const char *data;
 			rc = 0;
@@ -442,42 +442,14 @@ int fdisk_script_has_force_label(struct fdisk_script *dp)
 }
 
 
-/**
- * fdisk_script_read_context:
- * @dp: script
- * @cxt: context
- *
- * Reads data from the @cxt context (on disk partition table) into the script.
- * If the context is not specified then defaults to context used for fdisk_new_script().
- *
- * Return: 0 on success, <0 on error.
- */
-int fdisk_script_read_context(struct fdisk_script *dp, struct fdisk_context *cxt)
+/* generate headers from @cxt */
+static int read_context_headers(struct fdisk_script *dp, struct fdisk_context *cxt)
 {
-	struct fdisk_label *lb;
+	struct fdisk_label *lb = fdisk_get_label(cxt, NULL);
 	int rc;
 	char *p = NULL;
 	char buf[64];
 
-	if (!dp || (!cxt && !dp->cxt))
-		return -EINVAL;
-
-	if (!cxt)
-		cxt = dp->cxt;
-
-	DBG(SCRIPT, ul_debugobj(dp, "reading context into script"));
-	fdisk_reset_script(dp);
-
-	lb = fdisk_get_label(cxt, NULL);
-	if (!lb)
-		return -EINVAL;
-
-	/* allocate (if not yet) and fill table */
-	rc = fdisk_get_partitions(cxt, &dp->table);
-	if (rc)
-		return rc;
-
-	/* generate headers */
 	rc = fdisk_script_set_header(dp, "label", fdisk_label_get_name(lb));
 
 	if (!rc && fdisk_get_disklabel_id(cxt, &p) == 0 && p) {
@@ -527,6 +499,42 @@ int fdisk_script_read_context(struct fdisk_script *dp, struct fdisk_context *cxt
 		rc = fdisk_script_set_header(dp, "sector-size", buf);
 	}
 
+	return rc;
+}
+
+/**
+ * fdisk_script_read_context:
+ * @dp: script
+ * @cxt: context
+ *
+ * Reads data from the @cxt context (on disk partition table) into the script.
+ * If the context is not specified then defaults to context used for fdisk_new_script().
+ *
+ * Return: 0 on success, <0 on error.
+ */
+int fdisk_script_read_context(struct fdisk_script *dp, struct fdisk_context *cxt)
+{
+	int rc;
+
+	if (!dp || (!cxt && !dp->cxt))
+		return -EINVAL;
+
+	if (!cxt)
+		cxt = dp->cxt;
+
+	DBG(SCRIPT, ul_debugobj(dp, "reading context into script"));
+	fdisk_reset_script(dp);
+
+	if (!fdisk_get_label(cxt, NULL))
+		return -EINVAL;
+
+	/* allocate (if not yet) and fill table */
+	rc = fdisk_get_partitions(cxt, &dp->table);
+	if (rc)
+		return rc;
+
+	rc = read_context_headers(dp, cxt);
+
 	DBG(SCRIPT, ul_debugobj(dp, "read context done [rc=%d]", rc));
 	return rc;
 }
@@ -548,13 +556,82 @@ int fdisk_script_enable_json(struct fdisk_script *dp, int json)
 	return 0;
 }
 
-static int write_file_json(struct fdisk_script *dp, FILE *f)
+/*
+ * Returns the next partition of the script table, or the next used partition
+ * from @cxt label if the partitions are streamed; in this case @pa is reused
+ * for all the partitions and @n is the next partition number.
+ */
+static int next_dump_partition(struct fdisk_script *dp, struct fdisk_context *cxt,
+			       struct fdisk_iter *itr, size_t *n,
+			       struct fdisk_partition **pa)
+{
+	if (!cxt)
+		return dp->table ? fdisk_table_next_partition(dp->table, itr, pa) : 1;
+
+	while (*n < cxt->label->nparts_max) {
+		if (fdisk_get_partition(cxt, (*n)++, pa) == 0
+		    && fdisk_partition_is_used(*pa))
+			return 0;
+	}
+	return 1;
+}
+
+static void write_json_partition(struct fdisk_script *dp, struct ul_jsonwrt *json,
+				 const char *devname, struct fdisk_partition *pa)
+{
+	char *p = NULL;
+
+	ul_jsonwrt_object_open(json, NULL);
+	if (devname)
+		p = fdisk_partname(devname, pa->partno + 1);
+	if (p) {
+		DBG(SCRIPT, ul_debugobj(dp, "write %s entry", p));
+		ul_jsonwrt_value_s(json, "node", p);
+		free(p);
+	}
+
+	if (fdisk_partition_has_start(pa))
+		ul_jsonwrt_value_u64(json, "start", (uintmax_t)pa->start);
+
+	if (fdisk_partition_has_size(pa))
+		ul_jsonwrt_value_u64(json, "size", (uintmax_t)pa->size);
+
+	if (pa->type && fdisk_parttype_get_string(pa->type))
+		ul_jsonwrt_value_s(json, "type", fdisk_parttype_get_string(pa->type));
+
+	else if (pa->type) {
+		ul_jsonwrt_value_open(json, "type");
+		fprintf(json->out, "\"%x\"", fdisk_parttype_get_code(pa->type));
+		ul_jsonwrt_value_close(json);
+	}
+
+	if (pa->uuid)
+		ul_jsonwrt_value_s(json, "uuid", pa->uuid);
+	if (pa->name && *pa->name)
+		ul_jsonwrt_value_s(json, "name", pa->name);
+
+	/* for MBR attr=80 means bootable */
+	if (pa->attrs) {
+		struct fdisk_label *lb = script_get_label(dp);
+
+		if (!lb || fdisk_label_get_type(lb) != FDISK_DISKLABEL_DOS)
+			ul_jsonwrt_value_s(json, "attrs", pa->attrs);
+	}
+
+	if (fdisk_partition_is_bootable(pa))
+		ul_jsonwrt_value_boolean(json, "bootable", 1);
+	ul_jsonwrt_object_close(json);
+}
+
+/* writes headers and partitions from script table or from @cxt */
+static int write_file_json(struct fdisk_script *dp, struct fdisk_context *cxt, FILE *f)
 {
 	struct list_head *h;
-	struct fdisk_partition *pa;
+	struct fdisk_partition *pa = NULL;
 	struct fdisk_iter itr;
 	const char *devname = NULL;
 	struct ul_jsonwrt json;
+	size_t n = 0, nents = 0;
 
 	assert(dp);
 	assert(f);
@@ -593,77 +670,79 @@ static int write_file_json(struct fdisk_script *dp, FILE *f)
 			devname = fi->data;
 	}
 
-
-	if (!dp->table || fdisk_table_is_empty(dp->table)) {
-		DBG(SCRIPT, ul_debugobj(dp, "script table empty"));
-		goto done;
-	}
-
-	DBG(SCRIPT, ul_debugobj(dp, "%zu entries", fdisk_table_get_nents(dp->table)));
-
-	ul_jsonwrt_array_open(&json, "partitions");
-
+	/* the array is opened for the first partition, no array for empty table */
 	fdisk_reset_iter(&itr, FDISK_ITER_FORWARD);
-	while (fdisk_table_next_partition(dp->table, &itr, &pa) == 0) {
-		char *p = NULL;
-
-		ul_jsonwrt_object_open(&json, NULL);
-		if (devname)
-			p = fdisk_partname(devname, pa->partno + 1);
-		if (p) {
-			DBG(SCRIPT, ul_debugobj(dp, "write %s entry", p));
-			ul_jsonwrt_value_s(&json, "node", p);
-			free(p);
-		}
-
-		if (fdisk_partition_has_start(pa))
-			ul_jsonwrt_value_u64(&json, "start", (uintmax_t)pa->start);
-
-		if (fdisk_partition_has_size(pa))
-			ul_jsonwrt_value_u64(&json, "size", (uintmax_t)pa->size);
+	while (next_dump_partition(dp, cxt, &itr, &n, &pa) == 0) {
+		if (!nents++)
+			ul_jsonwrt_array_open(&json, "partitions");
+		write_json_partition(dp, &json, devname, pa);
+	}
 
-		if (pa->type && fdisk_parttype_get_string(pa->type))
-			ul_jsonwrt_value_s(&json, "type", fdisk_parttype_get_string(pa->type));
+	DBG(SCRIPT, ul_debugobj(dp, "%zu entries", nents));
+	if (nents)
+		ul_jsonwrt_array_close(&json);
 
-		else if (pa->type) {
-			ul_jsonwrt_value_open(&json, "type");
-			fprintf(f, "\"%x\"", fdisk_parttype_get_code(pa->type));
-			ul_jsonwrt_value_close(&json);
-		}
+	ul_jsonwrt_object_close(&json);
+	ul_jsonwrt_root_close(&json);
 
-		if (pa->uuid)
-			ul_jsonwrt_value_s(&json, "uuid", pa->uuid);
-		if (pa->name && *pa->name)
-			ul_jsonwrt_value_s(&json, "name", pa->name);
+	if (cxt)
+		fdisk_unref_partition(pa);
 
-		/* for MBR attr=80 means bootable */
-		if (pa->attrs) {
-			struct fdisk_label *lb = script_get_label(dp);
+	DBG(SCRIPT, ul_debugobj(dp, "write script done"));
+	return 0;
+}
 
-			if (!lb || fdisk_label_get_type(lb) != FDISK_DISKLABEL_DOS)
-				ul_jsonwrt_value_s(&json, "attrs", pa->attrs);
-		}
+static void write_sfdisk_partition(struct fdisk_script *dp, FILE *f,
+				   const char *devname, struct fdisk_partition *pa)
+{
+	char *p = NULL;
 
-		if (fdisk_partition_is_bootable(pa))
-			ul_jsonwrt_value_boolean(&json, "bootable", 1);
-		ul_jsonwrt_object_close(&json);
+	if (devname)
+		p = fdisk_partname(devname, pa->partno + 1);
+	if (p) {
+		DBG(SCRIPT, ul_debugobj(dp, "write %s entry", p));
+		fprintf(f, "%s :", p);
+		free(p);
+	} else
+		fprintf(f, "%zu :", pa->partno + 1);
+
+	if (fdisk_partition_has_start(pa))
+		fprintf(f, " start=%12ju", (uintmax_t)pa->start);
+	if (fdisk_partition_has_size(pa))
+		fprintf(f, ", size=%12ju", (uintmax_t)pa->size);
+
+	if (pa->type && fdisk_parttype_get_string(pa->type))
+		fprintf(f, ", type=%s", fdisk_parttype_get_string(pa->type));
+	else if (pa->type)
+		fprintf(f, ", type=%x", fdisk_parttype_get_code(pa->type));
+
+	if (pa->uuid)
+		fprintf(f, ", uuid=%s", pa->uuid);
+	if (pa->name && *pa->name) {
+		fputs(", name=", f);
+		fputs_quoted(pa->name, f);
 	}
 
-	ul_jsonwrt_array_close(&json);
-done:
-	ul_jsonwrt_object_close(&json);
-	ul_jsonwrt_root_close(&json);
+	/* for MBR attr=80 means bootable */
+	if (pa->attrs) {
+		struct fdisk_label *lb = script_get_label(dp);
 
-	DBG(SCRIPT, ul_debugobj(dp, "write script done"));
-	return 0;
+		if (!lb || fdisk_label_get_type(lb) != FDISK_DISKLABEL_DOS)
+			fprintf(f, ", attrs=\"%s\"", pa->attrs);
+	}
+	if (fdisk_partition_is_bootable(pa))
+		fprintf(f, ", bootable");
+	fputc('\n', f);
 }
 
-static int write_file_sfdisk(struct fdisk_script *dp, FILE *f)
+/* writes headers and partitions from script table or from @cxt */
+static int write_file_sfdisk(struct fdisk_script *dp, struct fdisk_context *cxt, FILE *f)
 {
 	struct list_head *h;
-	struct fdisk_partition *pa;
+	struct fdisk_partition *pa = NULL;
 	struct fdisk_iter itr;
 	const char *devname = NULL;
+	size_t n = 0, nents = 0;
 
 	assert(dp);
 	assert(f);
@@ -678,56 +757,18 @@ static int write_file_sfdisk(struct fdisk_script *dp, FILE *f)
 			devname = fi->data;
 	}
 
-	if (!dp->table || fdisk_table_is_empty(dp->table)) {
-		DBG(SCRIPT, ul_debugobj(dp, "script table empty"));
-		return 0;
-	}
-
-	DBG(SCRIPT, ul_debugobj(dp, "%zu entries", fdisk_table_get_nents(dp->table)));
-
-	fputc('\n', f);
-
+	/* the headers are separated from the first partition entry */
 	fdisk_reset_iter(&itr, FDISK_ITER_FORWARD);
-	while (fdisk_table_next_partition(dp->table, &itr, &pa) == 0) {
-		char *p = NULL;
-
-		if (devname)
-			p = fdisk_partname(devname, pa->partno + 1);
-		if (p) {
-			DBG(SCRIPT, ul_debugobj(dp, "write %s entry", p));
-			fprintf(f, "%s :", p);
-			free(p);
-		} else
-			fprintf(f, "%zu :", pa->partno + 1);
-
-		if (fdisk_partition_has_start(pa))
-			fprintf(f, " start=%12ju", (uintmax_t)pa->start);
-		if (fdisk_partition_has_size(pa))
-			fprintf(f, ", size=%12ju", (uintmax_t)pa->size);
-
-		if (pa->type && fdisk_parttype_get_string(pa->type))
-			fprintf(f, ", type=%s", fdisk_parttype_get_string(pa->type));
-		else if (pa->type)
-			fprintf(f, ", type=%x", fdisk_parttype_get_code(pa->type));
-
-		if (pa->uuid)
-			fprintf(f, ", uuid=%s", pa->uuid);
-		if (pa->name && *pa->name) {
-			fputs(", name=", f);
-			fputs_quoted(pa->name, f);
-		}
+	while (next_dump_partition(dp, cxt, &itr, &n, &pa) == 0) {
+		if (!nents++)
+			fputc('\n', f);
+		write_sfdisk_partition(dp, f, devname, pa);
+	}
 
-		/* for MBR attr=80 means bootable */
-		if (pa->attrs) {
-			struct fdisk_label *lb = script_get_label(dp);
+	DBG(SCRIPT, ul_debugobj(dp, "%zu entries", nents));
 
-			if (!lb || fdisk_label_get_type(lb) != FDISK_DISKLABEL_DOS)
-				fprintf(f, ", attrs=\"%s\"", pa->attrs);
-		}
-		if (fdisk_partition_is_bootable(pa))
-			fprintf(f, ", bootable");
-		fputc('\n', f);
-	}
+	if (cxt)
+		fdisk_unref_partition(pa);
 
 	DBG(SCRIPT, ul_debugobj(dp, "write script done"));
 	return 0;
@@ -747,9 +788,55 @@ int fdisk_script_write_file(struct fdisk_script *dp, FILE *f)
 	assert(dp);
 
 	if (dp->json)
-		return write_file_json(dp, f);
+		return write_file_json(dp, NULL, f);
+
+	return write_file_sfdisk(dp, NULL, f);
+}
+
+/**
+ * fdisk_script_write_context:
+ * @dp: script
+ * @cxt: context
+ * @f: output file
+ *
+ * Writes the on-disk partition table from @cxt to the file @f. If the context
+ * is not specified then defaults to context used for fdisk_new_script().
+ *
+ * The result is the same as fdisk_script_read_context() followed by
+ * fdisk_script_write_file(), but the partitions are written as they are read
+ * from the label and only one partition is in memory at a time. The script
+ * headers are kept in @dp, the script table is empty.
+ *
+ * Returns: 0 on success, <0 on error.
+ *
+ * Since: 2.41
+ */
+int fdisk_script_write_context(struct fdisk_script *dp, struct fdisk_context *cxt, FILE *f)
+{
+	int rc;
+
+	if (!dp || !f || (!cxt && !dp->cxt))
+		return -EINVAL;
+
+	if (!cxt)
+		cxt = dp->cxt;
+
+	DBG(SCRIPT, ul_debugobj(dp, "writing context"));
+	fdisk_reset_script(dp);
+
+	if (!fdisk_get_label(cxt, NULL))
+		return -EINVAL;
+	if (!cxt->label->op->get_part)
+		return -ENOSYS;
+
+	rc = read_context_headers(dp, cxt);
+	if (rc)
+		return rc;
+
+	if (dp->json)
+		return write_file_json(dp, cxt, f);
 
-	return write_file_sfdisk(dp, f);
+	return write_file_sfdisk(dp, cxt, f);
 }
 
 static inline int is_header_line(const char *s)
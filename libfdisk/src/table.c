@@ -397,19 +397,17 @@ int fdisk_table_sort_partitions(struct fdisk_table *tb,
 	return 0;
 }
 
-/* allocates a new freespace description */
+/* adds a new area to the freespace cache */
 static int new_freespace(struct fdisk_context *cxt,
 			 fdisk_sector_t start,
 			 fdisk_sector_t end,
 			 struct fdisk_partition *parent,
-			 struct fdisk_partition **pa)
+			 int tail)
 {
 	fdisk_sector_t aligned_start, size;
+	struct fdisk_freespace *fs;
 
 	assert(cxt);
-	assert(pa);
-
-	*pa = NULL;
 
 	if (start == end)
 		return 0;
@@ -426,57 +424,70 @@ static int new_freespace(struct fdisk_context *cxt,
 		return 0;
 	}
 
-	*pa = fdisk_new_partition();
-	if (!*pa)
-		return -ENOMEM;
+	if (cxt->nfreespaces == cxt->freespaces_max) {
+		size_t n = cxt->freespaces_max ? cxt->freespaces_max * 2 : 16;
 
-	(*pa)->freespace = 1;
-	(*pa)->start = aligned_start;
-	(*pa)->size = size;
+		fs = reallocarray(cxt->freespaces, n, sizeof(*fs));
+		if (!fs)
+			return -ENOMEM;
+		cxt->freespaces = fs;
+		cxt->freespaces_max = n;
+	}
 
+	fs = &cxt->freespaces[cxt->nfreespaces++];
+	fs->start = aligned_start;
+	fs->size = size;
+	fs->tail = tail ? 1 : 0;
 	if (parent)
-		(*pa)->parent_partno = parent->partno;
+		fs->parent_partno = parent->partno;
+	else
+		FDISK_INIT_UNDEF(fs->parent_partno);
 	return 0;
 }
 
 /* add freespace description to the right place within @tb */
 static int table_add_freespace(
-			struct fdisk_context *cxt,
 			struct fdisk_table *tb,
-			fdisk_sector_t start,
-			fdisk_sector_t end,
-			struct fdisk_partition *parent)
+			const struct fdisk_freespace *fs)
 {
 	struct fdisk_partition *pa, *x, *real_parent = NULL, *best = NULL;
 	struct fdisk_iter itr;
 	int rc = 0;
 
 	assert(tb);
+	assert(fs);
 
-	rc = new_freespace(cxt, start, end, parent, &pa);
-	if (rc)
-		return -ENOMEM;
+	pa = fdisk_new_partition();
 	if (!pa)
-		return 0;
+		return -ENOMEM;
 
-	assert(fdisk_partition_has_start(pa));
-	assert(fdisk_partition_has_end(pa));
+	pa->freespace = 1;
+	pa->start = fs->start;
+	pa->size = fs->size;
+	pa->parent_partno = fs->parent_partno;
+
+	/* free-space behind last partition belongs to the end of the table */
+	if (fs->tail) {
+		rc = fdisk_table_add_partition(tb, pa);
+		fdisk_unref_partition(pa);
+		return rc;
+	}
 
 	DBG(TAB, ul_debugobj(tb, "adding freespace"));
 
 	fdisk_reset_iter(&itr, FDISK_ITER_FORWARD);
-	if (parent && fdisk_partition_has_partno(parent)) {
+	if (!FDISK_IS_UNDEF(fs->parent_partno)) {
 		while (fdisk_table_next_partition(tb, &itr, &x) == 0) {
 			if (!fdisk_partition_has_partno(x))
 				continue;
-			if (x->partno == parent->partno) {
+			if (x->partno == fs->parent_partno) {
 				real_parent = x;
 				break;
 			}
 		}
 		if (!real_parent) {
 			DBG(TAB, ul_debugobj(tb, "not found freespace parent (partno=%zu)",
-					parent->partno));
+					fs->parent_partno));
 			fdisk_reset_iter(&itr, FDISK_ITER_FORWARD);
 		}
 	}
@@ -505,11 +516,10 @@ static int table_add_freespace(
 	return rc;
 }
 
-/* analyze @cont(ainer) in @parts and add all detected freespace into @tb, note
- * that @parts has to be sorted by partition starts */
+/* analyze @cont(ainer) in @parts and add all detected freespace into the
+ * cache, note that @parts has to be sorted by partition starts */
 static int check_container_freespace(struct fdisk_context *cxt,
 				     struct fdisk_table *parts,
-				     struct fdisk_table *tb,
 				     struct fdisk_partition *cont)
 {
 	struct fdisk_iter itr;
@@ -519,11 +529,10 @@ static int check_container_freespace(struct fdisk_context *cxt,
 
 	assert(cxt);
 	assert(parts);
-	assert(tb);
 	assert(cont);
 	assert(fdisk_partition_has_start(cont));
 
-	DBG(TAB, ul_debugobj(tb, "analyze container 0x%p", cont));
+	DBG(TAB, ul_debugobj(cxt, "analyze container 0x%p", cont));
 
 	last = fdisk_partition_get_start(cont);
 	grain = cxt->grain > cxt->sector_size ?	cxt->grain / cxt->sector_size : 1;
@@ -548,7 +557,7 @@ static int check_container_freespace(struct fdisk_context *cxt,
 
 		lastplusoff = last + cxt->first_lba;
 		if (pa->start > lastplusoff && pa->start - lastplusoff > grain)
-			rc = table_add_freespace(cxt, tb, lastplusoff, pa->start, cont);
+			rc = new_freespace(cxt, lastplusoff, pa->start, cont, 0);
 		if (rc)
 			goto done;
 		last = fdisk_partition_get_end(pa);
@@ -558,30 +567,41 @@ static int check_container_freespace(struct fdisk_context *cxt,
 	x = fdisk_partition_get_start(cont) + fdisk_partition_get_size(cont) - 1;
 	lastplusoff = last + cxt->first_lba;
 	if (lastplusoff < x && x - lastplusoff > grain) {
-		DBG(TAB, ul_debugobj(tb, "add remaining space in container 0x%p", cont));
-		rc = table_add_freespace(cxt, tb, lastplusoff, x, cont);
+		DBG(TAB, ul_debugobj(cxt, "add remaining space in container 0x%p", cont));
+		rc = new_freespace(cxt, lastplusoff, x, cont, 0);
 	}
 
 done:
-	DBG(TAB, ul_debugobj(tb, "analyze container 0x%p DONE [rc=%d]", cont, rc));
+	DBG(TAB, ul_debugobj(cxt, "analyze container 0x%p DONE [rc=%d]", cont, rc));
 	return rc;
 }
 
+/* the cache is usable as long as the label and alignment are unchanged */
+static void get_freespaces_key(struct fdisk_context *cxt,
+			       struct fdisk_freespaces_key *key)
+{
+	memset(key, 0, sizeof(*key));
+
+	key->label = cxt->label;
+	key->generation = cxt->label->generation;
+	key->grain = cxt->grain;
+	key->sector_size = cxt->sector_size;
+	key->phy_sector_size = cxt->phy_sector_size;
+	key->alignment_offset = cxt->alignment_offset;
+	key->first_lba = cxt->first_lba;
+	key->last_lba = cxt->last_lba;
+}
 
-/**
- * fdisk_get_freespaces
- * @cxt: fdisk context
- * @tb: returns table
- *
- * This function adds freespace (described by fdisk_partition) to @table, it
- * allocates a new table if the @table points to NULL.
- *
- * Note that free space smaller than grain (see fdisk_get_grain_size()) is
- * ignored.
- *
- * Returns: 0 on success, otherwise, a corresponding error.
- */
-int fdisk_get_freespaces(struct fdisk_context *cxt, struct fdisk_table **tb)
+void fdisk_reset_freespaces(struct fdisk_context *cxt)
+{
+	free(cxt->freespaces);
+	cxt->freespaces = NULL;
+	cxt->nfreespaces = cxt->freespaces_max = 0;
+	memset(&cxt->freespaces_key, 0, sizeof(cxt->freespaces_key));
+}
+
+/* analyze gaps between partitions and fill the cache */
+static int read_freespaces(struct fdisk_context *cxt)
 {
 	int rc = 0;
 	size_t nparts = 0;
@@ -590,12 +610,7 @@ int fdisk_get_freespaces(struct fdisk_context *cxt, struct fdisk_table **tb)
 	struct fdisk_partition *pa;
 	struct fdisk_iter itr;
 
-	DBG(CXT, ul_debugobj(cxt, "-- get freespace --"));
-
-	if (!cxt || !cxt->label || !tb)
-		return -EINVAL;
-	if (!*tb && !(*tb = fdisk_new_table()))
-		return -ENOMEM;
+	fdisk_reset_freespaces(cxt);
 
 	rc = fdisk_get_partitions(cxt, &parts);
 	if (rc)
@@ -609,7 +624,6 @@ int fdisk_get_freespaces(struct fdisk_context *cxt, struct fdisk_table **tb)
 	DBG(CXT, ul_debugobj(cxt, "initialized:  last=%ju, grain=%ju",
 	                     (uintmax_t)last,  (uintmax_t)grain));
 
-	/* analyze gaps between partitions */
 	while (rc == 0 && fdisk_table_next_partition(parts, &itr, &pa) == 0) {
 
 		DBG(CXT, ul_debugobj(cxt, "partno=%zu, start=%ju",
@@ -630,13 +644,13 @@ int fdisk_get_freespaces(struct fdisk_context *cxt, struct fdisk_table **tb)
 		    || (nparts == 0 &&
 		        (fdisk_align_lba(cxt, last, FDISK_ALIGN_UP) <
 			 pa->start))) {
-			rc = table_add_freespace(cxt, *tb,
+			rc = new_freespace(cxt,
 				last + (nparts == 0 ? 0 : 1),
-				pa->start - 1, NULL);
+				pa->start - 1, NULL, 0);
 		}
 		/* add gaps between logical partitions */
 		if (fdisk_partition_is_container(pa))
-			rc = check_container_freespace(cxt, parts, *tb, pa);
+			rc = check_container_freespace(cxt, parts, pa);
 
 		if (fdisk_partition_has_end(pa)) {
 			fdisk_sector_t pa_end = fdisk_partition_get_end(pa);
@@ -646,22 +660,59 @@ int fdisk_get_freespaces(struct fdisk_context *cxt, struct fdisk_table **tb)
 		nparts++;
 	}
 
-	/* add free-space behind last partition to the end of the table (so
-	 * don't use table_add_freespace()) */
 	if (rc == 0 && last + grain < cxt->last_lba - 1) {
 		DBG(CXT, ul_debugobj(cxt, "freespace behind last partition detected"));
 		rc = new_freespace(cxt,
 			last + (last > cxt->first_lba || nparts ? 1 : 0),
-			cxt->last_lba, NULL, &pa);
-		if (pa) {
-			fdisk_table_add_partition(*tb, pa);
-			fdisk_unref_partition(pa);
-		}
+			cxt->last_lba, NULL, 1);
 	}
-
 done:
 	fdisk_unref_table(parts);
 
+	if (rc)
+		fdisk_reset_freespaces(cxt);
+	else
+		get_freespaces_key(cxt, &cxt->freespaces_key);
+	return rc;
+}
+
+/**
+ * fdisk_get_freespaces
+ * @cxt: fdisk context
+ * @tb: returns table
+ *
+ * This function adds freespace (described by fdisk_partition) to @table, it
+ * allocates a new table if the @table points to NULL.
+ *
+ * Note that free space smaller than grain (see fdisk_get_grain_size()) is
+ * ignored.
+ *
+ * Returns: 0 on success, otherwise, a corresponding error.
+ */
+int fdisk_get_freespaces(struct fdisk_context *cxt, struct fdisk_table **tb)
+{
+	struct fdisk_freespaces_key key;
+	size_t i;
+	int rc = 0;
+
+	DBG(CXT, ul_debugobj(cxt, "-- get freespace --"));
+
+	if (!cxt || !cxt->label || !tb)
+		return -EINVAL;
+	if (!*tb && !(*tb = fdisk_new_table()))
+		return -ENOMEM;
+
+	/* The free areas are cached in the context until the label is
+	 * modified; cfdisk and scripts ask for them after every change only. */
+	get_freespaces_key(cxt, &key);
+	if (memcmp(&key, &cxt->freespaces_key, sizeof(key)) != 0)
+		rc = read_freespaces(cxt);
+	else
+		DBG(CXT, ul_debugobj(cxt, "using cached freespace"));
+
+	for (i = 0; rc == 0 && i < cxt->nfreespaces; i++)
+		rc = table_add_freespace(*tb, &cxt->freespaces[i]);
+
 	DBG(CXT, ul_debugobj(cxt, "get freespace DONE [rc=%d]", rc));
 	return rc;
 }
@@ -701,19 +752,28 @@ int fdisk_table_wrong_order(struct fdisk_table *tb)
  * that does not define start (or does not follow the default start)
  * are ignored.
  *
+ * The partitions are added as one batch, the label driver may postpone
+ * work common for all the partitions (e.g. checksums) to the end of the
+ * batch.
+ *
  * Returns: 0 on success, <0 on error.
  */
 int fdisk_apply_table(struct fdisk_context *cxt, struct fdisk_table *tb)
 {
 	struct fdisk_partition *pa;
 	struct fdisk_iter itr;
-	int rc = 0;
+	struct fdisk_label *lb;
+	int rc = 0, xrc;
 
 	assert(cxt);
 	assert(tb);
 
 	DBG(TAB, ul_debugobj(tb, "applying to context %p", cxt));
 
+	lb = cxt->label;
+	if (lb && lb->op->end_batch)
+		lb->batch = 1;
+
 	fdisk_reset_iter(&itr, FDISK_ITER_FORWARD);
 	while (tb && fdisk_table_next_partition(tb, &itr, &pa) == 0) {
 		if (!fdisk_partition_has_start(pa) && !pa->start_follow_default)
@@ -723,6 +783,12 @@ int fdisk_apply_table(struct fdisk_context *cxt, struct fdisk_table *tb)
 			break;
 	}
 
+	if (lb && lb->batch) {
+		lb->batch = 0;
+		xrc = lb->op->end_batch(cxt);
+		if (!rc)
+			rc = xrc;
+	}
 	return rc;
 }
 
@@ -11,9 +11,12 @@
  * @short_description: misc fdisk functions
  */
 
-static int read_from_device(struct fdisk_context *cxt,
-		unsigned char *buf,
-		uintmax_t start, size_t size)
+/*
+ * Reads @size bytes from @start offset. The data are copied from the
+ * mapping if the device is mapped (see fdisk_enable_mmap()).
+ */
+int fdisk_read_device(struct fdisk_context *cxt, void *buf,
+		      uintmax_t start, size_t size)
 {
 	ssize_t r;
 
@@ -22,6 +25,16 @@ static int read_from_device(struct fdisk_context *cxt,
 	DBG(CXT, ul_debugobj(cxt, "reading: offset=%ju, size=%zu",
 				start, size));
 
+	if (cxt->dev_map) {
+		if (start > cxt->dev_mapsz || size > cxt->dev_mapsz - start) {
+			DBG(CXT, ul_debugobj(cxt, "failed to read %zu from offset %ju: out of mapping",
+					size, start));
+			return -EINVAL;	/* too small file */
+		}
+		memcpy(buf, cxt->dev_map + start, size);
+		return 0;
+	}
+
 	r = lseek(cxt->dev_fd, start, SEEK_SET);
 	if (r == -1)
 	{
@@ -43,6 +56,25 @@ static int read_from_device(struct fdisk_context *cxt,
 }
 
 
+/*
+ * Asks kernel to read the area in advance, the next fdisk_read_device() for
+ * the area does not wait for the device then. It's only a hint. The mapping
+ * (if any) shares the page cache with the file descriptor.
+ */
+void fdisk_prefetch_device(struct fdisk_context *cxt,
+			   uintmax_t start, size_t size)
+{
+	assert(cxt);
+
+#if defined(POSIX_FADV_WILLNEED) && defined(HAVE_POSIX_FADVISE)
+	DBG(CXT, ul_debugobj(cxt, "prefetch: offset=%ju, size=%zu", start, size));
+	ignore_result( posix_fadvise(cxt->dev_fd, start, size, POSIX_FADV_WILLNEED) );
+#else
+	(void) start;
+	(void) size;
+#endif
+}
+
 /*
  * Zeros in-memory first sector buffer
  */
@@ -84,7 +116,7 @@ int fdisk_init_firstsector_buffer(struct fdisk_context *cxt,
 		 * to be sure.			-- kzak 13-Apr-2015
 		 */
 		DBG(CXT, ul_debugobj(cxt, "first sector protection enabled -- re-reading"));
-		read_from_device(cxt, cxt->firstsector, protect_off, protect_size);
+		fdisk_read_device(cxt, cxt->firstsector, protect_off, protect_size);
 	}
 	return 0;
 }
@@ -103,7 +135,7 @@ int fdisk_read_firstsector(struct fdisk_context *cxt)
 	assert(cxt->sector_size == cxt->firstsector_bufsz);
 
 
-	return  read_from_device(cxt, cxt->firstsector, 0, cxt->sector_size);
+	return  fdisk_read_device(cxt, cxt->firstsector, 0, cxt->sector_size);
 }
 
 /**
@@ -168,7 +168,10 @@ int fdisk_check_collisions(struct fdisk_context *cxt)
 	pr = blkid_new_probe();
 	if (!pr)
 		return -ENOMEM;
-	rc = blkid_probe_set_device(pr, cxt->dev_fd, 0, 0);
+	if (cxt->dev_map)
+		rc = blkid_probe_set_buffer(pr, cxt->dev_map, cxt->dev_mapsz);
+	else
+		rc = blkid_probe_set_device(pr, cxt->dev_fd, 0, 0);
 	if (rc)
 		return rc;
 
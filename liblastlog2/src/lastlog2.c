@@ -39,11 +39,22 @@
 #include "lastlog2P.h"
 #include "strutils.h"
 
+/* How long to wait for a lock of another process, in milliseconds. */
+#define LL2_BUSY_TIMEOUT	1000
+
+static const char *sql_table = "CREATE TABLE IF NOT EXISTS Lastlog2(Name TEXT PRIMARY KEY, Time INTEGER, TTY TEXT, RemoteHost TEXT, Service TEXT);";
+
+static const char *sql_stmts[LL2_NSTMTS] = {
+	[LL2_STMT_READ]   = "SELECT Name,Time,TTY,RemoteHost,Service FROM Lastlog2 WHERE Name = ?",
+	[LL2_STMT_WRITE]  = "REPLACE INTO Lastlog2 VALUES(?,?,?,?,?);",
+	[LL2_STMT_REMOVE] = "DELETE FROM Lastlog2 WHERE Name = ?"
+};
+
 /* Set the ll2 context/environment */
 /* Returns the context or NULL if an error has happened. */
 extern struct ll2_context * ll2_new_context(const char *db_path)
 {
-	struct ll2_context *context = (struct ll2_context *)malloc(sizeof(struct ll2_context));
+	struct ll2_context *context = (struct ll2_context *)calloc(1, sizeof(struct ll2_context));
 
 	if (context) {
 		if (db_path) {
@@ -61,11 +72,28 @@ extern struct ll2_context * ll2_new_context(const char *db_path)
 	return context;
 }
 
+static void
+close_database(struct ll2_context *context)
+{
+	size_t i;
+
+	for (i = 0; i < LL2_NSTMTS; i++) {
+		sqlite3_finalize(context->stmts[i]);
+		context->stmts[i] = NULL;
+	}
+	sqlite3_close(context->db);
+	context->db = NULL;
+	context->db_rw = 0;
+	context->db_table = 0;
+}
+
 /* Release ll2 context/environment */
 extern void ll2_unref_context(struct ll2_context *context)
 {
-	if (context)
+	if (context) {
+		close_database(context);
 		free(context->lastlog2_path);
+	}
 	free(context);
 }
 
@@ -115,26 +143,145 @@ open_database_rw(struct ll2_context *context,  sqlite3 **db, char **error)
 	return ret;
 }
 
-/* Reads one entry from database and returns that.
+/* Returns the database connection cached in the context, or opens a new one.
+   The connection is kept open until the context is released; a read-only
+   connection is reopened if read-write access is requested.
    Returns 0 on success, -ENOMEM or -1 on other failure. */
 static int
-read_entry(sqlite3 *db, const char *user,
-	   int64_t *ll_time, char **tty, char **rhost,
-	   char **pam_service, char **error)
+get_database(struct ll2_context *context, int rw, sqlite3 **db, char **error)
+{
+	int ret;
+
+	if (context && context->db) {
+		if (context->db_rw || !rw) {
+			*db = context->db;
+			return 0;
+		}
+		close_database(context);
+	}
+
+	if (rw)
+		ret = open_database_rw(context, db, error);
+	else
+		ret = open_database_ro(context, db, error);
+	if (ret != 0)
+		return ret;
+
+	/* wait for concurrent logins rather than fail */
+	sqlite3_busy_timeout(*db, LL2_BUSY_TIMEOUT);
+
+	if (context) {
+		context->db = *db;
+		context->db_rw = rw ? 1 : 0;
+	}
+	return 0;
+}
+
+/* Closes the database if it is not cached in a context. */
+static void
+put_database(struct ll2_context *context, sqlite3 *db)
+{
+	if (!context)
+		sqlite3_close(db);
+}
+
+/* Returns a prepared statement, it is cached in the context if possible.
+   Returns 0 on success, -ENOMEM or -1 on other failure. */
+static int
+get_stmt(struct ll2_context *context, sqlite3 *db, int id,
+	 sqlite3_stmt **res, char **error)
 {
 	int retval = 0;
-	sqlite3_stmt *res = NULL;
-	static const char *sql = "SELECT Name,Time,TTY,RemoteHost,Service FROM Lastlog2 WHERE Name = ?";
 
-	if (sqlite3_prepare_v2(db, sql, -1, &res, 0) != SQLITE_OK) {
+	if (context && context->stmts[id]) {
+		*res = context->stmts[id];
+		return 0;
+	}
+
+	if (sqlite3_prepare_v2(db, sql_stmts[id], -1, res, 0) != SQLITE_OK) {
+		*res = NULL;
 		retval = -1;
 		if (error)
 			if (asprintf(error, "Failed to execute statement: %s",
 				     sqlite3_errmsg(db)) < 0)
 				retval = -ENOMEM;
-		goto out_read_entry;
+		return retval;
+	}
+
+	if (context)
+		context->stmts[id] = *res;
+	return 0;
+}
+
+/* Resets a cached statement, so it does not keep the database locked,
+   or destroys a not cached one. */
+static void
+put_stmt(struct ll2_context *context, int id, sqlite3_stmt *res)
+{
+	if (!res)
+		return;
+	if (context && context->stmts[id] == res) {
+		sqlite3_reset(res);
+		sqlite3_clear_bindings(res);
+	} else
+		sqlite3_finalize(res);
+}
+
+/* Starts a transaction, unless there is one already.
+   Returns 1 if started, 0 if already in a transaction, -ENOMEM or -1 on
+   failure. */
+static int
+begin_transaction(sqlite3 *db, char **error)
+{
+	char *err_msg = NULL;
+	int retval = -1;
+
+	if (!sqlite3_get_autocommit(db))
+		return 0;
+
+	if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, &err_msg) == SQLITE_OK)
+		return 1;
+
+	if (error)
+		if (asprintf(error, "Cannot begin transaction: %s", err_msg) < 0)
+			retval = -ENOMEM;
+	sqlite3_free(err_msg);
+
+	return retval;
+}
+
+/* Commits or rolls back the current transaction.
+   Returns 0 on success, -ENOMEM or -1 on other failure. */
+static int
+end_transaction(sqlite3 *db, int commit, char **error)
+{
+	char *err_msg = NULL;
+	int retval = 0;
+
+	if (sqlite3_exec(db, commit ? "COMMIT;" : "ROLLBACK;", 0, 0, &err_msg) != SQLITE_OK) {
+		retval = -1;
+		if (error)
+			if (asprintf(error, "Cannot end transaction: %s", err_msg) < 0)
+				retval = -ENOMEM;
+		sqlite3_free(err_msg);
 	}
 
+	return retval;
+}
+
+/* Reads one entry from database and returns that.
+   Returns 0 on success, -ENOMEM or -1 on other failure. */
+static int
+read_entry(struct ll2_context *context, sqlite3 *db, const char *user,
+	   int64_t *ll_time, char **tty, char **rhost,
+	   char **pam_service, char **error)
+{
+	int retval = 0;
+	sqlite3_stmt *res = NULL;
+
+	if ((retval = get_stmt(context, db, LL2_STMT_READ, &res, error)) != 0)
+		goto out_read_entry;
+
 	if (sqlite3_bind_text(res, 1, user, -1, SQLITE_STATIC) != SQLITE_OK) {
 		retval = -1;
 		if (error)
@@ -200,8 +347,7 @@ read_entry(sqlite3 *db, const char *user,
 	}
 
 out_read_entry:
-	if (res)
-		sqlite3_finalize(res);
+	put_stmt(context, LL2_STMT_READ, res);
 
 	return retval;
 }
@@ -215,46 +361,42 @@ ll2_read_entry(struct ll2_context *context, const char *user,
 	sqlite3 *db;
 	int retval;
 
-	if ((retval = open_database_ro(context, &db, error)) != 0)
+	if ((retval = get_database(context, 0, &db, error)) != 0)
 		return retval;
 
-	retval = read_entry(db, user, ll_time, tty, rhost, pam_service, error);
+	retval = read_entry(context, db, user, ll_time, tty, rhost, pam_service, error);
 
-	sqlite3_close(db);
+	put_database(context, db);
 
 	return retval;
 }
 
 /* Write a new entry. Returns 0 on success, -ENOMEM or -1 on other failure. */
 static int
-write_entry(sqlite3 *db, const char *user,
+write_entry(struct ll2_context *context, sqlite3 *db, const char *user,
 	    int64_t ll_time, const char *tty, const char *rhost,
 	    const char *pam_service, char **error)
 {
 	int retval = 0;
 	char *err_msg = NULL;
 	sqlite3_stmt *res = NULL;
-	static const char *sql_table = "CREATE TABLE IF NOT EXISTS Lastlog2(Name TEXT PRIMARY KEY, Time INTEGER, TTY TEXT, RemoteHost TEXT, Service TEXT);";
-	static const char *sql_replace = "REPLACE INTO Lastlog2 VALUES(?,?,?,?,?);";
 
-	if (sqlite3_exec(db, sql_table, 0, 0, &err_msg) != SQLITE_OK) {
-		retval = -1;
-		if (error)
-			if (asprintf(error, "SQL error: %s", err_msg) < 0)
-				retval = -ENOMEM;
+	if (!context || !context->db_table) {
+		if (sqlite3_exec(db, sql_table, 0, 0, &err_msg) != SQLITE_OK) {
+			retval = -1;
+			if (error)
+				if (asprintf(error, "SQL error: %s", err_msg) < 0)
+					retval = -ENOMEM;
 
-		sqlite3_free(err_msg);
-		goto out_ll2_read_entry;
+			sqlite3_free(err_msg);
+			goto out_ll2_read_entry;
+		}
+		if (context)
+			context->db_table = 1;
 	}
 
-	if (sqlite3_prepare_v2(db, sql_replace, -1, &res, 0) != SQLITE_OK) {
-		retval = -1;
-		if (error)
-			if (asprintf(error, "Failed to execute statement: %s",
-				     sqlite3_errmsg(db)) < 0)
-				retval = -ENOMEM;
+	if ((retval = get_stmt(context, db, LL2_STMT_WRITE, &res, error)) != 0)
 		goto out_ll2_read_entry;
-	}
 
 	if (sqlite3_bind_text(res, 1, user, -1, SQLITE_STATIC) != SQLITE_OK) {
 		retval = -1;
@@ -318,8 +460,7 @@ write_entry(sqlite3 *db, const char *user,
 		}
 	}
 out_ll2_read_entry:
-	if (res)
-		sqlite3_finalize(res);
+	put_stmt(context, LL2_STMT_WRITE, res);
 
 	return retval;
 }
@@ -333,16 +474,59 @@ ll2_write_entry(struct ll2_context *context, const char *user,
 	sqlite3 *db;
 	int retval;
 
-	if ((retval = open_database_rw(context, &db, error)) != 0)
+	if ((retval = get_database(context, 1, &db, error)) != 0)
 		return retval;
 
-	retval = write_entry(db, user, ll_time, tty, rhost, pam_service, error);
+	retval = write_entry(context, db, user, ll_time, tty, rhost, pam_service, error);
 
-	sqlite3_close(db);
+	put_database(context, db);
 
 	return retval;
 }
 
+/* Starts a batch of changes written to the database by one transaction.
+   Returns 0 on success, -ENOMEM or -1 on other failure. */
+int
+ll2_begin_batch(struct ll2_context *context, char **error)
+{
+	sqlite3 *db;
+	int retval;
+
+	if (!context || (context->db && !sqlite3_get_autocommit(context->db))) {
+		retval = -1;
+		if (error)
+			if ((*error = strdup(context ? "Batch already started" :
+						       "Batch needs a context")) == NULL)
+				retval = -ENOMEM;
+		return retval;
+	}
+
+	if ((retval = get_database(context, 1, &db, error)) != 0)
+		return retval;
+
+	retval = begin_transaction(db, error);
+
+	return retval < 0 ? retval : 0;
+}
+
+/* Writes the changes since ll2_begin_batch(), or discards them if commit
+   is zero. Returns 0 on success, -ENOMEM or -1 on other failure. */
+int
+ll2_end_batch(struct ll2_context *context, int commit, char **error)
+{
+	int retval;
+
+	if (!context || !context->db || sqlite3_get_autocommit(context->db)) {
+		retval = -1;
+		if (error)
+			if ((*error = strdup("No batch started")) == NULL)
+				retval = -ENOMEM;
+		return retval;
+	}
+
+	return end_transaction(context->db, commit, error);
+}
+
 /* Write a new entry with updated login time.
    Returns 0 on success, -ENOMEM or -1 on other failure. */
 int
@@ -350,22 +534,31 @@ ll2_update_login_time(struct ll2_context *context, const char *user,
 		      int64_t ll_time, char **error)
 {
 	sqlite3 *db;
-	int retval;
-	char *tty;
-	char *rhost;
-	char *pam_service;
+	int retval, started;
+	char *tty = NULL;
+	char *rhost = NULL;
+	char *pam_service = NULL;
 
-	if ((retval = open_database_rw(context , &db, error)) != 0)
+	if ((retval = get_database(context, 1, &db, error)) != 0)
 		return retval;
 
-	if ((retval = read_entry(db, user, 0, &tty, &rhost, &pam_service, error)) != 0) {
-		sqlite3_close(db);
-		return retval;
+	if ((started = begin_transaction(db, error)) < 0) {
+		put_database(context, db);
+		return started;
 	}
 
-	retval = write_entry(db, user, ll_time, tty, rhost, pam_service, error);
+	retval = read_entry(context, db, user, 0, &tty, &rhost, &pam_service, error);
+	if (retval == 0)
+		retval = write_entry(context, db, user, ll_time, tty, rhost, pam_service, error);
 
-	sqlite3_close(db);
+	if (started) {
+		if (retval == 0)
+			retval = end_transaction(db, 1, error);
+		else
+			end_transaction(db, 0, NULL);
+	}
+
+	put_database(context, db);
 
 	free(tty);
 	free(rhost);
@@ -412,7 +605,7 @@ ll2_read_all(struct ll2_context *context,
 	char *err_msg = 0;
 	int retval = 0;
 
-	if ((retval = open_database_ro(context, &db, error)) != 0)
+	if ((retval = get_database(context, 0, &db, error)) != 0)
 		return retval;
 
 	static const char *sql = "SELECT Name,Time,TTY,RemoteHost,Service FROM Lastlog2 ORDER BY Name ASC";
@@ -426,27 +619,21 @@ ll2_read_all(struct ll2_context *context,
 		sqlite3_free(err_msg);
 	}
 
-	sqlite3_close(db);
+	put_database(context, db);
 
 	return retval;
 }
 
 /* Remove an user entry. Returns 0 on success, -ENOMEM or -1 on other failure. */
 static int
-remove_entry(sqlite3 *db, const char *user, char **error)
+remove_entry(struct ll2_context *context, sqlite3 *db, const char *user,
+	     char **error)
 {
 	int retval = 0;
 	sqlite3_stmt *res = NULL;
-	static const char *sql = "DELETE FROM Lastlog2 WHERE Name = ?";
 
-	if (sqlite3_prepare_v2(db, sql, -1, &res, 0) != SQLITE_OK) {
-		if (error)
-			if (asprintf(error, "Failed to execute statement: %s",
-				     sqlite3_errmsg(db)) < 0)
-				return -ENOMEM;
-
-		return -1;
-	}
+	if ((retval = get_stmt(context, db, LL2_STMT_REMOVE, &res, error)) != 0)
+		return retval;
 
 	if (sqlite3_bind_text(res, 1, user, -1, SQLITE_STATIC) != SQLITE_OK) {
 		retval = -1;
@@ -474,8 +661,7 @@ remove_entry(sqlite3 *db, const char *user, char **error)
 		}
 	}
 out_remove_entry:
-	if (res)
-		sqlite3_finalize(res);
+	put_stmt(context, LL2_STMT_REMOVE, res);
 
 	return retval;
 }
@@ -488,12 +674,12 @@ ll2_remove_entry(struct ll2_context *context, const char *user,
 	sqlite3 *db;
 	int retval;
 
-	if ((retval = open_database_rw(context, &db, error)) != 0)
+	if ((retval = get_database(context, 1, &db, error)) != 0)
 		return retval;
 
-	retval = remove_entry(db, user, error);
+	retval = remove_entry(context, db, user, error);
 
-	sqlite3_close(db);
+	put_database(context, db);
 
 	return retval;
 }
@@ -505,29 +691,33 @@ ll2_rename_user(struct ll2_context *context, const char *user,
 {
 	sqlite3 *db;
 	int64_t ll_time;
-	char *tty;
-	char *rhost;
-	char *pam_service;
-	int retval;
+	char *tty = NULL;
+	char *rhost = NULL;
+	char *pam_service = NULL;
+	int retval, started;
 
-	if ((retval = open_database_rw(context, &db, error)) != 0)
+	if ((retval = get_database(context, 1, &db, error)) != 0)
 		return retval;
 
-	if ((retval = read_entry(db, user, &ll_time, &tty, &rhost, &pam_service, error) != 0)) {
-		sqlite3_close(db);
-		return retval;
+	if ((started = begin_transaction(db, error)) < 0) {
+		put_database(context, db);
+		return started;
 	}
 
-	if ((retval = write_entry(db, newname, ll_time, tty, rhost, pam_service, error) != 0)) {
-		sqlite3_close(db);
-		free(tty);
-		free(rhost);
-		return retval;
+	retval = read_entry(context, db, user, &ll_time, &tty, &rhost, &pam_service, error);
+	if (retval == 0)
+		retval = write_entry(context, db, newname, ll_time, tty, rhost, pam_service, error);
+	if (retval == 0)
+		retval = remove_entry(context, db, user, error);
+
+	if (started) {
+		if (retval == 0)
+			retval = end_transaction(db, 1, error);
+		else
+			end_transaction(db, 0, NULL);
 	}
 
-	retval = remove_entry(db, user, error);
-
-	sqlite3_close(db);
+	put_database(context, db);
 
 	free(tty);
 	free(rhost);
@@ -546,21 +736,22 @@ ll2_import_lastlog(struct ll2_context *context, const char *lastlog_file,
 	struct stat statll;
 	sqlite3 *db;
 	FILE *ll_fp;
-	int retval = 0;
+	int retval = 0, started;
 
-	if ((retval = open_database_rw(context, &db, error)) != 0)
+	if ((retval = get_database(context, 1, &db, error)) != 0)
 		return retval;
 
 	ll_fp = fopen(lastlog_file, "r");
 	if (ll_fp == NULL) {
+		retval = -1;
 		if (error && asprintf(error, "Failed to open '%s': %s",
 				     lastlog_file, strerror(errno)) < 0)
-			return -ENOMEM;
+			retval = -ENOMEM;
 
-		return -1;
+		put_database(context, db);
+		return retval;
 	}
 
-
 	if (fstat(fileno(ll_fp), &statll) != 0) {
 		retval = -1;
 		if (error && asprintf(error, "Cannot get size of '%s': %s",
@@ -570,6 +761,11 @@ ll2_import_lastlog(struct ll2_context *context, const char *lastlog_file,
 		goto done;
 	}
 
+	/* one transaction for all the users */
+	if ((retval = started = begin_transaction(db, error)) < 0)
+		goto done;
+	retval = 0;
+
 	setpwent();
 	while ((pw = getpwent()) != NULL ) {
 		off_t offset;
@@ -599,7 +795,7 @@ ll2_import_lastlog(struct ll2_context *context, const char *lastlog_file,
 				mem2strcpy(tty, ll.ll_line, sizeof(ll.ll_line), sizeof(tty));
 				mem2strcpy(rhost, ll.ll_host, sizeof(ll.ll_host), sizeof(rhost));
 
-				if ((retval = write_entry(db, pw->pw_name, ll_time, tty,
+				if ((retval = write_entry(context, db, pw->pw_name, ll_time, tty,
 							  rhost, NULL, error)) != 0)
 					goto out_import_lastlog;
 			}
@@ -607,8 +803,14 @@ ll2_import_lastlog(struct ll2_context *context, const char *lastlog_file,
 	}
 out_import_lastlog:
 	endpwent();
-	sqlite3_close(db);
+	if (started) {
+		if (retval == 0)
+			retval = end_transaction(db, 1, error);
+		else
+			end_transaction(db, 0, NULL);
+	}
 done:
+	put_database(context, db);
 	fclose(ll_fp);
 
 	return retval;
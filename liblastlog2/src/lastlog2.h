@@ -51,6 +51,15 @@ extern int ll2_write_entry (struct ll2_context *context, const char *user,
 			    const char *rhost, const char *pam_service,
 			    char **error);
 
+/* Starts a batch of changes, written to the database by one transaction.
+   Returns 0 on success, -ENOMEM or -1 on other failure. */
+extern int ll2_begin_batch (struct ll2_context *context, char **error);
+
+/* Writes the changes of the batch, or discards them if commit is zero.
+   Returns 0 on success, -ENOMEM or -1 on other failure. */
+extern int ll2_end_batch (struct ll2_context *context, int commit,
+			  char **error);
+
 /* Calling a defined function for each entry. Returns 0 on success, -ENOMEM or -1 on other failure. */
 extern int ll2_read_all (struct ll2_context *context,
 			 int (*callback)(const char *user, int64_t ll_time,
@@ -30,8 +30,22 @@
 
 #include "lastlog2.h"
 
+/* cached prepared statements */
+enum {
+    LL2_STMT_READ = 0,
+    LL2_STMT_WRITE,
+    LL2_STMT_REMOVE,
+
+    LL2_NSTMTS
+};
+
 struct ll2_context {
     char *lastlog2_path;
+
+    struct sqlite3 *db;		/* database connection, kept open until unref */
+    struct sqlite3_stmt *stmts[LL2_NSTMTS];
+    unsigned int db_rw : 1,	/* the connection is read-write */
+		 db_table : 1;	/* the table has been created */
 };
 
 #endif /* _LIBLASTLOG2_P_H */
@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+/* Test case:
+   Write entries in a batch and commit it, all the entries have to be
+   in the database. Write an entry in a batch and discard it, the entry
+   must not be in the database.
+*/
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lastlog2.h"
+
+#define NUSERS	1000
+
+static int
+check_error (const char *func, char *error)
+{
+	if (error) {
+		fprintf (stderr, "%s: %s\n", func, error);
+		free (error);
+	} else
+		fprintf (stderr, "%s failed\n", func);
+	return 1;
+}
+
+int
+main(void)
+{
+	struct ll2_context *context = ll2_new_context("tst-batch-write.db");
+	char *error = NULL;
+	int64_t ll_time;
+	char user[32];
+	int i, rc = 1;
+
+	if (ll2_begin_batch (context, &error) != 0) {
+		check_error ("ll2_begin_batch", error);
+		goto done;
+	}
+	/* only one batch at a time */
+	if (ll2_begin_batch (context, &error) == 0) {
+		fprintf (stderr, "Nested ll2_begin_batch did not fail!\n");
+		goto done;
+	}
+	free (error);
+	error = NULL;
+
+	for (i = 0; i < NUSERS; i++) {
+		snprintf (user, sizeof(user), "user%d", i);
+		if (ll2_write_entry (context, user, i, "test-tty",
+				     "localhost", "sshd", &error) != 0) {
+			check_error ("ll2_write_entry", error);
+			goto done;
+		}
+	}
+	if (ll2_update_login_time (context, "user0", 4242, &error) != 0) {
+		check_error ("ll2_update_login_time", error);
+		goto done;
+	}
+	if (ll2_end_batch (context, 1, &error) != 0) {
+		check_error ("ll2_end_batch", error);
+		goto done;
+	}
+
+	for (i = 0; i < NUSERS; i++) {
+		snprintf (user, sizeof(user), "user%d", i);
+		if (ll2_read_entry (context, user, &ll_time, NULL, NULL, NULL, &error) != 0) {
+			check_error ("ll2_read_entry", error);
+			goto done;
+		}
+		if (ll_time != (i ? i : 4242)) {
+			fprintf (stderr, "Wrong time for %s: %lld\n", user, (long long int)ll_time);
+			goto done;
+		}
+	}
+
+	/* discarded batch */
+	if (ll2_begin_batch (context, &error) != 0) {
+		check_error ("ll2_begin_batch", error);
+		goto done;
+	}
+	if (ll2_write_entry (context, "discarded", time (NULL), NULL, NULL, NULL, &error) != 0) {
+		check_error ("ll2_write_entry", error);
+		goto done;
+	}
+	if (ll2_end_batch (context, 0, &error) != 0) {
+		check_error ("ll2_end_batch", error);
+		goto done;
+	}
+	if (ll2_read_entry (context, "discarded", &ll_time, NULL, NULL, NULL, &error) == 0) {
+		fprintf (stderr, "Discarded entry found in database!\n");
+		goto done;
+	}
+	free (error);
+
+	rc = 0;
+done:
+	ll2_unref_context(context);
+	return rc;
+}
@@ -500,6 +500,237 @@ static PyObject *Table_next_fs(TableObject *self)
 	return PyObjectResultFs(fs);
 }
 
+/* Fs attributes available for Table.entries() */
+enum {
+	TAB_FIELD_ID,
+	TAB_FIELD_PARENT,
+	TAB_FIELD_DEVNO,
+	TAB_FIELD_FREQ,
+	TAB_FIELD_PASSNO,
+	TAB_FIELD_TID,
+
+	/* strings */
+	TAB_FIELD_FSTYPE,
+	TAB_FIELD_SOURCE,
+	TAB_FIELD_SRCPATH,
+	TAB_FIELD_ROOT,
+	TAB_FIELD_TARGET,
+	TAB_FIELD_OPTIONS,
+	TAB_FIELD_VFS_OPTIONS,
+	TAB_FIELD_OPT_FIELDS,
+	TAB_FIELD_FS_OPTIONS,
+	TAB_FIELD_USR_OPTIONS,
+	TAB_FIELD_ATTRIBUTES,
+	TAB_FIELD_COMMENT,
+	TAB_FIELD_SWAPTYPE
+};
+
+static const struct {
+	const char *name;
+	const char *(*get)(struct libmnt_fs *fs);
+} Table_fields[] = {
+	[TAB_FIELD_ID]		= { "id" },
+	[TAB_FIELD_PARENT]	= { "parent" },
+	[TAB_FIELD_DEVNO]	= { "devno" },
+	[TAB_FIELD_FREQ]	= { "freq" },
+	[TAB_FIELD_PASSNO]	= { "passno" },
+	[TAB_FIELD_TID]		= { "tid" },
+	[TAB_FIELD_FSTYPE]	= { "fstype",	   mnt_fs_get_fstype },
+	[TAB_FIELD_SOURCE]	= { "source",	   mnt_fs_get_source },
+	[TAB_FIELD_SRCPATH]	= { "srcpath",	   mnt_fs_get_srcpath },
+	[TAB_FIELD_ROOT]	= { "root",	   mnt_fs_get_root },
+	[TAB_FIELD_TARGET]	= { "target",	   mnt_fs_get_target },
+	[TAB_FIELD_OPTIONS]	= { "options",	   mnt_fs_get_options },
+	[TAB_FIELD_VFS_OPTIONS]	= { "vfs_options", mnt_fs_get_vfs_options },
+	[TAB_FIELD_OPT_FIELDS]	= { "opt_fields",  mnt_fs_get_optional_fields },
+	[TAB_FIELD_FS_OPTIONS]	= { "fs_options",  mnt_fs_get_fs_options },
+	[TAB_FIELD_USR_OPTIONS]	= { "usr_options", mnt_fs_get_user_options },
+	[TAB_FIELD_ATTRIBUTES]	= { "attributes",  mnt_fs_get_attributes },
+	[TAB_FIELD_COMMENT]	= { "comment",	   mnt_fs_get_comment },
+	[TAB_FIELD_SWAPTYPE]	= { "swaptype",	   mnt_fs_get_swaptype }
+};
+
+static const int Table_default_fields[] = {
+	TAB_FIELD_SOURCE,
+	TAB_FIELD_TARGET,
+	TAB_FIELD_FSTYPE,
+	TAB_FIELD_OPTIONS
+};
+
+/* Returns a new reference; the values are created directly by Python C API
+ * to avoid Py_BuildValue() format parsing for every entry. */
+static PyObject *Table_field_value(struct libmnt_fs *fs, int field)
+{
+	const char *str;
+
+	switch (field) {
+	case TAB_FIELD_ID:
+		return PyLong_FromLong(mnt_fs_get_id(fs));
+	case TAB_FIELD_PARENT:
+		return PyLong_FromLong(mnt_fs_get_parent_id(fs));
+	case TAB_FIELD_DEVNO:
+		return PyLong_FromUnsignedLongLong(mnt_fs_get_devno(fs));
+	case TAB_FIELD_FREQ:
+		return PyLong_FromLong(mnt_fs_get_freq(fs));
+	case TAB_FIELD_PASSNO:
+		return PyLong_FromLong(mnt_fs_get_passno(fs));
+	case TAB_FIELD_TID:
+		return PyLong_FromLong(mnt_fs_get_tid(fs));
+	}
+
+	str = Table_fields[field].get(fs);
+	if (!str)
+		Py_RETURN_NONE;
+
+	/* a few different values shared by many entries */
+	if (field == TAB_FIELD_FSTYPE)
+		return PyUnicode_InternFromString(str);
+
+	return PyUnicode_FromString(str);
+}
+
+/* converts sequence of the field names to array of the field IDs */
+static int *Table_parse_fields(PyObject *seq, Py_ssize_t *nfields)
+{
+	PyObject *fast;
+	Py_ssize_t i;
+	int *res;
+
+	if (!seq || seq == Py_None) {
+		*nfields = ARRAY_SIZE(Table_default_fields);
+		res = PyMem_New(int, *nfields);
+		if (!res)
+			return (int *) PyErr_NoMemory();
+		memcpy(res, Table_default_fields, sizeof(Table_default_fields));
+		return res;
+	}
+
+	fast = PySequence_Fast(seq, "fields must be a sequence of strings");
+	if (!fast)
+		return NULL;
+
+	*nfields = PySequence_Fast_GET_SIZE(fast);
+	res = PyMem_New(int, *nfields ? *nfields : 1);
+	if (!res) {
+		Py_DECREF(fast);
+		return (int *) PyErr_NoMemory();
+	}
+
+	for (i = 0; i < *nfields; i++) {
+		PyObject *item = PySequence_Fast_GET_ITEM(fast, i);
+		const char *name = PyUnicode_Check(item) ? PyUnicode_AsUTF8(item) : NULL;
+		size_t x;
+
+		if (!name) {
+			PyErr_SetString(PyExc_TypeError, "field name must be a string");
+			goto err;
+		}
+		for (x = 0; x < ARRAY_SIZE(Table_fields); x++) {
+			if (strcmp(Table_fields[x].name, name) == 0)
+				break;
+		}
+		if (x == ARRAY_SIZE(Table_fields)) {
+			PyErr_Format(PyExc_ValueError, "unknown field '%s'", name);
+			goto err;
+		}
+		res[i] = x;
+	}
+	Py_DECREF(fast);
+	return res;
+err:
+	Py_DECREF(fast);
+	PyMem_Free(res);
+	return NULL;
+}
+
+#define Table_entries_HELP "entries(fields=None, columns=False)\n\n" \
+		"Returns all entries of the table in one call without creating\n" \
+		"Fs objects. The fields is a sequence of Fs attribute names\n" \
+		"(id, parent, devno, freq, passno, tid, fstype, source, srcpath,\n" \
+		"root, target, options, vfs_options, opt_fields, fs_options,\n" \
+		"usr_options, attributes, comment, swaptype), the default is\n" \
+		"(source, target, fstype, options).\n" \
+		"\n" \
+		"Returns list of tuples (one tuple for each entry), or a dictionary\n" \
+		"with a list of values for each field if columns is True."
+static PyObject *Table_entries(TableObject *self, PyObject *args, PyObject *kwds)
+{
+	struct libmnt_iter *itr = NULL;
+	struct libmnt_fs *fs;
+	PyObject *fields = NULL, *res = NULL, **cols = NULL;
+	Py_ssize_t nfields = 0, nents, n = 0, i;
+	int columns = 0, *ids;
+	char *kwlist[] = {"fields", "columns", NULL};
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|Op", kwlist, &fields, &columns))
+		return NULL;
+
+	ids = Table_parse_fields(fields, &nfields);
+	if (!ids)
+		return NULL;
+
+	nents = mnt_table_get_nents(self->tab);
+
+	if (columns) {
+		res = PyDict_New();
+		cols = PyMem_New(PyObject *, nfields ? nfields : 1);
+		if (!res || !cols)
+			goto nomem;
+		for (i = 0; i < nfields; i++) {
+			cols[i] = PyList_New(nents);
+			if (!cols[i] || PyDict_SetItemString(res,
+					Table_fields[ids[i]].name, cols[i]) != 0) {
+				Py_XDECREF(cols[i]);
+				goto err;
+			}
+			Py_DECREF(cols[i]);	/* owned by the dictionary */
+		}
+	} else {
+		res = PyList_New(nents);
+		if (!res)
+			goto nomem;
+	}
+
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+	if (!itr)
+		goto nomem;
+
+	while (n < nents && mnt_table_next_fs(self->tab, itr, &fs) == 0) {
+		PyObject *tuple = NULL;
+
+		if (!columns) {
+			tuple = PyTuple_New(nfields);
+			if (!tuple)
+				goto err;
+			PyList_SET_ITEM(res, n, tuple);
+		}
+		for (i = 0; i < nfields; i++) {
+			PyObject *val = Table_field_value(fs, ids[i]);
+
+			if (!val)
+				goto err;
+			if (columns)
+				PyList_SET_ITEM(cols[i], n, val);
+			else
+				PyTuple_SET_ITEM(tuple, i, val);
+		}
+		n++;
+	}
+
+	mnt_free_iter(itr);
+	PyMem_Free(cols);
+	PyMem_Free(ids);
+	return res;
+nomem:
+	PyErr_NoMemory();
+err:
+	Py_XDECREF(res);
+	mnt_free_iter(itr);
+	PyMem_Free(cols);
+	PyMem_Free(ids);
+	return NULL;
+}
+
 static PyMethodDef Table_methods[] = {
 	{"enable_comments", (PyCFunction)Table_enable_comments, METH_VARARGS|METH_KEYWORDS, Table_enable_comments_HELP},
 	{"find_pair", (PyCFunction)Table_find_pair, METH_VARARGS|METH_KEYWORDS, Table_find_pair_HELP},
@@ -518,6 +749,7 @@ static PyMethodDef Table_methods[] = {
 	{"add_fs", (PyCFunction)Table_add_fs, METH_VARARGS|METH_KEYWORDS, Table_add_fs_HELP},
 	{"remove_fs", (PyCFunction)Table_remove_fs, METH_VARARGS|METH_KEYWORDS, Table_remove_fs_HELP},
 	{"next_fs", (PyCFunction)Table_next_fs, METH_NOARGS, Table_next_fs_HELP},
+	{"entries", (PyCFunction)Table_entries, METH_VARARGS|METH_KEYWORDS, Table_entries_HELP},
 	{"write_file", (PyCFunction)Table_write_file, METH_VARARGS|METH_KEYWORDS, Table_write_file_HELP},
 	{"replace_file", (PyCFunction)Table_replace_file, METH_VARARGS|METH_KEYWORDS, Table_replace_file_HELP},
 	{NULL}
@@ -151,6 +151,24 @@ def test_find_mountpoint(ts, argv):
 	fs.print_debug()
 	return 0
 
+def test_entries(ts, argv):
+	tb = create_table(argv[1], False)
+	if not tb:
+		return -1
+	fields = argv[2:] if len(argv) > 2 else None
+	for e in tb.entries(fields):
+		print(e)
+	return 0
+
+def test_entries_columns(ts, argv):
+	tb = create_table(argv[1], False)
+	if not tb:
+		return -1
+	fields = argv[2:] if len(argv) > 2 else None
+	for name, values in tb.entries(fields, columns=True).items():
+		print(name, values)
+	return 0
+
 
 tss = (
 	( "--parse",    test_parse,        "<file> [--comments] parse and print(tab" ),
@@ -160,5 +178,7 @@ tss = (
 	( "--find-mountpoint", test_find_mountpoint, "<path>" ),
 	( "--copy-fs",       test_copy_fs, "<file>  copy root FS from the file" ),
 	( "--is-mounted",    test_is_mounted, "<fstab> check what from <file> are already mounted" ),
+	( "--entries",       test_entries, "<file> [<field> ...] print entries by Table.entries()" ),
+	( "--entries-columns", test_entries_columns, "<file> [<field> ...] print columns by Table.entries()" ),
 )
 sys.exit(mnt_run_test(tss, sys.argv))
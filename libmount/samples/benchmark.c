@@ -0,0 +1,544 @@
+/*
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * Mount table benchmark. The program generates synthetic mountinfo, fstab
+ * and utab files (nested bind mounts, overlays, long mangled paths, ...) and
+ * measures parsing, lookups by mnt_table_find_* functions, mnt_diff_tables()
+ * and memory used by the parsed table. The results are printed as one JSON
+ * object per line.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include <libmount.h>
+
+#include "c.h"
+
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+# include <malloc.h>
+# define HAVE_MALLINFO2	1
+#endif
+
+/* lines for the mnt_diff_tables() test: 1 % of the entries is unmounted,
+ * 1 % is remounted and 1 % is newly mounted */
+#define DIFF_RATIO	100
+
+struct bench {
+	const char	*dir;
+	char		*mountinfo;
+	char		*mountinfo_new;
+	char		*fstab;
+	char		*utab;
+
+	unsigned long	nents;
+	unsigned long	niter;
+	unsigned long	nlookups;
+
+	struct libmnt_cache *cache;
+};
+
+struct lookup {
+	const char	*name;
+	int		(*find)(struct libmnt_table *tb, struct libmnt_fs *fs);
+};
+
+static uint64_t cpu_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* allocated memory in KiB, or RSS if malloc statistic is not available */
+static long memory_kib(void)
+{
+#ifdef HAVE_MALLINFO2
+	struct mallinfo2 mi = mallinfo2();
+
+	return (mi.uordblks + mi.hblkhd) / 1024;
+#else
+	FILE *f = fopen("/proc/self/statm", "r");
+	long size, rss = 0;
+
+	if (f) {
+		if (fscanf(f, "%ld %ld", &size, &rss) != 2)
+			rss = 0;
+		fclose(f);
+	}
+	return rss * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+}
+
+/*
+ * The mount tree: every container has an overlay root, some bind mounts from
+ * a shared device, tmpfs, proc and a nested bind mount; between containers
+ * are NFS mounts and mounts with long names with mangled (space and tab)
+ * characters.
+ */
+static void write_mountinfo_line(FILE *f, unsigned long i, int remount)
+{
+	unsigned long id = i + 100;
+	unsigned long ct = i / 8;		/* container number */
+	unsigned long ctid = ct * 8 + 100;	/* container root mount ID */
+	const char *rw = remount ? "ro" : "rw";
+
+	switch (i % 8) {
+	case 0:
+		fprintf(f, "%lu 1 0:%lu / /var/lib/containers/c%lu/merged %s,relatime shared:%lu - overlay overlay "
+			   "rw,lowerdir=/var/lib/containers/l%lu/diff:/var/lib/containers/base/diff,"
+			   "upperdir=/var/lib/containers/c%lu/diff,workdir=/var/lib/containers/c%lu/work\n",
+			id, 100 + ct % 1000, ct, rw, id, ct, ct, ct);
+		break;
+	case 1:
+	case 2:
+		fprintf(f, "%lu %lu 8:1 /volumes/v%lu /var/lib/containers/c%lu/merged/srv/vol%lu %s,nosuid,nodev,relatime master:1 - ext4 /dev/sda1 rw,errors=remount-ro\n",
+			id, ctid, i, ct, i % 8, rw);
+		break;
+	case 3:
+		fprintf(f, "%lu %lu 0:%lu / /var/lib/containers/c%lu/merged/run %s,nosuid,nodev - tmpfs tmpfs rw,size=65536k,mode=755\n",
+			id, ctid, 2000 + i % 1000, ct, rw);
+		break;
+	case 4:
+		fprintf(f, "%lu %lu 0:%lu / /var/lib/containers/c%lu/merged/proc %s,nosuid,nodev,noexec,relatime - proc proc rw\n",
+			id, ctid, 4000 + i % 1000, ct, rw);
+		break;
+	case 5:
+		/* nested bind mount of the bind mount */
+		fprintf(f, "%lu %lu 8:1 /volumes/v%lu/data /var/lib/containers/c%lu/merged/srv/vol1/data %s,relatime master:1 - ext4 /dev/sda1 rw\n",
+			id, id - 4, i - 4, ct, rw);
+		break;
+	case 6:
+		fprintf(f, "%lu 1 0:%lu / /net/server%lu/export%lu %s,relatime - nfs4 server%lu:/export/%lu "
+			   "rw,vers=4.2,rsize=1048576,wsize=1048576,namlen=255,hard,proto=tcp,timeo=600,retrans=2,sec=sys\n",
+			id, 6000 + i % 1000, ct % 16, i, rw, ct % 16, i);
+		break;
+	case 7:
+		fprintf(f, "%lu 1 8:%lu / /srv/shared\\040data/user\\040%lu/"
+			   "a\\040very\\040long\\040directory\\040name\\040with\\040spaces\\011and\\011tabs/"
+			   "%lu-0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef "
+			   "%s,noatime - xfs /dev/sd%c%lu rw,attr2,inode64,logbufs=8,logbsize=32k,noquota\n",
+			id, 16 + i % 16, ct, i, rw, 'b' + (int) (ct % 24), 1 + i % 16);
+		break;
+	}
+}
+
+static FILE *open_file(struct bench *bc, char **path, const char *name)
+{
+	FILE *f;
+
+	if (asprintf(path, "%s/%s", bc->dir, name) < 0)
+		err(EXIT_FAILURE, "cannot allocate path");
+	f = fopen(*path, "w" UL_CLOEXECSTR);
+	if (!f)
+		err(EXIT_FAILURE, "%s: cannot open", *path);
+	return f;
+}
+
+static void close_file(FILE *f, const char *path)
+{
+	if (ferror(f) | fclose(f))
+		err(EXIT_FAILURE, "%s: write failed", path);
+}
+
+static void generate_files(struct bench *bc)
+{
+	unsigned long i;
+	FILE *f;
+
+	/* mountinfo */
+	f = open_file(bc, &bc->mountinfo, "mountinfo");
+	fputs("1 0 253:0 / / rw,relatime shared:1 - ext4 /dev/vda1 rw\n", f);
+	for (i = 0; i < bc->nents; i++)
+		write_mountinfo_line(f, i, 0);
+	close_file(f, bc->mountinfo);
+
+	/* mountinfo for diff */
+	f = open_file(bc, &bc->mountinfo_new, "mountinfo.new");
+	fputs("1 0 253:0 / / rw,relatime shared:1 - ext4 /dev/vda1 rw\n", f);
+	for (i = 0; i < bc->nents + bc->nents / DIFF_RATIO; i++) {
+		if (i % DIFF_RATIO == DIFF_RATIO / 2 && i < bc->nents)
+			continue;
+		write_mountinfo_line(f, i, i % DIFF_RATIO == DIFF_RATIO / 4);
+	}
+	close_file(f, bc->mountinfo_new);
+
+	/* utab, userspace options for every 4th mount */
+	f = open_file(bc, &bc->utab, "utab");
+	for (i = 0; i < bc->nents; i += 4)
+		fprintf(f, "ID=%lu SRC=/dev/sda1 TARGET=/var/lib/containers/c%lu/merged/srv/vol1 "
+			   "ROOT=/volumes/v%lu OPTS=x-container.id=%lu,x-initrd.mount\n",
+			i + 101, i / 8, i + 1, i / 8);
+	close_file(f, bc->utab);
+
+	/* fstab */
+	f = open_file(bc, &bc->fstab, "fstab");
+	fputs("# generated by sample-mount-benchmark\n", f);
+	for (i = 0; i < bc->nents; i++) {
+		switch (i % 4) {
+		case 0:
+			fprintf(f, "UUID=%08lx-1b2c-4d3e-8f40-%012lx /mnt/disk%lu ext4 defaults,noatime 0 2\n",
+				i, i * 7919, i);
+			break;
+		case 1:
+			fprintf(f, "LABEL=data%lu /srv/data\\040%lu xfs defaults,nofail,x-systemd.device-timeout=5s 0 0\n",
+				i, i);
+			break;
+		case 2:
+			fprintf(f, "server%lu:/export/%lu /net/server%lu/export%lu nfs4 rw,hard,_netdev 0 0\n",
+				i % 16, i, i % 16, i);
+			break;
+		case 3:
+			fprintf(f, "/dev/mapper/vg-lv%lu /var/lib/volumes/lv%lu btrfs subvol=/@%lu,compress=zstd 0 0\n",
+				i, i, i);
+			break;
+		}
+	}
+	close_file(f, bc->fstab);
+}
+
+static void remove_files(struct bench *bc)
+{
+	unlink(bc->mountinfo);
+	unlink(bc->mountinfo_new);
+	unlink(bc->utab);
+	unlink(bc->fstab);
+}
+
+enum {
+	TAB_MOUNTINFO,
+	TAB_MTAB,		/* mountinfo + utab */
+	TAB_FSTAB
+};
+
+static const char *tabnames[] = {
+	[TAB_MOUNTINFO] = "mountinfo",
+	[TAB_MTAB] = "mountinfo+utab",
+	[TAB_FSTAB] = "fstab"
+};
+
+static struct libmnt_table *parse_table(struct bench *bc, int type)
+{
+	struct libmnt_table *tb = mnt_new_table();
+	int rc = -ENOMEM;
+
+	if (!tb)
+		goto err;
+	if (bc->cache)
+		mnt_table_set_cache(tb, bc->cache);
+
+	switch (type) {
+	case TAB_MOUNTINFO:
+		rc = mnt_table_parse_file(tb, bc->mountinfo);
+		break;
+	case TAB_MTAB:
+		rc = mnt_table_parse_mtab(tb, bc->mountinfo);
+		break;
+	case TAB_FSTAB:
+		rc = mnt_table_parse_fstab(tb, bc->fstab);
+		break;
+	}
+	if (rc == 0)
+		return tb;
+err:
+	errno = -rc;
+	err(EXIT_FAILURE, "cannot parse %s table", tabnames[type]);
+}
+
+/*
+ * The lookup functions return 1 if found, 0 if not found, and -1 if the
+ * lookup is not applicable for the entry (e.g. no tag in fstab entry).
+ */
+#define found(_x)	((_x) ? 1 : 0)
+
+static int find_target(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	return found(mnt_table_find_target(tb, mnt_fs_get_target(fs), MNT_ITER_BACKWARD));
+}
+
+static int find_srcpath(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	const char *path = mnt_fs_get_srcpath(fs);
+
+	if (!path)
+		return -1;
+	return found(mnt_table_find_srcpath(tb, path, MNT_ITER_BACKWARD));
+}
+
+static int find_source(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	return found(mnt_table_find_source(tb, mnt_fs_get_source(fs), MNT_ITER_BACKWARD));
+}
+
+static int find_tag(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	const char *tag = NULL, *val = NULL;
+
+	if (mnt_fs_get_tag(fs, &tag, &val) != 0)
+		return -1;
+	return found(mnt_table_find_tag(tb, tag, val, MNT_ITER_BACKWARD));
+}
+
+static int find_pair(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	return found(mnt_table_find_pair(tb, mnt_fs_get_source(fs),
+				mnt_fs_get_target(fs), MNT_ITER_BACKWARD));
+}
+
+static int find_devno(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	return found(mnt_table_find_devno(tb, mnt_fs_get_devno(fs), MNT_ITER_BACKWARD));
+}
+
+static int find_target_with_option(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	char *val = NULL;
+	size_t valsz = 0;
+
+	if (mnt_fs_get_option(fs, "errors", &val, &valsz) != 0 || valsz != 10)
+		return -1;
+	return found(mnt_table_find_target_with_option(tb, mnt_fs_get_target(fs),
+				"errors", "remount-ro", MNT_ITER_BACKWARD));
+}
+
+/* mnt_table_find_mountpoint() is not tested, it requires existing paths */
+static const struct lookup kernel_lookups[] = {
+	{ "find_target", find_target },
+	{ "find_srcpath", find_srcpath },
+	{ "find_source", find_source },
+	{ "find_pair", find_pair },
+	{ "find_devno", find_devno },
+	{ "find_target_with_option", find_target_with_option },
+	{ NULL }
+};
+
+static const struct lookup fstab_lookups[] = {
+	{ "find_target", find_target },
+	{ "find_srcpath", find_srcpath },
+	{ "find_source", find_source },
+	{ "find_tag", find_tag },
+	{ "find_pair", find_pair },
+	{ NULL }
+};
+
+/* returns array of entries used for lookups */
+static struct libmnt_fs **get_lookup_entries(struct bench *bc,
+				struct libmnt_table *tb, size_t *nfs)
+{
+	struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_FORWARD);
+	struct libmnt_fs *fs, **res;
+	size_t ntab = mnt_table_get_nents(tb), step, n = 0, i = 0;
+
+	*nfs = min((size_t) bc->nlookups, ntab);
+	res = calloc(*nfs ? *nfs : 1, sizeof(struct libmnt_fs *));
+	if (!itr || !res)
+		err(EXIT_FAILURE, "cannot allocate lookup entries");
+
+	step = *nfs ? ntab / *nfs : 1;
+	while (n < *nfs && mnt_table_next_fs(tb, itr, &fs) == 0) {
+		if (i++ % step == 0)
+			res[n++] = fs;
+	}
+	*nfs = n;
+	mnt_free_iter(itr);
+	return res;
+}
+
+static void bench_table(struct bench *bc, int type)
+{
+	const struct lookup *lk;
+	struct libmnt_table *tb;
+	struct libmnt_fs **fss;
+	uint64_t start, nsec = 0;
+	long mem;
+	size_t nfs, i;
+	unsigned long n;
+	int nents;
+
+	/* memory used by one table */
+	mem = memory_kib();
+	tb = parse_table(bc, type);
+	mem = memory_kib() - mem;
+	nents = mnt_table_get_nents(tb);
+	mnt_unref_table(tb);
+
+	for (n = 0; n < bc->niter; n++) {
+		start = cpu_nsec();
+		tb = parse_table(bc, type);
+		nsec += cpu_nsec() - start;
+		mnt_unref_table(tb);
+	}
+
+	printf("{\"table\":\"%s\",\"entries\":%d,\"iterations\":%lu"
+	       ",\"parse_usec\":%.1f,\"parse_nsec_per_entry\":%.1f,\"memory_kib\":%ld",
+		tabnames[type], nents, bc->niter,
+		(double) nsec / bc->niter / 1000,
+		nents ? (double) nsec / bc->niter / nents : 0.0,
+		mem);
+
+	tb = parse_table(bc, type);
+	fss = get_lookup_entries(bc, tb, &nfs);
+
+	for (lk = type == TAB_FSTAB ? fstab_lookups : kernel_lookups; lk->name; lk++) {
+		size_t nfound = 0, ntested = 0;
+
+		start = cpu_nsec();
+		for (i = 0; i < nfs; i++) {
+			int rc = lk->find(tb, fss[i]);
+
+			if (rc < 0)
+				continue;
+			ntested++;
+			nfound += rc;
+		}
+		nsec = cpu_nsec() - start;
+
+		if (nfound != ntested)
+			warnx("%s: %s: found %zu from %zu entries",
+				tabnames[type], lk->name, nfound, ntested);
+		printf(",\"%s_usec\":%.2f", lk->name,
+				ntested ? (double) nsec / ntested / 1000 : 0.0);
+	}
+	free(fss);
+
+	if (type == TAB_MOUNTINFO) {
+		struct libmnt_tabdiff *df = mnt_new_tabdiff();
+		struct libmnt_table *tb_new = mnt_new_table();
+		int nchanges = 0;
+
+		if (!df || !tb_new || mnt_table_parse_file(tb_new, bc->mountinfo_new) != 0)
+			err(EXIT_FAILURE, "cannot initialize diff");
+
+		nsec = 0;
+		for (n = 0; n < bc->niter; n++) {
+			start = cpu_nsec();
+			nchanges = mnt_diff_tables(df, tb, tb_new);
+			nsec += cpu_nsec() - start;
+			if (nchanges < 0)
+				errx(EXIT_FAILURE, "mnt_diff_tables() failed");
+		}
+		printf(",\"diff_usec\":%.1f,\"diff_changes\":%d",
+				(double) nsec / bc->niter / 1000, nchanges);
+
+		mnt_free_tabdiff(df);
+		mnt_unref_table(tb_new);
+	}
+
+	mnt_unref_table(tb);
+	fputs("}\n", stdout);
+	fflush(stdout);
+}
+
+static void __attribute__((__noreturn__)) usage(int status)
+{
+	fprintf(status ? stderr : stdout, "usage: %s [options]\n"
+			"  -n, --entries N     number of entries in generated tables (default 1000),\n"
+			"                      may be specified more than once\n"
+			"  -i, --iterations N  number of parse and diff iterations (default 10)\n"
+			"  -l, --lookups N     number of lookups for each function (default 100)\n"
+			"  -c, --cache         use libmount cache (canonicalize paths on lookups)\n"
+			"  -d, --dir DIR       generate the tables to DIR and keep them\n"
+			"  -h, --help          display this help\n",
+			program_invocation_short_name);
+	exit(status);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option longopts[] = {
+		{ "entries",	required_argument, NULL, 'n' },
+		{ "iterations",	required_argument, NULL, 'i' },
+		{ "lookups",	required_argument, NULL, 'l' },
+		{ "cache",	no_argument,       NULL, 'c' },
+		{ "dir",	required_argument, NULL, 'd' },
+		{ "help",	no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	struct bench bc = { .niter = 10, .nlookups = 100 };
+	unsigned long *entries = NULL;
+	size_t nentries = 0, i;
+	char *tmpdir = NULL;
+	int c, cache = 0;
+
+	while ((c = getopt_long(argc, argv, "n:i:l:cd:h", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'n':
+			entries = realloc(entries, (nentries + 1) * sizeof(*entries));
+			if (!entries)
+				err(EXIT_FAILURE, "cannot allocate entries");
+			entries[nentries] = strtoul(optarg, NULL, 10);
+			if (!entries[nentries])
+				errx(EXIT_FAILURE, "invalid number of entries: %s", optarg);
+			nentries++;
+			break;
+		case 'i':
+			bc.niter = strtoul(optarg, NULL, 10);
+			if (!bc.niter)
+				errx(EXIT_FAILURE, "invalid number of iterations: %s", optarg);
+			break;
+		case 'l':
+			bc.nlookups = strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			cache = 1;
+			break;
+		case 'd':
+			bc.dir = optarg;
+			break;
+		case 'h':
+			usage(EXIT_SUCCESS);
+		default:
+			usage(EXIT_FAILURE);
+		}
+	}
+	if (optind < argc)
+		usage(EXIT_FAILURE);
+
+	if (!bc.dir) {
+		const char *tmp = getenv("TMPDIR");
+
+		if (asprintf(&tmpdir, "%s/mount-benchmark.XXXXXX", tmp ? tmp : "/tmp") < 0
+		    || !mkdtemp(tmpdir))
+			err(EXIT_FAILURE, "cannot create temporary directory");
+		bc.dir = tmpdir;
+	}
+
+	for (i = 0; i < (nentries ? nentries : 1); i++) {
+		bc.nents = nentries ? entries[i] : 1000;
+		generate_files(&bc);
+
+		/* utab is read by mnt_table_parse_mtab() */
+		setenv("LIBMOUNT_UTAB", bc.utab, 1);
+
+		if (cache)
+			bc.cache = mnt_new_cache();
+
+		bench_table(&bc, TAB_MOUNTINFO);
+		bench_table(&bc, TAB_MTAB);
+		bench_table(&bc, TAB_FSTAB);
+
+		mnt_unref_cache(bc.cache);
+		bc.cache = NULL;
+
+		if (tmpdir)
+			remove_files(&bc);
+		free(bc.mountinfo);
+		free(bc.mountinfo_new);
+		free(bc.utab);
+		free(bc.fstab);
+	}
+
+	if (tmpdir)
+		rmdir(tmpdir);
+	free(entries);
+	free(tmpdir);
+	return EXIT_SUCCESS;
+}
@@ -20,6 +20,11 @@
  * paths. The cache uses libblkid as a backend for TAGs resolution.
  *
  * All returned paths are always canonicalized.
+ *
+ * The cache is internally hashed, so the lookups do not depend on the number
+ * of cached entries. Long-running processes may limit the number of the
+ * entries by mnt_cache_set_limit() and drop the results related to the old
+ * mount table by mnt_cache_invalidate() or mnt_monitor_set_cache().
  */
 #include <string.h>
 #include <stdlib.h>
@@ -38,7 +43,8 @@
 /*
  * Canonicalized (resolved) paths & tags cache
  */
-#define MNT_CACHE_CHUNKSZ	128
+#define MNT_CACHE_MINBUCKETS	64
+#define MNT_CACHE_MINLIMIT	64
 
 #define MNT_CACHE_ISTAG		(1 << 1) /* entry is TAG */
 #define MNT_CACHE_ISPATH	(1 << 2) /* entry is path */
@@ -49,12 +55,28 @@ struct mnt_cache_entry {
 	char			*key;	/* search key (e.g. uncanonicalized path) */
 	char			*value;	/* value (e.g. canonicalized path) */
 	int			flag;
+	unsigned int		generation;
+
+	size_t			keyhash;
+	size_t			valhash;	/* tags only */
+
+	struct mnt_cache_entry	*keynext;	/* hash chains */
+	struct mnt_cache_entry	*valnext;
+	struct list_head	lru;		/* cache->lru or cache->retired */
 };
 
 struct libmnt_cache {
-	struct mnt_cache_entry	*ents;
+	struct mnt_cache_entry	**keys;		/* hashed by key */
+	struct mnt_cache_entry	**values;	/* hashed by value (tags only) */
+	size_t			nbuckets;	/* power of 2 */
+
+	struct list_head	lru;		/* the least recently used first */
+	struct list_head	retired;	/* evicted or stale entries */
 	size_t			nents;
-	size_t			nallocs;
+	size_t			nretired;
+	size_t			limit;		/* max entries or 0 */
+	unsigned int		generation;
+
 	int			refcount;
 	int			probe_sb_extra;	/* extra BLKID_SUBLKS_* flags */
 
@@ -69,9 +91,130 @@ struct libmnt_cache {
 	 */
 	blkid_cache		bc;
 
+	struct canon_cache	*canon;		/* canonicalized directories */
+
 	struct libmnt_table	*mountinfo;
 };
 
+static size_t hash_tag(const char *token, const char *value)
+{
+	uint32_t h = 2166136261U;	/* FNV-1a */
+
+	for (; *token; token++)
+		h = (h ^ (unsigned char) *token) * 16777619U;
+	h = (h ^ '=') * 16777619U;
+	for (; *value; value++)
+		h = (h ^ (unsigned char) *value) * 16777619U;
+	return h;
+}
+
+static inline struct mnt_cache_entry **key_bucket(struct libmnt_cache *cache,
+						   size_t hash)
+{
+	return &cache->keys[hash & (cache->nbuckets - 1)];
+}
+
+static inline struct mnt_cache_entry **value_bucket(struct libmnt_cache *cache,
+						     size_t hash)
+{
+	return &cache->values[hash & (cache->nbuckets - 1)];
+}
+
+static void free_retired_entries(struct libmnt_cache *cache)
+{
+	while (!list_empty(&cache->retired)) {
+		struct mnt_cache_entry *e = list_entry(cache->retired.next,
+						struct mnt_cache_entry, lru);
+		list_del(&e->lru);
+		if (e->value != e->key)
+			free(e->value);
+		free(e->key);
+		free(e);
+	}
+	cache->nretired = 0;
+}
+
+/*
+ * Removes the entry from the hash chains. The strings are not deallocated
+ * immediately, because the caller may still use the results returned from
+ * the cache. They are freed by mnt_cache_invalidate() or when there are too
+ * many retired entries.
+ */
+static void retire_entry(struct libmnt_cache *cache, struct mnt_cache_entry *e)
+{
+	struct mnt_cache_entry **pp;
+
+	for (pp = key_bucket(cache, e->keyhash); *pp; pp = &(*pp)->keynext) {
+		if (*pp == e) {
+			*pp = e->keynext;
+			break;
+		}
+	}
+	if (e->flag & MNT_CACHE_ISTAG) {
+		for (pp = value_bucket(cache, e->valhash); *pp; pp = &(*pp)->valnext) {
+			if (*pp == e) {
+				*pp = e->valnext;
+				break;
+			}
+		}
+	}
+	list_del(&e->lru);
+	list_add_tail(&e->lru, &cache->retired);
+	cache->nents--;
+	cache->nretired++;
+}
+
+static int resize_buckets(struct libmnt_cache *cache, size_t nbuckets)
+{
+	struct mnt_cache_entry **keys, **values;
+	struct list_head *p;
+
+	keys = calloc(nbuckets, sizeof(struct mnt_cache_entry *));
+	values = calloc(nbuckets, sizeof(struct mnt_cache_entry *));
+	if (!keys || !values) {
+		free(keys);
+		free(values);
+		return -ENOMEM;
+	}
+
+	free(cache->keys);
+	free(cache->values);
+	cache->keys = keys;
+	cache->values = values;
+	cache->nbuckets = nbuckets;
+
+	list_for_each(p, &cache->lru) {
+		struct mnt_cache_entry *e = list_entry(p, struct mnt_cache_entry, lru);
+		struct mnt_cache_entry **head = key_bucket(cache, e->keyhash);
+
+		e->keynext = *head;
+		*head = e;
+		if (e->flag & MNT_CACHE_ISTAG) {
+			head = value_bucket(cache, e->valhash);
+			e->valnext = *head;
+			*head = e;
+		}
+	}
+	return 0;
+}
+
+/* Returns 1 if the entry is usable, stale entries are retired */
+static int is_valid_entry(struct libmnt_cache *cache, struct mnt_cache_entry *e)
+{
+	if (e->generation == cache->generation)
+		return 1;
+
+	DBG(CACHE, ul_debugobj(cache, "retire stale entry: %s", e->key));
+	retire_entry(cache, e);
+	return 0;
+}
+
+static inline void touch_entry(struct libmnt_cache *cache, struct mnt_cache_entry *e)
+{
+	list_del(&e->lru);
+	list_add_tail(&e->lru, &cache->lru);
+}
+
 /**
  * mnt_new_cache:
  *
@@ -84,6 +227,8 @@ struct libmnt_cache *mnt_new_cache(void)
 		return NULL;
 	DBG(CACHE, ul_debugobj(cache, "alloc"));
 	cache->refcount = 1;
+	INIT_LIST_HEAD(&cache->lru);
+	INIT_LIST_HEAD(&cache->retired);
 	return cache;
 }
 
@@ -96,22 +241,18 @@ struct libmnt_cache *mnt_new_cache(void)
  */
 void mnt_free_cache(struct libmnt_cache *cache)
 {
-	size_t i;
-
 	if (!cache)
 		return;
 
 	DBG(CACHE, ul_debugobj(cache, "free [refcount=%d]", cache->refcount));
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
-		if (e->value != e->key)
-			free(e->value);
-		free(e->key);
-	}
-	free(cache->ents);
+	list_splice(&cache->lru, &cache->retired);
+	free_retired_entries(cache);
+	free(cache->keys);
+	free(cache->values);
 	if (cache->bc)
 		blkid_put_cache(cache->bc);
+	free_canon_cache(cache->canon);
 	free(cache);
 }
 
@@ -168,6 +309,9 @@ int mnt_cache_set_targets(struct libmnt_cache *cache,
 	mnt_ref_table(mountinfo);
 	mnt_unref_table(cache->mountinfo);
 	cache->mountinfo = mountinfo;
+
+	/* the mount table has been changed, cached directories may be obsolete */
+	canonicalize_cache_reset(cache->canon);
 	return 0;
 }
 
@@ -193,32 +337,59 @@ int mnt_cache_set_sbprobe(struct libmnt_cache *cache, int flags)
 static int cache_add_entry(struct libmnt_cache *cache, char *key,
 					char *value, int flag)
 {
-	struct mnt_cache_entry *e;
+	struct mnt_cache_entry *e, **head;
 
 	assert(cache);
 	assert(value);
 	assert(key);
 
-	if (cache->nents == cache->nallocs) {
-		size_t sz = cache->nallocs + MNT_CACHE_CHUNKSZ;
+	if (cache->nents >= cache->nbuckets &&
+	    resize_buckets(cache, cache->nbuckets ?
+				  cache->nbuckets << 1 : MNT_CACHE_MINBUCKETS))
+		return -ENOMEM;
 
-		e = reallocarray(cache->ents, sz, sizeof(struct mnt_cache_entry));
-		if (!e)
-			return -ENOMEM;
-		cache->ents = e;
-		cache->nallocs = sz;
-	}
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		return -ENOMEM;
 
-	e = &cache->ents[cache->nents];
 	e->key = key;
 	e->value = value;
 	e->flag = flag;
+	e->generation = cache->generation;
+
+	if (flag & MNT_CACHE_ISTAG) {
+		e->keyhash = hash_tag(key, key + strlen(key) + 1);
+		e->valhash = ul_hash_path(value);
+
+		head = value_bucket(cache, e->valhash);
+		e->valnext = *head;
+		*head = e;
+	} else
+		e->keyhash = ul_hash_path(key);
+
+	head = key_bucket(cache, e->keyhash);
+	e->keynext = *head;
+	*head = e;
+
+	list_add_tail(&e->lru, &cache->lru);
 	cache->nents++;
 
 	DBG(CACHE, ul_debugobj(cache, "add entry [%2zd] (%s): %s: %s",
 			cache->nents,
 			(flag & MNT_CACHE_ISPATH) ? "path" : "tag",
 			value, key));
+
+	/* evict the least recently used entries */
+	while (cache->limit && cache->nents > cache->limit) {
+		struct mnt_cache_entry *x = list_entry(cache->lru.next,
+						struct mnt_cache_entry, lru);
+		retire_entry(cache, x);
+	}
+	if (cache->limit && cache->nretired > cache->limit / 2) {
+		DBG(CACHE, ul_debugobj(cache, "free %zu retired entries",
+					cache->nretired));
+		free_retired_entries(cache);
+	}
 	return 0;
 }
 
@@ -263,17 +434,19 @@ static int cache_add_tag(struct libmnt_cache *cache, const char *tagname,
  */
 static const char *cache_find_path(struct libmnt_cache *cache, const char *path)
 {
-	size_t i;
+	struct mnt_cache_entry *e, *next;
 
-	if (!cache || !path)
+	if (!cache || !path || !cache->nents)
 		return NULL;
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	for (e = *key_bucket(cache, ul_hash_path(path)); e; e = next) {
+		next = e->keynext;
 		if (!(e->flag & MNT_CACHE_ISPATH))
 			continue;
-		if (streq_paths(path, e->key))
+		if (streq_paths(path, e->key) && is_valid_entry(cache, e)) {
+			touch_entry(cache, e);
 			return e->value;
+		}
 	}
 	return NULL;
 }
@@ -284,46 +457,142 @@ static const char *cache_find_path(struct libmnt_cache *cache, const char *path)
 static const char *cache_find_tag(struct libmnt_cache *cache,
 			const char *token, const char *value)
 {
-	size_t i;
+	struct mnt_cache_entry *e, *next;
 	size_t tksz;
 
-	if (!cache || !token || !value)
+	if (!cache || !token || !value || !cache->nents)
 		return NULL;
 
 	tksz = strlen(token);
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	for (e = *key_bucket(cache, hash_tag(token, value)); e; e = next) {
+		next = e->keynext;
 		if (!(e->flag & MNT_CACHE_ISTAG))
 			continue;
 		if (strcmp(token, e->key) == 0 &&
-		    strcmp(value, e->key + tksz + 1) == 0)
+		    strcmp(value, e->key + tksz + 1) == 0 &&
+		    is_valid_entry(cache, e)) {
+			touch_entry(cache, e);
 			return e->value;
+		}
 	}
 	return NULL;
 }
 
-static char *cache_find_tag_value(struct libmnt_cache *cache,
+/*
+ * Returns tag entry for the device; the @token is optional, the first
+ * TAGREAD entry is returned if @token is NULL.
+ */
+static struct mnt_cache_entry *cache_find_device(struct libmnt_cache *cache,
 			const char *devname, const char *token)
 {
-	size_t i;
+	struct mnt_cache_entry *e, *next;
 
 	assert(cache);
 	assert(devname);
-	assert(token);
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
-		if (!(e->flag & MNT_CACHE_ISTAG))
+	if (!cache->nents)
+		return NULL;
+
+	for (e = *value_bucket(cache, ul_hash_path(devname)); e; e = next) {
+		next = e->valnext;
+		if (token ? strcmp(token, e->key) != 0	/* tag name */
+			  : !(e->flag & MNT_CACHE_TAGREAD))
 			continue;
 		if (strcmp(e->value, devname) == 0 &&	/* dev name */
-		    strcmp(token, e->key) == 0)	/* tag name */
-			return e->key + strlen(token) + 1;	/* tag value */
+		    is_valid_entry(cache, e)) {
+			touch_entry(cache, e);
+			return e;
+		}
 	}
+	return NULL;
+}
+
+static char *cache_find_tag_value(struct libmnt_cache *cache,
+			const char *devname, const char *token)
+{
+	struct mnt_cache_entry *e;
+
+	assert(cache);
+	assert(devname);
+	assert(token);
+
+	e = cache_find_device(cache, devname, token);
+	if (e)
+		return e->key + strlen(token) + 1;	/* tag value */
 
 	return NULL;
 }
 
+/**
+ * mnt_cache_set_limit:
+ * @cache: cache pointer
+ * @max: maximal number of the cached entries or zero for unlimited cache
+ *
+ * Limits the number of the cached paths and tags. The least recently used
+ * entries are removed from the cache if the limit is exceeded. The minimal
+ * limit is 64 entries.
+ *
+ * Note that the strings returned from the limited cache (for example by
+ * mnt_resolve_path()) are valid only within a short period of time (until
+ * about @max / 2 new entries are added to the cache, or until
+ * mnt_cache_invalidate() is called). Copy the strings if you need them for a
+ * longer time.
+ *
+ * Returns: negative number in case of error, or 0 o success.
+ *
+ * Since: 2.41
+ */
+int mnt_cache_set_limit(struct libmnt_cache *cache, size_t max)
+{
+	if (!cache)
+		return -EINVAL;
+
+	if (max && max < MNT_CACHE_MINLIMIT)
+		max = MNT_CACHE_MINLIMIT;
+
+	DBG(CACHE, ul_debugobj(cache, "set limit to %zu", max));
+	cache->limit = max;
+
+	while (cache->limit && cache->nents > cache->limit) {
+		struct mnt_cache_entry *e = list_entry(cache->lru.next,
+						struct mnt_cache_entry, lru);
+		retire_entry(cache, e);
+	}
+	return 0;
+}
+
+/**
+ * mnt_cache_invalidate:
+ * @cache: cache pointer
+ *
+ * Marks all the cached paths and tags as outdated, for example after a change
+ * in the mount table, when the paths canonicalization may return different
+ * results. The outdated entries are resolved again on the next lookup. The
+ * table set by mnt_cache_set_targets() is dropped from the cache too.
+ *
+ * The strings returned from the cache before the previous
+ * mnt_cache_invalidate() call are deallocated.
+ *
+ * Returns: negative number in case of error, or 0 o success.
+ *
+ * Since: 2.41
+ */
+int mnt_cache_invalidate(struct libmnt_cache *cache)
+{
+	if (!cache)
+		return -EINVAL;
+
+	DBG(CACHE, ul_debugobj(cache, "invalidate [generation=%u, retired=%zu]",
+				cache->generation, cache->nretired));
+	free_retired_entries(cache);
+	cache->generation++;
+
+	mnt_unref_table(cache->mountinfo);
+	cache->mountinfo = NULL;
+	return 0;
+}
+
 /**
  * mnt_cache_read_tags
  * @cache: pointer to struct libmnt_cache instance
@@ -348,14 +617,9 @@ int mnt_cache_read_tags(struct libmnt_cache *cache, const char *devname)
 	DBG(CACHE, ul_debugobj(cache, "tags for %s requested", devname));
 
 	/* check if device is already cached */
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
-		if (!(e->flag & MNT_CACHE_TAGREAD))
-			continue;
-		if (strcmp(e->value, devname) == 0)
-			/* tags have already been read */
-			return 0;
-	}
+	if (cache_find_device(cache, devname, NULL))
+		/* tags have already been read */
+		return 0;
 
 	pr =  blkid_new_probe_from_filename(devname);
 	if (!pr)
@@ -518,7 +782,10 @@ static char *canonicalize_path_and_cache(const char *path,
 	char *value;
 
 	DBG(CACHE, ul_debugobj(cache, "canonicalize path %s", path));
-	p = canonicalize_path(path);
+	if (cache && !cache->canon)
+		cache->canon = new_canon_cache();
+	p = cache && cache->canon ? canonicalize_path_cached(cache->canon, path)
+				  : canonicalize_path(path);
 
 	if (p && cache) {
 		value = p;
@@ -804,7 +1071,7 @@ static int test_read_tags(struct libmnt_test *ts __attribute__((unused)),
 {
 	char line[BUFSIZ];
 	struct libmnt_cache *cache;
-	size_t i;
+	struct list_head *p;
 
 	cache = mnt_new_cache();
 	if (!cache)
@@ -839,8 +1106,8 @@ static int test_read_tags(struct libmnt_test *ts __attribute__((unused)),
 		}
 	}
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	list_for_each(p, &cache->lru) {
+		struct mnt_cache_entry *e = list_entry(p, struct mnt_cache_entry, lru);
 		if (!(e->flag & MNT_CACHE_ISTAG))
 			continue;
 
@@ -853,12 +1120,139 @@ static int test_read_tags(struct libmnt_test *ts __attribute__((unused)),
 
 }
 
+static int lru_add_path(struct libmnt_cache *cache, const char *path)
+{
+	char *key = strdup(path), *value = NULL;
+	int rc = -ENOMEM;
+
+	if (key && asprintf(&value, "/canon%s", path) > 0)
+		rc = cache_add_entry(cache, key, value, MNT_CACHE_ISPATH);
+	if (rc) {
+		free(key);
+		free(value);
+	}
+	return rc;
+}
+
+static void lru_print(struct libmnt_cache *cache)
+{
+	struct list_head *p;
+
+	list_for_each(p, &cache->lru) {
+		struct mnt_cache_entry *e = list_entry(p, struct mnt_cache_entry, lru);
+
+		if (e->flag & MNT_CACHE_ISTAG)
+			printf("  %s=%s : %s\n", e->key,
+					e->key + strlen(e->key) + 1, e->value);
+		else
+			printf("  %s : %s\n", e->key, e->value);
+	}
+	printf("entries: %zu, retired: %zu\n", cache->nents, cache->nretired);
+}
+
+/*
+ * Commands from stdin:
+ *	limit <max>		mnt_cache_set_limit()
+ *	add <path>		cache <path> as "/canon<path>"
+ *	fill <n> <prefix>	add <prefix>1 .. <prefix><n>
+ *	tag <NAME=value> <dev>	cache the tag
+ *	find <path>		lookup the path
+ *	findtag <NAME=value>	lookup the tag
+ *	finddev <dev> <NAME>	lookup the tag value of the device
+ *	invalidate		mnt_cache_invalidate()
+ *	list			print the entries, the least recently used first
+ */
+static int test_lru(struct libmnt_test *ts __attribute__((unused)),
+		    int argc __attribute__((unused)),
+		    char *argv[] __attribute__((unused)))
+{
+	char line[BUFSIZ];
+	struct libmnt_cache *cache;
+	int rc = 0;
+
+	cache = mnt_new_cache();
+	if (!cache)
+		return -ENOMEM;
+
+	while (rc == 0 && fgets(line, sizeof(line), stdin)) {
+		char cmd[32], a[256], b[256];
+		int n;
+
+		n = sscanf(line, "%31s %255s %255s", cmd, a, b);
+		if (n < 1)
+			continue;
+
+		if (strcmp(cmd, "limit") == 0 && n == 2) {
+			rc = mnt_cache_set_limit(cache, strtoul(a, NULL, 10));
+
+		} else if (strcmp(cmd, "add") == 0 && n == 2) {
+			rc = lru_add_path(cache, a);
+
+		} else if (strcmp(cmd, "fill") == 0 && n == 3) {
+			unsigned long i, max = strtoul(a, NULL, 10);
+
+			for (i = 1; rc == 0 && i <= max; i++) {
+				char path[sizeof(b) + 32];
+
+				snprintf(path, sizeof(path), "%s%lu", b, i);
+				rc = lru_add_path(cache, path);
+			}
+
+		} else if (strcmp(cmd, "tag") == 0 && n == 3) {
+			char *t = NULL, *v = NULL, *dev = strdup(b);
+
+			if (!dev || blkid_parse_tag_string(a, &t, &v) != 0)
+				rc = -EINVAL;
+			else
+				rc = cache_add_tag(cache, t, v, dev, 0);
+			if (rc)
+				free(dev);
+			free(t);
+			free(v);
+
+		} else if (strcmp(cmd, "find") == 0 && n == 2) {
+			const char *cn = cache_find_path(cache, a);
+
+			printf("%s: %s\n", a, cn ? cn : "not cached");
+
+		} else if (strcmp(cmd, "findtag") == 0 && n == 2) {
+			char *t = NULL, *v = NULL;
+			const char *cn = NULL;
+
+			if (blkid_parse_tag_string(a, &t, &v) == 0)
+				cn = cache_find_tag(cache, t, v);
+			printf("%s: %s\n", a, cn ? cn : "not cached");
+			free(t);
+			free(v);
+
+		} else if (strcmp(cmd, "finddev") == 0 && n == 3) {
+			const char *cn = cache_find_tag_value(cache, a, b);
+
+			printf("%s %s: %s\n", a, b, cn ? cn : "not cached");
+
+		} else if (strcmp(cmd, "invalidate") == 0) {
+			rc = mnt_cache_invalidate(cache);
+
+		} else if (strcmp(cmd, "list") == 0) {
+			lru_print(cache);
+
+		} else {
+			fprintf(stderr, "unknown command: %s", line);
+			rc = -EINVAL;
+		}
+	}
+
+	mnt_unref_cache(cache);
+	return rc;
+}
+
 int main(int argc, char *argv[])
 {
 	struct libmnt_test ts[] = {
 		{ "--resolve-path", test_resolve_path, "  resolve paths from stdin" },
 		{ "--resolve-spec", test_resolve_spec, "  evaluate specs from stdin" },
 		{ "--read-tags", test_read_tags,       "  read devname or TAG from stdin (\"quit\" to exit)" },
+		{ "--lru", test_lru,                   "  run LRU commands from stdin" },
 		{ NULL }
 	};
 
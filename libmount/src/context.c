@@ -112,7 +112,15 @@ void mnt_free_context(struct libmnt_context *cxt)
 
 	mnt_context_set_target_ns(cxt, NULL);
 
-	free(cxt->children);
+	if (cxt->children) {
+		int i;
+
+		for (i = 0; i < cxt->nchildren; i++) {
+			free(cxt->children[i].target);
+			free(cxt->children[i].source);
+		}
+		free(cxt->children);
+	}
 
 	DBG(CXT, ul_debugobj(cxt, "free"));
 	free(cxt);
@@ -172,6 +180,7 @@ int mnt_reset_context(struct libmnt_context *cxt)
 
 	mnt_context_reset_status(cxt);
 	mnt_context_deinit_hooksets(cxt);
+	mnt_context_reset_hookstats(cxt);
 
 	if (cxt->table_fltrcb)
 		mnt_context_set_tabfilter(cxt, NULL, NULL);
@@ -290,6 +299,7 @@ struct libmnt_context *mnt_copy_context(struct libmnt_context *o)
 
 	n->noautofs = o->noautofs;
 	n->has_selinux_opt = o->has_selinux_opt;
+	n->timing = o->timing;
 
 	return n;
 failed:
@@ -566,8 +576,9 @@ int mnt_context_is_onlyonce(struct libmnt_context *cxt)
  * @cxt: mount context
  * @enable: TRUE or FALSE
  *
- * Enable/disable fork(2) call in mnt_context_next_mount() (see mount(8) man
- * page, option -F).
+ * Enable/disable fork(2) call in mnt_context_next_mount() and
+ * mnt_context_next_umount() (see mount(8) man page, option -F). See also
+ * mnt_context_set_parallel().
  *
  * Returns: 0 on success, negative number in case of error.
  */
@@ -2861,26 +2872,173 @@ int mnt_context_is_fs_mounted(struct libmnt_context *cxt,
 	return rc;
 }
 
-static int mnt_context_add_child(struct libmnt_context *cxt, pid_t pid)
+static int mnt_context_add_child(struct libmnt_context *cxt, pid_t pid,
+				 const char *target, const char *source)
 {
-	pid_t *pids;
+	struct libmnt_child *ch;
+	char *tgt = NULL, *src = NULL;
 
 	if (!cxt)
 		return -EINVAL;
+	if (target && cxt->max_children) {
+		tgt = strdup(target);
+		if (!tgt)
+			return -ENOMEM;
+	}
+	if (source && cxt->max_children) {
+		src = strdup(source);
+		if (!src) {
+			free(tgt);
+			return -ENOMEM;
+		}
+	}
 
-	pids = reallocarray(cxt->children, cxt->nchildren + 1, sizeof(pid_t));
-	if (!pids)
+	ch = reallocarray(cxt->children, cxt->nchildren + 1, sizeof(*ch));
+	if (!ch) {
+		free(tgt);
+		free(src);
 		return -ENOMEM;
+	}
 
 	DBG(CXT, ul_debugobj(cxt, "add new child %d", pid));
-	cxt->children = pids;
-	cxt->children[cxt->nchildren++] = pid;
+	cxt->children = ch;
+	ch = &cxt->children[cxt->nchildren++];
+	ch->pid = pid;
+	ch->status = 0;
+	ch->target = tgt;
+	ch->source = src;
+
+	return 0;
+}
+
+/* waits for the child and saves its wait(2) status; returns 0 if the child
+ * is still running and @nohang is set */
+static int wait_child(struct libmnt_context *cxt, struct libmnt_child *ch,
+		      int nohang)
+{
+	pid_t rc;
+
+	do {
+		errno = 0;
+		rc = waitpid(ch->pid, &ch->status, nohang ? WNOHANG : 0);
+	} while (rc == -1 && errno == EINTR);
+
+	if (rc == 0)
+		return 0;
+	if (rc == -1)
+		ch->status = -1;	/* unknown status */
+
+	DBG(CXT, ul_debugobj(cxt, "child %d finished [status=%d]",
+				ch->pid, ch->status));
+	ch->pid = 0;
+	free(ch->target);
+	free(ch->source);
+	ch->target = ch->source = NULL;
+	return 1;
+}
+
+/* returns 1 if @a is @b, or if one of the paths is a parent of the other */
+static int is_related_path(const char *a, const char *b)
+{
+	size_t alen = strlen(a), blen = strlen(b);
+	const char *longer;
+	size_t len;
+
+	while (alen > 1 && a[alen - 1] == '/')
+		alen--;
+	while (blen > 1 && b[blen - 1] == '/')
+		blen--;
+
+	len = min(alen, blen);
+	if (strncmp(a, b, len) != 0)
+		return 0;
+
+	longer = alen > blen ? a : b;
+	return alen == blen || (len == 1 && *a == '/')
+			|| longer[len] == '/';
+}
+
+/*
+ * Waits for the running children which mount or umount a parent or a child of
+ * @target, @source, or of any x-systemd.requires-mounts-for= path from
+ * @options, and for the children whose source is related to @target. Then
+ * waits until the number of running children is below the max_children limit.
+ */
+static int wait_for_dependencies(struct libmnt_context *cxt,
+				 const char *target, const char *source,
+				 const char *options)
+{
+	int i, nrunning = 0, oldest = -1;
+
+	for (i = 0; i < cxt->nchildren; i++) {
+		struct libmnt_child *ch = &cxt->children[i];
+		int related = 0;
+
+		if (!ch->pid || !ch->target)
+			continue;
+		if (wait_child(cxt, ch, 1))
+			continue;
+
+		if (target)
+			related = is_related_path(ch->target, target)
+				|| (ch->source && is_related_path(ch->source, target));
+		if (!related && source)
+			related = is_related_path(ch->target, source);
+		if (!related && options) {
+			char *opts = (char *) options, *name, *val;
+			size_t namesz, valsz;
+
+			while (!related && mnt_optstr_next_option(&opts,
+					&name, &namesz, &val, &valsz) == 0) {
+				char *path;
+
+				if (!val || namesz != sizeof("x-systemd.requires-mounts-for") - 1
+				    || strncmp(name, "x-systemd.requires-mounts-for", namesz) != 0)
+					continue;
+				path = strndup(val, valsz);
+				if (!path)
+					return -ENOMEM;
+				related = is_related_path(ch->target, path);
+				free(path);
+			}
+		}
+
+		if (related) {
+			DBG(CXT, ul_debugobj(cxt, "%s: waiting for %s [pid=%d]",
+						target, ch->target, ch->pid));
+			wait_child(cxt, ch, 0);
+			continue;
+		}
+		if (oldest < 0)
+			oldest = i;
+		nrunning++;
+	}
+
+	for (i = oldest; i >= 0 && i < cxt->nchildren
+			 && nrunning >= (int) cxt->max_children; i++) {
+		struct libmnt_child *ch = &cxt->children[i];
+
+		if (!ch->pid || !ch->target)
+			continue;
+		DBG(CXT, ul_debugobj(cxt, "too many children, waiting for %s [pid=%d]",
+					ch->target, ch->pid));
+		wait_child(cxt, ch, 0);
+		nrunning--;
+	}
 
 	return 0;
 }
 
-int mnt_fork_context(struct libmnt_context *cxt)
+/*
+ * Forks the context for @fs. If parallel is enabled, then the children for
+ * the related mountpoints are serialized and the number of running children
+ * is limited by max_children. The @source is a path the operation depends on
+ * besides the target (bind source, loop backing file), or NULL.
+ */
+int mnt_fork_context(struct libmnt_context *cxt, struct libmnt_fs *fs,
+		     const char *source)
 {
+	const char *target = fs ? mnt_fs_get_target(fs) : NULL;
 	int rc = 0;
 	pid_t pid;
 
@@ -2888,6 +3046,13 @@ int mnt_fork_context(struct libmnt_context *cxt)
 	if (!mnt_context_is_parent(cxt))
 		return -EINVAL;
 
+	if (cxt->max_children) {
+		rc = wait_for_dependencies(cxt, target, source,
+				fs ? mnt_fs_get_user_options(fs) : NULL);
+		if (rc)
+			return rc;
+	}
+
 	DBG(CXT, ul_debugobj(cxt, "forking context"));
 
 	DBG_FLUSH;
@@ -2906,13 +3071,58 @@ int mnt_fork_context(struct libmnt_context *cxt)
 		break;
 
 	default:
-		rc = mnt_context_add_child(cxt, pid);
+		rc = mnt_context_add_child(cxt, pid, target, source);
 		break;
 	}
 
 	return rc;
 }
 
+/**
+ * mnt_context_set_parallel:
+ * @cxt: mount context
+ * @max: maximal number of running children or zero
+ *
+ * Enables dependency scheduling for mnt_context_next_mount() and
+ * mnt_context_next_umount() when fork is enabled (see
+ * mnt_context_enable_fork()). The filesystems are still processed in the
+ * table order, but a child for a mountpoint is not created until the
+ * children for its parent or submounts (or for any
+ * x-systemd.requires-mounts-for= path, the bind mount source or the loop
+ * device backing file) finished, and no more than @max
+ * children run at the same time. The zero @max disables the scheduling.
+ *
+ * If enabled, the child does not call _exit() in mnt_context_next_mount()
+ * and mnt_context_next_umount(). The caller is expected to check
+ * mnt_context_is_child(), report the result and exit. The exit statuses are
+ * returned by mnt_context_wait_for_children().
+ *
+ * Returns: 0 on success, negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_context_set_parallel(struct libmnt_context *cxt, unsigned int max)
+{
+	if (!cxt)
+		return -EINVAL;
+	cxt->max_children = max;
+	return 0;
+}
+
+/**
+ * mnt_context_get_parallel:
+ * @cxt: mount context
+ *
+ * Returns: the maximal number of running children or 0 if the scheduling is
+ *          disabled.
+ *
+ * Since: 2.41
+ */
+unsigned int mnt_context_get_parallel(struct libmnt_context *cxt)
+{
+	return cxt ? cxt->max_children : 0;
+}
+
 int mnt_context_wait_for_children(struct libmnt_context *cxt,
 				  int *nchildren, int *nerrs)
 {
@@ -2924,30 +3134,24 @@ int mnt_context_wait_for_children(struct libmnt_context *cxt,
 	assert(mnt_context_is_parent(cxt));
 
 	for (i = 0; i < cxt->nchildren; i++) {
-		pid_t pid = cxt->children[i];
-		int rc = 0, ret = 0;
+		struct libmnt_child *ch = &cxt->children[i];
 
-		if (!pid)
-			continue;
-		do {
+		if (ch->pid) {
 			DBG(CXT, ul_debugobj(cxt,
 					"waiting for child (%d/%d): %d",
-					i + 1, cxt->nchildren, pid));
-			errno = 0;
-			rc = waitpid(pid, &ret, 0);
-
-		} while (rc == -1 && errno == EINTR);
+					i + 1, cxt->nchildren, ch->pid));
+			wait_child(cxt, ch, 0);
+		}
 
 		if (nchildren)
 			(*nchildren)++;
 
-		if (rc != -1 && nerrs) {
-			if (WIFEXITED(ret))
-				(*nerrs) += WEXITSTATUS(ret) == 0 ? 0 : 1;
+		if (ch->status != -1 && nerrs) {
+			if (WIFEXITED(ch->status))
+				(*nerrs) += WEXITSTATUS(ch->status) == 0 ? 0 : 1;
 			else
 				(*nerrs)++;
 		}
-		cxt->children[i] = 0;
 	}
 
 	cxt->nchildren = 0;
@@ -3270,6 +3474,45 @@ static int test_mount(struct libmnt_test *ts __attribute__((unused)),
 	return rc;
 }
 
+static int test_mount_targets(struct libmnt_test *ts __attribute__((unused)),
+			      int argc, char *argv[])
+{
+	int idx = 1, rc = 0;
+	size_t nmounted = 0;
+	struct libmnt_context *cxt;
+
+	if (argc < 3)
+		return -EINVAL;
+
+	cxt = mnt_new_context();
+	if (!cxt)
+		return -ENOMEM;
+
+	if (!strcmp(argv[idx], "-o")) {
+		mnt_context_set_options(cxt, argv[idx + 1]);
+		idx += 2;
+	}
+	if (!strcmp(argv[idx], "-t")) {
+		mnt_context_set_fstype(cxt, argv[idx + 1]);
+		idx += 2;
+	}
+	if (idx + 1 >= argc) {
+		mnt_free_context(cxt);
+		return -EINVAL;
+	}
+
+	mnt_context_set_source(cxt, argv[idx++]);
+
+	rc = mnt_context_mount_targets(cxt, (const char **) &argv[idx],
+				       argc - idx, &nmounted);
+	if (rc)
+		warn("failed to mount");
+	printf("successfully mounted %zu targets\n", nmounted);
+
+	mnt_free_context(cxt);
+	return rc;
+}
+
 static int test_umount(struct libmnt_test *ts __attribute__((unused)),
 		       int argc, char *argv[])
 {
@@ -3462,6 +3705,7 @@ int main(int argc, char *argv[])
 {
 	struct libmnt_test tss[] = {
 	{ "--mount",  test_mount,  "[-o <opts>] [-t <type>] <spec>|<src> <target>" },
+	{ "--mount-targets", test_mount_targets, "[-o <opts>] [-t <type>] <src> <target> [<target> ...]" },
 	{ "--umount", test_umount, "[-t <type>] [-f][-l][-r] <src>|<target>" },
 	{ "--mount-all", test_mountall,  "[-O <pattern>] [-t <pattern] mount all filesystems from fstab" },
 	{ "--flags", test_flags,   "[-o <opts>] <spec>" },
@@ -1000,18 +1000,9 @@ int mnt_context_finalize_mount(struct libmnt_context *cxt)
  *         >0 in case of mount(2) error (returns syscall errno),
  *         <0 in case of other errors.
  */
-int mnt_context_mount(struct libmnt_context *cxt)
+static int mount_context(struct libmnt_context *cxt)
 {
 	int rc;
-	struct libmnt_ns *ns_old;
-
-	assert(cxt);
-	assert(cxt->fs);
-	assert(cxt->helper_exec_status == 1);
-
-	ns_old = mnt_context_switch_target_ns(cxt);
-	if (!ns_old)
-		return -MNT_ERR_NAMESPACE;
 
 again:
 	rc = mnt_context_prepare_mount(cxt);
@@ -1053,7 +1044,23 @@ again:
 
 	if (rc == 0)
 		rc = mnt_context_call_hooks(cxt, MNT_STAGE_POST);
+	return rc;
+}
+
+int mnt_context_mount(struct libmnt_context *cxt)
+{
+	int rc;
+	struct libmnt_ns *ns_old;
+
+	assert(cxt);
+	assert(cxt->fs);
+	assert(cxt->helper_exec_status == 1);
+
+	ns_old = mnt_context_switch_target_ns(cxt);
+	if (!ns_old)
+		return -MNT_ERR_NAMESPACE;
 
+	rc = mount_context(cxt);
 	mnt_context_deinit_hooksets(cxt);
 
 	if (!mnt_context_switch_ns(cxt, ns_old))
@@ -1063,6 +1070,121 @@ again:
 	return rc;
 }
 
+/*
+ * Mounts the next instance of the already mounted filesystem; the context is
+ * completely prepared, only the target is different.
+ */
+static int mount_next_target(struct libmnt_context *cxt, const char *target)
+{
+	int rc = 0;
+
+	if (!mnt_context_is_fake(cxt))
+		rc = mnt_context_rewind_sysapi(cxt);
+	if (rc)
+		return rc;
+
+	mnt_context_reset_status(cxt);
+
+	rc = mnt_fs_set_target(cxt->fs, target);
+	if (!rc)
+		rc = prepare_target(cxt);
+	if (!rc)
+		rc = mnt_context_prepare_update(cxt);
+	if (!rc)
+		rc = mnt_context_do_mount(cxt);
+	if (!rc)
+		rc = mnt_context_update_tabs(cxt);
+	if (!rc)
+		rc = mnt_context_call_hooks(cxt, MNT_STAGE_POST);
+	return rc;
+}
+
+/**
+ * mnt_context_mount_targets:
+ * @cxt: mount context
+ * @targets: array of mountpoints
+ * @ntargets: number of items in @targets
+ * @nmounted: returns number of successfully mounted targets
+ *
+ * Mounts a new instance of the same filesystem (source, type and options) on
+ * all @targets. The context target is overwritten.
+ *
+ * The first target is mounted as by mnt_context_mount(); fstab, mount options,
+ * filesystem type, etc. are evaluated only once. For the next targets the
+ * already prepared context is re-used, and the filesystem instance is created
+ * only by fsopen(), fsconfig() and fsmount() syscalls.
+ *
+ * This is supported only by the new kernel mount API and only for a new
+ * filesystem which does not need any additional setup (loop device,
+ * ID-mapping, X-mount.subdir=, etc.) or a mount helper. In other cases the
+ * function returns -ENOTSUP after the first mount. The function stops on the
+ * first failed target, the context status (see mnt_context_get_status())
+ * describes the target.
+ *
+ * Returns: 0 on success, negative number or syscall errno (see mnt_context_mount()).
+ *
+ * Since: 2.41
+ */
+int mnt_context_mount_targets(struct libmnt_context *cxt,
+			      const char **targets, size_t ntargets,
+			      size_t *nmounted)
+{
+	struct libmnt_ns *ns_old;
+	size_t i;
+	int rc;
+
+	if (nmounted)
+		*nmounted = 0;
+	if (!cxt || !targets || !ntargets)
+		return -EINVAL;
+
+	rc = mnt_context_set_target(cxt, targets[0]);
+	if (rc)
+		return rc;
+
+	ns_old = mnt_context_switch_target_ns(cxt);
+	if (!ns_old)
+		return -MNT_ERR_NAMESPACE;
+
+	rc = mount_context(cxt);
+
+	for (i = 1; rc == 0 && mnt_context_get_status(cxt) == 1; i++) {
+		if (nmounted)
+			*nmounted = i;
+		if (i == ntargets)
+			break;
+
+		DBG(CXT, ul_debugobj(cxt, "mount next target: %s", targets[i]));
+		rc = mount_next_target(cxt, targets[i]);
+	}
+
+	mnt_context_deinit_hooksets(cxt);
+
+	if (!mnt_context_switch_ns(cxt, ns_old))
+		rc = -MNT_ERR_NAMESPACE;
+
+	DBG(CXT, ul_debugobj(cxt, "mnt_context_mount_targets() done [rc=%d]", rc));
+	return rc;
+}
+
+/*
+ * Returns the path of the bind mount source or the loop device backing file,
+ * the mount has to wait for the filesystem with the path.
+ */
+static const char *get_source_dependency(struct libmnt_fs *fs)
+{
+	const char *src = mnt_fs_get_srcpath(fs);
+
+	if (!src || *src != '/')
+		return NULL;		/* tag, pseudo or network filesystem */
+	if (mnt_fs_get_option(fs, "bind", NULL, NULL) == 0
+	    || mnt_fs_get_option(fs, "rbind", NULL, NULL) == 0
+	    || mnt_fs_get_option(fs, "loop", NULL, NULL) == 0
+	    || strncmp(src, "/dev/", 5) != 0)
+		return src;
+	return NULL;
+}
+
 /**
  * mnt_context_next_mount:
  * @cxt: context
@@ -1190,7 +1312,7 @@ int mnt_context_next_mount(struct libmnt_context *cxt,
 	cxt->mountinfo = mountinfo;
 
 	if (mnt_context_is_fork(cxt)) {
-		rc = mnt_fork_context(cxt);
+		rc = mnt_fork_context(cxt, *fs, get_source_dependency(*fs));
 		if (rc)
 			return rc;		/* fork error */
 
@@ -1222,7 +1344,8 @@ int mnt_context_next_mount(struct libmnt_context *cxt,
 			*mntrc = rc;
 	}
 
-	if (mnt_context_is_child(cxt)) {
+	/* with mnt_context_set_parallel() the caller reports the result */
+	if (mnt_context_is_child(cxt) && !cxt->max_children) {
 		DBG(CXT, ul_debugobj(cxt, "next-mount: child exit [rc=%d]", rc));
 		DBG_FLUSH;
 		_exit(rc);
@@ -1138,6 +1138,20 @@ int mnt_context_umount(struct libmnt_context *cxt)
 	return rc;
 }
 
+/* returns the backing file of the loop device mounted by @fs, or NULL */
+static char *get_backing_file(struct libmnt_context *cxt, struct libmnt_fs *fs)
+{
+	const char *src;
+
+	if (!cxt->max_children)
+		return NULL;
+
+	src = mnt_fs_get_srcpath(fs);
+	if (!src || strncmp(src, "/dev/loop", 9) != 0)
+		return NULL;
+
+	return loopdev_get_backing_file(src);
+}
 
 /**
  * mnt_context_next_umount:
@@ -1218,12 +1232,32 @@ int mnt_context_next_umount(struct libmnt_context *cxt,
 		return 0;
 	}
 
+	if (mnt_context_is_fork(cxt)) {
+		char *backing = get_backing_file(cxt, *fs);
+
+		/* the unmount has to finish before the backing file is unmounted */
+		rc = mnt_fork_context(cxt, *fs, backing);
+		free(backing);
+		if (rc)
+			return rc;		/* fork error */
+
+		if (mnt_context_is_parent(cxt))
+			return 0;		/* parent */
+	}
+
 	rc = mnt_context_set_fs(cxt, *fs);
 	if (rc)
 		return rc;
 	rc = mnt_context_umount(cxt);
 	if (mntrc)
 		*mntrc = rc;
+
+	/* with mnt_context_set_parallel() the caller reports the result */
+	if (mnt_context_is_child(cxt) && !cxt->max_children) {
+		DBG(CXT, ul_debugobj(cxt, "next-umount: child exit [rc=%d]", rc));
+		DBG_FLUSH;
+		_exit(rc);
+	}
 	return 0;
 }
 
@@ -87,13 +87,15 @@ void mnt_reset_fs(struct libmnt_fs *fs)
 	free(fs->root);
 	free(fs->swaptype);
 	free(fs->target);
-	free(fs->fstype);
+	if (!fs->fstype_static)
+		free(fs->fstype);
 	free(fs->optstr);
 	free(fs->vfs_optstr);
 	free(fs->fs_optstr);
 	free(fs->user_optstr);
 	free(fs->attrs);
 	free(fs->opt_fields);
+	free(fs->lazy);
 	free(fs->comment);
 
 	mnt_unref_optlist(fs->optlist);
@@ -106,6 +108,53 @@ void mnt_reset_fs(struct libmnt_fs *fs)
 	fs->refcount = ref;
 }
 
+/*
+ * Copies the lazy decoded mountinfo fields (see mnt_parse_mountinfo_line()) to
+ * the struct members. The buffer in fs->lazy contains NUL terminated strings
+ * in order of the MNT_FS_LAZY_* bits.
+ */
+int __mnt_fs_decode_lazy(struct libmnt_fs *fs, unsigned int mask)
+{
+	static const size_t members[] = {
+		offsetof(struct libmnt_fs, root),
+		offsetof(struct libmnt_fs, vfs_optstr),
+		offsetof(struct libmnt_fs, opt_fields),
+		offsetof(struct libmnt_fs, fs_optstr)
+	};
+	const char *p = fs->lazy;
+	size_t i;
+
+	if (mask & MNT_FS_LAZY_OPTSTR)
+		mask |= MNT_FS_LAZY_VFSOPTS | MNT_FS_LAZY_FSOPTS;
+	mask &= fs->lazy_mask;
+
+	for (i = 0; p && i < ARRAY_SIZE(members); i++) {
+		size_t len = strlen(p);
+
+		if (mask & (1 << i)) {
+			char **member = (char **) ((char *) fs + members[i]);
+
+			if (len && !(*member = strndup(p, len)))
+				return -ENOMEM;
+			fs->lazy_mask &= ~(1 << i);
+		}
+		p += len + 1;
+	}
+
+	if (mask & MNT_FS_LAZY_OPTSTR) {
+		fs->lazy_mask &= ~MNT_FS_LAZY_OPTSTR;
+		fs->optstr = mnt_fs_strdup_options(fs);
+		if (!fs->optstr)
+			return -ENOMEM;
+	}
+
+	if (!fs->lazy_mask) {
+		free(fs->lazy);
+		fs->lazy = NULL;
+	}
+	return 0;
+}
+
 /**
  * mnt_ref_fs:
  * @fs: fs pointer
@@ -184,6 +233,8 @@ static inline int sync_opts_from_optlist(struct libmnt_fs *fs, struct libmnt_opt
 		const char *p;
 		int rc;
 
+		fs->lazy_mask &= ~MNT_FS_LAZY_OPTIONS;
+
 		/* All options */
 		rc = mnt_optlist_get_optstr(ol, &p, NULL, 0);
 		if (!rc)
@@ -259,15 +310,19 @@ struct libmnt_fs *mnt_copy_fs(struct libmnt_fs *dest,
 
 	if (!src)
 		return NULL;
+	if (mnt_fs_decode_lazy((struct libmnt_fs *) src, MNT_FS_LAZY_ALL))
+		return NULL;
 	if (!dest) {
 		dest = mnt_new_fs();
 		if (!dest)
 			return NULL;
 
 		dest->tab	 = NULL;
-	}
+	} else
+		mnt_table_drop_index(dest->tab);
 
 	dest->id         = src->id;
+	dest->uniq_id    = src->uniq_id;
 	dest->parent     = src->parent;
 	dest->devno      = src->devno;
 	dest->tid        = src->tid;
@@ -284,7 +339,7 @@ struct libmnt_fs *mnt_copy_fs(struct libmnt_fs *dest,
 		goto err;
 	if (cpy_str_at_offset(dest, src, offsetof(struct libmnt_fs, target)))
 		goto err;
-	if (cpy_str_at_offset(dest, src, offsetof(struct libmnt_fs, fstype)))
+	if (mnt_fs_set_fstype(dest, src->fstype))
 		goto err;
 	if (cpy_str_at_offset(dest, src, offsetof(struct libmnt_fs, optstr)))
 		goto err;
@@ -329,12 +384,14 @@ struct libmnt_fs *mnt_copy_mtab_fs(struct libmnt_fs *fs)
 		return NULL;
 	if (fs->optlist)
 		sync_opts_from_optlist(fs, fs->optlist);
+	if (mnt_fs_decode_lazy(fs, MNT_FS_LAZY_ALL))
+		goto err;
 
 	if (strdup_between_structs(n, fs, source))
 		goto err;
 	if (strdup_between_structs(n, fs, target))
 		goto err;
-	if (strdup_between_structs(n, fs, fstype))
+	if (mnt_fs_set_fstype(n, fs->fstype))
 		goto err;
 
 	if (fs->vfs_optstr) {
@@ -457,6 +514,8 @@ int __mnt_fs_set_source_ptr(struct libmnt_fs *fs, char *source)
 	if (fs->source != source)
 		free(fs->source);
 
+	mnt_table_drop_index(fs->tab);
+
 	free(fs->tagname);
 	free(fs->tagval);
 
@@ -624,6 +683,8 @@ const char *mnt_fs_get_target(struct libmnt_fs *fs)
  */
 int mnt_fs_set_target(struct libmnt_fs *fs, const char *tgt)
 {
+	if (fs)
+		mnt_table_drop_index(fs->tab);
 	return strdup_to_struct_member(fs, target, tgt);
 }
 
@@ -631,6 +692,7 @@ int __mnt_fs_set_target_ptr(struct libmnt_fs *fs, char *tgt)
 {
 	assert(fs);
 
+	mnt_table_drop_index(fs->tab);
 	free(fs->target);
 	fs->target = tgt;
 	return 0;
@@ -659,6 +721,8 @@ int mnt_fs_get_propagation(struct libmnt_fs *fs, unsigned long *flags)
 
 	*flags = 0;
 
+	if (mnt_fs_decode_lazy(fs, MNT_FS_LAZY_OPTFIELDS))
+		return -ENOMEM;
 	if (!fs->opt_fields)
 		return 0;
 
@@ -746,28 +810,37 @@ const char *mnt_fs_get_fstype(struct libmnt_fs *fs)
 	return fs ? fs->fstype : NULL;
 }
 
-/* Used by the struct libmnt_file parser only */
-int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
+/* returns MNT_FS_{PSEUDO,NET,SWAP} flags for @type */
+static int get_fstype_flags(const char *type)
 {
-	assert(fs);
+	if (mnt_fstype_is_pseudofs(type))
+		return MNT_FS_PSEUDO;
+	if (mnt_fstype_is_netfs(type))
+		return MNT_FS_NET;
+	if (!strcmp(type, "swap"))
+		return MNT_FS_SWAP;
+	return 0;
+}
 
-	if (fstype != fs->fstype)
+static void set_fstype(struct libmnt_fs *fs, char *fstype, int is_static, int flags)
+{
+	if (fstype != fs->fstype && !fs->fstype_static)
 		free(fs->fstype);
 
 	fs->fstype = fstype;
-	fs->flags &= ~MNT_FS_PSEUDO;
-	fs->flags &= ~MNT_FS_NET;
-	fs->flags &= ~MNT_FS_SWAP;
+	fs->fstype_static = is_static ? 1 : 0;
 
 	/* save info about pseudo filesystems */
-	if (fs->fstype) {
-		if (mnt_fstype_is_pseudofs(fs->fstype))
-			fs->flags |= MNT_FS_PSEUDO;
-		else if (mnt_fstype_is_netfs(fs->fstype))
-			fs->flags |= MNT_FS_NET;
-		else if (!strcmp(fs->fstype, "swap"))
-			fs->flags |= MNT_FS_SWAP;
-	}
+	fs->flags &= ~(MNT_FS_PSEUDO | MNT_FS_NET | MNT_FS_SWAP);
+	fs->flags |= flags;
+}
+
+/* Used by the struct libmnt_file parser only */
+int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
+{
+	assert(fs);
+
+	set_fstype(fs, fstype, 0, fstype ? get_fstype_flags(fstype) : 0);
 	return 0;
 }
 
@@ -787,11 +860,20 @@ int mnt_fs_set_fstype(struct libmnt_fs *fs, const char *fstype)
 	if (!fs)
 		return -EINVAL;
 	if (fstype) {
+		/* well-known names are shared, there is no reason to copy
+		 * "tmpfs" or "cgroup2" for each mountinfo entry */
+		int flags = 0;
+		const char *x = mnt_get_static_fstype(fstype, &flags);
+
+		if (x) {
+			set_fstype(fs, (char *) x, 1, flags);
+			return 0;
+		}
 		p = strdup(fstype);
 		if (!p)
 			return -ENOMEM;
 	}
-	return  __mnt_fs_set_fstype_ptr(fs, p);
+	return __mnt_fs_set_fstype_ptr(fs, p);
 }
 
 /*
@@ -808,6 +890,12 @@ int mnt_fs_set_fstype(struct libmnt_fs *fs, const char *fstype)
  *
  *           returns: "rw,noexec,journal=update"
  */
+static inline int startswith_rwro(const char *s)
+{
+	return *s == 'r' && (s[1] == 'w' || s[1] == 'o')
+	       && (s[2] == ',' || s[2] == '\0');
+}
+
 static char *merge_optstr(const char *vfs, const char *fs)
 {
 	char *res, *p;
@@ -821,6 +909,22 @@ static char *merge_optstr(const char *vfs, const char *fs)
 	if (!strcmp(vfs, fs))
 		return strdup(vfs);		/* e.g. "aaa" and "aaa" */
 
+	/* usual mountinfo, both strings start with rw/ro and there is
+	 * nothing else to remove */
+	if (startswith_rwro(vfs) && startswith_rwro(fs)
+	    && !strstr(vfs + 2, ",rw") && !strstr(vfs + 2, ",ro")
+	    && !strstr(fs + 2, ",rw") && !strstr(fs + 2, ",ro")) {
+		const char *v = vfs[2] ? vfs + 3 : NULL,
+			   *f = fs[2] ? fs + 3 : NULL;
+		int ro = vfs[1] == 'o' || fs[1] == 'o';
+
+		if (asprintf(&res, "%s%s%s%s%s", ro ? "ro" : "rw",
+				v ? "," : "", v ? v : "",
+				f ? "," : "", f ? f : "") < 0)
+			return NULL;
+		return res;
+	}
+
 	/* leave space for the leading "r[ow],", "," and the trailing zero */
 	sz = strlen(vfs) + strlen(fs) + 5;
 	res = malloc(sz);
@@ -865,6 +969,8 @@ char *mnt_fs_strdup_options(struct libmnt_fs *fs)
 		return NULL;
 	if (fs->optlist)
 		sync_opts_from_optlist(fs, fs->optlist);
+	if (mnt_fs_decode_lazy(fs, MNT_FS_LAZY_OPTSTR))
+		return NULL;
 
 	errno = 0;
 	if (fs->optstr)
@@ -889,10 +995,14 @@ char *mnt_fs_strdup_options(struct libmnt_fs *fs)
  */
 const char *mnt_fs_get_options(struct libmnt_fs *fs)
 {
-	if (fs && fs->optlist)
+	if (!fs)
+		return NULL;
+	if (fs->optlist)
 		sync_opts_from_optlist(fs, fs->optlist);
+	if (mnt_fs_decode_lazy(fs, MNT_FS_LAZY_OPTSTR))
+		return NULL;
 
-	return fs ? fs->optstr : NULL;
+	return fs->optstr;
 }
 
 /**
@@ -904,7 +1014,9 @@ const char *mnt_fs_get_options(struct libmnt_fs *fs)
  */
 const char *mnt_fs_get_optional_fields(struct libmnt_fs *fs)
 {
-	return fs ? fs->opt_fields : NULL;
+	if (!fs || mnt_fs_decode_lazy(fs, MNT_FS_LAZY_OPTFIELDS))
+		return NULL;
+	return fs->opt_fields;
 }
 
 /**
@@ -947,6 +1059,7 @@ int mnt_fs_set_options(struct libmnt_fs *fs, const char *optstr)
 	free(fs->user_optstr);
 	free(fs->optstr);
 
+	fs->lazy_mask &= ~MNT_FS_LAZY_OPTIONS;
 	fs->fs_optstr = f;
 	fs->vfs_optstr = v;
 	fs->user_optstr = u;
@@ -981,7 +1094,9 @@ int mnt_fs_append_options(struct libmnt_fs *fs, const char *optstr)
 		return mnt_optlist_append_optstr(fs->optlist, optstr, NULL);
 	}
 
-	rc = mnt_split_optstr(optstr, &u, &v, &f, 0, 0);
+	rc = mnt_fs_decode_lazy(fs, MNT_FS_LAZY_OPTIONS);
+	if (!rc)
+		rc = mnt_split_optstr(optstr, &u, &v, &f, 0, 0);
 	if (rc)
 		return rc;
 
@@ -1028,7 +1143,9 @@ int mnt_fs_prepend_options(struct libmnt_fs *fs, const char *optstr)
 		return mnt_optlist_prepend_optstr(fs->optlist, optstr, NULL);
 	}
 
-	rc = mnt_split_optstr(optstr, &u, &v, &f, 0, 0);
+	rc = mnt_fs_decode_lazy(fs, MNT_FS_LAZY_OPTIONS);
+	if (!rc)
+		rc = mnt_split_optstr(optstr, &u, &v, &f, 0, 0);
 	if (rc)
 		return rc;
 
@@ -1061,6 +1178,8 @@ const char *mnt_fs_get_fs_options(struct libmnt_fs *fs)
 		return NULL;
 	if (fs->optlist)
 		sync_opts_from_optlist(fs, fs->optlist);
+	if (mnt_fs_decode_lazy(fs, MNT_FS_LAZY_FSOPTS))
+		return NULL;
 
 	return fs->fs_optstr;
 }
@@ -1077,6 +1196,8 @@ const char *mnt_fs_get_vfs_options(struct libmnt_fs *fs)
 		return NULL;
 	if (fs->optlist)
 		sync_opts_from_optlist(fs, fs->optlist);
+	if (mnt_fs_decode_lazy(fs, MNT_FS_LAZY_VFSOPTS))
+		return NULL;
 
 	return fs->vfs_optstr;
 }
@@ -1257,7 +1378,9 @@ int mnt_fs_set_passno(struct libmnt_fs *fs, int passno)
  */
 const char *mnt_fs_get_root(struct libmnt_fs *fs)
 {
-	return fs ? fs->root : NULL;
+	if (!fs || mnt_fs_decode_lazy(fs, MNT_FS_LAZY_ROOT))
+		return NULL;
+	return fs->root;
 }
 
 /**
@@ -1269,6 +1392,8 @@ const char *mnt_fs_get_root(struct libmnt_fs *fs)
  */
 int mnt_fs_set_root(struct libmnt_fs *fs, const char *path)
 {
+	if (fs)
+		fs->lazy_mask &= ~MNT_FS_LAZY_ROOT;
 	return strdup_to_struct_member(fs, root, path);
 }
 
@@ -1367,6 +1492,23 @@ int mnt_fs_get_id(struct libmnt_fs *fs)
 	return fs ? fs->id : -EINVAL;
 }
 
+/**
+ * mnt_fs_get_uniq_id:
+ * @fs: filesystem from the kernel mount table
+ *
+ * The 64-bit unique mount ID is never reused by kernel. The ID is available
+ * only for entries read by listmount() and statmount() syscalls, see
+ * mnt_table_fetch_listmount().
+ *
+ * Returns: unique mount ID or 0 if not available.
+ *
+ * Since: 2.41
+ */
+uint64_t mnt_fs_get_uniq_id(struct libmnt_fs *fs)
+{
+	return fs ? fs->uniq_id : 0;
+}
+
 /**
  * mnt_fs_get_parent_id:
  * @fs: /proc/self/mountinfo entry
@@ -1419,6 +1561,8 @@ int mnt_fs_get_option(struct libmnt_fs *fs, const char *name,
 
 	if (fs->optlist)
 		sync_opts_from_optlist(fs, fs->optlist);
+	if (mnt_fs_decode_lazy(fs, MNT_FS_LAZY_VFSOPTS | MNT_FS_LAZY_FSOPTS))
+		return -ENOMEM;
 
 	if (fs->fs_optstr)
 		rc = mnt_optstr_get_option(fs->fs_optstr, name, value, valsz);
@@ -1711,6 +1855,8 @@ int mnt_fs_print_debug(struct libmnt_fs *fs, FILE *file)
 		fprintf(file, "pass:   %d\n", mnt_fs_get_passno(fs));
 	if (mnt_fs_get_id(fs))
 		fprintf(file, "id:     %d\n", mnt_fs_get_id(fs));
+	if (mnt_fs_get_uniq_id(fs))
+		fprintf(file, "uniq-id: %" PRIu64 "\n", mnt_fs_get_uniq_id(fs));
 	if (mnt_fs_get_parent_id(fs))
 		fprintf(file, "parent: %d\n", mnt_fs_get_parent_id(fs));
 	if (mnt_fs_get_devno(fs))
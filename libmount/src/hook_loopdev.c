@@ -131,7 +131,7 @@ static int setup_loopdev(struct libmnt_context *cxt,
 	struct loopdev_cxt lc;
 	int rc = 0, lo_flags = 0;
 	uint64_t offset = 0, sizelimit = 0;
-	bool reuse = FALSE;
+	bool reuse = FALSE, autotune = FALSE;
 	struct libmnt_opt *opt, *loopopt = NULL;
 
 	backing_file = mnt_fs_get_srcpath(cxt->fs);
@@ -173,6 +173,14 @@ static int setup_loopdev(struct libmnt_context *cxt,
 		}
 	}
 
+	/*
+	 * loop.autotune
+	 */
+	if (!rc && mnt_optlist_get_opt(ol, MNT_MS_LOOP_AUTOTUNE, cxt->map_userspace)) {
+		DBG(LOOP, ul_debugobj(cxt, "enabling autotune"));
+		autotune = TRUE;
+	}
+
 	/*
 	 * encryption=
 	 */
@@ -312,6 +320,8 @@ static int setup_loopdev(struct libmnt_context *cxt,
 			rc = loopcxt_set_sizelimit(&lc, sizelimit);
 		if (!rc)
 			loopcxt_set_flags(&lc, lo_flags);
+		if (!rc && autotune)
+			rc = loopcxt_set_autotune(&lc, 1);
 		if (rc) {
 			DBG(LOOP, ul_debugobj(cxt, "failed to set loop attributes"));
 			goto done;
@@ -423,7 +433,8 @@ static int is_loopdev_required(struct libmnt_context *cxt, struct libmnt_optlist
 	if (mnt_context_get_user_mflags(cxt, &flags))
 		return 0;
 
-	if (flags & (MNT_MS_LOOP | MNT_MS_OFFSET | MNT_MS_SIZELIMIT)) {
+	if (flags & (MNT_MS_LOOP | MNT_MS_OFFSET | MNT_MS_SIZELIMIT |
+		     MNT_MS_LOOP_AUTOTUNE)) {
 		DBG(LOOP, ul_debugobj(cxt, "loopdev specific options detected"));
 		return 1;
 	}
@@ -359,10 +359,13 @@ static int hook_create_mount(struct libmnt_context *cxt,
 		rc = statx(api->fd_tree, "", AT_EMPTY_PATH, STATX_MNT_ID, &st);
 		if (rc == 0) {
 			cxt->fs->id = (int) st.stx_mnt_id;
+			mnt_table_drop_index(cxt->fs->tab);
 			if (cxt->update) {
 				struct libmnt_fs *fs = mnt_update_get_fs(cxt->update);
-				if (fs)
+				if (fs) {
 					fs->id = cxt->fs->id;
+					mnt_table_drop_index(fs->tab);
+				}
 			}
 		}
 	}
@@ -578,6 +581,28 @@ static int hook_attach_target(struct libmnt_context *cxt,
 	return rc == 0 ? 0 : -errno;
 }
 
+/*
+ * Closes the file descriptors of the already attached filesystem, so the next
+ * MNT_STAGE_MOUNT creates a new instance of the filesystem by fsopen(). Used
+ * by mnt_context_mount_targets(); it's possible only for new filesystems
+ * (no bind, move, remount, ...) if the mount does not depend on any other
+ * hookset.
+ */
+int mnt_context_rewind_sysapi(struct libmnt_context *cxt)
+{
+	struct libmnt_sysapi *api = get_sysapi(cxt);
+
+	if (!api || !api->is_new_fs || cxt->helper
+	    || mnt_context_has_other_hooks(cxt, &hookset_mount)) {
+		DBG(HOOK, ul_debugobj(&hookset_mount, "rewind unsupported"));
+		return -ENOTSUP;
+	}
+
+	DBG(HOOK, ul_debugobj(&hookset_mount, "rewind"));
+	close_sysapi_fds(api);
+	return 0;
+}
+
 static inline int fsopen_is_supported(void)
 {
 	int dummy, rc = 1;
@@ -28,6 +28,7 @@
  */
 #include "mountP.h"
 #include "mount-api-utils.h"
+#include "monotonic.h"
 
 /* built-in hooksets */
 static const struct libmnt_hookset *hooksets[] =
@@ -311,14 +312,98 @@ int mnt_context_has_hook(struct libmnt_context *cxt,
 	return get_hookset_hook(cxt, hs, stage, data) ? 1 : 0;
 }
 
-static int call_hook(struct libmnt_context *cxt, struct hookset_hook *hook)
+static uint64_t hookstat_now(void)
 {
-	int rc = 0;
+	struct timeval tv;
+
+	if (gettime_monotonic(&tv) != 0)
+		return 0;
+	return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static int add_hookstat(struct libmnt_context *cxt, const char *name, int stage,
+			uint64_t usec, unsigned int nsyscalls)
+{
+	struct libmnt_hookstat *st = NULL;
+	size_t i;
 
-	if (mnt_context_is_fake(cxt))
+	for (i = 0; i < cxt->nhookstats; i++) {
+		if (cxt->hookstats[i].stage == stage
+		    && cxt->hookstats[i].hookset == name) {
+			st = &cxt->hookstats[i];
+			break;
+		}
+	}
+	if (!st) {
+		st = realloc(cxt->hookstats,
+			     (cxt->nhookstats + 1) * sizeof(*st));
+		if (!st)
+			return -ENOMEM;
+		cxt->hookstats = st;
+		st = &cxt->hookstats[cxt->nhookstats++];
+		memset(st, 0, sizeof(*st));
+		st->hookset = name;
+		st->stage = stage;
+	}
+
+	st->usec += usec;
+	st->nsyscalls += nsyscalls;
+	st->ncalls++;
+	return 0;
+}
+
+void mnt_context_reset_hookstats(struct libmnt_context *cxt)
+{
+	free(cxt->hookstats);
+	cxt->hookstats = NULL;
+	cxt->nhookstats = 0;
+}
+
+/* calls the hook function and updates timing if enabled */
+static int run_hook(struct libmnt_context *cxt, const struct libmnt_hookset *hs,
+		    int stage, void *data,
+		    int (*func)(struct libmnt_context *,
+				const struct libmnt_hookset *,
+				void *))
+{
+	unsigned int nsyscalls = cxt->nsyscalls;
+	uint64_t start;
+	int rc;
+
+	if (mnt_context_is_fake(cxt)) {
 		DBG(CXT, ul_debugobj(cxt, " FAKE call"));
-	else
-		rc = hook->func(cxt, hook->hookset, hook->data);
+		return 0;
+	}
+	if (!cxt->timing)
+		return func(cxt, hs, data);
+
+	start = hookstat_now();
+	rc = func(cxt, hs, data);
+	add_hookstat(cxt, hs->name, stage, hookstat_now() - start,
+			cxt->nsyscalls - nsyscalls);
+	return rc;
+}
+
+/* returns 1 if there is any hook which does not belong to @hs */
+int mnt_context_has_other_hooks(struct libmnt_context *cxt,
+				const struct libmnt_hookset *hs)
+{
+	struct list_head *p;
+
+	list_for_each(p, &cxt->hooksets_hooks) {
+		struct hookset_hook *x = list_entry(p, struct hookset_hook, hooks);
+
+		if (x->hookset != hs)
+			return 1;
+	}
+	return 0;
+}
+
+static int call_hook(struct libmnt_context *cxt, struct hookset_hook *hook)
+{
+	int rc;
+
+	rc = run_hook(cxt, hook->hookset, hook->stage, hook->data, hook->func);
 
 	hook->executed = 1;
 	if (!rc)
@@ -350,6 +435,8 @@ static int call_depend_hooks(struct libmnt_context *cxt, const char *name, int s
 int mnt_context_call_hooks(struct libmnt_context *cxt, int stage)
 {
 	struct list_head *p = NULL, *next = NULL;
+	unsigned int nsyscalls = cxt->nsyscalls;
+	uint64_t start = cxt->timing ? hookstat_now() : 0;
 	size_t i;
 	int rc = 0;
 
@@ -364,10 +451,7 @@ int mnt_context_call_hooks(struct libmnt_context *cxt, int stage)
 
 		DBG(CXT, ul_debugobj(cxt, "calling %s [first]", hs->name));
 
-		if (mnt_context_is_fake(cxt))
-			DBG(CXT, ul_debugobj(cxt, " FAKE call"));
-		else
-			rc = hs->firstcall(cxt, hs, NULL);
+		rc = run_hook(cxt, hs, stage, NULL, hs->firstcall);
 		if (!rc)
 			rc = call_depend_hooks(cxt, hs->name, stage);
 		if (rc < 0)
@@ -398,7 +482,80 @@ done:
 		x->executed = 0;
 	}
 
+	if (cxt->timing)
+		add_hookstat(cxt, NULL, stage, hookstat_now() - start,
+				cxt->nsyscalls - nsyscalls);
+
 	DBG(CXT, ul_debugobj(cxt, "<--- stage:%s [rc=%d status=%d]",
 				stagenames[stage], rc, cxt->syscall_status));
 	return rc;
 }
+
+/**
+ * mnt_context_enable_timing:
+ * @cxt: mount context
+ * @enable: TRUE or FALSE
+ *
+ * Enable/disable collecting of the time spent in the library hooks (loop
+ * device setup, mount(2) or new mount API syscalls, SELinux, ID-mapping, ...).
+ * The statistics are reset by mnt_reset_context(), it means that for
+ * mnt_context_next_mount() they describe the last mount only.
+ *
+ * See mnt_context_get_timing().
+ *
+ * Returns: 0 on success, negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_context_enable_timing(struct libmnt_context *cxt, int enable)
+{
+	if (!cxt)
+		return -EINVAL;
+	cxt->timing = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * mnt_context_get_timing:
+ * @cxt: mount context
+ * @idx: index of the record
+ * @stage: returns stage name (e.g. "prep-source", "mount")
+ * @hookset: returns hookset name or NULL for the whole stage
+ * @usec: returns time in microseconds
+ * @ncalls: returns number of hook calls
+ * @nsyscalls: returns number of mount related syscalls
+ *
+ * Returns one timing record from the last mount operation. The records are
+ * in order of the first call; the record with NULL @hookset follows all hooks
+ * of the stage and describes the whole stage. All the output arguments are
+ * optional.
+ *
+ * Returns: 0 on success, 1 if @idx is out of range, negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_context_get_timing(struct libmnt_context *cxt, size_t idx,
+			   const char **stage, const char **hookset,
+			   uint64_t *usec, unsigned int *ncalls,
+			   unsigned int *nsyscalls)
+{
+	struct libmnt_hookstat *st;
+
+	if (!cxt)
+		return -EINVAL;
+	if (idx >= cxt->nhookstats)
+		return 1;
+
+	st = &cxt->hookstats[idx];
+	if (stage)
+		*stage = stagenames[st->stage];
+	if (hookset)
+		*hookset = st->hookset;
+	if (usec)
+		*usec = st->usec;
+	if (ncalls)
+		*ncalls = st->ncalls;
+	if (nsyscalls)
+		*nsyscalls = st->nsyscalls;
+	return 0;
+}
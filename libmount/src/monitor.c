@@ -33,6 +33,27 @@
  *   </programlisting>
  * </informalexample>
  *
+ * The kernel monitor reports only that something has been changed in the
+ * kernel mount table. The fanotify monitor (see mnt_monitor_enable_fanotify())
+ * reports the unique IDs of the attached and detached mounts, it's possible
+ * to update an already existing table by mnt_table_update_mount() rather than
+ * to re-read all the mount table:
+ *
+ * <informalexample>
+ *   <programlisting>
+ * struct libmnt_table *tb = mnt_new_table();
+ * struct libmnt_monitor *mn = mnt_new_monitor();
+ * uint64_t id;
+ *
+ * mnt_table_fetch_listmount(tb);
+ * mnt_monitor_enable_fanotify(mn, TRUE);
+ *
+ * while (mnt_monitor_wait(mn, -1) > 0) {
+ *    while (mnt_monitor_next_mount(mn, &id, NULL) == 0)
+ *       mnt_table_update_mount(tb, id, NULL);
+ * }
+ *   </programlisting>
+ * </informalexample>
  */
 
 #include "fileutils.h"
@@ -41,7 +62,31 @@
 
 #include <sys/inotify.h>
 #include <sys/epoll.h>
-
+#include <inttypes.h>
+
+#ifdef HAVE_SYS_FANOTIFY_H
+# include <sys/fanotify.h>
+# ifndef FAN_REPORT_MNT
+#  define FAN_REPORT_MNT	0x00004000
+# endif
+# ifndef FAN_MARK_MNTNS
+#  define FAN_MARK_MNTNS	0x00000110
+# endif
+# ifndef FAN_MNT_ATTACH
+#  define FAN_MNT_ATTACH	0x01000000
+# endif
+# ifndef FAN_MNT_DETACH
+#  define FAN_MNT_DETACH	0x02000000
+# endif
+# ifndef FAN_EVENT_INFO_TYPE_MNT
+#  define FAN_EVENT_INFO_TYPE_MNT 7
+# endif
+
+struct ul_fanotify_event_info_mnt {
+	struct fanotify_event_info_header hdr;
+	uint64_t mnt_id;
+};
+#endif /* HAVE_SYS_FANOTIFY_H */
 
 struct monitor_opers;
 
@@ -52,6 +97,7 @@ struct monitor_entry {
 	uint32_t		events;		/* wanted epoll events */
 
 	const struct monitor_opers *opers;
+	void			*data;		/* type specific data */
 
 	unsigned int		enable : 1,
 				changed : 1;
@@ -64,6 +110,7 @@ struct libmnt_monitor {
 	int			fd;		/* public monitor file descriptor */
 
 	struct list_head	ents;
+	struct libmnt_cache	*cache;		/* invalidated on mount changes */
 
 	unsigned int		kernel_veiled: 1;
 };
@@ -119,6 +166,7 @@ static void free_monitor_entry(struct monitor_entry *me)
 	if (me->fd >= 0)
 		close(me->fd);
 	free(me->path);
+	free(me->data);
 	free(me);
 }
 
@@ -144,6 +192,7 @@ void mnt_unref_monitor(struct libmnt_monitor *mn)
 			free_monitor_entry(me);
 		}
 
+		mnt_unref_cache(mn->cache);
 		free(mn);
 	}
 }
@@ -563,6 +612,323 @@ err:
 	return rc;
 }
 
+
+/*
+ * Fanotify monitor
+ */
+
+/* max number of unread events, more events are reported as overflow */
+#define MOUNT_EVENTS_MAX	(16 * 1024)
+
+struct mount_event {
+	uint64_t	id;
+	int		oper;	/* MNT_TABDIFF_* */
+};
+
+struct mount_events {
+	size_t	nents;
+	size_t	cur;
+	size_t	size;
+
+	unsigned int overflow : 1;	/* lost events */
+
+	struct mount_event ents[];
+};
+
+#ifdef HAVE_SYS_FANOTIFY_H
+static int fanotify_monitor_get_fd(struct libmnt_monitor *mn,
+				   struct monitor_entry *me)
+{
+	int rc, ns;
+
+	if (!me || me->enable == 0)	/* not-initialized or disabled */
+		return -EINVAL;
+	if (me->fd >= 0)
+		return me->fd;		/* already initialized */
+
+	assert(me->path);
+	DBG(MONITOR, ul_debugobj(mn, " open fanotify monitor for %s", me->path));
+
+	me->fd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_MNT |
+			       FAN_CLOEXEC | FAN_NONBLOCK, O_RDONLY);
+	if (me->fd < 0)
+		goto err;
+
+	ns = open(me->path, O_RDONLY | O_CLOEXEC);
+	if (ns < 0)
+		goto err;
+
+	rc = fanotify_mark(me->fd, FAN_MARK_ADD | FAN_MARK_MNTNS,
+			   FAN_MNT_ATTACH | FAN_MNT_DETACH, ns, NULL);
+	close(ns);
+	if (rc < 0)
+		goto err;
+
+	return me->fd;
+err:
+	rc = -errno;
+	if (me->fd >= 0)
+		close(me->fd);
+	me->fd = -1;
+	DBG(MONITOR, ul_debugobj(mn, "failed to create fanotify monitor [rc=%d]", rc));
+	return rc;
+}
+
+/* @id zero means lost events */
+static int add_mount_event(struct monitor_entry *me, uint64_t id, int oper)
+{
+	struct mount_events *evs = me->data;
+
+	if (evs && evs->cur == evs->nents)
+		evs->cur = evs->nents = 0;
+
+	if (!evs || (id && evs->nents == evs->size)) {
+		size_t sz = evs ? evs->size * 2 : 64;
+
+		if (sz > MOUNT_EVENTS_MAX) {
+			evs->overflow = 1;
+			return 0;
+		}
+		evs = realloc(me->data, sizeof(*evs) + sz * sizeof(struct mount_event));
+		if (!evs)
+			return -ENOMEM;
+		if (!me->data)
+			evs->nents = evs->cur = evs->overflow = 0;
+		evs->size = sz;
+		me->data = evs;
+	}
+	if (!id) {
+		evs->overflow = 1;
+		return 0;
+	}
+
+	evs->ents[evs->nents].id = id;
+	evs->ents[evs->nents].oper = oper;
+	evs->nents++;
+	return 0;
+}
+
+/* reads all pending events; returns number of events or <0 on error */
+static int read_mount_events(struct libmnt_monitor *mn, struct monitor_entry *me)
+{
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct fanotify_event_metadata))));
+	int count = 0;
+
+	do {
+		struct fanotify_event_metadata *ev;
+		ssize_t len;
+
+		len = read(me->fd, buf, sizeof(buf));
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				break;
+			return -errno;
+		}
+		if (len == 0)
+			break;
+
+		for (ev = (struct fanotify_event_metadata *) buf;
+		     FAN_EVENT_OK(ev, len);
+		     ev = FAN_EVENT_NEXT(ev, len)) {
+			char *p = (char *) ev + ev->metadata_len,
+			     *end = (char *) ev + ev->event_len;
+			int oper, rc;
+
+			if (ev->vers != FANOTIFY_METADATA_VERSION)
+				continue;
+			if (ev->mask & FAN_Q_OVERFLOW) {
+				DBG(MONITOR, ul_debugobj(mn, "fanotify: overflow"));
+				rc = add_mount_event(me, 0, 0);
+				if (rc)
+					return rc;
+				count++;
+				continue;
+			}
+			if ((ev->mask & FAN_MNT_ATTACH) && (ev->mask & FAN_MNT_DETACH))
+				oper = MNT_TABDIFF_MOVE;
+			else if (ev->mask & FAN_MNT_ATTACH)
+				oper = MNT_TABDIFF_MOUNT;
+			else if (ev->mask & FAN_MNT_DETACH)
+				oper = MNT_TABDIFF_UMOUNT;
+			else
+				continue;
+
+			while (p + sizeof(struct ul_fanotify_event_info_mnt) <= end) {
+				struct ul_fanotify_event_info_mnt *info = (void *) p;
+
+				if (info->hdr.len == 0)
+					break;
+				if (info->hdr.info_type == FAN_EVENT_INFO_TYPE_MNT) {
+					DBG(MONITOR, ul_debugobj(mn, "fanotify: mount %" PRIu64
+							" [change=%d]", info->mnt_id, oper));
+					rc = add_mount_event(me, info->mnt_id, oper);
+					if (rc)
+						return rc;
+					count++;
+				}
+				p += info->hdr.len;
+			}
+		}
+	} while (1);
+
+	return count;
+}
+
+static int fanotify_event_verify(struct libmnt_monitor *mn,
+				 struct monitor_entry *me)
+{
+	if (!mn || !me || me->fd < 0)
+		return 0;
+
+	return read_mount_events(mn, me) > 0 ? 1 : 0;
+}
+
+/*
+ * fanotify monitor operations
+ */
+static const struct monitor_opers fanotify_opers = {
+	.op_get_fd		= fanotify_monitor_get_fd,
+	.op_close_fd		= kernel_monitor_close_fd,
+	.op_event_verify	= fanotify_event_verify
+};
+#endif /* HAVE_SYS_FANOTIFY_H */
+
+/**
+ * mnt_monitor_enable_fanotify:
+ * @mn: monitor
+ * @enable: 0 or 1
+ *
+ * Enables or disables fanotify based monitoring of the current mount
+ * namespace. In difference to mnt_monitor_enable_kernel(), this monitor
+ * provides unique IDs of the attached and detached mounts, see
+ * mnt_monitor_next_mount(). The monitor does not report changes of the
+ * mount options or propagation flags.
+ *
+ * The fanotify mount notifications are supported since Linux 6.15 and they
+ * require CAP_SYS_ADMIN in the mount namespace.
+ *
+ * Return: 0 on success and <0 on error (-ENOSYS if not supported)
+ *
+ * Since: 2.41
+ */
+int mnt_monitor_enable_fanotify(struct libmnt_monitor *mn, int enable)
+{
+#ifdef HAVE_SYS_FANOTIFY_H
+	struct monitor_entry *me;
+	int rc = 0;
+
+	if (!mn)
+		return -EINVAL;
+
+	me = monitor_get_entry(mn, MNT_MONITOR_TYPE_FANOTIFY);
+	if (me) {
+		rc = monitor_modify_epoll(mn, me, enable);
+		if (!enable)
+			kernel_monitor_close_fd(mn, me);
+		return rc;
+	}
+	if (!enable)
+		return 0;
+
+	DBG(MONITOR, ul_debugobj(mn, "allocate new fanotify monitor"));
+
+	/* create a new entry */
+	me = monitor_new_entry(mn);
+	if (!me)
+		goto err;
+
+	/* the events are always read by fanotify_event_verify(), so
+	 * edge-triggered mode is fine (see mnt_monitor_enable_kernel()) */
+	me->events = EPOLLIN | EPOLLET;
+
+	me->type = MNT_MONITOR_TYPE_FANOTIFY;
+	me->opers = &fanotify_opers;
+	me->path = strdup("/proc/self/ns/mnt");
+	if (!me->path)
+		goto err;
+
+	/* check for kernel support now rather than in mnt_monitor_get_fd() */
+	me->enable = 1;
+	rc = fanotify_monitor_get_fd(mn, me);
+	if (rc < 0) {
+		if (rc == -EINVAL)
+			rc = -ENOSYS;	/* unsupported FAN_REPORT_MNT */
+		free_monitor_entry(me);
+		return rc;
+	}
+
+	return monitor_modify_epoll(mn, me, TRUE);
+err:
+	rc = -errno;
+	free_monitor_entry(me);
+	DBG(MONITOR, ul_debugobj(mn, "failed to allocate fanotify monitor [rc=%d]", rc));
+	return rc;
+#else
+	if (!mn)
+		return -EINVAL;
+	return enable ? -ENOSYS : 0;
+#endif
+}
+
+/**
+ * mnt_monitor_next_mount:
+ * @mn: monitor
+ * @id: returns unique mount ID
+ * @oper: returns MNT_TABDIFF_{MOUNT,UMOUNT,MOVE} (optional argument)
+ *
+ * Returns the next mount changed according to fanotify monitor, see
+ * mnt_monitor_enable_fanotify(). The function does not wait. The @id is
+ * usable for mnt_table_update_mount() or for statmount() syscall.
+ *
+ * If the kernel has dropped some events, then the function returns -ENOBUFS
+ * (only once), and it's necessary to re-read the whole mount table.
+ *
+ * Returns: 0 on success, 1 no change, <0 on error
+ *
+ * Since: 2.41
+ */
+int mnt_monitor_next_mount(struct libmnt_monitor *mn, uint64_t *id, int *oper)
+{
+	struct monitor_entry *me;
+	struct mount_events *evs;
+	struct mount_event *ev;
+
+	if (!mn || !id)
+		return -EINVAL;
+
+	me = monitor_get_entry(mn, MNT_MONITOR_TYPE_FANOTIFY);
+	if (!me || !me->enable || me->fd < 0)
+		return -EINVAL;
+
+	evs = me->data;
+#ifdef HAVE_SYS_FANOTIFY_H
+	if (!evs || evs->cur == evs->nents) {
+		int rc = read_mount_events(mn, me);
+
+		if (rc < 0)
+			return rc;
+		evs = me->data;
+	}
+#endif
+	if (evs && evs->overflow) {
+		evs->cur = evs->nents = 0;
+		evs->overflow = 0;
+		mnt_cache_invalidate(mn->cache);
+		return -ENOBUFS;
+	}
+	if (!evs || evs->cur == evs->nents)
+		return 1;
+
+	mnt_cache_invalidate(mn->cache);
+	ev = &evs->ents[evs->cur++];
+	*id = ev->id;
+	if (oper)
+		*oper = ev->oper;
+	return 0;
+}
+
 /**
  * mnt_monitor_veil_kernel:
  * @mn: monitor instance
@@ -585,6 +951,34 @@ int mnt_monitor_veil_kernel(struct libmnt_monitor *mn, int enable)
 	return 0;
 }
 
+/**
+ * mnt_monitor_set_cache:
+ * @mn: monitor instance
+ * @cache: cache or NULL
+ *
+ * The @cache is invalidated by mnt_cache_invalidate() whenever
+ * mnt_monitor_next_change() returns a kernel mount table change or
+ * mnt_monitor_next_mount() returns a mount event. The monitor keeps a reference
+ * to the @cache; use NULL to remove the cache from the monitor.
+ *
+ * This allows long-running processes to share the same cache for many mount
+ * table queries without stale paths.
+ *
+ * Return: 0 on success and <0 on error.
+ *
+ * Since: 2.41
+ */
+int mnt_monitor_set_cache(struct libmnt_monitor *mn, struct libmnt_cache *cache)
+{
+	if (!mn)
+		return -EINVAL;
+
+	mnt_ref_cache(cache);
+	mnt_unref_cache(mn->cache);
+	mn->cache = cache;
+	return 0;
+}
+
 /*
  * Add/Remove monitor entry to/from monitor epoll.
  */
@@ -838,6 +1232,9 @@ int mnt_monitor_next_change(struct libmnt_monitor *mn,
 
 	me->changed = 0;
 
+	if (mn->cache && me->type != MNT_MONITOR_TYPE_USERSPACE)
+		mnt_cache_invalidate(mn->cache);
+
 	if (filename)
 		*filename = me->path;
 	if (type)
@@ -892,6 +1289,11 @@ static struct libmnt_monitor *create_test_monitor(int argc, char *argv[])
 				warn("failed to initialize kernel monitor");
 				goto err;
 			}
+		} else if (strcmp(argv[i], "fanotify") == 0) {
+			if (mnt_monitor_enable_fanotify(mn, TRUE)) {
+				warn("failed to initialize fanotify monitor");
+				goto err;
+			}
 		} else if (strcmp(argv[i], "veil") == 0) {
 			mnt_monitor_veil_kernel(mn, 1);
 		}
@@ -995,6 +1397,8 @@ static int test_wait(struct libmnt_test *ts __attribute__((unused)),
 {
 	const char *filename;
 	struct libmnt_monitor *mn = create_test_monitor(argc, argv);
+	uint64_t id;
+	int type, oper;
 
 	if (!mn)
 		return -1;
@@ -1003,8 +1407,16 @@ static int test_wait(struct libmnt_test *ts __attribute__((unused)),
 	while (mnt_monitor_wait(mn, -1) > 0) {
 		printf("notification detected\n");
 
-		while (mnt_monitor_next_change(mn, &filename, NULL) == 0)
+		while (mnt_monitor_next_change(mn, &filename, &type) == 0) {
 			printf(" %s: change detected\n", filename);
+			if (type != MNT_MONITOR_TYPE_FANOTIFY)
+				continue;
+			while (mnt_monitor_next_mount(mn, &id, &oper) == 0)
+				printf("  mount %" PRIu64 ": %s\n", id,
+					oper == MNT_TABDIFF_MOUNT ? "attached" :
+					oper == MNT_TABDIFF_UMOUNT ? "detached" :
+					"moved");
+		}
 
 		printf("waiting for changes...\n");
 	}
@@ -1017,7 +1429,7 @@ int main(int argc, char *argv[])
 	struct libmnt_test tss[] = {
 		{ "--epoll", test_epoll, "<userspace kernel veil ...>  monitor in epoll" },
 		{ "--epoll-clean", test_epoll_cleanup, "<userspace kernel veil ...>  monitor in epoll and clean events" },
-		{ "--wait",  test_wait,  "<userspace kernel veil ...>  monitor wait function" },
+		{ "--wait",  test_wait,  "<userspace kernel fanotify veil ...>  monitor wait function" },
 		{ NULL }
 	};
 
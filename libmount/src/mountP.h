@@ -27,6 +27,7 @@
 #include "c.h"
 #include "list.h"
 #include "debug.h"
+#include "ultrace.h"
 #include "buffer.h"
 #include "libmount.h"
 
@@ -100,6 +101,7 @@ extern int mnt_run_test(struct libmnt_test *tests, int argc, char *argv[]);
 extern int mnt_valid_tagname(const char *tagname);
 
 extern const char *mnt_statfs_get_fstype(struct statfs *vfs);
+extern const char *mnt_get_static_fstype(const char *type, int *flags);
 extern int is_file_empty(const char *name);
 
 extern int mnt_is_readonly(const char *path)
@@ -155,6 +157,7 @@ extern int __mnt_table_is_fs_mounted(	struct libmnt_table *tb,
 
 extern int mnt_table_enable_noautofs(struct libmnt_table *tb, int ignore);
 extern int mnt_table_is_noautofs(struct libmnt_table *tb);
+extern void mnt_table_drop_index(struct libmnt_table *tb);
 
 /*
  * Generic iterator
@@ -199,6 +202,7 @@ struct libmnt_fs {
 	struct libmnt_optlist *optlist;
 
 	int		id;		/* mountinfo[1]: ID */
+	uint64_t	uniq_id;	/* statmount(): unique mount ID */
 	int		parent;		/* mountinfo[2]: parent */
 	dev_t		devno;		/* mountinfo[3]: st_dev */
 
@@ -212,6 +216,7 @@ struct libmnt_fs {
 	char		*root;		/* mountinfo[4]: root of the mount within the FS */
 	char		*target;	/* mountinfo[5], fstab[2]: mountpoint */
 	char		*fstype;	/* mountinfo[9], fstab[3]: filesystem type */
+	unsigned int	fstype_static : 1; /* fstype from mnt_get_static_fstype() */
 
 	char		*optstr;	/* fstab[4], merged options */
 	char		*vfs_optstr;	/* mountinfo[6]: fs-independent (VFS) options */
@@ -220,6 +225,9 @@ struct libmnt_fs {
 	char		*user_optstr;	/* userspace mount options */
 	char		*attrs;		/* mount attributes */
 
+	char		*lazy;		/* not yet decoded mountinfo fields */
+	unsigned int	lazy_mask;	/* MNT_FS_LAZY_* fields in @lazy */
+
 	int		freq;		/* fstab[5]: dump frequency in days */
 	int		passno;		/* fstab[6]: pass number on parallel fsck */
 
@@ -246,6 +254,22 @@ struct libmnt_fs {
 #define MNT_FS_KERNEL	(1 << 4) /* data from /proc/{mounts,self/mountinfo} */
 #define MNT_FS_MERGED	(1 << 5) /* already merged data from /run/mount/utab */
 
+/*
+ * Lazy decoded mountinfo fields; the mountinfo parser stores the fields to
+ * one buffer (fs->lazy) in this order and they are copied to the struct
+ * members on the first request.
+ */
+#define MNT_FS_LAZY_ROOT	(1 << 0)
+#define MNT_FS_LAZY_VFSOPTS	(1 << 1)
+#define MNT_FS_LAZY_OPTFIELDS	(1 << 2)
+#define MNT_FS_LAZY_FSOPTS	(1 << 3)
+#define MNT_FS_LAZY_OPTSTR	(1 << 4) /* merged VFS and FS options */
+
+#define MNT_FS_LAZY_OPTIONS	(MNT_FS_LAZY_VFSOPTS | MNT_FS_LAZY_FSOPTS | \
+				 MNT_FS_LAZY_OPTSTR)
+#define MNT_FS_LAZY_ALL		(MNT_FS_LAZY_ROOT | MNT_FS_LAZY_OPTFIELDS | \
+				 MNT_FS_LAZY_OPTIONS)
+
 /*
  * fstab/mountinfo file
  */
@@ -267,6 +291,12 @@ struct libmnt_table {
 
 	int		noautofs;	/* ignore autofs mounts */
 
+	unsigned int	listmount :1;	/* use listmount() for kernel table */
+	uint64_t	lsmnt_mask;	/* statmount() mask, 0 means default */
+	char		*lsmnt_root;	/* listmount() subtree */
+
+	struct libmnt_tabidx *idx;	/* lookup indexes, built on demand */
+
 	struct list_head	ents;	/* list of entries (libmnt_fs) */
 	void		*userdata;
 };
@@ -363,7 +393,10 @@ extern int mnt_context_remove_hook(struct libmnt_context *cxt,
 			const struct libmnt_hookset *hs,
 			int stage,
 			void **data);
+extern int mnt_context_has_other_hooks(struct libmnt_context *cxt,
+			const struct libmnt_hookset *hs);
 extern int mnt_context_call_hooks(struct libmnt_context *cxt, int stage);
+extern void mnt_context_reset_hookstats(struct libmnt_context *cxt);
 
 /*
  * Namespace
@@ -373,6 +406,27 @@ struct libmnt_ns {
 	struct libmnt_cache *cache;	/* paths cache associated with NS */
 };
 
+/*
+ * "mount -a --fork" child
+ */
+struct libmnt_child {
+	pid_t	pid;		/* zero if already finished */
+	int	status;		/* wait(2) status */
+	char	*target;	/* mountpoint, for dependency scheduling only */
+	char	*source;	/* bind source or loop backing file, or NULL */
+};
+
+/*
+ * Hook timing, see mnt_context_enable_timing()
+ */
+struct libmnt_hookstat {
+	const char	*hookset;	/* hookset name, NULL for the whole stage */
+	int		stage;		/* MNT_STAGE_* */
+	uint64_t	usec;		/* time spent in the hook(s) */
+	unsigned int	ncalls;		/* number of calls */
+	unsigned int	nsyscalls;	/* number of syscalls (set_syscall_status()) */
+};
+
 /*
  * Mount context -- high-level API
  */
@@ -426,13 +480,18 @@ struct libmnt_context
 	int	helper_status;	/* helper wait(2) status */
 	int	helper_exec_status; /* 1: not called yet, 0: success, <0: -errno */
 
-	pid_t	*children;	/* "mount -a --fork" PIDs */
+	struct libmnt_child *children;	/* "mount -a --fork" children */
 	int	nchildren;	/* number of children */
+	unsigned int max_children; /* mnt_context_set_parallel() */
 	pid_t	pid;		/* 0=parent; PID=child */
 
 	int	syscall_status;	/* 1: not called yet, 0: success, <0: -errno */
 	const char *syscall_name;	/* failed syscall name */
 	char	*syscall_errmsg;	/* message from kernel */
+	unsigned int nsyscalls;		/* number of set_syscall_status() calls */
+
+	struct libmnt_hookstat *hookstats;	/* mnt_context_enable_timing() */
+	size_t	nhookstats;
 
 	struct libmnt_ns	ns_orig;	/* original namespace */
 	struct libmnt_ns	ns_tgt;		/* target namespace */
@@ -442,6 +501,7 @@ struct libmnt_context
 	unsigned int	noautofs : 1;		/* ignore autofs mounts */
 	unsigned int	has_selinux_opt : 1;	/* temporary for broken fsconfig() syscall */
 	unsigned int    force_clone : 1;	/* OPEN_TREE_CLONE */
+	unsigned int	timing : 1;		/* collect hookstats */
 
 	struct list_head	hooksets_datas;	/* global hooksets data */
 	struct list_head	hooksets_hooks;	/* global hooksets data */
@@ -482,6 +542,7 @@ struct libmnt_context
 
 static inline void set_syscall_status(struct libmnt_context *cxt, const char *name, int x)
 {
+	cxt->nsyscalls++;
 	if (!x) {
 		DBG(CXT, ul_debug("syscall '%s' [%m]", name));
 		cxt->syscall_status = -errno;
@@ -619,6 +680,13 @@ extern int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
 			__attribute__((nonnull(1)));
 extern int __mnt_fs_set_target_ptr(struct libmnt_fs *fs, char *tgt)
 			__attribute__((nonnull(1)));
+extern int __mnt_fs_decode_lazy(struct libmnt_fs *fs, unsigned int mask)
+			__attribute__((nonnull(1)));
+
+static inline int mnt_fs_decode_lazy(struct libmnt_fs *fs, unsigned int mask)
+{
+	return fs->lazy_mask & mask ? __mnt_fs_decode_lazy(fs, mask) : 0;
+}
 
 /* context.c */
 extern struct libmnt_context *mnt_copy_context(struct libmnt_context *o);
@@ -648,7 +716,8 @@ extern int mnt_context_propagation_only(struct libmnt_context *cxt)
 
 extern int mnt_context_delete_loopdev(struct libmnt_context *cxt);
 
-extern int mnt_fork_context(struct libmnt_context *cxt);
+extern int mnt_fork_context(struct libmnt_context *cxt, struct libmnt_fs *fs,
+			    const char *source);
 
 extern int mnt_context_set_tabfilter(struct libmnt_context *cxt,
 				     int (*fltr)(struct libmnt_fs *, void *),
@@ -667,6 +736,10 @@ extern int mnt_context_apply_fs(struct libmnt_context *cxt, struct libmnt_fs *fs
 
 extern struct libmnt_optlist *mnt_context_get_optlist(struct libmnt_context *cxt);
 
+/* tab_diff.c */
+extern int mnt_tabdiff_add_change(struct libmnt_tabdiff *df, struct libmnt_fs *old,
+			     struct libmnt_fs *new, int oper);
+
 /* tab_update.c */
 extern int mnt_update_emit_event(struct libmnt_update *upd);
 extern int mnt_update_set_filename(struct libmnt_update *upd, const char *filename);
@@ -692,6 +765,15 @@ static inline struct libmnt_sysapi *mnt_context_get_sysapi(struct libmnt_context
 {
 	return mnt_context_get_hookset_data(cxt, &hookset_mount);
 }
+
+/* hook_mount.c */
+extern int mnt_context_rewind_sysapi(struct libmnt_context *cxt);
+#else
+static inline int mnt_context_rewind_sysapi(
+			struct libmnt_context *cxt __attribute__((__unused__)))
+{
+	return -ENOTSUP;
+}
 #endif
 
 #endif /* _LIBMOUNT_PRIVATE_H */
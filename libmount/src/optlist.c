@@ -33,11 +33,20 @@ struct optlist_cache {
 		     optstr_ready : 1;
 };
 
+/* mnt_optlist_get_attrs() result, by MNT_OL_{REC,NOREC} */
+struct optlist_attrs_cache {
+	uint64_t set;
+	uint64_t clr;
+
+	unsigned int ready : 1;
+};
+
 struct libmnt_opt {
 	char *name;
 	char *value;
 
 	struct list_head opts;	/* libmnt_optlist->opts member */
+	struct libmnt_optlist *owner;
 
 	const struct libmnt_optmap	*map;
 	const struct libmnt_optmap	*ent;	/* map entry */
@@ -61,6 +70,7 @@ struct libmnt_optlist {
 
 	struct optlist_cache cache_mapped[MNT_OL_MAXMAPS];	/* cache by map */
 	struct optlist_cache cache_all[__MNT_OL_FLTR_COUNT];	/* from all maps, unknown, external, ... */
+	struct optlist_attrs_cache cache_attrs[MNT_OL_NOREC + 1];
 
 	unsigned long		propagation;	/* propagation MS_ flags */
 	struct list_head	opts;		/* parsed options */
@@ -163,20 +173,77 @@ static size_t optlist_get_mapidx(struct libmnt_optlist *ls, const struct libmnt_
 	return (size_t) -1;
 }
 
-static void optlist_cleanup_cache(struct libmnt_optlist *ls)
+static int is_wanted_opt(struct libmnt_opt *opt, const struct libmnt_optmap *map,
+		unsigned int what);
+
+static inline int is_rdonly_opt(struct libmnt_optlist *ls, struct libmnt_opt *opt)
+{
+	return opt->map == ls->linux_map && opt->ent && opt->ent->id == MS_RDONLY;
+}
+
+static inline void update_cached_flags(struct optlist_cache *cache,
+				       struct libmnt_opt *opt)
+{
+	if (opt->ent->mask & MNT_INVERT)
+		cache->flags &= ~opt->ent->id;
+	else
+		cache->flags |= opt->ent->id;
+}
+
+static inline void reset_cached_optstr(struct optlist_cache *cache)
+{
+	free(cache->optstr);
+	cache->optstr = NULL;
+	cache->optstr_ready = 0;
+}
+
+/*
+ * Updates the caches after a change of the @opt. Only the caches affected by
+ * the option are reset. The flags of the option appended to the end of the
+ * list are applied to the already calculated flags, because the last option
+ * wins.
+ *
+ * The "ro"/"rw" at the beginning of the option strings depends on MS_RDONLY
+ * option, so this option affects all the option strings.
+ */
+static void optlist_update_cache(struct libmnt_optlist *ls,
+				 struct libmnt_opt *opt, int appended)
 {
+	int rdonly = is_rdonly_opt(ls, opt);
+	int hasflag = opt->ent && opt->ent->id;
 	size_t i;
 
 	ls->age++;
 
-	if (list_empty(&ls->opts))
-		return;
+	for (i = 0; i < ls->nmaps; i++) {
+		struct optlist_cache *cache = &ls->cache_mapped[i];
 
-	for (i = 0; i < ARRAY_SIZE(ls->cache_mapped); i++)
-		reset_cache(&ls->cache_mapped[i]);
+		if (!rdonly && !is_wanted_opt(opt, ls->maps[i], MNT_OL_FLTR_DFLT))
+			continue;
 
-	for (i = 0; i < __MNT_OL_FLTR_COUNT; i++)
-		reset_cache(&ls->cache_all[i]);
+		if (cache->flags_ready && hasflag && opt->map == ls->maps[i]) {
+			if (appended && !opt->external)
+				update_cached_flags(cache, opt);
+			else
+				cache->flags_ready = 0;
+		}
+		if (cache->optstr_ready)
+			reset_cached_optstr(cache);
+	}
+
+	for (i = 0; i < __MNT_OL_FLTR_COUNT; i++) {
+		struct optlist_cache *cache = &ls->cache_all[i];
+
+		if (!rdonly && !is_wanted_opt(opt, NULL, i))
+			continue;
+
+		cache->flags_ready = 0;
+		if (cache->optstr_ready)
+			reset_cached_optstr(cache);
+	}
+
+	if (opt->map == ls->linux_map)
+		memset(ls->cache_attrs, 0, sizeof(ls->cache_attrs));
 }
 
 int mnt_optlist_remove_opt(struct libmnt_optlist *ls, struct libmnt_opt *opt)
@@ -206,9 +273,9 @@ int mnt_optlist_remove_opt(struct libmnt_optlist *ls, struct libmnt_opt *opt)
 			ls->is_recursive = 0;
 	}
 
-	optlist_cleanup_cache(ls);
-
 	list_del_init(&opt->opts);
+	optlist_update_cache(ls, opt, 0);
+
 	free(opt->value);
 	free(opt->name);
 	free(opt);
@@ -427,6 +494,7 @@ static struct libmnt_opt *optlist_new_opt(struct libmnt_optlist *ls,
 		return NULL;
 
 	INIT_LIST_HEAD(&opt->opts);
+	opt->owner = ls;
 	opt->map = map;
 	opt->ent = ent;
 
@@ -484,6 +552,8 @@ static struct libmnt_opt *optlist_new_opt(struct libmnt_optlist *ls,
 	    && is_vfs_opt(opt) && strcmp(opt->value, "recursive") == 0)
 		opt->recursive = 1;
 #endif
+	optlist_update_cache(ls, opt, where == NULL);
+
 	if (ent && map) {
 		DBG(OPTLIST, ul_debugobj(ls, " added %s [id=0x%08x map=%p]",
 				opt->name, ent->id, map));
@@ -530,8 +600,6 @@ static int optlist_add_optstr(struct libmnt_optlist *ls, const char *optstr,
 			where = &opt->opts;
 	}
 
-	optlist_cleanup_cache(ls);
-
 	return 0;
 }
 
@@ -634,8 +702,6 @@ static int optlist_add_flags(struct libmnt_optlist *ls, unsigned long flags,
 			where = &opt->opts;
 	}
 
-	optlist_cleanup_cache(ls);
-
 	return 0;
 }
 
@@ -840,6 +906,14 @@ int mnt_optlist_get_attrs(struct libmnt_optlist *ls, uint64_t *set, uint64_t *cl
 
 	if (!ls || !ls->linux_map || !set || !clr)
 		return -EINVAL;
+	if (rec < 0 || rec > MNT_OL_NOREC)
+		return -EINVAL;
+
+	if (ls->cache_attrs[rec].ready) {
+		*set = ls->cache_attrs[rec].set;
+		*clr = ls->cache_attrs[rec].clr;
+		return 0;
+	}
 
 	*set = 0, *clr = 0;
 	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
@@ -905,6 +979,10 @@ int mnt_optlist_get_attrs(struct libmnt_optlist *ls, uint64_t *set, uint64_t *cl
 	if (remount_reset)
 		*clr |= remount_reset;
 
+	ls->cache_attrs[rec].set = *set;
+	ls->cache_attrs[rec].clr = *clr;
+	ls->cache_attrs[rec].ready = 1;
+
 	DBG(OPTLIST, ul_debugobj(ls, "return attrs set=0x%08" PRIx64
 				      ", clr=0x%08" PRIx64 " %s",
 				*set, *clr,
@@ -1029,7 +1107,6 @@ struct libmnt_optlist *mnt_copy_optlist(struct libmnt_optlist *ls)
 	if (!n)
 		return NULL;
 
-	n->age = ls->age;
 	n->linux_map = ls->linux_map;
 
 	for (i = 0; i < ls->nmaps; i++)
@@ -1054,6 +1131,7 @@ struct libmnt_optlist *mnt_copy_optlist(struct libmnt_optlist *ls)
 	}
 
 	n->merged = ls->merged;
+	n->age = ls->age;
 	return n;
 }
 
@@ -1160,6 +1238,8 @@ int mnt_opt_set_value(struct libmnt_opt *opt, const char *str)
 
 	if (rc == 0 && str && strcmp(str, "recursive") == 0)
 		opt->recursive = 1;
+	if (opt->owner)
+		optlist_update_cache(opt->owner, opt, 0);
 	return rc;
 }
 
@@ -1182,7 +1262,15 @@ int mnt_opt_set_external(struct libmnt_opt *opt, int enable)
 {
 	if (!opt)
 		return -EINVAL;
+	if (opt->external == (enable ? 1 : 0))
+		return 0;
+
+	/* the option is removed from some caches and added to another */
+	if (opt->owner)
+		optlist_update_cache(opt->owner, opt, 0);
 	opt->external = enable ? 1 : 0;
+	if (opt->owner)
+		optlist_update_cache(opt->owner, opt, 0);
 	return 0;
 }
 
@@ -1416,6 +1504,44 @@ static int test_get_flg(struct libmnt_test *ts __attribute__((unused)),
 	return rc;
 }
 
+/* compare flags updated in the cache with flags from a fresh copy */
+static int test_append_get_flg(struct libmnt_test *ts __attribute__((unused)),
+			int argc, char *argv[])
+{
+	struct libmnt_optlist *ol, *cp = NULL;
+	const struct libmnt_optmap *map;
+	unsigned long flags = 0, cpflags = 0;
+	const char *str = NULL;
+	int rc;
+
+	if (argc < 4)
+		return -EINVAL;
+	map = get_map(argv[3]);
+	rc = mk_optlist(&ol, argv[1]);
+	if (!rc)
+		rc = mnt_optlist_get_flags(ol, &flags, map, 0);
+	if (!rc)
+		rc = mnt_optlist_get_optstr(ol, &str, NULL, 0);
+	if (!rc)
+		rc = mnt_optlist_append_optstr(ol, argv[2], NULL);
+	if (!rc)
+		rc = mnt_optlist_get_flags(ol, &flags, map, 0);
+	if (!rc)
+		rc = mnt_optlist_get_optstr(ol, &str, NULL, 0);
+	if (!rc)
+		cp = mnt_copy_optlist(ol);
+	if (cp)
+		rc = mnt_optlist_get_flags(cp, &cpflags, map, 0);
+	if (!rc) {
+		printf("cached: 0x%08lx\n", flags);
+		printf("copy:   0x%08lx\n", cpflags);
+		printf("optstr: %s\n", str);
+	}
+	mnt_unref_optlist(cp);
+	mnt_unref_optlist(ol);
+	return rc;
+}
+
 static int test_split(struct libmnt_test *ts __attribute__((unused)),
 		      int argc, char *argv[])
 {
@@ -1456,6 +1582,7 @@ int main(int argc, char *argv[])
 		{ "--set-flg",     test_set_flg,     "<list> <flg>  linux|user   set to the list" },
 		{ "--get-str",     test_get_str,     "<list> [linux|user]        all options in string" },
 		{ "--get-flg",     test_get_flg,     "<list>  linux|user         all options by flags" },
+		{ "--append-get-flg", test_append_get_flg, "<list> <str> linux|user  append and get flags" },
 		{ "--split",       test_split,       "<list>                     split options into key-value pairs"},
 
 		{ NULL }
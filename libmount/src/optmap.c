@@ -179,6 +179,7 @@ static const struct libmnt_optmap userspace_opts_map[] =
    { "offset=", MNT_MS_OFFSET, MNT_NOHLPS | MNT_NOMTAB },		   /* loop device offset */
    { "sizelimit=", MNT_MS_SIZELIMIT, MNT_NOHLPS | MNT_NOMTAB },	   /* loop device size limit */
    { "encryption=", MNT_MS_ENCRYPTION, MNT_NOHLPS | MNT_NOMTAB },	   /* loop device encryption */
+   { "loop.autotune", MNT_MS_LOOP_AUTOTUNE, MNT_NOHLPS | MNT_NOMTAB },  /* loop device direct I/O and block size */
 
    { "nofail",  MNT_MS_NOFAIL, MNT_NOMTAB },               /* Do not fail if ENOENT on dev */
 
@@ -169,9 +169,11 @@ void mnt_free_table(struct libmnt_table *tb)
 	mnt_reset_table(tb);
 	DBG(TAB, ul_debugobj(tb, "free [refcount=%d]", tb->refcount));
 
+	mnt_table_drop_index(tb);
 	mnt_unref_cache(tb->cache);
 	free(tb->comm_intro);
 	free(tb->comm_tail);
+	free(tb->lsmnt_root);
 	free(tb);
 }
 
@@ -452,6 +454,7 @@ int mnt_table_add_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 	list_add_tail(&fs->ents, &tb->ents);
 	fs->tab = tb;
 	tb->nents++;
+	mnt_table_drop_index(tb);
 
 	DBG(TAB, ul_debugobj(tb, "add entry: %s %s",
 			mnt_fs_get_source(fs), mnt_fs_get_target(fs)));
@@ -471,6 +474,7 @@ static int __table_insert_fs(
 
 	fs->tab = tb;
 	tb->nents++;
+	mnt_table_drop_index(tb);
 
 	DBG(TAB, ul_debugobj(tb, "insert entry: %s %s",
 			mnt_fs_get_source(fs), mnt_fs_get_target(fs)));
@@ -542,6 +546,7 @@ int mnt_table_move_fs(struct libmnt_table *src, struct libmnt_table *dst,
 	/* remove from source */
 	list_del_init(&fs->ents);
 	src->nents--;
+	mnt_table_drop_index(src);
 
 	/* insert to the destination */
 	return __table_insert_fs(dst, before, pos, fs);
@@ -569,15 +574,200 @@ int mnt_table_remove_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 
 	mnt_unref_fs(fs);
 	tb->nents--;
+	mnt_table_drop_index(tb);
 	return 0;
 }
 
+/*
+ * Lookup indexes
+ *
+ * The first (native, non-canonicalized) iteration of mnt_table_find_target(),
+ * mnt_table_find_srcpath(), mnt_table_find_devno(), mnt_table_find_uniq_id()
+ * and the "parent ID -> ID" lookups use hash indexes. The indexes are built on the first lookup and
+ * dropped on any change of the table or of the indexed entry fields, so they
+ * cost nothing for tables which are only parsed and iterated. Small tables
+ * are always searched linearly.
+ *
+ * Every hash chain keeps the entries in the table order, so the result is the
+ * same as for the linear search in the requested direction.
+ */
+#define MNT_TABIDX_MINENTS	32
+
+enum {
+	MNT_TABIDX_TARGET = 0,
+	MNT_TABIDX_SRCPATH,
+	MNT_TABIDX_DEVNO,
+	MNT_TABIDX_ID,
+	MNT_TABIDX_UNIQ_ID,
+
+	MNT_TABIDX_NKEYS
+};
+
+struct libmnt_tabidx_ent {
+	struct libmnt_fs *fs;
+	size_t		next[MNT_TABIDX_NKEYS];	/* next entry + 1, or 0 */
+};
+
+struct libmnt_tabidx {
+	size_t		nbuckets;	/* power of 2 */
+	size_t		*heads;		/* nbuckets for each key */
+	int		ntags;		/* number of entries with TAG source */
+
+	struct libmnt_tabidx_ent *ents;
+};
+
+static size_t hash_num(uint64_t x)
+{
+	return (x * 0x9E3779B97F4A7C15ULL) >> 32;
+}
+
+void mnt_table_drop_index(struct libmnt_table *tb)
+{
+	if (!tb || !tb->idx)
+		return;
+
+	DBG(TAB, ul_debugobj(tb, "drop lookup index"));
+	free(tb->idx->heads);
+	free(tb->idx->ents);
+	free(tb->idx);
+	tb->idx = NULL;
+}
+
+static inline void tabidx_add(struct libmnt_tabidx *idx, int key, size_t hash, size_t n)
+{
+	size_t *head = &idx->heads[key * idx->nbuckets + (hash & (idx->nbuckets - 1))];
+
+	idx->ents[n].next[key] = *head;
+	*head = n + 1;
+}
+
+/* Returns index or NULL if the table is small or on error */
+static struct libmnt_tabidx *tabidx_get(struct libmnt_table *tb)
+{
+	struct libmnt_tabidx *idx;
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+	size_t n;
+
+	if (tb->idx)
+		return tb->idx;
+	if (tb->nents < MNT_TABIDX_MINENTS)
+		return NULL;
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return NULL;
+
+	for (idx->nbuckets = MNT_TABIDX_MINENTS;
+	     idx->nbuckets < (size_t) tb->nents; idx->nbuckets <<= 1);
+
+	idx->heads = calloc(idx->nbuckets * MNT_TABIDX_NKEYS, sizeof(size_t));
+	idx->ents = calloc(tb->nents, sizeof(struct libmnt_tabidx_ent));
+	if (!idx->heads || !idx->ents) {
+		free(idx->heads);
+		free(idx->ents);
+		free(idx);
+		return NULL;
+	}
+
+	/* backward, the chains are in the table order then */
+	n = tb->nents;
+	mnt_reset_iter(&itr, MNT_ITER_BACKWARD);
+	while (n > 0 && mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		const char *p;
+
+		idx->ents[--n].fs = fs;
+
+		if ((p = mnt_fs_get_target(fs)))
+			tabidx_add(idx, MNT_TABIDX_TARGET, ul_hash_path(p), n);
+		if ((p = mnt_fs_get_srcpath(fs)))
+			tabidx_add(idx, MNT_TABIDX_SRCPATH, ul_hash_path(p), n);
+		if (mnt_fs_get_tag(fs, NULL, NULL) == 0)
+			idx->ntags++;
+
+		tabidx_add(idx, MNT_TABIDX_DEVNO, hash_num(mnt_fs_get_devno(fs)), n);
+		tabidx_add(idx, MNT_TABIDX_ID, hash_num(mnt_fs_get_id(fs)), n);
+		tabidx_add(idx, MNT_TABIDX_UNIQ_ID, hash_num(mnt_fs_get_uniq_id(fs)), n);
+	}
+
+	DBG(TAB, ul_debugobj(tb, "new lookup index [entries=%d, buckets=%zu]",
+				tb->nents, idx->nbuckets));
+	tb->idx = idx;
+	return idx;
+}
+
+static struct libmnt_fs *tabidx_find(struct libmnt_tabidx *idx, int key,
+			size_t hash, int direction,
+			int (*match)(struct libmnt_fs *, const void *),
+			const void *data)
+{
+	struct libmnt_fs *res = NULL;
+	size_t n = idx->heads[key * idx->nbuckets + (hash & (idx->nbuckets - 1))];
+
+	while (n) {
+		struct libmnt_tabidx_ent *ent = &idx->ents[n - 1];
+
+		if (match(ent->fs, data)) {
+			res = ent->fs;
+			if (direction == MNT_ITER_FORWARD)
+				break;
+		}
+		n = ent->next[key];
+	}
+	return res;
+}
+
+static int match_target(struct libmnt_fs *fs, const void *data)
+{
+	return mnt_fs_streq_target(fs, data);
+}
+
+static int match_devno(struct libmnt_fs *fs, const void *data)
+{
+	return mnt_fs_get_devno(fs) == *((const dev_t *) data);
+}
+
+static int match_id(struct libmnt_fs *fs, const void *data)
+{
+	return mnt_fs_get_id(fs) == *((const int *) data);
+}
+
+static int match_uniq_id(struct libmnt_fs *fs, const void *data)
+{
+	return mnt_fs_get_uniq_id(fs) == *((const uint64_t *) data);
+}
+
+/* native (non-canonicalized) @path lookup */
+static struct libmnt_fs *find_target(struct libmnt_table *tb,
+			const char *path, int direction)
+{
+	struct libmnt_tabidx *idx = tabidx_get(tb);
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs = NULL;
+
+	if (idx)
+		return tabidx_find(idx, MNT_TABIDX_TARGET, ul_hash_path(path),
+				direction, match_target, path);
+
+	mnt_reset_iter(&itr, direction);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		if (mnt_fs_streq_target(fs, path))
+			return fs;
+	}
+	return NULL;
+}
+
 static inline struct libmnt_fs *get_parent_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 {
 	struct libmnt_iter itr;
 	struct libmnt_fs *x;
+	struct libmnt_tabidx *idx = tabidx_get(tb);
 	int parent_id = mnt_fs_get_parent_id(fs);
 
+	if (idx)
+		return tabidx_find(idx, MNT_TABIDX_ID, hash_num(parent_id),
+				MNT_ITER_FORWARD, match_id, &parent_id);
+
 	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
 	while (mnt_table_next_fs(tb, &itr, &x) == 0) {
 		if (mnt_fs_get_id(x) == parent_id)
@@ -895,26 +1085,6 @@ int mnt_table_find_next_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 	return 0;
 }
 
-static int mnt_table_move_parent(struct libmnt_table *tb, int oldid, int newid)
-{
-	struct libmnt_iter itr;
-	struct libmnt_fs *fs;
-
-	if (!tb)
-		return -EINVAL;
-	if (list_empty(&tb->ents))
-		return 0;
-
-	DBG(TAB, ul_debugobj(tb, "moving parent ID from %d -> %d", oldid, newid));
-	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
-
-	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (fs->parent == oldid)
-			fs->parent = newid;
-	}
-	return 0;
-}
-
 /**
  * mnt_table_uniq_fs:
  * @tb: table
@@ -931,16 +1101,87 @@ static int mnt_table_move_parent(struct libmnt_table *tb, int oldid, int newid)
  * @MNT_UNIQ_FORWARD:  remove later mounted filesystems
  * @MNT_UNIQ_KEEPTREE: keep parent->id relationship still valid
  *
+ * Note that every filesystem is compared with all the previous unique
+ * filesystems; see mnt_table_uniq_fs_hashed() for large tables.
+ *
  * Returns: negative number in case of error, or 0 o success.
  */
 int mnt_table_uniq_fs(struct libmnt_table *tb, int flags,
 				int (*cmp)(struct libmnt_table *,
 					   struct libmnt_fs *,
 					   struct libmnt_fs *))
+{
+	return mnt_table_uniq_fs_hashed(tb, flags, NULL, cmp);
+}
+
+struct uniq_moved {
+	int	id;
+	int	parent_id;
+};
+
+static int cmp_uniq_moved(const void *a, const void *b)
+{
+	return cmp_numbers(((const struct uniq_moved *) a)->id,
+			   ((const struct uniq_moved *) b)->id);
+}
+
+/* The children of the removed filesystems inherit the removed parent ID */
+static void uniq_move_parents(struct libmnt_table *tb,
+			struct uniq_moved *moved, size_t nmoved)
 {
 	struct libmnt_iter itr;
 	struct libmnt_fs *fs;
-	int direction = MNT_ITER_BACKWARD;
+
+	DBG(TAB, ul_debugobj(tb, "moving parent IDs of %zu removed filesystems", nmoved));
+	qsort(moved, nmoved, sizeof(*moved), cmp_uniq_moved);
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		struct uniq_moved key = { .id = fs->parent }, *m;
+		size_t loops = 0;
+
+		while (loops++ < nmoved &&
+		       (m = bsearch(&key, moved, nmoved, sizeof(*moved),
+				    cmp_uniq_moved))) {
+			if (m->parent_id == key.id)
+				break;
+			key.id = m->parent_id;
+		}
+		fs->parent = key.id;
+	}
+}
+
+/**
+ * mnt_table_uniq_fs_hashed:
+ * @tb: table
+ * @flags: MNT_UNIQ_*
+ * @hash: function to calculate hash of the filesystem or NULL
+ * @cmp: function to compare filesystems
+ *
+ * The same as mnt_table_uniq_fs(), but the filesystem is compared only with
+ * the previous unique filesystems with the same hash, so the de-duplication
+ * is linear for the usual tables. The @hash function has to return the same
+ * value for all filesystems equal for @cmp; note that mnt_fs_streq_target()
+ * and mnt_fs_streq_srcpath() ignore redundant slashes in the paths. If @hash
+ * is NULL, all filesystems are compared as by mnt_table_uniq_fs().
+ *
+ * Returns: negative number in case of error, or 0 o success.
+ *
+ * Since: 2.41
+ */
+int mnt_table_uniq_fs_hashed(struct libmnt_table *tb, int flags,
+				size_t (*hash)(struct libmnt_table *,
+					       struct libmnt_fs *),
+				int (*cmp)(struct libmnt_table *,
+					   struct libmnt_fs *,
+					   struct libmnt_fs *))
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs, **uniq = NULL;
+	struct uniq_moved *moved = NULL;
+	size_t *heads = NULL, *next = NULL;
+	size_t nbuckets = 1, nents, nuniq = 0, nmoved = 0;
+	int direction = MNT_ITER_BACKWARD, rc = 0;
 
 	if (!tb || !cmp)
 		return -EINVAL;
@@ -950,36 +1191,61 @@ int mnt_table_uniq_fs(struct libmnt_table *tb, int flags,
 	if (flags & MNT_UNIQ_FORWARD)
 		direction = MNT_ITER_FORWARD;
 
-	DBG(TAB, ul_debugobj(tb, "de-duplicate"));
-	mnt_reset_iter(&itr, direction);
+	DBG(TAB, ul_debugobj(tb, "de-duplicate%s", hash ? " (hashed)" : ""));
 
 	if ((flags & MNT_UNIQ_KEEPTREE) && !is_mountinfo(tb))
 		flags &= ~MNT_UNIQ_KEEPTREE;
 
+	nents = tb->nents;
+	if (hash)
+		for (nbuckets = MNT_TABIDX_MINENTS; nbuckets < nents; nbuckets <<= 1);
+
+	heads = calloc(nbuckets, sizeof(size_t));
+	next = calloc(nents, sizeof(size_t));
+	uniq = calloc(nents, sizeof(struct libmnt_fs *));
+	if (flags & MNT_UNIQ_KEEPTREE)
+		moved = calloc(nents, sizeof(struct uniq_moved));
+	if (!heads || !next || !uniq || ((flags & MNT_UNIQ_KEEPTREE) && !moved)) {
+		rc = -ENOMEM;
+		goto done;
+	}
+
+	mnt_reset_iter(&itr, direction);
 	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		int want = 1;
-		struct libmnt_iter xtr;
-		struct libmnt_fs *x;
+		size_t *head = &heads[hash ? hash(tb, fs) & (nbuckets - 1) : 0];
+		size_t n;
 
-		mnt_reset_iter(&xtr, direction);
-		while (want && mnt_table_next_fs(tb, &xtr, &x) == 0) {
-			if (fs == x)
+		/* the chain is a list of the unique filesystems (+1) */
+		for (n = *head; n; n = next[n - 1]) {
+			if (cmp(tb, uniq[n - 1], fs) == 0)
 				break;
-			want = cmp(tb, x, fs) != 0;
+		}
+		if (!n) {
+			uniq[nuniq] = fs;
+			next[nuniq] = *head;
+			*head = ++nuniq;
+			continue;
 		}
 
-		if (!want) {
-			if (flags & MNT_UNIQ_KEEPTREE)
-				mnt_table_move_parent(tb, mnt_fs_get_id(fs),
-							  mnt_fs_get_parent_id(fs));
-
-			DBG(TAB, ul_debugobj(tb, "remove duplicate %s",
-						mnt_fs_get_target(fs)));
-			mnt_table_remove_fs(tb, fs);
+		if (flags & MNT_UNIQ_KEEPTREE) {
+			moved[nmoved].id = mnt_fs_get_id(fs);
+			moved[nmoved].parent_id = mnt_fs_get_parent_id(fs);
+			nmoved++;
 		}
+
+		DBG(TAB, ul_debugobj(tb, "remove duplicate %s",
+					mnt_fs_get_target(fs)));
+		mnt_table_remove_fs(tb, fs);
 	}
 
-	return 0;
+	if (nmoved)
+		uniq_move_parents(tb, moved, nmoved);
+done:
+	free(heads);
+	free(next);
+	free(uniq);
+	free(moved);
+	return rc;
 }
 
 /**
@@ -1085,23 +1351,17 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	DBG(TAB, ul_debugobj(tb, "lookup TARGET: '%s'", path));
 
 	/* native @target */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_target(fs, path))
-			return fs;
-	}
+	fs = find_target(tb, path, direction);
+	if (fs)
+		return fs;
 
 	/* try absolute path */
 	if (is_relative_path(path) && (cn = absolute_path(path))) {
 		DBG(TAB, ul_debugobj(tb, "lookup absolute TARGET: '%s'", cn));
-		mnt_reset_iter(&itr, direction);
-		while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
-			if (mnt_fs_streq_target(fs, cn)) {
-				free(cn);
-				return fs;
-			}
-		}
+		fs = find_target(tb, cn, direction);
 		free(cn);
+		if (fs)
+			return fs;
 	}
 
 	if (!tb->cache || !(cn = mnt_resolve_path(path, tb->cache)))
@@ -1110,11 +1370,9 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	DBG(TAB, ul_debugobj(tb, "lookup canonical TARGET: '%s'", cn));
 
 	/* canonicalized paths in struct libmnt_table */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_target(fs, cn))
-			return fs;
-	}
+	fs = find_target(tb, cn, direction);
+	if (fs)
+		return fs;
 
 	/* non-canonical path in struct libmnt_table
 	 * -- note that mountpoint in /proc/self/mountinfo is already
@@ -1138,6 +1396,40 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	return NULL;
 }
 
+static int match_srcpath(struct libmnt_fs *fs, const void *data)
+{
+	return mnt_fs_streq_srcpath(fs, data);
+}
+
+/* the same as match_srcpath(), but for btrfs accepts the default subvolume only */
+static int match_native_srcpath(struct libmnt_fs *fs, const void *data)
+{
+	if (!mnt_fs_streq_srcpath(fs, data))
+		return 0;
+#ifdef HAVE_BTRFS_SUPPORT
+	if (fs->fstype && !strcmp(fs->fstype, "btrfs")) {
+		uint64_t default_id = btrfs_get_default_subvol_id(mnt_fs_get_target(fs));
+		char *val;
+		size_t len;
+
+		if (default_id == UINT64_MAX)
+			DBG(TAB, ul_debug("not found btrfs volume setting"));
+
+		else if (mnt_fs_get_option(fs, "subvolid", &val, &len) == 0) {
+			uint64_t subvol_id;
+
+			if (mnt_parse_offset(val, len, &subvol_id)) {
+				DBG(TAB, ul_debugobj(fs->tab, "failed to parse subvolid="));
+				return 0;
+			}
+			if (subvol_id != default_id)
+				return 0;
+		}
+	}
+#endif /* HAVE_BTRFS_SUPPORT */
+	return 1;
+}
+
 /**
  * mnt_table_find_srcpath:
  * @tb: tab pointer
@@ -1160,6 +1452,7 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
  */
 struct libmnt_fs *mnt_table_find_srcpath(struct libmnt_table *tb, const char *path, int direction)
 {
+	struct libmnt_tabidx *idx;
 	struct libmnt_iter itr;
 	struct libmnt_fs *fs = NULL;
 	int ntags = 0, nents;
@@ -1174,36 +1467,21 @@ struct libmnt_fs *mnt_table_find_srcpath(struct libmnt_table *tb, const char *pa
 	DBG(TAB, ul_debugobj(tb, "lookup SRCPATH: '%s'", path));
 
 	/* native paths */
-	mnt_reset_iter(&itr, direction);
-
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-
-		if (mnt_fs_streq_srcpath(fs, path)) {
-#ifdef HAVE_BTRFS_SUPPORT
-			if (fs->fstype && !strcmp(fs->fstype, "btrfs")) {
-				uint64_t default_id = btrfs_get_default_subvol_id(mnt_fs_get_target(fs));
-				char *val;
-				size_t len;
-
-				if (default_id == UINT64_MAX)
-					DBG(TAB, ul_debug("not found btrfs volume setting"));
-
-				else if (mnt_fs_get_option(fs, "subvolid", &val, &len) == 0) {
-					uint64_t subvol_id;
-
-					if (mnt_parse_offset(val, len, &subvol_id)) {
-						DBG(TAB, ul_debugobj(tb, "failed to parse subvolid="));
-						continue;
-					}
-					if (subvol_id != default_id)
-						continue;
-				}
-			}
-#endif /* HAVE_BTRFS_SUPPORT */
+	idx = tabidx_get(tb);
+	if (idx) {
+		fs = tabidx_find(idx, MNT_TABIDX_SRCPATH, ul_hash_path(path),
+				direction, match_native_srcpath, path);
+		if (fs)
 			return fs;
+		ntags = idx->ntags;
+	} else {
+		mnt_reset_iter(&itr, direction);
+		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+			if (match_native_srcpath(fs, path))
+				return fs;
+			if (mnt_fs_get_tag(fs, NULL, NULL) == 0)
+				ntags++;
 		}
-		if (mnt_fs_get_tag(fs, NULL, NULL) == 0)
-			ntags++;
 	}
 
 	if (!path || !tb->cache || !(cn = mnt_resolve_path(path, tb->cache)))
@@ -1214,7 +1492,12 @@ struct libmnt_fs *mnt_table_find_srcpath(struct libmnt_table *tb, const char *pa
 	nents = mnt_table_get_nents(tb);
 
 	/* canonicalized paths in struct libmnt_table */
-	if (ntags < nents) {
+	if (ntags < nents && idx) {
+		fs = tabidx_find(idx, MNT_TABIDX_SRCPATH, ul_hash_path(cn),
+				direction, match_srcpath, cn);
+		if (fs)
+			return fs;
+	} else if (ntags < nents) {
 		mnt_reset_iter(&itr, direction);
 		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
 			if (mnt_fs_streq_srcpath(fs, cn))
@@ -1452,6 +1735,7 @@ struct libmnt_fs *mnt_table_find_pair(struct libmnt_table *tb, const char *sourc
 struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 				       dev_t devno, int direction)
 {
+	struct libmnt_tabidx *idx;
 	struct libmnt_fs *fs = NULL;
 	struct libmnt_iter itr;
 
@@ -1462,6 +1746,11 @@ struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 
 	DBG(TAB, ul_debugobj(tb, "lookup DEVNO: %d", (int) devno));
 
+	idx = tabidx_get(tb);
+	if (idx)
+		return tabidx_find(idx, MNT_TABIDX_DEVNO, hash_num(devno),
+				direction, match_devno, &devno);
+
 	mnt_reset_iter(&itr, direction);
 
 	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
@@ -1472,6 +1761,41 @@ struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 	return NULL;
 }
 
+/**
+ * mnt_table_find_uniq_id:
+ * @tb: table read by listmount()
+ * @id: unique mount ID
+ *
+ * See mnt_fs_get_uniq_id() and mnt_table_fetch_listmount().
+ *
+ * Returns: a tab entry or NULL.
+ *
+ * Since: 2.41
+ */
+struct libmnt_fs *mnt_table_find_uniq_id(struct libmnt_table *tb, uint64_t id)
+{
+	struct libmnt_tabidx *idx;
+	struct libmnt_fs *fs = NULL;
+	struct libmnt_iter itr;
+
+	if (!tb || !id)
+		return NULL;
+
+	DBG(TAB, ul_debugobj(tb, "lookup UNIQ-ID: %" PRIu64, id));
+
+	idx = tabidx_get(tb);
+	if (idx)
+		return tabidx_find(idx, MNT_TABIDX_UNIQ_ID, hash_num(id),
+				MNT_ITER_FORWARD, match_uniq_id, &id);
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		if (mnt_fs_get_uniq_id(fs) == id)
+			return fs;
+	}
+	return NULL;
+}
+
 static char *remove_mountpoint_from_path(const char *path, const char *mnt)
 {
         char *res;
@@ -2249,6 +2573,12 @@ static int test_uniq_cmp(struct libmnt_table *tb __attribute__((__unused__)),
 	return mnt_fs_streq_target(a, mnt_fs_get_target(b)) ? 0 : 1;
 }
 
+static size_t test_uniq_hash(struct libmnt_table *tb __attribute__((__unused__)),
+			 struct libmnt_fs *fs)
+{
+	return ul_hash_path(mnt_fs_get_target(fs));
+}
+
 static int test_uniq(struct libmnt_test *ts __attribute__((unused)),
 		     int argc, char *argv[])
 {
@@ -2264,7 +2594,15 @@ static int test_uniq(struct libmnt_test *ts __attribute__((unused)),
 	if (!tb)
 		goto done;
 
-	if (mnt_table_uniq_fs(tb, 0, test_uniq_cmp) == 0) {
+	if (strcmp(argv[0], "--uniq-target-hashed") == 0)
+		rc = mnt_table_uniq_fs_hashed(tb, MNT_UNIQ_KEEPTREE,
+					      test_uniq_hash, test_uniq_cmp);
+	else if (strcmp(argv[0], "--uniq-target-keeptree") == 0)
+		rc = mnt_table_uniq_fs(tb, MNT_UNIQ_KEEPTREE, test_uniq_cmp);
+	else
+		rc = mnt_table_uniq_fs(tb, 0, test_uniq_cmp);
+
+	if (rc == 0) {
 		struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_FORWARD);
 		struct libmnt_fs *fs;
 		if (!itr)
@@ -2287,6 +2625,8 @@ int main(int argc, char *argv[])
 	{ "--find-forward",  test_find_fw, "<file> <source|target> <string>" },
 	{ "--find-backward", test_find_bw, "<file> <source|target> <string>" },
 	{ "--uniq-target",   test_uniq,    "<file>" },
+	{ "--uniq-target-keeptree", test_uniq, "<file>" },
+	{ "--uniq-target-hashed", test_uniq, "<file>" },
 	{ "--find-pair",     test_find_pair, "<file> <source> <target>" },
 	{ "--find-fs",       test_find_idx, "<file> <target>" },
 	{ "--find-mountpoint", test_find_mountpoint, "<path>" },
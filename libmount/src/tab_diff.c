@@ -125,9 +125,22 @@ int mnt_tabdiff_next_change(struct libmnt_tabdiff *df, struct libmnt_iter *itr,
 	return rc;
 }
 
-static int tabdiff_reset(struct libmnt_tabdiff *df)
+/**
+ * mnt_reset_tabdiff:
+ * @df: tab diff
+ *
+ * Removes all changes from @df. This is usually unnecessary for
+ * mnt_diff_tables(), but the changes added by mnt_table_update_mount() are
+ * accumulated until the reset.
+ *
+ * Returns: 0 on success or negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_reset_tabdiff(struct libmnt_tabdiff *df)
 {
-	assert(df);
+	if (!df)
+		return -EINVAL;
 
 	DBG(DIFF, ul_debugobj(df, "resetting"));
 
@@ -151,7 +164,7 @@ static int tabdiff_reset(struct libmnt_tabdiff *df)
 	return 0;
 }
 
-static int tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
+int mnt_tabdiff_add_change(struct libmnt_tabdiff *df, struct libmnt_fs *old,
 			     struct libmnt_fs *new, int oper)
 {
 	struct tabdiff_entry *de;
@@ -235,7 +248,7 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 	if (!df || !old_tab || !new_tab)
 		return -EINVAL;
 
-	tabdiff_reset(df);
+	mnt_reset_tabdiff(df);
 
 	no = mnt_table_get_nents(old_tab);
 	nn = mnt_table_get_nents(new_tab);
@@ -252,12 +265,12 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 	/* all mounted or umounted */
 	if (!no && nn) {
 		while(mnt_table_next_fs(new_tab, &itr, &fs) == 0)
-			tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
+			mnt_tabdiff_add_change(df, NULL, fs, MNT_TABDIFF_MOUNT);
 		goto done;
 
 	} else if (no && !nn) {
 		while(mnt_table_next_fs(old_tab, &itr, &fs) == 0)
-			tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
+			mnt_tabdiff_add_change(df, fs, NULL, MNT_TABDIFF_UMOUNT);
 		goto done;
 	}
 
@@ -270,7 +283,7 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 		o_fs = mnt_table_find_pair(old_tab, src, tgt, MNT_ITER_FORWARD);
 		if (!o_fs)
 			/* 'fs' is not in the old table -- so newly mounted */
-			tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
+			mnt_tabdiff_add_change(df, NULL, fs, MNT_TABDIFF_MOUNT);
 		else {
 			/* is modified? */
 			const char *v1 = mnt_fs_get_vfs_options(o_fs),
@@ -279,7 +292,7 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 				   *f2 = mnt_fs_get_fs_options(fs);
 
 			if ((v1 && v2 && strcmp(v1, v2) != 0) || (f1 && f2 && strcmp(f1, f2) != 0))
-				tabdiff_add_entry(df, o_fs, fs, MNT_TABDIFF_REMOUNT);
+				mnt_tabdiff_add_change(df, o_fs, fs, MNT_TABDIFF_REMOUNT);
 		}
 	}
 
@@ -299,7 +312,7 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 				de->oper = MNT_TABDIFF_MOVE;
 				de->old_fs = fs;
 			} else
-				tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
+				mnt_tabdiff_add_change(df, fs, NULL, MNT_TABDIFF_UMOUNT);
 		}
 	}
 done:
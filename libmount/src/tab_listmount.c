@@ -0,0 +1,841 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * This file is part of libmount from util-linux project.
+ *
+ * libmount is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * The kernel mount table is read by listmount() and statmount() syscalls
+ * (Linux 6.8) rather than by /proc/self/mountinfo parsing. The syscalls
+ * return binary data, it's possible to ask for a subtree only and only the
+ * required information.
+ */
+#include <sys/mount.h>
+
+#include "mountP.h"
+#include "mount-api-utils.h"
+#include "fileutils.h"
+#include "strutils.h"
+
+#if defined(SYS_statmount) && defined(SYS_listmount)
+# define USE_LISTMOUNT 1
+#endif
+
+/* by default ask for everything necessary for mountinfo-like entries */
+#define LISTMOUNT_DEFAULT_MASK	(STATMOUNT_SB_BASIC | STATMOUNT_MNT_BASIC | \
+				 STATMOUNT_PROPAGATE_FROM | STATMOUNT_MNT_ROOT | \
+				 STATMOUNT_MNT_POINT | STATMOUNT_FS_TYPE | \
+				 STATMOUNT_MNT_OPTS | STATMOUNT_FS_SUBTYPE | \
+				 STATMOUNT_SB_SOURCE)
+
+/* number of IDs read by one listmount() call */
+#define LISTMOUNT_STEP		512
+
+/* statmount() buffer limits */
+#define STATMOUNT_BUFSIZ	4096
+#define STATMOUNT_BUFSIZ_MAX	(1024 * 1024)
+
+/**
+ * mnt_table_enable_listmount:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enable or disable listmount() and statmount() syscalls based kernel mount
+ * table. If enabled, then mnt_table_parse_mtab() (with the default filename)
+ * reads the table by mnt_table_fetch_listmount() and /proc/self/mountinfo is
+ * used only as a fallback on kernels without the syscalls.
+ *
+ * Returns: 0 on success, negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_table_enable_listmount(struct libmnt_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+	tb->listmount = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * mnt_table_listmount_set_mask:
+ * @tb: table
+ * @mask: STATMOUNT_* flags or 0
+ *
+ * Specifies information to read for every filesystem. The STATMOUNT_* flags
+ * are defined in linux/mount.h. The default (or if @mask is zero) is to read
+ * all the information usually available in /proc/self/mountinfo.
+ *
+ * Note that STATMOUNT_MNT_BASIC is always read, the mount IDs are necessary
+ * to keep the table consistent.
+ *
+ * Returns: 0 on success, negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_table_listmount_set_mask(struct libmnt_table *tb, uint64_t mask)
+{
+	if (!tb)
+		return -EINVAL;
+	tb->lsmnt_mask = mask;
+	return 0;
+}
+
+/**
+ * mnt_table_listmount_set_root:
+ * @tb: table
+ * @path: mountpoint or NULL
+ *
+ * Read only the mount specified by @path and all mounts below it. The default
+ * (or if @path is NULL) is to read all mounts visible for the process.
+ *
+ * Returns: 0 on success, negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_table_listmount_set_root(struct libmnt_table *tb, const char *path)
+{
+	if (!tb)
+		return -EINVAL;
+	return strdup_to_struct_member(tb, lsmnt_root, path);
+}
+
+#ifdef USE_LISTMOUNT
+
+#ifndef SB_RDONLY
+# define SB_RDONLY	(1 << 0)
+#endif
+#ifndef SB_SYNCHRONOUS
+# define SB_SYNCHRONOUS	(1 << 4)
+#endif
+#ifndef SB_MANDLOCK
+# define SB_MANDLOCK	(1 << 6)
+#endif
+#ifndef SB_DIRSYNC
+# define SB_DIRSYNC	(1 << 7)
+#endif
+#ifndef SB_LAZYTIME
+# define SB_LAZYTIME	(1 << 25)
+#endif
+
+struct libmnt_lsmnt {
+	uint64_t		mask;		/* statmount() mask */
+	struct ul_statmount	*buf;		/* statmount() buffer */
+	size_t			bufsiz;
+
+	pid_t			tid;
+	char			*sysroot;	/* /dev/root conversion */
+	int			sysroot_rc;
+
+	unsigned int		need_source :1;	/* check kernel for SB_SOURCE */
+};
+
+/* the same as mountinfo VFS option, see show_mnt_opts() in kernel */
+static int attr_to_vfs_optstr(struct libmnt_fs *fs, uint64_t attr)
+{
+	int rc;
+
+	rc = mnt_optstr_append_option(&fs->vfs_optstr,
+				attr & MOUNT_ATTR_RDONLY ? "ro" : "rw", NULL);
+	if (!rc && (attr & MOUNT_ATTR_NOSUID))
+		rc = mnt_optstr_append_option(&fs->vfs_optstr, "nosuid", NULL);
+	if (!rc && (attr & MOUNT_ATTR_NODEV))
+		rc = mnt_optstr_append_option(&fs->vfs_optstr, "nodev", NULL);
+	if (!rc && (attr & MOUNT_ATTR_NOEXEC))
+		rc = mnt_optstr_append_option(&fs->vfs_optstr, "noexec", NULL);
+
+	if (!rc) {
+		switch (attr & MOUNT_ATTR__ATIME) {
+		case MOUNT_ATTR_NOATIME:
+			rc = mnt_optstr_append_option(&fs->vfs_optstr, "noatime", NULL);
+			break;
+		case MOUNT_ATTR_RELATIME:
+			rc = mnt_optstr_append_option(&fs->vfs_optstr, "relatime", NULL);
+			break;
+		default:
+			break;
+		}
+	}
+	if (!rc && (attr & MOUNT_ATTR_NODIRATIME))
+		rc = mnt_optstr_append_option(&fs->vfs_optstr, "nodiratime", NULL);
+	if (!rc && (attr & MOUNT_ATTR_NOSYMFOLLOW))
+		rc = mnt_optstr_append_option(&fs->vfs_optstr, "nosymfollow", NULL);
+	if (!rc && (attr & MOUNT_ATTR_IDMAP))
+		rc = mnt_optstr_append_option(&fs->vfs_optstr, "idmapped", NULL);
+	return rc;
+}
+
+/* the same as mountinfo optional fields, see show_mountinfo() in kernel */
+static int propagation_to_fields(struct libmnt_fs *fs, struct ul_statmount *sm)
+{
+	char buf[64];
+	int rc = 0;
+
+	if (sm->mnt_propagation & MS_SHARED) {
+		snprintf(buf, sizeof(buf), "shared:%" PRIu64, sm->mnt_peer_group);
+		rc = strappend(&fs->opt_fields, buf);
+	}
+	if (!rc && (sm->mnt_propagation & MS_SLAVE)) {
+		snprintf(buf, sizeof(buf), "%smaster:%" PRIu64,
+				fs->opt_fields ? " " : "", sm->mnt_master);
+		rc = strappend(&fs->opt_fields, buf);
+
+		if (!rc && (sm->mask & STATMOUNT_PROPAGATE_FROM)
+		    && sm->propagate_from
+		    && sm->propagate_from != sm->mnt_master) {
+			snprintf(buf, sizeof(buf), " propagate_from:%" PRIu64,
+					sm->propagate_from);
+			rc = strappend(&fs->opt_fields, buf);
+		}
+	}
+	if (!rc && (sm->mnt_propagation & MS_UNBINDABLE))
+		rc = strappend(&fs->opt_fields, fs->opt_fields ? " unbindable" : "unbindable");
+	return rc;
+}
+
+/* the same as mountinfo FS options, see show_sb_opts() in kernel */
+static int sb_to_fs_optstr(struct libmnt_fs *fs, struct ul_statmount *sm)
+{
+	int rc;
+
+	rc = mnt_optstr_append_option(&fs->fs_optstr,
+				sm->sb_flags & SB_RDONLY ? "ro" : "rw", NULL);
+	if (!rc && (sm->sb_flags & SB_SYNCHRONOUS))
+		rc = mnt_optstr_append_option(&fs->fs_optstr, "sync", NULL);
+	if (!rc && (sm->sb_flags & SB_DIRSYNC))
+		rc = mnt_optstr_append_option(&fs->fs_optstr, "dirsync", NULL);
+	if (!rc && (sm->sb_flags & SB_MANDLOCK))
+		rc = mnt_optstr_append_option(&fs->fs_optstr, "mand", NULL);
+	if (!rc && (sm->sb_flags & SB_LAZYTIME))
+		rc = mnt_optstr_append_option(&fs->fs_optstr, "lazytime", NULL);
+	return rc;
+}
+
+static int apply_statmount(struct libmnt_table *tb, struct libmnt_lsmnt *ls,
+			   struct libmnt_fs *fs)
+{
+	struct ul_statmount *sm = ls->buf;
+	int rc = 0;
+
+	fs->flags |= MNT_FS_KERNEL;
+	fs->tid = ls->tid;
+
+	if (sm->mask & STATMOUNT_MNT_BASIC) {
+		fs->uniq_id = sm->mnt_id;
+		fs->id = sm->mnt_id_old;
+		fs->parent = sm->mnt_parent_id_old;
+
+		rc = attr_to_vfs_optstr(fs, sm->mnt_attr);
+		if (!rc)
+			rc = propagation_to_fields(fs, sm);
+	}
+	if (!rc && (sm->mask & STATMOUNT_SB_BASIC)) {
+		fs->devno = makedev(sm->sb_dev_major, sm->sb_dev_minor);
+		rc = sb_to_fs_optstr(fs, sm);
+	}
+	if (!rc && (sm->mask & STATMOUNT_MNT_OPTS) && *(sm->str + sm->mnt_opts))
+		rc = mnt_optstr_append_option(&fs->fs_optstr, sm->str + sm->mnt_opts, NULL);
+
+	if (!rc && (sm->mask & STATMOUNT_MNT_ROOT))
+		rc = mnt_fs_set_root(fs, sm->str + sm->mnt_root);
+	if (!rc && (sm->mask & STATMOUNT_MNT_POINT))
+		rc = mnt_fs_set_target(fs, sm->str + sm->mnt_point);
+
+	if (!rc && (sm->mask & STATMOUNT_FS_TYPE)) {
+		if ((sm->mask & STATMOUNT_FS_SUBTYPE) && *(sm->str + sm->fs_subtype)) {
+			char *type = NULL;
+
+			if (asprintf(&type, "%s.%s", sm->str + sm->fs_type,
+						sm->str + sm->fs_subtype) < 0)
+				rc = -ENOMEM;
+			else
+				rc = __mnt_fs_set_fstype_ptr(fs, type);
+		} else
+			rc = mnt_fs_set_fstype(fs, sm->str + sm->fs_type);
+	}
+
+	if (!rc && (sm->mask & STATMOUNT_SB_SOURCE)) {
+		const char *src = sm->str + sm->sb_source;
+
+		/* convert obscure /dev/root to something more usable */
+		if (strcmp(src, "/dev/root") == 0) {
+			if (ls->sysroot_rc == 0 && ls->sysroot == NULL)
+				ls->sysroot_rc = mnt_guess_system_root(fs->devno,
+							tb->cache, &ls->sysroot);
+			if (ls->sysroot_rc < 0)
+				return ls->sysroot_rc;
+			if (ls->sysroot)
+				src = ls->sysroot;
+		}
+		rc = mnt_fs_set_source(fs, src);
+	}
+
+	if (!rc && (fs->vfs_optstr || fs->fs_optstr)) {
+		fs->optstr = mnt_fs_strdup_options(fs);
+		if (!fs->optstr)
+			rc = -ENOMEM;
+	}
+	return rc;
+}
+
+/* returns 1 if the mount is not available anymore */
+static int call_statmount(struct libmnt_lsmnt *ls, uint64_t id)
+{
+	do {
+		if (!ls->buf) {
+			ls->buf = malloc(ls->bufsiz);
+			if (!ls->buf)
+				return -ENOMEM;
+		}
+		if (ul_statmount(id, ls->mask, ls->buf, ls->bufsiz, 0) == 0) {
+			if (ls->need_source) {
+				/* old kernel, source is available in mountinfo only */
+				if (!(ls->buf->mask & STATMOUNT_SB_SOURCE))
+					return -ENOSYS;
+				ls->need_source = 0;
+			}
+			return 0;
+		}
+		if (errno == ENOENT)
+			return 1;
+		if (errno != EOVERFLOW || ls->bufsiz >= STATMOUNT_BUFSIZ_MAX)
+			return -errno;
+
+		/* strings too large */
+		free(ls->buf);
+		ls->buf = NULL;
+		ls->bufsiz *= 2;
+		DBG(TAB, ul_debug("statmount: enlarge buffer to %zu", ls->bufsiz));
+	} while (1);
+}
+
+static void init_lsmnt(struct libmnt_table *tb, struct libmnt_lsmnt *ls)
+{
+	memset(ls, 0, sizeof(*ls));
+
+	ls->bufsiz = STATMOUNT_BUFSIZ;
+	ls->mask = tb->lsmnt_mask ? tb->lsmnt_mask : LISTMOUNT_DEFAULT_MASK;
+	ls->mask |= STATMOUNT_MNT_BASIC;
+	ls->need_source = ls->mask & STATMOUNT_SB_SOURCE ? 1 : 0;
+	ls->tid = getpid();
+}
+
+static void deinit_lsmnt(struct libmnt_lsmnt *ls)
+{
+	free(ls->buf);
+	free(ls->sysroot);
+}
+
+/* returns 1 if the mount is not available anymore or it has been ignored */
+static int new_statmount_fs(struct libmnt_table *tb, struct libmnt_lsmnt *ls,
+			    uint64_t id, struct libmnt_fs **res)
+{
+	struct libmnt_fs *fs;
+	int rc;
+
+	*res = NULL;
+
+	rc = call_statmount(ls, id);
+	if (rc)
+		return rc;
+
+	fs = mnt_new_fs();
+	if (!fs)
+		return -ENOMEM;
+
+	rc = apply_statmount(tb, ls, fs);
+
+	if (rc == 0 && tb->fltrcb && tb->fltrcb(fs, tb->fltrcb_data))
+		rc = 1;	/* filtered out by callback... */
+
+	if (rc == 0 && mnt_table_is_noautofs(tb)) {
+		const char *fstype = mnt_fs_get_fstype(fs);
+
+		if (fstype && strcmp(fstype, "autofs") == 0 &&
+		    mnt_fs_get_option(fs, "ignore", NULL, NULL) == 0)
+			rc = 1; /* Skip "ignore" autofs entry */
+	}
+
+	if (rc == 0)
+		*res = fs;
+	else
+		mnt_unref_fs(fs);
+	return rc;
+}
+
+/* returns 1 if the entry has been ignored */
+static int add_statmount_fs(struct libmnt_table *tb, struct libmnt_lsmnt *ls,
+			    uint64_t id)
+{
+	struct libmnt_fs *fs;
+	int rc;
+
+	rc = new_statmount_fs(tb, ls, id, &fs);
+	if (rc == 0) {
+		rc = mnt_table_add_fs(tb, fs);
+		mnt_unref_fs(fs);
+	}
+	return rc;
+}
+
+static uint64_t get_root_id(const char *path)
+{
+#if defined(HAVE_STATX) && defined(HAVE_STRUCT_STATX) && defined(HAVE_STRUCT_STATX_STX_MNT_ID)
+	struct statx st;
+
+	if (statx(AT_FDCWD, path, AT_STATX_DONT_SYNC | AT_NO_AUTOMOUNT,
+			STATX_MNT_ID_UNIQUE, &st) == 0
+	    && (st.stx_mask & STATX_MNT_ID_UNIQUE))
+		return st.stx_mnt_id;
+#endif
+	(void) path;
+	return 0;
+}
+
+/* without the unique ID of the subtree root, read all and filter by path */
+static int filter_by_root(struct libmnt_fs *fs, void *data)
+{
+	const char *root = data;
+	const char *tgt = mnt_fs_get_target(fs);
+	size_t sz = strlen(root);
+
+	if (!tgt || strncmp(tgt, root, sz) != 0)
+		return 1;
+	if (tgt[sz] == '\0' || tgt[sz] == '/' || (sz == 1 && *root == '/'))
+		return 0;
+	return 1;
+}
+
+/**
+ * mnt_table_fetch_listmount:
+ * @tb: table
+ *
+ * Reads the kernel mount table by listmount() and statmount() syscalls and
+ * appends the filesystems to the @tb. See also mnt_table_listmount_set_mask()
+ * and mnt_table_listmount_set_root().
+ *
+ * This function does not read /run/mount/utab, use mnt_table_parse_mtab()
+ * with enabled listmount if you need the userspace mount options.
+ *
+ * Returns: 0 on success, -ENOSYS if the syscalls are unsupported (or the
+ *          kernel does not provide the filesystem source and the default mask is
+ *          used), or negative number in case of another error.
+ *
+ * Since: 2.41
+ */
+int mnt_table_fetch_listmount(struct libmnt_table *tb)
+{
+	struct libmnt_lsmnt ls;
+	uint64_t ids[LISTMOUNT_STEP], last = 0, root_id = LSMT_ROOT;
+	int (*fltrcb)(struct libmnt_fs *fs, void *data) = NULL;
+	void *fltrcb_data = NULL;
+	char *root = NULL;
+	ssize_t n;
+	size_t i;
+	int rc = 0, first = 1;
+
+	if (!tb)
+		return -EINVAL;
+
+	init_lsmnt(tb, &ls);
+
+	DBG(TAB, ul_debugobj(tb, "listmount: fetch [mask=0x%" PRIx64 ", root=%s]",
+				ls.mask, tb->lsmnt_root));
+
+	if (tb->lsmnt_root) {
+		root = mnt_resolve_path(tb->lsmnt_root, tb->cache);
+		if (!root)
+			return -errno ? -errno : -EINVAL;
+		root_id = get_root_id(root);
+		if (root_id) {
+			/* listmount() does not return the subtree root itself */
+			rc = add_statmount_fs(tb, &ls, root_id);
+			if (rc < 0)
+				goto done;
+		} else {
+			DBG(TAB, ul_debugobj(tb, "listmount: no unique ID, filter by path"));
+			root_id = LSMT_ROOT;
+			fltrcb = tb->fltrcb;
+			fltrcb_data = tb->fltrcb_data;
+			tb->fltrcb = filter_by_root;
+			tb->fltrcb_data = root;
+		}
+	}
+
+	do {
+		n = ul_listmount(root_id, last, ids, ARRAY_SIZE(ids), 0);
+		if (n < 0) {
+			rc = -errno;
+			DBG(TAB, ul_debugobj(tb, "listmount: failed [rc=%d]", rc));
+			if (first && (rc == -ENOSYS || rc == -EINVAL || rc == -EPERM))
+				rc = -ENOSYS;	/* unsupported, try mountinfo */
+			goto done;
+		}
+		first = 0;
+		for (i = 0; i < (size_t) n; i++) {
+			rc = add_statmount_fs(tb, &ls, ids[i]);
+			if (rc < 0)
+				goto done;
+		}
+		if (n)
+			last = ids[n - 1];
+	} while (n == ARRAY_SIZE(ids));
+
+	rc = 0;
+done:
+	if (fltrcb || tb->fltrcb == filter_by_root) {
+		tb->fltrcb = fltrcb;
+		tb->fltrcb_data = fltrcb_data;
+	}
+	DBG(TAB, ul_debugobj(tb, "listmount: done [rc=%d, entries=%d]",
+				rc, mnt_table_get_nents(tb)));
+	deinit_lsmnt(&ls);
+	if (!tb->cache)
+		free(root);
+	return rc;
+}
+
+static int streq_nullable(const char *a, const char *b)
+{
+	return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+/* returns MNT_TABDIFF_* for the difference between @old and @new or 0 */
+static int get_change(struct libmnt_fs *old, struct libmnt_fs *new)
+{
+	if (!mnt_fs_streq_target(old, mnt_fs_get_target(new))
+	    || mnt_fs_get_parent_id(old) != mnt_fs_get_parent_id(new))
+		return MNT_TABDIFF_MOVE;
+	if (!streq_nullable(mnt_fs_get_vfs_options(old), mnt_fs_get_vfs_options(new))
+	    || !streq_nullable(mnt_fs_get_fs_options(old), mnt_fs_get_fs_options(new))
+	    || !streq_nullable(mnt_fs_get_source(old), mnt_fs_get_source(new)))
+		return MNT_TABDIFF_REMOUNT;
+	if (!streq_nullable(mnt_fs_get_optional_fields(old), mnt_fs_get_optional_fields(new)))
+		return MNT_TABDIFF_PROPAGATION;
+	return 0;
+}
+
+/* the table is sorted by unique IDs, new mounts are usually at the end */
+static int insert_by_uniq_id(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *x;
+
+	mnt_reset_iter(&itr, MNT_ITER_BACKWARD);
+	while (mnt_table_next_fs(tb, &itr, &x) == 0) {
+		if (mnt_fs_get_uniq_id(x) < mnt_fs_get_uniq_id(fs))
+			return mnt_table_insert_fs(tb, 0, x, fs);
+	}
+	return mnt_table_insert_fs(tb, 1, NULL, fs);
+}
+
+/**
+ * mnt_table_fetch_listmount_target:
+ * @tb: table
+ * @path: file or directory
+ *
+ * Reads only the mount where the @path resides and appends it to the @tb
+ * (together with the mounts over-mounted by it on the same mountpoint). The
+ * mount is found by statx() and read by statmount(), so the rest of the
+ * kernel mount table is not read at all. It's a cheap alternative to
+ * mnt_table_fetch_listmount() if mnt_table_find_target() or
+ * mnt_table_find_mountpoint() for one path is all what is necessary.
+ *
+ * Returns: 0 on success, -ENOSYS if the syscalls or the unique mount IDs are
+ *          unsupported, or negative number in case of another error.
+ *
+ * Since: 2.41
+ */
+int mnt_table_fetch_listmount_target(struct libmnt_table *tb, const char *path)
+{
+	struct libmnt_lsmnt ls;
+	struct libmnt_fs *fs;
+	char *target = NULL;
+	uint64_t id;
+	int rc;
+
+	if (!tb || !path)
+		return -EINVAL;
+
+	id = get_root_id(path);
+	if (!id)
+		return -ENOSYS;
+
+	DBG(TAB, ul_debugobj(tb, "listmount: fetch target %s [id=%" PRIu64 "]", path, id));
+	init_lsmnt(tb, &ls);
+
+	do {
+		uint64_t parent;
+
+		rc = new_statmount_fs(tb, &ls, id, &fs);
+		if (rc)
+			break;
+		parent = ls.buf->mnt_parent_id;
+
+		/* the parent is the over-mounted one only on the same mountpoint */
+		if (!target) {
+			target = strdup(mnt_fs_get_target(fs) ? : "");
+			if (!target)
+				rc = -ENOMEM;
+		} else if (!streq_nullable(target, mnt_fs_get_target(fs)))
+			rc = 1;
+
+		if (!rc)
+			rc = insert_by_uniq_id(tb, fs);
+		mnt_unref_fs(fs);
+		id = parent != id ? parent : 0;
+	} while (rc == 0 && id);
+
+	if (rc == 1)
+		rc = 0;		/* removed or filtered out */
+
+	DBG(TAB, ul_debugobj(tb, "listmount: done [rc=%d, entries=%d]",
+				rc, mnt_table_get_nents(tb)));
+	free(target);
+	deinit_lsmnt(&ls);
+	return rc;
+}
+
+/**
+ * mnt_table_update_mount:
+ * @tb: table read by mnt_table_fetch_listmount()
+ * @id: unique mount ID
+ * @df: NULL or tab diff to add the change
+ *
+ * Reads the current status of the mount @id by statmount() and updates @tb in
+ * place -- the entry is added, removed or replaced. The function is designed
+ * to keep the table up to date without re-reading the whole kernel mount table,
+ * for example with the mount IDs from mnt_monitor_next_mount().
+ *
+ * If @df is not NULL, then the change is added to @df and it's accessible by
+ * mnt_tabdiff_next_change(). The changes are accumulated, use
+ * mnt_reset_tabdiff() to remove the old changes. The replaced or removed
+ * entry is available as old filesystem in @df.
+ *
+ * The table subtree (see mnt_table_listmount_set_root()) is compared by paths.
+ * The userspace mount options from utab are not updated.
+ *
+ * Returns: MNT_TABDIFF_* change, 0 if the table has not been modified, or
+ *          negative number in case of error.
+ *
+ * Since: 2.41
+ */
+int mnt_table_update_mount(struct libmnt_table *tb, uint64_t id,
+			   struct libmnt_tabdiff *df)
+{
+	struct libmnt_lsmnt ls;
+	struct libmnt_fs *old, *fs = NULL;
+	int rc, oper = 0;
+
+	if (!tb || !id)
+		return -EINVAL;
+
+	init_lsmnt(tb, &ls);
+	old = mnt_table_find_uniq_id(tb, id);
+
+	rc = new_statmount_fs(tb, &ls, id, &fs);
+	if (rc < 0)
+		goto done;
+
+	if (rc == 0 && tb->lsmnt_root) {
+		char *root = mnt_resolve_path(tb->lsmnt_root, tb->cache);
+
+		if (!root || filter_by_root(fs, root)) {
+			mnt_unref_fs(fs);
+			fs = NULL;
+		}
+		if (!tb->cache)
+			free(root);
+	}
+
+	if (!fs && old)
+		oper = MNT_TABDIFF_UMOUNT;
+	else if (fs && !old)
+		oper = MNT_TABDIFF_MOUNT;
+	else if (fs && old)
+		oper = get_change(old, fs);
+
+	DBG(TAB, ul_debugobj(tb, "listmount: update %" PRIu64 " [change=%d]", id, oper));
+
+	rc = 0;
+	switch (oper) {
+	case 0:
+		goto done;
+	case MNT_TABDIFF_MOUNT:
+		rc = insert_by_uniq_id(tb, fs);
+		break;
+	default:
+		mnt_ref_fs(old);
+		if (fs)
+			rc = mnt_table_insert_fs(tb, 0, old, fs);
+		if (!rc)
+			rc = mnt_table_remove_fs(tb, old);
+		break;
+	}
+
+	if (!rc && df)
+		rc = mnt_tabdiff_add_change(df, old, fs, oper);
+	if (oper != MNT_TABDIFF_MOUNT)
+		mnt_unref_fs(old);
+	if (!rc)
+		rc = oper;
+done:
+	mnt_unref_fs(fs);
+	deinit_lsmnt(&ls);
+	return rc;
+}
+
+#else /* !USE_LISTMOUNT */
+int mnt_table_fetch_listmount(struct libmnt_table *tb)
+{
+	return tb ? -ENOSYS : -EINVAL;
+}
+
+int mnt_table_fetch_listmount_target(struct libmnt_table *tb, const char *path)
+{
+	return tb && path ? -ENOSYS : -EINVAL;
+}
+
+int mnt_table_update_mount(struct libmnt_table *tb,
+			   uint64_t id __attribute__((__unused__)),
+			   struct libmnt_tabdiff *df __attribute__((__unused__)))
+{
+	return tb ? -ENOSYS : -EINVAL;
+}
+#endif /* USE_LISTMOUNT */
+
+#ifdef TEST_PROGRAM
+static int test_listmount(struct libmnt_test *ts __attribute__((unused)),
+			  int argc, char *argv[])
+{
+	struct libmnt_table *tb;
+	struct libmnt_iter *itr;
+	struct libmnt_fs *fs;
+	int rc;
+
+	tb = mnt_new_table();
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+	if (!tb || !itr)
+		return -ENOMEM;
+
+	if (argc > 1)
+		mnt_table_listmount_set_root(tb, argv[1]);
+
+	rc = mnt_table_fetch_listmount(tb);
+	if (rc) {
+		fprintf(stderr, "listmount failed: %s\n", strerror(-rc));
+		goto done;
+	}
+	while (mnt_table_next_fs(tb, itr, &fs) == 0)
+		mnt_fs_print_debug(fs, stdout);
+done:
+	mnt_free_iter(itr);
+	mnt_unref_table(tb);
+	return rc;
+}
+
+static int test_target(struct libmnt_test *ts __attribute__((unused)),
+		       int argc, char *argv[])
+{
+	struct libmnt_table *tb;
+	struct libmnt_iter *itr;
+	struct libmnt_fs *fs;
+	int rc;
+
+	if (argc < 2)
+		return -EINVAL;
+
+	tb = mnt_new_table();
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+	if (!tb || !itr)
+		return -ENOMEM;
+
+	rc = mnt_table_fetch_listmount_target(tb, argv[1]);
+	if (rc) {
+		fprintf(stderr, "statmount failed: %s\n", strerror(-rc));
+		goto done;
+	}
+	while (mnt_table_next_fs(tb, itr, &fs) == 0)
+		mnt_fs_print_debug(fs, stdout);
+done:
+	mnt_free_iter(itr);
+	mnt_unref_table(tb);
+	return rc;
+}
+
+static int test_update(struct libmnt_test *ts __attribute__((unused)),
+		       int argc __attribute__((unused)),
+		       char *argv[] __attribute__((unused)))
+{
+	struct libmnt_table *tb;
+	struct libmnt_tabdiff *df;
+	struct libmnt_monitor *mn;
+	struct libmnt_iter *itr;
+	int rc;
+
+	tb = mnt_new_table();
+	df = mnt_new_tabdiff();
+	mn = mnt_new_monitor();
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+	if (!tb || !df || !mn || !itr)
+		return -ENOMEM;
+
+	rc = mnt_table_fetch_listmount(tb);
+	if (!rc)
+		rc = mnt_monitor_enable_fanotify(mn, 1);
+	if (rc) {
+		fprintf(stderr, "failed to initialize: %s\n", strerror(-rc));
+		goto done;
+	}
+
+	printf("%d mounts, waiting for changes...\n", mnt_table_get_nents(tb));
+	while (mnt_monitor_wait(mn, -1) > 0) {
+		struct libmnt_fs *old, *new;
+		uint64_t id;
+		int oper;
+
+		while ((rc = mnt_monitor_next_mount(mn, &id, NULL)) == 0) {
+			rc = mnt_table_update_mount(tb, id, df);
+			if (rc < 0)
+				goto done;
+		}
+		if (rc < 0)
+			goto done;
+
+		mnt_reset_iter(itr, MNT_ITER_FORWARD);
+		while (mnt_tabdiff_next_change(df, itr, &old, &new, &oper) == 0) {
+			struct libmnt_fs *fs = new ? new : old;
+
+			printf(" %" PRIu64 " %s: %s\n", mnt_fs_get_uniq_id(fs),
+				mnt_fs_get_target(fs),
+				oper == MNT_TABDIFF_MOUNT ? "mounted" :
+				oper == MNT_TABDIFF_UMOUNT ? "umounted" :
+				oper == MNT_TABDIFF_MOVE ? "moved" :
+				oper == MNT_TABDIFF_REMOUNT ? "remounted" :
+				"propagation changed");
+		}
+		mnt_reset_tabdiff(df);
+		printf("%d mounts, waiting for changes...\n", mnt_table_get_nents(tb));
+	}
+done:
+	mnt_free_iter(itr);
+	mnt_unref_monitor(mn);
+	mnt_free_tabdiff(df);
+	mnt_unref_table(tb);
+	return rc;
+}
+
+int main(int argc, char *argv[])
+{
+	struct libmnt_test tss[] = {
+	{ "--list", test_listmount, "[<mountpoint>]  print mounts by listmount()" },
+	{ "--target", test_target, "<path>  print mount(s) of the path by statmount()" },
+	{ "--update", test_update, "  keep mounts up to date by fanotify" },
+	{ NULL }
+	};
+
+	return mnt_run_test(tss, argc, argv);
+}
+#endif /* TEST_PROGRAM */
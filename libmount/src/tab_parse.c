@@ -50,34 +50,38 @@ static void parser_cleanup(struct libmnt_parser *pa)
 
 static const char *next_s32(const char *s, int *num, int *rc)
 {
-	char *end = NULL;
+	const char *end;
+	uint64_t n;
+	int neg;
 
 	if (!s || !*s)
 		return s;
 
-	errno = 0;
 	*rc = -EINVAL;
-	*num = strtol(s, &end, 10);
-	if (end == NULL || s == end)
+	neg = *s == '-';
+	end = ul_scan_u64(s + (neg || *s == '+'), NULL, &n);
+	if (!end)
 	       return s;
-	if (errno == 0 && (*end == ' ' || *end == '\t' || *end == '\0'))
+	if (n <= (uint64_t) INT_MAX + neg
+	    && (*end == ' ' || *end == '\t' || *end == '\0')) {
+		*num = neg ? (int) -(int64_t) n : (int) n;
 		*rc = 0;
+	}
 	return end;
 }
 
 static const char *next_u64(const char *s, uint64_t *num, int *rc)
 {
-	char *end = NULL;
+	const char *end;
 
 	if (!s || !*s)
 		return s;
 
-	errno = 0;
 	*rc = -EINVAL;
-	*num = (uint64_t) strtoumax(s, &end, 10);
-	if (end == NULL || s == end)
+	end = ul_scan_u64(s, NULL, num);
+	if (!end)
 	       return s;
-	if (errno == 0 && (*end == ' ' || *end == '\t' || *end == '\0'))
+	if (*end == ' ' || *end == '\t' || *end == '\0')
 		*rc = 0;
 	return end;
 }
@@ -179,122 +183,196 @@ fail:
 
 
 /*
- * Parses one line from a mountinfo file
+ * Returns the next field from the line, the field is terminated and unmangled
+ * in place in the line buffer. The @str is moved after the field separator.
  */
-static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, const char *s)
+static char *next_field(char **str, size_t *len)
 {
-	int rc = 0;
-	unsigned int maj, min;
+	char *p = *str, *end;
+
+	while (*p == ' ' || *p == '\t')
+		p++;
+
+	end = p + strcspn(p, " \t");
+	*str = *end ? end + 1 : end;
+	*end = '\0';
+	*len = end - p;
+
+	if (*len && memchr(p, '\\', *len)) {
+		unmangle_string(p);
+		*len = strlen(p);
+	}
+	return p;
+}
+
+/*
+ * Stores the fields from the mountinfo line which are not required to sort
+ * and search in the table to one buffer; the buffer is decoded on the first
+ * access by mnt_fs_get_*() functions. See __mnt_fs_decode_lazy().
+ */
+static int set_lazy_fields(struct libmnt_fs *fs, const char **fields, size_t *lens)
+{
+	size_t i, sz = 0;
 	char *p;
 
+	for (i = 0; i < 4; i++)
+		sz += lens[i] + 1;
+
+	p = fs->lazy = malloc(sz);
+	if (!p)
+		return -ENOMEM;
+
+	for (i = 0; i < 4; i++) {
+		if (lens[i])
+			memcpy(p, fields[i], lens[i]);
+		p += lens[i];
+		*p++ = '\0';
+	}
+
+	fs->lazy_mask = MNT_FS_LAZY_ALL;
+	if (!lens[2])
+		fs->lazy_mask &= ~MNT_FS_LAZY_OPTFIELDS;
+	return 0;
+}
+
+static char *dup_field(const char *p, size_t len)
+{
+	char *res = malloc(len + 1);
+
+	if (res) {
+		memcpy(res, p, len);
+		res[len] = '\0';
+	}
+	return res;
+}
+
+/*
+ * Parses one line from a mountinfo file. The line buffer is modified.
+ */
+static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, char *s)
+{
+	int rc = 0;
+	unsigned long maj, min;
+	char *p, *end;
+	size_t len;
+	const char *lazy[4] = { NULL };		/* root, vfsopts, optfields, fsopts */
+	size_t lazylen[4] = { 0 };
+
 	fs->flags |= MNT_FS_KERNEL;
 
 	/* (1) id */
-	s = next_s32(s, &fs->id, &rc);
+	s = (char *) next_s32(s, &fs->id, &rc);
 	if (!s || !*s || rc) {
 		DBG(TAB, ul_debug("tab parse error: [id]"));
 		goto fail;
 	}
 
-	s = skip_separator(s);
+	s = (char *) skip_separator(s);
 
 	/* (2) parent */
-	s = next_s32(s, &fs->parent, &rc);
+	s = (char *) next_s32(s, &fs->parent, &rc);
 	if (!s || !*s || rc) {
 		DBG(TAB, ul_debug("tab parse error: [parent]"));
 		goto fail;
 	}
 
-	s = skip_separator(s);
+	s = (char *) skip_separator(s);
 
 	/* (3) maj:min */
-	if (sscanf(s, "%u:%u", &maj, &min) != 2) {
+	maj = strtoul(s, &end, 10);
+	if (end == s || *end != ':') {
+		DBG(TAB, ul_debug("tab parse error: [maj:min]"));
+		goto fail;
+	}
+	s = end + 1;
+	min = strtoul(s, &end, 10);
+	if (end == s) {
 		DBG(TAB, ul_debug("tab parse error: [maj:min]"));
 		goto fail;
 	}
 	fs->devno = makedev(maj, min);
-	s = skip_nonspearator(s);
-	s = skip_separator(s);
+	s = (char *) skip_nonspearator(end);
 
 	/* (4) mountroot */
-	fs->root = unmangle(s, &s);
-	if (!fs->root) {
+	p = next_field(&s, &len);
+	if (!len) {
 		DBG(TAB, ul_debug("tab parse error: [mountroot]"));
 		goto fail;
 	}
-
-	s = skip_separator(s);
+	lazy[0] = p;
+	lazylen[0] = len;
 
 	/* (5) target */
-	fs->target = unmangle(s, &s);
-	if (!fs->target) {
+	p = next_field(&s, &len);
+	if (!len || !(fs->target = dup_field(p, len))) {
 		DBG(TAB, ul_debug("tab parse error: [target]"));
 		goto fail;
 	}
 
-	s = skip_separator(s);
-
 	/* (6) vfs options (fs-independent) */
-	fs->vfs_optstr = unmangle(s, &s);
-	if (!fs->vfs_optstr) {
+	p = next_field(&s, &len);
+	if (!len) {
 		DBG(TAB, ul_debug("tab parse error: [VFS options]"));
 		goto fail;
 	}
+	lazy[1] = p;
+	lazylen[1] = len;
 
 	/* (7) optional fields, terminated by " - " */
-	p = strstr(s, " - ");
-	if (!p) {
-		DBG(TAB, ul_debug("mountinfo parse error: separator not found"));
-		return -EINVAL;
+	if (strncmp(s, "- ", 2) == 0)
+		s += 2;
+	else {
+		p = strstr(s, " - ");
+		if (!p) {
+			DBG(TAB, ul_debug("mountinfo parse error: separator not found"));
+			return -EINVAL;
+		}
+		lazy[2] = s;
+		lazylen[2] = p - s;
+		s = p + 3;
 	}
-	if (p > s + 1)
-		fs->opt_fields = strndup(s + 1, p - s - 1);
-
-	s = skip_separator(p + 3);
 
 	/* (8) FS type */
-	p = unmangle(s, &s);
-	if (!p || (rc = __mnt_fs_set_fstype_ptr(fs, p))) {
+	p = next_field(&s, &len);
+	if (!len || (rc = mnt_fs_set_fstype(fs, p))) {
 		DBG(TAB, ul_debug("tab parse error: [fstype]"));
-		free(p);
 		goto fail;
 	}
 
 	/* (9) source -- maybe empty string */
-	if (!s || !*s) {
+	if (!*s) {
 		DBG(TAB, ul_debug("tab parse error: [source]"));
 		goto fail;
-	} else if (*s == ' ' && *(s+1) == ' ') {
+	} else if (*s == ' ') {
 		if ((rc = mnt_fs_set_source(fs, ""))) {
 			DBG(TAB, ul_debug("tab parse error: [empty source]"));
 			goto fail;
 		}
 	} else {
-		s = skip_separator(s);
-		p = unmangle(s, &s);
-		if (!p || (rc = __mnt_fs_set_source_ptr(fs, p))) {
+		p = next_field(&s, &len);
+		if (!len || !(p = dup_field(p, len))
+		    || (rc = __mnt_fs_set_source_ptr(fs, p))) {
 			DBG(TAB, ul_debug("tab parse error: [regular source]"));
-			free(p);
+			if (len)
+				free(p);
 			goto fail;
 		}
 	}
 
-	s = skip_separator(s);
-
 	/* (10) fs options (fs specific) */
-	fs->fs_optstr = unmangle(s, &s);
-	if (!fs->fs_optstr) {
+	p = next_field(&s, &len);
+	if (!len) {
 		DBG(TAB, ul_debug("tab parse error: [FS options]"));
 		goto fail;
 	}
+	lazy[3] = p;
+	lazylen[3] = len;
 
-	/* merge VFS and FS options to one string */
-	fs->optstr = mnt_fs_strdup_options(fs);
-	if (!fs->optstr) {
-		rc = -ENOMEM;
-		DBG(TAB, ul_debug("tab parse error: [merge VFS and FS options]"));
+	/* root and options are decoded later, VFS and FS options are merged
+	 * to one string on the first mnt_fs_get_options() call */
+	rc = set_lazy_fields(fs, lazy, lazylen);
+	if (rc)
 		goto fail;
-	}
 
 	return 0;
 fail:
@@ -737,6 +815,7 @@ int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filenam
 	assert(f);
 	assert(filename);
 
+	UL_TRACE_BEGIN("mnt_table_parse_stream");
 	DBG(TAB, ul_debugobj(tb, "%s: start parsing [entries=%d, filter=%s]",
 				filename, mnt_table_get_nents(tb),
 				tb->fltrcb ? "yes" : "not"));
@@ -808,10 +887,12 @@ int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filenam
 	DBG(TAB, ul_debugobj(tb, "%s: stop parsing (%d entries)",
 				filename, mnt_table_get_nents(tb)));
 	parser_cleanup(&pa);
+	UL_TRACE_END("mnt_table_parse_stream");
 	return 0;
 err:
 	DBG(TAB, ul_debugobj(tb, "%s: parse error (rc=%d)", filename, rc));
 	parser_cleanup(&pa);
+	UL_TRACE_END("mnt_table_parse_stream");
 	return rc;
 }
 
@@ -1237,6 +1318,17 @@ int __mnt_table_parse_mountinfo(struct libmnt_table *tb, const char *filename,
 	if (filename)
 		DBG(TAB, ul_debugobj(tb, "%s requested as mount table", filename));
 
+	if (!filename && tb->listmount) {
+		DBG(TAB, ul_debugobj(tb, "mountinfo parse: #1 read by listmount"));
+		rc = mnt_table_fetch_listmount(tb);
+		if (rc == 0) {
+			tb->fmt = MNT_FMT_MOUNTINFO;
+			goto utab;
+		}
+		if (rc != -ENOSYS)
+			return rc;
+	}
+
 	if (!filename || strcmp(filename, _PATH_PROC_MOUNTINFO) == 0) {
 		filename = _PATH_PROC_MOUNTINFO;
 		tb->fmt = MNT_FMT_MOUNTINFO;
@@ -1256,6 +1348,7 @@ int __mnt_table_parse_mountinfo(struct libmnt_table *tb, const char *filename,
 
 	if (!is_mountinfo(tb))
 		return 0;
+utab:
 	DBG(TAB, ul_debugobj(tb, "mountinfo parse: #2 read utab"));
 
 	if (mnt_table_get_nents(tb) == 0)
@@ -1307,6 +1400,10 @@ int __mnt_table_parse_mountinfo(struct libmnt_table *tb, const char *filename,
  * mountinfo file then /run/mount/utabs is parsed too and both files are merged
  * to the one libmnt_table.
  *
+ * If listmount is enabled by mnt_table_enable_listmount() and @filename is
+ * NULL, then the kernel mount table is read by listmount() and statmount()
+ * syscalls. /proc/self/mountinfo is used if the syscalls are unsupported.
+ *
  * The file /etc/mtab is no more used. The function uses "mtab" in the name for
  * backward compatibility only.
  *
@@ -91,7 +91,8 @@ int mnt_parse_offset(const char *str, size_t len, uintmax_t *res)
 	return rc;
 }
 
-/* used as a callback by bsearch in mnt_fstype_is_pseudofs() */
+/* used as a callback by bsearch in mnt_fstype_is_pseudofs() and
+ * mnt_get_static_fstype() */
 static int fstype_cmp(const void *v1, const void *v2)
 {
 	const char *s1 = *(char * const *)v1;
@@ -292,6 +293,95 @@ char *mnt_unmangle(const char *str)
 	return unmangle(str, NULL);
 }
 
+/* This array must remain sorted when adding new fstypes */
+static const char *pseudofs[] = {
+	"anon_inodefs",
+	"apparmorfs",
+	"autofs",
+	"bdev",
+	"binder",
+	"binfmt_misc",
+	"bpf",
+	"cgroup",
+	"cgroup2",
+	"configfs",
+	"cpuset",
+	"debugfs",
+	"devfs",
+	"devpts",
+	"devtmpfs",
+	"dlmfs",
+	"dmabuf",
+	"drm",
+	"efivarfs",
+	"fuse", /* Fallback name of fuse used by many poorly written drivers. */
+	"fuse.archivemount", /* Not a true pseudofs (has source), but source is not reported. */
+	"fuse.avfsd", /* Not a true pseudofs (has source), but source is not reported. */
+	"fuse.dumpfs", /* In fact, it is a netfs, but source is not reported. */
+	"fuse.encfs", /* Not a true pseudofs (has source), but source is not reported. */
+	"fuse.gvfs-fuse-daemon", /* Old name, not used by gvfs any more. */
+	"fuse.gvfsd-fuse",
+	"fuse.lxcfs",
+	"fuse.rofiles-fuse",
+	"fuse.vmware-vmblock",
+	"fuse.xwmfs",
+	"fusectl",
+	"hugetlbfs",
+	"ipathfs",
+	"mqueue",
+	"nfsd",
+	"none",
+	"nsfs",
+	"overlay",
+	"pipefs",
+	"proc",
+	"pstore",
+	"ramfs",
+	"resctrl",
+	"rootfs",
+	"rpc_pipefs",
+	"securityfs",
+	"selinuxfs",
+	"smackfs",
+	"sockfs",
+	"spufs",
+	"sysfs",
+	"tmpfs",
+	"tracefs",
+	"vboxsf",
+	"virtiofs"
+};
+
+/*
+ * Other frequently used filesystem types; together with pseudofs[] these
+ * names are shared by all libmnt_fs entries rather than strdup()ed for each
+ * of them, see mnt_get_static_fstype(). This array must remain sorted too.
+ */
+static const char *commonfs[] = {
+	"9p",
+	"btrfs",
+	"cifs",
+	"erofs",
+	"exfat",
+	"ext2",
+	"ext3",
+	"ext4",
+	"f2fs",
+	"fuseblk",
+	"iso9660",
+	"nfs",
+	"nfs4",
+	"ntfs",
+	"ntfs3",
+	"smb3",
+	"squashfs",
+	"swap",
+	"udf",
+	"vfat",
+	"xfs",
+	"zfs"
+};
+
 /**
  * mnt_fstype_is_pseudofs:
  * @type: filesystem name
@@ -300,71 +390,40 @@ char *mnt_unmangle(const char *str)
  */
 int mnt_fstype_is_pseudofs(const char *type)
 {
-	/* This array must remain sorted when adding new fstypes */
-	static const char *pseudofs[] = {
-		"anon_inodefs",
-		"apparmorfs",
-		"autofs",
-		"bdev",
-		"binder",
-		"binfmt_misc",
-		"bpf",
-		"cgroup",
-		"cgroup2",
-		"configfs",
-		"cpuset",
-		"debugfs",
-		"devfs",
-		"devpts",
-		"devtmpfs",
-		"dlmfs",
-		"dmabuf",
-		"drm",
-		"efivarfs",
-		"fuse", /* Fallback name of fuse used by many poorly written drivers. */
-		"fuse.archivemount", /* Not a true pseudofs (has source), but source is not reported. */
-		"fuse.avfsd", /* Not a true pseudofs (has source), but source is not reported. */
-		"fuse.dumpfs", /* In fact, it is a netfs, but source is not reported. */
-		"fuse.encfs", /* Not a true pseudofs (has source), but source is not reported. */
-		"fuse.gvfs-fuse-daemon", /* Old name, not used by gvfs any more. */
-		"fuse.gvfsd-fuse",
-		"fuse.lxcfs",
-		"fuse.rofiles-fuse",
-		"fuse.vmware-vmblock",
-		"fuse.xwmfs",
-		"fusectl",
-		"hugetlbfs",
-		"ipathfs",
-		"mqueue",
-		"nfsd",
-		"none",
-		"nsfs",
-		"overlay",
-		"pipefs",
-		"proc",
-		"pstore",
-		"ramfs",
-		"resctrl",
-		"rootfs",
-		"rpc_pipefs",
-		"securityfs",
-		"selinuxfs",
-		"smackfs",
-		"sockfs",
-		"spufs",
-		"sysfs",
-		"tmpfs",
-		"tracefs",
-		"vboxsf",
-		"virtiofs"
-	};
-
 	assert(type);
 
 	return !(bsearch(&type, pseudofs, ARRAY_SIZE(pseudofs),
 				sizeof(char*), fstype_cmp) == NULL);
 }
 
+/*
+ * Returns a static copy of the well-known filesystem type @type or NULL. The
+ * result must not be deallocated. The MNT_FS_{PSEUDO,NET,SWAP} flags for the
+ * type are returned by @flags, so the caller does not have to search again.
+ */
+const char *mnt_get_static_fstype(const char *type, int *flags)
+{
+	const char **p;
+
+	assert(type);
+	assert(flags);
+
+	p = bsearch(&type, pseudofs, ARRAY_SIZE(pseudofs),
+			sizeof(char *), fstype_cmp);
+	if (p) {
+		*flags = MNT_FS_PSEUDO;
+		return *p;
+	}
+	p = bsearch(&type, commonfs, ARRAY_SIZE(commonfs),
+			sizeof(char *), fstype_cmp);
+	if (!p)
+		return NULL;
+
+	*flags = mnt_fstype_is_netfs(*p) ? MNT_FS_NET :
+		 strcmp(*p, "swap") == 0 ? MNT_FS_SWAP : 0;
+	return *p;
+}
+
 /**
  * mnt_fstype_is_netfs:
  * @type: filesystem name
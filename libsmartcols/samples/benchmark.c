@@ -0,0 +1,372 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ *
+ * Printing benchmark. The program generates tables, trees and grouped trees
+ * with the requested number of cells (mixed widths, multibyte and long
+ * wrappable data) and measures scols_print_table() for all output formats.
+ * The results are printed as one JSON object per line.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <locale.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <sys/resource.h>
+
+#include "c.h"
+#include "libsmartcols.h"
+
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+# include <malloc.h>
+# define HAVE_MALLINFO2	1
+#endif
+
+enum {
+	COL_NAME,
+	COL_ID,
+	COL_SIZE,
+	COL_TYPE,
+	COL_LABEL,
+	COL_PATH,
+	COL_DESC,
+	COL_FLAGS,
+	NCOLUMNS
+};
+
+enum {
+	LAYOUT_TABLE,
+	LAYOUT_TREE,
+	LAYOUT_GROUPS
+};
+
+static const char *layouts[] = {
+	[LAYOUT_TABLE] = "table",
+	[LAYOUT_TREE] = "tree",
+	[LAYOUT_GROUPS] = "groups"
+};
+
+enum {
+	MODE_HUMAN,
+	MODE_RAW,
+	MODE_JSON,
+	MODE_EXPORT,
+	MODE_WRAP
+};
+
+static const char *modes[] = {
+	[MODE_HUMAN] = "human",
+	[MODE_RAW] = "raw",
+	[MODE_JSON] = "json",
+	[MODE_EXPORT] = "export",
+	[MODE_WRAP] = "wrap"
+};
+
+struct bench {
+	FILE		*out;
+	unsigned long	ncells;
+	unsigned long	niter;
+	unsigned int	termwidth;
+};
+
+static const char *types[] = { "disk", "part", "lvm", "crypt", "loop", "raid1" };
+
+static const char *labels[] = {
+	"data",
+	"příliš žluťoučký kůň",
+	"数据盘",
+	"Ünïcödé-Läbel",
+	"backup 2024",
+	"système"
+};
+
+static uint64_t cpu_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* allocated memory in KiB, or RSS if malloc statistic is not available */
+static long memory_kib(void)
+{
+#ifdef HAVE_MALLINFO2
+	struct mallinfo2 mi = mallinfo2();
+
+	return (mi.uordblks + mi.hblkhd) / 1024;
+#else
+	FILE *f = fopen("/proc/self/statm", "r");
+	long size, rss = 0;
+
+	if (f) {
+		if (fscanf(f, "%ld %ld", &size, &rss) != 2)
+			rss = 0;
+		fclose(f);
+	}
+	return rss * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+}
+
+static long maxrss_kib(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return 0;
+	return ru.ru_maxrss;
+}
+
+static void setup_columns(struct libscols_table *tb, int layout)
+{
+	if (!scols_table_new_column(tb, "NAME", 0, layout == LAYOUT_TABLE ? 0 : SCOLS_FL_TREE)
+	    || !scols_table_new_column(tb, "ID", 0, SCOLS_FL_RIGHT)
+	    || !scols_table_new_column(tb, "SIZE", 0, SCOLS_FL_RIGHT)
+	    || !scols_table_new_column(tb, "TYPE", 0, 0)
+	    || !scols_table_new_column(tb, "LABEL", 0, 0)
+	    || !scols_table_new_column(tb, "PATH", 0, SCOLS_FL_TRUNC)
+	    || !scols_table_new_column(tb, "DESC", 0, SCOLS_FL_NOEXTREMES)
+	    || !scols_table_new_column(tb, "FLAGS", 0, 0))
+		err(EXIT_FAILURE, "failed to create output columns");
+}
+
+static void set_cell(struct libscols_line *ln, size_t col, const char *fmt, ...)
+	__attribute__ ((__format__ (__printf__, 3, 4)));
+
+static void set_cell(struct libscols_line *ln, size_t col, const char *fmt, ...)
+{
+	va_list ap;
+	char *str = NULL;
+	int rc;
+
+	va_start(ap, fmt);
+	rc = vasprintf(&str, fmt, ap);
+	va_end(ap);
+
+	if (rc < 0 || scols_line_refer_data(ln, col, str))
+		err(EXIT_FAILURE, "failed to set cell data");
+}
+
+static void fill_line(struct libscols_line *ln, unsigned long i)
+{
+	set_cell(ln, COL_NAME, "dev%lu", i);
+	set_cell(ln, COL_ID, "%lu", i * 7919 % 1000003);
+	set_cell(ln, COL_SIZE, "%lu.%luG", (i * 37) % 4096, i % 10);
+	set_cell(ln, COL_TYPE, "%s", types[i % ARRAY_SIZE(types)]);
+	set_cell(ln, COL_LABEL, "%s %lu", labels[i % ARRAY_SIZE(labels)], i % 100);
+	set_cell(ln, COL_PATH, "/var/lib/containers/c%lu/merged/srv/volume-%lu%s",
+			i / 8, i,
+			i % 5 == 0 ? "/a/very/long/directory/name/to/make/widths/different" : "");
+	set_cell(ln, COL_DESC, "%s", i % 3 == 0 ?
+			"a long description which is a good candidate for wrapping, "
+			"it contains many words and it is usually wider than the terminal" :
+			"short text");
+	set_cell(ln, COL_FLAGS, "%s%s%s",
+			i % 2 ? "ro," : "rw,",
+			i % 3 ? "nosuid," : "",
+			i % 7 ? "relatime" : "noatime");
+}
+
+static struct libscols_table *build_table(struct bench *bc, int layout)
+{
+	struct libscols_table *tb = scols_new_table();
+	struct libscols_line *parent = NULL, *group = NULL;
+	unsigned long i, nlines = bc->ncells / NCOLUMNS;
+
+	if (!tb)
+		err(EXIT_FAILURE, "failed to create output table");
+
+	scols_table_set_stream(tb, bc->out);
+	scols_table_set_termforce(tb, SCOLS_TERMFORCE_ALWAYS);
+	scols_table_set_termwidth(tb, bc->termwidth);
+	scols_table_set_name(tb, "benchmark");
+	setup_columns(tb, layout);
+
+	for (i = 0; i < nlines; i++) {
+		struct libscols_line *ln;
+
+		/* trees: 1 root line and 7 children in 3 levels */
+		if (layout != LAYOUT_TABLE && i % 8 == 0)
+			parent = NULL;
+
+		ln = scols_table_new_line(tb, parent);
+		if (!ln)
+			err(EXIT_FAILURE, "failed to create output line");
+		fill_line(ln, i);
+
+		if (layout == LAYOUT_TABLE)
+			continue;
+		if (i % 8 == 0 || i % 8 == 3)
+			parent = ln;
+
+		/* groups: the root line and the last child of every 4th tree
+		 * are members of a group, the next root is linked to the group */
+		if (layout != LAYOUT_GROUPS)
+			continue;
+		if (i % 32 == 0)
+			group = ln;
+		else if (i % 32 == 7)
+			scols_table_group_lines(tb, group, ln, 0);
+		else if (i % 32 == 8)
+			scols_line_link_group(ln, group, 0);
+	}
+
+	return tb;
+}
+
+static void set_mode(struct libscols_table *tb, int mode)
+{
+	struct libscols_column *cl = scols_table_get_column(tb, COL_DESC);
+	int flags = scols_column_get_flags(cl) & ~SCOLS_FL_WRAP;
+
+	scols_table_enable_raw(tb, 0);
+	scols_table_enable_json(tb, 0);
+	scols_table_enable_export(tb, 0);
+
+	switch (mode) {
+	case MODE_HUMAN:
+		break;
+	case MODE_RAW:
+		scols_table_enable_raw(tb, 1);
+		break;
+	case MODE_JSON:
+		scols_table_enable_json(tb, 1);
+		break;
+	case MODE_EXPORT:
+		scols_table_enable_export(tb, 1);
+		break;
+	case MODE_WRAP:
+		flags |= SCOLS_FL_WRAP;
+		break;
+	}
+	scols_column_set_flags(cl, flags);
+}
+
+static void bench_layout(struct bench *bc, int layout)
+{
+	struct libscols_table *tb;
+	uint64_t start, build;
+	unsigned long n;
+	size_t nlines;
+	long mem;
+	int mode;
+
+	mem = memory_kib();
+	start = cpu_nsec();
+	tb = build_table(bc, layout);
+	build = cpu_nsec() - start;
+	mem = memory_kib() - mem;
+	nlines = scols_table_get_nlines(tb);
+
+	for (mode = 0; mode < (int) ARRAY_SIZE(modes); mode++) {
+		uint64_t nsec = 0;
+
+		set_mode(tb, mode);
+
+		for (n = 0; n < bc->niter; n++) {
+			start = cpu_nsec();
+			if (scols_print_table(tb) != 0)
+				errx(EXIT_FAILURE, "%s: %s: print failed",
+						layouts[layout], modes[mode]);
+			fflush(bc->out);
+			nsec += cpu_nsec() - start;
+		}
+
+		printf("{\"layout\":\"%s\",\"mode\":\"%s\",\"cells\":%zu,\"lines\":%zu"
+		       ",\"iterations\":%lu,\"build_usec\":%.1f,\"print_usec\":%.1f"
+		       ",\"print_nsec_per_cell\":%.1f,\"memory_kib\":%ld,\"maxrss_kib\":%ld}\n",
+			layouts[layout], modes[mode], nlines * NCOLUMNS, nlines,
+			bc->niter, (double) build / 1000,
+			(double) nsec / bc->niter / 1000,
+			nlines ? (double) nsec / bc->niter / (nlines * NCOLUMNS) : 0.0,
+			mem, maxrss_kib());
+		fflush(stdout);
+	}
+
+	scols_unref_table(tb);
+}
+
+static void __attribute__((__noreturn__)) usage(int status)
+{
+	fprintf(status ? stderr : stdout, "usage: %s [options]\n"
+			"  -n, --cells N       number of cells in generated tables (default 1000),\n"
+			"                      may be specified more than once\n"
+			"  -i, --iterations N  number of print iterations (default 3)\n"
+			"  -o, --output FILE   print tables to FILE (default /dev/null)\n"
+			"  -w, --width N       output width (default 160)\n"
+			"  -h, --help          display this help\n",
+			program_invocation_short_name);
+	exit(status);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option longopts[] = {
+		{ "cells",	required_argument, NULL, 'n' },
+		{ "iterations",	required_argument, NULL, 'i' },
+		{ "output",	required_argument, NULL, 'o' },
+		{ "width",	required_argument, NULL, 'w' },
+		{ "help",	no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	struct bench bc = { .niter = 3, .termwidth = 160 };
+	unsigned long *cells = NULL;
+	const char *output = "/dev/null";
+	size_t ncells = 0, i;
+	int c, layout;
+
+	setlocale(LC_ALL, "");
+
+	while ((c = getopt_long(argc, argv, "n:i:o:w:h", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'n':
+			cells = realloc(cells, (ncells + 1) * sizeof(*cells));
+			if (!cells)
+				err(EXIT_FAILURE, "cannot allocate cells");
+			cells[ncells] = strtoul(optarg, NULL, 10);
+			if (cells[ncells] < NCOLUMNS)
+				errx(EXIT_FAILURE, "invalid number of cells: %s", optarg);
+			ncells++;
+			break;
+		case 'i':
+			bc.niter = strtoul(optarg, NULL, 10);
+			if (!bc.niter)
+				errx(EXIT_FAILURE, "invalid number of iterations: %s", optarg);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'w':
+			bc.termwidth = strtoul(optarg, NULL, 10);
+			if (!bc.termwidth)
+				errx(EXIT_FAILURE, "invalid width: %s", optarg);
+			break;
+		case 'h':
+			usage(EXIT_SUCCESS);
+		default:
+			usage(EXIT_FAILURE);
+		}
+	}
+	if (optind < argc)
+		usage(EXIT_FAILURE);
+
+	bc.out = fopen(output, "w" UL_CLOEXECSTR);
+	if (!bc.out)
+		err(EXIT_FAILURE, "%s: cannot open", output);
+
+	for (i = 0; i < (ncells ? ncells : 1); i++) {
+		bc.ncells = ncells ? cells[i] : 1000;
+
+		for (layout = 0; layout < (int) ARRAY_SIZE(layouts); layout++)
+			bench_layout(&bc, layout);
+	}
+
+	if (ferror(bc.out) | fclose(bc.out))
+		err(EXIT_FAILURE, "%s: write failed", output);
+	free(cells);
+	return EXIT_SUCCESS;
+}
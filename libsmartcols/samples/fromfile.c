@@ -120,6 +120,33 @@ static void compose_tree(struct libscols_table *tb, int parent_col, int id_col)
 	scols_free_iter(itr);
 }
 
+static void sort_table(struct libscols_table *tb, const char *name)
+{
+	struct libscols_column *cl = scols_table_get_column_by_name(tb, name);
+
+	if (!cl)
+		errx(EXIT_FAILURE, "%s: no such sort column", name);
+
+	/* sort by keys of the data type, strings by scols_cmpstr_cells() */
+	switch (scols_column_get_json_type(cl)) {
+	case SCOLS_JSON_NUMBER:
+		scols_column_set_data_type(cl, SCOLS_DATA_U64);
+		break;
+	case SCOLS_JSON_FLOAT:
+		scols_column_set_data_type(cl, SCOLS_DATA_FLOAT);
+		break;
+	case SCOLS_JSON_BOOLEAN:
+		scols_column_set_data_type(cl, SCOLS_DATA_BOOLEAN);
+		break;
+	default:
+		scols_column_set_cmpfunc(cl, scols_cmpstr_cells, NULL);
+		break;
+	}
+
+	if (scols_sort_table(tb, cl) != 0)
+		errx(EXIT_FAILURE, "%s: failed to sort table", name);
+}
+
 static struct libscols_filter *init_filter(
 			struct libscols_table *tb,
 			const char *query, int dump)
@@ -172,6 +199,29 @@ static struct libscols_filter *init_filter(
  * only the data necessary for evaluating the filter, and the remaining data is
  * gathered later, only if necessary.
  */
+/* fills empty cells on demand, the calls are logged to stdout */
+static int filler_cb(struct libscols_filter *fltr __attribute__((__unused__)),
+		     struct libscols_line *ln, size_t colnum, void *data)
+{
+	struct libscols_table *tb = data;
+	struct libscols_cell *ce = scols_line_get_cell(ln, 0);
+	struct libscols_column *cl = scols_table_get_column(tb, colnum);
+
+	printf("filler: %s %s\n", ce ? scols_cell_get_data(ce) : NULL,
+			cl ? scols_column_get_name(cl) : NULL);
+	return scols_line_set_data(ln, colnum, "filled");
+}
+
+/* writes at most @data bytes (if not zero) to stdout, to test short writes */
+static ssize_t print_cb(void *data, const char *buf, size_t sz)
+{
+	size_t max = *((size_t *) data);
+
+	if (max && sz > max)
+		sz = max;
+	return fwrite(buf, 1, sz, stdout) == sz ? (ssize_t) sz : -1;
+}
+
 static void apply_filter(struct libscols_table *tb, struct libscols_filter *fltr)
 {
 	struct libscols_iter *itr = scols_new_iter(SCOLS_ITER_FORWARD);
@@ -209,6 +259,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(" -c, --column <file>            column definition\n", out);
 	fputs(" -n, --nlines <num>             number of lines\n", out);
 	fputs(" -J, --json                     JSON output format\n", out);
+	fputs(" -B, --cbor                     CBOR output format\n", out);
 	fputs(" -r, --raw                      RAW output format\n", out);
 	fputs(" -E, --export                   use key=\"value\" output format\n", out);
 	fputs(" -C, --colsep <str>             set columns separator\n", out);
@@ -216,6 +267,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(" -p, --tree-parent-column <n>   parent column\n", out);
 	fputs(" -i, --tree-id-column <n>       id column\n", out);
 	fputs(" -Q, --filter <expr>            filter\n", out);
+	fputs(" -F, --filter-filler            fill empty cells by filter callback\n", out);
+	fputs(" -S, --sort <name>              sort by the column\n", out);
+	fputs(" -W, --print-callback <max>     print by callback, write <max> bytes per call\n", out);
 	fputs(" -h, --help                     this help\n", out);
 	fputs("\n", out);
 
@@ -227,8 +281,9 @@ int main(int argc, char *argv[])
 	struct libscols_table *tb;
 	int c, n, nlines = 0, rc;
 	int parent_col = -1, id_col = -1;
-	int fltr_dump = 0;
-	const char *fltr_str = NULL;
+	int fltr_dump = 0, fltr_filler = 0, print_callback = 0;
+	size_t print_max = 0;
+	const char *fltr_str = NULL, *sort_name = NULL;
 	struct libscols_filter *fltr = NULL;
 
 	static const struct option longopts[] = {
@@ -240,17 +295,21 @@ int main(int argc, char *argv[])
 		{ "tree-parent-column", 1, NULL, 'p' },
 		{ "tree-id-column",	1, NULL, 'i' },
 		{ "json",   0, NULL, 'J' },
+		{ "cbor",   0, NULL, 'B' },
 		{ "raw",    0, NULL, 'r' },
 		{ "export", 0, NULL, 'E' },
 		{ "colsep",  1, NULL, 'C' },
 		{ "filter", 1, NULL, 'Q' },
 		{ "filter-dump", 0, NULL, 'd' },
+		{ "filter-filler", 0, NULL, 'F' },
+		{ "sort",   1, NULL, 'S' },
+		{ "print-callback", 1, NULL, 'W' },
 		{ "help",   0, NULL, 'h' },
 		{ NULL, 0, NULL, 0 },
 	};
 
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
-		{ 'E', 'J', 'r' },
+		{ 'B', 'E', 'J', 'r' },
 		{ 'M', 'm' },
 		{ 0 }
 	};
@@ -263,7 +322,7 @@ int main(int argc, char *argv[])
 	if (!tb)
 		err(EXIT_FAILURE, "failed to create output table");
 
-	while((c = getopt_long(argc, argv, "hCc:dEi:JMmn:p:Q:rw:", longopts, NULL)) != -1) {
+	while((c = getopt_long(argc, argv, "BhCc:dEFi:JMmn:p:Q:rS:W:w:", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -280,6 +339,9 @@ int main(int argc, char *argv[])
 		case 'd':
 			fltr_dump = 1;
 			break;
+		case 'F':
+			fltr_filler = 1;
+			break;
 		case 'p':
 			parent_col = strtou32_or_err(optarg, "failed to parse tree PARENT column");
 			break;
@@ -290,6 +352,10 @@ int main(int argc, char *argv[])
 			scols_table_enable_json(tb, 1);
 			scols_table_set_name(tb, "testtable");
 			break;
+		case 'B':
+			scols_table_enable_cbor(tb, 1);
+			scols_table_set_name(tb, "testtable");
+			break;
 		case 'm':
 			scols_table_enable_maxout(tb, TRUE);
 			break;
@@ -311,6 +377,13 @@ int main(int argc, char *argv[])
 		case 'Q':
 			fltr_str = optarg;
 			break;
+		case 'S':
+			sort_name = optarg;
+			break;
+		case 'W':
+			print_callback = 1;
+			print_max = strtou32_or_err(optarg, "failed to parse write size");
+			break;
 		case 'w':
 			scols_table_set_termforce(tb, SCOLS_TERMFORCE_ALWAYS);
 			scols_table_set_termwidth(tb, strtou32_or_err(optarg, "failed to parse terminal width"));
@@ -340,6 +413,8 @@ int main(int argc, char *argv[])
 			rc = EXIT_FAILURE;
 			goto done;
 		}
+		if (fltr_filler)
+			scols_filter_set_filler_cb(fltr, filler_cb, tb);
 	}
 
 	n = 0;
@@ -358,12 +433,19 @@ int main(int argc, char *argv[])
 	if (scols_table_is_tree(tb) && parent_col >= 0 && id_col >= 0)
 		compose_tree(tb, parent_col, id_col);
 
+	if (sort_name)
+		sort_table(tb, sort_name);
+
 	scols_table_enable_colors(tb, isatty(STDOUT_FILENO));
 
 	if (fltr)
 		apply_filter(tb, fltr);
 
-	scols_print_table(tb);
+	if (print_callback) {
+		if (scols_print_table_to_callback(tb, print_cb, &print_max) != 0)
+			err(EXIT_FAILURE, "failed to print table");
+	} else
+		scols_print_table(tb);
 	rc = EXIT_SUCCESS;
 done:
 	scols_unref_filter(fltr);
@@ -0,0 +1,140 @@
+/*
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "c.h"
+#include "nls.h"
+#include "strutils.h"
+#include "xalloc.h"
+
+#include "libsmartcols.h"
+
+enum { COL_COUNT, COL_TEXT, COL_STATUS };
+
+/* add columns to the @tb */
+static void setup_columns(struct libscols_table *tb, int trunc)
+{
+	if (!scols_table_new_column(tb, "COUNT", 0.1, SCOLS_FL_RIGHT))
+		goto fail;
+	if (!scols_table_new_column(tb, "TEXT", 0.5, trunc ? SCOLS_FL_TRUNC : 0))
+		goto fail;
+	if (!scols_table_new_column(tb, "STATUS", 0.4, 0))
+		goto fail;
+	return;
+fail:
+	scols_unref_table(tb);
+	err(EXIT_FAILURE, "failed to create output columns");
+}
+
+static void add_line(struct libscols_table *tb, size_t i, size_t nlines)
+{
+	char *p;
+	struct libscols_line *ln = scols_table_new_line(tb, NULL);
+
+	if (!ln)
+		err(EXIT_FAILURE, "failed to create output line");
+
+	xasprintf(&p, "%zu", i);
+	if (scols_line_refer_data(ln, COL_COUNT, p))
+		goto fail;
+
+	/* the last line is wider than the lines used to calculate widths */
+	if (i + 1 == nlines)
+		xasprintf(&p, "long-text-%zu-long-text", i);
+	else
+		xasprintf(&p, "text%zu", i);
+	if (scols_line_refer_data(ln, COL_TEXT, p))
+		goto fail;
+
+	/* repeated values, don't allocate for each line */
+	if (scols_line_refer_static_data(ln, COL_STATUS,
+			scols_table_intern_string(tb, i % 2 ? "odd" : "even")))
+		goto fail;
+	return;
+fail:
+	scols_unref_table(tb);
+	err(EXIT_FAILURE, "failed to create output line");
+}
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+	fprintf(out,
+		"\n %s [options]\n\n", program_invocation_short_name);
+
+	fputs(" -n, --nlines <num>    number of lines\n", out);
+	fputs(" -s, --sample <num>    number of lines to calculate widths\n", out);
+	fputs(" -t, --trunc           truncate TEXT column\n", out);
+	fputs(" -J, --json            JSON output\n", out);
+	fputs(" -w, --width <num>     hardcode terminal width\n", out);
+	fputs(" -h, --help            this help\n", out);
+	fputs("\n", out);
+
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+	struct libscols_table *tb;
+	size_t i, nlines = 10;
+	int c, trunc = 0;
+
+	static const struct option longopts[] = {
+		{ "nlines", 1, NULL, 'n' },
+		{ "sample", 1, NULL, 's' },
+		{ "trunc",  0, NULL, 't' },
+		{ "json",   0, NULL, 'J' },
+		{ "width",  1, NULL, 'w' },
+		{ "help",   0, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	setlocale(LC_ALL, "");	/* just to have enable UTF8 chars */
+	scols_init_debug(0);
+
+	tb = scols_new_table();
+	if (!tb)
+		err(EXIT_FAILURE, "failed to create output table");
+	scols_table_enable_streaming(tb, 1);
+
+	while((c = getopt_long(argc, argv, "hJn:s:tw:", longopts, NULL)) != -1) {
+		switch(c) {
+		case 'n':
+			nlines = strtou32_or_err(optarg, "failed to parse number of lines");
+			break;
+		case 's':
+			scols_table_set_streaming_sample(tb,
+				strtou32_or_err(optarg, "failed to parse number of lines"));
+			break;
+		case 't':
+			trunc = 1;
+			break;
+		case 'J':
+			scols_table_enable_json(tb, 1);
+			scols_table_set_name(tb, "streamtable");
+			break;
+		case 'w':
+			scols_table_set_termforce(tb, SCOLS_TERMFORCE_ALWAYS);
+			scols_table_set_termwidth(tb, strtou32_or_err(optarg, "failed to parse terminal width"));
+			break;
+		case 'h':
+			usage();
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	setup_columns(tb, trunc);
+
+	for (i = 0; i < nlines; i++)
+		add_line(tb, i, nlines);
+
+	scols_print_table(tb);
+	scols_unref_table(tb);
+	return EXIT_SUCCESS;
+}
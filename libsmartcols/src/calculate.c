@@ -48,14 +48,33 @@ static int count_cell_width(struct libscols_table *tb,
 	char *data;
 
 	ce = scols_line_get_cell(ln, cl->seqnum);
+
+	/* The width of a plain cell depends on the cell data only; use the
+	 * width from the previous calculation if the data are the same. Tree
+	 * art and wrapping depend on the line position and column. */
+	if (ce->has_width
+	    && ce->width_noencoding == (scols_table_is_noencoding(tb) ? 1 : 0)
+	    && !scols_column_is_tree(cl)
+	    && !scols_column_is_wrap(cl)
+	    && !scols_column_is_customwrap(cl)) {
+		len = ce->width;
+		goto count;
+	}
+
 	scols_table_set_cursor(tb, ln, cl, ce);
 
 	rc = __cursor_to_buffer(tb, buf, 1);
 	if (rc)
 		goto done;
 
+	ce->is_ascii = 0;
+
 	data = ul_buffer_get_data(buf, NULL, NULL);
-	if (data) {
+	if (data && mbs_is_safe_ascii(data, &len)) {
+		/* the same width and data with and without encoding */
+		if (!scols_column_is_tree(cl))
+			ce->is_ascii = 1;
+	} else if (data) {
 		len = scols_table_is_noencoding(tb) ?
 			mbs_width(data) :
 			mbs_safe_width(data);
@@ -70,7 +89,13 @@ static int count_cell_width(struct libscols_table *tb,
 	}
 
 	ce->width = len;
+	ce->has_width = 1;
+	ce->width_noencoding = scols_table_is_noencoding(tb) ? 1 : 0;
+count:
 	cl->wstat.width_max = max(len, cl->wstat.width_max);
+	cl->wstat.ncells++;
+	cl->wstat.width_sum += len;
+	cl->wstat.width_sq_sum += (double) len * (double) len;
 done:
 	scols_table_reset_cursor(tb);
 	return rc;
@@ -95,43 +120,34 @@ static double sqrtroot(double num)
 	return sq;
 }
 
+/*
+ * Uses sums collected by count_cell_width(), so it's not necessary to walk
+ * all the cells again.
+ */
 static void count_column_deviation(struct libscols_table *tb, struct libscols_column *cl)
 {
 	struct libscols_wstat *st;
-	struct libscols_iter itr;
-	struct libscols_line *ln;
-	struct libscols_cell *ce;
-	size_t sum = 0, n = 0, extra = 0;
+	size_t n, extra = 0;
 
 	st = &cl->wstat;
+	n = st->ncells;
 
 	if (scols_column_is_tree(cl) && has_groups(tb))
 		extra = tb->grpset_size + 1;
 
 	/* count average */
-	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
-	while (scols_table_next_line(tb, &itr, &ln) == 0) {
-		ce = scols_line_get_cell(ln, cl->seqnum);
-
-		n++;
-		sum += ce->width + extra;
-	}
-
 	if (n)
-		st->width_avg = (double) sum / (double) n;
+		st->width_avg = (double) (st->width_sum + n * extra) / (double) n;
 
-	/* count deviation */
+	/* count deviation, sum of (width - avg)^2 */
 	if (n > 1) {
 		double variance;
 
-		scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
-		while (scols_table_next_line(tb, &itr, &ln) == 0) {
-			double diff;
-			ce = scols_line_get_cell(ln, cl->seqnum);
-
-			diff = (double) ce->width - st->width_avg;
-			st->width_sqr_sum += diff * diff;	/* aka pow(x, 2) */
-		}
+		st->width_sqr_sum = st->width_sq_sum
+				    - 2.0 * st->width_avg * (double) st->width_sum
+				    + (double) n * st->width_avg * st->width_avg;
+		if (st->width_sqr_sum < 0)
+			st->width_sqr_sum = 0;	/* rounding error */
 
 		variance = st->width_sqr_sum / (double) (n - 1);
 		st->width_deviation = sqrtroot(variance);
@@ -413,6 +429,7 @@ int __scols_calculate(struct libscols_table *tb, struct ul_buffer *buf)
 	size_t colsepsz;
 	int sorted = 0;
 
+	UL_TRACE_BEGIN("scols_calculate");
 	DBG(TAB, ul_debugobj(tb, "-----calculate-(termwidth=%zu)-----", tb->termwidth));
 	tb->is_dummy_print = 1;
 	colsepsz = scols_table_is_noencoding(tb) ?
@@ -621,5 +638,6 @@ done:
 	DBG(TAB, ul_debugobj(tb, "-----final width: %zu (rc=%d)-----", width, rc));
 	ON_DBG(TAB, dbg_columns(tb));
 
+	UL_TRACE_END("scols_calculate");
 	return rc;
 }
@@ -45,7 +45,8 @@ int scols_reset_cell(struct libscols_cell *ce)
 		return -EINVAL;
 
 	/*DBG(CELL, ul_debugobj(ce, "reset"));*/
-	free(ce->data);
+	if (!ce->static_data)
+		free(ce->data);
 	free(ce->color);
 	memset(ce, 0, sizeof(*ce));
 	return 0;
@@ -68,6 +69,11 @@ int scols_cell_set_data(struct libscols_cell *ce, const char *data)
 		return -EINVAL;
 
 	ce->is_filled = 1;
+	ce->has_width = 0;
+	if (ce->static_data) {
+		ce->data = NULL;
+		ce->static_data = 0;
+	}
 	rc = strdup_to_struct_member(ce, data, data);
 	ce->datasiz = ce->data && *ce->data ? strlen(ce->data) + 1: 0;
 	return rc;
@@ -89,13 +95,40 @@ int scols_cell_refer_data(struct libscols_cell *ce, char *data)
 {
 	if (!ce)
 		return -EINVAL;
-	free(ce->data);
+	if (!ce->static_data)
+		free(ce->data);
 	ce->data = data;
 	ce->datasiz = ce->data && *ce->data ? strlen(ce->data) + 1: 0;
 	ce->is_filled = 1;
+	ce->has_width = 0;
+	ce->static_data = 0;
 	return 0;
 }
 
+/**
+ * scols_cell_refer_static_data:
+ * @ce: a pointer to a struct libscols_cell instance
+ * @data: string (used for scols_print_table())
+ *
+ * Adds a reference to @data to @ce. Unlike scols_cell_refer_data(), the
+ * pointer is never deallocated by the library and the string must not be
+ * modified or deallocated as long as the cell uses it. This is designed for
+ * string literals and strings returned by scols_table_intern_string(); the
+ * data are not copied and no memory is allocated.
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: 2.41
+ */
+int scols_cell_refer_static_data(struct libscols_cell *ce, const char *data)
+{
+	int rc = scols_cell_refer_data(ce, (char *) data);
+
+	if (!rc)
+		ce->static_data = 1;
+	return rc;
+}
+
 /**
  * scols_cell_refer_memory:
  * @ce: a pointer to a struct libscols_cell instance
@@ -117,9 +150,12 @@ int scols_cell_refer_memory(struct libscols_cell *ce, char *data, size_t datasiz
 {
 	if (!ce)
 		return -EINVAL;
-	free(ce->data);
+	if (!ce->static_data)
+		free(ce->data);
 	ce->data = data;
 	ce->datasiz = datasiz;
+	ce->has_width = 0;
+	ce->static_data = 0;
 	return 0;
 }
 
@@ -11,6 +11,17 @@ struct filter_expr {
 
 	struct filter_node *left;
 	struct filter_node *right;
+
+	/* Compiled by the first evaluation, used for the next lines: data type
+	 * of the comparison and literals already converted to the type. */
+	int datatype;
+	unsigned int generation;
+	struct filter_param *left_const;
+	struct filter_param *right_const;
+
+	unsigned int compiled : 1,
+		     is_const : 1,		/* both sides are literals */
+		     const_status : 1;		/* result if is_const */
 };
 
 struct filter_node *filter_new_expr(
@@ -49,8 +60,18 @@ struct filter_node *filter_new_expr(
 	return (struct filter_node *) n;
 }
 
+static void reset_compiled_expr(struct filter_expr *n)
+{
+	filter_unref_node((struct filter_node *) n->left_const);
+	filter_unref_node((struct filter_node *) n->right_const);
+	n->left_const = n->right_const = NULL;
+	n->compiled = n->is_const = n->const_status = 0;
+	n->datatype = SCOLS_DATA_NONE;
+}
+
 void filter_free_expr(struct filter_expr *n)
 {
+	reset_compiled_expr(n);
 	filter_unref_node(n->left);
 	filter_unref_node(n->right);
 	free(n);
@@ -175,25 +196,93 @@ static int guess_expr_datatype(struct filter_expr *n)
 	return type;
 }
 
+static inline int is_literal_node(struct filter_node *n)
+{
+	return n && filter_node_get_type(n) == F_NODE_PARAM && !is_filter_holder_node(n);
+}
+
+/* returns 1 if the node does not need data from filler callback */
+static int is_node_ready(struct libscols_filter *fltr, struct libscols_line *ln,
+			 struct filter_node *n)
+{
+	struct filter_expr *e;
+
+	if (!n)
+		return 1;
+	if (filter_node_get_type(n) == F_NODE_PARAM)
+		return filter_param_is_ready(fltr, (struct filter_param *) n, ln);
+
+	e = (struct filter_expr *) n;
+	return is_node_ready(fltr, ln, e->left) && is_node_ready(fltr, ln, e->right);
+}
+
+/*
+ * The comparison data type depends on the literals and the holders types (which
+ * are stable for the given columns), so it's guessed only once and the literals
+ * are converted to the type only once.
+ */
+static int compile_expr(struct libscols_filter *fltr, struct libscols_line *ln,
+			struct filter_expr *n)
+{
+	int rc = 0;
+
+	if (n->compiled && n->generation == fltr->generation)
+		return 0;
+
+	reset_compiled_expr(n);
+	n->datatype = guess_expr_datatype(n);
+
+	if (is_literal_node(n->left))
+		rc = filter_cast_param(fltr, ln, n->datatype,
+				(struct filter_param *) n->left, &n->left_const);
+	if (!rc && is_literal_node(n->right))
+		rc = filter_cast_param(fltr, ln, n->datatype,
+				(struct filter_param *) n->right, &n->right_const);
+	if (rc)
+		return rc;
+
+	if (n->left_const && n->right_const) {
+		int status = 0;
+
+		/* constant expression, evaluate only once */
+		rc = filter_compare_params(fltr, n->type, n->left_const,
+				n->right_const, &status);
+		if (rc)
+			return rc;
+		n->is_const = 1;
+		n->const_status = status ? 1 : 0;
+	}
+
+	n->generation = fltr->generation;
+	n->compiled = 1;
+
+	DBG(FPARAM, ul_debugobj(n, " expr compiled [type=%d, const=%s]",
+				n->datatype, n->is_const ? "yes" : "no"));
+	return 0;
+}
+
 int filter_eval_expr(struct libscols_filter *fltr, struct libscols_line *ln,
 			struct filter_expr *n, int *status)
 {
 	int rc = 0;
 	struct filter_param *l = NULL, *r = NULL;
+	struct filter_node *first, *second;
 	enum filter_etype oper = n->type;
-	int type;
 
 	/* logical operators */
 	switch (oper) {
 	case F_EXPR_AND:
-		rc = filter_eval_node(fltr, ln, n->left, status);
-		if (rc == 0 && *status)
-			rc = filter_eval_node(fltr, ln, n->right, status);
-		return rc;
 	case F_EXPR_OR:
-		rc = filter_eval_node(fltr, ln, n->left, status);
-		if (rc == 0 && !*status)
-			rc = filter_eval_node(fltr, ln, n->right, status);
+		/* Evaluate first the side which does not need the filler
+		 * callback; the other side (and the callback) is not
+		 * necessary if the result is already known. */
+		first = n->left, second = n->right;
+		if (!is_node_ready(fltr, ln, first) && is_node_ready(fltr, ln, second))
+			first = n->right, second = n->left;
+
+		rc = filter_eval_node(fltr, ln, first, status);
+		if (rc == 0 && (oper == F_EXPR_AND ? *status : !*status))
+			rc = filter_eval_node(fltr, ln, second, status);
 		return rc;
 	case F_EXPR_NEG:
 		rc = filter_eval_node(fltr, ln, n->right, status);
@@ -204,12 +293,27 @@ int filter_eval_expr(struct libscols_filter *fltr, struct libscols_line *ln,
 		break;
 	}
 
-	type = guess_expr_datatype(n);
+	rc = compile_expr(fltr, ln, n);
+	if (rc)
+		return rc;
+	if (n->is_const) {
+		*status = n->const_status;
+		return 0;
+	}
 
 	/* compare data */
-	rc = cast_node(fltr, ln, type, n->left, &l);
-	if (!rc)
-		rc = cast_node(fltr, ln, type, n->right, &r);
+	if (n->left_const) {
+		l = n->left_const;
+		filter_ref_node((struct filter_node *) l);
+	} else
+		rc = cast_node(fltr, ln, n->datatype, n->left, &l);
+
+	if (!rc && n->right_const) {
+		r = n->right_const;
+		filter_ref_node((struct filter_node *) r);
+	} else if (!rc)
+		rc = cast_node(fltr, ln, n->datatype, n->right, &r);
+
 	if (!rc)
 		rc = filter_compare_params(fltr, oper, l, r, status);
 
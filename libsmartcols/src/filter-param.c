@@ -207,6 +207,15 @@ int is_filter_holder_node(struct filter_node *n)
                 && ((struct filter_param *)(n))->holder;
 }
 
+/* returns 1 if the data for the holder are available without filler callback */
+int filter_param_is_ready(struct libscols_filter *fltr, struct filter_param *n,
+			  struct libscols_line *ln)
+{
+	if (n->holder != F_HOLDER_COLUMN || n->fetched || !n->col || !fltr->filler_cb)
+		return 1;
+	return scols_line_is_filled(ln, n->col->seqnum);
+}
+
 void filter_dump_param(struct ul_jsonwrt *json, struct filter_param *n)
 {
 	ul_jsonwrt_object_open(json, "param");
@@ -847,6 +856,7 @@ int scols_filter_assign_column(struct libscols_filter *fltr,
 					scols_column_get_name(col)));
 		n->col = col;
 		scols_ref_column(col);
+		fltr->generation++;	/* the holder type may be different */
 	}
 
 	return n ? 0 : -EINVAL;
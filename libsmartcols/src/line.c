@@ -103,9 +103,42 @@ void scols_line_free_cells(struct libscols_line *ln)
 	for (i = 0; i < ln->ncells; i++)
 		scols_reset_cell(&ln->cells[i]);
 
-	free(ln->cells);
+	if (!ln->pooled_cells)
+		free(ln->cells);
 	ln->ncells = 0;
 	ln->cells = NULL;
+	ln->pooled_cells = 0;
+}
+
+/* move cells from the table cell pool to private memory */
+static int realloc_pooled_cells(struct libscols_line *ln, size_t n)
+{
+	struct libscols_cell *ce;
+	size_t i;
+
+	DBG(LINE, ul_debugobj(ln, "unpool %zu cells", n));
+
+	ce = calloc(n, sizeof(struct libscols_cell));
+	if (!ce)
+		return -errno;
+
+	for (i = n; i < ln->ncells; i++)
+		scols_reset_cell(&ln->cells[i]);
+
+	memcpy(ce, ln->cells, min(n, ln->ncells) * sizeof(struct libscols_cell));
+
+	ln->cells = ce;
+	ln->ncells = n;
+	ln->pooled_cells = 0;
+	return 0;
+}
+
+/* the line is going to be independent on the table cell pool */
+int scols_line_unpool_cells(struct libscols_line *ln)
+{
+	if (!ln || !ln->pooled_cells)
+		return 0;
+	return realloc_pooled_cells(ln, ln->ncells);
 }
 
 /**
@@ -134,6 +167,9 @@ int scols_line_alloc_cells(struct libscols_line *ln, size_t n)
 		return 0;
 	}
 
+	if (ln->pooled_cells)
+		return realloc_pooled_cells(ln, n);
+
 	DBG(LINE, ul_debugobj(ln, "alloc %zu cells", n));
 
 	ce = reallocarray(ln->cells, n, sizeof(struct libscols_cell));
@@ -504,6 +540,28 @@ int scols_line_refer_data(struct libscols_line *ln, size_t n, char *data)
 	return scols_cell_refer_data(ce, data);
 }
 
+/**
+ * scols_line_refer_static_data:
+ * @ln: a pointer to a struct libscols_line instance
+ * @n: number of the cell which will refer to @data
+ * @data: actual data to refer to
+ *
+ * See scols_cell_refer_static_data(), the @data are not copied and not
+ * deallocated.
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: 2.41
+ */
+int scols_line_refer_static_data(struct libscols_line *ln, size_t n, const char *data)
+{
+	struct libscols_cell *ce = scols_line_get_cell(ln, n);
+
+	if (!ce)
+		return -EINVAL;
+	return scols_cell_refer_static_data(ce, data);
+}
+
 /**
  * scols_line_is_filled:
  * @ln: a pointer to a struct libscols_line instance
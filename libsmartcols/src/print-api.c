@@ -98,6 +98,35 @@ int scols_table_print_range_to_string(
 }
 #endif
 
+/**
+ * scols_table_flush:
+ * @tb: table
+ *
+ * Prints and removes all lines in streaming mode (see
+ * scols_table_enable_streaming()). The output is not terminated, call
+ * scols_print_table() to finish the table. This can be used when the next
+ * line is not expected soon. The column widths are calculated by the first
+ * flush if not calculated yet.
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: 2.41
+ */
+int scols_table_flush(struct libscols_table *tb)
+{
+	int rc;
+
+	if (!tb)
+		return -EINVAL;
+	if (!tb->streaming)
+		return 0;
+
+	rc = __scols_stream_lines(tb, NULL);
+	if (!rc)
+		fflush(tb->out);
+	return rc;
+}
+
 static int do_print_table(struct libscols_table *tb, int *is_empty)
 {
 	int rc = 0;
@@ -114,6 +143,23 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 		DBG(TAB, ul_debugobj(tb, "error -- no columns"));
 		return -EINVAL;
 	}
+	if (tb->streaming && (tb->stream_started || !list_empty(&tb->tb_lines))) {
+		rc = __scols_stream_lines(tb, NULL);
+		if (rc == 0 && tb->stream_started) {
+			/* finish the table, it can be used for the next stream */
+			if (scols_table_is_json(tb)) {
+				ul_jsonwrt_array_close(&tb->json);
+				ul_jsonwrt_root_close(&tb->json);
+			} else if (scols_table_is_cbor(tb))
+				__scols_cbor_root_close(tb);
+			tb->stream_started = 0;
+			tb->stream_nlines = 0;
+			return 0;
+		}
+		if (rc)
+			return rc;
+	}
+
 	if (list_empty(&tb->tb_lines)) {
 		DBG(TAB, ul_debugobj(tb, "ignore -- no lines"));
 		if (scols_table_is_json(tb)) {
@@ -122,6 +168,10 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 			ul_jsonwrt_array_open(&tb->json, tb->name ? tb->name : "");
 			ul_jsonwrt_array_close(&tb->json);
 			ul_jsonwrt_root_close(&tb->json);
+		} else if (scols_table_is_cbor(tb)) {
+			ul_cborwrt_init(&tb->cbor, tb->out);
+			__scols_cbor_root_open(tb);
+			__scols_cbor_root_close(tb);
 		} else if (is_empty)
 			*is_empty = 1;
 		return 0;
@@ -135,7 +185,8 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 	if (scols_table_is_json(tb)) {
 		ul_jsonwrt_root_open(&tb->json);
 		ul_jsonwrt_array_open(&tb->json, tb->name ? tb->name : "");
-	}
+	} else if (scols_table_is_cbor(tb))
+		__scols_cbor_root_open(tb);
 
 	if (tb->format == SCOLS_FMT_HUMAN)
 		__scols_print_title(tb);
@@ -152,7 +203,8 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 	if (scols_table_is_json(tb)) {
 		ul_jsonwrt_array_close(&tb->json);
 		ul_jsonwrt_root_close(&tb->json);
-	}
+	} else if (scols_table_is_cbor(tb))
+		__scols_cbor_root_close(tb);
 done:
 	__scols_cleanup_printing(tb, &buf);
 	return rc;
@@ -168,11 +220,15 @@ done:
  */
 int scols_print_table(struct libscols_table *tb)
 {
-	int empty = 0;
-	int rc = do_print_table(tb, &empty);
+	int empty = 0, rc;
+
+	UL_TRACE_BEGIN("scols_print_table");
+	rc = do_print_table(tb, &empty);
 
-	if (rc == 0 && !empty && !scols_table_is_json(tb))
+	if (rc == 0 && !empty && !scols_table_is_json(tb)
+	    && !scols_table_is_cbor(tb))
 		fputc('\n', tb->out);
+	UL_TRACE_END("scols_print_table");
 	return rc;
 }
 
@@ -218,3 +274,77 @@ int scols_print_table_to_string(
 	return -ENOSYS;
 }
 #endif
+
+#ifdef HAVE_FOPENCOOKIE
+struct print_callback {
+	ssize_t (*writefn)(void *, const char *, size_t);
+	void *data;
+};
+
+static ssize_t print_callback_write(void *cookie, const char *buf, size_t sz)
+{
+	struct print_callback *cb = (struct print_callback *) cookie;
+	size_t done = 0;
+
+	while (done < sz) {
+		ssize_t rc = cb->writefn(cb->data, buf + done, sz - done);
+
+		if (rc <= 0)
+			return done ? (ssize_t) done : -1;
+		done += rc;
+	}
+	return done;
+}
+
+/**
+ * scols_print_table_to_callback:
+ * @tb: table
+ * @writefn: function to write output
+ * @data: private data for @writefn
+ *
+ * Prints the table by @writefn rather than to the stream. The output is
+ * accumulated and @writefn is called for large blocks of the data (usually
+ * many lines together), so it's cheaper than a custom FILE stream with small
+ * buffer. The @writefn has to return number of written bytes or -1 on error.
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: 2.41
+ */
+int scols_print_table_to_callback(struct libscols_table *tb,
+			ssize_t (*writefn)(void *data, const char *buf, size_t sz),
+			void *data)
+{
+	struct print_callback cb = { .writefn = writefn, .data = data };
+	cookie_io_functions_t io = { .write = print_callback_write };
+	FILE *stream, *old_stream;
+	int rc;
+
+	if (!tb || !writefn)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "printing to callback"));
+
+	stream = fopencookie(&cb, "w", io);
+	if (!stream)
+		return -ENOMEM;
+	setvbuf(stream, NULL, _IOFBF, SCOLS_OUTPUT_BUFSIZ);
+
+	old_stream = scols_table_get_stream(tb);
+	scols_table_set_stream(tb, stream);
+	rc = scols_print_table(tb);
+	if (fclose(stream) != 0 && !rc)
+		rc = -EIO;
+	scols_table_set_stream(tb, old_stream);
+
+	return rc;
+}
+#else
+int scols_print_table_to_callback(
+		struct libscols_table *tb __attribute__((__unused__)),
+		ssize_t (*writefn)(void *, const char *, size_t) __attribute__((__unused__)),
+		void *data __attribute__((__unused__)))
+{
+	return -ENOSYS;
+}
+#endif
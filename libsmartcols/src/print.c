@@ -47,6 +47,25 @@
 #define cellpadding_symbol(tb)  ((tb)->padding_debug ? "." : \
 				 ((tb)->symbols->cell_padding ? (tb)->symbols->cell_padding: " "))
 
+/* prints @n padding symbols, blanks are written by blocks */
+static void fputs_cellpadding(struct libscols_table *tb, size_t n)
+{
+	static const char blanks[] = "                                ";
+	const char *sym = cellpadding_symbol(tb);
+
+	if (sym[0] == ' ' && sym[1] == '\0') {
+		while (n > 0) {
+			size_t sz = min(n, sizeof(blanks) - 1);
+
+			fwrite(blanks, 1, sz, tb->out);
+			n -= sz;
+		}
+		return;
+	}
+	while (n-- > 0)
+		fputs(sym, tb->out);
+}
+
 #define want_repeat_header(tb)	(!(tb)->header_repeat || (tb)->header_next <= (tb)->termlines_used)
 
 static int is_next_columns_empty(
@@ -113,6 +132,36 @@ static int tree_ascii_art_to_buffer(struct libscols_table *tb,
 	return ul_buffer_append_string(buf, art);
 }
 
+/*
+ * Appends tree ascii-art for children of @parent. The art is cached for the
+ * last used parent, siblings and descendants (the next level is added to the
+ * cached art) do not walk the parents chain again.
+ */
+static int tree_prefix_to_buffer(struct libscols_table *tb,
+				 struct libscols_line *parent,
+				 struct ul_buffer *buf)
+{
+	struct ul_buffer *art = &tb->treeart;
+	int rc = 0;
+
+	if (tb->treeart_line != parent) {
+		if (tb->treeart_line && parent->parent == tb->treeart_line)
+			rc = ul_buffer_append_string(art, is_last_child(parent) ?
+						"  " : vertical_symbol(tb));
+		else {
+			ul_buffer_reset_data(art);
+			rc = tree_ascii_art_to_buffer(tb, parent, art);
+		}
+		tb->treeart_line = rc ? NULL : parent;
+		if (rc)
+			return rc;
+	}
+
+	if (ul_buffer_is_empty(art))
+		return 0;
+	return ul_buffer_append_string(buf, ul_buffer_get_data(art, NULL, NULL));
+}
+
 static int grpset_is_empty(	struct libscols_table *tb,
 				size_t idx,
 				size_t *rest)
@@ -326,8 +375,11 @@ static void print_empty_cell(struct libscols_table *tb,
 		struct ul_buffer art = UL_INIT_BUFFER;
 		char *data;
 
-		if (ul_buffer_alloc_data(&art, bufsz) != 0)
+		ul_buffer_pool_get(&tb->bufpool, &art);
+		if (ul_buffer_alloc_data(&art, bufsz) != 0) {
+			ul_buffer_pool_put(&tb->bufpool, &art);
 			goto done;
+		}
 
 		if (cl->is_groups)
 			groups_ascii_art_to_buffer(tb, ln, &art, 1);
@@ -344,7 +396,7 @@ static void print_empty_cell(struct libscols_table *tb,
 
 		if (data && len_pad)
 			fputs(data, tb->out);
-		ul_buffer_free_data(&art);
+		ul_buffer_pool_put(&tb->bufpool, &art);
 	}
 
 done:
@@ -361,8 +413,8 @@ done:
 	}
 
 	/* fill rest of cell with space */
-	for(; len_pad < cl->width; ++len_pad)
-		fputs(cellpadding_symbol(tb), tb->out);
+	if (len_pad < cl->width)
+		fputs_cellpadding(tb, cl->width - len_pad);
 
 	fputs_color_cell_close(tb, cl, ln, ce);
 
@@ -414,7 +466,7 @@ static int print_pending_data(struct libscols_table *tb, struct ul_buffer *buf)
 	struct libscols_column *cl;
 	struct libscols_cell *ce;
 	char *data;
-	size_t i, width = 0, len = 0, bytes = 0;
+	size_t width = 0, len = 0, bytes = 0;
 
 	scols_table_get_cursor(tb, &ln, &cl, &ce);
 
@@ -459,8 +511,8 @@ static int print_pending_data(struct libscols_table *tb, struct ul_buffer *buf)
 	}
 
 	/* fill rest of cell with space */
-	for(i = len; i < width; i++)
-		fputs(cellpadding_symbol(tb), tb->out);
+	if (len < width)
+		fputs_cellpadding(tb, width - len);
 
 	fputs_color_cell_close(tb, cl, ln, ce);
 
@@ -530,12 +582,60 @@ static void print_json_data(struct libscols_table *tb,
 	}
 }
 
+static void print_cbor_data(struct libscols_table *tb,
+			    struct libscols_column *cl,
+			    char *data)
+{
+	switch (cl->json_type) {
+	case SCOLS_JSON_STRING:
+		ul_cborwrt_value_s(&tb->cbor, data);
+		break;
+	case SCOLS_JSON_NUMBER:
+	case SCOLS_JSON_FLOAT:
+		ul_cborwrt_value_number(&tb->cbor, data);
+		break;
+	case SCOLS_JSON_BOOLEAN:
+	case SCOLS_JSON_BOOLEAN_OPTIONAL:
+		if (cl->json_type == SCOLS_JSON_BOOLEAN_OPTIONAL && (!*data || !strcmp(data, "-"))) {
+			ul_cborwrt_value_null(&tb->cbor);
+		} else {
+			ul_cborwrt_value_boolean(&tb->cbor,
+					!*data ? 0 :
+					*data == '0' ? 0 :
+					*data == 'N' || *data == 'n' ? 0 : 1);
+		}
+		break;
+	case SCOLS_JSON_ARRAY_STRING:
+	case SCOLS_JSON_ARRAY_NUMBER:
+		/* the number of items is unknown for multi-line cells */
+		if (!scols_column_is_customwrap(cl)) {
+			if (data && *data) {
+				ul_cborwrt_array_open(&tb->cbor, 1);
+				ul_cborwrt_value_s(&tb->cbor, data);
+			} else
+				ul_cborwrt_array_open(&tb->cbor, 0);
+			break;
+		}
+		ul_cborwrt_array_open_indef(&tb->cbor);
+		do {
+			if (!data || !*data)
+				continue;
+			if (cl->json_type == SCOLS_JSON_ARRAY_STRING)
+				ul_cborwrt_value_s(&tb->cbor, data);
+			else
+				ul_cborwrt_value_number(&tb->cbor, data);
+		} while (scols_column_next_wrap(cl, NULL, &data) == 0);
+		ul_cborwrt_break(&tb->cbor);
+		break;
+	}
+}
+
 static int print_data(struct libscols_table *tb, struct ul_buffer *buf)
 {
 	struct libscols_line *ln;	/* NULL for header line! */
 	struct libscols_column *cl;
 	struct libscols_cell *ce;
-	size_t len = 0, i, width, bytes;
+	size_t len = 0, width, bytes;
 	char *data = NULL;
 	const char *name = NULL;
 	int is_last;
@@ -581,13 +681,23 @@ static int print_data(struct libscols_table *tb, struct ul_buffer *buf)
 		print_json_data(tb, cl, name, data);
 		return 0;
 
+	case SCOLS_FMT_CBOR:
+		print_cbor_data(tb, cl, data);
+		return 0;
+
 	case SCOLS_FMT_HUMAN:
 		break;		/* continue below */
 	}
 
 	/* Encode. Note that 'len' and 'width' are number of glyphs not bytes.
+	 * Plain ASCII cells (see count_cell_width()) don't need any conversion.
 	 */
-	if (scols_table_is_noencoding(tb))
+	if (ce && ce->has_width && ce->is_ascii
+	    && !scols_column_is_wrap(cl)
+	    && !scols_column_is_customwrap(cl)) {
+		data = ul_buffer_get_data(buf, NULL, NULL);
+		len = bytes = ce->width;
+	} else if (scols_table_is_noencoding(tb))
 		data = ul_buffer_get_data(buf, &bytes, &len);
 	else
 		data = ul_buffer_get_safe_data(buf, &bytes, &len, scols_column_get_safechars(cl));
@@ -628,8 +738,8 @@ static int print_data(struct libscols_table *tb, struct ul_buffer *buf)
 
 	if (data && *data) {
 		if (scols_column_is_right(cl)) {
-			for (i = len; i < width; i++)
-				fputs(cellpadding_symbol(tb), tb->out);
+			if (len < width)
+				fputs_cellpadding(tb, width - len);
 			len = width;
 		}
 		fputs(data, tb->out);
@@ -648,8 +758,8 @@ static int print_data(struct libscols_table *tb, struct ul_buffer *buf)
 	}
 
 	/* fill rest of cell with space */
-	for(i = len; i < width; i++)
-		fputs(cellpadding_symbol(tb), tb->out);
+	if (len < width)
+		fputs_cellpadding(tb, width - len);
 
 	fputs_color_cell_close(tb, cl, ln, ce);
 
@@ -663,6 +773,12 @@ static int print_data(struct libscols_table *tb, struct ul_buffer *buf)
 	return 0;
 }
 
+/* JSON and CBOR describe the tree by nested arrays rather than ascii art */
+static inline int is_structured(struct libscols_table *tb)
+{
+	return scols_table_is_json(tb) || scols_table_is_cbor(tb);
+}
+
 /*
  * Copy current cell data to buffer. The @cal means "calculation" phase.
  */
@@ -694,14 +810,14 @@ int __cursor_to_buffer(struct libscols_table *tb,
 	/*
 	 * Group stuff
 	 */
-	if (!scols_table_is_json(tb) && cl->is_groups)
+	if (!is_structured(tb) && cl->is_groups)
 		rc = groups_ascii_art_to_buffer(tb, ln, buf, 0);
 
 	/*
 	 * Tree stuff
 	 */
-	if (!rc && ln->parent && !scols_table_is_json(tb)) {
-		rc = tree_ascii_art_to_buffer(tb, ln->parent, buf);
+	if (!rc && ln->parent && !is_structured(tb)) {
+		rc = tree_prefix_to_buffer(tb, ln->parent, buf);
 
 		if (!rc && is_last_child(ln))
 			rc = ul_buffer_append_string(buf, right_symbol(tb));
@@ -709,7 +825,7 @@ int __cursor_to_buffer(struct libscols_table *tb,
 			rc = ul_buffer_append_string(buf, branch_symbol(tb));
 	}
 
-	if (!rc && (ln->parent || cl->is_groups) && !scols_table_is_json(tb))
+	if (!rc && (ln->parent || cl->is_groups) && !is_structured(tb))
 		ul_buffer_save_pointer(buf, SCOLS_BUFPTR_TREEEND);
 notree:
 	if (!rc && ce) {
@@ -721,6 +837,13 @@ notree:
 				tb->format == SCOLS_FMT_EXPORT))
 			do_wrap = 0;
 
+		/* CBOR lines are fixed-size arrays, keep only arrays wrapping */
+		if (do_wrap && tb->format == SCOLS_FMT_CBOR
+		    && !(scols_column_is_customwrap(cl)
+			 && (cl->json_type == SCOLS_JSON_ARRAY_STRING ||
+			     cl->json_type == SCOLS_JSON_ARRAY_NUMBER)))
+			do_wrap = 0;
+
 		/* Wrapping enabled; append the next chunk if cell data */
 		if (do_wrap) {
 			char *x = NULL;
@@ -974,6 +1097,7 @@ int __scols_print_header(struct libscols_table *tb, struct ul_buffer *buf)
 	    scols_table_is_noheadings(tb) ||
 	    scols_table_is_export(tb) ||
 	    scols_table_is_json(tb) ||
+	    scols_table_is_cbor(tb) ||
 	    list_empty(&tb->tb_lines))
 		return 0;
 
@@ -1021,6 +1145,66 @@ int __scols_print_header(struct libscols_table *tb, struct ul_buffer *buf)
 }
 
 
+/*
+ * The CBOR line is array of the visible cells, the children array (if any)
+ * is the last item.
+ */
+static void cbor_line_open(struct libscols_table *tb, struct libscols_line *ln)
+{
+	size_t n = scols_table_is_tree(tb) && has_children(ln) ? 1 : 0;
+	struct libscols_column *cl;
+	struct libscols_iter itr;
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_column(tb, &itr, &cl) == 0) {
+		if (!scols_column_is_hidden(cl))
+			n++;
+	}
+	ul_cborwrt_array_open(&tb->cbor, n);
+}
+
+/*
+ * CBOR root is map with the column names (schema) and lines:
+ *
+ *	{ "columns": [ "NAME", ... ], "<tablename>": [_ [ <cell>, ... ], ... ] }
+ *
+ * The lines array uses indefinite length, it allows to stream the lines.
+ */
+void __scols_cbor_root_open(struct libscols_table *tb)
+{
+	struct libscols_column *cl;
+	struct libscols_iter itr;
+	size_t n = 0;
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_column(tb, &itr, &cl) == 0) {
+		if (!scols_column_is_hidden(cl))
+			n++;
+	}
+
+	ul_cborwrt_map_open(&tb->cbor, 2);
+	ul_cborwrt_value_s(&tb->cbor, "columns");
+	ul_cborwrt_array_open(&tb->cbor, n);
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_column(tb, &itr, &cl) == 0) {
+		const char *name;
+
+		if (scols_column_is_hidden(cl))
+			continue;
+		name = scols_column_get_name(cl);
+		ul_cborwrt_text(&tb->cbor, name, name ? strlen(name) : 0);
+	}
+
+	ul_cborwrt_text(&tb->cbor, tb->name, tb->name ? strlen(tb->name) : 0);
+	ul_cborwrt_array_open_indef(&tb->cbor);
+}
+
+void __scols_cbor_root_close(struct libscols_table *tb)
+{
+	ul_cborwrt_break(&tb->cbor);
+}
+
 int __scols_print_range(struct libscols_table *tb,
 			struct ul_buffer *buf,
 			struct libscols_iter *itr,
@@ -1038,12 +1222,15 @@ int __scols_print_range(struct libscols_table *tb,
 
 		if (scols_table_is_json(tb))
 			ul_jsonwrt_object_open(&tb->json, NULL);
+		else if (scols_table_is_cbor(tb))
+			cbor_line_open(tb, ln);
 
 		rc = print_line(tb, ln, buf);
 
 		if (scols_table_is_json(tb))
 			ul_jsonwrt_object_close(&tb->json);
-		else if (last == 0 && tb->no_linesep == 0) {
+		else if (!scols_table_is_cbor(tb)
+			 && last == 0 && tb->no_linesep == 0) {
 			fputs(linesep(tb), tb->out);
 			tb->termlines_used++;
 		}
@@ -1080,6 +1267,8 @@ static int print_tree_line(struct libscols_table *tb,
 
 	if (scols_table_is_json(tb))
 		ul_jsonwrt_object_open(&tb->json, NULL);
+	else if (scols_table_is_cbor(tb))
+		cbor_line_open(tb, ln);
 
 	rc = print_line(tb, ln, buf);
 	if (rc)
@@ -1088,6 +1277,8 @@ static int print_tree_line(struct libscols_table *tb,
 	if (has_children(ln)) {
 		if (scols_table_is_json(tb))
 			ul_jsonwrt_array_open(&tb->json, "children");
+		else if (scols_table_is_cbor(tb))
+			ul_cborwrt_array_open_indef(&tb->cbor);
 		else {
 			/* between parent and child is separator */
 			fputs(linesep(tb), tb->out);
@@ -1108,6 +1299,17 @@ static int print_tree_line(struct libscols_table *tb,
 				ln = ln->parent;
 			} while(ln && last);
 
+		} else if (scols_table_is_cbor(tb)) {
+			/* terminate all open children arrays */
+			do {
+				last = (is_child(ln) && is_last_child(ln)) ||
+				       (is_tree_root(ln) && is_last_tree_root(tb, ln));
+
+				if (last && is_child(ln))
+					ul_cborwrt_break(&tb->cbor);
+				ln = ln->parent;
+			} while(ln && last);
+
 		} else if (tb->no_linesep == 0) {
 			int last_in_tree = scols_walk_is_last(tb, ln);
 
@@ -1130,6 +1332,85 @@ int __scols_print_tree(struct libscols_table *tb, struct ul_buffer *buf)
 	return scols_walk_tree(tb, NULL, print_tree_line, (void *) buf);
 }
 
+static inline int is_streamable(struct libscols_table *tb)
+{
+	return tb->streaming && !scols_table_is_tree(tb) && !has_groups(tb);
+}
+
+/*
+ * Streaming mode -- prints and removes all lines, except @keep (the line
+ * which is still not complete). The column widths are calculated only
+ * once, for the first printed lines.
+ */
+int __scols_stream_lines(struct libscols_table *tb, struct libscols_line *keep)
+{
+	struct ul_buffer buf = UL_INIT_BUFFER;
+	struct libscols_line *ln;
+	int rc;
+
+	assert(tb);
+
+	if (!is_streamable(tb))
+		return 0;
+	if (list_empty(&tb->tb_lines) ||
+	    (keep && tb->tb_lines.next == &keep->ln_lines))
+		return 0;
+
+	DBG(TAB, ul_debugobj(tb, "streaming lines [printed=%zu]", tb->stream_nlines));
+
+	if (!tb->stream_started)
+		tb->header_printed = 0;
+
+	rc = __scols_initialize_printing(tb, &buf);
+	if (rc)
+		return rc;
+
+	if (!tb->stream_started) {
+		if (scols_table_is_json(tb)) {
+			ul_jsonwrt_root_open(&tb->json);
+			ul_jsonwrt_array_open(&tb->json, tb->name ? tb->name : "");
+		} else if (scols_table_is_cbor(tb))
+			__scols_cbor_root_open(tb);
+		if (tb->format == SCOLS_FMT_HUMAN)
+			__scols_print_title(tb);
+
+		rc = __scols_print_header(tb, &buf);
+		if (rc)
+			goto done;
+		tb->stream_started = 1;
+	}
+
+	while (rc == 0 && !list_empty(&tb->tb_lines)) {
+		ln = list_entry(tb->tb_lines.next, struct libscols_line, ln_lines);
+		if (ln == keep)
+			break;
+
+		if (scols_table_is_json(tb))
+			ul_jsonwrt_object_open(&tb->json, NULL);
+		else if (scols_table_is_cbor(tb))
+			cbor_line_open(tb, ln);
+		else if (tb->stream_nlines && tb->no_linesep == 0) {
+			/* terminate previous line */
+			fputs(linesep(tb), tb->out);
+			tb->termlines_used++;
+
+			if (want_repeat_header(tb))
+				__scols_print_header(tb, &buf);
+		}
+
+		rc = print_line(tb, ln, &buf);
+
+		if (scols_table_is_json(tb))
+			ul_jsonwrt_object_close(&tb->json);
+
+		tb->stream_nlines++;
+		scols_table_remove_line(tb, ln);
+	}
+done:
+	__scols_cleanup_printing(tb, &buf);
+	return rc;
+}
+
 static size_t strlen_line(struct libscols_line *ln)
 {
 	size_t i, sz = 0;
@@ -1151,7 +1432,11 @@ void __scols_cleanup_printing(struct libscols_table *tb, struct ul_buffer *buf)
 	if (!tb)
 		return;
 
-	ul_buffer_free_data(buf);
+	/* keep the allocations for the next print */
+	ul_buffer_pool_put(&tb->bufpool, buf);
+
+	ul_buffer_pool_put(&tb->bufpool, &tb->treeart);
+	tb->treeart_line = NULL;
 
 	if (tb->priv_symbols) {
 		scols_table_set_symbols(tb, NULL);
@@ -1168,6 +1453,12 @@ int __scols_initialize_printing(struct libscols_table *tb, struct ul_buffer *buf
 
 	DBG(TAB, ul_debugobj(tb, "initialize printing"));
 
+	/* the tree could be modified since the last print */
+	ul_buffer_reset_data(&tb->treeart);
+	tb->treeart_line = NULL;
+	if (scols_table_is_tree(tb))
+		ul_buffer_pool_get(&tb->bufpool, &tb->treeart);
+
 	if (!tb->symbols) {
 		rc = scols_table_set_default_symbols(tb);
 		if (rc)
@@ -1207,9 +1498,14 @@ int __scols_initialize_printing(struct libscols_table *tb, struct ul_buffer *buf
 		extra_bufsz += tb->ncols;			/* separator between columns */
 		break;
 	case SCOLS_FMT_JSON:
-		ul_jsonwrt_init(&tb->json, tb->out, 0);
+		if (!tb->stream_started)
+			ul_jsonwrt_init(&tb->json, tb->out, 0);
 		extra_bufsz += tb->nlines * 3;		/* indentation */
 		/* fallthrough */
+	case SCOLS_FMT_CBOR:
+		if (!tb->stream_started)
+			ul_cborwrt_init(&tb->cbor, tb->out);
+		/* fallthrough */
 	case SCOLS_FMT_EXPORT:
 	{
 		struct libscols_column *cl;
@@ -1244,6 +1540,7 @@ int __scols_initialize_printing(struct libscols_table *tb, struct ul_buffer *buf
 	}
 
 	/* pre-allocate space for data */
+	ul_buffer_pool_get(&tb->bufpool, buf);
 	rc = ul_buffer_alloc_data(buf, bufsz + 1);	/* data + space for \0 */
 	if (rc)
 		goto err;
@@ -1254,7 +1551,8 @@ int __scols_initialize_printing(struct libscols_table *tb, struct ul_buffer *buf
 	if (has_groups(tb) && scols_table_is_tree(tb))
 		scols_groups_fix_members_order(tb);
 
-	if (tb->format == SCOLS_FMT_HUMAN) {
+	/* streaming mode keeps widths from the first printed lines */
+	if (tb->format == SCOLS_FMT_HUMAN && !tb->stream_started) {
 		rc = __scols_calculate(tb, buf);
 		if (rc != 0)
 			goto err;
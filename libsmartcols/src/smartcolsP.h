@@ -16,7 +16,9 @@
 #include "strutils.h"
 #include "color-names.h"
 #include "jsonwrt.h"
+#include "cborwrt.h"
 #include "debug.h"
+#include "ultrace.h"
 #include "buffer.h"
 
 #include <stdbool.h>
@@ -88,12 +90,17 @@ struct libscols_cell {
 	char	*color;
 	void    *userdata;
 	int	flags;
-	size_t	width;
+	size_t	width;		/* cached by __scols_calculate() */
 
-	unsigned int is_filled : 1;
+	unsigned int is_filled : 1,
+		     has_width : 1,		/* @width is valid */
+		     width_noencoding : 1,	/* @width counted without encoding */
+		     is_ascii : 1,		/* printable ASCII only (valid with @has_width) */
+		     static_data : 1;		/* @data is not owned by the cell */
 };
 
 extern int scols_line_move_cells(struct libscols_line *ln, size_t newn, size_t oldn);
+extern int scols_line_unpool_cells(struct libscols_line *ln);
 
 struct libscols_wstat {
 	size_t	width_min;
@@ -102,6 +109,10 @@ struct libscols_wstat {
 	double  width_sqr_sum;
 	double  width_deviation;
 
+	size_t	ncells;		/* number of counted cells */
+	size_t	width_sum;	/* sum of the cells widths */
+	double	width_sq_sum;	/* sum of the squares of the cells widths */
+
 	size_t  width_treeart;
 };
 
@@ -176,6 +187,38 @@ enum {
  */
 #define SCOLS_GRPSET_CHUNKSIZ	3
 
+/*
+ * Memory chunk for interned strings, see scols_table_intern_string()
+ */
+struct libscols_strchunk {
+	struct libscols_strchunk *next;
+	size_t	size;		/* size of data[] */
+	size_t	used;		/* used bytes in data[] */
+	char	data[];
+};
+
+#define SCOLS_STRCHUNK_SIZE	(16 * 1024)
+
+/*
+ * Memory chunk for line cells. The cells of the lines added to the table are
+ * allocated one line after another, so the cells of one column are accessible
+ * with a constant stride rather than by random pointers.
+ */
+struct libscols_cellchunk {
+	struct libscols_cellchunk *next;
+	size_t	size;		/* number of cells[] */
+	size_t	used;		/* used cells[] */
+	struct libscols_cell cells[];
+};
+
+#define SCOLS_CELLCHUNK_LINES	256
+
+/* default number of lines used to calculate widths in streaming mode */
+#define SCOLS_STREAM_SAMPLE	128
+
+/* output buffer size for scols_print_table_to_callback() */
+#define SCOLS_OUTPUT_BUFSIZ	(64 * 1024)
+
 struct libscols_group {
 	int     refcount;
 
@@ -209,13 +252,16 @@ struct libscols_line {
 	struct libscols_line	*parent;
 	struct libscols_group	*parent_group;	/* for group childs */
 	struct libscols_group	*group;		/* for group members */
+
+	unsigned int	pooled_cells : 1;	/* @cells allocated in table->cellchunks */
 };
 
 enum {
 	SCOLS_FMT_HUMAN = 0,		/* default, human readable */
 	SCOLS_FMT_RAW,			/* space separated */
 	SCOLS_FMT_EXPORT,		/* COLNAME="data" ... */
-	SCOLS_FMT_JSON			/* http://en.wikipedia.org/wiki/JSON */
+	SCOLS_FMT_JSON,			/* http://en.wikipedia.org/wiki/JSON */
+	SCOLS_FMT_CBOR			/* RFC 8949 binary */
 };
 
 /*
@@ -251,13 +297,25 @@ struct libscols_table {
 	struct libscols_symbols	*symbols;
 	struct libscols_cell	title;		/* optional table title (for humans) */
 
+	void			*strpool;	/* tsearch() tree with interned strings */
+	struct libscols_strchunk *strchunks;	/* memory for interned strings */
+	struct libscols_cellchunk *cellchunks;	/* memory for line cells */
+
+	struct ul_buffer	treeart;	/* cached tree ascii-art for @treeart_line children */
+	struct libscols_line	*treeart_line;
+	struct ul_buffer_pool	bufpool;	/* print buffers kept for the next print */
+
 	struct ul_jsonwrt	json;		/* JSON formatting */
+	struct ul_cborwrt	cbor;		/* CBOR formatting */
 
 	int	format;		/* SCOLS_FMT_* */
 
 	size_t	termlines_used;	/* printed line counter */
 	size_t	header_next;	/* where repeat header */
 
+	size_t	stream_sample;	/* number of lines used to calculate widths */
+	size_t	stream_nlines;	/* number of already printed lines */
+
 	const char *cur_color;	/* current active color when printing */
 
 	struct libscols_cell *cur_cell;		/* currently used cell */
@@ -280,7 +338,9 @@ struct libscols_table {
 			no_headings	:1,	/* don't print header */
 			no_encode	:1,	/* don't care about control and non-printable chars */
 			no_linesep	:1,	/* don't print line separator */
-			no_wrap		:1;	/* never wrap lines */
+			no_wrap		:1,	/* never wrap lines */
+			streaming	:1,	/* print lines as they are added */
+			stream_started	:1;	/* widths calculated, header printed */
 };
 
 #define IS_ITER_FORWARD(_i)	((_i)->direction == SCOLS_ITER_FORWARD)
@@ -389,6 +449,9 @@ int __scols_print_range(struct libscols_table *tb,
                         struct ul_buffer *buf,
                         struct libscols_iter *itr,
                         struct libscols_line *end);
+int __scols_stream_lines(struct libscols_table *tb, struct libscols_line *keep);
+void __scols_cbor_root_open(struct libscols_table *tb);
+void __scols_cbor_root_close(struct libscols_table *tb);
 
 static inline int is_tree_root(struct libscols_line *ln)
 {
@@ -553,6 +616,8 @@ struct libscols_filter {
 
 	struct list_head params;
 	struct list_head counters;
+
+	unsigned int generation;	/* incremented when a column is (re)assigned */
 };
 
 struct filter_node *__filter_new_node(enum filter_ntype type, size_t sz);
@@ -586,6 +651,8 @@ int filter_cast_param(struct libscols_filter *fltr,
                       struct filter_param **result);
 
 int is_filter_holder_node(struct filter_node *n);
+int filter_param_is_ready(struct libscols_filter *fltr, struct filter_param *n,
+			struct libscols_line *ln);
 
 int filter_count_param(struct libscols_filter *fltr,
                 struct libscols_line *ln,
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <termios.h>
 #include <ctype.h>
+#include <search.h>
 
 #include "nls.h"
 #include "ttyutils.h"
@@ -76,6 +77,7 @@ struct libscols_table *scols_new_table(void)
 
 	tb->refcount = 1;
 	tb->out = stdout;
+	tb->stream_sample = SCOLS_STREAM_SAMPLE;
 
 	get_terminal_dimension(&c, &l);
 	tb->termwidth  = c > 0 ? c : 80;
@@ -114,6 +116,59 @@ static void scols_table_remove_groups(struct libscols_table *tb)
 	}
 }
 
+static void strpool_nofree(void *data __attribute__((__unused__)))
+{
+	/* strings are stored in tb->strchunks */
+}
+
+static void free_strpool(struct libscols_table *tb)
+{
+	if (tb->strpool)
+		tdestroy(tb->strpool, strpool_nofree);
+	tb->strpool = NULL;
+
+	while (tb->strchunks) {
+		struct libscols_strchunk *ch = tb->strchunks;
+
+		tb->strchunks = ch->next;
+		free(ch);
+	}
+}
+
+static void free_cellpool(struct libscols_table *tb)
+{
+	while (tb->cellchunks) {
+		struct libscols_cellchunk *ch = tb->cellchunks;
+
+		tb->cellchunks = ch->next;
+		free(ch);
+	}
+}
+
+/*
+ * Recycles the cell pool; it's possible only when the table has no lines, the
+ * lines removed from the table do not use the pool.
+ */
+static void reset_cellpool(struct libscols_table *tb)
+{
+	struct libscols_cellchunk *ch = tb->cellchunks;
+
+	if (!ch)
+		return;
+
+	DBG(TAB, ul_debugobj(tb, "reset cell pool"));
+
+	/* keep the last allocated chunk */
+	while (ch->next) {
+		struct libscols_cellchunk *x = ch->next;
+
+		ch->next = x->next;
+		free(x);
+	}
+	memset(ch->cells, 0, ch->used * sizeof(struct libscols_cell));
+	ch->used = 0;
+}
+
 /**
  * scols_unref_table:
  * @tb: a pointer to a struct libscols_table instance
@@ -130,6 +185,9 @@ void scols_unref_table(struct libscols_table *tb)
 		scols_table_remove_columns(tb);
 		scols_unref_symbols(tb->symbols);
 		scols_reset_cell(&tb->title);
+		free_strpool(tb);
+		free_cellpool(tb);
+		ul_buffer_pool_free(&tb->bufpool);
 		free(tb->grpset);
 		free(tb->linesep);
 		free(tb->colsep);
@@ -521,6 +579,89 @@ size_t scols_table_get_nlines(const struct libscols_table *tb)
 	return tb->nlines;
 }
 
+static int cmp_strpool(const void *a, const void *b)
+{
+	return strcmp((const char *) a, (const char *) b);
+}
+
+static char *strpool_alloc(struct libscols_table *tb, size_t sz)
+{
+	struct libscols_strchunk *ch = tb->strchunks;
+	char *p;
+
+	if (!ch || ch->size - ch->used < sz) {
+		size_t chsz = max((size_t) SCOLS_STRCHUNK_SIZE, sz);
+
+		ch = malloc(sizeof(*ch) + chsz);
+		if (!ch)
+			return NULL;
+		ch->size = chsz;
+		ch->used = 0;
+
+		/* keep the current chunk first if it has more free space */
+		if (tb->strchunks && tb->strchunks->size - tb->strchunks->used > chsz - sz) {
+			ch->next = tb->strchunks->next;
+			tb->strchunks->next = ch;
+		} else {
+			ch->next = tb->strchunks;
+			tb->strchunks = ch;
+		}
+	}
+
+	p = ch->data + ch->used;
+	ch->used += sz;
+	return p;
+}
+
+/**
+ * scols_table_intern_string:
+ * @tb: table
+ * @str: string
+ *
+ * Returns a copy of the @str owned by the table. All calls with the same
+ * string return the same pointer, and the strings are stored in large memory
+ * chunks rather than allocated one by one. The copy is deallocated together
+ * with the table.
+ *
+ * This is useful for columns with often repeated values (types, user names,
+ * modes, ...) together with scols_line_refer_static_data():
+ *
+ * <informalexample>
+ *   <programlisting>
+ *	scols_line_refer_static_data(ln, COL_TYPE,
+ *			scols_table_intern_string(tb, type));
+ *   </programlisting>
+ * </informalexample>
+ *
+ * Note that lines which refer to the interned strings must not be used after
+ * the table is deallocated.
+ *
+ * Returns: string or NULL in case of an error.
+ *
+ * Since: 2.41
+ */
+const char *scols_table_intern_string(struct libscols_table *tb, const char *str)
+{
+	char **res, *p;
+	size_t sz;
+
+	if (!tb || !str)
+		return NULL;
+
+	res = tfind(str, &tb->strpool, cmp_strpool);
+	if (res)
+		return *res;
+
+	sz = strlen(str) + 1;
+	p = strpool_alloc(tb, sz);
+	if (!p)
+		return NULL;
+	memcpy(p, str, sz);
+
+	res = tsearch(p, &tb->strpool, cmp_strpool);
+	return res ? *res : NULL;
+}
+
 
 int scols_table_set_cursor(struct libscols_table *tb,
 			   struct libscols_line *ln,
@@ -689,6 +830,28 @@ struct libscols_column *scols_table_get_column_by_name(
 }
 
 
+/* allocates @n zeroized cells from the table cell pool */
+static struct libscols_cell *cellpool_alloc(struct libscols_table *tb, size_t n)
+{
+	struct libscols_cellchunk *ch = tb->cellchunks;
+	struct libscols_cell *ce;
+
+	if (!ch || ch->size - ch->used < n) {
+		size_t chsz = n * SCOLS_CELLCHUNK_LINES;
+
+		ch = calloc(1, sizeof(*ch) + chsz * sizeof(struct libscols_cell));
+		if (!ch)
+			return NULL;
+		ch->size = chsz;
+		ch->next = tb->cellchunks;
+		tb->cellchunks = ch;
+	}
+
+	ce = ch->cells + ch->used;
+	ch->used += n;
+	return ce;
+}
+
 /**
  * scols_table_add_line:
  * @tb: table
@@ -697,6 +860,11 @@ struct libscols_column *scols_table_get_column_by_name(
  * Note that this function calls scols_line_alloc_cells() if number
  * of the cells in the line is too small for @tb.
  *
+ * If the line has no cells yet, the cells are allocated from a memory pool
+ * shared by all lines in the table, so the cells of the one column are stored
+ * close together. The cells are moved to private memory when the line
+ * is removed from the table or when the number of cells is changed.
+ *
  * Returns: 0, a negative value in case of an error.
  */
 int scols_table_add_line(struct libscols_table *tb, struct libscols_line *ln)
@@ -707,6 +875,15 @@ int scols_table_add_line(struct libscols_table *tb, struct libscols_line *ln)
 	if (!list_empty(&ln->ln_lines))
 		return -EINVAL;
 
+	/* don't use the pool in streaming mode, lines are freed after print */
+	if (!ln->cells && tb->ncols && !tb->streaming) {
+		ln->cells = cellpool_alloc(tb, tb->ncols);
+		if (ln->cells) {
+			ln->ncells = tb->ncols;
+			ln->pooled_cells = 1;
+		}
+	}
+
 	if (tb->ncols > ln->ncells) {
 		int rc = scols_line_alloc_cells(ln, tb->ncols);
 		if (rc)
@@ -717,6 +894,10 @@ int scols_table_add_line(struct libscols_table *tb, struct libscols_line *ln)
 	list_add_tail(&ln->ln_lines, &tb->tb_lines);
 	ln->seqnum = tb->nlines++;
 	scols_ref_line(ln);
+
+	/* streaming -- all lines before @ln are complete */
+	if (tb->streaming && (tb->stream_started || tb->nlines > tb->stream_sample))
+		return __scols_stream_lines(tb, ln);
 	return 0;
 }
 
@@ -736,10 +917,23 @@ int scols_table_remove_line(struct libscols_table *tb,
 	if (!tb || !ln)
 		return -EINVAL;
 
+	/* the line survives the table, cell pool is table specific */
+	if (ln->refcount > 1) {
+		int rc = scols_line_unpool_cells(ln);
+		if (rc)
+			return rc;
+	}
+
+	if (tb->treeart_line == ln)
+		tb->treeart_line = NULL;
+
 	DBG(TAB, ul_debugobj(tb, "remove line"));
 	list_del_init(&ln->ln_lines);
 	tb->nlines--;
 	scols_unref_line(ln);
+
+	if (!tb->nlines)
+		reset_cellpool(tb);
 	return 0;
 }
 
@@ -1066,6 +1260,80 @@ int scols_table_enable_nolinesep(struct libscols_table *tb, int enable)
 	return 0;
 }
 
+/**
+ * scols_table_enable_streaming:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enable/disable streaming mode. In this mode the lines are printed and
+ * removed from the table as soon as the next line is added by
+ * scols_table_add_line() or scols_table_new_line(); the last line is printed
+ * by scols_table_flush() or scols_print_table(). The table keeps only a few
+ * lines in memory and the output starts before all the lines are known.
+ *
+ * The column widths are calculated only once from the first lines (see
+ * scols_table_set_streaming_sample()) and the width hints, and they are not
+ * modified later. Data wider than the column are truncated for columns with
+ * SCOLS_FL_TRUNC, wrapped for columns with SCOLS_FL_WRAP, and otherwise the
+ * next column continues on the next output line.
+ *
+ * The streaming mode is ignored for trees and tables with groups, and it
+ * does not make sense together with sorting or other operations which
+ * depend on all lines. The printed lines are unreferenced by the table, so
+ * don't use scols_table_remove_line() for them.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.41
+ */
+int scols_table_enable_streaming(struct libscols_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "streaming: %s", enable ? "ENABLE" : "DISABLE"));
+	tb->streaming = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * scols_table_is_streaming:
+ * @tb: a pointer to a struct libscols_table instance
+ *
+ * Returns: 1 if streaming mode is enabled.
+ *
+ * Since: 2.41
+ */
+int scols_table_is_streaming(const struct libscols_table *tb)
+{
+	return tb->streaming;
+}
+
+/**
+ * scols_table_set_streaming_sample:
+ * @tb: table
+ * @nlines: number of lines
+ *
+ * Sets the number of lines buffered in streaming mode before the first line
+ * is printed; the column widths are calculated from these lines. The default
+ * is 128 lines. Use 0 to print the lines immediately, in this case the widths
+ * are calculated from the first line only, so define widths by
+ * scols_column_set_whint() and SCOLS_FL_STRICTWIDTH.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.41
+ */
+int scols_table_set_streaming_sample(struct libscols_table *tb, size_t nlines)
+{
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "streaming sample: %zu", nlines));
+	tb->stream_sample = nlines;
+	return 0;
+}
+
 /**
  * scols_table_is_nolinesep:
  * @tb: a pointer to a struct libscols_table instance
@@ -1146,6 +1414,37 @@ int scols_table_enable_json(struct libscols_table *tb, int enable)
 	return 0;
 }
 
+/**
+ * scols_table_enable_cbor:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enable/disable CBOR (RFC 8949) output format. The output is a map with
+ * "columns" (array of the column names) and the table name (array of the
+ * lines). Every line is an array of the cell values in the same order as
+ * "columns", for trees the line has an extra array with the child lines.
+ * The values are typed according to scols_column_set_json_type().
+ *
+ * The parsable output formats (export, raw, JSON, ...) are mutually
+ * exclusive.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.41
+ */
+int scols_table_enable_cbor(struct libscols_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "cbor: %s", enable ? "ENABLE" : "DISABLE"));
+	if (enable)
+		tb->format = SCOLS_FMT_CBOR;
+	else if (tb->format == SCOLS_FMT_CBOR)
+		tb->format = 0;
+	return 0;
+}
+
 /**
  * scols_table_enable_export:
  * @tb: table
@@ -1482,6 +1781,19 @@ int scols_table_is_json(const struct libscols_table *tb)
 	return tb->format == SCOLS_FMT_JSON;
 }
 
+/**
+ * scols_table_is_cbor:
+ * @tb: table
+ *
+ * Returns: 1 if CBOR output format is enabled.
+ *
+ * Since: 2.41
+ */
+int scols_table_is_cbor(const struct libscols_table *tb)
+{
+	return tb->format == SCOLS_FMT_CBOR;
+}
+
 /**
  * scols_table_is_maxout
  * @tb: table
@@ -1605,9 +1917,219 @@ static int cells_cmp_wrapper_children(struct list_head *a, struct list_head *b,
 }
 
 
+/*
+ * Sort keys are extracted only once for each line, so the comparison is
+ * cheap. It's used for the default scols_cmpstr_cells() and for columns
+ * with data type but without cmpfunc.
+ */
+struct sort_key {
+	struct libscols_line	*ln;
+	size_t			seq;		/* original order, keep sort stable */
+	union {
+		uint64_t	num;
+		long double	fnum;
+		char		*str;		/* strxfrm() result */
+	} val;
+	unsigned int		empty : 1;
+};
+
+static int get_sort_key_type(const struct libscols_column *cl)
+{
+	if (cl->cmpfunc == scols_cmpstr_cells)
+		return SCOLS_DATA_STRING;
+	if (cl->cmpfunc)
+		return SCOLS_DATA_NONE;
+
+	switch (cl->data_type) {
+	case SCOLS_DATA_U64:
+	case SCOLS_DATA_FLOAT:
+	case SCOLS_DATA_BOOLEAN:
+	case SCOLS_DATA_STRING:
+		return cl->data_type;
+	}
+	return SCOLS_DATA_NONE;
+}
+
+static inline int is_sortable_column(const struct libscols_column *cl)
+{
+	return cl->cmpfunc || get_sort_key_type(cl) != SCOLS_DATA_NONE;
+}
+
+static int fill_sort_key(struct libscols_column *cl, int type,
+			 struct libscols_line *ln, struct sort_key *key)
+{
+	struct libscols_cell *ce = scols_line_get_cell(ln, cl->seqnum);
+	const void *data = NULL;
+	int is_string = 1;
+
+	if (ce && !cl->cmpfunc && scols_column_has_data_func(cl)) {
+		data = cl->datafunc(cl, ce, cl->datafunc_data);
+		is_string = type == SCOLS_DATA_STRING;
+	} else if (ce)
+		data = scols_cell_get_data(ce);
+
+	key->ln = ln;
+	key->empty = data == NULL;
+	if (!data)
+		return 0;
+
+	switch (type) {
+	case SCOLS_DATA_STRING:
+	{
+		size_t sz = strxfrm(NULL, (const char *) data, 0) + 1;
+
+		key->val.str = malloc(sz);
+		if (!key->val.str)
+			return -ENOMEM;
+		strxfrm(key->val.str, (const char *) data, sz);
+		break;
+	}
+	case SCOLS_DATA_U64:
+		if (!is_string)
+			key->val.num = *((const uint64_t *) data);
+		else if (ul_strtou64((const char *) data, &key->val.num, 10) != 0)
+			key->empty = 1;
+		break;
+	case SCOLS_DATA_FLOAT:
+		if (!is_string)
+			key->val.fnum = *((const long double *) data);
+		else {
+			char *end = NULL;
+
+			errno = 0;
+			key->val.fnum = strtold((const char *) data, &end);
+			if (errno || end == data)
+				key->empty = 1;
+		}
+		break;
+	case SCOLS_DATA_BOOLEAN:
+		if (!is_string)
+			key->val.num = *((const bool *) data) ? 1 : 0;
+		else {
+			const char *str = data;
+
+			key->val.num = *str && strcmp(str, "0") != 0
+					    && strcasecmp(str, "false") != 0;
+		}
+		break;
+	}
+	return 0;
+}
+
+/* empty keys first; returns 1 if @rc is final */
+static inline int cmp_sort_keys_empty(const struct sort_key *a,
+				      const struct sort_key *b, int *rc)
+{
+	if (!a->empty && !b->empty)
+		return 0;
+	*rc = a->empty && b->empty ? cmp_numbers(a->seq, b->seq) :
+	      a->empty ? -1 : 1;
+	return 1;
+}
+
+static int cmp_sort_keys_str(const void *x, const void *y)
+{
+	const struct sort_key *a = x, *b = y;
+	int rc;
+
+	if (cmp_sort_keys_empty(a, b, &rc))
+		return rc;
+	rc = strcmp(a->val.str, b->val.str);
+	return rc ? rc : cmp_numbers(a->seq, b->seq);
+}
+
+static int cmp_sort_keys_num(const void *x, const void *y)
+{
+	const struct sort_key *a = x, *b = y;
+	int rc;
+
+	if (cmp_sort_keys_empty(a, b, &rc))
+		return rc;
+	rc = cmp_numbers(a->val.num, b->val.num);
+	return rc ? rc : cmp_numbers(a->seq, b->seq);
+}
+
+static int cmp_sort_keys_fnum(const void *x, const void *y)
+{
+	const struct sort_key *a = x, *b = y;
+	int rc;
+
+	if (cmp_sort_keys_empty(a, b, &rc))
+		return rc;
+	rc = cmp_numbers(a->val.fnum, b->val.fnum);
+	return rc ? rc : cmp_numbers(a->seq, b->seq);
+}
+
+/* @children: the list is struct libscols_line->ln_children rather than ln_lines */
+static int sort_list_by_keys(struct list_head *head, int children,
+			     struct libscols_column *cl, int type)
+{
+	struct sort_key *keys;
+	struct list_head *p;
+	size_t i, n = 0;
+	int rc = 0;
+
+	list_for_each(p, head)
+		n++;
+	if (n < 2)
+		return 0;
+
+	keys = calloc(n, sizeof(*keys));
+	if (!keys)
+		return -ENOMEM;
+
+	i = 0;
+	list_for_each(p, head) {
+		struct libscols_line *ln = children ?
+				list_entry(p, struct libscols_line, ln_children) :
+				list_entry(p, struct libscols_line, ln_lines);
+		keys[i].seq = i;
+		rc = fill_sort_key(cl, type, ln, &keys[i]);
+		i++;
+		if (rc)
+			goto done;
+	}
+
+	qsort(keys, n, sizeof(*keys),
+		type == SCOLS_DATA_STRING ? cmp_sort_keys_str :
+		type == SCOLS_DATA_FLOAT  ? cmp_sort_keys_fnum :
+					    cmp_sort_keys_num);
+
+	/* relink in the new order */
+	INIT_LIST_HEAD(head);
+	for (i = 0; i < n; i++)
+		list_add_tail(children ? &keys[i].ln->ln_children :
+					 &keys[i].ln->ln_lines, head);
+done:
+	if (type == SCOLS_DATA_STRING) {
+		for (i = 0; i < n; i++)
+			free(keys[i].val.str);
+	}
+	free(keys);
+	return rc;
+}
+
+static int sort_list(struct list_head *head, int children, struct libscols_column *cl)
+{
+	int type = get_sort_key_type(cl);
+
+	if (type != SCOLS_DATA_NONE) {
+		int rc = sort_list_by_keys(head, children, cl, type);
+
+		if (rc == 0 || !cl->cmpfunc)
+			return rc;
+		/* fallback to the cmpfunc on errors */
+	}
+
+	list_sort(head, children ? cells_cmp_wrapper_children :
+				   cells_cmp_wrapper_lines, cl);
+	return 0;
+}
+
 static int sort_line_children(struct libscols_line *ln, struct libscols_column *cl)
 {
 	struct list_head *p;
+	int rc = 0;
 
 	if (!list_empty(&ln->ln_branch)) {
 		list_for_each(p, &ln->ln_branch) {
@@ -1616,34 +2138,35 @@ static int sort_line_children(struct libscols_line *ln, struct libscols_column *
 			sort_line_children(chld, cl);
 		}
 
-		list_sort(&ln->ln_branch, cells_cmp_wrapper_children, cl);
+		rc = sort_list(&ln->ln_branch, 1, cl);
 	}
 
-	if (is_first_group_member(ln)) {
+	if (!rc && is_first_group_member(ln)) {
 		list_for_each(p, &ln->group->gr_children) {
 			struct libscols_line *chld =
 					list_entry(p, struct libscols_line, ln_children);
 			sort_line_children(chld, cl);
 		}
 
-		list_sort(&ln->group->gr_children, cells_cmp_wrapper_children, cl);
+		rc = sort_list(&ln->group->gr_children, 1, cl);
 	}
 
-	return 0;
+	return rc;
 }
 
 static int  __scols_sort_tree(struct libscols_table *tb, struct libscols_column *cl)
 {
 	struct libscols_line *ln;
 	struct libscols_iter itr;
+	int rc = 0;
 
-	if (!tb || !cl || !cl->cmpfunc)
+	if (!tb || !cl || !is_sortable_column(cl))
 		return -EINVAL;
 
 	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
-	while (scols_table_next_line(tb, &itr, &ln) == 0)
-		sort_line_children(ln, cl);
-	return 0;
+	while (rc == 0 && scols_table_next_line(tb, &itr, &ln) == 0)
+		rc = sort_line_children(ln, cl);
+	return rc;
 }
 
 /**
@@ -1654,6 +2177,12 @@ static int  __scols_sort_tree(struct libscols_table *tb, struct libscols_column
  * Orders the table by the column. See also scols_column_set_cmpfunc(). If the
  * tree output is enabled then children in the tree are recursively sorted too.
  *
+ * Since version 2.41 the column does not need cmpfunc if the column data type
+ * is set by scols_column_set_data_type(). In this case (and for the default
+ * scols_cmpstr_cells()) the sort key is extracted only once for each line
+ * (by the column data function if defined, or from the cell string) and the
+ * lines are sorted by the keys.
+ *
  * The column @cl is saved as the default sort column to the @tb and the next time
  * is possible to call scols_sort_table(tb, NULL). The saved column is also used by
  * scols_sort_table_by_tree().
@@ -1662,23 +2191,25 @@ static int  __scols_sort_tree(struct libscols_table *tb, struct libscols_column
  */
 int scols_sort_table(struct libscols_table *tb, struct libscols_column *cl)
 {
+	int rc;
+
 	if (!tb)
 		return -EINVAL;
 	if (!cl)
 		cl = tb->dflt_sort_column;
-	if (!cl || !cl->cmpfunc)
+	if (!cl || !is_sortable_column(cl))
 		return -EINVAL;
 
 	DBG(TAB, ul_debugobj(tb, "sorting table by %zu column", cl->seqnum));
-	list_sort(&tb->tb_lines, cells_cmp_wrapper_lines, cl);
+	rc = sort_list(&tb->tb_lines, 0, cl);
 
-	if (scols_table_is_tree(tb))
-		__scols_sort_tree(tb, cl);
+	if (!rc && scols_table_is_tree(tb))
+		rc = __scols_sort_tree(tb, cl);
 
 	if (cl && cl != tb->dflt_sort_column)
 		tb->dflt_sort_column = cl;
 
-	return 0;
+	return rc;
 }
 
 /*
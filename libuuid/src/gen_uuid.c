@@ -80,6 +80,10 @@
 #if defined(__linux__) && defined(HAVE_SYS_SYSCALL_H)
 #include <sys/syscall.h>
 #endif
+#if defined(HAVE_TLS) && defined(HAVE_PTHREAD)
+#include <pthread.h>
+#define HAVE_RAND_POOL 1
+#endif
 
 #include "all-io.h"
 #include "uuidP.h"
@@ -585,13 +589,15 @@ int __uuid_generate_time_cont(uuid_t out, int *num, uint32_t cont_offset)
  */
 static int uuid_generate_time_generic(uuid_t out) {
 #ifdef HAVE_TLS
-	/* thread local cache for uuidd based requests */
+	/* thread local cache for uuidd or clock counter based requests */
 	THREAD_LOCAL int		num = 0;
 	THREAD_LOCAL int		cache_size = CS_MIN;
 	THREAD_LOCAL int		last_used = 0;
 	THREAD_LOCAL struct uuid	uu;
 	THREAD_LOCAL time_t		last_time = 0;
+	THREAD_LOCAL pid_t		last_pid = 0;
 	time_t				now;
+	pid_t				pid;
 
 	if (num > 0) { /* expire cache */
 		now = time(NULL);
@@ -600,6 +606,13 @@ static int uuid_generate_time_generic(uuid_t out) {
 			num = 0;
 		}
 	}
+	if (num > 0) { /* the cache has been reserved by the parent process */
+		pid = getpid();
+		if (pid != last_pid) {
+			num = 0;
+			cache_size = CS_MIN;
+		}
+	}
 	if (num <= 0) { /* fill cache */
 		/*
 		 * num + OP_BULK provides a local cache in each application.
@@ -614,15 +627,23 @@ static int uuid_generate_time_generic(uuid_t out) {
 		num = cache_size;
 
 		if (get_uuid_via_daemon(UUIDD_OP_BULK_TIME_UUID,
-					out, &num) == 0) {
+					out, &num) == 0
+		    /*
+		     * Without uuidd reserve the same range in the clock counter
+		     * like uuidd does; one flock() per range and the UUIDs are
+		     * unique as long as the range is used by this thread only.
+		     */
+		    || __uuid_generate_time(out, &num) == 0) {
 			last_time = time(NULL);
+			last_pid = getpid();
 			uuid_unpack(out, &uu);
 			num--;
 			return 0;
 		}
-		/* request to daemon failed, reset cache */
+		/* clock counter is not usable, @out is generated anyway */
 		num = 0;
 		cache_size = CS_MIN;
+		return -1;
 	}
 	if (num > 0) { /* serve uuid from cache */
 		uu.time_low++;
@@ -662,6 +683,100 @@ int uuid_generate_time_safe(uuid_t out)
 }
 
 
+#ifdef HAVE_RAND_POOL
+/*
+ * Per-thread buffer of random bytes for the random-based UUIDs; one
+ * ul_random_get_bytes() call reads RAND_POOL_SIZE bytes instead of one call
+ * per UUID. The used bytes are zeroized, the buffer is wiped in the child
+ * after fork() and freed on thread exit.
+ */
+#define RAND_POOL_SIZE	4096
+
+struct rand_pool {
+	size_t		avail;		/* unused bytes at the end of @buf */
+	int		weak;		/* ul_random_get_bytes() result */
+	unsigned char	buf[RAND_POOL_SIZE];
+};
+
+static __thread struct rand_pool *rand_pool;
+static pthread_key_t rand_pool_key;
+static pthread_once_t rand_pool_once = PTHREAD_ONCE_INIT;
+static int rand_pool_ok;
+
+static void rand_pool_free(void *data)
+{
+	struct rand_pool *pool = data;
+
+	memset(pool, 0, sizeof(*pool));
+	free(pool);
+}
+
+/* the child must not use the same bytes as the parent */
+static void rand_pool_atfork_child(void)
+{
+	if (rand_pool)
+		memset(rand_pool, 0, sizeof(*rand_pool));
+}
+
+static void rand_pool_init(void)
+{
+	if (pthread_key_create(&rand_pool_key, rand_pool_free) != 0)
+		return;
+	if (pthread_atfork(NULL, NULL, rand_pool_atfork_child) != 0) {
+		pthread_key_delete(rand_pool_key);
+		return;
+	}
+	rand_pool_ok = 1;
+}
+
+/* the key destructor must not be called after the library is unloaded */
+static void __attribute__((destructor)) rand_pool_deinit(void)
+{
+	if (rand_pool_ok)
+		pthread_key_delete(rand_pool_key);
+}
+
+/* like ul_random_get_bytes(), returns 1 for weak random bytes */
+static int random_get_bytes(void *buf, size_t nbytes)
+{
+	unsigned char *cp = buf;
+	int weak = 0;
+
+	if (!rand_pool) {
+		pthread_once(&rand_pool_once, rand_pool_init);
+		if (!rand_pool_ok)
+			return ul_random_get_bytes(buf, nbytes);
+		rand_pool = calloc(1, sizeof(*rand_pool));
+		if (!rand_pool)
+			return ul_random_get_bytes(buf, nbytes);
+		pthread_setspecific(rand_pool_key, rand_pool);
+	}
+
+	while (nbytes) {
+		unsigned char *p;
+		size_t sz;
+
+		if (!rand_pool->avail) {
+			rand_pool->weak = ul_random_get_bytes(rand_pool->buf,
+							      sizeof(rand_pool->buf));
+			rand_pool->avail = sizeof(rand_pool->buf);
+		}
+		p = rand_pool->buf + sizeof(rand_pool->buf) - rand_pool->avail;
+		sz = min(nbytes, rand_pool->avail);
+
+		memcpy(cp, p, sz);
+		memset(p, 0, sz);
+		rand_pool->avail -= sz;
+		weak |= rand_pool->weak;
+		cp += sz;
+		nbytes -= sz;
+	}
+	return weak;
+}
+#else
+# define random_get_bytes(_buf, _n)	ul_random_get_bytes(_buf, _n)
+#endif /* HAVE_RAND_POOL */
+
 int __uuid_generate_random(uuid_t out, int *num)
 {
 	uuid_t	buf;
@@ -674,7 +789,7 @@ int __uuid_generate_random(uuid_t out, int *num)
 		n = *num;
 
 	for (i = 0; i < n; i++) {
-		if (ul_random_get_bytes(buf, sizeof(buf)))
+		if (random_get_bytes(buf, sizeof(buf)))
 			r = -1;
 		uuid_unpack(buf, &uu);
 
@@ -696,6 +811,92 @@ void uuid_generate_random(uuid_t out)
 	__uuid_generate_random(out, &num);
 }
 
+/*
+ * Generate @n random-based UUIDs to the array @out.
+ *
+ * Returns 0 on success, -1 if high-quality randomness has not been available
+ * for some of them.
+ */
+int uuid_generate_random_bulk(uuid_t *out, size_t n)
+{
+	int r = 0;
+
+	while (n) {
+		int num = n > INT_MAX ? INT_MAX : (int) n;
+
+		if (__uuid_generate_random(*out, &num))
+			r = -1;
+		out += num;
+		n -= num;
+	}
+	return r;
+}
+
+/*
+ * The time-ordered v7 UUIDs use the RFC 9562 method 1: the 12-bit rand_a and
+ * the top 30 bits of rand_b are a counter, randomly seeded (with the top bit
+ * zero) in every new millisecond and incremented for every UUID, so the UUIDs
+ * from one thread are strictly monotonic. The rest of rand_b is random. If
+ * the counter overflows, or the clock goes back, the timestamp of the last
+ * UUID is advanced instead of the clock.
+ */
+#define V7_COUNTER_BITS		42
+#define V7_COUNTER_MAX		((UINT64_C(1) << V7_COUNTER_BITS) - 1)
+#define V7_CHUNK		64	/* UUIDs per random_get_bytes() */
+
+int uuid_generate_time_v7_bulk(uuid_t *out, size_t n)
+{
+	THREAD_LOCAL uint64_t	last_ms = 0, counter = 0;
+	uint32_t		rnd[V7_CHUNK + 2];	/* + the counter seed */
+	uint64_t		seed, ms;
+	struct timeval		tv;
+	int			r = 0;
+
+	gettimeofday(&tv, NULL);
+	ms = (uint64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+
+	while (n) {
+		size_t i, sz = min(n, (size_t) V7_CHUNK);
+
+		if (random_get_bytes(rnd, (sz + 2) * sizeof(rnd[0])))
+			r = -1;
+		seed = ((uint64_t) rnd[sz] << 32) | rnd[sz + 1];
+
+		for (i = 0; i < sz; i++, out++) {
+			unsigned char *cp = *out;
+
+			if (ms > last_ms) {
+				last_ms = ms;
+				counter = seed & (V7_COUNTER_MAX >> 1);
+			} else if (++counter > V7_COUNTER_MAX) {
+				last_ms++;
+				counter = seed & (V7_COUNTER_MAX >> 1);
+			}
+
+			cp[0] = last_ms >> 40;
+			cp[1] = last_ms >> 32;
+			cp[2] = last_ms >> 24;
+			cp[3] = last_ms >> 16;
+			cp[4] = last_ms >> 8;
+			cp[5] = last_ms;
+			cp[6] = 0x70 | ((counter >> 38) & 0x0F);
+			cp[7] = counter >> 30;
+			cp[8] = 0x80 | ((counter >> 24) & 0x3F);
+			cp[9] = counter >> 16;
+			cp[10] = counter >> 8;
+			cp[11] = counter;
+			memcpy(cp + 12, &rnd[i], sizeof(rnd[i]));
+		}
+		n -= sz;
+	}
+	return r;
+}
+
+void uuid_generate_time_v7(uuid_t out)
+{
+	uuid_generate_time_v7_bulk((uuid_t *) out, 1);
+}
+
 /*
  * This is the generic front-end to __uuid_generate_random and
  * uuid_generate_time.  It uses __uuid_generate_random output
@@ -709,30 +910,47 @@ void uuid_generate(uuid_t out)
 		uuid_generate_time(out);
 }
 
+/* sets the variant and @version of the UUID made from the first bytes of @hash */
+static void uuid_from_hash(uuid_t out, const unsigned char *hash, int version)
+{
+	memcpy(out, hash, sizeof(uuid_t));
+
+	out[6] = (out[6] & 0x0F) | (version << 4);	/* time_hi_and_version */
+	out[8] = (out[8] & 0x3F) | 0x80;		/* clock_seq */
+}
+
 /*
  * Generate an MD5 hashed (predictable) UUID based on a well-known UUID
  * providing the namespace and an arbitrary binary string.
  */
 void uuid_generate_md5(uuid_t out, const uuid_t ns, const char *name, size_t len)
 {
-	UL_MD5_CTX ctx;
-	char hash[UL_MD5LENGTH];
-	uuid_t buf;
-	struct uuid uu;
+	uuid_generate_md5_bulk((uuid_t *) out, ns, &name, &len, 1);
+}
 
-	ul_MD5Init(&ctx);
-	ul_MD5Update(&ctx, ns, sizeof(uuid_t));
-	ul_MD5Update(&ctx, (const unsigned char *)name, len);
-	ul_MD5Final((unsigned char *)hash, &ctx);
+/*
+ * The same as uuid_generate_md5() for @n names. The namespace is hashed only
+ * once, the state is copied for every name. If @lens is NULL the names are
+ * strings.
+ */
+void uuid_generate_md5_bulk(uuid_t *out, const uuid_t ns,
+			    const char *const *names, const size_t *lens, size_t n)
+{
+	UL_MD5_CTX nsctx;
+	size_t i;
 
-	assert(sizeof(buf) <= sizeof(hash));
+	ul_MD5Init(&nsctx);
+	ul_MD5Update(&nsctx, ns, sizeof(uuid_t));
 
-	memcpy(buf, hash, sizeof(buf));
-	uuid_unpack(buf, &uu);
+	for (i = 0; i < n; i++) {
+		UL_MD5_CTX ctx = nsctx;
+		unsigned char hash[UL_MD5LENGTH];
 
-	uu.clock_seq = (uu.clock_seq & 0x3FFF) | 0x8000;
-	uu.time_hi_and_version = (uu.time_hi_and_version & 0x0FFF) | 0x3000;
-	uuid_pack(&uu, out);
+		ul_MD5Update(&ctx, (const unsigned char *) names[i],
+			     lens ? lens[i] : strlen(names[i]));
+		ul_MD5Final(hash, &ctx);
+		uuid_from_hash(out[i], hash, 3);
+	}
 }
 
 /*
@@ -741,22 +959,28 @@ void uuid_generate_md5(uuid_t out, const uuid_t ns, const char *name, size_t len
  */
 void uuid_generate_sha1(uuid_t out, const uuid_t ns, const char *name, size_t len)
 {
-	UL_SHA1_CTX ctx;
-	char hash[UL_SHA1LENGTH];
-	uuid_t buf;
-	struct uuid uu;
+	uuid_generate_sha1_bulk((uuid_t *) out, ns, &name, &len, 1);
+}
 
-	ul_SHA1Init(&ctx);
-	ul_SHA1Update(&ctx, ns, sizeof(uuid_t));
-	ul_SHA1Update(&ctx, (const unsigned char *)name, len);
-	ul_SHA1Final((unsigned char *)hash, &ctx);
+/*
+ * The same as uuid_generate_sha1() for @n names, see uuid_generate_md5_bulk().
+ */
+void uuid_generate_sha1_bulk(uuid_t *out, const uuid_t ns,
+			     const char *const *names, const size_t *lens, size_t n)
+{
+	UL_SHA1_CTX nsctx;
+	size_t i;
 
-	assert(sizeof(buf) <= sizeof(hash));
+	ul_SHA1Init(&nsctx);
+	ul_SHA1Update(&nsctx, ns, sizeof(uuid_t));
 
-	memcpy(buf, hash, sizeof(buf));
-	uuid_unpack(buf, &uu);
+	for (i = 0; i < n; i++) {
+		UL_SHA1_CTX ctx = nsctx;
+		unsigned char hash[UL_SHA1LENGTH];
 
-	uu.clock_seq = (uu.clock_seq & 0x3FFF) | 0x8000;
-	uu.time_hi_and_version = (uu.time_hi_and_version & 0x0FFF) | 0x5000;
-	uuid_pack(&uu, out);
+		ul_SHA1Update(&ctx, (const unsigned char *) names[i],
+			      lens ? lens[i] : strlen(names[i]));
+		ul_SHA1Final(hash, &ctx);
+		uuid_from_hash(out[i], hash, 5);
+	}
 }
@@ -34,12 +34,52 @@
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <ctype.h>
 #include <string.h>
 
 #include "c.h"
 #include "uuidP.h"
 
+/*
+ * The value of the hex digit plus one, zero for all other characters. Only
+ * ASCII digits are accepted, independently on locale.
+ */
+static const unsigned char hexval[256] = {
+	['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,
+	['5'] = 6,  ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16
+};
+
+/* offsets of the bytes in the string, the byte order is the same as in uuid_t */
+static const unsigned char hexpos[16] = {
+	0, 2, 4, 6, 9, 11, 14, 16, 19, 21, 24, 26, 28, 30, 32, 34
+};
+
+/* parses 36 characters at @in, @uu is not modified on error */
+static int parse_uuid_str(const char *in, uuid_t uu)
+{
+	const unsigned char *s = (const unsigned char *) in;
+	unsigned int bad = 0;
+	uuid_t tmp;
+	size_t i;
+
+	if (s[8] != '-' || s[13] != '-' || s[18] != '-' || s[23] != '-')
+		return -1;
+
+	for (i = 0; i < 16; i++) {
+		unsigned int hi = hexval[s[hexpos[i]]];
+		unsigned int lo = hexval[s[hexpos[i] + 1]];
+
+		bad |= !hi | !lo;
+		tmp[i] = ((hi - 1) << 4) | (lo - 1);
+	}
+	if (bad)
+		return -1;
+
+	memcpy(uu, tmp, sizeof(tmp));
+	return 0;
+}
+
 int uuid_parse(const char *in, uuid_t uu)
 {
 	size_t len = strlen(in);
@@ -51,48 +91,24 @@ int uuid_parse(const char *in, uuid_t uu)
 
 int uuid_parse_range(const char *in_start, const char *in_end, uuid_t uu)
 {
-	struct uuid	uuid;
-	int		i;
-	const char	*cp;
-	char		buf[3];
-
 	if ((in_end - in_start) != 36)
 		return -1;
-	for (i=0, cp = in_start; i < 36; i++,cp++) {
-		if ((i == 8) || (i == 13) || (i == 18) ||
-		    (i == 23)) {
-			if (*cp == '-')
-				continue;
-			return -1;
-		}
 
-		if (!isxdigit(*cp))
-			return -1;
-	}
-	errno = 0;
-	uuid.time_low = strtoul(in_start, NULL, 16);
-
-	if (!errno)
-		uuid.time_mid = strtoul(in_start+9, NULL, 16);
-	if (!errno)
-		uuid.time_hi_and_version = strtoul(in_start+14, NULL, 16);
-	if (!errno)
-		uuid.clock_seq = strtoul(in_start+19, NULL, 16);
-	if (errno)
-		return -1;
+	return parse_uuid_str(in_start, uu);
+}
 
-	cp = in_start+24;
-	buf[2] = 0;
-	for (i=0; i < 6; i++) {
-		buf[0] = *cp++;
-		buf[1] = *cp++;
+/*
+ * Parses @n records of UUID_STR_LEN bytes, every record is a UUID string
+ * followed by @sep. Returns the number of the leading valid records.
+ */
+size_t uuid_parse_many(const char *in, size_t n, uuid_t *out, char sep)
+{
+	size_t i;
 
-		errno = 0;
-		uuid.node[i] = strtoul(buf, NULL, 16);
-		if (errno)
-			return -1;
+	for (i = 0; i < n; i++, in += UUID_STR_LEN) {
+		if (in[UUID_STR_LEN - 1] != sep
+		    || parse_uuid_str(in, out[i]) != 0)
+			break;
 	}
-
-	uuid_pack(&uuid, uu);
-	return 0;
+	return i;
 }
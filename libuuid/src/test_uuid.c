@@ -42,6 +42,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 
 #include "c.h"
@@ -64,6 +65,88 @@ static int test_uuid(const char * uuid, int isValid)
 	return 0;
 }
 
+static int test_uuid_many(void)
+{
+	static const char *strs[] = {
+		"84949cc5-4701-4a84-895b-354c584a981b",
+		"01234567-89ab-cdef-0134-567890abcedf",
+		"ffffffff-ffff-ffff-ffff-ffffffffffff"
+	};
+	uuid_t in[ARRAY_SIZE(strs)], out[ARRAY_SIZE(strs)];
+	char buf[ARRAY_SIZE(strs) * UUID_STR_LEN];
+	size_t i, n = ARRAY_SIZE(strs);
+
+	for (i = 0; i < n; i++)
+		uuid_parse(strs[i], in[i]);
+
+	uuid_unparse_many(in, n, buf, '\n');
+	for (i = 0; i < n; i++) {
+		if (strncmp(buf + i * UUID_STR_LEN, strs[i], UUID_STR_LEN - 1) != 0
+		    || buf[i * UUID_STR_LEN + UUID_STR_LEN - 1] != '\n') {
+			printf("uuid_unparse_many failed\n");
+			return 1;
+		}
+	}
+	if (uuid_parse_many(buf, n, out, '\n') != n
+	    || memcmp(in, out, sizeof(in)) != 0) {
+		printf("uuid_parse_many failed\n");
+		return 1;
+	}
+	buf[UUID_STR_LEN + 5] = 'x';
+	if (uuid_parse_many(buf, n, out, '\n') != 1) {
+		printf("uuid_parse_many accepted an invalid record\n");
+		return 1;
+	}
+	if (uuid_parse_many(buf, n, out, '\0') != 0) {
+		printf("uuid_parse_many accepted an invalid separator\n");
+		return 1;
+	}
+	printf("uuid_parse_many and uuid_unparse_many, OK\n");
+	return 0;
+}
+
+static int test_uuid_hash(void)
+{
+	static const char *names[] = { "www.example.com", "python.org" };
+	static const char *md5[] = {
+		"5df41881-3aed-3515-88a7-2f4a814cf09e",
+		"6fa459ea-ee8a-3ca4-894e-db77e160355e"
+	};
+	static const char *sha1[] = {
+		"2ed6657d-e927-568b-95e1-2665a8aea6a2",
+		"886313e1-3b8a-5372-9b90-0c9aee199e5d"
+	};
+	uuid_t ns, uu, out[ARRAY_SIZE(names)];
+	char str[UUID_STR_LEN];
+	size_t i;
+	int failed = 0;
+
+	uuid_parse("6ba7b810-9dad-11d1-80b4-00c04fd430c8", ns);	/* @dns */
+
+	uuid_generate_md5_bulk(out, ns, names, NULL, ARRAY_SIZE(names));
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		uuid_generate_md5(uu, ns, names[i], strlen(names[i]));
+		uuid_unparse(out[i], str);
+		if (uuid_compare(uu, out[i]) != 0 || strcmp(str, md5[i]) != 0) {
+			printf("md5 %s: %s, expected %s\n", names[i], str, md5[i]);
+			failed++;
+		}
+	}
+
+	uuid_generate_sha1_bulk(out, ns, names, NULL, ARRAY_SIZE(names));
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		uuid_generate_sha1(uu, ns, names[i], strlen(names[i]));
+		uuid_unparse(out[i], str);
+		if (uuid_compare(uu, out[i]) != 0 || strcmp(str, sha1[i]) != 0) {
+			printf("sha1 %s: %s, expected %s\n", names[i], str, sha1[i]);
+			failed++;
+		}
+	}
+	if (!failed)
+		printf("uuid_generate_md5_bulk and uuid_generate_sha1_bulk, OK\n");
+	return failed;
+}
+
 static int check_uuids_in_file(const char *file)
 {
 	int ret = 0;
@@ -113,6 +196,10 @@ main(int argc, char **argv)
 		failed += test_uuid("00000000-0000-0000-0000-000000000000", 1);
 		failed += test_uuid("01234567-89ab-cdef-0134-567890abcedf", 1);
 		failed += test_uuid("ffffffff-ffff-ffff-ffff-ffffffffffff", 1);
+		failed += test_uuid("+4949cc5-4701-4a84-895b-354c584a981b", 0);
+		failed += test_uuid("84949cc5-4701-4a84-895b-354c584a98 b", 0);
+		failed += test_uuid_many();
+		failed += test_uuid_hash();
 	} else {
 		int i;
 
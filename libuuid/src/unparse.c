@@ -74,3 +74,17 @@ void uuid_unparse(const uuid_t uu, char *out)
 	uuid_fmt(uu, out, hexdigits_lower);
 #endif
 }
+
+/*
+ * Writes @n records of UUID_STR_LEN bytes to @out, every record is a UUID
+ * string (in the default case) followed by @sep.
+ */
+void uuid_unparse_many(const uuid_t *uu, size_t n, char *out, char sep)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++, out += UUID_STR_LEN) {
+		uuid_unparse(uu[i], out);
+		out[UUID_STR_LEN - 1] = sep;
+	}
+}
@@ -69,6 +69,17 @@ time_t __uuid_time(const uuid_t uu, struct timeval *ret_tv)
 	uint32_t		high;
 	uint64_t		clock_reg;
 
+	if (((uu[6] >> 4) & 0xF) == UUID_TYPE_DCE_TIME_V7) {
+		uint64_t ms = 0;
+		int i;
+
+		for (i = 0; i < 6; i++)
+			ms = (ms << 8) | uu[i];
+		tv.tv_sec = ms / 1000;
+		tv.tv_usec = (ms % 1000) * 1000;
+		goto done;
+	}
+
 	uuid_unpack(uu, &uuid);
 
 	high = uuid.time_mid | ((uuid.time_hi_and_version & 0xFFF) << 16);
@@ -77,7 +88,7 @@ time_t __uuid_time(const uuid_t uu, struct timeval *ret_tv)
 	clock_reg -= (((uint64_t) 0x01B21DD2) << 32) + 0x13814000;
 	tv.tv_sec = clock_reg / 10000000;
 	tv.tv_usec = (clock_reg % 10000000) / 10;
-
+done:
 	if (ret_tv)
 		*ret_tv = tv;
 
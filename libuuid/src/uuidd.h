@@ -46,7 +46,8 @@
 #define UUIDD_OP_RANDOM_UUID		3
 #define UUIDD_OP_BULK_TIME_UUID		4
 #define UUIDD_OP_BULK_RANDOM_UUID	5
-#define UUIDD_MAX_OP			UUIDD_OP_BULK_RANDOM_UUID
+#define UUIDD_OP_BULK_TIME_V7_UUID	6
+#define UUIDD_MAX_OP			UUIDD_OP_BULK_TIME_V7_UUID
 
 extern int __uuid_generate_time(uuid_t out, int *num);
 extern int __uuid_generate_time_cont(uuid_t out, int *num, uint32_t cont);
@@ -26,6 +26,7 @@
  */
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <time.h>
 #include <stdio.h>
@@ -98,6 +99,15 @@ struct last_control {
 	char separator;        /* output separator */
 };
 
+/* wtmp file mapped to memory */
+struct wtmp_map {
+	char	*data;
+	size_t	size;
+	size_t	base;		/* offset of the first record */
+	size_t	first;		/* first record of the time window */
+	size_t	next;		/* the records are read backwards from here */
+};
+
 /* Double linked list of struct utmp's */
 struct utmplist {
 	struct utmpx ut;
@@ -267,6 +277,129 @@ static int uread(FILE *fp, struct utmpx *u,  int *quit, const char *filename)
 	return 1;
 }
 
+static time_t wtmp_map_time(const struct wtmp_map *m, size_t idx)
+{
+	struct utmpx u;
+
+	memcpy(&u.ut_tv, m->data + m->base + idx * sizeof(struct utmpx)
+			 + offsetof(struct utmpx, ut_tv), sizeof(u.ut_tv));
+	return u.ut_tv.tv_sec;
+}
+
+/*
+ *	Returns 1 if the records are in order by time. The clock may be set
+ *	backwards (e.g. boot without RTC), the binary search is unusable then.
+ */
+static int wtmp_map_is_sorted(const struct wtmp_map *m, size_t nrecs)
+{
+	time_t last = wtmp_map_time(m, 0);
+	size_t i;
+
+	for (i = 1; i < nrecs; i++) {
+		time_t x = wtmp_map_time(m, i);
+
+		if (x < last)
+			return 0;
+		last = x;
+	}
+	return 1;
+}
+
+/*
+ *	Returns the number of records that are not newer than @t, that is the
+ *	index of the first newer record. The records are expected in order by
+ *	time, -1 is returned if a probed record is out of the order.
+ */
+static ssize_t wtmp_map_search(const struct wtmp_map *m, size_t nrecs, time_t t)
+{
+	size_t lo = 0, hi = nrecs;
+	time_t lo_t = wtmp_map_time(m, 0),
+	       hi_t = wtmp_map_time(m, nrecs - 1);
+
+	if (hi_t < lo_t)
+		return -1;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		time_t x = wtmp_map_time(m, mid);
+
+		if (x < lo_t || hi_t < x)
+			return -1;
+		if (x <= t) {
+			lo = mid + 1;
+			lo_t = x;
+		} else {
+			hi = mid;
+			hi_t = x;
+		}
+	}
+	return lo;
+}
+
+/*
+ *	Map the file to memory and find the records between --since and
+ *	--until. If the records are not in order by time, all of them are read.
+ */
+static int wtmp_map_init(struct wtmp_map *m, const struct last_control *ctl,
+			 int fd, const struct stat *st)
+{
+	size_t nrecs;
+	ssize_t x;
+
+	if (!S_ISREG(st->st_mode) || st->st_size < (off_t) sizeof(struct utmpx)
+	    || (uintmax_t) st->st_size > SIZE_MAX)
+		return -1;
+
+	m->size = st->st_size;
+	m->data = mmap(NULL, m->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (m->data == MAP_FAILED) {
+		m->data = NULL;
+		return -1;
+	}
+
+	/* the records are aligned to the end like uread() does */
+	nrecs = m->size / sizeof(struct utmpx);
+	m->base = m->size % sizeof(struct utmpx);
+	m->first = 0;
+	m->next = nrecs;
+
+	if ((ctl->since || ctl->until) && !wtmp_map_is_sorted(m, nrecs))
+		return 0;
+
+	if (ctl->until) {
+		x = wtmp_map_search(m, nrecs, ctl->until);
+		if (x < 0)
+			return 0;
+		/* the newer records right behind may be slightly out of order */
+		while ((size_t) x < nrecs && wtmp_map_time(m, x) <= ctl->until)
+			x++;
+		m->next = x;
+	}
+	if (ctl->since) {
+		x = wtmp_map_search(m, nrecs, ctl->since - 1);
+		if (x < 0) {
+			m->next = nrecs;
+			return 0;
+		}
+		while (x > 0 && ctl->since <= wtmp_map_time(m, x - 1))
+			x--;
+		m->first = min((size_t) x, m->next);
+	}
+	return 0;
+}
+
+/*
+ *	Read one utmp entry backwards from the time window.
+ */
+static int wtmp_map_read(struct wtmp_map *m, struct utmpx *u)
+{
+	if (m->next == m->first)
+		return 0;
+	m->next--;
+	memcpy(u, m->data + m->base + m->next * sizeof(struct utmpx),
+	       sizeof(struct utmpx));
+	return 1;
+}
+
 #ifndef FUZZ_TARGET
 /*
  *	SIGINT handler
@@ -648,6 +781,7 @@ static void process_wtmp_file(const struct last_control *ctl,
 			      const char *filename)
 {
 	FILE *fp;		/* File pointer of wtmp file */
+	struct wtmp_map map = { .data = NULL };
 
 	struct utmpx ut;	/* Current utmp entry */
 	struct utmplist *ulist = NULL;	/* All entries */
@@ -689,35 +823,47 @@ static void process_wtmp_file(const struct last_control *ctl,
 	if ((fp = fopen(filename, "r")) == NULL)
 		err(EXIT_FAILURE, _("cannot open %s"), filename);
 
-	/*
-	 * Optimize the buffer size.
-	 */
-	setvbuf(fp, NULL, _IOFBF, UCHUNKSIZE);
+	if (fstat(fileno(fp), &st) != 0)
+		err(EXIT_FAILURE, _("stat of %s failed"), filename);
 
-	/*
-	 * Read first structure to capture the time field
-	 */
-	if (uread(fp, &ut, NULL, filename) == 1)
+	if (wtmp_map_init(&map, ctl, fileno(fp), &st) == 0) {
+		/*
+		 * The first structure is the begin of the file.
+		 */
+		memcpy(&ut, map.data, sizeof(struct utmpx));
 		begintime = ut.ut_tv.tv_sec;
-	else {
-		if (fstat(fileno(fp), &st) != 0)
-			err(EXIT_FAILURE, _("stat of %s failed"), filename);
-		begintime = st.st_ctime;
-		quit = 1;
-	}
+	} else {
+		/*
+		 * Optimize the buffer size.
+		 */
+		setvbuf(fp, NULL, _IOFBF, UCHUNKSIZE);
 
-	/*
-	 * Go to end of file minus one structure
-	 * and/or initialize utmp reading code.
-	 */
-	uread(fp, NULL, NULL, filename);
+		/*
+		 * Read first structure to capture the time field
+		 */
+		if (uread(fp, &ut, NULL, filename) == 1)
+			begintime = ut.ut_tv.tv_sec;
+		else {
+			begintime = st.st_ctime;
+			quit = 1;
+		}
+
+		/*
+		 * Go to end of file minus one structure
+		 * and/or initialize utmp reading code.
+		 */
+		uread(fp, NULL, NULL, filename);
+	}
 
 	/*
 	 * Read struct after struct backwards from the file.
 	 */
 	while (!quit) {
 
-		if (uread(fp, &ut, &quit, filename) != 1)
+		if (map.data) {
+			if (wtmp_map_read(&map, &ut) != 1)
+				break;
+		} else if (uread(fp, &ut, &quit, filename) != 1)
 			break;
 
 		if (ctl->since && ut.ut_tv.tv_sec < ctl->since)
@@ -913,6 +1059,8 @@ static void process_wtmp_file(const struct last_control *ctl,
 		free(tmp);
 	}
 
+	if (map.data)
+		munmap(map.data, map.size);
 	fclose(fp);
 
 	for (p = ulist; p; p = next) {
@@ -224,6 +224,28 @@ static const char *const pretty_status[] = {
 	[STATUS_UNKNOWN]= NULL
 };
 
+/*
+ * Per-user data collected in one pass over wtmp, btmp, lastlog2 and groups,
+ * the records are stored in lslogins_control->logdata tree.
+ */
+struct lslogins_logdata {
+	char *name;
+
+	struct utmpx *wtmp;		/* last login */
+	struct utmpx *btmp;		/* last failed login */
+
+	gid_t *sgroups;			/* supplementary groups */
+	size_t nsgroups;
+
+#ifdef HAVE_LIBLASTLOG2
+	int64_t ll2_time;
+	char *ll2_tty;
+	char *ll2_host;
+
+	unsigned int has_ll2 : 1;
+#endif
+};
+
 #define get_status(x)	(outmode == OUT_PRETTY ? pretty_status[(x)] : status[(x)])
 
 static const struct lslogins_coldesc coldescs[] =
@@ -268,9 +290,11 @@ struct lslogins_control {
 
 #ifdef HAVE_LIBLASTLOG2
 	const char *lastlog2_path;
+	struct ll2_context *ll2_context;
 #endif
 
 	void *usertree;
+	void *logdata;			/* tree with struct lslogins_logdata */
 
 	uid_t uid;
 	uid_t UID_MIN;
@@ -289,6 +313,8 @@ struct lslogins_control {
 	unsigned int selinux_enabled : 1,
 		     fail_on_unknown : 1,		/* fail if user does not exist */
 		     ulist_on : 1,
+		     groups_collected : 1,	/* logdata has all groups */
+		     ll2_collected : 1,		/* logdata has all lastlog2 entries */
 		     shellvar : 1,
 		     noheadings : 1,
 		     notrunc : 1;
@@ -298,6 +324,11 @@ struct lslogins_control {
  * them for each call of fill_table() via twalk() */
 static struct libscols_table *tb;
 
+#ifdef HAVE_LIBLASTLOG2
+/* ll2_read_all() has no way to pass private data to the callback */
+static struct lslogins_control *ll2_collector;
+#endif
+
 /* columns[] array specifies all currently wanted output column. The columns
  * are defined by coldescs[] array and you can specify (on command line) each
  * column twice. That's enough, dynamically allocated array of the columns is
@@ -432,21 +463,92 @@ again:
 	return res;
 }
 
-static struct utmpx *get_last_wtmp(struct lslogins_control *ctl, const char *username)
+static int cmp_logdata(const void *a, const void *b)
 {
-	size_t n = 0;
+	return strcmp(((const struct lslogins_logdata *) a)->name,
+		      ((const struct lslogins_logdata *) b)->name);
+}
+
+static struct lslogins_logdata *get_logdata(struct lslogins_control *ctl,
+					    const char *name, int create)
+{
+	struct lslogins_logdata key = { .name = (char *) name }, *data;
+	void **node;
+
+	node = tfind(&key, &ctl->logdata, cmp_logdata);
+	if (node)
+		return *node;
+	if (!create)
+		return NULL;
+
+	data = xcalloc(1, sizeof(*data));
+	data->name = xstrdup(name);
+	if (!tsearch(data, &ctl->logdata, cmp_logdata))
+		err_oom();
+	return data;
+}
+
+static void free_logdata(void *f)
+{
+	struct lslogins_logdata *data = f;
+
+	free(data->name);
+	free(data->sgroups);
+#ifdef HAVE_LIBLASTLOG2
+	free(data->ll2_tty);
+	free(data->ll2_host);
+#endif
+	free(data);
+}
+
+/* remember the last wtmp or btmp record for each user */
+static void index_utmpx(struct lslogins_control *ctl,
+			struct utmpx *records, size_t nrecords, int failed)
+{
+	char name[sizeof(records[0].ut_user) + 1];
+	size_t i;
+
+	for (i = 0; i < nrecords; i++) {
+		struct lslogins_logdata *data;
+
+		mem2strcpy(name, records[i].ut_user,
+			   sizeof(records[i].ut_user), sizeof(name));
+		if (!*name)
+			continue;
+
+		data = get_logdata(ctl, name, 1);
+		if (failed)
+			data->btmp = records + i;
+		else
+			data->wtmp = records + i;
+	}
+}
+
+/* utmp records use (possibly) truncated, not terminated names */
+static struct lslogins_logdata *get_utmpx_logdata(struct lslogins_control *ctl,
+						  const char *username)
+{
+	char name[sizeof_member(struct utmpx, ut_user) + 1];
 
 	if (!username)
 		return NULL;
 
-	n = ctl->wtmp_size - 1;
-	do {
-		if (!strncmp(username, ctl->wtmp[n].ut_user,
-		             sizeof(ctl->wtmp[0].ut_user)))
-			return ctl->wtmp + n;
-	} while (n--);
-	return NULL;
+	xstrncpy(name, username, sizeof(name));
+	return get_logdata(ctl, name, 0);
+}
+
+static struct utmpx *get_last_wtmp(struct lslogins_control *ctl, const char *username)
+{
+	struct lslogins_logdata *data = get_utmpx_logdata(ctl, username);
+
+	return data ? data->wtmp : NULL;
+}
+
+static struct utmpx *get_last_btmp(struct lslogins_control *ctl, const char *username)
+{
+	struct lslogins_logdata *data = get_utmpx_logdata(ctl, username);
 
+	return data ? data->btmp : NULL;
 }
 
 static int require_wtmp(void)
@@ -467,21 +569,13 @@ static int require_btmp(void)
 	return 0;
 }
 
-static struct utmpx *get_last_btmp(struct lslogins_control *ctl, const char *username)
+static int require_sgroups(void)
 {
-	size_t n = 0;
-
-	if (!username)
-		return NULL;
-
-	n = ctl->btmp_size - 1;
-	do {
-		if (!strncmp(username, ctl->btmp[n].ut_user,
-		             sizeof(ctl->wtmp[0].ut_user)))
-			return ctl->btmp + n;
-	}while (n--);
-	return NULL;
-
+	size_t i;
+	for (i = 0; i < ncolumns; i++)
+		if (columns[i] == COL_SGROUPS || columns[i] == COL_SGIDS)
+			return 1;
+	return 0;
 }
 
 static int parse_utmpx(const char *path, size_t *nrecords, struct utmpx **records)
@@ -533,52 +627,83 @@ fail:
 }
 
 #ifdef HAVE_LIBLASTLOG2
+static int collect_lastlog2_entry(const char *user, int64_t ll_time,
+				  const char *tty, const char *rhost,
+				  const char *pam_service __attribute__((__unused__)),
+				  const char *cb_error __attribute__((__unused__)))
+{
+	struct lslogins_logdata *data = get_logdata(ll2_collector, user, 1);
+
+	free(data->ll2_tty);
+	free(data->ll2_host);
+
+	data->ll2_time = ll_time;
+	data->ll2_tty = tty ? xstrdup(tty) : NULL;
+	data->ll2_host = rhost ? xstrdup(rhost) : NULL;
+	data->has_ll2 = 1;
+	return 0;
+}
+
+/*
+ * Read the whole lastlog2 database at once rather than to query it for each
+ * user. The users not found in the database (or all of them if the database
+ * is not readable) fall back to the old lastlog file.
+ */
+static void collect_lastlog2(struct lslogins_control *ctl)
+{
+	ll2_collector = ctl;
+	ll2_read_all(ctl->ll2_context, collect_lastlog2_entry, NULL);
+	ll2_collector = NULL;
+
+	ctl->ll2_collected = 1;
+}
+
 static int get_lastlog2(struct lslogins_control *ctl, const char *user, void *dst, int what)
 {
-	struct ll2_context *context = ll2_new_context(ctl->lastlog2_path);
+	int64_t res_time = 0;
+	char *res_tty = NULL, *res_host = NULL;
+	const char *tty, *host;
+
+	if (ctl->ll2_collected) {
+		struct lslogins_logdata *data = get_logdata(ctl, user, 0);
+
+		if (!data || !data->has_ll2)
+			return -1;
+		res_time = data->ll2_time;
+		tty = data->ll2_tty;
+		host = data->ll2_host;
+	} else {
+		if (ll2_read_entry(ctl->ll2_context, user,
+				   what == LASTLOG_TIME ? &res_time : NULL,
+				   what == LASTLOG_LINE ? &res_tty : NULL,
+				   what == LASTLOG_HOST ? &res_host : NULL,
+				   NULL, NULL) != 0)
+			return -1;
+		tty = res_tty;
+		host = res_host;
+	}
 
 	switch (what) {
 	case LASTLOG_TIME: {
 		time_t *t = dst;
-		int64_t res_time = 0;
 
-		if (ll2_read_entry(context, user, &res_time, NULL, NULL, NULL, NULL) != 0) {
-			ll2_unref_context(context);
-			return -1;
-		}
 		*t = res_time;
 		break;
 	}
-	case LASTLOG_LINE: {
-		char *res_tty = NULL;
-
-		if (ll2_read_entry(context, user, NULL, &res_tty, NULL, NULL, NULL) != 0) {
-			ll2_unref_context(context);
-			return -1;
-		}
-		if (res_tty) {
-			mem2strcpy(dst, res_tty, strlen(res_tty), strlen(res_tty) + 1);
-			free (res_tty);
-		}
+	case LASTLOG_LINE:
+		if (tty)
+			mem2strcpy(dst, tty, strlen(tty), strlen(tty) + 1);
 		break;
-	}
-	case LASTLOG_HOST: {
-		char *res_host = NULL;
-
-		if (ll2_read_entry(context, user, NULL, NULL, &res_host, NULL, NULL) != 0) {
-			ll2_unref_context(context);
-			return -1;
-		}
-		if (res_host) {
-			mem2strcpy(dst, res_host, strlen(res_host), strlen(res_host) + 1);
-			free(res_host);
-		}
+	case LASTLOG_HOST:
+		if (host)
+			mem2strcpy(dst, host, strlen(host), strlen(host) + 1);
 		break;
-	}
 	default:
 		abort();
 	}
-	ll2_unref_context(context);
+
+	free(res_tty);
+	free(res_host);
 	return 0;
 }
 #endif
@@ -618,7 +743,41 @@ static void get_lastlog(struct lslogins_control *ctl, uid_t uid,
 	}
 }
 
-static int get_sgroups(gid_t **list, size_t *len, struct passwd *pwd)
+/*
+ * Read all groups by one getgrent() pass rather than to call getgrouplist()
+ * for each user. It makes sense only if all the users are listed.
+ */
+static void collect_groups(struct lslogins_control *ctl)
+{
+	struct group *grp;
+
+	setgrent();
+	while ((grp = getgrent())) {
+		char **mem;
+
+		for (mem = grp->gr_mem; mem && *mem; mem++) {
+			struct lslogins_logdata *data = get_logdata(ctl, *mem, 1);
+			size_t i;
+
+			for (i = 0; i < data->nsgroups; i++) {
+				if (data->sgroups[i] == grp->gr_gid)
+					break;
+			}
+			if (i < data->nsgroups)
+				continue;
+
+			data->sgroups = xreallocarray(data->sgroups,
+					data->nsgroups + 1, sizeof(gid_t));
+			data->sgroups[data->nsgroups++] = grp->gr_gid;
+		}
+	}
+	endgrent();
+
+	ctl->groups_collected = 1;
+}
+
+static int get_sgroups(struct lslogins_control *ctl,
+		       gid_t **list, size_t *len, struct passwd *pwd)
 {
 	size_t n = 0;
 	int ngroups = 0;
@@ -626,18 +785,33 @@ static int get_sgroups(gid_t **list, size_t *len, struct passwd *pwd)
 	*len = 0;
 	*list = NULL;
 
-	/* first let's get a supp. group count */
-	getgrouplist(pwd->pw_name, pwd->pw_gid, *list, &ngroups);
-	if (!ngroups)
-		return -1;
+	if (ctl->groups_collected) {
+		struct lslogins_logdata *data = get_logdata(ctl, pwd->pw_name, 0);
+		size_t i;
 
-	*list = xcalloc(1, ngroups * sizeof(gid_t));
+		/* the same order as from getgrouplist() */
+		ngroups = 1 + (data ? data->nsgroups : 0);
+		*list = xcalloc(ngroups, sizeof(gid_t));
+		(*list)[(*len)++] = pwd->pw_gid;
 
-	/* now for the actual list of GIDs */
-	if (-1 == getgrouplist(pwd->pw_name, pwd->pw_gid, *list, &ngroups))
-		return -1;
+		for (i = 0; data && i < data->nsgroups; i++) {
+			if (data->sgroups[i] != pwd->pw_gid)
+				(*list)[(*len)++] = data->sgroups[i];
+		}
+	} else {
+		/* first let's get a supp. group count */
+		getgrouplist(pwd->pw_name, pwd->pw_gid, *list, &ngroups);
+		if (!ngroups)
+			return -1;
 
-	*len = (size_t) ngroups;
+		*list = xcalloc(1, ngroups * sizeof(gid_t));
+
+		/* now for the actual list of GIDs */
+		if (-1 == getgrouplist(pwd->pw_name, pwd->pw_gid, *list, &ngroups))
+			return -1;
+
+		*len = (size_t) ngroups;
+	}
 
 	/* getgroups also returns the user's primary GID - dispose of it */
 	while (n < *len) {
@@ -655,20 +829,19 @@ static int get_sgroups(gid_t **list, size_t *len, struct passwd *pwd)
 #ifdef __linux__
 static int get_nprocs(const uid_t uid)
 {
-	DIR *dir;
-	struct dirent *d;
+	struct procfs_iter *it;
+	pid_t pid;
 	int nprocs = 0;
 
-	dir = opendir(_PATH_PROC);
-	if (!dir)
+	it = procfs_new_iter(NULL);
+	if (!it)
 		return 0;
 
-	while ((d = xreaddir(dir))) {
-		if (procfs_dirent_match_uid(dir, d, uid))
-			++nprocs;
-	}
+	procfs_iter_set_uid(it, uid);
+	while (procfs_iter_next(it, &pid) == 0)
+		++nprocs;
 
-	closedir(dir);
+	procfs_free_iter(it);
 	return nprocs;
 }
 #endif
@@ -848,7 +1021,7 @@ static struct lslogins_user *get_user_info(struct lslogins_control *ctl, const c
 		case COL_SGROUPS:
 		case COL_SGIDS:
 			if (!user->nsgroups &&
-			    get_sgroups(&user->sgroups, &user->nsgroups, pwd) < 0)
+			    get_sgroups(ctl, &user->sgroups, &user->nsgroups, pwd) < 0)
 				err(EXIT_FAILURE, _("failed to get supplementary groups"));
 			break;
 		case COL_HOME:
@@ -1105,6 +1278,7 @@ static void free_ctl(struct lslogins_control *ctl)
 
 	free(ctl->wtmp);
 	free(ctl->btmp);
+	tdestroy(ctl->logdata, free_logdata);
 
 	while (n < ctl->ulsiz)
 		free(ctl->ulist[n++]);
@@ -1799,15 +1973,27 @@ int main(int argc, char *argv[])
 					 &ncolumns, column_name_to_id) < 0)
 		return EXIT_FAILURE;
 
+	if (logins || groups)
+		get_ulist(ctl, logins, groups);
+
 	if (require_wtmp()) {
 		parse_utmpx(path_wtmp, &ctl->wtmp_size, &ctl->wtmp);
+		index_utmpx(ctl, ctl->wtmp, ctl->wtmp_size, 0);
 		ctl->lastlogin_fd = open(path_lastlog, O_RDONLY, 0);
+#ifdef HAVE_LIBLASTLOG2
+		ctl->ll2_context = ll2_new_context(ctl->lastlog2_path);
+		if (!ctl->ll2_context)
+			err_oom();
+		if (!ctl->ulist_on)
+			collect_lastlog2(ctl);
+#endif
 	}
-	if (require_btmp())
+	if (require_btmp()) {
 		parse_utmpx(path_btmp, &ctl->btmp_size, &ctl->btmp);
-
-	if (logins || groups)
-		get_ulist(ctl, logins, groups);
+		index_utmpx(ctl, ctl->btmp, ctl->btmp_size, 1);
+	}
+	if (require_sgroups() && !ctl->ulist_on)
+		collect_groups(ctl);
 
 	if (create_usertree(ctl))
 		return EXIT_FAILURE;
@@ -1819,6 +2005,9 @@ int main(int argc, char *argv[])
 
 	if (ctl->lastlogin_fd >= 0)
 		close(ctl->lastlogin_fd);
+#ifdef HAVE_LIBLASTLOG2
+	ll2_unref_context(ctl->ll2_context);
+#endif
 	free_ctl(ctl);
 
 	return EXIT_SUCCESS;
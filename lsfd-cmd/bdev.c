@@ -40,7 +40,7 @@ static bool bdev_fill_column(struct proc *proc __attribute__((__unused__)),
 
 	switch(column_id) {
 	case COL_TYPE:
-		if (scols_line_set_data(ln, column_index, "BLK"))
+		if (scols_line_refer_static_data(ln, column_index, "BLK"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_BLKDRV:
@@ -52,7 +52,7 @@ static bool bdev_fill_column(struct proc *proc __attribute__((__unused__)),
 				  major(file->stat.st_rdev));
 		break;
 	case COL_DEVTYPE:
-		if (scols_line_set_data(ln, column_index,
+		if (scols_line_refer_static_data(ln, column_index,
 					"blk"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
@@ -106,14 +106,22 @@ static void free_partition(struct partition *partition)
 
 static void read_partitions(struct list_head *partitions_list, FILE *part_fp)
 {
-	unsigned int major, minor;
 	char line[256];
-	char name[sizeof(line)];
 
+	/* "major minor  #blocks  name" */
 	while (fgets(line, sizeof(line), part_fp)) {
 		struct partition *partition;
+		uint64_t major, minor, blocks;
+		const char *p;
+		char *name;
 
-		if (sscanf(line, "%u %u %*u %s", &major, &minor, name) != 3)
+		if (!(p = ul_scan_u64(skip_blank(line), NULL, &major))
+		    || !(p = ul_scan_u64(skip_blank(p), NULL, &minor))
+		    || !(p = ul_scan_u64(skip_blank(p), NULL, &blocks)))
+			continue;
+		name = (char *) skip_blank(p);
+		name[strcspn(name, " \t\n")] = '\0';
+		if (!*name)
 			continue;
 		partition = new_partition(makedev(major, minor), name);
 		list_add_tail(&partition->partitions, partitions_list);
@@ -82,11 +82,11 @@ static bool cdev_fill_column(struct proc *proc __attribute__((__unused__)),
 		}
 		return false;
 	case COL_TYPE:
-		if (scols_line_set_data(ln, column_index, "CHR"))
+		if (scols_line_refer_static_data(ln, column_index, "CHR"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_DEVTYPE:
-		if (scols_line_set_data(ln, column_index,
+		if (scols_line_refer_static_data(ln, column_index,
 					"char"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
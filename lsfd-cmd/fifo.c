@@ -51,7 +51,7 @@ static bool fifo_fill_column(struct proc *proc __attribute__((__unused__)),
 
 	switch(column_id) {
 	case COL_TYPE:
-		if (scols_line_set_data(ln, column_index, "FIFO"))
+		if (scols_line_refer_static_data(ln, column_index, "FIFO"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_SOURCE:
@@ -134,13 +134,13 @@ static bool abst_fill_column(struct proc *proc,
 		return true;
 	case COL_USER:
 		add_uid(username_cache, (int)proc->uid);
-		if (scols_line_set_data(ln, column_index,
+		if (scols_line_refer_static_data(ln, column_index,
 					get_id(username_cache,
 					       (int)proc->uid)->name))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_DEVTYPE:
-		if (scols_line_set_data(ln, column_index,
+		if (scols_line_refer_static_data(ln, column_index,
 					"nodev"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
@@ -267,7 +267,7 @@ static bool error_fill_column(struct proc *proc __attribute__((__unused__)),
 
 	switch(column_id) {
 	case COL_TYPE:
-		if (scols_line_set_data(ln, column_index, "ERROR"))
+		if (scols_line_refer_static_data(ln, column_index, "ERROR"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_SOURCE:
@@ -432,7 +432,7 @@ static bool file_fill_column(struct proc *proc __attribute__((__unused__)),
 	case COL_STTYPE:
 	case COL_TYPE:
 		ftype = file->stat.st_mode & S_IFMT;
-		if (scols_line_set_data(ln, column_index, strftype(ftype)))
+		if (scols_line_refer_static_data(ln, column_index, strftype(ftype)))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_INODE:
@@ -556,6 +556,8 @@ static int file_handle_fdinfo(struct file *file, const char *key, const char* va
 
 	} else if (strcmp(key, "flags") == 0) {
 		rc = ul_strtou32(value, &file->sys_flags, 8);
+		if (rc == 0)
+			file->has_sys_flags = 1;
 
 	} else if (strcmp(key, "mnt_id") == 0) {
 		rc = ul_strtou32(value, &file->mnt_id, 10);
@@ -579,11 +581,6 @@ static int file_handle_fdinfo(struct file *file, const char *key, const char* va
 	return 1;		/* success */
 }
 
-static void file_free_content(struct file *file)
-{
-	free(file->name);
-}
-
 static unsigned long get_minor_for_sysvipc(void)
 {
 	int id;
@@ -698,7 +695,6 @@ const struct file_class file_class = {
 	.finalize_class = NULL,
 	.fill_column = file_fill_column,
 	.handle_fdinfo = file_handle_fdinfo,
-	.free_content = file_free_content,
 };
 
 /*
@@ -814,7 +810,7 @@ static bool nsfs_file_fill_column(struct proc *proc __attribute__((__unused__)),
 			  (unsigned long long)file->stat.st_ino);
 		break;
 	case COL_NS_TYPE:
-		if (scols_line_set_data(ln, column_index,
+		if (scols_line_refer_static_data(ln, column_index,
 					get_ns_type_name(nsfs_file->clone_type)))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
@@ -880,7 +876,7 @@ static bool mqueue_file_fill_column(struct proc *proc __attribute__((__unused__)
 {
 	switch (column_id) {
 	case COL_TYPE:
-		if (scols_line_set_data(ln, column_index, "mqueue"))
+		if (scols_line_refer_static_data(ln, column_index, "mqueue"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_ENDPOINTS: {
@@ -995,7 +991,7 @@ static bool pidfs_file_fill_column(struct proc *proc __attribute__((__unused__))
 
 	switch(column_id) {
 	case COL_TYPE:
-		if (scols_line_set_data(ln, column_index, "pidfd"))
+		if (scols_line_refer_static_data(ln, column_index, "pidfd"))
 			err(EXIT_FAILURE, _("failed to add output data"));
 		return true;
 	case COL_NAME:
@@ -38,6 +38,10 @@
 #include <linux/sched.h>
 #include <sys/syscall.h>
 
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
 #ifdef HAVE_LINUX_KCMP_H
 #  include <linux/kcmp.h>
 static int kcmp(pid_t pid1, pid_t pid2, int type,
@@ -73,6 +77,7 @@ static int kcmp(pid_t pid1 __attribute__((__unused__)),
 #define PF_KTHREAD		0x00200000	/* I am a kernel thread */
 
 #include "c.h"
+#include "all-io.h"
 #include "list.h"
 #include "closestream.h"
 #include "column-list-table.h"
@@ -170,6 +175,9 @@ struct colinfo {
 
 /* columns descriptions */
 static const struct colinfo infos[] = {
+	[COL_ACTION]           = { "ACTION",
+				   0,   0, SCOLS_JSON_STRING,
+				   N_("opened or closed file in --watch --changes output") },
 	[COL_AINODECLASS]      = { "AINODECLASS",
 				   0,   SCOLS_FL_RIGHT, SCOLS_JSON_STRING,
 				   N_("class of anonymous inode") },
@@ -542,6 +550,14 @@ struct filler_data {
 	struct file *file;
 };
 
+/* --changes output line, cells data separated by '\0' */
+struct lsfd_row {
+	char			*data;
+	size_t			size;
+	size_t			seq;		/* position in the output */
+	struct libscols_line	*ln;		/* current line or NULL */
+};
+
 struct lsfd_control {
 	struct libscols_table *tb;		/* output */
 	struct list_head procs;			/* list of all processes */
@@ -549,12 +565,21 @@ struct lsfd_control {
 	unsigned int	noheadings : 1,
 			raw : 1,
 			json : 1,
+			cbor : 1,
 			notrunc : 1,
 			threads : 1,
 			show_main : 1,		/* print main table */
 			show_summary : 1,	/* print summary/counters */
 			sockets_only : 1,	/* display only SOCKETS */
-			show_xmode : 1;		/* XMODE column is enabled. */
+			show_xmode : 1,		/* XMODE column is enabled. */
+			proc_filter : 1,	/* filter uses only process columns */
+			changes : 1;		/* --changes */
+
+	struct timespec	watch;			/* --watch interval */
+	struct lsfd_row	*rows;			/* --changes previous output */
+	size_t		nrows;
+
+	unsigned int	njobs;			/* --jobs */
 
 	struct libscols_filter *filter;		/* filter */
 	struct libscols_filter **ct_filters;	/* counters (NULL terminated array) */
@@ -686,6 +711,51 @@ static const struct file_class *stat2class(struct stat *sb)
 	return &unkn_class;
 }
 
+/*
+ * The same names (libraries, /dev/null, ...) are listed by most of the
+ * processes.  The pool keeps one copy of each name for all the files.
+ */
+static void *name_pool;		/* for tsearch/tfind */
+
+static int compare_names(const void *a, const void *b)
+{
+	return strcmp(a, b);
+}
+
+static const char *intern_name(const char *name)
+{
+	char **node, *p;
+
+	if (!name)
+		return NULL;
+
+	node = tfind(name, &name_pool, compare_names);
+	if (node)
+		return *node;
+
+	p = xstrdup(name);
+	if (tsearch(p, &name_pool, compare_names) == NULL)
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
+	return p;
+}
+
+static void free_name_pool(void)
+{
+	tdestroy(name_pool, free);
+	name_pool = NULL;
+}
+
+static void copy_file_stat(struct file_stat *dest, const struct stat *sb)
+{
+	dest->st_dev = sb->st_dev;
+	dest->st_rdev = sb->st_rdev;
+	dest->st_ino = sb->st_ino;
+	dest->st_size = sb->st_size;
+	dest->st_mode = sb->st_mode;
+	dest->st_uid = sb->st_uid;
+	dest->st_nlink = sb->st_nlink;
+}
+
 static struct file *new_file(struct proc *proc, const struct file_class *class,
 			     struct stat *sb, const char *name, int association)
 {
@@ -701,8 +771,8 @@ static struct file *new_file(struct proc *proc, const struct file_class *class,
 	list_add_tail(&file->files, &proc->files);
 
 	file->association = association;
-	file->name = xstrdup(name);
-	file->stat = *sb;
+	file->name = intern_name(name);
+	copy_file_stat(&file->stat, sb);
 
 	return file;
 }
@@ -742,7 +812,7 @@ static struct file *new_stat_error_file(struct proc *proc, const char *name, int
 	file->error.syscall = "stat";
 	file->error.number = error_no;
 	file->association = association;
-	file->name = xstrdup(name);
+	file->name = intern_name(name);
 
 	return file;
 }
@@ -757,7 +827,7 @@ static struct file *copy_file(struct file *old, int new_association)
 
 	file->class = old->class;
 	file->association = new_association;
-	file->name = xstrdup(old->name);
+	file->name = old->name;
 	file->stat = old->stat;
 
 	return file;
@@ -831,17 +901,188 @@ static void read_fdinfo(struct file *file, FILE *fdinfo)
 	}
 }
 
+/*
+ * The --jobs workers read /proc/#/{fd,fdinfo,maps} in advance, the data are
+ * later used (in the same order as without the workers) to create the files.
+ * The workers don't touch any lsfd global state.
+ */
+struct fd_prefetch {
+	uint64_t	num;
+	char		*sym;		/* readlink() result or NULL */
+	int		readlink_errno;
+	int		stat_errno;
+	struct stat	stat;
+	mode_t		mode;		/* from lstat(), 0 if unknown */
+	char		*fdinfo;
+	size_t		fdinfo_sz;
+
+	unsigned int	has_stat : 1;	/* stat() called (or failed) */
+};
+
+struct proc_prefetch {
+	pid_t			pid;
+	struct fd_prefetch	*fds;
+	size_t			nfds;
+	char			*maps;
+	size_t			maps_sz;
+
+	unsigned int		done : 1,	/* worker finished */
+				ok : 1;		/* data usable */
+};
+
+static ssize_t file_readlink(struct path_cxt *pc, const struct fd_prefetch *pf,
+			     char *buf, size_t bufsz, const char *name)
+{
+	if (!pf)
+		return ul_path_readlink(pc, buf, bufsz, name);
+	if (!pf->sym) {
+		errno = pf->readlink_errno;
+		return -1;
+	}
+	xstrncpy(buf, pf->sym, bufsz);
+	return strlen(buf);
+}
+
+static int file_stat(struct path_cxt *pc, const struct fd_prefetch *pf,
+		     struct stat *sb, int flags, const char *name)
+{
+	if (pf && (flags & AT_SYMLINK_NOFOLLOW) && pf->mode) {
+		sb->st_mode = pf->mode;
+		return 0;
+	}
+	if (pf && !(flags & AT_SYMLINK_NOFOLLOW) && pf->has_stat) {
+		if (pf->stat_errno) {
+			errno = pf->stat_errno;
+			return -1;
+		}
+		*sb = pf->stat;
+		return 0;
+	}
+	return ul_path_stat(pc, sb, flags, name);
+}
+
+static FILE *file_fdinfo(struct path_cxt *pc, const struct fd_prefetch *pf, int assoc)
+{
+	if (!pf)
+		return ul_path_fopenf(pc, "r", "fdinfo/%d", assoc);
+	if (!pf->fdinfo || !pf->fdinfo_sz)
+		return NULL;
+	return fmemopen(pf->fdinfo, pf->fdinfo_sz, "r");
+}
+
+/*
+ * The same socket, pipe or namespace is often opened by many processes.
+ * Such files are on pseudo filesystems with one superblock and the symlink
+ * names (e.g. "socket:[12345]") identify the inodes.  The cache keeps
+ * stat() results for the names to avoid stat() for each occurrence.
+ */
+struct stat_cache_entry {
+	char *name;
+	struct stat stat;
+};
+
+static void *stat_cache;	/* for tsearch/tfind */
+
+static int compare_stat_cache_entry(const void *a, const void *b)
+{
+	return strcmp(((const struct stat_cache_entry *)a)->name,
+		      ((const struct stat_cache_entry *)b)->name);
+}
+
+static void free_stat_cache_entry(void *data)
+{
+	struct stat_cache_entry *e = data;
+
+	free(e->name);
+	free(e);
+}
+
+/* "<type>:[<inode>]" */
+static bool is_stat_cacheable(const char *sym)
+{
+	const char *p = strstr(sym, ":[");
+	size_t len;
+
+	if (!p || p == sym || *sym == '/')
+		return false;
+	p += 2;
+	len = strspn(p, "0123456789");
+	return len && strcmp(p + len, "]") == 0;
+}
+
+static int cached_file_stat(struct path_cxt *pc, const struct fd_prefetch *pf,
+			    const char *sym, struct stat *sb, const char *name)
+{
+	struct stat_cache_entry key = { .name = (char *) sym }, *e, **node;
+	bool cacheable = is_stat_cacheable(sym);
+
+	if (cacheable) {
+		node = tfind(&key, &stat_cache, compare_stat_cache_entry);
+		if (node) {
+			*sb = (*node)->stat;
+			return 0;
+		}
+	}
+
+	if (file_stat(pc, pf, sb, 0, name) < 0)
+		return -1;
+
+	if (cacheable) {
+		e = xmalloc(sizeof(*e));
+		e->name = xstrdup(sym);
+		e->stat = *sb;
+		if (tsearch(e, &stat_cache, compare_stat_cache_entry) == NULL)
+			errx(EXIT_FAILURE, _("failed to allocate memory"));
+	}
+	return 0;
+}
+
+static void free_stat_cache(void)
+{
+	tdestroy(stat_cache, free_stat_cache_entry);
+	stat_cache = NULL;
+}
+
+/*
+ * Returns permissions of /proc/#/fd/# symlink for the open(2) flags, see
+ * tid_fd_update_inode() and OPEN_FMODE() in the kernel.
+ */
+static mode_t fdinfo_flags_to_mode(unsigned int flags)
+{
+	mode_t mode;
+
+#ifdef O_PATH
+	if (flags & O_PATH)
+		return 0;
+#endif
+	switch (flags & O_ACCMODE) {
+	case O_RDONLY:
+		mode = S_IRUSR;
+		break;
+	case O_WRONLY:
+		mode = S_IWUSR;
+		break;
+	case O_RDWR:
+		mode = S_IRUSR | S_IWUSR;
+		break;
+	default:
+		return 0;
+	}
+	return mode | S_IXUSR;
+}
+
 static struct file *collect_file_symlink(struct path_cxt *pc,
 					 struct proc *proc,
 					 const char *name,
 					 int assoc,
-					 bool sockets_only)
+					 bool sockets_only,
+					 const struct fd_prefetch *pf)
 {
 	char sym[PATH_MAX] = { '\0' };
 	struct stat sb;
 	struct file *f, *prev;
 
-	if (ul_path_readlink(pc, sym, sizeof(sym), name) < 0)
+	if (file_readlink(pc, pf, sym, sizeof(sym), name) < 0)
 		f = new_readlink_error_file(proc, errno, assoc);
 	/* The /proc/#/{fd,ns} often contains the same file (e.g. /dev/tty)
 	 * more than once. Let's try to reuse the previous file if the real
@@ -851,7 +1092,7 @@ static struct file *collect_file_symlink(struct path_cxt *pc,
 		 && (!prev->is_error)
 		 && prev->name && strcmp(prev->name, sym) == 0)
 		f = copy_file(prev, assoc);
-	else if (ul_path_stat(pc, &sb, 0, name) < 0)
+	else if (cached_file_stat(pc, pf, sym, &sb, name) < 0)
 		f = new_stat_error_file(proc, sym, errno, assoc);
 	else {
 		const struct file_class *class = stat2class(&sb);
@@ -883,17 +1124,20 @@ static struct file *collect_file_symlink(struct path_cxt *pc,
 		/* file-descriptor based association */
 		FILE *fdinfo;
 
-		if (ul_path_stat(pc, &sb, AT_SYMLINK_NOFOLLOW, name) == 0)
-			f->mode = sb.st_mode;
-
 		if (is_nsfs_dev(f->stat.st_dev))
 			load_sock_xinfo(pc, name, f->stat.st_ino);
 
-		fdinfo = ul_path_fopenf(pc, "r", "fdinfo/%d", assoc);
+		fdinfo = file_fdinfo(pc, pf, assoc);
 		if (fdinfo) {
 			read_fdinfo(f, fdinfo);
 			fclose(fdinfo);
 		}
+
+		/* The access mode from fdinfo saves lstat() of the symlink */
+		if (f->has_sys_flags)
+			f->mode = fdinfo_flags_to_mode(f->sys_flags);
+		else if (file_stat(pc, pf, &sb, AT_SYMLINK_NOFOLLOW, name) == 0)
+			f->mode = sb.st_mode;
 	}
 
 	return f;
@@ -902,12 +1146,24 @@ static struct file *collect_file_symlink(struct path_cxt *pc,
 /* read symlinks from /proc/#/fd
  */
 static void collect_fd_files(struct path_cxt *pc, struct proc *proc,
-			     bool sockets_only)
+			     bool sockets_only, const struct proc_prefetch *pp)
 {
 	DIR *sub = NULL;
 	struct dirent *d = NULL;
 	char path[sizeof("fd/") + sizeof(stringify_value(UINT64_MAX))];
 
+	if (pp) {
+		size_t i;
+
+		for (i = 0; i < pp->nfds; i++) {
+			const struct fd_prefetch *pf = &pp->fds[i];
+
+			snprintf(path, sizeof(path), "fd/%ju", (uintmax_t) pf->num);
+			collect_file_symlink(pc, proc, path, pf->num, sockets_only, pf);
+		}
+		return;
+	}
+
 	while (ul_path_next_dirent(pc, &sub, "fd", &d) == 0) {
 		uint64_t num;
 
@@ -915,30 +1171,127 @@ static void collect_fd_files(struct path_cxt *pc, struct proc *proc,
 			continue;
 
 		snprintf(path, sizeof(path), "fd/%ju", (uintmax_t) num);
-		collect_file_symlink(pc, proc, path, num, sockets_only);
+		collect_file_symlink(pc, proc, path, num, sockets_only, NULL);
+	}
+}
+
+/*
+ * The mapped libraries and binaries are usually the same for many processes.
+ * The cache keeps stat() results for the (dev, ino) pairs from the maps.
+ */
+struct maps_stat_entry {
+	dev_t dev;
+	ino_t ino;
+	struct stat stat;
+};
+
+static void *maps_stat_cache;	/* for tsearch/tfind */
+
+static int compare_maps_stat_entry(const void *a, const void *b)
+{
+	const struct maps_stat_entry *A = a, *B = b;
+
+	if (A->dev != B->dev)
+		return A->dev < B->dev ? -1 : 1;
+	if (A->ino != B->ino)
+		return A->ino < B->ino ? -1 : 1;
+	return 0;
+}
+
+static int maps_stat(const char *path, dev_t dev, ino_t ino, struct stat *sb)
+{
+	struct maps_stat_entry key = { .dev = dev, .ino = ino }, *e, **node;
+
+	node = tfind(&key, &maps_stat_cache, compare_maps_stat_entry);
+	if (node) {
+		*sb = (*node)->stat;
+		return 0;
+	}
+	if (stat(path, sb) < 0)
+		return -1;
+
+	/* cache only if the path is really the mapped file */
+	if (sb->st_dev == dev && sb->st_ino == ino) {
+		e = xmalloc(sizeof(*e));
+		e->dev = dev;
+		e->ino = ino;
+		e->stat = *sb;
+		if (tsearch(e, &maps_stat_cache, compare_maps_stat_entry) == NULL)
+			errx(EXIT_FAILURE, _("failed to allocate memory"));
 	}
+	return 0;
+}
+
+static void free_maps_stat_cache(void)
+{
+	tdestroy(maps_stat_cache, free);
+	maps_stat_cache = NULL;
+}
+
+static char *parse_maps_hex(char *p, uint64_t *res)
+{
+	uint64_t x = 0;
+	char *begin = p;
+
+	for (;; p++) {
+		if (*p >= '0' && *p <= '9')
+			x = (x << 4) | (*p - '0');
+		else if (*p >= 'a' && *p <= 'f')
+			x = (x << 4) | (*p - 'a' + 10);
+		else
+			break;
+	}
+	*res = x;
+	return p == begin ? NULL : p;
+}
+
+static char *parse_maps_dec(char *p, uint64_t *res)
+{
+	uint64_t x = 0;
+	char *begin = p;
+
+	for (; *p >= '0' && *p <= '9'; p++)
+		x = x * 10 + (*p - '0');
+	*res = x;
+	return p == begin ? NULL : p;
+}
+
+/* "start-end mode offset maj:min inode [path]" */
+static bool parse_maps_fields(char *buf, uint64_t *start, uint64_t *end,
+			      char **modestr, uint64_t *offset,
+			      uint64_t *major, uint64_t *minor, uint64_t *ino)
+{
+	char *p = buf;
+
+	if (!(p = parse_maps_hex(p, start)) || *p++ != '-'
+	    || !(p = parse_maps_hex(p, end)) || *p++ != ' ')
+		return false;
+
+	*modestr = p;
+	if (strnlen(p, 4) < 4 || p[4] != ' ')
+		return false;
+	p += 5;
+
+	if (!(p = parse_maps_hex(p, offset)) || *p++ != ' '
+	    || !(p = parse_maps_hex(p, major)) || *p++ != ':'
+	    || !(p = parse_maps_hex(p, minor)) || *p++ != ' '
+	    || !(p = parse_maps_dec(p, ino)))
+		return false;
+
+	return true;
 }
 
 static void parse_maps_line(struct path_cxt *pc, char *buf, struct proc *proc)
 {
-	uint64_t start, end, offset, ino;
-	unsigned long major, minor;
+	uint64_t start, end, offset, ino, major, minor;
 	enum association assoc = ASSOC_MEM;
 	struct stat sb;
 	struct file *f, *prev;
-	char *path, modestr[5];
+	char *path, *modestr;
 	dev_t devno;
 
-	/* read rest of the map */
-	if (sscanf(buf, "%"SCNx64		/* start */
-			"-%"SCNx64		/* end */
-			" %4[^ ]"		/* mode */
-			" %"SCNx64		/* offset */
-			" %lx:%lx"		/* maj:min */
-			" %"SCNu64,		/* inode */
-
-			&start, &end, modestr, &offset,
-			&major, &minor, &ino) != 7)
+	if (!parse_maps_fields(buf, &start, &end, &modestr, &offset,
+			       &major, &minor, &ino))
 		return;
 
 	/* Skip private anonymous mappings. */
@@ -960,7 +1313,7 @@ static void parse_maps_line(struct path_cxt *pc, char *buf, struct proc *proc)
 		f = copy_file(prev, -assoc);
 	else if ((path = strchr(buf, '/'))) {
 		rtrim_whitespace((unsigned char *) path);
-		if (stat(path, &sb) < 0)
+		if (maps_stat(path, devno, ino, &sb) < 0)
 			/* If a file is mapped but deleted from the file system,
 			 * "stat by the file name" may not work. In that case,
 			 */
@@ -995,19 +1348,39 @@ static void parse_maps_line(struct path_cxt *pc, char *buf, struct proc *proc)
 	file_init_content(f);
 }
 
-static void collect_mem_files(struct path_cxt *pc, struct proc *proc)
+static void collect_mem_files(struct path_cxt *pc, struct proc *proc,
+			      const struct proc_prefetch *pp)
 {
-	FILE *fp;
-	char buf[BUFSIZ];
+	char *buf = NULL, *line, *end;
+	ssize_t sz;
 
-	fp = ul_path_fopen(pc, "r", "maps");
-	if (!fp)
-		return;
+	/* read the whole file by one read(), the lines are parsed in place */
+	if (pp) {
+		buf = pp->maps;
+		sz = pp->maps_sz;
+	} else {
+		int fd = ul_path_open(pc, O_RDONLY | O_CLOEXEC, "maps");
 
-	while (fgets(buf, sizeof(buf), fp))
-		parse_maps_line(pc, buf, proc);
+		if (fd < 0)
+			return;
+		sz = read_all_alloc(fd, &buf);
+		close(fd);
+	}
+	if (sz <= 0 || !buf)
+		goto done;
 
-	fclose(fp);
+	for (line = buf, end = buf + sz; line < end; ) {
+		char *eol = memchr(line, '\n', end - line);
+
+		if (!eol)
+			break;		/* no incomplete lines */
+		*eol = '\0';
+		parse_maps_line(pc, line, proc);
+		line = eol + 1;
+	}
+done:
+	if (!pp)
+		free(buf);
 }
 
 static void collect_outofbox_files(struct path_cxt *pc,
@@ -1021,7 +1394,7 @@ static void collect_outofbox_files(struct path_cxt *pc,
 
 	for (i = 0; i < count; i++)
 		collect_file_symlink(pc, proc, names[assocs[i]], assocs[i] * -1,
-				     sockets_only);
+				     sockets_only, NULL);
 }
 
 static void collect_execve_file(struct path_cxt *pc, struct proc *proc,
@@ -1259,11 +1632,13 @@ static void finalize_nodevs(void)
 
 	if (self_mntns_fd >= 0)
 		close(self_mntns_fd);
+	self_mntns_fd = -1;
 
 	for (i = 0; i < NODEV_TABLE_SIZE; i++)
 		list_free(&nodev_table.tables[i], struct nodev, nodevs, free_nodev);
 
 	tdestroy(mnt_namespaces, free_mnt_ns);
+	mnt_namespaces = NULL;
 }
 
 const char *get_nodev_filesystem(unsigned long minor)
@@ -1519,7 +1894,7 @@ static void convert(struct list_head *procs, struct lsfd_control *ctl)
 	}
 }
 
-static void delete(struct list_head *procs, struct lsfd_control *ctl)
+static void delete_procs(struct list_head *procs)
 {
 	struct list_head *p;
 
@@ -1528,6 +1903,12 @@ static void delete(struct list_head *procs, struct lsfd_control *ctl)
 		tdelete(proc, &proc_tree, proc_tree_compare);
 	}
 	list_free(procs, struct proc, procs, free_proc);
+	free_name_pool();
+}
+
+static void delete(struct list_head *procs, struct lsfd_control *ctl)
+{
+	delete_procs(procs);
 
 	scols_unref_table(ctl->tb);
 	scols_unref_filter(ctl->filter);
@@ -1545,6 +1926,140 @@ static void emit(struct lsfd_control *ctl)
 	scols_print_table(ctl->tb);
 }
 
+static int compare_rows(const void *a, const void *b)
+{
+	const struct lsfd_row *ra = a, *rb = b;
+	int rc = memcmp(ra->data, rb->data, min(ra->size, rb->size));
+
+	if (rc == 0)
+		rc = ra->size < rb->size ? -1 : ra->size > rb->size ? 1 : 0;
+	return rc;
+}
+
+static int compare_rows_seq(const void *a, const void *b)
+{
+	const struct lsfd_row *ra = *(const struct lsfd_row **) a;
+	const struct lsfd_row *rb = *(const struct lsfd_row **) b;
+
+	return ra->seq < rb->seq ? -1 : ra->seq > rb->seq ? 1 : 0;
+}
+
+static void line_to_row(struct libscols_line *ln, struct lsfd_row *row, size_t seq)
+{
+	size_t i;
+
+	row->ln = ln;
+	row->seq = seq;
+	row->data = NULL;
+	row->size = 0;
+
+	for (i = 0; i < ncolumns; i++) {
+		const char *data;
+		size_t sz;
+
+		if (get_column_id(i) == COL_ACTION)
+			continue;
+		data = scols_cell_get_data(scols_line_get_cell(ln, i));
+		if (!data)
+			data = "";
+		sz = strlen(data) + 1;
+		row->data = xrealloc(row->data, row->size + sz);
+		memcpy(row->data + row->size, data, sz);
+		row->size += sz;
+	}
+}
+
+static void set_action(struct libscols_line *ln, const char *action)
+{
+	size_t i;
+
+	for (i = 0; i < ncolumns; i++) {
+		if (get_column_id(i) == COL_ACTION
+		    && scols_line_set_data(ln, i, action))
+			err(EXIT_FAILURE, _("failed to add output data"));
+	}
+}
+
+static void row_to_line(struct lsfd_control *ctl, const struct lsfd_row *row)
+{
+	struct libscols_line *ln = scols_table_new_line(ctl->tb, NULL);
+	const char *p = row->data;
+	size_t i;
+
+	if (!ln)
+		err(EXIT_FAILURE, _("failed to allocate output line"));
+
+	for (i = 0; i < ncolumns; i++) {
+		if (get_column_id(i) == COL_ACTION)
+			continue;
+		if (*p && scols_line_set_data(ln, i, p))
+			err(EXIT_FAILURE, _("failed to add output data"));
+		p += strlen(p) + 1;
+	}
+	set_action(ln, "close");
+}
+
+/*
+ * Compares the lines in the table with the lines from the previous call,
+ * keeps only the new lines and adds the disappeared lines.
+ */
+static void emit_changes(struct lsfd_control *ctl, bool print)
+{
+	struct libscols_iter *itr;
+	struct libscols_line *ln;
+	struct lsfd_row *rows, **closed;
+	size_t i = 0, j = 0, nclosed = 0, nrows = scols_table_get_nlines(ctl->tb);
+
+	rows = nrows ? xcalloc(nrows, sizeof(*rows)) : NULL;
+	closed = ctl->nrows ? xcalloc(ctl->nrows, sizeof(*closed)) : NULL;
+
+	itr = scols_new_iter(SCOLS_ITER_FORWARD);
+	if (!itr)
+		err(EXIT_FAILURE, _("failed to allocate iterator"));
+	while (scols_table_next_line(ctl->tb, itr, &ln) == 0) {
+		line_to_row(ln, &rows[i], i);
+		i++;
+	}
+	scols_free_iter(itr);
+
+	qsort(rows, nrows, sizeof(*rows), compare_rows);
+
+	/* the rows are sorted, so it's possible to merge them */
+	i = 0;
+	while (i < nrows || j < ctl->nrows) {
+		int rc = i == nrows ? 1 :
+			 j == ctl->nrows ? -1 :
+			 compare_rows(&rows[i], &ctl->rows[j]);
+
+		if (rc < 0)
+			set_action(rows[i++].ln, "open");
+		else if (rc > 0)
+			closed[nclosed++] = &ctl->rows[j++];
+		else {
+			scols_table_remove_line(ctl->tb, rows[i++].ln);
+			j++;
+		}
+	}
+
+	/* the closed files in the order of the previous output */
+	qsort(closed, nclosed, sizeof(*closed), compare_rows_seq);
+	for (i = 0; i < nclosed; i++)
+		row_to_line(ctl, closed[i]);
+	free(closed);
+
+	if (print && scols_table_get_nlines(ctl->tb))
+		emit(ctl);
+
+	for (j = 0; j < ctl->nrows; j++)
+		free(ctl->rows[j].data);
+	free(ctl->rows);
+
+	for (i = 0; i < nrows; i++)
+		rows[i].ln = NULL;
+	ctl->rows = rows;
+	ctl->nrows = nrows;
+}
+
 
 static void initialize_class(const struct file_class *class)
 {
@@ -1727,11 +2242,9 @@ unsigned long add_name(struct name_manager *nm, const char *name)
 	if (e)
 		return e->id;
 
-	e = xmalloc(sizeof(struct identry));
-	e->name = xstrdup(name);
-	e->id = nm->next_id++;
-	e->next = nm->cache->ent;
-	nm->cache->ent = e;
+	e = add_id(nm->cache, name, nm->next_id++);
+	if (!e)
+		err(EXIT_FAILURE, _("failed to allocate an idcache entry"));
 
 	return e->id;
 }
@@ -1900,10 +2413,40 @@ static void parse_proc_syscall(struct lsfd_control *ctl __attribute__((__unused_
 }
 
 static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
-			 pid_t pid, struct proc *leader)
+			 pid_t pid, struct proc *leader);
+
+/*
+ * Evaluates the filter with process columns only (see is_proc_filter()).
+ * The filter is applied again in convert(), so this is only a shortcut to
+ * not read files of the processes which cannot match.
+ */
+static bool match_proc_filter(struct lsfd_control *ctl, struct proc *proc)
+{
+	struct file file = { .class = &abst_class, .proc = proc, .association = -1 };
+	struct filler_data fid = { .proc = proc, .file = &file };
+	struct libscols_line *ln;
+	int status = 0;
+
+	ln = scols_new_line();
+	if (!ln || scols_line_alloc_cells(ln, ncolumns) != 0)
+		err(EXIT_FAILURE, _("failed to allocate output line"));
+
+	scols_filter_set_filler_cb(ctl->filter, filter_filler_cb, (void *) &fid);
+	if (scols_line_apply_filter(ln, ctl->filter, &status))
+		err(EXIT_FAILURE, _("failed to apply filter"));
+
+	scols_unref_line(ln);
+	return status != 0;
+}
+
+/* @pp is data read in advance by --jobs workers or NULL */
+static void __read_process(struct lsfd_control *ctl, struct path_cxt *pc,
+			   pid_t pid, struct proc *leader,
+			   const struct proc_prefetch *pp)
 {
 	char buf[BUFSIZ];
 	struct proc *proc;
+	bool skip_files = false;
 
 	if (procfs_process_init_path(pc, pid) != 0)
 		return;
@@ -1936,10 +2479,19 @@ static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
 		goto out;
 	}
 
-	collect_execve_file(pc, proc, ctl->sockets_only);
+	/* The process is still registered (for its threads and for pidfd
+	 * names), only the expensive reading of the files is skipped. The
+	 * namespaces are read anyway, they are global lsfd state.
+	 */
+	if (ctl->proc_filter && !match_proc_filter(ctl, proc))
+		skip_files = true;
+
+	if (!skip_files)
+		collect_execve_file(pc, proc, ctl->sockets_only);
 
-	if (proc->pid == proc->leader->pid
-	    || kcmp(proc->leader->pid, proc->pid, KCMP_FS, 0, 0) != 0)
+	if (!skip_files
+	    && (proc->pid == proc->leader->pid
+		|| kcmp(proc->leader->pid, proc->pid, KCMP_FS, 0, 0) != 0))
 		collect_fs_files(pc, proc, ctl->sockets_only);
 
 	/* Reading /proc/$pid/mountinfo is expensive.
@@ -1992,20 +2544,21 @@ static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
 	 * In such cases, we must pay the costs: call collect_mem_files()
 	 * and collect_fd_files().
 	 */
-	if ((!ctl->sockets_only)
+	if (!skip_files && !ctl->sockets_only
 	    && (proc->pid == proc->leader->pid
 		|| kcmp(proc->leader->pid, proc->pid, KCMP_VM, 0, 0) != 0))
-		collect_mem_files(pc, proc);
+		collect_mem_files(pc, proc, pp);
 
-	if (proc->pid == proc->leader->pid
-	    || kcmp(proc->leader->pid, proc->pid, KCMP_FILES, 0, 0) != 0)
-		collect_fd_files(pc, proc, ctl->sockets_only);
+	if (!skip_files
+	    && (proc->pid == proc->leader->pid
+		|| kcmp(proc->leader->pid, proc->pid, KCMP_FILES, 0, 0) != 0))
+		collect_fd_files(pc, proc, ctl->sockets_only, pp);
 
 	list_add_tail(&proc->procs, &ctl->procs);
 	if (tsearch(proc, &proc_tree, proc_tree_compare) == NULL)
 		errx(EXIT_FAILURE, _("failed to allocate memory"));
 
-	if (ctl->show_xmode)
+	if (ctl->show_xmode && !skip_files)
 		parse_proc_syscall(ctl, pc, pid, proc);
 
 	/* The tasks collecting overwrites @pc by /proc/<task-pid>/. Keep it as
@@ -2013,7 +2566,7 @@ static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
 	 */
 	if (ctl->threads && leader == NULL)
 		walk_threads(ctl, pc, pid, proc, read_process);
-	else if (ctl->show_xmode)
+	else if (ctl->show_xmode && !skip_files)
 		walk_threads(ctl, pc, pid, proc, parse_proc_syscall);
 
  out:
@@ -2021,6 +2574,12 @@ static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
 	ul_path_close_dirfd(pc);
 }
 
+static void read_process(struct lsfd_control *ctl, struct path_cxt *pc,
+			 pid_t pid, struct proc *leader)
+{
+	__read_process(ctl, pc, pid, leader, NULL);
+}
+
 static void parse_pids(const char *str, pid_t **pids, int *count)
 {
 	long v;
@@ -2072,30 +2631,249 @@ static bool member_pids(const pid_t pid, const pid_t pids[], const int count)
 	return bsearch(&pid, pids, count, sizeof(pid_t), pidcmp)? true: false;
 }
 
+static void free_proc_prefetch(struct proc_prefetch *pp)
+{
+	size_t i;
+
+	for (i = 0; i < pp->nfds; i++) {
+		free(pp->fds[i].sym);
+		free(pp->fds[i].fdinfo);
+	}
+	free(pp->fds);
+	free(pp->maps);
+	pp->fds = NULL;
+	pp->nfds = 0;
+	pp->maps = NULL;
+	pp->maps_sz = 0;
+}
+
+#ifdef HAVE_PTHREAD
+struct prefetch_pool {
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;		/* signaled when a proc is done */
+	struct proc_prefetch	*procs;
+	size_t			nprocs;
+	size_t			next;		/* the next proc for a worker */
+	bool			sockets_only;
+};
+
+static ssize_t read_file_alloc(struct path_cxt *pc, char **buf, const char *name)
+{
+	ssize_t sz;
+	int fd = ul_path_open(pc, O_RDONLY | O_CLOEXEC, name);
+
+	*buf = NULL;
+	if (fd < 0)
+		return -errno;
+	sz = read_all_alloc(fd, buf);
+	close(fd);
+	return sz;
+}
+
+/*
+ * Reads /proc/<pid>/{maps,fd/,fdinfo/}. It uses only the local @pc and
+ * plain allocations; on failure the data are not used and the process is
+ * read by read_process() as usual.
+ */
+static void prefetch_proc(struct path_cxt *pc, struct proc_prefetch *pp,
+			  bool sockets_only)
+{
+	DIR *sub = NULL;
+	struct dirent *d = NULL;
+	char path[sizeof("fdinfo/") + sizeof(stringify_value(UINT64_MAX))];
+	char sym[PATH_MAX];
+	size_t nalloc = 0;
+	ssize_t sz;
+
+	if (procfs_process_init_path(pc, pp->pid) != 0)
+		return;
+
+	if (!sockets_only) {
+		sz = read_file_alloc(pc, &pp->maps, "maps");
+		if (sz > 0)
+			pp->maps_sz = sz;
+	}
+
+	while (ul_path_next_dirent(pc, &sub, "fd", &d) == 0) {
+		struct fd_prefetch *pf, *prev;
+		struct stat sb;
+		uint64_t num;
+
+		if (ul_strtou64(d->d_name, &num, 10) != 0)	/* only numbers */
+			continue;
+
+		if (pp->nfds == nalloc) {
+			size_t n = nalloc ? nalloc * 2 : 32;
+			void *tmp = reallocarray(pp->fds, n, sizeof(*pp->fds));
+
+			if (!tmp)
+				goto fail;
+			pp->fds = tmp;
+			nalloc = n;
+		}
+		pf = &pp->fds[pp->nfds++];
+		memset(pf, 0, sizeof(*pf));
+		pf->num = num;
+		prev = pp->nfds > 1 ? pf - 1 : NULL;
+
+		snprintf(path, sizeof(path), "fd/%ju", (uintmax_t) num);
+		if (ul_path_readlink(pc, sym, sizeof(sym), path) < 0) {
+			pf->readlink_errno = errno;
+			continue;
+		}
+		pf->sym = strdup(sym);
+		if (!pf->sym)
+			goto fail;
+
+		/* collect_file_symlink() reuses the previous file with the
+		 * same path, stat() is called later only if really necessary */
+		if (!prev || !prev->sym || strcmp(prev->sym, sym) != 0) {
+			pf->has_stat = 1;
+			if (ul_path_stat(pc, &pf->stat, 0, path) < 0)
+				pf->stat_errno = errno;
+		}
+		snprintf(path, sizeof(path), "fdinfo/%ju", (uintmax_t) num);
+		sz = read_file_alloc(pc, &pf->fdinfo, path);
+		if (sz > 0)
+			pf->fdinfo_sz = sz;
+		else {
+			/* the mode is usually from fdinfo flags */
+			snprintf(path, sizeof(path), "fd/%ju", (uintmax_t) num);
+			if (ul_path_stat(pc, &sb, AT_SYMLINK_NOFOLLOW, path) == 0)
+				pf->mode = sb.st_mode;
+		}
+	}
+	pp->ok = 1;
+	ul_path_close_dirfd(pc);
+	return;
+fail:
+	if (sub)
+		closedir(sub);
+	free_proc_prefetch(pp);
+	ul_path_close_dirfd(pc);
+}
+
+static void *prefetch_worker(void *data)
+{
+	struct prefetch_pool *pool = (struct prefetch_pool *) data;
+	struct path_cxt *pc = ul_new_path(NULL);
+
+	do {
+		struct proc_prefetch *pp = NULL;
+
+		pthread_mutex_lock(&pool->lock);
+		if (pool->next < pool->nprocs)
+			pp = &pool->procs[pool->next++];
+		pthread_mutex_unlock(&pool->lock);
+
+		if (!pp)
+			break;
+		if (pc)
+			prefetch_proc(pc, pp, pool->sockets_only);
+
+		pthread_mutex_lock(&pool->lock);
+		pp->done = 1;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->lock);
+	} while (1);
+
+	ul_unref_path(pc);
+	return NULL;
+}
+
+/*
+ * The processes are read by the workers in parallel, but the data are
+ * consumed in the original order by the main thread, so the result is the
+ * same as for sequential reading.
+ */
+static void read_processes_parallel(struct lsfd_control *ctl, struct path_cxt *pc,
+				    const pid_t pids[], size_t npids)
+{
+	struct prefetch_pool pool = { .nprocs = npids, .sockets_only = ctl->sockets_only };
+	pthread_t *threads;
+	size_t i, nthreads = 0;
+
+	pool.procs = xcalloc(npids, sizeof(struct proc_prefetch));
+	threads = xcalloc(ctl->njobs, sizeof(pthread_t));
+
+	for (i = 0; i < npids; i++)
+		pool.procs[i].pid = pids[i];
+
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.cond, NULL);
+
+	for (i = 0; i < min((size_t) ctl->njobs, npids); i++) {
+		if (pthread_create(&threads[nthreads], NULL, prefetch_worker, &pool) != 0)
+			break;
+		nthreads++;
+	}
+
+	for (i = 0; i < npids; i++) {
+		struct proc_prefetch *pp = &pool.procs[i];
+
+		if (nthreads) {
+			pthread_mutex_lock(&pool.lock);
+			while (!pp->done)
+				pthread_cond_wait(&pool.cond, &pool.lock);
+			pthread_mutex_unlock(&pool.lock);
+		}
+		__read_process(ctl, pc, pp->pid, NULL, pp->ok ? pp : NULL);
+		free_proc_prefetch(pp);
+	}
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_cond_destroy(&pool.cond);
+	pthread_mutex_destroy(&pool.lock);
+	free(threads);
+	free(pool.procs);
+}
+#endif /* HAVE_PTHREAD */
+
 static void collect_processes(struct lsfd_control *ctl, const pid_t pids[], int n_pids)
 {
-	DIR *dir;
-	struct dirent *d;
+	struct procfs_iter *it;
 	struct path_cxt *pc = NULL;
+	pid_t *found = NULL, pid;
+	size_t nfound = 0, nalloc = 0;
 
 	pc = ul_new_path(NULL);
 	if (!pc)
 		err(EXIT_FAILURE, _("failed to alloc procfs handler"));
 
-	dir = opendir(_PATH_PROC);
-	if (!dir)
+	it = procfs_new_iter(NULL);
+	if (!it)
 		err(EXIT_FAILURE, _("failed to open /proc"));
 
-	while ((d = readdir(dir))) {
-		pid_t pid;
-
-		if (procfs_dirent_get_pid(d, &pid) != 0)
+	while (procfs_iter_next(it, &pid) == 0) {
+		if (n_pids != 0 && !member_pids(pid, pids, n_pids))
 			continue;
-		if (n_pids == 0 || member_pids(pid, pids, n_pids))
+		if (ctl->njobs <= 1) {
 			read_process(ctl, pc, pid, 0);
+			continue;
+		}
+		if (nfound == nalloc) {
+			nalloc = nalloc ? nalloc * 2 : 256;
+			found = xreallocarray(found, nalloc, sizeof(pid_t));
+		}
+		found[nfound++] = pid;
 	}
 
-	closedir(dir);
+	procfs_free_iter(it);
+
+#ifdef HAVE_PTHREAD
+	if (nfound)
+		read_processes_parallel(ctl, pc, found, nfound);
+#else
+	{
+		size_t i;
+
+		for (i = 0; i < nfound; i++)
+			read_process(ctl, pc, found[i], 0);
+	}
+#endif
+	free(found);
 	ul_unref_path(pc);
 }
 
@@ -2138,17 +2916,21 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -l, --threads                list in threads level\n"), out);
 	fputs(_(" -J, --json                   use JSON output format\n"), out);
+	fputs(_("     --cbor                   use CBOR (binary) output format\n"), out);
 	fputs(_(" -n, --noheadings             don't print headings\n"), out);
 	fputs(_(" -o, --output <list>          output columns (see --list-columns)\n"), out);
 	fputs(_(" -r, --raw                    use raw output format\n"), out);
 	fputs(_(" -u, --notruncate             don't truncate text in columns\n"), out);
 	fputs(_(" -p, --pid  <pid(s)>          collect information only specified processes\n"), out);
+	fputs(_(" -j, --jobs <num>             read processes by up to <num> threads\n"), out);
 	fputs(_(" -i[4|6], --inet[=4|=6]       list only IPv4 and/or IPv6 sockets\n"), out);
 	fputs(_(" -Q, --filter <expr>          apply display filter\n"), out);
 	fputs(_("     --debug-filter           dump the internal data structure of filter and exit\n"), out);
 	fputs(_(" -C, --counter <name>:<expr>  define custom counter for --summary output\n"), out);
 	fputs(_("     --dump-counters          dump counter definitions\n"), out);
 	fputs(_("     --summary[=<when>]       print summary information (only, append, or never)\n"), out);
+	fputs(_(" -w, --watch <seconds>        list files again after given interval\n"), out);
+	fputs(_("     --changes                print only opened and closed files (with --watch)\n"), out);
 	fputs(_("     --_drop-privilege        (testing purpose) do setuid(1) just after starting\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -2232,6 +3014,39 @@ static struct libscols_filter *new_filter(const char *expr, bool debug, struct l
 	return f;
 }
 
+/*
+ * Returns true if the filter depends only on columns known before the files
+ * of the process are read.
+ */
+static bool is_proc_filter(struct libscols_filter *f)
+{
+	struct libscols_iter *itr;
+	const char *name = NULL;
+	bool res = true;
+
+	itr = scols_new_iter(SCOLS_ITER_FORWARD);
+	if (!itr)
+		err(EXIT_FAILURE, _("failed to allocate iterator"));
+
+	while (res && scols_filter_next_holder(f, itr, &name, 0) == 0) {
+		switch (column_name_to_id(name, strlen(name))) {
+		case COL_COMMAND:
+		case COL_KTHREAD:
+		case COL_PID:
+		case COL_TID:
+		case COL_UID:
+		case COL_USER:
+			break;
+		default:
+			res = false;
+			break;
+		}
+	}
+
+	scols_free_iter(itr);
+	return res;
+}
+
 static struct counter_spec *new_counter_spec(const char *spec_str)
 {
 	char *sep;
@@ -2362,21 +3177,22 @@ static struct libscols_table *new_summary_table(struct lsfd_control *ctl)
 	scols_table_enable_noheadings(tb, ctl->noheadings);
 	scols_table_enable_raw(tb, ctl->raw);
 	scols_table_enable_json(tb, ctl->json);
+	scols_table_enable_cbor(tb, ctl->cbor);
 
-	if(ctl->json)
+	if(ctl->json || ctl->cbor)
 		scols_table_set_name(tb, "lsfd-summary");
 
 
 	value_cl = scols_table_new_column(tb, _("VALUE"), 0, SCOLS_FL_RIGHT);
 	if (!value_cl)
 		err(EXIT_FAILURE, _("failed to allocate summary column"));
-	if (ctl->json)
+	if (ctl->json || ctl->cbor)
 		scols_column_set_json_type(value_cl, SCOLS_JSON_NUMBER);
 
 	name_cl = scols_table_new_column(tb, _("COUNTER"), 0, 0);
 	if (!name_cl)
 		err(EXIT_FAILURE, _("failed to allocate summary column"));
-	if (ctl->json)
+	if (ctl->json || ctl->cbor)
 		scols_column_set_json_type(name_cl, SCOLS_JSON_STRING);
 
 	return tb;
@@ -2449,6 +3265,65 @@ static void set_multiplexed_flags(struct list_head *procs)
 	}
 }
 
+/* collect data and fill the output table */
+static void scan(struct lsfd_control *ctl, const pid_t pids[], int n_pids)
+{
+	/* The call initialize_ipc_table() must come before
+	 * initialize_classes.
+	 */
+	initialize_nodevs();
+	initialize_ipc_table();
+	initialize_classes();
+	initialize_devdrvs();
+
+	collect_processes(ctl, pids, n_pids);
+	free_stat_cache();
+	free_maps_stat_cache();
+
+	attach_xinfos(&ctl->procs);
+	if (ctl->show_xmode)
+		set_multiplexed_flags(&ctl->procs);
+
+	convert(&ctl->procs, ctl);
+}
+
+static void finalize_scan(struct lsfd_control *ctl)
+{
+	delete_procs(&ctl->procs);
+
+	finalize_devdrvs();
+	finalize_classes();
+	finalize_ipc_table();
+	finalize_nodevs();
+}
+
+/*
+ * Every interval is a complete scan. The data from /proc cannot be reused,
+ * the files are linked together by the ipc and socket tables and the
+ * /proc/#/fd directory timestamps don't follow open() and close().
+ */
+static void __attribute__((__noreturn__)) watch(struct lsfd_control *ctl,
+						 const pid_t pids[], int n_pids)
+{
+	bool first = true;
+
+	do {
+		scan(ctl, pids, n_pids);
+
+		if (ctl->changes)
+			emit_changes(ctl, !first);
+		else
+			emit(ctl);
+		fflush(stdout);
+
+		scols_table_remove_lines(ctl->tb);
+		finalize_scan(ctl);
+		first = false;
+
+		nanosleep(&ctl->watch, NULL);
+	} while (1);
+}
+
 /* Filter expressions for implementing -i option.
  *
  * To list up the protocol names, use the following command line
@@ -2495,6 +3370,8 @@ int main(int argc, char *argv[])
 		OPT_SUMMARY,
 		OPT_DUMP_COUNTERS,
 		OPT_DROP_PRIVILEGE,
+		OPT_CBOR,
+		OPT_CHANGES,
 	};
 	static const struct option longopts[] = {
 		{ "noheadings", no_argument, NULL, 'n' },
@@ -2502,10 +3379,12 @@ int main(int argc, char *argv[])
 		{ "version",    no_argument, NULL, 'V' },
 		{ "help",	no_argument, NULL, 'h' },
 		{ "json",       no_argument, NULL, 'J' },
+		{ "cbor",       no_argument, NULL, OPT_CBOR },
 		{ "raw",        no_argument, NULL, 'r' },
 		{ "threads",    no_argument, NULL, 'l' },
 		{ "notruncate", no_argument, NULL, 'u' },
 		{ "pid",        required_argument, NULL, 'p' },
+		{ "jobs",       required_argument, NULL, 'j' },
 		{ "inet",       optional_argument, NULL, 'i' },
 		{ "filter",     required_argument, NULL, 'Q' },
 		{ "debug-filter",no_argument, NULL, OPT_DEBUG_FILTER },
@@ -2513,6 +3392,8 @@ int main(int argc, char *argv[])
 		{ "counter",    required_argument, NULL, 'C' },
 		{ "dump-counters",no_argument, NULL, OPT_DUMP_COUNTERS },
 		{ "list-columns",no_argument, NULL, 'H' },
+		{ "watch",      required_argument, NULL, 'w' },
+		{ "changes",    no_argument, NULL, OPT_CHANGES },
 		{ "_drop-privilege",no_argument,NULL,OPT_DROP_PRIVILEGE },
 		{ NULL, 0, NULL, 0 },
 	};
@@ -2524,7 +3405,7 @@ int main(int argc, char *argv[])
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "no:JrVhluQ:p:i::C:sH", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "no:JrVhluQ:p:i::C:sHj:w:", longopts, NULL)) != -1) {
 		switch (c) {
 		case 'n':
 			ctl.noheadings = 1;
@@ -2535,6 +3416,9 @@ int main(int argc, char *argv[])
 		case 'J':
 			ctl.json = 1;
 			break;
+		case OPT_CBOR:
+			ctl.cbor = 1;
+			break;
 		case 'r':
 			ctl.raw = 1;
 			break;
@@ -2544,6 +3428,9 @@ int main(int argc, char *argv[])
 		case 'u':
 			ctl.notrunc = 1;
 			break;
+		case 'j':
+			ctl.njobs = strtou32_or_err(optarg, _("invalid jobs argument"));
+			break;
 		case 'p':
 			parse_pids(optarg, &pids, &n_pids);
 			break;
@@ -2592,6 +3479,15 @@ int main(int argc, char *argv[])
 		case OPT_DUMP_COUNTERS:
 			dump_counters = true;
 			break;
+		case 'w':
+			strtotimespec_or_err(optarg, &ctl.watch,
+					     _("failed to parse watch interval"));
+			if (!ctl.watch.tv_sec && !ctl.watch.tv_nsec)
+				errx(EXIT_FAILURE, _("invalid watch interval: %s"), optarg);
+			break;
+		case OPT_CHANGES:
+			ctl.changes = 1;
+			break;
 		case OPT_DROP_PRIVILEGE:
 			if (setuid(1) == -1)
 				err(EXIT_FAILURE, _("failed to drop privilege"));
@@ -2614,6 +3510,11 @@ int main(int argc, char *argv[])
 	if (argv[optind])
 		errtryhelp(EXIT_FAILURE);
 
+	if (ctl.changes && !ctl.watch.tv_sec && !ctl.watch.tv_nsec)
+		errx(EXIT_FAILURE, _("--changes requires --watch"));
+	if ((ctl.watch.tv_sec || ctl.watch.tv_nsec) && ctl.show_summary)
+		errx(EXIT_FAILURE, _("--watch cannot be used with --summary"));
+
 #define INITIALIZE_COLUMNS(COLUMN_SPEC)				\
 	for (i = 0; i < ARRAY_SIZE(COLUMN_SPEC); i++)	\
 		columns[ncolumns++] = COLUMN_SPEC[i]
@@ -2628,6 +3529,18 @@ int main(int argc, char *argv[])
 					    &ncolumns, column_name_to_id) < 0)
 		return EXIT_FAILURE;
 
+	if (ctl.changes) {
+		for (i = 0; i < ncolumns; i++) {
+			if (columns[i] == COL_ACTION)
+				break;
+		}
+		if (i == ncolumns && ncolumns < ARRAY_SIZE(columns)) {
+			memmove(columns + 1, columns, ncolumns * sizeof(columns[0]));
+			columns[0] = COL_ACTION;
+			ncolumns++;
+		}
+	}
+
 	scols_init_debug(0);
 
 	INIT_LIST_HEAD(&ctl.procs);
@@ -2640,7 +3553,8 @@ int main(int argc, char *argv[])
 	scols_table_enable_noheadings(ctl.tb, ctl.noheadings);
 	scols_table_enable_raw(ctl.tb, ctl.raw);
 	scols_table_enable_json(ctl.tb, ctl.json);
-	if (ctl.json)
+	scols_table_enable_cbor(ctl.tb, ctl.cbor);
+	if (ctl.json || ctl.cbor)
 		scols_table_set_name(ctl.tb, "lsfd");
 
 	/* create output columns */
@@ -2689,25 +3603,17 @@ int main(int argc, char *argv[])
 	if (scols_table_get_column_by_name(ctl.tb, "XMODE"))
 		ctl.show_xmode = 1;
 
-	/* collect data
-	 *
-	 * The call initialize_ipc_table() must come before
-	 * initialize_classes.
-	 */
-	initialize_nodevs();
-	initialize_ipc_table();
-	initialize_classes();
-	initialize_devdrvs();
-
-	collect_processes(&ctl, pids, n_pids);
-	free(pids);
-
-	attach_xinfos(&ctl.procs);
-	if (ctl.show_xmode)
-		set_multiplexed_flags(&ctl.procs);
+	/* ENDPOINTS needs the files of all processes */
+	if (ctl.filter && is_proc_filter(ctl.filter)
+	    && !scols_table_get_column_by_name(ctl.tb, "ENDPOINTS"))
+		ctl.proc_filter = 1;
 
+	if (ctl.watch.tv_sec || ctl.watch.tv_nsec)
+		watch(&ctl, pids, n_pids);
 
-	convert(&ctl.procs, &ctl);
+	/* collect data */
+	scan(&ctl, pids, n_pids);
+	free(pids);
 
 	/* print */
 	if (ctl.show_main)
@@ -2716,13 +3622,10 @@ int main(int argc, char *argv[])
 	if (ctl.show_summary && ctl.ct_filters)
 		emit_summary(&ctl);
 
-	/* cleanup */
+	/* cleanup, the lines refer to static data freed by finalize_scan() */
+	scols_table_remove_lines(ctl.tb);
+	finalize_scan(&ctl);
 	delete(&ctl.procs, &ctl);
 
-	finalize_devdrvs();
-	finalize_classes();
-	finalize_ipc_table();
-	finalize_nodevs();
-
 	return 0;
 }
@@ -55,6 +55,7 @@ UL_DEBUG_DECLARE_MASK(lsfd);
  * column IDs
  */
 enum {
+	COL_ACTION,
 	COL_AINODECLASS,
 	COL_ASSOC,
 	COL_BLKDRV,
@@ -184,19 +185,33 @@ struct proc *get_proc(pid_t pid);
 /*
  * File class
  */
+/*
+ * The part of struct stat the columns use.  The member names follow
+ * struct stat, so file->stat.st_xxx work for both.
+ */
+struct file_stat {
+	dev_t st_dev;
+	dev_t st_rdev;
+	ino_t st_ino;
+	off_t st_size;
+	mode_t st_mode;
+	uid_t st_uid;
+	nlink_t st_nlink;
+};
+
 struct file {
 	struct list_head files;
 	const struct file_class *class;
 	int association;
-	char *name;
+	mode_t mode;
+	const char *name;	/* in the name pool, don't free */
 	union {
-		struct stat stat;
+		struct file_stat stat;
 		struct {
 			int number;
 			const char *syscall;
 		} error;
 	};
-	mode_t mode;
 	struct proc *proc;
 
 	uint64_t pos;
@@ -209,7 +224,8 @@ struct file {
 	uint8_t locked_read:1,
 		locked_write:1,
 		multiplexed:1,
-		is_error:1;
+		is_error:1,
+		has_sys_flags:1;	/* sys_flags read from fdinfo */
 };
 
 #define is_opened_file(_f) ((_f)->association >= 0)
@@ -76,8 +76,14 @@ static const char *get_iface_name(ino_t netns, unsigned int iface_index);
 struct netns {
 	ino_t inode;
 	struct iface *ifaces;
+
+	/* not loaded yet, see load_pending_netns() */
+	char *path;
+	struct list_head pending;
 };
 
+static struct list_head pending_netns;
+
 static int netns_compare(const void *a, const void *b)
 {
 	const struct netns *netns_a = a;
@@ -91,6 +97,7 @@ static void netns_free(void *netns)
 	struct netns *nsobj = netns;
 
 	free(nsobj->ifaces);
+	free(nsobj->path);
 	free(netns);
 }
 
@@ -132,6 +139,9 @@ static const char *get_iface_name(ino_t netns, unsigned int iface_index)
 	if (!nsobj)
 		return NULL;
 
+	if (!(*nsobj)->ifaces)
+		return NULL;
+
 	for (size_t i = 0; (*nsobj)->ifaces[i].index; i++) {
 		if ((*nsobj)->ifaces[i].index == iface_index)
 			return (*nsobj)->ifaces[i].name;
@@ -152,6 +162,7 @@ static struct netns *mark_sock_xinfo_loaded(ino_t ino)
 	ino_t **tmp;
 
 	netns->inode = ino;
+	INIT_LIST_HEAD(&netns->pending);
 	tmp = tsearch(netns, &netns_tree, netns_compare);
 	if (tmp == NULL)
 		errx(EXIT_FAILURE, _("failed to allocate memory"));
@@ -199,21 +210,60 @@ static void load_sock_xinfo_with_fd(int fd, struct netns *nsobj)
 	}
 }
 
-void load_sock_xinfo(struct path_cxt *pc, const char *name, ino_t netns)
+/*
+ * Switching to a network namespace and reading all its sockets is expensive,
+ * and most namespaces found in /proc/#/ns/net are shared or contain no
+ * sockets opened by the listed processes. The namespaces are remembered
+ * here and loaded later by get_sock_xinfo() only until the socket is found.
+ */
+static void add_pending_netns(ino_t ino, const char *path)
 {
-	if (self_netns_fd == -1)
-		return;
+	struct netns *nsobj = mark_sock_xinfo_loaded(ino);
 
-	if (!is_sock_xinfo_loaded(netns)) {
-		int fd;
-		struct netns *nsobj = mark_sock_xinfo_loaded(netns);
-		fd = ul_path_open(pc, O_RDONLY, name);
-		if (fd < 0)
-			return;
+	nsobj->path = xstrdup(path);
+	list_add_tail(&nsobj->pending, &pending_netns);
+}
+
+static bool load_pending_netns(void)
+{
+	struct netns *nsobj;
+	int fd;
+
+	if (list_empty(&pending_netns))
+		return false;
 
-		load_sock_xinfo_with_fd(fd, nsobj);
+	nsobj = list_entry(pending_netns.next, struct netns, pending);
+	list_del_init(&nsobj->pending);
+
+	DBG(ENDPOINTS, ul_debug("load netns %ju from %s",
+				(uintmax_t) nsobj->inode, nsobj->path));
+	fd = open(nsobj->path, O_RDONLY | O_CLOEXEC);
+	if (fd >= 0) {
+		struct stat sb;
+
+		/* the process may be gone or in another namespace now */
+		if (fstat(fd, &sb) == 0 && sb.st_ino == nsobj->inode)
+			load_sock_xinfo_with_fd(fd, nsobj);
+		else
+			DBG(ENDPOINTS, ul_debug("netns %ju: %s changed, ignore",
+					(uintmax_t) nsobj->inode, nsobj->path));
 		close(fd);
 	}
+	free(nsobj->path);
+	nsobj->path = NULL;
+	return true;
+}
+
+void load_sock_xinfo(struct path_cxt *pc, const char *name, ino_t netns)
+{
+	char path[PATH_MAX];
+
+	if (self_netns_fd == -1)
+		return;
+
+	if (!is_sock_xinfo_loaded(netns)
+	    && ul_path_get_abspath(pc, path, sizeof(path), "%s", name))
+		add_pending_netns(netns, path);
 }
 
 void initialize_sock_xinfos(void)
@@ -222,6 +272,7 @@ void initialize_sock_xinfos(void)
 	DIR *dir;
 	struct dirent *d;
 
+	INIT_LIST_HEAD(&pending_netns);
 	self_netns_fd = open("/proc/self/ns/net", O_RDONLY);
 
 	if (self_netns_fd < 0)
@@ -253,18 +304,14 @@ void initialize_sock_xinfos(void)
 	}
 	while ((d = readdir(dir))) {
 		struct stat sb;
-		int fd;
-		struct netns *nsobj;
+		char path[PATH_MAX];
+
 		if (ul_path_stat(pc, &sb, 0, d->d_name) < 0)
 			continue;
 		if (is_sock_xinfo_loaded(sb.st_ino))
 			continue;
-		nsobj = mark_sock_xinfo_loaded(sb.st_ino);
-		fd = ul_path_open(pc, O_RDONLY, d->d_name);
-		if (fd < 0)
-			continue;
-		load_sock_xinfo_with_fd(fd, nsobj);
-		close(fd);
+		if (ul_path_get_abspath(pc, path, sizeof(path), "%s", d->d_name))
+			add_pending_netns(sb.st_ino, path);
 	}
 	closedir(dir);
 	ul_unref_path(pc);
@@ -282,8 +329,11 @@ void finalize_sock_xinfos(void)
 {
 	if (self_netns_fd != -1)
 		close(self_netns_fd);
+	self_netns_fd = -1;
 	tdestroy(netns_tree, netns_free);
+	netns_tree = NULL;
 	tdestroy(xinfo_tree, free_sock_xinfo);
+	xinfo_tree = NULL;
 }
 
 static int xinfo_compare(const void *a, const void *b)
@@ -299,7 +349,7 @@ static void add_sock_info(struct sock_xinfo *xinfo)
 		errx(EXIT_FAILURE, _("failed to allocate memory"));
 }
 
-struct sock_xinfo *get_sock_xinfo(ino_t inode)
+static struct sock_xinfo *find_sock_xinfo(ino_t inode)
 {
 	struct sock_xinfo key = { .inode = inode };
 	struct sock_xinfo **xinfo = tfind(&key, &xinfo_tree, xinfo_compare);
@@ -309,6 +359,19 @@ struct sock_xinfo *get_sock_xinfo(ino_t inode)
 	return NULL;
 }
 
+struct sock_xinfo *get_sock_xinfo(ino_t inode)
+{
+	struct sock_xinfo *xinfo;
+
+	do {
+		xinfo = find_sock_xinfo(inode);
+		if (xinfo)
+			break;
+	} while (load_pending_netns());
+
+	return xinfo;
+}
+
 bool is_nsfs_dev(dev_t dev)
 {
 	return dev == self_netns_sb.st_dev;
@@ -748,7 +811,7 @@ static bool handle_diag_unix(ino_t netns __attribute__((__unused__)),
 		return false;
 
 	inode = (ino_t)diag->udiag_ino;
-	xinfo = get_sock_xinfo(inode);
+	xinfo = find_sock_xinfo(inode);
 
 	DBG(ENDPOINTS, ul_debug("         inode: %llu", (unsigned long long)inode));
 	DBG(ENDPOINTS, ul_debug("         xinfo: %p", xinfo));
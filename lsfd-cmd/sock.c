@@ -21,10 +21,54 @@
 
 #include <sys/types.h>
 #include <sys/xattr.h>
+#include <search.h>		/* tfind, tsearch */
 
 #include "lsfd.h"
 #include "sock.h"
 
+/* The socket protocol names shared by all files for the same socket */
+struct sock_protoname {
+	ino_t ino;
+	char *name;
+};
+
+static void *protoname_tree;	/* for tsearch/tfind */
+
+static int protoname_compare(const void *a, const void *b)
+{
+	ino_t A = ((const struct sock_protoname *)a)->ino;
+	ino_t B = ((const struct sock_protoname *)b)->ino;
+
+	return A < B ? -1 : A == B ? 0 : 1;
+}
+
+static void free_protoname(void *data)
+{
+	struct sock_protoname *pn = data;
+
+	free(pn->name);
+	free(pn);
+}
+
+static char *get_protoname(ino_t ino)
+{
+	struct sock_protoname key = { .ino = ino };
+	struct sock_protoname **pn = tfind(&key, &protoname_tree, protoname_compare);
+
+	return pn ? (*pn)->name : NULL;
+}
+
+static char *add_protoname(ino_t ino, const char *name)
+{
+	struct sock_protoname *pn = xmalloc(sizeof(*pn));
+
+	pn->ino = ino;
+	pn->name = xstrdup(name);
+	if (tsearch(pn, &protoname_tree, protoname_compare) == NULL)
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
+	return pn->name;
+}
+
 static void attach_sock_xinfo(struct file *file)
 {
 	struct sock *sock = (struct sock *)file;
@@ -144,7 +188,10 @@ static void init_sock_content(struct file *file)
 
 	fd = file->association;
 
-	if (fd >= 0 || fd == -ASSOC_MEM || fd == -ASSOC_SHM) {
+	sock->protoname = get_protoname(file->stat.st_ino);
+
+	if (!sock->protoname
+	    && (fd >= 0 || fd == -ASSOC_MEM || fd == -ASSOC_SHM)) {
 		char path[PATH_MAX] = {'\0'};
 		char buf[256];
 		ssize_t len;
@@ -162,22 +209,13 @@ static void init_sock_content(struct file *file)
 		len = getxattr(path, "system.sockprotoname", buf, sizeof(buf) - 1);
 		if (len > 0) {
 			buf[len] = '\0';
-			sock->protoname = xstrdup(buf);
+			sock->protoname = add_protoname(file->stat.st_ino, buf);
 		}
 	}
 
 	init_endpoint(&sock->endpoint);
 }
 
-static void free_sock_content(struct file *file)
-{
-	struct sock *sock = (struct sock *)file;
-	if (sock->protoname) {
-		free(sock->protoname);
-		sock->protoname = NULL;
-	}
-}
-
 static void initialize_sock_class(void)
 {
 	initialize_sock_xinfos();
@@ -186,6 +224,8 @@ static void initialize_sock_class(void)
 static void finalize_sock_class(void)
 {
 	finalize_sock_xinfos();
+	tdestroy(protoname_tree, free_protoname);
+	protoname_tree = NULL;
 }
 
 const struct file_class sock_class = {
@@ -194,7 +234,7 @@ const struct file_class sock_class = {
 	.fill_column = sock_fill_column,
 	.attach_xinfo = attach_sock_xinfo,
 	.initialize_content = init_sock_content,
-	.free_content = free_sock_content,
+	.free_content = NULL,
 	.initialize_class = initialize_sock_class,
 	.finalize_class = finalize_sock_class,
 	.get_ipc_class = sock_get_ipc_class,
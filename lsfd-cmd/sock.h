@@ -41,7 +41,7 @@ struct sock_xinfo {
 
 struct sock {
 	struct file file;
-	char *protoname;
+	char *protoname;		/* shared, see get_protoname() */
 	struct sock_xinfo *xinfo;
 	struct ipc_endpoint endpoint;
 };
@@ -61,7 +61,7 @@ static const struct anon_ops *anon_probe(const char *);
 
 static char * anon_get_class(struct unkn *unkn)
 {
-	char *name;
+	const char *name;
 
 	if (unkn->anon_ops->class)
 		return xstrdup(unkn->anon_ops->class);
@@ -54,8 +54,10 @@ struct blkid_control {
 	int output;
 	uintmax_t offset;
 	uintmax_t size;
+	unsigned int njobs;
 	char *show[128];
 	struct ul_jsonwrt *json_fmt;
+	const char *batch;		/* file with device names or "-" */
 	unsigned int
 		eval:1,
 		gc:1,
@@ -64,6 +66,7 @@ struct blkid_control {
 		lowprobe_superblocks:1,
 		lowprobe_topology:1,
 		no_part_details:1,
+		probe_stats:1,
 		raw_chars:1;
 };
 
@@ -77,12 +80,14 @@ static void __attribute__((__noreturn__)) usage(void)
 			"       [--match-token <token>] [<dev> ...]\n\n"), program_invocation_short_name);
 	fprintf(out, _(	" %s -p [--match-tag <tag>] [--offset <offset>] [--size <size>] \n"
 			"       [--output <format>] <dev> ...\n\n"), program_invocation_short_name);
-	fprintf(out, _(	" %s -i [--match-tag <tag>] [--output <format>] <dev> ...\n"), program_invocation_short_name);
+	fprintf(out, _(	" %s -i [--match-tag <tag>] [--output <format>] <dev> ...\n\n"), program_invocation_short_name);
+	fprintf(out, _(	" %s -p --batch[=<file>] [--match-tag <tag>] [<dev> ...]\n"), program_invocation_short_name);
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(	" -c, --cache-file <file>    read from <file> instead of reading from the default\n"
 			"                              cache file (-c /dev/null means no cache)\n"), out);
 	fputs(_(	" -d, --no-encoding          don't encode non-printing characters\n"), out);
 	fputs(_(	" -g, --garbage-collect      garbage collect the blkid cache\n"), out);
+	fputs(_(	" -j, --jobs <num>           probe all devices by up to <num> threads\n"), out);
 	fputs(_(	" -o, --output <format>      output format; can be one of:\n"
 			"                              value, device, export, json or full; (default: full)\n"), out);
 	fputs(_(	" -k, --list-filesystems     list all known filesystems/RAIDs and exit\n"), out);
@@ -101,6 +106,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(	" -u, --usages <list>        filter by \"usage\" (e.g. -u filesystem,raid)\n"), out);
 	fputs(_(	" -n, --match-types <list>   filter by filesystem type (e.g. -n vfat,ext3)\n"), out);
 	fputs(_(	" -D, --no-part-details      don't print info from partition table\n"), out);
+	fputs(_(	"     --probe-stats          print probing statistics in JSON\n"), out);
+	fputs(_(	"     --batch[=<file>]       read devices from <file> or stdin, print JSON lines\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(28));
@@ -350,6 +357,14 @@ static void print_value(const struct blkid_control *ctl, int num,
 	}
 }
 
+/* the batch mode prints one JSON object per line */
+static void init_json(const struct blkid_control *ctl)
+{
+	ul_jsonwrt_init(ctl->json_fmt, stdout, 0);
+	if (ctl->batch)
+		ul_jsonwrt_set_compact(ctl->json_fmt, 1);
+}
+
 static void print_tags(const struct blkid_control *ctl, blkid_dev dev)
 {
 	blkid_tag_iterate	iter;
@@ -373,7 +388,7 @@ static void print_tags(const struct blkid_control *ctl, blkid_dev dev)
 	}
 
 	if (ctl->output == OUTPUT_JSON) {
-		ul_jsonwrt_init(ctl->json_fmt, stdout, 0);
+		init_json(ctl);
 		ul_jsonwrt_open(ctl->json_fmt, NULL, UL_JSON_OBJECT);
 	}
 
@@ -517,6 +532,40 @@ static int lowprobe_topology(blkid_probe pr)
 	return blkid_do_fullprobe(pr);
 }
 
+static void print_probe_stats(blkid_probe pr, const char *devname,
+			      struct blkid_control *ctl)
+{
+	uint64_t nreads = 0, nbytes = 0, nhits = 0, nmisses = 0;
+	uint64_t ncalls, usec;
+	const char *chain, *name;
+	size_t i;
+
+	blkid_probe_get_stats(pr, &nreads, &nbytes, &nhits, &nmisses);
+
+	init_json(ctl);
+	ul_jsonwrt_open(ctl->json_fmt, NULL, UL_JSON_OBJECT);
+	ul_jsonwrt_value_s(ctl->json_fmt, "device", devname);
+	ul_jsonwrt_value_u64(ctl->json_fmt, "reads", nreads);
+	ul_jsonwrt_value_u64(ctl->json_fmt, "bytes", nbytes);
+	ul_jsonwrt_value_u64(ctl->json_fmt, "hits", nhits);
+	ul_jsonwrt_value_u64(ctl->json_fmt, "misses", nmisses);
+
+	ul_jsonwrt_open(ctl->json_fmt, "probers", UL_JSON_ARRAY);
+	for (i = 0; blkid_probe_get_prober_stats(pr, i, &chain, &name, &ncalls,
+					&nreads, &nbytes, &usec) == 0; i++) {
+		ul_jsonwrt_open(ctl->json_fmt, NULL, UL_JSON_OBJECT);
+		ul_jsonwrt_value_s(ctl->json_fmt, "chain", chain);
+		ul_jsonwrt_value_s(ctl->json_fmt, "name", name);
+		ul_jsonwrt_value_u64(ctl->json_fmt, "calls", ncalls);
+		ul_jsonwrt_value_u64(ctl->json_fmt, "reads", nreads);
+		ul_jsonwrt_value_u64(ctl->json_fmt, "bytes", nbytes);
+		ul_jsonwrt_value_u64(ctl->json_fmt, "usec", usec);
+		ul_jsonwrt_close(ctl->json_fmt, UL_JSON_OBJECT);
+	}
+	ul_jsonwrt_close(ctl->json_fmt, UL_JSON_ARRAY);
+	ul_jsonwrt_close(ctl->json_fmt, UL_JSON_OBJECT);
+}
+
 static int lowprobe_device(blkid_probe pr, const char *devname,
 			   struct blkid_control *ctl)
 {
@@ -547,6 +596,11 @@ static int lowprobe_device(blkid_probe pr, const char *devname,
 	if (rc < 0)
 		goto done;
 
+	if (ctl->probe_stats) {
+		print_probe_stats(pr, devname, ctl);
+		goto done;
+	}
+
 	if (!rc)
 		nvals = blkid_probe_numof_values(pr);
 
@@ -555,8 +609,10 @@ static int lowprobe_device(blkid_probe pr, const char *devname,
 		fputc('\n', stdout);
 
 	if (ctl->output == OUTPUT_JSON) {
-		ul_jsonwrt_init(ctl->json_fmt, stdout, 0);
+		init_json(ctl);
 		ul_jsonwrt_open(ctl->json_fmt, NULL, UL_JSON_OBJECT);
+		if (ctl->batch)
+			ul_jsonwrt_value_s(ctl->json_fmt, "devname", devname);
 	}
 
 	if (nvals && (ctl->output & OUTPUT_DEVICE_ONLY)) {
@@ -583,6 +639,8 @@ static int lowprobe_device(blkid_probe pr, const char *devname,
 
 	if (ctl->output == OUTPUT_JSON)
 		ul_jsonwrt_close(ctl->json_fmt, UL_JSON_OBJECT);
+	if (ctl->batch)
+		fflush(stdout);
 done:
 	if (rc == -2) {
 		if (ctl->output & OUTPUT_UDEV_LIST)
@@ -603,6 +661,44 @@ done:
 	return 0;		/* success */
 }
 
+/*
+ * Probes devices from the batch file (one device name per line) by the same
+ * probe. Returns the last non-zero exit code, but does not stop on errors.
+ */
+static int lowprobe_batch(blkid_probe pr, struct blkid_control *ctl)
+{
+	FILE *f = stdin;
+	char *line = NULL;
+	size_t sz = 0;
+	ssize_t len;
+	int rc = 0;
+
+	if (strcmp(ctl->batch, "-") != 0) {
+		f = fopen(ctl->batch, "r" UL_CLOEXECSTR);
+		if (!f)
+			err(BLKID_EXIT_OTHER, _("cannot open %s"), ctl->batch);
+	}
+
+	while ((len = getline(&line, &sz, f)) >= 0) {
+		int x;
+
+		if (len > 0 && line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (!*line)
+			continue;
+
+		blkid_reset_probe(pr);
+		x = lowprobe_device(pr, line, ctl);
+		if (x)
+			rc = x;
+	}
+
+	free(line);
+	if (f != stdin)
+		fclose(f);
+	return rc;
+}
+
 /* converts comma separated list to BLKID_USAGE_* mask */
 static int list_to_usage(const char *list, int *flag)
 {
@@ -700,6 +796,10 @@ int main(int argc, char **argv)
 	int fltr_usage = 0;
 	char **fltr_type = NULL;
 	int fltr_flag = BLKID_FLTR_ONLYIN;
+	enum {
+		OPT_PROBE_STATS = CHAR_MAX + 1,
+		OPT_BATCH
+	};
 	unsigned int numdev = 0, numtag = 0;
 	int err = BLKID_EXIT_OTHER;
 	unsigned int i;
@@ -710,6 +810,7 @@ int main(int argc, char **argv)
 		{ "no-encoding",      no_argument,	 NULL, 'd' },
 		{ "no-part-details",  no_argument,       NULL, 'D' },
 		{ "garbage-collect",  no_argument,	 NULL, 'g' },
+		{ "jobs",	      required_argument, NULL, 'j' },
 		{ "output",	      required_argument, NULL, 'o' },
 		{ "list-filesystems", no_argument,	 NULL, 'k' },
 		{ "match-tag",	      required_argument, NULL, 's' },
@@ -718,6 +819,8 @@ int main(int argc, char **argv)
 		{ "label",	      required_argument, NULL, 'L' },
 		{ "uuid",	      required_argument, NULL, 'U' },
 		{ "probe",	      no_argument,	 NULL, 'p' },
+		{ "probe-stats",      no_argument,	 NULL, OPT_PROBE_STATS },
+		{ "batch",	      optional_argument, NULL, OPT_BATCH },
 		{ "hint",	      required_argument, NULL, 'H' },
 		{ "info",	      no_argument,	 NULL, 'i' },
 		{ "size",	      required_argument, NULL, 'S' },
@@ -743,7 +846,7 @@ int main(int argc, char **argv)
 	strutils_set_exitcode(BLKID_EXIT_OTHER);
 
 	while ((c = getopt_long (argc, argv,
-			    "c:DdgH:hilL:n:ko:O:ps:S:t:u:U:w:Vv", longopts, NULL)) != -1) {
+			    "c:DdgH:hij:lL:n:ko:O:ps:S:t:u:U:w:Vv", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -779,6 +882,9 @@ int main(int argc, char **argv)
 		case 'i':
 			ctl.lowprobe_topology = 1;
 			break;
+		case 'j':
+			ctl.njobs = strtou32_or_err(optarg, _("invalid jobs argument"));
+			break;
 		case 'l':
 			ctl.lookup = 1;
 			break;
@@ -851,6 +957,12 @@ int main(int argc, char **argv)
 		case 'w':
 			/* ignore - backward compatibility */
 			break;
+		case OPT_PROBE_STATS:
+			ctl.probe_stats = 1;
+			break;
+		case OPT_BATCH:
+			ctl.batch = optarg ? optarg : "-";
+			break;
 		case 'h':
 			usage();
 			break;
@@ -861,6 +973,8 @@ int main(int argc, char **argv)
 
 	if (ctl.lowprobe_topology || ctl.lowprobe_superblocks)
 		ctl.lowprobe = 1;
+	if (ctl.batch && !ctl.lowprobe)
+		errx(BLKID_EXIT_OTHER, _("--batch requires --probe or --info"));
 
 	/* The rest of the args are device names */
 	if (optind < argc) {
@@ -927,7 +1041,7 @@ int main(int argc, char **argv)
 		 */
 		blkid_probe pr;
 
-		if (!numdev)
+		if (!numdev && !ctl.batch)
 			errx(BLKID_EXIT_OTHER,
 			     _("The low-level probing mode "
 			       "requires a device"));
@@ -935,10 +1049,14 @@ int main(int argc, char **argv)
 		/* automatically enable 'export' format for I/O Limits */
 		if (!ctl.output  && ctl.lowprobe_topology)
 			ctl.output = OUTPUT_EXPORT_LIST;
+		if (ctl.batch)
+			ctl.output = OUTPUT_JSON;
 
 		pr = blkid_new_probe();
 		if (!pr)
 			goto exit;
+		if (ctl.probe_stats)
+			blkid_probe_enable_stats(pr, 1);
 		if (hint && blkid_probe_set_hint(pr, hint, 0) != 0) {
 			warn(_("Failed to use probing hint: %s"), hint);
 			goto exit;
@@ -962,9 +1080,15 @@ int main(int argc, char **argv)
 
 		for (i = 0; i < numdev; i++) {
 			err = lowprobe_device(pr, devices[i], &ctl);
-			if (err)
+			if (err && !ctl.batch)
 				break;
 		}
+		if (ctl.batch) {
+			int rc = lowprobe_batch(pr, &ctl);
+
+			if (!numdev || rc)
+				err = rc;
+		}
 		blkid_free_probe(pr);
 	} else if (ctl.eval) {
 		/*
@@ -999,7 +1123,10 @@ int main(int argc, char **argv)
 		blkid_dev_iterate	iter;
 		blkid_dev		dev;
 
-		blkid_probe_all(cache);
+		if (ctl.njobs > 1)
+			blkid_probe_all_parallel(cache, ctl.njobs);
+		else
+			blkid_probe_all(cache);
 
 		iter = blkid_dev_iterate_begin(cache);
 		blkid_dev_set_search(iter, search_type, search_value);
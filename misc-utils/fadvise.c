@@ -23,10 +23,28 @@
 #include <getopt.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #include "c.h"
 #include "nls.h"
 #include "strutils.h"
+#include "xalloc.h"
+#include "monotonic.h"
+#include "walkdir.h"
+
+#ifndef MADV_POPULATE_READ
+# define MADV_POPULATE_READ	22
+#endif
+
+/* the unit of --rate and --verbose accounting */
+#define FADV_CHUNK		(8 * 1024 * 1024)
+
+/* names queued for every worker */
+#define FADV_QUEUE_PER_THREAD	64
 
 static const struct advice {
 	const char *name;
@@ -40,19 +58,416 @@ static const struct advice {
 	{ "dontneed",   POSIX_FADV_DONTNEED,   },
 };
 
+enum {
+	METHOD_FADVISE,
+	METHOD_READAHEAD,
+	METHOD_POPULATE
+};
+
+static const char *methods[] = {
+	[METHOD_FADVISE]   = "fadvise",
+	[METHOD_READAHEAD] = "readahead",
+	[METHOD_POPULATE]  = "populate",
+};
+
+struct fadv_control {
+	int		advice;
+	int		method;
+	off_t		offset;
+	off_t		len;
+	uint64_t	rate;		/* bytes per second or 0 */
+	size_t		nthreads;
+
+	unsigned int	verbose : 1,
+			zero : 1,
+			fallback : 1;	/* MADV_POPULATE_READ unsupported */
+
+	struct timeval	start;
+	struct timeval	last;		/* the last progress report */
+	uint64_t	issued;		/* bytes started, for --rate */
+	uint64_t	done;
+	size_t		nfiles;
+	int		rc;
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t	lock;
+
+	/* file names for the workers */
+	char		**queue;
+	size_t		qsize;
+	size_t		qfirst;
+	size_t		qcount;
+	bool		qeof;
+	pthread_cond_t	qavail;
+	pthread_cond_t	qspace;
+#endif
+};
+
+static inline void ctl_lock(struct fadv_control *ctl __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&ctl->lock);
+#endif
+}
+
+static inline void ctl_unlock(struct fadv_control *ctl __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&ctl->lock);
+#endif
+}
+
+static usec_t elapsed_usec(const struct timeval *from, const struct timeval *to)
+{
+	struct timeval diff;
+
+	timersub(to, from, &diff);
+	return (usec_t) diff.tv_sec * USEC_PER_SEC + diff.tv_usec;
+}
+
+static uint64_t get_throughput(uint64_t bytes, usec_t usec)
+{
+	if (!usec)
+		return 0;
+	return bytes / usec * USEC_PER_SEC + bytes % usec * USEC_PER_SEC / usec;
+}
+
+/* sleeps until @len more bytes are allowed by --rate */
+static void throttle(struct fadv_control *ctl, uint64_t len)
+{
+	struct timeval now;
+	usec_t due, cur;
+
+	ctl_lock(ctl);
+	ctl->issued += len;
+	due = ctl->issued / ctl->rate * USEC_PER_SEC
+	      + ctl->issued % ctl->rate * USEC_PER_SEC / ctl->rate;
+	ctl_unlock(ctl);
+
+	for (;;) {
+		gettime_monotonic(&now);
+		cur = elapsed_usec(&ctl->start, &now);
+		if (due <= cur)
+			break;
+		xusleep(min(due - cur, (usec_t) USEC_PER_SEC));
+	}
+}
+
+/* reporting progress at most once per second */
+static void account(struct fadv_control *ctl, uint64_t len, size_t nfiles)
+{
+	struct timeval now;
+
+	ctl_lock(ctl);
+	ctl->done += len;
+	ctl->nfiles += nfiles;
+
+	if (ctl->verbose) {
+		gettime_monotonic(&now);
+		if (elapsed_usec(&ctl->last, &now) >= USEC_PER_SEC) {
+			char *str = size_to_human_string(SIZE_SUFFIX_1LETTER, ctl->done);
+			char *thr = size_to_human_string(SIZE_SUFFIX_1LETTER,
+					get_throughput(ctl->done,
+						elapsed_usec(&ctl->start, &now)));
+
+			printf(_("%zu files, %s (%s/s)\n"), ctl->nfiles, str, thr);
+			fflush(stdout);
+			free(str);
+			free(thr);
+			ctl->last = now;
+		}
+	}
+	ctl_unlock(ctl);
+}
+
+static void set_failed(struct fadv_control *ctl)
+{
+	ctl_lock(ctl);
+	ctl->rc = EXIT_FAILURE;
+	ctl_unlock(ctl);
+}
+
+static void print_throughput(struct fadv_control *ctl)
+{
+	struct timeval now;
+	usec_t usec;
+	char *str;
+
+	gettime_monotonic(&now);
+	usec = elapsed_usec(&ctl->start, &now);
+	str = size_to_human_string(SIZE_SUFFIX_1LETTER,
+				   get_throughput(ctl->done, usec));
+
+	printf(_("%zu files, %" PRIu64 " bytes in %" PRIu64 ".%06" PRIu64 " seconds (%s/s)\n"),
+		ctl->nfiles, ctl->done, (uint64_t) (usec / USEC_PER_SEC),
+		(uint64_t) (usec % USEC_PER_SEC), str);
+	free(str);
+}
+
+/* reads the range by page faults, the pages are in memory on return */
+static int populate_range(struct fadv_control *ctl, int fd, off_t off, off_t len)
+{
+	off_t start = off - off % getpagesize();
+	void *map;
+	int rc = 0;
+
+	map = mmap(NULL, len + off - start, PROT_READ, MAP_SHARED, fd, start);
+	if (map == MAP_FAILED)
+		return errno;
+
+	if (madvise(map, len + off - start, MADV_POPULATE_READ) != 0) {
+		rc = errno;
+		if (rc == EINVAL) {
+			/* kernel without MADV_POPULATE_READ (< 5.14) */
+			ctl->fallback = 1;
+			rc = readahead(fd, off, len) == 0 ? 0 : errno;
+		}
+	}
+	munmap(map, len + off - start);
+	return rc;
+}
+
+/* returns 0 or errno */
+static int advise_range(struct fadv_control *ctl, int fd, off_t off, off_t len)
+{
+	switch (ctl->method) {
+	case METHOD_READAHEAD:
+		return readahead(fd, off, len) == 0 ? 0 : errno;
+	case METHOD_POPULATE:
+		if (!ctl->fallback)
+			return populate_range(ctl, fd, off, len);
+		return readahead(fd, off, len) == 0 ? 0 : errno;
+	default:
+		return posix_fadvise(fd, off, len, ctl->advice);
+	}
+}
+
+/*
+ * Applies the advice to the range of @fd. The range is split into chunks for
+ * --rate and progress, otherwise posix_fadvise() is called only once.
+ *
+ * Returns: 0 or errno.
+ */
+static int advise_fd(struct fadv_control *ctl, int fd)
+{
+	struct stat sb;
+	off_t end;
+	int rc = 0;
+
+	if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+		/* unknown size, let the kernel do whatever the range means */
+		rc = advise_range(ctl, fd, ctl->offset, ctl->len);
+		account(ctl, 0, 1);
+		return rc;
+	}
+
+	end = sb.st_size;
+	if (ctl->len && ctl->offset + ctl->len < end)
+		end = ctl->offset + ctl->len;
+
+	if (ctl->method == METHOD_FADVISE && !ctl->rate && !ctl->verbose) {
+		rc = posix_fadvise(fd, ctl->offset, ctl->len, ctl->advice);
+		account(ctl, end > ctl->offset ? end - ctl->offset : 0, 1);
+		return rc;
+	}
+
+	for (off_t off = ctl->offset; off < end; ) {
+		off_t len = min((off_t) FADV_CHUNK, end - off);
+
+		if (ctl->rate)
+			throttle(ctl, len);
+		rc = advise_range(ctl, fd, off, len);
+		if (rc)
+			break;
+		account(ctl, len, 0);
+		off += len;
+	}
+	account(ctl, 0, 1);
+	return rc;
+}
+
+static void advise_file(struct fadv_control *ctl, const char *name)
+{
+	int fd, rc;
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0) {
+		warn(_("cannot open %s"), name);
+		set_failed(ctl);
+		return;
+	}
+
+	rc = advise_fd(ctl, fd);
+	if (rc != 0) {
+		warnx(_("%s: failed to advise: %s"), name, strerror(rc));
+		set_failed(ctl);
+	}
+	close(fd);
+}
+
+#ifdef HAVE_PTHREAD
+static void *advise_worker(void *data)
+{
+	struct fadv_control *ctl = data;
+
+	for (;;) {
+		char *name;
+
+		pthread_mutex_lock(&ctl->lock);
+		while (!ctl->qcount && !ctl->qeof)
+			pthread_cond_wait(&ctl->qavail, &ctl->lock);
+		if (!ctl->qcount) {
+			pthread_mutex_unlock(&ctl->lock);
+			break;
+		}
+		name = ctl->queue[ctl->qfirst];
+		ctl->qfirst = (ctl->qfirst + 1) % ctl->qsize;
+		ctl->qcount--;
+		pthread_cond_signal(&ctl->qspace);
+		pthread_mutex_unlock(&ctl->lock);
+
+		advise_file(ctl, name);
+		free(name);
+	}
+	return NULL;
+}
+#endif
+
+/* applies the advice to @name now, or queues it for a worker */
+static void submit_file(struct fadv_control *ctl, const char *name)
+{
+#ifdef HAVE_PTHREAD
+	if (ctl->queue) {
+		pthread_mutex_lock(&ctl->lock);
+		while (ctl->qcount == ctl->qsize)
+			pthread_cond_wait(&ctl->qspace, &ctl->lock);
+		ctl->queue[(ctl->qfirst + ctl->qcount) % ctl->qsize] = xstrdup(name);
+		ctl->qcount++;
+		pthread_cond_signal(&ctl->qavail);
+		pthread_mutex_unlock(&ctl->lock);
+		return;
+	}
+#endif
+	advise_file(ctl, name);
+}
+
+/* the walker callback has no private data */
+static struct fadv_control *walk_ctl;
+
+static int advise_walk(const char *fpath,
+		       const struct stat *sb __attribute__((__unused__)),
+		       int type,
+		       struct FTW *ftwbuf __attribute__((__unused__)))
+{
+	switch (type) {
+	case FTW_F:
+		submit_file(walk_ctl, fpath);
+		break;
+	case FTW_DNR:
+		warn(_("cannot read directory %s"), fpath);
+		set_failed(walk_ctl);
+		break;
+	case FTW_NS:
+		warnx(_("cannot stat %s"), fpath);
+		set_failed(walk_ctl);
+		break;
+	}
+	return 0;
+}
+
+static void advise_list(struct fadv_control *ctl, const char *filename)
+{
+	FILE *f = stdin;
+	char *buf = NULL;
+	size_t bufsz = 0;
+	ssize_t sz;
+	int delim = ctl->zero ? '\0' : '\n';
+
+	if (strcmp(filename, "-") != 0) {
+		f = fopen(filename, "r");
+		if (!f)
+			err(EXIT_FAILURE, _("cannot open %s"), filename);
+	}
+
+	while ((sz = getdelim(&buf, &bufsz, delim, f)) > 0) {
+		if (buf[sz - 1] == delim)
+			buf[--sz] = '\0';
+		if (sz)
+			submit_file(ctl, buf);
+	}
+	if (ferror(f)) {
+		warn(_("read failed: %s"), filename);
+		set_failed(ctl);
+	}
+
+	free(buf);
+	if (f != stdin)
+		fclose(f);
+}
+
+#ifdef HAVE_PTHREAD
+/* returns the number of started workers */
+static size_t start_workers(struct fadv_control *ctl, pthread_t *threads)
+{
+	size_t i;
+
+	ctl->qsize = ctl->nthreads * FADV_QUEUE_PER_THREAD;
+	ctl->queue = xcalloc(ctl->qsize, sizeof(char *));
+	pthread_cond_init(&ctl->qavail, NULL);
+	pthread_cond_init(&ctl->qspace, NULL);
+
+	for (i = 0; i < ctl->nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, advise_worker, ctl) != 0)
+			break;
+	}
+	if (!i) {
+		free(ctl->queue);
+		ctl->queue = NULL;
+	}
+	return i;
+}
+
+static void stop_workers(struct fadv_control *ctl, pthread_t *threads, size_t n)
+{
+	size_t i;
+
+	pthread_mutex_lock(&ctl->lock);
+	ctl->qeof = true;
+	pthread_cond_broadcast(&ctl->qavail);
+	pthread_mutex_unlock(&ctl->lock);
+
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	free(ctl->queue);
+	ctl->queue = NULL;
+	pthread_cond_destroy(&ctl->qavail);
+	pthread_cond_destroy(&ctl->qspace);
+}
+#endif
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
 	size_t i;
 
 	fputs(USAGE_HEADER, out);
-	fprintf(out, _(" %s [options] file\n"), program_invocation_short_name);
+	fprintf(out, _(" %s [options] file...\n"), program_invocation_short_name);
 	fprintf(out, _(" %s [options] --fd|-d file-descriptor\n"), program_invocation_short_name);
+	fprintf(out, _(" %s [options] --files-from|-F list\n"), program_invocation_short_name);
 
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -a, --advice <advice> applying advice to the file (default: \"dontneed\")\n"), out);
 	fputs(_(" -l, --length <num>    length for range operations, in bytes\n"), out);
 	fputs(_(" -o, --offset <num>    offset for range operations, in bytes\n"), out);
+	fputs(_(" -R, --recursive       apply the advice to all files in directories\n"), out);
+	fputs(_(" -F, --files-from <file>\n"
+		"                       read the file names from <file> (or - for stdin)\n"), out);
+	fputs(_(" -z, --zero            the names in the list are separated by NUL\n"), out);
+	fputs(_(" -m, --method <name>   how to read the files for \"willneeded\"\n"), out);
+	fputs(_("     --rate <size>     limit the throughput to <size> bytes per second\n"), out);
+	fputs(_("     --threads <num>   number of threads to advise files\n"), out);
+	fputs(_(" -v, --verbose         print progress and throughput\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(23));
@@ -63,6 +478,12 @@ static void __attribute__((__noreturn__)) usage(void)
 			advices[i].name);
 	}
 
+	fputs(_("\nAvailable values for method:\n"), out);
+	for (i = 0; i < ARRAY_SIZE(methods); i++) {
+		fprintf(out, "  %s\n",
+			methods[i]);
+	}
+
 	fprintf(out, USAGE_MAN_TAIL("fadvise(1)"));
 
 	exit(EXIT_SUCCESS);
@@ -72,18 +493,34 @@ int main(int argc, char ** argv)
 {
 	int c;
 	int rc;
-	bool do_close = false;
+	bool recursive = false;
+	const char *list = NULL;
+	bool advice_set = false;
 
 	int fd = -1;
-	off_t offset = 0;
-	off_t len = 0;
-	int advice = POSIX_FADV_DONTNEED;
+	struct fadv_control ctl = {
+		.advice = POSIX_FADV_DONTNEED,
+		.method = METHOD_FADVISE,
+		.nthreads = 1,
+		.rc = EXIT_SUCCESS
+	};
 
+	enum {
+		OPT_RATE = CHAR_MAX + 1,
+		OPT_THREADS
+	};
 	static const struct option longopts[] = {
 		{ "advice",     required_argument, NULL, 'a' },
 		{ "fd",         required_argument, NULL, 'd' },
+		{ "files-from", required_argument, NULL, 'F' },
 		{ "length",     required_argument, NULL, 'l' },
+		{ "method",     required_argument, NULL, 'm' },
 		{ "offset",     required_argument, NULL, 'o' },
+		{ "rate",       required_argument, NULL, OPT_RATE },
+		{ "recursive",  no_argument,       NULL, 'R' },
+		{ "threads",    required_argument, NULL, OPT_THREADS },
+		{ "verbose",    no_argument,       NULL, 'v' },
+		{ "zero",       no_argument,       NULL, 'z' },
 		{ "version",    no_argument,       NULL, 'V' },
 		{ "help",	no_argument,       NULL, 'h' },
 		{ NULL, 0, NULL, 0 },
@@ -93,31 +530,65 @@ int main(int argc, char ** argv)
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
 
-	while ((c = getopt_long (argc, argv, "a:d:hl:o:V", longopts, NULL)) != -1) {
+	while ((c = getopt_long (argc, argv, "a:d:F:hl:m:o:RvVz", longopts, NULL)) != -1) {
 		switch (c) {
 		case 'a':
-			advice = -1;
+			ctl.advice = -1;
 			for (size_t i = 0; i < ARRAY_SIZE(advices); i++) {
 				if (strcmp(optarg, advices[i].name) == 0) {
-					advice = advices[i].num;
+					ctl.advice = advices[i].num;
 					break;
 				}
 			}
-			if (advice == -1)
+			if (ctl.advice == -1)
 				errx(EXIT_FAILURE, "invalid advice argument: '%s'", optarg);
+			advice_set = true;
 			break;
 		case 'd':
 			fd = strtos32_or_err(optarg,
 					     _("invalid fd argument"));
 			break;
+		case 'F':
+			list = optarg;
+			break;
 		case 'l':
-			len = strtosize_or_err(optarg,
+			ctl.len = strtosize_or_err(optarg,
 					       _("invalid length argument"));
 			break;
+		case 'm':
+			ctl.method = -1;
+			for (size_t i = 0; i < ARRAY_SIZE(methods); i++) {
+				if (strcmp(optarg, methods[i]) == 0) {
+					ctl.method = i;
+					break;
+				}
+			}
+			if (ctl.method == -1)
+				errx(EXIT_FAILURE, _("invalid method argument: '%s'"), optarg);
+			break;
 		case 'o':
-			offset = strtosize_or_err(optarg,
+			ctl.offset = strtosize_or_err(optarg,
 						  _("invalid offset argument"));
 			break;
+		case OPT_RATE:
+			ctl.rate = strtosize_or_err(optarg,
+						_("invalid rate argument"));
+			break;
+		case 'R':
+			recursive = true;
+			break;
+		case OPT_THREADS:
+			ctl.nthreads = str2unum_or_err(optarg, 10,
+					_("failed to parse number of threads"), 1024);
+			if (!ctl.nthreads)
+				ctl.nthreads = 1;
+			break;
+		case 'v':
+			ctl.verbose = 1;
+			break;
+		case 'z':
+			ctl.zero = 1;
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -127,36 +598,70 @@ int main(int argc, char ** argv)
 		}
 	}
 
-	if (optind == argc && fd == -1) {
+	if (optind == argc && fd == -1 && !list) {
 		warnx(_("no file specified"));
 		errtryhelp(EXIT_FAILURE);
 	}
 
-	if (argc - optind > 0 && fd != -1) {
+	if ((argc - optind > 0 || list || recursive) && fd != -1) {
 		warnx(_("specify either file descriptor or file name"));
 		errtryhelp(EXIT_FAILURE);
 	}
 
-	if (argc - optind > 1) {
-		warnx(_("specify one file descriptor or file name"));
-		errtryhelp(EXIT_FAILURE);
+	if (ctl.method != METHOD_FADVISE) {
+		if (advice_set && ctl.advice != POSIX_FADV_WILLNEED)
+			errx(EXIT_FAILURE, _("--method requires \"willneeded\" advice"));
+		ctl.advice = POSIX_FADV_WILLNEED;
 	}
 
-	if (fd == -1) {
-		fd = open(argv[optind], O_RDONLY);
-		if (fd < 0)
-			err(EXIT_FAILURE, _("cannot open %s"), argv[optind]);
-		do_close = true;
-	}
+	gettime_monotonic(&ctl.start);
+	ctl.last = ctl.start;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init(&ctl.lock, NULL);
+#endif
+
+	if (fd != -1) {
+		rc = advise_fd(&ctl, fd);
+		if (rc != 0) {
+			warnx(_("failed to advise: %s"), strerror(rc));
+			ctl.rc = EXIT_FAILURE;
+		}
+	} else {
+#ifdef HAVE_PTHREAD
+		pthread_t *threads = NULL;
+		size_t nthreads = 0;
+
+		if (ctl.nthreads > 1) {
+			threads = xcalloc(ctl.nthreads, sizeof(pthread_t));
+			nthreads = start_workers(&ctl, threads);
+		}
+#endif
+		walk_ctl = &ctl;
 
-	rc = posix_fadvise(fd,
-			   offset, len,
-			   advice);
-	if (rc != 0)
-		warnx(_("failed to advise: %s"), strerror(rc));
+		if (list)
+			advise_list(&ctl, list);
+
+		for (; optind < argc; optind++) {
+			if (!recursive)
+				submit_file(&ctl, argv[optind]);
+			else if (ul_walkdir(argv[optind], advise_walk,
+					UL_WALKDIR_REGULAR, ctl.nthreads) != 0) {
+				warn(_("cannot walk %s"), argv[optind]);
+				set_failed(&ctl);
+			}
+		}
+#ifdef HAVE_PTHREAD
+		if (nthreads)
+			stop_workers(&ctl, threads, nthreads);
+		free(threads);
+#endif
+	}
+#ifdef HAVE_PTHREAD
+	pthread_mutex_destroy(&ctl.lock);
+#endif
 
-	if (do_close)
-		close(fd);
+	if (ctl.verbose)
+		print_throughput(&ctl);
 
-	return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	return ctl.rc;
 }
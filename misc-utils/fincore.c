@@ -32,6 +32,7 @@
 #include "xalloc.h"
 #include "strutils.h"
 #include "blkdev.h"
+#include "walkdir.h"
 
 #include "libsmartcols.h"
 
@@ -92,6 +93,8 @@ enum {
 	COL_EVICTED,
 	COL_RECENTLY_EVICTED_PAGES,
 	COL_RECENTLY_EVICTED,
+	COL_FILES,
+	COL_OFFSET,
 };
 
 static const struct colinfo infos[] = {
@@ -107,11 +110,29 @@ static const struct colinfo infos[] = {
 	[COL_EVICTED]                = { "EVICTED",                5, SCOLS_FL_RIGHT, N_("number of evicted bytes")},
 	[COL_RECENTLY_EVICTED_PAGES] = { "RECENTLY_EVICTED_PAGES", 1, SCOLS_FL_RIGHT, N_("number of recently evicted pages"), 1},
 	[COL_RECENTLY_EVICTED]       = { "RECENTLY_EVICTED",       5, SCOLS_FL_RIGHT, N_("number of recently evicted bytes")},
+	[COL_FILES]                  = { "FILES",                  1, SCOLS_FL_RIGHT, N_("number of files")},
+	[COL_OFFSET]                 = { "OFFSET",                 5, SCOLS_FL_RIGHT, N_("offset of the data extent")},
 };
 
 static int columns[ARRAY_SIZE(infos) * 2] = {-1};
 static size_t ncolumns;
 
+struct fincore_state {
+	const char *name;
+	long long unsigned int file_size;	/* or size of the extent */
+	long long unsigned int offset;		/* of the extent */
+	size_t nfiles;				/* files of a directory summary */
+	unsigned int extent : 1;
+
+	struct cachestat cstat;
+	struct {
+		unsigned int dirty : 1,
+			     writeback : 1,
+			     evicted : 1,
+			     recently_evicted : 1;
+	} cstat_fields;
+};
+
 struct fincore_control {
 	const size_t pagesize;
 
@@ -120,21 +141,21 @@ struct fincore_control {
 	unsigned int bytes : 1,
 		     noheadings : 1,
 		     raw : 1,
-		     json : 1;
+		     json : 1,
+		     recursive : 1,
+		     extents : 1;
 
-};
+	int depth;				/* summarize directories, or -1 */
+	size_t nthreads;			/* directory walker threads */
 
-struct fincore_state {
-	const char * const name;
-	long long unsigned int file_size;
+	size_t top;				/* print only @top most resident */
+	size_t ntops, ntopsalloc;
+	struct fincore_state *tops;		/* sorted by nr_cache, descending */
 
-	struct cachestat cstat;
-	struct {
-		unsigned int dirty : 1,
-			     writeback : 1,
-			     evicted : 1,
-			     recently_evicted : 1;
-	} cstat_fields;
+	size_t rootsz;				/* the walked argument */
+	struct fincore_state *sums;		/* directory per level 0..depth */
+
+	int rc;
 };
 
 
@@ -226,6 +247,19 @@ static int add_output_data(struct fincore_control *ctl,
 		case COL_FILE:
 			rc = scols_line_set_data(ln, i, st->name);
 			break;
+		case COL_FILES:
+			xasprintf(&tmp, "%zu", st->nfiles);
+			rc = scols_line_refer_data(ln, i, tmp);
+			break;
+		case COL_OFFSET:
+			if (!st->extent)
+				break;
+			if (ctl->bytes)
+				xasprintf(&tmp, "%ju", (uintmax_t) st->offset);
+			else
+				tmp = size_to_human_string(SIZE_SUFFIX_1LETTER, st->offset);
+			rc = scols_line_refer_data(ln, i, tmp);
+			break;
 		case COL_SIZE:
 			if (ctl->bytes)
 				xasprintf(&tmp, "%jd", (intmax_t) st->file_size);
@@ -269,6 +303,52 @@ static int add_output_data(struct fincore_control *ctl,
 	return 0;
 }
 
+/*
+ * Prints @st, or with --top keeps a copy of @st if it is one of the @ctl->top
+ * most resident entries. The copies are kept sorted, the cheapest is the last.
+ */
+static void output_state(struct fincore_control *ctl, struct fincore_state *st)
+{
+	size_t i;
+
+	if (!ctl->top) {
+		add_output_data(ctl, st);
+		return;
+	}
+
+	if (ctl->ntops == ctl->top) {
+		struct fincore_state *last = &ctl->tops[ctl->ntops - 1];
+
+		if (st->cstat.nr_cache <= last->cstat.nr_cache)
+			return;
+		free((char *) last->name);
+		ctl->ntops--;
+	} else if (ctl->ntops == ctl->ntopsalloc) {
+		ctl->ntopsalloc = min(ctl->top, max(ctl->ntopsalloc * 2, (size_t) 64));
+		ctl->tops = xreallocarray(ctl->tops, ctl->ntopsalloc, sizeof(*ctl->tops));
+	}
+
+	for (i = ctl->ntops; i > 0; i--) {
+		if (ctl->tops[i - 1].cstat.nr_cache >= st->cstat.nr_cache)
+			break;
+		ctl->tops[i] = ctl->tops[i - 1];
+	}
+	ctl->tops[i] = *st;
+	ctl->tops[i].name = xstrdup(st->name);
+	ctl->ntops++;
+}
+
+static void output_tops(struct fincore_control *ctl)
+{
+	size_t i;
+
+	for (i = 0; i < ctl->ntops; i++) {
+		add_output_data(ctl, &ctl->tops[i]);
+		free((char *) ctl->tops[i].name);
+	}
+	ctl->ntops = 0;
+}
+
 static int do_mincore(struct fincore_control *ctl,
 		      void *window, const size_t len,
 		      struct fincore_state *st)
@@ -293,18 +373,20 @@ static int do_mincore(struct fincore_control *ctl,
 	return 0;
 }
 
-static int mincore_fd (struct fincore_control *ctl,
-		       int fd,
-		       struct fincore_state *st)
+static int mincore_range(struct fincore_control *ctl,
+			 int fd,
+			 struct fincore_state *st,
+			 long long unsigned int start,
+			 long long unsigned int end)
 {
 	size_t window_size = N_PAGES_IN_WINDOW * ctl->pagesize;
 	long long unsigned int file_offset, len;
 	int rc = 0;
 
-	for (file_offset = 0; file_offset < st->file_size; file_offset += len) {
+	for (file_offset = start; file_offset < end; file_offset += len) {
 		void  *window = NULL;
 
-		len = st->file_size - file_offset;
+		len = end - file_offset;
 		if (len >= window_size)
 			len = window_size;
 
@@ -326,30 +408,132 @@ static int mincore_fd (struct fincore_control *ctl,
 	return rc;
 }
 
+/*
+ * Finds the next data extent from @*start to @size and sets @*start and @*end
+ * to its page aligned boundaries. Without SEEK_DATA support the rest of the
+ * file is one extent.
+ *
+ * Returns: 1 if found, 0 if there is no more data.
+ */
+static int next_data_extent(struct fincore_control *ctl, int fd,
+			    long long unsigned int size,
+			    long long unsigned int *start,
+			    long long unsigned int *end)
+{
+	off_t data, hole;
+
+	if (*start >= size)
+		return 0;
+
+	data = lseek(fd, *start, SEEK_DATA);
+	if (data < 0) {
+		if (errno == ENXIO)
+			return 0;
+		*end = size;
+		return 1;
+	}
+	hole = lseek(fd, data, SEEK_HOLE);
+	if (hole < 0 || (long long unsigned int) hole > size)
+		hole = size;
+
+	/* the filesystem block may be smaller than page, don't count the
+	 * same page twice */
+	data -= data % ctl->pagesize;
+	*start = max(*start, (long long unsigned int) data);
+	*end = min(size, ((long long unsigned int) hole + ctl->pagesize - 1)
+				/ ctl->pagesize * ctl->pagesize);
+	return 1;
+}
+
+/* mincore() of the data extents only, the holes are not mapped at all */
+static int mincore_fd (struct fincore_control *ctl,
+		       int fd,
+		       struct fincore_state *st)
+{
+	long long unsigned int start = 0, end;
+	int rc = 0;
+
+	while (!rc && next_data_extent(ctl, fd, st->file_size, &start, &end)) {
+		rc = mincore_range(ctl, fd, st, start, end);
+		start = end;
+	}
+
+	return rc;
+}
+
+static int cachestat_range(int fd, struct fincore_state *st,
+			   long long unsigned int start,
+			   long long unsigned int end)
+{
+	const struct cachestat_range cstat_range = {
+		.off = start,
+		.len = end - start
+	};
+
+	if (cachestat(fd, &cstat_range, &st->cstat, 0) != 0)
+		return -errno;
+
+	st->cstat_fields.dirty = 1;
+	st->cstat_fields.writeback = 1;
+	st->cstat_fields.evicted = 1;
+	st->cstat_fields.recently_evicted = 1;
+	return 0;
+}
+
+/* prints a line for every data extent; returns 1 on success */
+static int fincore_extents(struct fincore_control *ctl,
+			   int fd,
+			   struct fincore_state *st)
+{
+	long long unsigned int start = 0, end;
+	int rc = 0;
+
+	while (next_data_extent(ctl, fd, st->file_size, &start, &end)) {
+		struct fincore_state ext = {
+			.name = st->name,
+			.file_size = end - start,
+			.offset = start,
+			.nfiles = 1,
+			.extent = 1
+		};
+
+		rc = cachestat_range(fd, &ext, start, end);
+		if (rc) {
+			if (rc != -ENOSYS)
+				warn(_("failed to do cachestat: %s"), st->name);
+			rc = mincore_range(ctl, fd, &ext, start, end);
+		}
+		if (rc)
+			return rc;
+
+		output_state(ctl, &ext);
+		start = end;
+	}
+
+	return 1;
+}
+
 static int fincore_fd (struct fincore_control *ctl,
 		       int fd,
 		       struct fincore_state *st)
 {
 	int rc;
-	const struct cachestat_range cstat_range = { 0 };
-
-	rc = cachestat(fd, &cstat_range, &st->cstat, 0);
-	if (!rc) {
-		st->cstat_fields.dirty = 1;
-		st->cstat_fields.writeback = 1;
-		st->cstat_fields.evicted = 1;
-		st->cstat_fields.recently_evicted = 1;
+
+	if (ctl->extents)
+		return fincore_extents(ctl, fd, st);
+
+	rc = cachestat_range(fd, st, 0, st->file_size);
+	if (!rc)
 		return 0;
-	}
 
-	if (errno != ENOSYS)
+	if (rc != -ENOSYS)
 		warn(_("failed to do cachestat: %s"), st->name);
 
 	return mincore_fd(ctl, fd, st);
 }
 
 /*
- * Returns: <0 on error, 0 success, 1 ignore.
+ * Returns: <0 on error, 0 success, 1 ignore (or already printed).
  */
 static int fincore_name(struct fincore_control *ctl,
 			struct fincore_state *st)
@@ -383,11 +567,135 @@ static int fincore_name(struct fincore_control *ctl,
 
 	if (!rc)
 		rc = fincore_fd(ctl, fd, st);
+	if (!rc)
+		st->nfiles = 1;
 
 	close (fd);
 	return rc;
 }
 
+/* prints directory summaries from the deepest one up to @level */
+static void flush_sums(struct fincore_control *ctl, int level)
+{
+	int i;
+
+	for (i = ctl->depth; i >= level; i--) {
+		struct fincore_state *sum = &ctl->sums[i];
+
+		if (!sum->name)
+			continue;
+		output_state(ctl, sum);
+		free((char *) sum->name);
+		memset(sum, 0, sizeof(*sum));
+	}
+}
+
+/*
+ * Adds @st to the summaries of all its parent directories up to --depth. The
+ * walker returns the whole subtree of a directory before its next sibling, so
+ * a summary is complete (and printed) when a file from another directory is
+ * seen on the same level.
+ */
+static void sum_state(struct fincore_control *ctl, struct fincore_state *st,
+		      int level)
+{
+	const char *p = st->name + ctl->rootsz;
+	int i;
+
+	for (i = 0; i <= ctl->depth && i < level; i++) {
+		struct fincore_state *sum = &ctl->sums[i];
+		size_t sz;
+
+		if (i > 0) {
+			while (*p == '/')
+				p++;
+			p += strcspn(p, "/");
+		}
+		sz = p - st->name;
+
+		if (sum->name && (strncmp(sum->name, st->name, sz) != 0
+				  || sum->name[sz] != '\0'))
+			flush_sums(ctl, i);
+		if (!sum->name) {
+			sum->name = xstrndup(st->name, sz);
+			sum->cstat_fields.dirty = 1;
+			sum->cstat_fields.writeback = 1;
+			sum->cstat_fields.evicted = 1;
+			sum->cstat_fields.recently_evicted = 1;
+		}
+
+		sum->nfiles += st->nfiles;
+		sum->file_size += st->file_size;
+		sum->cstat.nr_cache += st->cstat.nr_cache;
+		sum->cstat.nr_dirty += st->cstat.nr_dirty;
+		sum->cstat.nr_writeback += st->cstat.nr_writeback;
+		sum->cstat.nr_evicted += st->cstat.nr_evicted;
+		sum->cstat.nr_recently_evicted += st->cstat.nr_recently_evicted;
+		sum->cstat_fields.dirty &= st->cstat_fields.dirty;
+		sum->cstat_fields.writeback &= st->cstat_fields.writeback;
+		sum->cstat_fields.evicted &= st->cstat_fields.evicted;
+		sum->cstat_fields.recently_evicted &= st->cstat_fields.recently_evicted;
+	}
+}
+
+/* the walker callback has no private data */
+static struct fincore_control *walk_ctl;
+
+static int fincore_walk(const char *fpath,
+			const struct stat *sb __attribute__((__unused__)),
+			int type, struct FTW *ftwbuf)
+{
+	struct fincore_control *ctl = walk_ctl;
+	struct fincore_state st = {
+		.name = fpath,
+	};
+
+	switch (type) {
+	case FTW_DNR:
+		warn(_("cannot read directory %s"), fpath);
+		ctl->rc = EXIT_FAILURE;
+		return 0;
+	case FTW_NS:
+		warnx(_("cannot stat %s"), fpath);
+		ctl->rc = EXIT_FAILURE;
+		return 0;
+	case FTW_F:
+		break;
+	default:
+		return 0;
+	}
+
+	switch (fincore_name(ctl, &st)) {
+	case 0:
+		if (ctl->depth >= 0 && ftwbuf->level > 0)
+			sum_state(ctl, &st, ftwbuf->level);
+		else
+			output_state(ctl, &st);
+		break;
+	case 1:
+		break; /* ignore */
+	default:
+		ctl->rc = EXIT_FAILURE;
+		break;
+	}
+	return 0;
+}
+
+static void fincore_tree(struct fincore_control *ctl, const char *path)
+{
+	ctl->rootsz = strlen(path);
+	while (ctl->rootsz > 1 && path[ctl->rootsz - 1] == '/')
+		ctl->rootsz--;
+
+	walk_ctl = ctl;
+	if (ul_walkdir(path, fincore_walk, UL_WALKDIR_REGULAR, ctl->nthreads) != 0) {
+		warn(_("cannot walk %s"), path);
+		ctl->rc = EXIT_FAILURE;
+	}
+	if (ctl->depth >= 0)
+		flush_sums(ctl, 0);
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -399,10 +707,16 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -J, --json            use JSON output format\n"), out);
 	fputs(_(" -b, --bytes           print sizes in bytes rather than in human readable format\n"), out);
+	fputs(_(" -E, --extents         print a line for every data extent of the files\n"), out);
 	fputs(_(" -n, --noheadings      don't print headings\n"), out);
 	fputs(_(" -o, --output <list>   output columns\n"), out);
 	fputs(_("     --output-all      output all columns\n"), out);
 	fputs(_(" -r, --raw             use raw output format\n"), out);
+	fputs(_(" -R, --recursive       count files in directories recursively\n"), out);
+	fputs(_(" -d, --depth <num>     with --recursive, print totals of directories\n"
+		"                         up to <num> levels below the arguments\n"), out);
+	fputs(_(" -t, --top <num>       print only <num> entries with the most resident data\n"), out);
+	fputs(_("     --threads <num>   number of threads to read directories\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(23));
@@ -421,18 +735,22 @@ int main(int argc, char ** argv)
 {
 	int c;
 	size_t i;
-	int rc = EXIT_SUCCESS;
 	char *outarg = NULL;
 
 	struct fincore_control ctl = {
-		.pagesize = getpagesize()
+		.pagesize = getpagesize(),
+		.depth = -1,
+		.nthreads = 1,
+		.rc = EXIT_SUCCESS
 	};
 
 	enum {
-		OPT_OUTPUT_ALL = CHAR_MAX + 1
+		OPT_OUTPUT_ALL = CHAR_MAX + 1,
+		OPT_THREADS
 	};
 	static const struct option longopts[] = {
 		{ "bytes",      no_argument, NULL, 'b' },
+		{ "extents",    no_argument, NULL, 'E' },
 		{ "noheadings", no_argument, NULL, 'n' },
 		{ "output",     required_argument, NULL, 'o' },
 		{ "output-all",	no_argument,       NULL, OPT_OUTPUT_ALL },
@@ -440,6 +758,10 @@ int main(int argc, char ** argv)
 		{ "help",	no_argument, NULL, 'h' },
 		{ "json",       no_argument, NULL, 'J' },
 		{ "raw",        no_argument, NULL, 'r' },
+		{ "recursive",  no_argument, NULL, 'R' },
+		{ "depth",      required_argument, NULL, 'd' },
+		{ "top",        required_argument, NULL, 't' },
+		{ "threads",    required_argument, NULL, OPT_THREADS },
 		{ NULL, 0, NULL, 0 },
 	};
 
@@ -448,11 +770,14 @@ int main(int argc, char ** argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long (argc, argv, "bno:JrVh", longopts, NULL)) != -1) {
+	while ((c = getopt_long (argc, argv, "bd:Eno:JrRt:Vh", longopts, NULL)) != -1) {
 		switch (c) {
 		case 'b':
 			ctl.bytes = 1;
 			break;
+		case 'E':
+			ctl.extents = 1;
+			break;
 		case 'n':
 			ctl.noheadings = 1;
 			break;
@@ -469,6 +794,23 @@ int main(int argc, char ** argv)
 		case 'r':
 			ctl.raw = 1;
 			break;
+		case 'R':
+			ctl.recursive = 1;
+			break;
+		case 'd':
+			ctl.depth = str2num_or_err(optarg, 10,
+					_("failed to parse depth"), 0, 1024);
+			break;
+		case 't':
+			ctl.top = str2unum_or_err(optarg, 10,
+					_("failed to parse number of entries"), SIZE_MAX);
+			break;
+		case OPT_THREADS:
+			ctl.nthreads = str2unum_or_err(optarg, 10,
+					_("failed to parse number of threads"), 1024);
+			if (!ctl.nthreads)
+				ctl.nthreads = 1;
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -483,9 +825,20 @@ int main(int argc, char ** argv)
 		errtryhelp(EXIT_FAILURE);
 	}
 
+	if (ctl.depth >= 0 && !ctl.recursive) {
+		warnx(_("--depth requires --recursive"));
+		errtryhelp(EXIT_FAILURE);
+	}
+	if (ctl.depth >= 0 && ctl.extents) {
+		warnx(_("--depth and --extents are mutually exclusive"));
+		errtryhelp(EXIT_FAILURE);
+	}
+
 	if (!ncolumns) {
 		columns[ncolumns++] = COL_RES;
 		columns[ncolumns++] = COL_PAGES;
+		if (ctl.extents)
+			columns[ncolumns++] = COL_OFFSET;
 		columns[ncolumns++] = COL_SIZE;
 		columns[ncolumns++] = COL_FILE;
 	}
@@ -522,6 +875,7 @@ int main(int argc, char ** argv)
 				break;
 			case COL_SIZE:
 			case COL_RES:
+			case COL_OFFSET:
 				if (!ctl.bytes)
 					break;
 				/* fallthrough */
@@ -532,25 +886,37 @@ int main(int argc, char ** argv)
 		}
 	}
 
+	if (ctl.depth >= 0)
+		ctl.sums = xcalloc(ctl.depth + 1, sizeof(*ctl.sums));
+
 	for(; optind < argc; optind++) {
 		struct fincore_state st = {
 			.name = argv[optind],
 		};
 
+		if (ctl.recursive) {
+			fincore_tree(&ctl, argv[optind]);
+			continue;
+		}
+
 		switch (fincore_name(&ctl, &st)) {
 		case 0:
-			add_output_data(&ctl, &st);
+			output_state(&ctl, &st);
 			break;
 		case 1:
 			break; /* ignore */
 		default:
-			rc = EXIT_FAILURE;
+			ctl.rc = EXIT_FAILURE;
 			break;
 		}
 	}
 
+	output_tops(&ctl);
+	free(ctl.tops);
+	free(ctl.sums);
+
 	scols_print_table(ctl.tb);
 	scols_unref_table(ctl.tb);
 
-	return rc;
+	return ctl.rc;
 }
@@ -6,9 +6,14 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <libmount.h>
 #include <blkid.h>
 #include <sys/utsname.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <inttypes.h>
 
 #include "nls.h"
 #include "c.h"
@@ -16,9 +21,47 @@
 #include "xalloc.h"
 #include "pathnames.h"
 #include "match.h"
+#include "all-io.h"
 
 #include "findmnt.h"
 
+enum {
+	VFY_CHECK_ORDER = 0,
+	VFY_CHECK_TARGET,
+	VFY_CHECK_OPTIONS,
+	VFY_CHECK_SWAPAREA,
+	VFY_CHECK_SOURCE,
+	VFY_CHECK_FSTYPE,
+	VFY_CHECK_PASSNO,
+
+	VFY_NCHECKS
+};
+
+static const char *check_names[] = {
+	[VFY_CHECK_ORDER]	= "order",
+	[VFY_CHECK_TARGET]	= "target",
+	[VFY_CHECK_OPTIONS]	= "options",
+	[VFY_CHECK_SWAPAREA]	= "swaparea",
+	[VFY_CHECK_SOURCE]	= "source",
+	[VFY_CHECK_FSTYPE]	= "fstype",
+	[VFY_CHECK_PASSNO]	= "passno"
+};
+
+/* one fstab entry verified by a child process (--verify-jobs) */
+struct verify_job {
+	struct libmnt_fs	*fs;
+	pid_t		pid;
+	int		fd;		/* pipe with messages from the child */
+	uint64_t	start;
+
+	char		*buf;		/* messages, see send_record() */
+	size_t		len;
+
+	unsigned int	done : 1,
+			timedout : 1,
+			failed : 1;
+};
+
 struct verify_context {
 	struct libmnt_fs	*fs;
 	struct libmnt_table	*tb;
@@ -30,21 +73,55 @@ struct verify_context {
 	int	nwarnings;
 	int	nerrors;
 
+	int	out_fd;				/* in child process, or -1 */
+	uint64_t usec[VFY_NCHECKS];		/* time spent in the checks */
+	uint64_t ncalls[VFY_NCHECKS];
+
 	unsigned int	target_printed : 1,
 			no_fsck : 1;
 };
 
-static void __attribute__ ((__format__ (__printf__, 3, 0)))
-	verify_mesg(struct verify_context *vfy, char type, const char *fmt, va_list ap)
+static uint64_t now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * The child writes records to the pipe: one byte with the type and
+ * a NUL-terminated string.
+ */
+static void send_record(struct verify_context *vfy, char type, const char *str)
+{
+	if (write_all(vfy->out_fd, &type, 1) != 0 ||
+	    write_all(vfy->out_fd, str, strlen(str) + 1) != 0)
+		_exit(EXIT_FAILURE);
+}
+
+static void print_mesg(struct verify_context *vfy, char type, const char *str)
 {
 	if (!vfy->target_printed && vfy->fs) {
 		fprintf(stdout, "%s\n", mnt_fs_get_target(vfy->fs));
 		vfy->target_printed = 1;
 	}
 
-	fprintf(stdout, "   [%c] ", type);
-	vfprintf(stdout, fmt, ap);
-	fputc('\n', stdout);
+	fprintf(stdout, "   [%c] %s\n", type, str);
+}
+
+static void __attribute__ ((__format__ (__printf__, 3, 0)))
+	verify_mesg(struct verify_context *vfy, char type, const char *fmt, va_list ap)
+{
+	char *str = NULL;
+
+	xvasprintf(&str, fmt, ap);
+
+	if (vfy->out_fd >= 0)
+		send_record(vfy, type, str);
+	else
+		print_mesg(vfy, type, str);
+	free(str);
 }
 
 static int __attribute__ ((__format__ (__printf__, 2, 3)))
@@ -494,35 +571,285 @@ static int verify_passno(struct verify_context *vfy)
 	return 0;
 }
 
-static int verify_filesystem(struct verify_context *vfy)
+static int run_check(struct verify_context *vfy, int id,
+		     int (*check)(struct verify_context *))
+{
+	uint64_t start = now_usec();
+	int rc = check(vfy);
+
+	vfy->usec[id] += now_usec() - start;
+	vfy->ncalls[id]++;
+	return rc;
+}
+
+static int verify_filesystem(struct verify_context *vfy, int check_order)
 {
 	int rc = 0;
 
+	if (check_order)
+		rc = run_check(vfy, VFY_CHECK_ORDER, verify_order);
+	if (rc)
+		return rc;
+
 	if (mnt_fs_is_swaparea(vfy->fs))
-		rc = verify_swaparea(vfy);
+		rc = run_check(vfy, VFY_CHECK_SWAPAREA, verify_swaparea);
 	else {
-		rc = verify_target(vfy);
+		rc = run_check(vfy, VFY_CHECK_TARGET, verify_target);
 		if (!rc)
-			rc = verify_options(vfy);
+			rc = run_check(vfy, VFY_CHECK_OPTIONS, verify_options);
 	}
 
 	if (!rc)
-		rc = verify_source(vfy);
+		rc = run_check(vfy, VFY_CHECK_SOURCE, verify_source);
 	if (!rc)
-		rc = verify_fstype(vfy);
+		rc = run_check(vfy, VFY_CHECK_FSTYPE, verify_fstype);
 	if (!rc)
-		rc = verify_passno(vfy);	/* depends on verify_fstype() */
+		/* depends on verify_fstype() */
+		rc = run_check(vfy, VFY_CHECK_PASSNO, verify_passno);
 
 	return rc;
 }
 
-int verify_table(struct libmnt_table *tb)
+/* child process; verify the filesystem and send messages and timing */
+static void __attribute__((__noreturn__))
+	verify_child(struct verify_context *vfy, int fd, int check_order)
+{
+	char buf[64];
+	size_t i;
+	int rc;
+
+	vfy->out_fd = fd;
+	memset(vfy->usec, 0, sizeof(vfy->usec));
+	memset(vfy->ncalls, 0, sizeof(vfy->ncalls));
+
+	rc = verify_filesystem(vfy, check_order);
+
+	for (i = 0; i < VFY_NCHECKS; i++) {
+		if (!vfy->ncalls[i])
+			continue;
+		snprintf(buf, sizeof(buf), "%zu %"PRIu64" %"PRIu64,
+				i, vfy->usec[i], vfy->ncalls[i]);
+		send_record(vfy, 'T', buf);
+	}
+	_exit(rc ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static int start_job(struct verify_context *vfy, struct verify_job *job,
+		     int check_order)
 {
-	struct verify_context vfy = { .nerrors = 0 };
+	int fds[2];
+
+	if (pipe(fds) != 0) {
+		warn(_("cannot create pipe"));
+		return -errno;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	job->fs = vfy->fs;
+	job->start = now_usec();
+	job->pid = fork();
+
+	switch (job->pid) {
+	case -1:
+		warn(_("fork failed"));
+		close(fds[0]);
+		close(fds[1]);
+		return -errno;
+	case 0:
+		close(fds[0]);
+		verify_child(vfy, fds[1], check_order);
+	default:
+		close(fds[1]);
+		job->fd = fds[0];
+		break;
+	}
+	return 0;
+}
+
+static void finish_job(struct verify_job *job, int timedout)
+{
+	int status = 0;
+
+	if (timedout)
+		kill(job->pid, SIGKILL);
+	while (waitpid(job->pid, &status, 0) < 0 && errno == EINTR)
+		;
+
+	close(job->fd);
+	job->fd = -1;
+	job->done = 1;
+	job->timedout = timedout;
+	job->failed = !timedout &&
+		(!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS);
+}
+
+/* print messages from the child process and update counters */
+static int flush_job(struct verify_context *vfy, struct verify_job *job,
+		     unsigned int timeout)
+{
+	const char *p = job->buf, *end = job->buf + job->len;
+
+	vfy->fs = job->fs;
+	vfy->target_printed = 0;
+
+	while (p && p < end) {
+		char type = *p++;
+		size_t sz = strnlen(p, end - p);
+
+		if (p + sz >= end)
+			break;			/* incomplete record */
+		if (type == 'T') {
+			size_t id;
+			uint64_t usec, ncalls;
+
+			if (sscanf(p, "%zu %"SCNu64" %"SCNu64, &id, &usec, &ncalls) == 3
+			    && id < VFY_NCHECKS) {
+				vfy->usec[id] += usec;
+				vfy->ncalls[id] += ncalls;
+			}
+		} else {
+			if (type == 'W')
+				vfy->nwarnings++;
+			else if (type == 'E')
+				vfy->nerrors++;
+			print_mesg(vfy, type, p);
+		}
+		p += sz + 1;
+	}
+
+	if (job->timedout)
+		verify_err(vfy, P_("verification timed out after %u second",
+				   "verification timed out after %u seconds",
+				   timeout), timeout);
+
+	free(job->buf);
+	memset(job, 0, sizeof(*job));
+	job->fd = -1;
+	return job->failed ? -EINVAL : 0;
+}
+
+/* wait for data or a timeout of any running job */
+static void wait_jobs(struct verify_job *jobs, size_t njobs, unsigned int timeout)
+{
+	struct pollfd *pfds = xcalloc(njobs, sizeof(struct pollfd));
+	struct verify_job **polled = xcalloc(njobs, sizeof(struct verify_job *));
+	uint64_t now = now_usec();
+	int tmout = -1;
+	size_t i, n = 0;
+
+	for (i = 0; i < njobs; i++) {
+		struct verify_job *job = &jobs[i];
+
+		if (!job->fs || job->done)
+			continue;
+		if (timeout) {
+			uint64_t deadline = job->start + (uint64_t) timeout * 1000000;
+			int ms;
+
+			if (deadline <= now) {
+				finish_job(job, 1);
+				tmout = 0;
+				continue;
+			}
+			ms = (deadline - now + 999) / 1000;
+			if (tmout < 0 || ms < tmout)
+				tmout = ms;
+		}
+		pfds[n].fd = job->fd;
+		pfds[n].events = POLLIN;
+		polled[n] = job;
+		n++;
+	}
+
+	if (n && poll(pfds, n, tmout) > 0) {
+		for (i = 0; i < n; i++) {
+			struct verify_job *job = polled[i];
+			char buf[BUFSIZ];
+			ssize_t sz;
+
+			if (!pfds[i].revents)
+				continue;
+			sz = read(job->fd, buf, sizeof(buf));
+			if (sz < 0 && (errno == EAGAIN || errno == EINTR))
+				continue;
+			if (sz <= 0) {
+				finish_job(job, 0);
+				continue;
+			}
+			job->buf = xrealloc(job->buf, job->len + sz);
+			memcpy(job->buf + job->len, buf, sz);
+			job->len += sz;
+		}
+	}
+	free(polled);
+	free(pfds);
+}
+
+/*
+ * Verify filesystems by child processes; the output is printed in the order
+ * of the entries in the table.
+ */
+static int verify_parallel(struct verify_context *vfy, struct libmnt_iter *itr,
+			   int check_order, unsigned int njobs, unsigned int timeout)
+{
+	struct verify_job *jobs = xcalloc(njobs, sizeof(struct verify_job));
+	size_t head = 0, nused = 0, i;
+	int rc = 0, eof = 0;
+
+	for (i = 0; i < njobs; i++)
+		jobs[i].fd = -1;
+
+	while (!eof || nused) {
+		/* start new jobs */
+		while (rc == 0 && !eof && nused < njobs) {
+			vfy->fs = get_next_fs(vfy->tb, itr);
+			if (!vfy->fs) {
+				eof = 1;
+				break;
+			}
+			rc = start_job(vfy, &jobs[(head + nused) % njobs], check_order);
+			if (rc)
+				break;
+			nused++;
+
+			if (flags & FL_FIRSTONLY)
+				eof = 1;
+			flags |= FL_NOSWAPMATCH;
+		}
+		if (rc)
+			eof = 1;
+		if (!nused)
+			break;
+
+		/* the first job has to be printed first */
+		if (!jobs[head].done)
+			wait_jobs(jobs, njobs, timeout);
+
+		while (nused && jobs[head].done) {
+			int x = flush_job(vfy, &jobs[head], timeout);
+
+			if (x && !rc)
+				rc = x;
+			head = (head + 1) % njobs;
+			nused--;
+		}
+	}
+
+	vfy->fs = NULL;
+	free(jobs);
+	return rc;
+}
+
+int verify_table(struct libmnt_table *tb, unsigned int njobs, unsigned int timeout)
+{
+	struct verify_context vfy = { .nerrors = 0, .out_fd = -1 };
 	struct libmnt_iter *itr;
 	int rc = 0;		/* overall return code (alloc errors, etc.) */
 	int check_order = is_listall_mode();
 	static int has_read_fs = 0;
+	size_t i;
 
 	itr = mnt_new_iter(MNT_ITER_FORWARD);
 	if (!itr) {
@@ -538,14 +865,13 @@ int verify_table(struct libmnt_table *tb)
 		has_read_fs = 1;
 	}
 
-	while (rc == 0 && (vfy.fs = get_next_fs(tb, itr))) {
+	if (njobs > 1 || timeout)
+		rc = verify_parallel(&vfy, itr, check_order, max(njobs, 1U), timeout);
+	else while (rc == 0 && (vfy.fs = get_next_fs(tb, itr))) {
 		vfy.target_printed = 0;
 		vfy.no_fsck = 0;
 
-		if (check_order)
-			rc = verify_order(&vfy);
-		if (!rc)
-			rc = verify_filesystem(&vfy);
+		rc = verify_filesystem(&vfy, check_order);
 
 		if (flags & FL_FIRSTONLY)
 			break;
@@ -578,6 +904,17 @@ done:
 	} else
 		fprintf(stdout, _("Success, no errors or warnings detected\n"));
 
+	if (flags & FL_VERBOSE) {
+		fputs(_("\nTime spent in checks:\n"), stdout);
+		for (i = 0; i < VFY_NCHECKS; i++) {
+			if (!vfy.ncalls[i])
+				continue;
+			fprintf(stdout, "   %-10s %10.3f ms  (%"PRIu64" %s)\n",
+				check_names[i], vfy.usec[i] / 1000.0, vfy.ncalls[i],
+				P_("entry", "entries", vfy.ncalls[i]));
+		}
+	}
+
 
 	free_proc_filesystems(&vfy);
 
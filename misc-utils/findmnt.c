@@ -49,6 +49,8 @@
 #include "optutils.h"
 #include "mangle.h"
 #include "buffer.h"
+#include "jsonwrt.h"
+#include "monotonic.h"
 #include "column-list-table.h"
 
 #include "findmnt.h"
@@ -700,7 +702,8 @@ static char *get_data(struct libmnt_fs *fs, int num, size_t *datasiz)
 		if (!devno)
 			break;
 
-		if ((flags & FL_RAW) || (flags & FL_EXPORT) || (flags & FL_JSON))
+		if ((flags & FL_RAW) || (flags & FL_EXPORT) || (flags & FL_JSON) ||
+		    (flags & FL_CBOR))
 			xasprintf(&str, "%u:%u", major(devno), minor(devno));
 		else
 			xasprintf(&str, "%3u:%-3u", major(devno), minor(devno));
@@ -979,9 +982,14 @@ static char **append_pid_tabfile(char **files, int *nfiles, pid_t pid)
 }
 
 /* calls libmount fstab/mtab/mountinfo parser */
+/*
+ * The @target is not NULL if only the mount of the target path is necessary,
+ * then the kernel table is read by statx() and statmount() for the path only.
+ */
 static struct libmnt_table *parse_tabfiles(char **files,
 					   int nfiles,
-					   int tabtype)
+					   int tabtype,
+					   const char *target)
 {
 	struct libmnt_table *tb;
 	int rc = 0;
@@ -1005,6 +1013,22 @@ static struct libmnt_table *parse_tabfiles(char **files,
 			rc = mnt_table_parse_mtab(tb, path);
 			break;
 		case TABTYPE_KERNEL:
+			if (!path && target) {
+				rc = mnt_table_fetch_listmount_target(tb, target);
+				if (rc != -ENOSYS) {
+					path = "statmount";
+					break;
+				}
+				rc = 0;	/* unsupported, read all */
+			}
+			if (!path && (flags & FL_LISTMOUNT)) {
+				rc = mnt_table_fetch_listmount(tb);
+				if (rc != -ENOSYS) {
+					path = "listmount";
+					break;
+				}
+				rc = 0;	/* unsupported, try mountinfo */
+			}
 			if (!path)
 				path = access(_PATH_PROC_MOUNTINFO, R_OK) == 0 ?
 					      _PATH_PROC_MOUNTINFO :
@@ -1254,8 +1278,298 @@ static int poll_match(struct libmnt_fs *fs)
 	return rc;
 }
 
+/*
+ * Prints the @table lines as JSON objects, one object per line (JSON Lines).
+ * The output is flushed after each line to make it usable for pipes.
+ */
+static int print_json_lines(struct libscols_table *table)
+{
+	struct libscols_iter *itr;
+	struct libscols_line *ln;
+	struct ul_jsonwrt json;
+	FILE *out = scols_table_get_stream(table);
+	size_t i, ncols = scols_table_get_ncols(table);
+
+	itr = scols_new_iter(SCOLS_ITER_FORWARD);
+	if (!itr) {
+		warn(_("failed to initialize libsmartcols iterator"));
+		return -ENOMEM;
+	}
+
+	while (scols_table_next_line(table, itr, &ln) == 0) {
+		ul_jsonwrt_init(&json, out, 0);
+		ul_jsonwrt_set_compact(&json, 1);
+		ul_jsonwrt_root_open(&json);
+
+		for (i = 0; i < ncols; i++) {
+			struct libscols_column *cl = scols_table_get_column(table, i);
+			struct libscols_cell *ce = scols_line_get_cell(ln, i);
+			const char *name = scols_column_get_name(cl);
+			const char *data = scols_cell_get_data(ce);
+			size_t sz;
+
+			if (!data || !*data) {
+				ul_jsonwrt_value_null(&json, name);
+				continue;
+			}
+			switch (scols_column_get_json_type(cl)) {
+			case SCOLS_JSON_NUMBER:
+				ul_jsonwrt_value_raw(&json, name, data);
+				break;
+			case SCOLS_JSON_ARRAY_STRING:
+				/* zero separated chunks, see scols_wrapzero_nextchunk() */
+				sz = scols_cell_get_datasiz(ce);
+				ul_jsonwrt_array_open(&json, name);
+				while (sz && *data) {
+					size_t len = strnlen(data, sz);
+
+					ul_jsonwrt_value_s_sized(&json, NULL, data, len);
+					if (len + 1 >= sz)
+						break;
+					data += len + 1;
+					sz -= len + 1;
+				}
+				ul_jsonwrt_array_close(&json);
+				break;
+			default:
+				ul_jsonwrt_value_s(&json, name, data);
+				break;
+			}
+		}
+		ul_jsonwrt_root_close(&json);
+		ul_jsonwrt_flush(&json);
+	}
+
+	scols_free_iter(itr);
+	return 0;
+}
+
+static int print_poll_lines(struct libscols_table *table)
+{
+	int rc;
+
+	if (flags & FL_JSONLINES)
+		rc = print_json_lines(table);
+	else {
+		FILE *out = scols_table_get_stream(table);
+
+		/* the last line of the range is not terminated */
+		rc = scols_table_print_range(table, NULL, NULL);
+		if (!rc && !(flags & FL_JSON))
+			fputc('\n', out);
+		fflush(out);
+	}
+
+	/* remove already printed lines to reduce memory usage */
+	scols_table_remove_lines(table);
+	return rc;
+}
+
+/*
+ * Adds the matching changes from @diff to the output @table. Returns number
+ * of the added lines or <0 on error.
+ */
+static int add_tabdiff_lines(struct libscols_table *table,
+			     struct libmnt_tabdiff *diff,
+			     struct libmnt_iter *itr, int direction)
+{
+	struct libmnt_fs *old, *new;
+	int change, count = 0;
+
+	mnt_reset_iter(itr, direction);
+	while(mnt_tabdiff_next_change(
+			diff, itr, &old, &new, &change) == 0) {
+
+		/* findmnt has no separate action for propagation changes */
+		if (change == MNT_TABDIFF_PROPAGATION)
+			change = MNT_TABDIFF_REMOUNT;
+		if (!has_poll_action(change))
+			continue;
+		if (!poll_match(new ? new : old))
+			continue;
+		count++;
+		if (!add_tabdiff_line(table, new, old, change))
+			return -1;
+		if (flags & FL_FIRSTONLY)
+			break;
+	}
+	return count;
+}
+
+/* returns remaining time of the batching window in milliseconds */
+static int window_remaining(struct timeval *end)
+{
+	struct timeval now;
+
+	gettime_monotonic(&now);
+	if (!timercmp(&now, end, <))
+		return 0;
+	timersub(end, &now, &now);
+	return now.tv_sec * 1000 + (now.tv_usec + 999) / 1000;
+}
+
+static void window_start(struct timeval *end, int window)
+{
+	struct timeval win = { .tv_sec = window / 1000,
+			       .tv_usec = (window % 1000) * 1000 };
+
+	gettime_monotonic(end);
+	timeradd(end, &win, end);
+}
+
+static void add_mount_id(uint64_t **ids, size_t *nids, uint64_t id)
+{
+	size_t i;
+
+	for (i = 0; i < *nids; i++) {
+		if ((*ids)[i] == id)
+			return;
+	}
+	*ids = xreallocarray(*ids, *nids + 1, sizeof(uint64_t));
+	(*ids)[(*nids)++] = id;
+}
+
+/*
+ * Reads all pending mount IDs from the monitor. Returns 1 if the kernel has
+ * dropped some events and the whole table has to be re-read.
+ */
+static int read_mount_ids(struct libmnt_monitor *mn, uint64_t **ids, size_t *nids)
+{
+	uint64_t id;
+	int rc, resync = 0;
+
+	while ((rc = mnt_monitor_next_mount(mn, &id, NULL)) != 1) {
+		if (rc == -ENOBUFS)
+			resync = 1;
+		else if (rc < 0)
+			return rc;
+		else
+			add_mount_id(ids, nids, id);
+	}
+	return resync;
+}
+
+/*
+ * Monitors the kernel mount table by fanotify and updates the table entries
+ * by statmount() for the changed mount IDs only. The changes within the
+ * batching @window are coalesced, the mount ID is read only once.
+ *
+ * The fanotify monitor does not report changes of the mount options, so this
+ * is usable only if "remount" action is not requested.
+ *
+ * Returns 1 if the fanotify based monitor is not supported.
+ */
+static int poll_mounts(int timeout, int window,
+		       struct libscols_table *table, int direction)
+{
+	struct libmnt_monitor *mn;
+	struct libmnt_table *tb = NULL, *tb_new = NULL;
+	struct libmnt_tabdiff *diff = NULL;
+	struct libmnt_iter *itr = NULL;
+	uint64_t *ids = NULL;
+	size_t nids = 0, i;
+	int rc = 1;
+
+	if (has_poll_action(MNT_TABDIFF_REMOUNT))
+		return 1;
+
+	mn = mnt_new_monitor();
+	if (!mn || mnt_monitor_enable_fanotify(mn, 1) != 0)
+		goto done;
+
+	tb = mnt_new_table();
+	if (!tb)
+		goto done;
+	if (mnt_table_fetch_listmount(tb) != 0)
+		goto done;
+
+	rc = -1;
+	itr = mnt_new_iter(direction);
+	if (!itr) {
+		warn(_("failed to initialize libmount iterator"));
+		goto done;
+	}
+	diff = mnt_new_tabdiff();
+	if (!diff) {
+		warn(_("failed to initialize libmount tabdiff"));
+		goto done;
+	}
+
+	while (1) {
+		struct timeval end;
+		int count, resync;
+
+		count = mnt_monitor_wait(mn, timeout);
+		if (count == 0)
+			break;	/* timeout */
+		if (count < 0) {
+			warn(_("poll() failed"));
+			goto done;
+		}
+
+		resync = read_mount_ids(mn, &ids, &nids);
+		if (window > 0) {
+			int ms;
+
+			window_start(&end, window);
+			while (resync >= 0 && (ms = window_remaining(&end)) > 0) {
+				if (mnt_monitor_wait(mn, ms) <= 0)
+					break;
+				count = read_mount_ids(mn, &ids, &nids);
+				if (count)
+					resync = count;
+			}
+		}
+		if (resync < 0)
+			goto done;
+
+		if (resync) {
+			/* events dropped by kernel, compare with whole table */
+			struct libmnt_table *tmp;
+
+			if (!tb_new)
+				tb_new = mnt_new_table();
+			if (!tb_new || mnt_table_fetch_listmount(tb_new) != 0
+			    || mnt_diff_tables(diff, tb, tb_new) < 0)
+				goto done;
+			tmp = tb;
+			tb = tb_new;
+			tb_new = tmp;
+		} else {
+			for (i = 0; i < nids; i++) {
+				if (mnt_table_update_mount(tb, ids[i], diff) < 0)
+					goto done;
+			}
+		}
+		nids = 0;
+
+		count = add_tabdiff_lines(table, diff, itr, direction);
+		if (count < 0)
+			goto done;
+		if (count && print_poll_lines(table) != 0)
+			goto done;
+
+		mnt_reset_tabdiff(diff);
+		if (tb_new)
+			mnt_reset_table(tb_new);
+
+		if (count && (flags & FL_FIRSTONLY))
+			break;
+	}
+
+	rc = 0;
+done:
+	free(ids);
+	mnt_unref_table(tb);
+	mnt_unref_table(tb_new);
+	mnt_free_tabdiff(diff);
+	mnt_free_iter(itr);
+	mnt_unref_monitor(mn);
+	return rc;
+}
+
 static int poll_table(struct libmnt_table *tb, const char *tabfile,
-		  int timeout, struct libscols_table *table, int direction)
+		  int timeout, int window, struct libscols_table *table, int direction)
 {
 	FILE *f = NULL;
 	int rc = -1;
@@ -1299,8 +1613,7 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 
 	while (1) {
 		struct libmnt_table *tmp;
-		struct libmnt_fs *old, *new;
-		int change, count;
+		int count;
 
 		count = poll(fds, 1, timeout);
 		if (count == 0)
@@ -1310,6 +1623,17 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 			goto done;
 		}
 
+		if (window > 0) {
+			/* coalesce all changes within the window to one diff */
+			struct timeval end;
+			int ms;
+
+			window_start(&end, window);
+			while ((ms = window_remaining(&end)) > 0
+			       && poll(fds, 1, ms) >= 0)
+				;
+		}
+
 		rewind(f);
 		rc = mnt_table_parse_stream(tb_new, f, tabfile);
 		if (!rc)
@@ -1317,37 +1641,18 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 		if (rc < 0)
 			goto done;
 
-		count = 0;
-		mnt_reset_iter(itr, direction);
-		while(mnt_tabdiff_next_change(
-				diff, itr, &old, &new, &change) == 0) {
-
-			if (!has_poll_action(change))
-				continue;
-			if (!poll_match(new ? new : old))
-				continue;
-			count++;
-			rc = !add_tabdiff_line(table, new, old, change);
-			if (rc)
-				goto done;
-			if (flags & FL_FIRSTONLY)
-				break;
-		}
-
-		if (count) {
-			rc = scols_table_print_range(table, NULL, NULL);
-			fflush(scols_table_get_stream(table));
-			if (rc)
-				goto done;
-		}
+		rc = -1;
+		count = add_tabdiff_lines(table, diff, itr, direction);
+		if (count < 0)
+			goto done;
+		if (count && print_poll_lines(table) != 0)
+			goto done;
 
 		/* swap tables */
 		tmp = tb;
 		tb = tb_new;
 		tb_new = tmp;
 
-		/* remove already printed lines to reduce memory usage */
-		scols_table_remove_lines(table);
 		mnt_reset_table(tb_new);
 
 		if (count && (flags & FL_FIRSTONLY))
@@ -1372,6 +1677,14 @@ static int uniq_fs_target_cmp(
 	return !mnt_fs_match_target(a, mnt_fs_get_target(b), cache);
 }
 
+/* kernel tables contain canonicalized paths only */
+static size_t uniq_fs_target_hash(
+		struct libmnt_table *tb __attribute__((__unused__)),
+		struct libmnt_fs *fs)
+{
+	return ul_hash_path(mnt_fs_get_target(fs));
+}
+
 static int get_column_json_type(int id, int scols_flags, int *multi)
 {
 	switch (id) {
@@ -1418,11 +1731,15 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -s, --fstab            search in static table of filesystems\n"), out);
 	fputs(_(" -m, --mtab             search in table of mounted filesystems\n"
 		"                          (includes user space mount options)\n"), out);
-	fputs(_(" -k, --kernel           search in kernel table of mounted\n"
-		"                          filesystems (default)\n"), out);
+	fputs(_(" -k, --kernel[=<method>]\n"
+		"                         search in kernel table of mounted\n"
+		"                          filesystems (default); <method> is\n"
+		"                          'mountinfo' (default) or 'listmount'\n"), out);
 	fputc('\n', out);
 	fputs(_(" -p, --poll[=<list>]    monitor changes in table of mounted filesystems\n"), out);
 	fputs(_(" -w, --timeout <num>    upper limit in milliseconds that --poll will block\n"), out);
+	fputs(_("     --poll-window <num>\n"
+		"                        coalesce --poll changes within <num> milliseconds\n"), out);
 	fputc('\n', out);
 
 	fputs(_(" -A, --all              disable all built-in filters, print all filesystems\n"), out);
@@ -1439,6 +1756,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -I, --dfi              imitate the output of df(1) with -i option\n"), out);
 	fputs(_(" -i, --invert           invert the sense of matching\n"), out);
 	fputs(_(" -J, --json             use JSON output format\n"), out);
+	fputs(_("     --json-lines       use JSON Lines output format (one object per line)\n"), out);
+	fputs(_("     --cbor             use CBOR (binary) output format\n"), out);
 	fputs(_(" -l, --list             use list format output\n"), out);
 	fputs(_(" -N, --task <tid>       use alternative namespace (/proc/<tid>/mountinfo file)\n"), out);
 	fputs(_(" -n, --noheadings       don't print column headings\n"), out);
@@ -1464,6 +1783,10 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fputc('\n', out);
 	fputs(_(" -x, --verify           verify mount table content (default is fstab)\n"), out);
+	fputs(_("     --verify-jobs <num>\n"
+		"                        verify up to <num> entries in parallel\n"), out);
+	fputs(_("     --verify-timeout <sec>\n"
+		"                        maximal time to verify one entry\n"), out);
 	fputs(_("     --verbose          print more details\n"), out);
 	fputs(_("     --vfs-all          print all VFS options\n"), out);
 
@@ -1507,11 +1830,13 @@ int main(int argc, char *argv[])
 	char **tabfiles = NULL;
 	int direction = MNT_ITER_FORWARD;
 	int verify = 0, collist = 0;
-	int c, rc = -1, timeout = -1;
+	unsigned int verify_jobs = 1, verify_timeout = 0;
+	int c, rc = -1, timeout = -1, window = 0;
 	int ntabfiles = 0, tabtype = 0;
 	char *outarg = NULL;
 	size_t i;
-	int force_tree = 0, istree = 0;
+	int force_tree = 0, istree = 0, force_mountinfo = 0;
+	const char *fast_target = NULL;
 
 	struct libscols_table *table = NULL;
 
@@ -1522,7 +1847,12 @@ int main(int argc, char *argv[])
 		FINDMNT_OPT_PSEUDO,
 		FINDMNT_OPT_REAL,
 		FINDMNT_OPT_VFS_ALL,
-		FINDMNT_OPT_SHADOWED
+		FINDMNT_OPT_SHADOWED,
+		FINDMNT_OPT_VERIFY_JOBS,
+		FINDMNT_OPT_VERIFY_TIMEOUT,
+		FINDMNT_OPT_JSON_LINES,
+		FINDMNT_OPT_POLL_WINDOW,
+		FINDMNT_OPT_CBOR
 	};
 
 	static const struct option longopts[] = {
@@ -1530,6 +1860,7 @@ int main(int argc, char *argv[])
 		{ "ascii",	    no_argument,       NULL, 'a'		 },
 		{ "bytes",	    no_argument,       NULL, 'b'		 },
 		{ "canonicalize",   no_argument,       NULL, 'c'		 },
+		{ "cbor",	    no_argument,       NULL, FINDMNT_OPT_CBOR	 },
 		{ "direction",	    required_argument, NULL, 'd'		 },
 		{ "df",		    no_argument,       NULL, 'D'		 },
 		{ "dfi",	    no_argument,       NULL, 'I'		 },
@@ -1539,7 +1870,8 @@ int main(int argc, char *argv[])
 		{ "help",	    no_argument,       NULL, 'h'		 },
 		{ "invert",	    no_argument,       NULL, 'i'		 },
 		{ "json",	    no_argument,       NULL, 'J'		 },
-		{ "kernel",	    no_argument,       NULL, 'k'		 },
+		{ "json-lines",	    no_argument,       NULL, FINDMNT_OPT_JSON_LINES },
+		{ "kernel",	    optional_argument, NULL, 'k'		 },
 		{ "list",	    no_argument,       NULL, 'l'		 },
 		{ "mountpoint",	    required_argument, NULL, 'M'		 },
 		{ "mtab",	    no_argument,       NULL, 'm'		 },
@@ -1560,8 +1892,11 @@ int main(int argc, char *argv[])
 		{ "task",	    required_argument, NULL, 'N'		 },
 		{ "target",	    required_argument, NULL, 'T'		 },
 		{ "timeout",	    required_argument, NULL, 'w'		 },
+		{ "poll-window",    required_argument, NULL, FINDMNT_OPT_POLL_WINDOW },
 		{ "uniq",	    no_argument,       NULL, 'U'		 },
 		{ "verify",	    no_argument,       NULL, 'x'		 },
+		{ "verify-jobs",    required_argument, NULL, FINDMNT_OPT_VERIFY_JOBS },
+		{ "verify-timeout", required_argument, NULL, FINDMNT_OPT_VERIFY_TIMEOUT },
 		{ "version",	    no_argument,       NULL, 'V'		 },
 		{ "shell",          no_argument,       NULL, 'y'                 },
 		{ "verbose",	    no_argument,       NULL, FINDMNT_OPT_VERBOSE },
@@ -1578,10 +1913,12 @@ int main(int argc, char *argv[])
 		{ 'C', 'c'},			/* [no]canonicalize */
 		{ 'C', 'e' },			/* nocanonicalize, evaluate */
 		{ 'J', 'P', 'r','x' },		/* json,pairs,raw,verify */
+		{ 'J', 'P', 'r', FINDMNT_OPT_JSON_LINES, FINDMNT_OPT_CBOR },
 		{ 'M', 'T' },			/* mountpoint, target */
 		{ 'N','k','m','s' },		/* task,kernel,mtab,fstab */
 		{ 'P','l','r','x' },		/* pairs,list,raw,verify */
 		{ 'p','x' },			/* poll,verify */
+		{ 'p', FINDMNT_OPT_CBOR },	/* poll,cbor */
 		{ 'm','p','s' },		/* mtab,poll,fstab */
 		{ FINDMNT_OPT_PSEUDO, FINDMNT_OPT_REAL },
 		{ 0 }
@@ -1692,6 +2029,14 @@ int main(int argc, char *argv[])
 			break;
 		case 'k':		/* kernel (mountinfo) */
 			tabtype = TABTYPE_KERNEL;
+			if (!optarg || strcmp(optarg, "mountinfo") == 0) {
+				flags &= ~FL_LISTMOUNT;
+				force_mountinfo = optarg != NULL;
+			}
+			else if (strcmp(optarg, "listmount") == 0)
+				flags |= FL_LISTMOUNT;
+			else
+				errx(EXIT_FAILURE, _("unsupported kernel table method: %s"), optarg);
 			break;
 		case 't':
 			set_match(COL_FSTYPE, optarg);
@@ -1759,6 +2104,23 @@ int main(int argc, char *argv[])
 		case FINDMNT_OPT_SHADOWED:
 			flags |= FL_SHADOWED;
 			break;
+		case FINDMNT_OPT_VERIFY_JOBS:
+			verify_jobs = strtou32_or_err(optarg, _("invalid jobs argument"));
+			if (!verify_jobs)
+				errx(EXIT_FAILURE, _("invalid jobs argument: %s"), optarg);
+			break;
+		case FINDMNT_OPT_VERIFY_TIMEOUT:
+			verify_timeout = strtou32_or_err(optarg, _("invalid timeout argument"));
+			break;
+		case FINDMNT_OPT_JSON_LINES:
+			flags |= FL_JSON | FL_JSONLINES;
+			break;
+		case FINDMNT_OPT_CBOR:
+			flags |= FL_CBOR;
+			break;
+		case FINDMNT_OPT_POLL_WINDOW:
+			window = strtos32_or_err(optarg, _("invalid window argument"));
+			break;
 
 		case 'H':
 			collist = 1;
@@ -1851,7 +2213,16 @@ int main(int argc, char *argv[])
 	 */
 	mnt_init_debug(0);
 
-	tb = parse_tabfiles(tabfiles, ntabfiles, tabtype);
+	/*
+	 * Only one mount (or a few over-mounted ones) is necessary for
+	 * --target or --mountpoint, don't read the whole kernel table.
+	 */
+	if (tabtype == TABTYPE_KERNEL && !ntabfiles && !force_mountinfo
+	    && !force_tree && !verify
+	    && !(flags & (FL_POLL | FL_SUBMOUNTS | FL_INVERT)))
+		fast_target = get_match(COL_TARGET);
+
+	tb = parse_tabfiles(tabfiles, ntabfiles, tabtype, fast_target);
 	if (!tb)
 		goto leave;
 
@@ -1878,10 +2249,12 @@ int main(int argc, char *argv[])
 	}
 
 	if (flags & FL_UNIQ)
-		mnt_table_uniq_fs(tb, MNT_UNIQ_KEEPTREE, uniq_fs_target_cmp);
+		mnt_table_uniq_fs_hashed(tb, MNT_UNIQ_KEEPTREE,
+				tabtype == TABTYPE_KERNEL ? uniq_fs_target_hash : NULL,
+				uniq_fs_target_cmp);
 
 	if (verify) {
-		rc = verify_table(tb);
+		rc = verify_table(tb, verify_jobs, verify_timeout);
 		goto leave;
 	}
 
@@ -1897,11 +2270,12 @@ int main(int argc, char *argv[])
 	scols_table_enable_raw(table,        !!(flags & FL_RAW));
 	scols_table_enable_export(table,     !!(flags & FL_EXPORT));
 	scols_table_enable_shellvar(table,   !!(flags & FL_SHELLVAR));
-	scols_table_enable_json(table,       !!(flags & FL_JSON));
+	scols_table_enable_json(table,       (flags & FL_JSON) && !(flags & FL_JSONLINES));
+	scols_table_enable_cbor(table,       !!(flags & FL_CBOR));
 	scols_table_enable_ascii(table,      !!(flags & FL_ASCII));
 	scols_table_enable_noheadings(table, !!(flags & FL_NOHEADINGS));
 
-	if (flags & FL_JSON)
+	if (((flags & FL_JSON) && !(flags & FL_JSONLINES)) || (flags & FL_CBOR))
 		scols_table_set_name(table, "filesystems");
 
 	for (i = 0; i < ncolumns; i++) {
@@ -1929,7 +2303,7 @@ int main(int argc, char *argv[])
 						NULL,
 						scols_wrapzero_nextchunk,
 						NULL);
-		if (flags & FL_JSON)
+		if (flags & (FL_JSON | FL_CBOR))
 	                scols_column_set_json_type(cl, get_column_json_type(id, fl, NULL));
 	}
 
@@ -1938,7 +2312,12 @@ int main(int argc, char *argv[])
 	 */
 	if (flags & FL_POLL) {
 		/* poll mode (accept the first tabfile only) */
-		rc = poll_table(tb, tabfiles ? *tabfiles : _PATH_PROC_MOUNTINFO, timeout, table, direction);
+		rc = 1;
+		if (!tabfiles)
+			rc = poll_mounts(timeout, window, table, direction);
+		if (rc == 1)
+			rc = poll_table(tb, tabfiles ? *tabfiles : _PATH_PROC_MOUNTINFO,
+					timeout, window, table, direction);
 
 	} else if ((flags & FL_TREE) && !(flags & FL_SUBMOUNTS)) {
 		/* whole tree */
@@ -1965,8 +2344,12 @@ int main(int argc, char *argv[])
 	/*
 	 * Print the output table for non-poll modes
 	 */
-	if (!rc && !(flags & FL_POLL))
-		scols_print_table(table);
+	if (!rc && !(flags & FL_POLL)) {
+		if (flags & FL_JSONLINES)
+			print_json_lines(table);
+		else
+			scols_print_table(table);
+	}
 leave:
 	scols_unref_table(table);
 
@@ -3,10 +3,12 @@
 
 /* flags */
 enum {
+	FL_CBOR		= (1 << 0),
 	FL_EVALUATE	= (1 << 1),
 	FL_CANONICALIZE = (1 << 2),
 	FL_FIRSTONLY	= (1 << 3),
 	FL_INVERT	= (1 << 4),
+	FL_JSONLINES	= (1 << 5),
 	FL_NOSWAPMATCH	= (1 << 6),
 	FL_NOFSROOT	= (1 << 7),
 	FL_SUBMOUNTS	= (1 << 8),
@@ -25,6 +27,7 @@ enum {
 	FL_DELETED      = (1 << 21),
 	FL_SHELLVAR     = (1 << 22),
 	FL_DF_INODES	= (1 << 23),
+	FL_LISTMOUNT	= (1 << 24),
 
 	/* basic table settings */
 	FL_ASCII	= (1 << 25),
@@ -41,6 +44,6 @@ extern int parse_nerrors;
 
 extern int is_listall_mode(void);
 extern struct libmnt_fs *get_next_fs(struct libmnt_table *tb, struct libmnt_iter *itr);
-extern int verify_table(struct libmnt_table *tb);
+extern int verify_table(struct libmnt_table *tb, unsigned int njobs, unsigned int timeout);
 
 #endif /* UTIL_LINUX_FINDMNT_H */
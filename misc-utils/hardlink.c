@@ -37,6 +37,9 @@
 #include <getopt.h>		/* getopt_long() */
 #include <ctype.h>		/* tolower() */
 #include <sys/ioctl.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #if defined(HAVE_LINUX_FIEMAP_H) && defined(HAVE_SYS_VFS_H)
 # include <linux/fs.h>
@@ -44,6 +47,9 @@
 # ifdef FICLONE
 #  define USE_REFLINK 1
 # endif
+# ifdef FIDEDUPERANGE
+#  define USE_DEDUPE 1
+# endif
 #endif
 
 #include "nls.h"
@@ -52,7 +58,12 @@
 #include "strutils.h"
 #include "monotonic.h"
 #include "optutils.h"
+#include "fileutils.h"
+#include "closestream.h"
 #include "fileeq.h"
+#include "walkdir.h"
+#include "all-io.h"
+#include "jsonwrt.h"
 
 #ifdef USE_REFLINK
 # include "statfs_magic.h"
@@ -78,12 +89,20 @@ static int reflink_mode = REFLINK_NEVER;
 static int reflinks_skip;
 #endif
 
+#ifdef USE_DEDUPE
+/* max bytes per FIDEDUPERANGE, btrfs does not dedupe more at once */
+# define HDL_DEDUPE_MAXLEN	(16 * 1024 * 1024)
+static int dedupe;
+#endif
+
 static struct ul_fileeq fileeq;
 
 /**
  * struct file - Information about a file
  * @st:       The stat buffer associated with the file
  * @next:     Next file with the same size
+ * @eqclass:  Content class within the size group (--threads), 0 if unknown
+ * @deduped:  The file shares the content with an equal file (--dedupe)
  * @basename: The offset off the basename in the filename
  * @path:     The path of the file
  *
@@ -94,6 +113,8 @@ struct file {
 	struct ul_fileeq_data data;
 
 	struct file *next;
+	size_t eqclass;
+	unsigned int deduped :1;
 	struct link {
 		struct link *next;
 		int basename;
@@ -139,6 +160,8 @@ static struct statistics {
 	size_t xattr_comparisons;
 	size_t comparisons;
 	size_t ignored_reflinks;
+	size_t deduped;
+	size_t cache_hits;
 	double saved;
 	struct timeval start_time;
 } stats;
@@ -164,14 +187,20 @@ struct hdl_regex {
  * @minimise: Chose the file with the lowest link count as master
  * @keep_oldest: Choose the file with oldest timestamp as master (default = FALSE)
  * @dry_run: Specifies whether hardlink should not link files (default = FALSE)
+ * @verify: Compare file contents if sha1 or sha256 digests match (default = FALSE)
+ * @cache: Persistent digests cache file name (default = NULL)
  * @min_size: Minimum size of files to consider. (default = 1 byte)
  * @max_size: Maximum size of files to consider, 0 means umlimited. (default = 0 byte)
+ * @nthreads: Number of threads comparing the file contents (default = 1)
+ * @low_memory: Keep only one size group in memory (default = FALSE)
+ * @json: Print the linked files in JSON (default = FALSE)
  */
 static struct options {
 	struct hdl_regex *include;
 	struct hdl_regex *exclude;
 
 	const char *method;
+	const char *cache;
 	signed int verbosity;
 	unsigned int respect_mode:1;
 	unsigned int respect_owner:1;
@@ -183,24 +212,25 @@ static struct options {
 	unsigned int minimise:1;
 	unsigned int keep_oldest:1;
 	unsigned int dry_run:1;
+	unsigned int verify:1;
+	unsigned int low_memory:1;
+	unsigned int json:1;
 	uintmax_t min_size;
 	uintmax_t max_size;
 	size_t io_size;
 	size_t cache_size;
+	size_t nthreads;
 } opts = {
 	/* default setting */
-#ifdef USE_FILEEQ_CRYPTOAPI
-	.method = "sha256",
-#else
-	.method = "memcmp",
-#endif
+	.method = "xxh128",
 	.respect_mode = TRUE,
 	.respect_owner = TRUE,
 	.respect_time = TRUE,
 	.respect_xattrs = FALSE,
 	.keep_oldest = FALSE,
 	.min_size = 1,
-	.cache_size = 10*1024*1024
+	.cache_size = 10*1024*1024,
+	.nthreads = 1
 };
 
 /*
@@ -405,6 +435,14 @@ static void print_stats(void)
 		jlog(JLOG_SUMMARY, _("%-25s %zu files"), _("Skipped reflinks:"),
 		     stats.ignored_reflinks);
 #endif
+#ifdef USE_DEDUPE
+	if (dedupe)
+		jlog(JLOG_SUMMARY, _("%-25s %zu files"), _("Deduplicated:"),
+		     stats.deduped);
+#endif
+	if (opts.cache)
+		jlog(JLOG_SUMMARY, _("%-25s %zu files"), _("Cached:"),
+		     stats.cache_hits);
 	ssz = size_to_human_string(SIZE_SUFFIX_3LETTER |
 				   SIZE_SUFFIX_SPACE |
 				   SIZE_DECIMAL_2DIGITS, stats.saved);
@@ -437,6 +475,326 @@ static int handle_interrupt(void)
 	return FALSE;
 }
 
+/*
+ * Persistent digests cache (--cache)
+ *
+ * The file starts with a header, followed by records. Every record describes
+ * one inode and it's followed by the block digests. The data are in native
+ * byte order, the cache is not portable between architectures. The cache is
+ * invalidated if the method or digest size has been changed.
+ */
+#define HDL_CACHE_MAGIC		"hardlink-cache\n"
+#define HDL_CACHE_VERSION	1
+
+struct hdl_cache_header {
+	char		magic[16];
+	char		method[16];
+	uint32_t	version;
+	uint32_t	digsiz;
+};
+
+struct hdl_cache_record {
+	uint64_t	dev;
+	uint64_t	ino;
+	uint64_t	size;
+	int64_t		mtime_sec;
+	int64_t		mtime_nsec;
+	int64_t		ctime_sec;
+	int64_t		ctime_nsec;
+	uint64_t	readsiz;
+	uint64_t	ndigests;
+	uint64_t	flags;
+	unsigned char	intro[UL_FILEEQ_INTROSIZ];
+};
+
+#define HDL_CACHE_FL_EOF	(1 << 0)
+
+struct hdl_cache_entry {
+	struct hdl_cache_record	rec;
+	unsigned int		used :1;	/* keep it in the cache file */
+	unsigned char		digests[];
+};
+
+static void *cache_root;		/* tsearch() tree of struct hdl_cache_entry */
+static FILE *cache_out;			/* used by cache_write_entry() */
+
+#ifdef HAVE_PTHREAD
+/* cache_root is searched by the --threads workers and updated by cache_store() */
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static inline void cache_lock_tree(void)
+{
+#ifdef HAVE_PTHREAD
+	if (opts.nthreads > 1)
+		pthread_mutex_lock(&cache_lock);
+#endif
+}
+
+static inline void cache_unlock_tree(void)
+{
+#ifdef HAVE_PTHREAD
+	if (opts.nthreads > 1)
+		pthread_mutex_unlock(&cache_lock);
+#endif
+}
+
+static int compare_cache_entries(const void *_a, const void *_b)
+{
+	const struct hdl_cache_entry *a = _a;
+	const struct hdl_cache_entry *b = _b;
+	int diff;
+
+	diff = CMP(a->rec.dev, b->rec.dev);
+	if (diff == 0)
+		diff = CMP(a->rec.ino, b->rec.ino);
+	return diff;
+}
+
+static void cache_set_key(struct hdl_cache_record *rec, const struct stat *st)
+{
+	rec->dev = st->st_dev;
+	rec->ino = st->st_ino;
+	rec->size = st->st_size;
+	rec->mtime_sec = st->st_mtim.tv_sec;
+	rec->mtime_nsec = st->st_mtim.tv_nsec;
+	rec->ctime_sec = st->st_ctim.tv_sec;
+	rec->ctime_nsec = st->st_ctim.tv_nsec;
+}
+
+static int cache_replace_entry(struct hdl_cache_entry *ent)
+{
+	struct hdl_cache_entry **node;
+
+	node = tsearch(ent, &cache_root, compare_cache_entries);
+	if (!node)
+		return -ENOMEM;
+	if (*node != ent) {
+		free(*node);
+		*node = ent;
+	}
+	return 0;
+}
+
+/**
+ * cache_read - Read the cache file
+ *
+ * The missing file is not error, the broken or incompatible file is ignored
+ * (and replaced by cache_write()).
+ */
+static void cache_read(void)
+{
+	struct hdl_cache_header hdr;
+	struct hdl_cache_record rec;
+	size_t digsiz = ul_fileeq_get_digsiz(&fileeq);
+	size_t count = 0;
+	uint64_t maxdigs;
+	FILE *f;
+
+	/* ul_fileeq_set_size() never uses more than this with the current
+	 * --cache-size (the read size is rounded down, hence the 2x) */
+	maxdigs = (opts.cache_size / digsiz + 1) * 2;
+
+	f = fopen(opts.cache, "r" UL_CLOEXECSTR);
+	if (!f) {
+		if (errno != ENOENT)
+			warn(_("cannot open %s"), opts.cache);
+		return;
+	}
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1
+	    || memcmp(hdr.magic, HDL_CACHE_MAGIC, sizeof(HDL_CACHE_MAGIC)) != 0
+	    || hdr.version != HDL_CACHE_VERSION) {
+		warnx(_("%s: unsupported cache file format, ignored"), opts.cache);
+		goto done;
+	}
+	if (hdr.digsiz != digsiz
+	    || strncmp(hdr.method, opts.method, sizeof(hdr.method)) != 0) {
+		jlog(JLOG_INFO, _("Cache %s created by another method, ignored"),
+				opts.cache);
+		goto done;
+	}
+
+	while (fread(&rec, sizeof(rec), 1, f) == 1) {
+		struct hdl_cache_entry *ent;
+
+		if (!rec.readsiz || rec.ndigests > rec.size / rec.readsiz + 1)
+			break;
+
+		/* unusable for this run, skip it rather than allocate it */
+		if (rec.ndigests > maxdigs) {
+			if (rec.ndigests > (uint64_t) INT64_MAX / digsiz
+			    || fseeko(f, rec.ndigests * digsiz, SEEK_CUR) != 0)
+				break;
+			continue;
+		}
+
+		ent = xmalloc(sizeof(*ent) + rec.ndigests * digsiz);
+		ent->rec = rec;
+		ent->used = 0;
+
+		if (fread(ent->digests, digsiz, rec.ndigests, f) != rec.ndigests
+		    || cache_replace_entry(ent) != 0) {
+			free(ent);
+			break;
+		}
+		count++;
+	}
+	if (!feof(f))
+		warnx(_("%s: broken cache file, some entries ignored"), opts.cache);
+
+	jlog(JLOG_VERBOSE1, _("Read %zu entries from cache %s"), count, opts.cache);
+done:
+	fclose(f);
+}
+
+static void cache_write_entry(const void *nodep, const VISIT which,
+			      const int depth __attribute__((__unused__)))
+{
+	const struct hdl_cache_entry *ent = *(struct hdl_cache_entry **) nodep;
+
+	if (which != leaf && which != postorder)
+		return;
+	if (!ent->used || !cache_out)
+		return;
+
+	if (fwrite(&ent->rec, sizeof(ent->rec), 1, cache_out) != 1
+	    || fwrite(ent->digests, ul_fileeq_get_digsiz(&fileeq),
+		      ent->rec.ndigests, cache_out) != ent->rec.ndigests) {
+		fclose(cache_out);
+		cache_out = NULL;
+	}
+}
+
+/**
+ * cache_write - Write the cache file
+ *
+ * Only the entries used or created by this run are written, the cache does
+ * not keep information about removed or modified files. The file is replaced
+ * atomically.
+ */
+static void cache_write(void)
+{
+	struct hdl_cache_header hdr = {
+		.version = HDL_CACHE_VERSION,
+		.digsiz = ul_fileeq_get_digsiz(&fileeq)
+	};
+	char *dir, *tmpname = NULL;
+	const char *tmpdir;
+	int rc;
+
+	/* create the temporary file in the same directory to use rename() */
+	dir = xstrdup(opts.cache);
+	tmpdir = !stripoff_last_component(dir) ? "." : *dir ? dir : "/";
+
+	cache_out = xfmkstemp(&tmpname, tmpdir, "hardlink-cache");
+	free(dir);
+	if (!cache_out) {
+		warn(_("cannot create temporary cache file"));
+		free(tmpname);
+		return;
+	}
+
+	memcpy(hdr.magic, HDL_CACHE_MAGIC, sizeof(HDL_CACHE_MAGIC));
+	xstrncpy(hdr.method, opts.method, sizeof(hdr.method));
+
+	if (fwrite(&hdr, sizeof(hdr), 1, cache_out) != 1) {
+		fclose(cache_out);
+		cache_out = NULL;
+	}
+
+	twalk(cache_root, cache_write_entry);
+
+	rc = cache_out ? close_stream(cache_out) : -1;
+	cache_out = NULL;
+
+	if (rc != 0 || rename(tmpname, opts.cache) != 0) {
+		warn(_("cannot write %s"), opts.cache);
+		unlink(tmpname);
+	}
+	free(tmpname);
+}
+
+/**
+ * cache_load - Initialize file data from the cache
+ * @eq: The comparator with already set sizes
+ * @fil: The file with already associated data
+ *
+ * The cached digests are used only if the file has not been modified and the
+ * current I/O size is the same as used for the cached data.
+ */
+static void cache_load(struct ul_fileeq *eq, struct file *fil)
+{
+	struct hdl_cache_entry key, **node, *ent;
+
+	if (!cache_root)
+		return;
+
+	cache_set_key(&key.rec, &fil->st);
+
+	cache_lock_tree();
+	node = tfind(&key, &cache_root, compare_cache_entries);
+	if (!node)
+		goto done;
+
+	ent = *node;
+	if (ent->rec.size != key.rec.size
+	    || ent->rec.mtime_sec != key.rec.mtime_sec
+	    || ent->rec.mtime_nsec != key.rec.mtime_nsec
+	    || ent->rec.ctime_sec != key.rec.ctime_sec
+	    || ent->rec.ctime_nsec != key.rec.ctime_nsec
+	    || ent->rec.readsiz != eq->readsiz)
+		goto done;
+
+	if (ul_fileeq_data_set_digests(eq, &fil->data, ent->rec.intro,
+				ent->digests, ent->rec.ndigests,
+				ent->rec.flags & HDL_CACHE_FL_EOF) == 0) {
+		ent->used = 1;
+		stats.cache_hits++;
+	}
+done:
+	cache_unlock_tree();
+}
+
+/**
+ * cache_store - Add the file digests to the cache
+ * @fil: The file
+ * @readsiz: The I/O size used for the digests
+ *
+ * Call before the file data are deinitialized.
+ */
+static void cache_store(struct file *fil, size_t readsiz)
+{
+	struct hdl_cache_entry *ent;
+	const unsigned char *digests;
+	size_t digsiz = ul_fileeq_get_digsiz(&fileeq);
+	ssize_t n;
+
+	/* ignore files replaced by link */
+	if (!opts.cache || (!fil->links && !opts.dry_run))
+		return;
+
+	n = ul_fileeq_data_get_digests(&fileeq, &fil->data, &digests);
+	if (n < 0)
+		return;
+
+	ent = xcalloc(1, sizeof(*ent) + n * digsiz);
+	cache_set_key(&ent->rec, &fil->st);
+	ent->rec.readsiz = readsiz;
+	ent->rec.ndigests = n;
+	if (fil->data.is_eof)
+		ent->rec.flags |= HDL_CACHE_FL_EOF;
+	memcpy(ent->rec.intro, fil->data.intro, sizeof(ent->rec.intro));
+	if (n)
+		memcpy(ent->digests, digests, n * digsiz);
+	ent->used = 1;
+
+	cache_lock_tree();
+	if (cache_replace_entry(ent) != 0)
+		free(ent);
+	cache_unlock_tree();
+}
+
 #ifdef USE_XATTR
 
 /**
@@ -728,6 +1086,51 @@ static inline int do_link(struct file *a,
 }
 #endif /* USE_REFLINK */
 
+/*
+ * --json
+ *
+ * Every master is one object in the "duplicates" array, the paths linked to
+ * the master (or deduplicated) are in the "files" array of the object.
+ */
+static struct ul_jsonwrt json;
+static const struct file *json_master;	/* the master of the open object */
+
+static void json_open(void)
+{
+	ul_jsonwrt_init(&json, stdout, 0);
+	ul_jsonwrt_root_open(&json);
+	ul_jsonwrt_array_open(&json, "duplicates");
+}
+
+static void json_close_set(void)
+{
+	if (!json_master)
+		return;
+	ul_jsonwrt_array_close(&json);
+	ul_jsonwrt_object_close(&json);
+	json_master = NULL;
+}
+
+static void json_close(void)
+{
+	json_close_set();
+	ul_jsonwrt_array_close(&json);
+	ul_jsonwrt_root_close(&json);
+}
+
+static void json_add_file(const struct file *master, const char *path)
+{
+	if (json_master != master) {
+		json_close_set();
+		ul_jsonwrt_object_open(&json, NULL);
+		ul_jsonwrt_value_u64(&json, "size", master->st.st_size);
+		ul_jsonwrt_value_s(&json, "master", master->links->path);
+		ul_jsonwrt_array_open(&json, "files");
+		json_master = master;
+	}
+	ul_jsonwrt_value_s(&json, NULL, path);
+}
+
 /**
  * file_link - Replace b with a link to a
  * @a: The first file
@@ -779,6 +1182,9 @@ static int file_link(struct file *a, struct file *b, int reflink)
 	/* Update statistics */
 	stats.linked++;
 
+	if (opts.json)
+		json_add_file(a, b->links->path);
+
 	/* Increase the link count of this file, and set stat() of other file */
 	a->st.st_nlink++;
 	b->st.st_nlink--;
@@ -814,6 +1220,141 @@ static int has_fpath(struct file *node, const char *path)
 	return 0;
 }
 
+/* adds @fil to the size group @head, the master candidates are first */
+static void insert_by_size(struct file **head, struct file *fil)
+{
+	struct file *l;
+
+	if (*head == NULL || file_compare(fil, *head) >= 0) {
+		fil->next = *head;
+		*head = fil;
+		return;
+	}
+	for (l = *head; l != NULL; l = l->next) {
+		if (l->next != NULL && file_compare(fil, l->next) < 0)
+			continue;
+
+		fil->next = l->next;
+		l->next = fil;
+		break;
+	}
+}
+
+/*
+ * --low-memory
+ *
+ * The first pass keeps only a small record for every file, the paths are
+ * written to a temporary file. The records are sorted in runs of
+ * HDL_RUN_RECORDS and the full runs are written to another temporary file.
+ * The second pass merges the runs, so the records of the same device and
+ * size come together, and only the files of this one size group are read
+ * back to memory, compared by link_group() and freed.
+ */
+
+/* number of records sorted in memory, 12 MiB */
+#define HDL_RUN_RECORDS		(256 * 1024)
+/* number of records read at once from every run in the second pass */
+#define HDL_MERGE_RECORDS	512
+
+struct hdl_record {
+	uint64_t dev;
+	uint64_t size;
+	uint64_t ino;
+	uint64_t path;		/* offset of the path in the names file */
+	uint32_t pathlen;	/* including the terminating zero */
+	uint32_t basename;
+	uint32_t dirname;
+};
+
+static struct hdl_lowmem {
+	FILE *names;		/* paths of the files */
+	uint64_t namesz;
+
+	int runs_fd;		/* sorted runs of the records */
+	off_t *runs;		/* end offsets of the runs */
+	size_t nruns;
+
+	struct hdl_record *recs;
+	size_t nrecs;
+} lowmem = { .runs_fd = -1 };
+
+/* the same order as compare_nodes(), the files of one inode together */
+static int compare_records(const void *_a, const void *_b)
+{
+	const struct hdl_record *a = _a;
+	const struct hdl_record *b = _b;
+	int diff;
+
+	diff = CMP(a->dev, b->dev);
+	if (diff == 0)
+		diff = CMP(a->size, b->size);
+	if (diff == 0)
+		diff = CMP(a->ino, b->ino);
+	if (diff == 0)
+		diff = CMP(a->path, b->path);
+	return diff;
+}
+
+static int lowmem_tmpfile(void)
+{
+	char *name = NULL;
+	int fd;
+
+	fd = xmkstemp(&name, NULL, "hardlink");
+	if (fd < 0)
+		err(EXIT_FAILURE, _("cannot create temporary file"));
+	unlink(name);
+	free(name);
+	return fd;
+}
+
+static void lowmem_write_run(void)
+{
+	off_t end = lowmem.nruns ? lowmem.runs[lowmem.nruns - 1] : 0;
+	size_t sz = lowmem.nrecs * sizeof(struct hdl_record);
+
+	if (lowmem.runs_fd < 0)
+		lowmem.runs_fd = lowmem_tmpfile();
+
+	qsort(lowmem.recs, lowmem.nrecs, sizeof(struct hdl_record), compare_records);
+	if (write_all(lowmem.runs_fd, lowmem.recs, sz) != 0)
+		err(EXIT_FAILURE, _("cannot write temporary file"));
+
+	lowmem.runs = xreallocarray(lowmem.runs, lowmem.nruns + 1, sizeof(off_t));
+	lowmem.runs[lowmem.nruns++] = end + sz;
+	lowmem.nrecs = 0;
+}
+
+/* the first pass, called by inserter() for the files to compare */
+static void lowmem_add_file(const char *fpath, const struct stat *sb, int basename)
+{
+	struct hdl_record *rec;
+	size_t pathlen = strlen(fpath) + 1;
+
+	if (!lowmem.names) {
+		lowmem.names = fdopen(lowmem_tmpfile(), "w+");
+		if (!lowmem.names)
+			err(EXIT_FAILURE, _("cannot create temporary file"));
+		lowmem.recs = xmalloc(HDL_RUN_RECORDS * sizeof(struct hdl_record));
+	}
+	if (lowmem.nrecs == HDL_RUN_RECORDS)
+		lowmem_write_run();
+
+	if (fwrite(fpath, 1, pathlen, lowmem.names) != pathlen)
+		err(EXIT_FAILURE, _("cannot write temporary file"));
+
+	rec = &lowmem.recs[lowmem.nrecs++];
+	memset(rec, 0, sizeof(*rec));
+	rec->dev = sb->st_dev;
+	rec->size = sb->st_size;
+	rec->ino = sb->st_ino;
+	rec->path = lowmem.namesz;
+	rec->pathlen = pathlen;
+	rec->basename = basename;
+	rec->dirname = rootbasesz;
+
+	lowmem.namesz += pathlen;
+}
 
 /**
  * inserter - Callback function for nftw()
@@ -866,6 +1407,11 @@ static int inserter(const char *fpath, const struct stat *sb,
 		return 0;
 	}
 
+	if (opts.low_memory) {
+		lowmem_add_file(fpath, sb, ftwbuf->base);
+		return 0;
+	}
+
 	pathlen = strlen(fpath) + 1;
 
 	fil = xcalloc(1, sizeof(*fil));
@@ -905,25 +1451,8 @@ static int inserter(const char *fpath, const struct stat *sb,
 		if (node == NULL)
 			goto fail;
 
-		if (*node != fil) {
-			struct file *l;
-
-			if (file_compare(fil, *node) >= 0) {
-				fil->next = *node;
-				*node = fil;
-			} else {
-				for (l = *node; l != NULL; l = l->next) {
-					if (l->next != NULL
-					    && file_compare(fil, l->next) < 0)
-						continue;
-
-					fil->next = l->next;
-					l->next = fil;
-
-					break;
-				}
-			}
-		}
+		if (*node != fil)
+			insert_by_size(node, fil);
 	}
 
 	return 0;
@@ -962,67 +1491,112 @@ static int is_reflink_compatible(dev_t devno, const char *filename)
 
 static int is_reflink(struct file *xa, struct file *xb)
 {
-	int last = 0, rc = 0;
-	char abuf[BUFSIZ] = { 0 },
-	     bbuf[BUFSIZ] = { 0 };
-
-	struct fiemap *amap = (struct fiemap *) abuf,
-		      *bmap = (struct fiemap *) bbuf;
-
+	int rc = 0;
 	int af = open(xa->links->path, O_RDONLY),
 	    bf = open(xb->links->path, O_RDONLY);
 
-	if (af < 0 || bf < 0)
-		goto done;
+	if (af >= 0 && bf >= 0)
+		rc = ul_fileeq_same_extents(af, bf, true);
+	if (af >= 0)
+		close(af);
+	if (bf >= 0)
+		close(bf);
+	return rc;
+}
+
+#ifdef USE_DEDUPE
+/**
+ * file_dedupe - Share the content of two files by FIDEDUPERANGE
+ * @a: The master file
+ * @b: The file which will share the extents of @a
+ *
+ * The content is compared by kernel, nothing is read to userspace.
+ *
+ * Returns: %TRUE if the files are equal and deduplicated, else %FALSE.
+ */
+static int file_dedupe(struct file *a, struct file *b)
+{
+	static dev_t unsupported_dev;	/* the last device without dedupe */
+	struct file_dedupe_range *range;
+	uint64_t off = 0, size = a->st.st_size;
+	int src, dst, rc = FALSE;
 
-	do {
-		size_t i;
+	if (unsupported_dev && unsupported_dev == a->st.st_dev)
+		return FALSE;
 
-		amap->fm_length = ~0ULL;
-		amap->fm_flags = FIEMAP_FLAG_SYNC;
-		amap->fm_extent_count =	(sizeof(abuf) - sizeof(*amap)) / sizeof(struct fiemap_extent);
+	range = xcalloc(1, sizeof(*range) + sizeof(struct file_dedupe_range_info));
 
-		bmap->fm_length = ~0ULL;
-		bmap->fm_flags = FIEMAP_FLAG_SYNC;
-		bmap->fm_extent_count =	(sizeof(bbuf) - sizeof(*bmap)) / sizeof(struct fiemap_extent);
+	src = open(a->links->path, O_RDONLY);
+	dst = open(b->links->path, O_RDONLY);
+	if (src < 0 || dst < 0) {
+		warn(_("cannot open %s"), src < 0 ? a->links->path : b->links->path);
+		goto done;
+	}
 
-		if (ioctl(af, FS_IOC_FIEMAP, (unsigned long) amap) < 0)
+	while (off < size) {
+		struct file_dedupe_range_info *info = &range->info[0];
+
+		range->src_offset = off;
+		range->src_length = min(size - off, (uint64_t) HDL_DEDUPE_MAXLEN);
+		range->dest_count = 1;
+		info->dest_fd = dst;
+		info->dest_offset = off;
+		info->bytes_deduped = 0;
+		info->status = 0;
+
+		if (ioctl(src, FIDEDUPERANGE, range) != 0) {
+			if (errno == EOPNOTSUPP) {
+				/* don't try it again for all files */
+				unsupported_dev = a->st.st_dev;
+				warnx(_("%s: deduplication is not supported"),
+						a->links->path);
+			} else
+				warn(_("cannot deduplicate %s and %s"),
+						a->links->path, b->links->path);
 			goto done;
-		if (ioctl(bf, FS_IOC_FIEMAP, (unsigned long) bmap) < 0)
+		}
+		if (info->status == FILE_DEDUPE_RANGE_DIFFERS)
 			goto done;
-
-		if (amap->fm_mapped_extents == 0 ||
-		    amap->fm_mapped_extents != bmap->fm_mapped_extents)
+		if (info->status < 0) {
+			errno = -info->status;
+			warn(_("cannot deduplicate %s and %s"),
+					a->links->path, b->links->path);
 			goto done;
-
-		for (i = 0; i < amap->fm_mapped_extents; i++) {
-			struct fiemap_extent *a = &amap->fm_extents[i];
-			struct fiemap_extent *b = &bmap->fm_extents[i];
-
-			if (a->fe_logical != b->fe_logical ||
-			    a->fe_length !=  b->fe_length ||
-			    a->fe_physical != b->fe_physical)
-				goto done;
-			if (!(a->fe_flags & FIEMAP_EXTENT_SHARED) ||
-			    !(b->fe_flags & FIEMAP_EXTENT_SHARED))
-				goto done;
-			if (a->fe_flags & FIEMAP_EXTENT_LAST)
-				last = 1;
 		}
-
-		bmap->fm_start = amap->fm_start =
-			amap->fm_extents[amap->fm_mapped_extents - 1].fe_logical +
-			amap->fm_extents[amap->fm_mapped_extents - 1].fe_length;
-	} while (last == 0);
-
-	rc = 1;
+		if (!info->bytes_deduped)
+			goto done;
+		off += info->bytes_deduped;
+	}
+	rc = TRUE;
 done:
-	if (af >= 0)
-		close(af);
-	if (bf >= 0)
-		close(bf);
+	if (src >= 0)
+		close(src);
+	if (dst >= 0)
+		close(dst);
+	free(range);
 	return rc;
 }
+
+/* update statistics after file_dedupe() or the content comparison on --dry-run */
+static void file_deduped(struct file *a, struct file *b)
+{
+	if (is_log_enabled(JLOG_INFO)) {
+		char *ssz = size_to_human_string(SIZE_SUFFIX_3LETTER |
+				   SIZE_SUFFIX_SPACE |
+				   SIZE_DECIMAL_2DIGITS, a->st.st_size);
+		jlog(JLOG_INFO, _("%sDeduplicating %s to %s (-%s)"),
+		     opts.dry_run ? _("[DryRun] ") : "",
+		     a->links->path, b->links->path,
+		     ssz);
+		free(ssz);
+	}
+	if (opts.json)
+		json_add_file(a, b->links->path);
+	stats.deduped++;
+	stats.saved += a->st.st_size;
+	b->deduped = 1;
+}
+#endif /* USE_DEDUPE */
 #endif /* USE_REFLINK */
 
 static inline size_t count_nodes(struct file *x)
@@ -1035,26 +1609,64 @@ static inline size_t count_nodes(struct file *x)
 	return ct;
 }
 
+/* the same as file_may_link_to(), but only for attributes kept by linking */
+static int file_may_share_class(const struct file *a, const struct file *b)
+{
+	return (a->st.st_dev == b->st.st_dev &&
+		(!opts.respect_mode || a->st.st_mode == b->st.st_mode) &&
+		(!opts.respect_owner || a->st.st_uid == b->st.st_uid) &&
+		(!opts.respect_owner || a->st.st_gid == b->st.st_gid) &&
+		(!opts.respect_time || a->st.st_mtime == b->st.st_mtime) &&
+		(!opts.respect_name || filename_strcmp(a, b) == 0) &&
+		(!opts.respect_dir || dirname_strcmp(a, b) == 0));
+}
+
+/*
+ * Asks the kernel to read the beginning of the next file which will be
+ * compared with @master, so that the device reads it while the current files
+ * are compared. Not used with --cache, the file may be already hashed.
+ */
+static void prefetch_next(struct ul_fileeq *eq, const struct file *master,
+			  struct file *fil)
+{
+	if (opts.cache || !eq->readahead)
+		return;
+
+	for (; fil != NULL; fil = fil->next) {
+		if (!fil->links || !file_may_share_class(master, fil))
+			continue;
+		if (!ul_fileeq_data_associated(&fil->data))
+			ul_fileeq_prefetch(eq, fil->links->path);
+		break;
+	}
+}
+
+/*
+ * struct hdl_group - Size group compared by the --threads workers
+ * @files: The first file of the group
+ * @readsiz: The I/O size used for the digests of the group
+ * @done: The eqclass of all files in the group is known
+ */
+struct hdl_group {
+	struct file *files;
+	size_t readsiz;
+	unsigned int done :1;
+};
+
 /**
- * visitor - Callback for twalk()
- * @nodep: Pointer to a pointer to a #struct file
- * @which: At which point this visit is (preorder, postorder, endorder)
- * @depth: The depth of the node in the tree
+ * link_group - Link equal files with the same size
+ * @begin: The first #struct file of the size group
+ * @grp: The group compared by group_classify() or NULL
  *
- * Visit the nodes in the binary tree. For each node, call hardlinker()
- * on each #struct file in the linked list of #struct file instances located
- * at that node.
+ * Without @grp the files are compared here, otherwise the content equality
+ * is taken from the already known @eqclass of the files. The decisions,
+ * messages and statistics are the same in both cases.
  */
-static void visitor(const void *nodep, const VISIT which, const int depth)
+static void link_group(struct file *begin, struct hdl_group *grp)
 {
-	struct file *master = *(struct file **)nodep;
-	struct file *begin = master;
+	struct file *master = begin;
 	struct file *other;
-
-	(void)depth;
-
-	if (which != leaf && which != endorder)
-		return;
+	size_t readsiz = grp ? grp->readsiz : 0;
 
 	for (; master != NULL; master = master->next) {
 		size_t nnodes, memsiz;
@@ -1062,7 +1674,7 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 
 		if (handle_interrupt())
 			exit(EXIT_FAILURE);
-		if (master->links == NULL)
+		if (master->links == NULL || master->deduped)
 			continue;
 
 		/* calculate per file max memory use */
@@ -1070,10 +1682,13 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 		if (!nnodes)
 			continue;
 
-		/* per-file cache size */
-		memsiz = opts.cache_size / nnodes;
-		/*                                filesiz,      readsiz,      memsiz */
-		ul_fileeq_set_size(&fileeq, master->st.st_size, opts.io_size, memsiz);
+		if (!grp) {
+			/* per-file cache size */
+			memsiz = opts.cache_size / nnodes;
+			/*                                filesiz,      readsiz,      memsiz */
+			ul_fileeq_set_size(&fileeq, master->st.st_size, opts.io_size, memsiz);
+			readsiz = fileeq.readsiz;
+		}
 
 #ifdef USE_REFLINK
 		if (reflink_mode || reflinks_skip) {
@@ -1092,7 +1707,7 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 			assert(other != other->next);
 			assert(other->st.st_size == master->st.st_size);
 
-			if (!other->links)
+			if (!other->links || other->deduped)
 				continue;
 
 			/* check file attributes, etc. */
@@ -1109,17 +1724,31 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 				continue;
 			}
 #endif
-			/* initialize content comparison */
-			if (!ul_fileeq_data_associated(&master->data))
-				ul_fileeq_data_set_file(&master->data, master->links->path);
-			if (!ul_fileeq_data_associated(&other->data))
-				ul_fileeq_data_set_file(&other->data, other->links->path);
+			if (grp)
+				eq = master->eqclass && master->eqclass == other->eqclass;
+#ifdef USE_DEDUPE
+			else if (dedupe && !opts.dry_run)
+				eq = file_dedupe(master, other);
+#endif
+			else {
+				/* initialize content comparison */
+				if (!ul_fileeq_data_associated(&master->data)) {
+					ul_fileeq_data_set_file(&master->data, master->links->path);
+					cache_load(&fileeq, master);
+				}
+				if (!ul_fileeq_data_associated(&other->data)) {
+					ul_fileeq_data_set_file(&other->data, other->links->path);
+					cache_load(&fileeq, other);
+				}
+
+				prefetch_next(&fileeq, master, other->next);
 
-			/* compare files */
-			eq = ul_fileeq(&fileeq, &master->data, &other->data);
+				/* compare files */
+				eq = ul_fileeq(&fileeq, &master->data, &other->data);
 
-			/* reduce number of open files, keep only master open */
-			ul_fileeq_data_close_file(&other->data);
+				/* reduce number of open files, keep only master open */
+				ul_fileeq_data_close_file(&other->data);
+			}
 
 			stats.comparisons++;
 
@@ -1129,24 +1758,505 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 				continue;
 			}
 
+#ifdef USE_DEDUPE
+			if (dedupe) {
+				file_deduped(master, other);
+				continue;
+			}
+#endif
 			/* link files */
 			if (!file_link(master, other, may_reflink) && errno == EMLINK) {
+				cache_store(master, readsiz);
 				ul_fileeq_data_deinit(&master->data);
 				master = other;
 			}
 		}
 
 		/* don't keep master data in memory */
+		cache_store(master, readsiz);
 		ul_fileeq_data_deinit(&master->data);
 	}
 
 	/* final cleanup */
 	for (other = begin; other != NULL; other = other->next) {
-		if (ul_fileeq_data_associated(&other->data))
+		if (ul_fileeq_data_associated(&other->data)) {
+			cache_store(other, readsiz);
 			ul_fileeq_data_deinit(&other->data);
+		}
+	}
+	if (opts.json)
+		json_close_set();
+}
+
+/**
+ * visitor - Callback for twalk()
+ * @nodep: Pointer to a pointer to a #struct file
+ * @which: At which point this visit is (preorder, postorder, endorder)
+ * @depth: The depth of the node in the tree
+ *
+ * Visit the nodes in the binary tree. For each node, call link_group()
+ * for the linked list of #struct file instances located at that node.
+ */
+static void visitor(const void *nodep, const VISIT which, const int depth)
+{
+	(void)depth;
+
+	if (which != leaf && which != endorder)
+		return;
+
+	link_group(*(struct file **)nodep, NULL);
+}
+
+/*
+ * --low-memory, the second pass
+ */
+struct hdl_run {
+	off_t off;		/* the unread rest of the run in the runs file */
+	off_t end;
+	struct hdl_record *recs;
+	size_t nrecs;
+	size_t cur;
+};
+
+static void lowmem_pread(int fd, void *buf, size_t sz, off_t off)
+{
+	char *p = buf;
+
+	while (sz) {
+		ssize_t rc = pread(fd, p, sz, off);
+
+		if (rc < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+		if (rc <= 0) {
+			if (rc == 0)
+				errno = EIO;
+			err(EXIT_FAILURE, _("cannot read temporary file"));
+		}
+		p += rc;
+		sz -= rc;
+		off += rc;
+	}
+}
+
+/* returns the current record of the run or NULL at the end of the run */
+static struct hdl_record *run_current(struct hdl_run *run)
+{
+	size_t sz;
+
+	if (run->cur < run->nrecs)
+		return &run->recs[run->cur];
+	if (run->off >= run->end)
+		return NULL;
+
+	sz = min((uint64_t) HDL_MERGE_RECORDS * sizeof(struct hdl_record),
+		 (uint64_t) (run->end - run->off));
+	lowmem_pread(lowmem.runs_fd, run->recs, sz, run->off);
+	run->off += sz;
+	run->nrecs = sz / sizeof(struct hdl_record);
+	run->cur = 0;
+
+	return run->recs;
+}
+
+static void heap_down(struct hdl_run **heap, size_t nheap, size_t i)
+{
+	for (;;) {
+		struct hdl_run *tmp;
+		size_t l = 2 * i + 1, r = l + 1, x = i;
+
+		if (l < nheap && compare_records(run_current(heap[l]),
+						 run_current(heap[x])) < 0)
+			x = l;
+		if (r < nheap && compare_records(run_current(heap[r]),
+						 run_current(heap[x])) < 0)
+			x = r;
+		if (x == i)
+			break;
+		tmp = heap[i];
+		heap[i] = heap[x];
+		heap[x] = tmp;
+		i = x;
+	}
+}
+
+/* reads the path of @rec and returns the file if it has not been modified */
+static struct file *lowmem_read_file(const struct hdl_record *rec)
+{
+	struct file *fil;
+
+	fil = xcalloc(1, sizeof(*fil));
+	fil->links = xcalloc(1, sizeof(struct link) + rec->pathlen);
+	fil->links->basename = rec->basename;
+	fil->links->dirname = rec->dirname;
+
+	lowmem_pread(fileno(lowmem.names), fil->links->path, rec->pathlen, rec->path);
+	fil->links->path[rec->pathlen - 1] = '\0';
+
+	if (lstat(fil->links->path, &fil->st) != 0) {
+		warn(_("cannot stat %s"), fil->links->path);
+		goto skip;
+	}
+	if (!S_ISREG(fil->st.st_mode)
+	    || (uint64_t) fil->st.st_dev != rec->dev
+	    || (uint64_t) fil->st.st_ino != rec->ino
+	    || (uint64_t) fil->st.st_size != rec->size) {
+		jlog(JLOG_VERBOSE1,
+		     _("Skipped %s (modified since scanning)"), fil->links->path);
+		goto skip;
+	}
+	return fil;
+skip:
+	free(fil->links);
+	free(fil);
+	return NULL;
+}
+
+/* builds the size group of the same device and size as inserter() and links it */
+static void lowmem_link_group(const struct hdl_record *recs, size_t nrecs)
+{
+	struct file *head = NULL, *fil, **inode = NULL;
+	size_t i, ninode = 0;
+
+	/* one file or all the files are links to one inode */
+	if (nrecs < 2 || recs[0].ino == recs[nrecs - 1].ino)
+		return;
+
+	for (i = 0; i < nrecs; i++) {
+		size_t k;
+
+		if (i == 0 || recs[i].ino != recs[i - 1].ino)
+			ninode = 0;
+
+		fil = lowmem_read_file(&recs[i]);
+		if (!fil)
+			continue;
+
+		/* already known inode (and name), add link */
+		for (k = 0; k < ninode; k++) {
+			if (compare_nodes_ino(fil, inode[k]) == 0)
+				break;
+		}
+		if (k < ninode) {
+			if (has_fpath(inode[k], fil->links->path)) {
+				jlog(JLOG_VERBOSE1,
+					_("Skipped %s (specified more than once)"),
+					fil->links->path);
+				free(fil->links);
+			} else {
+				fil->links->next = inode[k]->links;
+				inode[k]->links = fil->links;
+			}
+			free(fil);
+			continue;
+		}
+
+		if (ninode % 8 == 0)
+			inode = xreallocarray(inode, ninode + 8, sizeof(struct file *));
+		inode[ninode++] = fil;
+		insert_by_size(&head, fil);
+	}
+	free(inode);
+
+	if (head)
+		link_group(head, NULL);
+
+	while (head) {
+		fil = head;
+		head = head->next;
+
+		while (fil->links) {
+			struct link *l = fil->links;
+
+			fil->links = l->next;
+			free(l);
+		}
+		free(fil);
 	}
 }
 
+/**
+ * lowmem_link_groups - Link the files recorded by the first pass
+ *
+ * Merges the sorted runs and links the files of every size group.
+ */
+static void lowmem_link_groups(void)
+{
+	struct hdl_run *runs, **heap;
+	struct hdl_record *grp = NULL;
+	size_t i, nruns, nheap = 0, ngrp = 0, grpsz = 0;
+
+	if (!lowmem.names)
+		return;
+	if (fflush(lowmem.names) != 0)
+		err(EXIT_FAILURE, _("cannot write temporary file"));
+
+	/* all records in memory, don't use the runs file at all */
+	if (!lowmem.nruns) {
+		nruns = 1;
+		runs = xcalloc(1, sizeof(struct hdl_run));
+		qsort(lowmem.recs, lowmem.nrecs, sizeof(struct hdl_record), compare_records);
+		runs[0].recs = lowmem.recs;
+		runs[0].nrecs = lowmem.nrecs;
+		lowmem.recs = NULL;
+	} else {
+		if (lowmem.nrecs)
+			lowmem_write_run();
+		free(lowmem.recs);
+		lowmem.recs = NULL;
+
+		nruns = lowmem.nruns;
+		runs = xcalloc(nruns, sizeof(struct hdl_run));
+		for (i = 0; i < nruns; i++) {
+			runs[i].off = i ? lowmem.runs[i - 1] : 0;
+			runs[i].end = lowmem.runs[i];
+			runs[i].recs = xmalloc(HDL_MERGE_RECORDS * sizeof(struct hdl_record));
+		}
+	}
+
+	heap = xcalloc(nruns, sizeof(struct hdl_run *));
+	for (i = 0; i < nruns; i++) {
+		if (run_current(&runs[i]))
+			heap[nheap++] = &runs[i];
+	}
+	for (i = nheap / 2; i > 0; i--)
+		heap_down(heap, nheap, i - 1);
+
+	while (nheap) {
+		struct hdl_record *rec = run_current(heap[0]);
+
+		if (ngrp && (grp[0].dev != rec->dev || grp[0].size != rec->size)) {
+			if (handle_interrupt())
+				exit(EXIT_FAILURE);
+			lowmem_link_group(grp, ngrp);
+			ngrp = 0;
+		}
+		if (ngrp == grpsz) {
+			grpsz = grpsz ? grpsz * 2 : 64;
+			grp = xreallocarray(grp, grpsz, sizeof(struct hdl_record));
+		}
+		grp[ngrp++] = *rec;
+
+		heap[0]->cur++;
+		if (!run_current(heap[0]))
+			heap[0] = heap[--nheap];
+		heap_down(heap, nheap, 0);
+	}
+	if (ngrp)
+		lowmem_link_group(grp, ngrp);
+
+	for (i = 0; i < nruns; i++)
+		free(runs[i].recs);
+	free(runs);
+	free(heap);
+	free(grp);
+	free(lowmem.runs);
+
+	fclose(lowmem.names);
+	lowmem.names = NULL;
+	if (lowmem.runs_fd >= 0)
+		close(lowmem.runs_fd);
+	lowmem.runs_fd = -1;
+}
+
+#ifdef HAVE_PTHREAD
+/*
+ * --threads
+ *
+ * The workers read and compare the files of the size groups ahead of the main
+ * thread. Every file gets @eqclass, the files in the same class have the same
+ * content and attributes which do not change by linking. The main thread
+ * links the groups in the same order as visitor() by link_group().
+ */
+
+/* number of groups the workers may be ahead of the main thread per thread */
+#define HDL_GROUPS_PER_THREAD	4
+
+struct hdl_pool {
+	struct hdl_group *groups;
+	size_t ngroups;
+	size_t next;		/* the next group for a worker */
+	size_t linked;		/* number of groups finished by link_group() */
+	size_t window;		/* max number of groups ahead of link_group() */
+
+	pthread_mutex_t lock;
+	pthread_cond_t done;	/* a group has been classified */
+	pthread_cond_t space;	/* a group has been linked */
+};
+
+static struct hdl_pool pool;
+
+static void collector(const void *nodep, const VISIT which, const int depth)
+{
+	(void)depth;
+
+	if (which != leaf && which != endorder)
+		return;
+
+	if (pool.ngroups % 1024 == 0)
+		pool.groups = xreallocarray(pool.groups,
+				pool.ngroups + 1024, sizeof(struct hdl_group));
+	pool.groups[pool.ngroups].files = *(struct file **)nodep;
+	pool.groups[pool.ngroups].readsiz = 0;
+	pool.groups[pool.ngroups].done = 0;
+	pool.ngroups++;
+}
+
+static inline int is_interrupted(void)
+{
+	return last_signal == SIGINT || last_signal == SIGTERM;
+}
+
+static void file_open_data(struct ul_fileeq *eq, struct file *fil)
+{
+	if (!ul_fileeq_data_associated(&fil->data)) {
+		ul_fileeq_data_set_file(&fil->data, fil->links->path);
+		cache_load(eq, fil);
+	}
+}
+
+/*
+ * Sets @eqclass for all files in the group. Every file is compared with the
+ * first file of the already known classes only, the files in the class are
+ * not compared with each other.
+ */
+static void group_classify(struct ul_fileeq *eq, struct hdl_group *grp)
+{
+	struct file *fil, *rep;
+	size_t nclasses = 0;
+
+	ul_fileeq_set_size(eq, grp->files->st.st_size, opts.io_size,
+			   opts.cache_size / count_nodes(grp->files));
+	grp->readsiz = eq->readsiz;
+
+	for (fil = grp->files; fil != NULL; fil = fil->next)
+		fil->eqclass = 0;
+	if (!grp->files->next || grp->files->st.st_size == 0)
+		return;
+
+	for (fil = grp->files; fil != NULL && !is_interrupted(); fil = fil->next) {
+		size_t last = 0;
+
+		prefetch_next(eq, fil, fil->next);
+
+		/* the first file of the class has the highest class so far */
+		for (rep = grp->files; rep != fil; rep = rep->next) {
+			if (rep->eqclass <= last)
+				continue;
+			last = rep->eqclass;
+
+			if (!file_may_share_class(rep, fil))
+				continue;
+
+			file_open_data(eq, rep);
+			file_open_data(eq, fil);
+
+			if (ul_fileeq(eq, &rep->data, &fil->data))
+				fil->eqclass = rep->eqclass;
+
+			ul_fileeq_data_close_file(&rep->data);
+			ul_fileeq_data_close_file(&fil->data);
+			if (fil->eqclass)
+				break;
+		}
+		if (!fil->eqclass)
+			fil->eqclass = ++nclasses;
+	}
+}
+
+static void *group_worker(void *data)
+{
+	struct ul_fileeq *eq = data;
+
+	pthread_mutex_lock(&pool.lock);
+	while (pool.next < pool.ngroups) {
+		struct hdl_group *grp;
+
+		if (pool.next >= pool.linked + pool.window) {
+			pthread_cond_wait(&pool.space, &pool.lock);
+			continue;
+		}
+		grp = &pool.groups[pool.next++];
+		pthread_mutex_unlock(&pool.lock);
+
+		group_classify(eq, grp);
+
+		pthread_mutex_lock(&pool.lock);
+		grp->done = 1;
+		pthread_cond_broadcast(&pool.done);
+	}
+	pthread_mutex_unlock(&pool.lock);
+	return NULL;
+}
+
+/**
+ * link_groups_parallel - Link files using the --threads workers
+ *
+ * Returns: 0 on success, -1 if no thread has been created.
+ */
+static int link_groups_parallel(void)
+{
+	pthread_t *threads;
+	struct ul_fileeq *eqs;
+	size_t i, nthreads = 0;
+
+	twalk(files, collector);
+	if (!pool.ngroups)
+		return 0;
+
+	pool.window = opts.nthreads * HDL_GROUPS_PER_THREAD;
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.done, NULL);
+	pthread_cond_init(&pool.space, NULL);
+
+	threads = xcalloc(opts.nthreads, sizeof(pthread_t));
+	eqs = xcalloc(opts.nthreads, sizeof(struct ul_fileeq));
+
+	/* every worker has own comparator (buffers and crypto sockets) */
+	for (i = 0; i < opts.nthreads; i++) {
+		if (ul_fileeq_init(&eqs[i], opts.method) != 0)
+			break;
+		ul_fileeq_set_verify(&eqs[i], opts.verify);
+		ul_fileeq_set_extents(&eqs[i], true);
+		if (pthread_create(&threads[i], NULL, group_worker, &eqs[i]) != 0) {
+			ul_fileeq_deinit(&eqs[i]);
+			break;
+		}
+		nthreads++;
+	}
+	if (!nthreads) {
+		free(threads);
+		free(eqs);
+		free(pool.groups);
+		return -1;
+	}
+
+	for (i = 0; i < pool.ngroups; i++) {
+		struct hdl_group *grp = &pool.groups[i];
+
+		pthread_mutex_lock(&pool.lock);
+		while (!grp->done && !is_interrupted())
+			pthread_cond_wait(&pool.done, &pool.lock);
+		pthread_mutex_unlock(&pool.lock);
+
+		link_group(grp->files, grp);
+
+		pthread_mutex_lock(&pool.lock);
+		pool.linked = i + 1;
+		pthread_cond_broadcast(&pool.space);
+		pthread_mutex_unlock(&pool.lock);
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(threads[i], NULL);
+		ul_fileeq_deinit(&eqs[i]);
+	}
+	free(threads);
+	free(eqs);
+	free(pool.groups);
+	return 0;
+}
+#endif /* HAVE_PTHREAD */
+
 /**
  * usage - Print the program help and exit
  */
@@ -1168,6 +2278,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -d, --respect-dir          directory names have to be identical\n"), out);
 	fputs(_(" -f, --respect-name         filenames have to be identical\n"), out);
 	fputs(_(" -i, --include <regex>      regular expression to include files/dirs\n"), out);
+	fputs(_(" -J, --json                 print the linked files in JSON format\n"), out);
 	fputs(_(" -m, --maximize             maximize the hardlink count, remove the file with\n"
 	        "                              lowest hardlink count\n"), out);
 	fputs(_(" -M, --minimize             reverse the meaning of -m\n"), out);
@@ -1187,10 +2298,21 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -X, --respect-xattrs       respect extended attributes\n"), out);
 #endif
 	fputs(_(" -y, --method <name>        file content comparison method\n"), out);
+	fputs(_("     --verify               confirm sha256 and sha1 match by content comparison\n"), out);
+	fputs(_("     --cache <file>         keep file digests in the file for next runs\n"), out);
+	fputs(_("     --low-memory           keep only one size group in memory, the files\n"
+		"                              are recorded in temporary files\n"), out);
+#ifdef HAVE_PTHREAD
+	fputs(_("     --threads <num>        number of threads reading the files\n"), out);
+#endif
 
 #ifdef USE_REFLINK
 	fputs(_("     --reflink[=<when>]     create clone/CoW copies (auto, always, never)\n"), out);
 	fputs(_("     --skip-reflinks        skip already cloned files (enabled on --reflink)\n"), out);
+#endif
+#ifdef USE_DEDUPE
+	fputs(_("     --dedupe               share equal content by kernel deduplication\n"
+		"                              rather than hardlinks\n"), out);
 #endif
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(28));
@@ -1208,9 +2330,14 @@ static int parse_options(int argc, char *argv[])
 {
 	enum {
 		OPT_REFLINK = CHAR_MAX + 1,
-		OPT_SKIP_RELINKS
+		OPT_SKIP_RELINKS,
+		OPT_VERIFY,
+		OPT_CACHE,
+		OPT_THREADS,
+		OPT_DEDUPE,
+		OPT_LOW_MEMORY
 	};
-	static const char optstr[] = "VhvndfpotXcmMOx:y:i:r:S:s:b:q";
+	static const char optstr[] = "VhvndfpotXcmMOJx:y:i:r:S:s:b:q";
 	static const struct option long_options[] = {
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
@@ -1228,11 +2355,21 @@ static int parse_options(int argc, char *argv[])
 		{"exclude", required_argument, NULL, 'x'},
 		{"include", required_argument, NULL, 'i'},
 		{"method", required_argument, NULL, 'y' },
+		{"verify", no_argument, NULL, OPT_VERIFY },
+		{"cache", required_argument, NULL, OPT_CACHE },
+		{"low-memory", no_argument, NULL, OPT_LOW_MEMORY },
+		{"json", no_argument, NULL, 'J'},
+#ifdef HAVE_PTHREAD
+		{"threads", required_argument, NULL, OPT_THREADS },
+#endif
 		{"minimum-size", required_argument, NULL, 's'},
 		{"maximum-size", required_argument, NULL, 'S'},
 #ifdef USE_REFLINK
 		{"reflink", optional_argument, NULL, OPT_REFLINK },
 		{"skip-reflinks", no_argument, NULL, OPT_SKIP_RELINKS },
+#endif
+#ifdef USE_DEDUPE
+		{"dedupe", no_argument, NULL, OPT_DEDUPE },
 #endif
 		{"io-size", required_argument, NULL, 'b'},
 		{"content", no_argument, NULL, 'c'},
@@ -1242,6 +2379,9 @@ static int parse_options(int argc, char *argv[])
 	};
 	static const ul_excl_t excl[] = {
 		{'q', 'v'},
+#if defined(USE_REFLINK) && defined(USE_DEDUPE)
+		{OPT_REFLINK, OPT_DEDUPE},
+#endif
 		{0}
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -1312,6 +2452,26 @@ static int parse_options(int argc, char *argv[])
 		case 'b':
 			opts.io_size = strtosize_or_err(optarg, _("failed to parse I/O size"));
 			break;
+		case OPT_VERIFY:
+			opts.verify = TRUE;
+			break;
+		case OPT_CACHE:
+			opts.cache = optarg;
+			break;
+		case OPT_LOW_MEMORY:
+			opts.low_memory = TRUE;
+			break;
+		case 'J':
+			opts.json = TRUE;
+			break;
+#ifdef HAVE_PTHREAD
+		case OPT_THREADS:
+			opts.nthreads = str2unum_or_err(optarg, 10,
+					_("failed to parse number of threads"), 1024);
+			if (!opts.nthreads)
+				opts.nthreads = 1;
+			break;
+#endif
 #ifdef USE_REFLINK
 		case OPT_REFLINK:
 			reflink_mode = REFLINK_AUTO;
@@ -1331,6 +2491,12 @@ static int parse_options(int argc, char *argv[])
 		case OPT_SKIP_RELINKS:
 			reflinks_skip = 1;
 			break;
+#endif
+#ifdef USE_DEDUPE
+		case OPT_DEDUPE:
+			dedupe = 1;
+			reflinks_skip = 1;
+			break;
 #endif
 		case 'h':
 			usage();
@@ -1340,6 +2506,9 @@ static int parse_options(int argc, char *argv[])
 #ifdef USE_REFLINK
 				"reflink",
 #endif
+#ifdef USE_DEDUPE
+				"dedupe",
+#endif
 #ifdef USE_FILEEQ_CRYPTOAPI
 				"cryptoapi",
 #endif
@@ -1360,6 +2529,9 @@ static int parse_options(int argc, char *argv[])
 		opts.respect_time = FALSE;
 		opts.respect_xattrs = FALSE;
 	}
+	/* the messages would break the JSON output */
+	if (opts.json)
+		quiet = TRUE;
 	return 0;
 }
 
@@ -1368,6 +2540,8 @@ static int parse_options(int argc, char *argv[])
 */
 static void to_be_called_atexit(void)
 {
+	if (stats.started && opts.json)
+		json_close();
 	if (stats.started)
 		print_stats();
 }
@@ -1422,6 +2596,15 @@ int main(int argc, char *argv[])
 	}
 	if (rc < 0)
 		err(EXIT_FAILURE, _("failed to initialize files comparior"));
+	ul_fileeq_set_verify(&fileeq, opts.verify);
+	ul_fileeq_set_extents(&fileeq, true);
+
+	if (opts.cache && !ul_fileeq_get_digsiz(&fileeq)) {
+		warnx(_("the %s method does not support --cache, ignored"), opts.method);
+		opts.cache = NULL;
+	}
+	if (opts.cache)
+		cache_read();
 
 	/* defautl I/O size */
 	if (!opts.io_size) {
@@ -1432,6 +2615,8 @@ int main(int argc, char *argv[])
 	}
 
 	stats.started = TRUE;
+	if (opts.json)
+		json_open();
 
 	jlog(JLOG_VERBOSE2, _("Scanning [device/inode/links]:"));
 	for (; optind < argc; optind++) {
@@ -1443,13 +2628,27 @@ int main(int argc, char *argv[])
 		}
 		if (opts.respect_dir)
 			rootbasesz = strlen(path);
-		if (nftw(path, inserter, 20, FTW_PHYS) == -1)
+		if (ul_walkdir(path, inserter, UL_WALKDIR_REGULAR, opts.nthreads) == -1)
 			warn(_("cannot process %s"), path);
 		free(path);
 		rootbasesz = 0;
 	}
 
-	twalk(files, visitor);
+	if (opts.low_memory)
+		lowmem_link_groups();
+	else
+#ifdef HAVE_PTHREAD
+	/* --dedupe compares in kernel, the workers would read the files */
+	if (opts.nthreads <= 1
+#ifdef USE_DEDUPE
+	    || dedupe
+#endif
+	    || link_groups_parallel() != 0)
+#endif
+		twalk(files, visitor);
+
+	if (opts.cache)
+		cache_write();
 
 	ul_fileeq_deinit(&fileeq);
 	return 0;
@@ -72,15 +72,38 @@ enum {
 };
 
 #ifdef UL_HAVE_PIDFD
-# include <poll.h>
+# include <sys/epoll.h>
+# include <sys/timerfd.h>
 # include "list.h"
 struct timeouts {
 	int period;
 	int sig;
 	struct list_head follow_ups;
 };
+
+/* signaled processes waiting for --timeout follow-ups */
+struct kill_pidfds {
+	int *fds;
+	pid_t *pids;
+	size_t n;
+	size_t nalloc;
+};
+
+/* max number of events returned by one epoll_wait() */
+# define KILL_MAX_EVENTS	256
+# define KILL_TIMER_IDX		UINT64_MAX
 #endif
 
+/* pid or name from command line */
+struct kill_target {
+	char *arg;
+	pid_t pid;
+	pid_t *pids;		/* processes matching the name */
+	size_t npids;
+	size_t nalloc;
+	unsigned int is_name:1;
+};
+
 struct kill_control {
 	char *arg;
 	pid_t pid;
@@ -90,6 +113,7 @@ struct kill_control {
 #endif
 #ifdef UL_HAVE_PIDFD
 	struct list_head follow_ups;
+	struct kill_pidfds pidfds;
 #endif
 	unsigned int
 		check_all:1,
@@ -386,48 +410,152 @@ static char **parse_arguments(int argc, char **argv, struct kill_control *ctl)
 }
 
 #ifdef UL_HAVE_PIDFD
-static int kill_with_timeout(const struct kill_control *ctl)
+static void init_siginfo(const struct kill_control *ctl, siginfo_t *info, int sig)
 {
-	int pfd, n;
-	struct pollfd p = { 0 };
-	siginfo_t info = { 0 };
-	struct list_head *entry;
-
-	info.si_code = SI_QUEUE;
-	info.si_signo = ctl->numsig;
-	info.si_uid = getuid();
-	info.si_pid = getpid();
-	info.si_value.sival_int =
+	memset(info, 0, sizeof(*info));
+	info->si_code = SI_QUEUE;
+	info->si_signo = sig;
+	info->si_uid = getuid();
+	info->si_pid = getpid();
+	info->si_value.sival_int =
 	    ctl->use_sigval != 0 ? ctl->use_sigval : ctl->numsig;
+}
+
+/* sends the signal and keeps the pidfd for kill_follow_ups() */
+static int kill_with_timeout(struct kill_control *ctl)
+{
+	struct kill_pidfds *pf = &ctl->pidfds;
+	siginfo_t info;
+	int pfd;
+
+	init_siginfo(ctl, &info, ctl->numsig);
 
 	if ((pfd = pidfd_open(ctl->pid, 0)) < 0)
-		err(EXIT_FAILURE, _("pidfd_open() failed: %d"), ctl->pid);
-	p.fd = pfd;
-	p.events = POLLIN;
+		return -1;
+	if (pidfd_send_signal(pfd, ctl->numsig, &info, 0) < 0) {
+		int errsv = errno;
+
+		close(pfd);
+		errno = errsv;
+		return -1;
+	}
+
+	if (pf->n == pf->nalloc) {
+		pf->nalloc = pf->nalloc ? pf->nalloc * 2 : 64;
+		pf->fds = xreallocarray(pf->fds, pf->nalloc, sizeof(int));
+		pf->pids = xreallocarray(pf->pids, pf->nalloc, sizeof(pid_t));
+	}
+	pf->fds[pf->n] = pfd;
+	pf->pids[pf->n] = ctl->pid;
+	pf->n++;
+	return 0;
+}
+
+/*
+ * Waits for all the signaled processes at once; when the timeout expires
+ * the follow-up signal is sent to the processes that still exist.
+ */
+static void kill_follow_ups(struct kill_control *ctl)
+{
+	struct kill_pidfds *pf = &ctl->pidfds;
+	struct epoll_event evt = { .events = EPOLLIN }, evts[KILL_MAX_EVENTS];
+	struct list_head *entry;
+	size_t i, nalive = pf->n;
+	int epll, tfd;
+
+	if (!nalive)
+		return;
+
+	epll = epoll_create1(EPOLL_CLOEXEC);
+	if (epll < 0)
+		err(EXIT_FAILURE, _("epoll_create() failed"));
+	tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (tfd < 0)
+		err(EXIT_FAILURE, _("timerfd_create() failed"));
+
+	evt.data.u64 = KILL_TIMER_IDX;
+	if (epoll_ctl(epll, EPOLL_CTL_ADD, tfd, &evt) < 0)
+		err(EXIT_FAILURE, _("epoll_ctl() failed"));
+	for (i = 0; i < pf->n; i++) {
+		evt.data.u64 = i;
+		if (epoll_ctl(epll, EPOLL_CTL_ADD, pf->fds[i], &evt) < 0)
+			err(EXIT_FAILURE, _("epoll_ctl() failed"));
+	}
 
-	if (pidfd_send_signal(pfd, ctl->numsig, &info, 0) < 0)
-		err(EXIT_FAILURE, _("pidfd_send_signal() failed"));
 	list_for_each(entry, &ctl->follow_ups) {
 		struct timeouts *timeout;
+		siginfo_t info;
+		int expired;
+
+		if (!nalive)
+			break;
 
 		timeout = list_entry(entry, struct timeouts, follow_ups);
-		n = poll(&p, 1, timeout->period);
-		if (n < 0)
-			err(EXIT_FAILURE, _("poll() failed"));
-		if (n == 0) {
-			info.si_signo = timeout->sig;
+		expired = timeout->period == 0;
+		if (timeout->period > 0) {
+			struct itimerspec tm = {
+				.it_value = {
+					.tv_sec = timeout->period / 1000,
+					.tv_nsec = (timeout->period % 1000) * 1000000L
+				}
+			};
+			if (timerfd_settime(tfd, 0, &tm, NULL) < 0)
+				err(EXIT_FAILURE, _("timerfd_settime() failed"));
+		}
+
+		while (!expired && nalive) {
+			int n = epoll_wait(epll, evts, KILL_MAX_EVENTS, -1);
+
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				err(EXIT_FAILURE, _("epoll_wait() failed"));
+			}
+			for (i = 0; i < (size_t) n; i++) {
+				uint64_t idx = evts[i].data.u64;
+
+				if (idx == KILL_TIMER_IDX) {
+					uint64_t x;
+
+					ignore_result( read(tfd, &x, sizeof(x)) );
+					expired = 1;
+					continue;
+				}
+				/* the process has exited */
+				epoll_ctl(epll, EPOLL_CTL_DEL, pf->fds[idx], NULL);
+				close(pf->fds[idx]);
+				pf->fds[idx] = -1;
+				nalive--;
+			}
+		}
+		if (!expired)
+			break;
+
+		init_siginfo(ctl, &info, timeout->sig);
+		for (i = 0; i < pf->n; i++) {
+			if (pf->fds[i] < 0)
+				continue;
 			if (ctl->verbose)
 				printf(_("timeout, sending signal %d to pid %d\n"),
-					 timeout->sig, ctl->pid);
-			if (pidfd_send_signal(pfd, timeout->sig, &info, 0) < 0)
-				err(EXIT_FAILURE, _("pidfd_send_signal() failed"));
+					 timeout->sig, pf->pids[i]);
+			if (pidfd_send_signal(pf->fds[i], timeout->sig, &info, 0) < 0
+			    && errno != ESRCH)
+				warn(_("pidfd_send_signal() failed"));
 		}
 	}
-	return 0;
+
+	for (i = 0; i < pf->n; i++) {
+		if (pf->fds[i] >= 0)
+			close(pf->fds[i]);
+	}
+	close(tfd);
+	close(epll);
+	free(pf->fds);
+	free(pf->pids);
 }
 #endif
 
-static int kill_verbose(const struct kill_control *ctl)
+static int kill_verbose(struct kill_control *ctl)
 {
 	int rc = 0;
 
@@ -454,6 +582,57 @@ static int kill_verbose(const struct kill_control *ctl)
 	return rc;
 }
 
+static void add_target_pid(struct kill_target *tg, pid_t pid)
+{
+	if (tg->npids == tg->nalloc) {
+		tg->nalloc = tg->nalloc ? tg->nalloc * 2 : 16;
+		tg->pids = xreallocarray(tg->pids, tg->nalloc, sizeof(pid_t));
+	}
+	tg->pids[tg->npids++] = pid;
+}
+
+/* finds processes for all the names by one /proc scan */
+static void resolve_names(const struct kill_control *ctl,
+			  struct kill_target *targets, size_t ntargets,
+			  size_t nnames)
+{
+	struct procfs_iter *it = procfs_new_iter(NULL);
+	pid_t pid;
+	size_t i;
+
+	if (!it)
+		return;
+	if (!ctl->check_all)
+		procfs_iter_set_uid(it, getuid());
+
+	/* only one name, let the iterator to filter it */
+	if (nnames == 1) {
+		for (i = 0; i < ntargets; i++) {
+			if (targets[i].is_name)
+				break;
+		}
+		if (procfs_iter_set_name(it, targets[i].arg) != 0)
+			goto done;
+		while (procfs_iter_next(it, &pid) == 0)
+			add_target_pid(&targets[i], pid);
+		goto done;
+	}
+
+	while (procfs_iter_next(it, &pid) == 0) {
+		char *name = pid_get_cmdname(pid);
+
+		if (!name)
+			continue;
+		for (i = 0; i < ntargets; i++) {
+			if (targets[i].is_name && strcmp(targets[i].arg, name) == 0)
+				add_target_pid(&targets[i], pid);
+		}
+		free(name);
+	}
+done:
+	procfs_free_iter(it);
+}
+
 static int check_signal_handler(const struct kill_control *ctl)
 {
 	uintmax_t sigcgt = 0;
@@ -483,6 +662,8 @@ static int check_signal_handler(const struct kill_control *ctl)
 int main(int argc, char **argv)
 {
 	struct kill_control ctl = { .numsig = SIGTERM };
+	struct kill_target *targets;
+	size_t i, j, ntargets, nnames = 0, npids = 0;
 	int nerrs = 0, ct = 0;
 
 	setlocale(LC_ALL, "");
@@ -496,51 +677,74 @@ int main(int argc, char **argv)
 	argv = parse_arguments(argc, argv, &ctl);
 
 	/* The rest of the arguments should be process ids and names. */
-	for ( ; (ctl.arg = *argv) != NULL; argv++) {
+	for (ntargets = 0; argv[ntargets]; ntargets++);
+	targets = xcalloc(ntargets, sizeof(*targets));
+
+	for (i = 0; i < ntargets; i++) {
+		struct kill_target *tg = &targets[i];
 		char *ep = NULL;
 
+		tg->arg = argv[i];
 		errno = 0;
-		ctl.pid = strtol(ctl.arg, &ep, 10);
-		if (errno == 0 && ep && *ep == '\0' && ctl.arg < ep) {
+		tg->pid = strtol(tg->arg, &ep, 10);
+		if (errno == 0 && ep && *ep == '\0' && tg->arg < ep)
+			npids++;
+		else {
+			tg->is_name = 1;
+			nnames++;
+		}
+	}
+
+	if (nnames)
+		resolve_names(&ctl, targets, ntargets, nnames);
+
+#ifdef UL_HAVE_PIDFD
+	/* all the pidfds are kept open for the follow-ups */
+	if (ctl.timeout) {
+		for (i = 0; i < ntargets; i++)
+			npids += targets[i].npids;
+		ul_raise_fd_limit(npids + 16);
+	}
+#endif
+
+	for (i = 0; i < ntargets; i++) {
+		struct kill_target *tg = &targets[i];
+		int found = 0;
+
+		ctl.arg = tg->arg;
+		if (!tg->is_name) {
+			ctl.pid = tg->pid;
 			if (check_signal_handler(&ctl) <= 0)
 				continue;
 			if (kill_verbose(&ctl) != 0)
 				nerrs++;
 			ct++;
-		} else {
-			int found = 0;
-			struct dirent *d;
-			DIR *dir = opendir(_PATH_PROC);
-			uid_t uid = !ctl.check_all ? getuid() : 0;
+			continue;
+		}
 
-			if (!dir)
+		for (j = 0; j < tg->npids; j++) {
+			ctl.pid = tg->pids[j];
+			if (check_signal_handler(&ctl) <= 0)
 				continue;
 
-			while ((d = xreaddir(dir))) {
-				if (!ctl.check_all &&
-				    !procfs_dirent_match_uid(dir, d, uid))
-					continue;
-				if (ctl.arg &&
-				    !procfs_dirent_match_name(dir, d, ctl.arg))
-					continue;
-				if (procfs_dirent_get_pid(d, &ctl.pid) != 0)
-					continue;
-				if (check_signal_handler(&ctl) <= 0)
-					continue;
-
-				if (kill_verbose(&ctl) != 0)
-					nerrs++;
-				ct++;
-				found = 1;
-			}
+			if (kill_verbose(&ctl) != 0)
+				nerrs++;
+			ct++;
+			found = 1;
+		}
+		free(tg->pids);
 
-			closedir(dir);
-			if (!found) {
-				nerrs++, ct++;
-				warnx(_("cannot find process \"%s\""), ctl.arg);
-			}
+		if (!found) {
+			nerrs++, ct++;
+			warnx(_("cannot find process \"%s\""), ctl.arg);
 		}
 	}
+	free(targets);
+
+#ifdef UL_HAVE_PIDFD
+	if (ctl.timeout)
+		kill_follow_ups(&ctl);
+#endif
 
 #ifdef UL_HAVE_PIDFD
 	while (!list_empty(&ctl.follow_ups)) {
@@ -52,6 +52,7 @@
 #include <getopt.h>
 #include <pwd.h>
 #include <signal.h>
+#include <poll.h>
 #include <sys/uio.h>
 
 #include "all-io.h"
@@ -64,6 +65,7 @@
 #include "strv.h"
 #include "list.h"
 #include "pwdutils.h"
+#include "monotonic.h"
 
 #define	SYSLOG_NAMES
 #include <syslog.h>
@@ -101,9 +103,15 @@ enum {
 	OPT_ID,
 	OPT_STRUCTURED_DATA_ID,
 	OPT_STRUCTURED_DATA_PARAM,
-	OPT_OCTET_COUNT
+	OPT_OCTET_COUNT,
+	OPT_BATCH,
+	OPT_FLUSH_INTERVAL
 };
 
+#define LOGGER_BATCH_SIZE	64	/* default number of messages in a batch */
+#define LOGGER_BATCH_INTERVAL	100	/* default batch delay in milliseconds */
+#define LOGGER_INBUF_SIZE	(64 * 1024)
+
 /* rfc5424 structured data */
 struct structured_data {
 	char *id;		/* SD-ID */
@@ -112,6 +120,35 @@ struct structured_data {
 	struct list_head	sds;
 };
 
+/*
+ * Messages queued by --batch; the messages are serialized (including the
+ * octet count or the line terminator) in @data and sent by one sendmmsg()
+ * on datagram sockets or by one sendmsg() on stream sockets.
+ */
+struct logger_batch {
+	size_t max;		/* max number of messages, zero when unwanted */
+	unsigned int interval;	/* max delay in milliseconds */
+
+	char *data;		/* the queued messages */
+	size_t datasz;		/* allocated size of @data */
+	size_t datalen;		/* used size of @data */
+	size_t *ends;		/* end offset of the messages in @data */
+	size_t count;		/* number of queued messages */
+	usec_t deadline;	/* when to flush the first queued message */
+
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr *msgs;
+#endif
+	struct iovec *iovs;
+
+	char *inbuf;		/* stdin buffer */
+	size_t inlen;
+	size_t inpos;
+
+	uintmax_t nsent;	/* number of sent messages */
+	uintmax_t ndropped;	/* number of dropped messages */
+};
+
 struct logger_ctl {
 	int fd;
 	int pri;
@@ -127,6 +164,7 @@ struct logger_ctl {
 	size_t max_message_size;
 	struct list_head user_sds;	/* user defined rfc5424 structured data */
 	struct list_head reserved_sds;	/* standard rfc5424 structured data */
+	struct logger_batch batch;	/* --batch queue */
 
 	void (*syslogfp)(struct logger_ctl *ctl);
 
@@ -143,6 +181,7 @@ struct logger_ctl {
 };
 
 #define is_connected(_ctl)	((_ctl)->fd >= 0)
+#define is_batched(_ctl)	((_ctl)->batch.max > 0)
 static void logger_reopen(struct logger_ctl *ctl);
 
 /*
@@ -449,6 +488,267 @@ static char const *rfc3164_current_time(void)
 #define iovec_memcmp(ary, idx, str, len)		\
 		memcmp((ary)[(idx) - 1].iov_base, str, len)
 
+#ifdef SCM_CREDENTIALS
+union logger_cmsg {
+	struct cmsghdr cmh;
+	char   control[CMSG_SPACE(sizeof(struct ucred))];
+};
+
+/* syslog/journald may follow local socket credentials rather
+ * than in the message PID. If we use --id as root than we can
+ * force kernel to accept another valid PID than the real logger(1)
+ * PID.
+ */
+static void add_credentials(struct logger_ctl *ctl, struct msghdr *message,
+			    union logger_cmsg *cbuf)
+{
+	struct cmsghdr *cmhp;
+	struct ucred *cred;
+
+	if (!ctl->pid || ctl->server || ctl->pid == getpid()
+	    || geteuid() != 0 || kill(ctl->pid, 0) != 0)
+		return;
+
+	memset(cbuf, 0, sizeof(*cbuf));
+	message->msg_control = cbuf->control;
+	message->msg_controllen = CMSG_SPACE(sizeof(struct ucred));
+
+	cmhp = CMSG_FIRSTHDR(message);
+	cmhp->cmsg_len = CMSG_LEN(sizeof(struct ucred));
+	cmhp->cmsg_level = SOL_SOCKET;
+	cmhp->cmsg_type = SCM_CREDENTIALS;
+	cred = (struct ucred *) CMSG_DATA(cmhp);
+
+	cred->pid = ctl->pid;
+}
+#endif
+
+/*
+ * Note that logger(1) maybe executed for long time (as pipe
+ * reader) and connection endpoint (syslogd) may be restarted.
+ *
+ * The libc syslog() function reconnects on failed send().
+ * Let's do the same to be robust.    [kzak -- Oct 2017]
+ *
+ * MSG_NOSIGNAL is POSIX.1-2008 compatible, but it for example
+ * not supported by apple-darwin15.6.0.
+ */
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+static usec_t logger_monotonic(void)
+{
+	struct timeval tv;
+
+	if (gettime_monotonic(&tv) != 0)
+		return 0;
+	return (usec_t) tv.tv_sec * USEC_PER_SEC + tv.tv_usec;
+}
+
+static void init_batch(struct logger_ctl *ctl)
+{
+	struct logger_batch *b = &ctl->batch;
+
+	b->ends = xcalloc(b->max, sizeof(size_t));
+	b->iovs = xcalloc(b->max, sizeof(struct iovec));
+#ifdef HAVE_SENDMMSG
+	b->msgs = xcalloc(b->max, sizeof(struct mmsghdr));
+#endif
+	b->inbuf = xmalloc(LOGGER_INBUF_SIZE);
+}
+
+static void free_batch(struct logger_ctl *ctl)
+{
+	struct logger_batch *b = &ctl->batch;
+
+	free(b->data);
+	free(b->ends);
+	free(b->iovs);
+#ifdef HAVE_SENDMMSG
+	free(b->msgs);
+#endif
+	free(b->inbuf);
+}
+
+/* sends queued datagrams from @first, returns number of sent messages */
+static ssize_t batch_send_dgram(struct logger_ctl *ctl, size_t first)
+{
+	struct logger_batch *b = &ctl->batch;
+	struct msghdr message = { 0 };
+	size_t i, n = b->count - first;
+#ifdef SCM_CREDENTIALS
+	union logger_cmsg cbuf;
+
+	add_credentials(ctl, &message, &cbuf);
+#endif
+	for (i = 0; i < n; i++) {
+		size_t start = first + i ? b->ends[first + i - 1] : 0;
+
+		b->iovs[i].iov_base = b->data + start;
+		b->iovs[i].iov_len = b->ends[first + i] - start;
+	}
+#ifdef HAVE_SENDMMSG
+	for (i = 0; i < n; i++) {
+		b->msgs[i].msg_hdr = message;
+		b->msgs[i].msg_hdr.msg_iov = &b->iovs[i];
+		b->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	return sendmmsg(ctl->fd, b->msgs, n, MSG_NOSIGNAL);
+#else
+	message.msg_iovlen = 1;
+	for (i = 0; i < n; i++) {
+		message.msg_iov = &b->iovs[i];
+		if (sendmsg(ctl->fd, &message, MSG_NOSIGNAL) < 0)
+			return i ? (ssize_t) i : -1;
+	}
+	return n;
+#endif
+}
+
+/* sends queued stream data from @done offset, returns number of sent bytes */
+static ssize_t batch_send_stream(struct logger_ctl *ctl, size_t done)
+{
+	struct logger_batch *b = &ctl->batch;
+	struct msghdr message = { 0 };
+	struct iovec iov = {
+		.iov_base = b->data + done,
+		.iov_len = b->datalen - done
+	};
+#ifdef SCM_CREDENTIALS
+	union logger_cmsg cbuf;
+
+	add_credentials(ctl, &message, &cbuf);
+#endif
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+
+	return sendmsg(ctl->fd, &message, MSG_NOSIGNAL);
+}
+
+/* sends all queued messages, the connection is re-opened on error */
+static void batch_flush(struct logger_ctl *ctl)
+{
+	struct logger_batch *b = &ctl->batch;
+	size_t sent = 0, done = 0;
+	int reopened = 0;
+
+	if (!b->count)
+		return;
+	if (!is_connected(ctl))
+		logger_reopen(ctl);
+
+	while (sent < b->count && is_connected(ctl)) {
+		ssize_t rc;
+
+		if (ctl->socket_type == TYPE_TCP)
+			rc = batch_send_stream(ctl, done);
+		else
+			rc = batch_send_dgram(ctl, sent);
+
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			if (reopened) {
+				warn(_("send message failed"));
+				break;
+			}
+			logger_reopen(ctl);
+			reopened = 1;
+
+			/* never continue with half of the message on a new
+			 * connection */
+			done = sent ? b->ends[sent - 1] : 0;
+			continue;
+		}
+
+		reopened = 0;
+		if (ctl->socket_type == TYPE_TCP) {
+			done += rc;
+			while (sent < b->count && b->ends[sent] <= done)
+				sent++;
+		} else
+			sent += rc;
+	}
+
+	b->nsent += sent;
+	b->ndropped += b->count - sent;
+	b->count = 0;
+	b->datalen = 0;
+}
+
+/* adds the message to the batch, @iov is the octet count, header and message */
+static void batch_add(struct logger_ctl *ctl, struct iovec *iov, int iovlen)
+{
+	struct logger_batch *b = &ctl->batch;
+	int lf = ctl->socket_type == TYPE_TCP && !ctl->octet_count;
+	size_t len = lf ? 1 : 0;
+	int i;
+
+	for (i = 0; i < iovlen; i++)
+		len += iov[i].iov_len;
+
+	if (b->datalen + len > b->datasz) {
+		b->datasz = max(b->datasz * 2, b->datalen + len);
+		b->data = xrealloc(b->data, b->datasz);
+	}
+	for (i = 0; i < iovlen; i++) {
+		memcpy(b->data + b->datalen, iov[i].iov_base, iov[i].iov_len);
+		b->datalen += iov[i].iov_len;
+	}
+	if (lf)
+		b->data[b->datalen++] = '\n';
+
+	if (b->count == 0)
+		b->deadline = logger_monotonic() + (usec_t) b->interval * 1000;
+	b->ends[b->count++] = b->datalen;
+
+	if (b->count == b->max
+	    || (b->interval && logger_monotonic() >= b->deadline))
+		batch_flush(ctl);
+}
+
+/*
+ * getchar() for logger_stdin(); in batch mode the queued messages are
+ * flushed when the input does not provide more data before the deadline.
+ */
+static int logger_getchar(struct logger_ctl *ctl)
+{
+	struct logger_batch *b = &ctl->batch;
+
+	if (!is_batched(ctl))
+		return getchar();
+
+	if (b->inpos == b->inlen) {
+		ssize_t rc;
+
+		if (b->count) {
+			struct pollfd fds = {
+				.fd = fileno(stdin),
+				.events = POLLIN
+			};
+			usec_t now = logger_monotonic();
+			int timeout = 0;
+
+			if (now < b->deadline)
+				timeout = (b->deadline - now + 999) / 1000;
+			if (poll(&fds, 1, timeout) == 0)
+				batch_flush(ctl);
+		}
+
+		do {
+			rc = read(fileno(stdin), b->inbuf, LOGGER_INBUF_SIZE);
+		} while (rc < 0 && errno == EINTR);
+
+		if (rc <= 0)
+			return EOF;
+		b->inlen = rc;
+		b->inpos = 0;
+	}
+
+	return (unsigned char) b->inbuf[b->inpos++];
+}
+
 /* writes generated buffer to desired destination. For TCP syslog,
  * we use RFC6587 octet-stuffing (unless octet-counting is selected).
  * This is not great, but doing full blown RFC5425 (TLS) looks like
@@ -462,7 +762,7 @@ static void write_output(struct logger_ctl *ctl, const char *const msg)
 	char *octet = NULL;
 
 	/* initial connect failed? */
-	if (!ctl->noact && !is_connected(ctl))
+	if (!ctl->noact && !is_batched(ctl) && !is_connected(ctl))
 		logger_reopen(ctl);
 
 	/* 1) octet count */
@@ -477,15 +777,13 @@ static void write_output(struct logger_ctl *ctl, const char *const msg)
 	/* 3) message */
 	iovec_add_string(iov, iovlen, msg, 0);
 
-	if (!ctl->noact && is_connected(ctl)) {
+	if (!ctl->noact && is_batched(ctl))
+		batch_add(ctl, iov, iovlen);
+
+	else if (!ctl->noact && is_connected(ctl)) {
 		struct msghdr message = { 0 };
 #ifdef SCM_CREDENTIALS
-		struct cmsghdr *cmhp;
-		struct ucred *cred;
-		union {
-			struct cmsghdr cmh;
-			char   control[CMSG_SPACE(sizeof(struct ucred))];
-		} cbuf = { .control = { 0 } };
+		union logger_cmsg cbuf;
 #endif
 
 		/* 4) add extra \n to make sure message is terminated */
@@ -496,37 +794,7 @@ static void write_output(struct logger_ctl *ctl, const char *const msg)
 		message.msg_iovlen = iovlen;
 
 #ifdef SCM_CREDENTIALS
-		/* syslog/journald may follow local socket credentials rather
-		 * than in the message PID. If we use --id as root than we can
-		 * force kernel to accept another valid PID than the real logger(1)
-		 * PID.
-		 */
-		if (ctl->pid && !ctl->server && ctl->pid != getpid()
-		    && geteuid() == 0 && kill(ctl->pid, 0) == 0) {
-
-			message.msg_control = cbuf.control;
-			message.msg_controllen = CMSG_SPACE(sizeof(struct ucred));
-
-			cmhp = CMSG_FIRSTHDR(&message);
-			cmhp->cmsg_len = CMSG_LEN(sizeof(struct ucred));
-			cmhp->cmsg_level = SOL_SOCKET;
-			cmhp->cmsg_type = SCM_CREDENTIALS;
-			cred = (struct ucred *) CMSG_DATA(cmhp);
-
-			cred->pid = ctl->pid;
-		}
-#endif
-		/* Note that logger(1) maybe executed for long time (as pipe
-		 * reader) and connection endpoint (syslogd) may be restarted.
-		 *
-		 * The libc syslog() function reconnects on failed send().
-		 * Let's do the same to be robust.    [kzak -- Oct 2017]
-		 *
-		 * MSG_NOSIGNAL is POSIX.1-2008 compatible, but it for example
-		 * not supported by apple-darwin15.6.0.
-		 */
-#ifndef MSG_NOSIGNAL
-# define MSG_NOSIGNAL 0
+		add_credentials(ctl, &message, &cbuf);
 #endif
 		if (sendmsg(ctl->fd, &message, MSG_NOSIGNAL) < 0) {
 			logger_reopen(ctl);
@@ -1018,13 +1286,13 @@ static void logger_stdin(struct logger_ctl *ctl)
 	int c;
 	size_t i;
 
-	c = getchar();
+	c = logger_getchar(ctl);
 	while (c != EOF) {
 		i = 0;
 		if (ctl->prio_prefix && c == '<') {
 			pri = 0;
 			buf[i++] = c;
-			while (isdigit(c = getchar()) && pri <= 191) {
+			while (isdigit(c = logger_getchar(ctl)) && pri <= 191) {
 				buf[i++] = c;
 				pri = pri * 10 + c - '0';
 			}
@@ -1040,12 +1308,12 @@ static void logger_stdin(struct logger_ctl *ctl)
 				ctl->pri = default_priority;
 
 			if (c != EOF && c != '\n')
-				c = getchar();
+				c = logger_getchar(ctl);
 		}
 
 		while (c != EOF && c != '\n' && i < ctl->max_message_size) {
 			buf[i++] = c;
-			c = getchar();
+			c = logger_getchar(ctl);
 		}
 		buf[i] = '\0';
 
@@ -1055,14 +1323,23 @@ static void logger_stdin(struct logger_ctl *ctl)
 		}
 
 		if (c == '\n')	/* discard line terminator */
-			c = getchar();
+			c = logger_getchar(ctl);
 	}
 
 	free(buf);
 }
 
-static void logger_close(const struct logger_ctl *ctl)
+static void logger_close(struct logger_ctl *ctl)
 {
+	if (is_batched(ctl)) {
+		struct logger_batch *b = &ctl->batch;
+
+		batch_flush(ctl);
+		if (b->ndropped)
+			warnx(_("%ju of %ju messages dropped"),
+			      b->ndropped, b->nsent + b->ndropped);
+		free_batch(ctl);
+	}
 	if (ctl->fd != -1 && close(ctl->fd) != 0)
 		err(EXIT_FAILURE, _("close failed"));
 	free(ctl->hdr);
@@ -1086,6 +1363,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_("     --no-act             do everything except the write the log\n"), out);
 	fputs(_(" -p, --priority <prio>    mark given message with this priority\n"), out);
 	fputs(_("     --octet-count        use rfc6587 octet counting\n"), out);
+	fputs(_("     --batch[=<num>]      send messages in batches of <num> messages\n"), out);
+	fputs(_("     --flush-interval <ms> max delay of batched messages (implies --batch)\n"), out);
 	fputs(_("     --prio-prefix        look for a prefix on every line read from stdin\n"), out);
 	fputs(_(" -s, --stderr             output message to standard error as well\n"), out);
 	fputs(_(" -S, --size <size>        maximum size for a single message\n"), out);
@@ -1139,7 +1418,10 @@ int main(int argc, char **argv)
 		.rfc5424_time = 1,
 		.rfc5424_tq = 1,
 		.rfc5424_host = 1,
-		.skip_empty_lines = 0
+		.skip_empty_lines = 0,
+		.batch = {
+			.interval = LOGGER_BATCH_INTERVAL
+		}
 	};
 	int ch;
 	int stdout_reopened = 0;
@@ -1163,6 +1445,8 @@ int main(int argc, char **argv)
 		{ "version",	   no_argument,	      0, 'V'		   },
 		{ "help",	   no_argument,	      0, 'h'		   },
 		{ "octet-count",   no_argument,	      0, OPT_OCTET_COUNT   },
+		{ "batch",	   optional_argument, 0, OPT_BATCH	   },
+		{ "flush-interval", required_argument, 0, OPT_FLUSH_INTERVAL },
 		{ "prio-prefix",   no_argument,	      0, OPT_PRIO_PREFIX   },
 		{ "rfc3164",	   no_argument,	      0, OPT_RFC3164	   },
 		{ "rfc5424",	   optional_argument, 0, OPT_RFC5424	   },
@@ -1240,6 +1524,24 @@ int main(int argc, char **argv)
 		case OPT_OCTET_COUNT:
 			ctl.octet_count = 1;
 			break;
+		case OPT_BATCH:
+			ctl.batch.max = LOGGER_BATCH_SIZE;
+			if (optarg) {
+				const char *p = optarg;
+
+				if (*p == '=')
+					p++;
+				ctl.batch.max = strtou32_or_err(p, _("failed to parse batch size"));
+				if (!ctl.batch.max)
+					errx(EXIT_FAILURE, _("batch size has to be greater than zero"));
+			}
+			break;
+		case OPT_FLUSH_INTERVAL:
+			ctl.batch.interval = strtou32_or_err(optarg,
+				_("failed to parse flush interval"));
+			if (!ctl.batch.max)
+				ctl.batch.max = LOGGER_BATCH_SIZE;
+			break;
 		case OPT_PRIO_PREFIX:
 			ctl.prio_prefix = 1;
 			break;
@@ -1328,6 +1630,8 @@ int main(int argc, char **argv)
 		abort();
 	}
 	logger_open(&ctl);
+	if (is_batched(&ctl))
+		init_batch(&ctl);
 	if (0 < argc) {
 		generate_syslog_header(&ctl);
 		logger_command_line(&ctl, argv);
@@ -177,4 +177,7 @@ void lsblk_mnt_deinit(void)
 	mnt_unref_table(mtab);
 	mnt_unref_table(swaps);
 	mnt_unref_cache(mntcache);
+
+	mtab = swaps = NULL;
+	mntcache = NULL;
 }
@@ -15,7 +15,22 @@
 #include "lsblk.h"
 
 #ifdef HAVE_LIBUDEV
-static struct udev *udev;
+# ifdef HAVE_TLS
+#  define THREAD_LOCAL static __thread
+# else
+#  define THREAD_LOCAL static	/* --jobs threads do not read properties */
+# endif
+
+THREAD_LOCAL struct udev *udev;	/* the handler is not thread-safe */
+
+/* block devices from one udev enumeration, see lsblk_properties_read_udev() */
+struct udev_snapshot_entry {
+	const char *sysname;
+	struct udev_device *dev;
+};
+
+static struct udev_snapshot_entry *snapshot;
+static size_t nsnapshot;
 #endif
 
 void lsblk_device_free_properties(struct lsblk_devprop *p)
@@ -53,11 +68,92 @@ static struct lsblk_devprop *get_properties_by_udev(struct lsblk_device *dev
 {
 	return NULL;
 }
+
+void lsblk_properties_read_udev(void)
+{
+}
 #else
 
 #define LSBLK_UDEV_BYID_PREFIX "/dev/disk/by-id/"
 #define LSBLK_UDEV_BYID_PREFIXSZ (sizeof(LSBLK_UDEV_BYID_PREFIX) - 1)
 
+static int cmp_snapshot_entries(const void *a, const void *b)
+{
+	return strcmp(((const struct udev_snapshot_entry *) a)->sysname,
+		      ((const struct udev_snapshot_entry *) b)->sysname);
+}
+
+/*
+ * Reads all block devices by one udev enumeration. The lookup by
+ * udev_device_new_from_subsystem_sysname() searches sysfs for each device,
+ * it's expensive on systems with thousands of devices. The properties are
+ * still read by libudev when requested.
+ *
+ * The snapshot is not shared with --jobs threads, call it from the main
+ * thread only if the properties are read by the main thread.
+ */
+void lsblk_properties_read_udev(void)
+{
+	struct udev_enumerate *en;
+	struct udev_list_entry *le;
+	size_t nalloc = 0;
+
+	if (snapshot)
+		return;
+	if (!udev)
+		udev = udev_new();	/* global handler */
+	if (!udev)
+		return;
+
+	en = udev_enumerate_new(udev);
+	if (!en)
+		return;
+	if (udev_enumerate_add_match_subsystem(en, "block") != 0
+	    || udev_enumerate_scan_devices(en) != 0)
+		goto done;
+
+	udev_list_entry_foreach(le, udev_enumerate_get_list_entry(en)) {
+		struct udev_device *dev;
+		const char *sysname;
+
+		dev = udev_device_new_from_syspath(udev, udev_list_entry_get_name(le));
+		if (!dev)
+			continue;
+		sysname = udev_device_get_sysname(dev);
+		if (!sysname) {
+			udev_device_unref(dev);
+			continue;
+		}
+		if (nsnapshot == nalloc) {
+			nalloc = nalloc ? nalloc * 2 : 64;
+			snapshot = xreallocarray(snapshot, nalloc, sizeof(*snapshot));
+		}
+		snapshot[nsnapshot].sysname = sysname;
+		snapshot[nsnapshot].dev = dev;
+		nsnapshot++;
+	}
+	if (nsnapshot)
+		qsort(snapshot, nsnapshot, sizeof(*snapshot), cmp_snapshot_entries);
+
+	DBG(DEV, ul_debug("udev: %zu block devices enumerated", nsnapshot));
+done:
+	udev_enumerate_unref(en);
+}
+
+static struct udev_device *get_udev_device(const char *name)
+{
+	if (snapshot) {
+		struct udev_snapshot_entry key = { .sysname = name }, *e;
+
+		e = bsearch(&key, snapshot, nsnapshot, sizeof(*snapshot),
+			    cmp_snapshot_entries);
+		if (e)
+			return udev_device_ref(e->dev);
+		/* not enumerated (e.g. new device), try the usual way */
+	}
+	return udev_device_new_from_subsystem_sysname(udev, "block", name);
+}
+
 static struct lsblk_devprop *get_properties_by_udev(struct lsblk_device *ld)
 {
 	struct udev_device *dev;
@@ -74,7 +170,7 @@ static struct lsblk_devprop *get_properties_by_udev(struct lsblk_device *ld)
 	if (!udev)
 		goto done;
 
-	dev = udev_device_new_from_subsystem_sysname(udev, "block", ld->name);
+	dev = get_udev_device(ld->name);
 	if (!dev)
 		goto done;
 
@@ -361,7 +457,16 @@ struct lsblk_devprop *lsblk_device_get_properties(struct lsblk_device *dev)
 void lsblk_properties_deinit(void)
 {
 #ifdef HAVE_LIBUDEV
+	size_t i;
+
+	for (i = 0; i < nsnapshot; i++)
+		udev_device_unref(snapshot[i].dev);
+	free(snapshot);
+	snapshot = NULL;
+	nsnapshot = 0;
+
 	udev_unref(udev);
+	udev = NULL;
 #endif
 }
 
@@ -36,6 +36,13 @@
 #include <grp.h>
 #include <ctype.h>
 #include <assert.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #include <blkid.h>
 
@@ -148,7 +155,8 @@ enum {
 	LSBLK_EXPORT =		(1 << 3),
 	LSBLK_TREE =		(1 << 4),
 	LSBLK_JSON =		(1 << 5),
-	LSBLK_SHELLVAR =	(1 << 6)
+	LSBLK_SHELLVAR =	(1 << 6),
+	LSBLK_CBOR =		(1 << 7)
 };
 
 /* Types used for qsort() and JSON */
@@ -258,6 +266,46 @@ struct lsblk *lsblk;	/* global handler */
  * column twice. That's enough, dynamically allocated array of the columns is
  * unnecessary overkill and over-engineering in this case
  */
+/* data sources which are not always used */
+enum {
+	SRC_PROPS	= (1 << 1),	/* udev, libblkid or --sysroot properties */
+	SRC_DISK_PROPS	= (1 << 2),	/* properties of whole-disks only */
+	SRC_SYSROOT_PROPS = (1 << 3),	/* properties on --sysroot only */
+	SRC_MOUNT	= (1 << 4),	/* mountinfo and swaps (libmount) */
+};
+
+/* data sources of the columns, see get_columns_sources() */
+static const int sources[] = {
+	[COL_FSAVAIL]	= SRC_MOUNT,
+	[COL_FSROOTS]	= SRC_MOUNT,
+	[COL_FSSIZE]	= SRC_MOUNT,
+	[COL_FSTYPE]	= SRC_PROPS,
+	[COL_FSUSED]	= SRC_MOUNT,
+	[COL_FSUSEPERC]	= SRC_MOUNT,
+	[COL_FSVERSION]	= SRC_PROPS,
+	[COL_GROUP]	= SRC_SYSROOT_PROPS,
+	[COL_ID]	= SRC_PROPS,
+	[COL_IDLINK]	= SRC_PROPS,
+	[COL_LABEL]	= SRC_PROPS,
+	[COL_MODE]	= SRC_SYSROOT_PROPS,
+	[COL_MODEL]	= SRC_DISK_PROPS,
+	[COL_OWNER]	= SRC_SYSROOT_PROPS,
+	[COL_PARTFLAGS]	= SRC_PROPS,
+	[COL_PARTLABEL]	= SRC_PROPS,
+	[COL_PARTN]	= SRC_PROPS,
+	[COL_PARTTYPE]	= SRC_PROPS,
+	[COL_PARTTYPENAME] = SRC_PROPS,
+	[COL_PARTUUID]	= SRC_PROPS,
+	[COL_PTTYPE]	= SRC_PROPS,
+	[COL_PTUUID]	= SRC_PROPS,
+	[COL_REV]	= SRC_DISK_PROPS,
+	[COL_SERIAL]	= SRC_DISK_PROPS,
+	[COL_TARGET]	= SRC_MOUNT,
+	[COL_TARGETS]	= SRC_MOUNT,
+	[COL_UUID]	= SRC_PROPS,
+	[COL_WWN]	= SRC_PROPS,
+};
+
 static int columns[ARRAY_SIZE(infos) * 2];
 static size_t ncolumns;
 
@@ -276,6 +324,21 @@ static inline void add_uniq_column(int id)
 		add_column(id);
 }
 
+/* returns data sources used by the output, filter, sort and dedup columns */
+static int get_columns_sources(void)
+{
+	size_t i;
+	int res = 0;
+
+	for (i = 0; i < ncolumns; i++) {
+		if ((size_t) columns[i] < ARRAY_SIZE(sources))
+			res |= sources[columns[i]];
+	}
+	if (lsblk->sysroot && (res & SRC_SYSROOT_PROPS))
+		res |= SRC_PROPS;
+	return res;
+}
+
 static void lsblk_init_debug(void)
 {
 	__UL_INIT_DEBUG_FROM_ENV(lsblk, LSBLK_DEBUG_, 0, LSBLK_DEBUG);
@@ -596,7 +659,8 @@ static char *get_subsystems(struct lsblk_device *dev)
 
 #define is_parsable(_l)	(scols_table_is_raw((_l)->table) || \
 			 scols_table_is_export((_l)->table) || \
-			 scols_table_is_json((_l)->table))
+			 scols_table_is_json((_l)->table) || \
+			 scols_table_is_cbor((_l)->table))
 
 static char *mk_name(const char *name)
 {
@@ -1575,6 +1639,173 @@ static struct lsblk_device *devtree_get_device_or_new(struct lsblk_devtree *tr,
 	return dev;
 }
 
+/* returns true if the properties are read by --jobs threads */
+static inline int read_properties_by_jobs(void)
+{
+#if defined(HAVE_PTHREAD) && defined(HAVE_TLS)
+	return lsblk->njobs > 1;
+#else
+	return 0;
+#endif
+}
+
+#ifdef HAVE_PTHREAD
+/*
+ * The --jobs workers read data for an array of devices; every worker takes
+ * the next unprocessed item.  The tree is assembled by the main thread in
+ * the usual order, so the output does not depend on the workers.
+ */
+struct devices_pool {
+	pthread_mutex_t		lock;
+	struct lsblk_device	**devs;
+	char			**names;	/* for initialize_worker() */
+	size_t			ndevs;
+	size_t			next;		/* the next item for a worker */
+};
+
+static int pool_next_item(struct devices_pool *pool, size_t *idx)
+{
+	pthread_mutex_lock(&pool->lock);
+	*idx = pool->next++;
+	pthread_mutex_unlock(&pool->lock);
+
+	return *idx < pool->ndevs;
+}
+
+static void *initialize_worker(void *data)
+{
+	struct devices_pool *pool = data;
+	size_t i;
+
+	while (pool_next_item(pool, &i)) {
+		struct lsblk_device *dev = lsblk_new_device();
+
+		if (!dev)
+			err(EXIT_FAILURE, _("failed to allocate device"));
+		if (initialize_device(dev, NULL, pool->names[i]) != 0) {
+			lsblk_unref_device(dev);
+			continue;
+		}
+		/* Let's be careful with number of open files */
+		ul_path_close_dirfd(dev->sysfs);
+		pool->devs[i] = dev;
+	}
+	return NULL;
+}
+
+static void *properties_worker(void *data)
+{
+	struct devices_pool *pool = data;
+	size_t i;
+
+	while (pool_next_item(pool, &i))
+		lsblk_device_get_properties(pool->devs[i]);
+
+	lsblk_properties_deinit();
+	return NULL;
+}
+
+/* returns the number of threads; the pool is unchanged if zero */
+static size_t run_workers(struct devices_pool *pool, void *(*worker)(void *))
+{
+	pthread_t *threads;
+	size_t i, nthreads = 0;
+
+	threads = xcalloc(lsblk->njobs, sizeof(pthread_t));
+	pthread_mutex_init(&pool->lock, NULL);
+
+	for (i = 0; i < min((size_t) lsblk->njobs, pool->ndevs); i++) {
+		if (pthread_create(&threads[nthreads], NULL, worker, pool) != 0)
+			break;
+		nthreads++;
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	DBG(DEV, ul_debug("%zu devices read by %zu threads", pool->ndevs, nthreads));
+
+	pthread_mutex_destroy(&pool->lock);
+	free(threads);
+	return nthreads;
+}
+
+/*
+ * Initializes devices from @dir (/sys/block) in parallel and adds them to the
+ * tree; process_all_devices() finds them there. The devices which cannot be
+ * initialized are not added, the usual code path will try them again.
+ */
+static void initialize_devices_parallel(struct lsblk_devtree *tr, DIR *dir)
+{
+	struct devices_pool pool = { .ndevs = 0 };
+	struct dirent *d;
+	size_t i, nalloc = 0;
+
+	while ((d = xreaddir(dir))) {
+		if (pool.ndevs == nalloc) {
+			nalloc = nalloc ? nalloc * 2 : 64;
+			pool.names = xreallocarray(pool.names, nalloc, sizeof(char *));
+		}
+		pool.names[pool.ndevs++] = xstrdup(d->d_name);
+	}
+	rewinddir(dir);
+
+	if (pool.ndevs) {
+		pool.devs = xcalloc(pool.ndevs, sizeof(struct lsblk_device *));
+		run_workers(&pool, initialize_worker);
+	}
+
+	for (i = 0; i < pool.ndevs; i++) {
+		struct lsblk_device *dev = pool.devs[i];
+
+		if (dev) {
+			lsblk_devtree_add_device(tr, dev);
+			lsblk_unref_device(dev);	/* keep it referenced by devtree only */
+		}
+		free(pool.names[i]);
+	}
+	free(pool.names);
+	free(pool.devs);
+}
+
+/*
+ * Reads properties of all devices in the tree in parallel; they are cached in
+ * the devices and used later when the output lines are filled. The udev
+ * handler is thread-local, so it requires TLS, see read_properties_by_jobs().
+ */
+static void read_properties_parallel(struct lsblk_devtree *tr)
+{
+	struct devices_pool pool = { .ndevs = 0 };
+	struct lsblk_device *dev = NULL;
+	struct lsblk_iter itr;
+	size_t i = 0;
+	int sources = get_columns_sources();
+
+	if (!(sources & (SRC_PROPS | SRC_DISK_PROPS)))
+		return;
+
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0)
+		pool.ndevs++;
+	if (!pool.ndevs)
+		return;
+
+	pool.devs = xcalloc(pool.ndevs, sizeof(struct lsblk_device *));
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0) {
+		/* MODEL, SERIAL and REV read properties of whole-disks only */
+		if (!(sources & SRC_PROPS)
+		    && (device_is_partition(dev) || dev->nslaves))
+			continue;
+		pool.devs[i++] = dev;
+	}
+	pool.ndevs = i;
+
+	blkid_init_debug(0);		/* before the threads */
+	run_workers(&pool, properties_worker);
+	free(pool.devs);
+}
+#endif /* HAVE_PTHREAD */
+
 static struct lsblk_device *devtree_pktcdvd_get_dep(
 			struct lsblk_devtree *tr,
 			struct lsblk_device *dev,
@@ -1820,7 +2051,7 @@ static int __process_one_device(struct lsblk_devtree *tr, char *devname, dev_t d
 	} else {
 		dev_t diskno = 0;
 
-		if (blkid_devno_to_wholedisk(devno, buf, sizeof(buf), &diskno)) {
+		if (sysfs_devno_to_wholedisk(devno, buf, sizeof(buf), &diskno)) {
 			warn(_("%s: failed to get whole-disk device number"), name);
 			goto leave;
 		}
@@ -1951,6 +2182,10 @@ static int process_all_devices(struct lsblk_devtree *tr)
 
 	DBG(DEV, ul_debug("iterate on " _PATH_SYS_BLOCK));
 
+#ifdef HAVE_PTHREAD
+	if (lsblk->njobs > 1)
+		initialize_devices_parallel(tr, dir);
+#endif
 	while ((d = xreaddir(dir))) {
 		struct lsblk_device *dev = NULL;
 
@@ -2327,6 +2562,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -e, --exclude <list> exclude devices by major number (default: RAM disks)\n"), out);
 	fputs(_(" -f, --fs             output info about filesystems\n"), out);
 	fputs(_(" -i, --ascii          use ascii characters only\n"), out);
+	fputs(_(" -j, --jobs <num>     read devices by up to <num> threads\n"), out);
 	fputs(_(" -l, --list           use list format output\n"), out);
 	fputs(_(" -m, --perms          output info about permissions\n"), out);
 	fputs(_(" -n, --noheadings     don't print headings\n"), out);
@@ -2340,6 +2576,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -y, --shell          use column names to be usable as shell variable identifiers\n"), out);
 	fputs(_(" -z, --zoned          print zone related information\n"), out);
 	fputs(_("     --sysroot <dir>  use specified directory as system root\n"), out);
+	fputs(_("     --watch          list devices again after uevents\n"), out);
+	fputs(_("     --cbor           use CBOR (binary) output format\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_(" -H, --list-columns   list the available columns\n"), out);
@@ -2385,6 +2623,168 @@ static void check_sysdevblock(void)
 		    _PATH_SYS_DEVBLOCK);
 }
 
+/*
+ * Reads all devices or the devices from the command line (@argv starting at
+ * @first) into the tree; returns the exit status.
+ */
+static int read_devices(struct lsblk_devtree *tr, int argc, char **argv, int first)
+{
+	int status;
+
+	if (first == argc) {
+		int rc;
+
+		/* enumerate udev devices at once rather than look up one by one */
+		if (!lsblk->sysroot && !read_properties_by_jobs()
+		    && (get_columns_sources() & (SRC_PROPS | SRC_DISK_PROPS)))
+			lsblk_properties_read_udev();
+
+		rc = lsblk->inverse ?
+			process_all_devices_inverse(tr) :
+			process_all_devices(tr);
+
+		status = rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	} else {
+		int i, cnt = 0, cnt_err = 0;
+
+		for (i = first; i < argc; i++) {
+			if (process_one_device(tr, argv[i]) != 0)
+				cnt_err++;
+			cnt++;
+		}
+		status = cnt == 0	? EXIT_FAILURE :	/* nothing */
+			 cnt == cnt_err	? LSBLK_EXIT_ALLFAILED :/* all failed */
+			 cnt_err	? LSBLK_EXIT_SOMEOK :	/* some ok */
+					  EXIT_SUCCESS;		/* all success */
+	}
+
+#ifdef HAVE_PTHREAD
+	if (read_properties_by_jobs())
+		read_properties_parallel(tr);
+#endif
+	return status;
+}
+
+static void print_devtree(struct lsblk_devtree *tr)
+{
+	if (lsblk->dedup_id > -1) {
+		devtree_set_dedupkeys(tr, lsblk->dedup_id);
+		lsblk_devtree_deduplicate_devices(tr);
+	}
+
+	devtree_to_scols(tr, lsblk->table);
+
+	if (lsblk->sort_col)
+		scols_sort_table(lsblk->table, lsblk->sort_col);
+	if (lsblk->force_tree_order)
+		scols_sort_table_by_tree(lsblk->table);
+
+	scols_print_table(lsblk->table);
+}
+
+/* kernel uevents; the udev database may be updated later */
+static int open_uevent_socket(void)
+{
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = 1		/* kernel events */
+	};
+	int fd;
+
+	fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		err(EXIT_FAILURE, _("cannot open uevent socket"));
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+		err(EXIT_FAILURE, _("cannot bind uevent socket"));
+	return fd;
+}
+
+/* the uevent is "<action>@<devpath>\0" followed by "KEY=value\0" pairs */
+static int is_block_uevent(const char *buf, size_t sz)
+{
+	const char *p = buf, *end = buf + sz;
+
+	while (p < end) {
+		if (strcmp(p, "SUBSYSTEM=block") == 0)
+			return 1;
+		p += strlen(p) + 1;
+	}
+	return 0;
+}
+
+/* how long to wait for more events before the devices are read again */
+#define WATCH_SETTLE_MSEC	250
+
+/*
+ * Waits for uevents of block devices. The events come in bursts (a disk and
+ * its partitions), it returns when no event has been received in the last
+ * WATCH_SETTLE_MSEC.
+ */
+static void wait_for_uevents(int fd)
+{
+	char buf[BUFSIZ];
+	int changed = 0;
+
+	do {
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		int rc = poll(&pfd, 1, changed ? WATCH_SETTLE_MSEC : -1);
+
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, _("poll() failed"));
+		}
+		if (rc == 0)
+			break;
+
+		while (1) {
+			ssize_t sz = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+
+			if (sz < 0) {
+				if (errno == ENOBUFS)
+					changed = 1;	/* lost events */
+				else if (errno != EAGAIN && errno != EINTR)
+					err(EXIT_FAILURE, _("cannot read uevent"));
+				break;
+			}
+			buf[sz] = '\0';
+			if (is_block_uevent(buf, sz))
+				changed = 1;
+		}
+	} while (1);
+}
+
+/*
+ * All devices are read from scratch after the events. The tree is linked by
+ * holders/slaves and partitions, an event may change any part of it, and
+ * the reading is cheap in comparison with the udev processing of the event.
+ */
+static void __attribute__((__noreturn__)) watch(struct lsblk_devtree *tr, int fd,
+						 int argc, char **argv, int first)
+{
+	do {
+		fflush(stdout);
+		wait_for_uevents(fd);
+
+		if (lsblk->rawdata)
+			unref_table_rawdata(lsblk->table);
+		scols_table_remove_lines(lsblk->table);
+		lsblk_unref_devtree(tr);
+
+		/* drop mount tables, udev and sysfs data read for the previous output */
+		lsblk_mnt_deinit();
+		lsblk_properties_deinit();
+		sysfs_devno_cache_invalidate();
+
+		tr = lsblk_new_devtree();
+		if (!tr)
+			err(EXIT_FAILURE, _("failed to allocate device tree"));
+
+		read_devices(tr, argc, argv, first);
+		print_devtree(tr);
+	} while (1);
+}
+
 int main(int argc, char *argv[])
 {
 	struct lsblk _ls = {
@@ -2394,6 +2794,7 @@ int main(int argc, char *argv[])
 		.tree_id = COL_NAME
 	};
 	struct lsblk_devtree *tr = NULL;
+	int watch_fd = -1;
 	int c, status = EXIT_FAILURE, collist = 0;
 	char *outarg = NULL;
 	size_t i;
@@ -2405,11 +2806,14 @@ int main(int argc, char *argv[])
 		OPT_COUNTER_FILTER,
 		OPT_COUNTER,
 		OPT_HIGHLIGHT,
+		OPT_CBOR,
+		OPT_WATCH,
 	};
 
 	static const struct option longopts[] = {
 		{ "all",	no_argument,       NULL, 'a' },
 		{ "bytes",      no_argument,       NULL, 'b' },
+		{ "cbor",       no_argument,       NULL, OPT_CBOR },
 		{ "nodeps",     no_argument,       NULL, 'd' },
 		{ "noempty",    no_argument,       NULL, 'A' },
 		{ "discard",    no_argument,       NULL, 'D' },
@@ -2426,6 +2830,7 @@ int main(int argc, char *argv[])
 		{ "noheadings",	no_argument,       NULL, 'n' },
 		{ "list",       no_argument,       NULL, 'l' },
 		{ "ascii",	no_argument,       NULL, 'i' },
+		{ "jobs",       required_argument, NULL, 'j' },
 		{ "raw",        no_argument,       NULL, 'r' },
 		{ "inverse",	no_argument,       NULL, 's' },
 		{ "fs",         no_argument,       NULL, 'f' },
@@ -2442,6 +2847,7 @@ int main(int argc, char *argv[])
 		{ "shell",      no_argument,       NULL, 'y' },
 		{ "tree",       optional_argument, NULL, 'T' },
 		{ "version",    no_argument,       NULL, 'V' },
+		{ "watch",      no_argument,       NULL, OPT_WATCH },
 		{ "width",	required_argument, NULL, 'w' },
 		{ "ct-filter",  required_argument, NULL, OPT_COUNTER_FILTER },
 		{ "ct",         required_argument, NULL, OPT_COUNTER },
@@ -2452,7 +2858,7 @@ int main(int argc, char *argv[])
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
 		{ 'D','O' },
 		{ 'I','e' },
-		{ 'J', 'P', 'r' },
+		{ 'J', 'P', 'r', OPT_CBOR },
 		{ 'O','S' },
 		{ 'O','f' },
 		{ 'O','m' },
@@ -2474,7 +2880,7 @@ int main(int argc, char *argv[])
 	scols_init_debug(0);
 
 	while((c = getopt_long(argc, argv,
-				"AabdDzE:e:fHhJlNnMmo:OpPQ:iI:rstVvST::w:x:y",
+				"AabdDzE:e:fHhJj:lNnMmo:OpPQ:iI:rstVvST::w:x:y",
 				longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
@@ -2515,6 +2921,9 @@ int main(int argc, char *argv[])
 		case 'J':
 			lsblk->flags |= LSBLK_JSON;
 			break;
+		case OPT_CBOR:
+			lsblk->flags |= LSBLK_CBOR;
+			break;
 		case 'l':
 			lsblk->flags &= ~LSBLK_TREE; /* disable the default */
 			break;
@@ -2548,6 +2957,9 @@ int main(int argc, char *argv[])
 		case 'i':
 			lsblk->flags |= LSBLK_ASCII;
 			break;
+		case 'j':
+			lsblk->njobs = strtou32_or_err(optarg, _("invalid jobs argument"));
+			break;
 		case 'I':
 			parse_includes(optarg);
 			break;
@@ -2633,6 +3045,9 @@ int main(int argc, char *argv[])
 		case OPT_SYSROOT:
 			lsblk->sysroot = optarg;
 			break;
+		case OPT_WATCH:
+			lsblk->watch = 1;
+			break;
 		case 'E':
 			lsblk->dedup_id = column_name_to_id(optarg, strlen(optarg));
 			if (lsblk->dedup_id >= 0)
@@ -2678,6 +3093,11 @@ int main(int argc, char *argv[])
 	if (force_tree)
 		lsblk->flags |= LSBLK_TREE;
 
+	if (lsblk->watch && lsblk->sysroot)
+		errx(EXIT_FAILURE, _("--watch cannot be used with --sysroot"));
+	if (lsblk->watch && lsblk->ncts)
+		errx(EXIT_FAILURE, _("--watch cannot be used with --ct"));
+
 	check_sysdevblock();
 
 	if (!ncolumns) {
@@ -2719,7 +3139,6 @@ int main(int argc, char *argv[])
 		lsblk->dedup_hidden = 1;
 	}
 
-	lsblk_mnt_init();
 	ul_path_init_debug();
 
 	/*
@@ -2732,9 +3151,10 @@ int main(int argc, char *argv[])
 	scols_table_enable_shellvar(lsblk->table, !!(lsblk->flags & LSBLK_SHELLVAR));
 	scols_table_enable_ascii(lsblk->table, !!(lsblk->flags & LSBLK_ASCII));
 	scols_table_enable_json(lsblk->table, !!(lsblk->flags & LSBLK_JSON));
+	scols_table_enable_cbor(lsblk->table, !!(lsblk->flags & LSBLK_CBOR));
 	scols_table_enable_noheadings(lsblk->table, !!(lsblk->flags & LSBLK_NOHEADINGS));
 
-	if (lsblk->flags & LSBLK_JSON)
+	if (lsblk->flags & (LSBLK_JSON | LSBLK_CBOR))
 		scols_table_set_name(lsblk->table, "blockdevices");
 	if (width) {
 		scols_table_set_termwidth(lsblk->table, width);
@@ -2760,7 +3180,7 @@ int main(int argc, char *argv[])
 			fl |= SCOLS_FL_HIDDEN;
 
 		if (force_tree
-		    && lsblk->flags & LSBLK_JSON
+		    && lsblk->flags & (LSBLK_JSON | LSBLK_CBOR)
 		    && has_tree_col == 0
 		    && i + 1 == ncolumns)
 			/* The "--tree --json" specified, but no column with
@@ -2776,17 +3196,26 @@ int main(int argc, char *argv[])
 		if (!lsblk->sort_col && lsblk->sort_id == id) {
 			lsblk->sort_col = cl;
 			lsblk->rawdata = 1;
-			scols_column_set_cmpfunc(cl,
-				ci->type == COLTYPE_NUM     ? cmp_u64_cells :
-				ci->type == COLTYPE_SIZE    ? cmp_u64_cells :
-			        ci->type == COLTYPE_SORTNUM ? cmp_u64_cells : scols_cmpstr_cells,
-				NULL);
+
+			/* numbers are sorted by u64 keys (see below) */
+			if (ci->type == COLTYPE_NUM || ci->type == COLTYPE_SIZE)
+				scols_column_set_data_func(cl, get_u64_cell, NULL);
+			else
+				scols_column_set_cmpfunc(cl,
+					ci->type == COLTYPE_SORTNUM ? cmp_u64_cells :
+								      scols_cmpstr_cells,
+					NULL);
 		}
 		/* multi-line cells (now used for MOUNTPOINTS) */
 		if (fl & SCOLS_FL_WRAP)
 			scols_column_set_wrapfunc(cl, NULL, scols_wrapzero_nextchunk, NULL);
 
 		set_column_type(ci, cl, fl);
+
+		/* the library extracts the u64 sort key only once per line */
+		if (cl == lsblk->sort_col
+		    && (ci->type == COLTYPE_NUM || ci->type == COLTYPE_SIZE))
+			scols_column_set_data_type(cl, SCOLS_DATA_U64);
 	}
 
 	if (lsblk->filter)
@@ -2800,43 +3229,25 @@ int main(int argc, char *argv[])
 	for (i = 0; i < lsblk->ncts; i++)
 		init_scols_filter(lsblk->table, lsblk->ct_filters[i]);
 
-	tr = lsblk_new_devtree();
-	if (!tr)
-		err(EXIT_FAILURE, _("failed to allocate device tree"));
+	/* the filters may add hidden columns, don't check sources before */
+	if (get_columns_sources() & SRC_MOUNT)
+		lsblk_mnt_init();
 
-	if (optind == argc) {
-		int rc = lsblk->inverse ?
-			process_all_devices_inverse(tr) :
-			process_all_devices(tr);
+	if (lsblk->watch)
+		watch_fd = open_uevent_socket();	/* before the first scan */
 
-		status = rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
-	} else {
-		int cnt = 0, cnt_err = 0;
-
-		while (optind < argc) {
-			if (process_one_device(tr, argv[optind++]) != 0)
-				cnt_err++;
-			cnt++;
-		}
-		status = cnt == 0	? EXIT_FAILURE :	/* nothing */
-			 cnt == cnt_err	? LSBLK_EXIT_ALLFAILED :/* all failed */
-			 cnt_err	? LSBLK_EXIT_SOMEOK :	/* some ok */
-					  EXIT_SUCCESS;		/* all success */
-	}
-
-	if (lsblk->dedup_id > -1) {
-		devtree_set_dedupkeys(tr, lsblk->dedup_id);
-		lsblk_devtree_deduplicate_devices(tr);
-	}
+	/* the same devno is resolved for every dependency and argument */
+	sysfs_devno_cache_enable(1);
 
-	devtree_to_scols(tr, lsblk->table);
+	tr = lsblk_new_devtree();
+	if (!tr)
+		err(EXIT_FAILURE, _("failed to allocate device tree"));
 
-	if (lsblk->sort_col)
-		scols_sort_table(lsblk->table, lsblk->sort_col);
-	if (lsblk->force_tree_order)
-		scols_sort_table_by_tree(lsblk->table);
+	status = read_devices(tr, argc, argv, optind);
+	print_devtree(tr);
 
-	scols_print_table(lsblk->table);
+	if (lsblk->watch)
+		watch(tr, watch_fd, argc, argv, optind);
 
 	if (lsblk->ncts)
 		print_counters();
@@ -2854,6 +3265,7 @@ leave:
 
 	lsblk_mnt_deinit();
 	lsblk_properties_deinit();
+	sysfs_devno_cache_enable(0);
 	lsblk_unref_devtree(tr);
 
 	return status;
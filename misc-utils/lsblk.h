@@ -50,6 +50,7 @@ struct lsblk {
 
 	const char *sysroot;
 	int flags;			/* LSBLK_* */
+	unsigned int njobs;		/* --jobs */
 
 	unsigned int all_devices:1;	/* print all devices, including empty */
 	unsigned int bytes:1;		/* print SIZE in bytes */
@@ -65,6 +66,7 @@ struct lsblk {
 	unsigned int dedup_hidden :1;	/* deduplication column not between output columns */
 	unsigned int force_tree_order:1;/* sort lines by parent->tree relation */
 	unsigned int noempty:1;		/* hide empty devices */
+	unsigned int watch:1;		/* --watch */
 };
 
 extern struct lsblk *lsblk;     /* global handler */
@@ -229,6 +231,7 @@ extern struct libmnt_fs **lsblk_device_get_filesystems(struct lsblk_device *dev,
 /* lsblk-properties.c */
 extern void lsblk_device_free_properties(struct lsblk_devprop *p);
 extern struct lsblk_devprop *lsblk_device_get_properties(struct lsblk_device *dev);
+extern void lsblk_properties_read_udev(void);
 extern void lsblk_properties_deinit(void);
 
 extern const char *lsblk_parttype_code_to_string(const char *code, const char *pttype);
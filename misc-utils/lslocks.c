@@ -213,40 +213,96 @@ static char *get_fallback_filename(dev_t dev)
 }
 
 /*
- * Return the absolute path of a file from
- * a given inode number (and its size)
+ * Per-process index of the opened files. The /proc/PID/fd directory of the
+ * lock holder is read only once, all locks held by the process are then
+ * resolved by the inode number.
  */
-static char *get_filename_sz(ino_t inode, pid_t lock_pid, size_t *size)
+struct proc_file {
+	ino_t inode;
+	uint64_t size;
+	char path[];
+};
+
+struct proc_files {
+	pid_t pid;
+	char *cmdname;		/* NULL if unknown */
+	void *files;		/* tree of struct proc_file, by inode */
+
+	unsigned int has_cmdname : 1,
+		     has_files : 1;
+};
+
+static void *proc_files_tree;	/* tree of struct proc_files, by pid */
+
+static int proc_files_compare(const void *a, const void *b)
+{
+	pid_t ap = ((const struct proc_files *) a)->pid;
+	pid_t bp = ((const struct proc_files *) b)->pid;
+
+	return ap < bp ? -1 : ap > bp ? 1 : 0;
+}
+
+static int proc_file_compare(const void *a, const void *b)
+{
+	ino_t ai = ((const struct proc_file *) a)->inode;
+	ino_t bi = ((const struct proc_file *) b)->inode;
+
+	return ai < bi ? -1 : ai > bi ? 1 : 0;
+}
+
+static void rem_proc_files(void *node)
+{
+	struct proc_files *pf = node;
+
+	tdestroy(pf->files, free);
+	free(pf->cmdname);
+	free(pf);
+}
+
+static struct proc_files *get_proc_files(pid_t pid)
 {
-	struct stat sb;
+	struct proc_files tmp = { .pid = pid }, *pf, **res;
+
+	res = tfind(&tmp, &proc_files_tree, proc_files_compare);
+	if (res)
+		return *res;
+
+	pf = xcalloc(1, sizeof(*pf));
+	pf->pid = pid;
+	if (!tsearch(pf, &proc_files_tree, proc_files_compare))
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
+	return pf;
+}
+
+static const char *get_proc_cmdname(pid_t pid)
+{
+	struct proc_files *pf = get_proc_files(pid);
+
+	if (!pf->has_cmdname) {
+		pf->cmdname = pid_get_cmdname(pid);
+		pf->has_cmdname = 1;
+	}
+	return pf->cmdname;
+}
+
+static void read_proc_files(struct proc_files *pf)
+{
+	char path[PATH_MAX], sym[PATH_MAX];
 	struct dirent *dp;
 	DIR *dirp;
 	int fd;
-	char path[PATH_MAX] = { 0 },
-	     sym[PATH_MAX] = { 0 }, *ret = NULL;
-
-	*size = 0;
 
-	if (lock_pid < 0)
-		/* pid could be -1 for OFD locks */
-		return NULL;
+	pf->has_files = 1;
 
-	/*
-	 * We know the pid so we don't have to
-	 * iterate the *entire* filesystem searching
-	 * for the damn file.
-	 */
-	snprintf(path, sizeof(path), "/proc/%d/fd/", lock_pid);
+	snprintf(path, sizeof(path), "/proc/%d/fd/", pf->pid);
 	if (!(dirp = opendir(path)))
-		return NULL;
-
-	if (strlen(path) >= (sizeof(path) - 2))
-		goto out;
-
-	if ((fd = dirfd(dirp)) < 0 )
+		return;
+	if ((fd = dirfd(dirp)) < 0)
 		goto out;
 
 	while ((dp = xreaddir(dirp))) {
+		struct proc_file *f;
+		struct stat sb;
 		ssize_t len;
 
 		errno = 0;
@@ -255,22 +311,55 @@ static char *get_filename_sz(ino_t inode, pid_t lock_pid, size_t *size)
 		if (!strtol(dp->d_name, (char **) NULL, 10) || errno)
 			continue;
 
-		if (!fstatat(fd, dp->d_name, &sb, 0)
-		    && inode != sb.st_ino)
+		if (fstatat(fd, dp->d_name, &sb, 0) != 0)
 			continue;
-
 		if ((len = readlinkat(fd, dp->d_name, sym, sizeof(sym) - 1)) < 1)
-			goto out;
-
-		*size = sb.st_size;
+			continue;
 		sym[len] = '\0';
 
-		ret = xstrdup(sym);
-		break;
+		f = xmalloc(sizeof(*f) + len + 1);
+		f->inode = sb.st_ino;
+		f->size = sb.st_size;
+		memcpy(f->path, sym, len + 1);
+
+		/* keep the first descriptor for the inode */
+		if (*(struct proc_file **) tsearch(f, &pf->files, proc_file_compare) != f)
+			free(f);
 	}
 out:
 	closedir(dirp);
-	return ret;
+}
+
+/*
+ * Return the absolute path of a file from
+ * a given inode number (and its size)
+ */
+static char *get_filename_sz(ino_t inode, pid_t lock_pid, size_t *size)
+{
+	struct proc_file tmp = { .inode = inode }, **f;
+	struct proc_files *pf;
+
+	*size = 0;
+
+	if (lock_pid < 0)
+		/* pid could be -1 for OFD locks */
+		return NULL;
+
+	/*
+	 * We know the pid so we don't have to
+	 * iterate the *entire* filesystem searching
+	 * for the damn file.
+	 */
+	pf = get_proc_files(lock_pid);
+	if (!pf->has_files)
+		read_proc_files(pf);
+
+	f = tfind(&tmp, &pf->files, proc_file_compare);
+	if (!f)
+		return NULL;
+
+	*size = (*f)->size;
+	return xstrdup((*f)->path);
 }
 
 /*
@@ -383,11 +472,12 @@ static struct lock *get_lock(char *buf, struct override_info *oinfo, void *fallb
 			} else {
 				l->pid = strtos32_or_err(tok, _("failed to parse pid"));
 				if (l->pid > 0) {
-					l->cmdname = pid_get_cmdname(l->pid);
-					if (!l->cmdname) {
-						l->cmdname = NULL;
+					const char *cmd = get_proc_cmdname(l->pid);
+
+					if (cmd)
+						l->cmdname = xstrdup(cmd);
+					else
 						cmdname_unknown = true;
-					}
 				} else
 					l->cmdname = NULL;
 			}
@@ -491,26 +581,22 @@ static int get_pid_locks(void *locks, void (*add_lock)(void *, struct lock *), s
 
 static void get_pids_locks(void *locks, void (*add_lock)(void *, struct lock *))
 {
-	DIR *dir;
-	struct dirent *d;
+	struct procfs_iter *it;
 	struct path_cxt *pc = NULL;
+	pid_t pid;
 
 	pc = ul_new_path(NULL);
 	if (!pc)
 		err(EXIT_FAILURE, _("failed to alloc procfs handler"));
 
-	dir = opendir(_PATH_PROC);
-	if (!dir)
+	it = procfs_new_iter(NULL);
+	if (!it)
 		err(EXIT_FAILURE, _("failed to open /proc"));
 
-	while ((d = readdir(dir))) {
-		pid_t pid;
+	while (procfs_iter_next(it, &pid) == 0) {
 		char buf[BUFSIZ];
 		const char *cmdname = NULL;
 
-		if (procfs_dirent_get_pid(d, &pid) != 0)
-			continue;
-
 		if (procfs_process_init_path(pc, pid) != 0)
 			continue;
 
@@ -521,7 +607,7 @@ static void get_pids_locks(void *locks, void (*add_lock)(void *, struct lock *))
 		get_pid_locks(locks, add_lock, pc, pid, cmdname);
 	}
 
-	closedir(dir);
+	procfs_free_iter(it);
 	ul_unref_path(pc);
 
 	return;
@@ -576,18 +662,39 @@ static inline const struct colinfo *get_column_info(unsigned num)
 	return &infos[ get_column_id(num) ];
 }
 
+static void *blockers_tree;	/* tree of not blocked struct lock, by id */
+
+static int lock_id_compare(const void *a, const void *b)
+{
+	int ai = ((const struct lock *) a)->id;
+	int bi = ((const struct lock *) b)->id;
+
+	return ai < bi ? -1 : ai > bi ? 1 : 0;
+}
+
+static void rem_nothing(void *node __attribute__((__unused__)))
+{
+}
+
 static pid_t get_blocker(int id, struct list_head *locks)
 {
-	struct list_head *p;
+	struct lock tmp = { .id = id }, **res;
 
-	list_for_each(p, locks) {
-		struct lock *l = list_entry(p, struct lock, locks);
+	if (!blockers_tree) {
+		struct list_head *p;
+
+		/* the first lock with the ID wins, the same as in the list */
+		list_for_each(p, locks) {
+			struct lock *l = list_entry(p, struct lock, locks);
 
-		if (l->id == id && !l->blocked)
-			return l->pid;
+			if (!l->blocked
+			    && !tsearch(l, &blockers_tree, lock_id_compare))
+				errx(EXIT_FAILURE, _("failed to allocate memory"));
+		}
 	}
 
-	return 0;
+	res = tfind(&tmp, &blockers_tree, lock_id_compare);
+	return res ? (*res)->pid : 0;
 }
 
 static void xstrcoholder(char **str, struct lock *l)
@@ -968,8 +1075,10 @@ int main(int argc, char *argv[])
 	if (!rc && !list_empty(&proc_locks))
 		rc = show_locks(&proc_locks, target_pid, &pid_locks);
 
+	tdestroy(blockers_tree, rem_nothing);
 	tdestroy(pid_locks, rem_tnode);
 	rem_locks(&proc_locks);
+	tdestroy(proc_files_tree, rem_proc_files);
 
 	mnt_unref_table(tab);
 	return rc;
@@ -25,6 +25,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <search.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/param.h>
@@ -70,10 +71,84 @@ struct namei {
 #endif
 };
 
+/*
+ * Cache of the resolved path components. Every node is one component of the
+ * path as used for lstat(), so the nodes for "/usr" and "/usr/bin" are
+ * shared by all the paths starting with "/usr/bin/". The paths are resolved
+ * only once per run.
+ */
+struct namei_node {
+	char		*name;
+	void		*children;	/* tsearch() tree of struct namei_node */
+
+	unsigned int	resolved : 1;
+	struct stat	st;
+	int		noent;
+	char		*abslink;
+	int		relstart;
+#ifdef HAVE_LIBSELINUX
+	int		context_len;
+	char		*context;
+#endif
+};
+
 static int flags;
 static struct idcache *gcache;	/* groupnames */
 static struct idcache *ucache;	/* usernames */
 
+static struct namei_node abs_root = { .name = "/" };	/* absolute paths */
+static struct namei_node rel_root = { .name = "" };	/* relative paths */
+
+static int cmp_node_names(const void *a, const void *b)
+{
+	return strcmp(((const struct namei_node *) a)->name,
+		      ((const struct namei_node *) b)->name);
+}
+
+static struct namei_node *
+get_node_child(struct namei_node *node, const char *name)
+{
+	struct namei_node key = { .name = (char *) name }, *child, **res;
+
+	res = tfind(&key, &node->children, cmp_node_names);
+	if (res)
+		return *res;
+
+	child = xcalloc(1, sizeof(*child));
+	child->name = xstrdup(name);
+	if (!tsearch(child, &node->children, cmp_node_names))
+		err(EXIT_FAILURE, _("failed to allocate memory"));
+	return child;
+}
+
+/* returns the node for the first @len bytes of @path */
+static struct namei_node *
+get_node(const char *path, size_t len)
+{
+	struct namei_node *node = *path == '/' ? &abs_root : &rel_root;
+	char *buf = xstrndup(path, len), *tok, *save = NULL;
+
+	for (tok = strtok_r(buf, "/", &save); tok; tok = strtok_r(NULL, "/", &save))
+		node = get_node_child(node, tok);
+	free(buf);
+	return node;
+}
+
+static void free_node(void *data)
+{
+	struct namei_node *node = data;
+
+	tdestroy(node->children, free_node);
+	free(node->abslink);
+#ifdef HAVE_LIBSELINUX
+	freecon(node->context);
+#endif
+	if (node != &abs_root && node != &rel_root) {
+		free(node->name);
+		free(node);
+	}
+}
+
 static void
 free_namei(struct namei *nm)
 {
@@ -90,7 +165,7 @@ free_namei(struct namei *nm)
 }
 
 static void
-readlink_to_namei(struct namei *nm, const char *path)
+readlink_to_node(struct namei_node *nm, const char *path)
 {
 	char sym[PATH_MAX];
 	ssize_t sz;
@@ -148,8 +223,26 @@ dotdot_stat(const char *dirname, struct stat *st)
 	return st;
 }
 
+static void
+resolve_node(struct namei_node *node, const char *path)
+{
+	node->resolved = 1;
+#ifdef HAVE_LIBSELINUX
+	/* Don't use is_selinux_enabled() here. We need info about a context
+	 * also on systems where SELinux is (temporary) disabled */
+	node->context_len = lgetfilecon(path, &node->context);
+#endif
+	if (lstat(path, &node->st) != 0) {
+		node->noent = errno;
+		return;
+	}
+	if (S_ISLNK(node->st.st_mode))
+		readlink_to_node(node, path);
+}
+
 static struct namei *
-new_namei(struct namei *parent, const char *path, const char *fname, int lev)
+new_namei(struct namei *parent, const char *path, const char *fname, int lev,
+	  struct namei_node *node)
 {
 	struct namei *nm;
 
@@ -162,18 +255,22 @@ new_namei(struct namei *parent, const char *path, const char *fname, int lev)
 	nm->level = lev;
 	nm->name = xstrdup(fname);
 
+	if (!node->resolved)
+		resolve_node(node, path);
 #ifdef HAVE_LIBSELINUX
-	/* Don't use is_selinux_enabled() here. We need info about a context
-	 * also on systems where SELinux is (temporary) disabled */
-	nm->context_len = lgetfilecon(path, &nm->context);
+	nm->context_len = node->context_len;
+	if (node->context)
+		nm->context = xstrdup(node->context);
 #endif
-	if (lstat(path, &nm->st) != 0) {
-		nm->noent = errno;
+	if (node->noent) {
+		nm->noent = node->noent;
 		return nm;
 	}
-
-	if (S_ISLNK(nm->st.st_mode))
-		readlink_to_namei(nm, path);
+	nm->st = node->st;
+	if (node->abslink) {
+		nm->abslink = xstrdup(node->abslink);
+		nm->relstart = node->relstart;
+	}
 	if (flags & NAMEI_OWNERS) {
 		add_uid(ucache, nm->st.st_uid);
 		add_gid(gcache, nm->st.st_gid);
@@ -199,6 +296,7 @@ static struct namei *
 add_namei(struct namei *parent, const char *orgpath, int start, struct namei **last)
 {
 	struct namei *nm = NULL, *first = NULL;
+	struct namei_node *node;
 	char *fname, *end, *path;
 	int level = 0;
 
@@ -210,12 +308,14 @@ add_namei(struct namei *parent, const char *orgpath, int start, struct namei **l
 	}
 	path = xstrdup(orgpath);
 	fname = path + start;
+	node = get_node(path, start);
 
 	/* root directory */
 	if (*fname == '/') {
 		while (*fname == '/')
 			fname++; /* eat extra '/' */
-		first = nm = new_namei(nm, "/", "/", level);
+		first = nm = new_namei(nm, "/", "/", level, &abs_root);
+		node = &abs_root;
 	}
 
 	for (end = fname; fname && end; ) {
@@ -226,7 +326,8 @@ add_namei(struct namei *parent, const char *orgpath, int start, struct namei **l
 				*end = '\0';
 
 			/* create a new entry */
-			nm = new_namei(nm, path, fname, level);
+			node = get_node_child(node, fname);
+			nm = new_namei(nm, path, fname, level, node);
 		} else
 			end = NULL;
 		if (!first)
@@ -346,6 +447,65 @@ print_namei(struct namei *nm, char *path)
 	return 0;
 }
 
+static int
+namei_path(char *path)
+{
+	struct namei *nm = NULL;
+	struct stat st;
+	int rc = EXIT_SUCCESS;
+
+	if (stat(path, &st) != 0)
+		rc = EXIT_FAILURE;
+
+	nm = add_namei(NULL, path, 0, NULL);
+	if (nm) {
+		int sml = 0;
+		if (!(flags & NAMEI_NOLINKS))
+			sml = follow_symlinks(nm);
+		if (print_namei(nm, path)) {
+			free_namei(nm);
+			return EXIT_FAILURE;
+		}
+		free_namei(nm);
+		if (sml == -1) {
+			warnx(_("%s: exceeded limit of symlinks"), path);
+			return EXIT_FAILURE;
+		}
+	}
+	return rc;
+}
+
+/* reads pathnames from @fname, one per line */
+static int
+namei_file(const char *fname)
+{
+	FILE *f = stdin;
+	char *line = NULL;
+	size_t sz = 0;
+	ssize_t len;
+	int rc = EXIT_SUCCESS;
+
+	if (strcmp(fname, "-") != 0) {
+		f = fopen(fname, "r");
+		if (!f)
+			err(EXIT_FAILURE, _("cannot open %s"), fname);
+	}
+
+	while ((len = getline(&line, &sz, f)) != -1) {
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (!len)
+			continue;
+		if (namei_path(line) != EXIT_SUCCESS)
+			rc = EXIT_FAILURE;
+	}
+
+	free(line);
+	if (f != stdin)
+		fclose(f);
+	return rc;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	const char *p = program_invocation_short_name;
@@ -357,6 +517,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_HEADER, out);
 	fprintf(out,
 	      _(" %s [options] <pathname>...\n"), p);
+	fprintf(out,
+	      _(" %s [options] --file <file>\n"), p);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Follow a pathname until a terminal point is found.\n"), out);
@@ -368,7 +530,8 @@ static void __attribute__((__noreturn__)) usage(void)
 		" -o, --owners        show owner and group name of each file\n"
 		" -l, --long          use a long listing format (-m -o -v) \n"
 		" -n, --nosymlinks    don't follow symlinks\n"
-		" -v, --vertical      vertical align of modes and owners\n"), out);
+		" -v, --vertical      vertical align of modes and owners\n"
+		" -f, --file <file>   read pathnames from file, one per line ('-' for stdin)\n"), out);
 #ifdef HAVE_LIBSELINUX
 	fputs(_( " -Z, --context       print any security context of each file \n"), out);
 #endif
@@ -389,6 +552,7 @@ static const struct option longopts[] =
 	{ "long",        no_argument, NULL, 'l' },
 	{ "nolinks",	 no_argument, NULL, 'n' },
 	{ "vertical",    no_argument, NULL, 'v' },
+	{ "file",        required_argument, NULL, 'f' },
 #ifdef HAVE_LIBSELINUX
 	{ "context",	 no_argument, NULL, 'Z' },
 #endif
@@ -404,7 +568,8 @@ main(int argc, char **argv)
 #ifdef HAVE_LIBSELINUX
 		"Z"
 #endif
-		"hVlmnovx";
+		"f:hVlmnovx";
+	const char *fname = NULL;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -431,6 +596,9 @@ main(int argc, char **argv)
 		case 'v':
 			flags |= NAMEI_VERTICAL;
 			break;
+		case 'f':
+			fname = optarg;
+			break;
 #ifdef HAVE_LIBSELINUX
 		case 'Z':
 			flags |= NAMEI_CONTEXT;
@@ -445,7 +613,7 @@ main(int argc, char **argv)
 		}
 	}
 
-	if (optind == argc) {
+	if (optind == argc && !fname) {
 		warnx(_("pathname argument is missing"));
 		errtryhelp(EXIT_FAILURE);
 	}
@@ -458,31 +626,14 @@ main(int argc, char **argv)
 		err(EXIT_FAILURE, _("failed to allocate GID cache"));
 
 	for(; optind < argc; optind++) {
-		char *path = argv[optind];
-		struct namei *nm = NULL;
-		struct stat st;
-
-		if (stat(path, &st) != 0)
+		if (namei_path(argv[optind]) != EXIT_SUCCESS)
 			rc = EXIT_FAILURE;
-
-		nm = add_namei(NULL, path, 0, NULL);
-		if (nm) {
-			int sml = 0;
-			if (!(flags & NAMEI_NOLINKS))
-				sml = follow_symlinks(nm);
-			if (print_namei(nm, path)) {
-				rc = EXIT_FAILURE;
-				continue;
-			}
-			free_namei(nm);
-			if (sml == -1) {
-				rc = EXIT_FAILURE;
-				warnx(_("%s: exceeded limit of symlinks"), path);
-				continue;
-			}
-		}
 	}
+	if (fname && namei_file(fname) != EXIT_SUCCESS)
+		rc = EXIT_FAILURE;
 
+	free_node(&rel_root);
+	free_node(&abs_root);
 	free_idcache(ucache);
 	free_idcache(gcache);
 
@@ -33,6 +33,9 @@ for i in $@; do N=`echo "$i" | sed "s/$FROM/$TO/g"`; mv "$i" "$N"; done
 #include <termios.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifndef HAVE_RENAMEAT2
+# include <sys/syscall.h>
+#endif
 
 #include "nls.h"
 #include "xalloc.h"
@@ -40,6 +43,26 @@ for i in $@; do N=`echo "$i" | sed "s/$FROM/$TO/g"`; mv "$i" "$N"; done
 #include "closestream.h"
 #include "optutils.h"
 #include "rpmatch.h"
+#include "strutils.h"
+#include "jsonwrt.h"
+#include "walkdir.h"
+
+#ifndef RENAME_NOREPLACE
+# define RENAME_NOREPLACE (1 << 0)
+#endif
+
+#if !defined(HAVE_RENAMEAT2)
+static inline int renameat2(int olddirfd, const char *oldpath,
+			    int newdirfd, const char *newpath, unsigned int flags)
+{
+# ifdef SYS_renameat2
+	return syscall (SYS_renameat2, olddirfd, oldpath, newdirfd, newpath, flags);
+# else
+	errno = ENOSYS;
+	return -1;
+# endif
+}
+#endif
 
 #define RENAME_EXIT_SOMEOK	2
 #define RENAME_EXIT_NOTHING	4
@@ -49,6 +72,45 @@ static int tty_cbreak = 0;
 static int all = 0;
 static int last = 0;
 
+/* --json */
+static struct ul_jsonwrt json;
+static int use_json = 0;
+
+/*
+ * --recursive
+ *
+ * The tree is walked first and the entries to rename are collected per
+ * directory. The directories are then processed in the reverse order of the
+ * walk, so the contents of a directory are always renamed before the
+ * directory itself and the paths of the remaining directories are still
+ * valid. Every directory is opened only once and its entries are renamed
+ * relative to the directory file descriptor.
+ */
+struct rename_entry {
+	char	*name;
+	char	*newname;		/* NULL for --symlink */
+};
+
+struct rename_dir {
+	char			*path;
+	struct rename_entry	*ents;
+	size_t			nents;
+};
+
+struct rename_plan {
+	struct rename_dir	*dirs;		/* in the order of the walk */
+	size_t			ndirs;
+
+	size_t			*levels;	/* index of the current dir per level */
+	size_t			nlevels;
+
+	int			symlinks;	/* --symlink */
+	int			errors;
+};
+
+static struct rename_plan plan;
+static char *plan_from, *plan_to;
+
 /* Find the first place in `orig` where we'll perform a replacement. NULL if
    there are no replacements to do. */
 static char *find_initial_replace(char *from, char *to, char *orig)
@@ -106,6 +168,22 @@ static int string_replace(char *from, char *to, char *orig, char **newname)
 	return 0;
 }
 
+static void report_rename(const char *path, const char *target,
+			  const char *newname)
+{
+	if (use_json) {
+		ul_jsonwrt_object_open(&json, NULL);
+		ul_jsonwrt_value_s(&json, "path", path);
+		if (target)
+			ul_jsonwrt_value_s(&json, "target", target);
+		ul_jsonwrt_value_s(&json, "new", newname);
+		ul_jsonwrt_object_close(&json);
+	} else if (target)
+		printf("%s: `%s' -> `%s'\n", path, target, newname);
+	else
+		printf("`%s' -> `%s'\n", path, newname);
+}
+
 static int ask(char *name)
 {
 	int c;
@@ -183,7 +261,7 @@ static int do_symlink(char *from, char *to, char *s, int verbose, int noact,
 	if ( ret == 1 &&
 	     (nooverwrite || (interactive && (noact || ask(newname) != 0))) )
 	{
-		if (verbose)
+		if (verbose && !use_json)
 			printf(_("Skipping existing link: `%s' -> `%s'\n"), s, target);
 		ret = 0;
 	}
@@ -198,8 +276,8 @@ static int do_symlink(char *from, char *to, char *s, int verbose, int noact,
 			ret = 2;
 		}
 	}
-	if (verbose && (noact || ret == 1))
-		printf("%s: `%s' -> `%s'\n", s, target, newname);
+	if ((verbose || use_json) && (noact || ret == 1))
+		report_rename(s, target, newname);
 	free(newname);
 	free(target);
 	return ret;
@@ -232,7 +310,7 @@ static int do_file(char *from, char *to, char *s, int verbose, int noact,
 		nooverwrite = interactive = 0;
 
 	if (nooverwrite || (interactive && (noact || ask(newname) != 0))) {
-		if (verbose)
+		if (verbose && !use_json)
 			printf(_("Skipping existing file: `%s'\n"), newname);
 		ret = 0;
 	}
@@ -240,9 +318,217 @@ static int do_file(char *from, char *to, char *s, int verbose, int noact,
 		warn(_("%s: rename to %s failed"), s, newname);
 		ret = 2;
 	}
-	if (verbose && (noact || ret == 1))
-		printf("`%s' -> `%s'\n", s, newname);
+	if ((verbose || use_json) && (noact || ret == 1))
+		report_rename(s, NULL, newname);
+	free(newname);
+	return ret;
+}
+
+static int plan_add_dir(const char *path)
+{
+	size_t idx = plan.ndirs;
+
+	if (plan.ndirs % 64 == 0)
+		plan.dirs = xreallocarray(plan.dirs, plan.ndirs + 64,
+					  sizeof(struct rename_dir));
+	plan.dirs[idx].path = xstrdup(path);
+	plan.dirs[idx].ents = NULL;
+	plan.dirs[idx].nents = 0;
+	plan.ndirs++;
+	return idx;
+}
+
+static void plan_add_entry(size_t idx, const char *name, char *newname)
+{
+	struct rename_dir *dir = &plan.dirs[idx];
+
+	if (dir->nents % 64 == 0)
+		dir->ents = xreallocarray(dir->ents, dir->nents + 64,
+					  sizeof(struct rename_entry));
+	dir->ents[dir->nents].name = xstrdup(name);
+	dir->ents[dir->nents].newname = newname;
+	dir->nents++;
+}
+
+static int plan_walk_cb(const char *fpath, const struct stat *sb __attribute__((__unused__)),
+			int type, struct FTW *ftw)
+{
+	char *newname = NULL;
+	const char *name = fpath + ftw->base;
+
+	if (type == FTW_DNR) {
+		warn(_("cannot read directory %s"), fpath);
+		plan.errors++;
+	}
+
+	if (ftw->level > 0) {
+		/* the entry belongs to the current directory on the upper level */
+		size_t idx = plan.levels[ftw->level - 1];
+
+		if (plan.symlinks) {
+			if (type == FTW_SL)
+				plan_add_entry(idx, name, NULL);
+		} else if (string_replace(plan_from, plan_to, (char *) name, &newname) == 0)
+			plan_add_entry(idx, name, newname);
+	}
+
+	if (type == FTW_D) {
+		if ((size_t) ftw->level >= plan.nlevels) {
+			plan.nlevels = ftw->level + 16;
+			plan.levels = xreallocarray(plan.levels, plan.nlevels,
+						    sizeof(size_t));
+		}
+		plan.levels[ftw->level] = plan_add_dir(fpath);
+	}
+	return 0;
+}
+
+static int rename_entry_at(int dfd, struct rename_dir *dir,
+			   struct rename_entry *ent, int verbose, int noact,
+			   int nooverwrite, int interactive)
+{
+	char *path = NULL, *newpath = NULL;
+	int ret = 1, exists = 0;
+
+	xasprintf(&path, "%s/%s", dir->path, ent->name);
+	xasprintf(&newpath, "%s/%s", dir->path, ent->newname);
+
+	if (nooverwrite || interactive || noact)
+		exists = faccessat(dfd, ent->newname, F_OK, AT_SYMLINK_NOFOLLOW) == 0;
+
+	if (exists && (nooverwrite || (interactive && (noact || ask(newpath) != 0)))) {
+		if (verbose && !use_json)
+			printf(_("Skipping existing file: `%s'\n"), newpath);
+		ret = 0;
+	} else if (!noact) {
+		/* --interactive already confirmed the overwrite */
+		unsigned int flags = nooverwrite ? RENAME_NOREPLACE : 0;
+		int rc = renameat2(dfd, ent->name, dfd, ent->newname, flags);
+
+		if (rc != 0 && flags && (errno == EINVAL || errno == ENOSYS)) {
+			/* RENAME_NOREPLACE not supported by kernel or filesystem */
+			if (faccessat(dfd, ent->newname, F_OK, AT_SYMLINK_NOFOLLOW) == 0)
+				errno = EEXIST;
+			else
+				rc = renameat(dfd, ent->name, dfd, ent->newname);
+		}
+		if (rc != 0 && errno == EEXIST && nooverwrite) {
+			if (verbose && !use_json)
+				printf(_("Skipping existing file: `%s'\n"), newpath);
+			ret = 0;
+		} else if (rc != 0) {
+			warn(_("%s: rename to %s failed"), path, newpath);
+			ret = 2;
+		}
+	}
+	if ((verbose || use_json) && (noact || ret == 1))
+		report_rename(path, NULL, newpath);
+	free(path);
+	free(newpath);
+	return ret;
+}
+
+static int symlink_entry_at(int dfd, struct rename_dir *dir,
+			    struct rename_entry *ent, int verbose, int noact,
+			    int nooverwrite, int interactive)
+{
+	char *path = NULL, *target = NULL, *newname = NULL;
+	struct stat sb;
+	ssize_t ssz;
+	int ret = 1;
+
+	xasprintf(&path, "%s/%s", dir->path, ent->name);
+
+	if (fstatat(dfd, ent->name, &sb, AT_SYMLINK_NOFOLLOW) != 0) {
+		warn(_("stat of %s failed"), path);
+		ret = 2;
+		goto done;
+	}
+	target = xmalloc(sb.st_size + 1);
+	ssz = readlinkat(dfd, ent->name, target, sb.st_size + 1);
+	if (ssz < 0) {
+		warn(_("%s: readlink failed"), path);
+		ret = 2;
+		goto done;
+	}
+	target[ssz] = '\0';
+
+	if (string_replace(plan_from, plan_to, target, &newname) != 0) {
+		ret = 0;
+		goto done;
+	}
+
+	/* relative targets are resolved in the directory of the link */
+	if ((nooverwrite || interactive)
+	    && fstatat(dfd, newname, &sb, AT_SYMLINK_NOFOLLOW) == 0
+	    && (nooverwrite || (interactive && (noact || ask(newname) != 0)))) {
+		if (verbose && !use_json)
+			printf(_("Skipping existing link: `%s' -> `%s'\n"), path, target);
+		ret = 0;
+		goto done;
+	}
+
+	if (!noact && unlinkat(dfd, ent->name, 0) != 0) {
+		warn(_("%s: unlink failed"), path);
+		ret = 2;
+	} else if (!noact && symlinkat(newname, dfd, ent->name) != 0) {
+		warn(_("%s: symlinking to %s failed"), path, newname);
+		ret = 2;
+	}
+	if ((verbose || use_json) && (noact || ret == 1))
+		report_rename(path, target, newname);
+done:
 	free(newname);
+	free(target);
+	free(path);
+	return ret;
+}
+
+static int do_recursive(char *path, size_t nthreads, int verbose, int noact,
+			int nooverwrite, int interactive)
+{
+	size_t i, j;
+	int ret = 0;
+
+	plan.errors = 0;
+	if (ul_walkdir(path, plan_walk_cb, 0, nthreads) != 0) {
+		warn(_("%s: not accessible"), path);
+		ret = 2;
+	}
+	if (plan.errors)
+		ret |= 2;
+
+	for (i = plan.ndirs; i > 0; i--) {
+		struct rename_dir *dir = &plan.dirs[i - 1];
+		int dfd = -1;
+
+		if (dir->nents) {
+			dfd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (dfd < 0) {
+				warn(_("cannot open directory %s"), dir->path);
+				ret |= 2;
+			}
+		}
+		for (j = 0; j < dir->nents; j++) {
+			struct rename_entry *ent = &dir->ents[j];
+
+			if (dfd >= 0)
+				ret |= plan.symlinks ?
+					symlink_entry_at(dfd, dir, ent, verbose,
+						noact, nooverwrite, interactive) :
+					rename_entry_at(dfd, dir, ent, verbose,
+						noact, nooverwrite, interactive);
+			free(ent->name);
+			free(ent->newname);
+		}
+		if (dfd >= 0)
+			close(dfd);
+		free(dir->ents);
+		free(dir->path);
+	}
+	free(plan.dirs);
+	plan.dirs = NULL;
+	plan.ndirs = 0;
 	return ret;
 }
 
@@ -265,6 +551,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -l, --last          replace only the last occurrence\n"), out);
 	fputs(_(" -o, --no-overwrite  don't overwrite existing files\n"), out);
 	fputs(_(" -i, --interactive   prompt before overwrite\n"), out);
+	fputs(_(" -r, --recursive     rename the contents of directories recursively\n"), out);
+	fputs(_("     --threads <num> number of threads to read directories with --recursive\n"), out);
+	fputs(_(" -J, --json          print the changes in JSON\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(21));
 	fprintf(out, USAGE_MAN_TAIL("rename(1)"));
@@ -275,10 +564,15 @@ int main(int argc, char **argv)
 {
 	char *from, *to;
 	int i, c, ret = 0, verbose = 0, noact = 0, nooverwrite = 0, interactive = 0;
+	int recursive = 0;
+	size_t nthreads = 1;
 	struct termios tio;
 	int (*do_rename)(char *from, char *to, char *s, int verbose, int noact,
 	                 int nooverwrite, int interactive) = do_file;
 
+	enum {
+		OPT_THREADS = CHAR_MAX + 1
+	};
 	static const struct option longopts[] = {
 		{"verbose", no_argument, NULL, 'v'},
 		{"version", no_argument, NULL, 'V'},
@@ -289,6 +583,9 @@ int main(int argc, char **argv)
 		{"no-overwrite", no_argument, NULL, 'o'},
 		{"interactive", no_argument, NULL, 'i'},
 		{"symlink", no_argument, NULL, 's'},
+		{"recursive", no_argument, NULL, 'r'},
+		{"threads", required_argument, NULL, OPT_THREADS},
+		{"json", no_argument, NULL, 'J'},
 		{NULL, 0, NULL, 0}
 	};
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
@@ -303,7 +600,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "vsVhnaloi", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "vsVhnaloirJ", longopts, NULL)) != -1) {
 		err_exclusive_options(c, longopts, excl, excl_st);
 		switch (c) {
 		case 'n':
@@ -327,6 +624,17 @@ int main(int argc, char **argv)
 		case 's':
 			do_rename = do_symlink;
 			break;
+		case 'r':
+			recursive = 1;
+			break;
+		case OPT_THREADS:
+			nthreads = strtou32_or_err(optarg, _("invalid threads argument"));
+			if (nthreads < 1)
+				errx(EXIT_FAILURE, _("invalid threads argument: %s"), optarg);
+			break;
+		case 'J':
+			use_json = 1;
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -359,8 +667,37 @@ int main(int argc, char **argv)
 			tty_cbreak = 1;
 	}
 
-	for (i = 2; i < argc; i++)
+	if (recursive) {
+		plan.symlinks = do_rename == do_symlink;
+		if (!plan.symlinks && (strchr(from, '/') || strchr(to, '/')))
+			errx(EXIT_FAILURE, _("--recursive cannot be used when "
+					     "expression or replacement contains '/'"));
+		plan_from = from;
+		plan_to = to;
+	}
+	if (use_json) {
+		ul_jsonwrt_init(&json, stdout, 0);
+		ul_jsonwrt_root_open(&json);
+		ul_jsonwrt_array_open(&json, "renames");
+	}
+
+	for (i = 2; i < argc; i++) {
+		struct stat st;
+
+		if (recursive && lstat(argv[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+			ret |= do_recursive(argv[i], nthreads, verbose, noact,
+					    nooverwrite, interactive);
+			if (plan.symlinks)
+				continue;
+		}
 		ret |= do_rename(from, to, argv[i], verbose, noact, nooverwrite, interactive);
+	}
+
+	if (use_json) {
+		ul_jsonwrt_array_close(&json);
+		ul_jsonwrt_root_close(&json);
+	}
+	free(plan.levels);
 
 	switch (ret) {
 	case 0:
@@ -22,20 +22,35 @@
  * to overwrite the built-in default then use:
  *
  *	make uuidd uuidgen runstatedir=/var/run
+ *
+ * With -b the UUIDs are not checked, but every UUID generation method is
+ * measured by the threads in one process, for example:
+ *
+ *	test_uuidd -b all -T 1,2,4,8 -o 100000
+ *
+ * prints UUIDs/sec and the latency percentiles of one call per method and
+ * number of threads in JSON.
  */
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/shm.h>
+#include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 
 #include "uuid.h"
+#include "uuidd.h"
+#include "all-io.h"
 #include "c.h"
 #include "xalloc.h"
 #include "strutils.h"
+#include "jsonwrt.h"
 #include "nls.h"
 
 #define LOG(level,args) if (loglev >= level) { fprintf args; }
@@ -44,6 +59,8 @@ static size_t nprocesses = 4;
 static size_t nthreads = 4;
 static size_t nobjects = 4096;
 static size_t loglev = 1;
+static size_t nbulk = 1000;
+static const char *socket_path = UUIDD_SOCKET_PATH;
 
 struct processentry {
 	pid_t		pid;
@@ -81,6 +98,11 @@ static void __attribute__((__noreturn__)) usage(void)
 	printf("  -t <num>     number of nthreads (default:%zu)\n", nthreads);
 	printf("  -o <num>     number of nobjects (default:%zu)\n", nobjects);
 	printf("  -l <level>   log level (default:%zu)\n", loglev);
+	printf("  -b <list>    benchmark the methods (all,random,random-bulk,time,clock,\n"
+	       "               uuidd,uuidd-bulk,v7,v7-bulk); -o is calls per thread\n");
+	printf("  -T <list>    benchmark with these numbers of threads (default: -t)\n");
+	printf("  -B <num>     UUIDs per bulk call (default:%zu)\n", nbulk);
+	printf("  -s <path>    uuidd socket (default:%s)\n", socket_path);
 	printf("  -h           display help\n");
 
 	exit(EXIT_SUCCESS);
@@ -264,14 +286,311 @@ static void object_dump(size_t idx, object_t *obj)
 	fprintf(stderr, "}\n");
 }
 
+/*
+ * Benchmark
+ */
+struct bench_thread {
+	pthread_t		tid;
+	const struct bench_method *method;
+	pthread_barrier_t	*barrier;
+	uuid_t			*buf;		/* nbulk UUIDs, at least two */
+	uint64_t		*lat;		/* latency of every call in ns */
+	uint64_t		start, end;	/* ns */
+	size_t			nuuids;
+	size_t			nerrors;
+};
+
+struct bench_method {
+	const char	*name;
+	/* one call, returns number of UUIDs or -1 */
+	int		(*call)(struct bench_thread *bt);
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int call_random(struct bench_thread *bt)
+{
+	uuid_generate_random(bt->buf[0]);
+	return 1;
+}
+
+static int call_random_bulk(struct bench_thread *bt)
+{
+	uuid_generate_random_bulk(bt->buf, nbulk);
+	return nbulk;
+}
+
+/* libuuid time-based UUIDs, from ring, uuidd or clock file ranges */
+static int call_time(struct bench_thread *bt)
+{
+	uuid_generate_time(bt->buf[0]);
+	return 1;
+}
+
+/* clock file only, one flock() per UUID */
+static int call_clock(struct bench_thread *bt)
+{
+	return __uuid_generate_time(bt->buf[0], NULL) < 0 ? -1 : 1;
+}
+
+static int call_v7(struct bench_thread *bt)
+{
+	uuid_generate_time_v7(bt->buf[0]);
+	return 1;
+}
+
+static int call_v7_bulk(struct bench_thread *bt)
+{
+	uuid_generate_time_v7_bulk(bt->buf, nbulk);
+	return nbulk;
+}
+
+/* one uuidd request on a new connection, as libuuid does */
+static int call_uuidd_op(struct bench_thread *bt, char op, int32_t num)
+{
+	char buf[sizeof(op) + sizeof(num)];
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int32_t reply_len = 0;
+	int s, rc = -1;
+
+	s = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (s < 0)
+		return -1;
+	if (strlen(socket_path) >= sizeof(addr.sun_path))
+		goto done;
+	xstrncpy(addr.sun_path, socket_path, sizeof(addr.sun_path));
+	if (connect(s, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+		goto done;
+
+	buf[0] = op;
+	memcpy(buf + 1, &num, sizeof(num));
+	if (write_all(s, buf, op == UUIDD_OP_BULK_TIME_UUID ? sizeof(buf) : 1) < 0)
+		goto done;
+	if (read_all(s, (char *) &reply_len, sizeof(reply_len)) != sizeof(reply_len)
+	    || reply_len < (int32_t) sizeof(uuid_t)
+	    || (size_t) reply_len > sizeof(uuid_t) + sizeof(num))
+		goto done;
+	if (read_all(s, (char *) bt->buf, reply_len) != reply_len)
+		goto done;
+
+	rc = 1;
+	if (op == UUIDD_OP_BULK_TIME_UUID)
+		memcpy(&rc, (char *) bt->buf + sizeof(uuid_t), sizeof(rc));
+done:
+	close(s);
+	return rc;
+}
+
+static int call_uuidd(struct bench_thread *bt)
+{
+	return call_uuidd_op(bt, UUIDD_OP_TIME_UUID, 0);
+}
+
+static int call_uuidd_bulk(struct bench_thread *bt)
+{
+	return call_uuidd_op(bt, UUIDD_OP_BULK_TIME_UUID, nbulk);
+}
+
+static const struct bench_method bench_methods[] = {
+	{ "random",	 call_random },
+	{ "random-bulk", call_random_bulk },
+	{ "time",	 call_time },
+	{ "clock",	 call_clock },
+	{ "uuidd",	 call_uuidd },
+	{ "uuidd-bulk",	 call_uuidd_bulk },
+	{ "v7",		 call_v7 },
+	{ "v7-bulk",	 call_v7_bulk }
+};
+
+static void *bench_body(void *arg)
+{
+	struct bench_thread *bt = arg;
+	size_t i;
+
+	pthread_barrier_wait(bt->barrier);
+	bt->start = now_ns();
+
+	for (i = 0; i < nobjects; i++) {
+		uint64_t t = now_ns();
+		int n = bt->method->call(bt);
+		uint64_t e = now_ns();
+
+		bt->lat[i] = e - t;
+		if (n < 0)
+			bt->nerrors++;
+		else
+			bt->nuuids += n;
+	}
+	bt->end = now_ns();
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void bench_run(struct ul_jsonwrt *json, const struct bench_method *m,
+		      size_t nthr, uint64_t *lat)
+{
+	struct bench_thread *bts = xcalloc(nthr, sizeof(*bts));
+	pthread_barrier_t barrier;
+	uint64_t start = UINT64_MAX, end = 0;
+	size_t i, ncalls = 0, nuuids = 0, nerrors = 0;
+	double secs;
+
+	pthread_barrier_init(&barrier, NULL, nthr);
+
+	for (i = 0; i < nthr; i++) {
+		struct bench_thread *bt = &bts[i];
+
+		bt->method = m;
+		bt->barrier = &barrier;
+		/* the uuidd reply is one UUID and the number of UUIDs */
+		bt->buf = xcalloc(max(nbulk, (size_t) 2), sizeof(uuid_t));
+		bt->lat = lat + i * nobjects;
+		if (pthread_create(&bt->tid, NULL, bench_body, bt) != 0)
+			err(EXIT_FAILURE, "pthread_create failed");
+	}
+	for (i = 0; i < nthr; i++) {
+		struct bench_thread *bt = &bts[i];
+
+		pthread_join(bt->tid, NULL);
+		start = min(start, bt->start);
+		end = max(end, bt->end);
+		nuuids += bt->nuuids;
+		nerrors += bt->nerrors;
+		ncalls += nobjects;
+		free(bt->buf);
+	}
+	pthread_barrier_destroy(&barrier);
+	free(bts);
+
+	qsort(lat, ncalls, sizeof(*lat), cmp_u64);
+	secs = end > start ? (end - start) / 1E9 : 0;
+
+	ul_jsonwrt_object_open(json, NULL);
+	ul_jsonwrt_value_s(json, "method", m->name);
+	ul_jsonwrt_value_u64(json, "threads", nthr);
+	ul_jsonwrt_value_u64(json, "calls", ncalls);
+	ul_jsonwrt_value_u64(json, "uuids", nuuids);
+	ul_jsonwrt_value_u64(json, "errors", nerrors);
+	ul_jsonwrt_value_double(json, "seconds", secs);
+	ul_jsonwrt_value_double(json, "uuids_per_sec", secs ? nuuids / secs : 0);
+	ul_jsonwrt_object_open(json, "latency_ns");
+	ul_jsonwrt_value_u64(json, "min", lat[0]);
+	ul_jsonwrt_value_u64(json, "p50", lat[ncalls / 2]);
+	ul_jsonwrt_value_u64(json, "p90", lat[ncalls * 90 / 100]);
+	ul_jsonwrt_value_u64(json, "p99", lat[ncalls * 99 / 100]);
+	ul_jsonwrt_value_u64(json, "p999", lat[ncalls * 999 / 1000]);
+	ul_jsonwrt_value_u64(json, "max", lat[ncalls - 1]);
+	ul_jsonwrt_object_close(json);
+	ul_jsonwrt_object_close(json);
+
+	if (nerrors)
+		warnx("%s: %zu of %zu calls failed", m->name, nerrors, ncalls);
+}
+
+static const struct bench_method *bench_method(const char *name, size_t namesz)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(bench_methods); i++) {
+		if (strncmp(name, bench_methods[i].name, namesz) == 0
+		    && !bench_methods[i].name[namesz])
+			return &bench_methods[i];
+	}
+	errx(EXIT_FAILURE, "unknown method: %.*s", (int) namesz, name);
+}
+
+static size_t parse_list(const char *list, size_t **threads)
+{
+	size_t n = 0;
+	char *str = xstrdup(list), *p, *save = NULL;
+
+	*threads = NULL;
+	for (p = strtok_r(str, ",", &save); p; p = strtok_r(NULL, ",", &save)) {
+		*threads = xreallocarray(*threads, n + 1, sizeof(size_t));
+		(*threads)[n] = strtou32_or_err(p, "invalid threads number argument");
+		if (!(*threads)[n])
+			errx(EXIT_FAILURE, "invalid threads number argument: %s", p);
+		n++;
+	}
+	free(str);
+	return n;
+}
+
+static int benchmark(const char *methods, const char *threadlist)
+{
+	struct ul_jsonwrt json;
+	size_t *threads, nthr, maxthr = 0, i;
+	uint64_t *lat;
+	const char *p;
+
+	if (threadlist)
+		nthr = parse_list(threadlist, &threads);
+	else {
+		threads = xmalloc(sizeof(size_t));
+		threads[0] = nthreads;
+		nthr = 1;
+	}
+	for (i = 0; i < nthr; i++)
+		maxthr = max(maxthr, threads[i]);
+	if (!nobjects || !nbulk || !nthr)
+		errx(EXIT_FAILURE, "nothing to measure");
+
+	lat = xcalloc(maxthr * nobjects, sizeof(*lat));
+
+	ul_jsonwrt_init(&json, stdout, 0);
+	ul_jsonwrt_root_open(&json);
+	ul_jsonwrt_array_open(&json, "benchmark");
+
+	for (p = methods; p && *p; ) {
+		size_t sz = strcspn(p, ",");
+
+		if (sz == 3 && strncmp(p, "all", 3) == 0) {
+			for (i = 0; i < ARRAY_SIZE(bench_methods); i++) {
+				size_t t;
+
+				for (t = 0; t < nthr; t++)
+					bench_run(&json, &bench_methods[i], threads[t], lat);
+			}
+		} else {
+			const struct bench_method *m = bench_method(p, sz);
+
+			for (i = 0; i < nthr; i++)
+				bench_run(&json, m, threads[i], lat);
+		}
+		p += sz;
+		if (*p == ',')
+			p++;
+	}
+
+	ul_jsonwrt_array_close(&json);
+	ul_jsonwrt_root_close(&json);
+
+	free(lat);
+	free(threads);
+	return EXIT_SUCCESS;
+}
+
 #define MSG_TRY_HELP "Try '-h' for help."
 
 int main(int argc, char *argv[])
 {
 	size_t i, nfailed = 0, nignored = 0;
+	const char *methods = NULL, *threadlist = NULL;
 	int c;
 
-	while (((c = getopt(argc, argv, "p:t:o:l:h")) != -1)) {
+	while (((c = getopt(argc, argv, "p:t:o:l:b:T:B:s:h")) != -1)) {
 		switch (c) {
 		case 'p':
 			nprocesses = strtou32_or_err(optarg, "invalid nprocesses number argument");
@@ -285,6 +604,18 @@ int main(int argc, char *argv[])
 		case 'l':
 			loglev = strtou32_or_err(optarg, "invalid log level argument");
 			break;
+		case 'b':
+			methods = optarg;
+			break;
+		case 'T':
+			threadlist = optarg;
+			break;
+		case 'B':
+			nbulk = strtou32_or_err(optarg, "invalid bulk number argument");
+			break;
+		case 's':
+			socket_path = optarg;
+			break;
 		case 'h':
 			usage();
 			break;
@@ -297,6 +628,9 @@ int main(int argc, char *argv[])
 	if (optind != argc)
 		errx(EXIT_FAILURE, "bad usage\n" MSG_TRY_HELP);
 
+	if (methods)
+		return benchmark(methods, threadlist);
+
 	if (loglev == 1)
 		fprintf(stderr, "requested: %zu processes, %zu threads, %zu objects per thread (%zu objects = %zu bytes)\n",
 				nprocesses, nthreads, nobjects,
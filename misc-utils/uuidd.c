@@ -18,7 +18,7 @@
  * Server:
  * | reply length (4 bytes) | uuid reply (16 bytes) |
  *   or
- * | reply length (4 bytes) | uuid reply (16 bytes) multiply by number when random bulk request |
+ * | reply length (4 bytes) | number (4 bytes) | uuid reply (16 bytes) multiply by number when random or v7 bulk request |
  *   or
  * | reply length (4 bytes) | uuid reply (16 bytes) | number (4 bytes) time bulk |
  *   or
@@ -40,7 +40,11 @@
 #include <string.h>
 #include <getopt.h>
 #include <sys/signalfd.h>
-#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #include "uuid.h"
 #include "uuidd.h"
@@ -49,6 +53,7 @@
 #include "closestream.h"
 #include "strutils.h"
 #include "optutils.h"
+#include "list.h"
 #include "monotonic.h"
 #include "timer.h"
 
@@ -67,12 +72,30 @@ enum {
 	UUIDD_PROT_BUFSZ = ((sizeof(uuidd_prot_num_t)) + (sizeof(uuid_t) * 63))
 };
 
+/* number of events read by one epoll_wait() */
+#define UUIDD_MAX_EVENTS	64
+
+/* a client has to send the request and read the reply within this time */
+#define UUIDD_CLIENT_TIMEOUT	5	/* seconds */
+
+/* per-operation counters, printed on SIGUSR1 */
+struct uuidd_opstat {
+	uint64_t	nreqs;		/* number of replied requests */
+	uint64_t	nuuids;		/* number of generated UUIDs */
+	uint64_t	usec;		/* sum of the request latencies */
+	uint64_t	usec_max;	/* the slowest request */
+};
+
 /* server loop control structure */
 struct uuidd_cxt_t {
 	const char	*cleanup_pidfile;
 	const char	*cleanup_socket;
 	uint32_t	timeout;
 	uint32_t	cont_clock_offset;
+	size_t		njobs;		/* random UUIDs worker threads */
+
+	struct timeval		started;
+	struct uuidd_opstat	stats[UUIDD_MAX_OP + 1];
 
 	unsigned int	debug: 1,
 			quiet: 1,
@@ -104,12 +127,14 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -k, --kill              kill running daemon\n"), out);
 	fputs(_(" -r, --random            test random-based generation\n"), out);
 	fputs(_(" -t, --time              test time-based generation\n"), out);
+	fputs(_(" -7, --time-v7           test time-ordered v7 generation\n"), out);
 	fputs(_(" -n, --uuids <num>       request number of uuids\n"), out);
 	fputs(_(" -P, --no-pid            do not create pid file\n"), out);
 	fputs(_(" -F, --no-fork           do not daemonize using double-fork\n"), out);
 	fputs(_(" -S, --socket-activation do not create listening socket\n"), out);
 	fputs(_(" -C, --cont-clock[=<NUM>[hd]]\n"), out);
 	fputs(_("                         activate continuous clock handling\n"), out);
+	fputs(_(" -j, --jobs <num>        generate random UUIDs by <num> threads\n"), out);
 	fputs(_(" -d, --debug             run in debugging mode\n"), out);
 	fputs(_(" -q, --quiet             turn on quiet mode\n"), out);
 	fputs(USAGE_SEPARATOR, out);
@@ -141,7 +166,8 @@ static int call_daemon(const char *socket_path, uuidd_prot_op_t op, char *buf,
 	struct sockaddr_un srv_addr;
 
 	if (((op == UUIDD_OP_BULK_TIME_UUID) ||
-	     (op == UUIDD_OP_BULK_RANDOM_UUID)) && !num) {
+	     (op == UUIDD_OP_BULK_RANDOM_UUID) ||
+	     (op == UUIDD_OP_BULK_TIME_V7_UUID)) && !num) {
 		if (err_context)
 			*err_context = _("bad arguments");
 		errno = EINVAL;
@@ -166,14 +192,16 @@ static int call_daemon(const char *socket_path, uuidd_prot_op_t op, char *buf,
 		return -1;
 	}
 
-	if (op == UUIDD_OP_BULK_RANDOM_UUID) {
+	if ((op == UUIDD_OP_BULK_RANDOM_UUID) ||
+	    (op == UUIDD_OP_BULK_TIME_V7_UUID)) {
 		if ((buflen - sizeof(*num)) < (size_t)((*num) * sizeof(uuid_t)))
 			*num = (buflen - sizeof(*num)) / sizeof(uuid_t);
 	}
 	op_buf[0] = op;
 	op_len = sizeof(op);
 	if ((op == UUIDD_OP_BULK_TIME_UUID) ||
-	    (op == UUIDD_OP_BULK_RANDOM_UUID)) {
+	    (op == UUIDD_OP_BULK_RANDOM_UUID) ||
+	    (op == UUIDD_OP_BULK_TIME_V7_UUID)) {
 		memcpy(op_buf + sizeof(op), num, sizeof(*num));
 		op_len += sizeof(*num);
 	}
@@ -207,7 +235,8 @@ static int call_daemon(const char *socket_path, uuidd_prot_op_t op, char *buf,
 		else
 			*num = -1;
 	}
-	if ((ret > 0) && (op == UUIDD_OP_BULK_RANDOM_UUID)) {
+	if ((ret > 0) && ((op == UUIDD_OP_BULK_RANDOM_UUID) ||
+			  (op == UUIDD_OP_BULK_TIME_V7_UUID))) {
 		if (sizeof(*num) <= (size_t) reply_len)
 			memcpy(buf, num, sizeof(*num));
 		else
@@ -314,6 +343,41 @@ static void __attribute__((__noreturn__)) all_done(const struct uuidd_cxt_t *uui
 	exit(ret);
 }
 
+static const char *const opnames[] = {
+	[UUIDD_OP_GETPID]		= "getpid",
+	[UUIDD_OP_GET_MAXOP]		= "get-maxop",
+	[UUIDD_OP_TIME_UUID]		= "time",
+	[UUIDD_OP_RANDOM_UUID]		= "random",
+	[UUIDD_OP_BULK_TIME_UUID]	= "bulk-time",
+	[UUIDD_OP_BULK_RANDOM_UUID]	= "bulk-random",
+	[UUIDD_OP_BULK_TIME_V7_UUID]	= "bulk-time-v7"
+};
+
+static void print_stats(const struct uuidd_cxt_t *uuidd_cxt)
+{
+	struct timeval now;
+	uint64_t uptime;
+	size_t i;
+
+	gettime_monotonic(&now);
+	timersub(&now, &uuidd_cxt->started, &now);
+	uptime = (uint64_t) now.tv_sec * 1000000 + now.tv_usec;
+
+	fprintf(stderr, _("uptime %"PRIu64" sec\n"), uptime / 1000000);
+	for (i = 0; i < ARRAY_SIZE(uuidd_cxt->stats); i++) {
+		const struct uuidd_opstat *st = &uuidd_cxt->stats[i];
+
+		if (!st->nreqs)
+			continue;
+		fprintf(stderr, _("%-12s %"PRIu64" requests, %"PRIu64" UUIDs, "
+				  "%"PRIu64" UUIDs/sec, latency avg %"PRIu64
+				  " max %"PRIu64" usec\n"),
+			opnames[i], st->nreqs, st->nuuids,
+			uptime ? st->nuuids * 1000000 / uptime : 0,
+			st->usec / st->nreqs, st->usec_max);
+	}
+}
+
 static void handle_signal(const struct uuidd_cxt_t *uuidd_cxt, int fd)
 {
 	struct signalfd_siginfo info;
@@ -328,6 +392,10 @@ static void handle_signal(const struct uuidd_cxt_t *uuidd_cxt, int fd)
 	}
 	if (info.ssi_signo == SIGPIPE)
 		return;		/* ignored */
+	if (info.ssi_signo == SIGUSR1) {
+		print_stats(uuidd_cxt);
+		return;
+	}
 	all_done(uuidd_cxt, EXIT_SUCCESS);
 }
 
@@ -341,28 +409,471 @@ static void timeout_handler(int sig __attribute__((__unused__)),
 		errx(EXIT_FAILURE, _("timed out"));
 }
 
+/*
+ * The server is single-threaded except the optional random UUIDs workers. All
+ * sockets are non-blocking and served from one epoll loop, so a slow client
+ * does not delay the others. The time-based UUIDs are always generated by the
+ * main thread to keep the clock state in one place.
+ */
+struct uuidd_client {
+	struct list_head	clients;	/* server clients, the oldest first */
+	struct list_head	jobs;		/* worker queue */
+	int			fd;
+	struct timeval		start;		/* when accepted */
+
+	uuidd_prot_op_t		op;
+	uuidd_prot_num_t	num;		/* requested, later generated UUIDs */
+	char			in[sizeof(uuidd_prot_op_t) + sizeof(uuidd_prot_num_t)];
+	size_t			in_len;
+
+	char			out[sizeof(int32_t) + UUIDD_PROT_BUFSZ];
+	size_t			out_len;
+	size_t			out_pos;
+
+	unsigned int		queued : 1,	/* owned by a worker */
+				pollout : 1;	/* waits for EPOLLOUT */
+};
+
+struct uuidd_server {
+	struct uuidd_cxt_t	*cxt;
+	int			epfd;
+	int			sock;		/* listening socket */
+	int			sigfd;
+	struct list_head	clients;
+
+#ifdef HAVE_PTHREAD
+	int			evfd;		/* workers have done some jobs */
+	size_t			nthreads;
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+	struct list_head	jobs;		/* requests for the workers */
+	struct list_head	done;		/* replies from the workers */
+#endif
+};
+
+static inline int is_bulk_op(uuidd_prot_op_t op)
+{
+	return op == UUIDD_OP_BULK_TIME_UUID || op == UUIDD_OP_BULK_RANDOM_UUID
+	       || op == UUIDD_OP_BULK_TIME_V7_UUID;
+}
+
+static inline int is_random_op(uuidd_prot_op_t op)
+{
+	return op == UUIDD_OP_RANDOM_UUID || op == UUIDD_OP_BULK_RANDOM_UUID;
+}
+
+/*
+ * Generates reply for the request in @cl to @cl->out; @cl->num is set to the
+ * number of generated UUIDs. Only the random-based operations may be called
+ * from the workers.
+ *
+ * Returns: 0 on success, -1 on invalid operation.
+ */
+static int generate_reply(const struct uuidd_cxt_t *uuidd_cxt, struct uuidd_client *cl)
+{
+	char		*reply_buf = cl->out + sizeof(int32_t), *cp;
+	int32_t		reply_len = 0;
+	uuid_t		uu;
+	char		str[UUID_STR_LEN];
+	int		i, ret;
+	uuidd_prot_num_t num = cl->num;
+
+	switch (cl->op) {
+	case UUIDD_OP_GETPID:
+		snprintf(reply_buf, UUIDD_PROT_BUFSZ, "%d", getpid());
+		reply_len = strlen(reply_buf) + 1;
+		num = 0;
+		break;
+	case UUIDD_OP_GET_MAXOP:
+		snprintf(reply_buf, UUIDD_PROT_BUFSZ, "%d", UUIDD_MAX_OP);
+		reply_len = strlen(reply_buf) + 1;
+		num = 0;
+		break;
+	case UUIDD_OP_TIME_UUID:
+		num = 1;
+		ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
+		if (ret < 0 && !uuidd_cxt->quiet)
+			warnx(_("failed to open/lock clock counter"));
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, _("Generated time UUID: %s\n"), str);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		break;
+	case UUIDD_OP_RANDOM_UUID:
+		num = 1;
+		__uuid_generate_random(uu, &num);
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, _("Generated random UUID: %s\n"), str);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		break;
+	case UUIDD_OP_BULK_TIME_UUID:
+		ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
+		if (ret < 0 && !uuidd_cxt->quiet)
+			warnx(_("failed to open/lock clock counter"));
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, P_("Generated time UUID %s "
+					   "and %d following\n",
+					   "Generated time UUID %s "
+					   "and %d following\n", num - 1),
+			       str, num - 1);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		memcpy(reply_buf + reply_len, &num, sizeof(num));
+		reply_len += sizeof(num);
+		break;
+	case UUIDD_OP_BULK_RANDOM_UUID:
+	case UUIDD_OP_BULK_TIME_V7_UUID:
+		if (num < 0)
+			num = 1;
+		if ((UUIDD_PROT_BUFSZ - sizeof(num)) < (size_t) (sizeof(uu) * num))
+			num = (UUIDD_PROT_BUFSZ - sizeof(num)) / sizeof(uu);
+		if (cl->op == UUIDD_OP_BULK_TIME_V7_UUID)
+			/* one thread keeps them monotonic for all clients */
+			uuid_generate_time_v7_bulk((uuid_t *) (reply_buf +
+						   sizeof(num)), num);
+		else
+			__uuid_generate_random((unsigned char *) reply_buf +
+					      sizeof(num), &num);
+		reply_len = sizeof(num) + (sizeof(uu) * num);
+		memcpy(reply_buf, &num, sizeof(num));
+		if (uuidd_cxt->debug) {
+			fprintf(stderr, P_("Generated %d UUID:\n",
+					   "Generated %d UUIDs:\n", num), num);
+			cp = reply_buf + sizeof(num);
+			for (i = 0; i < num; i++) {
+				uuid_unparse((unsigned char *)cp, str);
+				fprintf(stderr, "\t%s\n", str);
+				cp += sizeof(uu);
+			}
+		}
+		break;
+	default:
+		if (uuidd_cxt->debug)
+			fprintf(stderr, _("Invalid operation %d\n"), cl->op);
+		return -1;
+	}
+
+	memcpy(cl->out, &reply_len, sizeof(reply_len));
+	cl->out_len = sizeof(reply_len) + reply_len;
+	cl->num = num;
+	return 0;
+}
+
+/* returns 1 if the request is complete, 0 if more data are expected, -1 on error */
+static int read_request(const struct uuidd_cxt_t *uuidd_cxt, struct uuidd_client *cl)
+{
+	for (;;) {
+		size_t need = sizeof(uuidd_prot_op_t);
+		ssize_t len;
+
+		if (cl->in_len && is_bulk_op((uuidd_prot_op_t) cl->in[0]))
+			need += sizeof(uuidd_prot_num_t);
+		if (cl->in_len == need)
+			break;
+
+		len = read(cl->fd, cl->in + cl->in_len, need - cl->in_len);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			warn(_("read failed"));
+			return -1;
+		}
+		if (len == 0) {
+			if (!cl->in_len)
+				warnx(_("error reading from client, len = %d"), 0);
+			return -1;
+		}
+		cl->in_len += len;
+	}
+
+	cl->op = (uuidd_prot_op_t) cl->in[0];
+	if (is_bulk_op(cl->op)) {
+		memcpy(&cl->num, cl->in + sizeof(cl->op), sizeof(cl->num));
+		if (uuidd_cxt->debug)
+			fprintf(stderr, _("operation %d, incoming num = %d\n"),
+			       cl->op, cl->num);
+	} else if (uuidd_cxt->debug)
+		fprintf(stderr, _("operation %d\n"), cl->op);
+
+	return 1;
+}
+
+/* returns 1 if the reply has been sent, 0 if the socket is full, -1 on error */
+static int write_reply(struct uuidd_client *cl)
+{
+	while (cl->out_pos < cl->out_len) {
+		ssize_t len = write(cl->fd, cl->out + cl->out_pos,
+				    cl->out_len - cl->out_pos);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -1;
+		}
+		cl->out_pos += len;
+	}
+	return 1;
+}
+
+static void account_request(struct uuidd_cxt_t *uuidd_cxt,
+			    const struct uuidd_client *cl)
+{
+	struct uuidd_opstat *st = &uuidd_cxt->stats[cl->op];
+	struct timeval now;
+	uint64_t usec;
+
+	gettime_monotonic(&now);
+	timersub(&now, &cl->start, &now);
+	usec = (uint64_t) now.tv_sec * 1000000 + now.tv_usec;
+
+	st->nreqs++;
+	st->nuuids += cl->num;
+	st->usec += usec;
+	if (usec > st->usec_max)
+		st->usec_max = usec;
+}
+
+static void remove_client(struct uuidd_client *cl)
+{
+	list_del(&cl->clients);
+	close(cl->fd);		/* removes it from epoll too */
+	free(cl);
+}
+
+static void reply_client(struct uuidd_server *srv, struct uuidd_client *cl)
+{
+	int rc = write_reply(cl);
+
+	if (rc == 0) {
+		if (!cl->pollout) {
+			struct epoll_event ev = { .events = EPOLLOUT, .data.ptr = cl };
+
+			if (epoll_ctl(srv->epfd, EPOLL_CTL_ADD, cl->fd, &ev) < 0) {
+				warn(_("epoll_ctl failed"));
+				remove_client(cl);
+				return;
+			}
+			cl->pollout = 1;
+		}
+		return;
+	}
+	if (rc == 1)
+		account_request(srv->cxt, cl);
+	remove_client(cl);
+}
+
+#ifdef HAVE_PTHREAD
+static void *random_worker(void *data)
+{
+	struct uuidd_server *srv = data;
+
+	for (;;) {
+		struct uuidd_client *cl;
+
+		pthread_mutex_lock(&srv->lock);
+		while (list_empty(&srv->jobs))
+			pthread_cond_wait(&srv->cond, &srv->lock);
+		cl = list_first_entry(&srv->jobs, struct uuidd_client, jobs);
+		list_del_init(&cl->jobs);
+		pthread_mutex_unlock(&srv->lock);
+
+		generate_reply(srv->cxt, cl);
+
+		pthread_mutex_lock(&srv->lock);
+		list_add_tail(&cl->jobs, &srv->done);
+		pthread_mutex_unlock(&srv->lock);
+		eventfd_write(srv->evfd, 1);
+	}
+	return NULL;
+}
+
+/* the workers run until the daemon exits */
+static void start_workers(struct uuidd_server *srv, size_t njobs)
+{
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &srv->evfd };
+	size_t i;
+
+	INIT_LIST_HEAD(&srv->jobs);
+	INIT_LIST_HEAD(&srv->done);
+
+	srv->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (srv->evfd < 0)
+		err(EXIT_FAILURE, _("cannot create eventfd"));
+	if (epoll_ctl(srv->epfd, EPOLL_CTL_ADD, srv->evfd, &ev) < 0)
+		err(EXIT_FAILURE, _("epoll_ctl failed"));
+
+	pthread_mutex_init(&srv->lock, NULL);
+	pthread_cond_init(&srv->cond, NULL);
+
+	for (i = 0; i < njobs; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, random_worker, srv) != 0)
+			break;
+		pthread_detach(thread);
+		srv->nthreads++;
+	}
+	if (srv->nthreads < njobs && !srv->cxt->quiet)
+		warnx(_("started %zu of %zu workers"), srv->nthreads, njobs);
+}
+
+static void queue_job(struct uuidd_server *srv, struct uuidd_client *cl)
+{
+	cl->queued = 1;
+
+	pthread_mutex_lock(&srv->lock);
+	list_add_tail(&cl->jobs, &srv->jobs);
+	pthread_cond_signal(&srv->cond);
+	pthread_mutex_unlock(&srv->lock);
+}
+
+static void handle_done_jobs(struct uuidd_server *srv)
+{
+	struct list_head done, *p, *pnext;
+	eventfd_t n;
+
+	eventfd_read(srv->evfd, &n);
+
+	INIT_LIST_HEAD(&done);
+	pthread_mutex_lock(&srv->lock);
+	list_splice(&srv->done, &done);
+	INIT_LIST_HEAD(&srv->done);
+	pthread_mutex_unlock(&srv->lock);
+
+	list_for_each_safe(p, pnext, &done) {
+		struct uuidd_client *cl = list_entry(p, struct uuidd_client, jobs);
+
+		list_del_init(&cl->jobs);
+		cl->queued = 0;
+		reply_client(srv, cl);
+	}
+}
+#endif /* HAVE_PTHREAD */
+
+static void handle_client(struct uuidd_server *srv, struct uuidd_client *cl)
+{
+	int rc;
+
+	if (cl->queued)
+		return;
+	if (cl->out_len) {		/* EPOLLOUT */
+		reply_client(srv, cl);
+		return;
+	}
+
+	rc = read_request(srv->cxt, cl);
+	if (rc == 0)
+		return;
+	/* nothing more is read from the client */
+	epoll_ctl(srv->epfd, EPOLL_CTL_DEL, cl->fd, NULL);
+	if (rc < 0) {
+		remove_client(cl);
+		return;
+	}
+#ifdef HAVE_PTHREAD
+	if (srv->nthreads && is_random_op(cl->op)) {
+		queue_job(srv, cl);
+		return;
+	}
+#endif
+	if (generate_reply(srv->cxt, cl) != 0) {
+		remove_client(cl);
+		return;
+	}
+	reply_client(srv, cl);
+}
+
+/* accepts all pending connections, the listening socket is non-blocking */
+static void accept_clients(struct uuidd_server *srv)
+{
+	for (;;) {
+		struct epoll_event ev = { .events = EPOLLIN };
+		struct uuidd_client *cl;
+		int fd;
+
+		fd = accept4(srv->sock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS
+			    || errno == ENOMEM) {
+				warn("accept");
+				break;
+			}
+			err(EXIT_FAILURE, "accept");
+		}
+
+		cl = calloc(1, sizeof(*cl));
+		if (!cl) {
+			warn(_("cannot allocate client"));
+			close(fd);
+			break;
+		}
+		INIT_LIST_HEAD(&cl->jobs);
+		cl->fd = fd;
+		gettime_monotonic(&cl->start);
+		list_add_tail(&cl->clients, &srv->clients);
+
+		ev.data.ptr = cl;
+		if (epoll_ctl(srv->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			warn(_("epoll_ctl failed"));
+			remove_client(cl);
+			continue;
+		}
+		/* the request is usually already there */
+		handle_client(srv, cl);
+	}
+}
+
+/* removes clients older than UUIDD_CLIENT_TIMEOUT, returns msec to the next timeout */
+static int expire_clients(struct uuidd_server *srv)
+{
+	struct list_head *p, *pnext;
+	struct timeval now;
+
+	gettime_monotonic(&now);
+
+	list_for_each_safe(p, pnext, &srv->clients) {
+		struct uuidd_client *cl = list_entry(p, struct uuidd_client, clients);
+		struct timeval age;
+
+		if (cl->queued)
+			continue;
+		timersub(&now, &cl->start, &age);
+		if (age.tv_sec < UUIDD_CLIENT_TIMEOUT)
+			return (UUIDD_CLIENT_TIMEOUT - age.tv_sec) * 1000
+			       - age.tv_usec / 1000;
+		if (srv->cxt->debug)
+			fprintf(stderr, _("client timeout, closing\n"));
+		remove_client(cl);
+	}
+	return -1;
+}
+
 static void server_loop(const char *socket_path, const char *pidfile_path,
 			struct uuidd_cxt_t *uuidd_cxt)
 {
-	struct sockaddr_un	from_addr;
-	socklen_t		fromlen;
-	int32_t			reply_len = 0;
-	uuid_t			uu;
-	char			reply_buf[UUIDD_PROT_BUFSZ], *cp;
-	uuidd_prot_op_t 	op;
-	char			str[UUID_STR_LEN];
-	int			i, ns, len;
-	uuidd_prot_num_t	num;		/* intentionally uninitialized */
-	int			s = 0;
+	struct uuidd_server	srv = { .cxt = uuidd_cxt };
+	struct epoll_event	ev = { .events = EPOLLIN };
+	struct timeval		last;
+	char			reply_buf[UUIDD_PROT_BUFSZ];
+	int			i, ret;
 	int			fd_pidfile = -1;
-	int			ret;
-	struct pollfd		pfd[2];
 	sigset_t		sigmask;
-	int			sigfd;
-	enum {
-				POLLFD_SIGNAL = 0,
-				POLLFD_SOCKET
-	};
+
+	INIT_LIST_HEAD(&srv.clients);
 
 #ifdef HAVE_LIBSYSTEMD
 	if (!uuidd_cxt->no_sock)	/* no_sock implies no_fork and no_pid */
@@ -387,9 +898,9 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 			exit(EXIT_FAILURE);
 		}
 
-		s = create_socket(uuidd_cxt, socket_path,
+		srv.sock = create_socket(uuidd_cxt, socket_path,
 				  (!uuidd_cxt->debug || !uuidd_cxt->no_fork));
-		if (listen(s, SOMAXCONN) < 0) {
+		if (listen(srv.sock, SOMAXCONN) < 0) {
 			if (!uuidd_cxt->quiet)
 				warn(_("couldn't listen on unix socket %s"), socket_path);
 			exit(EXIT_FAILURE);
@@ -422,7 +933,7 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 		else if (1 < r)
 			errx(EXIT_FAILURE,
 			     _("too many file descriptors received, check uuidd.socket"));
-		s = SD_LISTEN_FDS_START + 0;
+		srv.sock = SD_LISTEN_FDS_START + 0;
 	}
 #endif
 
@@ -432,138 +943,75 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 	sigaddset(&sigmask, SIGTERM);
 	sigaddset(&sigmask, SIGALRM);
 	sigaddset(&sigmask, SIGPIPE);
+	sigaddset(&sigmask, SIGUSR1);
 	/* Block signals so that they aren't handled according to their
-	 * default dispositions */
+	 * default dispositions; the workers inherit the mask */
 	sigprocmask(SIG_BLOCK, &sigmask, NULL);
-	if ((sigfd = signalfd(-1, &sigmask, 0)) < 0)
+	if ((srv.sigfd = signalfd(-1, &sigmask, SFD_NONBLOCK | SFD_CLOEXEC)) < 0)
 		err(EXIT_FAILURE, _("cannot set signal handler"));
 
-	pfd[POLLFD_SIGNAL].fd = sigfd;
-	pfd[POLLFD_SOCKET].fd = s;
-	pfd[POLLFD_SIGNAL].events = pfd[POLLFD_SOCKET].events = POLLIN | POLLERR | POLLHUP;
+	if (fcntl(srv.sock, F_SETFL, fcntl(srv.sock, F_GETFL) | O_NONBLOCK) < 0)
+		err(EXIT_FAILURE, _("cannot set non-blocking socket"));
+
+	srv.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (srv.epfd < 0)
+		err(EXIT_FAILURE, _("cannot create epoll"));
+	ev.data.ptr = &srv.sigfd;
+	if (epoll_ctl(srv.epfd, EPOLL_CTL_ADD, srv.sigfd, &ev) < 0)
+		err(EXIT_FAILURE, _("epoll_ctl failed"));
+	ev.data.ptr = &srv.sock;
+	if (epoll_ctl(srv.epfd, EPOLL_CTL_ADD, srv.sock, &ev) < 0)
+		err(EXIT_FAILURE, _("epoll_ctl failed"));
+
+#ifdef HAVE_PTHREAD
+	if (uuidd_cxt->njobs)
+		start_workers(&srv, uuidd_cxt->njobs);
+#endif
+	gettime_monotonic(&uuidd_cxt->started);
+	gettime_monotonic(&last);
 
 	while (1) {
-		ret = poll(pfd, ARRAY_SIZE(pfd),
-				uuidd_cxt->timeout ?
-					(int) uuidd_cxt->timeout * 1000 : -1);
+		struct epoll_event events[UUIDD_MAX_EVENTS];
+		struct timeval now, idle;
+		int timeout = expire_clients(&srv);
+
+		if (uuidd_cxt->timeout && list_empty(&srv.clients)) {
+			gettime_monotonic(&now);
+			timersub(&now, &last, &idle);
+			if (idle.tv_sec >= (time_t) uuidd_cxt->timeout) {
+				if (uuidd_cxt->debug)
+					fprintf(stderr, _("timeout [%d sec]\n"), uuidd_cxt->timeout);
+				all_done(uuidd_cxt, EXIT_SUCCESS);
+			}
+			if (timeout < 0)
+				timeout = (uuidd_cxt->timeout - idle.tv_sec) * 1000
+					  - idle.tv_usec / 1000;
+		}
+
+		ret = epoll_wait(srv.epfd, events, ARRAY_SIZE(events), timeout);
 		if (ret < 0) {
-			if (errno == EAGAIN)
+			if (errno == EAGAIN || errno == EINTR)
 				continue;
-			warn(_("poll failed"));
+			warn(_("epoll_wait failed"));
 			all_done(uuidd_cxt, EXIT_FAILURE);
 		}
-		if (ret == 0) {		/* true when poll() times out */
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("timeout [%d sec]\n"), uuidd_cxt->timeout);
-			all_done(uuidd_cxt, EXIT_SUCCESS);
-		}
-		if (pfd[POLLFD_SIGNAL].revents != 0)
-			handle_signal(uuidd_cxt, sigfd);
-		if (pfd[POLLFD_SOCKET].revents == 0)
-			continue;
-		fromlen = sizeof(from_addr);
-		ns = accept(s, (struct sockaddr *) &from_addr, &fromlen);
-		if (ns < 0) {
-			if ((errno == EAGAIN) || (errno == EINTR))
-				continue;
-			err(EXIT_FAILURE, "accept");
-		}
-		len = read(ns, &op, sizeof(op));
-		if (len != sizeof(op)) {
-			if (len < 0)
-				warn(_("read failed"));
+		if (ret > 0)
+			gettime_monotonic(&last);
+
+		for (i = 0; i < ret; i++) {
+			void *ptr = events[i].data.ptr;
+
+			if (ptr == &srv.sigfd)
+				handle_signal(uuidd_cxt, srv.sigfd);
+			else if (ptr == &srv.sock)
+				accept_clients(&srv);
+#ifdef HAVE_PTHREAD
+			else if (ptr == &srv.evfd)
+				handle_done_jobs(&srv);
+#endif
 			else
-				warnx(_("error reading from client, len = %d"),
-						len);
-			goto shutdown_socket;
-		}
-		if ((op == UUIDD_OP_BULK_TIME_UUID) ||
-		    (op == UUIDD_OP_BULK_RANDOM_UUID)) {
-			if (read_all(ns, (char *) &num, sizeof(num)) != sizeof(num))
-				goto shutdown_socket;
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("operation %d, incoming num = %d\n"),
-				       op, num);
-		} else if (uuidd_cxt->debug)
-			fprintf(stderr, _("operation %d\n"), op);
-
-		switch (op) {
-		case UUIDD_OP_GETPID:
-			snprintf(reply_buf, sizeof(reply_buf), "%d", getpid());
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_GET_MAXOP:
-			snprintf(reply_buf, sizeof(reply_buf), "%d", UUIDD_MAX_OP);
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_TIME_UUID:
-			num = 1;
-			ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
-			if (ret < 0 && !uuidd_cxt->quiet)
-				warnx(_("failed to open/lock clock counter"));
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated time UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_RANDOM_UUID:
-			num = 1;
-			__uuid_generate_random(uu, &num);
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated random UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_BULK_TIME_UUID:
-			ret = __uuid_generate_time_cont(uu, &num, uuidd_cxt->cont_clock_offset);
-			if (ret < 0 && !uuidd_cxt->quiet)
-				warnx(_("failed to open/lock clock counter"));
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, P_("Generated time UUID %s "
-						   "and %d following\n",
-						   "Generated time UUID %s "
-						   "and %d following\n", num - 1),
-				       str, num - 1);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			memcpy(reply_buf + reply_len, &num, sizeof(num));
-			reply_len += sizeof(num);
-			break;
-		case UUIDD_OP_BULK_RANDOM_UUID:
-			if (num < 0)
-				num = 1;
-			if ((sizeof(reply_buf) - sizeof(num)) < (size_t) (sizeof(uu) * num))
-				num = (sizeof(reply_buf) - sizeof(num)) / sizeof(uu);
-			__uuid_generate_random((unsigned char *) reply_buf +
-					      sizeof(num), &num);
-			reply_len = sizeof(num) + (sizeof(uu) * num);
-			memcpy(reply_buf, &num, sizeof(num));
-			if (uuidd_cxt->debug) {
-				fprintf(stderr, P_("Generated %d UUID:\n",
-						   "Generated %d UUIDs:\n", num), num);
-				cp = reply_buf + sizeof(num);
-				for (i = 0; i < num; i++) {
-					uuid_unparse((unsigned char *)cp, str);
-					fprintf(stderr, "\t%s\n", str);
-					cp += sizeof(uu);
-				}
-			}
-			break;
-		default:
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("Invalid operation %d\n"), op);
-			goto shutdown_socket;
+				handle_client(&srv, ptr);
 		}
-		write_all(ns, (char *) &reply_len, sizeof(num));
-		write_all(ns, reply_buf, reply_len);
-	shutdown_socket:
-		close(ns);
 	}
 }
 
@@ -603,11 +1051,13 @@ static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 		{"kill", no_argument, NULL, 'k'},
 		{"random", no_argument, NULL, 'r'},
 		{"time", no_argument, NULL, 't'},
+		{"time-v7", no_argument, NULL, '7'},
 		{"uuids", required_argument, NULL, 'n'},
 		{"no-pid", no_argument, NULL, 'P'},
 		{"no-fork", no_argument, NULL, 'F'},
 		{"socket-activation", no_argument, NULL, 'S'},
 		{"cont-clock", optional_argument, NULL, 'C'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"debug", no_argument, NULL, 'd'},
 		{"quiet", no_argument, NULL, 'q'},
 		{"version", no_argument, NULL, 'V'},
@@ -617,13 +1067,13 @@ static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 	const ul_excl_t excl[] = {
 		{ 'P', 'p' },
 		{ 'd', 'q' },
-		{ 'r', 't' },
+		{ '7', 'r', 't' },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 	int c;
 
-	while ((c = getopt_long(argc, argv, "p:s:T:krtn:PFSC::dqVh", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "p:s:T:krt7n:PFSC::j:dqVh", longopts, NULL)) != -1) {
 		err_exclusive_options(c, longopts, excl, excl_st);
 		switch (c) {
 		case 'C':
@@ -635,6 +1085,10 @@ static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 		case 'd':
 			uuidd_cxt->debug = 1;
 			break;
+		case 'j':
+			uuidd_cxt->njobs = strtou32_or_err(optarg,
+						_("failed to parse --jobs"));
+			break;
 		case 'k':
 			uuidd_opts->do_kill = 1;
 			break;
@@ -674,6 +1128,10 @@ static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 		case 't':
 			uuidd_opts->do_type = UUIDD_OP_TIME_UUID;
 			break;
+		case '7':
+			/* there is no single v7 operation */
+			uuidd_opts->do_type = UUIDD_OP_BULK_TIME_V7_UUID;
+			break;
 		case 'T':
 			uuidd_cxt->timeout = strtou32_or_err(optarg,
 						_("failed to parse --timeout"));
@@ -697,7 +1155,8 @@ static void parse_options(int argc, char **argv, struct uuidd_cxt_t *uuidd_cxt,
 			uuidd_opts->do_type = UUIDD_OP_BULK_TIME_UUID;
 			break;
 		}
-	}
+	} else if (uuidd_opts->do_type == UUIDD_OP_BULK_TIME_V7_UUID)
+		uuidd_opts->num = 1;
 }
 
 int main(int argc, char **argv)
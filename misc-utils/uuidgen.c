@@ -21,6 +21,9 @@
 #include "optutils.h"
 #include "xalloc.h"
 
+/* UUIDs generated, formatted and written at once */
+#define UUIDGEN_BATCH	1024
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -34,6 +37,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -r, --random          generate random-based uuid\n"), out);
 	fputs(_(" -t, --time            generate time-based uuid\n"), out);
+	fputs(_(" -7, --time-v7         generate time-ordered v7 uuid\n"), out);
 	fputs(_(" -n, --namespace <ns>  generate hash-based uuid in this namespace\n"), out);
 	fprintf(out, _("                        available namespaces: %s\n"), "@dns @url @oid @x500");
 	fputs(_(" -N, --name <name>     generate hash-based uuid from this name\n"), out);
@@ -41,6 +45,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -C, --count <num>     generate more uuids in loop\n"), out);
 	fputs(_(" -s, --sha1            generate sha1 hash\n"), out);
 	fputs(_(" -x, --hex             interpret name as hex string\n"), out);
+	fputs(_(" -b, --binary          write 16-byte binary uuids\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(21));
 	fprintf(out, USAGE_MAN_TAIL("uuidgen(1)"));
@@ -83,20 +88,55 @@ badstring:
 	return value2;
 }
 
+static void generate_uuids(int type, uuid_t *buf, size_t n)
+{
+	size_t i;
+
+	switch (type) {
+	case UUID_TYPE_DCE_TIME_V7:
+		/* one clock read and one random bytes fill per batch */
+		uuid_generate_time_v7_bulk(buf, n);
+		break;
+	case UUID_TYPE_DCE_RANDOM:
+		uuid_generate_random_bulk(buf, n);
+		break;
+	case UUID_TYPE_DCE_TIME:
+		/* libuuid caches ranges of time-based UUIDs (from uuidd) */
+		for (i = 0; i < n; i++)
+			uuid_generate_time(buf[i]);
+		break;
+	default:
+		for (i = 0; i < n; i++)
+			uuid_generate(buf[i]);
+		break;
+	}
+}
+
+static void write_uuids(const uuid_t *buf, size_t n, char *str, int binary)
+{
+	if (binary)
+		fwrite(buf, sizeof(uuid_t), n, stdout);
+	else {
+		uuid_unparse_many(buf, n, str, '\n');
+		fwrite(str, UUID_STR_LEN, n, stdout);
+	}
+}
+
 int
 main (int argc, char *argv[])
 {
 	int    c;
-	int    do_type = 0, is_hex = 0;
-	char   str[UUID_STR_LEN];
+	int    do_type = 0, is_hex = 0, binary = 0;
+	char   *str;
 	char   *namespace = NULL, *name = NULL;
 	size_t namelen = 0;
-	uuid_t ns, uu;
-	unsigned int count = 1, i;
+	uuid_t ns, *buf;
+	unsigned int count = 1, nbuf;
 
 	static const struct option longopts[] = {
 		{"random", no_argument, NULL, 'r'},
 		{"time", no_argument, NULL, 't'},
+		{"time-v7", no_argument, NULL, '7'},
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
 		{"namespace", required_argument, NULL, 'n'},
@@ -105,14 +145,15 @@ main (int argc, char *argv[])
 		{"count", required_argument, NULL, 'C'},
 		{"sha1", no_argument, NULL, 's'},
 		{"hex", no_argument, NULL, 'x'},
+		{"binary", no_argument, NULL, 'b'},
 		{NULL, 0, NULL, 0}
 	};
 
 	static const ul_excl_t excl[] = {
 		{ 'C', 'm', 's' },
-		{ 'N', 'r', 't' },
-		{ 'm', 'r', 's', 't' },
-		{ 'n', 'r', 't' },
+		{ '7', 'N', 'r', 't' },
+		{ '7', 'm', 'r', 's', 't' },
+		{ '7', 'n', 'r', 't' },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -122,7 +163,7 @@ main (int argc, char *argv[])
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "C:rtVhn:N:msx", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "bC:rt7Vhn:N:msx", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -133,6 +174,9 @@ main (int argc, char *argv[])
 		case 'r':
 			do_type = UUID_TYPE_DCE_RANDOM;
 			break;
+		case '7':
+			do_type = UUID_TYPE_DCE_TIME_V7;
+			break;
 		case 'n':
 			namespace = optarg;
 			break;
@@ -151,6 +195,9 @@ main (int argc, char *argv[])
 		case 'x':
 			is_hex = 1;
 			break;
+		case 'b':
+			binary = 1;
+			break;
 
 		case 'h':
 			usage();
@@ -187,46 +234,45 @@ main (int argc, char *argv[])
 			name = unhex(name, &namelen);
 	}
 
-	for (i = 0; i < count; i++) {
-		switch (do_type) {
-		case UUID_TYPE_DCE_TIME:
-			uuid_generate_time(uu);
-			break;
-		case UUID_TYPE_DCE_RANDOM:
-			uuid_generate_random(uu);
-			break;
-		case UUID_TYPE_DCE_MD5:
-		case UUID_TYPE_DCE_SHA1:
-			if (namespace[0] == '@' && namespace[1] != '\0') {
-				const uuid_t *uuidptr;
-
-				uuidptr = uuid_get_template(&namespace[1]);
-				if (uuidptr == NULL) {
-					warnx(_("unknown namespace alias: '%s'"), namespace);
-					errtryhelp(EXIT_FAILURE);
-				}
-				memcpy(ns, *uuidptr, sizeof(ns));
-			} else {
-				if (uuid_parse(namespace, ns) != 0) {
-					warnx(_("invalid uuid for namespace: '%s'"), namespace);
-					errtryhelp(EXIT_FAILURE);
-				}
+	nbuf = count ? min(count, (unsigned int) UUIDGEN_BATCH) : 1;
+	buf = xmalloc(nbuf * sizeof(uuid_t));
+	str = binary ? NULL : xmalloc(nbuf * UUID_STR_LEN);
+
+	if (do_type == UUID_TYPE_DCE_MD5 || do_type == UUID_TYPE_DCE_SHA1) {
+		if (namespace[0] == '@' && namespace[1] != '\0') {
+			const uuid_t *uuidptr;
+
+			uuidptr = uuid_get_template(&namespace[1]);
+			if (uuidptr == NULL) {
+				warnx(_("unknown namespace alias: '%s'"), namespace);
+				errtryhelp(EXIT_FAILURE);
+			}
+			memcpy(ns, *uuidptr, sizeof(ns));
+		} else {
+			if (uuid_parse(namespace, ns) != 0) {
+				warnx(_("invalid uuid for namespace: '%s'"), namespace);
+				errtryhelp(EXIT_FAILURE);
 			}
-			if (do_type == UUID_TYPE_DCE_MD5)
-				uuid_generate_md5(uu, ns, name, namelen);
-			else
-				uuid_generate_sha1(uu, ns, name, namelen);
-			break;
-		default:
-			uuid_generate(uu);
-			break;
 		}
+		/* --count is not allowed, the hash is the same every time */
+		if (do_type == UUID_TYPE_DCE_MD5)
+			uuid_generate_md5(buf[0], ns, name, namelen);
+		else
+			uuid_generate_sha1(buf[0], ns, name, namelen);
+		write_uuids(buf, 1, str, binary);
+		count = 0;
+	}
 
-		uuid_unparse(uu, str);
+	while (count) {
+		unsigned int n = min(count, nbuf);
 
-		printf("%s\n", str);
+		generate_uuids(do_type, buf, n);
+		write_uuids(buf, n, str, binary);
+		count -= n;
 	}
 
+	free(buf);
+	free(str);
 	if (is_hex)
 		free(name);
 
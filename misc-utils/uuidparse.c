@@ -37,6 +37,7 @@
  */
 
 #include <assert.h>
+#include <ctype.h>
 #include <getopt.h>
 #include <libsmartcols.h>
 #include <stdint.h>
@@ -55,6 +56,9 @@
 #include "timeutils.h"
 #include "xalloc.h"
 
+#define UUIDPARSE_BUFSZ		(64 * 1024)	/* stdin read block */
+#define UUIDPARSE_STREAM_SAMPLE	128		/* default --stream lines */
+
 /* column IDs */
 enum {
 	COL_UUID = 0,
@@ -83,10 +87,12 @@ static int columns[ARRAY_SIZE(infos) * 2];
 static size_t ncolumns;
 
 struct control {
+	size_t	stream_sample;	/* --stream lines to calculate widths */
 	unsigned int
 		json:1,
 		no_headings:1,
-		raw:1;
+		raw:1,
+		stream:1;
 };
 
 static void __attribute__((__noreturn__)) usage(void)
@@ -101,6 +107,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputsln(_(" -n, --noheadings       don't print headings"), stdout);
 	fputsln(_(" -o, --output <list>    COLUMNS to display (see below)"), stdout);
 	fputsln(_(" -r, --raw              use the raw output format"), stdout);
+	fputsln(_("     --stream[=<lines>] print lines as read, widths from the leading lines"), stdout);
 	fprintf(stdout, USAGE_HELP_OPTIONS(24));
 
 	fputs(USAGE_COLUMNS, stdout);
@@ -215,6 +222,9 @@ static void fill_table_row(struct libscols_table *tb, char const *const uuid)
 			case UUID_TYPE_DCE_SHA1:
 				str = xstrdup(_("sha1-based"));
 				break;
+			case UUID_TYPE_DCE_TIME_V7:
+				str = xstrdup(_("time-v7"));
+				break;
 			default:
 				str = xstrdup(_("unknown"));
 			}
@@ -224,7 +234,8 @@ static void fill_table_row(struct libscols_table *tb, char const *const uuid)
 				str = xstrdup(_("invalid"));
 				break;
 			}
-			if (variant == UUID_VARIANT_DCE && type == UUID_TYPE_DCE_TIME) {
+			if (variant == UUID_VARIANT_DCE && (type == UUID_TYPE_DCE_TIME
+							    || type == UUID_TYPE_DCE_TIME_V7)) {
 				struct timeval tv;
 				char date_buf[ISO_BUFSIZ];
 
@@ -242,6 +253,51 @@ static void fill_table_row(struct libscols_table *tb, char const *const uuid)
 	}
 }
 
+/*
+ * Reads whitespace separated UUIDs from @f in large blocks. A word is never
+ * split between blocks, except words longer than the block.
+ */
+static void read_uuids(struct libscols_table *tb, FILE *f)
+{
+	char *buf = xmalloc(UUIDPARSE_BUFSZ + 1);
+	size_t len = 0;
+
+	do {
+		char *p, *word, *end;
+		int eof;
+
+		len += fread(buf + len, 1, UUIDPARSE_BUFSZ - len, f);
+		eof = feof(f) || ferror(f);
+		end = buf + len;
+
+		for (p = buf; ; ) {
+			while (p < end && isspace((unsigned char) *p))
+				p++;
+			word = p;
+			while (p < end && !isspace((unsigned char) *p))
+				p++;
+			if (word == p)
+				break;
+			/* incomplete word, read the rest by the next block */
+			if (p == end && !eof && word != buf)
+				break;
+			*p++ = '\0';
+			fill_table_row(tb, word);
+			word = p;
+		}
+
+		len = word < end ? (size_t) (end - word) : 0;
+		if (len)
+			memmove(buf, word, len);
+		if (eof)
+			break;
+	} while (1);
+
+	if (ferror(f))
+		err(EXIT_FAILURE, _("read failed"));
+	free(buf);
+}
+
 static void print_output(struct control const *const ctrl, int argc,
 			 char **argv)
 {
@@ -259,6 +315,10 @@ static void print_output(struct control const *const ctrl, int argc,
 	}
 	scols_table_enable_noheadings(tb, ctrl->no_headings);
 	scols_table_enable_raw(tb, ctrl->raw);
+	if (ctrl->stream) {
+		scols_table_set_streaming_sample(tb, ctrl->stream_sample);
+		scols_table_enable_streaming(tb, 1);
+	}
 
 	for (i = 0; i < ncolumns; i++) {
 		const struct colinfo *col = get_column_info(i);
@@ -272,12 +332,8 @@ static void print_output(struct control const *const ctrl, int argc,
 	for (i = 0; i < (size_t) argc; i++)
 		fill_table_row(tb, argv[i]);
 
-	if (i == 0) {
-		char uuid[UUID_STR_LEN];
-
-		while (scanf(" %36[^ \t\n]%*c", uuid) && !feof(stdin))
-			fill_table_row(tb, uuid);
-	}
+	if (i == 0)
+		read_uuids(tb, stdin);
 	scols_print_table(tb);
 	scols_unref_table(tb);
 }
@@ -288,11 +344,15 @@ int main(int argc, char **argv)
 	char *outarg = NULL;
 	int c;
 
+	enum {
+		OPT_STREAM = CHAR_MAX + 1
+	};
 	static const struct option longopts[] = {
 		{"json",       no_argument,       NULL, 'J'},
 		{"noheadings", no_argument,       NULL, 'n'},
 		{"output",     required_argument, NULL, 'o'},
 		{"raw",        no_argument,       NULL, 'r'},
+		{"stream",     optional_argument, NULL, OPT_STREAM},
 		{"version",    no_argument,       NULL, 'V'},
 		{"help",       no_argument,       NULL, 'h'},
 		{NULL, 0, NULL, 0}
@@ -323,6 +383,12 @@ int main(int argc, char **argv)
 		case 'r':
 			ctrl.raw = 1;
 			break;
+		case OPT_STREAM:
+			ctrl.stream = 1;
+			ctrl.stream_sample = optarg ?
+				strtou32_or_err(optarg, _("invalid stream lines argument")) :
+				UUIDPARSE_STREAM_SAMPLE;
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
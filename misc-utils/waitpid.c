@@ -20,7 +20,6 @@
 
 #include <sys/epoll.h>
 #include <sys/timerfd.h>
-#include <assert.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
@@ -36,11 +35,15 @@
 #include "exitcodes.h"
 #include "timeutils.h"
 #include "optutils.h"
+#include "fileutils.h"
 
 #define EXIT_TIMEOUT_EXPIRED 3
 
 #define TIMEOUT_SOCKET_IDX UINT64_MAX
 
+/* max number of events returned by one epoll_wait() */
+#define MAX_EVENTS	256
+
 static bool verbose = false;
 static struct timespec timeout;
 static bool allow_exited = false;
@@ -125,28 +128,32 @@ static size_t add_listeners(int epll, size_t n_pids, int * const pidfds, int tim
 static void wait_for_exits(int epll, size_t active_pids, pid_t * const pids,
 			   int * const pidfds)
 {
+	struct epoll_event evts[MAX_EVENTS];
+
 	while (active_pids) {
-		struct epoll_event evt;
-		int ret, fd;
+		int ret, i;
 
-		ret = epoll_wait(epll, &evt, 1, -1);
+		ret = epoll_wait(epll, evts, min(active_pids, (size_t) MAX_EVENTS), -1);
 		if (ret == -1) {
 			if (errno == EINTR)
 				continue;
 			else
 				err_nosys(EXIT_FAILURE, _("failure during wait"));
 		}
-		if (evt.data.u64 == TIMEOUT_SOCKET_IDX) {
+		for (i = 0; i < ret && active_pids; i++) {
+			uint64_t idx = evts[i].data.u64;
+
+			if (idx == TIMEOUT_SOCKET_IDX) {
+				if (verbose)
+					printf(_("Timeout expired\n"));
+				exit(EXIT_TIMEOUT_EXPIRED);
+			}
 			if (verbose)
-				printf(_("Timeout expired\n"));
-			exit(EXIT_TIMEOUT_EXPIRED);
+				printf(_("PID %d finished\n"), pids[idx]);
+			epoll_ctl(epll, EPOLL_CTL_DEL, pidfds[idx], NULL);
+			close(pidfds[idx]);
+			active_pids--;
 		}
-		if (verbose)
-			printf(_("PID %d finished\n"), pids[evt.data.u64]);
-		assert((size_t) ret <= active_pids);
-		fd = pidfds[evt.data.u64];
-		epoll_ctl(epll, EPOLL_CTL_DEL, fd, NULL);
-		active_pids -= ret;
 	}
 }
 
@@ -240,6 +247,9 @@ int main(int argc, char **argv)
 
 	pid_t *pids = parse_pids(argc - pid_idx, argv + pid_idx);
 
+	/* all the pidfds are open at once */
+	ul_raise_fd_limit(n_pids + 16);
+
 	pidfds = open_pidfds(n_pids, pids);
 	timeoutfd = open_timeoutfd();
 	epoll = epoll_create(n_pids);
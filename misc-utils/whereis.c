@@ -90,6 +90,12 @@ enum {
 	ALL_DIRS = BIN_DIR | MAN_DIR | SRC_DIR
 };
 
+/* directory entry */
+struct wh_dirent {
+	char	*name;
+	size_t	order;		/* position in readdir() order */
+};
+
 /* directories */
 struct wh_dirlist {
 	int	type;
@@ -97,6 +103,10 @@ struct wh_dirlist {
 	ino_t	st_ino;
 	char	*path;
 
+	struct wh_dirent *ents;	/* entries sorted by name, see dirlist_load() */
+	size_t	nents;
+	unsigned int loaded : 1;
+
 	struct wh_dirlist *next;
 };
 
@@ -370,6 +380,17 @@ static void construct_dirlist(struct wh_dirlist **ls,
 	}
 }
 
+static void free_dirents(struct wh_dirlist *ls)
+{
+	size_t i;
+
+	for (i = 0; i < ls->nents; i++)
+		free(ls->ents[i].name);
+	free(ls->ents);
+	ls->ents = NULL;
+	ls->nents = 0;
+}
+
 static void free_dirlist(struct wh_dirlist **ls0, int type)
 {
 	struct wh_dirlist *prev = NULL, *next, *ls = *ls0;
@@ -382,6 +403,7 @@ static void free_dirlist(struct wh_dirlist **ls0, int type)
 		if (ls->type & type) {
 			next = ls->next;
 			DBG(LIST, ul_debugobj(*ls0, " free: %s", ls->path));
+			free_dirents(ls);
 			free(ls->path);
 			free(ls);
 			ls = next;
@@ -439,34 +461,150 @@ static int filename_equal(const char *cp, const char *dp, int type)
 	return 0;
 }
 
-static void findin(const char *dir, const char *pattern, int *count,
-		   char **wait, int type)
+static int cmp_dirent_name(const void *a, const void *b)
+{
+	return strcmp(((const struct wh_dirent *) a)->name,
+		      ((const struct wh_dirent *) b)->name);
+}
+
+static int cmp_dirent_order(const void *a, const void *b)
+{
+	const struct wh_dirent *x = *(const struct wh_dirent * const *) a,
+			       *y = *(const struct wh_dirent * const *) b;
+
+	return x->order < y->order ? -1 : x->order > y->order;
+}
+
+/*
+ * Read the directory only once per run; the entries are sorted by name to
+ * make it possible to look up all possible matches of a name by binary
+ * search rather than to scan the whole directory for each name.
+ */
+static void dirlist_load(struct wh_dirlist *ls)
 {
 	DIR *dirp;
 	struct dirent *dp;
+	size_t nalloc = 0;
+
+	if (ls->loaded)
+		return;
+	ls->loaded = 1;
 
-	dirp = opendir(dir);
+	dirp = opendir(ls->path);
 	if (dirp == NULL)
 		return;
 
-	DBG(SEARCH, ul_debug("find '%s' in '%s'", pattern, dir));
+	DBG(SEARCH, ul_debug("reading '%s'", ls->path));
 
 	while ((dp = readdir(dirp)) != NULL) {
-		if (!filename_equal(pattern, dp->d_name, type))
+		if (ls->nents == nalloc) {
+			nalloc = nalloc ? nalloc * 2 : 64;
+			ls->ents = xreallocarray(ls->ents, nalloc, sizeof(*ls->ents));
+		}
+		ls->ents[ls->nents].name = xstrdup(dp->d_name);
+		ls->ents[ls->nents].order = ls->nents;
+		ls->nents++;
+	}
+	closedir(dirp);
+
+	if (ls->nents)
+		qsort(ls->ents, ls->nents, sizeof(*ls->ents), cmp_dirent_name);
+}
+
+/* returns index of the first entry with name >= prefix */
+static size_t dirlist_lower_bound(struct wh_dirlist *ls, const char *prefix)
+{
+	size_t lo = 0, hi = ls->nents;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (strcmp(ls->ents[mid].name, prefix) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ * Collect entries matching the pattern. All names accepted by
+ * filename_equal() start with the pattern (or with "s." and the pattern for
+ * sources), so only this range of the sorted entries has to be checked.
+ */
+static size_t dirlist_match_prefix(struct wh_dirlist *ls, const char *prefix,
+				   const char *pattern,
+				   struct wh_dirent **res, size_t nres)
+{
+	size_t i, len = strlen(prefix);
+
+	for (i = dirlist_lower_bound(ls, prefix); i < ls->nents; i++) {
+		struct wh_dirent *de = &ls->ents[i];
+
+		if (strncmp(de->name, prefix, len) != 0)
+			break;
+		if (filename_equal(pattern, de->name, ls->type))
+			res[nres++] = de;
+	}
+	return nres;
+}
+
+static void findin(struct wh_dirlist *ls, const char *pattern, int *count,
+		   char **wait)
+{
+	struct wh_dirent **res;
+	size_t i, nres = 0;
+
+	dirlist_load(ls);
+	if (!ls->nents)
+		return;
+
+	DBG(SEARCH, ul_debug("find '%s' in '%s'", pattern, ls->path));
+
+	res = xmalloc(ls->nents * sizeof(*res));
+
+#ifdef HAVE_FNMATCH
+	if (use_glob) {
+		for (i = 0; i < ls->nents; i++) {
+			if (filename_equal(pattern, ls->ents[i].name, ls->type))
+				res[nres++] = &ls->ents[i];
+		}
+	} else
+#endif
+	{
+		nres = dirlist_match_prefix(ls, pattern, pattern, res, nres);
+		if (ls->type & SRC_DIR) {
+			char *spat;
+
+			xasprintf(&spat, "s.%s", pattern);
+			nres = dirlist_match_prefix(ls, spat, pattern, res, nres);
+			free(spat);
+		}
+	}
+
+	/* keep the order of the results as returned by readdir() */
+	if (nres > 1)
+		qsort(res, nres, sizeof(*res), cmp_dirent_order);
+
+	for (i = 0; i < nres; i++) {
+		const char *name = res[i]->name;
+
+		/* both ranges may contain the same entry (e.g. "s.s") */
+		if (i && res[i] == res[i - 1])
 			continue;
 
 		if (uflag && *count == 0)
-			xasprintf(wait, "%s/%s", dir, dp->d_name);
+			xasprintf(wait, "%s/%s", ls->path, name);
 
 		else if (uflag && *count == 1 && *wait) {
-			printf("%s: %s %s/%s", pattern, *wait, dir,  dp->d_name);
+			printf("%s: %s %s/%s", pattern, *wait, ls->path, name);
 			free(*wait);
 			*wait = NULL;
 		} else
-			printf(" %s/%s", dir, dp->d_name);
+			printf(" %s/%s", ls->path, name);
 		++(*count);
 	}
-	closedir(dirp);
+	free(res);
 }
 
 static void lookup(const char *pattern, struct wh_dirlist *ls, int want)
@@ -492,7 +630,7 @@ static void lookup(const char *pattern, struct wh_dirlist *ls, int want)
 
 	for (; ls; ls = ls->next) {
 		if ((ls->type & want) && ls->path)
-			findin(ls->path, patbuf, &count, &wait, ls->type);
+			findin(ls, patbuf, &count, &wait);
 	}
 
 	free(wait);
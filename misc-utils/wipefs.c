@@ -30,6 +30,10 @@
 #include <string.h>
 #include <limits.h>
 #include <libgen.h>
+#include <sys/time.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #include <blkid.h>
 #include <libsmartcols.h>
@@ -43,6 +47,8 @@
 #include "closestream.h"
 #include "optutils.h"
 #include "blkdev.h"
+#include "monotonic.h"
+#include "jsonwrt.h"
 
 struct wipe_desc {
 	loff_t		offset;		/* magic string offset */
@@ -71,9 +77,7 @@ struct wipe_control {
 	struct wipe_desc *offsets;		/* -o <offset> -o <offset> ... */
 
 	size_t		ndevs;			/* number of devices to probe */
-
-	char		**reread;		/* devices to BLKRRPART */
-	size_t		nrereads;		/* size of reread */
+	size_t		nthreads;		/* --parallel <num> */
 
 	unsigned int	noact : 1,
 			all : 1,
@@ -85,6 +89,16 @@ struct wipe_control {
 };
 
 
+/* the device to erase */
+struct wipe_device {
+	const char	*devname;
+	struct wipe_desc *wiped;		/* erased signatures */
+	struct timeval	time;			/* duration of the erase */
+	int		rc;
+
+	unsigned int	reread : 1;		/* postponed BLKRRPART */
+};
+
 /* column IDs */
 enum {
 	COL_UUID = 0,
@@ -443,22 +457,20 @@ static void free_wipe(struct wipe_desc *wp)
 	}
 }
 
-static void do_wipe_real(struct wipe_control *ctl, blkid_probe pr,
+static void print_wiped(struct wipe_control *ctl, const char *devname,
 			struct wipe_desc *w)
 {
 	size_t i;
 
-	if (blkid_do_wipe(pr, ctl->noact) != 0)
-		err(EXIT_FAILURE, _("%s: failed to erase %s magic string at offset 0x%08jx"),
-		     ctl->devname, w->type, (intmax_t)w->offset);
-
-	if (ctl->quiet)
+	if (ctl->quiet || ctl->json)
 		return;
 
+	/* the devices may be erased by more threads */
+	flockfile(stdout);
 	printf(P_("%s: %zd byte was erased at offset 0x%08jx (%s): ",
 		  "%s: %zd bytes were erased at offset 0x%08jx (%s): ",
 		  w->len),
-	       ctl->devname, w->len, (intmax_t)w->offset, w->type);
+	       devname, w->len, (intmax_t)w->offset, w->type);
 
 	for (i = 0; i < w->len; i++) {
 		printf("%02x", w->magic[i]);
@@ -466,6 +478,45 @@ static void do_wipe_real(struct wipe_control *ctl, blkid_probe pr,
 			fputc(' ', stdout);
 	}
 	putchar('\n');
+	funlockfile(stdout);
+}
+
+static void do_wipe_real(struct wipe_control *ctl, const char *devname,
+			 blkid_probe pr, struct wipe_desc *w)
+{
+	if (blkid_do_wipe(pr, ctl->noact) != 0)
+		err(EXIT_FAILURE, _("%s: failed to erase %s magic string at offset 0x%08jx"),
+		     devname, w->type, (intmax_t)w->offset);
+
+	print_wiped(ctl, devname, w);
+}
+
+/*
+ * Zeroes the magic strings hidden by blkid_do_wipe(dryrun) in the probing
+ * loop, the device is flushed by caller. It's one write per signature but
+ * one fsync() for the device rather than one for every signature.
+ */
+static void wipe_offsets(const char *devname, int fd, struct wipe_desc *wp)
+{
+	char buf[BUFSIZ] = { 0 };
+
+	for (/*nothing*/; wp; wp = wp->next) {
+		if (lseek(fd, wp->offset, SEEK_SET) == (off_t) -1
+		    || write_all(fd, buf, min(wp->len, sizeof(buf))) != 0)
+			err(EXIT_FAILURE, _("%s: failed to erase %s magic string at offset 0x%08jx"),
+			     devname, wp->type, (intmax_t)wp->offset);
+	}
+}
+
+/* the zones are reset by libblkid, it does not work for the hidden ranges */
+static int is_zoned(int fd)
+{
+	struct blk_zone_report *rep = blkdev_get_zonereport(fd, 0, 1);
+
+	if (!rep)
+		return 0;
+	free(rep);
+	return 1;
 }
 
 static void do_backup(struct wipe_desc *wp, const char *base)
@@ -514,33 +565,39 @@ static void rereadpt(int fd, const char *devname)
 }
 #endif
 
-static int do_wipe(struct wipe_control *ctl)
+static int do_wipe(struct wipe_control *ctl, struct wipe_device *dev)
 {
-	int mode = O_RDWR, reread = 0, need_force = 0;
+	int mode = O_RDWR, reread = 0, need_force = 0, batch;
 	blkid_probe pr;
 	char *backup = NULL;
-	struct wipe_desc *w;
+	struct wipe_desc *w, **last = &dev->wiped;
+	struct timeval start, end;
 
 	if (!ctl->force)
 		mode |= O_EXCL;
 
-	pr = new_probe(ctl->devname, mode);
+	pr = new_probe(dev->devname, mode);
 	if (!pr)
 		return -errno;
 
 	if (blkdev_lock(blkid_probe_get_fd(pr),
-			ctl->devname, ctl->lockmode) != 0) {
+			dev->devname, ctl->lockmode) != 0) {
 		blkid_free_probe(pr);
 		return -1;
 	}
 
 	if (ctl->backup) {
-		char *tmp = xstrdup(ctl->devname);
+		char *tmp = xstrdup(dev->devname);
 
 		xasprintf(&backup, "%s/wipefs-%s-", ctl->backup, basename(tmp));
 		free(tmp);
 	}
 
+	gettime_monotonic(&start);
+
+	/* erase all the signatures after probing */
+	batch = !ctl->noact && !is_zoned(blkid_probe_get_fd(pr));
+
 	while (blkid_do_probe(pr) == 0) {
 		int wiped = 0;
 		size_t len = 0;
@@ -555,14 +612,20 @@ static int do_wipe(struct wipe_control *ctl)
 		    && wp->is_parttable
 		    && !blkid_probe_is_wholedisk(pr)) {
 			warnx(_("%s: ignoring nested \"%s\" partition table "
-				"on non-whole disk device"), ctl->devname, wp->type);
+				"on non-whole disk device"), dev->devname, wp->type);
 			need_force = 1;
 			goto done;
 		}
 
 		if (backup)
 			do_backup(wp, backup);
-		do_wipe_real(ctl, pr, wp);
+		if (batch) {
+			/* hide the signature, it's zeroed by wipe_offsets() */
+			if (blkid_do_wipe(pr, 1) != 0)
+				err(EXIT_FAILURE, _("%s: failed to erase %s magic string at offset 0x%08jx"),
+				     dev->devname, wp->type, (intmax_t)wp->offset);
+		} else
+			do_wipe_real(ctl, dev->devname, pr, wp);
 		if (wp->is_parttable)
 			reread = 1;
 		wiped = 1;
@@ -578,13 +641,23 @@ static int do_wipe(struct wipe_control *ctl)
 			blkid_probe_hide_range(pr, offset, len);
 			blkid_probe_step_back(pr);
 		}
-		free_wipe(wp);
+		if (wiped) {
+			*last = wp;
+			last = &wp->next;
+		} else
+			free_wipe(wp);
+	}
+
+	if (batch) {
+		wipe_offsets(dev->devname, blkid_probe_get_fd(pr), dev->wiped);
+		for (w = dev->wiped; w; w = w->next)
+			print_wiped(ctl, dev->devname, w);
 	}
 
 	for (w = ctl->offsets; w; w = w->next) {
 		if (!w->on_disk && !ctl->quiet)
 			warnx(_("%s: offset 0x%jx not found"),
-					ctl->devname, (uintmax_t)w->offset);
+					dev->devname, (uintmax_t)w->offset);
 	}
 
 	if (need_force)
@@ -592,34 +665,135 @@ static int do_wipe(struct wipe_control *ctl)
 
 	if (fsync(blkid_probe_get_fd(pr)) != 0)
 		err(EXIT_FAILURE, _("%s: cannot flush modified buffers"),
-				ctl->devname);
+				dev->devname);
+
+	gettime_monotonic(&end);
+	timersub(&end, &start, &dev->time);
 
 #ifdef BLKRRPART
 	if (reread && (mode & O_EXCL)) {
-		if (ctl->ndevs > 1) {
+		if (ctl->ndevs > 1)
 			/*
 			 * We're going to probe more device, let's postpone
 			 * re-read PT ioctl until all is erased to avoid
 			 * situation we erase PT on /dev/sda before /dev/sdaN
 			 * devices are processed.
 			 */
-			if (!ctl->reread)
-				ctl->reread = xcalloc(ctl->ndevs, sizeof(char *));
-
-			ctl->reread[ctl->nrereads++] = ctl->devname;
-		} else
-			rereadpt(blkid_probe_get_fd(pr), ctl->devname);
+			dev->reread = 1;
+		else
+			rereadpt(blkid_probe_get_fd(pr), dev->devname);
 	}
 #endif
 
 	if (close(blkid_probe_get_fd(pr)) != 0)
-		err(EXIT_FAILURE, _("%s: close device failed"), ctl->devname);
+		err(EXIT_FAILURE, _("%s: close device failed"), dev->devname);
 
 	blkid_free_probe(pr);
 	free(backup);
 	return 0;
 }
 
+static void print_json(struct wipe_device *devs, size_t ndevs)
+{
+	struct ul_jsonwrt json;
+	size_t i;
+
+	ul_jsonwrt_init(&json, stdout, 0);
+	ul_jsonwrt_root_open(&json);
+	ul_jsonwrt_array_open(&json, "devices");
+
+	for (i = 0; i < ndevs; i++) {
+		struct wipe_device *dev = &devs[i];
+		struct wipe_desc *w;
+
+		ul_jsonwrt_object_open(&json, NULL);
+		ul_jsonwrt_value_s(&json, "device", dev->devname);
+		ul_jsonwrt_value_s(&json, "status", dev->rc == 0 ? "ok" : "failed");
+		ul_jsonwrt_value_double(&json, "duration",
+				(long double) dev->time.tv_sec
+				+ (long double) dev->time.tv_usec / 1000000);
+
+		ul_jsonwrt_array_open(&json, "signatures");
+		for (w = dev->wiped; w; w = w->next) {
+			char *off = NULL;
+
+			xasprintf(&off, "0x%jx", (intmax_t) w->offset);
+			ul_jsonwrt_object_open(&json, NULL);
+			ul_jsonwrt_value_s(&json, "offset", off);
+			ul_jsonwrt_value_u64(&json, "length", w->len);
+			ul_jsonwrt_value_s(&json, "type", w->type);
+			ul_jsonwrt_value_s(&json, "usage", w->usage);
+			ul_jsonwrt_object_close(&json);
+			free(off);
+		}
+		ul_jsonwrt_array_close(&json);
+		ul_jsonwrt_object_close(&json);
+	}
+
+	ul_jsonwrt_array_close(&json);
+	ul_jsonwrt_root_close(&json);
+}
+
+#ifdef HAVE_PTHREAD
+/*
+ * --parallel
+ *
+ * Every worker takes the next device. The partition tables are re-read
+ * after all devices are erased.
+ */
+struct wipe_pool {
+	struct wipe_control *ctl;
+	struct wipe_device *devs;
+	size_t ndevs;
+	size_t next;		/* the next device for a worker */
+
+	pthread_mutex_t lock;
+};
+
+static void *wipe_worker(void *data)
+{
+	struct wipe_pool *pool = data;
+
+	for (;;) {
+		struct wipe_device *dev;
+
+		pthread_mutex_lock(&pool->lock);
+		if (pool->next >= pool->ndevs) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		dev = &pool->devs[pool->next++];
+		pthread_mutex_unlock(&pool->lock);
+
+		dev->rc = do_wipe(pool->ctl, dev);
+	}
+	return NULL;
+}
+
+/* returns 0 on success, -1 if no thread has been created */
+static int wipe_parallel(struct wipe_control *ctl, struct wipe_device *devs, size_t ndevs)
+{
+	struct wipe_pool pool = { .ctl = ctl, .devs = devs, .ndevs = ndevs };
+	pthread_t *threads;
+	size_t i, nthreads = 0;
+
+	pthread_mutex_init(&pool.lock, NULL);
+	threads = xcalloc(ctl->nthreads, sizeof(pthread_t));
+
+	for (i = 0; i < ctl->nthreads && i < ndevs; i++) {
+		if (pthread_create(&threads[nthreads], NULL, wipe_worker, &pool) != 0)
+			break;
+		nthreads++;
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&pool.lock);
+	free(threads);
+	return nthreads ? 0 : -1;
+}
+#endif /* HAVE_PTHREAD */
+
 
 static void __attribute__((__noreturn__))
 usage(void)
@@ -644,6 +818,9 @@ usage(void)
 	fputsln(_(" -p, --parsable       print out in parsable instead of printable format"), stdout);
 	fputsln(_(" -q, --quiet          suppress output messages"), stdout);
 	fputsln(_(" -t, --types <list>   limit the set of filesystem, RAIDs or partition tables"), stdout);
+#ifdef HAVE_PTHREAD
+	fputsln(_("     --parallel <num> erase up to <num> devices at the same time"), stdout);
+#endif
 	fprintf(stdout,
 	     _("     --lock[=<mode>] use exclusive device lock (%s, %s or %s)\n"), "yes", "no", "nonblock");
 
@@ -670,6 +847,7 @@ main(int argc, char **argv)
 	char *outarg = NULL;
 	enum {
 		OPT_LOCK = CHAR_MAX + 1,
+		OPT_PARALLEL,
 	};
 	static const struct option longopts[] = {
 	    { "all",       no_argument,       NULL, 'a' },
@@ -680,6 +858,9 @@ main(int argc, char **argv)
 	    { "no-act",    no_argument,       NULL, 'n' },
 	    { "offset",    required_argument, NULL, 'o' },
 	    { "parsable",  no_argument,       NULL, 'p' },
+#ifdef HAVE_PTHREAD
+	    { "parallel",  required_argument, NULL, OPT_PARALLEL },
+#endif
 	    { "quiet",     no_argument,       NULL, 'q' },
 	    { "types",     required_argument, NULL, 't' },
 	    { "version",   no_argument,       NULL, 'V' },
@@ -755,6 +936,11 @@ main(int argc, char **argv)
 				ctl.lockmode = optarg;
 			}
 			break;
+#ifdef HAVE_PTHREAD
+		case OPT_PARALLEL:
+			ctl.nthreads = strtou32_or_err(optarg, _("invalid parallel argument"));
+			break;
+#endif
 		case 'h':
 			usage();
 		case 'V':
@@ -813,11 +999,21 @@ main(int argc, char **argv)
 		/*
 		 * Erase
 		 */
-		ctl.ndevs = argc - optind;
-
-		while (optind < argc) {
-			ctl.devname = argv[optind++];
-			do_wipe(&ctl);
+		struct wipe_device *devs;
+		size_t ndevs = argc - optind;
+		int done = 0;
+
+		devs = xcalloc(ndevs, sizeof(struct wipe_device));
+		for (i = 0; i < ndevs; i++)
+			devs[i].devname = argv[optind + i];
+
+		ctl.ndevs = ndevs;
+#ifdef HAVE_PTHREAD
+		if (ctl.nthreads > 1 && ndevs > 1)
+			done = wipe_parallel(&ctl, devs, ndevs) == 0;
+#endif
+		for (i = 0; !done && i < ndevs; i++) {
+			devs[i].rc = do_wipe(&ctl, &devs[i]);
 			ctl.ndevs--;
 		}
 
@@ -825,17 +1021,25 @@ main(int argc, char **argv)
 		/* Re-read partition tables on whole-disk devices. This is
 		 * postponed until all is done to avoid conflicts.
 		 */
-		for (i = 0; i < ctl.nrereads; i++) {
-			char *devname = ctl.reread[i];
-			int fd = open(devname, O_RDONLY);
+		for (i = 0; i < ndevs; i++) {
+			const char *devname = devs[i].devname;
+			int fd;
 
+			if (!devs[i].reread)
+				continue;
+			fd = open(devname, O_RDONLY);
 			if (fd >= 0) {
 				rereadpt(fd, devname);
 				close(fd);
 			}
 		}
-		free(ctl.reread);
 #endif
+		if (ctl.json)
+			print_json(devs, ndevs);
+
+		for (i = 0; i < ndevs; i++)
+			free_wipe(devs[i].wiped);
+		free(devs);
 	}
 	return EXIT_SUCCESS;
 }
@@ -34,12 +34,16 @@
 #include "closestream.h"
 #include "strutils.h"
 #include "procfs.h"
+#include "optutils.h"
+#include "xalloc.h"
 #include "sched_attr.h"
 
 
 /* control struct */
 struct chrt_ctl {
-	pid_t	pid;
+	pid_t	*pids;				/* --pid or 0 for the command */
+	size_t	npids;
+	const char *cgroup;			/* --cgroup */
 	int	policy;				/* SCHED_* */
 	int	priority;
 
@@ -47,12 +51,30 @@ struct chrt_ctl {
 	uint64_t deadline;
 	uint64_t period;
 
+	size_t	nchanged;			/* --summary counters */
+	size_t	nunchanged;
+	size_t	nfailed;
+
 	unsigned int all_tasks : 1,		/* all threads of the PID */
 		     reset_on_fork : 1,		/* SCHED_RESET_ON_FORK or SCHED_FLAG_RESET_ON_FORK */
 		     altered : 1,		/* sched_set**() used */
+		     bulk : 1,			/* more tasks, don't exit on error */
+		     scanned : 1,		/* the task has been found in /proc or cgroup */
+		     summary : 1,		/* print counters rather than policies */
 		     verbose : 1;		/* verbose output */
 };
 
+/* the current setting of a task */
+struct chrt_sched {
+	int	policy;
+	int	priority;
+	int	reset_on_fork;
+
+	uint64_t runtime;
+	uint64_t deadline;
+	uint64_t period;
+};
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -61,10 +83,12 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Set policy:\n"
 	" chrt [options] <priority> <command> [<arg>...]\n"
-	" chrt [options] --pid <priority> <pid>\n"), out);
+	" chrt [options] --pid <priority> <pid>...\n"
+	" chrt [options] --cgroup <path> <priority>\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Get policy:\n"
-	" chrt [options] -p <pid>\n"), out);
+	" chrt [options] -p <pid>\n"
+	" chrt [options] --cgroup <path>\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Policy options:\n"), out);
@@ -85,8 +109,10 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Other options:\n"), out);
 	fputs(_(" -a, --all-tasks      operate on all the tasks (threads) for a given pid\n"), out);
+	fputs(_(" -g, --cgroup <path>  operate on all the tasks in the cgroup\n"), out);
 	fputs(_(" -m, --max            show min and max valid priorities\n"), out);
-	fputs(_(" -p, --pid            operate on existing given pid\n"), out);
+	fputs(_(" -p, --pid            operate on existing given pid(s)\n"), out);
+	fputs(_("     --summary        print number of changed tasks\n"), out);
 	fputs(_(" -v, --verbose        display status information\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -127,17 +153,11 @@ static const char *get_policy_name(int policy)
 	return _("unknown");
 }
 
-static void show_sched_pid_info(struct chrt_ctl *ctl, pid_t pid)
+/* returns 0 or -1 and errno */
+static int get_sched_pid(pid_t pid, struct chrt_sched *cs)
 {
-	int policy = -1, reset_on_fork = 0, prio = 0;
-#ifdef SCHED_DEADLINE
-	uint64_t deadline = 0, runtime = 0, period = 0;
-#endif
-
-	/* don't display "pid 0" as that is confusing */
-	if (!pid)
-		pid = getpid();
-
+	memset(cs, 0, sizeof(*cs));
+	cs->policy = -1;
 	errno = 0;
 
 	/*
@@ -150,15 +170,15 @@ static void show_sched_pid_info(struct chrt_ctl *ctl, pid_t pid)
 		if (sched_getattr(pid, &sa, sizeof(sa), 0) != 0) {
 			if (errno == ENOSYS)
 				goto fallback;
-			err(EXIT_FAILURE, _("failed to get pid %d's policy"), pid);
+			return -1;
 		}
 
-		policy = sa.sched_policy;
-		prio = sa.sched_priority;
-		reset_on_fork = sa.sched_flags & SCHED_FLAG_RESET_ON_FORK;
-		deadline = sa.sched_deadline;
-		runtime = sa.sched_runtime;
-		period = sa.sched_period;
+		cs->policy = sa.sched_policy;
+		cs->priority = sa.sched_priority;
+		cs->reset_on_fork = sa.sched_flags & SCHED_FLAG_RESET_ON_FORK ? 1 : 0;
+		cs->deadline = sa.sched_deadline;
+		cs->runtime = sa.sched_runtime;
+		cs->period = sa.sched_period;
 	}
 
 	/*
@@ -170,64 +190,139 @@ fallback:
 	{
 		struct sched_param sp;
 
-		policy = sched_getscheduler(pid);
-		if (policy == -1)
-			err(EXIT_FAILURE, _("failed to get pid %d's policy"), pid);
+		cs->policy = sched_getscheduler(pid);
+		if (cs->policy == -1)
+			return -1;
 
 		if (sched_getparam(pid, &sp) != 0)
-			err(EXIT_FAILURE, _("failed to get pid %d's attributes"), pid);
-		else
-			prio = sp.sched_priority;
+			return -1;
+		cs->priority = sp.sched_priority;
 # ifdef SCHED_RESET_ON_FORK
-		if (policy & SCHED_RESET_ON_FORK)
-			reset_on_fork = 1;
+		if (cs->policy & SCHED_RESET_ON_FORK)
+			cs->reset_on_fork = 1;
 # endif
 	}
+	return 0;
+}
+
+/* exits if only one task is requested, otherwise returns -1 */
+static int err_sched(struct chrt_ctl *ctl, pid_t pid, const char *msg)
+{
+	/* the thread has been terminated after scan */
+	if (ctl->bulk && ctl->scanned && errno == ESRCH)
+		return -1;
+	if (!ctl->bulk)
+		err(EXIT_FAILURE, msg, pid);
+
+	warn(msg, pid);
+	ctl->nfailed++;
+	return -1;
+}
+
+static int show_sched_pid_info(struct chrt_ctl *ctl, pid_t pid)
+{
+	struct chrt_sched cs;
+
+	/* don't display "pid 0" as that is confusing */
+	if (!pid)
+		pid = getpid();
+
+	if (get_sched_pid(pid, &cs) != 0)
+		return err_sched(ctl, pid, _("failed to get pid %d's policy"));
+
+	if (ctl->summary) {
+		if (!ctl->altered)
+			ctl->nunchanged++;
+		return 0;
+	}
 
 	if (ctl->altered)
-		printf(_("pid %d's new scheduling policy: %s"), pid, get_policy_name(policy));
+		printf(_("pid %d's new scheduling policy: %s"), pid, get_policy_name(cs.policy));
 	else
-		printf(_("pid %d's current scheduling policy: %s"), pid, get_policy_name(policy));
+		printf(_("pid %d's current scheduling policy: %s"), pid, get_policy_name(cs.policy));
 
-	if (reset_on_fork)
+	if (cs.reset_on_fork)
 		printf("|SCHED_RESET_ON_FORK");
 	putchar('\n');
 
 	if (ctl->altered)
-		printf(_("pid %d's new scheduling priority: %d\n"), pid, prio);
+		printf(_("pid %d's new scheduling priority: %d\n"), pid, cs.priority);
 	else
-		printf(_("pid %d's current scheduling priority: %d\n"), pid, prio);
+		printf(_("pid %d's current scheduling priority: %d\n"), pid, cs.priority);
 
 #ifdef SCHED_DEADLINE
-	if (policy == SCHED_DEADLINE) {
+	if (cs.policy == SCHED_DEADLINE) {
 		if (ctl->altered)
 			printf(_("pid %d's new runtime/deadline/period parameters: %ju/%ju/%ju\n"),
-					pid, runtime, deadline, period);
+					pid, cs.runtime, cs.deadline, cs.period);
 		else
 			printf(_("pid %d's current runtime/deadline/period parameters: %ju/%ju/%ju\n"),
-					pid, runtime, deadline, period);
+					pid, cs.runtime, cs.deadline, cs.period);
 	}
 #endif
+	return 0;
 }
 
-
-static void show_sched_info(struct chrt_ctl *ctl)
+/* calls @fn for all the requested tasks */
+static void for_each_task(struct chrt_ctl *ctl,
+			  int (*fn)(struct chrt_ctl *, pid_t))
 {
-	if (ctl->all_tasks) {
-#ifdef __linux__
-		DIR *sub = NULL;
-		pid_t tid;
-		struct path_cxt *pc = ul_new_procfs_path(ctl->pid, NULL);
+	size_t i;
 
-		while (pc && procfs_process_next_tid(pc, &sub, &tid) == 0)
-			show_sched_pid_info(ctl, tid);
+	if (ctl->cgroup) {
+		pid_t *tids = NULL;
+		size_t ntids = 0;
+		int rc = cgroup_get_tids(ctl->cgroup, &tids, &ntids);
 
-		ul_unref_path(pc);
+		if (rc < 0) {
+			errno = -rc;
+			err(EXIT_FAILURE, _("cannot read tasks of cgroup %s"), ctl->cgroup);
+		}
+		ctl->scanned = 1;
+		for (i = 0; i < ntids; i++)
+			fn(ctl, tids[i]);
+		free(tids);
+	}
+
+	for (i = 0; i < ctl->npids; i++) {
+		if (ctl->all_tasks) {
+#ifdef __linux__
+			struct path_cxt *pc = ul_new_procfs_path(ctl->pids[i], NULL);
+			struct procfs_iter *it = pc ? procfs_new_iter(pc) : NULL;
+			pid_t tid;
+
+			if (!it) {
+				warn(_("cannot obtain the list of tasks of pid %d"), ctl->pids[i]);
+				ctl->nfailed++;
+			}
+			ctl->scanned = 1;
+			while (it && procfs_iter_next(it, &tid) == 0)
+				fn(ctl, tid);
+
+			procfs_free_iter(it);
+			ul_unref_path(pc);
 #else
-		err(EXIT_FAILURE, _("cannot obtain the list of tasks"));
+			err(EXIT_FAILURE, _("cannot obtain the list of tasks"));
 #endif
-	} else
-		show_sched_pid_info(ctl, ctl->pid);
+		} else {
+			ctl->scanned = 0;
+			fn(ctl, ctl->pids[i]);
+		}
+	}
+}
+
+static void show_sched_info(struct chrt_ctl *ctl)
+{
+	for_each_task(ctl, show_sched_pid_info);
+}
+
+static void print_summary(struct chrt_ctl *ctl)
+{
+	size_t total = ctl->nchanged + ctl->nunchanged + ctl->nfailed;
+
+	printf(P_("%zu task: ", "%zu tasks: ", total), total);
+	printf(_("%zu changed, %zu unchanged, %zu failed\n"),
+		  ctl->nchanged, ctl->nunchanged, ctl->nfailed);
 }
 
 static void show_min_max(void)
@@ -319,41 +414,48 @@ static int set_sched_one(struct chrt_ctl *ctl, pid_t pid)
 }
 #endif /* HAVE_SCHED_SETATTR */
 
-static void set_sched(struct chrt_ctl *ctl)
+static int set_sched_task(struct chrt_ctl *ctl, pid_t pid)
 {
-	if (ctl->all_tasks) {
-#ifdef __linux__
-		DIR *sub = NULL;
-		pid_t tid;
-		struct path_cxt *pc = ul_new_procfs_path(ctl->pid, NULL);
+	struct chrt_sched old, cur;
 
-		if (!pc)
-			err(EXIT_FAILURE, _("cannot obtain the list of tasks"));
+	if (ctl->summary && get_sched_pid(pid, &old) != 0)
+		return err_sched(ctl, pid, _("failed to get pid %d's policy"));
 
-		while (procfs_process_next_tid(pc, &sub, &tid) == 0) {
-			if (set_sched_one(ctl, tid) == -1)
-				err(EXIT_FAILURE, _("failed to set tid %d's policy"), tid);
-		}
-		ul_unref_path(pc);
-#else
-		err(EXIT_FAILURE, _("cannot obtain the list of tasks"));
-#endif
-	} else if (set_sched_one(ctl, ctl->pid) == -1)
-		err(EXIT_FAILURE, _("failed to set pid %d's policy"), ctl->pid);
+	if (set_sched_one(ctl, pid) == -1)
+		return err_sched(ctl, pid, _("failed to set pid %d's policy"));
 
+	if (ctl->summary) {
+		if (get_sched_pid(pid, &cur) != 0)
+			return err_sched(ctl, pid, _("failed to get pid %d's policy"));
+		if (memcmp(&old, &cur, sizeof(old)) == 0)
+			ctl->nunchanged++;
+		else
+			ctl->nchanged++;
+	}
+	return 0;
+}
+
+static void set_sched(struct chrt_ctl *ctl)
+{
+	for_each_task(ctl, set_sched_task);
 	ctl->altered = 1;
 }
 
 int main(int argc, char **argv)
 {
-	struct chrt_ctl _ctl = { .pid = -1, .policy = SCHED_RR }, *ctl = &_ctl;
-	int c;
+	struct chrt_ctl _ctl = { .policy = SCHED_RR }, *ctl = &_ctl;
+	pid_t self = 0;
+	int c, use_pid = 0, nargs;
+	enum {
+		OPT_SUMMARY = CHAR_MAX + 1
+	};
 
 	static const struct option longopts[] = {
 		{ "all-tasks",  no_argument, NULL, 'a' },
 		{ "batch",	no_argument, NULL, 'b' },
 		{ "deadline",   no_argument, NULL, 'd' },
 		{ "fifo",	no_argument, NULL, 'f' },
+		{ "cgroup",	required_argument, NULL, 'g' },
 		{ "idle",	no_argument, NULL, 'i' },
 		{ "pid",	no_argument, NULL, 'p' },
 		{ "help",	no_argument, NULL, 'h' },
@@ -364,18 +466,27 @@ int main(int argc, char **argv)
 		{ "sched-period",   required_argument, NULL, 'P' },
 		{ "sched-deadline", required_argument, NULL, 'D' },
 		{ "reset-on-fork",  no_argument,       NULL, 'R' },
+		{ "summary",	no_argument, NULL, OPT_SUMMARY },
 		{ "verbose",	no_argument, NULL, 'v' },
 		{ "version",	no_argument, NULL, 'V' },
 		{ NULL,		no_argument, NULL, 0 }
 	};
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 'a', 'g' },
+		{ 'g', 'p' },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while((c = getopt_long(argc, argv, "+abdD:fiphmoP:T:rRvV", longopts, NULL)) != -1)
+	while((c = getopt_long(argc, argv, "+abdD:fg:iphmoP:T:rRvV", longopts, NULL)) != -1)
 	{
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'a':
 			ctl->all_tasks = 1;
@@ -394,6 +505,9 @@ int main(int argc, char **argv)
 		case 'f':
 			ctl->policy = SCHED_FIFO;
 			break;
+		case 'g':
+			ctl->cgroup = optarg;
+			break;
 		case 'R':
 			ctl->reset_on_fork = 1;
 			break;
@@ -409,8 +523,7 @@ int main(int argc, char **argv)
 			ctl->policy = SCHED_OTHER;
 			break;
 		case 'p':
-			errno = 0;
-			ctl->pid = strtos32_or_err(argv[argc - 1], _("invalid PID argument"));
+			use_pid = 1;
 			break;
 		case 'r':
 			ctl->policy = SCHED_RR;
@@ -418,6 +531,9 @@ int main(int argc, char **argv)
 		case 'v':
 			ctl->verbose = 1;
 			break;
+		case OPT_SUMMARY:
+			ctl->summary = 1;
+			break;
 		case 'T':
 			ctl->runtime = strtou64_or_err(optarg, _("invalid runtime argument"));
 			break;
@@ -437,17 +553,36 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (((ctl->pid > -1) && argc - optind < 1) ||
-	    ((ctl->pid == -1) && argc - optind < 2)) {
+	nargs = argc - optind;
+	if ((use_pid && nargs < 1) ||
+	    (ctl->cgroup && nargs > 1) ||
+	    (!use_pid && !ctl->cgroup && nargs < 2)) {
 		warnx(_("bad usage"));
 		errtryhelp(EXIT_FAILURE);
-}
+	}
+
+	if (use_pid) {
+		int first = nargs == 1 ? optind : optind + 1;
+		size_t i;
+
+		ctl->npids = argc - first;
+		ctl->pids = xcalloc(ctl->npids, sizeof(pid_t));
+		for (i = 0; i < ctl->npids; i++)
+			ctl->pids[i] = strtos32_or_err(argv[first + i], _("invalid PID argument"));
+	} else if (!ctl->cgroup) {
+		ctl->pids = &self;
+		ctl->npids = 1;
+	}
+	ctl->bulk = ctl->cgroup || ctl->all_tasks || ctl->npids > 1;
 
-	if ((ctl->pid > -1) && (ctl->verbose || argc - optind == 1)) {
+	if ((use_pid && nargs == 1) || (ctl->cgroup && nargs == 0)) {
 		show_sched_info(ctl);
-		if (argc - optind == 1)
-			return EXIT_SUCCESS;
+		if (ctl->summary)
+			print_summary(ctl);
+		return ctl->nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
 	}
+	if ((use_pid || ctl->cgroup) && ctl->verbose && !ctl->summary)
+		show_sched_info(ctl);
 
 	errno = 0;
 	ctl->priority = strtos32_or_err(argv[optind], _("invalid priority argument"));
@@ -471,8 +606,6 @@ int main(int argc, char **argv)
 	if (ctl->runtime || ctl->deadline || ctl->period)
 		errx(EXIT_FAILURE, _("SCHED_DEADLINE is unsupported"));
 #endif
-	if (ctl->pid == -1)
-		ctl->pid = 0;
 	if (ctl->priority < sched_get_priority_min(ctl->policy) ||
 	    sched_get_priority_max(ctl->policy) < ctl->priority)
 		errx(EXIT_FAILURE,
@@ -480,10 +613,15 @@ int main(int argc, char **argv)
 		     ctl->priority);
 	set_sched(ctl);
 
-	if (ctl->verbose)
+	if (ctl->summary)
+		print_summary(ctl);
+	else if (ctl->verbose)
 		show_sched_info(ctl);
 
-	if (!ctl->pid) {
+	if (ctl->pids != &self)
+		free(ctl->pids);
+
+	if (!use_pid && !ctl->cgroup) {
 		argv += optind + 1;
 		if (strcmp(argv[0], "--") == 0)
 			argv++;
@@ -491,5 +629,5 @@ int main(int argc, char **argv)
 		errexec(argv[0]);
 	}
 
-	return EXIT_SUCCESS;
+	return ctl->nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
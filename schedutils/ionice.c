@@ -20,6 +20,7 @@
 #include "strutils.h"
 #include "c.h"
 #include "closestream.h"
+#include "procfs.h"
 
 static int tolerant;
 
@@ -70,25 +71,29 @@ static int parse_ioclass(const char *str)
 	return -1;
 }
 
+static void ioprio_print_value(int ioprio)
+{
+	int ioclass = IOPRIO_PRIO_CLASS(ioprio);
+	const char *name = _("unknown");
+
+	if (ioclass >= 0 && (size_t) ioclass < ARRAY_SIZE(to_prio))
+		name = to_prio[ioclass];
+
+	if (ioclass != IOPRIO_CLASS_IDLE)
+		printf(_("%s: prio %lu\n"), name,
+		       IOPRIO_PRIO_DATA(ioprio));
+	else
+		printf("%s\n", name);
+}
+
 static void ioprio_print(int pid, int who)
 {
 	int ioprio = ioprio_get(who, pid);
 
 	if (ioprio == -1)
 		err(EXIT_FAILURE, _("ioprio_get failed"));
-	else {
-		int ioclass = IOPRIO_PRIO_CLASS(ioprio);
-		const char *name = _("unknown");
-
-		if (ioclass >= 0 && (size_t) ioclass < ARRAY_SIZE(to_prio))
-			name = to_prio[ioclass];
-
-		if (ioclass != IOPRIO_CLASS_IDLE)
-			printf(_("%s: prio %lu\n"), name,
-			       IOPRIO_PRIO_DATA(ioprio));
-		else
-			printf("%s\n", name);
-	}
+	else
+		ioprio_print_value(ioprio);
 }
 
 static void ioprio_setid(int which, int ioclass, int data, int who)
@@ -100,6 +105,44 @@ static void ioprio_setid(int which, int ioclass, int data, int who)
 		err(EXIT_FAILURE, _("ioprio_set failed"));
 }
 
+/*
+ * I/O priority is per-thread, so --cgroup operates on all threads in the
+ * cgroup; the threads terminated meanwhile are ignored.
+ */
+static int ioprio_print_task(pid_t tid, void *data __attribute__((__unused__)))
+{
+	int ioprio = ioprio_get(IOPRIO_WHO_PROCESS, tid);
+
+	if (ioprio == -1) {
+		if (errno == ESRCH)
+			return 0;
+		err(EXIT_FAILURE, _("ioprio_get failed"));
+	}
+	printf("%d: ", (int) tid);
+	ioprio_print_value(ioprio);
+	return 0;
+}
+
+static int ioprio_set_task(pid_t tid, void *data)
+{
+	if (ioprio_set(IOPRIO_WHO_PROCESS, tid, *((int *) data)) == -1) {
+		if (errno == ESRCH || tolerant)
+			return 0;
+		err(EXIT_FAILURE, _("ioprio_set failed"));
+	}
+	return 0;
+}
+
+static void ioprio_cgroup(const char *path, int (*fn)(pid_t, void *), void *data)
+{
+	int rc = cgroup_foreach_tid(path, fn, data);
+
+	if (rc < 0 && !tolerant) {
+		errno = -rc;
+		err(EXIT_FAILURE, _("cannot read tasks of cgroup %s"), path);
+	}
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -107,6 +150,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out,  _(" %1$s [options] -p <pid>...\n"
 			" %1$s [options] -P <pgid>...\n"
 			" %1$s [options] -u <uid>...\n"
+			" %1$s [options] -g <path>...\n"
 			" %1$s [options] <command>\n"), program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -117,6 +161,7 @@ static void __attribute__((__noreturn__)) usage(void)
 		"                          0: none, 1: realtime, 2: best-effort, 3: idle\n"), out);
 	fputs(_(" -n, --classdata <num>  priority (0..7) in the specified scheduling class,\n"
 		"                          only for the realtime and best-effort classes\n"), out);
+	fputs(_(" -g, --cgroup <path>... act on all threads in these cgroups\n"), out);
 	fputs(_(" -p, --pid <pid>...     act on these already running processes\n"), out);
 	fputs(_(" -P, --pgid <pgrp>...   act on already running processes in these groups\n"), out);
 	fputs(_(" -t, --ignore           ignore failures\n"), out);
@@ -134,11 +179,12 @@ int main(int argc, char **argv)
 {
 	int data = 4, set = 0, ioclass = IOPRIO_CLASS_BE, c;
 	int which = 0, who = 0;
-	const char *invalid_msg = NULL;
+	const char *invalid_msg = NULL, *cgroup = NULL;
 
 	static const struct option longopts[] = {
 		{ "classdata", required_argument, NULL, 'n' },
 		{ "class",     required_argument, NULL, 'c' },
+		{ "cgroup",    required_argument, NULL, 'g' },
 		{ "help",      no_argument,       NULL, 'h' },
 		{ "ignore",    no_argument,       NULL, 't' },
 		{ "pid",       required_argument, NULL, 'p' },
@@ -153,7 +199,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "+n:c:p:P:u:tVh", longopts, NULL)) != EOF)
+	while ((c = getopt_long(argc, argv, "+n:c:g:p:P:u:tVh", longopts, NULL)) != EOF)
 		switch (c) {
 		case 'n':
 			data = strtos32_or_err(optarg, _("invalid class data argument"));
@@ -173,29 +219,35 @@ int main(int argc, char **argv)
 			set |= 2;
 			break;
 		case 'p':
-			if (who)
+			if (who || cgroup)
 				errx(EXIT_FAILURE,
-				     _("can handle only one of pid, pgid or uid at once"));
+				     _("can handle only one of pid, pgid, uid or cgroup at once"));
 			invalid_msg = _("invalid PID argument");
 			which = strtos32_or_err(optarg, invalid_msg);
 			who = IOPRIO_WHO_PROCESS;
 			break;
 		case 'P':
-			if (who)
+			if (who || cgroup)
 				errx(EXIT_FAILURE,
-				     _("can handle only one of pid, pgid or uid at once"));
+				     _("can handle only one of pid, pgid, uid or cgroup at once"));
 			invalid_msg = _("invalid PGID argument");
 			which = strtos32_or_err(optarg, invalid_msg);
 			who = IOPRIO_WHO_PGRP;
 			break;
 		case 'u':
-			if (who)
+			if (who || cgroup)
 				errx(EXIT_FAILURE,
-				     _("can handle only one of pid, pgid or uid at once"));
+				     _("can handle only one of pid, pgid, uid or cgroup at once"));
 			invalid_msg = _("invalid UID argument");
 			which = strtos32_or_err(optarg, invalid_msg);
 			who = IOPRIO_WHO_USER;
 			break;
+		case 'g':
+			if (who || cgroup)
+				errx(EXIT_FAILURE,
+				     _("can handle only one of pid, pgid, uid or cgroup at once"));
+			cgroup = optarg;
+			break;
 		case 't':
 			tolerant = 1;
 			break;
@@ -228,7 +280,25 @@ int main(int argc, char **argv)
 			break;
 	}
 
-	if (!set && !which && optind == argc)
+	if (cgroup && !set) {
+		/*
+		 * ionice -g PATH [PATH ...]
+		 */
+		ioprio_cgroup(cgroup, ioprio_print_task, NULL);
+
+		for(; argv[optind]; ++optind)
+			ioprio_cgroup(argv[optind], ioprio_print_task, NULL);
+	} else if (cgroup) {
+		/*
+		 * ionice -c CLASS -g PATH [PATH ...]
+		 */
+		int ioprio = IOPRIO_PRIO_VALUE(ioclass, data);
+
+		ioprio_cgroup(cgroup, ioprio_set_task, &ioprio);
+
+		for(; argv[optind]; ++optind)
+			ioprio_cgroup(argv[optind], ioprio_set_task, &ioprio);
+	} else if (!set && !which && optind == argc)
 		/*
 		 * ionice without options, print the current ioprio
 		 */
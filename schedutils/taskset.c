@@ -34,6 +34,7 @@
 #include "procfs.h"
 #include "c.h"
 #include "closestream.h"
+#include "optutils.h"
 
 #ifndef PF_NO_SETAFFINITY
 # define PF_NO_SETAFFINITY 0x04000000
@@ -42,18 +43,27 @@
 struct taskset {
 	pid_t		pid;		/* task PID */
 	cpu_set_t	*set;		/* task CPU mask */
+	cpu_set_t	*oldset;	/* task CPU mask before change (--summary) */
 	size_t		setsize;
 	char		*buf;		/* buffer for conversion from mask to string */
 	size_t		buflen;
+
+	size_t		nchanged;	/* --summary counters */
+	size_t		nunchanged;
+	size_t		nfailed;
+
 	unsigned int	use_list:1,	/* use list rather than masks */
-			get_only:1;	/* print the mask, but not modify */
+			get_only:1,	/* print the mask, but not modify */
+			bulk:1,		/* more tasks, don't exit on error */
+			scanned:1,	/* the task has been found in /proc or cgroup */
+			summary:1;	/* print counters rather than masks */
 };
 
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
 	fprintf(out,
-		_("Usage: %s [options] [mask | cpu-list] [pid|cmd [args...]]\n\n"),
+		_("Usage: %s [options] [mask | cpu-list] [pid...|cmd [args...]]\n\n"),
 		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -63,8 +73,10 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out, _(
 		"Options:\n"
 		" -a, --all-tasks         operate on all the tasks (threads) for a given pid\n"
-		" -p, --pid               operate on existing given pid\n"
+		" -p, --pid               operate on existing given pid(s)\n"
+		" -g, --cgroup <path>     operate on all the tasks in the cgroup\n"
 		" -c, --cpu-list          display and specify cpus in list format\n"
+		"     --summary           print number of changed tasks rather than masks\n"
 		));
 	fprintf(out, USAGE_HELP_OPTIONS(25));
 
@@ -76,6 +88,8 @@ static void __attribute__((__noreturn__)) usage(void)
 		"    %1$s -p 700\n"
 		"Or set it:\n"
 		"    %1$s -p 03 700\n"
+		"    %1$s -p 03 700 701 702\n"
+		"    %1$s --cgroup system.slice/foo.service 03\n"
 		"List format uses a comma-separated list instead of a mask:\n"
 		"    %1$s -pc 0,3,7-11 700\n"
 		"Ranges in list format can take a stride argument:\n"
@@ -106,33 +120,56 @@ static void print_affinity(struct taskset *ts, int isnew)
 	printf(msg, ts->pid ? ts->pid : getpid(), str);
 }
 
-static void __attribute__((__noreturn__)) err_affinity(pid_t pid, int set)
+/* exits if only one task is requested, otherwise returns -1 */
+static int err_affinity(struct taskset *ts, int set)
 {
+	pid_t pid = ts->pid ? ts->pid : getpid();
 	char *msg;
 
+	/* the thread has been terminated after scan */
+	if (ts->bulk && ts->scanned && errno == ESRCH)
+		return -1;
+
 	msg = set ? _("failed to set pid %d's affinity") :
 		    _("failed to get pid %d's affinity");
+	if (!ts->bulk)
+		err(EXIT_FAILURE, msg, pid);
 
-	err(EXIT_FAILURE, msg, pid ? pid : getpid());
+	warn(msg, pid);
+	ts->nfailed++;
+	return -1;
 }
 
+static void print_summary(struct taskset *ts)
+{
+	size_t total = ts->nchanged + ts->nunchanged + ts->nfailed;
+
+	printf(P_("%zu task: ", "%zu tasks: ", total), total);
+	printf(_("%zu changed, %zu unchanged, %zu failed\n"),
+		  ts->nchanged, ts->nunchanged, ts->nfailed);
+}
 
-static void do_taskset(struct taskset *ts, size_t setsize, cpu_set_t *set)
+static int do_taskset(struct taskset *ts, size_t setsize, cpu_set_t *set)
 {
 	/* read the current mask */
 	if (ts->pid) {
 		if (sched_getaffinity(ts->pid, ts->setsize, ts->set) < 0)
-			err_affinity(ts->pid, 0);
-		print_affinity(ts, FALSE);
+			return err_affinity(ts, 0);
+		if (!ts->summary)
+			print_affinity(ts, FALSE);
 	}
 
-	if (ts->get_only)
-		return;
+	if (ts->get_only) {
+		ts->nunchanged++;
+		return 0;
+	}
+	if (ts->summary)
+		memcpy(ts->oldset, ts->set, ts->setsize);
 
 	/* set new mask */
 	if (sched_setaffinity(ts->pid, setsize, set) < 0) {
 		uintmax_t flags = 0;
-		struct path_cxt *pc;
+		struct path_cxt *pc = NULL;
 		int errsv = errno;
 
 		if (errno != EPERM
@@ -144,34 +181,93 @@ static void do_taskset(struct taskset *ts, size_t setsize, cpu_set_t *set)
 		} else
 			errno = errsv;
 
-		err_affinity(ts->pid, 1);
+		ul_unref_path(pc);
+		return err_affinity(ts, 1);
 	}
 
 	/* re-read the current mask */
 	if (ts->pid) {
 		if (sched_getaffinity(ts->pid, ts->setsize, ts->set) < 0)
-			err_affinity(ts->pid, 0);
-		print_affinity(ts, TRUE);
+			return err_affinity(ts, 0);
+		if (!ts->summary)
+			print_affinity(ts, TRUE);
+		else if (CPU_EQUAL_S(ts->setsize, ts->oldset, ts->set))
+			ts->nunchanged++;
+		else
+			ts->nchanged++;
 	}
+	return 0;
+}
+
+static void do_taskset_all_tasks(struct taskset *ts, pid_t pid,
+				 size_t setsize, cpu_set_t *set)
+{
+	struct path_cxt *pc = ul_new_procfs_path(pid, NULL);
+	struct procfs_iter *it = pc ? procfs_new_iter(pc) : NULL;
+
+	ts->scanned = 0;
+	if (!it) {
+		ts->pid = pid;
+		err_affinity(ts, !ts->get_only);
+	} else {
+		ts->scanned = 1;
+		while (procfs_iter_next(it, &ts->pid) == 0)
+			do_taskset(ts, setsize, set);
+	}
+	procfs_free_iter(it);
+	ul_unref_path(pc);
+}
+
+static void do_taskset_cgroup(struct taskset *ts, const char *cgroup,
+			      size_t setsize, cpu_set_t *set)
+{
+	pid_t *tids = NULL;
+	size_t i, ntids = 0;
+	int rc;
+
+	rc = cgroup_get_tids(cgroup, &tids, &ntids);
+	if (rc < 0) {
+		errno = -rc;
+		err(EXIT_FAILURE, _("cannot read tasks of cgroup %s"), cgroup);
+	}
+
+	ts->scanned = 1;
+	for (i = 0; i < ntids; i++) {
+		ts->pid = tids[i];
+		do_taskset(ts, setsize, set);
+	}
+	free(tids);
 }
 
 int main(int argc, char **argv)
 {
 	cpu_set_t *new_set;
-	pid_t pid = 0;
-	int c, all_tasks = 0;
+	pid_t *pids = NULL;
+	int c, all_tasks = 0, use_pid = 0, nargs;
 	int ncpus;
-	size_t new_setsize, nbits;
+	size_t new_setsize, nbits, npids = 0, i;
+	const char *cgroup = NULL;
 	struct taskset ts;
+	enum {
+		OPT_SUMMARY = CHAR_MAX + 1
+	};
 
 	static const struct option longopts[] = {
 		{ "all-tasks",	0, NULL, 'a' },
 		{ "pid",	0, NULL, 'p' },
+		{ "cgroup",	1, NULL, 'g' },
 		{ "cpu-list",	0, NULL, 'c' },
+		{ "summary",	0, NULL, OPT_SUMMARY },
 		{ "help",	0, NULL, 'h' },
 		{ "version",	0, NULL, 'V' },
 		{ NULL,		0, NULL,  0  }
 	};
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 'a', 'g' },
+		{ 'g', 'p' },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -180,18 +276,26 @@ int main(int argc, char **argv)
 
 	memset(&ts, 0, sizeof(ts));
 
-	while ((c = getopt_long(argc, argv, "+apchV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "+apg:chV", longopts, NULL)) != -1) {
+
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'a':
 			all_tasks = 1;
 			break;
 		case 'p':
-			pid = strtos32_or_err(argv[argc - 1],
-					    _("invalid PID argument"));
+			use_pid = 1;
+			break;
+		case 'g':
+			cgroup = optarg;
 			break;
 		case 'c':
 			ts.use_list = 1;
 			break;
+		case OPT_SUMMARY:
+			ts.summary = 1;
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -202,12 +306,24 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if ((!pid && argc - optind < 2)
-	    || (pid && (argc - optind < 1 || argc - optind > 2))) {
+	nargs = argc - optind;
+	if ((use_pid && nargs < 1)
+	    || (cgroup && nargs > 1)
+	    || (!use_pid && !cgroup && nargs < 2)) {
 		warnx(_("bad usage"));
 		errtryhelp(EXIT_FAILURE);
 	}
 
+	if (use_pid) {
+		int first = nargs == 1 ? optind : optind + 1;
+
+		npids = argc - first;
+		pids = xcalloc(npids, sizeof(pid_t));
+		for (i = 0; i < npids; i++)
+			pids[i] = strtos32_or_err(argv[first + i],
+						  _("invalid PID argument"));
+	}
+
 	ncpus = get_max_number_of_cpus();
 	if (ncpus <= 0)
 		errx(EXIT_FAILURE, _("cannot determine NR_CPUS; aborting"));
@@ -234,7 +350,13 @@ int main(int argc, char **argv)
 	if (!new_set)
 		err(EXIT_FAILURE, _("cpuset_alloc failed"));
 
-	if (argc - optind == 1)
+	if (ts.summary) {
+		ts.oldset = cpuset_alloc(ncpus, NULL, NULL);
+		if (!ts.oldset)
+			err(EXIT_FAILURE, _("cpuset_alloc failed"));
+	}
+
+	if ((use_pid && nargs == 1) || (cgroup && nargs == 0))
 		ts.get_only = 1;
 
 	else if (ts.use_list) {
@@ -246,28 +368,41 @@ int main(int argc, char **argv)
 		     argv[optind]);
 	}
 
-	if (all_tasks && pid) {
-		DIR *sub = NULL;
-		struct path_cxt *pc = ul_new_procfs_path(pid, NULL);
+	ts.bulk = cgroup || all_tasks || npids > 1;
 
-		while (pc && procfs_process_next_tid(pc, &sub, &ts.pid) == 0)
+	if (cgroup)
+		do_taskset_cgroup(&ts, cgroup, new_setsize, new_set);
+
+	for (i = 0; i < npids; i++) {
+		if (all_tasks && pids[i])
+			do_taskset_all_tasks(&ts, pids[i], new_setsize, new_set);
+		else {
+			ts.pid = pids[i];
+			ts.scanned = 0;
 			do_taskset(&ts, new_setsize, new_set);
+		}
+	}
 
-		ul_unref_path(pc);
-	} else {
-		ts.pid = pid;
+	if (!use_pid && !cgroup) {
+		ts.pid = 0;
 		do_taskset(&ts, new_setsize, new_set);
 	}
 
+	if (ts.summary)
+		print_summary(&ts);
+
+	free(pids);
 	free(ts.buf);
 	cpuset_free(ts.set);
+	if (ts.oldset)
+		cpuset_free(ts.oldset);
 	cpuset_free(new_set);
 
-	if (!pid) {
+	if (!use_pid && !cgroup) {
 		argv += optind + 1;
 		execvp(argv[0], argv);
 		errexec(argv[0]);
 	}
 
-	return EXIT_SUCCESS;
+	return ts.nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
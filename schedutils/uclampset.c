@@ -25,6 +25,7 @@
 #include <stdlib.h>
 
 #include "closestream.h"
+#include "optutils.h"
 #include "path.h"
 #include "pathnames.h"
 #include "procfs.h"
@@ -38,6 +39,7 @@ struct uclampset {
 	unsigned int util_max;
 
 	pid_t pid;
+	const char *cgroup;			/* --cgroup */
 	unsigned int	all_tasks:1,		/* all threads of the PID */
 			system:1,
 			util_min_set:1,		/* indicates -m option was passed */
@@ -54,7 +56,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_HEADER, out);
 	fprintf(out,
 		_(" %1$s [options]\n"
-		  " %1$s [options] --pid <pid> | --system | <command> <arg>...\n"),
+		  " %1$s [options] --pid <pid> | --cgroup <path> | --system | <command> <arg>...\n"),
 		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -65,6 +67,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -M <value>           util_max value to set\n"), out);
 	fputs(_(" -a, --all-tasks      operate on all the tasks (threads) for a given pid\n"), out);
 	fputs(_(" -p, --pid <pid>      operate on existing given pid\n"), out);
+	fputs(_(" -g, --cgroup <path>  operate on all the tasks in the cgroup\n"), out);
 	fputs(_(" -s, --system         operate on system\n"), out);
 	fputs(_(" -R, --reset-on-fork  set reset-on-fork flag\n"), out);
 	fputs(_(" -v, --verbose        display status information\n"), out);
@@ -79,7 +82,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	exit(EXIT_SUCCESS);
 }
 
-static void show_uclamp_pid_info(pid_t pid, char *cmd)
+/* @scanned: the task has been found in cgroup, ignore it if terminated */
+static void show_uclamp_pid_info(pid_t pid, char *cmd, int scanned)
 {
 	struct sched_attr sa;
 	char *comm;
@@ -88,8 +92,11 @@ static void show_uclamp_pid_info(pid_t pid, char *cmd)
 	if (!pid)
 		pid = getpid();
 
-	if (sched_getattr(pid, &sa, sizeof(sa), 0) != 0)
+	if (sched_getattr(pid, &sa, sizeof(sa), 0) != 0) {
+		if (scanned && errno == ESRCH)
+			return;
 		err(EXIT_FAILURE, _("failed to get pid %d's uclamp values"), pid);
+	}
 
 	if (cmd)
 		comm = cmd;
@@ -129,10 +136,28 @@ static void show_uclamp_system_info(void)
 	printf(_("System util_clamp: min: %u max: %u\n"), min, max);
 }
 
+static int show_uclamp_task_info(pid_t tid, void *data __attribute__((__unused__)))
+{
+	show_uclamp_pid_info(tid, NULL, 1);
+	return 0;
+}
+
+static void uclamp_cgroup(struct uclampset *ctl, int (*fn)(pid_t, void *))
+{
+	int rc = cgroup_foreach_tid(ctl->cgroup, fn, ctl);
+
+	if (rc < 0) {
+		errno = -rc;
+		err(EXIT_FAILURE, _("cannot read tasks of cgroup %s"), ctl->cgroup);
+	}
+}
+
 static void show_uclamp_info(struct uclampset *ctl)
 {
 	if (ctl->system) {
 		show_uclamp_system_info();
+	} else if (ctl->cgroup) {
+		uclamp_cgroup(ctl, show_uclamp_task_info);
 	} else if (ctl->all_tasks) {
 		DIR *sub = NULL;
 		pid_t tid;
@@ -142,11 +167,11 @@ static void show_uclamp_info(struct uclampset *ctl)
 			err(EXIT_FAILURE, _("cannot obtain the list of tasks"));
 
 		while (procfs_process_next_tid(pc, &sub, &tid) == 0)
-			show_uclamp_pid_info(tid, NULL);
+			show_uclamp_pid_info(tid, NULL, 0);
 
 		ul_unref_path(pc);
 	} else {
-		show_uclamp_pid_info(ctl->pid, ctl->cmd);
+		show_uclamp_pid_info(ctl->pid, ctl->cmd, 0);
 	}
 }
 
@@ -154,8 +179,11 @@ static int set_uclamp_one(struct uclampset *ctl, pid_t pid)
 {
 	struct sched_attr sa;
 
-	if (sched_getattr(pid, &sa, sizeof(sa), 0) != 0)
+	if (sched_getattr(pid, &sa, sizeof(sa), 0) != 0) {
+		if (ctl->cgroup && errno == ESRCH)
+			return -1;
 		err(EXIT_FAILURE, _("failed to get pid %d's uclamp values"), pid);
+	}
 
 	if (ctl->util_min_set)
 		sa.sched_util_min = ctl->util_min;
@@ -173,9 +201,24 @@ static int set_uclamp_one(struct uclampset *ctl, pid_t pid)
 	return sched_setattr(pid, &sa, 0);
 }
 
+static int set_uclamp_task(pid_t tid, void *data)
+{
+	struct uclampset *ctl = data;
+
+	if (set_uclamp_one(ctl, tid) == -1) {
+		/* the thread has been terminated after cgroup scan */
+		if (errno == ESRCH)
+			return 0;
+		err(EXIT_FAILURE, _("failed to set tid %d's uclamp values"), tid);
+	}
+	return 0;
+}
+
 static void set_uclamp_pid(struct uclampset *ctl)
 {
-	if (ctl->all_tasks) {
+	if (ctl->cgroup) {
+		uclamp_cgroup(ctl, set_uclamp_task);
+	} else if (ctl->all_tasks) {
 		DIR *sub = NULL;
 		pid_t tid;
 		struct path_cxt *pc = ul_new_procfs_path(ctl->pid, NULL);
@@ -225,6 +268,7 @@ int main(int argc, char **argv)
 	static const struct option longopts[] = {
 		{ "all-tasks",		no_argument, NULL, 'a' },
 		{ "pid",		required_argument, NULL, 'p' },
+		{ "cgroup",		required_argument, NULL, 'g' },
 		{ "system",		no_argument, NULL, 's' },
 		{ "reset-on-fork",	no_argument, NULL, 'R' },
 		{ "help",		no_argument, NULL, 'h' },
@@ -232,14 +276,22 @@ int main(int argc, char **argv)
 		{ "version",		no_argument, NULL, 'V' },
 		{ NULL,			no_argument, NULL, 0 }
 	};
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 'a', 'g' },
+		{ 'g', 'p', 's' },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while((c = getopt_long(argc, argv, "+asRp:hm:M:vV", longopts, NULL)) != -1)
+	while((c = getopt_long(argc, argv, "+asRp:g:hm:M:vV", longopts, NULL)) != -1)
 	{
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'a':
 			ctl->all_tasks = 1;
@@ -248,6 +300,9 @@ int main(int argc, char **argv)
 			errno = 0;
 			ctl->pid = strtos32_or_err(optarg, _("invalid PID argument"));
 			break;
+		case 'g':
+			ctl->cgroup = optarg;
+			break;
 		case 's':
 			ctl->system = 1;
 			break;
@@ -287,8 +342,8 @@ int main(int argc, char **argv)
 	}
 
 	if (!ctl->util_min_set && !ctl->util_max_set) {
-		/* -p or -s must be passed */
-		if (!ctl->system && ctl->pid == -1) {
+		/* -p, -g or -s must be passed */
+		if (!ctl->system && !ctl->cgroup && ctl->pid == -1) {
 			usage();
 			exit(EXIT_FAILURE);
 		}
@@ -297,8 +352,8 @@ int main(int argc, char **argv)
 		return EXIT_SUCCESS;
 	}
 
-	/* ensure there's a command to execute if no -s or -p */
-	if (!ctl->system && ctl->pid == -1) {
+	/* ensure there's a command to execute if no -s, -g or -p */
+	if (!ctl->system && !ctl->cgroup && ctl->pid == -1) {
 		if (argc <= optind) {
 			errno = EINVAL;
 			err(EXIT_FAILURE, _("no cmd to execute"));
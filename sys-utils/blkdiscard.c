@@ -48,18 +48,7 @@
 #include "closestream.h"
 #include "monotonic.h"
 #include "exitcodes.h"
-
-#ifndef BLKDISCARD
-# define BLKDISCARD	_IO(0x12,119)
-#endif
-
-#ifndef BLKSECDISCARD
-# define BLKSECDISCARD	_IO(0x12,125)
-#endif
-
-#ifndef BLKZEROOUT
-# define BLKZEROOUT	_IO(0x12,127)
-#endif
+#include "discard.h"
 
 enum {
 	ACT_DISCARD = 0,	/* default */
@@ -69,6 +58,13 @@ enum {
 
 static int quiet;
 
+struct progress {
+	int		act;
+	char		*path;
+	uint64_t	stats[2];	/* offset and length of the unreported bytes */
+	struct timeval	last;
+};
+
 static void print_stats(int act, char *path, uint64_t stats[])
 {
 	switch (act) {
@@ -96,6 +92,7 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -f, --force         disable all checking\n"), out);
+	fputs(_(" -j, --jobs <num>    discard by up to <num> threads\n"), out);
 	fputs(_(" -l, --length <num>  length of bytes to discard from the offset\n"), out);
 	fputs(_(" -o, --offset <num>  offset in bytes to discard from\n"), out);
 	fputs(_(" -p, --step <num>    size of the discard iterations within the offset\n"), out);
@@ -162,18 +159,48 @@ static void __attribute__((__noreturn__)) err_on_ioctl(
 	err(exno, _("%s: %s ioctl failed"), ioctlname, path);
 }
 
+/* reporting progress at most once per second */
+static void report_progress(struct ul_discard *dc, uint64_t done)
+{
+	struct progress *pg = dc->data;
+	struct timeval now;
+
+	pg->stats[1] = done - (pg->stats[0] - dc->start);
+
+	gettime_monotonic(&now);
+	if (now.tv_sec > pg->last.tv_sec &&
+	    (now.tv_usec >= pg->last.tv_usec || now.tv_sec > pg->last.tv_sec + 1)) {
+		print_stats(pg->act, pg->path, pg->stats);
+		pg->stats[0] += pg->stats[1], pg->stats[1] = 0;
+		pg->last = now;
+	}
+}
+
+static void print_throughput(struct ul_discard *dc, char *path)
+{
+	char *str = size_to_human_string(SIZE_SUFFIX_1LETTER,
+				ul_discard_get_throughput(dc));
+
+	printf(_("%s: %" PRIu64 " bytes in %" PRIu64 ".%06" PRIu64 " seconds (%s/s)\n"),
+		path, dc->done, dc->usec / 1000000, dc->usec % 1000000, str);
+	free(str);
+}
+
 int main(int argc, char **argv)
 {
 	char *path;
 	int c, fd, verbose = 0, secsize, force = 0;
-	uint64_t end, blksize, step, range[2], stats[2];
+	uint64_t end, blksize, step, range[2];
+	size_t njobs = 0;
 	struct stat sb;
-	struct timeval now = { 0 }, last = { 0 };
+	struct ul_discard dc;
+	struct progress pg = { 0 };
 	int act = ACT_DISCARD;
 
 	static const struct option longopts[] = {
 	    { "force",     no_argument,       NULL, 'f' },
 	    { "help",      no_argument,       NULL, 'h' },
+	    { "jobs",      required_argument, NULL, 'j' },
 	    { "length",    required_argument, NULL, 'l' },
 	    { "offset",    required_argument, NULL, 'o' },
 	    { "quiet",     no_argument,       NULL, 'q' },
@@ -194,11 +221,14 @@ int main(int argc, char **argv)
 	range[1] = ULLONG_MAX;
 	step = 0;
 
-	while ((c = getopt_long(argc, argv, "hfVsvo:l:p:qz", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hfj:Vsvo:l:p:qz", longopts, NULL)) != -1) {
 		switch(c) {
 		case 'f':
 			force = 1;
 			break;
+		case 'j':
+			njobs = strtou32_or_err(optarg, _("invalid jobs argument"));
+			break;
 		case 'l':
 			range[1] = strtosize_or_err(optarg,
 					_("failed to parse length"));
@@ -302,47 +332,47 @@ int main(int argc, char **argv)
 	}
 #endif /* HAVE_LIBBLKID */
 
-	stats[0] = range[0], stats[1] = 0;
-	gettime_monotonic(&last);
+	if (ul_discard_init(&dc, fd, act == ACT_ZEROOUT ? BLKZEROOUT :
+				     act == ACT_SECURE ? BLKSECDISCARD :
+							 BLKDISCARD,
+			    range[0], end) != 0)
+		err(EXIT_FAILURE, _("stat of %s failed"), path);
 
-	for (/* nothing */; range[0] < end; range[0] += range[1]) {
-		if (range[0] + range[1] > end)
-			range[1] = end - range[0];
+	dc.step = step;
+	dc.njobs = njobs;
 
-		errno = 0;
+	if (verbose && (step || njobs > 1)) {
+		pg.act = act;
+		pg.path = path;
+		pg.stats[0] = range[0];
+		gettime_monotonic(&pg.last);
 
-		switch (act) {
-		case ACT_ZEROOUT:
-			if (ioctl(fd, BLKZEROOUT, &range))
-				err_on_ioctl("BLKZEROOUT", path);
-			break;
-		case ACT_SECURE:
-			if (ioctl(fd, BLKSECDISCARD, &range))
-				err_on_ioctl("BLKSECDISCARD", path);
-			break;
-		case ACT_DISCARD:
-			if (ioctl(fd, BLKDISCARD, &range))
-				err_on_ioctl("BLKDISCARD", path);
-			break;
-		}
+		dc.progress = report_progress;
+		dc.data = &pg;
+	}
 
-		stats[1] += range[1];
+	if (ul_discard_range(&dc) != 0)
+		err_on_ioctl(act == ACT_ZEROOUT ? "BLKZEROOUT" :
+			     act == ACT_SECURE ? "BLKSECDISCARD" :
+						 "BLKDISCARD", path);
 
-		/* reporting progress at most once per second */
-		if (verbose && step) {
-			gettime_monotonic(&now);
-			if (now.tv_sec > last.tv_sec &&
-			    (now.tv_usec >= last.tv_usec || now.tv_sec > last.tv_sec + 1)) {
-				print_stats(act, path, stats);
-				stats[0] += stats[1], stats[1] = 0;
-				last = now;
-			}
+	if (verbose) {
+		uint64_t stats[2];
+
+		if (dc.progress) {
+			stats[0] = pg.stats[0];
+			stats[1] = pg.stats[1];
+		} else {
+			stats[0] = range[0];
+			stats[1] = dc.done;
 		}
+		if (stats[1])
+			print_stats(act, path, stats);
+		/* the duration is not stable, keep it out of pipes and logs */
+		if (isatty(STDOUT_FILENO))
+			print_throughput(&dc, path);
 	}
 
-	if (verbose && stats[1])
-		print_stats(act, path, stats);
-
 	close(fd);
 	return EXIT_SUCCESS;
 }
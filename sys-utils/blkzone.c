@@ -44,6 +44,7 @@
 #include "blkdev.h"
 #include "sysfs.h"
 #include "optutils.h"
+#include "discard.h"
 
 /*
  * These ioctls are defined in linux/blkzoned.h starting with kernel 5.5.
@@ -81,8 +82,10 @@ struct blkzone_control {
 	uint64_t offset;
 	uint64_t length;
 	uint32_t count;
+	size_t njobs;
 
 	unsigned int force : 1;
+	unsigned int summary : 1;
 	unsigned int verbose : 1;
 };
 
@@ -158,38 +161,50 @@ static int init_device(struct blkzone_control *ctl, int mode)
 }
 
 /*
- * Get the device zone size indicated by chunk sectors).
+ * Returns sysfs path of the whole-disk for the device, the zone limits are
+ * not available for partitions.
  */
-static unsigned long blkdev_chunk_sectors(const char *dname)
+static struct path_cxt *blkdev_disk_path(const char *dname)
 {
 	struct path_cxt *pc = NULL;
 	dev_t devno = sysfs_devname_to_devno(dname);
 	dev_t disk;
-	uint64_t sz = 0;
-	int rc;
 
 	/*
-	 * Mapping /dev/sdXn -> /sys/block/sdX to read the chunk_size entry.
+	 * Mapping /dev/sdXn -> /sys/block/sdX to read the queue/ entries.
 	 * This method masks off the partition specified by the minor device
 	 * component.
 	 */
 	pc = ul_new_sysfs_path(devno, NULL, NULL);
 	if (!pc)
-		return 0;
+		return NULL;
 
-	rc = sysfs_blkdev_get_wholedisk(pc, NULL, 0, &disk);
-	if (rc != 0)
-		goto done;
+	if (sysfs_blkdev_get_wholedisk(pc, NULL, 0, &disk) != 0)
+		goto fail;
 
 	/* if @pc is not while-disk device, switch to disk */
-	if (devno != disk) {
-		rc = sysfs_blkdev_init_path(pc, disk, NULL);
-		if (rc != 0)
-			goto done;
-	}
+	if (devno != disk && sysfs_blkdev_init_path(pc, disk, NULL) != 0)
+		goto fail;
+
+	return pc;
+fail:
+	ul_unref_path(pc);
+	return NULL;
+}
+
+/*
+ * Get the device zone size indicated by chunk sectors).
+ */
+static unsigned long blkdev_chunk_sectors(const char *dname)
+{
+	struct path_cxt *pc = blkdev_disk_path(dname);
+	uint64_t sz = 0;
+	int rc;
+
+	if (!pc)
+		return 0;
 
 	rc = ul_path_read_u64(pc, &sz, "queue/chunk_sectors");
-done:
 	ul_unref_path(pc);
 	return rc == 0 ? sz : 0;
 }
@@ -206,6 +221,38 @@ done:
  * blkzone report
  */
 #define DEF_REPORT_LEN		(1U << 12) /* 4k zones per report (256k kzalloc) */
+#define MAX_REPORT_LEN		(1U << 16) /* 64k zones per report (4M buffer) */
+#define ZONE_DESC_SIZE		64	   /* ZBC and ZNS zone descriptor */
+
+/*
+ * The driver reports zones by commands limited by the device transfer size
+ * (max_hw_sectors_kb and max_segments pages). Returns number of zones per
+ * one BLKREPORTZONE, the largest multiple of the zones per command, so the
+ * kernel does not end every ioctl by a short command.
+ */
+static uint32_t report_batch_size(const char *dname, uint32_t nr_zones)
+{
+	struct path_cxt *pc = blkdev_disk_path(dname);
+	uint64_t hw_kb = 0, segs = 0, bytes;
+	uint32_t per_cmd, len = DEF_REPORT_LEN;
+
+	if (pc) {
+		ul_path_read_u64(pc, &hw_kb, "queue/max_hw_sectors_kb");
+		ul_path_read_u64(pc, &segs, "queue/max_segments");
+		ul_unref_path(pc);
+	}
+
+	bytes = hw_kb * 1024;
+	if (segs)
+		bytes = min(bytes, segs * getpagesize());
+	per_cmd = bytes / ZONE_DESC_SIZE;
+
+	if (per_cmd)
+		len = min(max(MAX_REPORT_LEN / per_cmd, 1U) * per_cmd,
+			  MAX_REPORT_LEN);
+
+	return min(len, nr_zones);
+}
 
 static const char *type_text[] = {
 	"RESERVED",
@@ -226,13 +273,103 @@ static const char *condition_str[] = {
 	"of"  /* Offline */
 };
 
+/*
+ * blkzone report --summary
+ */
+#define ZONE_FILL_BUCKETS	10	/* 10% of zone capacity per bucket */
+
+struct zone_summary {
+	uint64_t nzones;
+	uint64_t types[ARRAY_SIZE(type_text)];
+	uint64_t conds[ARRAY_SIZE(condition_str)];
+
+	/* sequential zones by write pointer: empty, 0-9%, ..., 90-99%, full */
+	uint64_t fill[ZONE_FILL_BUCKETS + 2];
+
+	uint64_t capacity;	/* sum of zone capacities */
+	uint64_t written;	/* sum of written sectors in sequential zones */
+};
+
+static void summary_add(struct zone_summary *sum, const struct blk_zone *z,
+			uint64_t cap)
+{
+	size_t idx;
+
+	sum->nzones++;
+	sum->capacity += cap;
+	if (z->type < ARRAY_SIZE(type_text))
+		sum->types[z->type]++;
+	sum->conds[z->cond & (ARRAY_SIZE(condition_str) - 1)]++;
+
+	/* the write pointer is meaningful only for these conditions */
+	switch (z->cond) {
+	case BLK_ZONE_COND_EMPTY:
+	case BLK_ZONE_COND_IMP_OPEN:
+	case BLK_ZONE_COND_EXP_OPEN:
+	case BLK_ZONE_COND_CLOSED:
+	case BLK_ZONE_COND_FULL:
+		break;
+	default:
+		return;
+	}
+
+	if (z->cond == BLK_ZONE_COND_FULL || z->wp - z->start >= cap) {
+		idx = ZONE_FILL_BUCKETS + 1;
+		sum->written += cap;
+	} else if (z->wp == z->start)
+		idx = 0;
+	else {
+		idx = 1 + (z->wp - z->start) * ZONE_FILL_BUCKETS / cap;
+		sum->written += z->wp - z->start;
+	}
+	sum->fill[idx]++;
+}
+
+static void summary_print(const struct zone_summary *sum)
+{
+	size_t i;
+
+	printf(_("Zones: %"PRIu64"\n"), sum->nzones);
+	printf(_("Capacity: 0x%09"PRIx64", written: 0x%09"PRIx64"\n"),
+			sum->capacity, sum->written);
+
+	fputs(_("Types:\n"), stdout);
+	for (i = 0; i < ARRAY_SIZE(type_text); i++) {
+		if (sum->types[i])
+			printf("  %-20s %12"PRIu64"\n", type_text[i], sum->types[i]);
+	}
+
+	fputs(_("Conditions:\n"), stdout);
+	for (i = 0; i < ARRAY_SIZE(condition_str); i++) {
+		if (sum->conds[i])
+			printf("  %-20s %12"PRIu64"\n", condition_str[i], sum->conds[i]);
+	}
+
+	fputs(_("Write pointers:\n"), stdout);
+	for (i = 0; i < ARRAY_SIZE(sum->fill); i++) {
+		char buf[32];
+
+		if (i == 0)
+			xstrncpy(buf, _("empty"), sizeof(buf));
+		else if (i == ZONE_FILL_BUCKETS + 1)
+			xstrncpy(buf, _("full"), sizeof(buf));
+		else
+			snprintf(buf, sizeof(buf), "%zu-%zu%%",
+				(i - 1) * (100 / ZONE_FILL_BUCKETS),
+				i * (100 / ZONE_FILL_BUCKETS) - 1);
+
+		printf("  %-20s %12"PRIu64"\n", buf, sum->fill[i]);
+	}
+}
+
 static int blkzone_report(struct blkzone_control *ctl)
 {
 	bool only_capacity_sum = !strcmp(ctl->command->name, "capacity");
 	uint64_t capacity_sum = 0;
+	struct zone_summary sum = { .nzones = 0 };
 	struct blk_zone_report *zi;
 	unsigned long zonesize;
-	uint32_t i, nr_zones;
+	uint32_t i, nr_zones, batch;
 	int fd;
 
 	fd = init_device(ctl, O_RDONLY);
@@ -252,12 +389,13 @@ static int blkzone_report(struct blkzone_control *ctl)
 	else
 		nr_zones = 1 + (ctl->total_sectors - ctl->offset) / zonesize;
 
+	batch = report_batch_size(ctl->devname, nr_zones);
 	zi = xmalloc(sizeof(struct blk_zone_report) +
-		     (DEF_REPORT_LEN * sizeof(struct blk_zone)));
+		     (batch * sizeof(struct blk_zone)));
 
 	while (nr_zones && ctl->offset < ctl->total_sectors) {
 
-		zi->nr_zones = min(nr_zones, DEF_REPORT_LEN);
+		zi->nr_zones = min(nr_zones, batch);
 		zi->sector = ctl->offset;
 
 		if (ioctl(fd, BLKREPORTZONE, zi) == -1)
@@ -291,6 +429,8 @@ static int blkzone_report(struct blkzone_control *ctl)
 
 			if (only_capacity_sum) {
 				capacity_sum += cap;
+			} else if (ctl->summary) {
+				summary_add(&sum, &entry, cap);
 			} else if (has_zone_capacity(zi)) {
 				printf(_("  start: 0x%09"PRIx64", len 0x%06"PRIx64
 					", cap 0x%06"PRIx64", wptr 0x%06"PRIx64
@@ -317,6 +457,8 @@ static int blkzone_report(struct blkzone_control *ctl)
 
 	if (only_capacity_sum)
 		printf(_("0x%09"PRIx64"\n"), capacity_sum);
+	else if (ctl->summary)
+		summary_print(&sum);
 
 	free(zi);
 	close(fd);
@@ -329,7 +471,7 @@ static int blkzone_report(struct blkzone_control *ctl)
  */
 static int blkzone_action(struct blkzone_control *ctl)
 {
-	struct blk_zone_range za = { .sector = 0 };
+	struct ul_discard dc = { .request = ctl->command->ioctl_cmd };
 	unsigned long zonesize;
 	uint64_t zlen;
 	int fd;
@@ -364,10 +506,22 @@ static int blkzone_action(struct blkzone_control *ctl)
 			"to zone size %lu"),
 			ctl->devname, ctl->length, zonesize);
 
-	za.sector = ctl->offset;
-	za.nr_sectors = zlen;
+	/*
+	 * The zone range ioctls use the same {start, length} pair as discard,
+	 * so the ranges are split to zones and submitted by the discard
+	 * engine. Reset of the whole device is kept in one ioctl, the kernel
+	 * uses one "reset all" command in this case.
+	 */
+	dc.fd = fd;
+	dc.start = ctl->offset;
+	dc.end = ctl->offset + zlen;
+	dc.granularity = zonesize;
+	dc.njobs = ctl->njobs;
 
-	if (ioctl(fd, ctl->command->ioctl_cmd, &za) == -1)
+	if (dc.request == BLKRESETZONE && dc.start == 0 && zlen == ctl->total_sectors)
+		dc.njobs = 1;
+
+	if (ul_discard_range(&dc) != 0)
 		err(EXIT_FAILURE, _("%s: %s ioctl failed"),
 		    ctl->devname, ctl->command->ioctl_name);
 	else if (ctl->verbose)
@@ -400,6 +554,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -l, --length <sectors> maximum sectors to act (in 512-byte sectors)\n"), out);
 	fputs(_(" -c, --count <number>   maximum number of zones\n"), out);
 	fputs(_(" -f, --force            enforce on block devices used by the system\n"), out);
+	fputs(_(" -j, --jobs <num>       run zone action by up to <num> threads\n"), out);
+	fputs(_(" -s, --summary          report zone counts rather than every zone\n"), out);
 	fputs(_(" -v, --verbose          display more details\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(24));
@@ -424,6 +580,8 @@ int main(int argc, char **argv)
 	    { "length",  required_argument, NULL, 'l' }, /* max of sectors to operate on */
 	    { "offset",  required_argument, NULL, 'o' }, /* starting LBA */
 	    { "force",   no_argument,       NULL, 'f' },
+	    { "jobs",    required_argument, NULL, 'j' },
+	    { "summary", no_argument,       NULL, 's' },
 	    { "verbose", no_argument,       NULL, 'v' },
 	    { "version", no_argument,       NULL, 'V' },
 	    { NULL, 0, NULL, 0 }
@@ -448,7 +606,7 @@ int main(int argc, char **argv)
 		argc--;
 	}
 
-	while ((c = getopt_long(argc, argv, "hc:l:o:fvV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hc:l:o:fj:svV", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -468,6 +626,13 @@ int main(int argc, char **argv)
 		case 'f':
 			ctl.force = 1;
 			break;
+		case 'j':
+			ctl.njobs = strtou32_or_err(optarg,
+					_("invalid jobs argument"));
+			break;
+		case 's':
+			ctl.summary = 1;
+			break;
 		case 'v':
 			ctl.verbose = 1;
 			break;
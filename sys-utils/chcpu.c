@@ -42,6 +42,7 @@
 #include "path.h"
 #include "closestream.h"
 #include "optutils.h"
+#include "monotonic.h"
 
 #define EXCL_ERROR "--{configure,deconfigure,disable,dispatch,enable}"
 
@@ -53,6 +54,17 @@
 static cpu_set_t *onlinecpus;
 static int maxcpus;
 
+static struct timeval deadline;		/* --timeout, not set if zero */
+static int verbose;
+
+/* --verbose statistic */
+struct cpu_stat {
+	struct timeval	start;
+	int		ndone;		/* changed CPUs */
+	int		slowest;	/* CPU with the longest write */
+	uint64_t	max_usec;
+};
+
 #define is_cpu_online(cpu) (CPU_ISSET_S((cpu), CPU_ALLOC_SIZE(maxcpus), onlinecpus))
 #define num_online_cpus()  (CPU_COUNT_S(CPU_ALLOC_SIZE(maxcpus), onlinecpus))
 
@@ -66,6 +78,66 @@ enum {
 	CMD_CPU_DISPATCH_VERTICAL,
 };
 
+static uint64_t usec_since(struct timeval *start)
+{
+	struct timeval now;
+
+	gettime_monotonic(&now);
+	timersub(&now, start, &now);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+/* no more CPUs are changed when --timeout is over */
+static int is_timeout(void)
+{
+	struct timeval now;
+
+	if (!timerisset(&deadline))
+		return 0;
+	gettime_monotonic(&now);
+	return timercmp(&now, &deadline, >);
+}
+
+/*
+ * Writes @str to cpu<N>/<attr>. The write blocks until the kernel has
+ * finished the hotplug, its duration is returned by @usec.
+ */
+static int write_cpu_attr(struct path_cxt *sys, int cpu, const char *attr,
+			  const char *str, uint64_t *usec)
+{
+	struct timeval start;
+	int rc, errsv;
+
+	gettime_monotonic(&start);
+	rc = ul_path_writef_string(sys, str, "cpu%d/%s", cpu, attr);
+	errsv = errno;
+	*usec = usec_since(&start);
+	errno = errsv;
+	return rc;
+}
+
+static void stat_add_cpu(struct cpu_stat *st, int cpu, uint64_t usec)
+{
+	if (!st->ndone || usec > st->max_usec) {
+		st->max_usec = usec;
+		st->slowest = cpu;
+	}
+	st->ndone++;
+}
+
+static void print_stat(struct cpu_stat *st, int fails)
+{
+	printf(P_("%d CPU changed in %.3f seconds",
+		  "%d CPUs changed in %.3f seconds", st->ndone),
+		st->ndone, (double) usec_since(&st->start) / 1000000);
+	if (st->ndone)
+		printf(_(", the slowest CPU %u (%.3f ms)"),
+			st->slowest, (double) st->max_usec / 1000);
+	if (fails)
+		printf(P_(", %d failed", ", %d failed", fails), fails);
+	fputc('\n', stdout);
+}
+
 /* returns:   0 = success
  *          < 0 = failure
  *          > 0 = partial success
@@ -76,10 +148,20 @@ static int cpu_enable(struct path_cxt *sys, cpu_set_t *cpu_set, size_t setsize,
 	int online, rc;
 	int configured = -1;
 	int fails = 0;
+	struct cpu_stat st = { .ndone = 0 };
+	uint64_t usec;
+
+	gettime_monotonic(&st.start);
 
-	for (cpu = 0; cpu < maxcpus; cpu++) {
-		if (!CPU_ISSET_S(cpu, setsize, cpu_set))
+	cpuset_foreach(cpu, cpu_set, setsize) {
+		if (cpu >= maxcpus)
+			break;
+		if (is_timeout()) {
+			warnx(enable ? _("CPU %u enable skipped (timeout)") :
+				       _("CPU %u disable skipped (timeout)"), cpu);
+			fails++;
 			continue;
+		}
 		if (ul_path_accessf(sys, F_OK, "cpu%d", cpu) != 0) {
 			warnx(_("CPU %u does not exist"), cpu);
 			fails++;
@@ -103,33 +185,44 @@ static int cpu_enable(struct path_cxt *sys, cpu_set_t *cpu_set, size_t setsize,
 		if (ul_path_accessf(sys, F_OK, "cpu%d/configure", cpu) == 0)
 			ul_path_readf_s32(sys, &configured, "cpu%d/configure", cpu);
 		if (enable) {
-			rc = ul_path_writef_string(sys, "1", "cpu%d/online", cpu);
+			rc = write_cpu_attr(sys, cpu, "online", "1", &usec);
 			if (rc != 0 && configured == 0) {
 				warn(_("CPU %u enable failed (CPU is deconfigured)"), cpu);
 				fails++;
 			} else if (rc != 0) {
 				warn(_("CPU %u enable failed"), cpu);
 				fails++;
-			} else
-				printf(_("CPU %u enabled\n"), cpu);
+			} else {
+				if (verbose)
+					printf(_("CPU %u enabled (%.3f ms)\n"), cpu, (double) usec / 1000);
+				else
+					printf(_("CPU %u enabled\n"), cpu);
+				stat_add_cpu(&st, cpu, usec);
+			}
 		} else {
 			if (onlinecpus && num_online_cpus() == 1) {
 				warnx(_("CPU %u disable failed (last enabled CPU)"), cpu);
 				fails++;
 				continue;
 			}
-			rc = ul_path_writef_string(sys, "0", "cpu%d/online", cpu);
+			rc = write_cpu_attr(sys, cpu, "online", "0", &usec);
 			if (rc != 0) {
 				warn(_("CPU %u disable failed"), cpu);
 				fails++;
 			} else {
-				printf(_("CPU %u disabled\n"), cpu);
+				if (verbose)
+					printf(_("CPU %u disabled (%.3f ms)\n"), cpu, (double) usec / 1000);
+				else
+					printf(_("CPU %u disabled\n"), cpu);
+				stat_add_cpu(&st, cpu, usec);
 				if (onlinecpus)
 					CPU_CLR_S(cpu, setsize, onlinecpus);
 			}
 		}
 	}
 
+	if (verbose)
+		print_stat(&st, fails);
 	return fails == 0 ? 0 : fails == maxcpus ? -1 : 1;
 }
 
@@ -173,10 +266,20 @@ static int cpu_configure(struct path_cxt *sys, cpu_set_t *cpu_set, size_t setsiz
 	int cpu;
 	int rc, current;
 	int fails = 0;
+	struct cpu_stat st = { .ndone = 0 };
+	uint64_t usec;
 
-	for (cpu = 0; cpu < maxcpus; cpu++) {
-		if (!CPU_ISSET_S(cpu, setsize, cpu_set))
+	gettime_monotonic(&st.start);
+
+	cpuset_foreach(cpu, cpu_set, setsize) {
+		if (cpu >= maxcpus)
+			break;
+		if (is_timeout()) {
+			warnx(configure ? _("CPU %u configure skipped (timeout)") :
+					  _("CPU %u deconfigure skipped (timeout)"), cpu);
+			fails++;
 			continue;
+		}
 		if (ul_path_accessf(sys, F_OK, "cpu%d", cpu) != 0) {
 			warnx(_("CPU %u does not exist"), cpu);
 			fails++;
@@ -203,22 +306,34 @@ static int cpu_configure(struct path_cxt *sys, cpu_set_t *cpu_set, size_t setsiz
 			continue;
 		}
 		if (configure) {
-			rc = ul_path_writef_string(sys, "1", "cpu%d/configure", cpu);
+			rc = write_cpu_attr(sys, cpu, "configure", "1", &usec);
 			if (rc != 0) {
 				warn(_("CPU %u configure failed"), cpu);
 				fails++;
-			} else
-				printf(_("CPU %u configured\n"), cpu);
+			} else {
+				if (verbose)
+					printf(_("CPU %u configured (%.3f ms)\n"), cpu, (double) usec / 1000);
+				else
+					printf(_("CPU %u configured\n"), cpu);
+				stat_add_cpu(&st, cpu, usec);
+			}
 		} else {
-			rc = ul_path_writef_string(sys, "0", "cpu%d/configure", cpu);
+			rc = write_cpu_attr(sys, cpu, "configure", "0", &usec);
 			if (rc != 0) {
 				warn(_("CPU %u deconfigure failed"), cpu);
 				fails++;
-			} else
-				printf(_("CPU %u deconfigured\n"), cpu);
+			} else {
+				if (verbose)
+					printf(_("CPU %u deconfigured (%.3f ms)\n"), cpu, (double) usec / 1000);
+				else
+					printf(_("CPU %u deconfigured\n"), cpu);
+				stat_add_cpu(&st, cpu, usec);
+			}
 		}
 	}
 
+	if (verbose)
+		print_stat(&st, fails);
 	return fails == 0 ? 0 : fails == maxcpus ? -1 : 1;
 }
 
@@ -252,6 +367,8 @@ static void __attribute__((__noreturn__)) usage(void)
 		" -g, --deconfigure <cpu-list>  deconfigure cpus\n"
 		" -p, --dispatch <mode>         set dispatching mode\n"
 		" -r, --rescan                  trigger rescan of cpus\n"
+		" -t, --timeout <seconds>       don't change more cpus after the timeout\n"
+		" -v, --verbose                 print duration of the changes\n"
 		), stdout);
 	fprintf(stdout, USAGE_HELP_OPTIONS(31));
 
@@ -264,6 +381,7 @@ int main(int argc, char *argv[])
 	struct path_cxt *sys = NULL;	/* _PATH_SYS_CPU handler */
 	cpu_set_t *cpu_set = NULL;
 	size_t setsize;
+	struct timeval timeout = { 0 };
 	int cmd = -1;
 	int c, rc;
 
@@ -275,6 +393,8 @@ int main(int argc, char *argv[])
 		{ "enable",	required_argument, NULL, 'e' },
 		{ "help",	no_argument,       NULL, 'h' },
 		{ "rescan",	no_argument,       NULL, 'r' },
+		{ "timeout",	required_argument, NULL, 't' },
+		{ "verbose",	no_argument,       NULL, 'v' },
 		{ "version",	no_argument,       NULL, 'V' },
 		{ NULL,		0, NULL, 0 }
 	};
@@ -308,7 +428,7 @@ int main(int argc, char *argv[])
 
 	setsize = CPU_ALLOC_SIZE(maxcpus);
 
-	while ((c = getopt_long(argc, argv, "c:d:e:g:hp:rV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "c:d:e:g:hp:rt:vV", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -341,6 +461,12 @@ int main(int argc, char *argv[])
 		case 'r':
 			cmd = CMD_CPU_RESCAN;
 			break;
+		case 't':
+			strtotimeval_or_err(optarg, &timeout, _("invalid timeout argument"));
+			break;
+		case 'v':
+			verbose = 1;
+			break;
 
 		case 'h':
 			usage();
@@ -356,6 +482,11 @@ int main(int argc, char *argv[])
 		errtryhelp(EXIT_FAILURE);
 	}
 
+	if (timerisset(&timeout)) {
+		gettime_monotonic(&deadline);
+		timeradd(&deadline, &timeout, &deadline);
+	}
+
 	switch (cmd) {
 	case CMD_CPU_ENABLE:
 		rc = cpu_enable(sys, cpu_set, maxcpus, 1);
@@ -32,12 +32,17 @@
 #include "optutils.h"
 #include "closestream.h"
 #include "xalloc.h"
+#include "monotonic.h"
 
 /* partial success, otherwise we return regular EXIT_{SUCCESS,FAILURE} */
 #define CHMEM_EXIT_SOMEOK		64
 
 #define _PATH_SYS_MEMORY		"/sys/devices/system/memory"
 
+/* --retry delay, doubled after every attempt */
+#define CHMEM_RETRY_DELAY		(100 * 1000)
+#define CHMEM_RETRY_DELAY_MAX		(2 * 1000 * 1000)
+
 struct chmem_desc {
 	struct path_cxt	*sysmem;	/* _PATH_SYS_MEMORY handler */
 	struct dirent	**dirs;
@@ -46,6 +51,8 @@ struct chmem_desc {
 	uint64_t	start;
 	uint64_t	end;
 	uint64_t	size;
+	uint64_t	done;		/* number of changed blocks */
+	unsigned int	retries;	/* --retry */
 	unsigned int	use_blocks : 1;
 	unsigned int	is_size	   : 1;
 	unsigned int	verbose	   : 1;
@@ -101,9 +108,54 @@ static void idxtostr(struct chmem_desc *desc, uint64_t idx, char *buf, size_t bu
 		 idx, start, end);
 }
 
+/*
+ * Reads state and valid_zones (if available) of the block @name, the
+ * attributes are read by one directory lookup. Returns the state, the zones
+ * are returned by @zones; both are empty strings if not available.
+ */
+static const char *read_block_attrs(struct chmem_desc *desc, const char *name,
+				    const char **zones)
+{
+	struct ul_path_attr attrs[] = {
+		{ .name = "state" },
+		{ .name = "valid_zones" }	/* the last, optional */
+	};
+
+	ul_path_read_attrs(desc->sysmem, name, attrs,
+			   ARRAY_SIZE(attrs) - (desc->have_zones ? 0 : 1), NULL);
+
+	*zones = desc->have_zones && attrs[1].value ? attrs[1].value : "";
+	return attrs[0].value ? attrs[0].value : "";
+}
+
+/*
+ * Writes the new state of the block @name. Offline fails with EBUSY if some
+ * pages cannot be migrated right now and the hotplug may be interrupted
+ * (EAGAIN, EINTR), so try it again up to --retry times with a growing delay.
+ */
+static int write_block_state(struct chmem_desc *desc, const char *name,
+			     const char *str, const char *onoff)
+{
+	unsigned int delay = CHMEM_RETRY_DELAY, n = 0;
+	int rc;
+
+	while ((rc = ul_path_writef_string(desc->sysmem, onoff, "%s/state", name)) != 0
+	       && n++ < desc->retries
+	       && (errno == EBUSY || errno == EAGAIN || errno == EINTR)) {
+		if (desc->verbose)
+			fprintf(stdout, _("%s %s failed, retrying\n"), str, onoff);
+		xusleep(delay);
+		delay = min(delay * 2, (unsigned int) CHMEM_RETRY_DELAY_MAX);
+	}
+	if (rc == 0)
+		desc->done++;
+	return rc;
+}
+
 static int chmem_size(struct chmem_desc *desc, int enable, int zone_id)
 {
-	char *name, *onoff, line[BUFSIZ], str[BUFSIZ];
+	char *name, *onoff, str[BUFSIZ];
+	const char *line, *zones;
 	uint64_t size, index;
 	const char *zn;
 	int i, rc;
@@ -123,12 +175,12 @@ static int chmem_size(struct chmem_desc *desc, int enable, int zone_id)
 		name = desc->dirs[i]->d_name;
 		index = strtou64_or_err(name + 6, _("Failed to parse index"));
 
-		if (ul_path_readf_buffer(desc->sysmem, line, sizeof(line), "%s/state", name) > 0
-		    && strncmp(onoff, line, 6) == 0)
+		line = read_block_attrs(desc, name, &zones);
+		if (*line && strncmp(onoff, line, 6) == 0)
 			continue;
 
 		if (desc->have_zones) {
-			ul_path_readf_buffer(desc->sysmem, line, sizeof(line), "%s/valid_zones", name);
+			line = zones;
 			if (zone_id >= 0) {
 				zn = zone_names[zone_id];
 				if (enable && !strcasestr(line, zn))
@@ -145,7 +197,7 @@ static int chmem_size(struct chmem_desc *desc, int enable, int zone_id)
 		}
 
 		idxtostr(desc, index, str, sizeof(str));
-		rc = ul_path_writef_string(desc->sysmem, onoff, "%s/state", name);
+		rc = write_block_state(desc, name, str, onoff);
 		if (rc != 0 && desc->verbose) {
 			if (enable)
 				fprintf(stdout, _("%s enable failed\n"), str);
@@ -175,9 +227,27 @@ static int chmem_size(struct chmem_desc *desc, int enable, int zone_id)
 	return size == 0 ? 0 : size == desc->size ? -1 : 1;
 }
 
+/* returns the first dirs[] entry with index >= @start, the dirs are sorted */
+static int find_first_block(struct chmem_desc *desc, uint64_t start)
+{
+	int lo = 0, hi = desc->ndirs;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		uint64_t index = strtou64_or_err(desc->dirs[mid]->d_name + 6,
+						 _("Failed to parse index"));
+		if (index < start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 {
-	char *name, *onoff, line[BUFSIZ], str[BUFSIZ];
+	char *name, *onoff, str[BUFSIZ];
+	const char *line, *zones;
 	uint64_t index, todo;
 	const char *zn;
 	int i, rc;
@@ -192,16 +262,14 @@ static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 			onoff = "online_kernel";
 	}
 
-	for (i = 0; i < desc->ndirs; i++) {
+	for (i = find_first_block(desc, desc->start); i < desc->ndirs; i++) {
 		name = desc->dirs[i]->d_name;
 		index = strtou64_or_err(name + 6, _("Failed to parse index"));
-		if (index < desc->start)
-			continue;
 		if (index > desc->end)
 			break;
 		idxtostr(desc, index, str, sizeof(str));
-		if (ul_path_readf_buffer(desc->sysmem, line, sizeof(line), "%s/state", name) > 0
-		    && strncmp(onoff, line, 6) == 0) {
+		line = read_block_attrs(desc, name, &zones);
+		if (*line && strncmp(onoff, line, 6) == 0) {
 			if (desc->verbose && enable)
 				fprintf(stdout, _("%s already enabled\n"), str);
 			else if (desc->verbose && !enable)
@@ -211,7 +279,7 @@ static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 		}
 
 		if (desc->have_zones) {
-			ul_path_readf_buffer(desc->sysmem, line, sizeof(line), "%s/valid_zones", name);
+			line = zones;
 			if (zone_id >= 0) {
 				zn = zone_names[zone_id];
 				if (enable && !strcasestr(line, zn)) {
@@ -231,7 +299,7 @@ static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 			}
 		}
 
-		rc = ul_path_writef_string(desc->sysmem, onoff, "%s/state", name);
+		rc = write_block_state(desc, name, str, onoff);
 		if (rc != 0) {
 			if (enable)
 				warn(_("%s enable failed"), str);
@@ -249,6 +317,31 @@ static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 	return todo == 0 ? 0 : todo == desc->end - desc->start + 1 ? -1 : 1;
 }
 
+static void print_throughput(struct chmem_desc *desc, int enable,
+			     struct timeval *start, struct timeval *end)
+{
+	struct timeval tv;
+	uint64_t bytes = desc->done * desc->block_size, usec;
+	char *sizestr, *ratestr;
+
+	timersub(end, start, &tv);
+	usec = (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+	if (!desc->done || !usec)
+		return;
+
+	sizestr = size_to_human_string(SIZE_SUFFIX_1LETTER, bytes);
+	ratestr = size_to_human_string(SIZE_SUFFIX_1LETTER,
+				(uint64_t) ((double) bytes * 1000000 / usec));
+	if (enable)
+		fprintf(stdout, _("%s enabled in %.3f seconds (%s/s)\n"),
+			sizestr, (double) usec / 1000000, ratestr);
+	else
+		fprintf(stdout, _("%s disabled in %.3f seconds (%s/s)\n"),
+			sizestr, (double) usec / 1000000, ratestr);
+	free(sizestr);
+	free(ratestr);
+}
+
 static int filter(const struct dirent *de)
 {
 	if (strncmp("memory", de->d_name, 6) != 0)
@@ -347,6 +440,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -d, --disable      disable memory\n"), out);
 	fputs(_(" -b, --blocks       use memory blocks\n"), out);
 	fputs(_(" -z, --zone <name>  select memory zone (see below)\n"), out);
+	fputs(_(" -r, --retry <num>  retry failed blocks up to <num> times\n"), out);
 	fputs(_(" -v, --verbose      verbose output\n"), out);
 	fprintf(out, USAGE_HELP_OPTIONS(20));
 
@@ -363,6 +457,7 @@ int main(int argc, char **argv)
 {
 	struct chmem_desc _desc = { 0 }, *desc = &_desc;
 	int cmd = CMD_NONE, zone_id = -1;
+	struct timeval start, end;
 	char *zone = NULL;
 	int c, rc;
 
@@ -371,6 +466,7 @@ int main(int argc, char **argv)
 		{"disable",	no_argument,		NULL, 'd'},
 		{"enable",	no_argument,		NULL, 'e'},
 		{"help",	no_argument,		NULL, 'h'},
+		{"retry",	required_argument,	NULL, 'r'},
 		{"verbose",	no_argument,		NULL, 'v'},
 		{"version",	no_argument,		NULL, 'V'},
 		{"zone",	required_argument,	NULL, 'z'},
@@ -395,7 +491,7 @@ int main(int argc, char **argv)
 
 	read_info(desc);
 
-	while ((c = getopt_long(argc, argv, "bdehvVz:", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "bdehr:vVz:", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -409,6 +505,9 @@ int main(int argc, char **argv)
 		case 'b':
 			desc->use_blocks = 1;
 			break;
+		case 'r':
+			desc->retries = strtou32_or_err(optarg, _("invalid retry argument"));
+			break;
 		case 'v':
 			desc->verbose = 1;
 			break;
@@ -447,10 +546,15 @@ int main(int argc, char **argv)
 		}
 	}
 
+	gettime_monotonic(&start);
 	if (desc->is_size)
 		rc = chmem_size(desc, cmd == CMD_MEMORY_ENABLE ? 1 : 0, zone_id);
 	else
 		rc = chmem_range(desc, cmd == CMD_MEMORY_ENABLE ? 1 : 0, zone_id);
+	gettime_monotonic(&end);
+
+	if (desc->verbose)
+		print_throughput(desc, cmd == CMD_MEMORY_ENABLE ? 1 : 0, &start, &end);
 
 	ul_unref_path(desc->sysmem);
 
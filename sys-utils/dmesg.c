@@ -27,6 +27,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #include "c.h"
 #include "colors.h"
@@ -216,6 +217,7 @@ struct dmesg_control {
 	 * able to buffer at least that much in one call
 	 */
 	char		kmsg_buf[2048]; /* buffer to read kmsg data */
+	uint64_t	kmsg_seq;	/* sequence number of the last record */
 
 	usec_t		since;		/* filter records by time */
 	usec_t		until;		/* filter records by time */
@@ -243,8 +245,10 @@ struct dmesg_control {
 			pager:1,	/* pipe output into a pager */
 			color:1,	/* colorize messages */
 			json:1,		/* JSON output */
-			force_prefix:1;	/* force timestamp and decode prefix
+			force_prefix:1,	/* force timestamp and decode prefix
 					   on each line */
+			kmsg_seq_valid:1,	/* kmsg_seq is set */
+			kmsg_overrun:1;	/* EPIPE, records have been overwritten */
 	int		indent;		/* due to timestamps if newline */
 	size_t          caller_id_size;   /* PRINTK_CALLERID max field size */
 };
@@ -257,6 +261,7 @@ struct dmesg_record {
 	int		facility;
 	struct timeval  tv;
 	char		caller_id[PID_CHARS_MAX];
+	uint64_t	seq;		/* kmsg sequence number */
 
 	const char	*next;		/* buffer with next unparsed record */
 	size_t		next_size;	/* size of the next buffer */
@@ -270,6 +275,7 @@ struct dmesg_record {
 		(_r)->tv.tv_sec = 0; \
 		(_r)->tv.tv_usec = 0; \
 		(_r)->caller_id[0] = 0; \
+		(_r)->seq = 0; \
 	} while (0)
 
 static int process_kmsg(struct dmesg_control *ctl);
@@ -1346,8 +1352,6 @@ done:
 	free(mesg_copy);
 	if (ctl->json) {
 		ul_jsonwrt_object_close(&ctl->jfmt);
-		if (ctl->follow)
-			ul_jsonwrt_flush(&ctl->jfmt);
 	} else {
 		putchar('\n');
 	}
@@ -1371,29 +1375,45 @@ static void print_buffer(struct dmesg_control *ctl,
 		print_record(ctl, &rec);
 }
 
+/*
+ * Every read() returns one record. The kmsg is always non-blocking; for
+ * --follow the output is flushed and poll() waits for a new record only when
+ * all available records have been read, so the records are printed by
+ * batches rather than by one write() per record.
+ */
 static ssize_t read_kmsg_one(struct dmesg_control *ctl)
 {
 	ssize_t size;
 
-	/* kmsg returns EPIPE if record was modified while reading */
-	do {
+	for (;;) {
 		size = read(ctl->kmsg, ctl->kmsg_buf,
 			    sizeof(ctl->kmsg_buf) - 1);
-	} while (size < 0 && errno == EPIPE);
+		if (size >= 0)
+			break;
+
+		/* kmsg returns EPIPE if the next record has been overwritten
+		 * by the kernel, the next read() returns the oldest record */
+		if (errno == EPIPE) {
+			ctl->kmsg_overrun = 1;
+			continue;
+		}
+		if (errno == EAGAIN && ctl->follow) {
+			struct pollfd fds = { .fd = ctl->kmsg, .events = POLLIN };
+
+			fflush(stdout);
+			if (poll(&fds, 1, -1) < 0 && errno != EINTR)
+				break;
+			continue;
+		}
+		break;
+	}
 
 	return size;
 }
 
 static int init_kmsg(struct dmesg_control *ctl)
 {
-	int mode = O_RDONLY;
-
-	if (!ctl->follow)
-		mode |= O_NONBLOCK;
-	else
-		setlinebuf(stdout);
-
-	ctl->kmsg = open("/dev/kmsg", mode);
+	ctl->kmsg = open("/dev/kmsg", O_RDONLY | O_NONBLOCK);
 	if (ctl->kmsg < 0)
 		return -1;
 
@@ -1461,6 +1481,7 @@ static int parse_kmsg_record(struct dmesg_control *ctl,
 		goto mesg;
 
 	/* B) sequence number */
+	rec->seq = strtoull(p, NULL, 10);
 	p = skip_item(p, end, ",;");
 	if (LAST_KMSG_FIELD(p))
 		goto mesg;
@@ -1543,8 +1564,19 @@ static int process_kmsg(struct dmesg_control *ctl)
 		*(ctl->kmsg_buf + sz) = '\0';	/* for debug messages */
 
 		if (parse_kmsg_record(ctl, &rec,
-				      ctl->kmsg_buf, (size_t) sz) == 0)
+				      ctl->kmsg_buf, (size_t) sz) == 0) {
+			if (ctl->kmsg_overrun && ctl->kmsg_seq_valid
+			    && rec.seq > ctl->kmsg_seq + 1) {
+				fflush(stdout);
+				warnx(_("%" PRIu64 " messages have been lost"),
+				      rec.seq - ctl->kmsg_seq - 1);
+			}
+			ctl->kmsg_overrun = 0;
+			ctl->kmsg_seq = rec.seq;
+			ctl->kmsg_seq_valid = 1;
+
 			print_record(ctl, &rec);
+		}
 
 		sz = read_kmsg_one(ctl);
 	}
@@ -1552,6 +1584,56 @@ static int process_kmsg(struct dmesg_control *ctl)
 	return 0;
 }
 
+/* returns the time of the kmsg file record at @p like parse_kmsg_record() */
+static usec_t kmsg_file_record_time(struct dmesg_control *ctl,
+				    const char *p, const char *end)
+{
+	struct dmesg_record rec;
+
+	INIT_DMESG_RECORD(&rec);
+
+	p = skip_item(p, end, ",;");		/* faclev */
+	if (!LAST_KMSG_FIELD(p))
+		p = skip_item(p, end, ",;");	/* sequence number */
+	if (!LAST_KMSG_FIELD(p) && p < end)
+		parse_kmsg_timestamp(p, &rec.tv);
+
+	return record_time(ctl, &rec);
+}
+
+/*
+ * Returns offset of the first record in the kmsg file @buf with time greater
+ * than @tm. The records are sorted by the sequence number, so the timestamps
+ * are monotonic and it's enough to parse a few records by binary search
+ * rather than all the records before the --since/--until window.
+ */
+static size_t kmsg_file_find_time(struct dmesg_control *ctl,
+				  const char *buf, size_t size, usec_t tm)
+{
+	size_t lo = 0, hi = size;	/* both are the record starts */
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2, start = mid, next;
+
+		/* the start of the record which contains @mid */
+		while (start > lo && buf[start - 1] != '\0')
+			start--;
+
+		if (kmsg_file_record_time(ctl, buf + start, buf + size) > tm) {
+			hi = start;
+			continue;
+		}
+
+		/* the next record */
+		next = mid;
+		while (next < hi && buf[next] != '\0')
+			next++;
+		lo = next < hi ? next + 1 : hi;
+	}
+
+	return lo;
+}
+
 static int process_kmsg_file(struct dmesg_control *ctl, char **buf)
 {
 	char str[sizeof(ctl->kmsg_buf)];
@@ -1566,6 +1648,15 @@ static int process_kmsg_file(struct dmesg_control *ctl, char **buf)
 	if (sz == -1)
 		return -1;
 
+	/* skip the records out of --since and --until */
+	if (ctl->until && sz > 0)
+		sz = kmsg_file_find_time(ctl, ctl->mmap_buff, sz, ctl->until - 1);
+	if (ctl->since && sz > 0) {
+		len = kmsg_file_find_time(ctl, ctl->mmap_buff, sz, ctl->since);
+		ctl->mmap_buff += len;
+		sz -= len;
+	}
+
 	while (sz > 0) {
 		len = strnlen(ctl->mmap_buff, sz);
 		if (len > sizeof(str))
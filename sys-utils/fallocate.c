@@ -33,6 +33,9 @@
 #include <getopt.h>
 #include <limits.h>
 #include <string.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #ifndef HAVE_FALLOCATE
 # include <sys/syscall.h>
@@ -72,6 +75,7 @@
 #include "closestream.h"
 #include "xalloc.h"
 #include "optutils.h"
+#include "iszero.h"
 
 static int verbose;
 static char *filename;
@@ -99,6 +103,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -x, --posix          use posix_fallocate(3) instead of fallocate(2)\n"), out);
 #endif
 	fputs(_(" -v, --verbose        verbose mode\n"), out);
+	fputs(_("     --threads <num>  number of threads to dig holes\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(22));
@@ -151,135 +156,258 @@ static void xposix_fallocate(int fd, off_t offset, off_t length)
 }
 #endif
 
-/* The real buffer size has to be bufsize + sizeof(uintptr_t) */
-static int is_nul(void *buf, size_t bufsize)
-{
-	typedef uintptr_t word;
-	void const *vp;
-	char const *cbuf = buf, *cp;
-	word const *wp = buf;
-
-	/* set sentinel */
-	memset((char *) buf + bufsize, '\1', sizeof(word));
+/* the read buffer and the unit of page cache discarding */
+#define DIG_BUFSZ	(1024 * 1024)
 
-	/* Find first nonzero *word*, or the word with the sentinel.  */
-	while (*wp++ == 0)
-		continue;
+/* the file is split to chunks of this size for --threads */
+#define DIG_CHUNKSZ	(64 * 1024 * 1024)
 
-	/* Find the first nonzero *byte*, or the sentinel.  */
-	vp = wp - 1;
-	cp = vp;
-
-	while (*cp++ == 0)
-		continue;
+/*
+ * A part of a data area. The zeroes inside the chunk are punched by the
+ * worker; the zeroes at the begin and the end of the chunk are punched later
+ * together with the zeroes of the neighbouring chunks.
+ */
+struct dig_chunk {
+	off_t	start;
+	off_t	end;
+	off_t	head;		/* zero bytes from start */
+	off_t	tail;		/* zero bytes before end */
+};
+
+struct dig_control {
+	int			fd;
+	size_t			blksz;
+	off_t			size;		/* of the file */
+
+	struct dig_chunk	*chunks;
+	size_t			nchunks;
+	size_t			next;		/* the next chunk for a worker */
+
+	uintmax_t		ct;		/* punched bytes */
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t		lock;
+#endif
+};
 
-	return cbuf + bufsize < cp;
+static inline void dig_lock(struct dig_control *dig __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&dig->lock);
+#endif
 }
 
-static void dig_holes(int fd, off_t file_off, off_t len)
+static inline void dig_unlock(struct dig_control *dig __attribute__((__unused__)))
 {
-	off_t file_end = len ? file_off + len : 0;
-	off_t hole_start = 0, hole_sz = 0;
-	uintmax_t ct = 0;
-	size_t  bufsz;
-	char *buf;
-	struct stat st;
-#if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
-	off_t cache_start = file_off;
-	/*
-	 * We don't want to call POSIX_FADV_DONTNEED to discard cached
-	 * data in PAGE_SIZE steps. IMHO it's overkill (too many syscalls).
-	 *
-	 * Let's assume that 1MiB (on system with 4K page size) is just
-	 * a good compromise.
-	 *					    -- kzak Feb-2014
-	 */
-	const size_t cachesz = getpagesize() * 256;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&dig->lock);
 #endif
+}
 
-	if (fstat(fd, &st) != 0)
-		err(EXIT_FAILURE, _("stat of %s failed"), filename);
+static void dig_punch(struct dig_control *dig, off_t start, off_t end)
+{
+	off_t len = end - start;
 
-	bufsz = st.st_blksize;
+	/* meet block boundary at the end of the file */
+	if (end == dig->size && end % dig->blksz)
+		len += dig->blksz - end % dig->blksz;
 
-	if (lseek(fd, file_off, SEEK_SET) < 0)
-		err(EXIT_FAILURE, _("seek on %s failed"), filename);
+	xfallocate(dig->fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, start, len);
+
+	dig_lock(dig);
+	dig->ct += end - start;
+	dig_unlock(dig);
+}
+
+/* splits the data areas of the range to chunks, the holes are skipped */
+static void dig_add_chunks(struct dig_control *dig, off_t file_off, off_t file_end)
+{
+	size_t nalloc = 0;
 
-	/* buffer + extra space for is_nul() sentinel */
-	buf = xmalloc(bufsz + sizeof(uintptr_t));
 	while (file_end == 0 || file_off < file_end) {
-		/*
-		 * Detect data area (skip holes)
-		 */
 		off_t end, off;
 
-		off = lseek(fd, file_off, SEEK_DATA);
+		off = lseek(dig->fd, file_off, SEEK_DATA);
 		if ((off == -1 && errno == ENXIO) ||
 		    (file_end && off >= file_end))
 			break;
 
-		end = lseek(fd, off, SEEK_HOLE);
+		end = lseek(dig->fd, off, SEEK_HOLE);
 		if (file_end && end > file_end)
 			end = file_end;
 
 		if (off < 0 || end < 0)
 			break;
 
+		for (file_off = off; file_off < end; ) {
+			struct dig_chunk *ch;
+
+			if (dig->nchunks == nalloc) {
+				nalloc = max(nalloc * 2, (size_t) 64);
+				dig->chunks = xreallocarray(dig->chunks, nalloc,
+							    sizeof(struct dig_chunk));
+			}
+			ch = &dig->chunks[dig->nchunks++];
+			memset(ch, 0, sizeof(*ch));
+			ch->start = file_off;
+			ch->end = min(end, file_off + DIG_CHUNKSZ);
+			file_off = ch->end;
+		}
+	}
+}
+
+static void dig_chunk(struct dig_control *dig, struct dig_chunk *ch, char *buf)
+{
+	off_t off = ch->start, hole_start = -1;
+
 #if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
-		(void) posix_fadvise(fd, off, end, POSIX_FADV_SEQUENTIAL);
+	(void) posix_fadvise(dig->fd, ch->start, ch->end - ch->start,
+			     POSIX_FADV_SEQUENTIAL);
 #endif
-		/*
-		 * Dig holes in the area
-		 */
-		while (off < end) {
-			ssize_t rsz = pread(fd, buf, bufsz, off);
-			if (rsz < 0 && errno)
-				err(EXIT_FAILURE, _("%s: read failed"), filename);
-			if (end && rsz > 0 && off > end - rsz)
-				rsz = end - off;
-			if (rsz <= 0)
-				break;
-
-			if (is_nul(buf, rsz)) {
-				if (!hole_sz)				/* new hole detected */
-					hole_start = off;
-				hole_sz += rsz;
-			 } else if (hole_sz) {
-				xfallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE,
-					   hole_start, hole_sz);
-				ct += hole_sz;
-				hole_sz = hole_start = 0;
-			}
+	while (off < ch->end) {
+		ssize_t rsz, i;
 
-#if defined(POSIX_FADV_DONTNEED) && defined(HAVE_POSIX_FADVISE)
-			/* discard cached data */
-			if (off - cache_start > (off_t) cachesz) {
-				size_t clen = off - cache_start;
+		rsz = pread(dig->fd, buf, min((off_t) DIG_BUFSZ, ch->end - off), off);
+		if (rsz < 0)
+			err(EXIT_FAILURE, _("%s: read failed"), filename);
+		if (rsz == 0)
+			break;
 
-				clen = (clen / cachesz) * cachesz;
-				(void) posix_fadvise(fd, cache_start, clen, POSIX_FADV_DONTNEED);
-				cache_start = cache_start + clen;
+		for (i = 0; i < rsz; i += dig->blksz) {
+			size_t sz = min((size_t) (rsz - i), dig->blksz);
+
+			if (ul_buffer_is_zero(buf + i, sz)) {
+				if (hole_start < 0)		/* new hole detected */
+					hole_start = off + i;
+			} else if (hole_start >= 0) {
+				if (hole_start == ch->start)
+					ch->head = off + i - hole_start;
+				else
+					dig_punch(dig, hole_start, off + i);
+				hole_start = -1;
 			}
+		}
+#if defined(POSIX_FADV_DONTNEED) && defined(HAVE_POSIX_FADVISE)
+		/* discard cached data */
+		(void) posix_fadvise(dig->fd, off, rsz, POSIX_FADV_DONTNEED);
+#endif
+		off += rsz;
+	}
+
+	if (off < ch->end)
+		ch->end = off;				/* truncated file */
+	if (hole_start >= 0) {
+		ch->tail = ch->end - hole_start;
+		if (hole_start == ch->start)
+			ch->head = ch->tail;
+	}
+}
+
+static void *dig_worker(void *data)
+{
+	struct dig_control *dig = data;
+	char *buf = xmalloc(DIG_BUFSZ);
+
+	for (;;) {
+		struct dig_chunk *ch = NULL;
+
+		dig_lock(dig);
+		if (dig->next < dig->nchunks)
+			ch = &dig->chunks[dig->next++];
+		dig_unlock(dig);
+
+		if (!ch)
+			break;
+		dig_chunk(dig, ch, buf);
+	}
+
+	free(buf);
+	return NULL;
+}
+
+#ifdef HAVE_PTHREAD
+/* returns the number of threads, zero if no thread has been created */
+static size_t dig_run_workers(struct dig_control *dig, size_t njobs)
+{
+	pthread_t *threads;
+	size_t i, nthreads = 0;
+
+	threads = calloc(njobs, sizeof(pthread_t));
+	if (!threads)
+		return 0;
+
+	for (i = 0; i < njobs; i++) {
+		if (pthread_create(&threads[nthreads], NULL, dig_worker, dig) != 0)
+			break;
+		nthreads++;
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	return nthreads;
+}
 #endif
-			off += rsz;
+
+/* punches the zeroes at the chunk boundaries, adjacent ones together */
+static void dig_merge_chunks(struct dig_control *dig)
+{
+	off_t hole_start = -1, hole_end = 0;
+	size_t i;
+
+	for (i = 0; i < dig->nchunks; i++) {
+		struct dig_chunk *ch = &dig->chunks[i];
+		int whole = ch->head && ch->head == ch->end - ch->start;
+
+		if (ch->head) {
+			if (hole_start < 0)
+				hole_start = ch->start;
+			hole_end = ch->start + ch->head;
+		}
+		if (whole)
+			continue;
+		if (hole_start >= 0) {
+			dig_punch(dig, hole_start, hole_end);
+			hole_start = -1;
 		}
-		if (hole_sz) {
-			off_t alloc_sz = hole_sz;
-			if (off >= end)
-				alloc_sz += st.st_blksize;		/* meet block boundary */
-			xfallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE,
-					hole_start, alloc_sz);
-			ct += hole_sz;
+		if (ch->tail) {
+			hole_start = ch->end - ch->tail;
+			hole_end = ch->end;
 		}
-		file_off = off;
 	}
+	if (hole_start >= 0)
+		dig_punch(dig, hole_start, hole_end);
+}
 
-	free(buf);
+static void dig_holes(int fd, off_t file_off, off_t len, size_t nthreads)
+{
+	struct dig_control dig = { .fd = fd };
+	struct stat st;
+
+	if (fstat(fd, &st) != 0)
+		err(EXIT_FAILURE, _("stat of %s failed"), filename);
+
+	dig.blksz = st.st_blksize;
+	dig.size = st.st_size;
+
+	dig_add_chunks(&dig, file_off, len ? file_off + len : 0);
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init(&dig.lock, NULL);
+	if (nthreads < 2 || dig.nchunks < 2 ||
+	    !dig_run_workers(&dig, min(nthreads, dig.nchunks)))
+#endif
+		dig_worker(&dig);
+
+	dig_merge_chunks(&dig);
+#ifdef HAVE_PTHREAD
+	pthread_mutex_destroy(&dig.lock);
+#endif
+	free(dig.chunks);
 
 	if (verbose) {
-		char *str = size_to_human_string(SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE, ct);
+		char *str = size_to_human_string(SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE, dig.ct);
 		fprintf(stdout, _("%s: %s (%ju bytes) converted to sparse holes.\n"),
-				filename, str, ct);
+				filename, str, dig.ct);
 		free(str);
 	}
 }
@@ -295,6 +423,11 @@ int main(int argc, char **argv)
 #endif
 	loff_t	length = -2LL;
 	loff_t	offset = 0;
+	size_t	nthreads = 1;
+
+	enum {
+		OPT_THREADS = CHAR_MAX + 1
+	};
 
 	static const struct option longopts[] = {
 	    { "help",           no_argument,       NULL, 'h' },
@@ -309,6 +442,7 @@ int main(int argc, char **argv)
 	    { "length",         required_argument, NULL, 'l' },
 	    { "posix",          no_argument,       NULL, 'x' },
 	    { "verbose",        no_argument,       NULL, 'v' },
+	    { "threads",        required_argument, NULL, OPT_THREADS },
 	    { NULL, 0, NULL, 0 }
 	};
 
@@ -365,6 +499,12 @@ int main(int argc, char **argv)
 		case 'v':
 			verbose++;
 			break;
+		case OPT_THREADS:
+			nthreads = str2unum_or_err(optarg, 10,
+					_("failed to parse number of threads"), 1024);
+			if (!nthreads)
+				nthreads = 1;
+			break;
 
 		case 'h':
 			usage();
@@ -407,7 +547,7 @@ int main(int argc, char **argv)
 		err(EXIT_FAILURE, _("cannot open %s"), filename);
 
 	if (dig)
-		dig_holes(fd, offset, length);
+		dig_holes(fd, offset, length, nthreads);
 	else {
 #ifdef HAVE_POSIX_FALLOCATE
 		if (posix)
@@ -19,13 +19,18 @@
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <getopt.h>
+#include <signal.h>
 
 #include "c.h"
 #include "blkdev.h"
 #include "nls.h"
 #include "closestream.h"
 #include "optutils.h"
+#include "strutils.h"
+#include "xalloc.h"
+#include "monotonic.h"
 
 enum fs_operation {
 	NOOP,
@@ -33,37 +38,233 @@ enum fs_operation {
 	UNFREEZE
 };
 
+struct fsfreeze_target {
+	const char	*path;
+	int		fd;
+	dev_t		devno;
+
+	pid_t		pid;		/* FIFREEZE child process */
+	struct timeval	start;		/* when FIFREEZE was issued */
+	struct timeval	latency;
+
+	unsigned int	frozen : 1,
+			done : 1;
+};
+
+static volatile sig_atomic_t sig_die;
+
+static void sig_handler(int signo __attribute__((__unused__)))
+{
+	sig_die = 1;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
 	fputs(USAGE_HEADER, out);
 	fprintf(out,
-	      _(" %s [options] <mountpoint>\n"), program_invocation_short_name);
+	      _(" %s [options] <mountpoint>...\n"), program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Suspend access to a filesystem.\n"), out);
 
 	fputs(USAGE_OPTIONS, out);
-	fputs(_(" -f, --freeze      freeze the filesystem\n"), out);
-	fputs(_(" -u, --unfreeze    unfreeze the filesystem\n"), out);
+	fputs(_(" -f, --freeze          freeze the filesystem\n"), out);
+	fputs(_(" -u, --unfreeze        unfreeze the filesystem\n"), out);
+	fputs(_(" -t, --timeout <sec>   maximal time to freeze all filesystems\n"), out);
+	fputs(_(" -v, --verbose         print freeze latency of the filesystems\n"), out);
 	fputs(USAGE_SEPARATOR, out);
-	fprintf(out, USAGE_HELP_OPTIONS(19));
+	fprintf(out, USAGE_HELP_OPTIONS(23));
 	fprintf(out, USAGE_MAN_TAIL("fsfreeze(8)"));
 
 	exit(EXIT_SUCCESS);
 }
 
+static int open_target(struct fsfreeze_target *tg)
+{
+	struct stat sb;
+
+	tg->fd = open(tg->path, O_RDONLY);
+	if (tg->fd < 0) {
+		warn(_("cannot open %s"), tg->path);
+		return -errno;
+	}
+	if (fstat(tg->fd, &sb) == -1) {
+		warn(_("stat of %s failed"), tg->path);
+		return -errno;
+	}
+	if (!S_ISDIR(sb.st_mode)) {
+		warnx(_("%s: is not a directory"), tg->path);
+		return -EINVAL;
+	}
+	tg->devno = sb.st_dev;
+	return 0;
+}
+
+static int thaw_target(struct fsfreeze_target *tg)
+{
+	if (ioctl(tg->fd, FITHAW, 0)) {
+		warn(_("%s: unfreeze failed"), tg->path);
+		return -errno;
+	}
+	tg->frozen = 0;
+	return 0;
+}
+
+/* thaw in reverse order */
+static int thaw_targets(struct fsfreeze_target *tgs, size_t ntgs, int frozen_only)
+{
+	size_t i;
+	int rc = 0;
+
+	for (i = ntgs; i > 0; i--) {
+		struct fsfreeze_target *tg = &tgs[i - 1];
+
+		if (frozen_only && !tg->frozen)
+			continue;
+		if (thaw_target(tg) != 0)
+			rc = -1;
+	}
+	return rc;
+}
+
+static void finish_freeze(struct fsfreeze_target *tg, int status)
+{
+	struct timeval now;
+
+	gettime_monotonic(&now);
+	timersub(&now, &tg->start, &tg->latency);
+	tg->done = 1;
+
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+		tg->frozen = 1;
+	else if (WIFEXITED(status)) {
+		errno = WEXITSTATUS(status);
+		warn(_("%s: freeze failed"), tg->path);
+	} else
+		warnx(_("%s: freeze failed"), tg->path);
+}
+
+static struct fsfreeze_target *get_target_by_pid(struct fsfreeze_target *tgs,
+						 size_t ntgs, pid_t pid)
+{
+	size_t i;
+
+	for (i = 0; i < ntgs; i++) {
+		if (tgs[i].pid == pid)
+			return &tgs[i];
+	}
+	return NULL;
+}
+
+/*
+ * Freezes all filesystems in parallel; FIFREEZE blocks until all dirty data
+ * is written, so every filesystem is frozen by a separate child process (the
+ * frozen state belongs to the superblock, not to the process). Returns the
+ * number of targets not frozen before @timeout.
+ */
+static size_t freeze_targets(struct fsfreeze_target *tgs, size_t ntgs,
+			     struct timeval *timeout)
+{
+	struct timeval deadline;
+	sigset_t mask, oldmask;
+	size_t i, npending = 0, nfailed = 0;
+	int timedout = 0;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &mask, &oldmask);
+
+	gettime_monotonic(&deadline);
+	if (timeout)
+		timeradd(&deadline, timeout, &deadline);
+
+	for (i = 0; i < ntgs; i++) {
+		struct fsfreeze_target *tg = &tgs[i];
+
+		gettime_monotonic(&tg->start);
+		tg->pid = fork();
+		if (tg->pid < 0) {
+			warn(_("fork failed"));
+			tg->done = 1;
+			nfailed++;
+			break;
+		}
+		if (tg->pid == 0)
+			_exit(ioctl(tg->fd, FIFREEZE, 0) ? errno : 0);
+		npending++;
+	}
+
+	while (npending && !sig_die) {
+		struct fsfreeze_target *tg;
+		int status;
+		pid_t pid;
+
+		pid = waitpid(-1, &status, WNOHANG);
+		if (pid > 0) {
+			tg = get_target_by_pid(tgs, ntgs, pid);
+			if (tg) {
+				finish_freeze(tg, status);
+				if (!tg->frozen)
+					nfailed++;
+				npending--;
+			}
+			continue;
+		}
+		if (nfailed)
+			break;
+
+		/* wait for the next child or the deadline */
+		if (timeout) {
+			struct timeval now, rem;
+			struct timespec ts;
+
+			gettime_monotonic(&now);
+			if (!timercmp(&now, &deadline, <)) {
+				timedout = 1;
+				break;
+			}
+			timersub(&deadline, &now, &rem);
+			ts.tv_sec = rem.tv_sec;
+			ts.tv_nsec = rem.tv_usec * 1000;
+			sigtimedwait(&mask, NULL, &ts);
+		} else
+			sigwaitinfo(&mask, NULL);
+	}
+
+	/* FIFREEZE cannot be interrupted, wait for the pending children to
+	 * be able to thaw the filesystems */
+	for (i = 0; i < ntgs; i++) {
+		struct fsfreeze_target *tg = &tgs[i];
+		int status;
+
+		if (tg->pid <= 0 || tg->done)
+			continue;
+		if (timedout)
+			warnx(_("%s: freeze timed out"), tg->path);
+		nfailed++;
+		if (waitpid(tg->pid, &status, 0) == tg->pid)
+			finish_freeze(tg, status);
+	}
+
+	sigprocmask(SIG_SETMASK, &oldmask, NULL);
+	return nfailed;
+}
+
 int main(int argc, char **argv)
 {
-	int fd = -1, c;
+	struct fsfreeze_target *tgs;
+	struct timeval timeout, *ptimeout = NULL;
+	size_t ntgs, i;
+	int c, verbose = 0;
 	int action = NOOP, rc = EXIT_FAILURE;
-	char *path;
-	struct stat sb;
 
 	static const struct option longopts[] = {
 	    { "help",      no_argument, NULL, 'h' },
 	    { "freeze",    no_argument, NULL, 'f' },
 	    { "unfreeze",  no_argument, NULL, 'u' },
+	    { "timeout",   required_argument, NULL, 't' },
+	    { "verbose",   no_argument, NULL, 'v' },
 	    { "version",   no_argument, NULL, 'V' },
 	    { NULL, 0, NULL, 0 }
 	};
@@ -79,7 +280,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "hfuV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hfut:vV", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -90,6 +291,14 @@ int main(int argc, char **argv)
 		case 'u':
 			action = UNFREEZE;
 			break;
+		case 't':
+			strtotimeval_or_err(optarg, &timeout,
+					_("invalid timeout argument"));
+			ptimeout = &timeout;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
 
 		case 'h':
 			usage();
@@ -104,39 +313,58 @@ int main(int argc, char **argv)
 		errx(EXIT_FAILURE, _("neither --freeze or --unfreeze specified"));
 	if (optind == argc)
 		errx(EXIT_FAILURE, _("no filename specified"));
-	path = argv[optind++];
-
-	if (optind != argc) {
-		warnx(_("unexpected number of arguments"));
-		errtryhelp(EXIT_FAILURE);
-	}
-
-	fd = open(path, O_RDONLY);
-	if (fd < 0)
-		err(EXIT_FAILURE, _("cannot open %s"), path);
 
-	if (fstat(fd, &sb) == -1) {
-		warn(_("stat of %s failed"), path);
-		goto done;
-	}
+	ntgs = argc - optind;
+	tgs = xcalloc(ntgs, sizeof(*tgs));
 
-	if (!S_ISDIR(sb.st_mode)) {
-		warnx(_("%s: is not a directory"), path);
-		goto done;
+	/* open all targets before freezing anything */
+	for (i = 0; i < ntgs; i++) {
+		tgs[i].path = argv[optind + i];
+		tgs[i].fd = -1;
+		if (open_target(&tgs[i]) != 0)
+			goto done;
 	}
 
 	switch (action) {
 	case FREEZE:
-		if (ioctl(fd, FIFREEZE, 0)) {
-			warn(_("%s: freeze failed"), path);
+		for (i = 1; i < ntgs; i++) {
+			size_t x;
+
+			for (x = 0; x < i; x++) {
+				if (tgs[x].devno == tgs[i].devno) {
+					warnx(_("%s: is the same filesystem as %s"),
+							tgs[i].path, tgs[x].path);
+					goto done;
+				}
+			}
+		}
+
+		if (ntgs == 1 && !ptimeout) {
+			if (ioctl(tgs[0].fd, FIFREEZE, 0)) {
+				warn(_("%s: freeze failed"), tgs[0].path);
+				goto done;
+			}
+			break;
+		}
+
+		signal(SIGINT, sig_handler);
+		signal(SIGTERM, sig_handler);
+
+		if (freeze_targets(tgs, ntgs, ptimeout) || sig_die) {
+			thaw_targets(tgs, ntgs, 1);
 			goto done;
 		}
+		if (verbose) {
+			for (i = 0; i < ntgs; i++)
+				printf(_("%s: frozen in %ld.%06ld seconds\n"),
+					tgs[i].path,
+					(long) tgs[i].latency.tv_sec,
+					(long) tgs[i].latency.tv_usec);
+		}
 		break;
 	case UNFREEZE:
-		if (ioctl(fd, FITHAW, 0)) {
-			warn(_("%s: unfreeze failed"), path);
+		if (thaw_targets(tgs, ntgs, 0) != 0)
 			goto done;
-		}
 		break;
 	default:
 		abort();
@@ -144,6 +372,10 @@ int main(int argc, char **argv)
 
 	rc = EXIT_SUCCESS;
 done:
-	close(fd);
+	for (i = 0; i < ntgs; i++) {
+		if (tgs[i].fd >= 0)
+			close(tgs[i].fd);
+	}
+	free(tgs);
 	return rc;
 }
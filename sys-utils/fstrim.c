@@ -37,6 +37,9 @@
 #include <sys/stat.h>
 #include <sys/vfs.h>
 #include <linux/fs.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #include "nls.h"
 #include "xalloc.h"
@@ -47,6 +50,8 @@
 #include "sysfs.h"
 #include "optutils.h"
 #include "statfs_magic.h"
+#include "monotonic.h"
+#include "jsonwrt.h"
 
 #include <libmount.h>
 
@@ -63,12 +68,27 @@ struct fstrim_range {
 struct fstrim_control {
 	struct fstrim_range range;
 	char *type_pattern;
+	size_t nthreads;	/* --parallel */
+	uint64_t chunk_size;	/* --chunk-size, max bytes per FITRIM */
+	unsigned int max_latency;	/* --max-latency, msecs */
 
 	unsigned int verbose : 1,
 		     quiet_unsupp : 1,
+		     json : 1,
 		     dryrun : 1;
 };
 
+/* one filesystem to trim and the result */
+struct fstrim_fs {
+	const char *path;
+	const char *devname;
+	dev_t disk;		/* whole disk, filesystems on one disk are trimmed serially */
+
+	uint64_t trimmed;	/* bytes */
+	struct timeval time;	/* duration of FITRIM */
+	int rc;			/* 0 = success, 1 = unsupported, < 0 = error */
+};
+
 static int is_directory(const char *path, int silent)
 {
 	struct stat sb;
@@ -86,15 +106,137 @@ static int is_directory(const char *path, int silent)
 	return 1;
 }
 
+/*
+ * --chunk-size and --max-latency
+ *
+ * The range is trimmed by FITRIM ioctls of at most the chunk size, the
+ * default is discard_max_bytes of the disk. The average latency of the other
+ * (read and write) requests on the disk is read from the disk stat file
+ * after every chunk. If it is over --max-latency, the next chunk is halved
+ * and trim pauses as long as the last chunk took; otherwise the chunk grows
+ * back to the maximum.
+ */
+#define FSTRIM_MIN_CHUNK	(1024 * 1024)
+#define FSTRIM_DEFAULT_CHUNK	(1024 * 1024 * 1024)
+#define FSTRIM_MAX_PAUSE	1000000		/* usec */
+
+struct disk_stat {
+	uint64_t ios;		/* read and write requests */
+	uint64_t ticks;		/* msecs spent by the requests */
+};
+
+static int read_disk_stat(struct path_cxt *pc, struct disk_stat *st)
+{
+	uint64_t rios, rmerges, rsecs, rticks, wios, wmerges, wsecs, wticks;
+
+	if (!pc || ul_path_scanf(pc, "stat",
+			"%"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64
+			" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64,
+			&rios, &rmerges, &rsecs, &rticks,
+			&wios, &wmerges, &wsecs, &wticks) != 8)
+		return -1;
+
+	st->ios = rios + wios;
+	st->ticks = rticks + wticks;
+	return 0;
+}
+
+/*
+ * Calls FITRIM for @range in chunks up to the filesystem size, the rest (for
+ * example the metadata overhead not counted by statfs()) by one FITRIM.
+ *
+ * Returns: 0 or -1 and errno like ioctl().
+ */
+static int fitrim_chunked(struct fstrim_control *ctl, int fd, struct fstrim_range *range)
+{
+	struct path_cxt *pc = NULL;
+	struct statfs vfs;
+	struct stat st;
+	dev_t disk = 0;
+	uint64_t start = range->start, end, fsend = UINT64_MAX;
+	uint64_t max = ctl->chunk_size, len, trimmed = 0;
+
+	if (range->len > UINT64_MAX - start)
+		end = UINT64_MAX;
+	else
+		end = start + range->len;
+
+	if (fstatfs(fd, &vfs) == 0)
+		fsend = (uint64_t) vfs.f_blocks * vfs.f_bsize;
+
+	if (fstat(fd, &st) == 0
+	    && sysfs_devno_to_wholedisk(st.st_dev, NULL, 0, &disk) == 0 && disk)
+		pc = ul_new_sysfs_path(disk, NULL, NULL);
+	if (!max && pc)
+		ul_path_read_u64(pc, &max, "queue/discard_max_bytes");
+	if (!max)
+		max = FSTRIM_DEFAULT_CHUNK;
+	max = max(max, (uint64_t) FSTRIM_MIN_CHUNK);
+	len = max;
+
+	while (start < end) {
+		struct fstrim_range chunk = { .start = start, .minlen = range->minlen };
+		struct disk_stat before = { 0 }, after = { 0 };
+		struct timeval t0, t1;
+		uint64_t size;
+		int watch;
+
+		/* the last chunk is the rest behind the filesystem size */
+		size = start < fsend ? min(len, min(end, fsend) - start)
+				     : end - start;
+		chunk.len = size;
+
+		watch = ctl->max_latency && read_disk_stat(pc, &before) == 0;
+		gettime_monotonic(&t0);
+
+		if (ioctl(fd, FITRIM, &chunk)) {
+			/* start behind the end of the filesystem */
+			if (errno == EINVAL && start > range->start)
+				break;
+			ul_unref_path(pc);
+			return -1;
+		}
+		trimmed += chunk.len;	/* kernel returns the trimmed bytes */
+
+		if (end - start <= size)
+			break;
+		start += size;
+
+		gettime_monotonic(&t1);
+
+		if (watch && read_disk_stat(pc, &after) == 0 && after.ios > before.ios) {
+			uint64_t await = (after.ticks - before.ticks)
+					 / (after.ios - before.ios);
+
+			if (await > ctl->max_latency) {
+				uint64_t usec;
+
+				timersub(&t1, &t0, &t1);
+				usec = (uint64_t) t1.tv_sec * 1000000 + t1.tv_usec;
+
+				len = max(len / 2, (uint64_t) FSTRIM_MIN_CHUNK);
+				xusleep(min(usec, (uint64_t) FSTRIM_MAX_PAUSE));
+				continue;
+			}
+		}
+		len = min(len * 2, max);
+	}
+
+	ul_unref_path(pc);
+	range->len = trimmed;
+	return 0;
+}
+
 /* returns: 0 = success, 1 = unsupported, < 0 = error */
-static int fstrim_filesystem(struct fstrim_control *ctl, const char *path, const char *devname)
+static int fstrim_filesystem(struct fstrim_control *ctl, struct fstrim_fs *fsd)
 {
 	int fd = -1, rc;
 	struct fstrim_range range;
-	char *rpath = realpath(path, NULL);
+	struct timeval start, end;
+	char *rpath = realpath(fsd->path, NULL);
 
 	if (!rpath) {
-		warn(_("cannot get realpath: %s"), path);
+		warn(_("cannot get realpath: %s"), fsd->path);
 		rc = -errno;
 		goto done;
 	}
@@ -103,22 +245,21 @@ static int fstrim_filesystem(struct fstrim_control *ctl, const char *path, const
 
 	fd = open(rpath, O_RDONLY);
 	if (fd < 0) {
-		warn(_("cannot open %s"), path);
+		warn(_("cannot open %s"), fsd->path);
 		rc = -errno;
 		goto done;
 	}
 
 	if (ctl->dryrun) {
-		if (devname)
-			printf(_("%s: 0 B (dry run) trimmed on %s\n"), path, devname);
-		else
-			printf(_("%s: 0 B (dry run) trimmed\n"), path);
 		rc = 0;
 		goto done;
 	}
 
+	gettime_monotonic(&start);
 	errno = 0;
-	if (ioctl(fd, FITRIM, &range)) {
+	if (ctl->chunk_size || ctl->max_latency ?
+	    fitrim_chunked(ctl, fd, &range) :
+	    ioctl(fd, FITRIM, &range)) {
 		switch (errno) {
 		case EBADF:
 		case ENOTTY:
@@ -130,34 +271,168 @@ static int fstrim_filesystem(struct fstrim_control *ctl, const char *path, const
 			rc = -errno;
 		}
 		if (rc < 0)
-			warn(_("%s: FITRIM ioctl failed"), path);
+			warn(_("%s: FITRIM ioctl failed"), fsd->path);
 		goto done;
 	}
+	gettime_monotonic(&end);
+	timersub(&end, &start, &fsd->time);
+
+	fsd->trimmed = range.len;
+	rc = 0;
+done:
+	if (fd >= 0)
+		close(fd);
+	free(rpath);
+	fsd->rc = rc;
+	return rc;
+}
+
+/* prints the result of fstrim_filesystem(), JSON is printed by fstrim_print_json() */
+static void fstrim_report(struct fstrim_control *ctl, struct fstrim_fs *fsd)
+{
+	const char *path = fsd->path, *devname = fsd->devname;
+
+	if (fsd->rc == 1 && !ctl->quiet_unsupp)
+		warnx(_("%s: the discard operation is not supported"), path);
+	if (fsd->rc != 0 || ctl->json)
+		return;
 
-	if (ctl->verbose) {
+	if (ctl->dryrun) {
+		if (devname)
+			printf(_("%s: 0 B (dry run) trimmed on %s\n"), path, devname);
+		else
+			printf(_("%s: 0 B (dry run) trimmed\n"), path);
+
+	} else if (ctl->verbose) {
 		char *str = size_to_human_string(
 				SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE,
-				(uint64_t) range.len);
+				fsd->trimmed);
 		if (devname)
 			/* TRANSLATORS: The standard value here is a very large number. */
 			printf(_("%s: %s (%" PRIu64 " bytes) trimmed on %s\n"),
-				path, str, (uint64_t) range.len, devname);
+				path, str, fsd->trimmed, devname);
 		else
 			/* TRANSLATORS: The standard value here is a very large number. */
 			printf(_("%s: %s (%" PRIu64 " bytes) trimmed\n"),
-				path, str, (uint64_t) range.len);
+				path, str, fsd->trimmed);
 
 		free(str);
 	}
+}
 
-	rc = 0;
-done:
-	if (fd >= 0)
-		close(fd);
-	free(rpath);
-	return rc;
+static void fstrim_print_json(struct fstrim_fs *fss, size_t nfss)
+{
+	struct ul_jsonwrt json;
+	size_t i;
+
+	ul_jsonwrt_init(&json, stdout, 0);
+	ul_jsonwrt_root_open(&json);
+	ul_jsonwrt_array_open(&json, "filesystems");
+
+	for (i = 0; i < nfss; i++) {
+		struct fstrim_fs *fsd = &fss[i];
+
+		ul_jsonwrt_object_open(&json, NULL);
+		ul_jsonwrt_value_s(&json, "target", fsd->path);
+		ul_jsonwrt_value_s(&json, "source", fsd->devname);
+		ul_jsonwrt_value_s(&json, "status",
+				fsd->rc == 0 ? "ok" :
+				fsd->rc == 1 ? "unsupported" : "failed");
+		ul_jsonwrt_value_u64(&json, "trimmed", fsd->trimmed);
+		ul_jsonwrt_value_double(&json, "duration",
+				(long double) fsd->time.tv_sec
+				+ (long double) fsd->time.tv_usec / 1000000);
+		ul_jsonwrt_object_close(&json);
+	}
+
+	ul_jsonwrt_array_close(&json);
+	ul_jsonwrt_root_close(&json);
+}
+
+#ifdef HAVE_PTHREAD
+/*
+ * --parallel
+ *
+ * Every worker takes the next disk and trims all filesystems on the disk one
+ * after another, the disks are trimmed at the same time.
+ */
+struct fstrim_pool {
+	struct fstrim_control *ctl;
+	struct fstrim_fs *fss;
+	size_t nfss;
+	dev_t *disks;		/* unique disks in order of the filesystems */
+	size_t ndisks;
+	size_t next;		/* the next disk for a worker */
+
+	pthread_mutex_t lock;
+};
+
+static void *fstrim_worker(void *data)
+{
+	struct fstrim_pool *pool = data;
+
+	for (;;) {
+		dev_t disk;
+		size_t i;
+
+		pthread_mutex_lock(&pool->lock);
+		if (pool->next >= pool->ndisks) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		disk = pool->disks[pool->next++];
+		pthread_mutex_unlock(&pool->lock);
+
+		for (i = 0; i < pool->nfss; i++) {
+			struct fstrim_fs *fsd = &pool->fss[i];
+
+			if (fsd->disk != disk)
+				continue;
+			fstrim_filesystem(pool->ctl, fsd);
+
+			pthread_mutex_lock(&pool->lock);
+			fstrim_report(pool->ctl, fsd);
+			pthread_mutex_unlock(&pool->lock);
+		}
+	}
+	return NULL;
 }
 
+/* returns 0 on success, -1 if no thread has been created */
+static int fstrim_parallel(struct fstrim_control *ctl, struct fstrim_fs *fss, size_t nfss)
+{
+	struct fstrim_pool pool = { .ctl = ctl, .fss = fss, .nfss = nfss };
+	pthread_t *threads;
+	size_t i, k, nthreads = 0;
+
+	pool.disks = xcalloc(nfss, sizeof(dev_t));
+	for (i = 0; i < nfss; i++) {
+		for (k = 0; k < pool.ndisks; k++) {
+			if (pool.disks[k] == fss[i].disk)
+				break;
+		}
+		if (k == pool.ndisks)
+			pool.disks[pool.ndisks++] = fss[i].disk;
+	}
+
+	pthread_mutex_init(&pool.lock, NULL);
+	threads = xcalloc(ctl->nthreads, sizeof(pthread_t));
+
+	for (i = 0; i < ctl->nthreads && i < pool.ndisks; i++) {
+		if (pthread_create(&threads[nthreads], NULL, fstrim_worker, &pool) != 0)
+			break;
+		nthreads++;
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&pool.lock);
+	free(threads);
+	free(pool.disks);
+	return nthreads ? 0 : -1;
+}
+#endif /* HAVE_PTHREAD */
+
 static int has_discard(const char *devname, struct path_cxt **wholedisk)
 {
 	struct path_cxt *pc = NULL;
@@ -211,6 +486,16 @@ fail:
 	return 1;
 }
 
+/* returns the whole disk of the device, or the device if unknown */
+static dev_t get_wholedisk(const char *devname)
+{
+	dev_t dev = sysfs_devname_to_devno(devname), disk = 0;
+
+	if (dev && sysfs_devno_to_wholedisk(dev, NULL, 0, &disk) == 0 && disk)
+		return disk;
+	return dev;
+}
+
 static int is_unwanted_fs(struct libmnt_fs *fs, const char *tgt, const char *types)
 {
 	struct statfs vfs;
@@ -257,6 +542,13 @@ static int uniq_fs_target_cmp(
 	return !mnt_fs_streq_target(a, mnt_fs_get_target(b));
 }
 
+static size_t uniq_fs_target_hash(
+		struct libmnt_table *tb __attribute__((__unused__)),
+		struct libmnt_fs *fs)
+{
+	return ul_hash_path(mnt_fs_get_target(fs));
+}
+
 static int uniq_fs_source_cmp(
 		struct libmnt_table *tb __attribute__((__unused__)),
 		struct libmnt_fs *a,
@@ -269,6 +561,16 @@ static int uniq_fs_source_cmp(
 	return !mnt_fs_streq_srcpath(a, mnt_fs_get_srcpath(b));
 }
 
+static size_t uniq_fs_source_hash(
+		struct libmnt_table *tb __attribute__((__unused__)),
+		struct libmnt_fs *fs)
+{
+	/* pseudo and network filesystems are never equal */
+	if (mnt_fs_is_pseudofs(fs) || mnt_fs_is_netfs(fs))
+		return 0;
+	return ul_hash_path(mnt_fs_get_srcpath(fs));
+}
+
 /*
  * -1 = tab empty
  *  0 = all success
@@ -282,6 +584,8 @@ static int fstrim_all_from_file(struct fstrim_control *ctl, const char *filename
 	struct libmnt_table *tab;
 	struct libmnt_cache *cache = NULL;
 	struct path_cxt *wholedisk = NULL;
+	struct fstrim_fs *fss;
+	size_t i, nfss = 0;
 	int cnt = 0, cnt_err = 0;
 	int fstab = 0;
 
@@ -298,7 +602,7 @@ static int fstrim_all_from_file(struct fstrim_control *ctl, const char *filename
 		fstab = 1;
 
 	/* de-duplicate by mountpoints */
-	mnt_table_uniq_fs(tab, 0, uniq_fs_target_cmp);
+	mnt_table_uniq_fs_hashed(tab, 0, uniq_fs_target_hash, uniq_fs_target_cmp);
 
 	if (fstab) {
 		char *rootdev = NULL;
@@ -376,34 +680,51 @@ static int fstrim_all_from_file(struct fstrim_control *ctl, const char *filename
 	}
 
 	/* de-duplicate by source */
-	mnt_table_uniq_fs(tab, MNT_UNIQ_FORWARD, uniq_fs_source_cmp);
+	mnt_table_uniq_fs_hashed(tab, MNT_UNIQ_FORWARD,
+			uniq_fs_source_hash, uniq_fs_source_cmp);
 
 	mnt_reset_iter(itr, MNT_ITER_BACKWARD);
 
-	/* Do FITRIM */
+	fss = xcalloc(mnt_table_get_nents(tab) + 1, sizeof(struct fstrim_fs));
 	while (mnt_table_next_fs(tab, itr, &fs) == 0) {
-		const char *src = mnt_fs_get_srcpath(fs),
-			   *tgt = mnt_fs_get_target(fs);
-		int rc;
+		struct fstrim_fs *fsd = &fss[nfss++];
 
-		cnt++;
-
-		/*
-		 * We're able to detect that the device supports discard, but
-		 * things also depend on filesystem or device mapping, for
-		 * example LUKS (by default) does not support FSTRIM.
-		 *
-		 * This is reason why we ignore EOPNOTSUPP and ENOTTY errors
-		 * from discard ioctl.
-		 */
-		rc = fstrim_filesystem(ctl, tgt, src);
-		if (rc < 0)
-		       cnt_err++;
-		else if (rc == 1 && !ctl->quiet_unsupp)
-			warnx(_("%s: the discard operation is not supported"), tgt);
+		fsd->path = mnt_fs_get_target(fs);
+		fsd->devname = mnt_fs_get_srcpath(fs);
+		if (ctl->nthreads > 1)
+			fsd->disk = get_wholedisk(fsd->devname);
 	}
 	mnt_free_iter(itr);
 
+	/*
+	 * Do FITRIM
+	 *
+	 * We're able to detect that the device supports discard, but
+	 * things also depend on filesystem or device mapping, for
+	 * example LUKS (by default) does not support FSTRIM.
+	 *
+	 * This is reason why we ignore EOPNOTSUPP and ENOTTY errors
+	 * from discard ioctl.
+	 */
+#ifdef HAVE_PTHREAD
+	if (ctl->nthreads <= 1 || fstrim_parallel(ctl, fss, nfss) != 0)
+#endif
+	{
+		for (i = 0; i < nfss; i++) {
+			fstrim_filesystem(ctl, &fss[i]);
+			fstrim_report(ctl, &fss[i]);
+		}
+	}
+
+	for (i = 0; i < nfss; i++) {
+		cnt++;
+		if (fss[i].rc < 0)
+			cnt_err++;
+	}
+	if (ctl->json)
+		fstrim_print_json(fss, nfss);
+	free(fss);
+
 	ul_unref_path(wholedisk);
 	mnt_unref_table(tab);
 	mnt_unref_cache(cache);
@@ -463,10 +784,16 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -o, --offset <num>       the offset in bytes to start discarding from\n"), out);
 	fputs(_(" -l, --length <num>       the number of bytes to discard\n"), out);
 	fputs(_(" -m, --minimum <num>      the minimum extent length to discard\n"), out);
+	fputs(_("     --chunk-size <num>   the maximal number of bytes per trim call\n"), out);
+	fputs(_("     --max-latency <ms>   slow down if disk requests wait longer\n"), out);
 	fputs(_(" -t, --types <list>       limit the set of filesystem types\n"), out);
 	fputs(_(" -v, --verbose            print number of discarded bytes\n"), out);
 	fputs(_("     --quiet-unsupported  suppress error messages if trim unsupported\n"), out);
 	fputs(_(" -n, --dry-run            does everything, but trim\n"), out);
+	fputs(_(" -J, --json               use JSON output format\n"), out);
+#ifdef HAVE_PTHREAD
+	fputs(_(" -p, --parallel <num>     trim filesystems on <num> disks at the same time\n"), out);
+#endif
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(21));
@@ -486,8 +813,11 @@ int main(int argc, char **argv)
 	struct fstrim_control ctl = {
 			.range = { .len = ULLONG_MAX }
 	};
+	struct fstrim_fs fsd = { .path = NULL };
 	enum {
-		OPT_QUIET_UNSUPP = CHAR_MAX + 1
+		OPT_QUIET_UNSUPP = CHAR_MAX + 1,
+		OPT_CHUNK_SIZE,
+		OPT_MAX_LATENCY
 	};
 
 	static const struct option longopts[] = {
@@ -499,10 +829,16 @@ int main(int argc, char **argv)
 	    { "offset",    required_argument, NULL, 'o' },
 	    { "length",    required_argument, NULL, 'l' },
 	    { "minimum",   required_argument, NULL, 'm' },
+	    { "chunk-size", required_argument, NULL, OPT_CHUNK_SIZE },
+	    { "max-latency", required_argument, NULL, OPT_MAX_LATENCY },
 	    { "types",     required_argument, NULL, 't' },
 	    { "verbose",   no_argument,       NULL, 'v' },
 	    { "quiet-unsupported", no_argument,       NULL, OPT_QUIET_UNSUPP },
 	    { "dry-run",   no_argument,       NULL, 'n' },
+	    { "json",      no_argument,       NULL, 'J' },
+#ifdef HAVE_PTHREAD
+	    { "parallel",  required_argument, NULL, 'p' },
+#endif
 	    { NULL, 0, NULL, 0 }
 	};
 
@@ -517,7 +853,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "AahI:l:m:no:t:Vv", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "AahI:Jl:m:no:p:t:Vv", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -537,6 +873,15 @@ int main(int argc, char **argv)
 		case 'n':
 			ctl.dryrun = 1;
 			break;
+		case 'J':
+			ctl.json = 1;
+			break;
+#ifdef HAVE_PTHREAD
+		case 'p':
+			ctl.nthreads = str2unum_or_err(optarg, 10,
+					_("failed to parse number of disks"), 1024);
+			break;
+#endif
 		case 'l':
 			ctl.range.len = strtosize_or_err(optarg,
 					_("failed to parse length"));
@@ -549,6 +894,14 @@ int main(int argc, char **argv)
 			ctl.range.minlen = strtosize_or_err(optarg,
 					_("failed to parse minimum extent length"));
 			break;
+		case OPT_CHUNK_SIZE:
+			ctl.chunk_size = strtosize_or_err(optarg,
+					_("failed to parse chunk size"));
+			break;
+		case OPT_MAX_LATENCY:
+			ctl.max_latency = strtou32_or_err(optarg,
+					_("failed to parse latency"));
+			break;
 		case 't':
 			ctl.type_pattern = optarg;
 			break;
@@ -584,11 +937,13 @@ int main(int argc, char **argv)
 	if (!is_directory(path, 0))
 		return EXIT_FAILURE;
 
-	rc = fstrim_filesystem(&ctl, path, NULL);
+	fsd.path = path;
+	rc = fstrim_filesystem(&ctl, &fsd);
+	fstrim_report(&ctl, &fsd);
+	if (ctl.json)
+		fstrim_print_json(&fsd, 1);
 	if (rc == 1 && ctl.quiet_unsupp)
 		rc = 0;
-	if (rc == 1)
-		warnx(_("%s: the discard operation is not supported"), path);
 
 	return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -10,8 +10,10 @@
  * Copyright (C) 2012-2023 Karel Zak <kzak@redhat.com>
  */
 #include <inttypes.h>
+#include <fcntl.h>
 
 #include "c.h"
+#include "all-io.h"
 #include "nls.h"
 #include "xalloc.h"
 #include "path.h"
@@ -110,49 +112,113 @@ int ipc_shm_get_limits(struct ipc_limits *lim)
 	return 0;
 }
 
+/*
+ * The /proc/sysvipc files are read by one read() loop and the lines are
+ * split to the fields in place. Returns the buffer or NULL if the file cannot
+ * be opened; @lines is the first line after the header.
+ */
+static char *read_sysvipc_file(const char *path, char **lines)
+{
+	char *buf = NULL, *p;
+	ssize_t sz;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	sz = read_all_alloc(fd, &buf);
+	close(fd);
+
+	if (sz < 0 || !buf) {
+		/* empty list */
+		buf = xstrdup("");
+		sz = 0;
+	}
+	buf[sz] = '\0';	/* read_all_alloc() keeps a free byte */
+
+	p = strchr(buf, '\n');		/* skip header */
+	*lines = p ? p + 1 : buf + sz;
+	return buf;
+}
+
+/*
+ * Splits the line at @*lines to max @nfields fields, @*lines is set to the
+ * next line. Returns the number of the fields.
+ */
+static size_t next_sysvipc_line(char **lines, char **fields, size_t nfields)
+{
+	char *p = *lines, *end;
+	size_t n = 0;
+
+	end = strchr(p, '\n');
+	if (end) {
+		*end = '\0';
+		*lines = end + 1;
+	} else
+		*lines = p + strlen(p);
+
+	while (n < nfields) {
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (!*p)
+			break;
+		fields[n++] = p;
+		while (*p && *p != ' ' && *p != '\t')
+			p++;
+		if (*p)
+			*p++ = '\0';
+	}
+	return n;
+}
+
+static inline int64_t field_s64(const char *str, int base)
+{
+	return strtoll(str, NULL, base);
+}
+
+static inline uint64_t field_u64(const char *str)
+{
+	return strtoull(str, NULL, 10);
+}
+
 int ipc_shm_get_info(int id, struct shm_data **shmds)
 {
-	FILE *f;
+	char *buf, *lines, *f[16];
 	int i = 0, maxid, j;
-	char buf[BUFSIZ];
 	struct shm_data *p;
 	struct shmid_ds dummy;
 
 	p = *shmds = xcalloc(1, sizeof(struct shm_data));
 	p->next = NULL;
 
-	f = fopen(_PATH_PROC_SYSV_SHM, "r");
-	if (!f)
+	buf = read_sysvipc_file(_PATH_PROC_SYSV_SHM, &lines);
+	if (!buf)
 		goto shm_fallback;
 
-	while (fgetc(f) != '\n');		/* skip header */
+	while (*lines) {
+		/* the first 14-16 columns (e.g. Linux 2.6.32 has 14) */
+		size_t n = next_sysvipc_line(&lines, f, ARRAY_SIZE(f));
 
-	while (fgets(buf, sizeof(buf), f) != NULL) {
-		/* scan for the first 14-16 columns (e.g. Linux 2.6.32 has 14) */
-		p->shm_rss = 0xdead;
-		p->shm_swp = 0xdead;
-		if (sscanf(buf,
-			  "%d %d  %o %"SCNu64 " %u %u  "
-			  "%"SCNu64 " %u %u %u %u %"SCNi64 " %"SCNi64 " %"SCNi64
-			  " %"SCNu64 " %"SCNu64 "\n",
-			   &p->shm_perm.key,
-			   &p->shm_perm.id,
-			   &p->shm_perm.mode,
-			   &p->shm_segsz,
-			   &p->shm_cprid,
-			   &p->shm_lprid,
-			   &p->shm_nattch,
-			   &p->shm_perm.uid,
-			   &p->shm_perm.gid,
-			   &p->shm_perm.cuid,
-			   &p->shm_perm.cgid,
-			   &p->shm_atim,
-			   &p->shm_dtim,
-			   &p->shm_ctim,
-			   &p->shm_rss,
-			   &p->shm_swp) < 14)
+		if (n < 14)
 			continue; /* invalid line, skipped */
 
+		p->shm_perm.key = field_s64(f[0], 10);
+		p->shm_perm.id = field_s64(f[1], 10);
+		p->shm_perm.mode = field_s64(f[2], 8);
+		p->shm_segsz = field_u64(f[3]);
+		p->shm_cprid = field_s64(f[4], 10);
+		p->shm_lprid = field_s64(f[5], 10);
+		p->shm_nattch = field_u64(f[6]);
+		p->shm_perm.uid = field_u64(f[7]);
+		p->shm_perm.gid = field_u64(f[8]);
+		p->shm_perm.cuid = field_u64(f[9]);
+		p->shm_perm.cgid = field_u64(f[10]);
+		p->shm_atim = field_s64(f[11], 10);
+		p->shm_dtim = field_s64(f[12], 10);
+		p->shm_ctim = field_s64(f[13], 10);
+		p->shm_rss = n > 14 ? field_u64(f[14]) : 0xdead;
+		p->shm_swp = n > 15 ? field_u64(f[15]) : 0xdead;
+
 		if (id > -1) {
 			/* ID specified */
 			if (id == p->shm_perm.id) {
@@ -170,7 +236,7 @@ int ipc_shm_get_info(int id, struct shm_data **shmds)
 
 	if (i == 0)
 		free(*shmds);
-	fclose(f);
+	free(buf);
 	return i;
 
 	/* Fallback; /proc or /sys file(s) missing. */
@@ -260,7 +326,7 @@ static void get_sem_elements(struct sem_data *p)
 
 int ipc_sem_get_info(int id, struct sem_data **semds)
 {
-	FILE *f;
+	char *buf, *lines, *f[10];
 	int i = 0, maxid, j;
 	struct sem_data *p;
 	struct seminfo dummy;
@@ -269,28 +335,25 @@ int ipc_sem_get_info(int id, struct sem_data **semds)
 	p = *semds = xcalloc(1, sizeof(struct sem_data));
 	p->next = NULL;
 
-	f = fopen(_PATH_PROC_SYSV_SEM, "r");
-	if (!f)
+	buf = read_sysvipc_file(_PATH_PROC_SYSV_SEM, &lines);
+	if (!buf)
 		goto sem_fallback;
 
-	while (fgetc(f) != '\n') ;	/* skip header */
-
-	while (feof(f) == 0) {
-		if (fscanf(f,
-			   "%d %d  %o %" SCNu64 " %u %u %u %u %"
-			    SCNi64 " %" SCNi64 "\n",
-			   &p->sem_perm.key,
-			   &p->sem_perm.id,
-			   &p->sem_perm.mode,
-			   &p->sem_nsems,
-			   &p->sem_perm.uid,
-			   &p->sem_perm.gid,
-			   &p->sem_perm.cuid,
-			   &p->sem_perm.cgid,
-			   &p->sem_otime,
-			   &p->sem_ctime) != 10)
+	while (*lines) {
+		if (next_sysvipc_line(&lines, f, ARRAY_SIZE(f)) != 10)
 			continue;
 
+		p->sem_perm.key = field_s64(f[0], 10);
+		p->sem_perm.id = field_s64(f[1], 10);
+		p->sem_perm.mode = field_s64(f[2], 8);
+		p->sem_nsems = field_u64(f[3]);
+		p->sem_perm.uid = field_u64(f[4]);
+		p->sem_perm.gid = field_u64(f[5]);
+		p->sem_perm.cuid = field_u64(f[6]);
+		p->sem_perm.cgid = field_u64(f[7]);
+		p->sem_otime = field_s64(f[8], 10);
+		p->sem_ctime = field_s64(f[9], 10);
+
 		if (id > -1) {
 			/* ID specified */
 			if (id == p->sem_perm.id) {
@@ -309,7 +372,7 @@ int ipc_sem_get_info(int id, struct sem_data **semds)
 
 	if (i == 0)
 		free(*semds);
-	fclose(f);
+	free(buf);
 	return i;
 
 	/* Fallback; /proc or /sys file(s) missing. */
@@ -368,7 +431,7 @@ void ipc_sem_free_info(struct sem_data *semds)
 
 int ipc_msg_get_info(int id, struct msg_data **msgds)
 {
-	FILE *f;
+	char *buf, *lines, *f[14];
 	int i = 0, maxid, j;
 	struct msg_data *p;
 	struct msqid_ds dummy;
@@ -377,32 +440,29 @@ int ipc_msg_get_info(int id, struct msg_data **msgds)
 	p = *msgds = xcalloc(1, sizeof(struct msg_data));
 	p->next = NULL;
 
-	f = fopen(_PATH_PROC_SYSV_MSG, "r");
-	if (!f)
+	buf = read_sysvipc_file(_PATH_PROC_SYSV_MSG, &lines);
+	if (!buf)
 		goto msg_fallback;
 
-	while (fgetc(f) != '\n') ;	/* skip header */
-
-	while (feof(f) == 0) {
-		if (fscanf(f,
-			   "%d %d  %o  %" SCNu64 " %" SCNu64
-			   " %u %u %u %u %u %u %" SCNi64 " %" SCNi64 " %" SCNi64 "\n",
-			   &p->msg_perm.key,
-			   &p->msg_perm.id,
-			   &p->msg_perm.mode,
-			   &p->q_cbytes,
-			   &p->q_qnum,
-			   &p->q_lspid,
-			   &p->q_lrpid,
-			   &p->msg_perm.uid,
-			   &p->msg_perm.gid,
-			   &p->msg_perm.cuid,
-			   &p->msg_perm.cgid,
-			   &p->q_stime,
-			   &p->q_rtime,
-			   &p->q_ctime) != 14)
+	while (*lines) {
+		if (next_sysvipc_line(&lines, f, ARRAY_SIZE(f)) != 14)
 			continue;
 
+		p->msg_perm.key = field_s64(f[0], 10);
+		p->msg_perm.id = field_s64(f[1], 10);
+		p->msg_perm.mode = field_s64(f[2], 8);
+		p->q_cbytes = field_u64(f[3]);
+		p->q_qnum = field_u64(f[4]);
+		p->q_lspid = field_s64(f[5], 10);
+		p->q_lrpid = field_s64(f[6], 10);
+		p->msg_perm.uid = field_u64(f[7]);
+		p->msg_perm.gid = field_u64(f[8]);
+		p->msg_perm.cuid = field_u64(f[9]);
+		p->msg_perm.cgid = field_u64(f[10]);
+		p->q_stime = field_s64(f[11], 10);
+		p->q_rtime = field_s64(f[12], 10);
+		p->q_ctime = field_s64(f[13], 10);
+
 		if (id > -1) {
 			/* ID specified */
 			if (id == p->msg_perm.id) {
@@ -422,7 +482,7 @@ int ipc_msg_get_info(int id, struct msg_data **msgds)
 
 	if (i == 0)
 		free(*msgds);
-	fclose(f);
+	free(buf);
 	return i;
 
 	/* Fallback; /proc or /sys file(s) missing. */
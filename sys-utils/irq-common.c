@@ -12,7 +12,9 @@
  * version 2.1 of the License, or (at your option) any later version.
  */
 #include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <locale.h>
 #include <stdbool.h>
@@ -26,6 +28,7 @@
 
 #include "c.h"
 #include "nls.h"
+#include "path.h"
 #include "pathnames.h"
 #include "strutils.h"
 #include "xalloc.h"
@@ -34,6 +37,8 @@
 
 #define IRQ_INFO_LEN	64
 
+#define _PATH_SYS_CPU	"/sys/devices/system/cpu"
+
 struct colinfo {
 	const char *name;
 	double whint;
@@ -66,6 +71,15 @@ struct softirq_desc {
 	{ .irq = "RCU", .desc = "RCU softirq" },
 };
 
+/* sets @str to @*dest, the already allocated string is reused if the same */
+static void set_irq_string(char **dest, const char *str)
+{
+	if (*dest && strcmp(*dest, str) == 0)
+		return;
+	free(*dest);
+	*dest = xstrdup(str);
+}
+
 static void get_softirq_desc(struct irq_info *curr)
 {
 	int i, size = ARRAY_SIZE(softirq_descs);
@@ -75,10 +89,7 @@ static void get_softirq_desc(struct irq_info *curr)
 			break;
 	}
 
-	if (i < size)
-		curr->name = xstrdup(softirq_descs[i].desc);
-	else
-		curr->name = xstrdup("");
+	set_irq_string(&curr->name, i < size ? softirq_descs[i].desc : "");
 }
 
 int irq_column_name_to_id(const char *name, size_t namesz)
@@ -230,112 +241,192 @@ static bool cpu_in_list(int cpu, size_t setsize, cpu_set_t *cpuset)
 	return CPU_ISSET_S(cpu, setsize, cpuset);
 }
 
-/*
- * irqinfo - parse the system's interrupts
- */
-static struct irq_stat *get_irqinfo(int softirq, size_t setsize, cpu_set_t *cpuset)
+/* /proc/interrupts and /proc/softirqs are kept open and read from the
+ * beginning to the same buffer by every update */
+struct irq_file {
+	int	fd;
+	char	*buf;
+	size_t	bufsz;
+};
+
+static struct irq_file irq_files[] = {
+	{ .fd = -1 },		/* interrupts */
+	{ .fd = -1 }		/* softirqs */
+};
+
+static char *read_irq_file(int softirq, size_t *buflen)
 {
-	FILE *irqfile;
-	char *line = NULL, *tmp;
+	struct irq_file *f = &irq_files[softirq ? 1 : 0];
+	const char *path = softirq ? _PATH_PROC_SOFTIRQS : _PATH_PROC_INTERRUPTS;
 	size_t len = 0;
-	struct irq_stat *stat;
-	struct irq_info *curr;
 
-	/* NAME + ':' + 11 bytes/cpu + IRQ_NAME_LEN */
-	stat = xcalloc(1, sizeof(*stat));
+	if (f->fd < 0) {
+		f->fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (f->fd < 0) {
+			warn(_("cannot open %s"), path);
+			return NULL;
+		}
+	}
 
-	stat->irq_info = xmalloc(sizeof(*stat->irq_info) * IRQ_INFO_LEN);
-	stat->nr_irq_info = IRQ_INFO_LEN;
+	for (;;) {
+		ssize_t rc;
 
-	if (softirq)
-		irqfile = fopen(_PATH_PROC_SOFTIRQS, "r");
-	else
-		irqfile = fopen(_PATH_PROC_INTERRUPTS, "r");
-	if (!irqfile) {
-		warn(_("cannot open %s"), _PATH_PROC_INTERRUPTS);
-		goto free_stat;
+		if (f->bufsz - len < BUFSIZ) {
+			f->bufsz = max(f->bufsz * 2, len + BUFSIZ);
+			f->buf = xrealloc(f->buf, f->bufsz);
+		}
+		rc = pread(f->fd, f->buf + len, f->bufsz - len - 1, len);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			warn(_("cannot read %s"), path);
+			return NULL;
+		}
+		if (rc == 0)
+			break;
+		len += rc;
 	}
+	f->buf[len] = '\0';
+	*buflen = len;
+	return f->buf;
+}
+
+/* returns pointer behind the number or NULL if there is no number */
+static char *parse_count(char *p, const char *end, unsigned long *count)
+{
+	uint64_t n;
+
+	while (*p == ' ')
+		p++;
+	p = (char *) ul_scan_u64(p, end, &n);
+	if (p)
+		*count = n;
+	return p;
+}
+
+static void resize_irqstat(struct irq_stat *stat, size_t nr_irq_info)
+{
+	size_t old = stat->nr_irq_info;
+
+	stat->irq_info = xreallocarray(stat->irq_info, nr_irq_info, sizeof(*stat->irq_info));
+	stat->sorted = xreallocarray(stat->sorted, nr_irq_info, sizeof(*stat->sorted));
+	if (nr_irq_info > old)
+		memset(stat->irq_info + old, 0, (nr_irq_info - old) * sizeof(*stat->irq_info));
+	stat->nr_irq_info = nr_irq_info;
+}
+
+/*
+ * irqinfo - parse the system's interrupts
+ *
+ * The @stat may be from the previous update, the arrays and the names are
+ * reused then. The numbers are parsed in place in the file buffer.
+ */
+static int get_irqinfo(struct irq_stat *stat, int softirq,
+		       size_t setsize, cpu_set_t *cpuset)
+{
+	char *buf, *bufend, *line, *next, *tmp;
+	size_t i, len, old_nr_irq = stat->nr_irq, nr_cpu = 0;
+
+	buf = read_irq_file(softirq, &len);
+	if (!buf)
+		return -1;
+	bufend = buf + len;
 
 	/* read header firstly */
-	if (getline(&line, &len, irqfile) < 0) {
-		warn(_("cannot read %s"), _PATH_PROC_INTERRUPTS);
-		goto close_file;
+	next = strchr(buf, '\n');
+	if (!next) {
+		warnx(_("cannot read %s"), softirq ? _PATH_PROC_SOFTIRQS :
+						     _PATH_PROC_INTERRUPTS);
+		return -1;
 	}
+	*next++ = '\0';
 
-	tmp = line;
+	tmp = buf;
 	while ((tmp = strstr(tmp, "CPU")) != NULL) {
 		tmp += 3;	/* skip this "CPU", find next */
-		stat->nr_active_cpu++;
+		nr_cpu++;
+	}
+
+	if (nr_cpu != stat->nr_active_cpu) {
+		free(stat->cpus);
+		stat->cpus = xcalloc(nr_cpu, sizeof(struct irq_cpu));
+		stat->nr_active_cpu = nr_cpu;
+	} else
+		memset(stat->cpus, 0, nr_cpu * sizeof(struct irq_cpu));
+
+	/* the offline CPUs are not in the file */
+	for (i = 0, tmp = buf; i < nr_cpu && (tmp = strstr(tmp, "CPU")) != NULL; i++) {
+		tmp += 3;
+		stat->cpus[i].cpu = atoi(tmp);
 	}
 
-	stat->cpus =  xcalloc(stat->nr_active_cpu, sizeof(struct irq_cpu));
+	if (!stat->nr_irq_info)
+		resize_irqstat(stat, IRQ_INFO_LEN);
+
+	stat->nr_irq = 0;
+	stat->total_irq = 0;
+	stat->delta_irq = 0;
 
 	/* parse each line of _PATH_PROC_INTERRUPTS */
-	while (getline(&line, &len, irqfile) >= 0) {
+	for (line = next; line && *line; line = next) {
+		struct irq_info *curr;
 		unsigned long count;
 		size_t index;
-		int length;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
 
 		tmp = strchr(line, ':');
 		if (!tmp)
 			continue;
+		*tmp++ = '\0';
 
-		length = strlen(line);
+		if (stat->nr_irq == stat->nr_irq_info)
+			resize_irqstat(stat, stat->nr_irq_info * 2);
 
 		curr = stat->irq_info + stat->nr_irq++;
-		memset(curr, 0, sizeof(*curr));
-		*tmp = '\0';
-		curr->irq = xstrdup(line);
-		ltrim_whitespace((unsigned char *)curr->irq);
+		curr->total = 0;
+		curr->delta = 0;
 
-		tmp += 1;
-		for (index = 0; (index < stat->nr_active_cpu) && (tmp - line < length); index++) {
+		while (isspace((unsigned char) *line))
+			line++;
+		set_irq_string(&curr->irq, line);
+
+		for (index = 0; index < stat->nr_active_cpu; index++) {
 			struct irq_cpu *cpu = &stat->cpus[index];
+			char *end = parse_count(tmp, bufend, &count);
 
-			if (sscanf(tmp, " %10lu", &count) != 1)
-				continue;
-			if (cpu_in_list(index, setsize, cpuset)) {
+			if (!end)
+				break;
+			if (cpu_in_list(cpu->cpu, setsize, cpuset)) {
 				curr->total += count;
 				cpu->total += count;
 				stat->total_irq += count;
 			}
-
-			tmp += 11;
+			tmp = end;
 		}
 
 		/* softirq always has no desc, add additional desc for softirq */
 		if (softirq)
 			get_softirq_desc(curr);
 		else {
-			if (tmp - line < length) {
-				/* strip all space before desc */
-				while (isspace(*tmp))
-					tmp++;
-				tmp = remove_repeated_spaces(tmp);
-				rtrim_whitespace((unsigned char *)tmp);
-				curr->name = xstrdup(tmp);
-			} else /* no irq name string, we have to set '\0' here */
-				curr->name = xstrdup("");
-		}
-
-		if (stat->nr_irq == stat->nr_irq_info) {
-			stat->nr_irq_info *= 2;
-			stat->irq_info = xreallocarray(stat->irq_info, stat->nr_irq_info,
-						       sizeof(*stat->irq_info));
+			/* strip all space before desc */
+			while (isspace((unsigned char) *tmp))
+				tmp++;
+			tmp = remove_repeated_spaces(tmp);
+			rtrim_whitespace((unsigned char *)tmp);
+			set_irq_string(&curr->name, tmp);
 		}
 	}
-	fclose(irqfile);
-	free(line);
-	return stat;
 
- close_file:
-	fclose(irqfile);
- free_stat:
-	free(stat->irq_info);
-	free(stat->cpus);
-	free(stat);
-	free(line);
-	return NULL;
+	/* the lines which are not in the file anymore */
+	for (i = stat->nr_irq; i < old_nr_irq; i++) {
+		free(stat->irq_info[i].irq);
+		free(stat->irq_info[i].name);
+		memset(&stat->irq_info[i], 0, sizeof(stat->irq_info[i]));
+	}
+	return 0;
 }
 
 void free_irqstat(struct irq_stat *stat)
@@ -351,6 +442,7 @@ void free_irqstat(struct irq_stat *stat)
 	}
 
 	free(stat->irq_info);
+	free(stat->sorted);
 	free(stat->cpus);
 	free(stat);
 }
@@ -437,6 +529,142 @@ void set_sort_func_by_key(struct irq_output *out, char c)
 	}
 }
 
+static const char *cpu_group_names[] = {
+	[IRQ_GROUP_CPU]		= "cpu",
+	[IRQ_GROUP_NODE]	= "node",
+	[IRQ_GROUP_SOCKET]	= "socket"
+};
+
+int irq_cpu_group_name_to_id(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(cpu_group_names); i++) {
+		if (strcasecmp(name, cpu_group_names[i]) == 0)
+			return i;
+	}
+	return -1;
+}
+
+static int read_cpu_node(struct path_cxt *sys, int cpu)
+{
+	struct dirent *de;
+	DIR *dir;
+	int node = -1;
+
+	dir = ul_path_opendirf(sys, "cpu%d", cpu);
+	if (!dir)
+		return -1;
+	while ((de = readdir(dir)) != NULL) {
+		if (strncmp(de->d_name, "node", 4) == 0 && isdigit_string(de->d_name + 4)) {
+			node = atoi(de->d_name + 4);
+			break;
+		}
+	}
+	closedir(dir);
+	return node;
+}
+
+/*
+ * Reads the NUMA node or the socket of all the possible CPUs for the per-cpu
+ * stat. The CPUs of an unknown group are in the group 0.
+ */
+int irq_read_cpu_groups(struct irq_output *out, int group)
+{
+	struct path_cxt *sys;
+	int i, ncpus;
+
+	out->cpu_group = group;
+	if (group == IRQ_GROUP_CPU)
+		return 0;
+
+	ncpus = get_max_number_of_cpus();
+	if (ncpus <= 0)
+		return -EINVAL;
+
+	sys = ul_new_path(_PATH_SYS_CPU);
+	if (!sys)
+		return -ENOMEM;
+
+	out->cpu_groups = xcalloc(ncpus, sizeof(int));
+	out->ncpu_groups = ncpus;
+
+	for (i = 0; i < ncpus; i++) {
+		int id = -1;
+
+		if (group == IRQ_GROUP_NODE)
+			id = read_cpu_node(sys, i);
+		else if (ul_path_readf_s32(sys, &id, "cpu%d/topology/physical_package_id", i) != 0)
+			id = -1;
+		out->cpu_groups[i] = id < 0 ? 0 : id;
+	}
+
+	ul_unref_path(sys);
+	return 0;
+}
+
+/* per-cpu stat summed by the group */
+struct irq_cell {
+	int id;				/* CPU or group number */
+	unsigned long total;
+	unsigned long delta;
+};
+
+static int cmp_cell_id(const void *a, const void *b)
+{
+	const struct irq_cell *x = a, *y = b;
+
+	return x->id < y->id ? -1 : x->id > y->id;
+}
+
+static int cmp_cell_delta(const void *a, const void *b)
+{
+	const struct irq_cell *x = a, *y = b;
+	int cmp = cmp_ulong_descending(x->delta, y->delta);
+
+	return cmp ? cmp : cmp_cell_id(a, b);
+}
+
+static size_t get_irq_cells(struct irq_output *out, struct irq_stat *curr,
+			    struct irq_cell *cells, size_t setsize, cpu_set_t *cpuset)
+{
+	size_t i, j, ncells = 0;
+
+	for (i = 0; i < curr->nr_active_cpu; i++) {
+		struct irq_cpu *cpu = &curr->cpus[i];
+		int id = cpu->cpu;
+
+		if (!cpu_in_list(cpu->cpu, setsize, cpuset))
+			continue;
+		if (out->cpu_group != IRQ_GROUP_CPU)
+			id = cpu->cpu >= 0 && (size_t) cpu->cpu < out->ncpu_groups ?
+				out->cpu_groups[cpu->cpu] : 0;
+
+		/* the CPUs of the group are usually together */
+		for (j = ncells; j > 0; j--) {
+			if (cells[j - 1].id == id)
+				break;
+		}
+		if (!j) {
+			cells[ncells].id = id;
+			cells[ncells].total = 0;
+			cells[ncells].delta = 0;
+			j = ++ncells;
+		}
+		cells[j - 1].total += cpu->total;
+		cells[j - 1].delta += cpu->delta;
+	}
+
+	if (out->cpu_top) {
+		/* only the most changing cells, in order of the delta */
+		qsort(cells, ncells, sizeof(*cells), cmp_cell_delta);
+		ncells = min(ncells, out->cpu_top);
+	} else if (out->cpu_group != IRQ_GROUP_CPU)
+		qsort(cells, ncells, sizeof(*cells), cmp_cell_id);
+
+	return ncells;
+}
+
 struct libscols_table *get_scols_cpus_table(struct irq_output *out,
 					struct irq_stat *prev,
 					struct irq_stat *curr,
@@ -446,10 +674,11 @@ struct libscols_table *get_scols_cpus_table(struct irq_output *out,
 	struct libscols_table *table;
 	struct libscols_column *cl;
 	struct libscols_line *ln;
-	char colname[sizeof("cpu") + sizeof(stringify_value(LONG_MAX))];
-	size_t i, j;
+	char colname[sizeof("socket") + sizeof(stringify_value(LONG_MAX))];
+	struct irq_cell *cells;
+	size_t i, ncells;
 
-	if (prev) {
+	if (prev && prev->nr_active_cpu == curr->nr_active_cpu) {
 		for (i = 0; i < curr->nr_active_cpu; i++) {
 			struct irq_cpu *pre = &prev->cpus[i];
 			struct irq_cpu *cur = &curr->cpus[i];
@@ -458,9 +687,13 @@ struct libscols_table *get_scols_cpus_table(struct irq_output *out,
 		}
 	}
 
+	cells = xcalloc(max(curr->nr_active_cpu, (size_t) 1), sizeof(*cells));
+	ncells = get_irq_cells(out, curr, cells, setsize, cpuset);
+
 	table = scols_new_table();
 	if (!table) {
 		warn(_("failed to initialize output table"));
+		free(cells);
 		return NULL;
 	}
 	scols_table_enable_json(table, out->json);
@@ -472,10 +705,9 @@ struct libscols_table *get_scols_cpus_table(struct irq_output *out,
 	else
 		scols_table_new_column(table, "", 0, SCOLS_FL_RIGHT);
 
-	for (i = 0; i < curr->nr_active_cpu; i++) {
-		if (!cpu_in_list(i, setsize, cpuset))
-			continue;
-		snprintf(colname, sizeof(colname), "cpu%zu", i);
+	for (i = 0; i < ncells; i++) {
+		snprintf(colname, sizeof(colname), "%s%d",
+			 cpu_group_names[out->cpu_group], cells[i].id);
 		cl = scols_table_new_column(table, colname, 0, SCOLS_FL_RIGHT);
 		if (cl == NULL) {
 			warnx(_("failed to initialize output column"));
@@ -490,14 +722,11 @@ struct libscols_table *get_scols_cpus_table(struct irq_output *out,
 	if (!ln || (!out->json && scols_line_set_data(ln, 0, "%irq:") != 0))
 		goto err;
 
-	for (i = 0, j = 0; i < curr->nr_active_cpu; i++) {
-		struct irq_cpu *cpu = &curr->cpus[i];
+	for (i = 0; i < ncells; i++) {
 		char *str;
 
-		if (!cpu_in_list(i, setsize, cpuset))
-			continue;
-		xasprintf(&str, "%0.1f", (double)((long double) cpu->total / (long double) curr->total_irq * 100.0));
-		if (str && scols_line_refer_data(ln, ++j, str) != 0)
+		xasprintf(&str, "%0.1f", (double)((long double) cells[i].total / (long double) curr->total_irq * 100.0));
+		if (str && scols_line_refer_data(ln, i + 1, str) != 0)
 			goto err;
 	}
 
@@ -507,25 +736,49 @@ struct libscols_table *get_scols_cpus_table(struct irq_output *out,
 	if (!ln || (!out->json && scols_line_set_data(ln, 0, _("%delta:")) != 0))
 		goto err;
 
-	for (i = 0, j = 0; i < curr->nr_active_cpu; i++) {
-		struct irq_cpu *cpu = &curr->cpus[i];
+	for (i = 0; curr->delta_irq && i < ncells; i++) {
 		char *str;
 
-		if (!cpu_in_list(i, setsize, cpuset))
-			continue;
-		if (!curr->delta_irq)
-			continue;
-		xasprintf(&str, "%0.1f", (double)((long double) cpu->delta / (long double) curr->delta_irq * 100.0));
-		if (str && scols_line_refer_data(ln, ++j, str) != 0)
+		xasprintf(&str, "%0.1f", (double)((long double) cells[i].delta / (long double) curr->delta_irq * 100.0));
+		if (str && scols_line_refer_data(ln, i + 1, str) != 0)
 			goto err;
 	}
 
+	free(cells);
 	return table;
  err:
+	free(cells);
 	scols_unref_table(table);
 	return NULL;
 }
 
+/*
+ * Returns the line of @cur in @prev. The lines are in the same order, but
+ * some of them may be added or removed; @shift is the difference of the
+ * line numbers found for the previous line.
+ */
+static struct irq_info *find_prev_irq(struct irq_stat *prev, struct irq_info *cur,
+				      size_t idx, ssize_t *shift)
+{
+	size_t i = idx + *shift;
+
+	if (i < prev->nr_irq && strcmp(cur->irq, prev->irq_info[i].irq) == 0)
+		return &prev->irq_info[i];
+
+	for (i = 0; i < prev->nr_irq; i++) {
+		if (strcmp(cur->irq, prev->irq_info[i].irq) == 0) {
+			*shift = (ssize_t) i - (ssize_t) idx;
+			return &prev->irq_info[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Returns the table of the interrupts. The delta is counted against @prev if
+ * not NULL. The @xstat returns the new stat; *@xstat may be an old stat (not
+ * @prev) to reuse.
+ */
 struct libscols_table *get_scols_table(struct irq_output *out,
 					      struct irq_stat *prev,
 					      struct irq_stat **xstat,
@@ -534,43 +787,42 @@ struct libscols_table *get_scols_table(struct irq_output *out,
 					      cpu_set_t *cpuset)
 {
 	struct libscols_table *table;
-	struct irq_info *result;
 	struct irq_stat *stat;
-	size_t size;
 	size_t i;
 
-	/* the stats */
-	stat = get_irqinfo(softirq, setsize, cpuset);
-	if (!stat)
-		return NULL;
+	/* the stats, reuse the old stat if available */
+	stat = xstat && *xstat ? *xstat : xcalloc(1, sizeof(*stat));
+	if (xstat)
+		*xstat = NULL;
 
-	size = sizeof(*stat->irq_info) * stat->nr_irq;
-	result = xmalloc(size);
-	memcpy(result, stat->irq_info, size);
+	if (get_irqinfo(stat, softirq, setsize, cpuset) != 0) {
+		free_irqstat(stat);
+		return NULL;
+	}
 
 	if (prev) {
-		stat->delta_irq = 0;
+		ssize_t shift = 0;
+
 		for (i = 0; i < stat->nr_irq; i++) {
-			struct irq_info *cur = &result[i];
-			struct irq_info *pre = &prev->irq_info[i];
+			struct irq_info *cur = &stat->irq_info[i];
+			struct irq_info *pre = find_prev_irq(prev, cur, i, &shift);
 
-			cur->delta = cur->total - pre->total;
+			cur->delta = pre ? cur->total - pre->total : cur->total;
 			stat->delta_irq += cur->delta;
 		}
 	}
-	sort_result(out, result, stat->nr_irq);
+
+	memcpy(stat->sorted, stat->irq_info, sizeof(*stat->irq_info) * stat->nr_irq);
+	sort_result(out, stat->sorted, stat->nr_irq);
 
 	table = new_scols_table(out);
 	if (!table) {
-		free(result);
 		free_irqstat(stat);
 		return NULL;
 	}
 
 	for (i = 0; i < stat->nr_irq; i++)
-		add_scols_line(out, &result[i], table);
-
-	free(result);
+		add_scols_line(out, &stat->sorted[i], table);
 
 	if (xstat)
 		*xstat = stat;
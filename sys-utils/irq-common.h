@@ -34,6 +34,7 @@ struct irq_info {
 };
 
 struct irq_cpu {
+	int cpu;			/* CPU number */
 	unsigned long total;
 	unsigned long delta;
 };
@@ -42,6 +43,7 @@ struct irq_stat {
 	unsigned long nr_irq;		/* number of irq vector */
 	unsigned long nr_irq_info;	/* number of irq info */
 	struct irq_info *irq_info;	/* array of irq_info */
+	struct irq_info *sorted;	/* irq_info sorted for output */
 	struct irq_cpu *cpus;		 /* array of irq_cpu */
 	size_t nr_active_cpu;		/* number of active cpu */
 	unsigned long total_irq;	/* total irqs */
@@ -49,6 +51,13 @@ struct irq_stat {
 };
 
 
+/* per-cpu stat groups */
+enum {
+	IRQ_GROUP_CPU = 0,
+	IRQ_GROUP_NODE,
+	IRQ_GROUP_SOCKET
+};
+
 typedef int (irq_cmp_t)(const struct irq_info *, const struct irq_info *);
 
 /* output definition */
@@ -58,6 +67,11 @@ struct irq_output {
 
 	irq_cmp_t *sort_cmp_func;
 
+	int cpu_group;		/* IRQ_GROUP_* for per-cpu stat */
+	int *cpu_groups;	/* CPU number to node or socket */
+	size_t ncpu_groups;
+	size_t cpu_top;		/* only the top-N changing CPUs or groups */
+
 	unsigned int
 		json:1,		/* JSON output */
 		pairs:1,	/* export, NAME="value" aoutput */
@@ -69,6 +83,9 @@ void free_irqstat(struct irq_stat *stat);
 
 void irq_print_columns(FILE *f, int nodelta);
 
+int irq_cpu_group_name_to_id(const char *name);
+int irq_read_cpu_groups(struct irq_output *out, int group);
+
 void set_sort_func_by_name(struct irq_output *out, const char *name);
 void set_sort_func_by_key(struct irq_output *out, const char c);
 
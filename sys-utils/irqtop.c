@@ -68,6 +68,12 @@ enum irqtop_cpustat_mode {
 	IRQTOP_CPUSTAT_DISABLE,
 };
 
+/* line on the screen */
+struct irqtop_line {
+	char		*data;
+	int		attr;
+};
+
 /* top control struct */
 struct irqtop_ctl {
 	WINDOW		*win;
@@ -75,8 +81,13 @@ struct irqtop_ctl {
 	int		rows;
 	char		*hostname;
 
+	struct irqtop_line *frame;	/* the last printed screen */
+	size_t		frame_size;	/* allocated lines */
+	size_t		frame_nlines;	/* used lines */
+
 	struct itimerspec timer;
 	struct irq_stat	*prev_stat;
+	struct irq_stat	*free_stat;	/* to reuse by the next update */
 	size_t setsize;
 	cpu_set_t *cpuset;
 
@@ -99,14 +110,83 @@ static void parse_input(struct irqtop_ctl *ctl, struct irq_output *out, char c)
 	}
 }
 
+/* forget the last screen, everything will be printed again */
+static void reset_frame(struct irqtop_ctl *ctl)
+{
+	size_t i;
+
+	for (i = 0; i < ctl->frame_nlines; i++) {
+		free(ctl->frame[i].data);
+		ctl->frame[i].data = NULL;
+	}
+	ctl->frame_nlines = 0;
+}
+
+/*
+ * Prints the line to the @row if the line is not already on the screen. The
+ * curses refresh() sends only modified cells to the terminal, but queuing
+ * all the lines every update is expensive for large tables.
+ */
+static void print_line(struct irqtop_ctl *ctl, size_t *row,
+		       const char *data, size_t sz, int attr)
+{
+	struct irqtop_line *ln;
+
+	if (*row >= (size_t) ctl->rows)
+		return;
+
+	if (*row >= ctl->frame_size) {
+		ctl->frame = xreallocarray(ctl->frame, *row + 1, sizeof(*ln));
+		memset(ctl->frame + ctl->frame_size, 0,
+		       (*row + 1 - ctl->frame_size) * sizeof(*ln));
+		ctl->frame_size = *row + 1;
+	}
+	ln = &ctl->frame[*row];
+
+	if (*row >= ctl->frame_nlines || !ln->data || ln->attr != attr
+	    || strncmp(ln->data, data, sz) != 0 || ln->data[sz] != '\0') {
+		move(*row, 0);
+		if (attr)
+			attron(attr);
+		addnstr(data, sz);
+		if (attr)
+			attroff(attr);
+		clrtoeol();
+
+		free(ln->data);
+		ln->data = xstrndup(data, sz);
+		ln->attr = attr;
+	}
+
+	(*row)++;
+	if (*row > ctl->frame_nlines)
+		ctl->frame_nlines = *row;
+}
+
+/* prints multi-line @data, the first line with @attr (if not NULL) */
+static void print_lines(struct irqtop_ctl *ctl, size_t *row,
+			const char *data, int attr)
+{
+	while (data && *data) {
+		const char *end = strchr(data, '\n');
+		size_t sz = end ? (size_t) (end - data) : strlen(data);
+
+		print_line(ctl, row, data, sz, attr);
+		attr = 0;
+		data = end ? end + 1 : data + sz;
+	}
+}
+
 static int update_screen(struct irqtop_ctl *ctl, struct irq_output *out)
 {
 	struct libscols_table *table, *cpus = NULL;
-	struct irq_stat *stat;
+	struct irq_stat *stat = ctl->free_stat;
 	time_t now = time(NULL);
-	char timestr[64], *data, *data0, *p;
+	char timestr[64], *data, *header;
+	size_t row = 0, nlines = ctl->frame_nlines;
 
 	/* make irqs table */
+	ctl->free_stat = NULL;
 	table = get_scols_table(out, ctl->prev_stat, &stat, ctl->softirq, ctl->setsize,
 				ctl->cpuset);
 	if (!table) {
@@ -127,39 +207,43 @@ static int update_screen(struct irqtop_ctl *ctl, struct irq_output *out)
 	}
 
 	/* print header */
-	move(0, 0);
 	strtime_iso(&now, ISO_TIMESTAMP, timestr, sizeof(timestr));
-	wprintw(ctl->win, _("irqtop | total: %ld delta: %ld | %s | %s\n\n"),
+	xasprintf(&header, _("irqtop | total: %ld delta: %ld | %s | %s"),
 			   stat->total_irq, stat->delta_irq, ctl->hostname, timestr);
+	print_lines(ctl, &row, header, 0);
+	print_line(ctl, &row, "", 0, 0);
+	free(header);
 
 	/* print cpus table or not by -c option */
 	if (cpus) {
 		scols_print_table_to_string(cpus, &data);
-		wprintw(ctl->win, "%s\n\n", data);
+		print_lines(ctl, &row, data, 0);
+		print_line(ctl, &row, "", 0, 0);
 		free(data);
 	}
 
-	/* print irqs table */
-	scols_print_table_to_string(table, &data0);
-	data = data0;
-
-	p = strchr(data, '\n');
-	if (p) {
-		/* print header in reverse mode */
-		*p = '\0';
-		attron(A_REVERSE);
-		wprintw(ctl->win, "%s\n", data);
-		attroff(A_REVERSE);
-		data = p + 1;
-	}
+	/* print irqs table, header in reverse mode */
+	scols_print_table_to_string(table, &data);
+	print_lines(ctl, &row, data, A_REVERSE);
+	free(data);
+
+	/* clear lines from the previous update */
+	if (row < nlines) {
+		size_t i;
 
-	wprintw(ctl->win, "%s", data);
-	free(data0);
+		move(row, 0);
+		clrtobot();
+		for (i = row; i < nlines; i++) {
+			free(ctl->frame[i].data);
+			ctl->frame[i].data = NULL;
+		}
+	}
+	ctl->frame_nlines = row;
 
 	/* clean up */
 	scols_unref_table(table);
-	if (ctl->prev_stat)
-		free_irqstat(ctl->prev_stat);
+	scols_unref_table(cpus);
+	ctl->free_stat = ctl->prev_stat;
 	ctl->prev_stat = stat;
 	return 0;
 }
@@ -229,6 +313,8 @@ static int event_loop(struct irqtop_ctl *ctl, struct irq_output *out)
 #if HAVE_RESIZETERM
 					resizeterm(ctl->rows, ctl->cols);
 #endif
+					reset_frame(ctl);
+					clear();
 				}
 				else {
 					ctl->request_exit = 1;
@@ -261,9 +347,11 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -c, --cpu-stat <mode> show per-cpu stat (auto, enable, disable)\n"), stdout);
 	fputs(_(" -C, --cpu-list <list> specify cpus in list format\n"), stdout);
 	fputs(_(" -d, --delay <secs>   delay updates\n"), stdout);
+	fputs(_(" -g, --cpu-group <name> sum per-cpu stat by cpu, node or socket\n"), stdout);
 	fputs(_(" -o, --output <list>  define which output columns to use\n"), stdout);
 	fputs(_(" -s, --sort <column>  specify sort column\n"), stdout);
 	fputs(_(" -S, --softirq        show softirqs instead of interrupts\n"), stdout);
+	fputs(_(" -T, --cpu-top <num>  show per-cpu stat of the top <num> changing cpus or groups\n"), stdout);
 	fputs(USAGE_SEPARATOR, stdout);
 	fprintf(stdout, USAGE_HELP_OPTIONS(22));
 
@@ -291,6 +379,8 @@ static void parse_args(	struct irqtop_ctl *ctl,
 		{"cpu-stat", required_argument, NULL, 'c'},
 		{"cpu-list", required_argument, NULL, 'C'},
 		{"delay", required_argument, NULL, 'd'},
+		{"cpu-group", required_argument, NULL, 'g'},
+		{"cpu-top", required_argument, NULL, 'T'},
 		{"sort", required_argument, NULL, 's'},
 		{"output", required_argument, NULL, 'o'},
 		{"softirq", no_argument, NULL, 'S'},
@@ -298,9 +388,9 @@ static void parse_args(	struct irqtop_ctl *ctl,
 		{"version", no_argument, NULL, 'V'},
 		{NULL, 0, NULL, 0}
 	};
-	int o;
+	int o, group = IRQ_GROUP_CPU;
 
-	while ((o = getopt_long(argc, argv, "c:C:d:o:s:ShV", longopts, NULL)) != -1) {
+	while ((o = getopt_long(argc, argv, "c:C:d:g:o:s:ST:hV", longopts, NULL)) != -1) {
 		switch (o) {
 		case 'c':
 			if (!strcmp(optarg, "auto"))
@@ -337,9 +427,18 @@ static void parse_args(	struct irqtop_ctl *ctl,
 				ctl->timer.it_value = ctl->timer.it_interval;
 			}
 			break;
+		case 'g':
+			group = irq_cpu_group_name_to_id(optarg);
+			if (group < 0)
+				errx(EXIT_FAILURE, _("unsupported group '%s'"), optarg);
+			break;
 		case 's':
 			set_sort_func_by_name(out, optarg);
 			break;
+		case 'T':
+			out->cpu_top = strtou32_or_err(optarg,
+					_("failed to parse cpu-top argument"));
+			break;
 		case 'o':
 			outarg = optarg;
 			break;
@@ -355,6 +454,9 @@ static void parse_args(	struct irqtop_ctl *ctl,
 		}
 	}
 
+	if (irq_read_cpu_groups(out, group) != 0)
+		err(EXIT_FAILURE, _("failed to read CPU topology"));
+
 	/* default */
 	if (!out->ncolumns) {
 		out->columns[out->ncolumns++] = COL_IRQ;
@@ -402,6 +504,10 @@ int main(int argc, char **argv)
 	event_loop(&ctl, &out);
 
 	free_irqstat(ctl.prev_stat);
+	free_irqstat(ctl.free_stat);
+	free(out.cpu_groups);
+	reset_frame(&ctl);
+	free(ctl.frame);
 	free(ctl.hostname);
 	cpuset_free(ctl.cpuset);
 
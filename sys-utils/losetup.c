@@ -22,6 +22,9 @@
 #include <sys/stat.h>
 #include <inttypes.h>
 #include <getopt.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #include <libsmartcols.h>
 
@@ -34,6 +37,7 @@
 #include "xalloc.h"
 #include "canonicalize.h"
 #include "pathnames.h"
+#include "mangle.h"
 
 enum {
 	A_CREATE = 1,		/* setup a new device */
@@ -45,6 +49,7 @@ enum {
 	A_SET_CAPACITY,		/* set device capacity */
 	A_SET_DIRECT_IO,	/* set accessing backing file by direct io */
 	A_SET_BLOCKSIZE,	/* set logical block size of the loop device */
+	A_BATCH,		/* setup devices listed in file */
 };
 
 enum {
@@ -478,6 +483,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -c, --set-capacity <loopdev>  resize the device\n"), out);
 	fputs(_(" -j, --associated <file>       list all devices associated with <file>\n"), out);
 	fputs(_(" -L, --nooverlap               avoid possible conflict between devices\n"), out);
+	fputs(_("     --batch <file>            set up devices for files listed in <file>\n"), out);
 
 	/* commands options */
 	fputs(USAGE_SEPARATOR, out);
@@ -487,8 +493,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -P, --partscan                create a partitioned loop device\n"), out);
 	fputs(_(" -r, --read-only               set up a read-only loop device\n"), out);
 	fputs(_("     --direct-io[=<on|off>]    open backing file with O_DIRECT\n"), out);
+	fputs(_("     --auto-tune               use direct I/O and sector size of backing file\n"), out);
 	fputs(_("     --loop-ref <string>       loop device reference\n"), out);
-	fputs(_("     --show                    print device name after setup (with -f)\n"), out);
+	fputs(_("     --show                    print device name after setup (with -f or --batch)\n"), out);
 	fputs(_(" -v, --verbose                 verbose mode\n"), out);
 
 	/* output options */
@@ -558,7 +565,7 @@ static int create_loop(struct loopdev_cxt *lc,
 		       int nooverlap, int lo_flags, int flags,
 		       const char *file, const char *refname,
 		       uint64_t offset, uint64_t sizelimit,
-		       uint64_t blocksize)
+		       uint64_t blocksize, int autotune)
 {
 	int hasdev = loopcxt_has_device(lc);
 	int rc = 0, ntries = 0;
@@ -646,6 +653,8 @@ static int create_loop(struct loopdev_cxt *lc,
 			loopcxt_set_flags(lc, lo_flags);
 		if (blocksize > 0)
 			loopcxt_set_blocksize(lc, blocksize);
+		if (autotune)
+			loopcxt_set_autotune(lc, 1);
 		if (refname && (rc = loopcxt_set_refname(lc, refname))) {
 			warnx(_("cannot set loop reference string"));
 			break;
@@ -675,14 +684,295 @@ static int create_loop(struct loopdev_cxt *lc,
 	return rc;
 }
 
+/* prints the result of --auto-tune */
+static void report_autotune(const char *device)
+{
+	struct loopdev_cxt lc;
+	uint64_t blocksize = 0;
+
+	if (loopcxt_init(&lc, 0) || loopcxt_set_device(&lc, device))
+		return;
+
+	loopcxt_get_blocksize(&lc, &blocksize);
+	printf(_("%s: direct I/O %s, logical sector size %"PRIu64"\n"),
+		device, loopcxt_is_dio(&lc) ? _("on") : _("off"), blocksize);
+
+	loopcxt_deinit(&lc);
+}
+
+/*
+ * losetup --batch <file>
+ */
+#define BATCH_NTHREADS	8	/* devices set up at the same time */
+
+struct batch_entry {
+	char		*file;
+	uint64_t	offset;
+	uint64_t	sizelimit;
+	int		flags;		/* LOOPDEV_FL_{OFFSET,SIZELIMIT} */
+	int		lo_flags;	/* LO_FLAGS_* */
+	int		devnum;		/* pre-allocated device or -1 */
+
+	char		*device;	/* the result */
+	int		rc;
+};
+
+struct batch {
+	struct batch_entry	*ents;
+	size_t			nents;
+	size_t			next;		/* the next entry for a thread */
+	uint64_t		blocksize;
+	const char		*refname;
+	int			autotune;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t		lock;		/* for @next */
+	pthread_mutex_t		find_lock;	/* serializes find_unused() */
+#endif
+};
+
+/*
+ * The lines are "<file> [offset=<num>] [sizelimit=<num>] [ro] [partscan]
+ * [direct-io]", the file name may use \040 for spaces. The options from
+ * the command line are defaults for all lines.
+ */
+static void batch_read(struct batch *bt, const char *filename,
+		       int lo_flags, int flags, uint64_t offset, uint64_t sizelimit)
+{
+	FILE *f;
+	char *buf = NULL, *tok;
+	size_t bufsz = 0, lineno = 0, arysz = 0;
+
+	if (strcmp(filename, "-") == 0)
+		f = stdin;
+	else if (!(f = fopen(filename, "r" UL_CLOEXECSTR)))
+		err(EXIT_FAILURE, _("cannot open %s"), filename);
+
+	while (getline(&buf, &bufsz, f) != -1) {
+		struct batch_entry *be;
+		char *save = NULL;
+
+		lineno++;
+		tok = strtok_r(buf, " \t\n", &save);
+		if (!tok || *tok == '#')
+			continue;
+
+		if (bt->nents == arysz) {
+			arysz = arysz ? arysz * 2 : 64;
+			bt->ents = xreallocarray(bt->ents, arysz, sizeof(*be));
+		}
+		be = &bt->ents[bt->nents++];
+		memset(be, 0, sizeof(*be));
+
+		be->file = xstrdup(tok);
+		unmangle_string(be->file);
+		be->offset = offset;
+		be->sizelimit = sizelimit;
+		be->flags = flags;
+		be->lo_flags = lo_flags;
+		be->devnum = -1;
+
+		while ((tok = strtok_r(NULL, " \t\n", &save))) {
+			uintmax_t num;
+
+			if (strncmp(tok, "offset=", 7) == 0) {
+				if (strtosize(tok + 7, &num) != 0)
+					goto fail;
+				be->offset = num;
+				be->flags |= LOOPDEV_FL_OFFSET;
+			} else if (strncmp(tok, "sizelimit=", 10) == 0) {
+				if (strtosize(tok + 10, &num) != 0)
+					goto fail;
+				be->sizelimit = num;
+				be->flags |= LOOPDEV_FL_SIZELIMIT;
+			} else if (strcmp(tok, "ro") == 0)
+				be->lo_flags |= LO_FLAGS_READ_ONLY;
+			else if (strcmp(tok, "partscan") == 0)
+				be->lo_flags |= LO_FLAGS_PARTSCAN;
+			else if (strcmp(tok, "direct-io") == 0)
+				be->lo_flags |= LO_FLAGS_DIRECT_IO;
+			else
+				goto fail;
+		}
+	}
+
+	free(buf);
+	if (f != stdin)
+		fclose(f);
+	return;
+fail:
+	errx(EXIT_FAILURE, _("%s:%zu: unsupported field '%s'"), filename, lineno, tok);
+}
+
+static int batch_setup_device(struct loopdev_cxt *lc, struct batch *bt,
+			      struct batch_entry *be)
+{
+	int rc;
+
+	if (be->flags & LOOPDEV_FL_OFFSET)
+		loopcxt_set_offset(lc, be->offset);
+	if (be->flags & LOOPDEV_FL_SIZELIMIT)
+		loopcxt_set_sizelimit(lc, be->sizelimit);
+	if (be->lo_flags)
+		loopcxt_set_flags(lc, be->lo_flags);
+	if (bt->blocksize > 0)
+		loopcxt_set_blocksize(lc, bt->blocksize);
+	if (bt->autotune)
+		loopcxt_set_autotune(lc, 1);
+	if (bt->refname && (rc = loopcxt_set_refname(lc, bt->refname)))
+		return rc;
+	if ((rc = loopcxt_set_backing_file(lc, be->file)))
+		return rc;
+
+	errno = 0;
+	return loopcxt_setup_device(lc);
+}
+
+static void batch_setup(struct batch *bt, struct batch_entry *be)
+{
+	struct loopdev_cxt lc;
+	int rc = -EBUSY, ntries = 0;
+
+	if (loopcxt_init(&lc, 0)) {
+		be->rc = -errno;
+		warn(_("failed to initialize loopcxt"));
+		return;
+	}
+
+	if (be->devnum >= 0) {
+		char name[16];
+
+		snprintf(name, sizeof(name), "loop%d", be->devnum);
+		if (loopcxt_set_device(&lc, name) == 0)
+			rc = batch_setup_device(&lc, bt, be);
+		else
+			errno = EBUSY;
+	}
+
+	/* not pre-allocated or used by another process in the meantime */
+	if (rc && (errno == EBUSY || errno == EAGAIN)) {
+#ifdef HAVE_PTHREAD
+		pthread_mutex_lock(&bt->find_lock);
+#endif
+		do {
+			if ((rc = find_unused(&lc)))
+				break;
+			rc = batch_setup_device(&lc, bt, be);
+			if (rc == 0 || (errno != EBUSY && errno != EAGAIN))
+				break;
+			xusleep(200000);
+		} while (++ntries < 64);
+#ifdef HAVE_PTHREAD
+		pthread_mutex_unlock(&bt->find_lock);
+#endif
+	}
+
+	be->rc = rc;
+	if (rc == 0) {
+		be->device = loopcxt_strdup_device(&lc);
+		warn_size(be->file, be->sizelimit, be->offset, be->flags);
+	} else
+		warn(_("%s: failed to set up loop device"), be->file);
+
+	loopcxt_deinit(&lc);
+}
+
+static void *batch_worker(void *data)
+{
+	struct batch *bt = data;
+
+	do {
+		size_t i;
+
+#ifdef HAVE_PTHREAD
+		pthread_mutex_lock(&bt->lock);
+#endif
+		i = bt->next++;
+#ifdef HAVE_PTHREAD
+		pthread_mutex_unlock(&bt->lock);
+#endif
+		if (i >= bt->nents)
+			break;
+		batch_setup(bt, &bt->ents[i]);
+	} while (1);
+
+	return NULL;
+}
+
+/*
+ * The devices are pre-allocated for all lines at the beginning and set up
+ * by more threads; the output is in order of the lines.
+ */
+static int batch_loops(const char *filename, int lo_flags, int flags,
+		       uint64_t offset, uint64_t sizelimit, uint64_t blocksize,
+		       const char *refname, int autotune, int showdev, int verbose)
+{
+	struct batch bt = {
+		.blocksize = blocksize,
+		.refname = refname,
+		.autotune = autotune
+	};
+	size_t i;
+	int *nums, nfound, res = 0;
+
+	batch_read(&bt, filename, lo_flags, flags, offset, sizelimit);
+	if (!bt.nents)
+		return 0;
+
+	nums = xcalloc(bt.nents, sizeof(int));
+	nfound = loopdev_find_unused_many(nums, bt.nents);
+	for (i = 0; i < bt.nents; i++)
+		bt.ents[i].devnum = nfound > 0 && i < (size_t) nfound ? nums[i] : -1;
+	free(nums);
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init(&bt.lock, NULL);
+	pthread_mutex_init(&bt.find_lock, NULL);
+	{
+		pthread_t threads[BATCH_NTHREADS];
+		size_t nthreads = 0, n = min(bt.nents, (size_t) BATCH_NTHREADS);
+
+		for (i = 0; n > 1 && i < n; i++) {
+			if (pthread_create(&threads[nthreads], NULL, batch_worker, &bt) != 0)
+				break;
+			nthreads++;
+		}
+		batch_worker(&bt);
+		for (i = 0; i < nthreads; i++)
+			pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&bt.find_lock);
+	pthread_mutex_destroy(&bt.lock);
+#else
+	batch_worker(&bt);
+#endif
+
+	for (i = 0; i < bt.nents; i++) {
+		struct batch_entry *be = &bt.ents[i];
+
+		if (be->rc)
+			res++;
+		else {
+			if (showdev)
+				printf("%s\n", be->device);
+			if (autotune && verbose)
+				report_autotune(be->device);
+		}
+		free(be->device);
+		free(be->file);
+	}
+	free(bt.ents);
+
+	return res;
+}
+
 int main(int argc, char **argv)
 {
 	struct loopdev_cxt lc;
 	int act = 0, flags = 0, no_overlap = 0, c;
 	char *file = NULL, *refname = NULL;
 	uint64_t offset = 0, sizelimit = 0, blocksize = 0;
-	int res = 0, showdev = 0, lo_flags = 0;
-	char *outarg = NULL;
+	int res = 0, showdev = 0, lo_flags = 0, autotune = 0, verbose = 0;
+	char *outarg = NULL, *batchfile = NULL;
 	int list = 0;
 	unsigned long use_dio = 0, set_dio = 0, set_blocksize = 0;
 
@@ -692,10 +982,14 @@ int main(int argc, char **argv)
 		OPT_RAW,
 		OPT_REF,
 		OPT_DIO,
-		OPT_OUTPUT_ALL
+		OPT_OUTPUT_ALL,
+		OPT_BATCH,
+		OPT_AUTOTUNE
 	};
 	static const struct option longopts[] = {
 		{ "all",          no_argument,       NULL, 'a'           },
+		{ "auto-tune",    no_argument,       NULL, OPT_AUTOTUNE  },
+		{ "batch",        required_argument, NULL, OPT_BATCH     },
 		{ "set-capacity", required_argument, NULL, 'c'           },
 		{ "detach",       required_argument, NULL, 'd'           },
 		{ "detach-all",   no_argument,       NULL, 'D'           },
@@ -723,10 +1017,12 @@ int main(int argc, char **argv)
 	};
 
 	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
-		{ 'D','a','c','d','f','j' },
+		{ 'D','a','c','d','f','j', OPT_BATCH },
 		{ 'D','c','d','f','l' },
 		{ 'D','c','d','f','O' },
 		{ 'J',OPT_RAW },
+		{ 'b',OPT_AUTOTUNE },
+		{ OPT_DIO,OPT_AUTOTUNE },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -773,6 +1069,10 @@ int main(int argc, char **argv)
 		case 'D':
 			act = A_DELETE_ALL;
 			break;
+		case OPT_BATCH:
+			act = A_BATCH;
+			batchfile = optarg;
+			break;
 		case 'f':
 			act = A_FIND_FREE;
 			break;
@@ -822,6 +1122,10 @@ int main(int argc, char **argv)
 				lo_flags |= LO_FLAGS_DIRECT_IO;
 			break;
 		case 'v':
+			verbose = 1;
+			break;
+		case OPT_AUTOTUNE:
+			autotune = 1;
 			break;
 		case OPT_SIZELIMIT:			/* --sizelimit */
 			sizelimit = strtosize_or_err(optarg, _("failed to parse size"));
@@ -918,14 +1222,17 @@ int main(int argc, char **argv)
 		file = argv[optind++];
 	}
 
-	if (act != A_CREATE &&
-	    (sizelimit || lo_flags || showdev))
+	if (act == A_BATCH && optind < argc)
+		errx(EXIT_FAILURE, _("unexpected arguments"));
+
+	if (act != A_CREATE && act != A_BATCH &&
+	    (sizelimit || lo_flags || showdev || autotune))
 		errx(EXIT_FAILURE,
 			_("the options %s are allowed during loop device setup only"),
-			"--{sizelimit,partscan,read-only,show}");
+			"--{sizelimit,partscan,read-only,show,auto-tune}");
 
 	if ((flags & LOOPDEV_FL_OFFSET) &&
-	    act != A_CREATE && (act != A_SHOW || !file))
+	    act != A_CREATE && act != A_BATCH && (act != A_SHOW || !file))
 		errx(EXIT_FAILURE, _("the option --offset is not allowed in this context"));
 
 	if (outarg && string_add_to_idarray(outarg, columns, ARRAY_SIZE(columns),
@@ -935,13 +1242,19 @@ int main(int argc, char **argv)
 	switch (act) {
 	case A_CREATE:
 		res = create_loop(&lc, no_overlap, lo_flags, flags, file, refname,
-				  offset, sizelimit, blocksize);
+				  offset, sizelimit, blocksize, autotune);
 		if (res == 0) {
 			if (showdev)
 				printf("%s\n", loopcxt_get_device(&lc));
+			if (autotune && verbose)
+				report_autotune(loopcxt_get_device(&lc));
 			warn_size(file, sizelimit, offset, flags);
 		}
 		break;
+	case A_BATCH:
+		res = batch_loops(batchfile, lo_flags, flags, offset, sizelimit,
+				  blocksize, refname, autotune, showdev, verbose);
+		break;
 	case A_DELETE:
 		res = delete_loop(&lc);
 		while (optind < argc) {
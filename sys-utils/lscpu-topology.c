@@ -41,6 +41,21 @@ static int add_cpuset_to_array(cpu_set_t **ary, size_t *items, cpu_set_t *set, s
 	return 1;
 }
 
+/* returns set from the @ary which contains @cpu */
+static cpu_set_t *find_cpuset_in_array(cpu_set_t **ary, size_t items, int cpu, size_t setsize)
+{
+	size_t i;
+
+	if (!ary)
+		return NULL;
+
+	for (i = 0; i < items; i++) {
+		if (CPU_ISSET_S(cpu, setsize, ary[i]))
+			return ary[i];
+	}
+	return NULL;
+}
+
 static void free_cpuset_array(cpu_set_t **ary, int items)
 {
 	int i;
@@ -127,14 +142,20 @@ static int cputype_read_topology(struct lscpu_cxt *cxt, struct lscpu_cputype *ct
 					"cpu%d/topology/thread_siblings", num) != 0)
 			continue;
 
-		/* read topology maps */
-		ul_path_readf_cpuset(sys, &thread_siblings, cxt->maxcpus,
+		/* read topology maps; the siblings are the same for all CPUs
+		 * in the map, so don't read the map again if the CPU is
+		 * already in a map read for another CPU */
+		if (!find_cpuset_in_array(ct->coremaps, ct->ncores, num, cxt->setsize))
+			ul_path_readf_cpuset(sys, &thread_siblings, cxt->maxcpus,
 					"cpu%d/topology/thread_siblings", num);
-		ul_path_readf_cpuset(sys, &core_siblings, cxt->maxcpus,
+		if (!find_cpuset_in_array(ct->socketmaps, ct->nsockets, num, cxt->setsize))
+			ul_path_readf_cpuset(sys, &core_siblings, cxt->maxcpus,
 					"cpu%d/topology/core_siblings", num);
-		ul_path_readf_cpuset(sys, &book_siblings, cxt->maxcpus,
+		if (!find_cpuset_in_array(ct->bookmaps, ct->nbooks, num, cxt->setsize))
+			ul_path_readf_cpuset(sys, &book_siblings, cxt->maxcpus,
 					"cpu%d/topology/book_siblings", num);
-		ul_path_readf_cpuset(sys, &drawer_siblings, cxt->maxcpus,
+		if (!find_cpuset_in_array(ct->drawermaps, ct->ndrawers, num, cxt->setsize))
+			ul_path_readf_cpuset(sys, &drawer_siblings, cxt->maxcpus,
 					"cpu%d/topology/drawer_siblings", num);
 
 		if (thread_siblings)
@@ -384,6 +405,20 @@ static int read_sparc_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 	return 0;
 }
 
+/* returns number of the known caches shared by @cpu */
+static size_t count_cpu_caches(struct lscpu_cxt *cxt, int cpu)
+{
+	size_t i, n = 0;
+
+	for (i = 0; i < cxt->ncaches; i++) {
+		struct lscpu_cache *ca = &cxt->caches[i];
+
+		if (ca->sharedmap && CPU_ISSET_S(cpu, cxt->setsize, ca->sharedmap))
+			n++;
+	}
+	return n;
+}
+
 static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 {
 	char buf[256];
@@ -400,6 +435,14 @@ static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 				"cpu%d/l1_icache_size", num) == 0)
 		return read_sparc_caches(cxt, cpu);
 
+	/* Every cache is in one cpuN/cache/indexM directory. If all the caches
+	 * of the CPU are already known from shared_cpu_map of other CPUs,
+	 * then there is nothing new to read. */
+	if (ncaches && count_cpu_caches(cxt, num) == ncaches) {
+		DBG(CPU, ul_debugobj(cpu, "#%d all %zd caches already known", num, ncaches));
+		return 0;
+	}
+
 	DBG(CPU, ul_debugobj(cpu, "#%d reading %zd caches", num, ncaches));
 
 	for (i = 0; i < ncaches; i++) {
@@ -40,6 +40,7 @@
 #include "procfs.h"
 #include "ipcutils.h"
 #include "timeutils.h"
+#include "idcache.h"
 
 /*
  * time modes
@@ -234,6 +235,8 @@ static int column_name_to_id(const char *name, size_t namesz)
 	return -1;
 }
 
+static struct idcache *uid_cache, *gid_cache;
+
 static int get_column_id(int num)
 {
 	assert(num >= 0);
@@ -247,20 +250,25 @@ static const struct lsipc_coldesc *get_column_desc(int num)
 	return &coldescs[ get_column_id(num) ];
 }
 
-static char *get_username(struct passwd **pw, uid_t id)
+/* the whole database is read after more misses, see lib/idcache.c */
+static char *get_username(uid_t id)
 {
-	if (!*pw || (*pw)->pw_uid != id)
-		*pw = getpwuid(id);
+	struct identry *ent;
+
+	add_uid(uid_cache, id);
+	ent = get_id(uid_cache, id);
 
-	return *pw ? xstrdup((*pw)->pw_name) : NULL;
+	return ent ? xstrdup(ent->name) : NULL;
 }
 
-static char *get_groupname(struct group **gr, gid_t id)
+static char *get_groupname(gid_t id)
 {
-	if (!*gr || (*gr)->gr_gid != id)
-		*gr = getgrgid(id);
+	struct identry *ent;
 
-	return *gr ? xstrdup((*gr)->gr_name) : NULL;
+	add_gid(gid_cache, id);
+	ent = get_id(gid_cache, id);
+
+	return ent ? xstrdup(ent->name) : NULL;
 }
 
 static int parse_time_mode(const char *s)
@@ -547,8 +555,6 @@ static void setup_sem_elements_columns(struct libscols_table *tb)
 static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 {
 	struct libscols_line *ln;
-	struct passwd *pw = NULL, *cpw = NULL;
-	struct group *gr = NULL, *cgr = NULL;
 	struct sem_data *semds, *p;
 	char *arg = NULL;
 
@@ -578,7 +584,7 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_OWNER:
-				arg = get_username(&pw, p->sem_perm.uid);
+				arg = get_username(p->sem_perm.uid);
 				if (!arg)
 					xasprintf(&arg, "%u", p->sem_perm.uid);
 				rc = scols_line_refer_data(ln, n, arg);
@@ -597,7 +603,7 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CUSER:
-				arg = get_username(&cpw, p->sem_perm.cuid);
+				arg = get_username(p->sem_perm.cuid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -606,7 +612,7 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CGROUP:
-				arg = get_groupname(&cgr, p->sem_perm.cgid);
+				arg = get_groupname(p->sem_perm.cgid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -615,7 +621,7 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_USER:
-				arg = get_username(&pw, p->sem_perm.uid);
+				arg = get_username(p->sem_perm.uid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -624,7 +630,7 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_GROUP:
-				arg = get_groupname(&gr, p->sem_perm.gid);
+				arg = get_groupname(p->sem_perm.gid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -743,8 +749,6 @@ static void do_sem_global(struct lsipc_control *ctl, struct libscols_table *tb)
 static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 {
 	struct libscols_line *ln;
-	struct passwd *pw = NULL;
-	struct group *gr = NULL;
 	struct msg_data *msgds, *p;
 	char *arg = NULL;
 
@@ -762,14 +766,6 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 		if (!ln)
 			err(EXIT_FAILURE, _("failed to allocate output line"));
 
-		/* no need to call getpwuid() for the same user */
-		if (!(pw && pw->pw_uid == p->msg_perm.uid))
-			pw = getpwuid(p->msg_perm.uid);
-
-		/* no need to call getgrgid() for the same user */
-		if (!(gr && gr->gr_gid == p->msg_perm.gid))
-			gr = getgrgid(p->msg_perm.gid);
-
 		for (n = 0; n < ncolumns; n++) {
 			int rc = 0;
 
@@ -783,7 +779,7 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_OWNER:
-				arg = get_username(&pw, p->msg_perm.uid);
+				arg = get_username(p->msg_perm.uid);
 				if (!arg)
 					xasprintf(&arg, "%u", p->msg_perm.uid);
 				rc = scols_line_refer_data(ln, n, arg);
@@ -802,7 +798,7 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CUSER:
-				arg = get_username(&pw, p->msg_perm.cuid);
+				arg = get_username(p->msg_perm.cuid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -811,7 +807,7 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CGROUP:
-				arg = get_groupname(&gr, p->msg_perm.cgid);
+				arg = get_groupname(p->msg_perm.cgid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -820,7 +816,7 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_USER:
-				arg = get_username(&pw, p->msg_perm.uid);
+				arg = get_username(p->msg_perm.uid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -829,7 +825,7 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_GROUP:
-				arg = get_groupname(&gr, p->msg_perm.gid);
+				arg = get_groupname(p->msg_perm.gid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -909,8 +905,6 @@ static void do_msg_global(struct lsipc_control *ctl, struct libscols_table *tb)
 static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 {
 	struct libscols_line *ln;
-	struct passwd *pw = NULL;
-	struct group *gr = NULL;
 	struct shm_data *shmds, *p;
 	char *arg = NULL;
 
@@ -942,7 +936,7 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_OWNER:
-				arg = get_username(&pw, p->shm_perm.uid);
+				arg = get_username(p->shm_perm.uid);
 				if (!arg)
 					xasprintf(&arg, "%u", p->shm_perm.uid);
 				rc = scols_line_refer_data(ln, n, arg);
@@ -961,7 +955,7 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CUSER:
-				arg = get_username(&pw, p->shm_perm.cuid);
+				arg = get_username(p->shm_perm.cuid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -970,7 +964,7 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CGROUP:
-				arg = get_groupname(&gr, p->shm_perm.cgid);
+				arg = get_groupname(p->shm_perm.cgid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -979,7 +973,7 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_USER:
-				arg = get_username(&pw, p->shm_perm.uid);
+				arg = get_username(p->shm_perm.uid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -988,7 +982,7 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_GROUP:
-				arg = get_groupname(&gr, p->shm_perm.gid);
+				arg = get_groupname(p->shm_perm.gid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -1167,6 +1161,11 @@ int main(int argc, char *argv[])
 
 	scols_init_debug(0);
 
+	uid_cache = new_idcache();
+	gid_cache = new_idcache();
+	if (!uid_cache || !gid_cache)
+		err_oom();
+
 	while ((opt = getopt_long(argc, argv, "bceghi:Jlmno:PqrstVy", longopts, NULL)) != -1) {
 
 		err_exclusive_options(opt, longopts, excl, excl_st);
@@ -1358,6 +1357,8 @@ int main(int argc, char *argv[])
 	print_table(ctl, tb);
 
 	scols_unref_table(tb);
+	free_idcache(uid_cache);
+	free_idcache(gid_cache);
 	free(ctl);
 
 	return EXIT_SUCCESS;
@@ -26,6 +26,9 @@
 #include <assert.h>
 #include <optutils.h>
 #include <libsmartcols.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #define _PATH_SYS_MEMORY		"/sys/devices/system/memory"
 
@@ -65,6 +68,7 @@ struct lsmem {
 	uint64_t		block_size;
 	uint64_t		mem_online;
 	uint64_t		mem_offline;
+	size_t			njobs;			/* --jobs */
 
 	struct libscols_table	*table;
 	unsigned int		have_nodes : 1,
@@ -325,13 +329,25 @@ static void print_summary(struct lsmem *lsmem)
 	}
 }
 
-static int memory_block_get_node(struct lsmem *lsmem, char *name)
+/* blocks read from a part of the memory<N> directories */
+struct memory_reader {
+	struct lsmem		*lsmem;
+	struct path_cxt		*sysmem;	/* path_cxt is not thread-safe */
+	int			first;		/* the first lsmem->dirs[] entry */
+	int			last;		/* behind the last entry */
+	struct memory_block	*blocks;	/* merged blocks */
+	int			nblocks;
+	uint64_t		mem_online;
+	uint64_t		mem_offline;
+};
+
+static int memory_block_get_node(struct path_cxt *sysmem, char *name)
 {
 	struct dirent *de;
 	DIR *dir;
 	int node;
 
-	dir = ul_path_opendir(lsmem->sysmem, name);
+	dir = ul_path_opendir(sysmem, name);
 	if (!dir)
 		err(EXIT_FAILURE, _("Failed to open %s"), name);
 
@@ -351,64 +367,64 @@ static int memory_block_get_node(struct lsmem *lsmem, char *name)
 	return node;
 }
 
-static int memory_block_read_attrs(struct lsmem *lsmem, char *name,
-				    struct memory_block *blk)
+static int memory_block_read_attrs(struct lsmem *lsmem, struct path_cxt *sysmem,
+				   char *name, struct memory_block *blk)
 {
-	char *line = NULL;
-	int i, x = 0, rc = 0;
+	struct ul_path_attr attrs[] = {
+		{ .name = "removable" },
+		{ .name = "state" },
+		{ .name = "valid_zones" }	/* the last, optional */
+	};
+	const char *line;
+	int i, rc = 0;
 
 	memset(blk, 0, sizeof(*blk));
 
-	errno = 0;
 	blk->count = 1;
 	blk->state = MEMORY_STATE_UNKNOWN;
-	blk->index = strtoumax(name + 6, NULL, 10); /* get <num> of "memory<num>" */
-
-	if (errno)
+	/* get <num> of "memory<num>" */
+	if (!ul_scan_u64(name + 6, NULL, &blk->index))
 		rc = -errno;
 
-	if (ul_path_readf_s32(lsmem->sysmem, &x, "%s/removable", name) == 0)
-		blk->removable = x == 1;
+	ul_path_read_attrs(sysmem, name, attrs,
+			   ARRAY_SIZE(attrs) - (lsmem->have_zones ? 0 : 1), NULL);
+
+	if ((line = attrs[0].value))
+		blk->removable = strtol(line, NULL, 10) == 1;
 
-	if (ul_path_readf_string(lsmem->sysmem, &line, "%s/state", name) > 0 && line) {
+	if ((line = attrs[1].value)) {
 		if (strcmp(line, "offline") == 0)
 			blk->state = MEMORY_STATE_OFFLINE;
 		else if (strcmp(line, "online") == 0)
 			blk->state = MEMORY_STATE_ONLINE;
 		else if (strcmp(line, "going-offline") == 0)
 			blk->state = MEMORY_STATE_GOING_OFFLINE;
-		free(line);
 	}
 
 	if (lsmem->have_nodes)
-		blk->node = memory_block_get_node(lsmem, name);
+		blk->node = memory_block_get_node(sysmem, name);
 
 	blk->nr_zones = 0;
-	if (lsmem->have_zones
-	    && ul_path_readf_string(lsmem->sysmem, &line, "%s/valid_zones", name) > 0
-	    && line) {
-
-		char *token = strtok(line, " ");
+	if (lsmem->have_zones && attrs[2].value && *attrs[2].value) {
+		char *token = strtok(attrs[2].value, " ");
 
 		for (i = 0; token && i < MAX_NR_ZONES; i++) {
 			blk->zones[i] = zone_name_to_id(token);
 			blk->nr_zones++;
 			token = strtok(NULL, " ");
 		}
-		free(line);
 	}
 
 	return rc;
 }
 
-static int is_mergeable(struct lsmem *lsmem, struct memory_block *blk)
+static int is_mergeable(struct lsmem *lsmem, struct memory_block *curr,
+			struct memory_block *blk)
 {
-	struct memory_block *curr;
 	int i;
 
-	if (!lsmem->nblocks)
+	if (!curr)
 		return 0;
-	curr = &lsmem->blocks[lsmem->nblocks - 1];
 	if (lsmem->list_all)
 		return 0;
 	if (curr->index + curr->count != blk->index)
@@ -445,34 +461,118 @@ static void free_info(struct lsmem *lsmem)
 	free(lsmem->dirs);
 }
 
-static void read_info(struct lsmem *lsmem)
+/* adds @blk (may be already merged range) to @blocks, or merges it with the last one */
+static void add_memory_block(struct lsmem *lsmem, struct memory_block **blocks,
+			     int *nblocks, struct memory_block *blk)
+{
+	struct memory_block *curr = *nblocks ? &(*blocks)[*nblocks - 1] : NULL;
+
+	if (is_mergeable(lsmem, curr, blk)) {
+		curr->count += blk->count;
+		return;
+	}
+	*blocks = xreallocarray(*blocks, *nblocks + 1, sizeof(*blk));
+	(*blocks)[(*nblocks)++] = *blk;
+}
+
+static void *read_memory_blocks(void *data)
 {
+	struct memory_reader *rd = data;
+	struct lsmem *lsmem = rd->lsmem;
 	struct memory_block blk;
-	char buf[128];
 	int i;
 
+	for (i = rd->first; i < rd->last; i++) {
+		memory_block_read_attrs(lsmem, rd->sysmem, lsmem->dirs[i]->d_name, &blk);
+		if (blk.state == MEMORY_STATE_ONLINE)
+			rd->mem_online += lsmem->block_size;
+		else
+			rd->mem_offline += lsmem->block_size;
+		add_memory_block(lsmem, &rd->blocks, &rd->nblocks, &blk);
+	}
+	return NULL;
+}
+
+#ifdef HAVE_PTHREAD
+/*
+ * Every reader reads a part of the directories and merges the blocks. The
+ * first part is read by the main thread. The parts of the readers which
+ * cannot be started are read by the main thread too.
+ */
+static void read_memory_blocks_parallel(struct lsmem *lsmem,
+					struct memory_reader *rds, size_t nrds)
+{
+	pthread_t *threads = xcalloc(nrds, sizeof(pthread_t));
+	char *started = xcalloc(nrds, sizeof(char));
+	const char *prefix = ul_path_get_prefix(lsmem->sysmem);
+	size_t i;
+
+	for (i = 1; i < nrds; i++) {
+		struct memory_reader *rd = &rds[i];
+
+		rd->sysmem = ul_new_path(_PATH_SYS_MEMORY);
+		if (!rd->sysmem || (prefix && ul_path_set_prefix(rd->sysmem, prefix) != 0))
+			err(EXIT_FAILURE, _("failed to initialize %s handler"), _PATH_SYS_MEMORY);
+		if (pthread_create(&threads[i], NULL, read_memory_blocks, rd) == 0)
+			started[i] = 1;
+	}
+
+	for (i = 0; i < nrds; i++) {
+		if (i && started[i])
+			pthread_join(threads[i], NULL);
+		else
+			read_memory_blocks(&rds[i]);
+	}
+
+	for (i = 1; i < nrds; i++)
+		ul_unref_path(rds[i].sysmem);
+	free(started);
+	free(threads);
+}
+#endif
+
+static void read_info(struct lsmem *lsmem)
+{
+	struct memory_reader *rds;
+	char buf[128];
+	size_t i, nrds;
+	int j;
+
 	if (ul_path_read_buffer(lsmem->sysmem, buf, sizeof(buf), "block_size_bytes") <= 0)
 		err(EXIT_FAILURE, _("failed to read memory block size"));
 
-	errno = 0;
-	lsmem->block_size = strtoumax(buf, NULL, 16);
-	if (errno)
+	if (!ul_scan_x64(buf, NULL, &lsmem->block_size))
 		err(EXIT_FAILURE, _("failed to read memory block size"));
 
-	for (i = 0; i < lsmem->ndirs; i++) {
-		memory_block_read_attrs(lsmem, lsmem->dirs[i]->d_name, &blk);
-		if (blk.state == MEMORY_STATE_ONLINE)
-			lsmem->mem_online += lsmem->block_size;
-		else
-			lsmem->mem_offline += lsmem->block_size;
-		if (is_mergeable(lsmem, &blk)) {
-			lsmem->blocks[lsmem->nblocks - 1].count++;
-			continue;
-		}
-		lsmem->nblocks++;
-		lsmem->blocks = xreallocarray(lsmem->blocks, lsmem->nblocks, sizeof(blk));
-		*&lsmem->blocks[lsmem->nblocks - 1] = blk;
+	nrds = max((size_t) 1, min(lsmem->njobs, (size_t) lsmem->ndirs));
+	rds = xcalloc(nrds, sizeof(*rds));
+
+	for (i = 0; i < nrds; i++) {
+		rds[i].lsmem = lsmem;
+		rds[i].sysmem = lsmem->sysmem;
+		rds[i].first = lsmem->ndirs * i / nrds;
+		rds[i].last = lsmem->ndirs * (i + 1) / nrds;
 	}
+
+#ifdef HAVE_PTHREAD
+	if (nrds > 1)
+		read_memory_blocks_parallel(lsmem, rds, nrds);
+	else
+#endif
+		read_memory_blocks(&rds[0]);
+
+	/* the parts are in order, merge the ranges on the boundaries */
+	for (i = 0; i < nrds; i++) {
+		struct memory_reader *rd = &rds[i];
+
+		for (j = 0; j < rd->nblocks; j++)
+			add_memory_block(lsmem, &lsmem->blocks, &lsmem->nblocks,
+					 &rd->blocks[j]);
+		lsmem->mem_online += rd->mem_online;
+		lsmem->mem_offline += rd->mem_offline;
+		free(rd->blocks);
+	}
+	free(rds);
 }
 
 static int memory_block_filter(const struct dirent *de)
@@ -495,7 +595,7 @@ static void read_basic_info(struct lsmem *lsmem)
 	if (lsmem->ndirs <= 0)
 		err(EXIT_FAILURE, _("Failed to read %s"), dir);
 
-	if (memory_block_get_node(lsmem, lsmem->dirs[0]->d_name) != -1)
+	if (memory_block_get_node(lsmem->sysmem, lsmem->dirs[0]->d_name) != -1)
 		lsmem->have_nodes = 1;
 
 	/* The valid_zones sysmem attribute was introduced with kernel 3.18 */
@@ -519,6 +619,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -P, --pairs          use key=\"value\" output format\n"), out);
 	fputs(_(" -a, --all            list each individual memory block\n"), out);
 	fputs(_(" -b, --bytes          print SIZE in bytes rather than in human readable format\n"), out);
+	fputs(_("     --jobs <num>     read the memory blocks by up to <num> threads\n"), out);
 	fputs(_(" -n, --noheadings     don't print headings\n"), out);
 	fputs(_(" -o, --output <list>  output columns\n"), out);
 	fputs(_("     --output-all     output all columns\n"), out);
@@ -552,13 +653,15 @@ int main(int argc, char **argv)
 
 	enum {
 		LSMEM_OPT_SUMARRY = CHAR_MAX + 1,
-		OPT_OUTPUT_ALL
+		OPT_OUTPUT_ALL,
+		OPT_JOBS
 	};
 
 	static const struct option longopts[] = {
 		{"all",		no_argument,		NULL, 'a'},
 		{"bytes",	no_argument,		NULL, 'b'},
 		{"help",	no_argument,		NULL, 'h'},
+		{"jobs",	required_argument,	NULL, OPT_JOBS},
 		{"json",	no_argument,		NULL, 'J'},
 		{"noheadings",	no_argument,		NULL, 'n'},
 		{"output",	required_argument,	NULL, 'o'},
@@ -598,6 +701,10 @@ int main(int argc, char **argv)
 			lsmem->json = 1;
 			lsmem->want_summary = 0;
 			break;
+		case OPT_JOBS:
+			lsmem->njobs = str2unum_or_err(optarg, 10,
+					_("invalid jobs argument"), 1024);
+			break;
 		case 'n':
 			lsmem->noheadings = 1;
 			break;
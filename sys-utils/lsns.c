@@ -20,6 +20,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <wchar.h>
+#include <search.h>
 #include <libsmartcols.h>
 #include <libmount.h>
 # include <stdbool.h>
@@ -222,12 +223,20 @@ struct lsns {
 
 	struct libmnt_table *tab;
 	struct libscols_filter *filter;
+
+	void *namespaces_tree;		/* namespaces by id, see get_namespace() */
 };
 
 struct netnsid_cache {
 	ino_t ino;
 	int   id;
-	struct list_head netnsids;
+};
+
+/* parent and owner of the namespace, see get_ns_ino() */
+struct ns_relations {
+	ino_t ino;
+	ino_t pino;
+	ino_t oino;
 };
 
 /* "userdata" used by callback for libsmartcols filter */
@@ -237,7 +246,8 @@ struct filler_data {
 	struct lsns_process *proc;
 };
 
-static struct list_head netnsids_cache;
+static void *netnsids_cache;
+static void *ns_relations_cache;
 
 static int netlink_fd = -1;
 
@@ -298,6 +308,16 @@ static inline const struct colinfo *get_column_info(unsigned num)
 	return &infos[ get_column_id(num) ];
 }
 
+/* all the caches and indexes are keyed by the inode (or PID) at the start */
+static int cmp_ino(const void *a, const void *b)
+{
+	return cmp_numbers(*(const ino_t *) a, *(const ino_t *) b);
+}
+
+static void free_nothing(void *node __attribute__((__unused__)))
+{
+}
+
 static int get_ns_ino(struct path_cxt *pc, const char *nsname, ino_t *ino, ino_t *pino, ino_t *oino)
 {
 	struct stat st;
@@ -314,7 +334,17 @@ static int get_ns_ino(struct path_cxt *pc, const char *nsname, ino_t *ino, ino_t
 	*oino = 0;
 
 #ifdef USE_NS_GET_API
+	struct ns_relations **rel, *new;
 	int fd, pfd, ofd;
+
+	/* the relations are the same for all processes in the namespace */
+	rel = tfind(ino, &ns_relations_cache, cmp_ino);
+	if (rel) {
+		*pino = (*rel)->pino;
+		*oino = (*rel)->oino;
+		return 0;
+	}
+
 	fd = ul_path_open(pc, 0, path);
 	if (fd < 0)
 		return -errno;
@@ -357,6 +387,13 @@ static int get_ns_ino(struct path_cxt *pc, const char *nsname, ino_t *ino, ino_t
 	close(ofd);
  out:
 	close(fd);
+
+	new = xmalloc(sizeof(*new));
+	new->ino = *ino;
+	new->pino = *pino;
+	new->oino = *oino;
+	if (!tsearch(new, &ns_relations_cache, cmp_ino))
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
 #endif
 	return 0;
 }
@@ -382,19 +419,12 @@ error:
 #ifdef HAVE_LINUX_NET_NAMESPACE_H
 static int netnsid_cache_find(ino_t netino, int *netnsid)
 {
-	struct list_head *p;
+	struct netnsid_cache **e = tfind(&netino, &netnsids_cache, cmp_ino);
 
-	list_for_each(p, &netnsids_cache) {
-		struct netnsid_cache *e = list_entry(p,
-						     struct netnsid_cache,
-						     netnsids);
-		if (e->ino == netino) {
-			*netnsid = e->id;
-			return 1;
-		}
-	}
-
-	return 0;
+	if (!e)
+		return 0;
+	*netnsid = (*e)->id;
+	return 1;
 }
 
 static void netnsid_cache_add(ino_t netino, int netnsid)
@@ -404,8 +434,8 @@ static void netnsid_cache_add(ino_t netino, int netnsid)
 	e = xcalloc(1, sizeof(*e));
 	e->ino = netino;
 	e->id  = netnsid;
-	INIT_LIST_HEAD(&e->netnsids);
-	list_add(&e->netnsids, &netnsids_cache);
+	if (!tsearch(e, &netnsids_cache, cmp_ino))
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
 }
 
 static int get_netnsid_via_netlink_send_request(int target_fd)
@@ -593,27 +623,22 @@ done:
 
 static int read_processes(struct lsns *ls)
 {
-	DIR *dir;
-	struct dirent *d;
+	struct procfs_iter *it;
+	pid_t pid = 0;
 	int rc = 0;
 	struct path_cxt *pc;
 
 	DBG(PROC, ul_debug("opening /proc"));
 
-	dir = opendir(_PATH_PROC);
-	if (!dir)
+	it = procfs_new_iter(NULL);
+	if (!it)
 		return -errno;
 
 	pc = ul_new_path(NULL);
 	if (!pc)
 		err(EXIT_FAILURE, _("failed to alloc procfs handler"));
 
-	while ((d = xreaddir(dir))) {
-		pid_t pid = 0;
-
-		if (procfs_dirent_get_pid(d, &pid) != 0)
-			continue;
-
+	while (procfs_iter_next(it, &pid) == 0) {
 		DBG(PROC, ul_debug("reading %d", (int) pid));
 		rc = procfs_process_init_path(pc, pid);
 		if (rc < 0) {
@@ -622,8 +647,8 @@ static int read_processes(struct lsns *ls)
 			 * a namespace is gone while running this lsns process,
 			 * procfs_process_init_path(pc, $pid) may fail.
 			 *
-			 * We must reset this `rc' here. If this `d' is the last
-			 * dentry in `dir', this read_processes() invocation
+			 * We must reset this `rc' here. If this `pid' is the last
+			 * process in /proc, this read_processes() invocation
 			 * returns this `rc'. In the caller context, the
 			 * non-zero value returned from read_processes() makes
 			 * lsns prints nothing. We should avoid the behavior. */
@@ -642,21 +667,15 @@ static int read_processes(struct lsns *ls)
 	ul_unref_path(pc);
 
 	DBG(PROC, ul_debug("closing /proc"));
-	closedir(dir);
+	procfs_free_iter(it);
 	return rc;
 }
 
 static struct lsns_namespace *get_namespace(struct lsns *ls, ino_t ino)
 {
-	struct list_head *p;
+	struct lsns_namespace **ns = tfind(&ino, &ls->namespaces_tree, cmp_ino);
 
-	list_for_each(p, &ls->namespaces) {
-		struct lsns_namespace *ns = list_entry(p, struct lsns_namespace, namespaces);
-
-		if (ns->id == ino)
-			return ns;
-	}
-	return NULL;
+	return ns ? *ns : NULL;
 }
 
 static int namespace_has_process(struct lsns_namespace *ns, pid_t pid)
@@ -691,25 +710,48 @@ static struct lsns_namespace *add_namespace(struct lsns *ls, int type, ino_t ino
 	ns->related_id[RELA_OWNER] = owner_ino;
 
 	list_add_tail(&ns->namespaces, &ls->namespaces);
+
+	/* the first namespace with the ID wins, the same as in the list */
+	if (!tsearch(ns, &ls->namespaces_tree, cmp_ino))
+		errx(EXIT_FAILURE, _("failed to allocate memory"));
 	return ns;
 }
 
-static int add_process_to_namespace(struct lsns *ls, struct lsns_namespace *ns, struct lsns_process *proc)
+static int cmp_pids(const void *a, const void *b)
+{
+	return cmp_numbers(((const struct lsns_process *) a)->pid,
+			   ((const struct lsns_process *) b)->pid);
+}
+
+static void link_parent_processes(struct lsns *ls)
 {
 	struct list_head *p;
+	void *pids = NULL;
 
-	DBG(NS, ul_debugobj(ns, "add process [%p] pid=%d to %s[%ju]",
-		proc, proc->pid, ns_names[ns->type], (uintmax_t)ns->id));
+	list_for_each(p, &ls->processes) {
+		struct lsns_process *proc = list_entry(p, struct lsns_process, processes);
+
+		if (!tsearch(proc, &pids, cmp_pids))
+			errx(EXIT_FAILURE, _("failed to allocate memory"));
+	}
 
 	list_for_each(p, &ls->processes) {
-		struct lsns_process *xproc = list_entry(p, struct lsns_process, processes);
+		struct lsns_process *proc = list_entry(p, struct lsns_process, processes);
+		struct lsns_process tmp = { .pid = proc->ppid }, **parent;
 
-		if (xproc->pid == proc->ppid)		/* my parent */
-			proc->parent = xproc;
-		else if (xproc->ppid == proc->pid)	/* my child */
-			xproc->parent = proc;
+		parent = tfind(&tmp, &pids, cmp_pids);
+		if (parent)
+			proc->parent = *parent;
 	}
 
+	tdestroy(pids, free_nothing);
+}
+
+static int add_process_to_namespace(struct lsns_namespace *ns, struct lsns_process *proc)
+{
+	DBG(NS, ul_debugobj(ns, "add process [%p] pid=%d to %s[%ju]",
+		proc, proc->pid, ns_names[ns->type], (uintmax_t)ns->id));
+
 	list_add_tail(&proc->ns_siblings[ns->type], &ns->processes);
 	ns->nprocs++;
 
@@ -867,24 +909,17 @@ static void read_related_namespaces(struct lsns *ls)
 
 	list_for_each(p, &ls->namespaces) {
 		struct lsns_namespace *ns = list_entry(p, struct lsns_namespace, namespaces);
-		struct list_head *pp;
-		list_for_each(pp, &ls->namespaces) {
-			struct lsns_namespace *pns = list_entry(pp, struct lsns_namespace, namespaces);
-			if (ns->type == LSNS_ID_USER
-			    || ns->type == LSNS_ID_PID) {
-				if (ns->related_id[RELA_PARENT] == pns->id)
-					ns->related_ns[RELA_PARENT] = pns;
-				if (ns->related_id[RELA_OWNER] == pns->id)
-					ns->related_ns[RELA_OWNER] = pns;
-				if (ns->related_ns[RELA_PARENT] && ns->related_ns[RELA_OWNER])
-					break;
-			} else {
-				if (ns->related_id[RELA_OWNER] == pns->id) {
-					ns->related_ns[RELA_OWNER] = pns;
-					break;
-				}
-			}
+		struct lsns_namespace *pns;
+
+		if (ns->type == LSNS_ID_USER
+		    || ns->type == LSNS_ID_PID) {
+			pns = get_namespace(ls, ns->related_id[RELA_PARENT]);
+			if (pns)
+				ns->related_ns[RELA_PARENT] = pns;
 		}
+		pns = get_namespace(ls, ns->related_id[RELA_OWNER]);
+		if (pns)
+			ns->related_ns[RELA_OWNER] = pns;
 
 		/* lsns scans /proc/[0-9]+ for finding namespaces.
 		 * So if a namespace has no process, lsns cannot
@@ -958,6 +993,8 @@ static int read_namespaces(struct lsns *ls)
 
 	DBG(NS, ul_debug("reading namespace"));
 
+	link_parent_processes(ls);
+
 	list_for_each(p, &ls->processes) {
 		size_t i;
 		struct lsns_namespace *ns;
@@ -972,7 +1009,7 @@ static int read_namespaces(struct lsns *ls)
 				if (!ns)
 					return -ENOMEM;
 			}
-			add_process_to_namespace(ls, ns, proc);
+			add_process_to_namespace(ns, proc);
 		}
 	}
 
@@ -1400,11 +1437,6 @@ static void free_lsns_process(struct lsns_process *lsns_p)
 	free(lsns_p);
 }
 
-static void free_netnsid_caches(struct netnsid_cache *cache)
-{
-	free(cache);
-}
-
 static void free_lsns_namespace(struct lsns_namespace *lsns_n)
 {
 	free(lsns_n);
@@ -1413,7 +1445,9 @@ static void free_lsns_namespace(struct lsns_namespace *lsns_n)
 static void free_all(struct lsns *ls)
 {
 	list_free(&ls->processes, struct lsns_process, processes, free_lsns_process);
-	list_free(&netnsids_cache, struct netnsid_cache, netnsids, free_netnsid_caches);
+	tdestroy(netnsids_cache, free);
+	tdestroy(ns_relations_cache, free);
+	tdestroy(ls->namespaces_tree, free_nothing);
 	list_free(&ls->namespaces, struct lsns_namespace, namespaces, free_lsns_namespace);
 }
 
@@ -1537,7 +1571,6 @@ int main(int argc, char *argv[])
 
 	INIT_LIST_HEAD(&ls.processes);
 	INIT_LIST_HEAD(&ls.namespaces);
-	INIT_LIST_HEAD(&netnsids_cache);
 
 	while ((c = getopt_long(argc, argv,
 				"JlPp:o:nruhVt:T::WQ:H", long_opts, NULL)) != -1) {
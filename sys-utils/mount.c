@@ -159,7 +159,27 @@ static void print_all(struct libmnt_context *cxt, char *pattern, int show_label)
 }
 
 /*
- * mount -a [-F]
+ * mount --timing
+ */
+static void print_timing(struct libmnt_context *cxt, const char *tgt)
+{
+	const char *stage, *hookset;
+	uint64_t usec;
+	unsigned int ncalls, nsyscalls;
+	size_t i;
+
+	for (i = 0; mnt_context_get_timing(cxt, i, &stage, &hookset, &usec,
+					   &ncalls, &nsyscalls) == 0; i++) {
+		fprintf(stderr, "%-25s: %-12s %-14s %10ju usec %4u %s %4u %s\n",
+			tgt ? tgt : "-", stage, hookset ? hookset : _("(total)"),
+			(uintmax_t) usec,
+			ncalls, P_("call", "calls", ncalls),
+			nsyscalls, P_("syscall", "syscalls", nsyscalls));
+	}
+}
+
+/*
+ * mount -a [-F|--parallel <n>]
  */
 static int mount_all(struct libmnt_context *cxt)
 {
@@ -179,6 +199,17 @@ static int mount_all(struct libmnt_context *cxt)
 
 		const char *tgt = mnt_fs_get_target(fs);
 
+		if (mnt_context_is_child(cxt)) {
+			/* --parallel child, the parent collects exit codes */
+			rc = mk_exit_code(cxt, mntrc);
+			if (rc == MNT_EX_SUCCESS && mnt_context_get_status(cxt)
+			    && mnt_context_is_verbose(cxt))
+				printf("%-25s: successfully mounted\n", tgt);
+			print_timing(cxt, tgt);
+			mnt_free_iter(itr);
+			return rc;
+		}
+
 		if (ignored) {
 			if (mnt_context_is_verbose(cxt))
 				printf(ignored == 1 ? _("%-25s: ignored\n") :
@@ -199,7 +230,13 @@ static int mount_all(struct libmnt_context *cxt)
 					printf("%-25s: successfully mounted\n", tgt);
 			} else
 				nerrs++;
+
+			print_timing(cxt, tgt);
 		}
+
+		/* don't duplicate buffered output in the next child */
+		if (mnt_context_is_parent(cxt))
+			fflush(stdout);
 	}
 
 	if (mnt_context_is_parent(cxt)) {
@@ -490,6 +527,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -c, --no-canonicalize   don't canonicalize paths\n"), out);
 	fputs(_(" -f, --fake              dry run; skip the mount(2) syscall\n"), out);
 	fputs(_(" -F, --fork              fork off for each device (use with -a)\n"), out);
+	fputs(_("     --parallel <num>    like --fork, but wait for parent mountpoints\n"
+		"                         and run at most <num> mounts at once\n"), out);
 	fputs(_(" -T, --fstab <path>      alternative file to /etc/fstab\n"), out);
 	fputs(_(" -i, --internal-only     don't call the mount.<type> helpers\n"), out);
 	fputs(_(" -l, --show-labels       show also filesystem labels\n"), out);
@@ -512,6 +551,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -O, --test-opts <list>  limit the set of filesystems (use with -a)\n"), out);
 	fputs(_(" -r, --read-only         mount the filesystem read-only (same as -o ro)\n"), out);
 	fputs(_(" -t, --types <list>      limit the set of filesystem types\n"), out);
+	fputs(_("     --timing            print time spent in the library hooks\n"), out);
 	fputs(_("     --source <src>      explicitly specifies source (path, label, uuid)\n"), out);
 	fputs(_("     --target <target>   explicitly specifies mountpoint\n"), out);
 	fputs(_("     --target-prefix <path>\n"
@@ -637,7 +677,9 @@ int main(int argc, char **argv)
 		MOUNT_OPT_OPTMODE,
 		MOUNT_OPT_OPTSRC,
 		MOUNT_OPT_OPTSRC_FORCE,
-		MOUNT_OPT_ONLYONCE
+		MOUNT_OPT_ONLYONCE,
+		MOUNT_OPT_PARALLEL,
+		MOUNT_OPT_TIMING
 	};
 
 	static const struct option longopts[] = {
@@ -645,6 +687,7 @@ int main(int argc, char **argv)
 		{ "fake",             no_argument,       NULL, 'f'                   },
 		{ "fstab",            required_argument, NULL, 'T'                   },
 		{ "fork",             no_argument,       NULL, 'F'                   },
+		{ "parallel",         required_argument, NULL, MOUNT_OPT_PARALLEL    },
 		{ "help",             no_argument,       NULL, 'h'                   },
 		{ "no-mtab",          no_argument,       NULL, 'n'                   },
 		{ "read-only",        no_argument,       NULL, 'r'                   },
@@ -679,6 +722,7 @@ int main(int argc, char **argv)
 		{ "target-prefix",    required_argument, NULL, MOUNT_OPT_TARGET_PREFIX },
 		{ "source",           required_argument, NULL, MOUNT_OPT_SOURCE      },
 		{ "onlyonce",         no_argument,       NULL, MOUNT_OPT_ONLYONCE    },
+		{ "timing",           no_argument,       NULL, MOUNT_OPT_TIMING      },
 		{ "options-mode",     required_argument, NULL, MOUNT_OPT_OPTMODE     },
 		{ "options-source",   required_argument, NULL, MOUNT_OPT_OPTSRC      },
 		{ "options-source-force",   no_argument, NULL, MOUNT_OPT_OPTSRC_FORCE},
@@ -733,6 +777,19 @@ int main(int argc, char **argv)
 		case 'F':
 			mnt_context_enable_fork(cxt, TRUE);
 			break;
+		case MOUNT_OPT_PARALLEL:
+		{
+			uint32_t n = strtou32_or_err(optarg, _("invalid parallel argument"));
+
+			if (!n)
+				errx(MNT_EX_USAGE, _("invalid parallel argument: %s"), optarg);
+			mnt_context_enable_fork(cxt, TRUE);
+			mnt_context_set_parallel(cxt, n);
+			break;
+		}
+		case MOUNT_OPT_TIMING:
+			mnt_context_enable_timing(cxt, TRUE);
+			break;
 		case 'i':
 			mnt_context_disable_helpers(cxt, TRUE);
 			break;
@@ -1053,6 +1110,7 @@ int main(int argc, char **argv)
 		suid_drop(cxt);
 		rc = mnt_context_mount(cxt);
 	}
+	print_timing(cxt, mnt_context_get_target(cxt));
 	rc = mk_exit_code(cxt, rc);
 
 	if (rc == MNT_EX_SUCCESS && mnt_context_is_verbose(cxt))
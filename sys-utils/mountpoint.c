@@ -20,6 +20,7 @@
 #include <string.h>
 #include <getopt.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
@@ -33,6 +34,10 @@
 
 #define MOUNTPOINT_EXIT_NOMNT	32
 
+#ifndef STATX_ATTR_MOUNT_ROOT
+# define STATX_ATTR_MOUNT_ROOT	0x00002000	/* Root of a mount */
+#endif
+
 struct mountpoint_control {
 	char *path;
 	dev_t dev;
@@ -44,7 +49,7 @@ struct mountpoint_control {
 		quiet:1;
 };
 
-static int dir_to_device(struct mountpoint_control *ctl)
+static int mountinfo_dir_to_device(struct mountpoint_control *ctl)
 {
 	struct libmnt_table *tb = mnt_new_table_from_file(_PATH_PROC_MOUNTINFO);
 	struct libmnt_fs *fs;
@@ -93,6 +98,65 @@ static int dir_to_device(struct mountpoint_control *ctl)
 	return rc;
 }
 
+/*
+ * Returns 0 if the path is a mountpoint, 1 if it is not, or -errno if the
+ * kernel does not provide STATX_ATTR_MOUNT_ROOT (since Linux 5.8).
+ */
+static int statx_is_mountpoint(struct mountpoint_control *ctl)
+{
+#if defined(HAVE_STATX) && defined(HAVE_STRUCT_STATX)
+	struct statx stx;
+
+	if (statx(AT_FDCWD, ctl->path,
+		  AT_NO_AUTOMOUNT | (ctl->nofollow ? AT_SYMLINK_NOFOLLOW : 0),
+		  0, &stx) != 0)
+		return -errno;
+	if (!(stx.stx_attributes_mask & STATX_ATTR_MOUNT_ROOT))
+		return -ENOSYS;
+	return stx.stx_attributes & STATX_ATTR_MOUNT_ROOT ? 0 : 1;
+#else
+	(void) ctl;
+	return -ENOSYS;
+#endif
+}
+
+/* reads only the mount of the path by statmount() */
+static int statmount_dir_to_device(struct mountpoint_control *ctl)
+{
+	struct libmnt_table *tb = mnt_new_table();
+	struct libmnt_fs *fs;
+	int rc = -1;
+
+	if (tb && mnt_table_fetch_listmount_target(tb, ctl->path) == 0
+	    && mnt_table_last_fs(tb, &fs) == 0) {
+		ctl->dev = mnt_fs_get_devno(fs);
+		rc = 0;
+	}
+	mnt_unref_table(tb);
+	return rc;
+}
+
+/*
+ * The kernel knows whether the path is the root of a mount, it's not
+ * necessary to parse the whole mount table for each call.
+ */
+static int dir_to_device(struct mountpoint_control *ctl)
+{
+	switch (statx_is_mountpoint(ctl)) {
+	case 0:
+		if (!ctl->fs_devno)
+			return 0;
+		if (statmount_dir_to_device(ctl) == 0)
+			return 0;
+		break;
+	case 1:
+		return -1;
+	default:
+		break;
+	}
+	return mountinfo_dir_to_device(ctl);
+}
+
 static int print_devno(const struct mountpoint_control *ctl)
 {
 	if (!S_ISBLK(ctl->st.st_mode)) {
@@ -29,6 +29,8 @@
 #include "strutils.h"
 #include "list.h"
 #include "closestream.h"
+#include "optutils.h"
+#include "procfs.h"
 
 #ifndef RLIMIT_RTTIME
 # define RLIMIT_RTTIME 15
@@ -56,6 +58,7 @@ enum {
 /* basic output flags */
 static int no_headings;
 static int raw;
+static int json;
 
 struct prlimit_desc {
 	const char *name;
@@ -102,6 +105,8 @@ enum {
 	COL_SOFT,
 	COL_HARD,
 	COL_UNITS,
+	COL_PID,
+	COL_COMMAND,
 };
 
 /* column names */
@@ -119,6 +124,8 @@ static const struct colinfo infos[] = {
 	[COL_SOFT]    = { "SOFT",        0.1,  SCOLS_FL_RIGHT, N_("soft limit")},
 	[COL_HARD]    = { "HARD",        1,    SCOLS_FL_RIGHT, N_("hard limit (ceiling)")},
 	[COL_UNITS]   = { "UNITS",       0.1,  SCOLS_FL_TRUNC, N_("units")},
+	[COL_PID]     = { "PID",         5,    SCOLS_FL_RIGHT, N_("process ID")},
+	[COL_COMMAND] = { "COMMAND",     0.2,  SCOLS_FL_TRUNC, N_("command name")},
 };
 
 static int columns[ARRAY_SIZE(infos) * 2];
@@ -158,6 +165,8 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fprintf(out,
 		_(" %s [options] [--<resource>=<limit>] [-p PID]\n"), program_invocation_short_name);
+	fprintf(out,
+		_(" %s [options] [--<resource>=<limit>] --all|--cgroup <path>\n"), program_invocation_short_name);
 	fprintf(out,
 		_(" %s [options] [--<resource>=<limit>] COMMAND\n"), program_invocation_short_name);
 
@@ -165,8 +174,11 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_("Show or change the resource limits of a process.\n"), out);
 
 	fputs(USAGE_OPTIONS, out);
-	fputs(_(" -p, --pid <pid>        process id\n"
+	fputs(_(" -p, --pid <pid>[,...]  process id(s)\n"
+		"     --all              all processes\n"
+		"     --cgroup <path>    processes in the given cgroup (v2) and its children\n"
 		" -o, --output <list>    define which output columns to use\n"
+		" -J, --json             use JSON output format\n"
 		"     --noheadings       don't print headings\n"
 		"     --raw              use the raw output format\n"
 		"     --verbose          verbose output\n"
@@ -219,7 +231,18 @@ static inline const struct colinfo *get_column_info(unsigned num)
 	return &infos[ get_column_id(num) ];
 }
 
-static void add_scols_line(struct libscols_table *table, struct prlimit *l)
+static int has_column(int id)
+{
+	int i;
+
+	for (i = 0; i < ncolumns; i++)
+		if (columns[i] == id)
+			return 1;
+	return 0;
+}
+
+static void add_scols_line(struct libscols_table *table, struct prlimit *l,
+			   pid_t p, const char *cmd)
 {
 	int i;
 	struct libscols_line *line;
@@ -259,6 +282,13 @@ static void add_scols_line(struct libscols_table *table, struct prlimit *l)
 			if (l->desc->unit)
 				str = xstrdup(_(l->desc->unit));
 			break;
+		case COL_PID:
+			xasprintf(&str, "%d", (int) p);
+			break;
+		case COL_COMMAND:
+			if (cmd)
+				str = xstrdup(cmd);
+			break;
 		default:
 			break;
 		}
@@ -292,10 +322,9 @@ static void rem_prlim(struct prlimit *lim)
 	free(lim);
 }
 
-static int show_limits(struct list_head *lims)
+static struct libscols_table *new_table(void)
 {
 	int i;
-	struct list_head *p, *pnext;
 	struct libscols_table *table;
 
 	table = scols_new_table();
@@ -303,24 +332,43 @@ static int show_limits(struct list_head *lims)
 		err(EXIT_FAILURE, _("failed to allocate output table"));
 
 	scols_table_enable_raw(table, raw);
+	scols_table_enable_json(table, json);
 	scols_table_enable_noheadings(table, no_headings);
+	if (json)
+		scols_table_set_name(table, "limits");
 
 	for (i = 0; i < ncolumns; i++) {
 		const struct colinfo *col = get_column_info(i);
+		struct libscols_column *cl;
 
-		if (!scols_table_new_column(table, col->name, col->whint, col->flags))
+		cl = scols_table_new_column(table, col->name, col->whint, col->flags);
+		if (!cl)
 			err(EXIT_FAILURE, _("failed to allocate output column"));
+		if (json && get_column_id(i) == COL_PID)
+			scols_column_set_json_type(cl, SCOLS_JSON_NUMBER);
 	}
+	return table;
+}
+
+static int show_limits(struct list_head *lims)
+{
+	struct list_head *p, *pnext;
+	struct libscols_table *table;
+	pid_t self = pid ? pid : getpid();
+	char *cmd = has_column(COL_COMMAND) ? pid_get_cmdname(self) : NULL;
+
+	table = new_table();
 
 	list_for_each_safe(p, pnext, lims) {
 		struct prlimit *lim = list_entry(p, struct prlimit, lims);
 
-		add_scols_line(table, lim);
+		add_scols_line(table, lim, self, cmd);
 		rem_prlim(lim);
 	}
 
 	scols_print_table(table);
 	scols_unref_table(table);
+	free(cmd);
 	return 0;
 }
 
@@ -389,6 +437,88 @@ static void do_prlimit(struct list_head *lims)
 	}
 }
 
+/*
+ * Sets or gets all @lims for the process @p and adds the got limits to the
+ * streamed @table. In contrast to do_prlimit() this does not modify @lims
+ * and does not exit on errors, the processes may disappear at any time and
+ * the caller continues with the next PID.
+ *
+ * Returns: 0 on success, 1 on error.
+ */
+static int do_prlimit_pid(pid_t p, struct list_head *lims,
+			  struct libscols_table *table, int scanned)
+{
+	struct list_head *lp;
+	char *cmd = NULL;
+	int rc = 0;
+
+	if (table && has_column(COL_COMMAND))
+		cmd = pid_get_cmdname(p);
+
+	list_for_each(lp, lims) {
+		struct prlimit *lim = list_entry(lp, struct prlimit, lims);
+		struct rlimit rlim = lim->rlim, *new = NULL, *old = NULL;
+
+		if (lim->modify) {
+			if (lim->modify != (PRLIMIT_HARD | PRLIMIT_SOFT)) {
+				struct rlimit cur;
+
+				if (prlimit(p, lim->desc->resource, NULL, &cur) == -1)
+					goto failed;
+				if (!(lim->modify & PRLIMIT_SOFT))
+					rlim.rlim_cur = cur.rlim_cur;
+				else if (!(lim->modify & PRLIMIT_HARD))
+					rlim.rlim_max = cur.rlim_max;
+			}
+			if ((rlim.rlim_cur > rlim.rlim_max) &&
+			    (rlim.rlim_cur != RLIM_INFINITY ||
+			     rlim.rlim_max != RLIM_INFINITY)) {
+				warnx(_("the soft limit %s cannot exceed the hard limit for pid %d"),
+						lim->desc->name, p);
+				rc = 1;
+				continue;
+			}
+			new = &rlim;
+		} else
+			old = &rlim;
+
+		if (verbose && new) {
+			printf(_("New %s limit for pid %d: "), lim->desc->name, p);
+			if (new->rlim_cur == RLIM_INFINITY)
+				printf("<%s", _("unlimited"));
+			else
+				printf("<%ju", (uintmax_t)new->rlim_cur);
+
+			if (new->rlim_max == RLIM_INFINITY)
+				printf(":%s>\n", _("unlimited"));
+			else
+				printf(":%ju>\n", (uintmax_t)new->rlim_max);
+		}
+
+		if (prlimit(p, lim->desc->resource, new, old) == -1)
+			goto failed;
+		if (!lim->modify)
+			add_scols_line(table, &(struct prlimit) {
+						.rlim = rlim, .desc = lim->desc },
+				       p, cmd);
+		continue;
+failed:
+		/* the scanned process has already finished */
+		if (errno == ESRCH && scanned)
+			break;
+		warn(lim->modify ?
+			_("failed to set the %s resource limit for pid %d") :
+			_("failed to get the %s resource limit for pid %d"),
+			lim->desc->name, p);
+		rc = 1;
+		if (errno == ESRCH)
+			break;
+	}
+
+	free(cmd);
+	return rc;
+}
+
 static int get_range(char *str, rlim_t *soft, rlim_t *hard, int *found)
 {
 	char *end = NULL;
@@ -488,20 +618,40 @@ static int add_prlim(char *ops, struct list_head *lims, size_t id)
 	return 0;
 }
 
+static void add_pids(const char *str, pid_t **pids, size_t *npids)
+{
+	char *buf = xstrdup(str), *tok, *save = NULL;
+
+	for (tok = strtok_r(buf, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		*pids = xreallocarray(*pids, *npids + 1, sizeof(pid_t));
+		(*pids)[(*npids)++] = strtos32_or_err(tok, _("invalid PID argument"));
+	}
+	free(buf);
+}
+
 int main(int argc, char **argv)
 {
-	int opt;
+	int opt, all = 0, rc = EXIT_SUCCESS;
+	const char *cgroup = NULL;
+	pid_t *pids = NULL;
+	size_t npids = 0;
 	struct list_head lims;
 
 	enum {
 		VERBOSE_OPTION = CHAR_MAX + 1,
 		RAW_OPTION,
-		NOHEADINGS_OPTION
+		NOHEADINGS_OPTION,
+		ALL_OPTION,
+		CGROUP_OPTION
 	};
 
 	static const struct option longopts[] = {
 		{ "pid",	required_argument, NULL, 'p' },
+		{ "all",        no_argument, NULL, ALL_OPTION },
+		{ "cgroup",     required_argument, NULL, CGROUP_OPTION },
 		{ "output",     required_argument, NULL, 'o' },
+		{ "json",       no_argument, NULL, 'J' },
 		{ "as",         optional_argument, NULL, 'v' },
 		{ "core",       optional_argument, NULL, 'c' },
 		{ "cpu",        optional_argument, NULL, 't' },
@@ -526,6 +676,12 @@ int main(int argc, char **argv)
 		{ NULL, 0, NULL, 0 }
 	};
 
+	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
+		{ 'p', ALL_OPTION, CGROUP_OPTION },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
+
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
@@ -540,8 +696,11 @@ int main(int argc, char **argv)
 	assert(MAX_RESOURCES == STACK + 1);
 
 	while((opt = getopt_long(argc, argv,
-				 "+c::d::e::f::i::l::m::n::q::r::s::t::u::v::x::y::p:o:vVh",
+				 "+c::d::e::f::i::l::m::n::q::r::s::t::u::v::x::y::p:o:JvVh",
 				 longopts, NULL)) != -1) {
+
+		err_exclusive_options(opt, longopts, excl, excl_st);
+
 		switch(opt) {
 		case 'c':
 			add_prlim(optarg, &lims, CORE);
@@ -593,9 +752,16 @@ int main(int argc, char **argv)
 			break;
 
 		case 'p':
-			if (pid)
-				errx(EXIT_FAILURE, _("option --pid may be specified only once"));
-			pid = strtos32_or_err(optarg, _("invalid PID argument"));
+			add_pids(optarg, &pids, &npids);
+			break;
+		case ALL_OPTION:
+			all = 1;
+			break;
+		case CGROUP_OPTION:
+			cgroup = optarg;
+			break;
+		case 'J':
+			json = 1;
 			break;
 		case 'o':
 			ncolumns = string_to_idarray(optarg,
@@ -622,9 +788,21 @@ int main(int argc, char **argv)
 			errtryhelp(EXIT_FAILURE);
 		}
 	}
-	if (argc > optind && pid)
+	if (argc > optind && npids)
 		errx(EXIT_FAILURE, _("options --pid and COMMAND are mutually exclusive"));
-	if (!ncolumns) {
+	if (argc > optind && (all || cgroup))
+		errx(EXIT_FAILURE, _("options --all, --cgroup and COMMAND are mutually exclusive"));
+	if (npids == 1)
+		pid = pids[0];
+
+	if (!ncolumns && (npids > 1 || all || cgroup)) {
+		/* default columns for more processes */
+		columns[ncolumns++] = COL_PID;
+		columns[ncolumns++] = COL_COMMAND;
+		columns[ncolumns++] = COL_RES;
+		columns[ncolumns++] = COL_SOFT;
+		columns[ncolumns++] = COL_HARD;
+	} else if (!ncolumns) {
 		/* default columns */
 		columns[ncolumns++] = COL_RES;
 		columns[ncolumns++] = COL_HELP;
@@ -643,6 +821,59 @@ int main(int argc, char **argv)
 			add_prlim(NULL, &lims, n);
 	}
 
+	if (npids > 1 || all || cgroup) {
+		/* prlimit [options] --pid <pid>,... | --all | --cgroup <path> */
+		struct libscols_table *table = NULL;
+		struct list_head *p;
+		int getters = 0;
+
+		list_for_each(p, &lims) {
+			if (!list_entry(p, struct prlimit, lims)->modify)
+				getters++;
+		}
+		if (getters) {
+			/* print the lines as soon as they are complete */
+			table = new_table();
+			scols_table_enable_streaming(table, 1);
+		}
+
+		if (npids) {
+			size_t i;
+
+			for (i = 0; i < npids; i++)
+				if (do_prlimit_pid(pids[i], &lims, table, 0))
+					rc = EXIT_FAILURE;
+		} else {
+			struct procfs_iter *it = procfs_new_iter(NULL);
+			pid_t cur;
+			int ret;
+
+			if (!it)
+				err(EXIT_FAILURE, _("failed to open /proc"));
+			if (cgroup && procfs_iter_set_cgroup(it, cgroup))
+				err(EXIT_FAILURE, _("failed to set cgroup filter"));
+
+			while ((ret = procfs_iter_next(it, &cur)) == 0)
+				if (do_prlimit_pid(cur, &lims, table, 1))
+					rc = EXIT_FAILURE;
+			if (ret < 0) {
+				warn(_("failed to read /proc"));
+				rc = EXIT_FAILURE;
+			}
+			procfs_free_iter(it);
+		}
+
+		if (table) {
+			scols_print_table(table);
+			scols_unref_table(table);
+		}
+		while (!list_empty(&lims))
+			rem_prlim(list_entry(lims.next, struct prlimit, lims));
+		free(pids);
+		return rc;
+	}
+
+	free(pids);
 	do_prlimit(&lims);
 
 	if (!list_empty(&lims))
@@ -49,6 +49,7 @@
 #include "nls.h"
 #include "c.h"
 #include "closestream.h"
+#include "procfs.h"
 
 static const char *idtype[] = {
 	[PRIO_PROCESS]	= N_("process ID"),
@@ -63,7 +64,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out,
 	      _(" %1$s [-n|--priority|--relative] <priority> [-p|--pid] <pid>...\n"
 		" %1$s [-n|--priority|--relative] <priority>  -g|--pgrp <pgid>...\n"
-		" %1$s [-n|--priority|--relative] <priority>  -u|--user <user>...\n"),
+		" %1$s [-n|--priority|--relative] <priority>  -u|--user <user>...\n"
+		" %1$s [-n|--priority|--relative] <priority>  --cgroup <path>...\n"),
 		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -79,6 +81,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -p, --pid              interpret arguments as process ID (default)\n"), out);
 	fputs(_(" -g, --pgrp             interpret arguments as process group ID\n"), out);
 	fputs(_(" -u, --user             interpret arguments as username or user ID\n"), out);
+	fputs(_("     --cgroup           interpret arguments as cgroup paths\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(24));
 	fprintf(out, USAGE_MAN_TAIL("renice(1)"));
@@ -119,6 +122,55 @@ static int donice(const int which, const int who, const int prio, const int rela
 	return 0;
 }
 
+struct renice_cgroup {
+	int	prio;
+	int	relative;
+	size_t	ntasks;
+};
+
+static int donice_task(pid_t tid, void *data)
+{
+	struct renice_cgroup *rc = data;
+	int prio;
+
+	errno = 0;
+	prio = getpriority(PRIO_PROCESS, tid);
+	if (prio == -1 && errno)
+		goto failed;
+	if (setpriority(PRIO_PROCESS, tid, rc->relative ? prio + rc->prio : rc->prio) < 0)
+		goto failed;
+	rc->ntasks++;
+	return 0;
+failed:
+	/* the thread has been terminated meanwhile */
+	if (errno == ESRCH)
+		return 0;
+	warn(_("failed to set priority for %d (%s)"), tid, idtype[PRIO_PROCESS]);
+	return -1;
+}
+
+/* the nice value is per-thread, so all the threads in the cgroup are changed */
+static int donice_cgroup(const char *path, const int prio, const int relative)
+{
+	struct renice_cgroup rc = { .prio = prio, .relative = relative };
+	int nerrs = cgroup_foreach_tid(path, donice_task, &rc);
+
+	if (nerrs < 0) {
+		errno = -nerrs;
+		warn(_("cannot read tasks of cgroup %s"), path);
+		return 1;
+	}
+	if (relative)
+		printf(P_("%s (cgroup) priority changed by %d for %zu task\n",
+			  "%s (cgroup) priority changed by %d for %zu tasks\n", rc.ntasks),
+		       path, prio, rc.ntasks);
+	else
+		printf(P_("%s (cgroup) new priority %d for %zu task\n",
+			  "%s (cgroup) new priority %d for %zu tasks\n", rc.ntasks),
+		       path, prio, rc.ntasks);
+	return nerrs ? 1 : 0;
+}
+
 /*
  * Change the priority (the nice value) of processes
  * or groups of processes which are already running.
@@ -127,7 +179,7 @@ int main(int argc, char **argv)
 {
 	int which = PRIO_PROCESS;
 	int who = 0, prio, errs = 0;
-	int relative = 0;
+	int relative = 0, cgroup = 0;
 	char *endptr = NULL;
 
 	setlocale(LC_ALL, "");
@@ -189,14 +241,25 @@ int main(int argc, char **argv)
 	for (; argc > 0; argc--, argv++) {
 		if (strcmp(*argv, "-g") == 0 || strcmp(*argv, "--pgrp") == 0) {
 			which = PRIO_PGRP;
+			cgroup = 0;
 			continue;
 		}
 		if (strcmp(*argv, "-u") == 0 || strcmp(*argv, "--user") == 0) {
 			which = PRIO_USER;
+			cgroup = 0;
 			continue;
 		}
 		if (strcmp(*argv, "-p") == 0 || strcmp(*argv, "--pid") == 0) {
 			which = PRIO_PROCESS;
+			cgroup = 0;
+			continue;
+		}
+		if (strcmp(*argv, "--cgroup") == 0) {
+			cgroup = 1;
+			continue;
+		}
+		if (cgroup) {
+			errs |= donice_cgroup(*argv, prio, relative);
 			continue;
 		}
 		if (which == PRIO_USER) {
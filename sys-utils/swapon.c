@@ -24,6 +24,9 @@
 #include <fcntl.h>
 #include <stdint.h>
 #include <ctype.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #include <libsmartcols.h>
 
@@ -36,6 +39,7 @@
 #include "strutils.h"
 #include "optutils.h"
 #include "closestream.h"
+#include "sysfs.h"
 
 #include "swapheader.h"
 #include "swapprober.h"
@@ -137,6 +141,7 @@ struct swapon_ctl {
 	int ncolumns;				/* number of columns */
 
 	struct swap_prop props;		/* global settings for all devices */
+	size_t parallel;		/* --parallel */
 
 	unsigned int
 		all:1,			/* turn on all swap devices */
@@ -747,6 +752,178 @@ static int parse_options(struct swap_prop *props, const char *options)
 	return 0;
 }
 
+#ifdef HAVE_PTHREAD
+/* fstab entry for --all --parallel */
+struct swap_entry {
+	const char		*device;
+	struct swap_prop	prop;
+	dev_t			disk;		/* the whole disk behind the area */
+	int			status;
+
+	unsigned int		started : 1,
+				done : 1;
+};
+
+struct swap_queue {
+	const struct swapon_ctl	*ctl;
+	struct swap_entry	*ents;		/* in order of the priorities */
+	size_t			nents;
+
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;		/* signaled when an entry is done */
+};
+
+/* returns the disk where the area is stored, the areas on the same disk are
+ * not activated at the same time */
+static dev_t get_swap_disk(const char *device)
+{
+	struct stat st;
+	dev_t devno, disk = 0;
+
+	if (stat(device, &st) != 0)
+		return 0;
+
+	devno = S_ISBLK(st.st_mode) ? st.st_rdev : st.st_dev;
+	if (sysfs_devno_to_wholedisk(devno, NULL, 0, &disk) != 0 || !disk)
+		disk = devno;
+	return disk;
+}
+
+static void queue_add(struct swap_queue *q, const char *device,
+		      const struct swap_prop *prop)
+{
+	struct swap_entry *e;
+	size_t i;
+
+	q->ents = xreallocarray(q->ents, q->nents + 1, sizeof(struct swap_entry));
+
+	/* higher priority first, the areas without priority keep the fstab
+	 * order at the end */
+	for (i = q->nents; i > 0; i--) {
+		if (q->ents[i - 1].prop.priority >= prop->priority)
+			break;
+	}
+	memmove(&q->ents[i + 1], &q->ents[i], (q->nents - i) * sizeof(*e));
+	q->nents++;
+
+	e = &q->ents[i];
+	memset(e, 0, sizeof(*e));
+	e->device = device;
+	e->prop = *prop;
+	e->disk = get_swap_disk(device);
+}
+
+/*
+ * Returns the first entry which may be activated now. An entry waits for the
+ * running entries on the same disk. The areas without priority get the next
+ * lower priority from kernel, so they are activated one by one in the fstab
+ * order.
+ *
+ * @wait is set when there is an entry waiting for a running one.
+ */
+static struct swap_entry *queue_next(struct swap_queue *q, int *wait)
+{
+	size_t i, j;
+	int nopri_busy = 0;
+
+	*wait = 0;
+
+	for (i = 0; i < q->nents; i++) {
+		struct swap_entry *e = &q->ents[i];
+		int busy = 0;
+
+		if (e->started) {
+			if (!e->done && e->prop.priority < 0)
+				nopri_busy = 1;
+			continue;
+		}
+		if (e->prop.priority < 0 && nopri_busy) {
+			*wait = 1;
+			continue;
+		}
+		for (j = 0; e->disk && j < q->nents; j++) {
+			const struct swap_entry *x = &q->ents[j];
+
+			if (x->started && !x->done && x->disk == e->disk) {
+				busy = 1;
+				break;
+			}
+		}
+		if (!busy)
+			return e;
+
+		*wait = 1;
+		if (e->prop.priority < 0)
+			nopri_busy = 1;
+	}
+	return NULL;
+}
+
+static void *swapon_worker(void *data)
+{
+	struct swap_queue *q = data;
+
+	pthread_mutex_lock(&q->lock);
+	do {
+		struct swap_entry *e;
+		int wait;
+
+		e = queue_next(q, &wait);
+		if (!e) {
+			if (!wait)
+				break;
+			pthread_cond_wait(&q->cond, &q->lock);
+			continue;
+		}
+		e->started = 1;
+		pthread_mutex_unlock(&q->lock);
+
+		e->status = do_swapon(q->ctl, &e->prop, e->device, TRUE);
+
+		pthread_mutex_lock(&q->lock);
+		e->done = 1;
+		pthread_cond_broadcast(&q->cond);
+	} while (1);
+	pthread_mutex_unlock(&q->lock);
+
+	return NULL;
+}
+
+/* activates the entries by up to @njobs threads */
+static int swapon_queue(struct swap_queue *q, size_t njobs)
+{
+	pthread_t *threads;
+	size_t i, nthreads = 0;
+	int status = 0;
+
+	if (!q->nents)
+		return 0;
+
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->cond, NULL);
+
+	njobs = min(njobs, q->nents);
+	threads = xcalloc(njobs, sizeof(pthread_t));
+
+	for (i = 1; i < njobs; i++) {
+		if (pthread_create(&threads[nthreads], NULL, swapon_worker, q) != 0)
+			break;
+		nthreads++;
+	}
+	swapon_worker(q);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	pthread_cond_destroy(&q->cond);
+	pthread_mutex_destroy(&q->lock);
+
+	for (i = 0; i < q->nents; i++)
+		status |= q->ents[i].status;
+	free(q->ents);
+	return status;
+}
+#endif /* HAVE_PTHREAD */
 
 static int swapon_all(struct swapon_ctl *ctl, const char *filename)
 {
@@ -754,6 +931,9 @@ static int swapon_all(struct swapon_ctl *ctl, const char *filename)
 	struct libmnt_iter *itr;
 	struct libmnt_fs *fs;
 	int status = 0;
+#ifdef HAVE_PTHREAD
+	struct swap_queue q = { .ctl = ctl };
+#endif
 
 	if (!tb)
 		err(EXIT_FAILURE, _("failed to parse %s"), mnt_get_fstab_path());
@@ -803,9 +983,19 @@ static int swapon_all(struct swapon_ctl *ctl, const char *filename)
 		}
 
 		/* swapon */
+#ifdef HAVE_PTHREAD
+		if (ctl->parallel > 1) {
+			queue_add(&q, device, &prop);
+			continue;
+		}
+#endif
 		status |= do_swapon(ctl, &prop, device, TRUE);
 	}
 
+#ifdef HAVE_PTHREAD
+	if (ctl->parallel > 1)
+		status |= swapon_queue(&q, ctl->parallel);
+#endif
 	mnt_free_iter(itr);
 	return status;
 }
@@ -831,6 +1021,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -p, --priority <prio>    specify the priority of the swap device\n"), out);
 	fputs(_(" -s, --summary            display summary about used swap devices (DEPRECATED)\n"), out);
 	fputs(_(" -T, --fstab <path>       alternative file to /etc/fstab\n"), out);
+	fputs(_("     --parallel <num>     enable up to <num> swaps at once (with --all)\n"), out);
 	fputs(_("     --show[=<columns>]   display summary in definable table\n"), out);
 	fputs(_("     --noheadings         don't print table heading (with --show)\n"), out);
 	fputs(_("     --raw                use the raw output format (with --show)\n"), out);
@@ -874,7 +1065,8 @@ int main(int argc, char *argv[])
 		NOHEADINGS_OPTION,
 		RAW_OPTION,
 		SHOW_OPTION,
-		OPT_LIST_TYPES
+		OPT_LIST_TYPES,
+		OPT_PARALLEL
 	};
 
 	static const struct option long_opts[] = {
@@ -894,6 +1086,7 @@ int main(int argc, char *argv[])
 		{ "raw",        no_argument,       NULL, RAW_OPTION        },
 		{ "bytes",      no_argument,       NULL, BYTES_OPTION      },
 		{ "fstab",      required_argument, NULL, 'T'               },
+		{ "parallel",   required_argument, NULL, OPT_PARALLEL      },
 		{ NULL, 0, NULL, 0 }
 	};
 
@@ -994,6 +1187,10 @@ int main(int argc, char *argv[])
 		case BYTES_OPTION:
 			ctl.bytes = 1;
 			break;
+		case OPT_PARALLEL:
+			ctl.parallel = str2unum_or_err(optarg, 10,
+					_("invalid parallel argument"), 1024);
+			break;
 		case 0:
 			break;
 
@@ -1020,7 +1217,7 @@ int main(int argc, char *argv[])
 		return status;
 	}
 
-	if (ctl.props.no_fail && !ctl.all) {
+	if ((ctl.props.no_fail || ctl.parallel) && !ctl.all) {
 		warnx(_("bad usage"));
 		errtryhelp(EXIT_FAILURE);
 	}
@@ -34,6 +34,10 @@
 #include <ctype.h>
 #include <dirent.h>
 #include <getopt.h>
+#include <sys/syscall.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #include "c.h"
 #include "nls.h"
@@ -48,78 +52,310 @@
 #define MNT_DETACH       0x00000002	/* Just detach from the tree */
 #endif
 
-/* remove all files/directories below dirName -- don't cross mountpoints */
-static int recursiveRemove(int fd)
+/* getdents64() buffer for every directory being read */
+#define RM_BUFSIZ		(64 * 1024)
+
+/* max number of threads removing the old root */
+#define RM_MAX_THREADS		4
+
+#if defined(SYS_getdents64)
+struct rm_dirent64 {
+	uint64_t	d_ino;
+	int64_t		d_off;
+	unsigned short	d_reclen;
+	unsigned char	d_type;
+	char		d_name[];
+};
+#endif
+
+/*
+ * The directory is removed from its parent by the thread which finishes the
+ * last part of the directory, the parent's fd is kept open until then.
+ */
+struct rm_dir {
+	int		fd;
+	char		*name;		/* name in parent */
+	struct rm_dir	*parent;
+	size_t		pending;	/* own read + unfinished subdirectories */
+	struct rm_dir	*next;		/* queue */
+};
+
+struct rm_ctl {
+	dev_t		dev;		/* don't cross mountpoints */
+	struct rm_dir	*queue;		/* subdirectories for the workers */
+	size_t		nqueued;
+	size_t		nthreads;
+	int		done;		/* the root has been finished */
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t	lock;
+	pthread_cond_t	work;
+#endif
+};
+
+static inline void rm_lock(struct rm_ctl *ctl __attribute__((__unused__)))
 {
-	struct stat rb;
-	DIR *dir;
-	int rc = -1;
-	int dfd;
+#ifdef HAVE_PTHREAD
+	if (ctl->nthreads > 1)
+		pthread_mutex_lock(&ctl->lock);
+#endif
+}
 
-	if (!(dir = fdopendir(fd))) {
-		warn(_("failed to open directory"));
-		goto done;
+static inline void rm_unlock(struct rm_ctl *ctl __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD
+	if (ctl->nthreads > 1)
+		pthread_mutex_unlock(&ctl->lock);
+#endif
+}
+
+/* drops one reference; removes the directories which are done */
+static void rm_finish(struct rm_ctl *ctl, struct rm_dir *dir)
+{
+	while (dir) {
+		struct rm_dir *parent = dir->parent;
+		size_t pending;
+
+		rm_lock(ctl);
+		pending = --dir->pending;
+		if (!pending && !parent) {
+			ctl->done = 1;
+#ifdef HAVE_PTHREAD
+			if (ctl->nthreads > 1)
+				pthread_cond_broadcast(&ctl->work);
+#endif
+		}
+		rm_unlock(ctl);
+
+		if (pending)
+			break;
+
+		close(dir->fd);
+		if (parent && unlinkat(parent->fd, dir->name, AT_REMOVEDIR))
+			warn(_("failed to unlink %s"), dir->name);
+		if (parent) {
+			free(dir->name);
+			free(dir);
+		}
+		dir = parent;
 	}
+}
 
-	/* fdopendir() precludes us from continuing to use the input fd */
-	dfd = dirfd(dir);
-	if (fstat(dfd, &rb)) {
-		warn(_("stat failed"));
-		goto done;
+static void rm_dir_contents(struct rm_ctl *ctl, struct rm_dir *dir);
+
+static void rm_entry(struct rm_ctl *ctl, struct rm_dir *dir,
+		     const char *name, unsigned char type)
+{
+	int isdir = 0;
+
+	if (!strcmp(name, ".") || !strcmp(name, ".."))
+		return;
+
+	if (type == DT_DIR || type == DT_UNKNOWN) {
+		struct stat sb;
+
+		if (fstatat(dir->fd, name, &sb, AT_SYMLINK_NOFOLLOW)) {
+			warn(_("stat of %s failed"), name);
+			return;
+		}
+
+		/* skip if device is not the same */
+		if (sb.st_dev != ctl->dev)
+			return;
+
+		/* remove subdirectories */
+		if (S_ISDIR(sb.st_mode)) {
+			struct rm_dir *sub;
+			int cfd;
+
+			cfd = openat(dir->fd, name, O_RDONLY | O_DIRECTORY
+					| O_NOFOLLOW | O_CLOEXEC);
+			if (cfd < 0) {
+				isdir = 1;
+				goto unlink;
+			}
+
+			sub = calloc(1, sizeof(*sub));
+			if (sub)
+				sub->name = strdup(name);
+			if (!sub || !sub->name) {
+				warn(_("cannot allocate memory"));
+				free(sub);
+				close(cfd);
+				return;
+			}
+			sub->fd = cfd;
+			sub->parent = dir;
+			sub->pending = 1;
+
+			rm_lock(ctl);
+			dir->pending++;
+			if (ctl->nthreads > 1 && ctl->nqueued < ctl->nthreads) {
+				/* let an idle worker remove it */
+				sub->next = ctl->queue;
+				ctl->queue = sub;
+				ctl->nqueued++;
+#ifdef HAVE_PTHREAD
+				pthread_cond_signal(&ctl->work);
+#endif
+				sub = NULL;
+			}
+			rm_unlock(ctl);
+
+			if (sub) {
+				rm_dir_contents(ctl, sub);
+				rm_finish(ctl, sub);
+			}
+			return;	/* unlinked by rm_finish() */
+		}
 	}
+unlink:
+	if (unlinkat(dir->fd, name, isdir ? AT_REMOVEDIR : 0))
+		warn(_("failed to unlink %s"), name);
+}
+
+/* reads the directory and removes all its entries */
+static void rm_dir_contents(struct rm_ctl *ctl, struct rm_dir *dir)
+{
+#if defined(SYS_getdents64)
+	char *buf = malloc(RM_BUFSIZ);
+
+	if (!buf) {
+		warn(_("cannot allocate memory"));
+		return;
+	}
+	while (1) {
+		long n = syscall(SYS_getdents64, dir->fd, buf, RM_BUFSIZ);
+		long off;
+
+		if (n < 0) {
+			warn(_("failed to read directory"));
+			break;
+		}
+		if (n == 0)
+			break;	/* end of directory */
+
+		for (off = 0; off < n; ) {
+			struct rm_dirent64 *d = (struct rm_dirent64 *) (buf + off);
+
+			rm_entry(ctl, dir, d->d_name, d->d_type);
+			off += d->d_reclen;
+		}
+	}
+	free(buf);
+#else
+	DIR *dp;
+	int fd = dup(dir->fd);
 
-	while(1) {
+	/* fdopendir() precludes us from continuing to use the input fd */
+	if (fd < 0 || !(dp = fdopendir(fd))) {
+		warn(_("failed to open directory"));
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+	while (1) {
 		struct dirent *d;
-		int isdir = 0;
 
 		errno = 0;
-		if (!(d = readdir(dir))) {
-			if (errno) {
+		if (!(d = readdir(dp))) {
+			if (errno)
 				warn(_("failed to read directory"));
-				goto done;
-			}
 			break;	/* end of directory */
 		}
-
-		if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
-			continue;
-#ifdef _DIRENT_HAVE_D_TYPE
-		if (d->d_type == DT_DIR || d->d_type == DT_UNKNOWN)
+# ifdef _DIRENT_HAVE_D_TYPE
+		rm_entry(ctl, dir, d->d_name, d->d_type);
+# else
+		rm_entry(ctl, dir, d->d_name, DT_UNKNOWN);
+# endif
+	}
+	closedir(dp);
 #endif
-		{
-			struct stat sb;
-
-			if (fstatat(dfd, d->d_name, &sb, AT_SYMLINK_NOFOLLOW)) {
-				warn(_("stat of %s failed"), d->d_name);
-				continue;
-			}
+}
 
-			/* skip if device is not the same */
-			if (sb.st_dev != rb.st_dev)
-				continue;
+#ifdef HAVE_PTHREAD
+static void *rm_worker(void *data)
+{
+	struct rm_ctl *ctl = data;
 
-			/* remove subdirectories */
-			if (S_ISDIR(sb.st_mode)) {
-				int cfd;
+	pthread_mutex_lock(&ctl->lock);
+	while (!ctl->done) {
+		struct rm_dir *dir = ctl->queue;
 
-				cfd = openat(dfd, d->d_name, O_RDONLY);
-				if (cfd >= 0)
-					recursiveRemove(cfd);	/* it closes cfd too */
-				isdir = 1;
-			}
+		if (!dir) {
+			pthread_cond_wait(&ctl->work, &ctl->lock);
+			continue;
 		}
+		ctl->queue = dir->next;
+		ctl->nqueued--;
+		pthread_mutex_unlock(&ctl->lock);
 
-		if (unlinkat(dfd, d->d_name, isdir ? AT_REMOVEDIR : 0))
-			warn(_("failed to unlink %s"), d->d_name);
+		rm_dir_contents(ctl, dir);
+		rm_finish(ctl, dir);
+
+		pthread_mutex_lock(&ctl->lock);
 	}
+	pthread_mutex_unlock(&ctl->lock);
+	return NULL;
+}
+#endif
+
+/*
+ * Remove all files/directories below the directory -- don't cross
+ * mountpoints. The subdirectories are removed by a small pool of threads,
+ * the calling thread is one of them.
+ */
+static int recursiveRemove(int fd)
+{
+	struct rm_ctl ctl = { .nthreads = 1 };
+	struct rm_dir root = { .fd = fd, .pending = 1 };
+	struct stat rb;
+#ifdef HAVE_PTHREAD
+	pthread_t threads[RM_MAX_THREADS - 1];
+	size_t i, nthr = 0;
+	long ncpus;
+#endif
 
-	rc = 0;	/* success */
-done:
-	if (dir)
-		closedir(dir);
-	else
+	if (fstat(fd, &rb)) {
+		warn(_("stat failed"));
 		close(fd);
-	return rc;
+		return -1;
+	}
+	ctl.dev = rb.st_dev;
+
+#ifdef HAVE_PTHREAD
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpus > 1) {
+		ctl.nthreads = min((size_t) ncpus, (size_t) RM_MAX_THREADS);
+		pthread_mutex_init(&ctl.lock, NULL);
+		pthread_cond_init(&ctl.work, NULL);
+
+		for (i = 0; i < ctl.nthreads - 1; i++) {
+			if (pthread_create(&threads[nthr], NULL, rm_worker, &ctl) != 0)
+				break;
+			nthr++;
+		}
+		if (!nthr) {
+			pthread_cond_destroy(&ctl.work);
+			pthread_mutex_destroy(&ctl.lock);
+			ctl.nthreads = 1;
+		}
+	}
+#endif
+	rm_dir_contents(&ctl, &root);
+	rm_finish(&ctl, &root);		/* it closes fd too */
+
+#ifdef HAVE_PTHREAD
+	if (ctl.nthreads > 1) {
+		/* help the workers with the rest of the queue */
+		rm_worker(&ctl);
+
+		for (i = 0; i < nthr; i++)
+			pthread_join(threads[i], NULL);
+		pthread_cond_destroy(&ctl.work);
+		pthread_mutex_destroy(&ctl.lock);
+	}
+#endif
+	return 0;
 }
 
 static int switchroot(const char *newroot)
@@ -35,6 +35,7 @@
 #include "closestream.h"
 #include "pathnames.h"
 #include "canonicalize.h"
+#include "strutils.h"
 
 #define XALLOC_EXIT_CODE MNT_EX_SYSERR
 #include "xalloc.h"
@@ -99,6 +100,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -n, --no-mtab           don't write to /etc/mtab\n"), out);
 	fputs(_(" -l, --lazy              detach the filesystem now, clean up things later\n"), out);
 	fputs(_(" -O, --test-opts <list>  limit the set of filesystems (use with -a)\n"), out);
+	fputs(_("     --parallel <num>    unmount in parallel, at most <num> at once (use with -a)\n"), out);
 	fputs(_(" -R, --recursive         recursively unmount a target with all its children\n"), out);
 	fputs(_(" -r, --read-only         in case unmounting fails, try to remount read-only\n"), out);
 	fputs(_(" -t, --types <list>      limit the set of filesystem types\n"), out);
@@ -204,9 +206,21 @@ static int umount_all(struct libmnt_context *cxt)
 
 		const char *tgt = mnt_fs_get_target(fs);
 
+		if (mnt_context_is_child(cxt)) {
+			/* --parallel child, the parent collects exit codes */
+			rc = mk_exit_code(cxt, mntrc);
+			if (rc == MNT_EX_SUCCESS && mnt_context_is_verbose(cxt))
+				printf("%-25s: successfully unmounted\n", tgt);
+			mnt_free_iter(itr);
+			return rc;
+		}
+
 		if (ignored) {
 			if (mnt_context_is_verbose(cxt))
 				printf(_("%-25s: ignored\n"), tgt);
+		} else if (mnt_context_is_fork(cxt)) {
+			if (mnt_context_is_verbose(cxt))
+				printf("%-25s: umount successfully forked\n", tgt);
 		} else {
 			int xrc = mk_exit_code(cxt, mntrc);
 
@@ -215,6 +229,18 @@ static int umount_all(struct libmnt_context *cxt)
 				printf("%-25s: successfully unmounted\n", tgt);
 			rc |= xrc;
 		}
+
+		/* don't duplicate buffered output in the next child */
+		if (mnt_context_is_parent(cxt))
+			fflush(stdout);
+	}
+
+	if (mnt_context_is_parent(cxt)) {
+		/* wait for umount --parallel children */
+		int nerrs = 0;
+
+		if (mnt_context_wait_for_children(cxt, NULL, &nerrs) == 0 && nerrs)
+			rc |= MNT_EX_FAIL;
 	}
 
 	mnt_free_iter(itr);
@@ -475,6 +501,7 @@ int main(int argc, char **argv)
 
 	enum {
 		UMOUNT_OPT_FAKE = CHAR_MAX + 1,
+		UMOUNT_OPT_PARALLEL,
 	};
 
 	static const struct option longopts[] = {
@@ -488,6 +515,7 @@ int main(int argc, char **argv)
 		{ "lazy",            no_argument,       NULL, 'l'             },
 		{ "no-canonicalize", no_argument,       NULL, 'c'             },
 		{ "no-mtab",         no_argument,       NULL, 'n'             },
+		{ "parallel",        required_argument, NULL, UMOUNT_OPT_PARALLEL },
 		{ "quiet",           no_argument,       NULL, 'q'             },
 		{ "read-only",       no_argument,       NULL, 'r'             },
 		{ "recursive",       no_argument,       NULL, 'R'             },
@@ -571,6 +599,16 @@ int main(int argc, char **argv)
 		case 'q':
 			quiet = 1;
 			break;
+		case UMOUNT_OPT_PARALLEL:
+		{
+			uint32_t n = strtou32_or_err(optarg, _("invalid parallel argument"));
+
+			if (!n)
+				errx(MNT_EX_USAGE, _("invalid parallel argument: %s"), optarg);
+			mnt_context_enable_fork(cxt, TRUE);
+			mnt_context_set_parallel(cxt, n);
+			break;
+		}
 		case 'r':
 			mnt_context_enable_rdonly_umount(cxt, TRUE);
 			break;
@@ -614,6 +652,9 @@ int main(int argc, char **argv)
 	argc -= optind;
 	argv += optind;
 
+	if (recursive && mnt_context_get_parallel(cxt))
+		errx(MNT_EX_USAGE, _("--parallel is not supported with --recursive"));
+
 	if (all) {
 		if (argc) {
 			warnx(_("unexpected number of arguments"));
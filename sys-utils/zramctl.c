@@ -25,6 +25,11 @@
 #include <assert.h>
 #include <sys/types.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 #include <libsmartcols.h>
 
@@ -36,7 +41,6 @@
 #include "sysfs.h"
 #include "optutils.h"
 #include "ismounted.h"
-#include "strv.h"
 #include "path.h"
 #include "pathnames.h"
 
@@ -109,16 +113,43 @@ static const char *mm_stat_names[] = {
 	[MM_NUM_MIGRATED]    = "num_migrated"
 };
 
+#define MM_NSTATS	ARRAY_SIZE(mm_stat_names)
+
 struct zram {
 	char	devname[32];
 	struct	path_cxt *sysfs;	/* device specific sysfs directory */
-	char	**mm_stat;
+	int	mm_stat_fd;		/* mm_stat, re-read by pread() */
+	uint64_t mm_stat[MM_NSTATS];
+	uint64_t mm_prev[MM_NSTATS];	/* the previous --watch sample */
 
 	unsigned int mm_stat_probed : 1,
+		     has_mm_stat : 1,
+		     has_mm_prev : 1,
 		     control_probed : 1,
 		     has_control : 1;	/* has /sys/class/zram-control/ */
 };
 
+/* settings for the created devices */
+struct zram_setup {
+	uintmax_t	size;
+	uintmax_t	nstreams;
+	const char	*algorithm;
+};
+
+/* max number of threads to set up more devices */
+#define SETUP_NTHREADS	8
+
+struct zram_batch {
+	struct zram		**zrams;
+	size_t			nzrams;
+	size_t			next;		/* the next device for a thread */
+	const struct zram_setup	*setup;
+	int			*rcs;		/* result for every device */
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t		lock;		/* for @next */
+#endif
+};
+
 static unsigned int raw, no_headings, inbytes;
 static struct path_cxt *__control;
 
@@ -151,9 +182,12 @@ static int column_name_to_id(const char *name, size_t namesz)
 static void zram_reset_stat(struct zram *z)
 {
 	if (z) {
-		strv_free(z->mm_stat);
-		z->mm_stat = NULL;
+		if (z->mm_stat_fd >= 0)
+			close(z->mm_stat_fd);
+		z->mm_stat_fd = -1;
 		z->mm_stat_probed = 0;
+		z->has_mm_stat = 0;
+		z->has_mm_prev = 0;
 	}
 }
 
@@ -187,6 +221,7 @@ static struct zram *new_zram(const char *devname)
 {
 	struct zram *z = xcalloc(1, sizeof(struct zram));
 
+	z->mm_stat_fd = -1;
 	DBG(fprintf(stderr, "new: %p", z));
 	if (devname)
 		zram_set_devname(z, devname, 0);
@@ -321,13 +356,17 @@ static int zram_control_remove(struct zram *z)
 	return ul_path_write_u64(ctl, n, "hot_remove");
 }
 
-static struct zram *find_free_zram(void)
+/*
+ * Returns the first free device with number @*start or greater, and @*start
+ * is set behind the device to find more devices before anyone is set up.
+ */
+static struct zram *find_free_zram(size_t *start)
 {
 	struct zram *z = new_zram(NULL);
 	size_t i;
 	int isfree = 0;
 
-	for (i = 0; isfree == 0; i++) {
+	for (i = *start; isfree == 0; i++) {
 		DBG(fprintf(stderr, "find free: checking zram%zu", i));
 		zram_set_devname(z, NULL, i);
 		if (!zram_exist(z) && zram_control_add(z) != 0)
@@ -337,10 +376,55 @@ static struct zram *find_free_zram(void)
 	if (!isfree) {
 		free_zram(z);
 		z = NULL;
-	}
+	} else
+		*start = zram_get_devnum(z) + 1;
 	return z;
 }
 
+/*
+ * Linux >= 4.1 uses /sys/block/zram<id>/mm_stat. The file is kept open and
+ * read again by zram_next_sample().
+ */
+static void zram_read_mm_stat(struct zram *z, struct path_cxt *sysfs)
+{
+	char buf[BUFSIZ], *p = buf, *end;
+	ssize_t sz;
+	size_t i;
+
+	z->mm_stat_probed = 1;
+	z->has_mm_stat = 0;
+
+	if (z->mm_stat_fd < 0)
+		z->mm_stat_fd = ul_path_open(sysfs, O_RDONLY | O_CLOEXEC, "mm_stat");
+	if (z->mm_stat_fd < 0)
+		return;
+
+	sz = pread(z->mm_stat_fd, buf, sizeof(buf) - 1, 0);
+	if (sz <= 0)
+		return;
+	buf[sz] = '\0';
+
+	/* make sure kernel provides mm_stat as expected */
+	for (i = 0; i < MM_NSTATS; i++) {
+		errno = 0;
+		z->mm_stat[i] = strtoull(p, &end, 10);
+		if (errno || end == p)
+			return;
+		p = end;
+	}
+	z->has_mm_stat = 1;
+}
+
+/* the next get_mm_stat() reads the new values, the old ones are for deltas */
+static void zram_next_sample(struct zram *z)
+{
+	if (!z->has_mm_stat)
+		return;
+	memcpy(z->mm_prev, z->mm_stat, sizeof(z->mm_prev));
+	z->has_mm_prev = 1;
+	z->mm_stat_probed = 0;
+}
+
 static char *get_mm_stat(struct zram *z, size_t idx, int bytes)
 {
 	struct path_cxt *sysfs;
@@ -355,27 +439,32 @@ static char *get_mm_stat(struct zram *z, size_t idx, int bytes)
 	if (!sysfs)
 		return NULL;
 
-	/* Linux >= 4.1 uses /sys/block/zram<id>/mm_stat */
-	if (!z->mm_stat && !z->mm_stat_probed) {
-		if (ul_path_read_string(sysfs, &str, "mm_stat") > 0 && str) {
-			z->mm_stat = strv_split(str, " ");
+	if (!z->mm_stat_probed)
+		zram_read_mm_stat(z, sysfs);
 
-			/* make sure kernel provides mm_stat as expected */
-			if (strv_length(z->mm_stat) < ARRAY_SIZE(mm_stat_names)) {
-				strv_free(z->mm_stat);
-				z->mm_stat = NULL;
-			}
-		}
-		z->mm_stat_probed = 1;
-		free(str);
-		str = NULL;
-	}
+	if (z->has_mm_stat) {
+		num = z->mm_stat[idx];
+
+		if (z->has_mm_prev) {
+			/* --watch, print the change since the previous sample */
+			uint64_t prev = z->mm_prev[idx];
+			char sign = num >= prev ? '+' : '-';
 
-	if (z->mm_stat) {
-		if (bytes)
-			return xstrdup(z->mm_stat[idx]);
+			num = num >= prev ? num - prev : prev - num;
+			if (bytes)
+				xasprintf(&str, "%c%ju", sign, num);
+			else {
+				char *sz = size_to_human_string(SIZE_SUFFIX_1LETTER, num);
 
-		num = strtou64_or_err(z->mm_stat[idx], _("Failed to parse mm_stat"));
+				xasprintf(&str, "%c%s", sign, sz);
+				free(sz);
+			}
+			return str;
+		}
+		if (bytes) {
+			xasprintf(&str, "%ju", num);
+			return str;
+		}
 		return size_to_human_string(SIZE_SUFFIX_1LETTER, num);
 	}
 
@@ -482,13 +571,44 @@ static void fill_table_row(struct libscols_table *tb, struct zram *z)
 	}
 }
 
-static void status(struct zram *z)
+/* returns all used devices */
+static struct zram **get_used_zrams(size_t *nzrams)
 {
-	struct libscols_table *tb;
-	size_t i;
+	struct zram **zrams = NULL, *z;
+	size_t arysz = 0;
 	DIR *dir;
 	struct dirent *d;
 
+	*nzrams = 0;
+	if (!(dir = opendir(_PATH_DEV)))
+		err(EXIT_FAILURE, _("cannot open %s"), _PATH_DEV);
+
+	z = new_zram(NULL);
+	while ((d = readdir(dir))) {
+		int n;
+		if (sscanf(d->d_name, "zram%d", &n) != 1)
+			continue;
+		zram_set_devname(z, NULL, n);
+		if (!zram_exist(z) || !zram_used(z))
+			continue;
+		if (*nzrams == arysz) {
+			arysz = arysz ? arysz * 2 : 16;
+			zrams = xreallocarray(zrams, arysz, sizeof(struct zram *));
+		}
+		zrams[(*nzrams)++] = z;
+		z = new_zram(NULL);
+	}
+	closedir(dir);
+	free_zram(z);
+
+	return zrams;
+}
+
+static void status(struct zram **zrams, size_t nzrams)
+{
+	struct libscols_table *tb;
+	size_t i;
+
 	scols_init_debug(0);
 
 	tb = scols_new_table();
@@ -505,31 +625,132 @@ static void status(struct zram *z)
 			err(EXIT_FAILURE, _("failed to initialize output column"));
 	}
 
-	if (z) {
-		/* just one device specified */
-		fill_table_row(tb, z);
-		goto print_table;
+	for (i = 0; i < nzrams; i++)
+		fill_table_row(tb, zrams[i]);
+
+	scols_print_table(tb);
+	scols_unref_table(tb);
+}
+
+/*
+ * Prints the status every @interval; the devices and the mm_stat files are
+ * opened only once, the statistics are the changes since the previous sample.
+ */
+static void __attribute__((__noreturn__))
+watch_status(struct zram **zrams, size_t nzrams, const struct timespec *interval)
+{
+	size_t i;
+
+	do {
+		status(zrams, nzrams);
+		fflush(stdout);
+
+		nanosleep(interval, NULL);
+		for (i = 0; i < nzrams; i++)
+			zram_next_sample(zrams[i]);
+		if (!no_headings)
+			fputc('\n', stdout);
+	} while (1);
+}
+
+static int zram_setup(struct zram *z, const struct zram_setup *set)
+{
+	if (zram_set_u64parm(z, "reset", 1)) {
+		warn(_("%s: failed to reset"), z->devname);
+		return -1;
+	}
+	if (set->nstreams &&
+	    zram_set_u64parm(z, "max_comp_streams", set->nstreams)) {
+		warn(_("%s: failed to set number of streams"), z->devname);
+		return -1;
 	}
+	if (set->algorithm &&
+	    zram_set_strparm(z, "comp_algorithm", set->algorithm)) {
+		warn(_("%s: failed to set algorithm"), z->devname);
+		return -1;
+	}
+	if (zram_set_u64parm(z, "disksize", set->size)) {
+		warn(_("%s: failed to set disksize (%ju bytes)"),
+				z->devname, set->size);
+		return -1;
+	}
+	return 0;
+}
 
-	/* list all used devices */
-	z = new_zram(NULL);
-	if (!(dir = opendir(_PATH_DEV)))
-		err(EXIT_FAILURE, _("cannot open %s"), _PATH_DEV);
+static void *setup_worker(void *data)
+{
+	struct zram_batch *bt = data;
 
-	while ((d = readdir(dir))) {
-		int n;
-		if (sscanf(d->d_name, "zram%d", &n) != 1)
-			continue;
-		zram_set_devname(z, NULL, n);
-		if (zram_exist(z) && zram_used(z))
-			fill_table_row(tb, z);
+	do {
+		size_t i;
+
+#ifdef HAVE_PTHREAD
+		pthread_mutex_lock(&bt->lock);
+#endif
+		i = bt->next++;
+#ifdef HAVE_PTHREAD
+		pthread_mutex_unlock(&bt->lock);
+#endif
+		if (i >= bt->nzrams)
+			break;
+		bt->rcs[i] = zram_setup(bt->zrams[i], bt->setup);
+	} while (1);
+
+	return NULL;
+}
+
+/*
+ * The free devices are found (or hot-added) one by one, because the kernel
+ * serializes zram-control anyway, and set up by more threads. Every device
+ * is allocated by its disksize write, which does not block the others.
+ */
+static int create_zrams(size_t count, const struct zram_setup *set)
+{
+	struct zram_batch bt = { .setup = set };
+	size_t i, start = 0;
+	int res = 0;
+
+	bt.zrams = xcalloc(count, sizeof(struct zram *));
+	bt.rcs = xcalloc(count, sizeof(int));
+
+	for (i = 0; i < count; i++) {
+		bt.zrams[i] = find_free_zram(&start);
+		if (!bt.zrams[i])
+			errx(EXIT_FAILURE, _("no free zram device found"));
 	}
-	closedir(dir);
-	free_zram(z);
+	bt.nzrams = count;
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init(&bt.lock, NULL);
+	{
+		pthread_t threads[SETUP_NTHREADS];
+		size_t nthreads = 0, n = min(count, (size_t) SETUP_NTHREADS);
+
+		for (i = 0; n > 1 && i < n; i++) {
+			if (pthread_create(&threads[nthreads], NULL, setup_worker, &bt) != 0)
+				break;
+			nthreads++;
+		}
+		setup_worker(&bt);
+		for (i = 0; i < nthreads; i++)
+			pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&bt.lock);
+#else
+	setup_worker(&bt);
+#endif
 
-print_table:
-	scols_print_table(tb);
-	scols_unref_table(tb);
+	for (i = 0; i < count; i++) {
+		if (bt.rcs[i])
+			res++;
+		else
+			printf("%s\n", bt.zrams[i]->devname);
+		free_zram(bt.zrams[i]);
+	}
+	free(bt.zrams);
+	free(bt.rcs);
+
+	return res;
 }
 
 static void __attribute__((__noreturn__)) usage(void)
@@ -540,7 +761,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_HEADER, out);
 	fprintf(out, _(	" %1$s [options] <device>\n"
 			" %1$s -r <device> [...]\n"
-			" %1$s [options] -f | <device> -s <size>\n"),
+			" %1$s [options] -f | <device> -s <size>\n"
+			" %1$s [options] -f -c <count> -s <size>\n"),
 			program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -549,6 +771,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -a, --algorithm <alg>     compression algorithm to use\n"), out);
 	fputs(_(" -b, --bytes               print sizes in bytes rather than in human readable format\n"), out);
+	fputs(_(" -c, --count <num>         set up <num> free devices (with --find)\n"), out);
 	fputs(_(" -f, --find                find a free device\n"), out);
 	fputs(_(" -n, --noheadings          don't print headings\n"), out);
 	fputs(_(" -o, --output <list>       columns to use for status output\n"), out);
@@ -557,6 +780,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -r, --reset               reset all specified devices\n"), out);
 	fputs(_(" -s, --size <size>         device size\n"), out);
 	fputs(_(" -t, --streams <number>    number of compression streams\n"), out);
+	fputs(_(" -w, --watch <secs>        print the status changes every <secs>\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fprintf(out, USAGE_HELP_OPTIONS(27));
@@ -587,8 +811,9 @@ enum {
 
 int main(int argc, char **argv)
 {
-	uintmax_t size = 0, nstreams = 0;
-	char *algorithm = NULL;
+	struct zram_setup set = { .size = 0 };
+	struct timespec interval = { 0 };
+	size_t count = 0, start = 0;
 	int rc = 0, c, find = 0, act = A_NONE;
 	struct zram *zram = NULL;
 
@@ -600,6 +825,7 @@ int main(int argc, char **argv)
 	static const struct option longopts[] = {
 		{ "algorithm", required_argument, NULL, 'a' },
 		{ "bytes",     no_argument, NULL, 'b' },
+		{ "count",     required_argument, NULL, 'c' },
 		{ "find",      no_argument, NULL, 'f' },
 		{ "help",      no_argument, NULL, 'h' },
 		{ "output",    required_argument, NULL, 'o' },
@@ -610,11 +836,13 @@ int main(int argc, char **argv)
 		{ "size",      required_argument, NULL, 's' },
 		{ "streams",   required_argument, NULL, 't' },
 		{ "version",   no_argument, NULL, 'V' },
+		{ "watch",     required_argument, NULL, 'w' },
 		{ NULL, 0, NULL, 0 }
 	};
 
 	static const ul_excl_t excl[] = {
 		{ 'f', 'o', 'r' },
+		{ 'f', 'r', 's', 'w' },
 		{ 'o', 'r', 's' },
 		{ 0 }
 	};
@@ -625,17 +853,22 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "a:bfho:nrs:t:V", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "a:bc:fho:nrs:t:Vw:", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
 		switch (c) {
 		case 'a':
-			algorithm = optarg;
+			set.algorithm = optarg;
 			break;
 		case 'b':
 			inbytes = 1;
 			break;
+		case 'c':
+			count = str2unum_or_err(optarg, 10, _("failed to parse count"), INT_MAX);
+			if (!count)
+				errx(EXIT_FAILURE, _("failed to parse count"));
+			break;
 		case 'f':
 			find = 1;
 			break;
@@ -651,11 +884,15 @@ int main(int argc, char **argv)
 				columns[ncolumns] = ncolumns;
 			break;
 		case 's':
-			size = strtosize_or_err(optarg, _("failed to parse size"));
+			set.size = strtosize_or_err(optarg, _("failed to parse size"));
 			act = A_CREATE;
 			break;
 		case 't':
-			nstreams = strtou64_or_err(optarg, _("failed to parse streams"));
+			set.nstreams = strtou64_or_err(optarg, _("failed to parse streams"));
+			break;
+		case 'w':
+			strtotimespec_or_err(optarg, &interval,
+					     _("failed to parse watch interval"));
 			break;
 		case 'r':
 			act = A_RESET;
@@ -685,9 +922,12 @@ int main(int argc, char **argv)
 	if (act != A_RESET && optind + 1 < argc)
 		errx(EXIT_FAILURE, _("only one <device> at a time is allowed"));
 
-	if ((act == A_STATUS || act == A_FINDONLY) && (algorithm || nstreams))
+	if ((act == A_STATUS || act == A_FINDONLY) && (set.algorithm || set.nstreams))
 		errx(EXIT_FAILURE, _("options --algorithm and --streams "
 				     "must be combined with --size"));
+	if (count && (act != A_CREATE || !find))
+		errx(EXIT_FAILURE, _("option --count must be combined "
+				     "with --find and --size"));
 
 	ul_path_init_debug();
 	ul_sysfs_init_debug();
@@ -704,13 +944,28 @@ int main(int argc, char **argv)
 			columns[ncolumns++] = COL_STREAMS;
 			columns[ncolumns++] = COL_MOUNTPOINT;
 		}
-		if (optind < argc) {
-			zram = new_zram(argv[optind++]);
-			if (!zram_exist(zram))
-				err(EXIT_FAILURE, "%s", zram->devname);
+		{
+			struct zram **zrams;
+			size_t i, nzrams = 1;
+
+			if (optind < argc) {
+				/* just one device specified */
+				zram = new_zram(argv[optind++]);
+				if (!zram_exist(zram))
+					err(EXIT_FAILURE, "%s", zram->devname);
+				zrams = &zram;
+			} else
+				zrams = get_used_zrams(&nzrams);
+
+			if (interval.tv_sec || interval.tv_nsec)
+				watch_status(zrams, nzrams, &interval);
+
+			status(zrams, nzrams);
+			for (i = 0; i < nzrams; i++)
+				free_zram(zrams[i]);
+			if (zrams != &zram)
+				free(zrams);
 		}
-		status(zram);
-		free_zram(zram);
 		break;
 	case A_RESET:
 		if (optind == argc)
@@ -728,15 +983,19 @@ int main(int argc, char **argv)
 		}
 		break;
 	case A_FINDONLY:
-		zram = find_free_zram();
+		zram = find_free_zram(&start);
 		if (!zram)
 			errx(EXIT_FAILURE, _("no free zram device found"));
 		printf("%s\n", zram->devname);
 		free_zram(zram);
 		break;
 	case A_CREATE:
+		if (count > 1) {
+			rc = create_zrams(count, &set);
+			break;
+		}
 		if (find) {
-			zram = find_free_zram();
+			zram = find_free_zram(&start);
 			if (!zram)
 				errx(EXIT_FAILURE, _("no free zram device found"));
 		} else if (optind == argc)
@@ -747,20 +1006,8 @@ int main(int argc, char **argv)
 				err(EXIT_FAILURE, "%s", zram->devname);
 		}
 
-		if (zram_set_u64parm(zram, "reset", 1))
-			err(EXIT_FAILURE, _("%s: failed to reset"), zram->devname);
-
-		if (nstreams &&
-		    zram_set_u64parm(zram, "max_comp_streams", nstreams))
-			err(EXIT_FAILURE, _("%s: failed to set number of streams"), zram->devname);
-
-		if (algorithm &&
-		    zram_set_strparm(zram, "comp_algorithm", algorithm))
-			err(EXIT_FAILURE, _("%s: failed to set algorithm"), zram->devname);
-
-		if (zram_set_u64parm(zram, "disksize", size))
-			err(EXIT_FAILURE, _("%s: failed to set disksize (%ju bytes)"),
-				zram->devname, size);
+		if (zram_setup(zram, &set))
+			exit(EXIT_FAILURE);
 		if (find)
 			printf("%s\n", zram->devname);
 		free_zram(zram);
@@ -69,6 +69,9 @@ struct replay_setup {
 	struct timeval		delay_min;
 	double			delay_div;
 
+	struct timeval		elapsed;	/* recorded time of the current step */
+	struct timeval		target;		/* no delays before this time */
+
 	char			default_type;	/* type for REPLAY_TIMING_SIMPLE */
 	int			crmode;
 };
@@ -154,6 +157,14 @@ int replay_set_delay_div(struct replay_setup *stp, const double divi)
 	return 0;
 }
 
+/* fast-forward -- the steps recorded before @tv are returned without delay */
+int replay_set_target(struct replay_setup *stp, const struct timeval *tv)
+{
+	stp->target.tv_sec = tv->tv_sec;
+	stp->target.tv_usec = tv->tv_usec;
+	return 0;
+}
+
 static struct replay_log *replay_new_log(struct replay_setup *stp,
 					 const char *streams,
 					 const char *filename,
@@ -380,6 +391,109 @@ static int replay_seek_log(struct replay_log *log, size_t move)
 	return fseek(log->fp, move, SEEK_CUR) == (off_t) -1 ? -errno : 0;
 }
 
+/* reads the next timing file entry; returns: 0 = success, <0 = error, 1 = EOF */
+static int replay_read_step(struct replay_setup *stp, struct replay_step *step)
+{
+	int rc = 1;
+
+	if (feof(stp->timing_fp))
+		return rc;
+
+	DBG(TIMING, ul_debug("reading next step"));
+
+	replay_reset_step(step);
+	stp->timing_line++;
+
+	switch (stp->timing_format) {
+	case REPLAY_TIMING_SIMPLE:
+		/* old format is the same as new format, but without <type> prefix */
+		rc = read_multistream_step(step, stp->timing_fp, stp->default_type);
+		if (rc == 0)
+			step->type = stp->default_type;
+		break;
+	case REPLAY_TIMING_MULTI:
+		rc = fscanf(stp->timing_fp, "%c ", &step->type);
+		if (rc != 1)
+			rc = -EINVAL;
+		else
+			rc = read_multistream_step(step,
+					stp->timing_fp,
+					step->type);
+		break;
+	}
+
+	if (rc < 0 && feof(stp->timing_fp))
+		rc = 1;
+	return rc;
+}
+
+/*
+ * Skips all steps which end at or before @tv; the data logs are not read, only
+ * the sizes from the timing file are used to move in the logs. The rest of the
+ * step which crosses @tv is delayed (see replay_set_target()).
+ *
+ * returns: 0 = success, <0 = error, 1 = done (EOF)
+ */
+int replay_seek_target(struct replay_setup *stp, const struct timeval *tv)
+{
+	struct replay_step *step;
+	off_t *moves;
+	size_t i;
+	int rc = 0;
+
+	assert(stp);
+	assert(stp->timing_fp);
+
+	DBG(TIMING, ul_debug("seek to %"PRId64".%06"PRId64,
+			(int64_t) tv->tv_sec, (int64_t) tv->tv_usec));
+
+	step = &stp->step;
+	moves = xcalloc(stp->nlogs, sizeof(off_t));
+
+	while (rc == 0) {
+		struct timeval end;
+		off_t pos = ftello(stp->timing_fp);
+		int line = stp->timing_line;
+
+		if (pos < 0) {
+			rc = -errno;
+			break;
+		}
+		rc = replay_read_step(stp, step);
+		if (rc)
+			break;
+
+		timeradd(&stp->elapsed, &step->delay, &end);
+		if (timercmp(&end, tv, >)) {
+			/* return the step back to the timing file */
+			if (fseeko(stp->timing_fp, pos, SEEK_SET) != 0)
+				rc = -errno;
+			stp->timing_line = line;
+			break;
+		}
+		stp->elapsed = end;
+
+		for (i = 0; i < stp->nlogs; i++) {
+			if (is_wanted_stream(step->type, stp->logs[i].streams)) {
+				moves[i] += step->size;
+				break;
+			}
+		}
+	}
+
+	for (i = 0; rc >= 0 && i < stp->nlogs; i++) {
+		if (moves[i])
+			rc = replay_seek_log(&stp->logs[i], moves[i]);
+	}
+	free(moves);
+
+	replay_reset_step(step);
+	replay_set_target(stp, tv);
+
+	DBG(TIMING, ul_debug("seek done [rc=%d, line=%d]", rc, stp->timing_line));
+	return rc;
+}
+
 /* returns next step with pointer to the right log file for specified streams (e.g.
  * "IOS" for in/out/signals) or all streams if stream is NULL.
  *
@@ -403,38 +517,9 @@ int replay_get_next_step(struct replay_setup *stp, char *streams, struct replay_
 	do {
 		struct replay_log *log = NULL;
 
-		rc = 1;	/* done */
-		if (feof(stp->timing_fp))
-			break;
-
-		DBG(TIMING, ul_debug("reading next step"));
-
-		replay_reset_step(step);
-		stp->timing_line++;
-
-		switch (stp->timing_format) {
-		case REPLAY_TIMING_SIMPLE:
-			/* old format is the same as new format, but without <type> prefix */
-			rc = read_multistream_step(step, stp->timing_fp, stp->default_type);
-			if (rc == 0)
-				step->type = stp->default_type;
-			break;
-		case REPLAY_TIMING_MULTI:
-			rc = fscanf(stp->timing_fp, "%c ", &step->type);
-			if (rc != 1)
-				rc = -EINVAL;
-			else
-				rc = read_multistream_step(step,
-						stp->timing_fp,
-						step->type);
-			break;
-		}
-
-		if (rc) {
-			if (rc < 0 && feof(stp->timing_fp))
-				rc = 1;
+		rc = replay_read_step(stp, step);
+		if (rc)
 			break;		/* error or EOF */
-		}
 
 		DBG(TIMING, ul_debug(" step entry is '%c'", step->type));
 
@@ -472,6 +557,23 @@ done:
 			(int64_t) ignored_delay.tv_sec, (int64_t) ignored_delay.tv_usec,
 			step->size));
 
+	if (rc == 0) {
+		struct timeval start = stp->elapsed;
+
+		timerinc(&stp->elapsed, &step->delay);
+
+		/* fast-forward to the target */
+		if (timerisset(&stp->target)) {
+			if (!timercmp(&stp->elapsed, &stp->target, >))
+				timerclear(&step->delay);
+			else {
+				if (timercmp(&start, &stp->target, <))
+					timersub(&stp->elapsed, &stp->target, &step->delay);
+				timerclear(&stp->target);
+			}
+		}
+	}
+
 	/* normalize delay */
 	if (stp->delay_div) {
 		DBG(TIMING, ul_debug(" normalize delay: divide"));
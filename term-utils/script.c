@@ -88,6 +88,9 @@ UL_DEBUG_DEFINE_MASKNAMES(script) = UL_DEBUG_EMPTY_MASKNAMES;
 
 #define DEFAULT_TYPESCRIPT_FILENAME "typescript"
 
+#define SCRIPT_LOG_BUFSIZ	(64 * 1024)	/* stdio buffer for the logs */
+#define SCRIPT_FLUSH_INTERVAL	1000		/* default max delay of log data in milliseconds */
+
 /*
  * Script is driven by stream (stdout/stdin) activity. It's possible to
  * associate arbitrary number of log files with the stream. We have two basic
@@ -123,6 +126,9 @@ struct script_control {
 	uint64_t outsz;		/* current output files size */
 	uint64_t maxsz;		/* maximum output files size */
 
+	unsigned int flush_interval;	/* max delay of unflushed log data (ms) */
+	struct timeval flush_time;	/* when to flush logs, or zero */
+
 	struct script_stream	out;	/* output */
 	struct script_stream	in;	/* input */
 
@@ -210,6 +216,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -c, --command <command>       run command rather than interactive shell\n"), out);
 	fputs(_(" -e, --return                  return exit code of the child process\n"), out);
 	fputs(_(" -f, --flush                   run flush after each write\n"), out);
+	fputs(_("     --flush-interval <ms>     max delay of unflushed log data\n"), out);
 	fputs(_("     --force                   use output file even when it is a link\n"), out);
 	fputs(_(" -E, --echo <when>             echo input in session (auto, always or never)\n"), out);
 	fputs(_(" -o, --output-limit <size>     terminate if output files exceed size\n"), out);
@@ -386,6 +393,8 @@ static int log_start(struct script_control *ctl,
 		warn(_("cannot open %s"), log->filename);
 		return -errno;
 	}
+	/* the logs are flushed by log_schedule_flush() or on demand */
+	setvbuf(log->fp, NULL, _IOFBF, SCRIPT_LOG_BUFSIZ);
 
 	/* write header, etc. */
 	switch (log->format) {
@@ -448,6 +457,26 @@ static int logging_start(struct script_control *ctl)
 	return 0;
 }
 
+/* make sure the written log data do not wait in the buffers too long */
+static void log_schedule_flush(struct script_control *ctl, struct script_log *log)
+{
+	struct timeval now, delay;
+
+	if (ctl->flush) {
+		fflush(log->fp);
+		return;
+	}
+	if (!ctl->flush_interval || timerisset(&ctl->flush_time))
+		return;
+
+	delay.tv_sec = ctl->flush_interval / 1000;
+	delay.tv_usec = (ctl->flush_interval % 1000) * 1000;
+
+	gettime_monotonic(&now);
+	timeradd(&now, &delay, &ctl->flush_time);
+	ul_pty_set_mainloop_time(ctl->pty, &ctl->flush_time);
+}
+
 static ssize_t log_write(struct script_control *ctl,
 		      struct script_stream *stream,
 		      struct script_log *log,
@@ -503,8 +532,7 @@ static ssize_t log_write(struct script_control *ctl,
 		break;
 	}
 
-	if (ctl->flush)
-		fflush(log->fp);
+	log_schedule_flush(ctl, log);
 	return ssz;
 }
 
@@ -567,6 +595,7 @@ static ssize_t __attribute__ ((__format__ (__printf__, 3, 4)))
 			signum_to_signame(signum));
 
 	log->oldtime = now;
+	log_schedule_flush(ctl, log);
 	return sz;
 }
 
@@ -741,6 +770,17 @@ static int callback_flush_logs(void *data)
 	return 0;
 }
 
+/* called by ul_pty main loop when ctl->flush_time is over */
+static int callback_mainloop(void *data)
+{
+	struct script_control *ctl = (struct script_control *) data;
+
+	timerclear(&ctl->flush_time);
+	ul_pty_set_mainloop_time(ctl->pty, NULL);
+
+	return callback_flush_logs(ctl);
+}
+
 static void die_if_link(struct script_control *ctl, const char *filename)
 {
 	struct stat s;
@@ -759,13 +799,17 @@ int main(int argc, char **argv)
 	struct script_control ctl = {
 		.out = { .ident = 'O' },
 		.in  = { .ident = 'I' },
+		.flush_interval = SCRIPT_FLUSH_INTERVAL,
 	};
 	struct ul_pty_callbacks *cb;
 	int ch, format = 0, caught_signal = 0, rc = 0, echo = 1;
 	const char *outfile = NULL, *infile = NULL;
 	const char *timingfile = NULL, *shell = NULL;
 
-	enum { FORCE_OPTION = CHAR_MAX + 1 };
+	enum {
+		FORCE_OPTION = CHAR_MAX + 1,
+		FLUSH_INTERVAL_OPTION
+	};
 
 	static const struct option longopts[] = {
 		{"append", no_argument, NULL, 'a'},
@@ -773,6 +817,7 @@ int main(int argc, char **argv)
 		{"echo", required_argument, NULL, 'E'},
 		{"return", no_argument, NULL, 'e'},
 		{"flush", no_argument, NULL, 'f'},
+		{"flush-interval", required_argument, NULL, FLUSH_INTERVAL_OPTION},
 		{"force", no_argument, NULL, FORCE_OPTION,},
 		{"log-in", required_argument, NULL, 'I'},
 		{"log-out", required_argument, NULL, 'O'},
@@ -838,6 +883,10 @@ int main(int argc, char **argv)
 		case 'f':
 			ctl.flush = 1;
 			break;
+		case FLUSH_INTERVAL_OPTION:
+			ctl.flush_interval = strtou32_or_err(optarg,
+					_("failed to parse flush interval"));
+			break;
 		case FORCE_OPTION:
 			ctl.force = 1;
 			break;
@@ -944,6 +993,7 @@ int main(int argc, char **argv)
 	cb->log_stream_activity = callback_log_stream_activity;
 	cb->log_signal = callback_log_signal;
 	cb->flush_logs = callback_flush_logs;
+	cb->mainloop = callback_mainloop;
 
 	if (!ctl.quiet) {
 		printf(_("Script started"));
@@ -73,6 +73,7 @@ usage(void)
 	fputs(_(" -c, --command <command> run command rather than interactive shell\n"), out);
 	fputs(_(" -d, --divisor <num>     speed up or slow down execution with time divisor\n"), out);
 	fputs(_(" -m, --maxdelay <num>    wait at most this many seconds between updates\n"), out);
+	fputs(_("     --target <time>     execute the session without delays up to the time\n"), out);
 	fprintf(out, USAGE_HELP_OPTIONS(25));
 
 	fprintf(out, USAGE_MAN_TAIL("scriptlive(1)"));
@@ -158,7 +159,7 @@ int
 main(int argc, char *argv[])
 {
 	static const struct timeval mindelay = { .tv_sec = 0, .tv_usec = 100 };
-	struct timeval maxdelay;
+	struct timeval maxdelay, target;
 
 	const char *log_in = NULL, *log_io = NULL, *log_tm = NULL,
 		   *shell = NULL, *command = NULL;
@@ -168,6 +169,9 @@ main(int argc, char *argv[])
 	struct ul_pty_callbacks *cb;
 	struct scriptlive ss = { .pty = NULL };
 	pid_t child;
+	enum {
+		OPT_TARGET = CHAR_MAX + 1
+	};
 
 	static const struct option longopts[] = {
 		{ "command",    required_argument,      0, 'c' },
@@ -177,6 +181,7 @@ main(int argc, char *argv[])
 		{ "log-io",     required_argument,      0, 'B'},
 		{ "divisor",	required_argument,	0, 'd' },
 		{ "maxdelay",	required_argument,	0, 'm' },
+		{ "target",	required_argument,	0, OPT_TARGET },
 		{ "version",	no_argument,		0, 'V' },
 		{ "help",	no_argument,		0, 'h' },
 		{ NULL,		0, 0, 0 }
@@ -199,6 +204,7 @@ main(int argc, char *argv[])
 
 	replay_init_debug();
 	timerclear(&maxdelay);
+	timerclear(&target);
 
 	while ((ch = getopt_long(argc, argv, "c:B:I:T:t:d:m:Vh", longopts, NULL)) != -1) {
 
@@ -225,6 +231,9 @@ main(int argc, char *argv[])
 		case 'm':
 			strtotimeval_or_err(optarg, &maxdelay, _("failed to parse maximal delay argument"));
 			break;
+		case OPT_TARGET:
+			strtotimeval_or_err(optarg, &target, _("failed to parse target time"));
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -269,6 +278,8 @@ main(int argc, char *argv[])
 	if (timerisset(&maxdelay))
 		replay_set_delay_max(ss.setup, &maxdelay);
 	replay_set_delay_min(ss.setup, &mindelay);
+	if (timerisset(&target))
+		replay_set_target(ss.setup, &target);
 
 	shell = getenv("SHELL");
 	if (shell == NULL)
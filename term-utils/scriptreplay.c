@@ -66,6 +66,8 @@ usage(void)
 	fputs(_("     --summary           display overview about recorded session and exit\n"), out);
 	fputs(_(" -d, --divisor <num>     speed up or slow down execution with time divisor\n"), out);
 	fputs(_(" -m, --maxdelay <num>    wait at most this many seconds between updates\n"), out);
+	fputs(_("     --target <time>     replay the session without delays up to the time\n"), out);
+	fputs(_("     --seek <time>       skip the session up to the time\n"), out);
 	fputs(_(" -x, --stream <name>     stream type (out, in, signal or info)\n"), out);
 	fputs(_(" -c, --cr-mode <type>    CR char mode (auto, never, always)\n"), out);
 	fprintf(out, USAGE_HELP_OPTIONS(25));
@@ -143,7 +145,7 @@ int
 main(int argc, char *argv[])
 {
 	static const struct timeval mindelay = { .tv_sec = 0, .tv_usec = 100 };
-	struct timeval maxdelay;
+	struct timeval maxdelay, target;
 
 	int isterm;
 	struct termios saved;
@@ -157,9 +159,11 @@ main(int argc, char *argv[])
 		   *log_tm = NULL;
 	double divi = 1;
 	int diviopt = FALSE, idx;
-	int ch, rc, crmode = REPLAY_CRMODE_AUTO, summary = 0;
+	int ch, rc, crmode = REPLAY_CRMODE_AUTO, summary = 0, seek = 0;
 	enum {
-		OPT_SUMMARY = CHAR_MAX + 1
+		OPT_SUMMARY = CHAR_MAX + 1,
+		OPT_TARGET,
+		OPT_SEEK
 	};
 
 	static const struct option longopts[] = {
@@ -174,12 +178,15 @@ main(int argc, char *argv[])
 		{ "maxdelay",	required_argument,	0, 'm' },
 		{ "stream",     required_argument,	0, 'x' },
 		{ "summary",    no_argument,            0, OPT_SUMMARY },
+		{ "target",     required_argument,      0, OPT_TARGET },
+		{ "seek",       required_argument,      0, OPT_SEEK },
 		{ "version",	no_argument,		0, 'V' },
 		{ "help",	no_argument,		0, 'h' },
 		{ NULL,		0, 0, 0 }
 	};
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
 		{ 'O', 's' },
+		{ OPT_TARGET, OPT_SEEK },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -196,6 +203,7 @@ main(int argc, char *argv[])
 
 	replay_init_debug();
 	timerclear(&maxdelay);
+	timerclear(&target);
 
 	while ((ch = getopt_long(argc, argv, "B:c:I:O:T:t:s:d:m:x:Vh", longopts, NULL)) != -1) {
 
@@ -248,6 +256,12 @@ main(int argc, char *argv[])
 		case OPT_SUMMARY:
 			summary = 1;
 			break;
+		case OPT_SEEK:
+			seek = 1;
+			/* fallthrough */
+		case OPT_TARGET:
+			strtotimeval_or_err(optarg, &target, _("failed to parse target time"));
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -308,6 +322,15 @@ main(int argc, char *argv[])
 		replay_set_delay_max(setup, &maxdelay);
 	replay_set_delay_min(setup, &mindelay);
 
+	if (seek) {
+		rc = replay_seek_target(setup, &target);
+		if (rc < 0)
+			err(EXIT_FAILURE, _("%s: line %d: timing file error"),
+					replay_get_timing_file(setup),
+					replay_get_timing_line(setup));
+	} else if (timerisset(&target))
+		replay_set_target(setup, &target);
+
 	isterm = setterm(&saved);
 
 	do {
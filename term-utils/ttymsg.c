@@ -43,6 +43,8 @@
 #include <sys/types.h>
 #include <sys/param.h>
 #include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <dirent.h>
@@ -56,6 +58,9 @@
 #include "nls.h"
 #include "closestream.h"
 #include "pathnames.h"
+#include "fileutils.h"
+#include "monotonic.h"
+#include "xalloc.h"
 #include "ttymsg.h"
 
 #define ERR_BUFLEN	(MAXNAMLEN + 1024)
@@ -190,3 +195,307 @@ ttymsg(struct iovec *iov, size_t iovcnt, char *line, int tmout) {
 		_exit(EXIT_SUCCESS);
 	return NULL;
 }
+
+/*
+ * Batched variant of ttymsg() for callers writing the same message to many
+ * terminals (wall(1)).  All terminals are opened non-blocking; whatever does
+ * not get written immediately is finished from a single epoll loop by
+ * ttymsg_batch_flush().  Terminals which do not drain within the timeout are
+ * dropped.  Only one child process is forked for all the pending terminals.
+ */
+struct ttymsg_tty {
+	int	fd;
+	size_t	off;		/* bytes of the message already written */
+};
+
+struct ttymsg_batch {
+	const char		*msg;
+	size_t			len;
+
+	struct ttymsg_tty	*ttys;	/* terminals with pending output */
+	size_t			nttys;
+	size_t			nalloc;
+
+	char			errbuf[ERR_BUFLEN];
+};
+
+struct ttymsg_batch *ttymsg_batch_new(const char *msg, size_t len)
+{
+	struct ttymsg_batch *b = xcalloc(1, sizeof(*b));
+
+	b->msg = msg;
+	b->len = len;
+	return b;
+}
+
+void ttymsg_batch_free(struct ttymsg_batch *b)
+{
+	size_t i;
+
+	if (!b)
+		return;
+	for (i = 0; i < b->nttys; i++)
+		close(b->ttys[i].fd);
+	free(b->ttys);
+	free(b);
+}
+
+/* Returns 0 when done, 1 when the write would block, <0 on error. */
+static int ttymsg_batch_write(struct ttymsg_batch *b, struct ttymsg_tty *t)
+{
+	while (t->off < b->len) {
+		ssize_t ret = write(t->fd, b->msg + t->off, b->len - t->off);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 1;
+			/* ENODEV on a slip line, EIO if the line just went away */
+			if (errno == ENODEV || errno == EIO)
+				return 0;
+			return -errno;
+		}
+		t->off += ret;
+	}
+	return 0;
+}
+
+/*
+ * Open the terminal and write as much of the message as possible.  Returns
+ * pointer to error string on unexpected error, like ttymsg().
+ */
+char *ttymsg_batch_add(struct ttymsg_batch *b, const char *line)
+{
+	char device[MAXNAMLEN];
+	struct ttymsg_tty t = { .off = 0 };
+	int len, rc;
+
+	len = snprintf(device, sizeof(device), "%s%s", _PATH_DEV, line);
+	if (len < 0 || (size_t)len >= sizeof(device)) {
+		snprintf(b->errbuf, sizeof(b->errbuf), _("excessively long line arg"));
+		return b->errbuf;
+	}
+
+	t.fd = open(device, O_WRONLY|O_NONBLOCK|O_CLOEXEC|O_NOCTTY, 0);
+	if (t.fd < 0 && errno == EMFILE
+	    && ul_raise_fd_limit(b->nttys * 2 + 64) == 0)
+		t.fd = open(device, O_WRONLY|O_NONBLOCK|O_CLOEXEC|O_NOCTTY, 0);
+	if (t.fd < 0) {
+		if (errno == EBUSY || errno == EACCES || errno == ENOENT)
+			return NULL;
+		goto fail;
+	}
+
+	rc = ttymsg_batch_write(b, &t);
+	if (rc == 0) {
+		close(t.fd);
+		return NULL;
+	}
+	if (rc < 0) {
+		close(t.fd);
+		errno = -rc;
+		goto fail;
+	}
+
+	if (b->nttys == b->nalloc) {
+		b->nalloc = b->nalloc ? b->nalloc * 2 : 16;
+		b->ttys = xreallocarray(b->ttys, b->nalloc, sizeof(*b->ttys));
+	}
+	b->ttys[b->nttys++] = t;
+	return NULL;
+fail:
+	len = snprintf(b->errbuf, sizeof(b->errbuf), "%s: %m", device);
+	if (len < 0 || (size_t)len >= sizeof(b->errbuf))
+		snprintf(b->errbuf, sizeof(b->errbuf), _("open failed"));
+	return b->errbuf;
+}
+
+/*
+ * Finish all pending writes, waiting at most tmout seconds in total.
+ * Returns the number of terminals dropped due to timeout or write error.
+ */
+static size_t batch_write_pending(struct ttymsg_batch *b, int tmout)
+{
+	struct epoll_event evts[64];
+	struct timeval now, end = { .tv_sec = tmout };
+	size_t i, active, dropped = 0;
+	int efd;
+
+	efd = epoll_create1(EPOLL_CLOEXEC);
+	if (efd < 0) {
+		warn(_("cannot create epoll"));
+		dropped = b->nttys;
+		goto done;
+	}
+
+	for (i = 0; i < b->nttys; i++) {
+		struct epoll_event ev = { .events = EPOLLOUT, .data.u64 = i };
+
+		if (epoll_ctl(efd, EPOLL_CTL_ADD, b->ttys[i].fd, &ev) < 0) {
+			close(b->ttys[i].fd);
+			b->ttys[i].fd = -1;
+			dropped++;
+		}
+	}
+	active = b->nttys - dropped;
+
+	gettime_monotonic(&now);
+	timeradd(&now, &end, &end);
+
+	while (active) {
+		struct timeval left;
+		int n, ms;
+
+		gettime_monotonic(&now);
+		if (!timercmp(&now, &end, <))
+			break;
+		timersub(&end, &now, &left);
+		ms = left.tv_sec * 1000 + (left.tv_usec + 999) / 1000;
+
+		n = epoll_wait(efd, evts, ARRAY_SIZE(evts), ms);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			warn(_("epoll_wait failed"));
+			break;
+		}
+		while (n-- > 0) {
+			struct ttymsg_tty *t = &b->ttys[evts[n].data.u64];
+			int rc = ttymsg_batch_write(b, t);
+
+			if (rc == 1 && !(evts[n].events & (EPOLLERR | EPOLLHUP)))
+				continue;
+			if (rc < 0 || rc == 1)
+				dropped++;
+			close(t->fd);
+			t->fd = -1;
+			active--;
+		}
+	}
+	dropped += active;
+	close(efd);
+done:
+	for (i = 0; i < b->nttys; i++) {
+		if (b->ttys[i].fd >= 0)
+			close(b->ttys[i].fd);
+	}
+	b->nttys = 0;
+	return dropped;
+}
+
+/*
+ * Finish the writes which would block in a child process, waiting at most
+ * tmout seconds for all the terminals.  Like ttymsg(), the function does not
+ * wait for the child.  Returns pointer to error string if fork fails.
+ */
+char *ttymsg_batch_flush(struct ttymsg_batch *b, int tmout)
+{
+	sigset_t sigmask;
+	size_t i;
+	pid_t cpid;
+
+	if (!b->nttys)
+		return NULL;
+
+	cpid = fork();
+	if (cpid < 0) {
+		int len = snprintf(b->errbuf, sizeof(b->errbuf), _("fork: %m"));
+		if (len < 0 || (size_t)len >= sizeof(b->errbuf))
+			snprintf(b->errbuf, sizeof(b->errbuf), _("cannot fork"));
+		return b->errbuf;
+	}
+	if (cpid) {	/* parent */
+		for (i = 0; i < b->nttys; i++)
+			close(b->ttys[i].fd);
+		b->nttys = 0;
+		return NULL;
+	}
+
+	signal(SIGALRM, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	sigemptyset(&sigmask);
+	sigprocmask(SIG_SETMASK, &sigmask, NULL);
+
+	_exit(batch_write_pending(b, tmout) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+#ifdef TEST_PROGRAM_TTYMSG
+/*
+ * Writes <size> bytes to a new pseudo-terminal. The terminal is not read
+ * until ttymsg_batch_flush() returns, and it is not read at all if <read>
+ * is 0. Prints whether the flush returned immediately, the number of the
+ * bytes read from the terminal and the exit status of the flush child.
+ */
+# include <err.h>
+# include <poll.h>
+# include <sys/wait.h>
+# include "strutils.h"
+
+int main(int argc, char *argv[])
+{
+	struct ttymsg_batch *b;
+	struct timeval start, now, diff;
+	uint32_t size, tmout;
+	size_t got = 0;
+	char *msg, *name, buf[BUFSIZ];
+	int master, slave, status, rd;
+
+	if (argc != 4)
+		errx(EXIT_FAILURE, "usage: %s <size> <timeout> <read>",
+				program_invocation_short_name);
+
+	size = strtou32_or_err(argv[1], "invalid size");
+	tmout = strtou32_or_err(argv[2], "invalid timeout");
+	rd = strtos32_or_err(argv[3], "invalid read argument");
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0
+	    || !(name = ptsname(master)))
+		err(EXIT_FAILURE, "cannot create pseudo-terminal");
+
+	/* keep the terminal open, the data are not lost after the child exits */
+	slave = open(name, O_RDWR | O_NOCTTY);
+	if (slave < 0)
+		err(EXIT_FAILURE, "cannot open %s", name);
+	if (strncmp(name, _PATH_DEV, sizeof(_PATH_DEV) - 1) != 0)
+		errx(EXIT_FAILURE, "unexpected terminal name %s", name);
+
+	msg = xmalloc(size);
+	memset(msg, 'x', size);
+
+	b = ttymsg_batch_new(msg, size);
+	if ((name = ttymsg_batch_add(b, name + sizeof(_PATH_DEV) - 1)) != NULL)
+		errx(EXIT_FAILURE, "%s", name);
+
+	gettime_monotonic(&start);
+	if ((name = ttymsg_batch_flush(b, tmout)) != NULL)
+		errx(EXIT_FAILURE, "%s", name);
+	gettime_monotonic(&now);
+	timersub(&now, &start, &diff);
+	printf("flush: %s\n", diff.tv_sec < 1 ? "returned" : "blocked");
+
+	while (rd && got < size) {
+		struct pollfd fds = { .fd = master, .events = POLLIN };
+		ssize_t ret;
+
+		if (poll(&fds, 1, tmout * 1000) <= 0)
+			break;
+		ret = read(master, buf, sizeof(buf));
+		if (ret <= 0)
+			break;
+		got += ret;
+	}
+	printf("read: %zu bytes\n", got);
+
+	if (wait(&status) < 0)
+		err(EXIT_FAILURE, "wait failed");
+	printf("child: %d\n", WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+
+	ttymsg_batch_free(b);
+	free(msg);
+	close(slave);
+	close(master);
+	return EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM_TTYMSG */
@@ -3,4 +3,11 @@
 
 char *ttymsg(struct iovec *iov, size_t iovcnt, char *line, int tmout);
 
+struct ttymsg_batch;
+
+struct ttymsg_batch *ttymsg_batch_new(const char *msg, size_t len);
+void ttymsg_batch_free(struct ttymsg_batch *b);
+char *ttymsg_batch_add(struct ttymsg_batch *b, const char *line);
+char *ttymsg_batch_flush(struct ttymsg_batch *b, int tmout);
+
 #endif /* UTIL_LINUX_TERM_TTYMSG_H */
@@ -186,7 +186,7 @@ static int is_gr_member(const char *login, const struct group_workspace *buf)
 int main(int argc, char **argv)
 {
 	int ch;
-	struct iovec iov;
+	struct ttymsg_batch *batch;
 	struct utmpx *utmpptr;
 	char *p;
 	char line[sizeof(utmpptr->ut_line) + 1];
@@ -249,8 +249,7 @@ int main(int argc, char **argv)
 
 	mbuf = makemsg(fname, mvec, mvecsz, &mbufsize, print_banner);
 
-	iov.iov_base = mbuf;
-	iov.iov_len = mbufsize;
+	batch = ttymsg_batch_new(mbuf, mbufsize);
 
 #if defined(USE_SYSTEMD) && HAVE_DECL_SD_SESSION_GET_USERNAME == 1
 	if (sd_booted() > 0) {
@@ -271,7 +270,7 @@ int main(int argc, char **argv)
 
 			if (!(group_buf && !is_gr_member(name, group_buf))) {
 				if (sd_session_get_tty(sessions_list[i], &tty) >= 0) {
-					if ((p = ttymsg(&iov, 1, tty, timeout)) != NULL)
+					if ((p = ttymsg_batch_add(batch, tty)) != NULL)
 						warnx("%s", p);
 
 					free(tty);
@@ -303,12 +302,17 @@ int main(int argc, char **argv)
 				continue;
 
 			mem2strcpy(line, utmpptr->ut_line, sizeof(utmpptr->ut_line), sizeof(line));
-			if ((p = ttymsg(&iov, 1, line, timeout)) != NULL)
+			if ((p = ttymsg_batch_add(batch, line)) != NULL)
 				warnx("%s", p);
 		}
 		endutxent();
 	}
 
+	/* finish writes to terminals which would block, in background */
+	if ((p = ttymsg_batch_flush(batch, timeout)) != NULL)
+		warnx("%s", p);
+	ttymsg_batch_free(batch);
+
 	free(mbuf);
 	free_group_workspace(group_buf);
 	exit(EXIT_SUCCESS);
@@ -6,15 +6,18 @@ TS_HELPER_BOILERPLATE="${ts_helpersdir}test_boilerplate"
 TS_HELPER_BYTESWAP="${ts_helpersdir}test_byteswap"
 TS_HELPER_CPUSET="${ts_helpersdir}test_cpuset"
 TS_HELPER_CAP="${ts_helpersdir}test_cap"
+TS_HELPER_CANONICALIZE="${ts_helpersdir}test_canonicalize"
 TS_HELPER_DMESG="${ts_helpersdir}test_dmesg"
 TS_HELPER_ENOSYS="${ts_helpersdir}test_enosys"
 TS_HELPER_ISLOCAL="${ts_helpersdir}test_islocal"
 TS_HELPER_ISMOUNTED="${ts_helpersdir}test_ismounted"
 TS_HELPER_LIBFDISK_GPT="${ts_helpersdir}test_fdisk_gpt"
 TS_HELPER_LIBFDISK_MKPART="${ts_helpersdir}sample-fdisk-mkpart"
+TS_HELPER_LIBMOUNT_CACHE="${ts_helpersdir}test_mount_cache"
 TS_HELPER_LIBMOUNT_CONTEXT="${ts_helpersdir}test_mount_context"
 TS_HELPER_LIBFDISK_MKPART_FULLSPEC="${ts_helpersdir}sample-fdisk-mkpart-fullspec"
 TS_HELPER_LIBFDISK_SCRIPT_FUZZ="${ts_helpersdir}test_fdisk_script_fuzz"
+TS_HELPER_LIBLASTLOG2_BATCH_WRITE="${ts_helpersdir}test_lastlog2_batch_write"
 TS_HELPER_LIBLASTLOG2_DLOPEN="${ts_helpersdir}test_lastlog2_dlopen"
 TS_HELPER_LIBLASTLOG2_PAM_LASTLOG2_OUTPUT="${ts_helpersdir}test_lastlog2_pam_lastlog2_output"
 TS_HELPER_LIBLASTLOG2_REMOVE_ENTRY="${ts_helpersdir}test_lastlog2_remove_entry"
@@ -32,6 +35,7 @@ TS_HELPER_LIBMOUNT_UTILS="${ts_helpersdir}test_mount_utils"
 TS_HELPER_LIBMOUNT_DEBUG="${ts_helpersdir}test_mount_debug"
 TS_HELPER_LIBMOUNT_FUZZ="${ts_helpersdir}test_mount_fuzz"
 TS_HELPER_LIBSMARTCOLS_CONTINUOUS_JSON="${ts_helpersdir}sample-scols-continuous-json"
+TS_HELPER_LIBSMARTCOLS_STREAMING="${ts_helpersdir}sample-scols-streaming"
 TS_HELPER_LIBSMARTCOLS_FROMFILE="${ts_helpersdir}sample-scols-fromfile"
 TS_HELPER_LIBSMARTCOLS_TITLE="${ts_helpersdir}sample-scols-title"
 TS_HELPER_PYLIBMOUNT_CONTEXT="$top_srcdir/libmount/python/test_mount_context.py"
@@ -41,16 +45,19 @@ TS_HELPER_LOGGER="${ts_helpersdir}test_logger"
 TS_HELPER_LOGINDEFS="${ts_helpersdir}test_logindefs"
 TS_HELPER_MD5="${ts_helpersdir}test_md5"
 TS_HELPER_SHA1="${ts_helpersdir}test_sha1"
+TS_HELPER_SHA256="${ts_helpersdir}test_sha256"
 TS_HELPER_MKFS_MINIX="${ts_helpersdir}test_mkfs_minix"
 TS_HELPER_MORE=${TS_HELPER_MORE-"${ts_helpersdir}test_more"}
 TS_HELPER_PARTITIONS="${ts_helpersdir}sample-partitions"
 TS_HELPER_PATHS="${ts_helpersdir}test_pathnames"
 TS_HELPER_SCRIPT="${ts_helpersdir}test_script"
+TS_HELPER_RECVDGRAM="${ts_helpersdir}test_recvdgram"
 TS_HELPER_SIGRECEIVE="${ts_helpersdir}test_sigreceive"
 TS_HELPER_STRERROR="${ts_helpersdir}test_strerror"
 TS_HELPER_STRUTILS="${ts_helpersdir}test_strutils"
 TS_HELPER_SYSINFO="${ts_helpersdir}test_sysinfo"
 TS_HELPER_TIOCSTI="${ts_helpersdir}test_tiocsti"
+TS_HELPER_TTYMSG="${ts_helpersdir}test_ttymsg"
 TS_HELPER_UUID_PARSER="${ts_helpersdir}test_uuid_parser"
 TS_HELPER_UUID_NAMESPACE="${ts_helpersdir}test_uuid_namespace"
 TS_HELPER_MBSENCODE="${ts_helpersdir}test_mbsencode"
@@ -58,8 +65,18 @@ TS_HELPER_CAL="${ts_helpersdir}test_cal"
 TS_HELPER_LAST_FUZZ="${ts_helpersdir}test_last_fuzz"
 TS_HELPER_MKFDS="${ts_helpersdir}test_mkfds"
 TS_HELPER_BLKID_FUZZ="${ts_helpersdir}test_blkid_fuzz"
+TS_HELPER_BLKID_BINCACHE="${ts_helpersdir}test_blkid_bincache"
 TS_HELPER_PROCFS="${ts_helpersdir}test_procfs"
 TS_HELPER_TIMEUTILS="${ts_helpersdir}test_timeutils"
+TS_HELPER_WALKDIR="${ts_helpersdir}test_walkdir"
+TS_HELPER_ISZERO="${ts_helpersdir}test_iszero"
+TS_HELPER_CRC32="${ts_helpersdir}test_crc32"
+TS_HELPER_FILEEQ="${ts_helpersdir}test_fileeq"
+TS_HELPER_LINEINDEX="${ts_helpersdir}test_lineindex"
+TS_HELPER_UUIDD="${ts_helpersdir}test_uuidd"
+TS_HELPER_LIBBLKID_BENCHMARK="${ts_helpersdir}sample-benchmark"
+TS_HELPER_LIBMOUNT_BENCHMARK="${ts_helpersdir}sample-mount-benchmark"
+TS_HELPER_LIBSMARTCOLS_BENCHMARK="${ts_helpersdir}sample-scols-benchmark"
 
 # paths to commands
 TS_CMD_ADDPART=${TS_CMD_ADDPART:-"${ts_commandsdir}addpart"}
@@ -81,6 +98,7 @@ TS_CMD_SFDISK=${TS_CMD_SFDISK-"${ts_commandsdir}sfdisk"}
 TS_CMD_FADVISE=${TS_CMD_FADVISE-"${ts_commandsdir}fadvise"}
 TS_CMD_FINCORE=${TS_CMD_FINCORE-"${ts_commandsdir}fincore"}
 TS_CMD_FINDMNT=${TS_CMD_FINDMNT-"${ts_commandsdir}findmnt"}
+TS_CMD_FSFREEZE=${TS_CMD_FSFREEZE-"${ts_commandsdir}fsfreeze"}
 TS_CMD_FSCKCRAMFS=${TS_CMD_FSCKCRAMFS:-"${ts_commandsdir}fsck.cramfs"}
 TS_CMD_FSCKMINIX=${TS_CMD_FSCKMINIX:-"${ts_commandsdir}fsck.minix"}
 TS_CMD_GETOPT=${TS_CMD_GETOPT-"${ts_commandsdir}getopt"}
@@ -113,7 +131,9 @@ TS_CMD_MOUNTPOINT=${TS_CMD_MOUNTPOINT:-"${ts_commandsdir}mountpoint"}
 TS_CMD_NAMEI=${TS_CMD_NAMEI-"${ts_commandsdir}namei"}
 TS_CMD_PARTX=${TS_CMD_PARTX-"${ts_commandsdir}partx"}
 TS_CMD_PIPESZ=${TS_CMD_PIPESZ-"${ts_commandsdir}pipesz"}
+TS_CMD_PRLIMIT=${TS_CMD_PRLIMIT-"${ts_commandsdir}prlimit"}
 TS_CMD_RENAME=${TS_CMD_RENAME-"${ts_commandsdir}rename"}
+TS_CMD_RENICE=${TS_CMD_RENICE-"${ts_commandsdir}renice"}
 TS_CMD_RUNUSER=${TS_CMD_RUNUSER-"${ts_commandsdir}runuser"}
 TS_CMD_REV=${TS_CMD_REV:-"${ts_commandsdir}rev"}
 TS_CMD_SCRIPT=${TS_CMD_SCRIPT-"${ts_commandsdir}script"}
@@ -127,6 +147,8 @@ TS_CMD_SWAPLABEL=${TS_CMD_SWAPLABEL:-"${ts_commandsdir}swaplabel"}
 TS_CMD_SWAPOFF=${TS_CMD_SWAPOFF:-"${ts_commandsdir}swapoff"}
 TS_CMD_SWAPON=${TS_CMD_SWAPON:-"${ts_commandsdir}swapon"}
 TS_CMD_LSLOGINS=${TS_CMD_LSLOGINS:-"${ts_commandsdir}lslogins"}
+TS_CMD_TASKSET=${TS_CMD_TASKSET-"${ts_commandsdir}taskset"}
+TS_CMD_UCLAMPSET=${TS_CMD_UCLAMPSET-"${ts_commandsdir}uclampset"}
 TS_CMD_UL=${TS_CMD_UL-"${ts_commandsdir}ul"}
 TS_CMD_UMOUNT=${TS_CMD_UMOUNT:-"${ts_commandsdir}umount"}
 TS_CMD_UNSHARE=${TS_CMD_UNSHARE:-"${ts_commandsdir}unshare"}
@@ -137,5 +159,6 @@ TS_CMD_UUIDPARSE=${TS_CMD_UUIDPARSE-"${ts_commandsdir}uuidparse"}
 TS_CMD_WAITPID=${TS_CMD_WAITPID-"${ts_commandsdir}waitpid"}
 TS_CMD_WHEREIS=${TS_CMD_WHEREIS-"${ts_commandsdir}whereis"}
 TS_CMD_WIPEFS=${TS_CMD_WIPEFS-"${ts_commandsdir}wipefs"}
+TS_CMD_ZRAMCTL=${TS_CMD_ZRAMCTL-"${ts_commandsdir}zramctl"}
 TS_CMD_CHRT=${TS_CMD_CHRT-"${ts_commandsdir}chrt"}
 TS_CMD_CHFN=${TS_CMD_CHFN-"${ts_commandsdir}chfn"}
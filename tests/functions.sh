@@ -385,6 +385,16 @@ function ts_init_env {
 	TS_PARSABLE=$(ts_has_option "parsable" "$*")
 	[ "$TS_PARSABLE" = "yes" ] || TS_PARSABLE="$TS_PARALLEL"
 
+	TS_PERF=$(ts_has_option "perf" "$*")
+	TS_PERF_UPDATE=$(ts_has_option "perf-update" "$*")
+	TS_PERF_TOLERANCE=$(ts_option_argument "perf-tolerance" "$*")
+	TS_PERF_TOLERANCE=${TS_PERF_TOLERANCE:-25}
+	TS_PERF_BASELINE=$(ts_option_argument "perf-baseline" "$*")
+	TS_PERF_BASELINE=${TS_PERF_BASELINE:-"$top_builddir/tests/perf-baseline"}
+	TS_PERF_REPEAT=${TS_PERF_REPEAT:-5}
+	TS_PERF_DATA="$TS_OUTDIR/${TS_TESTNAME}.perf"
+	TS_PERF_RESULT="$TS_OUTDIR/${TS_TESTNAME}.json"
+
 	tmp=$( ts_has_option "memcheck-valgrind" "$*")
 	if [ "$tmp" == "yes" -a -f /usr/bin/valgrind ]; then
 		TS_VALGRIND_CMD="/usr/bin/valgrind"
@@ -466,6 +476,11 @@ function ts_init {
 
 	[ "$is_fake" == "yes" ] && ts_skip "fake mode"
 	[ "$TS_OPTIONAL" == "yes" -a "$is_force" != "yes" ] && ts_skip "optional"
+
+	if [ "$TS_CLASS" == "perf" ]; then
+		[ "$TS_PERF" != "yes" ] && ts_skip "performance test, --perf required"
+		rm -f "$TS_PERF_DATA" "$TS_PERF_RESULT"
+	fi
 }
 
 function ts_init_suid {
@@ -656,6 +671,113 @@ function ts_finalize {
 	ts_ok "$1"
 }
 
+#
+# Performance tests (TS_CLASS="perf")
+#
+# The tests record metrics where the lower value is better (time, memory) by
+# ts_perf_record, ts_perf_record_json or ts_perf_time. The metrics are saved
+# as JSON object to $TS_PERF_RESULT by ts_perf_finalize and compared with the
+# baseline from the --perf-baseline=<dir> directory; the metrics worse than
+# --perf-tolerance=<percent> are reported as the test failure. The baseline is
+# (re)created by --perf-update, the results are not compared in this case.
+#
+function ts_perf_record {
+	local metric="$1"
+	local value="$2"
+
+	echo "$metric $value" >> "$TS_PERF_DATA"
+}
+
+# ts_perf_record_json <prefix> <id-keys> <metric-keys>
+#
+# Reads one JSON object per line (without nested objects) from stdin, for
+# example {"image":"ext4.img","mode":"safeprobe","usec":3791} and records
+# <metric-keys> as <prefix>/<id-values>/<metric-key>.
+function ts_perf_record_json {
+	awk -v prefix="$1" -v ids="$2" -v metrics="$3" '
+		BEGIN {
+			nids = split(ids, id, ",")
+			nmetrics = split(metrics, metric, ",")
+		}
+		/^{/ {
+			delete kv
+			line = $0
+			gsub(/^{|}$/, "", line)
+			n = split(line, field, /,"/)
+			for (i = 1; i <= n; i++) {
+				p = index(field[i], "\":")
+				key = substr(field[i], 1, p - 1)
+				val = substr(field[i], p + 2)
+				gsub(/"/, "", key)
+				gsub(/"/, "", val)
+				kv[key] = val
+			}
+			name = prefix
+			for (i = 1; i <= nids; i++)
+				if (id[i] in kv)
+					name = name "/" kv[id[i]]
+			for (i = 1; i <= nmetrics; i++)
+				if (metric[i] in kv)
+					print name "/" metric[i], kv[metric[i]]
+		}' >> "$TS_PERF_DATA"
+}
+
+# ts_perf_time <metric> <command> [<argument> ...]
+#
+# Records the best CPU time (user + system, in microseconds) of the command
+# from $TS_PERF_REPEAT runs. The command output is ignored.
+function ts_perf_time {
+	local metric="$1"
+	local best= t i
+	shift
+
+	for i in $(seq 1 $TS_PERF_REPEAT); do
+		t=$( { TIMEFORMAT="%3U %3S"; time "$@" > /dev/null 2>> "$TS_ERRLOG"; } 2>&1 )
+		t=$(echo "$t" | awk '{ printf "%.0f", ($1 + $2) * 1000000 }')
+		if [ -z "$best" ] || [ "$t" -lt "$best" ]; then
+			best=$t
+		fi
+	done
+	ts_perf_record "$metric" "$best"
+}
+
+function ts_perf_finalize {
+	local baseline="$TS_PERF_BASELINE/$TS_COMPONENT/${TS_TESTNAME}.json"
+	local msg
+
+	[ -s "$TS_PERF_DATA" ] || ts_die "no performance data"
+
+	awk 'BEGIN { print "{" }
+	     { printf "%s   \"%s\": %s", (NR > 1 ? ",\n" : ""), $1, $2 }
+	     END { print "\n}" }' "$TS_PERF_DATA" > "$TS_PERF_RESULT"
+
+	if [ "$TS_PERF_UPDATE" == "yes" ]; then
+		mkdir -p "$TS_PERF_BASELINE/$TS_COMPONENT"
+		cp "$TS_PERF_RESULT" "$baseline"
+		msg="baseline updated"
+	elif [ -f "$baseline" ]; then
+		awk -v tolerance="$TS_PERF_TOLERANCE" '
+			FNR == NR {
+				if (match($0, /"[^"]+": /)) {
+					key = substr($0, RSTART + 1, RLENGTH - 4)
+					val = substr($0, RSTART + RLENGTH)
+					sub(/,$/, "", val)
+					base[key] = val
+				}
+				next
+			}
+			($1 in base) && base[$1] > 0 && $2 > base[$1] * (1 + tolerance / 100) {
+				printf "%s: %s -> %s (+%.1f%%)\n", $1, base[$1], $2,
+					($2 / base[$1] - 1) * 100
+			}' "$baseline" "$TS_PERF_DATA" >> "$TS_OUTPUT"
+		msg="compared with baseline"
+	else
+		msg="no baseline"
+	fi
+
+	ts_finalize "$msg"
+}
+
 function ts_die {
 	ts_log "$1"
 	ts_finalize
@@ -675,6 +797,7 @@ function ts_cleanup_on_exit {
 	unset TS_LOOP_DEVS
 
 	ts_scsi_debug_rmmod
+	ts_cgroup_deinit
 }
 
 function ts_image_md5sum {
@@ -1085,6 +1208,48 @@ function ts_scsi_debug_rmmod {
 	return 0
 }
 
+# Creates an empty cgroup v2 for the test.  TS_CGROUP is its path in the
+# hierarchy (as in /proc/<pid>/cgroup) and TS_CGROUP_DIR the directory in
+# /sys/fs/cgroup.  Returns non-zero if the cgroup cannot be created; the
+# caller decides whether to skip, see ts_skip_subtest.
+function ts_cgroup_init {
+	local mnt
+
+	[ $UID -eq 0 ] || return 1
+
+	mnt=$(awk '$3 == "cgroup2" { print $2; exit }' /proc/mounts)
+	case "$mnt" in
+	/sys/fs/cgroup|/sys/fs/cgroup/*)
+		;;
+	*)
+		return 1
+		;;
+	esac
+
+	TS_CGROUP="/ul-${TS_COMPONENT}-${TS_TESTNAME}-$$"
+	TS_CGROUP_DIR="${mnt}${TS_CGROUP}"
+	if ! mkdir "$TS_CGROUP_DIR" 2>/dev/null; then
+		unset TS_CGROUP TS_CGROUP_DIR
+		return 1
+	fi
+	return 0
+}
+
+# The processes in the cgroup have to be finished (and waited for) before.
+# Automatically called in ts_cleanup_on_exit().
+function ts_cgroup_deinit {
+	local t
+
+	[ -n "$TS_CGROUP_DIR" ] || return 0
+
+	for t in 0 0.02 0.05 0.1 1; do
+		sleep $t
+		rmdir "$TS_CGROUP_DIR" 2>/dev/null && break
+	done
+	[ -d "$TS_CGROUP_DIR" ] && ts_log "cannot remove cgroup $TS_CGROUP_DIR"
+	unset TS_CGROUP TS_CGROUP_DIR
+}
+
 function ts_resolve_host {
 	local host="$1"
 	local tmp
@@ -0,0 +1,67 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * test_recvdgram - receive datagrams on a UNIX socket and print them one per
+ * line, the datagram boundaries are kept in the output
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "strutils.h"
+
+#define TEST_RECVDGRAM_TIMEOUT	10	/* seconds for each datagram */
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	char buf[65536];
+	uint32_t count, i;
+	int fd;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <socket> <count>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	count = strtou32_or_err(argv[2], "invalid count");
+
+	if (strlen(argv[1]) >= sizeof(addr.sun_path))
+		errx(EXIT_FAILURE, "%s: path too long", argv[1]);
+	strcpy(addr.sun_path, argv[1]);
+
+	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if (fd < 0)
+		err(EXIT_FAILURE, "socket failed");
+	unlink(addr.sun_path);
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+		err(EXIT_FAILURE, "%s: bind failed", addr.sun_path);
+
+	for (i = 0; i < count; i++) {
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		ssize_t len;
+
+		if (poll(&pfd, 1, TEST_RECVDGRAM_TIMEOUT * 1000) != 1)
+			errx(EXIT_FAILURE, "timeout, %u datagrams received", i);
+
+		len = recv(fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			if (errno == EINTR) {
+				i--;
+				continue;
+			}
+			err(EXIT_FAILURE, "recv failed");
+		}
+		printf("%zd: %.*s\n", len, (int) len, buf);
+	}
+
+	close(fd);
+	unlink(addr.sun_path);
+	return EXIT_SUCCESS;
+}
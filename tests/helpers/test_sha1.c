@@ -7,16 +7,20 @@
 #include <unistd.h>
 #include <err.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "sha1.h"
 
-int main(void)
+int main(int argc, char *argv[])
 {
 	int i, ret;
 	UL_SHA1_CTX ctx;
 	unsigned char digest[UL_SHA1LENGTH];
 	unsigned char buf[BUFSIZ];
 
+	if (argc > 1 && strcmp(argv[1], "--generic") == 0)
+		ul_sha1_generic_only = 1;
+
 	ul_SHA1Init( &ctx );
 
 	while(!feof(stdin) && !ferror(stdin)) {
@@ -0,0 +1,41 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Prints SHA-256 of stdin; --generic disables the CPU extensions.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#include "sha256.h"
+
+int main(int argc, char *argv[])
+{
+	unsigned char digest[UL_SHA256LENGTH];
+	unsigned char *data = NULL;
+	size_t len = 0, sz = 0;
+	int i;
+
+	if (argc > 1 && strcmp(argv[1], "--generic") == 0)
+		ul_sha256_generic_only = 1;
+
+	/* ul_SHA256() has no incremental API, read the whole input */
+	while (!feof(stdin) && !ferror(stdin)) {
+		if (len == sz) {
+			sz = sz ? sz * 2 : BUFSIZ;
+			data = realloc(data, sz);
+			if (!data)
+				err(EXIT_FAILURE, "cannot allocate buffer");
+		}
+		len += fread(data + len, 1, sz - len, stdin);
+	}
+
+	ul_SHA256(digest, data, len);
+
+	for (i = 0; i < UL_SHA256LENGTH; i++)
+		printf("%02x", digest[i]);
+	printf("\n");
+	free(data);
+	return 0;
+}
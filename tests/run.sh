@@ -27,6 +27,7 @@ top_builddir=
 paraller_jobs=1
 has_asan_opt=
 has_ubsan_opt=
+has_perf_opt=
 
 function num_cpus()
 {
@@ -67,6 +68,9 @@ while [ -n "$1" ]; do
 	--verbose  |\
 	--skip-loopdevs |\
 	--noskip-commands |\
+	--perf-update |\
+	--perf-baseline=* |\
+	--perf-tolerance=* |\
 	--parsable)
 		# these options are simply forwarded to the test scripts
 		OPTS="$OPTS $1"
@@ -75,6 +79,10 @@ while [ -n "$1" ]; do
 		OPTS="$OPTS $1"
 		has_asan_opt="yes"
 		;;
+	--perf)
+		OPTS="$OPTS $1"
+		has_perf_opt="yes"
+		;;
 	--memcheck-ubsan)
 		OPTS="$OPTS $1"
 		has_ubsan_opt="yes"
@@ -132,6 +140,10 @@ while [ -n "$1" ]; do
 		echo "  --parallel=<num>      number of parallel test jobs, default: num cpus"
 		echo "  --parsable            use parsable output (default on --parallel)"
 		echo "  --exclude=<list>      exclude tests by list '<utilname>/<testname> ..'"
+		echo "  --perf                execute performance tests (sequentially)"
+		echo "  --perf-baseline=<dir> performance baseline, default: <builddir>/tests/perf-baseline"
+		echo "  --perf-tolerance=<percent>  allowed slowdown against the baseline, default: 25"
+		echo "  --perf-update         save the performance results as the new baseline"
 		echo
 		exit 1
 		;;
@@ -238,6 +250,11 @@ echo
 echo "      options: $(echo $OPTS | sed 's/ / \\\n               /g')"
 echo
 
+# the parallel tests affect the results
+if [ -n "$has_perf_opt" ]; then
+	paraller_jobs=1
+fi
+
 if [ "$paraller_jobs" -ne 1 ]; then
 	tmp=$paraller_jobs
 	[ "$paraller_jobs" -eq 0 ] && tmp=infinite
@@ -42,6 +42,7 @@
 #include <string.h>
 #include <errno.h>
 #include <getopt.h>
+#include <search.h>
 
 #include "nls.h"
 #include "c.h"
@@ -57,6 +58,7 @@
 #include "libsmartcols.h"
 
 #define TABCHAR_CELLS         8
+#define COLUMN_STREAM_SAMPLE  128	/* default --stream lines */
 
 enum {
 	COLUMN_MODE_FILLCOLS = 0,
@@ -94,6 +96,7 @@ struct column_control {
 	size_t	nents;		/* number of entries */
 	size_t	maxlength;	/* longest input record (line) */
 	size_t  maxncols;	/* maximal number of input columns */
+	size_t	stream_sample;	/* --stream lines to calculate widths */
 
 	unsigned int greedy :1,
 		     json :1,
@@ -101,6 +104,7 @@ struct column_control {
 		     hide_unnamed :1,
 		     maxout : 1,
 		     keep_empty_lines :1,	/* --keep-empty-lines */
+		     stream :1,			/* --stream */
 		     tab_noheadings :1;
 };
 
@@ -503,53 +507,99 @@ static void reorder_table(struct column_control *ctl)
 	strv_free(order);
 }
 
+/* lines with the same content of the tree parent column */
+struct tree_parent {
+	const char *name;
+	struct libscols_line **lines;
+	size_t nlines;
+	size_t nalloc;
+};
+
+static int cmp_tree_parent(const void *a, const void *b)
+{
+	return strcmp(((const struct tree_parent *) a)->name,
+		      ((const struct tree_parent *) b)->name);
+}
+
+static void free_tree_parent(void *data)
+{
+	struct tree_parent *tp = (struct tree_parent *) data;
+
+	free(tp->lines);
+	free(tp);
+}
+
+static const char *get_column_data(struct libscols_line *ln, struct libscols_column *cl)
+{
+	struct libscols_cell *ce = scols_line_get_column_cell(ln, cl);
+
+	return ce ? scols_cell_get_data(ce) : NULL;
+}
+
 static void create_tree(struct column_control *ctl)
 {
 	struct libscols_column *cl_tree = string_to_column(ctl, ctl->tree);
 	struct libscols_column *cl_p = string_to_column(ctl, ctl->tree_parent);
 	struct libscols_column *cl_i = string_to_column(ctl, ctl->tree_id);
-	struct libscols_iter *itr_p, *itr_i;
-	struct libscols_line *ln_i;
+	struct libscols_iter *itr;
+	struct libscols_line *ln;
+	void *parents = NULL;
 
 	if (!cl_p || !cl_i || !cl_tree)
 		return;			/* silently ignore the tree request */
 
 	column_set_flag(cl_tree, SCOLS_FL_TREE);
 
-	itr_p = scols_new_iter(SCOLS_ITER_FORWARD);
-	itr_i = scols_new_iter(SCOLS_ITER_FORWARD);
-	if (!itr_p || !itr_i)
+	itr = scols_new_iter(SCOLS_ITER_FORWARD);
+	if (!itr)
 		err_oom();
 
-	/* scan all lines for ID */
-	while (scols_table_next_line(ctl->tab, itr_i, &ln_i) == 0) {
-		struct libscols_line *ln;
-		struct libscols_cell *ce = scols_line_get_column_cell(ln_i, cl_i);
-		const char *id = ce ? scols_cell_get_data(ce) : NULL;
+	/* index lines by parent column, the lines are kept in the table order */
+	while (scols_table_next_line(ctl->tab, itr, &ln) == 0) {
+		struct tree_parent key = { .name = get_column_data(ln, cl_p) }, *tp;
+		void **node;
 
-		if (!id)
+		if (!key.name)
 			continue;
+		node = tfind(&key, &parents, cmp_tree_parent);
+		if (!node) {
+			tp = xcalloc(1, sizeof(*tp));
+			tp->name = key.name;
+			if (!tsearch(tp, &parents, cmp_tree_parent))
+				err_oom();
+		} else
+			tp = *(struct tree_parent **) node;
 
-		/* see if the ID is somewhere used in parent column */
-		scols_reset_iter(itr_p, SCOLS_ITER_FORWARD);
-		while (scols_table_next_line(ctl->tab, itr_p, &ln) == 0) {
-			const char *parent;
+		if (tp->nlines == tp->nalloc) {
+			tp->nalloc = tp->nalloc ? tp->nalloc * 2 : 4;
+			tp->lines = xreallocarray(tp->lines, tp->nalloc, sizeof(ln));
+		}
+		tp->lines[tp->nlines++] = ln;
+	}
 
-			ce = scols_line_get_column_cell(ln, cl_p);
-			parent = ce ? scols_cell_get_data(ce) : NULL;
+	/* scan all lines for ID and add lines with the ID in parent column */
+	scols_reset_iter(itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_line(ctl->tab, itr, &ln) == 0) {
+		struct tree_parent key = { .name = get_column_data(ln, cl_i) }, *tp;
+		void **node;
+		size_t i;
 
-			if (!parent)
-				continue;
-			if (strcmp(id, parent) != 0)
-				continue;
-			if (scols_line_is_ancestor(ln, ln_i))
+		if (!key.name)
+			continue;
+		node = tfind(&key, &parents, cmp_tree_parent);
+		if (!node)
+			continue;
+		tp = *(struct tree_parent **) node;
+
+		for (i = 0; i < tp->nlines; i++) {
+			if (scols_line_is_ancestor(tp->lines[i], ln))
 				continue;
-			scols_line_add_child(ln_i, ln);
+			scols_line_add_child(ln, tp->lines[i]);
 		}
 	}
 
-	scols_free_iter(itr_p);
-	scols_free_iter(itr_i);
+	tdestroy(parents, free_tree_parent);
+	scols_free_iter(itr);
 }
 
 static void modify_table(struct column_control *ctl)
@@ -593,6 +643,50 @@ static void modify_table(struct column_control *ctl)
 		reorder_table(ctl);
 }
 
+/*
+ * The --stream mode collects the leading lines in the table, then the table
+ * is finalized and libsmartcols prints (and frees) every next line when
+ * added. The widths are calculated from the collected lines only.
+ */
+static void stream_table(struct column_control *ctl)
+{
+	if (!ctl->stream || scols_table_is_streaming(ctl->tab)
+	    || scols_table_get_nlines(ctl->tab) < ctl->stream_sample)
+		return;
+
+	modify_table(ctl);
+	scols_table_set_streaming_sample(ctl->tab, 0);
+	scols_table_enable_streaming(ctl->tab, 1);
+}
+
+/*
+ * The line @ln needs more columns than the streamed table. The widths of the
+ * already printed lines cannot be changed, so finish the current table and
+ * start a new one with @ln as the first line.
+ */
+static void restart_stream(struct column_control *ctl, struct libscols_line *ln,
+			   size_t ncols)
+{
+	struct libscols_table *old = ctl->tab;
+
+	if (ln) {
+		scols_ref_line(ln);
+		scols_table_remove_line(old, ln);
+	}
+	if (scols_print_table(old) != 0)
+		err(EXIT_FAILURE, _("failed to print output table"));
+	scols_unref_table(old);
+
+	init_table(ctl);
+	while (scols_table_get_ncols(ctl->tab) < ncols)
+		scols_table_new_column(ctl->tab, NULL, 0, 0);
+
+	if (ln) {
+		if (scols_table_add_line(ctl->tab, ln))
+			err(EXIT_FAILURE, _("failed to allocate output line"));
+		scols_unref_line(ln);
+	}
+}
 
 static int add_line_to_table(struct column_control *ctl, wchar_t *wcs0)
 {
@@ -623,6 +717,11 @@ static int add_line_to_table(struct column_control *ctl, wchar_t *wcs0)
 			wcdata = all + skip;
 		}
 
+		/* hidden extra columns don't break the streamed output */
+		if (scols_table_get_ncols(ctl->tab) < n + 1
+		    && scols_table_is_streaming(ctl->tab) && !ctl->hide_unnamed)
+			restart_stream(ctl, ln, n);
+
 		if (scols_table_get_ncols(ctl->tab) < n + 1) {
 			if (scols_table_is_json(ctl->tab) && !ctl->hide_unnamed)
 				errx(EXIT_FAILURE, _("line %zu: for JSON the name of the "
@@ -650,6 +749,7 @@ static int add_line_to_table(struct column_control *ctl, wchar_t *wcs0)
 	} while (1);
 
 	free(all);
+	stream_table(ctl);
 	return 0;
 }
 
@@ -661,6 +761,7 @@ static int add_emptyline_to_table(struct column_control *ctl)
 	if (!scols_table_new_line(ctl->tab, NULL))
 		err(EXIT_FAILURE, _("failed to allocate output line"));
 
+	stream_table(ctl);
 	return 0;
 }
 
@@ -847,6 +948,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -W, --table-wrap <columns>       wrap text in the columns when necessary\n"), out);
 	fputs(_(" -L, --keep-empty-lines           don't ignore empty lines\n"), out);
 	fputs(_(" -J, --json                       use JSON output format for table\n"), out);
+	fputs(_("     --stream[=<lines>]           print lines as read, widths from the leading lines\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_(" -r, --tree <column>              column to use tree-like output for the table\n"), out);
@@ -878,6 +980,9 @@ int main(int argc, char **argv)
 	int c;
 	unsigned int eval = 0;		/* exit value */
 
+	enum {
+		OPT_STREAM = CHAR_MAX + 1
+	};
 	static const struct option longopts[] =
 	{
 		{ "columns",             required_argument, NULL, 'c' }, /* deprecated */
@@ -888,6 +993,7 @@ int main(int argc, char **argv)
 		{ "output-separator",    required_argument, NULL, 'o' },
 		{ "output-width",        required_argument, NULL, 'c' },
 		{ "separator",           required_argument, NULL, 's' },
+		{ "stream",              optional_argument, NULL, OPT_STREAM },
 		{ "table",               no_argument,       NULL, 't' },
 		{ "table-columns",       required_argument, NULL, 'N' },
 		{ "table-column",        required_argument, NULL, 'C' },
@@ -912,7 +1018,9 @@ int main(int argc, char **argv)
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
 		{ 'C','N' },
 		{ 'J','x' },
+		{ 'r', OPT_STREAM },
 		{ 't','x' },
+		{ 'x', OPT_STREAM },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -1011,6 +1119,13 @@ int main(int argc, char **argv)
 		case 'x':
 			ctl.mode = COLUMN_MODE_FILLROWS;
 			break;
+		case OPT_STREAM:
+			ctl.stream = 1;
+			ctl.stream_sample = optarg ?
+				strtou32_or_err(optarg, _("invalid stream lines argument")) :
+				COLUMN_STREAM_SAMPLE;
+			ctl.mode = COLUMN_MODE_TABLE;
+			break;
 
 		case 'h':
 			usage();
@@ -1066,8 +1181,11 @@ int main(int argc, char **argv)
 
 	switch (ctl.mode) {
 	case COLUMN_MODE_TABLE:
-		if (ctl.tab && scols_table_get_nlines(ctl.tab)) {
-			modify_table(&ctl);
+		if (ctl.tab && (scols_table_is_streaming(ctl.tab) ||
+				scols_table_get_nlines(ctl.tab))) {
+			/* --stream modifies the table before the first line is printed */
+			if (!scols_table_is_streaming(ctl.tab))
+				modify_table(&ctl);
 			eval = scols_print_table(ctl.tab);
 
 			scols_unref_table(ctl.tab);
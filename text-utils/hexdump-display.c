@@ -40,6 +40,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
 #include "hexdump.h"
 #include "xalloc.h"
 #include "c.h"
@@ -106,14 +107,143 @@ static const char *color_cond(struct hexdump_pr *pr, unsigned char *bp, int bcnt
 	return NULL;
 }
 
+/*
+ * The fast units are written to this buffer, it's flushed before any other
+ * output and after every block.
+ */
+static char outbuf[BUFSIZ];		/* 8KiB with glibc */
+static size_t outlen;
+
+static void flush_fast(void)
+{
+	if (outlen)
+		fwrite(outbuf, 1, outlen, stdout);
+	outlen = 0;
+}
+
+static void print_text(const char *str)
+{
+	size_t len = strlen(str);
+
+	if (sizeof(outbuf) - outlen < len) {
+		flush_fast();
+		if (len > sizeof(outbuf)) {
+			fputs(str, stdout);
+			return;
+		}
+	}
+	memcpy(outbuf + outlen, str, len);
+	outlen += len;
+}
+
+/* the same as printf(pr->fmt, num) for the formats from set_fast_format() */
+static void print_fast(const struct hexdump_pr *pr, unsigned long long num)
+{
+	const struct hexdump_ifmt *f = &pr->ifmt;
+	static const char lower[] = "0123456789abcdef", upper[] = "0123456789ABCDEF";
+	const char *digits = f->conv == 'X' ? upper : lower;
+	char tmp[24], *p;
+	unsigned int base = f->conv == 'o' ? 8 : f->conv == 'u' ? 10 : 16;
+	int ndigits = 0, nzeros, npad;
+
+	/* the width and precision are max 64 */
+	if (sizeof(outbuf) - outlen < f->prefix + 2 * 64 + sizeof(tmp))
+		flush_fast();
+	if (f->prefix + 2 * 64 + sizeof(tmp) > sizeof(outbuf)) {
+		fwrite(pr->fmt, 1, f->prefix, stdout);
+		p = outbuf;
+	} else {
+		p = outbuf + outlen;
+		memcpy(p, pr->fmt, f->prefix);
+		p += f->prefix;
+	}
+
+	if (f->conv == 'c') {
+		*p++ = (char) num;
+		outlen = p - outbuf;
+		return;
+	}
+
+	while (num) {
+		tmp[ndigits++] = digits[num % base];
+		num /= base;
+	}
+	/* zero is printed as "0", but as nothing for zero precision */
+	if (!ndigits && f->prec < 0)
+		tmp[ndigits++] = '0';
+
+	nzeros = f->prec > ndigits ? f->prec - ndigits : 0;
+	npad = f->width > ndigits + nzeros ? f->width - ndigits - nzeros : 0;
+
+	/* the '0' flag is ignored if a precision is specified */
+	if (f->zero && f->prec < 0) {
+		nzeros += npad;
+		npad = 0;
+	}
+	memset(p, ' ', npad);
+	p += npad;
+	memset(p, '0', nzeros);
+	p += nzeros;
+	while (ndigits)
+		*p++ = tmp[--ndigits];
+
+	outlen = p - outbuf;
+}
+
 static inline void
 print(struct hexdump_pr *pr, unsigned char *bp) {
 
 	const char *color = NULL;
 
-	if (pr->colorlist && (color = color_cond(pr, bp, pr->bcnt)))
+	if (pr->colorlist && (color = color_cond(pr, bp, pr->bcnt))) {
+		flush_fast();
 		color_enable(color);
+	}
 
+	if (pr->ifmt.conv) {
+		unsigned long long num = 0;
+
+		switch (pr->flags) {
+		case F_ADDRESS:
+			num = address;
+			break;
+		case F_P:
+			num = isprint(*bp) ? *bp : '.';
+			break;
+		case F_UINT:
+			switch (pr->bcnt) {
+			case 1:
+				num = *bp;
+				break;
+			case 2:
+			    {
+				uint16_t sval;
+				memcpy(&sval, bp, sizeof(sval));
+				num = sval;
+				break;
+			    }
+			case 4:
+			    {
+				uint32_t ival;
+				memcpy(&ival, bp, sizeof(ival));
+				num = ival;
+				break;
+			    }
+			case 8:
+				memcpy(&num, bp, sizeof(num));
+				break;
+			}
+			break;
+		}
+		print_fast(pr, num);
+		goto done;
+	}
+	if (pr->flags == F_TEXT) {
+		print_text(pr->fmt);
+		goto done;
+	}
+
+	flush_fast();
 	switch(pr->flags) {
 	case F_ADDRESS:
 		printf(pr->fmt, address);
@@ -176,9 +306,6 @@ print(struct hexdump_pr *pr, unsigned char *bp) {
 	case F_STR:
 		printf(pr->fmt, (char *)bp);
 		break;
-	case F_TEXT:
-		printf("%s", pr->fmt);
-		break;
 	case F_U:
 		conv_u(pr, bp);
 		break;
@@ -208,8 +335,11 @@ print(struct hexdump_pr *pr, unsigned char *bp) {
 		break;
 	    }
 	}
-	if (color) /* did we colorize something? */
+done:
+	if (color) { /* did we colorize something? */
+		flush_fast();
 		color_disable();
+	}
 }
 
 static void bpad(struct hexdump_pr *pr)
@@ -222,6 +352,7 @@ static void bpad(struct hexdump_pr *pr)
 	 * with %s, and it's not useful here.
 	 */
 	pr->flags = F_BPAD;
+	pr->ifmt.conv = 0;
 	pr->cchar[0] = 's';
 	pr->cchar[1] = 0;
 
@@ -296,6 +427,7 @@ void display(struct hexdump *hex)
 			rem = hex->blocksize;
 			address = saveaddress;
 		}
+		flush_fast();
 	}
 	if (endfu) {
 		/*
@@ -332,6 +464,41 @@ void display(struct hexdump *hex)
 
 static char **_argv;
 
+/*
+ * The input is read by read(2) in big chunks rather than by fread() for
+ * every block; the buffer is empty when the next file is opened.
+ */
+#define INBUF_SIZE	(1024 * 1024)
+
+static unsigned char *inbuf;
+static size_t inbuf_pos, inbuf_len;
+
+static ssize_t read_input(struct hexdump *hex, unsigned char *buf, size_t count)
+{
+	if (inbuf_pos == inbuf_len) {
+		size_t sz = INBUF_SIZE;
+		ssize_t n;
+
+		/* don't read behind -n */
+		if (hex->length != -1 && (size_t) hex->length < sz)
+			sz = hex->length;
+		if (!inbuf)
+			inbuf = xmalloc(INBUF_SIZE);
+		do {
+			n = read(fileno(stdin), inbuf, sz);
+		} while (n < 0 && errno == EINTR);
+		if (n <= 0)
+			return n;
+		inbuf_pos = 0;
+		inbuf_len = n;
+	}
+
+	count = min(count, inbuf_len - inbuf_pos);
+	memcpy(buf, inbuf + inbuf_pos, count);
+	inbuf_pos += count;
+	return count;
+}
+
 static u_char *
 get(struct hexdump *hex)
 {
@@ -374,10 +541,10 @@ get(struct hexdump *hex)
 			warnx(_("all input file arguments failed"));
 			goto retnul;
 		}
-		n = fread((char *)curp + nread, sizeof(unsigned char),
-		    hex->length == -1 ? need : min(hex->length, need), stdin);
-		if (!n) {
-			if (ferror(stdin))
+		n = read_input(hex, curp + nread,
+		    hex->length == -1 ? need : min(hex->length, need));
+		if (n <= 0) {
+			if (n < 0)
 				warn("%s", _argv[-1]);
 			ateof = 1;
 			continue;
@@ -405,6 +572,8 @@ get(struct hexdump *hex)
 retnul:
 	free (curp);
 	free (savp);
+	free (inbuf);
+	inbuf = NULL;
 	return NULL;
 }
 
@@ -431,12 +600,18 @@ int next(char **argv, struct hexdump *hex)
 				return(0);
 			statok = 0;
 		}
+		inbuf_pos = inbuf_len = 0;
 		if (hex->skip)
 			doskip(statok ? *_argv : "stdin", statok, hex);
 		if (*_argv)
 			++_argv;
-		if (!hex->skip)
+		if (!hex->skip) {
+#if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
+			ignore_result( posix_fadvise(fileno(stdin), 0, 0,
+						POSIX_FADV_SEQUENTIAL) );
+#endif
 			return(1);
+		}
 	}
 	/* NOTREACHED */
 }
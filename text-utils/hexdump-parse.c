@@ -225,6 +225,53 @@ int block_size(struct hexdump_fs *fs)
 	return(cursize);
 }
 
+/*
+ * The canonical formats (-C, -b, -d, -o, -x and the default) use only
+ * "<text>%[0][width][.prec]ll[ouxX]" and "<text>%c" units; these are printed
+ * by print_fast() without parsing the format again for every value.
+ */
+static void set_fast_format(struct hexdump_pr *pr)
+{
+	struct hexdump_ifmt *f = &pr->ifmt;
+	const char *p;
+
+	memset(f, 0, sizeof(*f));
+	f->prec = -1;
+
+	if (pr->nospace || !(pr->flags & (F_ADDRESS | F_UINT | F_P)))
+		return;
+
+	p = strchr(pr->fmt, '%');
+	if (!p)
+		return;
+	f->prefix = p - pr->fmt;
+	p++;
+
+	if (pr->flags == F_P) {
+		if (p[0] == 'c' && p[1] == '\0')
+			f->conv = 'c';
+		return;
+	}
+
+	if (*p == '0') {
+		f->zero = 1;
+		p++;
+	}
+	while (isdigit((unsigned char) *p))
+		f->width = f->width * 10 + (*p++ - '0');
+	if (*p == '.') {
+		f->prec = 0;
+		p++;
+		while (isdigit((unsigned char) *p))
+			f->prec = f->prec * 10 + (*p++ - '0');
+	}
+	if (p[0] != 'l' || p[1] != 'l' || !strchr("ouxX", p[2]) || p[3] != '\0'
+	    || f->width > 64 || f->prec > 64)
+		return;
+
+	f->conv = p[2];
+}
+
 void rewrite_rules(struct hexdump_fs *fs, struct hexdump *hex)
 {
 	enum { NOTOKAY, USEBCNT, USEPREC } sokay;
@@ -471,6 +518,8 @@ isint:				cs[3] = '\0';
 			if (p2)
 				pr->nospace = p2;
 		}
+		list_for_each(q, &fu->prlist)
+			set_fast_format(list_entry(q, struct hexdump_pr, prlist));
 	}
 }
 
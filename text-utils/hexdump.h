@@ -48,6 +48,15 @@ struct hexdump_clr {
 	int invert;			/* invert condition? */
 };
 
+/* simple conversion printed without printf(), see set_fast_format() */
+struct hexdump_ifmt {
+	size_t prefix;			/* length of the text before '%' */
+	int width;			/* field width */
+	int prec;			/* minimal number of digits or -1 */
+	char conv;			/* 'o', 'u', 'x', 'X', 'c' or 0 for printf() */
+	unsigned int zero : 1;		/* '0' flag */
+};
+
 struct hexdump_pr {
 	struct list_head prlist;		/* next print unit */
 #define	F_ADDRESS	0x001		/* print offset */
@@ -67,6 +76,7 @@ struct hexdump_pr {
 	struct list_head *colorlist;	/* color settings */
 	char *fmt;			/* printf format */
 	char *nospace;			/* no whitespace version */
+	struct hexdump_ifmt ifmt;	/* fast version of @fmt */
 };
 
 struct hexdump_fu {
@@ -84,6 +84,7 @@
 #include "widechar.h"
 #include "closestream.h"
 #include "env.h"
+#include "lineindex.h"
 
 #ifdef TEST_PROGRAM
 # define NON_INTERACTIVE_MORE 1
@@ -161,6 +162,7 @@ struct more_control {
 	FILE *current_file;		/* currently open input file */
 	off_t file_position;		/* file position */
 	off_t file_size;		/* file size */
+	struct ul_lineidx lineidx;	/* line offsets of the current file */
 	int argv_position;		/* argv[] position */
 	int lines_per_screen;		/* screen size in lines */
 	int d_scroll_len;		/* number of lines scrolled by 'd' */
@@ -476,6 +478,7 @@ static void checkf(struct more_control *ctl, char *fs)
 		return;
 	}
 	fcntl(fileno(ctl->current_file), F_SETFD, FD_CLOEXEC);
+	ul_init_lineidx(&ctl->lineidx, fileno(ctl->current_file));
 	c = more_getc(ctl);
 	ctl->clear_first = (c == '\f');
 	more_ungetc(ctl, c);
@@ -783,6 +786,7 @@ static void __attribute__((__noreturn__)) more_exit(struct more_control *ctl)
 	free(ctl->go_home);
 	if (ctl->current_file)
 		fclose(ctl->current_file);
+	ul_free_lineidx(&ctl->lineidx);
 	del_curterm(cur_term);
 	_exit(EXIT_SUCCESS);
 }
@@ -1314,6 +1318,19 @@ static void skip_lines(struct more_control *ctl)
 {
 	int c;
 
+	/* the index knows line numbers from the beginning of the file only */
+	if (ctl->next_jump > 0 && ctl->current_line == 0 && ctl->file_position == 0) {
+		size_t line = ctl->next_jump;
+		off_t off;
+
+		if (ul_lineidx_seek(&ctl->lineidx, &line, &off) == 0) {
+			more_fseek(ctl, off);
+			ctl->current_line = line;
+			ctl->next_jump -= line;
+			return;
+		}
+	}
+
 	while (ctl->next_jump > 0) {
 		while ((c = more_getc(ctl)) != '\n')
 			if (c == EOF)
@@ -1980,6 +1997,7 @@ static void display_file(struct more_control *ctl, int left)
 	fflush(NULL);
 	fclose(ctl->current_file);
 	ctl->current_file = NULL;
+	ul_free_lineidx(&ctl->lineidx);
 	ctl->screen_start.line_num = ctl->screen_start.row_num = 0;
 	ctl->context.line_num = ctl->context.row_num = 0L;
 }
@@ -2086,6 +2104,9 @@ int main(int argc, char **argv)
 	close_stdout_atexit();
 	setlocale(LC_ALL, "");
 
+	/* stdin is not indexed, it does not have to start at offset zero */
+	ul_init_lineidx(&ctl.lineidx, -1);
+
 	/* Auto set no scroll on when binary is called page */
 	if (!(strcmp(program_invocation_short_name, "page")))
 		ctl.no_scroll++;
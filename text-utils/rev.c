@@ -52,6 +52,7 @@
 #include <sys/types.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -60,11 +61,32 @@
 
 #include "nls.h"
 #include "xalloc.h"
+#include "bitops.h"
 #include "widechar.h"
 #include "c.h"
 #include "closestream.h"
 #include "fgetwc_or_err.h"
 
+#if defined(__x86_64__) && defined(__GNUC__)
+# include <immintrin.h>
+# define HAVE_REV_SSSE3	1
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+# include <arm_neon.h>
+# define HAVE_REV_NEON	1
+#endif
+
+/* initial size of the byte buffer, it grows for longer lines */
+#define REV_BUFSIZ	(256 * 1024)
+
+struct rev_buffer {
+	char	*data;		/* input */
+	char	*out;		/* reversed lines */
+	size_t	size;		/* size of both the buffers */
+};
+
+typedef void (*reverse_bytes_fn)(char *, const char *, size_t);
+
 static void sig_handler(int signo __attribute__ ((__unused__)))
 {
 	_exit(EXIT_SUCCESS);
@@ -97,6 +119,192 @@ static void reverse_str(wchar_t *str, size_t n)
 	}
 }
 
+/* copies @n bytes from @src to @dst in the reverse order */
+static void reverse_bytes_generic(char *dst, const char *src, size_t n)
+{
+	const char *s = src + n;
+
+	for (; n >= sizeof(uint64_t); n -= sizeof(uint64_t)) {
+		uint64_t w;
+
+		s -= sizeof(w);
+		memcpy(&w, s, sizeof(w));
+		w = bswap_64(w);
+		memcpy(dst, &w, sizeof(w));
+		dst += sizeof(w);
+	}
+	while (n--)
+		*dst++ = *--s;
+}
+
+#ifdef HAVE_REV_SSSE3
+static __attribute__((__target__("ssse3")))
+void reverse_bytes_ssse3(char *dst, const char *src, size_t n)
+{
+	const __m128i mask = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8,
+					   7, 6, 5, 4, 3, 2, 1, 0);
+	const char *s = src + n;
+
+	for (; n >= 16; n -= 16, dst += 16) {
+		s -= 16;
+		_mm_storeu_si128((__m128i *) dst,
+			_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) s), mask));
+	}
+	reverse_bytes_generic(dst, src, n);
+}
+#endif
+
+#ifdef HAVE_REV_NEON
+static void reverse_bytes_neon(char *dst, const char *src, size_t n)
+{
+	const char *s = src + n;
+
+	for (; n >= 16; n -= 16, dst += 16) {
+		uint8x16_t v;
+
+		s -= 16;
+		v = vrev64q_u8(vld1q_u8((const uint8_t *) s));
+		vst1q_u8((uint8_t *) dst, vcombine_u8(vget_high_u8(v), vget_low_u8(v)));
+	}
+	reverse_bytes_generic(dst, src, n);
+}
+#endif
+
+static reverse_bytes_fn get_reverse_bytes(void)
+{
+#if defined(HAVE_REV_NEON)
+	return reverse_bytes_neon;
+#elif defined(HAVE_REV_SSSE3)
+	if (__builtin_cpu_supports("ssse3"))
+		return reverse_bytes_ssse3;
+#endif
+	return reverse_bytes_generic;
+}
+
+/*
+ * The byte oriented path is usable if every ASCII byte is a character of its
+ * own and the encoding is stateless, that is in single-byte and UTF-8 locales.
+ */
+static int is_bytewise_locale(void)
+{
+#ifdef HAVE_WIDECHAR
+	if (MB_CUR_MAX == 1)
+		return 1;
+# ifdef HAVE_LANGINFO_H
+	if (strcmp(nl_langinfo(CODESET), "UTF-8") == 0)
+		return 1;
+# endif
+	return 0;
+#else
+	return 1;
+#endif
+}
+
+/*
+ * Verifies the multibyte characters in the line and reverses them in place,
+ * so they are in the original order after the whole line is reversed.
+ * Returns 0, or -1 for an invalid or incomplete sequence.
+ */
+static int prepare_line(char *p, size_t n)
+{
+#ifdef HAVE_WIDECHAR
+	char *end = p + n;
+
+	while (p < end) {
+		mbstate_t st;
+		size_t len, i;
+		uint64_t w;
+
+		/* skip ASCII */
+		while (end - p >= (ptrdiff_t) sizeof(w)) {
+			memcpy(&w, p, sizeof(w));
+			if (w & 0x8080808080808080ULL)
+				break;
+			p += sizeof(w);
+		}
+		while (p < end && !(*p & 0x80))
+			p++;
+		if (p == end)
+			break;
+
+		memset(&st, 0, sizeof(st));
+		len = mbrtowc(NULL, p, end - p, &st);
+		if (len == (size_t) -1 || len == (size_t) -2)
+			return -1;
+		for (i = 0; i < len / 2; i++) {
+			char c = p[i];
+			p[i] = p[len - 1 - i];
+			p[len - 1 - i] = c;
+		}
+		p += len;
+	}
+#endif
+	return 0;
+}
+
+/* reverses lines by read(2) of big blocks of bytes */
+static int rev_bytes(struct rev_buffer *b, reverse_bytes_fn reverse_bytes,
+		     int fd, const char *filename, char sep)
+{
+	size_t len = 0;
+	uintmax_t line = 0;
+	int eof = 0;
+
+	while (!eof) {
+		char *p, *end, *o;
+		ssize_t sz;
+
+		if (len == b->size) {
+			/* the line does not fit into the buffer */
+			b->size *= 2;
+			b->data = xrealloc(b->data, b->size);
+			b->out = xrealloc(b->out, b->size);
+		}
+		sz = read(fd, b->data + len, b->size - len);
+		if (sz < 0) {
+			if (errno == EINTR)
+				continue;
+			warn("%s: %ju", filename, line);
+			return -1;
+		}
+		if (sz == 0)
+			eof = 1;
+		len += sz;
+
+		p = b->data;
+		end = p + len;
+		o = b->out;
+		while (p < end) {
+			char *e = memchr(p, sep, end - p);
+
+			if (!e) {
+				if (!eof)
+					break;
+				e = end;	/* last line without separator */
+			}
+			if (prepare_line(p, e - p) != 0) {
+				/* fail the same way as the wide char path */
+				fwrite(b->out, 1, o - b->out, stdout);
+				errno = EILSEQ;
+				err(EXIT_FAILURE, _("fgetwc() failed"));
+			}
+			reverse_bytes(o, p, e - p);
+			o += e - p;
+			if (e < end) {
+				*o++ = sep;
+				e++;
+			}
+			p = e;
+			line++;
+		}
+		fwrite(b->out, 1, o - b->out, stdout);
+
+		len = end - p;
+		memmove(b->data, p, len);
+	}
+	return 0;
+}
+
 static size_t read_line(wchar_t sep, wchar_t *str, size_t n, FILE *stream)
 {
 	size_t r = 0;
@@ -117,15 +325,51 @@ static void write_line(wchar_t *str, size_t n, FILE *stream)
 		fputwc(str[i], stream);
 }
 
+/* reverses lines by wide characters */
+static int rev_wide(wchar_t **buf, size_t *bufsiz, FILE *fp,
+		    const char *filename, wchar_t sep)
+{
+	uintmax_t line = 0;
+	size_t len;
+
+	while (!feof(fp)) {
+		len = read_line(sep, *buf, *bufsiz, fp);
+
+		/* This is my hack from setpwnam.c -janl */
+		while (len == *bufsiz && !feof(fp)) {
+			/* Extend input buffer if it failed getting the whole line */
+			/* So now we double the buffer size */
+			*bufsiz *= 2;
+
+			*buf = xreallocarray(*buf, *bufsiz, sizeof(wchar_t));
+
+			/* And fill the rest of the buffer */
+			len += read_line(sep, &(*buf)[len], *bufsiz / 2, fp);
+		}
+		if (ferror(fp)) {
+			warn("%s: %ju", filename, line);
+			return -1;
+		}
+		if (len == 0)
+			continue;
+
+		reverse_str(*buf, (*buf)[len - 1] == sep ? len - 1 : len);
+		write_line(*buf, len, stdout);
+		line++;
+	}
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	char const *filename = "stdin";
-	wchar_t *buf;
+	wchar_t *buf = NULL;
 	wchar_t sep = L'\n';
-	size_t len, bufsiz = BUFSIZ;
+	size_t bufsiz = BUFSIZ;
+	struct rev_buffer bytes = { .size = 0 };
+	reverse_bytes_fn reverse_bytes = NULL;
 	FILE *fp = stdin;
-	int ch, rval = EXIT_SUCCESS;
-	uintmax_t line;
+	int ch, rc, rval = EXIT_SUCCESS;
 
 	static const struct option longopts[] = {
 		{ "zero",       no_argument,       NULL, '0' },
@@ -158,7 +402,13 @@ int main(int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
-	buf = xreallocarray(NULL, bufsiz, sizeof(wchar_t));
+	if (is_bytewise_locale()) {
+		bytes.size = REV_BUFSIZ;
+		bytes.data = xmalloc(bytes.size);
+		bytes.out = xmalloc(bytes.size);
+		reverse_bytes = get_reverse_bytes();
+	} else
+		buf = xreallocarray(NULL, bufsiz, sizeof(wchar_t));
 
 	do {
 		if (*argv) {
@@ -171,37 +421,19 @@ int main(int argc, char *argv[])
 			filename = *argv++;
 		}
 
-		line = 0;
-		while (!feof(fp)) {
-			len = read_line(sep, buf, bufsiz, fp);
-
-			/* This is my hack from setpwnam.c -janl */
-			while (len == bufsiz && !feof(fp)) {
-				/* Extend input buffer if it failed getting the whole line */
-				/* So now we double the buffer size */
-				bufsiz *= 2;
-
-				buf = xreallocarray(buf, bufsiz, sizeof(wchar_t));
-
-				/* And fill the rest of the buffer */
-				len += read_line(sep, &buf[len], bufsiz/2, fp);
-			}
-			if (ferror(fp)) {
-				warn("%s: %ju", filename, line);
-				rval = EXIT_FAILURE;
-				break;
-			}
-			if (len == 0)
-				continue;
-
-			reverse_str(buf, buf[len - 1] == sep ? len - 1 : len);
-			write_line(buf, len, stdout);
-			line++;
-		}
+		if (reverse_bytes)
+			rc = rev_bytes(&bytes, reverse_bytes, fileno(fp),
+				       filename, (char) sep);
+		else
+			rc = rev_wide(&buf, &bufsiz, fp, filename, sep);
+		if (rc)
+			rval = EXIT_FAILURE;
 		if (fp != stdin)
 			fclose(fp);
 	} while(*argv);
 
 	free(buf);
+	free(bytes.data);
+	free(bytes.out);
 	return rval;
 }